@@ -31,6 +31,9 @@
 #include <winpr/crt.h>
 #include <winpr/cmdline.h>
 #include <winpr/wlog.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
 
 #include <freerdp/addin.h>
 
@@ -74,6 +77,19 @@ typedef struct
 	UINT32 formats_count;
 } AUDIN_CHANNEL_CALLBACK;
 
+/**
+ * Single producer, single consumer byte ring between the capture callback and
+ * the encoder thread. The positions only grow and wrap at 2^32, the capacity is
+ * a power of two. Each side only writes its own position.
+ */
+typedef struct
+{
+	BYTE* buffer;
+	UINT32 capacity;
+	volatile LONG readPos;
+	volatile LONG writePos;
+} AUDIN_RING;
+
 typedef struct
 {
 	IWTSPlugin iface;
@@ -94,6 +110,25 @@ typedef struct
 	AUDIO_FORMAT* format;
 	UINT32 FramesPerPacket;
 
+	/* Opus encoder settings, 0 for the ones of the negotiated format */
+	UINT32 bitrate;
+	UINT32 frames;
+
+	/* Capture period and packet interval in ms, 0 for the FramesPerPacket of the server */
+	UINT32 latency;
+	UINT32 packet;
+
+	/* The capture callback only fills the ring, the encoder thread encodes and sends */
+	AUDIO_FORMAT device_format;
+	BOOL passthrough;
+	AUDIN_RING ring;
+	BYTE* pcm;
+	size_t packet_bytes;
+	volatile LONG dropped;
+	HANDLE encoder_thread;
+	HANDLE stop_event;
+	HANDLE data_event;
+
 	FREERDP_DSP_CONTEXT* dsp_context;
 	wLog* log;
 
@@ -332,29 +367,82 @@ static UINT audin_send_open_reply_pdu(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBAC
 	return audin_channel_write_and_free(callback, out, TRUE);
 }
 
+static BOOL audin_ring_init(AUDIN_RING* ring, size_t size)
+{
+	UINT32 capacity = 4096;
+
+	while ((capacity < size) && (capacity < (1u << 30)))
+		capacity <<= 1;
+
+	ring->buffer = malloc(capacity);
+
+	if (!ring->buffer)
+		return FALSE;
+
+	ring->capacity = capacity;
+	ring->readPos = 0;
+	ring->writePos = 0;
+	return TRUE;
+}
+
+static void audin_ring_free(AUDIN_RING* ring)
+{
+	free(ring->buffer);
+	ring->buffer = NULL;
+	ring->capacity = 0;
+}
+
+static UINT32 audin_ring_used(AUDIN_RING* ring)
+{
+	const UINT32 writePos = (UINT32)InterlockedCompareExchange(&ring->writePos, 0, 0);
+	const UINT32 readPos = (UINT32)InterlockedCompareExchange(&ring->readPos, 0, 0);
+	return writePos - readPos;
+}
+
+/* Called from the capture thread, never blocks */
+static BOOL audin_ring_write(AUDIN_RING* ring, const BYTE* data, size_t size)
+{
+	const UINT32 writePos = (UINT32)ring->writePos;
+	const UINT32 readPos = (UINT32)InterlockedCompareExchange(&ring->readPos, 0, 0);
+	const UINT32 offset = writePos & (ring->capacity - 1);
+	size_t first = ring->capacity - offset;
+
+	if (size > ring->capacity - (writePos - readPos))
+		return FALSE;
+
+	if (first > size)
+		first = size;
+
+	memcpy(&ring->buffer[offset], data, first);
+	memcpy(ring->buffer, &data[first], size - first);
+	InterlockedExchange(&ring->writePos, (LONG)(writePos + (UINT32)size));
+	return TRUE;
+}
+
+/* Called from the encoder thread, size must not exceed audin_ring_used */
+static void audin_ring_read(AUDIN_RING* ring, BYTE* data, size_t size)
+{
+	const UINT32 readPos = (UINT32)ring->readPos;
+	const UINT32 offset = readPos & (ring->capacity - 1);
+	size_t first = ring->capacity - offset;
+
+	if (first > size)
+		first = size;
+
+	memcpy(data, &ring->buffer[offset], first);
+	memcpy(&data[first], ring->buffer, size - first);
+	InterlockedExchange(&ring->readPos, (LONG)(readPos + (UINT32)size));
+}
+
 /**
  * Function description
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT audin_receive_wave_data(const AUDIO_FORMAT* format, const BYTE* data, size_t size,
-                                    void* user_data)
+static UINT audin_send_wave_data(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callback,
+                                 const BYTE* data, size_t size)
 {
 	UINT error;
-	BOOL compatible;
-	AUDIN_PLUGIN* audin;
-	AUDIN_CHANNEL_CALLBACK* callback = (AUDIN_CHANNEL_CALLBACK*)user_data;
-
-	if (!callback)
-		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
-
-	audin = (AUDIN_PLUGIN*)callback->plugin;
-
-	if (!audin)
-		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
-
-	if (!audin->attached)
-		return CHANNEL_RC_OK;
 
 	Stream_SetPosition(audin->data, 0);
 
@@ -363,8 +451,7 @@ static UINT audin_receive_wave_data(const AUDIO_FORMAT* format, const BYTE* data
 
 	Stream_Write_UINT8(audin->data, MSG_SNDIN_DATA);
 
-	compatible = audio_format_compatible(format, audin->format);
-	if (compatible && audin->device->FormatSupported(audin->device, audin->format))
+	if (audin->passthrough)
 	{
 		if (!Stream_EnsureRemainingCapacity(audin->data, size))
 			return CHANNEL_RC_NO_MEMORY;
@@ -373,7 +460,8 @@ static UINT audin_receive_wave_data(const AUDIO_FORMAT* format, const BYTE* data
 	}
 	else
 	{
-		if (!freerdp_dsp_encode(audin->dsp_context, format, data, size, audin->data))
+		if (!freerdp_dsp_encode(audin->dsp_context, &audin->device_format, data, size,
+		                        audin->data))
 			return ERROR_INTERNAL_ERROR;
 	}
 
@@ -394,15 +482,161 @@ static UINT audin_receive_wave_data(const AUDIO_FORMAT* format, const BYTE* data
 	return audin_channel_write_and_free(callback, audin->data, FALSE);
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT audin_receive_wave_data(const AUDIO_FORMAT* format, const BYTE* data, size_t size,
+                                    void* user_data)
+{
+	AUDIN_PLUGIN* audin;
+	AUDIN_CHANNEL_CALLBACK* callback = (AUDIN_CHANNEL_CALLBACK*)user_data;
+
+	WINPR_UNUSED(format);
+
+	if (!callback)
+		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+
+	audin = (AUDIN_PLUGIN*)callback->plugin;
+
+	if (!audin)
+		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+
+	if (!audin->attached)
+		return CHANNEL_RC_OK;
+
+	/* The encoder thread fell behind, drop the capture instead of stalling the device */
+	if (!audin_ring_write(&audin->ring, data, size))
+		InterlockedExchangeAdd(&audin->dropped, (LONG)size);
+
+	SetEvent(audin->data_event);
+	return CHANNEL_RC_OK;
+}
+
+static DWORD WINAPI audin_encoder_thread_func(LPVOID arg)
+{
+	AUDIN_CHANNEL_CALLBACK* callback = (AUDIN_CHANNEL_CALLBACK*)arg;
+	AUDIN_PLUGIN* audin = (AUDIN_PLUGIN*)callback->plugin;
+	HANDLE events[2];
+	UINT error = CHANNEL_RC_OK;
+
+	events[0] = audin->stop_event;
+	events[1] = audin->data_event;
+
+	while (error == CHANNEL_RC_OK)
+	{
+		LONG dropped;
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE);
+
+		if (status == WAIT_OBJECT_0)
+			break;
+
+		if (status != WAIT_OBJECT_0 + 1)
+		{
+			error = GetLastError();
+			WLog_Print(audin->log, WLOG_ERROR,
+			           "WaitForMultipleObjects failed with error %" PRIu32 "!", error);
+			break;
+		}
+
+		/* Reset before looking at the ring, a capture written meanwhile sets it again */
+		ResetEvent(audin->data_event);
+
+		if ((dropped = InterlockedExchange(&audin->dropped, 0)) > 0)
+			WLog_Print(audin->log, WLOG_WARN, "encoder too slow, dropped %" PRId32 " bytes",
+			           dropped);
+
+		/* Coalesce the capture periods up to the packet interval */
+		while ((error == CHANNEL_RC_OK) && (audin_ring_used(&audin->ring) >= audin->packet_bytes))
+		{
+			audin_ring_read(&audin->ring, audin->pcm, audin->packet_bytes);
+			error = audin_send_wave_data(audin, callback, audin->pcm, audin->packet_bytes);
+		}
+	}
+
+	if (error && audin->rdpcontext)
+		setChannelError(audin->rdpcontext, error, "audin_encoder_thread_func reported an error");
+
+	ExitThread(error);
+	return error;
+}
+
+static void audin_stop_encoder(AUDIN_PLUGIN* audin)
+{
+	if (audin->encoder_thread)
+	{
+		SetEvent(audin->stop_event);
+
+		if (WaitForSingleObject(audin->encoder_thread, INFINITE) == WAIT_FAILED)
+			WLog_Print(audin->log, WLOG_ERROR, "WaitForSingleObject failed with error %" PRIu32 "",
+			           GetLastError());
+
+		CloseHandle(audin->encoder_thread);
+		audin->encoder_thread = NULL;
+	}
+
+	if (audin->stop_event)
+		CloseHandle(audin->stop_event);
+
+	if (audin->data_event)
+		CloseHandle(audin->data_event);
+
+	audin->stop_event = NULL;
+	audin->data_event = NULL;
+	audin_ring_free(&audin->ring);
+	free(audin->pcm);
+	audin->pcm = NULL;
+}
+
+static BOOL audin_start_encoder(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callback)
+{
+	const size_t bytesPerSecond =
+	    1ull * audin->device_format.nSamplesPerSec * audin->device_format.nBlockAlign;
+
+	audin_stop_encoder(audin);
+	audin->dropped = 0;
+
+	/* A second of audio, at least a few packets */
+	if (!audin_ring_init(&audin->ring, (bytesPerSecond > 4 * audin->packet_bytes)
+	                                       ? bytesPerSecond
+	                                       : 4 * audin->packet_bytes))
+		goto fail;
+
+	if (!(audin->pcm = malloc(audin->packet_bytes)))
+		goto fail;
+
+	if (!(audin->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(audin->data_event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(audin->encoder_thread =
+	          CreateThread(NULL, 0, audin_encoder_thread_func, callback, 0, NULL)))
+	{
+		WLog_Print(audin->log, WLOG_ERROR, "CreateThread failed!");
+		goto fail;
+	}
+
+	return TRUE;
+fail:
+	audin_stop_encoder(audin);
+	return FALSE;
+}
+
 static BOOL audin_open_device(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callback)
 {
 	UINT error = ERROR_INTERNAL_ERROR;
 	BOOL supported;
 	AUDIO_FORMAT format;
+	UINT32 period;
 
 	if (!audin || !audin->device)
 		return FALSE;
 
+	period = audin->FramesPerPacket;
+
 	format = *audin->format;
 	supported = IFCALLRESULT(FALSE, audin->device->FormatSupported, audin->device, &format);
 	WLog_Print(audin->log, WLOG_DEBUG, "microphone uses %s codec",
@@ -437,7 +671,10 @@ static BOOL audin_open_device(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callb
 			return FALSE;
 	}
 
-	IFCALLRET(audin->device->SetFormat, error, audin->device, &format, audin->FramesPerPacket);
+	if (audin->latency > 0)
+		period = format.nSamplesPerSec * audin->latency / 1000;
+
+	IFCALLRET(audin->device->SetFormat, error, audin->device, &format, period);
 
 	if (error != CHANNEL_RC_OK)
 	{
@@ -445,7 +682,39 @@ static BOOL audin_open_device(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callb
 		return FALSE;
 	}
 
-	if (!freerdp_dsp_context_reset(audin->dsp_context, audin->format, audin->FramesPerPacket))
+	audin->device_format = format;
+	audin->passthrough = audio_format_compatible(&format, audin->format) &&
+	                     IFCALLRESULT(FALSE, audin->device->FormatSupported, audin->device,
+	                                  audin->format);
+
+	if (audin->packet > 0)
+		audin->packet_bytes = 1ull * format.nSamplesPerSec * audin->packet / 1000;
+	else
+		audin->packet_bytes = period;
+
+	audin->packet_bytes *= format.nBlockAlign;
+
+	if (audin->packet_bytes < format.nBlockAlign)
+		audin->packet_bytes = format.nBlockAlign;
+
+	if (audin->packet_bytes == 0)
+		return FALSE;
+
+	if (audin->format->wFormatTag == WAVE_FORMAT_OPUS)
+	{
+		AUDIO_FORMAT opus = *audin->format;
+		const UINT32 frames = (audin->frames > 0) ? audin->frames : audin->FramesPerPacket;
+
+		if (audin->bitrate > 0)
+			opus.nAvgBytesPerSec = audin->bitrate / 8;
+
+		if (!freerdp_dsp_context_reset(audin->dsp_context, &opus, frames))
+			return FALSE;
+	}
+	else if (!freerdp_dsp_context_reset(audin->dsp_context, audin->format, audin->FramesPerPacket))
+		return FALSE;
+
+	if (!audin_start_encoder(audin, callback))
 		return FALSE;
 
 	IFCALLRET(audin->device->Open, error, audin->device, audin_receive_wave_data, callback);
@@ -453,6 +722,7 @@ static BOOL audin_open_device(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callb
 	if (error != CHANNEL_RC_OK)
 	{
 		WLog_ERR(TAG, "Open failed with errorcode %" PRIu32 "", error);
+		audin_stop_encoder(audin);
 		return FALSE;
 	}
 
@@ -539,6 +809,8 @@ static UINT audin_process_format_change(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLB
 		}
 	}
 
+	audin_stop_encoder(audin);
+
 	if (!audin_open_device(audin, callback))
 		return ERROR_INTERNAL_ERROR;
 
@@ -621,6 +893,7 @@ static UINT audin_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 			WLog_Print(audin->log, WLOG_ERROR, "Close failed with errorcode %" PRIu32 "", error);
 	}
 
+	audin_stop_encoder(audin);
 	audin->format = NULL;
 	audio_formats_free(callback->formats, callback->formats_count);
 	free(callback);
@@ -739,6 +1012,7 @@ static UINT audin_plugin_terminated(IWTSPlugin* pPlugin)
 		audin->device = NULL;
 	}
 
+	audin_stop_encoder(audin);
 	freerdp_dsp_context_free(audin->dsp_context);
 	Stream_Free(audin->data, TRUE);
 	free(audin->subsystem);
@@ -877,6 +1151,14 @@ BOOL audin_process_addin_args(AUDIN_PLUGIN* audin, const ADDIN_ARGV* args)
 		{ "format", COMMAND_LINE_VALUE_REQUIRED, "<format>", NULL, NULL, -1, NULL, "format" },
 		{ "rate", COMMAND_LINE_VALUE_REQUIRED, "<rate>", NULL, NULL, -1, NULL, "rate" },
 		{ "channel", COMMAND_LINE_VALUE_REQUIRED, "<channel>", NULL, NULL, -1, NULL, "channel" },
+		{ "bitrate", COMMAND_LINE_VALUE_REQUIRED, "<bitrate>", NULL, NULL, -1, NULL,
+		  "opus bitrate" },
+		{ "frames", COMMAND_LINE_VALUE_REQUIRED, "<frames>", NULL, NULL, -1, NULL,
+		  "opus frame size" },
+		{ "latency", COMMAND_LINE_VALUE_REQUIRED, "<ms>", NULL, NULL, -1, NULL,
+		  "capture period" },
+		{ "packet", COMMAND_LINE_VALUE_REQUIRED, "<ms>", NULL, NULL, -1, NULL,
+		  "packet interval" },
 		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
 	};
 
@@ -942,6 +1224,43 @@ BOOL audin_process_addin_args(AUDIN_PLUGIN* audin, const ADDIN_ARGV* args)
 			if ((errno != 0) || (val < UINT16_MAX))
 				audin->fixed_format->nChannels = val;
 		}
+		CommandLineSwitchCase(arg, "bitrate")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return FALSE;
+
+			audin->bitrate = val;
+		}
+		CommandLineSwitchCase(arg, "frames")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return FALSE;
+
+			audin->frames = val;
+		}
+		CommandLineSwitchCase(arg, "latency")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > 1000))
+				return FALSE;
+
+			audin->latency = val;
+		}
+		CommandLineSwitchCase(arg, "packet")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			/* a packet has to fit into a single opus packet */
+			if ((errno != 0) || (val > 120))
+				return FALSE;
+
+			audin->packet = val;
+		}
 		CommandLineSwitchDefault(arg)
 		{
 		}
@@ -653,7 +653,7 @@ UINT dvcman_close_channel(IWTSVirtualChannelManager* pChannelMgr, UINT32 Channel
  */
 static UINT dvcman_receive_channel_data_first(drdynvcPlugin* drdynvc,
                                               IWTSVirtualChannelManager* pChannelMgr,
-                                              UINT32 ChannelId, UINT32 length)
+                                              UINT32 ChannelId, UINT32 length, size_t dataSize)
 {
 	DVCMAN_CHANNEL* channel;
 	channel = (DVCMAN_CHANNEL*)dvcman_find_channel_by_id(pChannelMgr, ChannelId);
@@ -672,6 +672,12 @@ static UINT dvcman_receive_channel_data_first(drdynvcPlugin* drdynvc,
 	if (channel->dvc_data)
 		Stream_Release(channel->dvc_data);
 
+	channel->dvc_data = NULL;
+
+	/* The whole message is in the first PDU, pass it on without copying */
+	if (dataSize == length)
+		return CHANNEL_RC_OK;
+
 	channel->dvc_data = StreamPool_Take(channel->dvcman->pool, length);
 
 	if (!channel->dvc_data)
@@ -1139,7 +1145,8 @@ static UINT drdynvc_process_data_first(drdynvcPlugin* drdynvc, int Sp, int cbChI
 	WLog_Print(drdynvc->log, WLOG_DEBUG,
 	           "process_data_first: Sp=%d cbChId=%d, ChannelId=%" PRIu32 " Length=%" PRIu32 "", Sp,
 	           cbChId, ChannelId, Length);
-	status = dvcman_receive_channel_data_first(drdynvc, drdynvc->channel_mgr, ChannelId, Length);
+	status = dvcman_receive_channel_data_first(drdynvc, drdynvc->channel_mgr, ChannelId, Length,
+	                                           Stream_GetRemainingLength(s));
 
 	if (status == CHANNEL_RC_OK)
 		status = dvcman_receive_channel_data(drdynvc, drdynvc->channel_mgr, ChannelId, s,
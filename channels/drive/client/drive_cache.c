@@ -0,0 +1,370 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#include "drive_cache.h"
+
+/* the attributes are dropped all at once when there are more */
+#define DRIVE_CACHE_MAX_ATTRIBUTES 4096
+/* expired directories are dropped when more are cached */
+#define DRIVE_CACHE_MAX_DIRECTORIES 16
+
+typedef struct
+{
+	UINT64 generation;
+	UINT64 time;
+	WIN32_FILE_ATTRIBUTE_DATA data;
+} DRIVE_CACHE_ATTRIBUTES;
+
+struct drive_cache
+{
+	UINT64 ttl;
+	CRITICAL_SECTION lock;
+
+	/* guarded by the lock */
+	UINT64 generation;
+	wHashTable* attributes;
+	wHashTable* directories;
+};
+
+static UINT32 drive_cache_hash(const void* key)
+{
+	const WCHAR* str = (const WCHAR*)key;
+	UINT32 hash = 2166136261u;
+
+	while (*str)
+	{
+		hash ^= *str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static BOOL drive_cache_compare(const void* key1, const void* key2)
+{
+	return _wcscmp((const WCHAR*)key1, (const WCHAR*)key2) == 0;
+}
+
+static void* drive_cache_key_clone(const void* key)
+{
+	return _wcsdup((const WCHAR*)key);
+}
+
+static void drive_cache_directory_free(void* obj)
+{
+	drive_cache_release_directory((DRIVE_DIRECTORY*)obj);
+}
+
+static wHashTable* drive_cache_table_new(OBJECT_FREE_FN fnValueFree)
+{
+	wObject* obj;
+	wHashTable* table = HashTable_New(FALSE);
+
+	if (!table)
+		return NULL;
+
+	if (!HashTable_SetHashFunction(table, drive_cache_hash))
+		goto fail;
+
+	obj = HashTable_KeyObject(table);
+	obj->fnObjectEquals = drive_cache_compare;
+	obj->fnObjectNew = drive_cache_key_clone;
+	obj->fnObjectFree = free;
+
+	obj = HashTable_ValueObject(table);
+	obj->fnObjectFree = fnValueFree;
+	return table;
+
+fail:
+	HashTable_Free(table);
+	return NULL;
+}
+
+DRIVE_CACHE* drive_cache_new(UINT64 ttl)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)calloc(1, sizeof(DRIVE_CACHE));
+
+	if (!cache)
+		return NULL;
+
+	cache->ttl = ttl;
+
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		free(cache);
+		return NULL;
+	}
+
+	cache->attributes = drive_cache_table_new(free);
+	cache->directories = drive_cache_table_new(drive_cache_directory_free);
+
+	if (!cache->attributes || !cache->directories)
+	{
+		drive_cache_free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+	HashTable_Free(cache->attributes);
+	HashTable_Free(cache->directories);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+void drive_cache_invalidate(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	cache->generation++;
+	LeaveCriticalSection(&cache->lock);
+}
+
+UINT64 drive_cache_generation(DRIVE_CACHE* cache)
+{
+	UINT64 generation;
+
+	if (!cache)
+		return 0;
+
+	EnterCriticalSection(&cache->lock);
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+	return generation;
+}
+
+/* Must be called with the lock held */
+static BOOL drive_cache_is_valid(DRIVE_CACHE* cache, UINT64 generation, UINT64 time, UINT64 now)
+{
+	return (generation == cache->generation) && (now - time < cache->ttl);
+}
+
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                WIN32_FILE_ATTRIBUTE_DATA* data)
+{
+	UINT64 generation;
+	UINT64 now;
+	DRIVE_CACHE_ATTRIBUTES* entry;
+
+	WINPR_ASSERT(path);
+	WINPR_ASSERT(data);
+
+	if (!cache || (cache->ttl == 0))
+		return GetFileAttributesExW(path, GetFileExInfoStandard, data);
+
+	now = GetTickCount64();
+	EnterCriticalSection(&cache->lock);
+	entry = (DRIVE_CACHE_ATTRIBUTES*)HashTable_GetItemValue(cache->attributes, path);
+
+	if (entry && drive_cache_is_valid(cache, entry->generation, entry->time, now))
+	{
+		*data = entry->data;
+		LeaveCriticalSection(&cache->lock);
+		return TRUE;
+	}
+
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+
+	if (!GetFileAttributesExW(path, GetFileExInfoStandard, data))
+		return FALSE;
+
+	EnterCriticalSection(&cache->lock);
+
+	/* the file might have changed while reading the attributes */
+	if (generation == cache->generation)
+	{
+		entry = (DRIVE_CACHE_ATTRIBUTES*)HashTable_GetItemValue(cache->attributes, path);
+
+		if (!entry)
+		{
+			if (HashTable_Count(cache->attributes) >= DRIVE_CACHE_MAX_ATTRIBUTES)
+				HashTable_Clear(cache->attributes);
+
+			entry = (DRIVE_CACHE_ATTRIBUTES*)calloc(1, sizeof(DRIVE_CACHE_ATTRIBUTES));
+
+			if (entry && !HashTable_Insert(cache->attributes, path, entry))
+			{
+				free(entry);
+				entry = NULL;
+			}
+		}
+
+		if (entry)
+		{
+			entry->generation = generation;
+			entry->time = now;
+			entry->data = *data;
+		}
+	}
+
+	LeaveCriticalSection(&cache->lock);
+	return TRUE;
+}
+
+static DRIVE_DIRECTORY* drive_cache_read_directory(const WCHAR* pattern)
+{
+	HANDLE handle;
+	size_t capacity = 0;
+	DRIVE_DIRECTORY* directory;
+	WIN32_FIND_DATAW data;
+
+	handle = FindFirstFileW(pattern, &data);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	directory = (DRIVE_DIRECTORY*)calloc(1, sizeof(DRIVE_DIRECTORY));
+
+	if (!directory)
+		goto fail;
+
+	directory->refCount = 1;
+
+	do
+	{
+		if (directory->count == capacity)
+		{
+			WIN32_FIND_DATAW* entries;
+
+			capacity = (capacity > 0) ? capacity * 2 : 64;
+			entries = (WIN32_FIND_DATAW*)realloc(directory->entries,
+			                                     capacity * sizeof(WIN32_FIND_DATAW));
+
+			if (!entries)
+				goto fail;
+
+			directory->entries = entries;
+		}
+
+		directory->entries[directory->count++] = data;
+	} while (FindNextFileW(handle, &data));
+
+	FindClose(handle);
+	return directory;
+
+fail:
+	FindClose(handle);
+	drive_cache_release_directory(directory);
+	SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+	return NULL;
+}
+
+/* Must be called with the lock held */
+static void drive_cache_drop_expired_directories(DRIVE_CACHE* cache, UINT64 now)
+{
+	size_t x, count;
+	ULONG_PTR* keys = NULL;
+
+	count = HashTable_GetKeys(cache->directories, &keys);
+
+	for (x = 0; x < count; x++)
+	{
+		const void* key = (const void*)keys[x];
+		const DRIVE_DIRECTORY* cur =
+		    (const DRIVE_DIRECTORY*)HashTable_GetItemValue(cache->directories, key);
+
+		if (cur && !drive_cache_is_valid(cache, cur->generation, cur->time, now))
+			HashTable_Remove(cache->directories, key);
+	}
+
+	free(keys);
+
+	if (HashTable_Count(cache->directories) >= DRIVE_CACHE_MAX_DIRECTORIES)
+		HashTable_Clear(cache->directories);
+}
+
+DRIVE_DIRECTORY* drive_cache_get_directory(DRIVE_CACHE* cache, const WCHAR* pattern)
+{
+	UINT64 generation;
+	UINT64 now;
+	DRIVE_DIRECTORY* directory;
+
+	WINPR_ASSERT(pattern);
+
+	if (!cache || (cache->ttl == 0))
+		return drive_cache_read_directory(pattern);
+
+	now = GetTickCount64();
+	EnterCriticalSection(&cache->lock);
+	directory = (DRIVE_DIRECTORY*)HashTable_GetItemValue(cache->directories, pattern);
+
+	if (directory && drive_cache_is_valid(cache, directory->generation, directory->time, now))
+	{
+		InterlockedIncrement(&directory->refCount);
+		LeaveCriticalSection(&cache->lock);
+		return directory;
+	}
+
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+
+	directory = drive_cache_read_directory(pattern);
+
+	if (!directory)
+		return NULL;
+
+	directory->generation = generation;
+	directory->time = now;
+	EnterCriticalSection(&cache->lock);
+
+	/* the directory might have changed while reading it */
+	if (generation == cache->generation)
+	{
+		HashTable_Remove(cache->directories, pattern);
+
+		if (HashTable_Count(cache->directories) >= DRIVE_CACHE_MAX_DIRECTORIES)
+			drive_cache_drop_expired_directories(cache, now);
+
+		InterlockedIncrement(&directory->refCount);
+
+		if (!HashTable_Insert(cache->directories, pattern, directory))
+			InterlockedDecrement(&directory->refCount);
+	}
+
+	LeaveCriticalSection(&cache->lock);
+	return directory;
+}
+
+void drive_cache_release_directory(DRIVE_DIRECTORY* directory)
+{
+	if (!directory)
+		return;
+
+	if (InterlockedDecrement(&directory->refCount) > 0)
+		return;
+
+	free(directory->entries);
+	free(directory);
+}
@@ -0,0 +1,64 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/file.h>
+
+/**
+ * Caches the attributes of files and the entries of directories for a short time, the server
+ * repeats the same queries while browsing. Every change done through the drive invalidates
+ * the whole cache, changes done by others are visible once the entries expired.
+ */
+typedef struct drive_cache DRIVE_CACHE;
+
+/* The entries of a directory, shared by all files enumerating it */
+typedef struct
+{
+	volatile LONG refCount;
+	UINT64 generation;
+	UINT64 time;
+	size_t count;
+	WIN32_FIND_DATAW* entries;
+} DRIVE_DIRECTORY;
+
+DRIVE_CACHE* drive_cache_new(UINT64 ttl);
+void drive_cache_free(DRIVE_CACHE* cache);
+
+void drive_cache_invalidate(DRIVE_CACHE* cache);
+
+/* @return a number changing with every invalidation */
+UINT64 drive_cache_generation(DRIVE_CACHE* cache);
+
+/**
+ * @brief drive_cache_get_attributes Like GetFileAttributesExW
+ * @return FALSE on failure, GetLastError() tells why
+ */
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                WIN32_FILE_ATTRIBUTE_DATA* data);
+
+/**
+ * @brief drive_cache_get_directory Returns the entries matching the search pattern
+ * @return a reference released with drive_cache_release_directory or NULL on failure,
+ * GetLastError() tells why
+ */
+DRIVE_DIRECTORY* drive_cache_get_directory(DRIVE_CACHE* cache, const WCHAR* pattern);
+void drive_cache_release_directory(DRIVE_DIRECTORY* directory);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H */
@@ -43,6 +43,9 @@
 
 #include "drive_file.h"
 
+/* data read after a sequential read, the next reads are answered from memory */
+#define DRIVE_FILE_READ_AHEAD_SIZE (256 * 1024)
+
 #ifdef WITH_DEBUG_RDPDR
 #define DEBUG_WSTR(msg, wstr)                                            \
 	do                                                                   \
@@ -331,9 +334,10 @@ static BOOL drive_file_init(DRIVE_FILE* file)
 	return file->file_handle != INVALID_HANDLE_VALUE;
 }
 
-DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathLength, UINT32 id,
-                           UINT32 DesiredAccess, UINT32 CreateDisposition, UINT32 CreateOptions,
-                           UINT32 FileAttributes, UINT32 SharedAccess)
+DRIVE_FILE* drive_file_new(DRIVE_CACHE* cache, const WCHAR* base_path, const WCHAR* path,
+                           UINT32 PathLength, UINT32 id, UINT32 DesiredAccess,
+                           UINT32 CreateDisposition, UINT32 CreateOptions, UINT32 FileAttributes,
+                           UINT32 SharedAccess)
 {
 	DRIVE_FILE* file;
 
@@ -349,7 +353,7 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 	}
 
 	file->file_handle = INVALID_HANDLE_VALUE;
-	file->find_handle = INVALID_HANDLE_VALUE;
+	file->cache = cache;
 	file->id = id;
 	file->basepath = base_path;
 	file->FileAttributes = FileAttributes;
@@ -362,11 +366,19 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 	if (!drive_file_init(file))
 	{
 		DWORD lastError = GetLastError();
+
+		if (CreateDisposition != FILE_OPEN)
+			drive_cache_invalidate(cache);
+
 		drive_file_free(file);
 		SetLastError(lastError);
 		return NULL;
 	}
 
+	/* anything but opening an existing file may have created or truncated it */
+	if (CreateDisposition != FILE_OPEN)
+		drive_cache_invalidate(cache);
+
 	return file;
 }
 
@@ -383,11 +395,8 @@ BOOL drive_file_free(DRIVE_FILE* file)
 		file->file_handle = INVALID_HANDLE_VALUE;
 	}
 
-	if (file->find_handle != INVALID_HANDLE_VALUE)
-	{
-		FindClose(file->find_handle);
-		file->find_handle = INVALID_HANDLE_VALUE;
-	}
+	drive_cache_release_directory(file->find_directory);
+	file->find_directory = NULL;
 
 	if (file->delete_pending)
 	{
@@ -402,7 +411,16 @@ BOOL drive_file_free(DRIVE_FILE* file)
 
 	rc = TRUE;
 fail:
+	/* a failed removal may still have deleted part of a directory tree */
+	if (file->delete_pending)
+		drive_cache_invalidate(file->cache);
+
 	DEBUG_WSTR("Free %s", file->fullpath);
+
+	if (file->file_handle != INVALID_HANDLE_VALUE)
+		CloseHandle(file->file_handle);
+
+	free(file->read_ahead);
 	free(file->fullpath);
 	free(file);
 	return rc;
@@ -410,57 +428,158 @@ fail:
 
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
 {
-	LARGE_INTEGER loffset;
-
 	if (!file)
 		return FALSE;
 
 	if (Offset > INT64_MAX)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
 		return FALSE;
+	}
 
-	loffset.QuadPart = (LONGLONG)Offset;
-	return SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN);
+	file->offset = Offset;
+	file->read_sequential = FALSE;
+	return TRUE;
 }
 
-BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
+static BOOL drive_file_read_at(DRIVE_FILE* file, UINT64 offset, BYTE* buffer, UINT32* Length)
 {
 	DWORD read;
+	LARGE_INTEGER loffset;
+
+	loffset.QuadPart = (LONGLONG)offset;
+
+	if (!SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN))
+		return FALSE;
+
+	if (!ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+		return FALSE;
+
+	*Length = read;
+	return TRUE;
+}
+
+static BOOL drive_file_write_at(DRIVE_FILE* file, UINT64 offset, const BYTE* buffer,
+                                size_t Length)
+{
+	DWORD written;
+	LARGE_INTEGER loffset;
+
+	loffset.QuadPart = (LONGLONG)offset;
+
+	if (!SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN))
+		return FALSE;
+
+	while (Length > 0)
+	{
+		const DWORD chunk = (DWORD)MIN(Length, UINT32_MAX);
+
+		if (!WriteFile(file->file_handle, buffer, chunk, &written, NULL))
+			return FALSE;
+
+		Length -= written;
+		buffer += written;
+	}
+
+	return TRUE;
+}
+
+BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
+{
+	UINT32 length = 0;
+	UINT64 offset;
 
 	if (!file || !buffer || !Length)
 		return FALSE;
 
 	DEBUG_WSTR("Read file %s", file->fullpath);
+	offset = file->offset;
+
+	if (file->read_ahead_generation != drive_cache_generation(file->cache))
+		file->read_ahead_length = 0;
 
-	if (ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+	/* the start is in the data read ahead, the rest is read from the file */
+	if ((offset >= file->read_ahead_offset) &&
+	    (offset - file->read_ahead_offset < file->read_ahead_length))
 	{
-		*Length = read;
-		return TRUE;
+		const size_t pos = (size_t)(offset - file->read_ahead_offset);
+
+		length = (UINT32)MIN(*Length, file->read_ahead_length - pos);
+		memcpy(buffer, &file->read_ahead[pos], length);
 	}
 
-	return FALSE;
+	if (length < *Length)
+	{
+		UINT32 rest = *Length - length;
+
+		if (!drive_file_read_at(file, offset + length, &buffer[length], &rest))
+			return FALSE;
+
+		length += rest;
+	}
+
+	file->read_sequential = (offset == file->read_end);
+	file->read_end = offset + length;
+	file->read_last = length;
+	file->offset = file->read_end;
+	*Length = length;
+	return TRUE;
 }
 
-BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length)
+BOOL drive_file_read_ahead(DRIVE_FILE* file)
 {
-	DWORD written;
+	UINT64 generation;
+	UINT32 length = DRIVE_FILE_READ_AHEAD_SIZE;
 
-	if (!file || !buffer)
+	if (!file)
 		return FALSE;
 
-	DEBUG_WSTR("Write file %s", file->fullpath);
+	generation = drive_cache_generation(file->cache);
 
-	while (Length > 0)
+	/* only worth it for files read in sequence, not at the end of the file */
+	if (!file->read_sequential || (file->read_last == 0))
+		return TRUE;
+
+	/* the next read of the same size is still answered from memory */
+	if ((file->read_ahead_generation == generation) &&
+	    (file->read_end >= file->read_ahead_offset) &&
+	    (file->read_end + file->read_last <= file->read_ahead_offset + file->read_ahead_length))
+		return TRUE;
+
+	if (!file->read_ahead)
 	{
-		if (!WriteFile(file->file_handle, buffer, Length, &written, NULL))
-			return FALSE;
+		file->read_ahead = (BYTE*)malloc(DRIVE_FILE_READ_AHEAD_SIZE);
 
-		Length -= written;
-		buffer += written;
+		if (!file->read_ahead)
+			return FALSE;
 	}
 
+	file->read_ahead_length = 0;
+
+	if (!drive_file_read_at(file, file->read_end, file->read_ahead, &length))
+		return FALSE;
+
+	file->read_ahead_offset = file->read_end;
+	file->read_ahead_length = length;
+	file->read_ahead_generation = generation;
 	return TRUE;
 }
 
+BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length)
+{
+	BOOL rc;
+	const UINT64 offset = file ? file->offset : 0;
+
+	if (!file || !buffer)
+		return FALSE;
+
+	DEBUG_WSTR("Write file %s", file->fullpath);
+	file->offset = offset + Length;
+	rc = drive_file_write_at(file, offset, buffer, Length);
+	drive_cache_invalidate(file->cache);
+	return rc;
+}
+
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
 {
 	WIN32_FILE_ATTRIBUTE_DATA fileAttributes;
@@ -469,7 +588,7 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 	if (!file || !output)
 		return FALSE;
 
-	if (!GetFileAttributesExW(file->fullpath, GetFileExInfoStandard, &fileAttributes))
+	if (!drive_cache_get_attributes(file->cache, file->fullpath, &fileAttributes))
 		goto out_fail;
 
 	switch (FsInformationClass)
@@ -542,8 +661,8 @@ out_fail:
 	return FALSE;
 }
 
-BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
-                                wStream* input)
+static BOOL drive_file_set_information_int(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                           UINT32 Length, wStream* input)
 {
 	INT64 size;
 	WCHAR* fullpath;
@@ -564,9 +683,6 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	UINT8 ReplaceIfExists;
 	DWORD attr;
 
-	if (!file || !input)
-		return FALSE;
-
 	switch (FsInformationClass)
 	{
 		case FileBasicInformation:
@@ -756,6 +872,21 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	return TRUE;
 }
 
+BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
+                                wStream* input)
+{
+	BOOL rc;
+
+	if (!file || !input)
+		return FALSE;
+
+	rc = drive_file_set_information_int(file, FsInformationClass, Length, input);
+
+	/* also on failure, the change may have been applied in part */
+	drive_cache_invalidate(file->cache);
+	return rc;
+}
+
 BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYTE InitialQuery,
                                 const WCHAR* path, UINT32 PathLength, wStream* output)
 {
@@ -767,20 +898,26 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 
 	if (InitialQuery != 0)
 	{
-		/* release search handle */
-		if (file->find_handle != INVALID_HANDLE_VALUE)
-			FindClose(file->find_handle);
+		/* release the entries of the previous search */
+		drive_cache_release_directory(file->find_directory);
+		file->find_index = 0;
 
 		ent_path = drive_file_combine_fullpath(file->basepath, path, PathLength);
-		/* open new search handle and retrieve the first entry */
-		file->find_handle = FindFirstFileW(ent_path, &file->find_data);
+		/* take the entries matching the pattern from the cache, the first one is returned */
+		file->find_directory = ent_path ? drive_cache_get_directory(file->cache, ent_path) : NULL;
 		free(ent_path);
 
-		if (file->find_handle == INVALID_HANDLE_VALUE)
+		if (!file->find_directory)
 			goto out_fail;
 	}
-	else if (!FindNextFileW(file->find_handle, &file->find_data))
+
+	if (!file->find_directory || (file->find_index >= file->find_directory->count))
+	{
+		SetLastError(ERROR_NO_MORE_FILES);
 		goto out_fail;
+	}
+
+	file->find_data = file->find_directory->entries[file->find_index++];
 
 	length = _wcslen(file->find_data.cFileName) * 2;
 
@@ -29,6 +29,8 @@
 #include <winpr/stream.h>
 #include <freerdp/channels/log.h>
 
+#include "drive_cache.h"
+
 #define TAG CHANNELS_TAG("drive.client")
 
 typedef struct
@@ -36,8 +38,10 @@ typedef struct
 	UINT32 id;
 	BOOL is_dir;
 	HANDLE file_handle;
-	HANDLE find_handle;
+	DRIVE_DIRECTORY* find_directory;
+	size_t find_index;
 	WIN32_FIND_DATAW find_data;
+	DRIVE_CACHE* cache;
 	const WCHAR* basepath;
 	WCHAR* fullpath;
 	WCHAR* filename;
@@ -47,16 +51,30 @@ typedef struct
 	UINT32 DesiredAccess;
 	UINT32 CreateDisposition;
 	UINT32 CreateOptions;
+
+	/* position set by drive_file_seek, the handle is positioned when reading or writing */
+	UINT64 offset;
+
+	/* data following a sequential read, valid as long as the cache generation is unchanged */
+	BYTE* read_ahead;
+	UINT64 read_ahead_offset;
+	size_t read_ahead_length;
+	UINT64 read_ahead_generation;
+	UINT64 read_end;
+	UINT32 read_last;
+	BOOL read_sequential;
 } DRIVE_FILE;
 
-DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathLength, UINT32 id,
-                           UINT32 DesiredAccess, UINT32 CreateDisposition, UINT32 CreateOptions,
-                           UINT32 FileAttributes, UINT32 SharedAccess);
+DRIVE_FILE* drive_file_new(DRIVE_CACHE* cache, const WCHAR* base_path, const WCHAR* path,
+                           UINT32 PathLength, UINT32 id, UINT32 DesiredAccess,
+                           UINT32 CreateDisposition, UINT32 CreateOptions, UINT32 FileAttributes,
+                           UINT32 SharedAccess);
 BOOL drive_file_free(DRIVE_FILE* file);
 
 BOOL drive_file_open(DRIVE_FILE* file);
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset);
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length);
+BOOL drive_file_read_ahead(DRIVE_FILE* file);
 BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length);
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output);
 BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
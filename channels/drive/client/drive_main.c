@@ -45,7 +45,24 @@
 
 #include "drive_file.h"
 
+/* IRPs of different files are processed concurrently by this many threads */
+#define DRIVE_WORKER_THREADS 4
+/* attributes and directory entries are answered from memory for this long (ms) */
+#define DRIVE_CACHE_TTL 1000
+
+typedef struct s_DRIVE_DEVICE DRIVE_DEVICE;
+
 typedef struct
+{
+	DRIVE_DEVICE* drive;
+	HANDLE thread;
+
+	/* guarded by the lock of the drive */
+	BOOL busy;
+	UINT32 FileId;
+} DRIVE_WORKER;
+
+struct s_DRIVE_DEVICE
 {
 	DEVICE device;
 
@@ -53,14 +70,21 @@ typedef struct
 	BOOL automount;
 	UINT32 PathLength;
 	wListDictionary* files;
+	DRIVE_CACHE* cache;
 
-	HANDLE thread;
-	wMessageQueue* IrpQueue;
+	DRIVE_WORKER workers[DRIVE_WORKER_THREADS];
+	CRITICAL_SECTION lock;
+	BOOL lockInitialized;
+	HANDLE event;
+
+	/* guarded by the lock */
+	wArrayList* pending;
+	BOOL stopping;
 
 	DEVMAN* devman;
 
 	rdpContext* rdpcontext;
-} DRIVE_DEVICE;
+};
 
 static UINT sys_code_page = 0;
 
@@ -180,9 +204,10 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 		return ERROR_INVALID_DATA;
 
 	path = (const WCHAR*)Stream_Pointer(irp->input);
-	FileId = irp->devman->id_sequence++;
-	file = drive_file_new(drive->path, path, PathLength, FileId, DesiredAccess, CreateDisposition,
-	                      CreateOptions, FileAttributes, SharedAccess);
+	/* creates run concurrently */
+	FileId = (UINT32)InterlockedIncrement((LONG*)&irp->devman->id_sequence) - 1;
+	file = drive_file_new(drive->cache, drive->path, path, PathLength, FileId, DesiredAccess,
+	                      CreateDisposition, CreateOptions, FileAttributes, SharedAccess);
 
 	if (!file)
 	{
@@ -267,6 +292,7 @@ static UINT drive_process_irp_close(DRIVE_DEVICE* drive, IRP* irp)
  */
 static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 {
+	UINT error;
 	DRIVE_FILE* file;
 	UINT32 Length;
 	UINT64 Offset;
@@ -315,7 +341,13 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 		}
 	}
 
-	return irp->Complete(irp);
+	error = irp->Complete(irp);
+
+	/* while the server handles the response, no other IRP of the file is processed */
+	if (file && !drive_file_read_ahead(file))
+		WLog_WARN(TAG, "drive_file_read_ahead failed with error %" PRIu32 "", GetLastError());
+
+	return error;
 }
 
 /**
@@ -748,53 +780,107 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 	return error;
 }
 
+/* Only creates do not refer to an open file */
+static BOOL drive_irp_is_ordered(const IRP* irp)
+{
+	return irp->MajorFunction != IRP_MJ_CREATE;
+}
+
+/**
+ * Takes the first pending IRP no other worker processes an IRP of the same file for, so the IRPs
+ * of a file are processed in the order they arrived. Must be called with the lock held.
+ */
+static IRP* drive_take_irp(DRIVE_DEVICE* drive, DRIVE_WORKER* worker)
+{
+	size_t x, y;
+	const size_t count = ArrayList_Count(drive->pending);
+
+	for (x = 0; x < count; x++)
+	{
+		BOOL busy = FALSE;
+		IRP* irp = (IRP*)ArrayList_GetItem(drive->pending, x);
+
+		if (drive_irp_is_ordered(irp))
+		{
+			for (y = 0; y < DRIVE_WORKER_THREADS; y++)
+			{
+				const DRIVE_WORKER* cur = &drive->workers[y];
+
+				if (cur->busy && (cur->FileId == irp->FileId))
+					busy = TRUE;
+			}
+		}
+
+		if (busy)
+			continue;
+
+		ArrayList_RemoveAt(drive->pending, x);
+		worker->busy = drive_irp_is_ordered(irp);
+		worker->FileId = irp->FileId;
+		return irp;
+	}
+
+	return NULL;
+}
+
 static DWORD WINAPI drive_thread_func(LPVOID arg)
 {
 	IRP* irp;
-	wMessage message;
-	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
+	DRIVE_WORKER* worker = (DRIVE_WORKER*)arg;
+	DRIVE_DEVICE* drive;
 	UINT error = CHANNEL_RC_OK;
 
-	if (!drive)
-	{
-		error = ERROR_INVALID_PARAMETER;
-		goto fail;
-	}
+	WINPR_ASSERT(worker);
+	drive = worker->drive;
+	WINPR_ASSERT(drive);
 
 	while (1)
 	{
-		if (!MessageQueue_Wait(drive->IrpQueue))
-		{
-			WLog_ERR(TAG, "MessageQueue_Wait failed!");
-			error = ERROR_INTERNAL_ERROR;
-			break;
-		}
+		BOOL stopping;
 
-		if (!MessageQueue_Peek(drive->IrpQueue, &message, TRUE))
-		{
-			WLog_ERR(TAG, "MessageQueue_Peek failed!");
-			error = ERROR_INTERNAL_ERROR;
-			break;
-		}
+		EnterCriticalSection(&drive->lock);
+		irp = NULL;
+		stopping = drive->stopping;
 
-		if (message.id == WMQ_QUIT)
-			break;
+		if (!stopping)
+			irp = drive_take_irp(drive, worker);
 
-		irp = (IRP*)message.wParam;
+		/* woken up again by a new IRP or a worker done with a file */
+		if (!irp && !stopping)
+			ResetEvent(drive->event);
 
-		if (irp)
+		LeaveCriticalSection(&drive->lock);
+
+		if (!irp)
 		{
-			if ((error = drive_process_irp(drive, irp)))
+			if (stopping)
+				break;
+
+			if (WaitForSingleObject(drive->event, INFINITE) != WAIT_OBJECT_0)
 			{
-				WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
+				WLog_ERR(TAG, "WaitForSingleObject failed!");
+				error = ERROR_INTERNAL_ERROR;
 				break;
 			}
+
+			continue;
 		}
-	}
 
-fail:
+		error = drive_process_irp(drive, irp);
 
-	if (error && drive && drive->rdpcontext)
+		EnterCriticalSection(&drive->lock);
+		worker->busy = FALSE;
+		SetEvent(drive->event);
+		LeaveCriticalSection(&drive->lock);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
+			break;
+		}
+	}
+
+	if (error && drive->rdpcontext)
 		setChannelError(drive->rdpcontext, error, "drive_thread_func reported an error");
 
 	ExitThread(error);
@@ -808,14 +894,23 @@ fail:
  */
 static UINT drive_irp_request(DEVICE* device, IRP* irp)
 {
+	BOOL rc;
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 
-	if (!drive)
+	if (!drive || !irp)
 		return ERROR_INVALID_PARAMETER;
 
-	if (!MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL))
+	EnterCriticalSection(&drive->lock);
+	rc = ArrayList_Append(drive->pending, irp);
+
+	if (rc)
+		SetEvent(drive->event);
+
+	LeaveCriticalSection(&drive->lock);
+
+	if (!rc)
 	{
-		WLog_ERR(TAG, "MessageQueue_Post failed!");
+		WLog_ERR(TAG, "ArrayList_Append failed!");
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -824,14 +919,38 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 
 static UINT drive_free_int(DRIVE_DEVICE* drive)
 {
+	size_t x;
 	UINT error = CHANNEL_RC_OK;
 
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	CloseHandle(drive->thread);
+	for (x = 0; x < DRIVE_WORKER_THREADS; x++)
+	{
+		if (drive->workers[x].thread)
+			CloseHandle(drive->workers[x].thread);
+	}
+
+	/* IRPs no worker took before stopping */
+	if (drive->pending)
+	{
+		for (x = 0; x < ArrayList_Count(drive->pending); x++)
+		{
+			IRP* irp = (IRP*)ArrayList_GetItem(drive->pending, x);
+			irp->Discard(irp);
+		}
+	}
+
 	ListDictionary_Free(drive->files);
-	MessageQueue_Free(drive->IrpQueue);
+	drive_cache_free(drive->cache);
+	ArrayList_Free(drive->pending);
+
+	if (drive->event)
+		CloseHandle(drive->event);
+
+	if (drive->lockInitialized)
+		DeleteCriticalSection(&drive->lock);
+
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -845,18 +964,28 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
  */
 static UINT drive_free(DEVICE* device)
 {
+	size_t x;
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 	UINT error = CHANNEL_RC_OK;
 
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	if (MessageQueue_PostQuit(drive->IrpQueue, 0) &&
-	    (WaitForSingleObject(drive->thread, INFINITE) == WAIT_FAILED))
+	EnterCriticalSection(&drive->lock);
+	drive->stopping = TRUE;
+	SetEvent(drive->event);
+	LeaveCriticalSection(&drive->lock);
+
+	for (x = 0; x < DRIVE_WORKER_THREADS; x++)
 	{
-		error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
-		return error;
+		HANDLE thread = drive->workers[x].thread;
+
+		if (thread && (WaitForSingleObject(thread, INFINITE) == WAIT_FAILED))
+		{
+			error = GetLastError();
+			WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+			return error;
+		}
 	}
 
 	return drive_free_int(drive);
@@ -961,29 +1090,61 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		}
 
 		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
-		drive->IrpQueue = MessageQueue_New(NULL);
+		drive->cache = drive_cache_new(DRIVE_CACHE_TTL);
 
-		if (!drive->IrpQueue)
+		if (!drive->cache)
 		{
-			WLog_ERR(TAG, "ListDictionary_New failed!");
+			WLog_ERR(TAG, "drive_cache_new failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		drive->pending = ArrayList_New(FALSE);
+
+		if (!drive->pending)
+		{
+			WLog_ERR(TAG, "ArrayList_New failed!");
 			error = CHANNEL_RC_NO_MEMORY;
 			goto out_error;
 		}
 
+		if (!InitializeCriticalSectionAndSpinCount(&drive->lock, 4000))
+		{
+			WLog_ERR(TAG, "InitializeCriticalSectionAndSpinCount failed!");
+			goto out_error;
+		}
+
+		drive->lockInitialized = TRUE;
+		drive->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (!drive->event)
+		{
+			WLog_ERR(TAG, "CreateEvent failed!");
+			goto out_error;
+		}
+
 		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)drive)))
 		{
 			WLog_ERR(TAG, "RegisterDevice failed with error %" PRIu32 "!", error);
 			goto out_error;
 		}
 
-		if (!(drive->thread =
-		          CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL)))
+		for (i = 0; i < DRIVE_WORKER_THREADS; i++)
 		{
-			WLog_ERR(TAG, "CreateThread failed!");
-			goto out_error;
+			DRIVE_WORKER* worker = &drive->workers[i];
+
+			worker->drive = drive;
+
+			if (!(worker->thread =
+			          CreateThread(NULL, 0, drive_thread_func, worker, CREATE_SUSPENDED, NULL)))
+			{
+				WLog_ERR(TAG, "CreateThread failed!");
+				goto out_error;
+			}
 		}
 
-		ResumeThread(drive->thread);
+		for (i = 0; i < DRIVE_WORKER_THREADS; i++)
+			ResumeThread(drive->workers[i].thread);
 	}
 
 	return CHANNEL_RC_OK;
@@ -26,6 +26,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/stream.h>
+#include <winpr/sysinfo.h>
 
 #include "echo_main.h"
 #include <freerdp/channels/log.h>
@@ -48,6 +49,10 @@ typedef struct
 	IWTSPlugin* plugin;
 	IWTSVirtualChannelManager* channel_mgr;
 	IWTSVirtualChannel* channel;
+
+	/* latency probes answered and the time spent queueing their answers */
+	UINT32 probes;
+	UINT64 probeWriteTime;
 } ECHO_CHANNEL_CALLBACK;
 
 typedef struct
@@ -70,8 +75,28 @@ static UINT echo_on_data_received(IWTSVirtualChannelCallback* pChannelCallback,
 	BYTE* pBuffer = Stream_Pointer(data);
 	UINT32 cbSize = Stream_GetRemainingLength(data);
 
+	UINT error;
+	UINT32 magic = 0;
+	UINT64 start;
+
+	if (cbSize == ECHO_PROBE_LENGTH)
+		Stream_Peek_UINT32(data, magic);
+
 	/* echo back what we have received. ECHO does not have any message IDs. */
-	return callback->channel->Write(callback->channel, cbSize, pBuffer, NULL);
+	if (magic != ECHO_PROBE_MAGIC)
+		return callback->channel->Write(callback->channel, cbSize, pBuffer, NULL);
+
+	/* A server latency probe, track how much of the round trip is spent client side */
+	start = GetTickCount64();
+	error = callback->channel->Write(callback->channel, cbSize, pBuffer, NULL);
+	callback->probeWriteTime += GetTickCount64() - start;
+	callback->probes++;
+
+	if ((callback->probes % 64) == 0)
+		WLog_DBG(TAG, "answered %" PRIu32 " latency probes, %" PRIu64 " ms spent writing",
+		         callback->probes, callback->probeWriteTime);
+
+	return error;
 }
 
 /**
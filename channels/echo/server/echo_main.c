@@ -50,6 +50,9 @@ typedef struct
 
 	DWORD SessionId;
 
+	UINT32 probeSequence;
+	UINT32 probeExpected;
+	ECHO_SERVER_LATENCY_STATS stats;
 } echo_server;
 
 /**
@@ -104,6 +107,87 @@ static UINT echo_server_open_channel(echo_server* echo)
 	return echo->echo_channel ? CHANNEL_RC_OK : ERROR_INTERNAL_ERROR;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT echo_server_send_probe(echo_server* echo)
+{
+	BYTE buffer[ECHO_PROBE_LENGTH];
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+
+	Stream_Write_UINT32(s, ECHO_PROBE_MAGIC);
+	Stream_Write_UINT32(s, echo->probeSequence++);
+	Stream_Write_UINT64(s, GetTickCount64());
+
+	if (!WTSVirtualChannelWrite(echo->echo_channel, (PCHAR)buffer, sizeof(buffer), NULL))
+	{
+		WLog_ERR(TAG, "WTSVirtualChannelWrite failed!");
+		return ERROR_INTERNAL_ERROR;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Account for the answer to a latency probe.
+ *
+ * @return TRUE if the PDU was a probe answer, FALSE if it belongs to the server
+ */
+static BOOL echo_server_handle_probe(echo_server* echo, wStream* s)
+{
+	UINT32 magic;
+	UINT32 sequence;
+	UINT64 sent;
+	UINT64 rtt;
+	size_t bucket = 0;
+	ECHO_SERVER_LATENCY_STATS* stats = &echo->stats;
+
+	if ((echo->context.ProbeInterval == 0) || (Stream_Length(s) != ECHO_PROBE_LENGTH))
+		return FALSE;
+
+	Stream_Read_UINT32(s, magic);
+
+	if (magic != ECHO_PROBE_MAGIC)
+		return FALSE;
+
+	Stream_Read_UINT32(s, sequence);
+	Stream_Read_UINT64(s, sent);
+	rtt = GetTickCount64() - sent;
+
+	/* DVC data is delivered in order, anything skipped was dropped */
+	if (sequence >= echo->probeExpected)
+	{
+		stats->lost += sequence - echo->probeExpected;
+		echo->probeExpected = sequence + 1;
+	}
+
+	if ((stats->count == 0) || (rtt < stats->min))
+		stats->min = rtt;
+
+	if (rtt > stats->max)
+		stats->max = rtt;
+
+	stats->sum += rtt;
+	stats->count++;
+
+	while ((bucket < ECHO_LATENCY_BUCKETS - 1) && (rtt >= (1ULL << bucket)))
+		bucket++;
+
+	stats->histogram[bucket]++;
+
+	if ((stats->count % 64) == 0)
+		WLog_DBG(TAG,
+		         "latency probes: %" PRIu32 " answered, %" PRIu32 " lost, rtt min/avg/max %" PRIu64
+		         "/%" PRIu64 "/%" PRIu64 " ms",
+		         stats->count, stats->lost, stats->min, stats->sum / stats->count, stats->max);
+
+	IFCALL(echo->context.Latency, &echo->context, sequence, rtt, stats);
+	return TRUE;
+}
+
 static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 {
 	wStream* s;
@@ -116,6 +200,7 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 	echo_server* echo = (echo_server*)arg;
 	UINT error;
 	DWORD status;
+	UINT64 nextProbe;
 
 	if ((error = echo_server_open_channel(echo)))
 	{
@@ -208,9 +293,31 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 		return ERROR_NOT_ENOUGH_MEMORY;
 	}
 
+	echo->probeSequence = 0;
+	echo->probeExpected = 0;
+	ZeroMemory(&echo->stats, sizeof(echo->stats));
+	nextProbe = GetTickCount64();
+
 	while (ready)
 	{
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+		DWORD timeout = INFINITE;
+
+		if (echo->context.ProbeInterval > 0)
+		{
+			UINT64 now = GetTickCount64();
+
+			if (now >= nextProbe)
+			{
+				if ((error = echo_server_send_probe(echo)))
+					break;
+
+				nextProbe = now + echo->context.ProbeInterval;
+			}
+
+			timeout = (DWORD)(nextProbe - now);
+		}
+
+		status = WaitForMultipleObjects(nCount, events, FALSE, timeout);
 
 		if (status == WAIT_FAILED)
 		{
@@ -222,6 +329,9 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 		if (status == WAIT_OBJECT_0)
 			break;
 
+		if (status == WAIT_TIMEOUT)
+			continue;
+
 		Stream_SetPosition(s, 0);
 		WTSVirtualChannelRead(echo->echo_channel, 0, NULL, 0, &BytesReturned);
 
@@ -243,6 +353,11 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 			break;
 		}
 
+		Stream_SetLength(s, BytesReturned);
+
+		if (echo_server_handle_probe(echo, s))
+			continue;
+
 		IFCALLRET(echo->context.Response, error, &echo->context, (BYTE*)Stream_Buffer(s),
 		          BytesReturned);
 
@@ -35,9 +35,20 @@
 #include <winpr/string.h>
 
 #include <freerdp/channels/rdpdr.h>
+#include <freerdp/channels/log.h>
 
 #include <freerdp/client/printer.h>
 
+#define TAG CHANNELS_TAG("printer.client.cups")
+
+#if defined(_CUPS_API_1_7)
+#define PRINTER_CUPS_CONTINUE HTTP_STATUS_CONTINUE
+#define PRINTER_CUPS_OK IPP_STATUS_OK
+#else
+#define PRINTER_CUPS_CONTINUE HTTP_CONTINUE
+#define PRINTER_CUPS_OK IPP_OK
+#endif
+
 typedef struct
 {
 	rdpPrinterDriver driver;
@@ -52,6 +63,7 @@ typedef struct
 
 	void* printjob_object;
 	int printjob_id;
+	FILE* spool; /* without the 1.4 API the job is spooled to printjob_object */
 } rdpCupsPrintJob;
 
 typedef struct
@@ -84,27 +96,19 @@ static UINT printer_cups_write_printjob(rdpPrintJob* printjob, const BYTE* data,
 
 #ifndef _CUPS_API_1_4
 
-	{
-		FILE* fp;
-
-		fp = winpr_fopen((const char*)cups_printjob->printjob_object, "a+b");
-
-		if (!fp)
-			return ERROR_INTERNAL_ERROR;
-
-		if (fwrite(data, 1, size, fp) < size)
-		{
-			fclose(fp);
-			return ERROR_INTERNAL_ERROR;
-			// FIXME once this function doesn't return void anymore!
-		}
-
-		fclose(fp);
-	}
+	if (fwrite(data, 1, size, cups_printjob->spool) < size)
+		return ERROR_INTERNAL_ERROR;
 
 #else
 
-	cupsWriteRequestData((http_t*)cups_printjob->printjob_object, (const char*)data, size);
+	/* the data goes to the scheduler right away, a slow scheduler delays the completion of the
+	 * write request and with it the next write from the server */
+	if (cupsWriteRequestData((http_t*)cups_printjob->printjob_object, (const char*)data, size) !=
+	    PRINTER_CUPS_CONTINUE)
+	{
+		WLog_ERR(TAG, "cupsWriteRequestData failed: %s", cupsLastErrorString());
+		return ERROR_INTERNAL_ERROR;
+	}
 
 #endif
 
@@ -120,6 +124,7 @@ static void printer_cups_close_printjob(rdpPrintJob* printjob)
 	{
 		char buf[100];
 
+		fclose(cups_printjob->spool);
 		printer_cups_get_printjob_name(buf, sizeof(buf), printjob->id);
 
 		if (cupsPrintFile(printjob->printer->name, (const char*)cups_printjob->printjob_object, buf,
@@ -133,7 +138,9 @@ static void printer_cups_close_printjob(rdpPrintJob* printjob)
 
 #else
 
-	cupsFinishDocument((http_t*)cups_printjob->printjob_object, printjob->printer->name);
+	if (cupsFinishDocument((http_t*)cups_printjob->printjob_object, printjob->printer->name) !=
+	    PRINTER_CUPS_OK)
+		WLog_ERR(TAG, "cupsFinishDocument failed: %s", cupsLastErrorString());
 	cups_printjob->printjob_id = 0;
 	httpClose((http_t*)cups_printjob->printjob_object);
 
@@ -170,6 +177,15 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 		return NULL;
 	}
 
+	/* kept open for the whole job instead of reopening it for every write */
+	cups_printjob->spool = winpr_fopen((const char*)cups_printjob->printjob_object, "wb");
+	if (!cups_printjob->spool)
+	{
+		free(cups_printjob->printjob_object);
+		free(cups_printjob);
+		return NULL;
+	}
+
 #else
 	{
 		char buf[100];
@@ -199,8 +215,16 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 			return NULL;
 		}
 
-		cupsStartDocument((http_t*)cups_printjob->printjob_object, printer->name,
-		                  cups_printjob->printjob_id, buf, CUPS_FORMAT_AUTO, 1);
+		if (cupsStartDocument((http_t*)cups_printjob->printjob_object, printer->name,
+		                      cups_printjob->printjob_id, buf, CUPS_FORMAT_AUTO,
+		                      1) != PRINTER_CUPS_CONTINUE)
+		{
+			WLog_ERR(TAG, "cupsStartDocument failed: %s", cupsLastErrorString());
+			cupsCancelJob2((http_t*)cups_printjob->printjob_object, printer->name, cups_printjob->printjob_id, 0);
+			httpClose((http_t*)cups_printjob->printjob_object);
+			free(cups_printjob);
+			return NULL;
+		}
 	}
 
 #endif
@@ -502,10 +502,12 @@ static UINT printer_process_irp_write(PRINTER_DEVICE* printer_dev, IRP* irp)
 		error = printjob->Write(printjob, ptr, Length);
 	}
 
+	/* the server aborts the job, the device stays usable for the next one */
 	if (error)
 	{
 		WLog_ERR(TAG, "printjob->Write failed with error %" PRIu32 "!", error);
-		return error;
+		irp->IoStatus = STATUS_UNSUCCESSFUL;
+		Length = 0;
 	}
 
 	Stream_Write_UINT32(irp->output, Length);
@@ -584,6 +586,7 @@ static UINT printer_process_irp(PRINTER_DEVICE* printer_dev, IRP* irp)
 static DWORD WINAPI printer_thread_func(LPVOID arg)
 {
 	IRP* irp;
+	IRP* next;
 	PRINTER_DEVICE* printer_dev = (PRINTER_DEVICE*)arg;
 	HANDLE obj[] = { printer_dev->event, printer_dev->stopEvent };
 	UINT error = CHANNEL_RC_OK;
@@ -605,20 +608,36 @@ static DWORD WINAPI printer_thread_func(LPVOID arg)
 			continue;
 
 		ResetEvent(printer_dev->event);
-		irp = (IRP*)InterlockedPopEntrySList(printer_dev->pIrpList);
 
-		if (irp == NULL)
+		/*
+		 * Take every queued request. The list returns the newest first, the writes of a job
+		 * have to reach the printer backend in the order the server sent them.
+		 */
+		next = (IRP*)InterlockedFlushSList(printer_dev->pIrpList);
+		irp = NULL;
+
+		while (next)
 		{
-			WLog_ERR(TAG, "InterlockedPopEntrySList failed!");
-			error = ERROR_INTERNAL_ERROR;
-			break;
+			IRP* cur = next;
+			next = (IRP*)cur->ItemEntry.Next;
+			cur->ItemEntry.Next = irp ? &irp->ItemEntry : NULL;
+			irp = cur;
 		}
 
-		if ((error = printer_process_irp(printer_dev, irp)))
+		while (irp)
 		{
-			WLog_ERR(TAG, "printer_process_irp failed with error %" PRIu32 "!", error);
-			break;
+			next = (IRP*)irp->ItemEntry.Next;
+
+			if (!error && (error = printer_process_irp(printer_dev, irp)))
+				WLog_ERR(TAG, "printer_process_irp failed with error %" PRIu32 "!", error);
+			else if (error)
+				irp->Discard(irp);
+
+			irp = next;
 		}
+
+		if (error)
+			break;
 	}
 
 	if (error && printer_dev->rdpcontext)
@@ -23,6 +23,7 @@
 #include <winpr/file.h>
 #include <winpr/pipe.h>
 #include <winpr/thread.h>
+#include <winpr/collections.h>
 
 #include <freerdp/svc.h>
 #include <freerdp/channels/rdp2tcp.h>
@@ -32,17 +33,22 @@
 
 static int const debug = 0;
 
+/* Reads are forwarded without waiting for the previous write to complete, up to
+ * RDP2TCP_WRITE_SLOTS pooled buffers are queued in the channel at a time */
+#define RDP2TCP_BUFFER_SIZE (64 * 1024)
+#define RDP2TCP_WRITE_SLOTS 8
+
 typedef struct
 {
 	HANDLE hStdOutputRead;
 	HANDLE hStdInputWrite;
 	HANDLE hProcess;
 	HANDLE copyThread;
-	HANDLE writeComplete;
+	HANDLE writeSlots;
+	wQueue* buffers;
 	DWORD openHandle;
 	void* initHandle;
 	CHANNEL_ENTRY_POINTS_FREERDP_EX channelEntryPoints;
-	char buffer[16 * 1024];
 	char* commandline;
 } Plugin;
 
@@ -130,27 +136,41 @@ static void dumpData(char* data, unsigned length)
 	puts("");
 }
 
+static void releaseBuffer(Plugin* plugin, void* buffer)
+{
+	if (!Queue_Enqueue(plugin->buffers, buffer))
+	{
+		free(buffer);
+		return;
+	}
+
+	ReleaseSemaphore(plugin->writeSlots, 1, NULL);
+}
+
 static DWORD WINAPI copyThread(void* data)
 {
 	Plugin* plugin = (Plugin*)data;
-	size_t const bufsize = 16 * 1024;
 
 	while (1)
 	{
 		DWORD dwRead;
-		char* buffer = malloc(bufsize);
+		char* buffer;
+
+		/* Blocks while all buffers are queued in the channel */
+		if (WaitForSingleObject(plugin->writeSlots, INFINITE) != WAIT_OBJECT_0)
+			goto fail;
+
+		buffer = Queue_Dequeue(plugin->buffers);
 
 		if (!buffer)
 		{
-			fprintf(stderr, "rdp2tcp copyThread: malloc failed\n");
+			fprintf(stderr, "rdp2tcp copyThread: no buffer available\n");
 			goto fail;
 		}
 
-		// if (!ReadFile(plugin->hStdOutputRead, plugin->buffer, sizeof plugin->buffer, &dwRead,
-		// NULL))
-		if (!ReadFile(plugin->hStdOutputRead, buffer, bufsize, &dwRead, NULL))
+		if (!ReadFile(plugin->hStdOutputRead, buffer, RDP2TCP_BUFFER_SIZE, &dwRead, NULL))
 		{
-			free(buffer);
+			releaseBuffer(plugin, buffer);
 			goto fail;
 		}
 
@@ -163,13 +183,10 @@ static DWORD WINAPI copyThread(void* data)
 		if (plugin->channelEntryPoints.pVirtualChannelWriteEx(
 		        plugin->initHandle, plugin->openHandle, buffer, dwRead, buffer) != CHANNEL_RC_OK)
 		{
-			free(buffer);
+			releaseBuffer(plugin, buffer);
 			fprintf(stderr, "rdp2tcp copyThread failed %i\n", (int)dwRead);
 			goto fail;
 		}
-
-		WaitForSingleObject(plugin->writeComplete, INFINITE);
-		ResetEvent(plugin->writeComplete);
 	}
 
 fail:
@@ -237,11 +254,8 @@ static void VCAPITYPE VirtualChannelOpenEventEx(LPVOID lpUserParam, DWORD openHa
 			break;
 
 		case CHANNEL_EVENT_WRITE_CANCELLED:
-			free(pData);
-			break;
 		case CHANNEL_EVENT_WRITE_COMPLETE:
-			SetEvent(plugin->writeComplete);
-			free(pData);
+			releaseBuffer(plugin, pData);
 			break;
 	}
 }
@@ -256,8 +270,10 @@ static void channel_terminated(Plugin* plugin)
 
 	if (plugin->copyThread)
 		TerminateThread(plugin->copyThread, 0);
-	if (plugin->writeComplete)
-		CloseHandle(plugin->writeComplete);
+	if (plugin->writeSlots)
+		CloseHandle(plugin->writeSlots);
+
+	Queue_Free(plugin->buffers);
 
 	CloseHandle(plugin->hStdInputWrite);
 	CloseHandle(plugin->hStdOutputRead);
@@ -269,7 +285,31 @@ static void channel_terminated(Plugin* plugin)
 
 static void channel_initialized(Plugin* plugin)
 {
-	plugin->writeComplete = CreateEvent(NULL, TRUE, FALSE, NULL);
+	size_t x;
+
+	plugin->buffers = Queue_New(TRUE, RDP2TCP_WRITE_SLOTS, 0);
+
+	if (!plugin->buffers)
+		return;
+
+	Queue_Object(plugin->buffers)->fnObjectFree = free;
+
+	for (x = 0; x < RDP2TCP_WRITE_SLOTS; x++)
+	{
+		void* buffer = malloc(RDP2TCP_BUFFER_SIZE);
+
+		if (!buffer || !Queue_Enqueue(plugin->buffers, buffer))
+		{
+			free(buffer);
+			break;
+		}
+	}
+
+	plugin->writeSlots = CreateSemaphore(NULL, (LONG)x, RDP2TCP_WRITE_SLOTS, NULL);
+
+	if ((x == 0) || !plugin->writeSlots)
+		return;
+
 	plugin->copyThread = CreateThread(NULL, 0, copyThread, plugin, 0, NULL);
 }
 
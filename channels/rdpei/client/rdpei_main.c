@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include <winpr/crt.h>
 #include <winpr/synch.h>
@@ -62,6 +63,8 @@
 
 #define MAX_CONTACTS 64
 #define MAX_PEN_CONTACTS 4
+/* milliseconds contact updates are merged before they are sent */
+#define RDPEI_COALESCE_TIME_DEFAULT 4
 
 typedef struct
 {
@@ -102,6 +105,9 @@ typedef struct
 	UINT16 maxPenContacts;
 	RDPINPUT_PEN_CONTACT_POINT penContactPoints[MAX_PEN_CONTACTS];
 
+	UINT32 coalesceTime;
+	UINT64 coalesceStart;
+
 	CRITICAL_SECTION lock;
 	rdpContext* rdpcontext;
 	BOOL initialized;
@@ -141,6 +147,30 @@ static const char* rdpei_eventid_string(UINT16 event)
 }
 #endif
 
+static BOOL rdpei_is_transition(UINT32 contactFlags)
+{
+	return (contactFlags & (RDPINPUT_CONTACT_FLAG_DOWN | RDPINPUT_CONTACT_FLAG_UP)) != 0;
+}
+
+/**
+ * Wakes the update thread for a changed contact, must be called with the lock held.
+ * Transitions are sent right away, updates are merged for the coalescing time and only the
+ * latest position of a contact is sent.
+ */
+static void rdpei_schedule_frame(RDPEI_PLUGIN* rdpei, UINT32 contactFlags)
+{
+	if ((rdpei->coalesceTime == 0) || rdpei_is_transition(contactFlags))
+	{
+		rdpei->coalesceStart = 0;
+		SetEvent(rdpei->event);
+	}
+	else if (rdpei->coalesceStart == 0)
+	{
+		rdpei->coalesceStart = GetTickCount64();
+		SetEvent(rdpei->event);
+	}
+}
+
 static RDPINPUT_CONTACT_POINT* rdpei_contact(RDPEI_PLUGIN* rdpei, INT32 externalId, BOOL active)
 {
 	UINT16 i;
@@ -451,6 +481,7 @@ static UINT rdpei_update(RdpeiClientContext* context)
 static DWORD WINAPI rdpei_periodic_update(LPVOID arg)
 {
 	DWORD status;
+	DWORD timeout = 20;
 	RDPEI_PLUGIN* rdpei = (RDPEI_PLUGIN*)arg;
 	UINT error = CHANNEL_RC_OK;
 	RdpeiClientContext* context;
@@ -471,7 +502,7 @@ static DWORD WINAPI rdpei_periodic_update(LPVOID arg)
 
 	while (rdpei->initialized)
 	{
-		status = WaitForSingleObject(rdpei->event, 20);
+		status = WaitForSingleObject(rdpei->event, timeout);
 
 		if (status == WAIT_FAILED)
 		{
@@ -481,6 +512,26 @@ static DWORD WINAPI rdpei_periodic_update(LPVOID arg)
 		}
 
 		EnterCriticalSection(&rdpei->lock);
+		timeout = 20;
+
+		/* wait for more updates until the coalescing time is over */
+		if (rdpei->coalesceStart != 0)
+		{
+			const UINT64 elapsed = GetTickCount64() - rdpei->coalesceStart;
+
+			if (elapsed < rdpei->coalesceTime)
+			{
+				timeout = (DWORD)(rdpei->coalesceTime - elapsed);
+
+				if (status == WAIT_OBJECT_0)
+					ResetEvent(rdpei->event);
+
+				LeaveCriticalSection(&rdpei->lock);
+				continue;
+			}
+
+			rdpei->coalesceStart = 0;
+		}
 
 		error = rdpei_update(context);
 		if (error != CHANNEL_RC_OK)
@@ -1094,6 +1145,7 @@ static UINT rdpei_add_contact(RdpeiClientContext* context, const RDPINPUT_CONTAC
 {
 	RDPINPUT_CONTACT_POINT* contactPoint;
 	RDPEI_PLUGIN* rdpei;
+	UINT error = CHANNEL_RC_OK;
 	if (!context || !contact || !context->handle)
 		return ERROR_INTERNAL_ERROR;
 
@@ -1101,12 +1153,18 @@ static UINT rdpei_add_contact(RdpeiClientContext* context, const RDPINPUT_CONTAC
 
 	EnterCriticalSection(&rdpei->lock);
 	contactPoint = &rdpei->contactPoints[contact->contactId];
+
+	/* only updates replace each other, a transition is never merged */
+	if (contactPoint->dirty && (rdpei_is_transition(contactPoint->data.contactFlags) ||
+	                            rdpei_is_transition(contact->contactFlags)))
+		error = rdpei_add_frame(context);
+
 	contactPoint->data = *contact;
 	contactPoint->dirty = TRUE;
-	SetEvent(rdpei->event);
+	rdpei_schedule_frame(rdpei, contact->contactFlags);
 	LeaveCriticalSection(&rdpei->lock);
 
-	return CHANNEL_RC_OK;
+	return error;
 }
 
 static UINT rdpei_touch_process(RdpeiClientContext* context, INT32 externalId, UINT32 contactFlags,
@@ -1299,6 +1357,7 @@ static UINT rdpei_add_pen(RdpeiClientContext* context, INT32 externalId,
 {
 	RDPEI_PLUGIN* rdpei;
 	RDPINPUT_PEN_CONTACT_POINT* contactPoint;
+	UINT error = CHANNEL_RC_OK;
 
 	if (!context || !contact || !context->handle)
 		return ERROR_INTERNAL_ERROR;
@@ -1309,13 +1368,18 @@ static UINT rdpei_add_pen(RdpeiClientContext* context, INT32 externalId,
 	contactPoint = rdpei_pen_contact(rdpei, externalId, TRUE);
 	if (contactPoint)
 	{
+		/* only updates replace each other, a transition is never merged */
+		if (contactPoint->dirty && (rdpei_is_transition(contactPoint->data.contactFlags) ||
+		                            rdpei_is_transition(contact->contactFlags)))
+			error = rdpei_add_pen_frame(context);
+
 		contactPoint->data = *contact;
 		contactPoint->dirty = TRUE;
-		SetEvent(rdpei->event);
+		rdpei_schedule_frame(rdpei, contact->contactFlags);
 	}
 	LeaveCriticalSection(&rdpei->lock);
 
-	return CHANNEL_RC_OK;
+	return error;
 }
 
 static UINT rdpei_pen_process(RdpeiClientContext* context, INT32 externalId, UINT32 contactFlags,
@@ -1455,6 +1519,51 @@ static UINT rdpei_pen_raw_event(RdpeiClientContext* context, INT32 externalId, U
 	return error;
 }
 
+static BOOL rdpei_process_addin_args(RDPEI_PLUGIN* rdpei, const ADDIN_ARGV* args)
+{
+	int status;
+	DWORD flags;
+	const COMMAND_LINE_ARGUMENT_A* arg;
+	COMMAND_LINE_ARGUMENT_A rdpei_args[] = {
+		{ "coalesce", COMMAND_LINE_VALUE_REQUIRED, "<milliseconds>", NULL, NULL, -1, NULL,
+		  "time contact updates are merged, 0 sends every update" },
+		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
+	};
+
+	if (!args || args->argc == 1)
+		return TRUE;
+
+	flags =
+	    COMMAND_LINE_SIGIL_NONE | COMMAND_LINE_SEPARATOR_COLON | COMMAND_LINE_IGN_UNKNOWN_KEYWORD;
+	status =
+	    CommandLineParseArgumentsA(args->argc, args->argv, rdpei_args, flags, rdpei, NULL, NULL);
+
+	if (status != 0)
+		return FALSE;
+
+	arg = rdpei_args;
+	errno = 0;
+
+	do
+	{
+		if (!(arg->Flags & COMMAND_LINE_VALUE_PRESENT))
+			continue;
+
+		CommandLineSwitchStart(arg) CommandLineSwitchCase(arg, "coalesce")
+		{
+			unsigned long time = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (time > 1000))
+				return FALSE;
+
+			rdpei->coalesceTime = (UINT32)time;
+		}
+		CommandLineSwitchEnd(arg)
+	} while ((arg = CommandLineFindNextArgumentA(arg)) != NULL);
+
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -1486,10 +1595,18 @@ UINT rdpei_DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
 		rdpei->previousFrameTime = 0;
 		rdpei->maxTouchContacts = MAX_CONTACTS;
 		rdpei->maxPenContacts = MAX_PEN_CONTACTS;
+		rdpei->coalesceTime = RDPEI_COALESCE_TIME_DEFAULT;
 		rdpei->rdpcontext =
 		    ((freerdp*)((rdpSettings*)pEntryPoints->GetRdpSettings(pEntryPoints))->instance)
 		        ->context;
 
+		if (!rdpei_process_addin_args(rdpei, pEntryPoints->GetPluginData(pEntryPoints)))
+		{
+			WLog_ERR(TAG, "invalid rdpei arguments");
+			error = ERROR_INVALID_PARAMETER;
+			goto error_out;
+		}
+
 		context = (RdpeiClientContext*)calloc(1, sizeof(RdpeiClientContext));
 
 		if (!context)
@@ -22,9 +22,14 @@
 #include <freerdp/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/assert.h>
 #include <winpr/stream.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/log.h>
+#include <freerdp/primitives.h>
 #include <freerdp/utils/profiler.h>
+#include <freerdp/utils/trace.h>
 
 #include "rdpgfx_common.h"
 
@@ -268,6 +273,7 @@ UINT rdpgfx_decode(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
 	UINT error = CHANNEL_RC_OK;
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
 	PROFILER_ENTER(context->SurfaceProfiler)
+	FREERDP_TRACE_SPAN_BEGIN(span);
 
 	switch (cmd->codecId)
 	{
@@ -296,6 +302,276 @@ UINT rdpgfx_decode(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
 			break;
 	}
 
+	FREERDP_TRACE_SPAN_END(span, "rdpgfx_decode");
 	PROFILER_EXIT(context->SurfaceProfiler)
 	return error;
 }
+
+/* the commands queued for a surface id, decoded one after the other */
+typedef struct
+{
+	RDPGFX_PLUGIN* gfx;
+	PTP_WORK work;
+	wQueue* commands;
+	CRITICAL_SECTION decoding;
+	CRITICAL_SECTION lock;
+	HANDLE idle;
+
+	/* guarded by the lock */
+	size_t pending;
+	UINT error;
+} RDPGFX_SURFACE_DECODER;
+
+static void rdpgfx_surface_decoder_free(void* obj)
+{
+	RDPGFX_SURFACE_DECODER* decoder = (RDPGFX_SURFACE_DECODER*)obj;
+
+	if (!decoder)
+		return;
+
+	if (decoder->idle)
+	{
+		WaitForSingleObject(decoder->idle, INFINITE);
+		CloseHandle(decoder->idle);
+	}
+
+	if (decoder->work)
+		CloseThreadpoolWork(decoder->work);
+
+	Queue_Free(decoder->commands);
+	DeleteCriticalSection(&decoder->lock);
+	DeleteCriticalSection(&decoder->decoding);
+	free(decoder);
+}
+
+static VOID CALLBACK rdpgfx_surface_decoder_work(PTP_CALLBACK_INSTANCE instance, PVOID context,
+                                               PTP_WORK work)
+{
+	UINT error = CHANNEL_RC_OK;
+	RDPGFX_SURFACE_COMMAND* cmd;
+	RDPGFX_SURFACE_DECODER* decoder = (RDPGFX_SURFACE_DECODER*)context;
+
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	WINPR_ASSERT(decoder);
+
+	/* every submit decodes one command, the lock keeps them in order */
+	EnterCriticalSection(&decoder->decoding);
+	cmd = (RDPGFX_SURFACE_COMMAND*)Queue_Dequeue(decoder->commands);
+
+	if (cmd)
+		error = rdpgfx_decode(decoder->gfx, cmd);
+
+	free(cmd);
+	LeaveCriticalSection(&decoder->decoding);
+
+	EnterCriticalSection(&decoder->lock);
+
+	if (error && !decoder->error)
+		decoder->error = error;
+
+	if (--decoder->pending == 0)
+		SetEvent(decoder->idle);
+
+	LeaveCriticalSection(&decoder->lock);
+}
+
+static RDPGFX_SURFACE_DECODER* rdpgfx_surface_decoder_new(RDPGFX_PLUGIN* gfx)
+{
+	RDPGFX_SURFACE_DECODER* decoder = calloc(1, sizeof(RDPGFX_SURFACE_DECODER));
+
+	if (!decoder)
+		return NULL;
+
+	decoder->gfx = gfx;
+	InitializeCriticalSection(&decoder->decoding);
+	InitializeCriticalSection(&decoder->lock);
+	decoder->commands = Queue_New(TRUE, -1, -1);
+
+	if (!decoder->commands)
+		goto fail;
+
+	decoder->idle = CreateEvent(NULL, TRUE, TRUE, NULL);
+
+	if (!decoder->idle)
+		goto fail;
+
+	decoder->work =
+	    CreateThreadpoolWork(rdpgfx_surface_decoder_work, decoder, &gfx->DecodeEnvironment);
+
+	if (!decoder->work)
+		goto fail;
+
+	return decoder;
+fail:
+	rdpgfx_surface_decoder_free(decoder);
+	return NULL;
+}
+
+static UINT rdpgfx_surface_decoder_wait(RDPGFX_SURFACE_DECODER* decoder)
+{
+	UINT error;
+
+	if (!decoder)
+		return CHANNEL_RC_OK;
+
+	WaitForSingleObject(decoder->idle, INFINITE);
+	EnterCriticalSection(&decoder->lock);
+	error = decoder->error;
+	decoder->error = CHANNEL_RC_OK;
+	LeaveCriticalSection(&decoder->lock);
+	return error;
+}
+
+BOOL rdpgfx_decoders_init(RDPGFX_PLUGIN* gfx)
+{
+	wObject* obj;
+	SYSTEM_INFO sysinfo = { 0 };
+
+	WINPR_ASSERT(gfx);
+
+	gfx->SurfaceDecoders = HashTable_New(TRUE);
+
+	if (!gfx->SurfaceDecoders)
+		return FALSE;
+
+	obj = HashTable_ValueObject(gfx->SurfaceDecoders);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = rdpgfx_surface_decoder_free;
+
+	/* the h264 decoders are per surface, the other codecs are shared and decode in order */
+	primitives_get();
+	gfx->DecodePool = CreateThreadpool(NULL);
+
+	if (!gfx->DecodePool)
+		return FALSE;
+
+	GetNativeSystemInfo(&sysinfo);
+	InitializeThreadpoolEnvironment(&gfx->DecodeEnvironment);
+	SetThreadpoolCallbackPool(&gfx->DecodeEnvironment, gfx->DecodePool);
+	SetThreadpoolThreadMaximum(gfx->DecodePool, MAX(1, sysinfo.dwNumberOfProcessors));
+	return TRUE;
+}
+
+void rdpgfx_decoders_uninit(RDPGFX_PLUGIN* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	HashTable_Free(gfx->SurfaceDecoders);
+	gfx->SurfaceDecoders = NULL;
+
+	if (gfx->DecodePool)
+	{
+		CloseThreadpool(gfx->DecodePool);
+		DestroyThreadpoolEnvironment(&gfx->DecodeEnvironment);
+		gfx->DecodePool = NULL;
+	}
+}
+
+static BOOL rdpgfx_decode_parallel(RDPGFX_PLUGIN* gfx, const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	/* outside of a frame every command presents its surface, so it is decoded right away */
+	if (!gfx->InFrame || !gfx->DecodePool)
+		return FALSE;
+
+	switch (cmd->codecId)
+	{
+		case RDPGFX_CODECID_AVC420:
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+UINT rdpgfx_decode_queued(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd)
+{
+	UINT error;
+	RDPGFX_SURFACE_COMMAND* copy;
+	RDPGFX_SURFACE_DECODER* decoder;
+	const ULONG_PTR key = ((ULONG_PTR)cmd->surfaceId) + 1;
+
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(cmd);
+
+	decoder = HashTable_GetItemValue(gfx->SurfaceDecoders, (void*)key);
+
+	if (!rdpgfx_decode_parallel(gfx, cmd))
+	{
+		error = rdpgfx_surface_decoder_wait(decoder);
+
+		if (error)
+			return error;
+
+		return rdpgfx_decode(gfx, cmd);
+	}
+
+	if (!decoder)
+	{
+		decoder = rdpgfx_surface_decoder_new(gfx);
+
+		if (!decoder)
+			return CHANNEL_RC_NO_MEMORY;
+
+		if (!HashTable_Insert(gfx->SurfaceDecoders, (void*)key, decoder))
+		{
+			rdpgfx_surface_decoder_free(decoder);
+			return CHANNEL_RC_NO_MEMORY;
+		}
+	}
+
+	/* the data points into the PDU, which is gone once this returns */
+	copy = malloc(sizeof(RDPGFX_SURFACE_COMMAND) + cmd->length);
+
+	if (!copy)
+		return CHANNEL_RC_NO_MEMORY;
+
+	*copy = *cmd;
+	copy->data = (BYTE*)&copy[1];
+	copy->extra = NULL;
+	memcpy(copy->data, cmd->data, cmd->length);
+
+	EnterCriticalSection(&decoder->lock);
+
+	if (!Queue_Enqueue(decoder->commands, copy))
+	{
+		LeaveCriticalSection(&decoder->lock);
+		free(copy);
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	decoder->pending++;
+	ResetEvent(decoder->idle);
+	LeaveCriticalSection(&decoder->lock);
+	SubmitThreadpoolWork(decoder->work);
+	return CHANNEL_RC_OK;
+}
+
+UINT rdpgfx_decode_wait(RDPGFX_PLUGIN* gfx)
+{
+	size_t x, count;
+	ULONG_PTR* keys = NULL;
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(gfx);
+
+	if (!gfx->SurfaceDecoders)
+		return CHANNEL_RC_OK;
+
+	count = HashTable_GetKeys(gfx->SurfaceDecoders, &keys);
+
+	for (x = 0; x < count; x++)
+	{
+		RDPGFX_SURFACE_DECODER* decoder =
+		    HashTable_GetItemValue(gfx->SurfaceDecoders, (void*)keys[x]);
+		const UINT rc = rdpgfx_surface_decoder_wait(decoder);
+
+		if (rc && !error)
+			error = rc;
+	}
+
+	free(keys);
+	return error;
+}
@@ -32,4 +32,19 @@
 
 FREERDP_LOCAL UINT rdpgfx_decode(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd);
 
+FREERDP_LOCAL BOOL rdpgfx_decoders_init(RDPGFX_PLUGIN* gfx);
+FREERDP_LOCAL void rdpgfx_decoders_uninit(RDPGFX_PLUGIN* gfx);
+
+/**
+ * @brief rdpgfx_decode_queued Decodes AVC commands within a frame on the decode pool, in order
+ * per surface. Other commands wait for the commands queued for their surface first.
+ */
+FREERDP_LOCAL UINT rdpgfx_decode_queued(RDPGFX_PLUGIN* gfx, RDPGFX_SURFACE_COMMAND* cmd);
+
+/**
+ * @brief rdpgfx_decode_wait Waits for the commands queued for all surfaces
+ * @return the first error of a queued command
+ */
+FREERDP_LOCAL UINT rdpgfx_decode_wait(RDPGFX_PLUGIN* gfx);
+
 #endif /* FREERDP_CHANNEL_RDPGFX_CLIENT_CODEC_H */
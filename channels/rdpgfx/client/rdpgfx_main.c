@@ -37,6 +37,7 @@
 
 #include <freerdp/addin.h>
 #include <freerdp/channels/log.h>
+#include <freerdp/utils/trace.h>
 
 #include "rdpgfx_common.h"
 #include "rdpgfx_codec.h"
@@ -45,6 +46,11 @@
 
 #define TAG CHANNELS_TAG("rdpgfx.client")
 
+/* the server rejects offers with 5462 or more entries */
+#define RDPGFX_CACHE_IMPORT_MAX_ENTRIES 5461
+/* the initial size of the decompressed message buffer, the output of one zgfx segment */
+#define RDPGFX_RECEIVE_BUFFER_SIZE 65536
+
 static void free_surfaces(RdpgfxClientContext* context, wHashTable* SurfaceTable)
 {
 	UINT error = 0;
@@ -94,6 +100,85 @@ static void evict_cache_slots(RdpgfxClientContext* context, UINT16 MaxCacheSlots
 	}
 }
 
+static BOOL rdpgfx_persist_enabled(const rdpSettings* settings)
+{
+	WINPR_ASSERT(settings);
+	return settings->BitmapCachePersistEnabled && settings->BitmapCachePersistFile;
+}
+
+static void rdpgfx_free_cache_import_entries(RDPGFX_PLUGIN* gfx)
+{
+	UINT16 index;
+
+	for (index = 0; index < gfx->CacheImportEntriesCount; index++)
+		free(gfx->CacheImportEntries[index].data);
+
+	free(gfx->CacheImportEntries);
+	gfx->CacheImportEntries = NULL;
+	gfx->CacheImportEntriesCount = 0;
+}
+
+/**
+ * Writes the cache slots to the persistent cache file, they are offered to the
+ * server on the next connection.
+ */
+static void rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
+{
+	UINT16 index;
+	UINT32 count = 0;
+	rdpPersistentCache* persistent = NULL;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context || !context->ExportCacheEntry || !rdpgfx_persist_enabled(gfx->settings))
+		return;
+
+	for (index = 0; index < gfx->MaxCacheSlots; index++)
+	{
+		if (gfx->CacheSlots[index])
+			count++;
+	}
+
+	if (count == 0)
+		return;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return;
+
+	if (!persistent_cache_open(persistent, gfx->settings->BitmapCachePersistFile, TRUE))
+		goto fail;
+
+	for (index = 0; index < gfx->MaxCacheSlots; index++)
+	{
+		BOOL rc = TRUE;
+		PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+		if (!gfx->CacheSlots[index])
+			continue;
+
+		if (context->ExportCacheEntry(context, index + 1, &entry) == CHANNEL_RC_OK)
+		{
+			entry.cacheId = PERSISTENT_CACHE_ID_GFX;
+			rc = persistent_cache_write_entry(persistent, &entry);
+		}
+
+		free(entry.data);
+
+		if (!rc)
+		{
+			WLog_Print(gfx->log, WLOG_WARN, "failed to write persistent cache entry");
+			break;
+		}
+	}
+
+	if (!persistent_cache_close(persistent))
+		WLog_Print(gfx->log, WLOG_WARN, "failed to save persistent cache");
+
+fail:
+	persistent_cache_free(persistent);
+}
+
 /**
  * Function description
  *
@@ -534,6 +619,97 @@ fail:
 	return error;
 }
 
+/**
+ * Loads the graphics pipeline entries of the persistent cache file and offers
+ * them to the server, the entries are imported when the reply arrives.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_send_persistent_cache_offer(RDPGFX_PLUGIN* gfx)
+{
+	UINT error = CHANNEL_RC_OK;
+	UINT16 count = 0;
+	UINT32 maxCount;
+	UINT64 size = 0;
+	UINT64 maxSize;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	RDPGFX_CACHE_IMPORT_OFFER_PDU pdu = { 0 };
+	rdpPersistentCache* persistent = NULL;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	rdpgfx_free_cache_import_entries(gfx);
+
+	if (!context || !context->ImportCacheEntry || !rdpgfx_persist_enabled(gfx->settings))
+		return CHANNEL_RC_OK;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return CHANNEL_RC_NO_MEMORY;
+
+	/* a missing cache file is not an error */
+	if (!persistent_cache_open(persistent, gfx->settings->BitmapCachePersistFile, FALSE))
+		goto fail;
+
+	maxCount = MIN(persistent_cache_get_count(persistent), gfx->MaxCacheSlots);
+	maxCount = MIN(maxCount, RDPGFX_CACHE_IMPORT_MAX_ENTRIES);
+	maxSize = (gfx->SmallCache ? 16ULL : 100ULL) * 1024ULL * 1024ULL;
+
+	if (maxCount == 0)
+		goto fail;
+
+	gfx->CacheImportEntries =
+	    (PERSISTENT_CACHE_ENTRY*)calloc(maxCount, sizeof(PERSISTENT_CACHE_ENTRY));
+	pdu.cacheEntries =
+	    (RDPGFX_CACHE_ENTRY_METADATA*)calloc(maxCount, sizeof(RDPGFX_CACHE_ENTRY_METADATA));
+
+	if (!gfx->CacheImportEntries || !pdu.cacheEntries)
+	{
+		error = CHANNEL_RC_NO_MEMORY;
+		goto fail;
+	}
+
+	while ((count < maxCount) && persistent_cache_read_entry(persistent, &entry))
+	{
+		PERSISTENT_CACHE_ENTRY* importEntry = &gfx->CacheImportEntries[count];
+
+		if (entry.cacheId != PERSISTENT_CACHE_ID_GFX)
+			continue;
+
+		if (size + entry.size > maxSize)
+			break;
+
+		*importEntry = entry;
+		importEntry->data = (BYTE*)malloc(entry.size);
+
+		if (!importEntry->data)
+		{
+			error = CHANNEL_RC_NO_MEMORY;
+			goto fail;
+		}
+
+		CopyMemory(importEntry->data, entry.data, entry.size);
+		pdu.cacheEntries[count].cacheKey = entry.key64;
+		pdu.cacheEntries[count].bitmapLength = entry.size;
+		size += entry.size;
+		gfx->CacheImportEntriesCount = ++count;
+	}
+
+	if (count > 0)
+	{
+		pdu.cacheEntriesCount = count;
+		error = rdpgfx_send_cache_import_offer_pdu(context, &pdu);
+	}
+
+fail:
+	if (error || (count == 0))
+		rdpgfx_free_cache_import_entries(gfx);
+
+	free(pdu.cacheEntries);
+	persistent_cache_free(persistent);
+	return error;
+}
+
 /**
  * Function description
  *
@@ -659,6 +835,48 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(RDPGFX_CHANNEL_CALLBACK* callback,
 	return error;
 }
 
+/**
+ * Moves the entries accepted by the server into the cache slots it assigned.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_import_cache_entries(RDPGFX_PLUGIN* gfx,
+                                        const RDPGFX_CACHE_IMPORT_REPLY_PDU* pdu)
+{
+	UINT16 index;
+	UINT16 count = MIN(pdu->importedEntriesCount, gfx->CacheImportEntriesCount);
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context || !context->ImportCacheEntry)
+		return CHANNEL_RC_OK;
+
+	for (index = 0; index < count; index++)
+	{
+		UINT error;
+		const UINT16 cacheSlot = pdu->cacheSlots[index];
+
+		/* entries the server did not import have no slot */
+		if (cacheSlot == 0)
+			continue;
+
+		if (cacheSlot > gfx->MaxCacheSlots)
+		{
+			WLog_Print(gfx->log, WLOG_ERROR, "invalid cache slot %" PRIu16 "", cacheSlot);
+			return ERROR_INVALID_DATA;
+		}
+
+		if ((error = context->ImportCacheEntry(context, cacheSlot,
+		                                       &gfx->CacheImportEntries[index])))
+		{
+			WLog_Print(gfx->log, WLOG_ERROR,
+			           "context->ImportCacheEntry failed with error %" PRIu32 "", error);
+			return error;
+		}
+	}
+
+	return CHANNEL_RC_OK;
+}
+
 /**
  * Function description
  *
@@ -666,7 +884,6 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(RDPGFX_CHANNEL_CALLBACK* callback,
  */
 static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 {
-	UINT16 index;
 	RDPGFX_CACHE_IMPORT_REPLY_PDU pdu;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
@@ -680,7 +897,7 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 
 	Stream_Read_UINT16(s, pdu.importedEntriesCount); /* cacheSlot (2 bytes) */
 
-	if (Stream_GetRemainingLength(s) / 2 < pdu.importedEntriesCount)
+	if (!Stream_CheckRequiredLengthOfSize(s, pdu.importedEntriesCount, 2))
 	{
 		WLog_Print(gfx->log, WLOG_ERROR, "not enough data!");
 		return ERROR_INVALID_DATA;
@@ -694,10 +911,8 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	for (index = 0; index < pdu.importedEntriesCount; index++)
-	{
-		Stream_Read_UINT16(s, pdu.cacheSlots[index]); /* cacheSlot (2 bytes) */
-	}
+	/* cacheSlots (2 bytes each) */
+	Stream_Read_UINT16_Array(s, pdu.cacheSlots, pdu.importedEntriesCount);
 
 	DEBUG_RDPGFX(gfx->log, "RecvCacheImportReplyPdu: importedEntriesCount: %" PRIu16 "",
 	             pdu.importedEntriesCount);
@@ -711,6 +926,10 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 			           "context->CacheImportReply failed with error %" PRIu32 "", error);
 	}
 
+	if (!error)
+		error = rdpgfx_import_cache_entries(gfx, &pdu);
+
+	rdpgfx_free_cache_import_entries(gfx);
 	free(pdu.cacheSlots);
 	return error;
 }
@@ -811,6 +1030,9 @@ static UINT rdpgfx_recv_start_frame_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStre
 	             pdu.frameId, pdu.timestamp);
 	gfx->StartDecodingTime = GetTickCount64();
 
+	if (gfx->QueuedFrames > 0)
+		gfx->QueuedFrames--;
+
 	if (context)
 	{
 		IFCALLRET(context->StartFrame, error, context, &pdu);
@@ -820,6 +1042,7 @@ static UINT rdpgfx_recv_start_frame_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStre
 			           error);
 	}
 
+	gfx->InFrame = TRUE;
 	gfx->UnacknowledgedFrames++;
 	return error;
 }
@@ -845,6 +1068,7 @@ static UINT rdpgfx_recv_end_frame_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream
 
 	Stream_Read_UINT32(s, pdu.frameId); /* frameId (4 bytes) */
 	DEBUG_RDPGFX(gfx->log, "RecvEndFramePdu: frameId: %" PRIu32 "", pdu.frameId);
+	gfx->InFrame = FALSE;
 
 	if (context)
 	{
@@ -878,7 +1102,7 @@ static UINT rdpgfx_recv_end_frame_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream
 	}
 	else
 	{
-		ack.queueDepth = QUEUE_DEPTH_UNAVAILABLE;
+		ack.queueDepth = gfx->QueuedFrames;
 
 		if ((error = rdpgfx_send_frame_acknowledge_pdu(context, &ack)))
 			WLog_Print(gfx->log, WLOG_ERROR,
@@ -1010,7 +1234,7 @@ static UINT rdpgfx_recv_wire_to_surface_1_pdu(RDPGFX_CHANNEL_CALLBACK* callback,
 		return ERROR_INVALID_DATA;
 	}
 
-	if ((error = rdpgfx_decode(gfx, &cmd)))
+	if ((error = rdpgfx_decode_queued(gfx, &cmd)))
 		WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_decode failed with error %" PRIu32 "!", error);
 
 	return error;
@@ -1133,8 +1357,6 @@ static UINT rdpgfx_recv_delete_encoding_context_pdu(RDPGFX_CHANNEL_CALLBACK* cal
  */
 static UINT rdpgfx_recv_solid_fill_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 {
-	UINT16 index;
-	RECTANGLE_16* fillRect;
 	RDPGFX_SOLID_FILL_PDU pdu;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
@@ -1171,18 +1393,14 @@ static UINT rdpgfx_recv_solid_fill_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStrea
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	for (index = 0; index < pdu.fillRectCount; index++)
+	if ((error = rdpgfx_read_rect16_array(s, pdu.fillRects, pdu.fillRectCount)))
 	{
-		fillRect = &(pdu.fillRects[index]);
-
-		if ((error = rdpgfx_read_rect16(s, fillRect)))
-		{
-			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_rect16 failed with error %" PRIu32 "!",
-			           error);
-			free(pdu.fillRects);
-			return error;
-		}
+		WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_rect16_array failed with error %" PRIu32 "!",
+		           error);
+		free(pdu.fillRects);
+		return error;
 	}
+
 	DEBUG_RDPGFX(gfx->log, "RecvSolidFillPdu: surfaceId: %" PRIu16 " fillRectCount: %" PRIu16 "",
 	             pdu.surfaceId, pdu.fillRectCount);
 
@@ -1206,8 +1424,6 @@ static UINT rdpgfx_recv_solid_fill_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStrea
  */
 static UINT rdpgfx_recv_surface_to_surface_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 {
-	UINT16 index;
-	RDPGFX_POINT16* destPt;
 	RDPGFX_SURFACE_TO_SURFACE_PDU pdu;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
@@ -1245,17 +1461,12 @@ static UINT rdpgfx_recv_surface_to_surface_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	for (index = 0; index < pdu.destPtsCount; index++)
+	if ((error = rdpgfx_read_point16_array(s, pdu.destPts, pdu.destPtsCount)))
 	{
-		destPt = &(pdu.destPts[index]);
-
-		if ((error = rdpgfx_read_point16(s, destPt)))
-		{
-			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_point16 failed with error %" PRIu32 "!",
-			           error);
-			free(pdu.destPts);
-			return error;
-		}
+		WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_point16_array failed with error %" PRIu32 "!",
+		           error);
+		free(pdu.destPts);
+		return error;
 	}
 
 	DEBUG_RDPGFX(gfx->log,
@@ -1333,8 +1544,6 @@ static UINT rdpgfx_recv_surface_to_cache_pdu(RDPGFX_CHANNEL_CALLBACK* callback,
  */
 static UINT rdpgfx_recv_cache_to_surface_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 {
-	UINT16 index;
-	RDPGFX_POINT16* destPt;
 	RDPGFX_CACHE_TO_SURFACE_PDU pdu;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
@@ -1364,17 +1573,12 @@ static UINT rdpgfx_recv_cache_to_surface_pdu(RDPGFX_CHANNEL_CALLBACK* callback,
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	for (index = 0; index < pdu.destPtsCount; index++)
+	if ((error = rdpgfx_read_point16_array(s, pdu.destPts, pdu.destPtsCount)))
 	{
-		destPt = &(pdu.destPts[index]);
-
-		if ((error = rdpgfx_read_point16(s, destPt)))
-		{
-			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_point16 failed with error %" PRIu32 "",
-			           error);
-			free(pdu.destPts);
-			return error;
-		}
+		WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_read_point16_array failed with error %" PRIu32 "",
+		           error);
+		free(pdu.destPts);
+		return error;
 	}
 
 	DEBUG_RDPGFX(gfx->log,
@@ -1574,6 +1778,17 @@ static UINT rdpgfx_recv_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 	    gfx->log, "cmdId: %s (0x%04" PRIX16 ") flags: 0x%04" PRIX16 " pduLength: %" PRIu32 "",
 	    rdpgfx_get_cmd_id_string(header.cmdId), header.cmdId, header.flags, header.pduLength);
 
+	/* everything but a surface command may use any surface, let the queued commands finish */
+	if (header.cmdId != RDPGFX_CMDID_WIRETOSURFACE_1)
+	{
+		if ((error = rdpgfx_decode_wait(gfx)))
+		{
+			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_decode failed with error %" PRIu32 "!",
+			           error);
+			return error;
+		}
+	}
+
 	switch (header.cmdId)
 	{
 		case RDPGFX_CMDID_WIRETOSURFACE_1:
@@ -1694,6 +1909,10 @@ static UINT rdpgfx_recv_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 			if ((error = rdpgfx_recv_caps_confirm_pdu(callback, s)))
 				WLog_Print(gfx->log, WLOG_ERROR,
 				           "rdpgfx_recv_caps_confirm_pdu failed with error %" PRIu32 "!", error);
+			else if ((error = rdpgfx_send_persistent_cache_offer(gfx)))
+				WLog_Print(gfx->log, WLOG_ERROR,
+				           "rdpgfx_send_persistent_cache_offer failed with error %" PRIu32 "!",
+				           error);
 
 			break;
 
@@ -1753,17 +1972,44 @@ static UINT rdpgfx_recv_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+/* The frames of a message are decoded one after the other, the ones behind the current frame
+ * are the queue depth reported with its acknowledge. */
+static UINT32 rdpgfx_count_frames(const BYTE* data, size_t length)
+{
+	size_t offset = 0;
+	UINT32 count = 0;
+
+	while (length - offset >= RDPGFX_HEADER_SIZE)
+	{
+		UINT16 cmdId;
+		UINT32 pduLength;
+		Data_Read_UINT16(&data[offset], cmdId);
+		Data_Read_UINT32(&data[offset + 4], pduLength);
+
+		if ((pduLength < RDPGFX_HEADER_SIZE) || (pduLength > length - offset))
+			break;
+
+		if (cmdId == RDPGFX_CMDID_STARTFRAME)
+			count++;
+
+		offset += pduLength;
+	}
+
+	return count;
+}
+
 static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback, wStream* data)
 {
-	wStream* s;
 	int status = 0;
-	UINT32 DstSize = 0;
-	BYTE* pDstData = NULL;
 	RDPGFX_CHANNEL_CALLBACK* callback = (RDPGFX_CHANNEL_CALLBACK*)pChannelCallback;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
+	wStream* s = gfx->ReceiveStream;
 	UINT error = CHANNEL_RC_OK;
-	status = zgfx_decompress(gfx->zgfx, Stream_Pointer(data), Stream_GetRemainingLength(data),
-	                         &pDstData, &DstSize, 0);
+
+	/* the PDUs are parsed in place, queued surface commands keep a copy of their data */
+	Stream_SetPosition(s, 0);
+	status = zgfx_decompress_to_stream(gfx->zgfx, Stream_Pointer(data),
+	                                   Stream_GetRemainingLength(data), s, 0);
 
 	if (status < 0)
 	{
@@ -1771,17 +2017,17 @@ static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback
 		return ERROR_INTERNAL_ERROR;
 	}
 
-	s = Stream_New(pDstData, DstSize);
-
-	if (!s)
-	{
-		WLog_Print(gfx->log, WLOG_ERROR, "calloc failed!");
-		return CHANNEL_RC_NO_MEMORY;
-	}
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+	gfx->QueuedFrames = rdpgfx_count_frames(Stream_Buffer(s), Stream_Length(s));
 
 	while (Stream_GetPosition(s) < Stream_Length(s))
 	{
-		if ((error = rdpgfx_recv_pdu(callback, s)))
+		FREERDP_TRACE_SPAN_BEGIN(span);
+		error = rdpgfx_recv_pdu(callback, s);
+		FREERDP_TRACE_SPAN_END(span, "rdpgfx_recv_pdu");
+
+		if (error)
 		{
 			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_recv_pdu failed with error %" PRIu32 "!",
 			           error);
@@ -1789,7 +2035,6 @@ static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback
 		}
 	}
 
-	Stream_Free(s, TRUE);
 	return error;
 }
 
@@ -1834,8 +2079,12 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
 
 	DEBUG_RDPGFX(gfx->log, "OnClose");
+	rdpgfx_decode_wait(gfx);
+	gfx->InFrame = FALSE;
 	free_surfaces(context, gfx->SurfaceTable);
+	rdpgfx_save_persistent_cache(gfx);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
+	rdpgfx_free_cache_import_entries(gfx);
 
 	free(callback);
 	gfx->UnacknowledgedFrames = 0;
@@ -2078,6 +2327,15 @@ RdpgfxClientContext* rdpgfx_client_context_new(rdpSettings* settings)
 		return NULL;
 	}
 
+	if (!rdpgfx_decoders_init(gfx))
+	{
+		rdpgfx_decoders_uninit(gfx);
+		HashTable_Free(gfx->SurfaceTable);
+		free(gfx);
+		WLog_ERR(TAG, "rdpgfx_decoders_init failed!");
+		return NULL;
+	}
+
 	gfx->ThinClient = gfx->settings->GfxThinClient;
 	gfx->SmallCache = gfx->settings->GfxSmallCache;
 	gfx->Progressive = gfx->settings->GfxProgressive;
@@ -2095,6 +2353,7 @@ RdpgfxClientContext* rdpgfx_client_context_new(rdpSettings* settings)
 
 	if (!context)
 	{
+		rdpgfx_decoders_uninit(gfx);
 		free(gfx);
 		WLog_ERR(TAG, "calloc failed!");
 		return NULL;
@@ -2116,12 +2375,25 @@ RdpgfxClientContext* rdpgfx_client_context_new(rdpSettings* settings)
 
 	if (!gfx->zgfx)
 	{
+		rdpgfx_decoders_uninit(gfx);
 		free(gfx);
 		free(context);
 		WLog_ERR(TAG, "zgfx_context_new failed!");
 		return NULL;
 	}
 
+	gfx->ReceiveStream = Stream_New(NULL, RDPGFX_RECEIVE_BUFFER_SIZE);
+
+	if (!gfx->ReceiveStream)
+	{
+		zgfx_context_free(gfx->zgfx);
+		rdpgfx_decoders_uninit(gfx);
+		free(gfx);
+		free(context);
+		WLog_ERR(TAG, "Stream_New failed!");
+		return NULL;
+	}
+
 	return context;
 }
 
@@ -2135,8 +2407,10 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 
 	gfx = (RDPGFX_PLUGIN*)context->handle;
 
+	rdpgfx_decoders_uninit(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
+	rdpgfx_free_cache_import_entries(gfx);
 
 	if (gfx->listener_callback)
 	{
@@ -2150,6 +2424,7 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 		gfx->zgfx = NULL;
 	}
 
+	Stream_Free(gfx->ReceiveStream, TRUE);
 	HashTable_Free(gfx->SurfaceTable);
 	free(context);
 	free(gfx);
@@ -25,6 +25,7 @@
 #include <freerdp/addin.h>
 
 #include <winpr/wlog.h>
+#include <winpr/pool.h>
 #include <winpr/collections.h>
 
 #include <freerdp/client/rdpgfx.h>
@@ -68,16 +69,28 @@ typedef struct
 	UINT32 capsFilter;
 
 	ZGFX_CONTEXT* zgfx;
+	/* the decompressed messages, reused and grown as needed */
+	wStream* ReceiveStream;
 	UINT32 UnacknowledgedFrames;
 	UINT32 TotalDecodedFrames;
 	UINT64 StartDecodingTime;
+	/* frames of the message being processed that did not start yet */
+	UINT32 QueuedFrames;
 	BOOL suspendFrameAcks;
 	BOOL sendFrameAcks;
 
 	wHashTable* SurfaceTable;
 
+	/* AVC commands of different surfaces within a frame decode in parallel */
+	BOOL InFrame;
+	wHashTable* SurfaceDecoders;
+	PTP_POOL DecodePool;
+	TP_CALLBACK_ENVIRON DecodeEnvironment;
+
 	UINT16 MaxCacheSlots;
 	void* CacheSlots[25600];
+	PERSISTENT_CACHE_ENTRY* CacheImportEntries;
+	UINT16 CacheImportEntriesCount;
 	rdpContext* rdpcontext;
 
 	wLog* log;
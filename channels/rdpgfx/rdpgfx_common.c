@@ -170,6 +170,33 @@ UINT rdpgfx_read_point16(wStream* s, RDPGFX_POINT16* pt16)
 	return CHANNEL_RC_OK;
 }
 
+/**
+ * Reads count points, the length is validated once for all of them
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT rdpgfx_read_point16_array(wStream* s, RDPGFX_POINT16* pts, size_t count)
+{
+	size_t index;
+
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(pts || (count == 0));
+
+	if (!Stream_CheckRequiredLengthOfSize(s, count, 4))
+	{
+		WLog_ERR(TAG, "not enough data!");
+		return ERROR_INVALID_DATA;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		Stream_Read_UINT16(s, pts[index].x); /* x (2 bytes) */
+		Stream_Read_UINT16(s, pts[index].y); /* y (2 bytes) */
+	}
+
+	return CHANNEL_RC_OK;
+}
+
 /**
  * Function description
  *
@@ -215,6 +242,39 @@ UINT rdpgfx_read_rect16(wStream* s, RECTANGLE_16* rect16)
 	return CHANNEL_RC_OK;
 }
 
+/**
+ * Reads count rectangles, the length is validated once for all of them
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT rdpgfx_read_rect16_array(wStream* s, RECTANGLE_16* rects, size_t count)
+{
+	size_t index;
+
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(rects || (count == 0));
+
+	if (!Stream_CheckRequiredLengthOfSize(s, count, 8))
+	{
+		WLog_ERR(TAG, "not enough data!");
+		return ERROR_INVALID_DATA;
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		RECTANGLE_16* rect16 = &rects[index];
+		Stream_Read_UINT16(s, rect16->left);   /* left (2 bytes) */
+		Stream_Read_UINT16(s, rect16->top);    /* top (2 bytes) */
+		Stream_Read_UINT16(s, rect16->right);  /* right (2 bytes) */
+		Stream_Read_UINT16(s, rect16->bottom); /* bottom (2 bytes) */
+
+		if ((rect16->left >= rect16->right) || (rect16->top >= rect16->bottom))
+			return ERROR_INVALID_DATA;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
 /**
  * Function description
  *
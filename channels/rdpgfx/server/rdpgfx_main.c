@@ -47,6 +47,11 @@
  *
  * @return new stream
  */
+/* Space kept in front of every packet so zgfx can frame up to 16 segments (about 1 MiB) in place */
+#define RDPGFX_SERVER_HEADROOM (7 + 16 * 5)
+/* A batch reserves room for 256 segments (about 16 MiB) */
+#define RDPGFX_SERVER_BATCH_HEADROOM (7 + 256 * 5)
+
 static INLINE UINT32 rdpgfx_pdu_length(UINT32 dataLen)
 {
 	return RDPGFX_HEADER_SIZE + dataLen;
@@ -85,55 +90,137 @@ static INLINE BOOL rdpgfx_server_packet_complete_header(wStream* s, size_t start
 
 /**
  * Function description
- * Send the stream for rdpgfx server packet.
- * The packet would be compressed according to [MS-RDPEGFX].
+ * Compress the packets built behind headroom bytes of s and write them to the channel.
+ * The packets would be compressed according to [MS-RDPEGFX].
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT rdpgfx_server_packet_send(RdpgfxServerContext* context, wStream* s)
+static UINT rdpgfx_server_packet_write(RdpgfxServerContext* context, wStream* s, size_t headroom)
 {
+	int status;
 	UINT error;
 	UINT32 flags = 0;
 	ULONG written;
-	BYTE* pSrcData = Stream_Buffer(s);
-	UINT32 SrcSize = Stream_GetPosition(s);
-	wStream* fs;
-	/* Allocate new stream with enough capacity. Additional overhead is
-	 * descriptor (1 bytes) + segmentCount (2 bytes) + uncompressedSize (4 bytes)
-	 * + segmentCount * size (4 bytes) */
-	fs = Stream_New(NULL, SrcSize + 7 + (SrcSize / ZGFX_SEGMENTED_MAXSIZE + 1) * 4);
+	size_t start = 0;
+	BYTE* pSrcData = Stream_Buffer(s) + headroom;
+	UINT32 SrcSize = Stream_GetPosition(s) - headroom;
+	wStream* fs = s;
+	/* The packets were built behind the headroom, frame them in the same buffer */
+	status = zgfx_compress_in_place(context->priv->zgfx, s, headroom, &start, &flags);
 
-	if (!fs)
+	if (status < 0)
 	{
-		WLog_ERR(TAG, "Stream_New failed!");
-		error = CHANNEL_RC_NO_MEMORY;
+		WLog_ERR(TAG, "zgfx_compress_in_place failed!");
+		error = ERROR_INTERNAL_ERROR;
 		goto out;
 	}
 
-	if (zgfx_compress_to_stream(context->priv->zgfx, fs, pSrcData, SrcSize, &flags) < 0)
+	if (status == 0)
 	{
-		WLog_ERR(TAG, "zgfx_compress_to_stream failed!");
-		error = ERROR_INTERNAL_ERROR;
-		goto out;
+		/* Allocate new stream with enough capacity. Additional overhead is
+		 * descriptor (1 bytes) + segmentCount (2 bytes) + uncompressedSize (4 bytes)
+		 * + segmentCount * size (4 bytes) */
+		fs = Stream_New(NULL, SrcSize + 7 + (SrcSize / ZGFX_SEGMENTED_MAXSIZE + 1) * 4);
+
+		if (!fs)
+		{
+			WLog_ERR(TAG, "Stream_New failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out;
+		}
+
+		if (zgfx_compress_to_stream(context->priv->zgfx, fs, pSrcData, SrcSize, &flags) < 0)
+		{
+			WLog_ERR(TAG, "zgfx_compress_to_stream failed!");
+			error = ERROR_INTERNAL_ERROR;
+			goto out;
+		}
 	}
 
-	if (!WTSVirtualChannelWrite(context->priv->rdpgfx_channel, (PCHAR)Stream_Buffer(fs),
-	                            Stream_GetPosition(fs), &written))
+	if (!WTSVirtualChannelWrite(context->priv->rdpgfx_channel,
+	                            (PCHAR)Stream_Buffer(fs) + start, Stream_GetPosition(fs) - start,
+	                            &written))
 	{
 		WLog_ERR(TAG, "WTSVirtualChannelWrite failed!");
 		error = ERROR_INTERNAL_ERROR;
 		goto out;
 	}
 
-	if (written < Stream_GetPosition(fs))
+	if (written < Stream_GetPosition(fs) - start)
 	{
 		WLog_WARN(TAG, "Unexpected bytes written: %" PRIu32 "/%" PRIuz "", written,
-		          Stream_GetPosition(fs));
+		          Stream_GetPosition(fs) - start);
 	}
 
 	error = CHANNEL_RC_OK;
 out:
-	Stream_Free(fs, TRUE);
+	if (fs != s)
+		Stream_Free(fs, TRUE);
+
+	return error;
+}
+
+/**
+ * Function description
+ * Get a stream to build rdpgfx packets of size bytes in. Between BeginBatch and
+ * EndBatch this is the batch stream, otherwise a new stream with headroom.
+ * The start of the packets is kept in packetStart.
+ *
+ * @return stream positioned at the start of the packets
+ */
+static wStream* rdpgfx_server_packet_new(RdpgfxServerContext* context, size_t size)
+{
+	wStream* s;
+	RdpgfxServerPrivate* priv = context->priv;
+
+	if (priv->batching)
+	{
+		if (!Stream_EnsureRemainingCapacity(priv->batch, size))
+			return NULL;
+
+		priv->packetStart = Stream_GetPosition(priv->batch);
+		return priv->batch;
+	}
+
+	s = Stream_New(NULL, RDPGFX_SERVER_HEADROOM + size);
+
+	if (!s)
+		return NULL;
+
+	Stream_Seek(s, RDPGFX_SERVER_HEADROOM);
+	priv->packetStart = RDPGFX_SERVER_HEADROOM;
+	return s;
+}
+
+/**
+ * Function description
+ * Drop the packets of a stream from rdpgfx_server_packet_new.
+ */
+static void rdpgfx_server_packet_free(RdpgfxServerContext* context, wStream* s)
+{
+	RdpgfxServerPrivate* priv = context->priv;
+
+	if (s && (s == priv->batch))
+		Stream_SetPosition(s, priv->packetStart);
+	else
+		Stream_Free(s, TRUE);
+}
+
+/**
+ * Function description
+ * Send the stream for rdpgfx server packet. Packets built in the batch stream
+ * stay there until EndBatch.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_server_packet_send(RdpgfxServerContext* context, wStream* s)
+{
+	UINT error;
+
+	if (s == context->priv->batch)
+		return CHANNEL_RC_OK;
+
+	error = rdpgfx_server_packet_write(context, s, RDPGFX_SERVER_HEADROOM);
 	Stream_Free(s, TRUE);
 	return error;
 }
@@ -150,12 +237,13 @@ out:
  *
  * @return new stream
  */
-static wStream* rdpgfx_server_single_packet_new(UINT16 cmdId, UINT32 dataLen)
+static wStream* rdpgfx_server_single_packet_new(RdpgfxServerContext* context, UINT16 cmdId,
+                                                UINT32 dataLen)
 {
 	UINT error;
 	wStream* s;
 	UINT32 pduLength = rdpgfx_pdu_length(dataLen);
-	s = Stream_New(NULL, pduLength);
+	s = rdpgfx_server_packet_new(context, pduLength);
 
 	if (!s)
 	{
@@ -171,7 +259,7 @@ static wStream* rdpgfx_server_single_packet_new(UINT16 cmdId, UINT32 dataLen)
 
 	return s;
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return NULL;
 }
 
@@ -186,7 +274,7 @@ error:
 static INLINE UINT rdpgfx_server_single_packet_send(RdpgfxServerContext* context, wStream* s)
 {
 	/* Fill actual length */
-	rdpgfx_server_packet_complete_header(s, 0);
+	rdpgfx_server_packet_complete_header(s, context->priv->packetStart);
 	return rdpgfx_server_packet_send(context, s);
 }
 
@@ -207,7 +295,7 @@ static UINT rdpgfx_send_caps_confirm_pdu(RdpgfxServerContext* context,
 	capsSet = capsConfirm->capsSet;
 	WINPR_ASSERT(capsSet);
 
-	s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_CAPSCONFIRM,
+	s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_CAPSCONFIRM,
 	                                    RDPGFX_CAPSET_BASE_SIZE + capsSet->length);
 
 	if (!s)
@@ -251,7 +339,7 @@ static UINT rdpgfx_send_reset_graphics_pdu(RdpgfxServerContext* context,
 		return ERROR_INVALID_DATA;
 	}
 
-	s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_RESETGRAPHICS,
+	s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_RESETGRAPHICS,
 	                                    RDPGFX_RESET_GRAPHICS_PDU_SIZE - RDPGFX_HEADER_SIZE);
 
 	if (!s)
@@ -275,7 +363,7 @@ static UINT rdpgfx_send_reset_graphics_pdu(RdpgfxServerContext* context,
 	}
 
 	/* pad (total size must be 340 bytes) */
-	Stream_SetPosition(s, RDPGFX_RESET_GRAPHICS_PDU_SIZE);
+	Stream_SetPosition(s, context->priv->packetStart + RDPGFX_RESET_GRAPHICS_PDU_SIZE);
 	return rdpgfx_server_single_packet_send(context, s);
 }
 
@@ -287,7 +375,7 @@ static UINT rdpgfx_send_reset_graphics_pdu(RdpgfxServerContext* context,
 static UINT rdpgfx_send_evict_cache_entry_pdu(RdpgfxServerContext* context,
                                               const RDPGFX_EVICT_CACHE_ENTRY_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_EVICTCACHEENTRY, 2);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_EVICTCACHEENTRY, 2);
 
 	if (!s)
 	{
@@ -308,7 +396,7 @@ static UINT rdpgfx_send_cache_import_reply_pdu(RdpgfxServerContext* context,
                                                const RDPGFX_CACHE_IMPORT_REPLY_PDU* pdu)
 {
 	UINT16 index;
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_CACHEIMPORTREPLY,
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_CACHEIMPORTREPLY,
 	                                             2 + 2 * pdu->importedEntriesCount);
 
 	if (!s)
@@ -336,7 +424,7 @@ static UINT rdpgfx_send_cache_import_reply_pdu(RdpgfxServerContext* context,
 static UINT rdpgfx_send_create_surface_pdu(RdpgfxServerContext* context,
                                            const RDPGFX_CREATE_SURFACE_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_CREATESURFACE, 7);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_CREATESURFACE, 7);
 
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(pdu);
@@ -364,7 +452,7 @@ static UINT rdpgfx_send_create_surface_pdu(RdpgfxServerContext* context,
 static UINT rdpgfx_send_delete_surface_pdu(RdpgfxServerContext* context,
                                            const RDPGFX_DELETE_SURFACE_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_DELETESURFACE, 2);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_DELETESURFACE, 2);
 
 	if (!s)
 	{
@@ -402,7 +490,7 @@ static UINT rdpgfx_send_start_frame_pdu(RdpgfxServerContext* context,
                                         const RDPGFX_START_FRAME_PDU* pdu)
 {
 	wStream* s =
-	    rdpgfx_server_single_packet_new(RDPGFX_CMDID_STARTFRAME, RDPGFX_START_FRAME_PDU_SIZE);
+	    rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_STARTFRAME, RDPGFX_START_FRAME_PDU_SIZE);
 
 	if (!s)
 	{
@@ -421,7 +509,7 @@ static UINT rdpgfx_send_start_frame_pdu(RdpgfxServerContext* context,
  */
 static UINT rdpgfx_send_end_frame_pdu(RdpgfxServerContext* context, const RDPGFX_END_FRAME_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_ENDFRAME, RDPGFX_END_FRAME_PDU_SIZE);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_ENDFRAME, RDPGFX_END_FRAME_PDU_SIZE);
 
 	if (!s)
 	{
@@ -706,7 +794,7 @@ static UINT rdpgfx_send_surface_command(RdpgfxServerContext* context,
 {
 	UINT error = CHANNEL_RC_OK;
 	wStream* s;
-	s = rdpgfx_server_single_packet_new(rdpgfx_surface_command_cmdid(cmd),
+	s = rdpgfx_server_single_packet_new(context, rdpgfx_surface_command_cmdid(cmd),
 	                                    rdpgfx_estimate_surface_command(cmd));
 
 	if (!s)
@@ -725,7 +813,7 @@ static UINT rdpgfx_send_surface_command(RdpgfxServerContext* context,
 
 	return rdpgfx_server_single_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -758,7 +846,7 @@ static UINT rdpgfx_send_surface_frame_command(RdpgfxServerContext* context,
 		size += rdpgfx_pdu_length(RDPGFX_END_FRAME_PDU_SIZE);
 	}
 
-	s = Stream_New(NULL, size);
+	s = rdpgfx_server_packet_new(context, size);
 
 	if (!s)
 	{
@@ -824,7 +912,7 @@ static UINT rdpgfx_send_surface_frame_command(RdpgfxServerContext* context,
 
 	return rdpgfx_server_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -836,7 +924,7 @@ error:
 static UINT rdpgfx_send_delete_encoding_context_pdu(RdpgfxServerContext* context,
                                                     const RDPGFX_DELETE_ENCODING_CONTEXT_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_DELETEENCODINGCONTEXT, 6);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_DELETEENCODINGCONTEXT, 6);
 
 	if (!s)
 	{
@@ -861,7 +949,7 @@ static UINT rdpgfx_send_solid_fill_pdu(RdpgfxServerContext* context,
 	UINT16 index;
 	RECTANGLE_16* fillRect;
 	wStream* s =
-	    rdpgfx_server_single_packet_new(RDPGFX_CMDID_SOLIDFILL, 8 + 8 * pdu->fillRectCount);
+	    rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_SOLIDFILL, 8 + 8 * pdu->fillRectCount);
 
 	if (!s)
 	{
@@ -893,7 +981,7 @@ static UINT rdpgfx_send_solid_fill_pdu(RdpgfxServerContext* context,
 
 	return rdpgfx_server_single_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -909,7 +997,7 @@ static UINT rdpgfx_send_surface_to_surface_pdu(RdpgfxServerContext* context,
 	UINT16 index;
 	RDPGFX_POINT16* destPt;
 	wStream* s =
-	    rdpgfx_server_single_packet_new(RDPGFX_CMDID_SURFACETOSURFACE, 14 + 4 * pdu->destPtsCount);
+	    rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_SURFACETOSURFACE, 14 + 4 * pdu->destPtsCount);
 
 	if (!s)
 	{
@@ -942,7 +1030,7 @@ static UINT rdpgfx_send_surface_to_surface_pdu(RdpgfxServerContext* context,
 
 	return rdpgfx_server_single_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -955,7 +1043,7 @@ static UINT rdpgfx_send_surface_to_cache_pdu(RdpgfxServerContext* context,
                                              const RDPGFX_SURFACE_TO_CACHE_PDU* pdu)
 {
 	UINT error = CHANNEL_RC_OK;
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_SURFACETOCACHE, 20);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_SURFACETOCACHE, 20);
 
 	if (!s)
 	{
@@ -976,7 +1064,7 @@ static UINT rdpgfx_send_surface_to_cache_pdu(RdpgfxServerContext* context,
 
 	return rdpgfx_server_single_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -992,7 +1080,7 @@ static UINT rdpgfx_send_cache_to_surface_pdu(RdpgfxServerContext* context,
 	UINT16 index;
 	RDPGFX_POINT16* destPt;
 	wStream* s =
-	    rdpgfx_server_single_packet_new(RDPGFX_CMDID_CACHETOSURFACE, 6 + 4 * pdu->destPtsCount);
+	    rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_CACHETOSURFACE, 6 + 4 * pdu->destPtsCount);
 
 	if (!s)
 	{
@@ -1017,7 +1105,7 @@ static UINT rdpgfx_send_cache_to_surface_pdu(RdpgfxServerContext* context,
 
 	return rdpgfx_server_single_packet_send(context, s);
 error:
-	Stream_Free(s, TRUE);
+	rdpgfx_server_packet_free(context, s);
 	return error;
 }
 
@@ -1029,7 +1117,7 @@ error:
 static UINT rdpgfx_send_map_surface_to_output_pdu(RdpgfxServerContext* context,
                                                   const RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_MAPSURFACETOOUTPUT, 12);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_MAPSURFACETOOUTPUT, 12);
 
 	if (!s)
 	{
@@ -1052,7 +1140,7 @@ static UINT rdpgfx_send_map_surface_to_output_pdu(RdpgfxServerContext* context,
 static UINT rdpgfx_send_map_surface_to_window_pdu(RdpgfxServerContext* context,
                                                   const RDPGFX_MAP_SURFACE_TO_WINDOW_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_MAPSURFACETOWINDOW, 18);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_MAPSURFACETOWINDOW, 18);
 
 	if (!s)
 	{
@@ -1071,7 +1159,7 @@ static UINT
 rdpgfx_send_map_surface_to_scaled_window_pdu(RdpgfxServerContext* context,
                                              const RDPGFX_MAP_SURFACE_TO_SCALED_WINDOW_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_MAPSURFACETOSCALEDWINDOW, 26);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_MAPSURFACETOSCALEDWINDOW, 26);
 
 	if (!s)
 	{
@@ -1088,6 +1176,73 @@ rdpgfx_send_map_surface_to_scaled_window_pdu(RdpgfxServerContext* context,
 	return rdpgfx_server_single_packet_send(context, s);
 }
 
+/**
+ * Function description
+ * Collect the following packets in one buffer until EndBatch.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_server_begin_batch(RdpgfxServerContext* context)
+{
+	RdpgfxServerPrivate* priv;
+
+	WINPR_ASSERT(context);
+	priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	if (priv->batching)
+	{
+		WLog_ERR(TAG, "batch already started");
+		return ERROR_INVALID_STATE;
+	}
+
+	if (!priv->batch)
+	{
+		priv->batch = Stream_New(NULL, RDPGFX_SERVER_BATCH_HEADROOM + 0x10000);
+
+		if (!priv->batch)
+		{
+			WLog_ERR(TAG, "Stream_New failed!");
+			return CHANNEL_RC_NO_MEMORY;
+		}
+	}
+
+	/* The previous batch sealed the stream to its compressed length */
+	Stream_SetLength(priv->batch, Stream_Capacity(priv->batch));
+	Stream_SetPosition(priv->batch, RDPGFX_SERVER_BATCH_HEADROOM);
+	priv->batching = TRUE;
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ * Compress the collected packets and write them with a single channel write,
+ * or drop them if send is FALSE.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_server_end_batch(RdpgfxServerContext* context, BOOL send)
+{
+	RdpgfxServerPrivate* priv;
+
+	WINPR_ASSERT(context);
+	priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	if (!priv->batching)
+	{
+		WLog_ERR(TAG, "no batch started");
+		return ERROR_INVALID_STATE;
+	}
+
+	priv->batching = FALSE;
+
+	if (!send || (Stream_GetPosition(priv->batch) == RDPGFX_SERVER_BATCH_HEADROOM))
+		return CHANNEL_RC_OK;
+
+	return rdpgfx_server_packet_write(context, priv->batch, RDPGFX_SERVER_BATCH_HEADROOM);
+}
+
 /**
  * Function description
  *
@@ -1284,7 +1439,7 @@ static UINT
 rdpgfx_send_map_surface_to_scaled_output_pdu(RdpgfxServerContext* context,
                                              const RDPGFX_MAP_SURFACE_TO_SCALED_OUTPUT_PDU* pdu)
 {
-	wStream* s = rdpgfx_server_single_packet_new(RDPGFX_CMDID_MAPSURFACETOSCALEDOUTPUT, 20);
+	wStream* s = rdpgfx_server_single_packet_new(context, RDPGFX_CMDID_MAPSURFACETOSCALEDOUTPUT, 20);
 
 	if (!s)
 	{
@@ -1591,6 +1746,8 @@ RdpgfxServerContext* rdpgfx_server_context_new(HANDLE vcm)
 	context->CapsConfirm = rdpgfx_send_caps_confirm_pdu;
 	context->FrameAcknowledge = NULL;
 	context->QoeFrameAcknowledge = NULL;
+	context->BeginBatch = rdpgfx_server_begin_batch;
+	context->EndBatch = rdpgfx_server_end_batch;
 	context->priv = priv = (RdpgfxServerPrivate*)calloc(1, sizeof(RdpgfxServerPrivate));
 
 	if (!priv)
@@ -1624,7 +1781,10 @@ void rdpgfx_server_context_free(RdpgfxServerContext* context)
 	rdpgfx_server_close(context);
 
 	if (context->priv)
+	{
 		Stream_Free(context->priv->input_stream, TRUE);
+		Stream_Free(context->priv->batch, TRUE);
+	}
 
 	free(context->priv);
 	free(context);
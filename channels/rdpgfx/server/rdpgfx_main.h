@@ -35,6 +35,9 @@ struct s_rdpgfx_server_private
 	wStream* input_stream;
 	BOOL isOpened;
 	BOOL isReady;
+	wStream* batch; /* packets collected between BeginBatch and EndBatch */
+	BOOL batching;
+	size_t packetStart;
 };
 
 #endif /* FREERDP_CHANNEL_RDPGFX_SERVER_MAIN_H */
@@ -49,6 +49,11 @@
 #include "rdpsnd_common.h"
 #include "rdpsnd_main.h"
 
+/* low latency playback speeds up or slows down by at most 1/RDPSND_STRETCH_DIVISOR */
+#define RDPSND_STRETCH_DIVISOR 16
+/* arrival gaps longer than the packet by this are pauses, not jitter */
+#define RDPSND_MAX_JITTER 1000
+
 typedef struct
 {
 	IWTSVirtualChannelCallback iface;
@@ -111,6 +116,13 @@ struct rdpsnd_plugin
 	UINT32 startPlayTime;
 	size_t totalPlaySize;
 
+	/* low latency playback */
+	BOOL lowLatency;
+	UINT64 lastArrivalTime;
+	UINT64 lastDuration;
+	INT64 jitter; /* smoothed arrival jitter in 1/16 ms */
+	UINT64 playEndTime;
+
 	char* subsystem;
 	char* device_name;
 
@@ -424,6 +436,9 @@ static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT32 wFormatNo,
 		rdpsnd->wCurrentFormatNo = wFormatNo;
 		rdpsnd->startPlayTime = 0;
 		rdpsnd->totalPlaySize = 0;
+		rdpsnd->lastArrivalTime = 0;
+		rdpsnd->jitter = 0;
+		rdpsnd->playEndTime = 0;
 	}
 
 	return TRUE;
@@ -583,6 +598,170 @@ static BOOL rdpsnd_detect_overrun(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* form
 	}
 }
 
+static UINT64 rdpsnd_pcm_duration(const AUDIO_FORMAT* format, size_t size)
+{
+	const UINT64 bps = 1ull * format->nChannels * format->wBitsPerSample * format->nSamplesPerSec;
+
+	if (bps == 0)
+		return 0;
+
+	return 8000ull * size / bps;
+}
+
+static void rdpsnd_update_jitter(rdpsndPlugin* rdpsnd, UINT64 duration)
+{
+	if (rdpsnd->lastArrivalTime != 0)
+	{
+		const INT64 interval = (INT64)(rdpsnd->wArrivalTime - rdpsnd->lastArrivalTime);
+		INT64 deviation = interval - (INT64)rdpsnd->lastDuration;
+
+		if (deviation < 0)
+			deviation = -deviation;
+
+		/* RFC 3550 estimate: J += (|D| - J) / 16 */
+		if (deviation < RDPSND_MAX_JITTER)
+			rdpsnd->jitter += (deviation * 16 - rdpsnd->jitter) / 16;
+	}
+
+	rdpsnd->lastArrivalTime = rdpsnd->wArrivalTime;
+	rdpsnd->lastDuration = duration;
+}
+
+/* Resamples 16 bit PCM from srcFrames to dstFrames by linear interpolation */
+static BOOL rdpsnd_stretch_pcm(const AUDIO_FORMAT* format, const BYTE* data, size_t srcFrames,
+                               size_t dstFrames, wStream* out)
+{
+	size_t x, channel;
+	const size_t channels = format->nChannels;
+
+	if ((srcFrames < 2) || (dstFrames < 2))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(out, dstFrames * channels * 2))
+		return FALSE;
+
+	for (x = 0; x < dstFrames; x++)
+	{
+		/* position in the source in 1/65536 frames */
+		const UINT64 pos = (UINT64)x * (srcFrames - 1) * 65536 / (dstFrames - 1);
+		const size_t index = (size_t)(pos >> 16);
+		const INT64 fraction = (INT64)(pos & 0xFFFF);
+		const size_t next = (index + 1 < srcFrames) ? index + 1 : index;
+
+		for (channel = 0; channel < channels; channel++)
+		{
+			const BYTE* a = &data[(index * channels + channel) * 2];
+			const BYTE* b = &data[(next * channels + channel) * 2];
+			const INT64 sa = (INT16)(a[0] | (a[1] << 8));
+			const INT64 sb = (INT16)(b[0] | (b[1] << 8));
+			Stream_Write_INT16(out, (INT16)(sa + (sb - sa) * fraction / 65536));
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Plays with an adaptive jitter buffer: the audio queued on the device is kept between half
+ * and all of the packet duration plus twice the arrival jitter, speeding up or slowing down
+ * the playback slightly to get there.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpsnd_play_low_latency(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* format,
+                                    const BYTE* data, size_t size, UINT* latency)
+{
+	UINT64 now;
+	UINT64 target;
+	UINT64 duration;
+	UINT64 buffered = 0;
+	size_t frames, bpf;
+	UINT status = CHANNEL_RC_OK;
+	AUDIO_FORMAT pcmFormat = *format;
+	wStream* stretched = NULL;
+	wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
+
+	if (!pcmData)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (!rdpsnd->device->FormatSupported(rdpsnd->device, format))
+	{
+		if (!freerdp_dsp_decode(rdpsnd->dsp_context, format, data, size, pcmData))
+		{
+			status = ERROR_INTERNAL_ERROR;
+			goto out;
+		}
+
+		Stream_SealLength(pcmData);
+		data = Stream_Buffer(pcmData);
+		size = Stream_Length(pcmData);
+		pcmFormat.wFormatTag = WAVE_FORMAT_PCM;
+		pcmFormat.wBitsPerSample = 16;
+	}
+
+	/* the duration of compressed audio the device decodes itself is unknown */
+	if (pcmFormat.wFormatTag != WAVE_FORMAT_PCM)
+	{
+		*latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, data, size);
+		goto out;
+	}
+
+	now = GetTickCount64();
+	duration = rdpsnd_pcm_duration(&pcmFormat, size);
+	rdpsnd_update_jitter(rdpsnd, duration);
+
+	if (rdpsnd->playEndTime > now)
+		buffered = rdpsnd->playEndTime - now;
+
+	target = duration + (UINT64)rdpsnd->jitter / 8 + rdpsnd->latency;
+
+	if (buffered > target + 4 * duration)
+	{
+		WLog_Print(rdpsnd->log, WLOG_DEBUG,
+		           "%s Buffer overrun pending %" PRIu64 " ms dropping %" PRIu64 " ms",
+		           rdpsnd_is_dyn_str(rdpsnd->dynamic), buffered, duration);
+		*latency = (UINT)buffered;
+		goto out;
+	}
+
+	bpf = pcmFormat.nChannels * 2ull;
+	frames = size / bpf;
+
+	if ((pcmFormat.wBitsPerSample == 16) && (frames >= 2 * RDPSND_STRETCH_DIVISOR))
+	{
+		size_t dstFrames = frames;
+
+		if (buffered > target)
+			dstFrames -= frames / RDPSND_STRETCH_DIVISOR;
+		else if (buffered < target / 2)
+			dstFrames += frames / RDPSND_STRETCH_DIVISOR;
+
+		if (dstFrames != frames)
+		{
+			stretched = StreamPool_Take(rdpsnd->pool, dstFrames * bpf);
+
+			if (stretched && rdpsnd_stretch_pcm(&pcmFormat, data, frames, dstFrames, stretched))
+			{
+				data = Stream_Buffer(stretched);
+				size = Stream_GetPosition(stretched);
+				duration = rdpsnd_pcm_duration(&pcmFormat, size);
+			}
+		}
+	}
+
+	*latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, data, size);
+	rdpsnd->playEndTime = now + buffered + duration;
+
+	/* backends without a real estimate report a fixed latency */
+	*latency = MAX(*latency, (UINT)buffered);
+out:
+	if (stretched)
+		Stream_Release(stretched);
+
+	Stream_Release(pcmData);
+	return status;
+}
+
 static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 {
 	BYTE* data;
@@ -603,7 +782,14 @@ static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 	           "%s Wave: cBlockNo: %" PRIu8 " wTimeStamp: %" PRIu16 ", size: %" PRIdz,
 	           rdpsnd_is_dyn_str(rdpsnd->dynamic), rdpsnd->cBlockNo, rdpsnd->wTimeStamp, size);
 
-	if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
+	if (rdpsnd->device && rdpsnd->attached && rdpsnd->lowLatency)
+	{
+		const UINT status = rdpsnd_play_low_latency(rdpsnd, format, data, size, &latency);
+
+		if (status != CHANNEL_RC_OK)
+			return status;
+	}
+	else if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
 	{
 		UINT status = CHANNEL_RC_OK;
 		wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
@@ -869,6 +1055,8 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 		{ "latency", COMMAND_LINE_VALUE_REQUIRED, "<latency>", NULL, NULL, -1, NULL, "latency" },
 		{ "quality", COMMAND_LINE_VALUE_REQUIRED, "<quality mode>", NULL, NULL, -1, NULL,
 		  "quality mode" },
+		{ "low-latency", COMMAND_LINE_VALUE_FLAG, "", NULL, NULL, -1, NULL,
+		  "low latency playback" },
 		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
 	};
 	rdpsnd->wQualityMode = HIGH_QUALITY; /* default quality mode */
@@ -959,6 +1147,10 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 
 				rdpsnd->wQualityMode = (UINT16)wQualityMode;
 			}
+			CommandLineSwitchCase(arg, "low-latency")
+			{
+				rdpsnd->lowLatency = TRUE;
+			}
 			CommandLineSwitchDefault(arg)
 			{
 			}
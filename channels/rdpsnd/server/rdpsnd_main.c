@@ -340,6 +340,15 @@ static UINT rdpsnd_server_select_format(RdpsndServerContext* context, UINT16 cli
 			bs = (format->nBlockAlign - 7 * format->nChannels) * 2 / format->nChannels + 2;
 			context->priv->out_frames -= context->priv->out_frames % bs;
 
+			if (context->priv->out_frames < bs)
+				context->priv->out_frames = bs;
+
+			break;
+
+		case WAVE_FORMAT_OPUS:
+			/* at least one 20 ms frame has to be encoded per wave */
+			bs = context->src_format->nSamplesPerSec / 25;
+
 			if (context->priv->out_frames < bs)
 				context->priv->out_frames = bs;
 
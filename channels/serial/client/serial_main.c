@@ -63,7 +63,8 @@ typedef struct
 
 	/* one thread per pending IRP and indexed according their CompletionId */
 	wListDictionary* IrpThreads;
-	UINT32 IrpThreadToBeTerminatedCount;
+	/* CompletionIds of the threads that completed their IRP and are exiting */
+	wArrayList* TerminatingIrpThreads;
 	CRITICAL_SECTION TerminatingIrpThreadsLock;
 	rdpContext* rdpcontext;
 } SERIAL_DEVICE;
@@ -242,14 +243,16 @@ static UINT serial_process_irp_read(SERIAL_DEVICE* serial, IRP* irp)
 	Stream_Read_UINT32(irp->input, Length); /* Length (4 bytes) */
 	Stream_Read_UINT64(irp->input, Offset); /* Offset (8 bytes) */
 	Stream_Seek(irp->input, 20);            /* Padding (20 bytes) */
-	buffer = (BYTE*)calloc(Length, sizeof(BYTE));
 
-	if (buffer == NULL)
+	/* the data is read right behind the Length field of the response */
+	if (!Stream_EnsureRemainingCapacity(irp->output, 4ull + Length))
 	{
 		irp->IoStatus = STATUS_NO_MEMORY;
 		goto error_handle;
 	}
 
+	buffer = Stream_Pointer(irp->output) + 4;
+
 	/* MS-RDPESP 3.2.5.1.4: If the Offset field is not set to 0, the value MUST be ignored
 	 * WINPR_ASSERT(Offset == 0);
 	 */
@@ -273,20 +276,7 @@ static UINT serial_process_irp_read(SERIAL_DEVICE* serial, IRP* irp)
 	           serial->device.name);
 error_handle:
 	Stream_Write_UINT32(irp->output, nbRead); /* Length (4 bytes) */
-
-	if (nbRead > 0)
-	{
-		if (!Stream_EnsureRemainingCapacity(irp->output, nbRead))
-		{
-			WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
-			free(buffer);
-			return CHANNEL_RC_NO_MEMORY;
-		}
-
-		Stream_Write(irp->output, buffer, nbRead); /* ReadData */
-	}
-
-	free(buffer);
+	Stream_Seek(irp->output, nbRead);         /* ReadData */
 	return CHANNEL_RC_OK;
 }
 
@@ -493,7 +483,9 @@ static DWORD WINAPI irp_thread_func(LPVOID arg)
 	}
 
 	EnterCriticalSection(&data->serial->TerminatingIrpThreadsLock);
-	data->serial->IrpThreadToBeTerminatedCount++;
+	if (!ArrayList_Append(data->serial->TerminatingIrpThreads,
+	                      (void*)(ULONG_PTR)data->irp->CompletionId))
+		WLog_ERR(TAG, "ArrayList_Append failed!");
 	error = data->irp->Complete(data->irp);
 	LeaveCriticalSection(&data->serial->TerminatingIrpThreadsLock);
 error_out:
@@ -515,6 +507,7 @@ static void create_irp_thread(SERIAL_DEVICE* serial, IRP* irp)
 	HANDLE irpThread;
 	HANDLE previousIrpThread;
 	uintptr_t key;
+	size_t i;
 	/* for a test/debug purpose, uncomment the code below to get a
 	 * single thread for all IRPs. NB: two IRPs could not be
 	 * processed at the same time, typically two concurent
@@ -527,56 +520,28 @@ static void create_irp_thread(SERIAL_DEVICE* serial, IRP* irp)
 	 */
 	EnterCriticalSection(&serial->TerminatingIrpThreadsLock);
 
-	while (serial->IrpThreadToBeTerminatedCount > 0)
+	/* Cleaning up terminating irp threads. They completed their IRP
+	 * and only have to exit, there is no need to poll the pending
+	 * ones. See also: irp_thread_func() */
+	for (i = 0; i < ArrayList_Count(serial->TerminatingIrpThreads); i++)
 	{
-		/* Cleaning up termitating and pending irp
-		 * threads. See also: irp_thread_func() */
-		HANDLE cirpThread;
-		ULONG_PTR* ids;
-		int i, nbIds;
-		nbIds = ListDictionary_GetKeys(serial->IrpThreads, &ids);
-
-		for (i = 0; i < nbIds; i++)
-		{
-			/* Checking if ids[i] is terminating or pending */
-			DWORD waitResult;
-			ULONG_PTR id = ids[i];
-			cirpThread = ListDictionary_GetItemValue(serial->IrpThreads, (void*)id);
-			/* FIXME: not quite sure a zero timeout is a good thing to check whether a thread is
-			 * stil alived or not */
-			waitResult = WaitForSingleObject(cirpThread, 0);
-
-			if (waitResult == WAIT_OBJECT_0)
-			{
-				/* terminating thread */
-				/* WLog_Print(serial->log, WLOG_DEBUG, "IRP thread with CompletionId=%"PRIuz"
-				 * naturally died", id); */
-				CloseHandle(cirpThread);
-				ListDictionary_Remove(serial->IrpThreads, (void*)id);
-				serial->IrpThreadToBeTerminatedCount--;
-			}
-			else if (waitResult != WAIT_TIMEOUT)
-			{
-				/* unexpected thread state */
-				WLog_Print(serial->log, WLOG_WARN,
-				           "WaitForSingleObject, got an unexpected result=0x%" PRIX32 "\n",
-				           waitResult);
-				WINPR_ASSERT(FALSE);
-			}
+		const ULONG_PTR id = (ULONG_PTR)ArrayList_GetItem(serial->TerminatingIrpThreads, i);
+		HANDLE cirpThread = ListDictionary_GetItemValue(serial->IrpThreads, (void*)id);
 
-			/* pending thread (but not yet terminating thread) if waitResult == WAIT_TIMEOUT */
-		}
+		if (!cirpThread)
+			continue;
 
-		if (serial->IrpThreadToBeTerminatedCount > 0)
+		if (WaitForSingleObject(cirpThread, INFINITE) == WAIT_FAILED)
 		{
-			WLog_Print(serial->log, WLOG_DEBUG, "%" PRIu32 " IRP thread(s) not yet terminated",
-			           serial->IrpThreadToBeTerminatedCount);
-			Sleep(1); /* 1 ms */
+			WLog_Print(serial->log, WLOG_WARN, "WaitForSingleObject failed!");
+			WINPR_ASSERT(FALSE);
 		}
 
-		free(ids);
+		CloseHandle(cirpThread);
+		ListDictionary_Remove(serial->IrpThreads, (void*)id);
 	}
 
+	ArrayList_Clear(serial->TerminatingIrpThreads);
 	LeaveCriticalSection(&serial->TerminatingIrpThreadsLock);
 	/* NB: At this point and thanks to the synchronization we're
 	 * sure that the incoming IRP uses well a recycled
@@ -688,6 +653,7 @@ static void terminate_pending_irp_threads(SERIAL_DEVICE* serial)
 	}
 
 	ListDictionary_Clear(serial->IrpThreads);
+	ArrayList_Clear(serial->TerminatingIrpThreads);
 	free(ids);
 }
 
@@ -788,6 +754,7 @@ static UINT serial_free(DEVICE* device)
 	Stream_Free(serial->device.data, TRUE);
 	MessageQueue_Free(serial->MainIrpQueue);
 	ListDictionary_Free(serial->IrpThreads);
+	ArrayList_Free(serial->TerminatingIrpThreads);
 	DeleteCriticalSection(&serial->TerminatingIrpThreadsLock);
 	free(serial);
 	return CHANNEL_RC_OK;
@@ -929,7 +896,15 @@ UINT serial_DeviceServiceEntry(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints)
 			goto error_out;
 		}
 
-		serial->IrpThreadToBeTerminatedCount = 0;
+		serial->TerminatingIrpThreads = ArrayList_New(FALSE);
+
+		if (!serial->TerminatingIrpThreads)
+		{
+			WLog_ERR(TAG, "ArrayList_New failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto error_out;
+		}
+
 		InitializeCriticalSection(&serial->TerminatingIrpThreadsLock);
 
 		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)serial)))
@@ -953,6 +928,7 @@ UINT serial_DeviceServiceEntry(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints)
 error_out:
 #ifdef __linux__ /* to be removed */
 	ListDictionary_Free(serial->IrpThreads);
+	ArrayList_Free(serial->TerminatingIrpThreads);
 	MessageQueue_Free(serial->MainIrpQueue);
 	Stream_Free(serial->device.data, TRUE);
 	free(serial);
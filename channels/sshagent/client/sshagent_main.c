@@ -50,12 +50,17 @@
 #include <winpr/synch.h>
 #include <winpr/thread.h>
 #include <winpr/stream.h>
+#include <winpr/collections.h>
 
 #include "sshagent_main.h"
 #include <freerdp/channels/log.h>
 
 #define TAG CHANNELS_TAG("sshagent.client")
 
+/* Agent replies are drained into one buffer and forwarded with a single write,
+ * drdynvc fragments it as required */
+#define SSHAGENT_READ_SIZE (64 * 1024)
+
 typedef struct
 {
 	IWTSListenerCallback iface;
@@ -77,8 +82,10 @@ typedef struct
 
 	rdpContext* rdpcontext;
 	int agent_fd;
-	HANDLE thread;
-	CRITICAL_SECTION lock;
+	HANDLE event;
+	BOOL eof;
+	BOOL closed;
+	BOOL released;
 } SSHAGENT_CHANNEL_CALLBACK;
 
 typedef struct
@@ -88,6 +95,14 @@ typedef struct
 	SSHAGENT_LISTENER_CALLBACK* listener_callback;
 
 	rdpContext* rdpcontext;
+
+	/* One reader thread serves all agent connections */
+	CRITICAL_SECTION lock;
+	wArrayList* connections;
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE changedEvent;
+	BYTE* buffer;
 } SSHAGENT_PLUGIN;
 
 /**
@@ -125,53 +140,186 @@ static int connect_to_sshagent(const char* udspath)
 	return agent_fd;
 }
 
+static void sshagent_connection_free(SSHAGENT_CHANNEL_CALLBACK* callback)
+{
+	if (!callback)
+		return;
+
+	if (callback->event)
+		CloseHandle(callback->event);
+
+	if (callback->agent_fd != -1)
+		close(callback->agent_fd);
+
+	free(callback);
+}
+
 /**
- * Entry point for thread to read from the ssh-agent socket and forward
- * the data to RDP
+ * Drains whatever the ssh-agent has ready into the plugin buffer and forwards
+ * it to RDP, one channel write per full buffer. Called with the plugin lock held.
  *
- * @return NULL
+ * @return 0 on success, otherwise a Win32 error code
  */
-static DWORD WINAPI sshagent_read_thread(LPVOID data)
+static UINT sshagent_forward(SSHAGENT_PLUGIN* sshagent, SSHAGENT_CHANNEL_CALLBACK* callback)
 {
-	SSHAGENT_CHANNEL_CALLBACK* callback = (SSHAGENT_CHANNEL_CALLBACK*)data;
-	BYTE buffer[4096];
-	int going = 1;
+	size_t used = 0;
 	UINT status = CHANNEL_RC_OK;
 
-	while (going)
+	while (status == CHANNEL_RC_OK)
 	{
-		int bytes_read = read(callback->agent_fd, buffer, sizeof(buffer));
+		const ssize_t bytes_read = recv(callback->agent_fd, &sshagent->buffer[used],
+		                                SSHAGENT_READ_SIZE - used, MSG_DONTWAIT);
 
 		if (bytes_read == 0)
 		{
 			/* Socket closed cleanly at other end */
-			going = 0;
+			callback->eof = TRUE;
+			break;
 		}
 		else if (bytes_read < 0)
 		{
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+
 			if (errno != EINTR)
 			{
 				WLog_ERR(TAG, "Error reading from sshagent, errno=%d", errno);
+				callback->eof = TRUE;
 				status = ERROR_READ_FAULT;
-				going = 0;
 			}
 		}
 		else
 		{
-			/* Something read: forward to virtual channel */
-			status = callback->channel->Write(callback->channel, bytes_read, buffer, NULL);
+			used += (size_t)bytes_read;
+
+			if (used == SSHAGENT_READ_SIZE)
+			{
+				status = callback->channel->Write(callback->channel, (ULONG)used,
+				                                  sshagent->buffer, NULL);
+				used = 0;
+			}
+		}
+	}
+
+	/* Something read: forward to virtual channel */
+	if ((used > 0) && (status == CHANNEL_RC_OK))
+		status = callback->channel->Write(callback->channel, (ULONG)used, sshagent->buffer, NULL);
+
+	if (status != CHANNEL_RC_OK)
+		callback->eof = TRUE;
+
+	return status;
+}
+
+/**
+ * Entry point for the thread reading from all ssh-agent sockets and forwarding
+ * the data to RDP
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static DWORD WINAPI sshagent_read_thread(LPVOID data)
+{
+	SSHAGENT_PLUGIN* sshagent = (SSHAGENT_PLUGIN*)data;
+	WINPR_WAIT_SET* set = winpr_WaitSetNew();
+	SSHAGENT_CHANNEL_CALLBACK* ready[MAXIMUM_WAIT_OBJECTS];
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	UINT status = CHANNEL_RC_OK;
+
+	if (!set)
+	{
+		status = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	while (status == CHANNEL_RC_OK)
+	{
+		DWORD x, count = 2, signaled = 0;
+		DWORD indices[MAXIMUM_WAIT_OBJECTS];
+		size_t index;
+
+		handles[0] = sshagent->stopEvent;
+		handles[1] = sshagent->changedEvent;
+
+		EnterCriticalSection(&sshagent->lock);
+		/* the connections are read below, a change made after this sets the event again */
+		ResetEvent(sshagent->changedEvent);
+
+		for (index = 0; index < ArrayList_Count(sshagent->connections); index++)
+		{
+			SSHAGENT_CHANNEL_CALLBACK* callback =
+			    ArrayList_GetItem(sshagent->connections, index);
+
+			if (callback->closed)
+				callback->released = TRUE;
+			else if (!callback->eof && (count < ARRAYSIZE(handles)))
+			{
+				ready[count] = callback;
+				handles[count++] = callback->event;
+			}
+		}
+
+		LeaveCriticalSection(&sshagent->lock);
+
+		if (!winpr_WaitSetUpdate(set, count, handles))
+		{
+			status = ERROR_INTERNAL_ERROR;
+			break;
+		}
+
+		/* Connections the channel closed are released once they left the set */
+		EnterCriticalSection(&sshagent->lock);
+
+		for (index = ArrayList_Count(sshagent->connections); index > 0; index--)
+		{
+			SSHAGENT_CHANNEL_CALLBACK* callback =
+			    ArrayList_GetItem(sshagent->connections, index - 1);
 
-			if (status != CHANNEL_RC_OK)
+			if (callback->released)
 			{
-				going = 0;
+				ArrayList_RemoveAt(sshagent->connections, index - 1);
+				sshagent_connection_free(callback);
 			}
 		}
+
+		LeaveCriticalSection(&sshagent->lock);
+
+		if (winpr_WaitSetWaitEx(set, INFINITE, indices, ARRAYSIZE(indices), &signaled) !=
+		    WAIT_OBJECT_0)
+		{
+			status = GetLastError();
+			WLog_ERR(TAG, "winpr_WaitSetWaitEx failed with error %" PRIu32 "!", status);
+			break;
+		}
+
+		for (x = 0; x < signaled; x++)
+		{
+			UINT error = CHANNEL_RC_OK;
+
+			if (indices[x] == 0)
+				goto out;
+
+			if (indices[x] == 1)
+				continue;
+
+			EnterCriticalSection(&sshagent->lock);
+
+			if (!ready[indices[x]]->closed)
+				error = sshagent_forward(sshagent, ready[indices[x]]);
+
+			LeaveCriticalSection(&sshagent->lock);
+
+			/* A failing connection stops forwarding, the others keep going */
+			if (error != CHANNEL_RC_OK)
+				setChannelError(sshagent->rdpcontext, error,
+				                "sshagent_read_thread reported an error");
+		}
 	}
 
-	close(callback->agent_fd);
+out:
+	winpr_WaitSetFree(set);
 
 	if (status != CHANNEL_RC_OK)
-		setChannelError(callback->rdpcontext, status, "sshagent_read_thread reported an error");
+		setChannelError(sshagent->rdpcontext, status, "sshagent_read_thread reported an error");
 
 	ExitThread(status);
 	return status;
@@ -224,21 +372,15 @@ static UINT sshagent_on_data_received(IWTSVirtualChannelCallback* pChannelCallba
 static UINT sshagent_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 {
 	SSHAGENT_CHANNEL_CALLBACK* callback = (SSHAGENT_CHANNEL_CALLBACK*)pChannelCallback;
-	/* Call shutdown() to wake up the read() in sshagent_read_thread(). */
-	shutdown(callback->agent_fd, SHUT_RDWR);
-	EnterCriticalSection(&callback->lock);
-
-	if (WaitForSingleObject(callback->thread, INFINITE) == WAIT_FAILED)
-	{
-		UINT error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "!", error);
-		return error;
-	}
+	SSHAGENT_PLUGIN* sshagent = (SSHAGENT_PLUGIN*)callback->plugin;
 
-	CloseHandle(callback->thread);
-	LeaveCriticalSection(&callback->lock);
-	DeleteCriticalSection(&callback->lock);
-	free(callback);
+	/* The reader thread may still wait on the socket, it frees the connection
+	 * once it rebuilt its wait set */
+	EnterCriticalSection(&sshagent->lock);
+	shutdown(callback->agent_fd, SHUT_RDWR);
+	callback->closed = TRUE;
+	LeaveCriticalSection(&sshagent->lock);
+	SetEvent(sshagent->changedEvent);
 	return CHANNEL_RC_OK;
 }
 
@@ -254,6 +396,7 @@ static UINT sshagent_on_new_channel_connection(IWTSListenerCallback* pListenerCa
 {
 	SSHAGENT_CHANNEL_CALLBACK* callback;
 	SSHAGENT_LISTENER_CALLBACK* listener_callback = (SSHAGENT_LISTENER_CALLBACK*)pListenerCallback;
+	SSHAGENT_PLUGIN* sshagent = (SSHAGENT_PLUGIN*)listener_callback->plugin;
 	callback = (SSHAGENT_CHANNEL_CALLBACK*)calloc(1, sizeof(SSHAGENT_CHANNEL_CALLBACK));
 
 	if (!callback)
@@ -272,27 +415,56 @@ static UINT sshagent_on_new_channel_connection(IWTSListenerCallback* pListenerCa
 		return CHANNEL_RC_INITIALIZATION_ERROR;
 	}
 
-	InitializeCriticalSection(&callback->lock);
 	callback->iface.OnDataReceived = sshagent_on_data_received;
 	callback->iface.OnClose = sshagent_on_close;
 	callback->plugin = listener_callback->plugin;
 	callback->channel_mgr = listener_callback->channel_mgr;
 	callback->channel = pChannel;
 	callback->rdpcontext = listener_callback->rdpcontext;
-	callback->thread = CreateThread(NULL, 0, sshagent_read_thread, (void*)callback, 0, NULL);
+	callback->event =
+	    CreateFileDescriptorEventA(NULL, FALSE, FALSE, callback->agent_fd, WINPR_FD_READ);
+
+	EnterCriticalSection(&sshagent->lock);
 
-	if (!callback->thread)
+	if (!callback->event || !ArrayList_Append(sshagent->connections, callback))
 	{
-		WLog_ERR(TAG, "CreateThread failed!");
-		DeleteCriticalSection(&callback->lock);
-		free(callback);
+		LeaveCriticalSection(&sshagent->lock);
+		WLog_ERR(TAG, "failed to register the ssh-agent connection!");
+		sshagent_connection_free(callback);
 		return CHANNEL_RC_INITIALIZATION_ERROR;
 	}
 
+	LeaveCriticalSection(&sshagent->lock);
+	SetEvent(sshagent->changedEvent);
 	*ppCallback = (IWTSVirtualChannelCallback*)callback;
 	return CHANNEL_RC_OK;
 }
 
+static void sshagent_plugin_free(SSHAGENT_PLUGIN* sshagent)
+{
+	size_t index;
+
+	if (!sshagent)
+		return;
+
+	/* The reader thread is gone, nothing waits on the connections any more */
+	for (index = 0; index < ArrayList_Count(sshagent->connections); index++)
+		sshagent_connection_free(ArrayList_GetItem(sshagent->connections, index));
+
+	ArrayList_Free(sshagent->connections);
+
+	if (sshagent->stopEvent)
+		CloseHandle(sshagent->stopEvent);
+
+	if (sshagent->changedEvent)
+		CloseHandle(sshagent->changedEvent);
+
+	DeleteCriticalSection(&sshagent->lock);
+	free(sshagent->buffer);
+	free(sshagent->listener_callback);
+	free(sshagent);
+}
+
 /**
  * Callback for when the plugin is initialised
  *
@@ -324,6 +496,12 @@ static UINT sshagent_plugin_initialize(IWTSPlugin* pPlugin, IWTSVirtualChannelMa
 		return CHANNEL_RC_INITIALIZATION_ERROR;
 	}
 
+	if (!(sshagent->thread = CreateThread(NULL, 0, sshagent_read_thread, sshagent, 0, NULL)))
+	{
+		WLog_ERR(TAG, "CreateThread failed!");
+		return CHANNEL_RC_INITIALIZATION_ERROR;
+	}
+
 	return pChannelMgr->CreateListener(pChannelMgr, "SSHAGENT", 0,
 	                                   (IWTSListenerCallback*)sshagent->listener_callback, NULL);
 }
@@ -336,7 +514,18 @@ static UINT sshagent_plugin_initialize(IWTSPlugin* pPlugin, IWTSVirtualChannelMa
 static UINT sshagent_plugin_terminated(IWTSPlugin* pPlugin)
 {
 	SSHAGENT_PLUGIN* sshagent = (SSHAGENT_PLUGIN*)pPlugin;
-	free(sshagent);
+
+	if (sshagent->thread)
+	{
+		SetEvent(sshagent->stopEvent);
+
+		if (WaitForSingleObject(sshagent->thread, INFINITE) == WAIT_FAILED)
+			WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "!", GetLastError());
+
+		CloseHandle(sshagent->thread);
+	}
+
+	sshagent_plugin_free(sshagent);
 	return CHANNEL_RC_OK;
 }
 
@@ -361,6 +550,20 @@ UINT sshagent_DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		InitializeCriticalSection(&sshagent->lock);
+		sshagent->connections = ArrayList_New(FALSE);
+		sshagent->buffer = malloc(SSHAGENT_READ_SIZE);
+		sshagent->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		sshagent->changedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (!sshagent->connections || !sshagent->buffer || !sshagent->stopEvent ||
+		    !sshagent->changedEvent)
+		{
+			WLog_ERR(TAG, "failed to allocate the reader state!");
+			sshagent_plugin_free(sshagent);
+			return CHANNEL_RC_NO_MEMORY;
+		}
+
 		sshagent->iface.Initialize = sshagent_plugin_initialize;
 		sshagent->iface.Connected = NULL;
 		sshagent->iface.Disconnected = NULL;
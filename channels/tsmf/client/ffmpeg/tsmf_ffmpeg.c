@@ -31,6 +31,16 @@
 #include <libavcodec/avcodec.h>
 #include <libavutil/common.h>
 
+#ifdef WITH_VAAPI
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+#include <libavutil/hwcontext.h>
+#else
+#pragma warning You have asked for VA - API decoding, \
+    but your version of libavcodec is too old !Disabling.
+#undef WITH_VAAPI
+#endif
+#endif
+
 #include "tsmf_constants.h"
 #include "tsmf_decoder.h"
 
@@ -68,6 +78,10 @@
 #define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
 #endif
 
+#ifdef WITH_VAAPI
+#define VAAPI_DEVICE "/dev/dri/renderD128"
+#endif
+
 typedef struct
 {
 	ITSMFDecoder iface;
@@ -86,6 +100,11 @@ typedef struct
 	BYTE* decoded_data;
 	UINT32 decoded_size;
 	UINT32 decoded_size_max;
+
+#ifdef WITH_VAAPI
+	AVBufferRef* hwctx;
+	AVFrame* sw_frame;
+#endif
 } TSMFFFmpegDecoder;
 
 static BOOL tsmf_ffmpeg_init_context(ITSMFDecoder* decoder)
@@ -102,6 +121,135 @@ static BOOL tsmf_ffmpeg_init_context(ITSMFDecoder* decoder)
 	return TRUE;
 }
 
+#ifdef WITH_VAAPI
+static enum AVPixelFormat tsmf_ffmpeg_get_format(struct AVCodecContext* ctx,
+                                                 const enum AVPixelFormat* fmts)
+{
+	const enum AVPixelFormat* p;
+
+	/* libavcodec drops VAAPI from the list and asks again if the hardware
+	 * can not decode the stream, so the software fallback is automatic */
+	for (p = fmts; *p != AV_PIX_FMT_NONE; p++)
+	{
+		if (*p == AV_PIX_FMT_VAAPI)
+			return *p;
+	}
+
+	return avcodec_default_get_format(ctx, fmts);
+}
+
+static void tsmf_ffmpeg_init_hwaccel(TSMFFFmpegDecoder* mdecoder)
+{
+	int err;
+
+	switch (mdecoder->codec_id)
+	{
+		case AV_CODEC_ID_H264:
+		case AV_CODEC_ID_VC1:
+		case AV_CODEC_ID_WMV3:
+		case AV_CODEC_ID_MPEG2VIDEO:
+			break;
+
+		default:
+			return;
+	}
+
+	err = av_hwdevice_ctx_create(&mdecoder->hwctx, AV_HWDEVICE_TYPE_VAAPI, VAAPI_DEVICE, NULL, 0);
+
+	if (err < 0)
+	{
+		WLog_WARN(TAG, "Could not initialize hardware decoder, falling back to software: %s",
+		          av_err2str(err));
+		mdecoder->hwctx = NULL;
+		return;
+	}
+
+	mdecoder->sw_frame = av_frame_alloc();
+	mdecoder->codec_context->hw_device_ctx = av_buffer_ref(mdecoder->hwctx);
+
+	if (!mdecoder->sw_frame || !mdecoder->codec_context->hw_device_ctx)
+	{
+		av_frame_free(&mdecoder->sw_frame);
+		av_buffer_unref(&mdecoder->codec_context->hw_device_ctx);
+		av_buffer_unref(&mdecoder->hwctx);
+		return;
+	}
+
+	mdecoder->codec_context->get_format = tsmf_ffmpeg_get_format;
+}
+
+/* Downloads a VAAPI surface and repacks it as I420, the only planar format the
+ * presentation path and the other decoders hand out */
+static BOOL tsmf_ffmpeg_transfer_frame(TSMFFFmpegDecoder* mdecoder)
+{
+	int err;
+	UINT32 x, y;
+	BYTE* dst;
+	const AVFrame* src = mdecoder->sw_frame;
+	const UINT32 width = mdecoder->codec_context->width;
+	const UINT32 height = mdecoder->codec_context->height;
+	const UINT32 chromaWidth = (width + 1) / 2;
+	const UINT32 chromaHeight = (height + 1) / 2;
+
+	av_frame_unref(mdecoder->sw_frame);
+	err = av_hwframe_transfer_data(mdecoder->sw_frame, mdecoder->frame, 0);
+
+	if (err < 0)
+	{
+		WLog_ERR(TAG, "av_hwframe_transfer_data failed: %s", av_err2str(err));
+		return FALSE;
+	}
+
+	if ((src->format != AV_PIX_FMT_NV12) && (src->format != AV_PIX_FMT_YUV420P))
+	{
+		WLog_ERR(TAG, "unsupported hardware frame format %d", src->format);
+		return FALSE;
+	}
+
+	mdecoder->decoded_size = width * height + 2 * chromaWidth * chromaHeight;
+	mdecoder->decoded_data = calloc(1, mdecoder->decoded_size);
+
+	if (!mdecoder->decoded_data)
+		return FALSE;
+
+	dst = mdecoder->decoded_data;
+
+	for (y = 0; y < height; y++)
+	{
+		memcpy(dst, &src->data[0][y * src->linesize[0]], width);
+		dst += width;
+	}
+
+	if (src->format == AV_PIX_FMT_YUV420P)
+	{
+		for (y = 0; y < chromaHeight; y++)
+		{
+			memcpy(dst, &src->data[1][y * src->linesize[1]], chromaWidth);
+			memcpy(&dst[chromaWidth * chromaHeight], &src->data[2][y * src->linesize[2]],
+			       chromaWidth);
+			dst += chromaWidth;
+		}
+	}
+	else
+	{
+		BYTE* dstV = &dst[chromaWidth * chromaHeight];
+
+		for (y = 0; y < chromaHeight; y++)
+		{
+			const BYTE* uv = &src->data[1][y * src->linesize[1]];
+
+			for (x = 0; x < chromaWidth; x++)
+			{
+				*dst++ = uv[2 * x];
+				*dstV++ = uv[2 * x + 1];
+			}
+		}
+	}
+
+	return TRUE;
+}
+#endif
+
 static BOOL tsmf_ffmpeg_init_video_stream(ITSMFDecoder* decoder, const TS_AM_MEDIA_TYPE* media_type)
 {
 	TSMFFFmpegDecoder* mdecoder = (TSMFFFmpegDecoder*)decoder;
@@ -114,6 +262,9 @@ static BOOL tsmf_ffmpeg_init_video_stream(ITSMFDecoder* decoder, const TS_AM_MED
 	mdecoder->frame = avcodec_alloc_frame();
 #else
 	mdecoder->frame = av_frame_alloc();
+#endif
+#ifdef WITH_VAAPI
+	tsmf_ffmpeg_init_hwaccel(mdecoder);
 #endif
 	return TRUE;
 }
@@ -361,6 +512,12 @@ static BOOL tsmf_ffmpeg_decode_video(ITSMFDecoder* decoder, const BYTE* data, UI
 		WLog_ERR(TAG, "data_size %" PRIu32 ", no frame is decoded.", data_size);
 		ret = FALSE;
 	}
+#ifdef WITH_VAAPI
+	else if (mdecoder->frame->format == AV_PIX_FMT_VAAPI)
+	{
+		ret = tsmf_ffmpeg_transfer_frame(mdecoder);
+	}
+#endif
 	else
 	{
 		DEBUG_TSMF("linesize[0] %d linesize[1] %d linesize[2] %d linesize[3] %d "
@@ -564,6 +721,9 @@ static UINT32 tsmf_ffmpeg_get_decoded_format(ITSMFDecoder* decoder)
 
 	switch (mdecoder->codec_context->pix_fmt)
 	{
+#ifdef WITH_VAAPI
+		case AV_PIX_FMT_VAAPI:
+#endif
 		case AV_PIX_FMT_YUV420P:
 			return RDP_PIXFMT_I420;
 
@@ -597,12 +757,19 @@ static void tsmf_ffmpeg_free(ITSMFDecoder* decoder)
 		av_free(mdecoder->frame);
 
 	free(mdecoder->decoded_data);
+#ifdef WITH_VAAPI
+	av_frame_free(&mdecoder->sw_frame);
+	av_buffer_unref(&mdecoder->hwctx);
+#endif
 
 	if (mdecoder->codec_context)
 	{
 		if (mdecoder->prepared)
 			avcodec_close(mdecoder->codec_context);
 
+#ifdef WITH_VAAPI
+		av_buffer_unref(&mdecoder->codec_context->hw_device_ctx);
+#endif
 		free(mdecoder->codec_context->extradata);
 		av_free(mdecoder->codec_context);
 	}
@@ -259,10 +259,14 @@ static void func_iso_callback(struct libusb_transfer* transfer)
 		{
 			int i;
 			UINT32 index = 0;
+			UINT32 runIndex = 0;
+			UINT32 runLength = 0;
+			const unsigned char* runBuffer = NULL;
 			BYTE* dataStart = Stream_Pointer(user_data->data);
 			Stream_SetPosition(user_data->data,
 			                   40); /* TS_URB_ISOCH_TRANSFER_RESULT IsoPacket offset */
 
+			/* The packets are compacted in place, adjacent ones are moved with a single copy */
 			for (i = 0; i < transfer->num_iso_packets; i++)
 			{
 				const UINT32 act_len = transfer->iso_packet_desc[i].actual_length;
@@ -276,14 +280,24 @@ static void func_iso_callback(struct libusb_transfer* transfer)
 				{
 					const unsigned char* packetBuffer =
 					    libusb_get_iso_packet_buffer_simple(transfer, i);
-					BYTE* data = dataStart + index;
 
-					if (data != packetBuffer)
-						memmove(data, packetBuffer, act_len);
+					if (!runBuffer || (packetBuffer != runBuffer + runLength))
+					{
+						if ((runLength > 0) && (dataStart + runIndex != runBuffer))
+							memmove(dataStart + runIndex, runBuffer, runLength);
 
+						runIndex = index;
+						runLength = 0;
+						runBuffer = packetBuffer;
+					}
+
+					runLength += act_len;
 					index += act_len;
 				}
 			}
+
+			if ((runLength > 0) && (dataStart + runIndex != runBuffer))
+				memmove(dataStart + runIndex, runBuffer, runLength);
 		}
 			/* fallthrough */
 
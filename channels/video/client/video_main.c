@@ -105,8 +105,9 @@ typedef struct
 	UINT64 hnsDuration;
 	MAPPED_GEOMETRY* geometry;
 	UINT32 w, h;
-	UINT32 scanline;
-	BYTE* surfaceData;
+	UINT32 iStride[3];
+	BYTE* pYUVData[3];
+	BYTE* surfaceData; /* I420, converted only if the frame is presented */
 	PresentationContext* presentation;
 } VideoFrame;
 
@@ -293,6 +294,7 @@ static VideoFrame* VideoFrame_new(VideoClientContextPriv* priv, PresentationCont
 {
 	VideoFrame* frame;
 	const VideoSurface* surface;
+	UINT32 chromaHeight;
 
 	WINPR_ASSERT(priv);
 	WINPR_ASSERT(presentation);
@@ -309,14 +311,20 @@ static VideoFrame* VideoFrame_new(VideoClientContextPriv* priv, PresentationCont
 	frame->presentation = presentation;
 	frame->publishTime = presentation->lastPublishTime;
 	frame->geometry = geom;
-	frame->w = surface->alignedWidth;
-	frame->h = surface->alignedHeight;
-	frame->scanline = surface->scanline;
-
-	frame->surfaceData = BufferPool_Take(priv->surfacePool, frame->scanline * frame->h * 1ull);
+	frame->w = surface->w;
+	frame->h = surface->h;
+	frame->iStride[0] = frame->w;
+	frame->iStride[1] = frame->iStride[2] = (frame->w + 1) / 2;
+	chromaHeight = (frame->h + 1) / 2;
+
+	frame->surfaceData = BufferPool_Take(
+	    priv->surfacePool, frame->iStride[0] * frame->h + 2ull * frame->iStride[1] * chromaHeight);
 	if (!frame->surfaceData)
 		goto fail;
 
+	frame->pYUVData[0] = frame->surfaceData;
+	frame->pYUVData[1] = frame->pYUVData[0] + frame->iStride[0] * frame->h;
+	frame->pYUVData[2] = frame->pYUVData[1] + frame->iStride[1] * chromaHeight;
 	return frame;
 
 fail:
@@ -324,6 +332,57 @@ fail:
 	return NULL;
 }
 
+static void VideoFrame_copy(VideoFrame* frame, const BYTE* pYUVData[3], const UINT32 iStride[3])
+{
+	size_t x, y;
+
+	WINPR_ASSERT(frame);
+
+	for (x = 0; x < 3; x++)
+	{
+		const UINT32 height = (x == 0) ? frame->h : (frame->h + 1) / 2;
+		const BYTE* src = pYUVData[x];
+		BYTE* dst = frame->pYUVData[x];
+
+		for (y = 0; y < height; y++)
+		{
+			memcpy(dst, src, frame->iStride[x]);
+			src += iStride[x];
+			dst += frame->iStride[x];
+		}
+	}
+}
+
+static BOOL video_present(VideoClientContext* video, PresentationContext* presentation,
+                          const BYTE* pYUVData[3], const UINT32 iStride[3])
+{
+	VideoSurface* surface;
+	const primitives_t* prims = primitives_get();
+	prim_size_t roi;
+
+	WINPR_ASSERT(video);
+	WINPR_ASSERT(presentation);
+
+	surface = presentation->surface;
+	WINPR_ASSERT(surface);
+
+	/* an overlay converts and scales the frame itself */
+	if (video->showYUVSurface &&
+	    video->showYUVSurface(video, surface, pYUVData, iStride, presentation->ScaledWidth,
+	                          presentation->ScaledHeight))
+		return TRUE;
+
+	roi.width = surface->w;
+	roi.height = surface->h;
+	if (prims->YUV420ToRGB_8u_P3AC4R(pYUVData, iStride, surface->data, surface->scanline,
+	                                 surface->format, &roi) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	WINPR_ASSERT(video->showSurface);
+	return video->showSurface(video, surface, presentation->ScaledWidth,
+	                          presentation->ScaledHeight);
+}
+
 void VideoClientContextPriv_free(VideoClientContextPriv* priv)
 {
 	if (!priv)
@@ -714,11 +773,10 @@ static void video_timer(VideoClientContext* video, UINT64 now)
 	presentation = frame->presentation;
 
 	priv->publishedFrames++;
-	memcpy(presentation->surface->data, frame->surfaceData, frame->scanline * frame->h * 1ull);
-
-	WINPR_ASSERT(video->showSurface);
-	video->showSurface(video, presentation->surface, presentation->ScaledWidth,
-	                   presentation->ScaledHeight);
+	{
+		const BYTE* pYUVData[3] = { frame->pYUVData[0], frame->pYUVData[1], frame->pYUVData[2] };
+		video_present(video, presentation, pYUVData, frame->iStride);
+	}
 
 	VideoFrame_free(&frame);
 
@@ -839,15 +897,22 @@ static UINT video_VideoData(VideoClientContext* context, const TSMM_VIDEO_DATA*
 
 	if (data->CurrentPacketIndex == data->PacketsInSample)
 	{
-		VideoSurface* surface = presentation->surface;
 		H264_CONTEXT* h264 = presentation->h264;
 		UINT64 startTime = GetTickCount64(), timeAfterH264;
 		MAPPED_GEOMETRY* geom = presentation->geometry;
+		const BYTE* pYUVData[3] = { 0 };
+		UINT32 iStride[3] = { 0 };
 
-		const RECTANGLE_16 rect = { 0, 0, surface->alignedWidth, surface->alignedHeight };
 		Stream_SealLength(presentation->currentSample);
 		Stream_SetPosition(presentation->currentSample, 0);
 
+		/* no colour conversion here, frames that get dropped never need it */
+		status = avc420_decompress_yuv(h264, Stream_Pointer(presentation->currentSample),
+		                               Stream_Length(presentation->currentSample), pYUVData,
+		                               iStride);
+		if (status <= 0)
+			return CHANNEL_RC_OK;
+
 		timeAfterH264 = GetTickCount64();
 		if (data->SampleNumber == 1)
 		{
@@ -860,17 +925,7 @@ static UINT video_VideoData(VideoClientContext* context, const TSMM_VIDEO_DATA*
 			int dropped = 0;
 
 			/* if the frame is to be published in less than 10 ms, let's consider it's now */
-			status = avc420_decompress(h264, Stream_Pointer(presentation->currentSample),
-			                           Stream_Length(presentation->currentSample), surface->data,
-			                           surface->format, surface->scanline, surface->alignedWidth,
-			                           surface->alignedHeight, &rect, 1);
-
-			if (status < 0)
-				return CHANNEL_RC_OK;
-
-			WINPR_ASSERT(context->showSurface);
-			context->showSurface(context, presentation->surface, presentation->ScaledWidth,
-			                     presentation->ScaledHeight);
+			video_present(context, presentation, pYUVData, iStride);
 
 			priv->publishedFrames++;
 
@@ -901,12 +956,7 @@ static UINT video_VideoData(VideoClientContext* context, const TSMM_VIDEO_DATA*
 				return CHANNEL_RC_NO_MEMORY;
 			}
 
-			status = avc420_decompress(h264, Stream_Pointer(presentation->currentSample),
-			                           Stream_Length(presentation->currentSample),
-			                           frame->surfaceData, surface->format, surface->scanline,
-			                           surface->alignedWidth, surface->alignedHeight, &rect, 1);
-			if (status < 0)
-				return CHANNEL_RC_OK;
+			VideoFrame_copy(frame, pYUVData, iStride);
 
 			InterlockedIncrement(&presentation->refCounter);
 
@@ -225,6 +225,7 @@ static DWORD WINAPI tf_client_thread_proc(LPVOID arg)
 	DWORD nCount;
 	DWORD status;
 	DWORD result = 0;
+	UINT64 start;
 	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
 	BOOL rc = freerdp_connect(instance);
 
@@ -253,7 +254,10 @@ static DWORD WINAPI tf_client_thread_proc(LPVOID arg)
 			break;
 		}
 
+		start = metrics_get_time_us();
 		status = WaitForMultipleObjects(nCount, handles, FALSE, 100);
+		metrics_histogram_record(instance->context->metrics, FREERDP_METRIC_NETWORK_WAIT,
+		                         metrics_get_time_us() - start);
 
 		if (status == WAIT_FAILED)
 		{
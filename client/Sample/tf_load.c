@@ -0,0 +1,469 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Load Generator
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
+#include <freerdp/scancode.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/utils/signal.h>
+
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/channels/channels.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <freerdp/log.h>
+
+#include "tf_channels.h"
+#include "tf_freerdp.h"
+
+#define TAG CLIENT_TAG("sample.load")
+
+/**
+ * Headless load generator.
+ *
+ * Connects a number of sessions with the same command line to one server, each on its own
+ * thread. The sessions decode the frames they receive, or with /load-ack-only only parse and
+ * acknowledge them, and send scripted input: the pointer moves across the desktop and every
+ * tenth step a key is typed. When the run ends a benchmark style report with frame rate, frame
+ * latency and bandwidth of every session is printed.
+ *
+ * The options understood in addition to the usual client options:
+ *
+ * /load-sessions:<n>      number of sessions, default 1
+ * /load-duration:<s>      seconds to run after the sessions were started, default 30
+ * /load-ramp:<ms>         delay between two session starts, default 100
+ * /load-input:<ms>        interval of the scripted input, 0 disables it, default 100
+ * /load-ack-only          do not decode frames
+ */
+
+#define TL_MAX_SESSIONS 1024
+#define TL_KEY_INTERVAL 10
+
+typedef struct
+{
+	UINT32 sessions;
+	UINT32 duration;
+	UINT32 ramp;
+	UINT32 input;
+	BOOL ackOnly;
+} tlOptions;
+
+typedef struct
+{
+	tfContext tf;
+
+	const tlOptions* options;
+	UINT32 session;
+	HANDLE thread;
+	DWORD result;
+	BOOL connected;
+	UINT64 start; /* microseconds, when the session was connected */
+	UINT64 stop;
+	UINT32 step;
+} tlContext;
+
+static BOOL tl_pre_connect(freerdp* instance)
+{
+	rdpSettings* settings;
+
+	WINPR_ASSERT(instance);
+
+	settings = instance->settings;
+	WINPR_ASSERT(settings);
+
+	settings->OsMajorType = OSMAJORTYPE_UNIX;
+	settings->OsMinorType = OSMINORTYPE_NATIVE_XSERVER;
+	PubSub_SubscribeChannelConnected(instance->context->pubSub, tf_OnChannelConnectedEventHandler);
+	PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+	                                    tf_OnChannelDisconnectedEventHandler);
+
+	return freerdp_client_load_addins(instance->context->channels, instance->settings);
+}
+
+static BOOL tl_desktop_resize(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+	return gdi_resize(context->gdi, context->settings->DesktopWidth,
+	                  context->settings->DesktopHeight);
+}
+
+static BOOL tl_post_connect(freerdp* instance)
+{
+	tlContext* tl;
+
+	WINPR_ASSERT(instance);
+	tl = (tlContext*)instance->context;
+
+	if (!gdi_init(instance, PIXEL_FORMAT_XRGB32))
+		return FALSE;
+
+	freerdp_settings_set_bool(instance->settings, FreeRDP_DeactivateClientDecoding,
+	                          tl->options->ackOnly);
+	instance->update->DesktopResize = tl_desktop_resize;
+	return TRUE;
+}
+
+static void tl_post_disconnect(freerdp* instance)
+{
+	if (!instance || !instance->context)
+		return;
+
+	PubSub_UnsubscribeChannelConnected(instance->context->pubSub,
+	                                   tf_OnChannelConnectedEventHandler);
+	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
+	                                      tf_OnChannelDisconnectedEventHandler);
+	gdi_free(instance);
+}
+
+static UINT16 tl_triangle(UINT32 step, UINT32 size)
+{
+	const UINT32 period = 2 * MAX(size, 2) - 2;
+	const UINT32 pos = step % period;
+
+	return (UINT16)((pos < size) ? pos : period - pos);
+}
+
+/* the pointer bounces over the desktop, every tenth step types a key */
+static BOOL tl_send_input(tlContext* tl)
+{
+	rdpContext* context = &tl->tf.common.context;
+	rdpInput* input = context->input;
+	const UINT32 width = context->settings->DesktopWidth;
+	const UINT32 height = context->settings->DesktopHeight;
+	const UINT16 x = tl_triangle(tl->step * 13, width);
+	const UINT16 y = tl_triangle(tl->step * 7, height);
+
+	tl->step++;
+
+	if (!freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, x, y))
+		return FALSE;
+
+	if ((tl->step % TL_KEY_INTERVAL) != 0)
+		return TRUE;
+
+	return freerdp_input_send_keyboard_event_ex(input, TRUE, RDP_SCANCODE_KEY_A) &&
+	       freerdp_input_send_keyboard_event_ex(input, FALSE, RDP_SCANCODE_KEY_A);
+}
+
+static DWORD WINAPI tl_session_thread_proc(LPVOID arg)
+{
+	tlContext* tl = (tlContext*)arg;
+	freerdp* instance = tl->tf.common.context.instance;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	const UINT32 interval = tl->options->input;
+	UINT64 next;
+
+	if (!freerdp_connect(instance))
+	{
+		tl->result = freerdp_get_last_error(instance->context);
+		WLog_ERR(TAG, "session %" PRIu32 ": connection failure 0x%08" PRIx32, tl->session,
+		         tl->result);
+		return tl->result;
+	}
+
+	tl->connected = TRUE;
+	tl->start = metrics_get_time_us();
+	next = GetTickCount64() + interval;
+
+	while (!freerdp_shall_disconnect(instance))
+	{
+		DWORD status;
+		DWORD timeout = INFINITE;
+		const DWORD nCount =
+		    freerdp_get_event_handles(instance->context, handles, ARRAYSIZE(handles));
+
+		if (nCount == 0)
+		{
+			WLog_ERR(TAG, "session %" PRIu32 ": freerdp_get_event_handles failed", tl->session);
+			break;
+		}
+
+		if (interval > 0)
+		{
+			const UINT64 now = GetTickCount64();
+			timeout = (next > now) ? (DWORD)(next - now) : 0;
+		}
+
+		status = WaitForMultipleObjects(nCount, handles, FALSE, timeout);
+
+		if (status == WAIT_FAILED)
+		{
+			WLog_ERR(TAG, "session %" PRIu32 ": WaitForMultipleObjects failed", tl->session);
+			break;
+		}
+
+		if (!freerdp_check_event_handles(instance->context))
+		{
+			if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
+				WLog_ERR(TAG, "session %" PRIu32 ": failed to check event handles",
+				         tl->session);
+
+			break;
+		}
+
+		if ((interval > 0) && (GetTickCount64() >= next))
+		{
+			next += interval;
+
+			if (!tl_send_input(tl))
+				break;
+		}
+	}
+
+	tl->stop = metrics_get_time_us();
+	freerdp_disconnect(instance);
+	return 0;
+}
+
+static BOOL tl_client_new(freerdp* instance, rdpContext* context)
+{
+	if (!instance || !context)
+		return FALSE;
+
+	instance->PreConnect = tl_pre_connect;
+	instance->PostConnect = tl_post_connect;
+	instance->PostDisconnect = tl_post_disconnect;
+	instance->AuthenticateEx = client_cli_authenticate_ex;
+	instance->VerifyCertificateEx = client_cli_verify_certificate_ex;
+	instance->VerifyChangedCertificateEx = client_cli_verify_changed_certificate_ex;
+	return TRUE;
+}
+
+static int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_ASSERT(pEntryPoints);
+
+	ZeroMemory(pEntryPoints, sizeof(RDP_CLIENT_ENTRY_POINTS));
+	pEntryPoints->Version = RDP_CLIENT_INTERFACE_VERSION;
+	pEntryPoints->Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	pEntryPoints->ContextSize = sizeof(tlContext);
+	pEntryPoints->ClientNew = tl_client_new;
+	return 0;
+}
+
+static BOOL tl_parse_number(const char* arg, const char* name, UINT32 max, UINT32* value)
+{
+	char* end = NULL;
+	unsigned long val;
+	const size_t length = strlen(name);
+
+	if ((strncmp(arg, name, length) != 0) || (arg[length] != ':'))
+		return FALSE;
+
+	errno = 0;
+	val = strtoul(&arg[length + 1], &end, 0);
+
+	if ((errno != 0) || (end == &arg[length + 1]) || (*end != '\0') || (val > max))
+	{
+		WLog_WARN(TAG, "ignoring invalid %s", arg);
+		return TRUE;
+	}
+
+	*value = (UINT32)val;
+	return TRUE;
+}
+
+/* removes the load generator options, the remaining arguments are parsed by the client */
+static int tl_parse_options(int argc, char* argv[], tlOptions* options)
+{
+	int x;
+	int count = 1;
+
+	options->sessions = 1;
+	options->duration = 30;
+	options->ramp = 100;
+	options->input = 100;
+
+	for (x = 1; x < argc; x++)
+	{
+		const char* arg = argv[x];
+
+		if (tl_parse_number(arg, "/load-sessions", TL_MAX_SESSIONS, &options->sessions) ||
+		    tl_parse_number(arg, "/load-duration", UINT32_MAX / 1000, &options->duration) ||
+		    tl_parse_number(arg, "/load-ramp", 60000, &options->ramp) ||
+		    tl_parse_number(arg, "/load-input", 60000, &options->input))
+			continue;
+
+		if (strcmp(arg, "/load-ack-only") == 0)
+		{
+			options->ackOnly = TRUE;
+			continue;
+		}
+
+		argv[count++] = argv[x];
+	}
+
+	if (options->sessions == 0)
+		options->sessions = 1;
+
+	return count;
+}
+
+static double tl_ms(UINT64 us)
+{
+	return us / 1000.0;
+}
+
+static void tl_print_report(tlContext** sessions, const tlOptions* options)
+{
+	UINT32 x;
+	UINT32 connected = 0;
+	double totalFps = 0.0;
+	double totalKbps = 0.0;
+	UINT64 worstLatency = 0;
+
+	printf("%-8s %10s %8s %10s %10s %10s %10s %10s\n", "session", "frames", "fps", "kbit/s",
+	       "lat p50", "lat p90", "lat p99", "dec p50");
+
+	for (x = 0; x < options->sessions; x++)
+	{
+		double seconds;
+		double fps;
+		double kbps;
+		UINT64 frames;
+		FREERDP_METRIC_HISTOGRAM_SUMMARY latency = { 0 };
+		FREERDP_METRIC_HISTOGRAM_SUMMARY decode = { 0 };
+		const tlContext* tl = sessions[x];
+		rdpMetrics* metrics;
+
+		if (!tl || !tl->connected)
+		{
+			printf("%-8" PRIu32 " %10s\n", x, "failed");
+			continue;
+		}
+
+		metrics = tl->tf.common.context.metrics;
+		connected++;
+		seconds = MAX(tl->stop - tl->start, 1) / 1000000.0;
+		frames = metrics_counter_get(metrics, FREERDP_METRIC_FRAMES_DECODED);
+		fps = frames / seconds;
+		kbps = metrics_counter_get(metrics, FREERDP_METRIC_BYTES_IN) * 8.0 / 1000.0 / seconds;
+		metrics_histogram_get(metrics, FREERDP_METRIC_FRAME_LATENCY, &latency);
+		metrics_histogram_get(metrics, FREERDP_METRIC_DECODE_TIME, &decode);
+		totalFps += fps;
+		totalKbps += kbps;
+		worstLatency = MAX(worstLatency, latency.p99);
+
+		printf("%-8" PRIu32 " %10" PRIu64 " %8.2f %10.1f %10.2f %10.2f %10.2f %10.2f\n", x, frames,
+		       fps, kbps, tl_ms(latency.p50), tl_ms(latency.p90), tl_ms(latency.p99),
+		       tl_ms(decode.p50));
+	}
+
+	printf("\n%" PRIu32 "/%" PRIu32 " sessions connected, %s\n", connected, options->sessions,
+	       options->ackOnly ? "frames acknowledged only" : "frames decoded");
+
+	if (connected > 0)
+		printf("mean %.2f fps, total %.1f kbit/s, worst frame latency p99 %.2f ms\n",
+		       totalFps / connected, totalKbps, tl_ms(worstLatency));
+}
+
+static void tl_session_free(tlContext* tl)
+{
+	if (!tl)
+		return;
+
+	freerdp_client_context_free(&tl->tf.common.context);
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	UINT32 x;
+	tlOptions options = { 0 };
+	tlContext** sessions = NULL;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints;
+
+	if (freerdp_handle_signals() != 0)
+		return -1;
+
+	argc = tl_parse_options(argc, argv, &options);
+	sessions = (tlContext**)calloc(options.sessions, sizeof(tlContext*));
+
+	if (!sessions)
+		return -1;
+
+	RdpClientEntry(&clientEntryPoints);
+
+	for (x = 0; x < options.sessions; x++)
+	{
+		DWORD status;
+		tlContext* tl = (tlContext*)freerdp_client_context_new(&clientEntryPoints);
+
+		if (!tl)
+			goto fail;
+
+		sessions[x] = tl;
+		tl->options = &options;
+		tl->session = x;
+		status = freerdp_client_settings_parse_command_line(tl->tf.common.context.settings, argc,
+		                                                    argv, FALSE);
+
+		if (status)
+		{
+			rc = freerdp_client_settings_command_line_status_print(
+			    tl->tf.common.context.settings, status, argc, argv);
+			goto fail;
+		}
+
+		if (!(tl->thread = CreateThread(NULL, 0, tl_session_thread_proc, tl, 0, NULL)))
+			goto fail;
+
+		if ((x + 1 < options.sessions) && (options.ramp > 0))
+			Sleep(options.ramp);
+	}
+
+	Sleep(options.duration * 1000);
+	rc = 0;
+
+fail:
+	for (x = 0; x < options.sessions; x++)
+	{
+		if (sessions[x])
+			freerdp_abort_connect(sessions[x]->tf.common.context.instance);
+	}
+
+	for (x = 0; x < options.sessions; x++)
+	{
+		if (sessions[x] && sessions[x]->thread)
+		{
+			WaitForSingleObject(sessions[x]->thread, INFINITE);
+			CloseHandle(sessions[x]->thread);
+			sessions[x]->thread = NULL;
+		}
+	}
+
+	if (rc == 0)
+		tl_print_report(sessions, &options);
+
+	for (x = 0; x < options.sessions; x++)
+		tl_session_free(sessions[x]);
+
+	free(sessions);
+	return rc;
+}
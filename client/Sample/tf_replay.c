@@ -0,0 +1,374 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Headless Replay Client
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
+#include <freerdp/streamdump.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/utils/signal.h>
+
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/channels/channels.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/crypto.h>
+#include <freerdp/log.h>
+
+#include "tf_channels.h"
+#include "tf_freerdp.h"
+
+#define TAG CLIENT_TAG("sample.replay")
+
+/**
+ * Headless replay client.
+ *
+ * Replays a session recorded with /tune:TransportDump:true,TransportDumpFile:<file> through the
+ * complete decode stack into a GDI framebuffer that is never shown. By default the recording is
+ * replayed as fast as the decoders allow, the time stamps of the records are ignored. When the
+ * recording ends a report with the decoded frame rate, the CPU time used and the time spent in
+ * the decode and present stages is printed.
+ *
+ * The options understood in addition to the usual client options:
+ *
+ * /replay-dump:<file>     recording to replay, same as
+ *                         /tune:TransportDumpReplay:true,TransportDumpFile:<file>
+ * /replay-speed:<percent> replay with the recorded timing scaled by percent, default 0 (no delay)
+ * /replay-hash            print the SHA-256 of the final framebuffer, for regression tests
+ */
+
+typedef struct
+{
+	const char* dump;
+	UINT32 speed;
+	BOOL hash;
+} trOptions;
+
+typedef struct
+{
+	tfContext tf;
+
+	const trOptions* options;
+} trContext;
+
+static BOOL tr_pre_connect(freerdp* instance)
+{
+	rdpSettings* settings;
+
+	WINPR_ASSERT(instance);
+
+	settings = instance->settings;
+	WINPR_ASSERT(settings);
+
+	settings->OsMajorType = OSMAJORTYPE_UNIX;
+	settings->OsMinorType = OSMINORTYPE_NATIVE_XSERVER;
+	PubSub_SubscribeChannelConnected(instance->context->pubSub, tf_OnChannelConnectedEventHandler);
+	PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+	                                    tf_OnChannelDisconnectedEventHandler);
+
+	return freerdp_client_load_addins(instance->context->channels, instance->settings);
+}
+
+static BOOL tr_desktop_resize(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+	return gdi_resize(context->gdi, context->settings->DesktopWidth,
+	                  context->settings->DesktopHeight);
+}
+
+static BOOL tr_post_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+
+	if (!gdi_init(instance, PIXEL_FORMAT_XRGB32))
+		return FALSE;
+
+	instance->update->DesktopResize = tr_desktop_resize;
+	return TRUE;
+}
+
+static void tr_post_disconnect(freerdp* instance)
+{
+	if (!instance || !instance->context)
+		return;
+
+	PubSub_UnsubscribeChannelConnected(instance->context->pubSub,
+	                                   tf_OnChannelConnectedEventHandler);
+	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
+	                                      tf_OnChannelDisconnectedEventHandler);
+	gdi_free(instance);
+}
+
+static BOOL tr_client_new(freerdp* instance, rdpContext* context)
+{
+	if (!instance || !context)
+		return FALSE;
+
+	instance->PreConnect = tr_pre_connect;
+	instance->PostConnect = tr_post_connect;
+	instance->PostDisconnect = tr_post_disconnect;
+	instance->AuthenticateEx = client_cli_authenticate_ex;
+	instance->VerifyCertificateEx = client_cli_verify_certificate_ex;
+	instance->VerifyChangedCertificateEx = client_cli_verify_changed_certificate_ex;
+	return TRUE;
+}
+
+static int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_ASSERT(pEntryPoints);
+
+	ZeroMemory(pEntryPoints, sizeof(RDP_CLIENT_ENTRY_POINTS));
+	pEntryPoints->Version = RDP_CLIENT_INTERFACE_VERSION;
+	pEntryPoints->Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	pEntryPoints->ContextSize = sizeof(trContext);
+	pEntryPoints->ClientNew = tr_client_new;
+	return 0;
+}
+
+/* removes the replay options, the remaining arguments are parsed by the client */
+static int tr_parse_options(int argc, char* argv[], trOptions* options)
+{
+	int x;
+	int count = 1;
+
+	for (x = 1; x < argc; x++)
+	{
+		const char* arg = argv[x];
+
+		if (strncmp(arg, "/replay-dump:", 13) == 0)
+		{
+			options->dump = &arg[13];
+			continue;
+		}
+
+		if (strncmp(arg, "/replay-speed:", 14) == 0)
+		{
+			char* end = NULL;
+			unsigned long val;
+
+			errno = 0;
+			val = strtoul(&arg[14], &end, 0);
+
+			if ((errno != 0) || (end == &arg[14]) || (*end != '\0') || (val > 10000))
+				WLog_WARN(TAG, "ignoring invalid %s", arg);
+			else
+				options->speed = (UINT32)val;
+
+			continue;
+		}
+
+		if (strcmp(arg, "/replay-hash") == 0)
+		{
+			options->hash = TRUE;
+			continue;
+		}
+
+		argv[count++] = argv[x];
+	}
+
+	return count;
+}
+
+static BOOL tr_apply_options(rdpContext* context, const trOptions* options)
+{
+	rdpSettings* settings = context->settings;
+
+	if (options->dump)
+	{
+		if (!freerdp_settings_set_bool(settings, FreeRDP_TransportDumpReplay, TRUE) ||
+		    !freerdp_settings_set_string(settings, FreeRDP_TransportDumpFile, options->dump))
+			return FALSE;
+	}
+
+	if (!freerdp_settings_get_bool(settings, FreeRDP_TransportDumpReplay) ||
+	    !freerdp_settings_get_string(settings, FreeRDP_TransportDumpFile))
+	{
+		WLog_ERR(TAG, "no recording to replay, use /replay-dump:<file>");
+		return FALSE;
+	}
+
+	if (!stream_dump_register_handlers(context, CONNECTION_STATE_MCS_CONNECT))
+		return FALSE;
+
+	stream_dump_set_replay_speed(context, options->speed);
+	return TRUE;
+}
+
+/* the hash covers the visible pixels only, the padding at the end of a line is ignored */
+static BOOL tr_print_hash(rdpContext* context)
+{
+	UINT32 y;
+	BOOL rc = FALSE;
+	BYTE digest[WINPR_SHA256_DIGEST_LENGTH] = { 0 };
+	char hex[2 * WINPR_SHA256_DIGEST_LENGTH + 1] = { 0 };
+	WINPR_DIGEST_CTX* sha256 = NULL;
+	const rdpGdi* gdi = context->gdi;
+
+	if (!gdi || !gdi->primary_buffer)
+	{
+		WLog_ERR(TAG, "no framebuffer to hash");
+		return FALSE;
+	}
+
+	if (!(sha256 = winpr_Digest_New()))
+		return FALSE;
+
+	if (!winpr_Digest_Init(sha256, WINPR_MD_SHA256))
+		goto fail;
+
+	for (y = 0; y < gdi->height; y++)
+	{
+		const BYTE* line = &gdi->primary_buffer[1ull * y * gdi->stride];
+
+		if (!winpr_Digest_Update(sha256, line, 4ull * gdi->width))
+			goto fail;
+	}
+
+	if (!winpr_Digest_Final(sha256, digest, sizeof(digest)))
+		goto fail;
+
+	for (y = 0; y < ARRAYSIZE(digest); y++)
+		sprintf_s(&hex[2 * y], sizeof(hex) - 2 * y, "%02" PRIx8, digest[y]);
+
+	printf("framebuffer %" PRIu32 "x%" PRIu32 " sha256 %s\n", gdi->width, gdi->height, hex);
+	rc = TRUE;
+fail:
+	winpr_Digest_Free(sha256);
+	return rc;
+}
+
+static double tr_ms(UINT64 us)
+{
+	return us / 1000.0;
+}
+
+static void tr_print_stage(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM id, const char* name)
+{
+	FREERDP_METRIC_HISTOGRAM_SUMMARY summary = { 0 };
+
+	if (!metrics_histogram_get(metrics, id, &summary) || (summary.count == 0))
+		return;
+
+	printf("%-14s %10" PRIu64 " %12.2f %10.3f %10.3f %10.3f\n", name, summary.count,
+	       tr_ms(summary.sum), tr_ms(summary.p50), tr_ms(summary.p99), tr_ms(summary.max));
+}
+
+static void tr_print_report(rdpContext* context, UINT64 wall, clock_t cpu)
+{
+	rdpMetrics* metrics = context->metrics;
+	const double seconds = MAX(wall, 1) / 1000000.0;
+	const double cpuSeconds = (double)cpu / CLOCKS_PER_SEC;
+	const UINT64 frames = metrics_counter_get(metrics, FREERDP_METRIC_FRAMES_DECODED);
+	const UINT64 pdus = metrics_counter_get(metrics, FREERDP_METRIC_PDUS_IN);
+
+	printf("replayed %" PRIu64 " PDUs and %" PRIu64 " frames in %.3f s, %.2f fps\n", pdus,
+	       frames, seconds, frames / seconds);
+	printf("cpu %.3f s (%.1f%% of wall time), transport %.2f ms\n\n", cpuSeconds,
+	       100.0 * cpuSeconds / seconds,
+	       tr_ms(metrics_counter_get(metrics, FREERDP_METRIC_TRANSPORT_IO_TIME)));
+	printf("%-14s %10s %12s %10s %10s %10s\n", "stage", "count", "total ms", "p50 ms", "p99 ms",
+	       "max ms");
+	tr_print_stage(metrics, FREERDP_METRIC_DECODE_TIME, "decode");
+	tr_print_stage(metrics, FREERDP_METRIC_PRESENT_TIME, "present");
+	tr_print_stage(metrics, FREERDP_METRIC_FRAME_DECODE_TIME, "frame decode");
+	tr_print_stage(metrics, FREERDP_METRIC_FRAME_TIME, "frame");
+}
+
+static int tr_replay(rdpContext* context, const trOptions* options)
+{
+	int rc = -1;
+	UINT64 start;
+	clock_t cpu;
+	freerdp* instance = context->instance;
+
+	start = metrics_get_time_us();
+	cpu = clock();
+
+	if (!freerdp_connect(instance))
+	{
+		WLog_ERR(TAG, "replay failed during the connection sequence 0x%08" PRIx32,
+		         freerdp_get_last_error(context));
+		return -1;
+	}
+
+	/* nothing to wait for, the transport reads the next record whenever it is asked to */
+	while (!freerdp_shall_disconnect(instance))
+	{
+		if (!freerdp_check_event_handles(context))
+			break;
+	}
+
+	tr_print_report(context, metrics_get_time_us() - start, clock() - cpu);
+	rc = 0;
+
+	if (options->hash && !tr_print_hash(context))
+		rc = -1;
+
+	freerdp_disconnect(instance);
+	return rc;
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	DWORD status;
+	trOptions options = { 0 };
+	trContext* tr = NULL;
+	rdpContext* context;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints;
+
+	if (freerdp_handle_signals() != 0)
+		return -1;
+
+	argc = tr_parse_options(argc, argv, &options);
+	RdpClientEntry(&clientEntryPoints);
+	tr = (trContext*)freerdp_client_context_new(&clientEntryPoints);
+
+	if (!tr)
+		goto fail;
+
+	tr->options = &options;
+	context = &tr->tf.common.context;
+	status = freerdp_client_settings_parse_command_line(context->settings, argc, argv, FALSE);
+
+	if (status)
+	{
+		rc = freerdp_client_settings_command_line_status_print(context->settings, status, argc,
+		                                                       argv);
+		goto fail;
+	}
+
+	if (!tr_apply_options(context, &options))
+		goto fail;
+
+	rc = tr_replay(context, &options);
+
+fail:
+	if (tr)
+		freerdp_client_context_free(&tr->tf.common.context);
+
+	return rc;
+}
@@ -30,6 +30,10 @@ typedef struct
 	rdpPointer pointer;
 	size_t size;
 	void* data;
+	/* data scaled for the current window size, kept for the next Set of this pointer */
+	void* scaled;
+	UINT32 scaledWidth;
+	UINT32 scaledHeight;
 } wlfPointer;
 
 static BOOL wlf_Pointer_New(rdpContext* context, rdpPointer* pointer)
@@ -63,18 +67,18 @@ static void wlf_Pointer_Free(rdpContext* context, rdpPointer* pointer)
 	WINPR_UNUSED(context);
 
 	if (ptr)
+	{
 		_aligned_free(ptr->data);
+		free(ptr->scaled);
+	}
 }
 
 static BOOL wlf_Pointer_Set(rdpContext* context, const rdpPointer* pointer)
 {
 	wlfContext* wlf = (wlfContext*)context;
-	const wlfPointer* ptr = (const wlfPointer*)pointer;
-	void* data;
+	wlfPointer* ptr = (wlfPointer*)pointer;
 	UINT32 w, h, x, y;
 	size_t size;
-	UwacReturnCode rc;
-	BOOL res = FALSE;
 	RECTANGLE_16 area;
 
 	if (!wlf || !wlf->seat)
@@ -90,28 +94,33 @@ static BOOL wlf_Pointer_Set(rdpContext* context, const rdpPointer* pointer)
 		return FALSE;
 
 	size = w * h * 4ULL;
-	data = malloc(size);
 
-	if (!data)
-		return FALSE;
+	/* a cached pointer is only scaled again when the window size changed */
+	if (!ptr->scaled || (ptr->scaledWidth != w) || (ptr->scaledHeight != h))
+	{
+		void* data = realloc(ptr->scaled, size);
 
-	area.top = 0;
-	area.left = 0;
-	area.right = (UINT16)pointer->width;
-	area.bottom = (UINT16)pointer->height;
+		if (!data)
+			return FALSE;
 
-	if (!wlf_copy_image(ptr->data, pointer->width * 4, pointer->width, pointer->height, data, w * 4,
-	                    w, h, &area, context->settings->SmartSizing))
-		goto fail;
+		ptr->scaled = data;
+		ptr->scaledWidth = 0;
+		ptr->scaledHeight = 0;
 
-	rc = UwacSeatSetMouseCursor(wlf->seat, data, size, w, h, x, y);
+		area.top = 0;
+		area.left = 0;
+		area.right = (UINT16)pointer->width;
+		area.bottom = (UINT16)pointer->height;
 
-	if (rc == UWAC_SUCCESS)
-		res = TRUE;
+		if (!wlf_copy_image(ptr->data, pointer->width * 4, pointer->width, pointer->height,
+		                    ptr->scaled, w * 4, w, h, &area, context->settings->SmartSizing))
+			return FALSE;
+
+		ptr->scaledWidth = w;
+		ptr->scaledHeight = h;
+	}
 
-fail:
-	free(data);
-	return res;
+	return UwacSeatSetMouseCursor(wlf->seat, ptr->scaled, size, w, h, x, y) == UWAC_SUCCESS;
 }
 
 static BOOL wlf_Pointer_SetNull(rdpContext* context)
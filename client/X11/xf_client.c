@@ -103,6 +103,7 @@
 #include "xf_keyboard.h"
 #include "xf_input.h"
 #include "xf_channels.h"
+#include "xf_shm.h"
 #include "xfreerdp.h"
 
 #include <freerdp/log.h>
@@ -117,18 +118,89 @@ static void xf_window_free(xfContext* xfc);
 static BOOL xf_get_pixmap_info(xfContext* xfc);
 
 #ifdef WITH_XRENDER
-static void xf_draw_screen_scaled(xfContext* xfc, int x, int y, int w, int h)
+void xf_draw_screen_free_pictures(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	if (xfc->primaryPicture)
+		XRenderFreePicture(xfc->display, xfc->primaryPicture);
+
+	if (xfc->windowPicture)
+		XRenderFreePicture(xfc->display, xfc->windowPicture);
+
+	xfc->primaryPicture = 0;
+	xfc->windowPicture = 0;
+	xfc->picturePrimary = 0;
+	xfc->pictureWindow = 0;
+}
+
+/* The pictures and the transform only change with the window or the scale, not per draw */
+static BOOL xf_draw_screen_pictures(xfContext* xfc, double xScalingFactor, double yScalingFactor)
 {
 	XTransform transform;
-	Picture windowPicture;
-	Picture primaryPicture;
-	XRenderPictureAttributes pa;
-	XRenderPictFormat* picFormat;
+	const char* filter;
+
+	if ((xfc->picturePrimary != xfc->primary) || (xfc->pictureWindow != xfc->window->handle))
+	{
+		XRenderPictureAttributes pa;
+		XRenderPictFormat* picFormat = XRenderFindVisualFormat(xfc->display, xfc->visual);
+
+		xf_draw_screen_free_pictures(xfc);
+		pa.subwindow_mode = IncludeInferiors;
+		xfc->primaryPicture =
+		    XRenderCreatePicture(xfc->display, xfc->primary, picFormat, CPSubwindowMode, &pa);
+		xfc->windowPicture = XRenderCreatePicture(xfc->display, xfc->window->handle, picFormat,
+		                                          CPSubwindowMode, &pa);
+
+		if (!xfc->primaryPicture || !xfc->windowPicture)
+		{
+			xf_draw_screen_free_pictures(xfc);
+			return FALSE;
+		}
+
+		xfc->picturePrimary = xfc->primary;
+		xfc->pictureWindow = xfc->window->handle;
+		xfc->pictureScaleX = 0.0;
+		xfc->pictureScaleY = 0.0;
+	}
+
+	if ((xfc->pictureScaleX == xScalingFactor) && (xfc->pictureScaleY == yScalingFactor))
+		return TRUE;
+
+	/* avoid blurry filter when scaling factor is 2x, 3x, etc
+	 * useful when the client has high-dpi monitor */
+	filter = FilterBilinear;
+	if (fabs(xScalingFactor - yScalingFactor) < MIN_PIXEL_DIFF)
+	{
+		const double inverseX = 1.0 / xScalingFactor;
+		const double inverseRoundedX = round(inverseX);
+		const double absInverse = fabs(inverseX - inverseRoundedX);
+
+		if (absInverse < MIN_PIXEL_DIFF)
+			filter = FilterNearest;
+	}
+	XRenderSetPictureFilter(xfc->display, xfc->primaryPicture, filter, 0, 0);
+	transform.matrix[0][0] = XDoubleToFixed(xScalingFactor);
+	transform.matrix[0][1] = XDoubleToFixed(0.0);
+	transform.matrix[0][2] = XDoubleToFixed(0.0);
+	transform.matrix[1][0] = XDoubleToFixed(0.0);
+	transform.matrix[1][1] = XDoubleToFixed(yScalingFactor);
+	transform.matrix[1][2] = XDoubleToFixed(0.0);
+	transform.matrix[2][0] = XDoubleToFixed(0.0);
+	transform.matrix[2][1] = XDoubleToFixed(0.0);
+	transform.matrix[2][2] = XDoubleToFixed(1.0);
+	XRenderSetPictureTransform(xfc->display, xfc->primaryPicture, &transform);
+	xfc->pictureScaleX = xScalingFactor;
+	xfc->pictureScaleY = yScalingFactor;
+	return TRUE;
+}
+
+static void xf_draw_screen_scaled(xfContext* xfc, int x, int y, int w, int h)
+{
 	double xScalingFactor;
 	double yScalingFactor;
 	int x2;
 	int y2;
-	const char* filter;
 	rdpSettings* settings;
 	WINPR_ASSERT(xfc);
 
@@ -171,34 +243,13 @@ static void xf_draw_screen_scaled(xfContext* xfc, int x, int y, int w, int h)
 		XDestroyRegion(reg1);
 		XDestroyRegion(reg2);
 	}
-	picFormat = XRenderFindVisualFormat(xfc->display, xfc->visual);
-	pa.subwindow_mode = IncludeInferiors;
-	primaryPicture =
-	    XRenderCreatePicture(xfc->display, xfc->primary, picFormat, CPSubwindowMode, &pa);
-	windowPicture =
-	    XRenderCreatePicture(xfc->display, xfc->window->handle, picFormat, CPSubwindowMode, &pa);
-	/* avoid blurry filter when scaling factor is 2x, 3x, etc
-	 * useful when the client has high-dpi monitor */
-	filter = FilterBilinear;
-	if (fabs(xScalingFactor - yScalingFactor) < MIN_PIXEL_DIFF)
-	{
-		const double inverseX = 1.0 / xScalingFactor;
-		const double inverseRoundedX = round(inverseX);
-		const double absInverse = fabs(inverseX - inverseRoundedX);
 
-		if (absInverse < MIN_PIXEL_DIFF)
-			filter = FilterNearest;
+	if (!xf_draw_screen_pictures(xfc, xScalingFactor, yScalingFactor))
+	{
+		WLog_ERR(TAG, "failed to create the pictures for scaling");
+		return;
 	}
-	XRenderSetPictureFilter(xfc->display, primaryPicture, filter, 0, 0);
-	transform.matrix[0][0] = XDoubleToFixed(xScalingFactor);
-	transform.matrix[0][1] = XDoubleToFixed(0.0);
-	transform.matrix[0][2] = XDoubleToFixed(0.0);
-	transform.matrix[1][0] = XDoubleToFixed(0.0);
-	transform.matrix[1][1] = XDoubleToFixed(yScalingFactor);
-	transform.matrix[1][2] = XDoubleToFixed(0.0);
-	transform.matrix[2][0] = XDoubleToFixed(0.0);
-	transform.matrix[2][1] = XDoubleToFixed(0.0);
-	transform.matrix[2][2] = XDoubleToFixed(1.0);
+
 	/* calculate and fix up scaled coordinates */
 	x2 = x + w;
 	y2 = y + h;
@@ -206,11 +257,8 @@ static void xf_draw_screen_scaled(xfContext* xfc, int x, int y, int w, int h)
 	y = floor(y / yScalingFactor) - 1;
 	w = ceil(x2 / xScalingFactor) + 1 - x;
 	h = ceil(y2 / yScalingFactor) + 1 - y;
-	XRenderSetPictureTransform(xfc->display, primaryPicture, &transform);
-	XRenderComposite(xfc->display, PictOpSrc, primaryPicture, 0, windowPicture, x, y, 0, 0,
-	                 xfc->offset_x + x, xfc->offset_y + y, w, h);
-	XRenderFreePicture(xfc->display, primaryPicture);
-	XRenderFreePicture(xfc->display, windowPicture);
+	XRenderComposite(xfc->display, PictOpSrc, xfc->primaryPicture, 0, xfc->windowPicture, x, y,
+	                 0, 0, xfc->offset_x + x, xfc->offset_y + y, w, h);
 }
 
 BOOL xf_picture_transform_required(xfContext* xfc)
@@ -273,6 +321,9 @@ static BOOL xf_desktop_resize(rdpContext* context)
 	if (xfc->primary)
 	{
 		BOOL same = (xfc->primary == xfc->drawing) ? TRUE : FALSE;
+#ifdef WITH_XRENDER
+		xf_draw_screen_free_pictures(xfc);
+#endif
 		XFreePixmap(xfc->display, xfc->primary);
 
 		if (!(xfc->primary = XCreatePixmap(xfc->display, xfc->drawable, settings->DesktopWidth,
@@ -320,6 +371,13 @@ static BOOL xf_desktop_resize(rdpContext* context)
 	return TRUE;
 }
 
+/* the server reads a shared primary buffer after XShmPutImage, before gdi draws to it again */
+static void xf_sw_sync_primary(xfContext* xfc)
+{
+	if (xfc->primaryShm.shmaddr)
+		XSync(xfc->display, False);
+}
+
 static BOOL xf_sw_end_paint(rdpContext* context)
 {
 	int i;
@@ -348,8 +406,9 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 				return TRUE;
 
 			xf_lock_x11(xfc);
-			XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, x, y, x, y, w, h);
+			xf_shm_put_image(xfc, xfc->primary, xfc->image, x, y, x, y, w, h);
 			xf_draw_screen(xfc, x, y, w, h);
+			xf_sw_sync_primary(xfc);
 			xf_unlock_x11(xfc);
 		}
 		else
@@ -365,11 +424,15 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 				y = cinvalid[i].y;
 				w = cinvalid[i].w;
 				h = cinvalid[i].h;
-				XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, x, y, x, y, w, h);
+				xf_shm_put_image(xfc, xfc->primary, xfc->image, x, y, x, y, w, h);
 				xf_draw_screen(xfc, x, y, w, h);
 			}
 
-			XFlush(xfc->display);
+			if (xfc->primaryShm.shmaddr)
+				xf_sw_sync_primary(xfc);
+			else
+				XFlush(xfc->display);
+
 			xf_unlock_x11(xfc);
 		}
 	}
@@ -388,6 +451,68 @@ static BOOL xf_sw_end_paint(rdpContext* context)
 	return TRUE;
 }
 
+/* gdi must not free a shared primary buffer, it is detached from the X server first */
+static void xf_shm_keep_buffer(void* ptr)
+{
+	WINPR_UNUSED(ptr);
+}
+
+static BOOL xf_sw_resize_primary(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	BYTE* buffer;
+	UINT32 stride;
+	xfShmSegment segment = { 0 };
+	rdpGdi* gdi = xfc->common.context.gdi;
+
+	if (!xfc->primaryShm.shmaddr || (((UINT32)gdi->width == width) &&
+	                                  ((UINT32)gdi->height == height)))
+		return gdi_resize(gdi, width, height);
+
+	stride = width * GetBytesPerPixel(gdi->dstFormat);
+	buffer = xf_shm_attach(xfc, &segment, 1ULL * stride * height);
+
+	if (buffer)
+	{
+		if (!gdi_resize_ex(gdi, width, height, stride, gdi->dstFormat, buffer,
+		                   xf_shm_keep_buffer))
+		{
+			xf_shm_detach(xfc, &segment);
+			return FALSE;
+		}
+	}
+	else if (!gdi_resize(gdi, width, height))
+		return FALSE;
+
+	xf_shm_detach(xfc, &xfc->primaryShm);
+	xfc->primaryShm = segment;
+	return TRUE;
+}
+
+/* the primary buffer of the software gdi is shared with the X server if possible */
+static BOOL xf_gdi_init(xfContext* xfc, UINT32 format)
+{
+	BYTE* buffer;
+	rdpContext* context = &xfc->common.context;
+	const rdpSettings* settings = context->settings;
+	const UINT32 stride = settings->DesktopWidth * GetBytesPerPixel(format);
+
+	if (!settings->SoftwareGdi)
+		return gdi_init(context->instance, format);
+
+	buffer = xf_shm_attach(xfc, &xfc->primaryShm, 1ULL * stride * settings->DesktopHeight);
+
+	if (!buffer)
+		return gdi_init(context->instance, format);
+
+	if (!gdi_init_ex(context->instance, format, stride, buffer, xf_shm_keep_buffer))
+	{
+		xf_shm_detach(xfc, &xfc->primaryShm);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static BOOL xf_sw_desktop_resize(rdpContext* context)
 {
 	rdpGdi* gdi = context->gdi;
@@ -396,18 +521,13 @@ static BOOL xf_sw_desktop_resize(rdpContext* context)
 	BOOL ret = FALSE;
 	xf_lock_x11(xfc);
 
-	if (!gdi_resize(gdi, settings->DesktopWidth, settings->DesktopHeight))
+	if (!xf_sw_resize_primary(xfc, settings->DesktopWidth, settings->DesktopHeight))
 		goto out;
 
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-	}
+	xf_shm_destroy_image(xfc->image);
 
-	if (!(xfc->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-	                                (char*)gdi->primary_buffer, gdi->width, gdi->height,
-	                                xfc->scanline_pad, gdi->stride)))
+	if (!(xfc->image = xf_shm_create_image(xfc, &xfc->primaryShm, gdi->primary_buffer,
+	                                       gdi->width, gdi->height, gdi->stride)))
 	{
 		goto out;
 	}
@@ -683,9 +803,12 @@ BOOL xf_create_window(xfContext* xfc)
 		rdpGdi* cgdi = xfc->common.context.gdi;
 		WINPR_ASSERT(cgdi);
 
-		xfc->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-		                          (char*)cgdi->primary_buffer, settings->DesktopWidth,
-		                          settings->DesktopHeight, xfc->scanline_pad, cgdi->stride);
+		xfc->image = xf_shm_create_image(xfc, &xfc->primaryShm, cgdi->primary_buffer,
+		                                 settings->DesktopWidth, settings->DesktopHeight,
+		                                 cgdi->stride);
+		if (!xfc->image)
+			return FALSE;
+
 		xfc->image->byte_order = LSBFirst;
 		xfc->image->bitmap_bit_order = LSBFirst;
 	}
@@ -715,12 +838,8 @@ static void xf_window_free(xfContext* xfc)
 	}
 #endif
 
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-		xfc->image = NULL;
-	}
+	xf_shm_destroy_image(xfc->image);
+	xfc->image = NULL;
 
 	if (xfc->bitmap_mono)
 	{
@@ -736,6 +855,9 @@ static void xf_window_free(xfContext* xfc)
 
 	if (xfc->primary)
 	{
+#ifdef WITH_XRENDER
+		xf_draw_screen_free_pictures(xfc);
+#endif
 		XFreePixmap(xfc->display, xfc->primary);
 		xfc->primary = 0;
 	}
@@ -997,6 +1119,8 @@ static void xf_check_extensions(xfContext* context)
 		context->xkbAvailable = TRUE;
 	}
 
+	xf_shm_check_extension(context);
+
 #ifdef WITH_XRENDER
 	{
 		int xrender_event_base;
@@ -1291,7 +1415,7 @@ static BOOL xf_post_connect(freerdp* instance)
 	settings = instance->settings;
 	update = context->update;
 
-	if (!gdi_init(instance, xf_get_local_color_format(xfc, TRUE)))
+	if (!xf_gdi_init(xfc, xf_get_local_color_format(xfc, TRUE)))
 		return FALSE;
 
 	if (!xf_register_pointer(context->graphics))
@@ -1390,6 +1514,7 @@ static void xf_post_disconnect(freerdp* instance)
 	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
 	                                      xf_OnChannelDisconnectedEventHandler);
 	gdi_free(instance);
+	xf_shm_detach(xfc, &xfc->primaryShm);
 
 	if (xfc->clipboard)
 	{
@@ -1526,6 +1651,7 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 	DWORD exit_code = 0;
 	DWORD nCount;
 	DWORD waitStatus;
+	UINT64 start;
 	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
 	xfContext* xfc;
 	freerdp* instance;
@@ -1719,9 +1845,15 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 		}
 
 		if (xfc->window)
+		{
 			xf_floatbar_hide_and_show(xfc->window->floatbar);
+			xf_floatbar_update_stats(xfc->window->floatbar);
+		}
 
+		start = metrics_get_time_us();
 		waitStatus = WaitForMultipleObjects(nCount, handles, FALSE, INFINITE);
+		metrics_histogram_record(context->metrics, FREERDP_METRIC_NETWORK_WAIT,
+		                         metrics_get_time_us() - start);
 
 		if (waitStatus == WAIT_FAILED)
 			break;
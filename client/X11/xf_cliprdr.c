@@ -71,16 +71,61 @@ typedef struct
 } xfCliprdrFormat;
 
 #ifdef WITH_FUSE
+/* file contents requests kept in flight per file read */
+#define CLIPRDR_FUSE_PIPELINE_DEPTH 4
+/* the chunk size doubles with every complete response up to the maximum */
+#define CLIPRDR_FUSE_MIN_CHUNK_SIZE (64 * 1024)
+#define CLIPRDR_FUSE_MAX_CHUNK_SIZE (1024 * 1024)
+
 typedef struct
 {
 	UINT32 stream_id;
 	/* must be one of FILECONTENTS_SIZE or FILECONTENTS_RANGE*/
 	UINT32 req_type;
+	/* NULL for FILECONTENTS_RANGE requests of a pipeline */
 	fuse_req_t req;
 	/*for FILECONTENTS_SIZE must be ino number* */
 	size_t req_ino;
 } xfCliprdrFuseStream;
 
+typedef struct
+{
+	UINT32 stream_id;
+	UINT64 offset;
+	UINT32 size;
+	UINT32 length;
+	BOOL done;
+	BOOL failed;
+	BYTE* data;
+} xfCliprdrFuseChunk;
+
+typedef struct
+{
+	fuse_req_t req;
+	UINT64 offset;
+	size_t size;
+} xfCliprdrFuseRead;
+
+/**
+ * Requests the contents of a file read in sequence ahead of the reads, the reads are answered
+ * from the chunks received.
+ */
+typedef struct
+{
+	size_t ino;
+	UINT32 lindex;
+	BOOL size_set;
+	UINT64 size;
+	/* position of the next chunk requested */
+	UINT64 next;
+	UINT32 chunk_size;
+	/* end of the last read answered */
+	UINT64 consumed;
+	BOOL eof;
+	wArrayList* chunks;
+	wArrayList* reads;
+} xfCliprdrFusePipeline;
+
 typedef struct
 {
 	size_t parent_ino;
@@ -180,6 +225,7 @@ struct xf_clipboard
 	wArrayList* stream_list;
 	UINT32 current_stream_id;
 	wArrayList* ino_list;
+	wArrayList* pipelines;
 #endif
 };
 
@@ -992,12 +1038,17 @@ static void xf_cliprdr_clear_cached_data(xfClipboard* clipboard)
 		for (index = 0; index < count; index++)
 		{
 			stream = (xfCliprdrFuseStream*)ArrayList_GetItem(clipboard->stream_list, index);
-			fuse_reply_err(stream->req, EIO);
+
+			if (stream->req)
+				fuse_reply_err(stream->req, EIO);
 		}
 		ArrayList_Unlock(clipboard->stream_list);
 
 		ArrayList_Clear(clipboard->stream_list);
 	}
+	/* replies an error to the reads waiting */
+	if (clipboard->pipelines)
+		ArrayList_Clear(clipboard->pipelines);
 	if (clipboard->ino_list)
 	{
 		ArrayList_Clear(clipboard->ino_list);
@@ -1377,6 +1428,438 @@ static UINT xf_cliprdr_send_client_file_contents(xfClipboard* clipboard, UINT32
 	                                                     &formatFileContentsRequest);
 }
 
+static void xf_cliprdr_fuse_chunk_free(void* obj)
+{
+	xfCliprdrFuseChunk* chunk = (xfCliprdrFuseChunk*)obj;
+
+	if (!chunk)
+		return;
+
+	free(chunk->data);
+	free(chunk);
+}
+
+static void xf_cliprdr_fuse_pipeline_free(void* obj)
+{
+	size_t index;
+	xfCliprdrFusePipeline* pipeline = (xfCliprdrFusePipeline*)obj;
+
+	if (!pipeline)
+		return;
+
+	if (pipeline->reads)
+	{
+		for (index = 0; index < ArrayList_Count(pipeline->reads); index++)
+		{
+			xfCliprdrFuseRead* read =
+			    (xfCliprdrFuseRead*)ArrayList_GetItem(pipeline->reads, index);
+			fuse_reply_err(read->req, EIO);
+		}
+	}
+
+	ArrayList_Free(pipeline->reads);
+	ArrayList_Free(pipeline->chunks);
+	free(pipeline);
+}
+
+static xfCliprdrFusePipeline* xf_cliprdr_fuse_pipeline_new(size_t ino, UINT32 lindex)
+{
+	wObject* obj;
+	xfCliprdrFusePipeline* pipeline =
+	    (xfCliprdrFusePipeline*)calloc(1, sizeof(xfCliprdrFusePipeline));
+
+	if (!pipeline)
+		return NULL;
+
+	pipeline->ino = ino;
+	pipeline->lindex = lindex;
+	pipeline->chunks = ArrayList_New(FALSE);
+	pipeline->reads = ArrayList_New(FALSE);
+
+	if (!pipeline->chunks || !pipeline->reads)
+	{
+		xf_cliprdr_fuse_pipeline_free(pipeline);
+		return NULL;
+	}
+
+	obj = ArrayList_Object(pipeline->chunks);
+	obj->fnObjectFree = xf_cliprdr_fuse_chunk_free;
+	obj = ArrayList_Object(pipeline->reads);
+	obj->fnObjectFree = free;
+	return pipeline;
+}
+
+/* Must be called with the pipelines locked */
+static xfCliprdrFusePipeline* xf_cliprdr_fuse_pipeline_find(xfClipboard* clipboard, size_t ino)
+{
+	size_t index;
+
+	for (index = 0; index < ArrayList_Count(clipboard->pipelines); index++)
+	{
+		xfCliprdrFusePipeline* pipeline =
+		    (xfCliprdrFusePipeline*)ArrayList_GetItem(clipboard->pipelines, index);
+
+		if (pipeline->ino == ino)
+			return pipeline;
+	}
+
+	return NULL;
+}
+
+static xfCliprdrFuseChunk* xf_cliprdr_fuse_pipeline_chunk_at(xfCliprdrFusePipeline* pipeline,
+                                                             UINT64 offset)
+{
+	size_t index;
+
+	for (index = 0; index < ArrayList_Count(pipeline->chunks); index++)
+	{
+		xfCliprdrFuseChunk* chunk =
+		    (xfCliprdrFuseChunk*)ArrayList_GetItem(pipeline->chunks, index);
+
+		if ((offset >= chunk->offset) && (offset - chunk->offset < chunk->size))
+			return chunk;
+	}
+
+	return NULL;
+}
+
+static BOOL xf_cliprdr_fuse_pipeline_request(xfClipboard* clipboard,
+                                             xfCliprdrFusePipeline* pipeline, UINT64 offset,
+                                             UINT32 size)
+{
+	UINT error;
+	xfCliprdrFuseStream* stream;
+	xfCliprdrFuseChunk* chunk = (xfCliprdrFuseChunk*)calloc(1, sizeof(xfCliprdrFuseChunk));
+
+	if (!chunk)
+		return FALSE;
+
+	stream = (xfCliprdrFuseStream*)calloc(1, sizeof(xfCliprdrFuseStream));
+
+	if (!stream)
+		goto fail;
+
+	stream->req_type = FILECONTENTS_RANGE;
+	stream->req_ino = pipeline->ino;
+	ArrayList_Lock(clipboard->stream_list);
+	stream->stream_id = clipboard->current_stream_id++;
+	chunk->stream_id = stream->stream_id;
+
+	if (!ArrayList_Append(clipboard->stream_list, stream))
+	{
+		ArrayList_Unlock(clipboard->stream_list);
+		free(stream);
+		goto fail;
+	}
+
+	ArrayList_Unlock(clipboard->stream_list);
+	chunk->offset = offset;
+	chunk->size = size;
+
+	if (!ArrayList_Append(pipeline->chunks, chunk))
+		goto fail;
+
+	error = xf_cliprdr_send_client_file_contents(clipboard, chunk->stream_id, pipeline->lindex,
+	                                             FILECONTENTS_RANGE, (UINT32)(offset & 0xFFFFFFFF),
+	                                             (UINT32)(offset >> 32), size);
+
+	if (error != CHANNEL_RC_OK)
+	{
+		chunk->done = TRUE;
+		chunk->failed = TRUE;
+	}
+
+	return TRUE;
+
+fail:
+	xf_cliprdr_fuse_chunk_free(chunk);
+	return FALSE;
+}
+
+/* keeps CLIPRDR_FUSE_PIPELINE_DEPTH chunks after the last read */
+static void xf_cliprdr_fuse_pipeline_fill(xfClipboard* clipboard, xfCliprdrFusePipeline* pipeline)
+{
+	/* nothing to read ahead of before the first read */
+	if (pipeline->next == UINT64_MAX)
+		return;
+
+	while (!pipeline->eof && (ArrayList_Count(pipeline->chunks) < CLIPRDR_FUSE_PIPELINE_DEPTH))
+	{
+		UINT32 size = pipeline->chunk_size;
+
+		if (pipeline->size_set)
+		{
+			if (pipeline->next >= pipeline->size)
+				break;
+
+			size = (UINT32)MIN(size, pipeline->size - pipeline->next);
+		}
+
+		if (!xf_cliprdr_fuse_pipeline_request(clipboard, pipeline, pipeline->next, size))
+			break;
+
+		pipeline->next += size;
+	}
+}
+
+/**
+ * Copies the data of a read from the chunks to buffer, NULL only checks for it.
+ * @return FALSE if the data was not received yet
+ */
+static BOOL xf_cliprdr_fuse_pipeline_copy(xfCliprdrFusePipeline* pipeline,
+                                          const xfCliprdrFuseRead* read, BYTE* buffer,
+                                          size_t* length, int* err)
+{
+	UINT64 pos = read->offset;
+
+	*length = 0;
+	*err = 0;
+
+	while (*length < read->size)
+	{
+		size_t count;
+		const xfCliprdrFuseChunk* chunk = xf_cliprdr_fuse_pipeline_chunk_at(pipeline, pos);
+
+		/* after the end of the file */
+		if (!chunk)
+			return pipeline->eof || (pipeline->size_set && (pos >= pipeline->size));
+
+		if (!chunk->done)
+			return FALSE;
+
+		if (chunk->failed)
+		{
+			*err = EIO;
+			return TRUE;
+		}
+
+		/* a short chunk ends the file */
+		if (pos - chunk->offset >= chunk->length)
+			return TRUE;
+
+		count = MIN(read->size - *length, chunk->length - (pos - chunk->offset));
+
+		if (buffer)
+			memcpy(&buffer[*length], &chunk->data[pos - chunk->offset], count);
+
+		*length += count;
+		pos += count;
+	}
+
+	return TRUE;
+}
+
+/* drops the received chunks no read waits for anymore */
+static void xf_cliprdr_fuse_pipeline_drop(xfCliprdrFusePipeline* pipeline)
+{
+	size_t index;
+	UINT64 before = pipeline->consumed;
+
+	for (index = 0; index < ArrayList_Count(pipeline->reads); index++)
+	{
+		const xfCliprdrFuseRead* read =
+		    (const xfCliprdrFuseRead*)ArrayList_GetItem(pipeline->reads, index);
+		before = MIN(before, read->offset);
+	}
+
+	index = 0;
+
+	while (index < ArrayList_Count(pipeline->chunks))
+	{
+		const xfCliprdrFuseChunk* chunk =
+		    (const xfCliprdrFuseChunk*)ArrayList_GetItem(pipeline->chunks, index);
+
+		if (chunk->done && (chunk->offset + chunk->size <= before))
+			ArrayList_RemoveAt(pipeline->chunks, index);
+		else
+			index++;
+	}
+}
+
+/* Answers the reads the data was received for and requests the following chunks */
+static void xf_cliprdr_fuse_pipeline_serve(xfClipboard* clipboard,
+                                           xfCliprdrFusePipeline* pipeline)
+{
+	size_t index = 0;
+
+	while (index < ArrayList_Count(pipeline->reads))
+	{
+		int err;
+		size_t length;
+		BYTE* buffer;
+		xfCliprdrFuseRead* read = (xfCliprdrFuseRead*)ArrayList_GetItem(pipeline->reads, index);
+
+		if (!xf_cliprdr_fuse_pipeline_copy(pipeline, read, NULL, &length, &err))
+		{
+			index++;
+			continue;
+		}
+
+		if (err)
+		{
+			/* fail the other reads too and start over with the next one */
+			for (index = 0; index < ArrayList_Count(pipeline->reads); index++)
+			{
+				read = (xfCliprdrFuseRead*)ArrayList_GetItem(pipeline->reads, index);
+				fuse_reply_err(read->req, err);
+			}
+
+			ArrayList_Clear(pipeline->reads);
+			ArrayList_Clear(pipeline->chunks);
+			pipeline->next = UINT64_MAX;
+			return;
+		}
+
+		buffer = (length > 0) ? (BYTE*)malloc(length) : NULL;
+
+		if ((length > 0) && !buffer)
+			fuse_reply_err(read->req, ENOMEM);
+		else
+		{
+			xf_cliprdr_fuse_pipeline_copy(pipeline, read, buffer, &length, &err);
+			fuse_reply_buf(read->req, (const char*)buffer, length);
+			pipeline->consumed = read->offset + length;
+		}
+
+		free(buffer);
+		ArrayList_RemoveAt(pipeline->reads, index);
+	}
+
+	xf_cliprdr_fuse_pipeline_drop(pipeline);
+	xf_cliprdr_fuse_pipeline_fill(clipboard, pipeline);
+}
+
+static int xf_cliprdr_fuse_pipeline_read(xfClipboard* clipboard, fuse_req_t req, size_t ino,
+                                         UINT32 lindex, BOOL size_set, UINT64 size,
+                                         size_t length, UINT64 offset)
+{
+	int err = 0;
+	xfCliprdrFuseRead* read;
+	xfCliprdrFusePipeline* pipeline;
+
+	ArrayList_Lock(clipboard->pipelines);
+	pipeline = xf_cliprdr_fuse_pipeline_find(clipboard, ino);
+
+	if (!pipeline)
+	{
+		pipeline = xf_cliprdr_fuse_pipeline_new(ino, lindex);
+
+		if (!pipeline || !ArrayList_Append(clipboard->pipelines, pipeline))
+		{
+			xf_cliprdr_fuse_pipeline_free(pipeline);
+			err = ENOMEM;
+			goto out;
+		}
+
+		pipeline->next = UINT64_MAX;
+	}
+
+	read = (xfCliprdrFuseRead*)calloc(1, sizeof(xfCliprdrFuseRead));
+
+	if (!read)
+	{
+		err = ENOMEM;
+		goto out;
+	}
+
+	read->req = req;
+	read->offset = offset;
+	read->size = length;
+	pipeline->size_set = size_set;
+	pipeline->size = size;
+
+	if (!xf_cliprdr_fuse_pipeline_chunk_at(pipeline, offset))
+	{
+		const UINT32 chunk_size =
+		    (UINT32)MAX(CLIPRDR_FUSE_MIN_CHUNK_SIZE, MIN(length, CLIPRDR_FUSE_MAX_CHUNK_SIZE));
+
+		/* not read in sequence, start over unless other reads wait for the chunks */
+		if (ArrayList_Count(pipeline->reads) == 0)
+		{
+			ArrayList_Clear(pipeline->chunks);
+			pipeline->next = offset;
+			pipeline->chunk_size = chunk_size;
+			pipeline->consumed = offset;
+			pipeline->eof = FALSE;
+		}
+		else if (!xf_cliprdr_fuse_pipeline_request(clipboard, pipeline, offset, chunk_size))
+		{
+			free(read);
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	if (!ArrayList_Append(pipeline->reads, read))
+	{
+		free(read);
+		err = ENOMEM;
+		goto out;
+	}
+
+	xf_cliprdr_fuse_pipeline_serve(clipboard, pipeline);
+
+out:
+	ArrayList_Unlock(clipboard->pipelines);
+	return err;
+}
+
+static void xf_cliprdr_fuse_pipeline_response(xfClipboard* clipboard, size_t ino,
+                                              UINT32 stream_id, BOOL failed, const BYTE* data,
+                                              size_t length)
+{
+	size_t index;
+	xfCliprdrFuseChunk* chunk = NULL;
+	xfCliprdrFusePipeline* pipeline;
+
+	ArrayList_Lock(clipboard->pipelines);
+	pipeline = xf_cliprdr_fuse_pipeline_find(clipboard, ino);
+
+	if (!pipeline)
+		goto out;
+
+	for (index = 0; index < ArrayList_Count(pipeline->chunks); index++)
+	{
+		xfCliprdrFuseChunk* cur = (xfCliprdrFuseChunk*)ArrayList_GetItem(pipeline->chunks, index);
+
+		if (cur->stream_id == stream_id)
+			chunk = cur;
+	}
+
+	/* of a pipeline started over */
+	if (!chunk || chunk->done)
+		goto out;
+
+	chunk->done = TRUE;
+	chunk->failed = failed || (length > chunk->size);
+
+	if (!chunk->failed && (length > 0))
+	{
+		chunk->data = (BYTE*)malloc(length);
+
+		if (chunk->data)
+			memcpy(chunk->data, data, length);
+		else
+			chunk->failed = TRUE;
+	}
+
+	if (!chunk->failed)
+	{
+		chunk->length = (UINT32)length;
+
+		if (length < chunk->size)
+			pipeline->eof = TRUE;
+		else if ((chunk->size == pipeline->chunk_size) &&
+		         (pipeline->chunk_size < CLIPRDR_FUSE_MAX_CHUNK_SIZE))
+			pipeline->chunk_size *= 2;
+	}
+
+	xf_cliprdr_fuse_pipeline_serve(clipboard, pipeline);
+
+out:
+	ArrayList_Unlock(clipboard->pipelines);
+}
+
 /**
  * Function description
  *
@@ -1432,6 +1915,14 @@ xf_cliprdr_server_file_contents_response(CliprdrClientContext* context,
 	ArrayList_RemoveAt(clipboard->stream_list, index);
 	ArrayList_Unlock(clipboard->stream_list);
 
+	if (!req)
+	{
+		xf_cliprdr_fuse_pipeline_response(clipboard, req_ino, stream_id,
+		                                  fileContentsResponse->msgFlags & CB_RESPONSE_FAIL,
+		                                  data, data_len);
+		return CHANNEL_RC_OK;
+	}
+
 	switch (req_type)
 	{
 		case FILECONTENTS_SIZE:
@@ -2423,30 +2914,23 @@ error:
 	return err;
 }
 
-static int xf_cliprdr_fuse_util_add_stream_list(xfClipboard* clipboard, fuse_req_t req,
-                                                UINT32* stream_id)
+static int xf_cliprdr_fuse_util_size(xfClipboard* clipboard, fuse_ino_t ino, BOOL* size_set,
+                                     UINT64* size)
 {
 	int err = 0;
-	xfCliprdrFuseStream* stream = (xfCliprdrFuseStream*)calloc(1, sizeof(xfCliprdrFuseStream));
-	if (!stream)
-	{
-		err = ENOMEM;
-		return err;
-	}
-	ArrayList_Lock(clipboard->stream_list);
-	stream->req = req;
-	stream->req_type = FILECONTENTS_RANGE;
-	stream->stream_id = clipboard->current_stream_id;
-	*stream_id = stream->stream_id;
-	stream->req_ino = 0;
-	clipboard->current_stream_id++;
-	if (!ArrayList_Append(clipboard->stream_list, stream))
+	xfCliprdrFuseInode* node;
+	ArrayList_Lock(clipboard->ino_list);
+
+	node = xf_cliprdr_fuse_util_get_inode(clipboard->ino_list, ino);
+	if (!node)
+		err = ENOENT;
+	else
 	{
-		err = ENOMEM;
-		goto error;
+		*size_set = node->size_set && (node->st_size >= 0);
+		*size = *size_set ? (UINT64)node->st_size : 0;
 	}
-error:
-	ArrayList_Unlock(clipboard->stream_list);
+
+	ArrayList_Unlock(clipboard->ino_list);
 	return err;
 }
 
@@ -2596,27 +3080,36 @@ static void xf_cliprdr_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size, of
 	int err;
 	xfClipboard* clipboard = (xfClipboard*)fuse_req_userdata(req);
 	UINT32 lindex;
-	UINT32 stream_id;
+	BOOL size_set;
+	UINT64 file_size;
 
 	err = xf_cliprdr_fuse_util_lindex(clipboard, ino, &lindex);
+	if (!err)
+		err = xf_cliprdr_fuse_util_size(clipboard, ino, &size_set, &file_size);
+	if (!err && (off < 0))
+		err = EINVAL;
+	if (!err)
+		err = xf_cliprdr_fuse_pipeline_read(clipboard, req, ino, lindex, size_set, file_size,
+		                                    size, (UINT64)off);
 	if (err)
-	{
 		fuse_reply_err(req, err);
-		return;
-	}
+}
 
-	err = xf_cliprdr_fuse_util_add_stream_list(clipboard, req, &stream_id);
-	if (err)
-	{
-		fuse_reply_err(req, err);
-		return;
-	}
+static void xf_cliprdr_fuse_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi)
+{
+	xfCliprdrFusePipeline* pipeline;
+	xfClipboard* clipboard = (xfClipboard*)fuse_req_userdata(req);
+
+	WINPR_UNUSED(fi);
 
-	UINT32 nPositionLow = (off >> 0) & 0xFFFFFFFF;
-	UINT32 nPositionHigh = (off >> 32) & 0xFFFFFFFF;
+	/* drops the chunks received ahead */
+	ArrayList_Lock(clipboard->pipelines);
+	pipeline = xf_cliprdr_fuse_pipeline_find(clipboard, ino);
+	if (pipeline && (ArrayList_Count(pipeline->reads) == 0))
+		ArrayList_Remove(clipboard->pipelines, pipeline);
+	ArrayList_Unlock(clipboard->pipelines);
 
-	xf_cliprdr_send_client_file_contents(clipboard, stream_id, lindex, FILECONTENTS_RANGE,
-	                                     nPositionLow, nPositionHigh, size);
+	fuse_reply_err(req, 0);
 }
 
 static void xf_cliprdr_fuse_lookup(fuse_req_t req, fuse_ino_t parent, const char* name)
@@ -2740,6 +3233,7 @@ static struct fuse_lowlevel_ops xf_cliprdr_fuse_oper = {
 	.readdir = xf_cliprdr_fuse_readdir,
 	.open = xf_cliprdr_fuse_open,
 	.read = xf_cliprdr_fuse_read,
+	.release = xf_cliprdr_fuse_release,
 	.opendir = xf_cliprdr_fuse_opendir,
 };
 
@@ -2994,6 +3488,15 @@ xfClipboard* xf_clipboard_new(xfContext* xfc)
 	obj = ArrayList_Object(clipboard->ino_list);
 	obj->fnObjectFree = xf_cliprdr_fuse_inode_free;
 
+	clipboard->pipelines = ArrayList_New(TRUE);
+	if (!clipboard->pipelines)
+	{
+		WLog_ERR(TAG, "failed to allocate pipelines");
+		goto error3;
+	}
+	obj = ArrayList_Object(clipboard->pipelines);
+	obj->fnObjectFree = xf_cliprdr_fuse_pipeline_free;
+
 	if (!(clipboard->fuse_thread =
 	          CreateThread(NULL, 0, xf_cliprdr_fuse_thread, clipboard, 0, NULL)))
 	{
@@ -3010,6 +3513,7 @@ xfClipboard* xf_clipboard_new(xfContext* xfc)
 #ifdef WITH_FUSE
 error3:
 
+	ArrayList_Free(clipboard->pipelines);
 	ArrayList_Free(clipboard->ino_list);
 error2:
 
@@ -3072,6 +3576,7 @@ void xf_clipboard_free(xfClipboard* clipboard)
 		free(clipboard->delegate->basePath);
 
 	// fuse related
+	ArrayList_Free(clipboard->pipelines);
 	ArrayList_Free(clipboard->stream_list);
 	ArrayList_Free(clipboard->ino_list);
 #endif
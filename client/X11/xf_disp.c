@@ -36,6 +36,7 @@
 
 #define TAG CLIENT_TAG("x11disp")
 #define RESIZE_MIN_DELAY 200 /* minimum delay in ms between two resizes */
+#define RESIZE_SETTLE_DELAY 100 /* the window size must be stable this long before sending */
 
 struct s_xfDispContext
 {
@@ -48,6 +49,7 @@ struct s_xfDispContext
 	UINT32 lastSentHeight;
 	BYTE reserved[4];
 	UINT64 lastSentDate;
+	UINT64 lastChangeDate;
 	UINT32 targetWidth;
 	UINT32 targetHeight;
 	BOOL activated;
@@ -117,6 +119,7 @@ static BOOL xf_disp_sendResize(xfDispContext* xfDisp)
 	DISPLAY_CONTROL_MONITOR_LAYOUT layout;
 	xfContext* xfc;
 	rdpSettings* settings;
+	UINT64 now;
 
 	if (!xfDisp || !xfDisp->xfc)
 		return FALSE;
@@ -130,13 +133,18 @@ static BOOL xf_disp_sendResize(xfDispContext* xfDisp)
 	if (!xfDisp->activated || !xfDisp->disp)
 		return TRUE;
 
-	if (GetTickCount64() - xfDisp->lastSentDate < RESIZE_MIN_DELAY)
+	if (!xf_disp_settings_changed(xfDisp))
 		return TRUE;
 
-	if (!xf_disp_settings_changed(xfDisp))
+	/* Wait for the user to stop dragging, the timer commits the final size */
+	now = GetTickCount64();
+	if (now - xfDisp->lastChangeDate < RESIZE_SETTLE_DELAY)
+		return TRUE;
+
+	if (now - xfDisp->lastSentDate < RESIZE_MIN_DELAY)
 		return TRUE;
 
-	xfDisp->lastSentDate = GetTickCount64();
+	xfDisp->lastSentDate = now;
 	if (xfc->fullscreen && (settings->MonitorCount > 0))
 	{
 		if (xf_disp_sendLayout(xfDisp->disp, settings->MonitorDefArray, settings->MonitorCount) !=
@@ -169,7 +177,7 @@ static BOOL xf_disp_queueResize(xfDispContext* xfDisp, UINT32 width, UINT32 heig
 		return TRUE;
 	xfDisp->targetWidth = width;
 	xfDisp->targetHeight = height;
-	xfDisp->lastSentDate = GetTickCount64();
+	xfDisp->lastChangeDate = GetTickCount64();
 	return xf_disp_sendResize(xfDisp);
 }
 
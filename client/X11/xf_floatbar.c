@@ -22,6 +22,7 @@
 #include <X11/cursorfont.h>
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "xf_floatbar.h"
 #include "resource/close.xbm"
@@ -40,6 +41,7 @@
 #define FLOATBAR_COLOR_BACKGROUND "RGB:31/6c/a9"
 #define FLOATBAR_COLOR_BORDER "RGB:75/9a/c8"
 #define FLOATBAR_COLOR_FOREGROUND "RGB:FF/FF/FF"
+#define FLOATBAR_STATS_INTERVAL 1000
 
 #ifdef WITH_DEBUG_X11
 #define DEBUG_X11(...) WLog_DBG(TAG, __VA_ARGS__)
@@ -91,6 +93,12 @@ struct xf_floatbar
 	BOOL created;
 	Window root_window;
 	char* title;
+
+	/* frame rate, decode, present and round trip time since the last update */
+	char stats[128];
+	UINT64 statsUpdated;
+	FREERDP_METRIC_HISTOGRAM_SUMMARY statsLast[3];
+	double statsValues[3];
 };
 
 static xfFloatbarButton* xf_floatbar_new_button(xfFloatbar* floatbar, int type);
@@ -356,6 +364,7 @@ static void xf_floatbar_event_expose(xfFloatbar* floatbar)
 	Pixmap pmap;
 	XPoint shape[5], border[5];
 	int len;
+	char text[MAX_PATH + 160];
 	Display* display = floatbar->xfc->display;
 
 	/* create the pixmap that we'll use for shaping the window */
@@ -398,14 +407,69 @@ static void xf_floatbar_event_expose(xfFloatbar* floatbar)
 	XSetForeground(display, gc, xf_floatbar_get_color(floatbar, FLOATBAR_COLOR_BORDER));
 	XDrawLines(display, floatbar->handle, gc, border, 5, CoordModeOrigin);
 	/* draw the host name connected to (limit to maximum file name) */
-	len = strnlen(floatbar->title, MAX_PATH);
+	if (floatbar->stats[0] != '\0')
+		_snprintf(text, sizeof(text), "%.*s | %s", MAX_PATH, floatbar->title, floatbar->stats);
+	else
+		_snprintf(text, sizeof(text), "%.*s", MAX_PATH, floatbar->title);
+
+	len = strnlen(text, sizeof(text));
 	XSetForeground(display, gc, xf_floatbar_get_color(floatbar, FLOATBAR_COLOR_FOREGROUND));
-	XDrawString(display, floatbar->handle, gc, floatbar->width / 2 - len * 2, 15, floatbar->title,
-	            len);
+	XDrawString(display, floatbar->handle, gc, floatbar->width / 2 - len * 2, 15, text, len);
 	XFreeGC(display, gc);
 	XFreeGC(display, shape_gc);
 }
 
+/* the average of the values recorded since the last call, the previous one without new values */
+static double xf_floatbar_average_ms(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM histogram,
+                                     FREERDP_METRIC_HISTOGRAM_SUMMARY* last, double previous)
+{
+	double average = previous;
+	FREERDP_METRIC_HISTOGRAM_SUMMARY summary = { 0 };
+
+	if (!metrics_histogram_get(metrics, histogram, &summary))
+		return previous;
+
+	if (summary.count > last->count)
+		average = (double)(summary.sum - last->sum) / (double)(summary.count - last->count) /
+		          1000.0;
+
+	*last = summary;
+	return average;
+}
+
+BOOL xf_floatbar_update_stats(xfFloatbar* floatbar)
+{
+	rdpMetrics* metrics;
+	const UINT64 now = GetTickCount64();
+	const FREERDP_METRIC_HISTOGRAM histograms[] = { FREERDP_METRIC_FRAME_DECODE_TIME,
+		                                            FREERDP_METRIC_PRESENT_TIME,
+		                                            FREERDP_METRIC_RTT };
+	size_t x;
+
+	if (!floatbar || ((floatbar->flags & 0x0040) == 0))
+		return TRUE;
+
+	if (now - floatbar->statsUpdated < FLOATBAR_STATS_INTERVAL)
+		return TRUE;
+
+	floatbar->statsUpdated = now;
+	metrics = floatbar->xfc->common.context.metrics;
+
+	for (x = 0; x < ARRAYSIZE(histograms); x++)
+		floatbar->statsValues[x] = xf_floatbar_average_ms(
+		    metrics, histograms[x], &floatbar->statsLast[x], floatbar->statsValues[x]);
+
+	_snprintf(floatbar->stats, sizeof(floatbar->stats),
+	          "%.0f fps, decode %.1f ms, present %.1f ms, rtt %.0f ms",
+	          metrics_counter_rate(metrics, FREERDP_METRIC_FRAMES_DECODED),
+	          floatbar->statsValues[0], floatbar->statsValues[1], floatbar->statsValues[2]);
+
+	if (floatbar->created)
+		xf_floatbar_event_expose(floatbar);
+
+	return TRUE;
+}
+
 static xfFloatbarButton* xf_floatbar_get_button(xfFloatbar* floatbar, Window window)
 {
 	int i, size;
@@ -30,5 +30,6 @@ BOOL xf_floatbar_check_event(xfFloatbar* floatbar, const XEvent* event);
 BOOL xf_floatbar_toggle_fullscreen(xfFloatbar* floatbar, bool visible);
 BOOL xf_floatbar_hide_and_show(xfFloatbar* floatbar);
 BOOL xf_floatbar_set_root_y(xfFloatbar* floatbar, int y);
+BOOL xf_floatbar_update_stats(xfFloatbar* floatbar);
 
 #endif /* FREERDP_CLIENT_X11_FLOATBAR_H */
@@ -1056,20 +1056,22 @@ static BOOL xf_gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND*
 	switch (cmd->bmp.codecID)
 	{
 		case RDP_CODEC_ID_REMOTEFX:
-			if (!rfx_process_message(context->codecs->rfx, cmd->bmp.bitmapData,
-			                         cmd->bmp.bitmapDataLength, cmd->destLeft, cmd->destTop,
-			                         gdi->primary_buffer, gdi->dstFormat, gdi->stride, gdi->height,
-			                         &region))
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_REMOTEFX) ||
+			    !rfx_process_message(context->codecs->rfx, cmd->bmp.bitmapData,
+			                             cmd->bmp.bitmapDataLength, cmd->destLeft, cmd->destTop,
+			                             gdi->primary_buffer, gdi->dstFormat, gdi->stride,
+			                             gdi->height, &region))
 				goto fail;
 
 			break;
 
 		case RDP_CODEC_ID_NSCODEC:
-			if (!nsc_process_message(context->codecs->nsc, cmd->bmp.bpp, cmd->bmp.width,
-			                         cmd->bmp.height, cmd->bmp.bitmapData,
-			                         cmd->bmp.bitmapDataLength, gdi->primary_buffer, gdi->dstFormat,
-			                         gdi->stride, 0, 0, cmd->bmp.width, cmd->bmp.height,
-			                         FREERDP_FLIP_VERTICAL))
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_NSCODEC) ||
+			    !nsc_process_message(context->codecs->nsc, cmd->bmp.bpp, cmd->bmp.width,
+			                             cmd->bmp.height, cmd->bmp.bitmapData,
+			                             cmd->bmp.bitmapDataLength, gdi->primary_buffer,
+			                             gdi->dstFormat, gdi->stride, 0, 0, cmd->bmp.width,
+			                             cmd->bmp.height, FREERDP_FLIP_VERTICAL))
 				goto fail;
 
 			region16_union_rect(&region, &region, &cmdRect);
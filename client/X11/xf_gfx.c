@@ -28,10 +28,120 @@
 
 #include <X11/Xutil.h>
 
+#ifdef WITH_XRENDER
+#include <X11/extensions/Xrender.h>
+#include <math.h>
+#endif
+
 #define TAG CLIENT_TAG("x11")
 
+/* the buffer of the surface image, shared with the X server if possible */
+static BYTE* xf_gfx_image_buffer_new(xfContext* xfc, xfGfxSurface* surface, size_t size)
+{
+	BYTE* data = xf_shm_attach(xfc, &surface->shm, size);
+
+	if (!data)
+	{
+		data = (BYTE*)_aligned_malloc(size, 16);
+
+		if (data)
+			ZeroMemory(data, size);
+	}
+
+	return data;
+}
+
+static void xf_gfx_image_buffer_free(xfContext* xfc, xfGfxSurface* surface, BYTE* data)
+{
+	if (data && (data == (BYTE*)surface->shm.shmaddr))
+		xf_shm_detach(xfc, &surface->shm);
+	else
+		_aligned_free(data);
+}
+
+static BOOL xf_gfx_scale_on_server(xfContext* xfc, double sx, double sy)
+{
+#ifdef WITH_XRENDER
+	return xfc->xrenderAvailable && ((sx != 1.0) || (sy != 1.0));
+#else
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(sx);
+	WINPR_UNUSED(sy);
+	return FALSE;
+#endif
+}
+
+#ifdef WITH_XRENDER
+/**
+ * A surface mapped to a scaled output is put unscaled to its pixmap and scaled by XRender, which
+ * most drivers run on the GPU.
+ */
+static BOOL xf_gfx_put_scaled(xfContext* xfc, xfGfxSurface* surface, Drawable drawable,
+                              UINT32 nXSrc, UINT32 nYSrc, UINT32 swidth, UINT32 sheight)
+{
+	int x, y, x2, y2;
+	Picture srcPicture;
+	Picture dstPicture;
+	XTransform transform = { 0 };
+	XRenderPictureAttributes pa = { 0 };
+	XRenderPictFormat* picFormat;
+	const double sx = surface->gdi.mappedWidth / (double)surface->gdi.outputTargetWidth;
+	const double sy = surface->gdi.mappedHeight / (double)surface->gdi.outputTargetHeight;
+
+	if (!surface->pixmap)
+	{
+		surface->pixmap = XCreatePixmap(xfc->display, xfc->drawable, surface->gdi.mappedWidth,
+		                                surface->gdi.mappedHeight, xfc->depth);
+
+		if (!surface->pixmap)
+			return FALSE;
+	}
+
+	xf_shm_put_image(xfc, surface->pixmap, surface->image, nXSrc, nYSrc, nXSrc, nYSrc, swidth,
+	                 sheight);
+	picFormat = XRenderFindVisualFormat(xfc->display, xfc->visual);
+	pa.subwindow_mode = IncludeInferiors;
+	srcPicture = XRenderCreatePicture(xfc->display, surface->pixmap, picFormat, 0, NULL);
+	dstPicture = XRenderCreatePicture(xfc->display, drawable, picFormat, CPSubwindowMode, &pa);
+	XRenderSetPictureFilter(xfc->display, srcPicture, FilterBilinear, 0, 0);
+	transform.matrix[0][0] = XDoubleToFixed(sx);
+	transform.matrix[1][1] = XDoubleToFixed(sy);
+	transform.matrix[2][2] = XDoubleToFixed(1.0);
+	XRenderSetPictureTransform(xfc->display, srcPicture, &transform);
+	/* the composite coordinates are in output space, the transform maps them to the surface */
+	x = (int)floor(nXSrc / sx);
+	y = (int)floor(nYSrc / sy);
+	x2 = (int)ceil((nXSrc + swidth) / sx);
+	y2 = (int)ceil((nYSrc + sheight) / sy);
+	XRenderComposite(xfc->display, PictOpSrc, srcPicture, None, dstPicture, x, y, 0, 0,
+	                 (int)surface->gdi.outputOriginX + x, (int)surface->gdi.outputOriginY + y,
+	                 (unsigned)(x2 - x), (unsigned)(y2 - y));
+	XRenderFreePicture(xfc->display, srcPicture);
+	XRenderFreePicture(xfc->display, dstPicture);
+	return TRUE;
+}
+#endif
+
+static BOOL xf_gfx_put(xfContext* xfc, xfGfxSurface* surface, Drawable drawable, BOOL scale,
+                       UINT32 nXSrc, UINT32 nYSrc, UINT32 swidth, UINT32 sheight, UINT32 nXDst,
+                       UINT32 nYDst, UINT32 dwidth, UINT32 dheight)
+{
+#ifdef WITH_XRENDER
+	if (scale)
+		return xf_gfx_put_scaled(xfc, surface, drawable, nXSrc, nYSrc, swidth, sheight);
+#else
+	WINPR_UNUSED(scale);
+	WINPR_UNUSED(swidth);
+	WINPR_UNUSED(sheight);
+#endif
+
+	xf_shm_put_image(xfc, drawable, surface->image, nXSrc, nYSrc, nXDst, nYDst, dwidth, dheight);
+	return TRUE;
+}
+
 static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 {
+	BOOL scale;
 	UINT rc = ERROR_INTERNAL_ERROR;
 	UINT32 surfaceX, surfaceY;
 	RECTANGLE_16 surfaceRect;
@@ -61,8 +171,12 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 	XSetFillStyle(xfc->display, xfc->gc, FillSolid);
 	region16_intersect_rect(&(surface->gdi.invalidRegion), &(surface->gdi.invalidRegion),
 	                        &surfaceRect);
+	/* a little overdraw is cheaper than an XPutImage per tile */
+	region16_coalesce(&surface->gdi.invalidRegion,
+	                  freerdp_settings_get_uint32(settings, FreeRDP_GfxOutputMaxRects));
 	sx = surface->gdi.outputTargetWidth / (double)surface->gdi.mappedWidth;
 	sy = surface->gdi.outputTargetHeight / (double)surface->gdi.mappedHeight;
+	scale = xf_gfx_scale_on_server(xfc, sx, sy);
 
 	if (!(rects = region16_rects(&surface->gdi.invalidRegion, &nbRects)))
 		return CHANNEL_RC_OK;
@@ -78,18 +192,22 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		const UINT32 dwidth = swidth * sx;
 		const UINT32 dheight = sheight * sy;
 
+		/* the stage only converts the format if the server scales */
 		if (surface->stage)
 		{
 			if (!freerdp_image_scale(surface->stage, gdi->dstFormat, surface->stageScanline, nXSrc,
-			                         nYSrc, dwidth, dheight, surface->gdi.data, surface->gdi.format,
+			                         nYSrc, scale ? swidth : dwidth, scale ? sheight : dheight,
+			                         surface->gdi.data, surface->gdi.format,
 			                         surface->gdi.scanline, nXSrc, nYSrc, swidth, sheight))
 				goto fail;
 		}
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			if (!xf_gfx_put(xfc, surface, xfc->primary, scale, nXSrc, nYSrc, swidth, sheight,
+			                nXDst, nYDst, dwidth, dheight))
+				goto fail;
+
 			xf_lock_x11(xfc);
 			xf_rail_paint(xfc, nXDst, nYDst, nXDst + dwidth, nYDst + dheight);
 			xf_unlock_x11(xfc);
@@ -98,15 +216,18 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 #ifdef WITH_XRENDER
 		    if (settings->SmartSizing || settings->MultiTouchGestures)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			if (!xf_gfx_put(xfc, surface, xfc->primary, scale, nXSrc, nYSrc, swidth, sheight,
+			                nXDst, nYDst, dwidth, dheight))
+				goto fail;
+
 			xf_draw_screen(xfc, nXDst, nYDst, dwidth, dheight);
 		}
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image, nXSrc, nYSrc, nXDst,
-			          nYDst, dwidth, dheight);
+			if (!xf_gfx_put(xfc, surface, xfc->drawable, scale, nXSrc, nYSrc, swidth, sheight,
+			                nXDst, nYDst, dwidth, dheight))
+				goto fail;
 		}
 	}
 
@@ -305,31 +426,40 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	surface->gdi.scanline = surface->gdi.width * GetBytesPerPixel(surface->gdi.format);
 	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline, xfc->scanline_pad);
 	size = surface->gdi.scanline * surface->gdi.height * 1ULL;
-	surface->gdi.data = (BYTE*)_aligned_malloc(size, 16);
 
-	if (!surface->gdi.data)
+	/* the decoders write to the image directly if the formats match */
+	if (AreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
 	{
-		WLog_ERR(TAG, "%s: unable to allocate GDI data", __FUNCTION__);
-		goto out_free;
-	}
+		surface->gdi.data = xf_gfx_image_buffer_new(xfc, surface, size);
 
-	ZeroMemory(surface->gdi.data, size);
+		if (!surface->gdi.data)
+		{
+			WLog_ERR(TAG, "%s: unable to allocate GDI data", __FUNCTION__);
+			goto out_free;
+		}
 
-	if (AreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
-	{
 		surface->image =
-		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-		                 (char*)surface->gdi.data, surface->gdi.mappedWidth,
-		                 surface->gdi.mappedHeight, xfc->scanline_pad, surface->gdi.scanline);
+		    xf_shm_create_image(xfc, &surface->shm, surface->gdi.data, surface->gdi.mappedWidth,
+		                        surface->gdi.mappedHeight, surface->gdi.scanline);
 	}
 	else
 	{
 		UINT32 width = surface->gdi.width;
 		UINT32 bytes = GetBytesPerPixel(gdi->dstFormat);
+
+		surface->gdi.data = (BYTE*)_aligned_malloc(size, 16);
+
+		if (!surface->gdi.data)
+		{
+			WLog_ERR(TAG, "%s: unable to allocate GDI data", __FUNCTION__);
+			goto out_free;
+		}
+
+		ZeroMemory(surface->gdi.data, size);
 		surface->stageScanline = width * bytes;
 		surface->stageScanline = x11_pad_scanline(surface->stageScanline, xfc->scanline_pad);
 		size = surface->stageScanline * surface->gdi.height * 1ULL;
-		surface->stage = (BYTE*)_aligned_malloc(size, 16);
+		surface->stage = xf_gfx_image_buffer_new(xfc, surface, size);
 
 		if (!surface->stage)
 		{
@@ -337,11 +467,9 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 			goto out_free_gdidata;
 		}
 
-		ZeroMemory(surface->stage, size);
 		surface->image =
-		    XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0, (char*)surface->stage,
-		                 surface->gdi.mappedWidth, surface->gdi.mappedHeight, xfc->scanline_pad,
-		                 surface->stageScanline);
+		    xf_shm_create_image(xfc, &surface->shm, surface->stage, surface->gdi.mappedWidth,
+		                        surface->gdi.mappedHeight, surface->stageScanline);
 	}
 
 	if (!surface->image)
@@ -363,12 +491,11 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 
 	return CHANNEL_RC_OK;
 error_set_surface_data:
-	surface->image->data = NULL;
-	XDestroyImage(surface->image);
+	xf_shm_destroy_image(surface->image);
 error_surface_image:
-	_aligned_free(surface->stage);
+	xf_gfx_image_buffer_free(xfc, surface, surface->stage);
 out_free_gdidata:
-	_aligned_free(surface->gdi.data);
+	xf_gfx_image_buffer_free(xfc, surface, surface->gdi.data);
 out_free:
 	free(surface);
 	return ret;
@@ -385,6 +512,8 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 	rdpCodecs* codecs = NULL;
 	xfGfxSurface* surface = NULL;
 	UINT status;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	xfContext* xfc = (xfContext*)gdi->context;
 	EnterCriticalSection(&context->mux);
 	surface = (xfGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -396,10 +525,14 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
 #endif
-		surface->image->data = NULL;
-		XDestroyImage(surface->image);
-		_aligned_free(surface->gdi.data);
-		_aligned_free(surface->stage);
+#ifdef WITH_XRENDER
+		if (surface->pixmap)
+			XFreePixmap(xfc->display, surface->pixmap);
+#endif
+
+		xf_shm_destroy_image(surface->image);
+		xf_gfx_image_buffer_free(xfc, surface, surface->gdi.data);
+		xf_gfx_image_buffer_free(xfc, surface, surface->stage);
 		region16_uninit(&surface->gdi.invalidRegion);
 		codecs = surface->gdi.codecs;
 		free(surface);
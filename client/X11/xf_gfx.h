@@ -24,6 +24,7 @@
 
 #include "xf_client.h"
 #include "xfreerdp.h"
+#include "xf_shm.h"
 
 #include <freerdp/gdi/gfx.h>
 
@@ -33,6 +34,12 @@ struct xf_gfx_surface
 	BYTE* stage;
 	UINT32 stageScanline;
 	XImage* image;
+	/* the buffer of the image is shared with the X server, if shmaddr is not NULL */
+	xfShmSegment shm;
+#ifdef WITH_XRENDER
+	/* the surface on the X server, XRender scales it to the output */
+	Pixmap pixmap;
+#endif
 };
 typedef struct xf_gfx_surface xfGfxSurface;
 
@@ -717,6 +717,7 @@ BOOL xf_register_graphics(rdpGraphics* graphics)
 	glyph.Draw = xf_Glyph_Draw;
 	glyph.BeginDraw = xf_Glyph_BeginDraw;
 	glyph.EndDraw = xf_Glyph_EndDraw;
+	glyph.DrawRun = NULL;
 	graphics_register_glyph(graphics, &glyph);
 	return TRUE;
 }
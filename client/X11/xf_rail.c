@@ -55,6 +55,7 @@ struct xf_rail_icon
 {
 	long* data;
 	int length;
+	UINT32 serial; /* changes with every conversion into the entry, 0 while empty */
 };
 typedef struct xf_rail_icon xfRailIcon;
 
@@ -64,6 +65,7 @@ struct xf_rail_icon_cache
 	UINT32 numCaches;
 	UINT32 numCacheEntries;
 	xfRailIcon scratch;
+	UINT32 nextSerial;
 };
 
 void xf_rail_enable_remoteapp_mode(xfContext* xfc)
@@ -270,6 +272,7 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 	xfContext* xfc = (xfContext*)context;
 	UINT32 fieldFlags = orderInfo->fieldFlags;
 	BOOL position_or_size_updated = FALSE;
+	BOOL visibility_updated = FALSE;
 	appWindow = xf_rail_get_window(xfc, orderInfo->windowId);
 
 	if (fieldFlags & WINDOW_ORDER_STATE_NEW)
@@ -326,28 +329,44 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 	if (!appWindow)
 		return FALSE;
 
-	/* Keep track of any position/size update so that we can force a refresh of the window */
-	if ((fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_WND_SIZE) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_SIZE) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_WND_CLIENT_DELTA) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_VIS_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_VISIBILITY))
+	/*
+	 * Servers resend fields that did not change, only values that differ from the window's
+	 * state cause X requests. A new window and updates held back while minimized apply all.
+	 */
+	if ((fieldFlags & WINDOW_ORDER_STATE_NEW) ||
+	    (appWindow->rail_pending_update && (appWindow->rail_state != WINDOW_SHOW_MINIMIZED)))
 	{
-		position_or_size_updated = TRUE;
+		if ((fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_WND_SIZE) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_OFFSET) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_SIZE) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_WND_CLIENT_DELTA) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_VIS_OFFSET) ||
+		    (fieldFlags & WINDOW_ORDER_FIELD_VISIBILITY) || appWindow->rail_pending_update)
+		{
+			position_or_size_updated = TRUE;
+			visibility_updated = TRUE;
+		}
 	}
 
 	/* Update Parameters */
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET)
 	{
+		if ((appWindow->windowOffsetX != windowState->windowOffsetX) ||
+		    (appWindow->windowOffsetY != windowState->windowOffsetY))
+			position_or_size_updated = TRUE;
+
 		appWindow->windowOffsetX = windowState->windowOffsetX;
 		appWindow->windowOffsetY = windowState->windowOffsetY;
 	}
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_WND_SIZE)
 	{
+		if ((appWindow->windowWidth != windowState->windowWidth) ||
+		    (appWindow->windowHeight != windowState->windowHeight))
+			position_or_size_updated = TRUE;
+
 		appWindow->windowWidth = windowState->windowWidth;
 		appWindow->windowHeight = windowState->windowHeight;
 	}
@@ -387,24 +406,44 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 			return FALSE;
 		}
 
-		free(appWindow->title);
-		appWindow->title = title;
+		if (appWindow->title && (strcmp(appWindow->title, title) == 0))
+		{
+			free(title);
+			fieldFlags &= ~WINDOW_ORDER_FIELD_TITLE;
+		}
+		else
+		{
+			free(appWindow->title);
+			appWindow->title = title;
+		}
 	}
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_OFFSET)
 	{
+		if ((appWindow->clientOffsetX != windowState->clientOffsetX) ||
+		    (appWindow->clientOffsetY != windowState->clientOffsetY))
+			position_or_size_updated = visibility_updated = TRUE;
+
 		appWindow->clientOffsetX = windowState->clientOffsetX;
 		appWindow->clientOffsetY = windowState->clientOffsetY;
 	}
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_SIZE)
 	{
+		if ((appWindow->clientAreaWidth != windowState->clientAreaWidth) ||
+		    (appWindow->clientAreaHeight != windowState->clientAreaHeight))
+			position_or_size_updated = TRUE;
+
 		appWindow->clientAreaWidth = windowState->clientAreaWidth;
 		appWindow->clientAreaHeight = windowState->clientAreaHeight;
 	}
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_WND_CLIENT_DELTA)
 	{
+		if ((appWindow->windowClientDeltaX != windowState->windowClientDeltaX) ||
+		    (appWindow->windowClientDeltaY != windowState->windowClientDeltaY))
+			position_or_size_updated = visibility_updated = TRUE;
+
 		appWindow->windowClientDeltaX = windowState->windowClientDeltaX;
 		appWindow->windowClientDeltaY = windowState->windowClientDeltaY;
 	}
@@ -434,12 +473,28 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_VIS_OFFSET)
 	{
+		if ((appWindow->visibleOffsetX != windowState->visibleOffsetX) ||
+		    (appWindow->visibleOffsetY != windowState->visibleOffsetY))
+			position_or_size_updated = visibility_updated = TRUE;
+
 		appWindow->visibleOffsetX = windowState->visibleOffsetX;
 		appWindow->visibleOffsetY = windowState->visibleOffsetY;
 	}
 
+	if ((fieldFlags & WINDOW_ORDER_FIELD_VISIBILITY) &&
+	    (appWindow->numVisibilityRects == windowState->numVisibilityRects) &&
+	    ((appWindow->numVisibilityRects == 0) ||
+	     (memcmp(appWindow->visibilityRects, windowState->visibilityRects,
+	             appWindow->numVisibilityRects * sizeof(RECTANGLE_16)) == 0)))
+	{
+		/* same shape as before */
+		fieldFlags &= ~WINDOW_ORDER_FIELD_VISIBILITY;
+	}
+
 	if (fieldFlags & WINDOW_ORDER_FIELD_VISIBILITY)
 	{
+		position_or_size_updated = visibility_updated = TRUE;
+
 		if (appWindow->visibilityRects)
 		{
 			free(appWindow->visibilityRects);
@@ -467,7 +522,10 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 	{
 	}
 
-	if (fieldFlags & WINDOW_ORDER_FIELD_SHOW)
+	/* A maximized window is refreshed every time the server confirms it, see xf_ShowWindow */
+	if ((fieldFlags & WINDOW_ORDER_FIELD_SHOW) &&
+	    ((appWindow->showState != appWindow->rail_state) ||
+	     (appWindow->showState == WINDOW_SHOW_MAXIMIZED)))
 	{
 		xf_ShowWindow(xfc, appWindow, appWindow->showState);
 	}
@@ -478,7 +536,7 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 			xf_SetWindowText(xfc, appWindow, appWindow->title);
 	}
 
-	if (position_or_size_updated)
+	if (position_or_size_updated || visibility_updated)
 	{
 		UINT32 visibilityRectsOffsetX =
 		    (appWindow->visibleOffsetX -
@@ -494,25 +552,34 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 		 */
 		if (appWindow->rail_state != WINDOW_SHOW_MINIMIZED)
 		{
-			/* Redraw window area if already in the correct position */
-			if (appWindow->x == (INT64)appWindow->windowOffsetX &&
-			    appWindow->y == (INT64)appWindow->windowOffsetY &&
-			    appWindow->width == (INT64)appWindow->windowWidth &&
-			    appWindow->height == (INT64)appWindow->windowHeight)
-			{
-				xf_UpdateWindowArea(xfc, appWindow, 0, 0, appWindow->windowWidth,
-				                    appWindow->windowHeight);
-			}
-			else
+			if (position_or_size_updated)
 			{
-				xf_MoveWindow(xfc, appWindow, appWindow->windowOffsetX, appWindow->windowOffsetY,
-				              appWindow->windowWidth, appWindow->windowHeight);
+				/* Redraw window area if already in the correct position */
+				if (appWindow->x == (INT64)appWindow->windowOffsetX &&
+				    appWindow->y == (INT64)appWindow->windowOffsetY &&
+				    appWindow->width == (INT64)appWindow->windowWidth &&
+				    appWindow->height == (INT64)appWindow->windowHeight)
+				{
+					xf_UpdateWindowArea(xfc, appWindow, 0, 0, appWindow->windowWidth,
+					                    appWindow->windowHeight);
+				}
+				else
+				{
+					xf_MoveWindow(xfc, appWindow, appWindow->windowOffsetX,
+					              appWindow->windowOffsetY, appWindow->windowWidth,
+					              appWindow->windowHeight);
+				}
 			}
 
-			xf_SetWindowVisibilityRects(xfc, appWindow, visibilityRectsOffsetX,
-			                            visibilityRectsOffsetY, appWindow->visibilityRects,
-			                            appWindow->numVisibilityRects);
+			if (visibility_updated)
+				xf_SetWindowVisibilityRects(xfc, appWindow, visibilityRectsOffsetX,
+				                            visibilityRectsOffsetY, appWindow->visibilityRects,
+				                            appWindow->numVisibilityRects);
+
+			appWindow->rail_pending_update = FALSE;
 		}
+		else
+			appWindow->rail_pending_update = TRUE;
 	}
 
 	/* We should only be using the visibility rects for shaping the window */
@@ -648,6 +715,11 @@ error:
 static void xf_rail_set_window_icon(xfContext* xfc, xfAppWindow* railWindow, xfRailIcon* icon,
                                     BOOL replace)
 {
+	/* servers repeat the cached icon orders, the property already ends with this icon */
+	if (icon->serial && (railWindow->iconSerial == icon->serial))
+		return;
+
+	railWindow->iconSerial = icon->serial;
 	XChangeProperty(xfc->display, railWindow->handle, xfc->_NET_WM_ICON, XA_CARDINAL, 32,
 	                replace ? PropModeReplace : PropModeAppend, (unsigned char*)icon->data,
 	                icon->length);
@@ -682,6 +754,10 @@ static BOOL xf_rail_window_icon(rdpContext* context, const WINDOW_ORDER_INFO* or
 		return FALSE;
 	}
 
+	if (++xfc->railIconCache->nextSerial == 0)
+		xfc->railIconCache->nextSerial = 1;
+	icon->serial = xfc->railIconCache->nextSerial;
+
 	replaceIcon = !!(orderInfo->fieldFlags & WINDOW_ORDER_STATE_NEW);
 	xf_rail_set_window_icon(xfc, railWindow, icon, replaceIcon);
 	return TRUE;
@@ -0,0 +1,189 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 Shared Memory Images
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <freerdp/log.h>
+
+#ifdef WITH_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#include "xf_shm.h"
+
+#define TAG CLIENT_TAG("x11")
+
+#ifdef WITH_XSHM
+static BOOL xf_shm_failed = FALSE;
+
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	WINPR_UNUSED(display);
+	WINPR_UNUSED(event);
+	xf_shm_failed = TRUE;
+	return 0;
+}
+#endif
+
+void xf_shm_check_extension(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+#ifdef WITH_XSHM
+	xfc->xshmAvailable = XShmQueryExtension(xfc->display);
+#else
+	xfc->xshmAvailable = FALSE;
+#endif
+}
+
+BYTE* xf_shm_attach(xfContext* xfc, xfShmSegment* segment, size_t size)
+{
+#ifdef WITH_XSHM
+	Bool attached;
+	int (*handler)(Display*, XErrorEvent*);
+
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(segment);
+
+	segment->shmaddr = NULL;
+
+	if (!xfc->xshmAvailable)
+		return NULL;
+
+	segment->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (segment->shmid < 0)
+		return NULL;
+
+	segment->shmaddr = shmat(segment->shmid, NULL, 0);
+	segment->readOnly = True;
+
+	if (segment->shmaddr == (char*)-1)
+	{
+		shmctl(segment->shmid, IPC_RMID, NULL);
+		segment->shmaddr = NULL;
+		return NULL;
+	}
+
+	/* xf_error_handler aborts, attaching fails for a remote X server */
+	xf_lock_x11(xfc);
+	xf_shm_failed = FALSE;
+	handler = XSetErrorHandler(xf_shm_error_handler);
+	attached = XShmAttach(xfc->display, segment);
+	XSync(xfc->display, False);
+	XSetErrorHandler(handler);
+	xf_unlock_x11(xfc);
+
+	/* the segment is removed once both sides detached it */
+	shmctl(segment->shmid, IPC_RMID, NULL);
+
+	if (!attached || xf_shm_failed)
+	{
+		WLog_INFO(TAG, "the X server can not attach shared memory, using XPutImage");
+		xfc->xshmAvailable = FALSE;
+		shmdt(segment->shmaddr);
+		segment->shmaddr = NULL;
+		return NULL;
+	}
+
+	ZeroMemory(segment->shmaddr, size);
+	return (BYTE*)segment->shmaddr;
+#else
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(size);
+	WINPR_ASSERT(segment);
+	segment->shmaddr = NULL;
+	return NULL;
+#endif
+}
+
+void xf_shm_detach(xfContext* xfc, xfShmSegment* segment)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(segment);
+
+	if (!segment->shmaddr)
+		return;
+
+#ifdef WITH_XSHM
+	XShmDetach(xfc->display, segment);
+	XSync(xfc->display, False);
+	shmdt(segment->shmaddr);
+#endif
+	segment->shmaddr = NULL;
+}
+
+XImage* xf_shm_create_image(xfContext* xfc, xfShmSegment* segment, BYTE* data, UINT32 width,
+                            UINT32 height, UINT32 scanline)
+{
+	XImage* image;
+	const BOOL shared = segment && segment->shmaddr && (data == (BYTE*)segment->shmaddr);
+
+	WINPR_ASSERT(xfc);
+
+	image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0, (char*)data, width,
+	                     height, xfc->scanline_pad, (int)scanline);
+
+	if (!image)
+		return NULL;
+
+#ifdef WITH_XSHM
+	if (shared)
+	{
+		/* the server derives the scanline from the width, include the padding */
+		if (image->bits_per_pixel >= 8)
+			image->width = (int)(scanline / (image->bits_per_pixel / 8));
+
+		image->obdata = (char*)segment;
+	}
+#else
+	WINPR_UNUSED(shared);
+#endif
+
+	return image;
+}
+
+void xf_shm_destroy_image(XImage* image)
+{
+	if (!image)
+		return;
+
+	/* the data belongs to the caller, obdata to the segment */
+	image->data = NULL;
+	image->obdata = NULL;
+	XDestroyImage(image);
+}
+
+void xf_shm_put_image(xfContext* xfc, Drawable drawable, XImage* image, int src_x, int src_y,
+                      int dest_x, int dest_y, unsigned int width, unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+#ifdef WITH_XSHM
+	if (image->obdata)
+	{
+		XShmPutImage(xfc->display, drawable, xfc->gc, image, src_x, src_y, dest_x, dest_y, width,
+		             height, False);
+		return;
+	}
+#endif
+
+	XPutImage(xfc->display, drawable, xfc->gc, image, src_x, src_y, dest_x, dest_y, width,
+	          height);
+}
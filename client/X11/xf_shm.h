@@ -0,0 +1,65 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 Shared Memory Images
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#ifdef WITH_XSHM
+#include <X11/extensions/XShm.h>
+
+typedef XShmSegmentInfo xfShmSegment;
+#else
+typedef struct
+{
+	char* shmaddr;
+} xfShmSegment;
+#endif
+
+#include "xfreerdp.h"
+
+/**
+ * The buffer of an image is shared with the X server if it can attach the segment, so it reads
+ * the pixels directly instead of receiving them over the socket. A remote X server can not, the
+ * images fall back to XPutImage then.
+ */
+void xf_shm_check_extension(xfContext* xfc);
+
+/**
+ * @brief xf_shm_attach Allocates a zeroed segment shared with the X server
+ * @return the mapped segment, NULL if it is not available, segment->shmaddr is set then
+ */
+BYTE* xf_shm_attach(xfContext* xfc, xfShmSegment* segment, size_t size);
+void xf_shm_detach(xfContext* xfc, xfShmSegment* segment);
+
+/**
+ * @brief xf_shm_create_image Creates a ZPixmap image of data, shared if data is the segment
+ */
+XImage* xf_shm_create_image(xfContext* xfc, xfShmSegment* segment, BYTE* data, UINT32 width,
+                            UINT32 height, UINT32 scanline);
+void xf_shm_destroy_image(XImage* image);
+
+/**
+ * @brief xf_shm_put_image Like XPutImage. The server reads a shared image after the call, the
+ * caller syncs before writing to it again.
+ */
+void xf_shm_put_image(xfContext* xfc, Drawable drawable, XImage* image, int src_x, int src_y,
+                      int dest_x, int dest_y, unsigned int width, unsigned int height);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
@@ -23,6 +23,15 @@
 #include <freerdp/gdi/video.h>
 
 #include "xf_video.h"
+#include "xf_shm.h"
+
+#if defined(WITH_XV) && defined(WITH_XSHM)
+#include <X11/extensions/Xv.h>
+#include <X11/extensions/Xvlib.h>
+
+#define XF_VIDEO_OVERLAY
+#define XF_VIDEO_FOURCC_I420 0x30323449 /* 'I420' */
+#endif
 
 #define TAG CLIENT_TAG("video")
 
@@ -30,32 +39,139 @@ typedef struct
 {
 	VideoSurface base;
 	XImage* image;
+	xfShmSegment segment;
+	BYTE* heapData;
+#ifdef XF_VIDEO_OVERLAY
+	XvPortID port;
+	XvImage* xvImage;
+	XShmSegmentInfo xvSegment;
+#endif
 } xfVideoSurface;
 
+#ifdef XF_VIDEO_OVERLAY
+static XvPortID xf_video_grab_port(xfContext* xfc)
+{
+	unsigned int i, num_adaptors = 0;
+	XvAdaptorInfo* ai = NULL;
+	XvPortID port = 0;
+
+	if (XvQueryAdaptors(xfc->display, DefaultRootWindow(xfc->display), &num_adaptors, &ai) !=
+	    Success)
+		return 0;
+
+	for (i = 0; (i < num_adaptors) && !port; i++)
+	{
+		XvPortID p;
+
+		if (!(ai[i].type & XvInputMask) || !(ai[i].type & XvImageMask))
+			continue;
+
+		for (p = ai[i].base_id; (p < ai[i].base_id + ai[i].num_ports) && !port; p++)
+		{
+			int j, count = 0;
+			XvImageFormatValues* fo = XvListImageFormats(xfc->display, p, &count);
+			BOOL hasI420 = FALSE;
+
+			for (j = 0; j < count; j++)
+			{
+				if (fo[j].id == XF_VIDEO_FOURCC_I420)
+					hasI420 = TRUE;
+			}
+			XFree(fo);
+
+			if (hasI420 && (XvGrabPort(xfc->display, p, CurrentTime) == Success))
+				port = p;
+		}
+	}
+
+	if (num_adaptors > 0)
+		XvFreeAdaptorInfo(ai);
+
+	return port;
+}
+
+static void xf_video_overlay_free(xfContext* xfc, xfVideoSurface* surface)
+{
+	if (surface->xvImage)
+	{
+		xf_shm_detach(xfc, &surface->xvSegment);
+		XFree(surface->xvImage);
+		surface->xvImage = NULL;
+	}
+
+	if (surface->port)
+	{
+		XvUngrabPort(xfc->display, surface->port, CurrentTime);
+		surface->port = 0;
+	}
+}
+
+/* Without an overlay the channel converts the frames and shows them with xfVideoShowSurface */
+static void xf_video_overlay_new(xfContext* xfc, xfVideoSurface* surface)
+{
+	if (!xfc->xshmAvailable)
+		return;
+
+	surface->port = xf_video_grab_port(xfc);
+	if (!surface->port)
+		return;
+
+	surface->xvImage =
+	    XvShmCreateImage(xfc->display, surface->port, XF_VIDEO_FOURCC_I420, NULL,
+	                     (int)surface->base.w, (int)surface->base.h, &surface->xvSegment);
+	if (surface->xvImage)
+	{
+		surface->xvImage->data =
+		    (char*)xf_shm_attach(xfc, &surface->xvSegment, (size_t)surface->xvImage->data_size);
+		if (surface->xvImage->data)
+		{
+			WLog_DBG(TAG, "presenting video with XVideo port %lu", surface->port);
+			return;
+		}
+	}
+
+	xf_video_overlay_free(xfc, surface);
+}
+#endif
+
 static VideoSurface* xfVideoCreateSurface(VideoClientContext* video, UINT32 x, UINT32 y,
                                           UINT32 width, UINT32 height)
 {
 	xfContext* xfc;
 	xfVideoSurface* ret;
 
+	BYTE* shared;
+
 	WINPR_ASSERT(video);
-	ret = (xfVideoSurface*)VideoClient_CreateCommonContext(sizeof(xfContext), x, y, width, height);
+	ret = (xfVideoSurface*)VideoClient_CreateCommonContext(sizeof(xfVideoSurface), x, y, width,
+	                                                       height);
 	if (!ret)
 		return NULL;
 
 	xfc = (xfContext*)video->custom;
 	WINPR_ASSERT(xfc);
 
-	ret->image = XCreateImage(xfc->display, xfc->visual, xfc->depth, ZPixmap, 0,
-	                          (char*)ret->base.data, width, height, 8, ret->base.scanline);
+	/* the channel converts into base.data, let the X server read it from there */
+	ret->heapData = ret->base.data;
+	shared = xf_shm_attach(xfc, &ret->segment, ret->base.scanline * ret->base.alignedHeight * 1ull);
+	if (shared)
+		ret->base.data = shared;
+
+	ret->image = xf_shm_create_image(xfc, &ret->segment, ret->base.data, width, height,
+	                                 ret->base.scanline);
 
 	if (!ret->image)
 	{
 		WLog_ERR(TAG, "unable to create surface image");
+		xf_shm_detach(xfc, &ret->segment);
+		ret->base.data = ret->heapData;
 		VideoClient_DestroyCommonContext(&ret->base);
 		return NULL;
 	}
 
+#ifdef XF_VIDEO_OVERLAY
+	xf_video_overlay_new(xfc, ret);
+#endif
 	return &ret->base;
 }
 
@@ -79,28 +195,100 @@ static BOOL xfVideoShowSurface(VideoClientContext* video, const VideoSurface* su
 
 	if (settings->SmartSizing || settings->MultiTouchGestures)
 	{
-		XPutImage(xfc->display, xfc->primary, xfc->gc, xfSurface->image, 0, 0, surface->x,
-		          surface->y, surface->w, surface->h);
+		xf_shm_put_image(xfc, xfc->primary, xfSurface->image, 0, 0, (int)surface->x,
+		                 (int)surface->y, surface->w, surface->h);
 		xf_draw_screen(xfc, surface->x, surface->y, surface->w, surface->h);
 	}
 	else
 #endif
 	{
-		XPutImage(xfc->display, xfc->drawable, xfc->gc, xfSurface->image, 0, 0, surface->x,
-		          surface->y, surface->w, surface->h);
+		xf_shm_put_image(xfc, xfc->drawable, xfSurface->image, 0, 0, (int)surface->x,
+		                 (int)surface->y, surface->w, surface->h);
+	}
+
+	/* the next frame is converted into the shared image */
+	if (xfSurface->image->obdata)
+		XSync(xfc->display, False);
+
+	return TRUE;
+}
+
+#ifdef XF_VIDEO_OVERLAY
+static BOOL xfVideoShowYUVSurface(VideoClientContext* video, const VideoSurface* surface,
+                                  const BYTE* pYUVData[3], const UINT32 iStride[3],
+                                  UINT32 destinationWidth, UINT32 destinationHeight)
+{
+	const xfVideoSurface* xfSurface = (const xfVideoSurface*)surface;
+	XvImage* image;
+	xfContext* xfc;
+	size_t x, y;
+
+	WINPR_ASSERT(video);
+	WINPR_ASSERT(xfSurface);
+
+	xfc = video->custom;
+	WINPR_ASSERT(xfc);
+
+	image = xfSurface->xvImage;
+	if (!image)
+		return FALSE;
+
+#ifdef WITH_XRENDER
+	/* the overlay can only be put on a window, not on the primary pixmap */
+	if (xfc->common.context.settings->SmartSizing ||
+	    xfc->common.context.settings->MultiTouchGestures)
+		return FALSE;
+#endif
+
+	for (x = 0; x < 3; x++)
+	{
+		const UINT32 width = (x == 0) ? surface->w : (surface->w + 1) / 2;
+		const UINT32 height = (x == 0) ? surface->h : (surface->h + 1) / 2;
+		const BYTE* src = pYUVData[x];
+		BYTE* dst = (BYTE*)image->data + image->offsets[x];
+
+		for (y = 0; y < height; y++)
+		{
+			memcpy(dst, src, width);
+			src += iStride[x];
+			dst += image->pitches[x];
+		}
 	}
 
+	if (!destinationWidth || !destinationHeight)
+	{
+		destinationWidth = surface->w;
+		destinationHeight = surface->h;
+	}
+
+	/* the XVideo adaptor converts and scales to the geometry of the presentation */
+	XvShmPutImage(xfc->display, xfSurface->port, xfc->drawable, xfc->gc, image, 0, 0,
+	              surface->w, surface->h, (int)surface->x, (int)surface->y, destinationWidth,
+	              destinationHeight, False);
+	XSync(xfc->display, False);
 	return TRUE;
 }
+#endif
 
 static BOOL xfVideoDeleteSurface(VideoClientContext* video, VideoSurface* surface)
 {
 	xfVideoSurface* xfSurface = (xfVideoSurface*)surface;
+	xfContext* xfc;
+
+	WINPR_ASSERT(video);
 
-	WINPR_UNUSED(video);
+	xfc = video->custom;
+	WINPR_ASSERT(xfc);
 
 	if (xfSurface)
-		XFree(xfSurface->image);
+	{
+#ifdef XF_VIDEO_OVERLAY
+		xf_video_overlay_free(xfc, xfSurface);
+#endif
+		xf_shm_destroy_image(xfSurface->image);
+		xf_shm_detach(xfc, &xfSurface->segment);
+		xfSurface->base.data = xfSurface->heapData;
+	}
 
 	VideoClient_DestroyCommonContext(surface);
 	return TRUE;
@@ -120,6 +308,9 @@ void xf_video_control_init(xfContext* xfc, VideoClientContext* video)
 		video->createSurface = xfVideoCreateSurface;
 		video->showSurface = xfVideoShowSurface;
 		video->deleteSurface = xfVideoDeleteSurface;
+#ifdef XF_VIDEO_OVERLAY
+		video->showYUVSurface = xfVideoShowYUVSurface;
+#endif
 	}
 }
 
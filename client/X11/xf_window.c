@@ -653,6 +653,10 @@ void xf_DestroyDesktopWindow(xfContext* xfc, xfWindow* window)
 
 	if (window->handle)
 	{
+#ifdef WITH_XRENDER
+		if (xfc->pictureWindow == window->handle)
+			xf_draw_screen_free_pictures(xfc);
+#endif
 		XUnmapWindow(xfc->display, window->handle);
 		XDestroyWindow(xfc->display, window->handle);
 	}
@@ -147,6 +147,8 @@ struct xf_app_window
 	xfLocalMove local_move;
 	BYTE rail_state;
 	BOOL rail_ignore_configure;
+	BOOL rail_pending_update; /* geometry that arrived while minimized is not applied yet */
+	UINT32 iconSerial;        /* the icon last written to _NET_WM_ICON */
 };
 
 void xf_ewmhints_init(xfContext* xfc);
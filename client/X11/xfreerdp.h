@@ -34,11 +34,16 @@ typedef struct xf_context xfContext;
 #include <X11/extensions/XInput2.h>
 #endif
 
+#ifdef WITH_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+
 #include <freerdp/api.h>
 
 #include "xf_window.h"
 #include "xf_monitor.h"
 #include "xf_channels.h"
+#include "xf_shm.h"
 
 #if defined(CHANNEL_TSMF_CLIENT)
 #include <freerdp/client/tsmf.h>
@@ -149,6 +154,7 @@ struct xf_context
 	BOOL invert;
 	Screen* screen;
 	XImage* image;
+	xfShmSegment primaryShm;
 	Pixmap primary;
 	Pixmap drawing;
 	Visual* visual;
@@ -198,6 +204,13 @@ struct xf_context
 	int scaledHeight;
 	int offset_x;
 	int offset_y;
+	/* kept between scaled draws, recreated when the drawables change */
+	Picture primaryPicture;
+	Picture windowPicture;
+	Pixmap picturePrimary;
+	Window pictureWindow;
+	double pictureScaleX;
+	double pictureScaleY;
 #endif
 
 	BOOL focused;
@@ -277,6 +290,7 @@ struct xf_context
 
 	BOOL xkbAvailable;
 	BOOL xrenderAvailable;
+	BOOL xshmAvailable; /* the X server can attach our shared memory segments */
 
 	/* value to be sent over wire for each logical client mouse button */
 	button_map button_map[NUM_BUTTONS_MAPPED];
@@ -383,6 +397,7 @@ void xf_lock_x11_(xfContext* xfc, const char* fkt);
 void xf_unlock_x11_(xfContext* xfc, const char* fkt);
 
 BOOL xf_picture_transform_required(xfContext* xfc);
+void xf_draw_screen_free_pictures(xfContext* xfc);
 
 #define xf_draw_screen(_xfc, _x, _y, _w, _h) \
 	xf_draw_screen_((_xfc), (_x), (_y), (_w), (_h), __FUNCTION__, __FILE__, __LINE__)
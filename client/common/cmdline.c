@@ -2330,6 +2330,16 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 			if (!freerdp_settings_set_string(settings, FreeRDP_GatewayAccessToken, arg->Value))
 				return COMMAND_LINE_ERROR_MEMORY;
 		}
+		CommandLineSwitchCase(arg, "gateway-inner-tls-ciphers")
+		{
+			const char* ciphers = arg->Value;
+
+			if (_stricmp(ciphers, "chacha20") == 0)
+				ciphers = "ECDHE+CHACHA20:DEFAULT";
+
+			if (!freerdp_settings_set_string(settings, FreeRDP_GatewayInnerTlsCiphers, ciphers))
+				return COMMAND_LINE_ERROR_MEMORY;
+		}
 		CommandLineSwitchCase(arg, "gateway-usage-method")
 		{
 			UINT32 type = 0;
@@ -3088,6 +3098,19 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 						else
 							return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
 					}
+					/* stats:[on|off] */
+					else if (_strnicmp(cur, "stats:", 6) == 0)
+					{
+						const char* val = cur + 6;
+						settings->Floatbar &= ~0x40u;
+
+						if (_strnicmp(val, "on", 3) == 0)
+							settings->Floatbar |= 0x40u;
+						else if (_strnicmp(val, "off", 4) == 0)
+							settings->Floatbar &= ~0x40u;
+						else
+							return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+					}
 					else
 						return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
 				} while (start);
@@ -3119,6 +3142,18 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->BitmapCacheEnabled = enable;
 		}
+		CommandLineSwitchCase(arg, "persist-cache")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_BitmapCachePersistEnabled, enable))
+				return COMMAND_LINE_ERROR;
+		}
+		CommandLineSwitchCase(arg, "persist-cache-file")
+		{
+			if (!freerdp_settings_set_string(settings, FreeRDP_BitmapCachePersistFile,
+			                                 arg->Value) ||
+			    !freerdp_settings_set_bool(settings, FreeRDP_BitmapCachePersistEnabled, TRUE))
+				return COMMAND_LINE_ERROR;
+		}
 		CommandLineSwitchCase(arg, "offscreen-cache")
 		{
 			settings->OffscreenSupportLevel = (UINT32)enable;
@@ -138,9 +138,10 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "fast-path input/output" },
 	{ "fipsmode", COMMAND_LINE_VALUE_BOOL, NULL, NULL, NULL, -1, NULL, "FIPS mode" },
 	{ "floatbar", COMMAND_LINE_VALUE_OPTIONAL,
-	  "sticky:[on|off],default:[visible|hidden],show:[always|fullscreen|window]", NULL, NULL, -1,
-	  NULL,
-	  "floatbar is disabled by default (when enabled defaults to sticky in fullscreen mode)" },
+	  "sticky:[on|off],default:[visible|hidden],show:[always|fullscreen|window],stats:[on|off]",
+	  NULL, NULL, -1, NULL,
+	  "floatbar is disabled by default (when enabled defaults to sticky in fullscreen mode), "
+	  "stats shows frame rate, decode and present time and round trip time" },
 	{ "fonts", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 	  "smooth fonts (ClearType)" },
 	{ "frame-ack", COMMAND_LINE_VALUE_REQUIRED, "<number>", NULL, NULL, -1, NULL,
@@ -150,6 +151,10 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "on server request." },
 	{ "g", COMMAND_LINE_VALUE_REQUIRED, "<gateway>[:<port>]", NULL, NULL, -1, NULL,
 	  "Gateway Hostname" },
+	{ "gateway-inner-tls-ciphers", COMMAND_LINE_VALUE_REQUIRED, "[chacha20|ciphers]", NULL, NULL,
+	  -1, NULL,
+	  "TLS ciphers of the RDP connection inside the gateway tunnel, chacha20 suits clients "
+	  "without AES instructions" },
 	{ "gateway-usage-method", COMMAND_LINE_VALUE_REQUIRED, "[direct|detect]", NULL, NULL, -1, "gum",
 	  "Gateway usage method" },
 	{ "gd", COMMAND_LINE_VALUE_REQUIRED, "<domain>", NULL, NULL, -1, NULL, "Gateway domain" },
@@ -239,8 +244,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	{ "menu-anims", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "menu animations" },
 	{ "microphone", COMMAND_LINE_VALUE_OPTIONAL,
-	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>]", NULL, NULL, -1,
-	  "mic", "Audio input (microphone)" },
+	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>,][bitrate:<"
+	  "bitrate>,][frames:<frames>,][latency:<ms>,][packet:<ms>]",
+	  NULL, NULL, -1, "mic", "Audio input (microphone)" },
 	{ "smartcard-list", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT, NULL, NULL, NULL, -1, NULL,
 	  "List smartcard informations" },
 	{ "monitor-list", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT, NULL, NULL, NULL, -1, NULL,
@@ -282,6 +288,10 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "Use smart card authentication with password as smart card PIN" },
 	{ "pcb", COMMAND_LINE_VALUE_REQUIRED, "<blob>", NULL, NULL, -1, NULL, "Preconnection Blob" },
 	{ "pcid", COMMAND_LINE_VALUE_REQUIRED, "<id>", NULL, NULL, -1, NULL, "Preconnection Id" },
+	{ "persist-cache", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Persistent bitmap cache" },
+	{ "persist-cache-file", COMMAND_LINE_VALUE_REQUIRED, "<filename>", NULL, NULL, -1, NULL,
+	  "File that keeps the persistent bitmap cache between sessions" },
 	{ "pheight", COMMAND_LINE_VALUE_REQUIRED, "<height>", NULL, NULL, -1, NULL,
 	  "Physical height of display (in millimeters)" },
 	{ "play-rfx", COMMAND_LINE_VALUE_REQUIRED, "<pcap-file>", NULL, NULL, -1, NULL,
@@ -347,7 +357,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  -1, NULL, "Activates Smartcard (optional certificate) Logon authentication." },
 	{ "sound", COMMAND_LINE_VALUE_OPTIONAL,
 	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>,][latency:<"
-	  "latency>,][quality:<quality>]",
+	  "latency>,][quality:<quality>,][low-latency]",
 	  NULL, NULL, -1, "audio", "Audio output (sound)" },
 	{ "span", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
 	  "Span screen over multiple monitors" },
@@ -66,6 +66,10 @@ CMAKE_DEPENDENT_OPTION(TESTS_WTSAPI_EXTRA "Build extra WTSAPI tests (interactive
 CMAKE_DEPENDENT_OPTION(BUILD_COMM_TESTS "Build comm related tests (require comm port)" OFF "BUILD_TESTING" OFF)
 
 option(WITH_SAMPLE "Build sample code" OFF)
+option(WITH_CODEC_BENCH "Build the freerdp-codec-bench codec benchmark" OFF)
+option(WITH_PRIMITIVES_BENCH "Build the freerdp-primitives-bench primitives benchmark" OFF)
+CMAKE_DEPENDENT_OPTION(WITH_PRIMITIVES_BENCH_REGRESSION "Compare freerdp-primitives-bench against its baseline in ctest (timing sensitive, needs an idle machine)" OFF "WITH_PRIMITIVES_BENCH;BUILD_TESTING" OFF)
+option(WITH_CONNECT_BENCH "Build the freerdp-connect-bench connection benchmark (requires WITH_WINPR_TOOLS)" OFF)
 
 option(WITH_CLIENT_COMMON "Build client common library" ON)
 CMAKE_DEPENDENT_OPTION(WITH_CLIENT "Build client binaries" ON "WITH_CLIENT_COMMON" OFF)
@@ -80,6 +84,7 @@ CMAKE_DEPENDENT_OPTION(WITH_CLIENT_CHANNELS "Build virtual channel plugins" ON
 	"WITH_CLIENT_COMMON;WITH_CHANNELS" OFF)
 
 CMAKE_DEPENDENT_OPTION(WITH_MACAUDIO "Enable OSX sound backend" ON "APPLE;NOT IOS" OFF)
+CMAKE_DEPENDENT_OPTION(WITH_VIDEO_TOOLBOX "Enable H264 VideoToolbox decoder" ON "APPLE" OFF)
 
 if(WITH_SERVER AND WITH_CHANNELS)
 	option(WITH_SERVER_CHANNELS "Build virtual channel plugins" ON)
@@ -151,7 +156,7 @@ option(WITH_CLANG_FORMAT "Detect clang-format. run 'cmake --build . --target cla
 option(WITH_DSP_EXPERIMENTAL "Enable experimental sound encoder/decoder formats" OFF)
 if (WITH_FFMPEG)
     option(WITH_DSP_FFMPEG "Use FFMPEG for audio encoding/decoding" OFF)
-    option(WITH_VAAPI "Use FFMPEG VAAPI" OFF)
+    option(WITH_VAAPI "Use FFMPEG VAAPI for H.264 and TSMF video decoding" OFF)
 endif(WITH_FFMPEG)
 
 option(USE_VERSION_FROM_GIT_TAG "Extract FreeRDP version from git tag." OFF)
@@ -0,0 +1,50 @@
+# Try to find the PipeWire client library
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+#
+# Once done this will define
+#
+#  PIPEWIRE_FOUND - system has PipeWire
+#  PIPEWIRE_INCLUDE_DIRS - the PipeWire and SPA include directories
+#  PIPEWIRE_LIBRARIES - libpipewire library
+
+if (UNIX AND NOT ANDROID)
+  find_package(PkgConfig QUIET)
+  pkg_check_modules(PC_PIPEWIRE QUIET libpipewire-0.3)
+  pkg_check_modules(PC_SPA QUIET libspa-0.2)
+endif (UNIX AND NOT ANDROID)
+
+if (PIPEWIRE_INCLUDE_DIR AND SPA_INCLUDE_DIR AND PIPEWIRE_LIBRARY)
+	set(PIPEWIRE_FIND_QUIETLY TRUE)
+endif (PIPEWIRE_INCLUDE_DIR AND SPA_INCLUDE_DIR AND PIPEWIRE_LIBRARY)
+
+find_path(PIPEWIRE_INCLUDE_DIR NAMES pipewire/pipewire.h
+	PATH_SUFFIXES include/pipewire-0.3 pipewire-0.3
+	HINTS ${PC_PIPEWIRE_INCLUDE_DIRS})
+find_path(SPA_INCLUDE_DIR NAMES spa/param/video/format-utils.h
+	PATH_SUFFIXES include/spa-0.2 spa-0.2
+	HINTS ${PC_SPA_INCLUDE_DIRS})
+find_library(PIPEWIRE_LIBRARY
+	 NAMES pipewire-0.3
+	 PATH_SUFFIXES lib
+	 HINTS ${PC_PIPEWIRE_LIBRARY_DIRS})
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(PipeWire DEFAULT_MSG PIPEWIRE_LIBRARY PIPEWIRE_INCLUDE_DIR SPA_INCLUDE_DIR)
+
+if (PIPEWIRE_INCLUDE_DIR AND SPA_INCLUDE_DIR AND PIPEWIRE_LIBRARY)
+	set(PIPEWIRE_FOUND TRUE)
+	set(PIPEWIRE_INCLUDE_DIRS ${PIPEWIRE_INCLUDE_DIR} ${SPA_INCLUDE_DIR})
+	set(PIPEWIRE_LIBRARIES ${PIPEWIRE_LIBRARY})
+endif (PIPEWIRE_INCLUDE_DIR AND SPA_INCLUDE_DIR AND PIPEWIRE_LIBRARY)
+
+mark_as_advanced(PIPEWIRE_INCLUDE_DIR SPA_INCLUDE_DIR PIPEWIRE_LIBRARY)
@@ -24,6 +24,7 @@
 #include <freerdp/types.h>
 #include <freerdp/update.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/cache/persistent.h>
 
 #include <winpr/stream.h>
 
@@ -31,6 +32,10 @@ typedef struct
 {
 	UINT32 number;
 	rdpBitmap** entries;
+
+	/* internal */
+	PERSISTENT_CACHE_ENTRY* persistent; /* loaded from the persistent cache, not drawn yet */
+	UINT32 persistentCount;
 } BITMAP_V2_CELL;
 
 typedef struct
@@ -27,4 +27,9 @@
 
 #define ECHO_DVC_CHANNEL_NAME "ECHO"
 
+/* Latency probe payload: magic, sequence number and send timestamp (ms),
+ * all little endian. The client echoes it back unchanged like any request. */
+#define ECHO_PROBE_MAGIC 0x42505245 /* "ERPB" */
+#define ECHO_PROBE_LENGTH 16
+
 #endif /* FREERDP_CHANNEL_ECHO_H */
@@ -24,6 +24,7 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/rdpgfx.h>
+#include <freerdp/cache/persistent.h>
 #include <freerdp/utils/profiler.h>
 
 /**
@@ -75,6 +76,10 @@ typedef UINT (*pcRdpgfxGetSurfaceIds)(RdpgfxClientContext* context, UINT16** ppS
 typedef UINT (*pcRdpgfxSetCacheSlotData)(RdpgfxClientContext* context, UINT16 cacheSlot,
                                          void* pData);
 typedef void* (*pcRdpgfxGetCacheSlotData)(RdpgfxClientContext* context, UINT16 cacheSlot);
+typedef UINT (*pcRdpgfxImportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         const PERSISTENT_CACHE_ENTRY* importCacheEntry);
+typedef UINT (*pcRdpgfxExportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         PERSISTENT_CACHE_ENTRY* exportCacheEntry);
 
 typedef UINT (*pcRdpgfxUpdateSurfaces)(RdpgfxClientContext* context);
 
@@ -96,6 +101,7 @@ typedef UINT (*pcRdpgfxQoeFrameAcknowledge)(
 typedef UINT (*pcRdpgfxMapWindowForSurface)(RdpgfxClientContext* context, UINT16 surfaceID,
                                             UINT64 windowID);
 typedef UINT (*pcRdpgfxUnmapWindowForSurface)(RdpgfxClientContext* context, UINT64 windowID);
+typedef void* (*pcRdpgfxGetSurfaceOutputWindow)(RdpgfxClientContext* context, UINT16 surfaceId);
 
 struct s_rdpgfx_client_context
 {
@@ -128,6 +134,10 @@ struct s_rdpgfx_client_context
 	pcRdpgfxSetCacheSlotData SetCacheSlotData;
 	pcRdpgfxGetCacheSlotData GetCacheSlotData;
 
+	/* Persistent cache, the exported entry data is freed by the caller */
+	pcRdpgfxImportCacheEntry ImportCacheEntry;
+	pcRdpgfxExportCacheEntry ExportCacheEntry;
+
 	/* Proxy callbacks */
 	pcRdpgfxOnOpen OnOpen;
 	pcRdpgfxOnClose OnClose;
@@ -147,9 +157,20 @@ struct s_rdpgfx_client_context
 	pcRdpgfxMapWindowForSurface MapWindowForSurface;
 	pcRdpgfxUnmapWindowForSurface UnmapWindowForSurface;
 
+	/* Optional platform window (ANativeWindow* on Android) AVC420 frames of a surface are
+	 * decoded into directly. Frames presented this way do not update the surface data.
+	 */
+	pcRdpgfxGetSurfaceOutputWindow GetSurfaceOutputWindow;
+
 	CRITICAL_SECTION mux;
 	rdpCodecs* codecs;
 	PROFILER_DEFINE(SurfaceProfiler)
+
+	/* Buffer and h264 decoder of the last deleted surface, reused by the next
+	 * surface that fits so a resize does not reallocate everything. */
+	void* spareSurfaceData;
+	size_t spareSurfaceSize;
+	H264_CONTEXT* spareH264;
 };
 
 #ifdef __cplusplus
@@ -48,6 +48,11 @@ extern "C"
 	typedef BOOL (*pcVideoShowSurface)(VideoClientContext* video, const VideoSurface* surface,
 	                                   UINT32 destinationWidth, UINT32 destinationHeight);
 	typedef BOOL (*pcVideoDeleteSurface)(VideoClientContext* video, VideoSurface* surface);
+	/** @brief presents an I420 frame of surface without converting it, FALSE to let the channel
+	 * convert it and call showSurface instead */
+	typedef BOOL (*pcVideoShowYUVSurface)(VideoClientContext* video, const VideoSurface* surface,
+	                                      const BYTE* pYUVData[3], const UINT32 iStride[3],
+	                                      UINT32 destinationWidth, UINT32 destinationHeight);
 
 	/** @brief context for the video (MS-RDPEVOR) channel */
 	struct s_VideoClientContext
@@ -61,6 +66,7 @@ extern "C"
 		pcVideoCreateSurface createSurface;
 		pcVideoShowSurface showSurface;
 		pcVideoDeleteSurface deleteSurface;
+		pcVideoShowYUVSurface showYUVSurface; /* optional */
 	};
 
 	FREERDP_API VideoSurface* VideoClient_CreateCommonContext(size_t size, UINT32 x, UINT32 y,
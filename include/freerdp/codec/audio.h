@@ -186,6 +186,7 @@ typedef struct AUDIO_FORMAT AUDIO_FORMAT;
 #define WAVE_FORMAT_DVM 0x2000
 #endif /* !__MINGW32__ */
 #define WAVE_FORMAT_AAC_MS 0xA106
+#define WAVE_FORMAT_OPUS 0x704F
 
 /**
  * Audio Format Functions
@@ -975,6 +975,15 @@ extern "C"
 	                                    UINT32 nXSrc, UINT32 nYSrc, const gdiPalette* palette,
 	                                    UINT32 flags);
 
+	/***
+	 * Copies that do not overlap and move at least threshold bytes are split into row
+	 * bands on a thread pool, the bands use non-temporal stores. The default is 4 MiB.
+	 *
+	 * @param threshold size of the destination rectangle in bytes, 0 disables it
+	 */
+	FREERDP_API void freerdp_image_copy_set_parallel_threshold(size_t threshold);
+	FREERDP_API size_t freerdp_image_copy_get_parallel_threshold(void);
+
 	/***
 	 *
 	 * @param pDstData   destination buffer
@@ -1000,6 +1009,28 @@ extern "C"
 	                                     UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
 	                                     UINT32 nSrcWidth, UINT32 nSrcHeight);
 
+	/***
+	 *
+	 * Scales like freerdp_image_scale, but only writes the part of the destination in the
+	 * rectangle. The result is the same as that of scaling the whole image, so the changed
+	 * parts of an image can be scaled one by one without seams. Always uses the built-in
+	 * scaler, the filter tables of recent sizes are cached.
+	 *
+	 * @param nXRect      rectangle x offset, relative to nXDst
+	 * @param nYRect      rectangle y offset, relative to nYDst
+	 * @param nRectWidth  rectangle width
+	 * @param nRectHeight rectangle height
+	 *
+	 * @return          TRUE if success, FALSE otherwise
+	 */
+	FREERDP_API BOOL freerdp_image_scale_rect(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+	                                          UINT32 nXDst, UINT32 nYDst, UINT32 nDstWidth,
+	                                          UINT32 nDstHeight, const BYTE* pSrcData,
+	                                          DWORD SrcFormat, UINT32 nSrcStep, UINT32 nXSrc,
+	                                          UINT32 nYSrc, UINT32 nSrcWidth, UINT32 nSrcHeight,
+	                                          UINT32 nXRect, UINT32 nYRect, UINT32 nRectWidth,
+	                                          UINT32 nRectHeight);
+
 	/***
 	 *
 	 * @param pDstData  destionation buffer
@@ -32,7 +32,8 @@ typedef struct S_YUV_CONTEXT YUV_CONTEXT;
 typedef enum
 {
 	H264_RATECONTROL_VBR = 0,
-	H264_RATECONTROL_CQP
+	H264_RATECONTROL_CQP,
+	H264_RATECONTROL_CBR
 } H264_RATECONTROL_MODE;
 
 typedef struct
@@ -46,7 +47,11 @@ typedef struct
 	UINT32 BitRate;
 	UINT32 FrameRate;
 	UINT32 QP;
+	UINT32 MinQP; /* 0 for the encoder default */
+	UINT32 MaxQP; /* 0 for the encoder default */
 	UINT32 NumberOfThreads;
+	/* AVC444 sends the chroma stream at least every n frames, 0 or 1 for every frame */
+	UINT32 ChromaRefreshInterval;
 
 	UINT32 iStride[3];
 	BYTE* pOldYUVData[3];
@@ -68,6 +73,18 @@ typedef struct
 
 	void* lumaData;
 	wLog* log;
+
+	/* Platform window decoders present AVC420 frames in, see h264_context_set_output_window */
+	void* OutputWindow;
+	BOOL FrameRendered; /* the last frame went to OutputWindow, pYUVData is not valid */
+
+	/* One byte per 64x64 tile for the main and auxiliary stream, each bit marks a
+	 * change in one of the last 8 frames */
+	BYTE* pChangeHistory[2];
+	UINT32 changeHistorySize;
+	/* One byte per 64x64 tile, set while a chroma change was not sent yet */
+	BYTE* pPendingChroma;
+	UINT32 chromaFrameCount;
 } H264_CONTEXT;
 
 #ifdef __cplusplus
@@ -95,6 +112,15 @@ extern "C"
 	                                    UINT32 nDstWidth, UINT32 nDstHeight,
 	                                    const RECTANGLE_16* regionRects, UINT32 numRegionRect);
 
+	/**
+	 * @brief avc420_decompress_yuv Decodes a frame without converting it to RGB
+	 * @return 1 and the planes of the frame, valid until the next call, 0 if the sample
+	 * produced no frame, a negative value on error
+	 */
+	FREERDP_API INT32 avc420_decompress_yuv(H264_CONTEXT* h264, const BYTE* pSrcData,
+	                                        UINT32 SrcSize, const BYTE* pYUVData[3],
+	                                        UINT32 iStride[3]);
+
 	FREERDP_API INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                                  UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
 	                                  BYTE version, const RECTANGLE_16* regionRect, BYTE* op,
@@ -112,6 +138,15 @@ extern "C"
 
 	FREERDP_API BOOL h264_context_reset(H264_CONTEXT* h264, UINT32 width, UINT32 height);
 
+	/**
+	 * @brief h264_context_set_output_window Lets the decoder present AVC420 frames directly
+	 * in a platform window (an ANativeWindow with MediaCodec) instead of converting them into
+	 * the destination buffer. Decoders without window support keep decoding to memory, check
+	 * FrameRendered after avc420_decompress. NULL switches back to decoding to memory.
+	 * The decoder is created again, the next frame has to be a key frame.
+	 */
+	FREERDP_API BOOL h264_context_set_output_window(H264_CONTEXT* h264, void* window);
+
 	FREERDP_API H264_CONTEXT* h264_context_new(BOOL Compressor);
 	FREERDP_API void h264_context_free(H264_CONTEXT* h264);
 
@@ -40,6 +40,8 @@ extern "C"
 	                                  const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
 
 	FREERDP_API void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush);
+	FREERDP_API void ncrush_set_match_finder(NCRUSH_CONTEXT* ncrush, UINT32 MaxChainDepth,
+	                                         BOOL LazyMatching);
 
 	FREERDP_API NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor);
 	FREERDP_API void ncrush_context_free(NCRUSH_CONTEXT* ncrush);
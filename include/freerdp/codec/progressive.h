@@ -43,6 +43,30 @@ extern "C"
 	                                     const REGION16* invalidRegion, BYTE** ppDstData,
 	                                     UINT32* pDstSize);
 
+	/**
+	 * Encodes the invalid region of a surface created with progressive_create_surface_context
+	 * as coarse first passes and spends up to upgradeBudget bytes on upgrade passes of
+	 * previously sent tiles. An empty invalidRegion only sends upgrades.
+	 */
+	FREERDP_API int progressive_compress_surface(PROGRESSIVE_CONTEXT* progressive,
+	                                             UINT16 surfaceId, const BYTE* pSrcData,
+	                                             UINT32 SrcSize, UINT32 SrcFormat, UINT32 Width,
+	                                             UINT32 Height, UINT32 ScanLine,
+	                                             const REGION16* invalidRegion,
+	                                             UINT32 upgradeBudget, BYTE** ppDstData,
+	                                             UINT32* pDstSize);
+
+	FREERDP_API UINT32 progressive_surface_pending_upgrades(PROGRESSIVE_CONTEXT* progressive,
+	                                                        UINT16 surfaceId);
+
+	/**
+	 * Returns the memory held by the tiles of a surface and its high water mark. Tile
+	 * buffers are allocated on first use and tiles at full quality drop their upgrade state.
+	 */
+	FREERDP_API BOOL progressive_get_surface_memory(PROGRESSIVE_CONTEXT* progressive,
+	                                                UINT16 surfaceId, size_t* pCurrent,
+	                                                size_t* pPeak);
+
 	FREERDP_API INT32 progressive_decompress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData,
 	                                         UINT32 SrcSize, BYTE* pDstData, UINT32 DstFormat,
 	                                         UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
@@ -58,6 +82,8 @@ extern "C"
 	FREERDP_API BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* progressive);
 
 	FREERDP_API PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor);
+	FREERDP_API PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor,
+	                                                            UINT32 ThreadingFlags);
 	FREERDP_API void progressive_context_free(PROGRESSIVE_CONTEXT* progressive);
 
 #ifdef __cplusplus
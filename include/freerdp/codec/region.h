@@ -120,6 +120,20 @@ extern "C"
 	FREERDP_API BOOL region16_union_rect(REGION16* dst, const REGION16* src,
 	                                     const RECTANGLE_16* rect);
 
+	/** adds rectangles in src and stores the resulting region in dst
+	 *
+	 * The region is built in a single sweep, this is much cheaper than calling
+	 * region16_union_rect for each rectangle.
+	 *
+	 * @param dst destination region
+	 * @param src source region
+	 * @param rects the rectangles to add, in any order
+	 * @param count number of rectangles
+	 * @return if the operation was successful (false meaning out-of-memory)
+	 */
+	FREERDP_API BOOL region16_union_rects(REGION16* dst, const REGION16* src,
+	                                      const RECTANGLE_16* rects, UINT32 count);
+
 	/** returns if a rectangle intersects the region
 	 * @param src the region
 	 * @param arg2 the rectangle
@@ -136,6 +150,18 @@ extern "C"
 	FREERDP_API BOOL region16_intersect_rect(REGION16* dst, const REGION16* src,
 	                                         const RECTANGLE_16* arg2);
 
+	/** covers the region with fewer, larger rectangles when it has more than maxRects
+	 *
+	 * The gaps between the rectangles of a band are closed, the smallest ones first. If a
+	 * rectangle per band is still too many, neighbouring bands are stacked. The result
+	 * contains the region and has the same extents, it may cover some pixels that were not
+	 * in the region.
+	 *
+	 * @param region the region to coalesce
+	 * @param maxRects the number of rectangles to stay below, 0 leaves the region as is
+	 */
+	FREERDP_API void region16_coalesce(REGION16* region, UINT32 maxRects);
+
 	/** release internal data associated with this region
 	 * @param region the region to release
 	 */
@@ -155,6 +155,8 @@ extern "C"
 		void (*quantization_encode)(INT16* buffer, const UINT32* quantization_values);
 		void (*dwt_2d_decode)(INT16* buffer, INT16* dwt_buffer);
 		void (*dwt_2d_encode)(INT16* buffer, INT16* dwt_buffer);
+		void (*quantization_dwt_2d_decode)(INT16* buffer, INT16* dwt_buffer,
+		                                   const UINT32* quantization_values);
 		int (*rlgr_decode)(RLGR_MODE mode, const BYTE* data, UINT32 data_size, INT16* buffer,
 		                   UINT32 buffer_size);
 		int (*rlgr_encode)(RLGR_MODE mode, const INT16* data, UINT32 data_size, BYTE* buffer,
@@ -191,6 +193,36 @@ extern "C"
 
 	FREERDP_API BOOL rfx_context_reset(RFX_CONTEXT* context, UINT32 width, UINT32 height);
 
+	/**
+	 * Frees the tiles and buffers idling in the pools of the context, they are allocated again
+	 * when the next message needs them.
+	 */
+	FREERDP_API void rfx_context_trim(RFX_CONTEXT* context);
+
+	/**
+	 * Encoder contexts remember the pixels and the encoded data of every tile and reuse
+	 * the data when a tile did not change. Enabled by default.
+	 */
+	FREERDP_API BOOL rfx_context_set_tile_cache(RFX_CONTEXT* context, BOOL enable);
+	FREERDP_API BOOL rfx_context_get_tile_stats(RFX_CONTEXT* context, UINT64* tilesEncoded,
+	                                            UINT64* tilesSkipped);
+
+	/**
+	 * Encoder contexts with a shared tile cache look up tiles they would encode in a cache
+	 * of the whole process, identical tiles of different sessions are encoded once.
+	 * Disabled by default, the cache keeps the least recently used tiles within the limit.
+	 */
+	FREERDP_API BOOL rfx_context_set_shared_tile_cache(RFX_CONTEXT* context, BOOL enable);
+	FREERDP_API void rfx_shared_tile_cache_set_limit(size_t bytes);
+	FREERDP_API void rfx_shared_tile_cache_get_stats(size_t* bytes, UINT64* hits,
+	                                                 UINT64* misses);
+
+	/**
+	 * Raises every default quantization value of an encoder by offset, trading quality for
+	 * a lower bit rate. 0 restores the defaults.
+	 */
+	FREERDP_API BOOL rfx_context_set_quantization_offset(RFX_CONTEXT* context, UINT32 offset);
+
 	FREERDP_API RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags);
 	FREERDP_API RFX_CONTEXT* rfx_context_new(BOOL encoder);
 	FREERDP_API void rfx_context_free(RFX_CONTEXT* context);
@@ -32,6 +32,11 @@
 
 #define ZGFX_SEGMENTED_MAXSIZE 65535
 
+/* Compressor levels */
+#define ZGFX_COMPRESSION_NONE 0 /* raw segments only */
+#define ZGFX_COMPRESSION_FAST 1 /* greedy matching with short hash chains */
+#define ZGFX_COMPRESSION_LAZY 2 /* lazy matching with long hash chains */
+
 typedef struct S_ZGFX_CONTEXT ZGFX_CONTEXT;
 
 #ifdef __cplusplus
@@ -41,13 +46,24 @@ extern "C"
 
 	FREERDP_API int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize,
 	                                BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
+	/* appends the data at the position of sDst, which grows as needed */
+	FREERDP_API int zgfx_decompress_to_stream(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData,
+	                                          UINT32 SrcSize, wStream* sDst, UINT32 flags);
 	FREERDP_API int zgfx_compress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize,
 	                              BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags);
 	FREERDP_API int zgfx_compress_to_stream(ZGFX_CONTEXT* zgfx, wStream* sDst,
 	                                        const BYTE* pUncompressed, UINT32 uncompressedSize,
 	                                        UINT32* pFlags);
 
+	/* bytes to reserve in front of data that is framed with zgfx_compress_in_place */
+	FREERDP_API size_t zgfx_compress_headroom(size_t uncompressedSize);
+	/* Frames the data between offset and the position of s in the same buffer, the framed
+	 * packet starts at *pStart. Returns 0 when the headroom before offset is too small. */
+	FREERDP_API int zgfx_compress_in_place(ZGFX_CONTEXT* zgfx, wStream* s, size_t offset,
+	                                       size_t* pStart, UINT32* pFlags);
+
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush);
+	FREERDP_API BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level);
 
 	FREERDP_API ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor);
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
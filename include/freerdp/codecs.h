@@ -45,6 +45,11 @@
 #define FREERDP_CODEC_AVC444 0x00000100
 #define FREERDP_CODEC_ALL 0xFFFFFFFF
 
+/* Codecs without state carried from one message to the next, their contexts can be released at
+ * any time */
+#define FREERDP_CODEC_STATELESS \
+	(FREERDP_CODEC_INTERLEAVED | FREERDP_CODEC_PLANAR | FREERDP_CODEC_NSCODEC)
+
 struct rdp_codecs
 {
 	rdpContext* context;
@@ -56,6 +61,11 @@ struct rdp_codecs
 	PROGRESSIVE_CONTEXT* progressive;
 	BITMAP_PLANAR_CONTEXT* planar;
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
+
+	/* contexts are created on first use, for the codecs and size of the last prepare/reset */
+	UINT32 flags;
+	UINT32 width;
+	UINT32 height;
 };
 
 #ifdef __cplusplus
@@ -68,6 +78,9 @@ extern "C"
 	FREERDP_API BOOL freerdp_client_codecs_reset(rdpCodecs* codecs, UINT32 flags, UINT32 width,
 	                                             UINT32 height);
 
+	FREERDP_API BOOL freerdp_client_codecs_ensure(rdpCodecs* codecs, UINT32 flags);
+	FREERDP_API void freerdp_client_codecs_release(rdpCodecs* codecs, UINT32 flags);
+
 	FREERDP_API rdpCodecs* codecs_new(rdpContext* context);
 	FREERDP_API void codecs_free(rdpCodecs* codecs);
 
@@ -75,8 +75,17 @@ extern "C"
 	FREERDP_API size_t ber_sizeof_sequence_tag(size_t length);
 	FREERDP_API BOOL ber_read_bit_string(wStream* s, size_t* length, BYTE* padding);
 
+	/* Single pass writers, the length is filled in by ber_write_end() once the content is
+	 * written. Elements nest, every begin needs a matching end in reverse order. */
+	FREERDP_API BOOL ber_write_sequence_begin(wStream* s, size_t* mark);
+	FREERDP_API BOOL ber_write_contextual_begin(wStream* s, BYTE tag, size_t* mark);
+	FREERDP_API BOOL ber_write_application_begin(wStream* s, BYTE tag, size_t* mark);
+	FREERDP_API BOOL ber_write_octet_string_begin(wStream* s, size_t* mark);
+	FREERDP_API BOOL ber_write_end(wStream* s, size_t mark);
+
 	FREERDP_API BOOL ber_read_octet_string_tag(wStream* s, size_t* length);
 	FREERDP_API BOOL ber_read_octet_string(wStream* s, BYTE** content, size_t* length);
+	FREERDP_API BOOL ber_read_octet_string_ref(wStream* s, const BYTE** content, size_t* length);
 	FREERDP_API size_t ber_write_octet_string_tag(wStream* s, size_t length);
 	FREERDP_API size_t ber_sizeof_octet_string(size_t length);
 	FREERDP_API size_t ber_sizeof_contextual_octet_string(size_t length);
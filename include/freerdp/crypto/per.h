@@ -31,6 +31,8 @@ extern "C"
 
 	FREERDP_API BOOL per_read_length(wStream* s, UINT16* length);
 	FREERDP_API BOOL per_write_length(wStream* s, UINT16 length);
+	FREERDP_API BOOL per_write_length_begin(wStream* s, size_t* mark);
+	FREERDP_API BOOL per_write_length_end(wStream* s, size_t mark);
 	FREERDP_API BOOL per_read_choice(wStream* s, BYTE* choice);
 	FREERDP_API BOOL per_write_choice(wStream* s, BYTE choice);
 	FREERDP_API BOOL per_read_selection(wStream* s, BYTE* selection);
@@ -82,6 +82,8 @@ struct rdp_tls
 	int alertLevel;
 	int alertDescription;
 	BOOL isGatewayTransport;
+	SSL_SESSION* session; /* client: session to resume, updated with new tickets */
+	BOOL isTunneled;      /* the RDP connection runs inside a gateway tunnel */
 };
 
 #ifdef __cplusplus
@@ -585,6 +585,12 @@ settings but before rdp_client_connect() to have it executed after the
 	FREERDP_API CONNECTION_STATE freerdp_get_state(const rdpContext* context);
 	FREERDP_API const char* freerdp_state_string(CONNECTION_STATE state);
 
+	/** Milliseconds the last connection spent in a state, including the current one so far */
+	FREERDP_API UINT64 freerdp_get_state_duration(const rdpContext* context,
+	                                              CONNECTION_STATE state);
+	/** Milliseconds from the start of the connection to the first graphics update, 0 if none */
+	FREERDP_API UINT64 freerdp_get_time_to_first_update(const rdpContext* context);
+
 	FREERDP_API BOOL freerdp_channels_from_mcs(rdpSettings* settings, const rdpContext* context);
 
 #ifdef __cplusplus
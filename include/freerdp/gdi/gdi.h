@@ -515,6 +515,10 @@ struct rdp_gdi
 	GeometryClientContext* geometry;
 
 	wLog* log;
+
+	/* of the current GFX frame, surface commands may be decoded in parallel */
+	UINT64 frameStart;
+	volatile LONGLONG frameDecodeTime;
 };
 
 #ifdef __cplusplus
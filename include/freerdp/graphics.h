@@ -69,7 +69,8 @@ extern "C"
 
 		BOOL compressed;          /* 32 */
 		BOOL ephemeral;           /* 33 */
-		UINT32 paddingC[64 - 34]; /* 34 */
+		UINT64 key64;             /* 34 persistent cache key, 0 if none */
+		UINT32 paddingC[64 - 36]; /* 36 */
 	};
 
 	FREERDP_API rdpBitmap* Bitmap_Alloc(rdpContext* context);
@@ -124,6 +125,21 @@ extern "C"
 	typedef BOOL (*pGlyph_SetBounds)(rdpContext* context, INT32 x, INT32 y, INT32 width,
 	                                 INT32 height);
 
+	typedef struct
+	{
+		const rdpGlyph* glyph;
+		INT32 x;
+		INT32 y;
+		INT32 w;
+		INT32 h;
+		INT32 sx;
+		INT32 sy;
+	} GLYPH_RUN_ENTRY;
+
+	/* Draws the glyphs of a text run in one call, optional replacement for Draw */
+	typedef BOOL (*pGlyph_DrawRun)(rdpContext* context, const GLYPH_RUN_ENTRY* entries,
+	                               size_t count, BOOL fOpRedundant);
+
 	struct rdp_glyph
 	{
 		size_t size;                /* 0 */
@@ -133,7 +149,8 @@ extern "C"
 		pGlyph_BeginDraw BeginDraw; /* 4 */
 		pGlyph_EndDraw EndDraw;     /* 5 */
 		pGlyph_SetBounds SetBounds; /* 6 */
-		UINT32 paddingA[16 - 7];    /* 7 */
+		pGlyph_DrawRun DrawRun;     /* 7 */
+		UINT32 paddingA[16 - 8];    /* 8 */
 
 		INT32 x;                  /* 16 */
 		INT32 y;                  /* 17 */
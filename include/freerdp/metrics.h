@@ -21,6 +21,7 @@
 #define FREERDP_METRICS_H
 
 #include <freerdp/api.h>
+#include <freerdp/types.h>
 
 struct rdp_metrics
 {
@@ -31,6 +32,57 @@ struct rdp_metrics
 	double TotalCompressionRatio;
 };
 
+/* Session counters, updated lock free and queryable from any thread */
+typedef enum
+{
+	FREERDP_METRIC_BYTES_IN,
+	FREERDP_METRIC_BYTES_OUT,
+	FREERDP_METRIC_PDUS_IN,
+	FREERDP_METRIC_PDUS_OUT,
+	FREERDP_METRIC_FRAMES_DECODED,
+	FREERDP_METRIC_FRAMES_ENCODED,
+	FREERDP_METRIC_FRAMES_ACKNOWLEDGED,
+	FREERDP_METRIC_TRANSPORT_IO_TIME, /* microseconds in transport reads and writes, all layers */
+	FREERDP_METRIC_GATEWAY_IO_TIME,   /* microseconds of that spent in the gateway tunnel */
+	FREERDP_METRIC_COUNTER_COUNT
+} FREERDP_METRIC_COUNTER;
+
+/* Session gauges, current values that go up and down */
+typedef enum
+{
+	FREERDP_METRIC_CODEC_CONTEXTS, /* allocated codec contexts */
+	FREERDP_METRIC_SURFACE_BYTES,  /* memory of graphics pipeline surfaces */
+	FREERDP_METRIC_GAUGE_COUNT
+} FREERDP_METRIC_GAUGE;
+
+/* Session histograms, all values are in microseconds */
+typedef enum
+{
+	FREERDP_METRIC_RTT,
+	FREERDP_METRIC_FRAME_ACK_LATENCY,
+	FREERDP_METRIC_DECODE_TIME,
+	FREERDP_METRIC_PRESENT_TIME,
+	FREERDP_METRIC_NETWORK_WAIT,
+	FREERDP_METRIC_FRAME_LATENCY, /* server frame timestamp to arrival, needs synchronized clocks */
+	FREERDP_METRIC_FRAME_DECODE_TIME, /* all surface commands of a frame */
+	FREERDP_METRIC_FRAME_TIME,        /* start of a frame to the end of its presentation */
+	FREERDP_METRIC_HISTOGRAM_COUNT
+} FREERDP_METRIC_HISTOGRAM;
+
+typedef struct
+{
+	UINT64 count;
+	UINT64 sum;
+	UINT64 min;
+	UINT64 max;
+	UINT64 p50;
+	UINT64 p90;
+	UINT64 p99;
+} FREERDP_METRIC_HISTOGRAM_SUMMARY;
+
+/* Receives one line of Prometheus text exposition format, without the line break */
+typedef BOOL (*pMetricsExportLine)(void* custom, const char* line);
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -39,6 +91,40 @@ extern "C"
 	FREERDP_API double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes,
 	                                       UINT32 CompressedBytes);
 
+	FREERDP_API UINT64 metrics_get_time_us(void);
+
+	FREERDP_API void metrics_counter_add(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter,
+	                                     UINT64 value);
+	FREERDP_API UINT64 metrics_counter_get(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter);
+	FREERDP_API double metrics_counter_rate(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter);
+	FREERDP_API const char* metrics_counter_name(FREERDP_METRIC_COUNTER counter);
+
+	FREERDP_API void metrics_gauge_add(rdpMetrics* metrics, FREERDP_METRIC_GAUGE gauge,
+	                                   INT64 value);
+	FREERDP_API INT64 metrics_gauge_get(rdpMetrics* metrics, FREERDP_METRIC_GAUGE gauge);
+	FREERDP_API const char* metrics_gauge_name(FREERDP_METRIC_GAUGE gauge);
+
+	FREERDP_API void metrics_histogram_record(rdpMetrics* metrics,
+	                                          FREERDP_METRIC_HISTOGRAM histogram, UINT64 value);
+	FREERDP_API BOOL metrics_histogram_get(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM histogram,
+	                                       FREERDP_METRIC_HISTOGRAM_SUMMARY* summary);
+	FREERDP_API UINT64 metrics_histogram_percentile(rdpMetrics* metrics,
+	                                                FREERDP_METRIC_HISTOGRAM histogram,
+	                                                double percentile);
+	FREERDP_API const char* metrics_histogram_name(FREERDP_METRIC_HISTOGRAM histogram);
+
+	FREERDP_API void metrics_channel_bytes(rdpMetrics* metrics, UINT16 channelId,
+	                                       const char* name, UINT64 bytesIn, UINT64 bytesOut);
+	FREERDP_API size_t metrics_channel_count(rdpMetrics* metrics);
+	FREERDP_API BOOL metrics_channel_get(rdpMetrics* metrics, size_t index, const char** name,
+	                                     UINT64* bytesIn, UINT64* bytesOut);
+
+	FREERDP_API void metrics_frame_sent(rdpMetrics* metrics, UINT32 frameId);
+	FREERDP_API void metrics_frame_acknowledged(rdpMetrics* metrics, UINT32 frameId);
+
+	FREERDP_API BOOL metrics_export(rdpMetrics* metrics, const char* labels,
+	                                pMetricsExportLine fkt, void* custom);
+
 	FREERDP_API rdpMetrics* metrics_new(rdpContext* context);
 	FREERDP_API void metrics_free(rdpMetrics* metrics);
 
@@ -83,6 +83,12 @@ typedef enum
 
 typedef LicenseCallbackResult (*psPeerLicenseCallback)(freerdp_peer* peer, wStream* s);
 
+typedef struct rdp_freerdp_peer_reactor freerdp_peer_reactor;
+
+typedef DWORD (*psPeerReactorGetEventHandles)(freerdp_peer* peer, HANDLE* events, DWORD count);
+typedef BOOL (*psPeerReactorCheckEvents)(freerdp_peer* peer);
+typedef void (*psPeerReactorRemoved)(freerdp_peer* peer);
+
 struct rdp_freerdp_peer
 {
 	rdpContext* context;
@@ -144,6 +150,15 @@ struct rdp_freerdp_peer
 	psPeerLicenseCallback LicenseCallback;
 
 	psPeerSendChannelPacket SendChannelPacket;
+
+	/* Used when the peer is serviced by a freerdp_peer_reactor:
+	 * ReactorGetEventHandles adds handles next to the transport ones, e.g. of the channel
+	 * manager, ReactorCheckEvents runs after CheckFileDescriptor whenever one fired and
+	 * ReactorRemoved is called once the peer left the reactor. Without ReactorRemoved
+	 * the peer is disconnected and freed. */
+	psPeerReactorGetEventHandles ReactorGetEventHandles;
+	psPeerReactorCheckEvents ReactorCheckEvents;
+	psPeerReactorRemoved ReactorRemoved;
 };
 
 #ifdef __cplusplus
@@ -159,6 +174,12 @@ extern "C"
 	FREERDP_API BOOL freerdp_peer_set_local_and_hostname(freerdp_peer* client,
 	                                                     const struct sockaddr_storage* peer_addr);
 
+	/* A reactor multiplexes many initialized peers over a few worker threads instead of
+	 * one thread per peer. workers = 0 uses one worker per processor. */
+	FREERDP_API freerdp_peer_reactor* freerdp_peer_reactor_new(DWORD workers);
+	FREERDP_API void freerdp_peer_reactor_free(freerdp_peer_reactor* reactor);
+	FREERDP_API BOOL freerdp_peer_reactor_add(freerdp_peer_reactor* reactor, freerdp_peer* peer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -409,6 +409,26 @@ typedef struct
 	rdpBrush brush;
 } ELLIPSE_CB_ORDER;
 
+/* Primary drawing order types ([MS-RDPEGDI] 2.2.2.2.1.1.2) that are delivered in batches */
+#define ORDERS_BATCH_TYPE_DSTBLT 0x00
+#define ORDERS_BATCH_TYPE_SCRBLT 0x02
+#define ORDERS_BATCH_TYPE_MEMBLT 0x0D
+#define ORDERS_BATCH_TYPE_OPAQUE_RECT 0x0A
+
+/* Consecutive primary orders of one orders PDU, in the order they were received */
+typedef struct
+{
+	UINT32 count;
+	const UINT32* orderType; /* ORDERS_BATCH_TYPE_* of each order */
+	const UINT32* index;     /* index of each order in the array of its type */
+	const BOOL* hasBounds;   /* TRUE if the order is clipped to its bounds */
+	const rdpBounds* bounds;
+	DSTBLT_ORDER* dstblt;
+	SCRBLT_ORDER* scrblt;
+	OPAQUE_RECT_ORDER* opaqueRect;
+	MEMBLT_ORDER* memblt;
+} ORDERS_BATCH;
+
 typedef BOOL (*pDstBlt)(rdpContext* context, const DSTBLT_ORDER* dstblt);
 typedef BOOL (*pPatBlt)(rdpContext* context, PATBLT_ORDER* patblt);
 typedef BOOL (*pScrBlt)(rdpContext* context, const SCRBLT_ORDER* scrblt);
@@ -435,6 +455,7 @@ typedef BOOL (*pEllipseSC)(rdpContext* context, const ELLIPSE_SC_ORDER* ellipse_
 typedef BOOL (*pEllipseCB)(rdpContext* context, const ELLIPSE_CB_ORDER* ellipse_cb);
 typedef BOOL (*pOrderInfo)(rdpContext* context, const ORDER_INFO* order_info,
                            const char* order_name);
+typedef BOOL (*pOrdersBatch)(rdpContext* context, const ORDERS_BATCH* batch);
 
 struct rdp_primary_update
 {
@@ -464,8 +485,11 @@ struct rdp_primary_update
 	pEllipseSC EllipseSC;                 /* 36 */
 	pEllipseCB EllipseCB;                 /* 37 */
 	/* Statistics callback */
-	pOrderInfo OrderInfo;     /* 38 */
-	UINT32 paddingB[48 - 39]; /* 39 */
+	pOrderInfo OrderInfo; /* 38 */
+	/* Optional, receives DstBlt, ScrBlt, OpaqueRect and MemBlt orders batched instead of
+	 * calling them one by one. The batch ends before any other order and with the PDU. */
+	pOrdersBatch OrdersBatch; /* 39 */
+	UINT32 paddingB[48 - 40]; /* 40 */
 };
 typedef struct rdp_primary_update rdpPrimaryUpdate;
 
@@ -142,6 +142,26 @@ typedef pstatus_t (*__RGBToAVC444YUV_t)(const BYTE* pSrc, UINT32 srcFormat, UINT
                                         const prim_size_t* roi);
 typedef pstatus_t (*__andC_32u_t)(const UINT32* pSrc, UINT32 val, UINT32* pDst, INT32 len);
 typedef pstatus_t (*__orC_32u_t)(const UINT32* pSrc, UINT32 val, UINT32* pDst, INT32 len);
+typedef pstatus_t (*__RGBToPlanar_8u_C4P4_t)(const BYTE* pSrc, UINT32 SrcFormat, INT32 srcStep,
+                                            BYTE* pDst[4], UINT32 width, UINT32 height);
+typedef pstatus_t (*__planarDeltaEncode_8u_P1_t)(const BYTE* pSrc, BYTE* pDst, UINT32 width,
+                                                 UINT32 height);
+typedef pstatus_t (*__planarRleScan_8u_t)(const BYTE* pSrc, UINT32 start, UINT32 len,
+                                          UINT32* pRawBytes, UINT32* pRunLength);
+/* Decodes numTiles RemoteFX tiles. pSrc holds the Y, Cb and Cr coefficients of each tile
+ * (3 * 4096 values per tile) after entropy and differential decoding, quantVals the Y, Cb and
+ * Cr quantization values (3 * 10 per tile). Tile i is written to pDst[i] with dstStep[i]. */
+typedef pstatus_t (*__RFXDecodeTiles_16s8u_t)(const INT16* pSrc, const UINT32* quantVals,
+                                              UINT32 numTiles, BYTE* const pDst[],
+                                              const UINT32 dstStep[], UINT32 DstFormat);
+/* Writes the padded base64 encoding of length bytes, 4 * ((length + 2) / 3) characters without
+ * a terminating NUL. */
+typedef pstatus_t (*__base64Encode_t)(const BYTE* pSrc, UINT32 length, char* pDst);
+/* Decodes length base64 characters, length must be a multiple of 4. pDst needs room for
+ * length / 4 * 3 bytes, the decoded size is returned in pDstLength. Invalid characters or
+ * padding fail. */
+typedef pstatus_t (*__base64Decode_t)(const char* pSrc, UINT32 length, BYTE* pDst,
+                                      UINT32* pDstLength);
 typedef pstatus_t (*primitives_uninit_t)(void);
 
 typedef struct
@@ -169,6 +189,7 @@ typedef struct
 	__shiftC_16u_t shiftC_16u;
 	/* Alpha Composition */
 	__alphaComp_argb_t alphaComp_argb;
+	__alphaComp_argb_t alphaCompPremultiplied_argb; /* pSrc1 with premultiplied alpha */
 	/* Sign */
 	__sign_16s_t sign_16s;
 	/* Color conversions */
@@ -177,6 +198,7 @@ typedef struct
 	__RGBToYCbCr_16s16s_P3P3_t RGBToYCbCr_16s16s_P3P3;
 	__RGBToRGB_16s8u_P3AC4R_t RGBToRGB_16s8u_P3AC4R;
 	__YCoCgToRGB_8u_AC4R_t YCoCgToRGB_8u_AC4R;
+	__RGB565ToARGB_16u32u_C3C4_t RGB565ToARGB_16u32u_C3C4;
 	__YUV420ToRGB_8u_P3AC4R_t YUV420ToRGB_8u_P3AC4R;
 	__RGBToYUV420_8u_P3AC4R_t RGBToYUV420_8u_P3AC4R;
 	__RGBToYUV444_8u_P3AC4R_t RGBToYUV444_8u_P3AC4R;
@@ -185,6 +207,14 @@ typedef struct
 	__YUV444ToRGB_8u_P3AC4R_t YUV444ToRGB_8u_P3AC4R;
 	__RGBToAVC444YUV_t RGBToAVC444YUV;
 	__RGBToAVC444YUV_t RGBToAVC444YUVv2;
+	/* Planar codec encoding */
+	__RGBToPlanar_8u_C4P4_t RGBToPlanar_8u_C4P4;
+	__planarDeltaEncode_8u_P1_t planarDeltaEncode_8u_P1;
+	__planarRleScan_8u_t planarRleScan_8u;
+	/* RemoteFX tile batches, only provided by GPU implementations */
+	__RFXDecodeTiles_16s8u_t RFXDecodeTiles_16s8u;
+	__base64Encode_t base64Encode;
+	__base64Decode_t base64Decode;
 	/* flags */
 	DWORD flags;
 	primitives_uninit_t uninit;
@@ -211,6 +241,10 @@ extern "C"
 	FREERDP_API BOOL primitives_init(primitives_t* p, primitive_hints hints);
 	FREERDP_API void primitives_uninit(void);
 
+	/** Describes which implementation primitives_get() uses for each function, one
+	 * "<function>: <implementation>" line per function. The result must be freed. */
+	FREERDP_API char* primitives_get_selection(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,19 @@ typedef enum ECHO_SERVER_OPEN_RESULT
 	ECHO_SERVER_OPEN_RESULT_ERROR = 3
 } ECHO_SERVER_OPEN_RESULT;
 
+#define ECHO_LATENCY_BUCKETS 12
+
+typedef struct
+{
+	UINT32 count; /* answered probes */
+	UINT32 lost;  /* probes that were never answered */
+	UINT64 min;   /* round trip times in ms */
+	UINT64 max;
+	UINT64 sum;
+	/* bucket i counts round trips below 2^i ms, the last one everything above */
+	UINT32 histogram[ECHO_LATENCY_BUCKETS];
+} ECHO_SERVER_LATENCY_STATS;
+
 typedef struct s_echo_server_context echo_server_context;
 
 typedef UINT (*psEchoServerOpen)(echo_server_context* context);
@@ -43,6 +56,8 @@ typedef UINT (*psEchoServerOpenResult)(echo_server_context* context,
                                        ECHO_SERVER_OPEN_RESULT result);
 typedef UINT (*psEchoServerResponse)(echo_server_context* context, const BYTE* buffer,
                                      UINT32 length);
+typedef void (*psEchoServerLatency)(echo_server_context* context, UINT32 sequence, UINT64 rtt,
+                                    const ECHO_SERVER_LATENCY_STATS* stats);
 
 struct s_echo_server_context
 {
@@ -76,6 +91,17 @@ struct s_echo_server_context
 	psEchoServerResponse Response;
 
 	rdpContext* rdpcontext;
+
+	/**
+	 * Interval in ms between latency probes sent once the channel is open,
+	 * 0 disables probing. Must be set before Open.
+	 */
+	UINT32 ProbeInterval;
+	/**
+	 * Receive the round trip time of an answered latency probe. Probe
+	 * answers are not passed to Response.
+	 */
+	psEchoServerLatency Latency;
 };
 
 #ifdef __cplusplus
@@ -33,11 +33,20 @@ struct proxy_config
 	/* server */
 	char* Host;
 	UINT16 Port;
+	UINT32 Workers; /* threads driving the sessions, 0 for one per processor */
+	UINT32 MaxHandshakes;    /* concurrent TLS/NLA handshakes, 0 for no limit */
+	UINT32 HandshakeTimeout; /* milliseconds a peer waits for a handshake slot */
+	UINT64 ThreadAffinity;   /* processors of the session threads, 0 leaves it to the OS */
 
 	/* target */
 	BOOL FixedTarget;
 	char* TargetHost;
 	UINT16 TargetPort;
+	UINT32 TargetPoolSize;        /* connected sockets kept per target, 0 disables the pool */
+	UINT32 TargetPoolIdleTimeout; /* seconds a pooled socket is kept */
+	char* FarmFile;               /* the farms routing tokens can name, NULL if unused */
+	UINT32 FarmRefreshInterval;   /* seconds between checks of the farm file */
+	UINT32 FarmStickyTimeout;     /* seconds a user returns to the same target, 0 disables */
 
 	/* input */
 	BOOL Keyboard;
@@ -55,6 +64,16 @@ struct proxy_config
 	BOOL ClientRdpSecurity;
 	BOOL ClientAllowFallbackToTls;
 
+	/* channel data shaping, rates in kbit/s, 0 for no limit */
+	BOOL QoS;
+	UINT32 QoSGraphicsRate;
+	UINT32 QoSAudioRate;
+	UINT32 QoSBulkRate;
+
+	/* metrics endpoint */
+	char* MetricsHost;
+	UINT16 MetricsPort; /* 0 disables the endpoint */
+
 	/* channels */
 	BOOL GFX;
 	BOOL DisplayControl;
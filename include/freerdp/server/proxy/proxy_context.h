@@ -23,6 +23,7 @@
 #define FREERDP_SERVER_PROXY_PFCONTEXT_H
 
 #include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
 #include <freerdp/channels/wtsvc.h>
 
 #include <freerdp/server/proxy/proxy_config.h>
@@ -36,6 +37,7 @@ extern "C"
 
 	typedef struct proxy_data proxyData;
 	typedef struct proxy_module proxyModule;
+	typedef struct proxy_qos proxyQos;
 
 	typedef struct s_InterceptContextMapEntry
 	{
@@ -81,6 +83,8 @@ extern "C"
 
 		wHashTable* interceptContextMap;
 		wHashTable* channelsById;
+
+		proxyQos* qos; /* schedules the channel data sent to the peer, NULL if disabled */
 	};
 	typedef struct p_server_context pServerContext;
 
@@ -111,8 +115,10 @@ extern "C"
 		BOOL connected; /* Set after client post_connect. */
 
 		pReceiveChannelData client_receive_channel_data_original;
+		pTCPConnect client_tcp_connect_original;
 		wQueue* cached_server_channel_data;
 		BOOL (*sendChannelData)(pClientContext* pc, const proxyChannelDataEventInfo* ev);
+		proxyQos* qos; /* schedules the channel data sent to the target, NULL if disabled */
 
 		/* X509 specific */
 		char* remote_hostname;
@@ -154,6 +160,16 @@ extern "C"
 		/* used to external modules to store per-session info */
 		wHashTable* modules_info;
 		psPeerReceiveChannelData server_receive_channel_data_original;
+
+		/* connection setup of both legs in microseconds, 0 until connected */
+		UINT64 connect_start_us;
+		UINT64 server_connect_us;
+		UINT64 client_connect_start_us;
+		UINT64 client_connect_us;
+
+		/* hooks and filters run and the microseconds spent in them */
+		volatile LONGLONG module_calls;
+		volatile LONGLONG module_time_us;
 	};
 
 	FREERDP_API BOOL pf_context_copy_settings(rdpSettings* dst, const rdpSettings* src);
@@ -107,6 +107,19 @@ extern "C"
 	 */
 	FREERDP_API BOOL pf_server_run(proxyServer* server);
 
+	/**
+	 * @brief pf_server_reload Replaces the configuration and modules used by new sessions.
+	 *        Running sessions keep the configuration they started with. Changes of the
+	 *        listener, workers and target pool settings need a restart.
+	 *        Can be called from any thread.
+	 *
+	 * @param server The server instance. Must NOT be NULL.
+	 * @param config The new configuration. Must NOT be NULL, it is copied.
+	 *
+	 * @return TRUE for success, FALSE if the configuration or its modules failed to load.
+	 */
+	FREERDP_API BOOL pf_server_reload(proxyServer* server, const proxyConfig* config);
+
 #ifdef __cplusplus
 }
 #endif
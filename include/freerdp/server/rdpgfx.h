@@ -77,6 +77,8 @@ typedef UINT (*psRdpgfxFrameAcknowledge)(RdpgfxServerContext* context,
                                          const RDPGFX_FRAME_ACKNOWLEDGE_PDU* frameAcknowledge);
 typedef UINT (*psRdpgfxQoeFrameAcknowledge)(
     RdpgfxServerContext* context, const RDPGFX_QOE_FRAME_ACKNOWLEDGE_PDU* qoeFrameAcknowledge);
+typedef UINT (*psRdpgfxBeginBatch)(RdpgfxServerContext* context);
+typedef UINT (*psRdpgfxEndBatch)(RdpgfxServerContext* context, BOOL send);
 
 struct s_rdpgfx_server_context
 {
@@ -110,6 +112,12 @@ struct s_rdpgfx_server_context
 	psRdpgfxFrameAcknowledge FrameAcknowledge;
 	psRdpgfxQoeFrameAcknowledge QoeFrameAcknowledge;
 
+	/* Packets sent between BeginBatch and EndBatch are serialized into one buffer,
+	 * compressed together and written with a single channel write by EndBatch.
+	 * The batch belongs to the thread that started it. */
+	psRdpgfxBeginBatch BeginBatch;
+	psRdpgfxEndBatch EndBatch;
+
 	RdpgfxServerPrivate* priv;
 	rdpContext* rdpcontext;
 };
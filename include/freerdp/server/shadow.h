@@ -51,6 +51,7 @@ typedef struct rdp_shadow_encoder rdpShadowEncoder;
 typedef struct rdp_shadow_capture rdpShadowCapture;
 typedef struct rdp_shadow_subsystem rdpShadowSubsystem;
 typedef struct rdp_shadow_multiclient_event rdpShadowMultiClientEvent;
+typedef struct rdp_shadow_fanout rdpShadowFanout;
 
 typedef struct S_RDP_SHADOW_ENTRY_POINTS RDP_SHADOW_ENTRY_POINTS;
 typedef int (*pfnShadowSubsystemEntry)(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
@@ -88,6 +89,16 @@ typedef BOOL (*pfnShadowChannelAudinServerReceiveSamples)(rdpShadowSubsystem* su
                                                           const AUDIO_FORMAT* format, wStream* buf,
                                                           size_t nframes);
 
+#define SHADOW_MAX_GFX_OUTPUTS 16
+
+/* graphics pipeline surface showing one monitor of the desktop */
+typedef struct
+{
+	UINT16 surfaceId;
+	RECTANGLE_16 rect;         /* area of the desktop the surface shows */
+	rdpShadowEncoder* encoder; /* the encoder of the client if there is only one output */
+} SHADOW_GFX_OUTPUT;
+
 struct rdp_shadow_client
 {
 	rdpContext context;
@@ -100,8 +111,12 @@ struct rdp_shadow_client
 	BOOL mayInteract;
 	BOOL suppressOutput;
 	UINT16 surfaceId;
+	UINT32 numOutputs;
+	SHADOW_GFX_OUTPUT outputs[SHADOW_MAX_GFX_OUTPUTS];
 	wMessageQueue* MsgQueue;
 	CRITICAL_SECTION lock;
+	CRITICAL_SECTION encodeLock; /* held by the encode thread while it handles a frame */
+	BOOL shareFrames; /* encoding within a frame update, encoded data may be shared */
 	REGION16 invalidRegion;
 	rdpShadowServer* server;
 	rdpShadowEncoder* encoder;
@@ -137,7 +152,9 @@ struct rdp_shadow_server
 	BOOL shareSubRect;
 	BOOL authentication;
 	UINT32 selectedMonitor;
+	BOOL spanMonitors; /* share the bounding box of all monitors */
 	RECTANGLE_16 subRect;
+	UINT64 threadAffinity; /* processors for the server threads, 0 leaves placement to the OS */
 
 	/* Codec settings */
 	RLGR_MODE rfxMode;
@@ -145,6 +162,9 @@ struct rdp_shadow_server
 	UINT32 h264BitRate;
 	UINT32 h264FrameRate;
 	UINT32 h264QP;
+	BOOL gfxMixed; /* lossless codecs for the content H.264 does not classify as video */
+
+	rdpShadowFanout* fanout; /* encoded frames shared between the clients */
 
 	char* ipcSocket;
 	char* ConfigPath;
@@ -168,6 +188,16 @@ struct rdp_shadow_surface
 
 	CRITICAL_SECTION lock;
 	REGION16 invalidRegion;
+
+	/* frame buffer of the surface, data points at a capture buffer while one is attached */
+	BYTE* buffer;
+	UINT32 bufferScanline;
+
+	/* content the capture reports as moved to moveSrc + (moveDx, moveDy) within invalidRegion */
+	BOOL moveValid;
+	RECTANGLE_16 moveSrc;
+	INT32 moveDx;
+	INT32 moveDy;
 };
 
 struct S_RDP_SHADOW_ENTRY_POINTS
@@ -284,6 +314,8 @@ extern "C"
 
 	FREERDP_API void shadow_subsystem_set_entry_builtin(const char* name);
 	FREERDP_API void shadow_subsystem_set_entry(pfnShadowSubsystemEntry pEntry);
+	/* used once if the subsystem set with shadow_subsystem_set_entry fails to initialize */
+	FREERDP_API void shadow_subsystem_set_fallback_entry(pfnShadowSubsystemEntry pEntry);
 
 	FREERDP_API int shadow_subsystem_pointer_convert_alpha_pointer_data(
 	    BYTE* pixels, BOOL premultiplied, UINT32 width, UINT32 height,
@@ -310,6 +342,14 @@ extern "C"
 	FREERDP_API int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth,
 	                                       UINT32 nHeight, BYTE* pData2, UINT32 nStep2,
 	                                       RECTANGLE_16* rect);
+	FREERDP_API int shadow_capture_compare_region(const BYTE* pData1, UINT32 nStep1,
+	                                              UINT32 nWidth, UINT32 nHeight,
+	                                              const BYTE* pData2, UINT32 nStep2,
+	                                              const REGION16* hint, REGION16* region);
+	FREERDP_API BOOL shadow_capture_find_scroll(const BYTE* pData1, UINT32 nStep1,
+	                                            const BYTE* pData2, UINT32 nStep2,
+	                                            const RECTANGLE_16* rect, RECTANGLE_16* src,
+	                                            INT32* dx, INT32* dy);
 
 	FREERDP_API void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem);
 
@@ -324,6 +364,9 @@ extern "C"
 
 	FREERDP_API BOOL shadow_screen_resize(rdpShadowScreen* screen);
 
+	FREERDP_API void shadow_surface_attach_buffer(rdpShadowSurface* surface, BYTE* data,
+	                                              UINT32 scanline);
+
 #ifdef __cplusplus
 }
 #endif
@@ -510,6 +510,8 @@ typedef struct
 #define FreeRDP_MaxTimeInCheckLoop (26)
 #define FreeRDP_AcceptedCert (27)
 #define FreeRDP_AcceptedCertLength (28)
+#define FreeRDP_MaxConcurrentHandshakes (29)
+#define FreeRDP_HandshakeQueueTimeout (30)
 #define FreeRDP_ThreadingFlags (64)
 #define FreeRDP_RdpVersion (128)
 #define FreeRDP_DesktopWidth (129)
@@ -585,6 +587,8 @@ typedef struct
 #define FreeRDP_ForceEncryptedCsPdu (719)
 #define FreeRDP_HiDefRemoteApp (720)
 #define FreeRDP_CompressionLevel (721)
+#define FreeRDP_NCrushMaxChainDepth (722)
+#define FreeRDP_NCrushLazyMatching (723)
 #define FreeRDP_IPv6Enabled (768)
 #define FreeRDP_ClientAddress (769)
 #define FreeRDP_ClientDir (770)
@@ -754,6 +758,7 @@ typedef struct
 #define FreeRDP_GatewayAcceptedCert (1998)
 #define FreeRDP_GatewayAcceptedCertLength (1999)
 #define FreeRDP_GatewayHttpUseWebsockets (2000)
+#define FreeRDP_GatewayInnerTlsCiphers (2001)
 #define FreeRDP_ProxyType (2015)
 #define FreeRDP_ProxyHostname (2016)
 #define FreeRDP_ProxyPort (2017)
@@ -801,6 +806,7 @@ typedef struct
 #define FreeRDP_BitmapCachePersistEnabled (2500)
 #define FreeRDP_BitmapCacheV2NumCells (2501)
 #define FreeRDP_BitmapCacheV2CellInfo (2502)
+#define FreeRDP_BitmapCachePersistFile (2503)
 #define FreeRDP_ColorPointerFlag (2560)
 #define FreeRDP_PointerCacheSize (2561)
 #define FreeRDP_KeyboardRemappingList (2622)
@@ -859,6 +865,8 @@ typedef struct
 #define FreeRDP_GfxAVC444v2 (3847)
 #define FreeRDP_GfxCapsFilter (3848)
 #define FreeRDP_GfxPlanar (3849)
+#define FreeRDP_GfxClearCodec (3850)
+#define FreeRDP_GfxOutputMaxRects (3851)
 #define FreeRDP_BitmapCacheV3CodecId (3904)
 #define FreeRDP_DrawNineGridEnabled (3968)
 #define FreeRDP_DrawNineGridCacheSize (3969)
@@ -932,7 +940,9 @@ struct rdp_settings
 	ALIGN64 UINT32 MaxTimeInCheckLoop;     /* 26 */
 	ALIGN64 char* AcceptedCert;            /* 27 */
 	ALIGN64 UINT32 AcceptedCertLength;     /* 28 */
-	UINT64 padding0064[64 - 29];           /* 29 */
+	ALIGN64 UINT32 MaxConcurrentHandshakes; /* 29 */
+	ALIGN64 UINT32 HandshakeQueueTimeout;   /* 30 */
+	UINT64 padding0064[64 - 31];            /* 31 */
 	/* resource management related options */
 	ALIGN64 UINT32 ThreadingFlags; /* 64 */
 
@@ -1046,7 +1056,9 @@ struct rdp_settings
 	ALIGN64 BOOL ForceEncryptedCsPdu;    /* 719 */
 	ALIGN64 BOOL HiDefRemoteApp;         /* 720 */
 	ALIGN64 UINT32 CompressionLevel;     /* 721 */
-	UINT64 padding0768[768 - 722];       /* 722 */
+	ALIGN64 UINT32 NCrushMaxChainDepth;  /* 722 */
+	ALIGN64 BOOL NCrushLazyMatching;     /* 723 */
+	UINT64 padding0768[768 - 724];       /* 724 */
 
 	/* Client Info (Extra) */
 	ALIGN64 BOOL IPv6Enabled;      /* 768 */
@@ -1291,7 +1303,8 @@ struct rdp_settings
 	ALIGN64 char* GatewayAcceptedCert;        /* 1998 */
 	ALIGN64 UINT32 GatewayAcceptedCertLength; /* 1999 */
 	ALIGN64 BOOL GatewayHttpUseWebsockets;    /* 2000 */
-	UINT64 padding2015[2015 - 2001];          /* 2001 */
+	ALIGN64 char* GatewayInnerTlsCiphers;     /* 2001 */
+	UINT64 padding2015[2015 - 2002];          /* 2002 */
 
 	/* Proxy */
 	ALIGN64 UINT32 ProxyType;        /* 2015 */
@@ -1368,7 +1381,8 @@ struct rdp_settings
 	ALIGN64 BOOL BitmapCachePersistEnabled;                   /* 2500 */
 	ALIGN64 UINT32 BitmapCacheV2NumCells;                     /* 2501 */
 	ALIGN64 BITMAP_CACHE_V2_CELL_INFO* BitmapCacheV2CellInfo; /* 2502 */
-	UINT64 padding2560[2560 - 2503];                          /* 2503 */
+	ALIGN64 char* BitmapCachePersistFile;                     /* 2503 */
+	UINT64 padding2560[2560 - 2504];                          /* 2504 */
 
 	/* Pointer Capabilities */
 	ALIGN64 BOOL ColorPointerFlag;   /* 2560 */
@@ -1487,17 +1501,19 @@ struct rdp_settings
 	ALIGN64 UINT32 JpegQuality;      /* 3778 */
 	UINT64 padding3840[3840 - 3779]; /* 3779 */
 
-	ALIGN64 BOOL GfxThinClient;      /* 3840 */
-	ALIGN64 BOOL GfxSmallCache;      /* 3841 */
-	ALIGN64 BOOL GfxProgressive;     /* 3842 */
-	ALIGN64 BOOL GfxProgressiveV2;   /* 3843 */
-	ALIGN64 BOOL GfxH264;            /* 3844 */
-	ALIGN64 BOOL GfxAVC444;          /* 3845 */
-	ALIGN64 BOOL GfxSendQoeAck;      /* 3846 */
-	ALIGN64 BOOL GfxAVC444v2;        /* 3847 */
-	ALIGN64 UINT32 GfxCapsFilter;    /* 3848 */
-	ALIGN64 BOOL GfxPlanar;          /* 3849 */
-	UINT64 padding3904[3904 - 3850]; /* 3850 */
+	ALIGN64 BOOL GfxThinClient;       /* 3840 */
+	ALIGN64 BOOL GfxSmallCache;       /* 3841 */
+	ALIGN64 BOOL GfxProgressive;      /* 3842 */
+	ALIGN64 BOOL GfxProgressiveV2;    /* 3843 */
+	ALIGN64 BOOL GfxH264;             /* 3844 */
+	ALIGN64 BOOL GfxAVC444;           /* 3845 */
+	ALIGN64 BOOL GfxSendQoeAck;       /* 3846 */
+	ALIGN64 BOOL GfxAVC444v2;         /* 3847 */
+	ALIGN64 UINT32 GfxCapsFilter;     /* 3848 */
+	ALIGN64 BOOL GfxPlanar;           /* 3849 */
+	ALIGN64 BOOL GfxClearCodec;       /* 3850 */
+	ALIGN64 UINT32 GfxOutputMaxRects; /* 3851 */
+	UINT64 padding3904[3904 - 3852];  /* 3852 */
 
 	/**
 	 * Caches
@@ -28,6 +28,7 @@
 #include <freerdp/freerdp.h>
 
 typedef struct stream_dump_context rdpStreamDumpContext;
+typedef struct stream_dump_index rdpStreamDumpIndex;
 
 #ifdef __cplusplus
 extern "C"
@@ -44,6 +45,20 @@ extern "C"
 
 	FREERDP_API BOOL stream_dump_register_handlers(rdpContext* context, CONNECTION_STATE state);
 
+	/* Index of the records of a dump file, built from the record headers only */
+	FREERDP_API rdpStreamDumpIndex* stream_dump_index_new(FILE* fp);
+	FREERDP_API void stream_dump_index_free(rdpStreamDumpIndex* index);
+	FREERDP_API size_t stream_dump_index_count(const rdpStreamDumpIndex* index);
+	FREERDP_API BOOL stream_dump_index_get(const rdpStreamDumpIndex* index, size_t entry,
+	                                       UINT64* pts, size_t* offset);
+	FREERDP_API BOOL stream_dump_index_find(const rdpStreamDumpIndex* index, UINT64 pts,
+	                                        size_t* entry);
+
+	/* Continue the replay with the first record at least ms after the start of the dump */
+	FREERDP_API BOOL stream_dump_replay_seek(rdpContext* context, UINT64 ms);
+	/* Replay pace in percent of the recorded speed, 0 replays without delays */
+	FREERDP_API void stream_dump_set_replay_speed(rdpContext* context, UINT32 percent);
+
 	FREERDP_API rdpStreamDumpContext* stream_dump_new(void);
 	FREERDP_API void stream_dump_free(rdpStreamDumpContext* dump);
 
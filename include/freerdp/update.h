@@ -190,6 +190,7 @@ typedef BOOL (*pSaveSessionInfo)(rdpContext* context, UINT32 type, void* data);
 typedef BOOL (*pSetKeyboardImeStatus)(rdpContext* context, UINT16 imeId, UINT32 imeState,
                                       UINT32 imeConvMode);
 typedef BOOL (*pServerStatusInfo)(rdpContext* context, UINT32 status);
+typedef BOOL (*pFastPathUpdate)(rdpContext* context, BYTE updateCode, wStream* s);
 
 struct rdp_update
 {
@@ -231,7 +232,11 @@ struct rdp_update
 	 * fills BITMAP_DATA struct members: flags, cbCompMainBodySize and cbCompFirstRowSize.
 	 */
 	BOOL autoCalculateBitmapData; /* 71 */
-	UINT32 paddingE[80 - 72];     /* 72 */
+	/* if set, bitmap and pointer fastpath updates are handed over as received (decompressed
+	 * and reassembled) instead of being parsed and dispatched to the callbacks above.
+	 */
+	pFastPathUpdate FastPathUpdate; /* 72 */
+	UINT32 paddingE[80 - 73];       /* 73 */
 };
 
 #ifdef __cplusplus
@@ -242,6 +247,9 @@ extern "C"
 	FREERDP_API void rdp_update_lock(rdpUpdate* update);
 	FREERDP_API void rdp_update_unlock(rdpUpdate* update);
 
+	FREERDP_API BOOL rdp_update_send_fastpath(rdpUpdate* update, BYTE updateCode,
+	                                          const BYTE* data, size_t length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -56,18 +56,6 @@ struct s_pcap_record
 	pcap_record* next;
 };
 
-struct rdp_pcap
-{
-	FILE* fp;
-	char* name;
-	BOOL write;
-	INT64 file_size;
-	int record_count;
-	pcap_header header;
-	pcap_record* head;
-	pcap_record* tail;
-	pcap_record* record;
-};
 typedef struct rdp_pcap rdpPcap;
 
 #ifdef __cplusplus
@@ -76,6 +64,16 @@ extern "C"
 #endif
 
 	FREERDP_API rdpPcap* pcap_open(const char* name, BOOL write);
+
+	/**
+	 * Opens a capture file. When writing, records are copied to a buffer of bufferSize bytes
+	 * (0 selects the default) and written by a background thread, records that do not fit are
+	 * dropped. With a rotateSize other than 0 a new file <name>.<n> is started whenever the
+	 * current one would grow beyond rotateSize bytes.
+	 */
+	FREERDP_API rdpPcap* pcap_open_ex(const char* name, BOOL write, size_t bufferSize,
+	                                  UINT64 rotateSize);
+
 	FREERDP_API void pcap_close(rdpPcap* pcap);
 
 	FREERDP_API BOOL pcap_add_record(rdpPcap* pcap, const void* data, UINT32 length);
@@ -0,0 +1,59 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Tracing Utils
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_TRACE_H
+#define FREERDP_UTILS_TRACE_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+/* Environment variable naming the file a trace is written to at exit */
+#define FREERDP_TRACE_ENV "FREERDP_TRACE_FILE"
+
+/* Number of spans every thread keeps, older ones are overwritten */
+#define FREERDP_TRACE_RING_SIZE 4096
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * Spans are recorded into per thread ring buffers while tracing is enabled and
+	 * written in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+	 * Tracing is started at runtime either with freerdp_trace_start() or by setting
+	 * FREERDP_TRACE_FILE, in which case the trace is written when the process exits.
+	 * While disabled a span costs a single flag check.
+	 */
+	FREERDP_API BOOL freerdp_trace_start(const char* path);
+	FREERDP_API BOOL freerdp_trace_stop(void);
+	FREERDP_API BOOL freerdp_trace_is_enabled(void);
+	FREERDP_API BOOL freerdp_trace_export(const char* path);
+
+	/* Returns the start timestamp in nanoseconds or 0 if tracing is disabled */
+	FREERDP_API UINT64 freerdp_trace_begin(void);
+	/* name must be a string literal, only the pointer is kept */
+	FREERDP_API void freerdp_trace_end(const char* name, UINT64 start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FREERDP_TRACE_SPAN_BEGIN(span) const UINT64 span = freerdp_trace_begin()
+#define FREERDP_TRACE_SPAN_END(span, name) freerdp_trace_end((name), (span))
+
+#endif /* FREERDP_UTILS_TRACE_H */
@@ -29,7 +29,9 @@
 #include <winpr/stream.h>
 
 #include <freerdp/log.h>
+#include <freerdp/codec/color.h>
 #include <freerdp/cache/bitmap.h>
+#include <freerdp/cache/persistent.h>
 #include <freerdp/gdi/bitmap.h>
 
 #include "../gdi/gdi.h"
@@ -42,6 +44,8 @@
 static rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index);
 static BOOL bitmap_cache_put(rdpBitmapCache* bitmap_cache, UINT32 id, UINT32 index,
                              rdpBitmap* bitmap);
+static void bitmap_cache_load_persistent_entry(rdpBitmapCache* bitmapCache, UINT32 id,
+                                               UINT32 index);
 
 static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
@@ -53,7 +57,11 @@ static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 	if (memblt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, memblt->cacheIndex);
 	else
+	{
+		bitmap_cache_load_persistent_entry(cache->bitmap, (BYTE)memblt->cacheId,
+		                                   memblt->cacheIndex);
 		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)memblt->cacheId, memblt->cacheIndex);
+	}
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (bitmap == NULL)
@@ -74,7 +82,11 @@ static BOOL update_gdi_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
 	if (mem3blt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, mem3blt->cacheIndex);
 	else
+	{
+		bitmap_cache_load_persistent_entry(cache->bitmap, (BYTE)mem3blt->cacheId,
+		                                   mem3blt->cacheIndex);
 		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)mem3blt->cacheId, mem3blt->cacheIndex);
+	}
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (!bitmap)
@@ -167,6 +179,9 @@ static BOOL update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDE
 		return FALSE;
 	}
 
+	if (cacheBitmapV2->flags & CBR2_PERSISTENT_KEY_PRESENT)
+		bitmap->key64 = ((UINT64)cacheBitmapV2->key2 << 32) | cacheBitmapV2->key1;
+
 	Bitmap_Free(context, prevBitmap);
 	return bitmap_cache_put(cache->bitmap, cacheBitmapV2->cacheId, cacheBitmapV2->cacheIndex,
 	                        bitmap);
@@ -254,9 +269,233 @@ BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpB
 	}
 
 	bitmapCache->cells[id].entries[index] = bitmap;
+
+	/* the server replaced the entry it knew from the persistent key list */
+	if (index < bitmapCache->cells[id].persistentCount)
+	{
+		PERSISTENT_CACHE_ENTRY* entry = &bitmapCache->cells[id].persistent[index];
+		free(entry->data);
+		entry->data = NULL;
+	}
+
 	return TRUE;
 }
 
+/**
+ * Creates the bitmap of a persistent cache entry the first time the server draws it, the
+ * graphics are not registered yet when the cache is loaded.
+ */
+static void bitmap_cache_load_persistent_entry(rdpBitmapCache* bitmapCache, UINT32 id,
+                                               UINT32 index)
+{
+	rdpBitmap* bitmap;
+	BITMAP_V2_CELL* cell;
+	PERSISTENT_CACHE_ENTRY* entry;
+	rdpContext* context = bitmapCache->context;
+
+	if (id >= bitmapCache->maxCells)
+		return;
+
+	cell = &bitmapCache->cells[id];
+
+	if ((index >= cell->persistentCount) || !cell->persistent[index].data || cell->entries[index])
+		return;
+
+	entry = &cell->persistent[index];
+	bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return;
+
+	Bitmap_SetDimensions(bitmap, entry->width, entry->height);
+
+	if (!bitmap->Decompress(context, bitmap, entry->data, entry->width, entry->height, 32,
+	                        entry->size, FALSE, RDP_CODEC_ID_NONE) ||
+	    !bitmap->New(context, bitmap))
+	{
+		WLog_WARN(TAG, "failed to restore persistent bitmap %" PRIu32 " in cell id: %" PRIu32 "",
+		          index, id);
+		Bitmap_Free(context, bitmap);
+		bitmap = NULL;
+	}
+	else
+		bitmap->key64 = entry->key64;
+
+	cell->entries[index] = bitmap;
+	free(entry->data);
+	entry->data = NULL;
+}
+
+static BOOL bitmap_cache_persist_enabled(const rdpSettings* settings)
+{
+	return freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled) &&
+	       freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
+}
+
+/**
+ * Loads the persistent cache file. The entries of each cell are numbered in file order, which is
+ * the order the keys are sent in the persistent key list PDU.
+ */
+static void bitmap_cache_load_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 count;
+	rdpPersistentCache* persistent;
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	const char* filename =
+	    freerdp_settings_get_string(bitmapCache->context->settings, FreeRDP_BitmapCachePersistFile);
+
+	if (!(persistent = persistent_cache_new()))
+		return;
+
+	if (!persistent_cache_open(persistent, filename, FALSE))
+	{
+		WLog_DBG(TAG, "no persistent bitmap cache in %s", filename);
+		goto out;
+	}
+
+	for (count = 0; persistent_cache_read_entry(persistent, &entry); count++)
+	{
+		BITMAP_V2_CELL* cell;
+		PERSISTENT_CACHE_ENTRY* copy;
+
+		if (entry.cacheId >= bitmapCache->maxCells)
+			continue;
+
+		cell = &bitmapCache->cells[entry.cacheId];
+
+		if (!cell->persistent || (cell->persistentCount >= cell->number))
+			continue;
+
+		copy = &cell->persistent[cell->persistentCount];
+		*copy = entry;
+		copy->data = malloc(entry.size);
+
+		if (!copy->data)
+			break;
+
+		CopyMemory(copy->data, entry.data, entry.size);
+		cell->persistentCount++;
+	}
+
+	WLog_DBG(TAG, "read %" PRIu32 " persistent bitmaps from %s", count, filename);
+out:
+	persistent_cache_free(persistent);
+}
+
+static BOOL bitmap_cache_save_bitmap(rdpPersistentCache* persistent, UINT32 id,
+                                     const rdpBitmap* bitmap, BYTE** buffer, size_t* size)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	if (!bitmap->key64 || !bitmap->data || (GetBytesPerPixel(bitmap->format) == 0) ||
+	    (bitmap->width > UINT16_MAX) || (bitmap->height > UINT16_MAX))
+		return TRUE;
+
+	entry.key64 = bitmap->key64;
+	entry.cacheId = (UINT16)id;
+	entry.width = (UINT16)bitmap->width;
+	entry.height = (UINT16)bitmap->height;
+	entry.size = 4UL * entry.width * entry.height;
+
+	if (*size < entry.size)
+	{
+		BYTE* tmp = (BYTE*)realloc(*buffer, entry.size);
+
+		if (!tmp)
+			return FALSE;
+
+		*buffer = tmp;
+		*size = entry.size;
+	}
+
+	/* stored like an uncompressed 32 bpp bitmap, the way it is restored */
+	if (!freerdp_image_copy(*buffer, PIXEL_FORMAT_BGRA32, 0, 0, 0, entry.width, entry.height,
+	                        bitmap->data, bitmap->format, 0, 0, 0, NULL, FREERDP_FLIP_VERTICAL))
+		return FALSE;
+
+	entry.data = *buffer;
+	return persistent_cache_write_entry(persistent, &entry);
+}
+
+/**
+ * Writes the keyed bitmaps of all cells and the persistent entries the server did not use in
+ * this session. Nothing is written if no bitmap has a key, the cache file may hold the entries of
+ * a graphics pipeline session.
+ */
+static void bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 i, j;
+	BOOL found = FALSE;
+	BYTE* buffer = NULL;
+	size_t size = 0;
+	rdpPersistentCache* persistent = NULL;
+	const char* filename =
+	    freerdp_settings_get_string(bitmapCache->context->settings, FreeRDP_BitmapCachePersistFile);
+
+	for (i = 0; !found && (i < bitmapCache->maxCells); i++)
+	{
+		const BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+
+		for (j = 0; !found && cell->entries && (j < cell->number); j++)
+			found = (cell->entries[j] && cell->entries[j]->key64) ||
+			        ((j < cell->persistentCount) && cell->persistent[j].data);
+	}
+
+	if (!found)
+		return;
+
+	if (!(persistent = persistent_cache_new()) ||
+	    !persistent_cache_open(persistent, filename, TRUE))
+		goto fail;
+
+	for (i = 0; i < bitmapCache->maxCells; i++)
+	{
+		const BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+
+		for (j = 0; cell->entries && (j < cell->number); j++)
+		{
+			if ((j < cell->persistentCount) && cell->persistent[j].data)
+			{
+				if (!persistent_cache_write_entry(persistent, &cell->persistent[j]))
+					goto fail;
+			}
+			else if (cell->entries[j])
+			{
+				if (!bitmap_cache_save_bitmap(persistent, i, cell->entries[j], &buffer, &size))
+					goto fail;
+			}
+		}
+	}
+
+	if (!persistent_cache_close(persistent))
+		goto fail;
+
+	WLog_DBG(TAG, "saved persistent bitmap cache to %s", filename);
+	persistent_cache_free(persistent);
+	free(buffer);
+	return;
+fail:
+	WLog_WARN(TAG, "failed to save the persistent bitmap cache to %s", filename);
+	persistent_cache_free(persistent);
+	free(buffer);
+}
+
+UINT32 bitmap_cache_get_persistent_count(const rdpBitmapCache* bitmapCache, UINT32 id)
+{
+	if (!bitmapCache || (id >= bitmapCache->maxCells))
+		return 0;
+
+	return bitmapCache->cells[id].persistentCount;
+}
+
+UINT64 bitmap_cache_get_persistent_key(const rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index)
+{
+	if (index >= bitmap_cache_get_persistent_count(bitmapCache, id))
+		return 0;
+
+	return bitmapCache->cells[id].persistent[index].key64;
+}
+
 void bitmap_cache_register_callbacks(rdpUpdate* update)
 {
 	rdpCache* cache;
@@ -315,8 +554,19 @@ rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 		if (!cell->entries)
 			goto fail;
 		cell->number = nr;
+
+		if (bitmap_cache_persist_enabled(settings) && (nr > 0))
+		{
+			cell->persistent = (PERSISTENT_CACHE_ENTRY*)calloc(nr, sizeof(PERSISTENT_CACHE_ENTRY));
+
+			if (!cell->persistent)
+				goto fail;
+		}
 	}
 
+	if (bitmap_cache_persist_enabled(settings))
+		bitmap_cache_load_persistent(bitmapCache);
+
 	return bitmapCache;
 fail:
 
@@ -329,10 +579,20 @@ void bitmap_cache_free(rdpBitmapCache* bitmapCache)
 	if (bitmapCache)
 	{
 		UINT32 i;
+
+		if (bitmapCache->cells && bitmap_cache_persist_enabled(bitmapCache->context->settings))
+			bitmap_cache_save_persistent(bitmapCache);
+
 		for (i = 0; i < bitmapCache->maxCells; i++)
 		{
 			UINT32 j;
 			BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+
+			for (j = 0; j < cell->persistentCount; j++)
+				free(cell->persistent[j].data);
+
+			free(cell->persistent);
+
 			if (!cell->entries)
 				continue;
 			for (j = 0; j < cell->number + 1; j++)
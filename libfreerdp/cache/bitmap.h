@@ -22,6 +22,12 @@
 
 #include <freerdp/api.h>
 #include <freerdp/update.h>
+#include <freerdp/cache/bitmap.h>
+
+FREERDP_LOCAL UINT32 bitmap_cache_get_persistent_count(const rdpBitmapCache* bitmapCache,
+                                                      UINT32 id);
+FREERDP_LOCAL UINT64 bitmap_cache_get_persistent_key(const rdpBitmapCache* bitmapCache, UINT32 id,
+                                                     UINT32 index);
 
 FREERDP_LOCAL BITMAP_UPDATE* copy_bitmap_update(rdpContext* context, const BITMAP_UPDATE* pointer);
 FREERDP_LOCAL void free_bitmap_update(rdpContext* context, BITMAP_UPDATE* pointer);
@@ -35,6 +35,15 @@
 
 #define TAG FREERDP_TAG("cache.glyph")
 
+#define GLYPH_RUN_MAX_ENTRIES 128
+
+typedef struct
+{
+	const rdpGlyph* prototype;
+	size_t count;
+	GLYPH_RUN_ENTRY entries[GLYPH_RUN_MAX_ENTRIES];
+} GLYPH_RUN;
+
 static rdpGlyph* glyph_cache_get(rdpGlyphCache* glyph_cache, UINT32 id, UINT32 index);
 static BOOL glyph_cache_put(rdpGlyphCache* glyph_cache, UINT32 id, UINT32 index, rdpGlyph* entry);
 
@@ -72,9 +81,20 @@ static UINT32 update_glyph_offset(const BYTE* data, size_t length, UINT32 index,
 	return index;
 }
 
+static BOOL update_flush_glyph_run(rdpContext* context, GLYPH_RUN* run, BOOL fOpRedundant)
+{
+	const size_t count = run->count;
+
+	if (count == 0)
+		return TRUE;
+
+	run->count = 0;
+	return run->prototype->DrawRun(context, run->entries, count, fOpRedundant);
+}
+
 static BOOL update_process_glyph(rdpContext* context, const BYTE* data, UINT32 cacheIndex, INT32* x,
                                  INT32* y, UINT32 cacheId, UINT32 flAccel, BOOL fOpRedundant,
-                                 const RDP_RECT* bound)
+                                 const RDP_RECT* bound, GLYPH_RUN* run)
 {
 	INT32 sx = 0, sy = 0;
 	INT32 dx, dy;
@@ -119,7 +139,24 @@ static BOOL update_process_glyph(rdpContext* context, const BYTE* data, UINT32 c
 
 		if ((dh > 0) && (dw > 0))
 		{
-			if (!glyph->Draw(context, glyph, dx, dy, dw, dh, sx, sy, fOpRedundant))
+			if (run)
+			{
+				GLYPH_RUN_ENTRY* entry;
+
+				if ((run->count == GLYPH_RUN_MAX_ENTRIES) &&
+				    !update_flush_glyph_run(context, run, fOpRedundant))
+					return FALSE;
+
+				entry = &run->entries[run->count++];
+				entry->glyph = glyph;
+				entry->x = dx;
+				entry->y = dy;
+				entry->w = dw;
+				entry->h = dh;
+				entry->sx = sx;
+				entry->sy = sy;
+			}
+			else if (!glyph->Draw(context, glyph, dx, dy, dw, dh, sx, sy, fOpRedundant))
 				return FALSE;
 		}
 	}
@@ -146,6 +183,8 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 	rdpGlyphCache* glyph_cache;
 	rdpGlyph* glyph;
 	RDP_RECT bound;
+	GLYPH_RUN run;
+	GLYPH_RUN* prun = NULL;
 
 	if (!context || !data || !context->graphics || !context->cache || !context->cache->glyph)
 		return FALSE;
@@ -157,6 +196,14 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 	if (!glyph)
 		return FALSE;
 
+	/* collect the visible glyphs and draw them at once if supported */
+	if (glyph->DrawRun)
+	{
+		run.prototype = glyph;
+		run.count = 0;
+		prun = &run;
+	}
+
 	/* Limit op rectangle to visible screen. */
 	if (opX < 0)
 	{
@@ -256,7 +303,7 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 					n = update_glyph_offset(fragments, size, n, &x, &y, ulCharInc, flAccel);
 
 					if (!update_process_glyph(context, fragments, fop, &x, &y, cacheId, flAccel,
-					                          fOpRedundant, &bound))
+					                          fOpRedundant, &bound, prun))
 						return FALSE;
 				}
 
@@ -275,13 +322,16 @@ static BOOL update_process_glyph_fragments(rdpContext* context, const BYTE* data
 				index = update_glyph_offset(data, length, index, &x, &y, ulCharInc, flAccel);
 
 				if (!update_process_glyph(context, data, op, &x, &y, cacheId, flAccel, fOpRedundant,
-				                          &bound))
+				                          &bound, prun))
 					return FALSE;
 
 				break;
 		}
 	}
 
+	if (prun && !update_flush_glyph_run(context, prun, fOpRedundant))
+		return FALSE;
+
 	return glyph->EndDraw(context, opX, opY, opWidth, opHeight, bgcolor, fgcolor);
 }
 
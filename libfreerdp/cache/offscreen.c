@@ -28,61 +28,131 @@
 #include <freerdp/log.h>
 #include <freerdp/cache/offscreen.h>
 #include <freerdp/cache/cache.h>
+#include <freerdp/gdi/gdi.h>
 
 #include "../core/graphics.h"
 
 #define TAG FREERDP_TAG("cache.offscreen")
 
+/* [MS-RDPBCGR] 2.2.7.1.9 offscreenCacheSize is limited to 7680 KB */
+#define OFFSCREEN_CACHE_MAX_SIZE 7680
+#define OFFSCREEN_CACHE_MAX_ENTRIES 2000
+
+typedef struct
+{
+	rdpBitmap* bitmap;
+	size_t size;    /* bytes of the bitmap in the client pixel format */
+	UINT64 lastUse; /* value of useCounter when the bitmap was last referenced */
+	UINT16 width;   /* dimensions, kept to recreate an evicted bitmap */
+	UINT16 height;
+	BOOL evicted;
+} OFFSCREEN_CACHE_ENTRY;
+
 struct rdp_offscreen_cache
 {
-	UINT32 maxSize;        /* 0 */
-	UINT32 maxEntries;     /* 1 */
-	rdpBitmap** entries;   /* 2 */
-	UINT32 currentSurface; /* 3 */
+	UINT32 maxSize;                 /* 0 */
+	UINT32 maxEntries;              /* 1 */
+	OFFSCREEN_CACHE_ENTRY* entries; /* 2 */
+	UINT32 currentSurface;          /* 3 */
 
 	rdpContext* context;
+	size_t bytes; /* sum of the entry sizes */
+	UINT64 useCounter;
 };
 
-static void offscreen_cache_put(rdpOffscreenCache* offscreen_cache, UINT32 index,
-                                rdpBitmap* bitmap);
+static BOOL offscreen_cache_put(rdpOffscreenCache* offscreen_cache, UINT32 index, UINT16 width,
+                                UINT16 height);
 static void offscreen_cache_delete(rdpOffscreenCache* offscreen, UINT32 index);
 
+static size_t offscreen_cache_bitmap_size(rdpOffscreenCache* offscreenCache, UINT16 width,
+                                          UINT16 height)
+{
+	const rdpGdi* gdi = offscreenCache->context->gdi;
+	const size_t bpp = gdi ? GetBytesPerPixel(gdi->dstFormat) : 4;
+	return 1ull * width * height * bpp;
+}
+
+/**
+ * The server accounts the advertised cache size in the session color depth, the client stores
+ * the bitmaps in its own pixel format. Scale the budget accordingly, a server that respects the
+ * capability never exceeds it.
+ */
+static size_t offscreen_cache_budget(rdpOffscreenCache* offscreenCache)
+{
+	const rdpGdi* gdi = offscreenCache->context->gdi;
+	const rdpSettings* settings = offscreenCache->context->settings;
+	const size_t clientBpp = gdi ? GetBytesPerPixel(gdi->dstFormat) : 4;
+	const UINT32 depth = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
+	const size_t sessionBpp = MAX(1, (depth + 7) / 8);
+	return 1024ull * offscreenCache->maxSize * clientBpp / sessionBpp;
+}
+
+/* Evicts the least recently used bitmaps until size more bytes fit into the budget */
+static void offscreen_cache_make_room(rdpOffscreenCache* offscreenCache, size_t size)
+{
+	const size_t budget = offscreen_cache_budget(offscreenCache);
+
+	while (offscreenCache->bytes + size > budget)
+	{
+		UINT32 x;
+		OFFSCREEN_CACHE_ENTRY* lru = NULL;
+
+		for (x = 0; x < offscreenCache->maxEntries; x++)
+		{
+			OFFSCREEN_CACHE_ENTRY* entry = &offscreenCache->entries[x];
+
+			if (!entry->bitmap || (x == offscreenCache->currentSurface))
+				continue;
+
+			if (!lru || (entry->lastUse < lru->lastUse))
+				lru = entry;
+		}
+
+		if (!lru)
+			return;
+
+		WLog_WARN(TAG,
+		          "server exceeds the offscreen cache size of %" PRIu32
+		          " KB, evicting bitmap 0x%04" PRIX32 "",
+		          offscreenCache->maxSize, (UINT32)(lru - offscreenCache->entries));
+		Bitmap_Free(offscreenCache->context, lru->bitmap);
+		offscreenCache->bytes -= lru->size;
+		lru->bitmap = NULL;
+		lru->size = 0;
+		lru->evicted = TRUE;
+	}
+}
+
 static BOOL
 update_gdi_create_offscreen_bitmap(rdpContext* context,
                                    const CREATE_OFFSCREEN_BITMAP_ORDER* createOffscreenBitmap)
 {
 	UINT32 i;
 	UINT16 index;
-	rdpBitmap* bitmap;
 	rdpCache* cache;
 
 	if (!context || !createOffscreenBitmap || !context->cache)
 		return FALSE;
 
 	cache = context->cache;
-	bitmap = Bitmap_Alloc(context);
-
-	if (!bitmap)
-		return FALSE;
 
-	Bitmap_SetDimensions(bitmap, createOffscreenBitmap->cx, createOffscreenBitmap->cy);
+	/* release the deleted bitmaps before the new one is allocated */
+	offscreen_cache_delete(cache->offscreen, createOffscreenBitmap->id);
 
-	if (!bitmap->New(context, bitmap))
+	for (i = 0; i < createOffscreenBitmap->deleteList.cIndices; i++)
 	{
-		Bitmap_Free(context, bitmap);
-		return FALSE;
+		index = createOffscreenBitmap->deleteList.indices[i];
+		offscreen_cache_delete(cache->offscreen, index);
 	}
 
-	offscreen_cache_delete(cache->offscreen, createOffscreenBitmap->id);
-	offscreen_cache_put(cache->offscreen, createOffscreenBitmap->id, bitmap);
+	if (!offscreen_cache_put(cache->offscreen, createOffscreenBitmap->id,
+	                         createOffscreenBitmap->cx, createOffscreenBitmap->cy))
+		return FALSE;
 
 	if (cache->offscreen->currentSurface == createOffscreenBitmap->id)
-		bitmap->SetSurface(context, bitmap, FALSE);
-
-	for (i = 0; i < createOffscreenBitmap->deleteList.cIndices; i++)
 	{
-		index = createOffscreenBitmap->deleteList.indices[i];
-		offscreen_cache_delete(cache->offscreen, index);
+		rdpBitmap* bitmap = cache->offscreen->entries[createOffscreenBitmap->id].bitmap;
+		bitmap->SetSurface(context, bitmap, FALSE);
 	}
 
 	return TRUE;
@@ -122,7 +192,7 @@ static BOOL update_gdi_switch_surface(rdpContext* context,
 
 rdpBitmap* offscreen_cache_get(rdpOffscreenCache* offscreenCache, UINT32 index)
 {
-	rdpBitmap* bitmap;
+	OFFSCREEN_CACHE_ENTRY* entry;
 
 	WINPR_ASSERT(offscreenCache);
 
@@ -132,34 +202,74 @@ rdpBitmap* offscreen_cache_get(rdpOffscreenCache* offscreenCache, UINT32 index)
 		return NULL;
 	}
 
-	bitmap = offscreenCache->entries[index];
+	entry = &offscreenCache->entries[index];
 
-	if (!bitmap)
+	/* the contents are lost, the server repaints what it still needs */
+	if (entry->evicted)
+	{
+		WLog_WARN(TAG, "recreating evicted offscreen bitmap 0x%04" PRIX32 "", index);
+
+		if (!offscreen_cache_put(offscreenCache, index, entry->width, entry->height))
+			return NULL;
+	}
+
+	if (!entry->bitmap)
 	{
 		WLog_ERR(TAG, "invalid offscreen bitmap at index: 0x%08" PRIX32 "", index);
 		return NULL;
 	}
 
-	return bitmap;
+	entry->lastUse = ++offscreenCache->useCounter;
+	return entry->bitmap;
 }
 
-void offscreen_cache_put(rdpOffscreenCache* offscreenCache, UINT32 index, rdpBitmap* bitmap)
+BOOL offscreen_cache_put(rdpOffscreenCache* offscreenCache, UINT32 index, UINT16 width,
+                         UINT16 height)
 {
+	size_t size;
+	rdpBitmap* bitmap;
+	OFFSCREEN_CACHE_ENTRY* entry;
+	rdpContext* context;
+
 	WINPR_ASSERT(offscreenCache);
+	context = offscreenCache->context;
 
 	if (index >= offscreenCache->maxEntries)
 	{
 		WLog_ERR(TAG, "invalid offscreen bitmap index: 0x%08" PRIX32 "", index);
-		return;
+		return FALSE;
 	}
 
 	offscreen_cache_delete(offscreenCache, index);
-	offscreenCache->entries[index] = bitmap;
+	size = offscreen_cache_bitmap_size(offscreenCache, width, height);
+	offscreen_cache_make_room(offscreenCache, size);
+
+	bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return FALSE;
+
+	Bitmap_SetDimensions(bitmap, width, height);
+
+	if (!bitmap->New(context, bitmap))
+	{
+		Bitmap_Free(context, bitmap);
+		return FALSE;
+	}
+
+	entry = &offscreenCache->entries[index];
+	entry->bitmap = bitmap;
+	entry->size = size;
+	entry->width = width;
+	entry->height = height;
+	entry->lastUse = ++offscreenCache->useCounter;
+	offscreenCache->bytes += size;
+	return TRUE;
 }
 
 void offscreen_cache_delete(rdpOffscreenCache* offscreenCache, UINT32 index)
 {
-	rdpBitmap* prevBitmap;
+	OFFSCREEN_CACHE_ENTRY* entry;
 
 	WINPR_ASSERT(offscreenCache);
 
@@ -169,12 +279,15 @@ void offscreen_cache_delete(rdpOffscreenCache* offscreenCache, UINT32 index)
 		return;
 	}
 
-	prevBitmap = offscreenCache->entries[index];
+	entry = &offscreenCache->entries[index];
 
-	if (prevBitmap != NULL)
-		Bitmap_Free(offscreenCache->context, prevBitmap);
+	if (entry->bitmap != NULL)
+		Bitmap_Free(offscreenCache->context, entry->bitmap);
 
-	offscreenCache->entries[index] = NULL;
+	offscreenCache->bytes -= entry->size;
+	entry->bitmap = NULL;
+	entry->size = 0;
+	entry->evicted = FALSE;
 }
 
 void offscreen_cache_register_callbacks(rdpUpdate* update)
@@ -201,13 +314,23 @@ rdpOffscreenCache* offscreen_cache_new(rdpContext* context)
 	if (!offscreenCache)
 		return NULL;
 
+	/* a smaller configured cache is advertised to the server and bounds the memory used */
 	offscreenCache->context = context;
 	offscreenCache->currentSurface = SCREEN_BITMAP_SURFACE;
-	offscreenCache->maxSize = 7680;
-	offscreenCache->maxEntries = 2000;
+	offscreenCache->maxSize = settings->OffscreenCacheSize;
+	offscreenCache->maxEntries = settings->OffscreenCacheEntries;
+
+	if ((offscreenCache->maxSize == 0) || (offscreenCache->maxSize > OFFSCREEN_CACHE_MAX_SIZE))
+		offscreenCache->maxSize = OFFSCREEN_CACHE_MAX_SIZE;
+
+	if ((offscreenCache->maxEntries == 0) ||
+	    (offscreenCache->maxEntries > OFFSCREEN_CACHE_MAX_ENTRIES))
+		offscreenCache->maxEntries = OFFSCREEN_CACHE_MAX_ENTRIES;
+
 	settings->OffscreenCacheSize = offscreenCache->maxSize;
 	settings->OffscreenCacheEntries = offscreenCache->maxEntries;
-	offscreenCache->entries = (rdpBitmap**)calloc(offscreenCache->maxEntries, sizeof(rdpBitmap*));
+	offscreenCache->entries = (OFFSCREEN_CACHE_ENTRY*)calloc(offscreenCache->maxEntries,
+	                                                         sizeof(OFFSCREEN_CACHE_ENTRY));
 
 	if (!offscreenCache->entries)
 	{
@@ -221,15 +344,11 @@ rdpOffscreenCache* offscreen_cache_new(rdpContext* context)
 void offscreen_cache_free(rdpOffscreenCache* offscreenCache)
 {
 	size_t i;
-	rdpBitmap* bitmap;
 
 	if (offscreenCache)
 	{
 		for (i = 0; i < offscreenCache->maxEntries; i++)
-		{
-			bitmap = offscreenCache->entries[i];
-			Bitmap_Free(offscreenCache->context, bitmap);
-		}
+			Bitmap_Free(offscreenCache->context, offscreenCache->entries[i].bitmap);
 
 		free(offscreenCache->entries);
 		free(offscreenCache);
@@ -0,0 +1,302 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/file.h>
+#include <winpr/stream.h>
+
+#include <freerdp/log.h>
+#include <freerdp/cache/persistent.h>
+
+#define TAG FREERDP_TAG("cache.persistent")
+
+/**
+ * The cache file starts with a 16 byte header followed by the entries:
+ *
+ * header: signature (8 bytes) "FRDPBMC\0", version (4 bytes), entry count (4 bytes)
+ * entry:  key64 (8 bytes), cacheId (2 bytes), width (2 bytes), height (2 bytes),
+ *         reserved (2 bytes), followed by width * height 32 bpp pixels
+ *
+ * New content is written to a temporary file that replaces the cache file when it is closed,
+ * an interrupted write leaves the previous cache intact.
+ */
+
+#define PERSISTENT_CACHE_SIGNATURE "FRDPBMC"
+#define PERSISTENT_CACHE_VERSION 1
+#define PERSISTENT_CACHE_HEADER_LENGTH 16
+#define PERSISTENT_CACHE_ENTRY_HEADER_LENGTH 16
+#define PERSISTENT_CACHE_MAX_DIMENSION 4096
+
+struct rdp_persistent_cache
+{
+	FILE* fp;
+	BOOL write;
+	char* filename;
+	char* tmpFilename;
+	UINT32 count;
+	BYTE* data;
+	size_t dataSize;
+};
+
+static BOOL persistent_cache_read_header(rdpPersistentCache* persistent)
+{
+	UINT32 version;
+	BYTE buffer[PERSISTENT_CACHE_HEADER_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, sizeof(buffer));
+
+	if (fread(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	if (memcmp(buffer, PERSISTENT_CACHE_SIGNATURE, sizeof(PERSISTENT_CACHE_SIGNATURE)) != 0)
+	{
+		WLog_WARN(TAG, "%s is not a bitmap cache file", persistent->filename);
+		return FALSE;
+	}
+
+	Stream_Seek(s, 8);
+	Stream_Read_UINT32(s, version);
+	Stream_Read_UINT32(s, persistent->count);
+
+	if (version != PERSISTENT_CACHE_VERSION)
+	{
+		WLog_WARN(TAG, "unsupported bitmap cache file version %" PRIu32, version);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL persistent_cache_write_header(rdpPersistentCache* persistent)
+{
+	BYTE buffer[PERSISTENT_CACHE_HEADER_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+
+	Stream_Write(s, PERSISTENT_CACHE_SIGNATURE, sizeof(PERSISTENT_CACHE_SIGNATURE));
+	Stream_Write_UINT32(s, PERSISTENT_CACHE_VERSION);
+	Stream_Write_UINT32(s, persistent->count);
+
+	if (_fseeki64(persistent->fp, 0, SEEK_SET) != 0)
+		return FALSE;
+
+	return fwrite(buffer, sizeof(buffer), 1, persistent->fp) == 1;
+}
+
+BOOL persistent_cache_open(rdpPersistentCache* persistent, const char* filename, BOOL write)
+{
+	size_t length;
+
+	WINPR_ASSERT(persistent);
+	WINPR_ASSERT(filename);
+
+	persistent_cache_close(persistent);
+
+	persistent->write = write;
+	persistent->filename = _strdup(filename);
+
+	if (!persistent->filename)
+		goto fail;
+
+	if (!write)
+	{
+		persistent->fp = winpr_fopen(filename, "rb");
+
+		if (!persistent->fp)
+			goto fail;
+
+		if (!persistent_cache_read_header(persistent))
+			goto fail;
+
+		return TRUE;
+	}
+
+	length = strlen(filename) + 5;
+	persistent->tmpFilename = (char*)calloc(length, sizeof(char));
+
+	if (!persistent->tmpFilename)
+		goto fail;
+
+	sprintf_s(persistent->tmpFilename, length, "%s.tmp", filename);
+	persistent->fp = winpr_fopen(persistent->tmpFilename, "w+b");
+
+	if (!persistent->fp)
+	{
+		WLog_WARN(TAG, "failed to create bitmap cache file %s", persistent->tmpFilename);
+		goto fail;
+	}
+
+	if (!persistent_cache_write_header(persistent))
+		goto fail;
+
+	return TRUE;
+fail:
+	persistent->write = FALSE;
+	persistent_cache_close(persistent);
+	return FALSE;
+}
+
+BOOL persistent_cache_close(rdpPersistentCache* persistent)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(persistent);
+
+	if (persistent->fp)
+	{
+		if (persistent->write)
+			rc = persistent_cache_write_header(persistent);
+
+		if (fclose(persistent->fp) != 0)
+			rc = FALSE;
+
+		if (persistent->write)
+		{
+			if (rc && !MoveFileExA(persistent->tmpFilename, persistent->filename,
+			                       MOVEFILE_REPLACE_EXISTING))
+			{
+				WLog_WARN(TAG, "failed to replace bitmap cache file %s", persistent->filename);
+				rc = FALSE;
+			}
+
+			if (!rc)
+				DeleteFileA(persistent->tmpFilename);
+		}
+	}
+
+	free(persistent->filename);
+	free(persistent->tmpFilename);
+	persistent->fp = NULL;
+	persistent->write = FALSE;
+	persistent->filename = NULL;
+	persistent->tmpFilename = NULL;
+	persistent->count = 0;
+	return rc;
+}
+
+UINT32 persistent_cache_get_count(const rdpPersistentCache* persistent)
+{
+	WINPR_ASSERT(persistent);
+	return persistent->count;
+}
+
+/**
+ * Reads the next entry, entry->data stays valid until the next call.
+ *
+ * @return FALSE at the end of the file or if it is truncated or corrupt
+ */
+BOOL persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE_ENTRY* entry)
+{
+	BYTE buffer[PERSISTENT_CACHE_ENTRY_HEADER_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, sizeof(buffer));
+
+	WINPR_ASSERT(persistent);
+	WINPR_ASSERT(entry);
+
+	if (!persistent->fp || persistent->write)
+		return FALSE;
+
+	if (fread(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	Stream_Read_UINT64(s, entry->key64);
+	Stream_Read_UINT16(s, entry->cacheId);
+	Stream_Read_UINT16(s, entry->width);
+	Stream_Read_UINT16(s, entry->height);
+
+	if ((entry->width == 0) || (entry->height == 0) ||
+	    (entry->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->height > PERSISTENT_CACHE_MAX_DIMENSION))
+	{
+		WLog_WARN(TAG, "invalid bitmap cache entry %" PRIu16 "x%" PRIu16, entry->width,
+		          entry->height);
+		return FALSE;
+	}
+
+	entry->size = 4UL * entry->width * entry->height;
+
+	if (persistent->dataSize < entry->size)
+	{
+		BYTE* data = (BYTE*)realloc(persistent->data, entry->size);
+
+		if (!data)
+			return FALSE;
+
+		persistent->data = data;
+		persistent->dataSize = entry->size;
+	}
+
+	if (fread(persistent->data, entry->size, 1, persistent->fp) != 1)
+		return FALSE;
+
+	entry->data = persistent->data;
+	return TRUE;
+}
+
+BOOL persistent_cache_write_entry(rdpPersistentCache* persistent,
+                                  const PERSISTENT_CACHE_ENTRY* entry)
+{
+	BYTE buffer[PERSISTENT_CACHE_ENTRY_HEADER_LENGTH] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+
+	WINPR_ASSERT(persistent);
+	WINPR_ASSERT(entry);
+
+	if (!persistent->fp || !persistent->write || !entry->data)
+		return FALSE;
+
+	if ((entry->width == 0) || (entry->height == 0) ||
+	    (entry->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->height > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->size != 4UL * entry->width * entry->height))
+		return FALSE;
+
+	Stream_Write_UINT64(s, entry->key64);
+	Stream_Write_UINT16(s, entry->cacheId);
+	Stream_Write_UINT16(s, entry->width);
+	Stream_Write_UINT16(s, entry->height);
+	Stream_Write_UINT16(s, 0); /* reserved */
+
+	if ((fwrite(buffer, sizeof(buffer), 1, persistent->fp) != 1) ||
+	    (fwrite(entry->data, entry->size, 1, persistent->fp) != 1))
+		return FALSE;
+
+	persistent->count++;
+	return TRUE;
+}
+
+rdpPersistentCache* persistent_cache_new(void)
+{
+	return (rdpPersistentCache*)calloc(1, sizeof(rdpPersistentCache));
+}
+
+void persistent_cache_free(rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return;
+
+	persistent_cache_close(persistent);
+	free(persistent->data);
+	free(persistent);
+}
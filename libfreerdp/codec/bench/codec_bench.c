@@ -0,0 +1,1567 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Replays a corpus of surface frames through the encoders and decoders of libfreerdp-codec.
+ *
+ * A corpus is a stream dump file (see stream_dump_write_line), every record holds one frame:
+ *
+ * UINT32 magic ('FCB1'), UINT32 width, UINT32 height, UINT32 scanline,
+ * UINT16 number of dirty rectangles, RECTANGLE_16 rectangles[],
+ * height * scanline bytes of PIXEL_FORMAT_BGRX32 pixels
+ *
+ * All frames of a corpus share the same size, a frame without rectangles is fully dirty.
+ * Without a corpus a synthetic desktop session is generated, --generate stores it and
+ * --import builds a corpus from still images.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/image.h>
+#include <winpr/stream.h>
+#include <winpr/string.h>
+
+#include <freerdp/streamdump.h>
+#include <freerdp/utils/stopwatch.h>
+#include <freerdp/codec/clear.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/interleaved.h>
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/progressive.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/codec/rfx.h>
+#include <freerdp/codec/zgfx.h>
+
+#define BENCH_CORPUS_MAGIC 0x31424346 /* FCB1 */
+#define BENCH_FORMAT PIXEL_FORMAT_BGRX32
+#define BENCH_TILE_SIZE 64
+
+/* Count heap allocations by interposing malloc, only possible with glibc and no sanitizer */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+#define BENCH_NO_ALLOC_COUNT
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(BENCH_NO_ALLOC_COUNT)
+#define BENCH_ALLOC_COUNT
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static UINT64 bench_allocations = 0;
+
+void* malloc(size_t size)
+{
+	__atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	__atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	__atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+static UINT64 bench_get_allocations(void)
+{
+	return __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+}
+#else
+static UINT64 bench_get_allocations(void)
+{
+	return 0;
+}
+#endif
+
+/* Grows only, so that packing the input does not show up in the allocation counts */
+static BYTE* bench_scratch_buffer = NULL;
+static size_t bench_scratch_size = 0;
+
+static BYTE* bench_scratch(size_t size)
+{
+	if (size > bench_scratch_size)
+	{
+		BYTE* buffer = realloc(bench_scratch_buffer, size);
+
+		if (!buffer)
+			return NULL;
+
+		bench_scratch_buffer = buffer;
+		bench_scratch_size = size;
+	}
+
+	return bench_scratch_buffer;
+}
+
+typedef struct
+{
+	UINT64 pts;
+	UINT32 width;
+	UINT32 height;
+	UINT32 scanline;
+	BYTE* data;
+	UINT32 numRects;
+	RECTANGLE_16* rects;
+} BENCH_FRAME;
+
+typedef struct
+{
+	const char* name;
+	UINT32 width;
+	UINT32 height;
+	size_t count;
+	BENCH_FRAME* frames;
+} BENCH_CORPUS;
+
+/**
+ * encode appends the encoded rectangles to s and returns 1, 0 if the codec can not handle
+ * them (the rectangles are skipped) or -1 on failure. The tiled codecs are called once per
+ * 64x64 tile of the dirty rectangles, the others once per frame.
+ * maxError is the largest channel difference the codec may produce, -1 for lossy codecs.
+ */
+typedef struct
+{
+	const char* name;
+	INT32 maxError;
+	BOOL tiled;
+	void* (*context_new)(BOOL compressor, UINT32 width, UINT32 height);
+	void (*context_free)(void* context);
+	int (*encode)(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+	              UINT32 numRects, wStream* s);
+	BOOL (*decode)(void* context, const BYTE* data, size_t size, const RECTANGLE_16* rects,
+	               UINT32 numRects, BYTE* dst, UINT32 stride, UINT32 width, UINT32 height);
+} BENCH_CODEC;
+
+typedef struct
+{
+	size_t frames;
+	UINT64 pixels;
+	UINT64 skippedPixels;
+	UINT64 rawBytes;
+	UINT64 compressedBytes;
+	UINT64 encodeAllocations;
+	UINT64 decodeAllocations;
+	UINT64* encodeTimes;
+	UINT64* decodeTimes;
+	UINT32 maxError;
+} BENCH_RESULT;
+
+static UINT32 bench_rect_width(const RECTANGLE_16* rect)
+{
+	return (UINT32)(rect->right - rect->left);
+}
+
+static UINT32 bench_rect_height(const RECTANGLE_16* rect)
+{
+	return (UINT32)(rect->bottom - rect->top);
+}
+
+static const BYTE* bench_frame_pointer(const BENCH_FRAME* frame, const RECTANGLE_16* rect)
+{
+	return &frame->data[1ull * rect->top * frame->scanline + 4ull * rect->left];
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_planar_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	BITMAP_PLANAR_CONTEXT* planar = freerdp_bitmap_planar_context_new(
+	    PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE, BENCH_TILE_SIZE, BENCH_TILE_SIZE);
+
+	WINPR_UNUSED(compressor);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+
+	/* the frames are top down, like a shadow server surface */
+	if (planar)
+		freerdp_planar_topdown_image(planar, TRUE);
+
+	return planar;
+}
+
+static void bench_planar_free(void* context)
+{
+	freerdp_bitmap_planar_context_free(context);
+}
+
+static int bench_planar_encode(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+                               UINT32 numRects, wStream* s)
+{
+	UINT32 size = 0;
+	BYTE* data;
+
+	WINPR_UNUSED(numRects);
+	data = freerdp_bitmap_compress_planar(context, bench_frame_pointer(frame, rects), BENCH_FORMAT,
+	                                      bench_rect_width(rects), bench_rect_height(rects),
+	                                      frame->scanline, NULL, &size);
+
+	if (!data || !Stream_EnsureRemainingCapacity(s, size))
+	{
+		free(data);
+		return -1;
+	}
+
+	Stream_Write(s, data, size);
+	free(data);
+	return 1;
+}
+
+static BOOL bench_planar_decode(void* context, const BYTE* data, size_t size,
+                                const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst,
+                                UINT32 stride, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return planar_decompress(context, data, (UINT32)size, bench_rect_width(rects),
+	                         bench_rect_height(rects), dst, BENCH_FORMAT, stride, rects->left,
+	                         rects->top, bench_rect_width(rects), bench_rect_height(rects), FALSE);
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_interleaved_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return bitmap_interleaved_context_new(compressor);
+}
+
+static void bench_interleaved_free(void* context)
+{
+	bitmap_interleaved_context_free(context);
+}
+
+static int bench_interleaved_encode(void* context, const BENCH_FRAME* frame,
+                                    const RECTANGLE_16* rects, UINT32 numRects, wStream* s)
+{
+	UINT32 size = BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4;
+
+	WINPR_UNUSED(numRects);
+
+	/* interleaved bitmaps have to be a multiple of 4 pixels wide */
+	if ((bench_rect_width(rects) % 4) != 0)
+		return 0;
+
+	if (!Stream_EnsureRemainingCapacity(s, size))
+		return -1;
+
+	if (!interleaved_compress(context, Stream_Pointer(s), &size, bench_rect_width(rects),
+	                          bench_rect_height(rects), bench_frame_pointer(frame, rects),
+	                          BENCH_FORMAT, frame->scanline, 0, 0, NULL, 24))
+		return -1;
+
+	Stream_Seek(s, size);
+	return 1;
+}
+
+static BOOL bench_interleaved_decode(void* context, const BYTE* data, size_t size,
+                                     const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst,
+                                     UINT32 stride, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return interleaved_decompress(context, data, (UINT32)size, bench_rect_width(rects),
+	                              bench_rect_height(rects), 24, dst, BENCH_FORMAT, stride,
+	                              rects->left, rects->top, bench_rect_width(rects),
+	                              bench_rect_height(rects), NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_nsc_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	NSC_CONTEXT* nsc = nsc_context_new();
+
+	WINPR_UNUSED(compressor);
+
+	if (!nsc)
+		return NULL;
+
+	if (!nsc_context_reset(nsc, width, height) ||
+	    !nsc_context_set_parameters(nsc, NSC_COLOR_FORMAT, BENCH_FORMAT))
+	{
+		nsc_context_free(nsc);
+		return NULL;
+	}
+
+	return nsc;
+}
+
+static void bench_nsc_free(void* context)
+{
+	nsc_context_free(context);
+}
+
+static int bench_nsc_encode(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+                            UINT32 numRects, wStream* s)
+{
+	WINPR_UNUSED(numRects);
+
+	if (!nsc_compose_message(context, s, bench_frame_pointer(frame, rects),
+	                         bench_rect_width(rects), bench_rect_height(rects), frame->scanline))
+		return -1;
+
+	return 1;
+}
+
+static BOOL bench_nsc_decode(void* context, const BYTE* data, size_t size,
+                             const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst, UINT32 stride,
+                             UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return nsc_process_message(context, 32, bench_rect_width(rects), bench_rect_height(rects),
+	                           data, (UINT32)size, dst, BENCH_FORMAT, stride, rects->left,
+	                           rects->top, bench_rect_width(rects), bench_rect_height(rects),
+	                           FREERDP_FLIP_VERTICAL);
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_clear_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return clear_context_new(compressor);
+}
+
+static void bench_clear_free(void* context)
+{
+	clear_context_free(context);
+}
+
+static int bench_clear_encode(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+                              UINT32 numRects, wStream* s)
+{
+	BYTE* data = NULL;
+	UINT32 size = 0;
+
+	WINPR_UNUSED(numRects);
+
+	if (clear_compress(context, bench_frame_pointer(frame, rects), BENCH_FORMAT, frame->scanline,
+	                   bench_rect_width(rects), bench_rect_height(rects), &data, &size) < 0)
+		return -1;
+
+	if (!Stream_EnsureRemainingCapacity(s, size))
+		return -1;
+
+	Stream_Write(s, data, size);
+	return 1;
+}
+
+static BOOL bench_clear_decode(void* context, const BYTE* data, size_t size,
+                               const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst,
+                               UINT32 stride, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(numRects);
+	return clear_decompress(context, data, (UINT32)size, bench_rect_width(rects),
+	                        bench_rect_height(rects), dst, BENCH_FORMAT, stride, rects->left,
+	                        rects->top, width, height, NULL) >= 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_rfx_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	RFX_CONTEXT* rfx = rfx_context_new(compressor);
+
+	if (!rfx)
+		return NULL;
+
+	if (!rfx_context_reset(rfx, width, height))
+	{
+		rfx_context_free(rfx);
+		return NULL;
+	}
+
+	rfx_context_set_pixel_format(rfx, BENCH_FORMAT);
+	return rfx;
+}
+
+static void bench_rfx_free(void* context)
+{
+	rfx_context_free(context);
+}
+
+static int bench_rfx_encode(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+                            UINT32 numRects, wStream* s)
+{
+	int rc = -1;
+	UINT32 i;
+	RFX_MESSAGE* message;
+	RFX_RECT* rfxRects = (RFX_RECT*)bench_scratch(numRects * sizeof(RFX_RECT));
+
+	if (!rfxRects)
+		return -1;
+
+	for (i = 0; i < numRects; i++)
+	{
+		rfxRects[i].x = rects[i].left;
+		rfxRects[i].y = rects[i].top;
+		rfxRects[i].width = (UINT16)bench_rect_width(&rects[i]);
+		rfxRects[i].height = (UINT16)bench_rect_height(&rects[i]);
+	}
+
+	message = rfx_encode_message(context, rfxRects, numRects, frame->data, frame->width,
+	                             frame->height, frame->scanline);
+
+	if (message && rfx_write_message(context, s, message))
+		rc = 1;
+
+	rfx_message_free(context, message);
+	return rc;
+}
+
+static BOOL bench_rfx_decode(void* context, const BYTE* data, size_t size,
+                             const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst, UINT32 stride,
+                             UINT32 width, UINT32 height)
+{
+	BOOL rc;
+	REGION16 invalidRegion;
+
+	WINPR_UNUSED(rects);
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	region16_init(&invalidRegion);
+	rc = rfx_process_message(context, data, (UINT32)size, 0, 0, dst, BENCH_FORMAT, stride, height,
+	                         &invalidRegion);
+	region16_uninit(&invalidRegion);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_progressive_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	PROGRESSIVE_CONTEXT* progressive = progressive_context_new(compressor);
+
+	if (!progressive)
+		return NULL;
+
+	if (!compressor && (progressive_create_surface_context(progressive, 0, width, height) < 0))
+	{
+		progressive_context_free(progressive);
+		return NULL;
+	}
+
+	return progressive;
+}
+
+static void bench_progressive_free(void* context)
+{
+	progressive_context_free(context);
+}
+
+static int bench_progressive_encode(void* context, const BENCH_FRAME* frame,
+                                    const RECTANGLE_16* rects, UINT32 numRects, wStream* s)
+{
+	int rc = -1;
+	UINT32 i;
+	BYTE* data = NULL;
+	UINT32 size = 0;
+	REGION16 invalidRegion;
+
+	region16_init(&invalidRegion);
+
+	for (i = 0; i < numRects; i++)
+	{
+		if (!region16_union_rect(&invalidRegion, &invalidRegion, &rects[i]))
+			goto fail;
+	}
+
+	if (progressive_compress(context, frame->data, frame->scanline * frame->height, BENCH_FORMAT,
+	                         frame->width, frame->height, frame->scanline, &invalidRegion, &data,
+	                         &size) < 0)
+		goto fail;
+
+	if (!Stream_EnsureRemainingCapacity(s, size))
+		goto fail;
+
+	Stream_Write(s, data, size);
+	rc = 1;
+fail:
+	region16_uninit(&invalidRegion);
+	return rc;
+}
+
+static BOOL bench_progressive_decode(void* context, const BYTE* data, size_t size,
+                                     const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst,
+                                     UINT32 stride, UINT32 width, UINT32 height)
+{
+	INT32 rc;
+	REGION16 invalidRegion;
+
+	WINPR_UNUSED(rects);
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	region16_init(&invalidRegion);
+	rc = progressive_decompress(context, data, (UINT32)size, dst, BENCH_FORMAT, stride, 0, 0,
+	                            &invalidRegion, 0, 0);
+	region16_uninit(&invalidRegion);
+	return rc >= 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void* bench_zgfx_new(BOOL compressor, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return zgfx_context_new(compressor);
+}
+
+static void bench_zgfx_free(void* context)
+{
+	zgfx_context_free(context);
+}
+
+/* Uncompressed surface commands: the rectangle pixels as one bulk compressed PDU */
+static int bench_zgfx_encode(void* context, const BENCH_FRAME* frame, const RECTANGLE_16* rects,
+                             UINT32 numRects, wStream* s)
+{
+	UINT32 y;
+	UINT32 flags = 0;
+	const UINT32 width = bench_rect_width(rects);
+	const UINT32 height = bench_rect_height(rects);
+	BYTE* pixels = bench_scratch(4ull * width * height);
+
+	WINPR_UNUSED(numRects);
+
+	if (!pixels)
+		return -1;
+
+	for (y = 0; y < height; y++)
+		memcpy(&pixels[4ull * width * y],
+		       &bench_frame_pointer(frame, rects)[1ull * frame->scanline * y], 4ull * width);
+
+	if (zgfx_compress_to_stream(context, s, pixels, 4 * width * height, &flags) < 0)
+		return -1;
+
+	return 1;
+}
+
+static BOOL bench_zgfx_decode(void* context, const BYTE* data, size_t size,
+                              const RECTANGLE_16* rects, UINT32 numRects, BYTE* dst, UINT32 stride,
+                              UINT32 width, UINT32 height)
+{
+	BYTE* pixels = NULL;
+	UINT32 pixelsSize = 0;
+	UINT32 y;
+	const UINT32 w = bench_rect_width(rects);
+	const UINT32 h = bench_rect_height(rects);
+
+	WINPR_UNUSED(numRects);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+
+	if (zgfx_decompress(context, data, (UINT32)size, &pixels, &pixelsSize, 0) < 0)
+		return FALSE;
+
+	if (pixelsSize != 4 * w * h)
+	{
+		free(pixels);
+		return FALSE;
+	}
+
+	for (y = 0; y < h; y++)
+		memcpy(&dst[1ull * (rects->top + y) * stride + 4ull * rects->left],
+		       &pixels[4ull * w * y], 4ull * w);
+
+	free(pixels);
+	return TRUE;
+}
+
+/* the interleaved bound is the one of TestFreeRDPCodecInterleaved */
+static const BENCH_CODEC bench_codecs[] = {
+	{ "planar", 0, TRUE, bench_planar_new, bench_planar_free, bench_planar_encode,
+	  bench_planar_decode },
+	{ "interleaved", 4, TRUE, bench_interleaved_new, bench_interleaved_free,
+	  bench_interleaved_encode, bench_interleaved_decode },
+	{ "nsc", -1, TRUE, bench_nsc_new, bench_nsc_free, bench_nsc_encode, bench_nsc_decode },
+	{ "clear", -1, TRUE, bench_clear_new, bench_clear_free, bench_clear_encode,
+	  bench_clear_decode },
+	{ "rfx", -1, FALSE, bench_rfx_new, bench_rfx_free, bench_rfx_encode, bench_rfx_decode },
+	{ "progressive", -1, FALSE, bench_progressive_new, bench_progressive_free,
+	  bench_progressive_encode, bench_progressive_decode },
+	{ "zgfx", 0, TRUE, bench_zgfx_new, bench_zgfx_free, bench_zgfx_encode, bench_zgfx_decode }
+};
+
+/* ------------------------------------------------------------------------- */
+static void bench_corpus_free(BENCH_CORPUS* corpus)
+{
+	size_t i;
+
+	if (!corpus)
+		return;
+
+	for (i = 0; i < corpus->count; i++)
+	{
+		free(corpus->frames[i].data);
+		free(corpus->frames[i].rects);
+	}
+
+	free(corpus->frames);
+	free(corpus);
+}
+
+static BENCH_FRAME* bench_corpus_add_frame(BENCH_CORPUS* corpus, UINT32 numRects)
+{
+	BENCH_FRAME* frame;
+	BENCH_FRAME* frames =
+	    realloc(corpus->frames, (corpus->count + 1) * sizeof(BENCH_FRAME));
+
+	if (!frames)
+		return NULL;
+
+	corpus->frames = frames;
+	frame = &frames[corpus->count];
+	ZeroMemory(frame, sizeof(BENCH_FRAME));
+	frame->width = corpus->width;
+	frame->height = corpus->height;
+	frame->scanline = corpus->width * 4;
+	frame->numRects = numRects;
+	frame->data = calloc(frame->height, frame->scanline);
+	frame->rects = calloc(MAX(numRects, 1), sizeof(RECTANGLE_16));
+
+	if (!frame->data || !frame->rects)
+	{
+		free(frame->data);
+		free(frame->rects);
+		return NULL;
+	}
+
+	corpus->count++;
+	return frame;
+}
+
+static BOOL bench_frame_read(BENCH_CORPUS* corpus, wStream* s, UINT64 pts)
+{
+	UINT32 i;
+	UINT32 y;
+	UINT32 magic, width, height, scanline;
+	UINT16 numRects;
+	BENCH_FRAME* frame;
+
+	if (Stream_GetRemainingLength(s) < 18)
+		return FALSE;
+
+	Stream_Read_UINT32(s, magic);
+	Stream_Read_UINT32(s, width);
+	Stream_Read_UINT32(s, height);
+	Stream_Read_UINT32(s, scanline);
+	Stream_Read_UINT16(s, numRects);
+
+	if ((magic != BENCH_CORPUS_MAGIC) || (width == 0) || (height == 0) || (width > 0xFFFF) ||
+	    (height > 0xFFFF) || (scanline < width * 4))
+	{
+		fprintf(stderr, "%s: invalid frame header\n", corpus->name);
+		return FALSE;
+	}
+
+	if (corpus->count == 0)
+	{
+		corpus->width = width;
+		corpus->height = height;
+	}
+	else if ((corpus->width != width) || (corpus->height != height))
+	{
+		fprintf(stderr, "%s: frame size changes from %" PRIu32 "x%" PRIu32 " to %" PRIu32
+		                "x%" PRIu32 "\n",
+		        corpus->name, corpus->width, corpus->height, width, height);
+		return FALSE;
+	}
+
+	if (Stream_GetRemainingLength(s) < 8ull * numRects + 1ull * scanline * height)
+	{
+		fprintf(stderr, "%s: truncated frame\n", corpus->name);
+		return FALSE;
+	}
+
+	frame = bench_corpus_add_frame(corpus, numRects);
+
+	if (!frame)
+		return FALSE;
+
+	frame->pts = pts;
+
+	for (i = 0; i < numRects; i++)
+	{
+		RECTANGLE_16* rect = &frame->rects[i];
+		Stream_Read_UINT16(s, rect->left);
+		Stream_Read_UINT16(s, rect->top);
+		Stream_Read_UINT16(s, rect->right);
+		Stream_Read_UINT16(s, rect->bottom);
+
+		if ((rect->left >= rect->right) || (rect->top >= rect->bottom) ||
+		    (rect->right > width) || (rect->bottom > height))
+		{
+			fprintf(stderr, "%s: invalid rectangle in frame %" PRIuz "\n", corpus->name,
+			        corpus->count - 1);
+			return FALSE;
+		}
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		Stream_Read(s, &frame->data[1ull * frame->scanline * y], frame->scanline);
+		Stream_Seek(s, scanline - frame->scanline);
+	}
+
+	return TRUE;
+}
+
+static BENCH_CORPUS* bench_corpus_load(const char* file)
+{
+	size_t offset = 0;
+	UINT64 pts = 0;
+	BENCH_CORPUS* corpus = calloc(1, sizeof(BENCH_CORPUS));
+	wStream* s = Stream_New(NULL, 1024);
+	FILE* fp = winpr_fopen(file, "rb");
+
+	if (!corpus || !s || !fp)
+	{
+		fprintf(stderr, "failed to open corpus %s\n", file);
+		goto fail;
+	}
+
+	corpus->name = file;
+
+	for (;;)
+	{
+		Stream_SetPosition(s, 0);
+
+		if (!stream_dump_read_line(fp, s, &pts, &offset))
+			break;
+
+		Stream_SetPosition(s, 0);
+
+		if (!bench_frame_read(corpus, s, pts))
+			goto fail;
+	}
+
+	if (corpus->count == 0)
+	{
+		fprintf(stderr, "%s: no frames\n", file);
+		goto fail;
+	}
+
+	Stream_Free(s, TRUE);
+	fclose(fp);
+	return corpus;
+fail:
+	Stream_Free(s, TRUE);
+	if (fp)
+		fclose(fp);
+	bench_corpus_free(corpus);
+	return NULL;
+}
+
+static BOOL bench_corpus_save(const BENCH_CORPUS* corpus, const char* file)
+{
+	BOOL rc = FALSE;
+	size_t i;
+	UINT32 j;
+	wStream* s = Stream_New(NULL, 1024);
+	FILE* fp = winpr_fopen(file, "wb");
+
+	if (!s || !fp)
+	{
+		fprintf(stderr, "failed to create corpus %s\n", file);
+		goto fail;
+	}
+
+	for (i = 0; i < corpus->count; i++)
+	{
+		const BENCH_FRAME* frame = &corpus->frames[i];
+		const size_t size = 18ull + 8ull * frame->numRects + 1ull * frame->scanline * frame->height;
+
+		Stream_SetPosition(s, 0);
+
+		if (!Stream_EnsureRemainingCapacity(s, size))
+			goto fail;
+
+		Stream_Write_UINT32(s, BENCH_CORPUS_MAGIC);
+		Stream_Write_UINT32(s, frame->width);
+		Stream_Write_UINT32(s, frame->height);
+		Stream_Write_UINT32(s, frame->scanline);
+		Stream_Write_UINT16(s, (UINT16)frame->numRects);
+
+		for (j = 0; j < frame->numRects; j++)
+		{
+			Stream_Write_UINT16(s, frame->rects[j].left);
+			Stream_Write_UINT16(s, frame->rects[j].top);
+			Stream_Write_UINT16(s, frame->rects[j].right);
+			Stream_Write_UINT16(s, frame->rects[j].bottom);
+		}
+
+		Stream_Write(s, frame->data, 1ull * frame->scanline * frame->height);
+		Stream_SealLength(s);
+
+		if (!stream_dump_write_line(fp, s))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	if (fp)
+		fclose(fp);
+	return rc;
+}
+
+static BENCH_CORPUS* bench_corpus_import(int argc, char* argv[])
+{
+	int i;
+	BENCH_CORPUS* corpus = calloc(1, sizeof(BENCH_CORPUS));
+
+	if (!corpus)
+		return NULL;
+
+	corpus->name = "import";
+
+	for (i = 0; i < argc; i++)
+	{
+		BOOL rc;
+		BENCH_FRAME* frame;
+		wImage* image = winpr_image_new();
+
+		if (!image || (winpr_image_read(image, argv[i]) <= 0))
+		{
+			fprintf(stderr, "failed to read image %s\n", argv[i]);
+			winpr_image_free(image, TRUE);
+			goto fail;
+		}
+
+		if (corpus->count == 0)
+		{
+			corpus->width = image->width;
+			corpus->height = image->height;
+		}
+
+		if ((image->width != corpus->width) || (image->height != corpus->height) ||
+		    ((image->bitsPerPixel != 24) && (image->bitsPerPixel != 32)))
+		{
+			fprintf(stderr, "%s: all images need the same size and 24 or 32 bpp\n", argv[i]);
+			winpr_image_free(image, TRUE);
+			goto fail;
+		}
+
+		/* still images are fully dirty frames */
+		frame = bench_corpus_add_frame(corpus, 0);
+		rc = frame && freerdp_image_copy(frame->data, BENCH_FORMAT, frame->scanline, 0, 0,
+		                                 frame->width, frame->height, image->data,
+		                                 (image->bitsPerPixel == 32) ? PIXEL_FORMAT_BGRX32
+		                                                             : PIXEL_FORMAT_BGR24,
+		                                 image->scanline, 0, 0, NULL, FREERDP_FLIP_NONE);
+		winpr_image_free(image, TRUE);
+
+		if (!rc)
+			goto fail;
+	}
+
+	if (corpus->count == 0)
+		goto fail;
+
+	return corpus;
+fail:
+	bench_corpus_free(corpus);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static UINT32 bench_random(UINT32* seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void bench_fill(BENCH_FRAME* frame, UINT32 left, UINT32 top, UINT32 right, UINT32 bottom,
+                       UINT32 color)
+{
+	UINT32 x, y;
+
+	for (y = top; y < bottom; y++)
+	{
+		UINT32* line = (UINT32*)&frame->data[1ull * frame->scanline * y];
+
+		for (x = left; x < right; x++)
+			line[x] = color;
+	}
+}
+
+/* Draws rows of "glyphs" into a text area, like a terminal or a document */
+static void bench_draw_text(BENCH_FRAME* frame, UINT32 left, UINT32 top, UINT32 right,
+                            UINT32 bottom, UINT32 line)
+{
+	UINT32 y;
+
+	bench_fill(frame, left, top, right, bottom, 0xFFFFFFFF);
+
+	for (y = top + 2; y + 12 < bottom; y += 16, line++)
+	{
+		UINT32 x = left + 4;
+		UINT32 lineSeed = line * 2654435761u;
+		const UINT32 length = (right - left) * (4 + bench_random(&lineSeed) % 5) / 8;
+
+		while (x + 8 < left + length)
+		{
+			const UINT32 word = 2 + bench_random(&lineSeed) % 8;
+			UINT32 i;
+
+			for (i = 0; (i < word) && (x + 8 < left + length); i++, x += 8)
+			{
+				const UINT32 glyph = bench_random(&lineSeed);
+				UINT32 gy;
+
+				for (gy = 0; gy < 12; gy++)
+				{
+					UINT32* pixel = (UINT32*)&frame->data[1ull * frame->scanline * (y + gy)];
+					UINT32 gx;
+
+					for (gx = 0; gx < 6; gx++)
+					{
+						if ((glyph >> ((gy * 6 + gx) % 24)) & 1)
+							pixel[x + gx] = 0xFF202020;
+					}
+				}
+			}
+
+			x += 8;
+		}
+	}
+}
+
+static BOOL bench_add_rect(RECTANGLE_16* rects, UINT32* numRects, UINT32 left, UINT32 top,
+                           UINT32 right, UINT32 bottom)
+{
+	if ((left >= right) || (top >= bottom))
+		return FALSE;
+
+	rects[*numRects].left = (UINT16)left;
+	rects[*numRects].top = (UINT16)top;
+	rects[*numRects].right = (UINT16)right;
+	rects[*numRects].bottom = (UINT16)bottom;
+	(*numRects)++;
+	return TRUE;
+}
+
+/**
+ * A desktop session: a gradient background with a scrolling text window, a small video
+ * playing and a blinking cursor. The first frame is fully dirty, later frames only
+ * carry the damaged areas.
+ */
+static BENCH_CORPUS* bench_corpus_generate(UINT32 width, UINT32 height, size_t count)
+{
+	size_t i;
+	UINT32 x, y;
+	UINT32 seed = 0x5EED;
+	BENCH_CORPUS* corpus = calloc(1, sizeof(BENCH_CORPUS));
+	const UINT32 textLeft = width / 8;
+	const UINT32 textTop = height / 8;
+	const UINT32 textRight = width * 5 / 8;
+	const UINT32 textBottom = height * 7 / 8;
+	const UINT32 videoLeft = width * 11 / 16;
+	const UINT32 videoTop = height / 4;
+	const UINT32 videoRight = MIN(width, videoLeft + 256);
+	const UINT32 videoBottom = MIN(height, videoTop + 144);
+
+	if (!corpus)
+		return NULL;
+
+	corpus->name = "synthetic";
+	corpus->width = width;
+	corpus->height = height;
+
+	for (i = 0; i < count; i++)
+	{
+		UINT32 numRects = 0;
+		RECTANGLE_16 rects[3];
+		BENCH_FRAME* frame;
+
+		if (i == 0)
+			bench_add_rect(rects, &numRects, 0, 0, width, height);
+		else
+		{
+			/* the text window scrolls every other frame */
+			if (i % 2)
+				bench_add_rect(rects, &numRects, textLeft, textTop, textRight, textBottom);
+
+			bench_add_rect(rects, &numRects, videoLeft, videoTop, videoRight, videoBottom);
+			bench_add_rect(rects, &numRects, textLeft + 4, textBottom - 20, textLeft + 6,
+			               textBottom - 4);
+		}
+
+		frame = bench_corpus_add_frame(corpus, numRects);
+
+		if (!frame)
+			goto fail;
+
+		CopyMemory(frame->rects, rects, numRects * sizeof(RECTANGLE_16));
+		frame->pts = i * 16;
+
+		/* the frames are complete screen contents, only the rectangles differ */
+		for (y = 0; y < height; y++)
+		{
+			UINT32* line = (UINT32*)&frame->data[1ull * frame->scanline * y];
+
+			for (x = 0; x < width; x++)
+				line[x] = 0xFF000000 | ((x * 255 / width) << 16) | ((y * 255 / height) << 8) | 0x80;
+		}
+
+		bench_draw_text(frame, textLeft, textTop, textRight, textBottom, (UINT32)(i + 1) / 2);
+
+		for (y = videoTop; y < videoBottom; y++)
+		{
+			UINT32* line = (UINT32*)&frame->data[1ull * frame->scanline * y];
+
+			for (x = videoLeft; x < videoRight; x++)
+			{
+				const UINT32 noise = bench_random(&seed) & 0x0F;
+				const UINT32 r = (x + (UINT32)i * 3) & 0xFF;
+				const UINT32 g = (y + (UINT32)i * 2) & 0xFF;
+				line[x] = 0xFF000000 | ((r ^ noise) << 16) | ((g ^ noise) << 8) | (noise << 3);
+			}
+		}
+
+		if (i % 2)
+			bench_fill(frame, textLeft + 4, textBottom - 20, textLeft + 6, textBottom - 4,
+			           0xFF000000);
+	}
+
+	return corpus;
+fail:
+	bench_corpus_free(corpus);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Splits the dirty rectangles of a frame into tiles, as bitmap updates do */
+static RECTANGLE_16* bench_frame_tiles(const BENCH_FRAME* frame, UINT32* numTiles)
+{
+	UINT32 i;
+	UINT32 count = 0;
+	RECTANGLE_16 full = { 0, 0, (UINT16)frame->width, (UINT16)frame->height };
+	const RECTANGLE_16* rects = frame->numRects ? frame->rects : &full;
+	const UINT32 numRects = frame->numRects ? frame->numRects : 1;
+	RECTANGLE_16* tiles;
+
+	for (i = 0; i < numRects; i++)
+		count += ((bench_rect_width(&rects[i]) + BENCH_TILE_SIZE - 1) / BENCH_TILE_SIZE) *
+		         ((bench_rect_height(&rects[i]) + BENCH_TILE_SIZE - 1) / BENCH_TILE_SIZE);
+
+	tiles = calloc(count, sizeof(RECTANGLE_16));
+
+	if (!tiles)
+		return NULL;
+
+	*numTiles = 0;
+
+	for (i = 0; i < numRects; i++)
+	{
+		UINT32 x, y;
+
+		for (y = rects[i].top; y < rects[i].bottom; y += BENCH_TILE_SIZE)
+		{
+			for (x = rects[i].left; x < rects[i].right; x += BENCH_TILE_SIZE)
+			{
+				RECTANGLE_16* tile = &tiles[(*numTiles)++];
+				tile->left = (UINT16)x;
+				tile->top = (UINT16)y;
+				tile->right = (UINT16)MIN(x + BENCH_TILE_SIZE, rects[i].right);
+				tile->bottom = (UINT16)MIN(y + BENCH_TILE_SIZE, rects[i].bottom);
+			}
+		}
+	}
+
+	return tiles;
+}
+
+/* Largest difference of a color channel, the X channel is not transported by every codec */
+static UINT32 bench_compare(const BENCH_FRAME* frame, const BYTE* dst, const RECTANGLE_16* rect)
+{
+	UINT32 x, y, c;
+	UINT32 maxError = 0;
+
+	for (y = rect->top; y < rect->bottom; y++)
+	{
+		const BYTE* a = &frame->data[1ull * frame->scanline * y];
+		const BYTE* b = &dst[1ull * frame->scanline * y];
+
+		for (x = rect->left; x < rect->right; x++)
+		{
+			for (c = 0; c < 3; c++)
+			{
+				const BYTE va = a[4ull * x + c];
+				const BYTE vb = b[4ull * x + c];
+				maxError = MAX(maxError, (UINT32)((va > vb) ? va - vb : vb - va));
+			}
+		}
+	}
+
+	return maxError;
+}
+
+static BOOL bench_verified(const BENCH_CODEC* codec, const BENCH_RESULT* result)
+{
+	return (codec->maxError < 0) || (result->maxError <= (UINT32)codec->maxError);
+}
+
+static UINT64 bench_elapsed(STOPWATCH* sw)
+{
+	UINT32 sec = 0;
+	UINT32 usec = 0;
+	stopwatch_get_elapsed_time_in_useconds(sw, &sec, &usec);
+	return 1000000ull * sec + usec;
+}
+
+static BOOL bench_run_codec(const BENCH_CODEC* codec, const BENCH_CORPUS* corpus,
+                            size_t iterations, BENCH_RESULT* result)
+{
+	BOOL rc = FALSE;
+	size_t iteration, i;
+	void* encoder = NULL;
+	void* decoder = NULL;
+	wStream* s = Stream_New(NULL, 1024);
+	BYTE* dst = calloc(corpus->height, corpus->width * 4ull);
+	STOPWATCH* sw = stopwatch_create();
+
+	ZeroMemory(result, sizeof(BENCH_RESULT));
+	result->encodeTimes = calloc(corpus->count * iterations, sizeof(UINT64));
+	result->decodeTimes = calloc(corpus->count * iterations, sizeof(UINT64));
+
+	if (!s || !dst || !sw || !result->encodeTimes || !result->decodeTimes)
+		goto fail;
+
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		/* every pass replays the session from the start, with fresh codec state */
+		codec->context_free(encoder);
+		codec->context_free(decoder);
+		encoder = codec->context_new(TRUE, corpus->width, corpus->height);
+		decoder = codec->context_new(FALSE, corpus->width, corpus->height);
+
+		if (!encoder || !decoder)
+		{
+			fprintf(stderr, "%s: failed to create the codec contexts\n", codec->name);
+			goto fail;
+		}
+
+		for (i = 0; i < corpus->count; i++)
+		{
+			const BENCH_FRAME* frame = &corpus->frames[i];
+			const size_t index = iteration * corpus->count + i;
+			RECTANGLE_16 full = { 0, 0, (UINT16)frame->width, (UINT16)frame->height };
+			const RECTANGLE_16* rects = frame->numRects ? frame->rects : &full;
+			UINT32 numUnits = frame->numRects ? frame->numRects : 1;
+			RECTANGLE_16* tiles = NULL;
+			UINT32 unit;
+
+			if (codec->tiled)
+			{
+				if (!(tiles = bench_frame_tiles(frame, &numUnits)))
+					goto fail;
+			}
+
+			for (unit = 0; unit < (codec->tiled ? numUnits : 1); unit++)
+			{
+				const RECTANGLE_16* unitRects = codec->tiled ? &tiles[unit] : rects;
+				const UINT32 unitCount = codec->tiled ? 1 : numUnits;
+				UINT64 allocations = bench_get_allocations();
+				UINT64 pixels = 0;
+				UINT32 j;
+				int status;
+
+				for (j = 0; j < unitCount; j++)
+					pixels += 1ull * bench_rect_width(&unitRects[j]) *
+					          bench_rect_height(&unitRects[j]);
+
+				Stream_SetPosition(s, 0);
+				stopwatch_reset(sw);
+				stopwatch_start(sw);
+				status = codec->encode(encoder, frame, unitRects, unitCount, s);
+				stopwatch_stop(sw);
+				result->encodeTimes[index] += bench_elapsed(sw);
+				result->encodeAllocations += bench_get_allocations() - allocations;
+
+				if (status < 0)
+				{
+					fprintf(stderr, "%s: encoding frame %" PRIuz " failed\n", codec->name, i);
+					free(tiles);
+					goto fail;
+				}
+
+				if (status == 0)
+				{
+					result->skippedPixels += pixels;
+					continue;
+				}
+
+				result->pixels += pixels;
+				result->rawBytes += pixels * 4;
+				result->compressedBytes += Stream_GetPosition(s);
+
+				allocations = bench_get_allocations();
+				stopwatch_reset(sw);
+				stopwatch_start(sw);
+				status = codec->decode(decoder, Stream_Buffer(s), Stream_GetPosition(s),
+				                       unitRects, unitCount, dst, corpus->width * 4,
+				                       corpus->width, corpus->height);
+				stopwatch_stop(sw);
+				result->decodeTimes[index] += bench_elapsed(sw);
+				result->decodeAllocations += bench_get_allocations() - allocations;
+
+				if (!status)
+				{
+					fprintf(stderr, "%s: decoding frame %" PRIuz " failed\n", codec->name, i);
+					free(tiles);
+					goto fail;
+				}
+
+				for (j = 0; j < unitCount; j++)
+					result->maxError =
+					    MAX(result->maxError, bench_compare(frame, dst, &unitRects[j]));
+			}
+
+			free(tiles);
+			result->frames++;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	codec->context_free(encoder);
+	codec->context_free(decoder);
+	stopwatch_free(sw);
+	Stream_Free(s, TRUE);
+	free(dst);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static int bench_compare_times(const void* a, const void* b)
+{
+	const UINT64 va = *(const UINT64*)a;
+	const UINT64 vb = *(const UINT64*)b;
+	return (va > vb) - (va < vb);
+}
+
+static UINT64 bench_percentile(const UINT64* times, size_t count, size_t percentile)
+{
+	return times[(count - 1) * percentile / 100];
+}
+
+typedef struct
+{
+	UINT64 total;
+	UINT64 p50;
+	UINT64 p99;
+	double mpixels;
+	double allocations;
+} BENCH_SUMMARY;
+
+static void bench_summarize(UINT64* times, size_t frames, UINT64 pixels, UINT64 allocations,
+                            BENCH_SUMMARY* summary)
+{
+	size_t i;
+
+	ZeroMemory(summary, sizeof(BENCH_SUMMARY));
+
+	if (frames == 0)
+		return;
+
+	for (i = 0; i < frames; i++)
+		summary->total += times[i];
+
+	qsort(times, frames, sizeof(UINT64), bench_compare_times);
+	summary->p50 = bench_percentile(times, frames, 50);
+	summary->p99 = bench_percentile(times, frames, 99);
+	summary->mpixels = (double)pixels / (double)MAX(summary->total, 1);
+	summary->allocations = (double)allocations / (double)frames;
+}
+
+static void bench_print(const BENCH_CODEC* codec, const BENCH_CORPUS* corpus, size_t iterations,
+                        BENCH_RESULT* result, BOOL json)
+{
+	BENCH_SUMMARY enc, dec;
+	const double ratio = result->compressedBytes
+	                         ? (double)result->rawBytes / (double)result->compressedBytes
+	                         : 0.0;
+
+	bench_summarize(result->encodeTimes, result->frames, result->pixels,
+	                result->encodeAllocations, &enc);
+	bench_summarize(result->decodeTimes, result->frames, result->pixels,
+	                result->decodeAllocations, &dec);
+
+	if (json)
+	{
+		printf("{\"corpus\":\"%s\",\"codec\":\"%s\",\"width\":%" PRIu32 ",\"height\":%" PRIu32
+		       ",\"frames\":%" PRIuz ",\"iterations\":%" PRIuz ",\"pixels\":%" PRIu64
+		       ",\"skipped_pixels\":%" PRIu64 ",\"raw_bytes\":%" PRIu64
+		       ",\"compressed_bytes\":%" PRIu64 ",\"ratio\":%.3f",
+		       corpus->name, codec->name, corpus->width, corpus->height, corpus->count,
+		       iterations, result->pixels, result->skippedPixels, result->rawBytes,
+		       result->compressedBytes, ratio);
+		printf(",\"encode\":{\"total_us\":%" PRIu64 ",\"mpixels_per_s\":%.3f,\"p50_us\":%" PRIu64
+		       ",\"p99_us\":%" PRIu64 ",\"allocs_per_frame\":",
+		       enc.total, enc.mpixels, enc.p50, enc.p99);
+#if defined(BENCH_ALLOC_COUNT)
+		printf("%.2f}", enc.allocations);
+#else
+		printf("null}");
+#endif
+		printf(",\"decode\":{\"total_us\":%" PRIu64 ",\"mpixels_per_s\":%.3f,\"p50_us\":%" PRIu64
+		       ",\"p99_us\":%" PRIu64 ",\"allocs_per_frame\":",
+		       dec.total, dec.mpixels, dec.p50, dec.p99);
+#if defined(BENCH_ALLOC_COUNT)
+		printf("%.2f}", dec.allocations);
+#else
+		printf("null}");
+#endif
+		printf(",\"max_error\":%" PRIu32, result->maxError);
+		if (codec->maxError < 0)
+			printf(",\"error_bound\":null,\"verified\":null}\n");
+		else
+			printf(",\"error_bound\":%" PRId32 ",\"verified\":%s}\n", codec->maxError,
+			       bench_verified(codec, result) ? "true" : "false");
+	}
+	else
+	{
+		printf("%-12s %7.2f %9.1f %8" PRIu64 " %8" PRIu64 " %8.1f %9.1f %8" PRIu64 " %8" PRIu64
+		       " %8.1f %7" PRIu32 "%s\n",
+		       codec->name, ratio, enc.mpixels, enc.p50, enc.p99, enc.allocations, dec.mpixels,
+		       dec.p50, dec.p99, dec.allocations, result->maxError,
+		       bench_verified(codec, result) ? "" : " FAILED");
+	}
+}
+
+static BOOL bench_codec_selected(const char* list, const char* name)
+{
+	const size_t length = strlen(name);
+	const char* cur = list;
+
+	if (!list)
+		return TRUE;
+
+	while ((cur = strstr(cur, name)))
+	{
+		if (((cur == list) || (cur[-1] == ',')) && ((cur[length] == '\0') || (cur[length] == ',')))
+			return TRUE;
+
+		cur += length;
+	}
+
+	return FALSE;
+}
+
+static BOOL bench_run(const BENCH_CORPUS* corpus, const char* codecs, size_t iterations,
+                      BOOL json)
+{
+	BOOL rc = TRUE;
+	size_t i;
+
+	if (!json)
+	{
+		printf("corpus %s: %" PRIuz " frames of %" PRIu32 "x%" PRIu32 ", %" PRIuz
+		       " iterations\n",
+		       corpus->name, corpus->count, corpus->width, corpus->height, iterations);
+		printf("%-12s %7s %9s %8s %8s %8s %9s %8s %8s %8s %7s\n", "codec", "ratio", "enc MP/s",
+		       "p50 us", "p99 us", "allocs", "dec MP/s", "p50 us", "p99 us", "allocs",
+		       "max err");
+	}
+
+	for (i = 0; i < ARRAYSIZE(bench_codecs); i++)
+	{
+		BENCH_RESULT result = { 0 };
+		const BENCH_CODEC* codec = &bench_codecs[i];
+
+		if (!bench_codec_selected(codecs, codec->name))
+			continue;
+
+		if (!bench_run_codec(codec, corpus, iterations, &result))
+			rc = FALSE;
+		else
+		{
+			bench_print(codec, corpus, iterations, &result, json);
+
+			if (!bench_verified(codec, &result))
+				rc = FALSE;
+		}
+
+		free(result.encodeTimes);
+		free(result.decodeTimes);
+	}
+
+	return rc;
+}
+
+static void usage(const char* name)
+{
+	size_t i;
+
+	printf("%s: benchmark the FreeRDP codecs with a recorded frame corpus\n\n", name);
+	printf("Usage: %s [options] [corpus...]\n", name);
+	printf("  -c <codec,...>     codecs to run (default all:");
+	for (i = 0; i < ARRAYSIZE(bench_codecs); i++)
+		printf(" %s", bench_codecs[i].name);
+	printf(")\n");
+	printf("  -i <iterations>    replay every corpus this often (default 3)\n");
+	printf("  -n <frames>        frames of the synthetic corpus (default 60)\n");
+	printf("  -s <width>x<height> size of the synthetic corpus (default 1024x768)\n");
+	printf("  -j                 print one JSON object per codec and corpus\n");
+	printf("  -g <file>          store the synthetic corpus in file and exit\n");
+	printf("  -m <file> <image...> import still images as corpus into file and exit\n");
+	printf("Without a corpus file a synthetic desktop session is used.\n");
+}
+
+static BOOL bench_parse_size(const char* arg, unsigned long min, unsigned long max,
+                             unsigned long* value)
+{
+	char* end = NULL;
+
+	errno = 0;
+	*value = strtoul(arg, &end, 0);
+	return (errno == 0) && end && (*end == '\0') && (*value >= min) && (*value <= max);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int rc = 1;
+	BOOL json = FALSE;
+	const char* codecs = NULL;
+	const char* generate = NULL;
+	const char* import = NULL;
+	unsigned long iterations = 3;
+	unsigned long frames = 60;
+	UINT32 width = 1024;
+	UINT32 height = 768;
+	BENCH_CORPUS* corpus = NULL;
+
+	for (index = 1; index < argc; index++)
+	{
+		const char* arg = argv[index];
+
+		if (arg[0] != '-')
+			break;
+
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		else if (strcmp(arg, "-j") == 0)
+			json = TRUE;
+		else if (index + 1 >= argc)
+		{
+			fprintf(stderr, "missing argument for %s\n", arg);
+			return 1;
+		}
+		else if (strcmp(arg, "-c") == 0)
+			codecs = argv[++index];
+		else if (strcmp(arg, "-g") == 0)
+			generate = argv[++index];
+		else if (strcmp(arg, "-m") == 0)
+		{
+			import = argv[++index];
+			index++;
+			break;
+		}
+		else if (strcmp(arg, "-i") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, 100000, &iterations))
+			{
+				fprintf(stderr, "invalid iterations %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "-n") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, 100000, &frames))
+			{
+				fprintf(stderr, "invalid frame count %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "-s") == 0)
+		{
+			if ((sscanf(argv[++index], "%" PRIu32 "x%" PRIu32, &width, &height) != 2) ||
+			    (width < 64) || (height < 64) || (width > 8192) || (height > 8192))
+			{
+				fprintf(stderr, "invalid size %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (import)
+	{
+		if (!(corpus = bench_corpus_import(argc - index, &argv[index])))
+			return 1;
+
+		rc = bench_corpus_save(corpus, import) ? 0 : 1;
+		bench_corpus_free(corpus);
+		return rc;
+	}
+
+	if (generate || (index >= argc))
+	{
+		if (!(corpus = bench_corpus_generate(width, height, frames)))
+			return 1;
+
+		if (generate)
+			rc = bench_corpus_save(corpus, generate) ? 0 : 1;
+		else
+			rc = bench_run(corpus, codecs, iterations, json) ? 0 : 1;
+
+		bench_corpus_free(corpus);
+		return rc;
+	}
+
+	rc = 0;
+
+	for (; index < argc; index++)
+	{
+		if (!(corpus = bench_corpus_load(argv[index])))
+			return 1;
+
+		if (!bench_run(corpus, codecs, iterations, json))
+			rc = 1;
+
+		bench_corpus_free(corpus);
+	}
+
+	free(bench_scratch_buffer);
+	return rc;
+}
@@ -180,7 +180,7 @@ static INLINE UINT16 out_copy_count_3(UINT16 in_count, wStream* in_s, wStream* i
 			Stream_Write_UINT16(in_s, in_count);
 		}
 
-		Stream_Write(in_s, Stream_Pointer(in_data), in_count * 3);
+		Stream_Write(in_s, Stream_Buffer(in_data), in_count * 3);
 	}
 
 	Stream_SetPosition(in_data, 0);
@@ -559,15 +559,23 @@ static SSIZE_T freerdp_bitmap_compress_24(const void* srcData, UINT32 width, UIN
 				    bicolor_count >= color_count && bicolor_count >= mix_count &&
 				    bicolor_count >= fom_count)
 				{
-					if ((bicolor_count % 2) != 0)
-						bicolor_count--;
-
 					if (bicolor_count > count)
 						return -1;
 
-					count -= bicolor_count;
-					OUT_COPY_COUNT3(count, s, temp_s);
-					OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor2, bicolor1);
+					/* the run started with bicolor1, an odd run drops its first pixel */
+					if ((bicolor_count % 2) == 0)
+					{
+						count -= bicolor_count;
+						OUT_COPY_COUNT3(count, s, temp_s);
+						OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor1, bicolor2);
+					}
+					else
+					{
+						bicolor_count--;
+						count -= bicolor_count;
+						OUT_COPY_COUNT3(count, s, temp_s);
+						OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor2, bicolor1);
+					}
 					RESET_COUNTS;
 				}
 
@@ -728,22 +736,23 @@ static SSIZE_T freerdp_bitmap_compress_24(const void* srcData, UINT32 width, UIN
 	else if (bicolor_count > 3 && bicolor_count >= mix_count && bicolor_count >= color_count &&
 	         bicolor_count >= fill_count && bicolor_count >= fom_count)
 	{
-		if ((bicolor_count % 2) != 0)
-			bicolor_count--;
-
-		if (bicolor_count > count)
-			return -1;
-
-		count -= bicolor_count;
-		OUT_COPY_COUNT3(count, s, temp_s);
-		OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor2, bicolor1);
-
 		if (bicolor_count > count)
 			return -1;
 
-		count -= bicolor_count;
-		OUT_COPY_COUNT3(count, s, temp_s);
-		OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor1, bicolor2);
+		/* the run started with bicolor1, an odd run drops its first pixel */
+		if ((bicolor_count % 2) == 0)
+		{
+			count -= bicolor_count;
+			OUT_COPY_COUNT3(count, s, temp_s);
+			OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor1, bicolor2);
+		}
+		else
+		{
+			bicolor_count--;
+			count -= bicolor_count;
+			OUT_COPY_COUNT3(count, s, temp_s);
+			OUT_BICOLOR_COUNT3(bicolor_count, s, bicolor2, bicolor1);
+		}
 	}
 	else if (fom_count > 3 && fom_count >= mix_count && fom_count >= color_count &&
 	         fom_count >= fill_count && fom_count >= bicolor_count)
@@ -865,15 +874,23 @@ static SSIZE_T freerdp_bitmap_compress_16(const void* srcData, UINT32 width, UIN
 				    (bicolor_count >= color_count) && (bicolor_count >= mix_count) &&
 				    (bicolor_count >= fom_count))
 				{
-					if ((bicolor_count % 2) != 0)
-						bicolor_count--;
-
 					if (bicolor_count > count)
 						return -1;
 
-					count -= bicolor_count;
-					OUT_COPY_COUNT2(count, s, temp_s);
-					OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor2, bicolor1);
+					/* the run started with bicolor1, an odd run drops its first pixel */
+					if ((bicolor_count % 2) == 0)
+					{
+						count -= bicolor_count;
+						OUT_COPY_COUNT2(count, s, temp_s);
+						OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor1, bicolor2);
+					}
+					else
+					{
+						bicolor_count--;
+						count -= bicolor_count;
+						OUT_COPY_COUNT2(count, s, temp_s);
+						OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor2, bicolor1);
+					}
 					RESET_COUNTS;
 				}
 
@@ -1032,22 +1049,23 @@ static SSIZE_T freerdp_bitmap_compress_16(const void* srcData, UINT32 width, UIN
 	else if (bicolor_count > 3 && bicolor_count >= mix_count && bicolor_count >= color_count &&
 	         bicolor_count >= fill_count && bicolor_count >= fom_count)
 	{
-		if ((bicolor_count % 2) != 0)
-			bicolor_count--;
-
-		if (bicolor_count > count)
-			return -1;
-
-		count -= bicolor_count;
-		OUT_COPY_COUNT2(count, s, temp_s);
-		OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor2, bicolor1);
-
 		if (bicolor_count > count)
 			return -1;
 
-		count -= bicolor_count;
-		OUT_COPY_COUNT2(count, s, temp_s);
-		OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor1, bicolor2);
+		/* the run started with bicolor1, an odd run drops its first pixel */
+		if ((bicolor_count % 2) == 0)
+		{
+			count -= bicolor_count;
+			OUT_COPY_COUNT2(count, s, temp_s);
+			OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor1, bicolor2);
+		}
+		else
+		{
+			bicolor_count--;
+			count -= bicolor_count;
+			OUT_COPY_COUNT2(count, s, temp_s);
+			OUT_BICOLOR_COUNT2(bicolor_count, s, bicolor2, bicolor1);
+		}
 	}
 	else if (fom_count > 3 && fom_count >= mix_count && fom_count >= color_count &&
 	         fom_count >= fill_count && fom_count >= bicolor_count)
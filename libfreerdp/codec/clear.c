@@ -37,12 +37,21 @@
 
 #define CLEARCODEC_VBAR_SIZE 32768
 #define CLEARCODEC_VBAR_SHORT_SIZE 16384
+#define CLEARCODEC_GLYPH_SIZE 4000
+#define CLEARCODEC_GLYPH_LOOKUP_SIZE 4096
+#define CLEARCODEC_GLYPH_MAX_PIXELS 1024
+#define CLEARCODEC_LOOKUP_NIL 0xFFFF
+
+/* Encoder cell size, bands must not be higher than 52 pixels */
+#define CLEARCODEC_CELL_SIZE 32
+#define CLEARCODEC_PALETTE_SIZE 127
 
 typedef struct
 {
 	UINT32 size;
 	UINT32 count;
 	UINT32* pixels;
+	UINT32 hash;
 } CLEAR_GLYPH_ENTRY;
 
 typedef struct
@@ -50,8 +59,17 @@ typedef struct
 	UINT32 size;
 	UINT32 count;
 	BYTE* pixels;
+	UINT32 hash;
 } CLEAR_VBAR_ENTRY;
 
+typedef enum
+{
+	CLEAR_CELL_RESIDUAL,
+	CLEAR_CELL_BANDS,
+	CLEAR_CELL_RLEX,
+	CLEAR_CELL_COMPLEX
+} CLEAR_CELL_TYPE;
+
 struct S_CLEAR_CONTEXT
 {
 	BOOL Compressor;
@@ -67,6 +85,18 @@ struct S_CLEAR_CONTEXT
 	CLEAR_VBAR_ENTRY VBarStorage[CLEARCODEC_VBAR_SIZE];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[CLEARCODEC_VBAR_SHORT_SIZE];
+
+	/* encoder state */
+	BOOL CacheResetPending;
+	UINT32 GlyphCursor;
+	UINT16 GlyphLookup[CLEARCODEC_GLYPH_LOOKUP_SIZE];
+	UINT16 VBarLookup[CLEARCODEC_VBAR_SIZE];
+	UINT16 ShortVBarLookup[CLEARCODEC_VBAR_SHORT_SIZE];
+	UINT32* EncodePixels;
+	UINT32 EncodePixelsSize;
+	BYTE* CellTypes;
+	UINT32 CellTypesSize;
+	wStream* EncodeStream;
 };
 
 static const UINT32 CLEAR_LOG2_FLOOR[256] = {
@@ -1143,18 +1173,849 @@ fail:
 	return rc;
 }
 
-int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
-                   UINT32* pDstSize)
+static INLINE UINT32 clear_hash_pixels(const UINT32* pixels, UINT32 count)
+{
+	UINT32 i;
+	UINT32 hash = 2166136261U ^ count;
+
+	for (i = 0; i < count; i++)
+		hash = (hash ^ pixels[i]) * 16777619U;
+
+	return hash;
+}
+
+static INLINE void clear_write_color(wStream* s, UINT32 color)
+{
+	Stream_Write_UINT8(s, color & 0xFF);         /* blue */
+	Stream_Write_UINT8(s, (color >> 8) & 0xFF);  /* green */
+	Stream_Write_UINT8(s, (color >> 16) & 0xFF); /* red */
+}
+
+static INLINE UINT32 clear_run_length_size(UINT32 runLengthFactor)
+{
+	if (runLengthFactor < 0xFF)
+		return 1;
+
+	if (runLengthFactor < 0xFFFF)
+		return 3;
+
+	return 7;
+}
+
+static INLINE void clear_write_run_length(wStream* s, UINT32 runLengthFactor)
+{
+	if (runLengthFactor < 0xFF)
+	{
+		Stream_Write_UINT8(s, runLengthFactor);
+		return;
+	}
+
+	Stream_Write_UINT8(s, 0xFF);
+
+	if (runLengthFactor < 0xFFFF)
+	{
+		Stream_Write_UINT16(s, runLengthFactor);
+		return;
+	}
+
+	Stream_Write_UINT16(s, 0xFFFF);
+	Stream_Write_UINT32(s, runLengthFactor);
+}
+
+static BOOL clear_encode_resize(CLEAR_CONTEXT* clear, UINT32 nWidth, UINT32 nHeight)
+{
+	const UINT32 pixels = nWidth * nHeight;
+	const UINT32 cells = ((nWidth + CLEARCODEC_CELL_SIZE - 1) / CLEARCODEC_CELL_SIZE) *
+	                     ((nHeight + CLEARCODEC_CELL_SIZE - 1) / CLEARCODEC_CELL_SIZE);
+
+	if (pixels > clear->EncodePixelsSize)
+	{
+		UINT32* tmp = (UINT32*)realloc(clear->EncodePixels, pixels * sizeof(UINT32));
+
+		if (!tmp)
+			return FALSE;
+
+		clear->EncodePixels = tmp;
+		clear->EncodePixelsSize = pixels;
+	}
+
+	if (cells > clear->CellTypesSize)
+	{
+		BYTE* tmp = (BYTE*)realloc(clear->CellTypes, cells);
+
+		if (!tmp)
+			return FALSE;
+
+		clear->CellTypes = tmp;
+		clear->CellTypesSize = cells;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Collects the distinct colors of a rectangle in order of appearance.
+ * Returns the number of colors, or CLEARCODEC_PALETTE_SIZE + 1 if there are more.
+ * If indices is not NULL it receives the palette index of each pixel (row major).
+ */
+static UINT32 clear_build_palette(const UINT32* pixels, UINT32 nStep, UINT32 width, UINT32 height,
+                                  UINT32* palette, BYTE* indices, UINT32* counts)
+{
+	UINT32 x, y;
+	UINT32 count = 0;
+	UINT32 slotColor[256];
+	BYTE slotIndex[256];
+	BYTE slotUsed[256] = { 0 };
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT32* row = &pixels[y * nStep];
+
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 color = row[x];
+			UINT32 slot = (color * 2654435761U) >> 24;
+
+			while (slotUsed[slot] && (slotColor[slot] != color))
+				slot = (slot + 1) & 0xFF;
+
+			if (!slotUsed[slot])
+			{
+				if (count >= CLEARCODEC_PALETTE_SIZE)
+					return CLEARCODEC_PALETTE_SIZE + 1;
+
+				slotUsed[slot] = 1;
+				slotColor[slot] = color;
+				slotIndex[slot] = (BYTE)count;
+
+				if (palette)
+					palette[count] = color;
+
+				if (counts)
+					counts[count] = 0;
+
+				count++;
+			}
+
+			if (indices)
+				*indices++ = slotIndex[slot];
+
+			if (counts)
+				counts[slotIndex[slot]]++;
+		}
+	}
+
+	return count;
+}
+
+static INLINE const CLEAR_VBAR_ENTRY* clear_vbar_lookup(const CLEAR_VBAR_ENTRY* storage,
+                                                        const UINT16* lookup, UINT32 lookupSize,
+                                                        const UINT32* pixels, UINT32 count,
+                                                        UINT32 hash, UINT16* pIndex)
+{
+	const UINT16 index = lookup[hash % lookupSize];
+	const CLEAR_VBAR_ENTRY* entry;
+
+	if (index == CLEARCODEC_LOOKUP_NIL)
+		return NULL;
+
+	entry = &storage[index];
+
+	if ((entry->hash != hash) || (entry->count != count) || !entry->pixels)
+		return NULL;
+
+	if (memcmp(entry->pixels, pixels, count * sizeof(UINT32)) != 0)
+		return NULL;
+
+	*pIndex = index;
+	return entry;
+}
+
+static BOOL clear_vbar_store(CLEAR_CONTEXT* clear, CLEAR_VBAR_ENTRY* entry, UINT16* lookup,
+                             UINT32 lookupSize, UINT32 index, const UINT32* pixels, UINT32 count,
+                             UINT32 hash)
+{
+	entry->count = count;
+
+	if (!resize_vbar_entry(clear, entry))
+		return FALSE;
+
+	if (count > 0)
+		CopyMemory(entry->pixels, pixels, count * sizeof(UINT32));
+
+	entry->hash = hash;
+	lookup[hash % lookupSize] = (UINT16)index;
+	return TRUE;
+}
+
+static INLINE void clear_get_vbar(const UINT32* pixels, UINT32 nStep, UINT32 height, UINT32 bkg,
+                                  UINT32* column, UINT32* pYOn, UINT32* pYOff)
+{
+	UINT32 y;
+	UINT32 yOn = height;
+	UINT32 yOff = 0;
+
+	for (y = 0; y < height; y++)
+	{
+		column[y] = pixels[y * nStep];
+
+		if (column[y] != bkg)
+		{
+			if (yOn == height)
+				yOn = y;
+
+			yOff = y + 1;
+		}
+	}
+
+	if (yOn == height)
+		yOn = yOff = 0;
+
+	*pYOn = yOn;
+	*pYOff = yOff;
+}
+
+static UINT32 clear_background_color(const UINT32* pixels, UINT32 nStep, UINT32 width,
+                                     UINT32 height)
+{
+	UINT32 i;
+	UINT32 best = 0;
+	UINT32 palette[CLEARCODEC_PALETTE_SIZE];
+	UINT32 counts[CLEARCODEC_PALETTE_SIZE];
+	const UINT32 count =
+	    clear_build_palette(pixels, nStep, width, height, palette, NULL, counts);
+
+	if (count > CLEARCODEC_PALETTE_SIZE)
+		return pixels[0];
+
+	for (i = 1; i < count; i++)
+	{
+		if (counts[i] > counts[best])
+			best = i;
+	}
+
+	return palette[best];
+}
+
+static UINT32 clear_estimate_bands(const CLEAR_CONTEXT* clear, const UINT32* pixels, UINT32 nStep,
+                                   UINT32 width, UINT32 height)
+{
+	UINT32 x, i;
+	UINT32 size = 11;
+	UINT32 column[CLEARCODEC_CELL_SIZE];
+	UINT32 hashes[CLEARCODEC_CELL_SIZE];
+	const UINT32 bkg = clear_background_color(pixels, nStep, width, height);
+
+	for (x = 0; x < width; x++)
+	{
+		UINT16 index;
+		UINT32 yOn, yOff;
+		clear_get_vbar(&pixels[x], nStep, height, bkg, column, &yOn, &yOff);
+		hashes[x] = clear_hash_pixels(column, height);
+
+		/* columns repeated within the cell will be vBar cache hits as well */
+		for (i = 0; i < x; i++)
+		{
+			if (hashes[i] == hashes[x])
+				break;
+		}
+
+		if ((i < x) || clear_vbar_lookup(clear->VBarStorage, clear->VBarLookup,
+		                                 CLEARCODEC_VBAR_SIZE, column, height, hashes[x], &index))
+			size += 2;
+		else if (clear_vbar_lookup(clear->ShortVBarStorage, clear->ShortVBarLookup,
+		                           CLEARCODEC_VBAR_SHORT_SIZE, &column[yOn], yOff - yOn,
+		                           clear_hash_pixels(&column[yOn], yOff - yOn), &index))
+			size += 3;
+		else
+			size += 2 + (yOff - yOn) * 3;
+	}
+
+	return size;
+}
+
+static UINT32 clear_estimate_residual(const UINT32* pixels, UINT32 nStep, UINT32 width,
+                                      UINT32 height)
+{
+	UINT32 x, y;
+	UINT32 runs = 0;
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT32* row = &pixels[y * nStep];
+		runs++;
+
+		for (x = 1; x < width; x++)
+		{
+			if (row[x] != row[x - 1])
+				runs++;
+		}
+	}
+
+	return runs * 4;
+}
+
+static UINT32 clear_estimate_rlex(const BYTE* indices, UINT32 pixelCount, UINT32 paletteCount)
+{
+	UINT32 i = 0;
+	UINT32 size = 13 + 1 + paletteCount * 3;
+
+	while (i < pixelCount)
+	{
+		UINT32 run = 1;
+
+		while ((i + run < pixelCount) && (indices[i + run] == indices[i]))
+			run++;
+
+		size += 1 + clear_run_length_size(run - 1);
+		i += run;
+	}
+
+	return size;
+}
+
+static CLEAR_CELL_TYPE clear_classify_cell(const CLEAR_CONTEXT* clear, const UINT32* pixels,
+                                           UINT32 nStep, UINT32 width, UINT32 height)
+{
+	BYTE indices[CLEARCODEC_CELL_SIZE * CLEARCODEC_CELL_SIZE];
+	CLEAR_CELL_TYPE type = CLEAR_CELL_RESIDUAL;
+	UINT32 best;
+	UINT32 size;
+	const UINT32 colors =
+	    clear_build_palette(pixels, nStep, width, height, NULL, indices, NULL);
+
+	if (colors == 1)
+		return CLEAR_CELL_RESIDUAL;
+
+	best = clear_estimate_residual(pixels, nStep, width, height);
+
+	if (colors <= CLEARCODEC_PALETTE_SIZE)
+	{
+		size = clear_estimate_rlex(indices, width * height, colors);
+
+		if (size < best)
+		{
+			best = size;
+			type = CLEAR_CELL_RLEX;
+		}
+	}
+	else
+	{
+		size = 13 + width * height * 3;
+
+		if (size < best)
+		{
+			best = size;
+			type = CLEAR_CELL_COMPLEX;
+		}
+	}
+
+	size = clear_estimate_bands(clear, pixels, nStep, width, height);
+
+	if (size < best)
+		type = CLEAR_CELL_BANDS;
+
+	return type;
+}
+
+static BOOL clear_encode_residual_data(CLEAR_CONTEXT* clear, wStream* s, UINT32 nWidth,
+                                       UINT32 nHeight, UINT32 cellsPerRow)
+{
+	UINT32 x, y;
+	UINT32 run = 0;
+	UINT32 color = clear->EncodePixels[0];
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const UINT32* row = &clear->EncodePixels[y * nWidth];
+		const BYTE* types = &clear->CellTypes[(y / CLEARCODEC_CELL_SIZE) * cellsPerRow];
+
+		for (x = 0; x < nWidth; x++)
+		{
+			/* pixels covered by bands or subcodecs just extend the current run */
+			if ((types[x / CLEARCODEC_CELL_SIZE] == CLEAR_CELL_RESIDUAL) && (row[x] != color))
+			{
+				if (run > 0)
+				{
+					if (!Stream_EnsureRemainingCapacity(s, 10))
+						return FALSE;
+
+					clear_write_color(s, color);
+					clear_write_run_length(s, run);
+				}
+
+				color = row[x];
+				run = 0;
+			}
+
+			run++;
+		}
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 10))
+		return FALSE;
+
+	clear_write_color(s, color);
+	clear_write_run_length(s, run);
+	return TRUE;
+}
+
+static BOOL clear_encode_band(CLEAR_CONTEXT* clear, wStream* s, const UINT32* pixels, UINT32 nStep,
+                              UINT32 xStart, UINT32 yStart, UINT32 width, UINT32 height)
+{
+	UINT32 x;
+	UINT32 column[CLEARCODEC_CELL_SIZE];
+	const UINT32 bkg = clear_background_color(pixels, nStep, width, height);
+
+	if (!Stream_EnsureRemainingCapacity(s, 11 + width * (2 + height * 3)))
+		return FALSE;
+
+	Stream_Write_UINT16(s, xStart);
+	Stream_Write_UINT16(s, xStart + width - 1);
+	Stream_Write_UINT16(s, yStart);
+	Stream_Write_UINT16(s, yStart + height - 1);
+	clear_write_color(s, bkg);
+
+	for (x = 0; x < width; x++)
+	{
+		UINT16 index;
+		UINT32 yOn, yOff;
+		UINT32 hash;
+		const UINT32 cursor = clear->VBarStorageCursor;
+		clear_get_vbar(&pixels[x], nStep, height, bkg, column, &yOn, &yOff);
+		hash = clear_hash_pixels(column, height);
+
+		if (clear_vbar_lookup(clear->VBarStorage, clear->VBarLookup, CLEARCODEC_VBAR_SIZE, column,
+		                      height, hash, &index))
+		{
+			Stream_Write_UINT16(s, 0x8000 | index); /* VBAR_CACHE_HIT */
+			continue;
+		}
+		else
+		{
+			const UINT32 shortCount = yOff - yOn;
+			const UINT32 shortHash = clear_hash_pixels(&column[yOn], shortCount);
+
+			if (clear_vbar_lookup(clear->ShortVBarStorage, clear->ShortVBarLookup,
+			                      CLEARCODEC_VBAR_SHORT_SIZE, &column[yOn], shortCount, shortHash,
+			                      &index))
+			{
+				Stream_Write_UINT16(s, 0x4000 | index); /* SHORT_VBAR_CACHE_HIT */
+				Stream_Write_UINT8(s, yOn);
+			}
+			else
+			{
+				UINT32 y;
+				const UINT32 shortCursor = clear->ShortVBarStorageCursor;
+				Stream_Write_UINT16(s, (yOff << 8) | yOn); /* SHORT_VBAR_CACHE_MISS */
+
+				for (y = yOn; y < yOff; y++)
+					clear_write_color(s, column[y]);
+
+				if (!clear_vbar_store(clear, &clear->ShortVBarStorage[shortCursor],
+				                      clear->ShortVBarLookup, CLEARCODEC_VBAR_SHORT_SIZE,
+				                      shortCursor, &column[yOn], shortCount, shortHash))
+					return FALSE;
+
+				clear->ShortVBarStorageCursor = (shortCursor + 1) % CLEARCODEC_VBAR_SHORT_SIZE;
+			}
+		}
+
+		/* the decoder builds a new full vBar for every short vBar it processes */
+		if (!clear_vbar_store(clear, &clear->VBarStorage[cursor], clear->VBarLookup,
+		                      CLEARCODEC_VBAR_SIZE, cursor, column, height, hash))
+			return FALSE;
+
+		clear->VBarStorageCursor = (cursor + 1) % CLEARCODEC_VBAR_SIZE;
+	}
+
+	return TRUE;
+}
+
+static BOOL clear_encode_subcodec_rlex(wStream* s, const UINT32* pixels, UINT32 nStep,
+                                       UINT32 width, UINT32 height)
+{
+	UINT32 i = 0;
+	UINT32 numBits;
+	UINT32 maxDepth;
+	UINT32 paletteCount;
+	UINT32 palette[CLEARCODEC_PALETTE_SIZE];
+	BYTE indices[CLEARCODEC_CELL_SIZE * CLEARCODEC_CELL_SIZE];
+	const UINT32 pixelCount = width * height;
+
+	paletteCount = clear_build_palette(pixels, nStep, width, height, palette, indices, NULL);
+
+	if (paletteCount > CLEARCODEC_PALETTE_SIZE)
+		return FALSE;
+
+	numBits = CLEAR_LOG2_FLOOR[paletteCount - 1] + 1;
+	maxDepth = CLEAR_8BIT_MASKS[8 - numBits];
+
+	if (!Stream_EnsureRemainingCapacity(s, 1 + paletteCount * 3 + pixelCount * 2))
+		return FALSE;
+
+	Stream_Write_UINT8(s, paletteCount);
+
+	for (i = 0; i < paletteCount; i++)
+		clear_write_color(s, palette[i]);
+
+	i = 0;
+
+	while (i < pixelCount)
+	{
+		UINT32 run = 1;
+		UINT32 depth = 0;
+		UINT32 suite;
+		const BYTE startIndex = indices[i];
+
+		while ((i + run < pixelCount) && (indices[i + run] == startIndex))
+			run++;
+
+		/* the last pixel of the run starts the suite */
+		suite = i + run - 1;
+
+		while ((depth < maxDepth) && (suite + depth + 1 < pixelCount) &&
+		       (indices[suite + depth + 1] == startIndex + depth + 1))
+			depth++;
+
+		Stream_Write_UINT8(s, (depth << numBits) | (startIndex + depth));
+		clear_write_run_length(s, run - 1);
+		i = suite + depth + 1;
+	}
+
+	return TRUE;
+}
+
+static BOOL clear_encode_subcodec_nsc(CLEAR_CONTEXT* clear, wStream* s, const UINT32* pixels,
+                                      UINT32 nStep, UINT32 width, UINT32 height)
+{
+	UINT32 x, y;
+	const UINT32 nDstStep = width * 4;
+
+	if (!clear_resize_buffer(clear, width, height))
+		return FALSE;
+
+	/* The NSCodec encoder consumes bottom-up BGRX32 bitmaps */
+	for (y = 0; y < height; y++)
+	{
+		BYTE* dst = &clear->TempBuffer[(height - 1 - y) * nDstStep];
+
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 color = pixels[y * nStep + x];
+			*dst++ = color & 0xFF;
+			*dst++ = (color >> 8) & 0xFF;
+			*dst++ = (color >> 16) & 0xFF;
+			*dst++ = 0xFF;
+		}
+	}
+
+	return nsc_compose_message(clear->nsc, s, clear->TempBuffer, width, height, nDstStep);
+}
+
+static BOOL clear_encode_subcodec(CLEAR_CONTEXT* clear, wStream* s, CLEAR_CELL_TYPE type,
+                                  const UINT32* pixels, UINT32 nStep, UINT32 xStart, UINT32 yStart,
+                                  UINT32 width, UINT32 height)
+{
+	size_t start;
+	size_t end;
+	BYTE subcodecId;
+
+	if (!Stream_EnsureRemainingCapacity(s, 13))
+		return FALSE;
+
+	Stream_Write_UINT16(s, xStart);
+	Stream_Write_UINT16(s, yStart);
+	Stream_Write_UINT16(s, width);
+	Stream_Write_UINT16(s, height);
+	Stream_Seek(s, 5); /* bitmapDataByteCount and subcodecId, filled below */
+	start = Stream_GetPosition(s);
+
+	if (type == CLEAR_CELL_RLEX)
+	{
+		subcodecId = 2; /* CLEARCODEC_SUBCODEC_RLEX */
+
+		if (!clear_encode_subcodec_rlex(s, pixels, nStep, width, height))
+			return FALSE;
+	}
+	else
+	{
+		subcodecId = 1; /* NSCodec */
+
+		if (!clear_encode_subcodec_nsc(clear, s, pixels, nStep, width, height))
+			return FALSE;
+
+		/* fall back to uncompressed pixels if NSCodec does not pay off */
+		if (Stream_GetPosition(s) - start >= width * height * 3ULL)
+		{
+			UINT32 x, y;
+			subcodecId = 0; /* Uncompressed */
+			Stream_SetPosition(s, start);
+
+			if (!Stream_EnsureRemainingCapacity(s, width * height * 3ULL))
+				return FALSE;
+
+			for (y = 0; y < height; y++)
+			{
+				for (x = 0; x < width; x++)
+					clear_write_color(s, pixels[y * nStep + x]);
+			}
+		}
+	}
+
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start - 5);
+	Stream_Write_UINT32(s, (UINT32)(end - start)); /* bitmapDataByteCount (4 bytes) */
+	Stream_Write_UINT8(s, subcodecId);              /* subcodecId (1 byte) */
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
+static BOOL clear_encode_composition(CLEAR_CONTEXT* clear, wStream* s, UINT32 nWidth,
+                                     UINT32 nHeight)
+{
+	UINT32 x, y;
+	size_t header;
+	size_t start;
+	UINT32 residualByteCount = 0;
+	UINT32 bandsByteCount;
+	UINT32 subcodecByteCount;
+	BOOL residual = FALSE;
+	const UINT32 cellsPerRow = (nWidth + CLEARCODEC_CELL_SIZE - 1) / CLEARCODEC_CELL_SIZE;
+	const UINT32 cellsPerColumn = (nHeight + CLEARCODEC_CELL_SIZE - 1) / CLEARCODEC_CELL_SIZE;
+
+	for (y = 0; y < cellsPerColumn; y++)
+	{
+		for (x = 0; x < cellsPerRow; x++)
+		{
+			const UINT32 cx = x * CLEARCODEC_CELL_SIZE;
+			const UINT32 cy = y * CLEARCODEC_CELL_SIZE;
+			const CLEAR_CELL_TYPE type = clear_classify_cell(
+			    clear, &clear->EncodePixels[cy * nWidth + cx], nWidth,
+			    MIN(CLEARCODEC_CELL_SIZE, nWidth - cx), MIN(CLEARCODEC_CELL_SIZE, nHeight - cy));
+			clear->CellTypes[y * cellsPerRow + x] = (BYTE)type;
+
+			if (type == CLEAR_CELL_RESIDUAL)
+				residual = TRUE;
+		}
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 12))
+		return FALSE;
+
+	header = Stream_GetPosition(s);
+	Stream_Seek(s, 12);
+	start = Stream_GetPosition(s);
+
+	if (residual)
+	{
+		if (!clear_encode_residual_data(clear, s, nWidth, nHeight, cellsPerRow))
+			return FALSE;
+
+		residualByteCount = (UINT32)(Stream_GetPosition(s) - start);
+	}
+
+	start = Stream_GetPosition(s);
+
+	for (y = 0; y < cellsPerColumn; y++)
+	{
+		for (x = 0; x < cellsPerRow; x++)
+		{
+			const UINT32 cx = x * CLEARCODEC_CELL_SIZE;
+			const UINT32 cy = y * CLEARCODEC_CELL_SIZE;
+
+			if (clear->CellTypes[y * cellsPerRow + x] != CLEAR_CELL_BANDS)
+				continue;
+
+			if (!clear_encode_band(clear, s, &clear->EncodePixels[cy * nWidth + cx], nWidth, cx,
+			                       cy, MIN(CLEARCODEC_CELL_SIZE, nWidth - cx),
+			                       MIN(CLEARCODEC_CELL_SIZE, nHeight - cy)))
+				return FALSE;
+		}
+	}
+
+	bandsByteCount = (UINT32)(Stream_GetPosition(s) - start);
+	start = Stream_GetPosition(s);
+
+	for (y = 0; y < cellsPerColumn; y++)
+	{
+		for (x = 0; x < cellsPerRow; x++)
+		{
+			const UINT32 cx = x * CLEARCODEC_CELL_SIZE;
+			const UINT32 cy = y * CLEARCODEC_CELL_SIZE;
+			const CLEAR_CELL_TYPE type = (CLEAR_CELL_TYPE)clear->CellTypes[y * cellsPerRow + x];
+
+			if ((type != CLEAR_CELL_RLEX) && (type != CLEAR_CELL_COMPLEX))
+				continue;
+
+			if (!clear_encode_subcodec(clear, s, type, &clear->EncodePixels[cy * nWidth + cx],
+			                           nWidth, cx, cy, MIN(CLEARCODEC_CELL_SIZE, nWidth - cx),
+			                           MIN(CLEARCODEC_CELL_SIZE, nHeight - cy)))
+				return FALSE;
+		}
+	}
+
+	subcodecByteCount = (UINT32)(Stream_GetPosition(s) - start);
+	start = Stream_GetPosition(s);
+	Stream_SetPosition(s, header);
+	Stream_Write_UINT32(s, residualByteCount);
+	Stream_Write_UINT32(s, bandsByteCount);
+	Stream_Write_UINT32(s, subcodecByteCount);
+	Stream_SetPosition(s, start);
+	return TRUE;
+}
+
+static INLINE INT32 clear_glyph_lookup(const CLEAR_CONTEXT* clear, const UINT32* pixels,
+                                       UINT32 count, UINT32 hash)
 {
-	WLog_ERR(TAG, "TODO: %s not implemented!", __FUNCTION__);
+	const UINT16 index = clear->GlyphLookup[hash % CLEARCODEC_GLYPH_LOOKUP_SIZE];
+	const CLEAR_GLYPH_ENTRY* glyphEntry;
+
+	if (index == CLEARCODEC_LOOKUP_NIL)
+		return -1;
+
+	glyphEntry = &clear->GlyphCache[index];
+
+	if ((glyphEntry->hash != hash) || (glyphEntry->count != count) || !glyphEntry->pixels)
+		return -1;
+
+	if (memcmp(glyphEntry->pixels, pixels, count * sizeof(UINT32)) != 0)
+		return -1;
+
+	return index;
+}
+
+static BOOL clear_glyph_store(CLEAR_CONTEXT* clear, UINT32 glyphIndex, const UINT32* pixels,
+                              UINT32 count, UINT32 hash)
+{
+	CLEAR_GLYPH_ENTRY* glyphEntry = &clear->GlyphCache[glyphIndex];
+
+	if (count > glyphEntry->size)
+	{
+		UINT32* tmp = (UINT32*)realloc(glyphEntry->pixels, count * sizeof(UINT32));
+
+		if (!tmp)
+			return FALSE;
+
+		glyphEntry->pixels = tmp;
+		glyphEntry->size = count;
+	}
+
+	glyphEntry->count = count;
+	glyphEntry->hash = hash;
+	CopyMemory(glyphEntry->pixels, pixels, count * sizeof(UINT32));
+	clear->GlyphLookup[hash % CLEARCODEC_GLYPH_LOOKUP_SIZE] = (UINT16)glyphIndex;
+	return TRUE;
+}
+
+int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcFormat, UINT32 nSrcStep,
+                   UINT32 nWidth, UINT32 nHeight, BYTE** ppDstData, UINT32* pDstSize)
+{
+	UINT32 i;
+	UINT32 hash = 0;
+	UINT32 glyphIndex = 0;
+	BYTE glyphFlags = 0;
+	BOOL glyph = FALSE;
+	wStream* s;
+	UINT32 pixelCount;
+
+	if (!clear || !clear->Compressor || !pSrcData || !ppDstData || !pDstSize)
+		return -1;
+
+	if ((nWidth == 0) || (nHeight == 0) || (nWidth > 0xFFFF) || (nHeight > 0xFFFF))
+		return -1;
+
+	if (nSrcStep == 0)
+		nSrcStep = nWidth * GetBytesPerPixel(SrcFormat);
+
+	pixelCount = nWidth * nHeight;
+
+	if (!clear_encode_resize(clear, nWidth, nHeight))
+		return -1;
+
+	if (!freerdp_image_copy((BYTE*)clear->EncodePixels, PIXEL_FORMAT_BGRX32, nWidth * 4, 0, 0,
+	                        nWidth, nHeight, pSrcData, SrcFormat, nSrcStep, 0, 0, NULL,
+	                        FREERDP_FLIP_NONE))
+		return -1;
+
+	/* work on 0x00RRGGBB values, ClearCodec does not transport alpha */
+	for (i = 0; i < pixelCount; i++)
+	{
+		const BYTE* pixel = (const BYTE*)&clear->EncodePixels[i];
+		clear->EncodePixels[i] = ((UINT32)pixel[2] << 16) | ((UINT32)pixel[1] << 8) | pixel[0];
+	}
+
+	s = clear->EncodeStream;
+	Stream_SetPosition(s, 0);
+
+	if (!Stream_EnsureRemainingCapacity(s, 4))
+		return -1;
+
+	if (clear->CacheResetPending)
+	{
+		glyphFlags |= CLEARCODEC_FLAG_CACHE_RESET;
+		clear->VBarStorageCursor = 0;
+		clear->ShortVBarStorageCursor = 0;
+		clear->CacheResetPending = FALSE;
+	}
+
+	if (pixelCount <= CLEARCODEC_GLYPH_MAX_PIXELS)
+	{
+		INT32 hit;
+		hash = clear_hash_pixels(clear->EncodePixels, pixelCount);
+		hit = clear_glyph_lookup(clear, clear->EncodePixels, pixelCount, hash);
+		glyph = TRUE;
+
+		if (hit >= 0)
+		{
+			Stream_Write_UINT8(s, glyphFlags | CLEARCODEC_FLAG_GLYPH_INDEX |
+			                          CLEARCODEC_FLAG_GLYPH_HIT);
+			Stream_Write_UINT8(s, clear->seqNumber);
+			Stream_Write_UINT16(s, (UINT16)hit);
+			goto out;
+		}
+
+		glyphIndex = clear->GlyphCursor;
+		clear->GlyphCursor = (clear->GlyphCursor + 1) % CLEARCODEC_GLYPH_SIZE;
+		glyphFlags |= CLEARCODEC_FLAG_GLYPH_INDEX;
+	}
+
+	Stream_Write_UINT8(s, glyphFlags);
+	Stream_Write_UINT8(s, clear->seqNumber);
+
+	if (glyph)
+		Stream_Write_UINT16(s, glyphIndex);
+
+	if (!clear_encode_composition(clear, s, nWidth, nHeight))
+		return -1;
+
+	if (glyph && !clear_glyph_store(clear, glyphIndex, clear->EncodePixels, pixelCount, hash))
+		return -1;
+
+out:
+	clear->seqNumber = (clear->seqNumber + 1) % 256;
+	Stream_SealLength(s);
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = (UINT32)Stream_GetPosition(s);
 	return 1;
 }
+
 BOOL clear_context_reset(CLEAR_CONTEXT* clear)
 {
 	if (!clear)
 		return FALSE;
 
 	clear->seqNumber = 0;
+
+	if (clear->Compressor)
+	{
+		clear->CacheResetPending = TRUE;
+		clear->GlyphCursor = 0;
+		FillMemory(clear->GlyphLookup, sizeof(clear->GlyphLookup), 0xFF);
+		FillMemory(clear->VBarLookup, sizeof(clear->VBarLookup), 0xFF);
+		FillMemory(clear->ShortVBarLookup, sizeof(clear->ShortVBarLookup), 0xFF);
+	}
+
 	return TRUE;
 }
 CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
@@ -1180,6 +2041,14 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear->TempBuffer)
 		goto error_nsc;
 
+	if (Compressor)
+	{
+		clear->EncodeStream = Stream_New(NULL, 4096);
+
+		if (!clear->EncodeStream)
+			goto error_nsc;
+	}
+
 	if (!clear_context_reset(clear))
 		goto error_nsc;
 
@@ -1197,6 +2066,9 @@ void clear_context_free(CLEAR_CONTEXT* clear)
 
 	nsc_context_free(clear->nsc);
 	free(clear->TempBuffer);
+	free(clear->EncodePixels);
+	free(clear->CellTypes);
+	Stream_Free(clear->EncodeStream, TRUE);
 
 	for (i = 0; i < 4000; i++)
 		free(clear->GlyphCache[i].pixels);
@@ -26,6 +26,9 @@
 #include <stdlib.h>
 
 #include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/freerdp.h>
@@ -41,6 +44,74 @@
 
 #define TAG FREERDP_TAG("color")
 
+#if defined(WITH_SSE2)
+#include "color_sse2.h"
+#include "color_ssse3.h"
+#endif
+
+/* Copies of at least this many bytes are split in bands */
+#define IMAGE_COPY_PARALLEL_THRESHOLD (4 * 1024 * 1024)
+#define IMAGE_COPY_MIN_BAND_SIZE (1024 * 1024)
+#define IMAGE_COPY_MAX_BANDS 16
+
+#define IMAGE_CONVERT_NONE 0xFF
+
+/* Byte level description of a conversion between two formats. Destination byte i is
+ * source byte index[i] masked with keep[i] and ORed with value[i], shuffle and fill
+ * repeat that for 4 pixels. */
+typedef struct image_convert image_convert;
+typedef void (*image_convert_fn)(const image_convert* conv, BYTE* pDst, const BYTE* pSrc,
+                                 UINT32 x, UINT32 width);
+
+struct image_convert
+{
+	BOOL valid;
+	BOOL rgb16;
+	BOOL ssse3;
+	DWORD dstFormat;
+	const primitives_t* prims;
+	UINT32 srcBytes;
+	UINT32 dstBytes;
+	BYTE index[4];
+	BYTE keep[4];
+	BYTE value[4];
+	BYTE shuffle[16];
+	BYTE fill[16];
+	image_convert_fn scalar;
+};
+
+typedef struct
+{
+	BYTE* pDstData;
+	DWORD DstFormat;
+	UINT32 nDstStep;
+	UINT32 nXDst;
+	UINT32 nYDst;
+	UINT32 nWidth;
+	const BYTE* pSrcData;
+	DWORD SrcFormat;
+	UINT32 nSrcStep;
+	UINT32 nXSrc;
+	UINT32 nYSrc;
+	UINT32 srcVOffset;
+	INT32 srcVMultiplier;
+	const gdiPalette* palette;
+	const image_convert* convert;
+	BOOL stream;
+	UINT32 y;
+	UINT32 lines;
+} image_copy_band;
+
+static size_t image_copy_parallel_threshold = IMAGE_COPY_PARALLEL_THRESHOLD;
+static INIT_ONCE image_copy_pool_once = INIT_ONCE_STATIC_INIT;
+static PTP_POOL image_copy_pool = NULL;
+static TP_CALLBACK_ENVIRON image_copy_pool_env;
+static DWORD image_copy_pool_threads = 0;
+#if defined(WITH_SSE2)
+static INIT_ONCE image_convert_once = INIT_ONCE_STATIC_INIT;
+static BOOL image_convert_have_ssse3 = FALSE;
+#endif
+
 BYTE* freerdp_glyph_convert(UINT32 width, UINT32 height, const BYTE* data)
 {
 	UINT32 x, y;
@@ -453,6 +524,35 @@ static BOOL freerdp_image_copy_from_pointer_data_xbpp(BYTE* pDstData, UINT32 Dst
 			xorBits = &xorMask[xorStep * (nHeight - y - 1)];
 		}
 
+		if (xorBpp == 32)
+		{
+			/* convert the row at once, only pixels with the AND bit set need another look */
+			if (!freerdp_image_copy(pDstPixel, DstFormat, 0, 0, 0, nWidth, 1, xorBits,
+			                        PIXEL_FORMAT_BGRA32, 0, 0, 0, palette, FREERDP_FLIP_NONE))
+				return FALSE;
+
+			for (x = 0; andBits && (x < nWidth); x++)
+			{
+				if (!(andBits[x / 8] & (0x80 >> (x % 8))))
+					continue;
+
+				xorPixel = FreeRDPConvertColor(ReadColor(&xorBits[x * 4], PIXEL_FORMAT_BGRA32),
+				                               PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_ARGB32, palette);
+
+				if (xorPixel == 0xFF000000) /* black -> transparent */
+					xorPixel = 0x00000000;
+				else if (xorPixel == 0xFFFFFFFF) /* white -> inverted */
+					xorPixel = freerdp_image_inverted_pointer_color(x, y, PIXEL_FORMAT_ARGB32);
+				else
+					continue;
+
+				WriteColor(&pDstPixel[x * GetBytesPerPixel(DstFormat)], DstFormat,
+				           FreeRDPConvertColor(xorPixel, PIXEL_FORMAT_ARGB32, DstFormat, palette));
+			}
+
+			continue;
+		}
+
 		for (x = 0; x < nWidth; x++)
 		{
 			UINT32 pixelFormat;
@@ -583,6 +683,405 @@ static INLINE BOOL overlapping(const BYTE* pDstData, UINT32 nXDst, UINT32 nYDst,
 	return FALSE;
 }
 
+#if defined(WITH_SSE2)
+static BOOL CALLBACK image_convert_init_once(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	image_convert_have_ssse3 = IsProcessorFeaturePresentEx(PF_EX_SSSE3);
+	return TRUE;
+}
+#endif
+
+static void image_convert_set_layout(BYTE layout[4], BYTE r, BYTE g, BYTE b, BYTE a)
+{
+	layout[0] = r;
+	layout[1] = g;
+	layout[2] = b;
+	layout[3] = a;
+}
+
+/* Byte offsets of red, green, blue and alpha of a pixel in memory */
+static BOOL image_convert_get_layout(DWORD format, BYTE layout[4])
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			image_convert_set_layout(layout, 1, 2, 3, 0);
+			return TRUE;
+
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			image_convert_set_layout(layout, 3, 2, 1, 0);
+			return TRUE;
+
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			image_convert_set_layout(layout, 0, 1, 2, 3);
+			return TRUE;
+
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			image_convert_set_layout(layout, 2, 1, 0, 3);
+			return TRUE;
+
+		case PIXEL_FORMAT_RGB24:
+			image_convert_set_layout(layout, 0, 1, 2, IMAGE_CONVERT_NONE);
+			return TRUE;
+
+		case PIXEL_FORMAT_BGR24:
+			image_convert_set_layout(layout, 2, 1, 0, IMAGE_CONVERT_NONE);
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/* Builds the byte mapping of a conversion once per copy. The alpha rules follow
+ * FreeRDPConvertColor: formats without alpha read as 0xFF, XRGB32 and XBGR32 store 0. */
+/* The scalar converters, specialized for the pixel sizes so the byte loops unroll */
+#define IMAGE_CONVERT_SCALAR(_name, _srcBytes, _dstBytes)                                 \
+	static void _name(const image_convert* conv, BYTE* pDst, const BYTE* pSrc, UINT32 x, \
+	                  UINT32 width)                                                      \
+	{                                                                                    \
+		size_t i;                                                                        \
+		for (; x < width; x++)                                                           \
+		{                                                                                \
+			const BYTE* src = &pSrc[x * (_srcBytes)];                                    \
+			BYTE* dst = &pDst[x * (_dstBytes)];                                          \
+			for (i = 0; i < (_dstBytes); i++)                                            \
+				dst[i] = (src[conv->index[i]] & conv->keep[i]) | conv->value[i];         \
+		}                                                                                \
+	}
+
+IMAGE_CONVERT_SCALAR(image_convert_32_to_32, 4, 4)
+IMAGE_CONVERT_SCALAR(image_convert_32_to_24, 4, 3)
+IMAGE_CONVERT_SCALAR(image_convert_24_to_32, 3, 4)
+IMAGE_CONVERT_SCALAR(image_convert_24_to_24, 3, 3)
+
+static void image_convert_RGB16(const image_convert* conv, BYTE* pDst, const BYTE* pSrc,
+                                UINT32 x, UINT32 width)
+{
+	size_t i;
+
+	for (; x < width; x++)
+	{
+		BYTE src[4];
+		BYTE* dst = &pDst[x * conv->dstBytes];
+		const UINT32 color = ((UINT32)pSrc[x * 2 + 1] << 8) | pSrc[x * 2];
+		const UINT32 r = (color >> 11) & 0x1F;
+		const UINT32 g = (color >> 5) & 0x3F;
+		const UINT32 b = color & 0x1F;
+
+		/* the same expansion as SplitColor */
+		src[0] = (BYTE)((b << 3) + b / 4);
+		src[1] = (BYTE)MIN((g << 2) + g / 4 / 2, 255);
+		src[2] = (BYTE)((r << 3) + r / 4);
+		src[3] = 0xFF;
+
+		for (i = 0; i < conv->dstBytes; i++)
+			dst[i] = (src[conv->index[i]] & conv->keep[i]) | conv->value[i];
+	}
+}
+
+static void image_convert_init(image_convert* conv, DWORD SrcFormat, DWORD DstFormat)
+{
+	size_t c, p, i;
+	BYTE src[4] = { 0 };
+	BYTE dst[4] = { 0 };
+
+	memset(conv, 0, sizeof(image_convert));
+
+	/* RGB16 pixels are expanded to B, G, R, 0xFF first */
+	if (SrcFormat == PIXEL_FORMAT_RGB16)
+	{
+		conv->rgb16 = TRUE;
+		image_convert_get_layout(PIXEL_FORMAT_BGRA32, src);
+	}
+	else if ((GetBitsPerPixel(SrcFormat) < 24) || !image_convert_get_layout(SrcFormat, src))
+		return;
+
+	if (!image_convert_get_layout(DstFormat, dst))
+		return;
+
+	conv->srcBytes = conv->rgb16 ? 4 : GetBytesPerPixel(SrcFormat);
+	conv->dstBytes = GetBytesPerPixel(DstFormat);
+	conv->dstFormat = DstFormat;
+
+	/* RGB16 to 32 bpp has a primitive with vector versions for all CPUs */
+	if (conv->rgb16 && (conv->dstBytes == 4))
+		conv->prims = primitives_get();
+
+	if (conv->rgb16)
+		conv->scalar = image_convert_RGB16;
+	else if (conv->srcBytes == 4)
+		conv->scalar = (conv->dstBytes == 4) ? image_convert_32_to_32 : image_convert_32_to_24;
+	else
+		conv->scalar = (conv->dstBytes == 4) ? image_convert_24_to_32 : image_convert_24_to_24;
+
+	for (c = 0; c < 4; c++)
+	{
+		if (dst[c] == IMAGE_CONVERT_NONE)
+			continue;
+
+		if ((c < 3) || (ColorHasAlpha(SrcFormat) && (DstFormat != PIXEL_FORMAT_XRGB32) &&
+		                (DstFormat != PIXEL_FORMAT_XBGR32)))
+		{
+			conv->index[dst[c]] = src[c];
+			conv->keep[dst[c]] = 0xFF;
+		}
+		else if ((DstFormat != PIXEL_FORMAT_XRGB32) && (DstFormat != PIXEL_FORMAT_XBGR32))
+			conv->value[dst[c]] = 0xFF;
+	}
+
+	memset(conv->shuffle, 0x80, sizeof(conv->shuffle));
+	for (p = 0; p < 4; p++)
+	{
+		for (i = 0; i < conv->dstBytes; i++)
+		{
+			const size_t pos = p * conv->dstBytes + i;
+
+			if (conv->keep[i])
+				conv->shuffle[pos] = (BYTE)(p * conv->srcBytes + conv->index[i]);
+			conv->fill[pos] = conv->value[i];
+		}
+	}
+
+#if defined(WITH_SSE2)
+	InitOnceExecuteOnce(&image_convert_once, image_convert_init_once, NULL, NULL);
+	conv->ssse3 = image_convert_have_ssse3;
+#endif
+	conv->valid = TRUE;
+}
+
+static void image_convert_line(const image_convert* conv, BYTE* pDst, const BYTE* pSrc,
+                               UINT32 width)
+{
+	UINT32 x = 0;
+
+	if (conv->prims)
+	{
+		conv->prims->RGB565ToARGB_16u32u_C3C4((const UINT16*)pSrc, 0, (UINT32*)pDst, 0, width, 1,
+		                                      conv->dstFormat);
+		return;
+	}
+
+#if defined(WITH_SSE2)
+	if (conv->ssse3 && !conv->rgb16)
+		x = freerdp_image_shuffle_ssse3(pDst, conv->dstBytes, pSrc, conv->srcBytes, width,
+		                                conv->shuffle, conv->fill);
+#endif
+
+	if (x < width)
+		conv->scalar(conv, pDst, pSrc, x, width);
+}
+
+static void image_copy_lines(const image_copy_band* band)
+{
+	UINT32 x, y;
+	const UINT32 dstByte = GetBytesPerPixel(band->DstFormat);
+	const UINT32 srcByte = GetBytesPerPixel(band->SrcFormat);
+	const UINT32 xSrcOffset = band->nXSrc * srcByte;
+	const UINT32 xDstOffset = band->nXDst * dstByte;
+	const UINT32 nSrcStep = band->nSrcStep;
+	const UINT32 nDstStep = band->nDstStep;
+	const INT32 srcVMultiplier = band->srcVMultiplier;
+	const UINT32 srcVOffset = band->srcVOffset;
+	const BYTE* pSrcData = band->pSrcData;
+	BYTE* pDstData = band->pDstData;
+
+	if (AreColorFormatsEqualNoAlpha(band->SrcFormat, band->DstFormat))
+	{
+		const UINT32 copyDstWidth = band->nWidth * dstByte;
+
+#if defined(WITH_SSE2)
+		if (band->stream && (band->lines > 0))
+		{
+			const BYTE* srcLine =
+			    &pSrcData[(band->y + band->nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
+			BYTE* dstLine = &pDstData[(band->y + band->nYDst) * nDstStep];
+			freerdp_image_copy_stream_sse2(&dstLine[xDstOffset], nDstStep, &srcLine[xSrcOffset],
+			                               (SSIZE_T)nSrcStep * srcVMultiplier, copyDstWidth,
+			                               band->lines);
+			return;
+		}
+#endif
+
+		for (y = band->y; y < band->y + band->lines; y++)
+		{
+			const BYTE* srcLine =
+			    &pSrcData[(y + band->nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
+			BYTE* dstLine = &pDstData[(y + band->nYDst) * nDstStep];
+			memcpy(&dstLine[xDstOffset], &srcLine[xSrcOffset], copyDstWidth);
+		}
+	}
+	else if (band->convert)
+	{
+		for (y = band->y; y < band->y + band->lines; y++)
+		{
+			const BYTE* srcLine =
+			    &pSrcData[(y + band->nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
+			BYTE* dstLine = &pDstData[(y + band->nYDst) * nDstStep];
+			image_convert_line(band->convert, &dstLine[xDstOffset], &srcLine[xSrcOffset],
+			                   band->nWidth);
+		}
+	}
+	else
+	{
+		for (y = band->y; y < band->y + band->lines; y++)
+		{
+			const BYTE* srcLine =
+			    &pSrcData[(y + band->nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
+			BYTE* dstLine = &pDstData[(y + band->nYDst) * nDstStep];
+
+			UINT32 color = ReadColor(&srcLine[band->nXSrc * srcByte], band->SrcFormat);
+			UINT32 oldColor = color;
+			UINT32 dstColor =
+			    FreeRDPConvertColor(color, band->SrcFormat, band->DstFormat, band->palette);
+			WriteColor(&dstLine[band->nXDst * dstByte], band->DstFormat, dstColor);
+			for (x = 1; x < band->nWidth; x++)
+			{
+				color = ReadColor(&srcLine[(x + band->nXSrc) * srcByte], band->SrcFormat);
+				if (color == oldColor)
+				{
+					WriteColor(&dstLine[(x + band->nXDst) * dstByte], band->DstFormat, dstColor);
+				}
+				else
+				{
+					oldColor = color;
+					dstColor =
+					    FreeRDPConvertColor(color, band->SrcFormat, band->DstFormat, band->palette);
+					WriteColor(&dstLine[(x + band->nXDst) * dstByte], band->DstFormat, dstColor);
+				}
+			}
+		}
+	}
+}
+
+static void CALLBACK image_copy_band_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                   PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	image_copy_lines((const image_copy_band*)context);
+}
+
+/* A private pool, waiting for the callbacks of the default pool from one of its threads
+ * would never return */
+static BOOL CALLBACK image_copy_pool_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	SYSTEM_INFO sysinfo = { 0 };
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	GetNativeSystemInfo(&sysinfo);
+	if (sysinfo.dwNumberOfProcessors < 2)
+		return TRUE;
+
+	image_copy_pool_threads = MIN(sysinfo.dwNumberOfProcessors - 1, IMAGE_COPY_MAX_BANDS - 1);
+	image_copy_pool = CreateThreadpool(NULL);
+	if (!image_copy_pool)
+	{
+		image_copy_pool_threads = 0;
+		return TRUE;
+	}
+
+	InitializeThreadpoolEnvironment(&image_copy_pool_env);
+	SetThreadpoolCallbackPool(&image_copy_pool_env, image_copy_pool);
+	SetThreadpoolThreadMaximum(image_copy_pool, image_copy_pool_threads);
+	return TRUE;
+}
+
+void freerdp_image_copy_set_parallel_threshold(size_t threshold)
+{
+	image_copy_parallel_threshold = threshold;
+}
+
+size_t freerdp_image_copy_get_parallel_threshold(void)
+{
+	return image_copy_parallel_threshold;
+}
+
+/* Large copies run in row bands on the image copy pool, the calling thread handles the
+ * first band. Bands that can not be submitted are copied here as well. */
+static void image_copy_no_overlap(image_copy_band* band, UINT32 nHeight)
+{
+	size_t x;
+	size_t bands = 1;
+	const size_t threshold = image_copy_parallel_threshold;
+	const size_t size = (size_t)band->nWidth * GetBytesPerPixel(band->DstFormat) * nHeight;
+	image_copy_band params[IMAGE_COPY_MAX_BANDS] = { 0 };
+	PTP_WORK work_objects[IMAGE_COPY_MAX_BANDS] = { 0 };
+
+	band->y = 0;
+	band->lines = nHeight;
+	band->stream = FALSE;
+
+	if ((threshold == 0) || (size < threshold))
+	{
+		image_copy_lines(band);
+		return;
+	}
+
+	InitOnceExecuteOnce(&image_copy_pool_once, image_copy_pool_init, NULL, NULL);
+	if (image_copy_pool)
+	{
+		bands = MIN(image_copy_pool_threads + 1, size / IMAGE_COPY_MIN_BAND_SIZE);
+		bands = MIN(bands, nHeight);
+	}
+
+	if (bands < 2)
+	{
+		image_copy_lines(band);
+		return;
+	}
+
+	/* Several threads writing at once are bound by the memory bandwidth, streaming stores
+	 * save the read for ownership. A single thread is faster with memcpy. */
+#if defined(WITH_SSE2)
+	band->stream = IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE);
+#endif
+
+	for (x = 0; x < bands; x++)
+	{
+		const UINT32 first = (UINT32)(x * nHeight / bands);
+		const UINT32 last = (UINT32)((x + 1) * nHeight / bands);
+
+		params[x] = *band;
+		params[x].y = first;
+		params[x].lines = last - first;
+
+		if (x == 0)
+			continue;
+
+		work_objects[x] =
+		    CreateThreadpoolWork(image_copy_band_work_callback, &params[x], &image_copy_pool_env);
+		if (work_objects[x])
+			SubmitThreadpoolWork(work_objects[x]);
+	}
+
+	image_copy_lines(&params[0]);
+
+	for (x = 1; x < bands; x++)
+	{
+		if (!work_objects[x])
+		{
+			image_copy_lines(&params[x]);
+			continue;
+		}
+
+		WaitForThreadpoolWorkCallbacks(work_objects[x], FALSE);
+		CloseThreadpoolWork(work_objects[x]);
+	}
+}
+
 BOOL freerdp_image_copy(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32 nXDst,
                         UINT32 nYDst, UINT32 nWidth, UINT32 nHeight, const BYTE* pSrcData,
                         DWORD SrcFormat, UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
@@ -598,6 +1097,8 @@ BOOL freerdp_image_copy(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32
 	INT32 srcVMultiplier = 1;
 	UINT32 dstVOffset = 0;
 	INT32 dstVMultiplier = 1;
+	image_copy_band band = { 0 };
+	image_convert convert = { 0 };
 
 	if ((nHeight > INT32_MAX) || (nWidth > INT32_MAX))
 		return FALSE;
@@ -617,6 +1118,29 @@ BOOL freerdp_image_copy(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32
 		srcVMultiplier = -1;
 	}
 
+	band.pDstData = pDstData;
+	band.DstFormat = DstFormat;
+	band.nDstStep = nDstStep;
+	band.nXDst = nXDst;
+	band.nYDst = nYDst;
+	band.nWidth = nWidth;
+	band.pSrcData = pSrcData;
+	band.SrcFormat = SrcFormat;
+	band.nSrcStep = nSrcStep;
+	band.nXSrc = nXSrc;
+	band.nYSrc = nYSrc;
+	band.srcVOffset = srcVOffset;
+	band.srcVMultiplier = srcVMultiplier;
+	band.palette = palette;
+
+	/* pick the converter once instead of per pixel */
+	if (!AreColorFormatsEqualNoAlpha(SrcFormat, DstFormat))
+	{
+		image_convert_init(&convert, SrcFormat, DstFormat);
+		if (convert.valid)
+			band.convert = &convert;
+	}
+
 	if (AreColorFormatsEqualNoAlpha(SrcFormat, DstFormat))
 	{
 		INT32 y;
@@ -674,44 +1198,20 @@ BOOL freerdp_image_copy(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32
 			}
 		}
 		else
-		{
-			for (y = 0; y < (INT32)nHeight; y++)
-			{
-				const BYTE* srcLine =
-				    &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
-				BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep * dstVMultiplier + dstVOffset];
-				memcpy(&dstLine[xDstOffset], &srcLine[xSrcOffset], copyDstWidth);
-			}
-		}
+			image_copy_no_overlap(&band, nHeight);
 	}
 	else
 	{
-		UINT32 x, y;
-
-		for (y = 0; y < nHeight; y++)
+		/* conversions of overlapping images stay in order */
+		if (overlapping(pDstData, nXDst, nYDst, nDstStep, dstByte, pSrcData, nXSrc, nYSrc,
+		                nSrcStep, srcByte, nWidth, nHeight))
 		{
-			const BYTE* srcLine = &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
-			BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep * dstVMultiplier + dstVOffset];
-
-			UINT32 color = ReadColor(&srcLine[nXSrc * srcByte], SrcFormat);
-			UINT32 oldColor = color;
-			UINT32 dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
-			WriteColor(&dstLine[nXDst * dstByte], DstFormat, dstColor);
-			for (x = 1; x < nWidth; x++)
-			{
-				color = ReadColor(&srcLine[(x + nXSrc) * srcByte], SrcFormat);
-				if (color == oldColor)
-				{
-					WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
-				}
-				else
-				{
-					oldColor = color;
-					dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
-					WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
-				}
-			}
+			band.y = 0;
+			band.lines = nHeight;
+			image_copy_lines(&band);
 		}
+		else
+			image_copy_no_overlap(&band, nHeight);
 	}
 
 	return TRUE;
@@ -746,6 +1246,422 @@ BOOL freerdp_image_fill(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32
 	return TRUE;
 }
 
+/* The built-in scaler, used without libswscale and cairo. It is a separable filter, a box
+ * filter on the axes that shrink and bilinear on the ones that grow. The weights are Q14,
+ * the horizontally filtered rows are kept as Q7 16 bit channels. */
+#define IMAGE_SCALE_WEIGHT_BITS 14
+#define IMAGE_SCALE_ROW_BITS 7
+#define IMAGE_SCALE_CACHE_SIZE 4
+
+typedef struct
+{
+	UINT32 taps;
+	UINT32* first;
+	INT16* weights;
+} image_scale_axis;
+
+typedef struct
+{
+	UINT32 srcWidth;
+	UINT32 srcHeight;
+	UINT32 dstWidth;
+	UINT32 dstHeight;
+	image_scale_axis x;
+	image_scale_axis y;
+	UINT32 refs;
+} image_scaler;
+
+static INIT_ONCE image_scale_once = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION image_scale_lock;
+static image_scaler* image_scale_cache[IMAGE_SCALE_CACHE_SIZE] = { 0 };
+
+static BOOL CALLBACK image_scale_init_once(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+	return InitializeCriticalSectionAndSpinCount(&image_scale_lock, 4000);
+}
+
+/* Converts the weights of one output to fixed point, the rounding error is added to the
+ * largest one so they always sum up to exactly 1.0 */
+static void image_scale_set_weights(INT16* weights, const double* values, UINT32 count)
+{
+	UINT32 k;
+	UINT32 largest = 0;
+	INT32 sum = 0;
+
+	for (k = 0; k < count; k++)
+	{
+		weights[k] = (INT16)(values[k] * (1 << IMAGE_SCALE_WEIGHT_BITS) + 0.5);
+		sum += weights[k];
+
+		if (weights[k] > weights[largest])
+			largest = k;
+	}
+
+	weights[largest] += (INT16)((1 << IMAGE_SCALE_WEIGHT_BITS) - sum);
+}
+
+static void image_scale_axis_free(image_scale_axis* axis)
+{
+	free(axis->first);
+	free(axis->weights);
+}
+
+static BOOL image_scale_axis_init(image_scale_axis* axis, UINT32 src, UINT32 dst)
+{
+	UINT32 i;
+	double* values;
+	const double scale = (double)src / (double)dst;
+
+	if (dst < src)
+		axis->taps = MIN((UINT32)scale + 2, src);
+	else
+		axis->taps = MIN(2, src);
+
+	axis->first = calloc(dst, sizeof(UINT32));
+	axis->weights = calloc(1ull * dst * axis->taps, sizeof(INT16));
+	values = calloc(axis->taps, sizeof(double));
+
+	if (!axis->first || !axis->weights || !values)
+	{
+		free(values);
+		return FALSE;
+	}
+
+	for (i = 0; i < dst; i++)
+	{
+		UINT32 j;
+		UINT32 begin;
+		UINT32 end;
+
+		memset(values, 0, axis->taps * sizeof(double));
+
+		if (dst < src)
+		{
+			/* box filter, every source pixel by the part of it the output covers */
+			const double left = i * scale;
+			const double right = left + scale;
+			begin = (UINT32)left;
+			end = MIN((UINT32)right + 1, src);
+			axis->first[i] = MIN(begin, src - axis->taps);
+
+			for (j = begin; j < end; j++)
+			{
+				const double coverage = MIN(right, j + 1.0) - MAX(left, (double)j);
+
+				if (coverage > 0.0)
+					values[j - axis->first[i]] = coverage / scale;
+			}
+		}
+		else
+		{
+			/* bilinear between the two source pixels around the output center */
+			double center = (i + 0.5) * scale - 0.5;
+			center = MAX(center, 0.0);
+			center = MIN(center, src - 1.0);
+			begin = (UINT32)center;
+			axis->first[i] = MIN(begin, src - axis->taps);
+			values[begin - axis->first[i]] = 1.0 - (center - begin);
+
+			if (begin + 1 < src)
+				values[begin + 1 - axis->first[i]] = center - begin;
+		}
+
+		image_scale_set_weights(&axis->weights[1ull * i * axis->taps], values, axis->taps);
+	}
+
+	free(values);
+	return TRUE;
+}
+
+static void image_scaler_free(image_scaler* scaler)
+{
+	if (!scaler)
+		return;
+
+	image_scale_axis_free(&scaler->x);
+	image_scale_axis_free(&scaler->y);
+	free(scaler);
+}
+
+static image_scaler* image_scaler_new(UINT32 srcWidth, UINT32 srcHeight, UINT32 dstWidth,
+                                      UINT32 dstHeight)
+{
+	image_scaler* scaler = calloc(1, sizeof(image_scaler));
+
+	if (!scaler)
+		return NULL;
+
+	scaler->srcWidth = srcWidth;
+	scaler->srcHeight = srcHeight;
+	scaler->dstWidth = dstWidth;
+	scaler->dstHeight = dstHeight;
+	scaler->refs = 1;
+
+	if (!image_scale_axis_init(&scaler->x, srcWidth, dstWidth) ||
+	    !image_scale_axis_init(&scaler->y, srcHeight, dstHeight))
+	{
+		image_scaler_free(scaler);
+		return NULL;
+	}
+
+	return scaler;
+}
+
+/* Must be called with image_scale_lock held */
+static void image_scaler_unref(image_scaler* scaler)
+{
+	if (scaler && (--scaler->refs == 0))
+		image_scaler_free(scaler);
+}
+
+/* Returns the weight tables for a size pair. They are kept in a small most recently used
+ * cache, smart sizing scales the same surface sizes over and over again. */
+static image_scaler* image_scaler_acquire(UINT32 srcWidth, UINT32 srcHeight, UINT32 dstWidth,
+                                          UINT32 dstHeight)
+{
+	size_t x;
+	image_scaler* scaler = NULL;
+
+	if (!InitOnceExecuteOnce(&image_scale_once, image_scale_init_once, NULL, NULL))
+		return NULL;
+
+	EnterCriticalSection(&image_scale_lock);
+
+	for (x = 0; x < IMAGE_SCALE_CACHE_SIZE; x++)
+	{
+		image_scaler* cur = image_scale_cache[x];
+
+		if (cur && (cur->srcWidth == srcWidth) && (cur->srcHeight == srcHeight) &&
+		    (cur->dstWidth == dstWidth) && (cur->dstHeight == dstHeight))
+		{
+			memmove(&image_scale_cache[1], &image_scale_cache[0], x * sizeof(image_scaler*));
+			image_scale_cache[0] = scaler = cur;
+			scaler->refs++;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&image_scale_lock);
+
+	if (scaler)
+		return scaler;
+
+	scaler = image_scaler_new(srcWidth, srcHeight, dstWidth, dstHeight);
+
+	if (!scaler)
+		return NULL;
+
+	EnterCriticalSection(&image_scale_lock);
+	image_scaler_unref(image_scale_cache[IMAGE_SCALE_CACHE_SIZE - 1]);
+	memmove(&image_scale_cache[1], &image_scale_cache[0],
+	        (IMAGE_SCALE_CACHE_SIZE - 1) * sizeof(image_scaler*));
+	image_scale_cache[0] = scaler;
+	scaler->refs++;
+	LeaveCriticalSection(&image_scale_lock);
+	return scaler;
+}
+
+static void image_scaler_release(image_scaler* scaler)
+{
+	EnterCriticalSection(&image_scale_lock);
+	image_scaler_unref(scaler);
+	LeaveCriticalSection(&image_scale_lock);
+}
+
+static void image_scale_horizontal(INT16* pDst, const BYTE* pSrc, UINT32 width,
+                                   const UINT32* first, const INT16* weights, UINT32 taps)
+{
+	UINT32 x;
+	UINT32 k;
+	size_t c;
+
+	for (x = 0; x < width; x++)
+	{
+		const BYTE* src = &pSrc[first[x] * 4];
+		const INT16* w = &weights[1ull * x * taps];
+
+		for (c = 0; c < 4; c++)
+		{
+			INT32 sum = 0;
+
+			for (k = 0; k < taps; k++)
+				sum += src[k * 4 + c] * w[k];
+
+			sum += 1 << (IMAGE_SCALE_WEIGHT_BITS - IMAGE_SCALE_ROW_BITS - 1);
+			pDst[x * 4 + c] = (INT16)(sum >> (IMAGE_SCALE_WEIGHT_BITS - IMAGE_SCALE_ROW_BITS));
+		}
+	}
+}
+
+static void image_scale_vertical(BYTE* pDst, const INT16* const* rows, UINT32 x, UINT32 width,
+                                 const INT16* weights, UINT32 taps)
+{
+	UINT32 k;
+	size_t i;
+
+	for (i = x * 4ull; i < width * 4ull; i++)
+	{
+		INT32 sum = 1 << (IMAGE_SCALE_WEIGHT_BITS + IMAGE_SCALE_ROW_BITS - 1);
+
+		for (k = 0; k < taps; k++)
+			sum += rows[k][i] * weights[k];
+
+		sum >>= IMAGE_SCALE_WEIGHT_BITS + IMAGE_SCALE_ROW_BITS;
+		pDst[i] = (BYTE)MAX(MIN(sum, 255), 0);
+	}
+}
+
+/* pSrcData and pDstData point to the first pixel of the rectangles. Only the part of the
+ * destination in the rect is written, the source rows and columns it does not depend on are
+ * never read. Formats that are not 32 bpp are converted row by row around the filter. */
+static BOOL image_scale_builtin(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+                                UINT32 nDstWidth, UINT32 nDstHeight, const BYTE* pSrcData,
+                                DWORD SrcFormat, UINT32 nSrcStep, UINT32 nSrcWidth,
+                                UINT32 nSrcHeight, UINT32 nXRect, UINT32 nYRect,
+                                UINT32 nRectWidth, UINT32 nRectHeight)
+{
+	BOOL rc = FALSE;
+	UINT32 x;
+	UINT32 y;
+	BOOL sse2 = FALSE;
+	image_scaler* scaler;
+	const DWORD format =
+	    (GetBytesPerPixel(SrcFormat) == 4) ? SrcFormat : PIXEL_FORMAT_BGRA32;
+	const BOOL convertDst =
+	    (GetBytesPerPixel(DstFormat) != 4) || !AreColorFormatsEqualNoAlpha(format, DstFormat);
+	const size_t rowSize = nRectWidth * 4ull * sizeof(INT16);
+	const UINT32* first;
+	const INT16* weights;
+	UINT32 srcLeft;
+	UINT32 srcWidth;
+	BYTE* srcRow = NULL;
+	BYTE* dstRow = NULL;
+	INT16* ring = NULL;
+	UINT32* ringRows = NULL;
+	const INT16** rows = NULL;
+
+	if ((nSrcWidth == 0) || (nSrcHeight == 0) || (nDstWidth == 0) || (nDstHeight == 0))
+		return FALSE;
+
+	if ((nRectWidth == 0) || (nRectHeight == 0))
+		return TRUE;
+
+	if ((nXRect > nDstWidth) || (nRectWidth > nDstWidth - nXRect) || (nYRect > nDstHeight) ||
+	    (nRectHeight > nDstHeight - nYRect))
+		return FALSE;
+
+	scaler = image_scaler_acquire(nSrcWidth, nSrcHeight, nDstWidth, nDstHeight);
+
+	if (!scaler)
+		return FALSE;
+
+#if defined(WITH_SSE2)
+	sse2 = IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE);
+#endif
+
+	/* the last horizontally filtered source rows, row r lives in slot r % taps */
+	ring = _aligned_malloc(rowSize * scaler->y.taps, 16);
+	ringRows = calloc(scaler->y.taps, sizeof(UINT32));
+	rows = calloc(scaler->y.taps, sizeof(INT16*));
+
+	if (!ring || !ringRows || !rows)
+		goto fail;
+
+	for (x = 0; x < scaler->y.taps; x++)
+		ringRows[x] = UINT32_MAX;
+
+	/* the filter tables of the rect columns and the source columns they read */
+	first = &scaler->x.first[nXRect];
+	weights = &scaler->x.weights[1ull * nXRect * scaler->x.taps];
+	srcLeft = first[0];
+	srcWidth = first[nRectWidth - 1] + scaler->x.taps - srcLeft;
+
+	if (format != SrcFormat)
+	{
+		srcRow = _aligned_malloc(nSrcWidth * 4ull, 16);
+
+		if (!srcRow)
+			goto fail;
+	}
+
+	if (convertDst)
+	{
+		dstRow = _aligned_malloc(nRectWidth * 4ull, 16);
+
+		if (!dstRow)
+			goto fail;
+	}
+
+	for (y = nYRect; y < nYRect + nRectHeight; y++)
+	{
+		const INT16* yWeights = &scaler->y.weights[1ull * y * scaler->y.taps];
+		BYTE* pDst = convertDst ? dstRow : &pDstData[1ull * y * nDstStep + nXRect * 4ull];
+		UINT32 done = 0;
+
+		for (x = 0; x < scaler->y.taps; x++)
+		{
+			const UINT32 row = scaler->y.first[y] + x;
+			const UINT32 slot = row % scaler->y.taps;
+			INT16* filtered = (INT16*)((BYTE*)ring + rowSize * slot);
+
+			if (ringRows[slot] != row)
+			{
+				const BYTE* pSrc = &pSrcData[1ull * row * nSrcStep];
+
+				if (srcRow)
+				{
+					if (!freerdp_image_copy(srcRow, format, 0, srcLeft, 0, srcWidth, 1, pSrc,
+					                        SrcFormat, nSrcStep, srcLeft, 0, NULL,
+					                        FREERDP_FLIP_NONE))
+						goto fail;
+
+					pSrc = srcRow;
+				}
+
+#if defined(WITH_SSE2)
+				if (sse2)
+					freerdp_image_scale_horizontal_sse2(filtered, pSrc, nRectWidth, first,
+					                                    weights, scaler->x.taps);
+				else
+#endif
+					image_scale_horizontal(filtered, pSrc, nRectWidth, first, weights,
+					                       scaler->x.taps);
+
+				ringRows[slot] = row;
+			}
+
+			rows[x] = filtered;
+		}
+
+#if defined(WITH_SSE2)
+		if (sse2)
+			done = freerdp_image_scale_vertical_sse2(pDst, rows, nRectWidth, yWeights,
+			                                         scaler->y.taps);
+#endif
+		image_scale_vertical(pDst, rows, done, nRectWidth, yWeights, scaler->y.taps);
+
+		if (convertDst)
+		{
+			if (!freerdp_image_copy(pDstData, DstFormat, nDstStep, nXRect, y, nRectWidth, 1,
+			                        dstRow, format, 0, 0, 0, NULL, FREERDP_FLIP_NONE))
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	_aligned_free(ring);
+	_aligned_free(srcRow);
+	_aligned_free(dstRow);
+	free(ringRows);
+	free(rows);
+	image_scaler_release(scaler);
+	return rc;
+}
+
 #if defined(SWSCALE_FOUND)
 static int av_format_for_buffer(UINT32 format)
 {
@@ -767,6 +1683,40 @@ static int av_format_for_buffer(UINT32 format)
 			return AV_PIX_FMT_NONE;
 	}
 }
+
+/* the context of the last scale is kept, sws_getCachedContext only rebuilds it when the
+ * sizes or formats change */
+static struct SwsContext* image_scale_sws = NULL;
+
+static struct SwsContext* image_scale_sws_acquire(int srcWidth, int srcHeight, int srcFormat,
+                                                  int dstWidth, int dstHeight, int dstFormat)
+{
+	struct SwsContext* resize;
+
+	if (!InitOnceExecuteOnce(&image_scale_once, image_scale_init_once, NULL, NULL))
+		return NULL;
+
+	EnterCriticalSection(&image_scale_lock);
+	resize = image_scale_sws;
+	image_scale_sws = NULL;
+	LeaveCriticalSection(&image_scale_lock);
+	return sws_getCachedContext(resize, srcWidth, srcHeight, srcFormat, dstWidth, dstHeight,
+	                            dstFormat, SWS_BILINEAR, NULL, NULL, NULL);
+}
+
+static void image_scale_sws_release(struct SwsContext* resize)
+{
+	EnterCriticalSection(&image_scale_lock);
+
+	if (!image_scale_sws)
+	{
+		image_scale_sws = resize;
+		resize = NULL;
+	}
+
+	LeaveCriticalSection(&image_scale_lock);
+	sws_freeContext(resize);
+}
 #endif
 
 BOOL freerdp_image_scale(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32 nXDst,
@@ -782,10 +1732,8 @@ BOOL freerdp_image_scale(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT3
 	if (nSrcStep == 0)
 		nSrcStep = nSrcWidth * GetBytesPerPixel(SrcFormat);
 
-#if defined(SWSCALE_FOUND) || defined(CAIRO_FOUND)
 	const BYTE* src = &pSrcData[nXSrc * GetBytesPerPixel(SrcFormat) + nYSrc * nSrcStep];
 	BYTE* dst = &pDstData[nXDst * GetBytesPerPixel(DstFormat) + nYDst * nDstStep];
-#endif
 
 	/* direct copy is much faster than scaling, so check if we can simply copy... */
 	if ((nDstWidth == nSrcWidth) && (nDstHeight == nSrcHeight))
@@ -805,18 +1753,19 @@ BOOL freerdp_image_scale(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT3
 		const int dstStep[1] = { (int)nDstStep };
 
 		if ((srcFormat == AV_PIX_FMT_NONE) || (dstFormat == AV_PIX_FMT_NONE))
-			return FALSE;
+			return image_scale_builtin(dst, DstFormat, nDstStep, nDstWidth, nDstHeight, src,
+			                           SrcFormat, nSrcStep, nSrcWidth, nSrcHeight, 0, 0,
+			                           nDstWidth, nDstHeight);
 
-		resize = sws_getContext((int)nSrcWidth, (int)nSrcHeight, srcFormat, (int)nDstWidth,
-		                        (int)nDstHeight, dstFormat, SWS_BILINEAR, NULL, NULL, NULL);
+		resize = image_scale_sws_acquire((int)nSrcWidth, (int)nSrcHeight, srcFormat,
+		                                 (int)nDstWidth, (int)nDstHeight, dstFormat);
 
 		if (!resize)
-			goto fail;
+			return FALSE;
 
 		res = sws_scale(resize, &src, srcStep, 0, (int)nSrcHeight, &dst, dstStep);
 		rc = (res == ((int)nDstHeight));
-	fail:
-		sws_freeContext(resize);
+		image_scale_sws_release(resize);
 	}
 
 #elif defined(CAIRO_FOUND)
@@ -858,8 +1807,41 @@ BOOL freerdp_image_scale(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT3
 	}
 #else
 	{
-		WLog_WARN(TAG, "SmartScaling requested but compiled without libcairo support!");
+		rc = image_scale_builtin(dst, DstFormat, nDstStep, nDstWidth, nDstHeight, src, SrcFormat,
+		                         nSrcStep, nSrcWidth, nSrcHeight, 0, 0, nDstWidth, nDstHeight);
 	}
 #endif
 	return rc;
 }
+
+BOOL freerdp_image_scale_rect(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32 nXDst,
+                              UINT32 nYDst, UINT32 nDstWidth, UINT32 nDstHeight,
+                              const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
+                              UINT32 nXSrc, UINT32 nYSrc, UINT32 nSrcWidth, UINT32 nSrcHeight,
+                              UINT32 nXRect, UINT32 nYRect, UINT32 nRectWidth,
+                              UINT32 nRectHeight)
+{
+	if (nDstStep == 0)
+		nDstStep = nDstWidth * GetBytesPerPixel(DstFormat);
+
+	if (nSrcStep == 0)
+		nSrcStep = nSrcWidth * GetBytesPerPixel(SrcFormat);
+
+	const BYTE* src = &pSrcData[nXSrc * GetBytesPerPixel(SrcFormat) + nYSrc * nSrcStep];
+	BYTE* dst = &pDstData[nXDst * GetBytesPerPixel(DstFormat) + nYDst * nDstStep];
+
+	if ((nDstWidth == nSrcWidth) && (nDstHeight == nSrcHeight))
+	{
+		if ((nXRect > nDstWidth) || (nRectWidth > nDstWidth - nXRect) ||
+		    (nYRect > nDstHeight) || (nRectHeight > nDstHeight - nYRect))
+			return FALSE;
+
+		return freerdp_image_copy(pDstData, DstFormat, nDstStep, nXDst + nXRect, nYDst + nYRect,
+		                          nRectWidth, nRectHeight, pSrcData, SrcFormat, nSrcStep,
+		                          nXSrc + nXRect, nYSrc + nYRect, NULL, FREERDP_FLIP_NONE);
+	}
+
+	return image_scale_builtin(dst, DstFormat, nDstStep, nDstWidth, nDstHeight, src, SrcFormat,
+	                           nSrcStep, nSrcWidth, nSrcHeight, nXRect, nYRect, nRectWidth,
+	                           nRectHeight);
+}
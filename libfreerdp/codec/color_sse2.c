@@ -0,0 +1,157 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Copy - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <emmintrin.h>
+
+#include "color_sse2.h"
+
+/* Copies lines with non-temporal stores. A large blit does not fit into the cache anyway,
+ * streaming it keeps the cache for the data that is read again. */
+void freerdp_image_copy_stream_sse2(BYTE* pDst, SSIZE_T dstStep, const BYTE* pSrc,
+                                    SSIZE_T srcStep, size_t lineSize, UINT32 lines)
+{
+	UINT32 y;
+
+	for (y = 0; y < lines; y++)
+	{
+		BYTE* dst = pDst + y * dstStep;
+		const BYTE* src = pSrc + y * srcStep;
+		size_t size = lineSize;
+		const size_t head = (16 - ((ULONG_PTR)dst & 0x0F)) & 0x0F;
+
+		if (size < head + 64)
+		{
+			memcpy(dst, src, size);
+			continue;
+		}
+
+		/* the streaming stores need an aligned destination */
+		memcpy(dst, src, head);
+		dst += head;
+		src += head;
+		size -= head;
+
+		while (size >= 64)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)&src[0]);
+			const __m128i b = _mm_loadu_si128((const __m128i*)&src[16]);
+			const __m128i c = _mm_loadu_si128((const __m128i*)&src[32]);
+			const __m128i d = _mm_loadu_si128((const __m128i*)&src[48]);
+			_mm_stream_si128((__m128i*)&dst[0], a);
+			_mm_stream_si128((__m128i*)&dst[16], b);
+			_mm_stream_si128((__m128i*)&dst[32], c);
+			_mm_stream_si128((__m128i*)&dst[48], d);
+			dst += 64;
+			src += 64;
+			size -= 64;
+		}
+
+		memcpy(dst, src, size);
+	}
+
+	/* make the streamed data visible before the copy is reported as done */
+	_mm_sfence();
+}
+
+static INLINE __m128i scale_weight_pair(INT16 a, INT16 b)
+{
+	return _mm_set1_epi32((int)((UINT32)(UINT16)a | ((UINT32)(UINT16)b << 16)));
+}
+
+/* Filters one row of 32 bpp pixels into Q7 channels. Every output pixel reads taps
+ * consecutive source pixels starting at first[x], two at a time with pmaddwd. */
+void freerdp_image_scale_horizontal_sse2(INT16* pDst, const BYTE* pSrc, UINT32 width,
+                                         const UINT32* first, const INT16* weights, UINT32 taps)
+{
+	UINT32 x;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << 6);
+
+	for (x = 0; x < width; x++)
+	{
+		UINT32 k = 0;
+		INT32 last;
+		__m128i sum = zero;
+		const BYTE* src = &pSrc[first[x] * 4];
+		const INT16* w = &weights[x * taps];
+
+		for (; k + 2 <= taps; k += 2)
+		{
+			const __m128i px =
+			    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&src[k * 4]), zero);
+			const __m128i pairs = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, scale_weight_pair(w[k], w[k + 1])));
+		}
+
+		if (k < taps)
+		{
+			__m128i px;
+			memcpy(&last, &src[k * 4], sizeof(last));
+			px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(px, zero),
+			                                        scale_weight_pair(w[k], 0)));
+		}
+
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, round), 7);
+		_mm_storel_epi64((__m128i*)&pDst[x * 4], _mm_packs_epi32(sum, sum));
+	}
+}
+
+/* Combines taps Q7 rows into one row of 32 bpp pixels, 2 pixels per round.
+ * Returns the number of pixels done, the caller finishes the rest. */
+UINT32 freerdp_image_scale_vertical_sse2(BYTE* pDst, const INT16* const* rows, UINT32 width,
+                                         const INT16* weights, UINT32 taps)
+{
+	UINT32 x;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << 20);
+
+	for (x = 0; x + 2 <= width; x += 2)
+	{
+		UINT32 k = 0;
+		__m128i lo = zero;
+		__m128i hi = zero;
+		__m128i val;
+
+		for (; k + 2 <= taps; k += 2)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)&rows[k][x * 4]);
+			const __m128i b = _mm_loadu_si128((const __m128i*)&rows[k + 1][x * 4]);
+			const __m128i w = scale_weight_pair(weights[k], weights[k + 1]);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+
+		if (k < taps)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)&rows[k][x * 4]);
+			const __m128i w = scale_weight_pair(weights[k], 0);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), w));
+		}
+
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 21);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 21);
+		val = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)&pDst[x * 4], _mm_packus_epi16(val, val));
+	}
+
+	return x;
+}
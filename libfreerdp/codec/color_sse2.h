@@ -0,0 +1,35 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Copy - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_COLOR_SSE2_H
+#define FREERDP_LIB_CODEC_COLOR_SSE2_H
+
+#include <winpr/wtypes.h>
+#include <freerdp/api.h>
+
+FREERDP_LOCAL void freerdp_image_copy_stream_sse2(BYTE* pDst, SSIZE_T dstStep, const BYTE* pSrc,
+                                                  SSIZE_T srcStep, size_t lineSize, UINT32 lines);
+
+/* Scaler kernels, weights are Q14 and the horizontally filtered rows Q7 */
+FREERDP_LOCAL void freerdp_image_scale_horizontal_sse2(INT16* pDst, const BYTE* pSrc,
+                                                       UINT32 width, const UINT32* first,
+                                                       const INT16* weights, UINT32 taps);
+FREERDP_LOCAL UINT32 freerdp_image_scale_vertical_sse2(BYTE* pDst, const INT16* const* rows,
+                                                       UINT32 width, const INT16* weights,
+                                                       UINT32 taps);
+
+#endif /* FREERDP_LIB_CODEC_COLOR_SSE2_H */
@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Copy - SSSE3 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include "color_ssse3.h"
+
+UINT32 freerdp_image_shuffle_ssse3(BYTE* pDst, UINT32 dstBytes, const BYTE* pSrc,
+                                   UINT32 srcBytes, UINT32 width, const BYTE* shuffle,
+                                   const BYTE* fill)
+{
+	UINT32 x = 0;
+	const __m128i mask = _mm_loadu_si128((const __m128i*)shuffle);
+	const __m128i value = _mm_loadu_si128((const __m128i*)fill);
+	/* 4 pixels of 24 bpp take 12 bytes, keep the 16 byte loads and stores inside the line */
+	const UINT32 margin = ((srcBytes == 3) || (dstBytes == 3)) ? 6 : 4;
+
+	if ((srcBytes == 4) && (dstBytes == 4))
+	{
+		/* 8 pixels per round */
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)&pSrc[x * 4]);
+			const __m128i b = _mm_loadu_si128((const __m128i*)&pSrc[x * 4 + 16]);
+			_mm_storeu_si128((__m128i*)&pDst[x * 4],
+			                 _mm_or_si128(_mm_shuffle_epi8(a, mask), value));
+			_mm_storeu_si128((__m128i*)&pDst[x * 4 + 16],
+			                 _mm_or_si128(_mm_shuffle_epi8(b, mask), value));
+		}
+	}
+
+	for (; x + margin <= width; x += 4)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)&pSrc[x * srcBytes]);
+		_mm_storeu_si128((__m128i*)&pDst[x * dstBytes],
+		                 _mm_or_si128(_mm_shuffle_epi8(a, mask), value));
+	}
+
+	return x;
+}
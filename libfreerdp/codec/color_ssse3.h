@@ -0,0 +1,31 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Copy - SSSE3 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_COLOR_SSSE3_H
+#define FREERDP_LIB_CODEC_COLOR_SSSE3_H
+
+#include <winpr/wtypes.h>
+#include <freerdp/api.h>
+
+/* Converts the leading pixels of a line and returns how many it did, the caller
+ * converts the rest. shuffle and fill describe 4 pixels: destination byte i is source byte
+ * shuffle[i] (0x80 for none) ORed with fill[i]. */
+FREERDP_LOCAL UINT32 freerdp_image_shuffle_ssse3(BYTE* pDst, UINT32 dstBytes, const BYTE* pSrc,
+                                                 UINT32 srcBytes, UINT32 width,
+                                                 const BYTE* shuffle, const BYTE* fill);
+
+#endif /* FREERDP_LIB_CODEC_COLOR_SSSE3_H */
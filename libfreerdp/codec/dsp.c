@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <winpr/crt.h>
 
@@ -47,6 +48,16 @@
 #include <faac.h>
 #endif
 
+#if defined(WITH_OPUS)
+#include <opus/opus.h>
+
+/* the largest packet of a single frame and the longest packet allowed */
+#define OPUS_MAX_FRAME_BYTES 1275
+#define OPUS_MAX_PACKET_MS 120
+/* rdpsnd wave PDUs carry at least four bytes, padding is part of the packet format */
+#define OPUS_MIN_PACKET_BYTES 4
+#endif
+
 #if defined(WITH_SOXR)
 #include <soxr.h>
 #endif
@@ -57,6 +68,16 @@
 
 #define TAG FREERDP_TAG("dsp")
 
+#if !defined(WITH_DSP_FFMPEG) && !defined(WITH_SOXR)
+/* built-in polyphase resampler: taps per output sample and filter phases per input sample */
+#define DSP_RESAMPLE_TAPS 32
+#define DSP_RESAMPLE_PHASES 128
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#endif
+
 #if !defined(WITH_DSP_FFMPEG)
 
 typedef union
@@ -87,6 +108,14 @@ struct S_FREERDP_DSP_CONTEXT
 	wStream* resample;
 	wStream* buffer;
 
+	/* source sample rate the resampler is set up for */
+	UINT32 resampleRate;
+#if !defined(WITH_SOXR)
+	float* resampleFilter;
+	wStream* resampleHistory;
+	UINT64 resamplePhase;
+#endif
+
 #if defined(WITH_GSM)
 	gsm gsm;
 #endif
@@ -99,6 +128,15 @@ struct S_FREERDP_DSP_CONTEXT
 	BOOL faadSetup;
 #endif
 
+#if defined(WITH_OPUS)
+	OpusEncoder* opusEncoder;
+	OpusDecoder* opusDecoder;
+	OpusRepacketizer* opusRepacketizer;
+	wStream* opusPackets;
+	size_t opusPending; /* bytes of an encoded frame left in opusPackets */
+	size_t opusFrameSize; /* samples per channel */
+#endif
+
 #if defined(WITH_FAAC)
 	faacEncHandle faac;
 	unsigned long faacInputSamples;
@@ -121,7 +159,8 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* context, const BYTE* sr
 {
 	UINT32 bpp;
 	size_t samples;
-	size_t x, y;
+	size_t x;
+	BYTE* dst;
 
 	if (!context || !data || !length)
 		return FALSE;
@@ -139,63 +178,63 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* context, const BYTE* sr
 		return TRUE;
 	}
 
-	Stream_SetPosition(context->channelmix, 0);
+	/* We only support mono and stereo */
+	if ((srcFormat->nChannels > 2) || (context->format.nChannels > 2))
+		return FALSE;
+
+	/* mono to stereo doubles the size, stereo to mono halves it */
+	if (!Stream_EnsureCapacity(context->channelmix, samples * bpp * 2))
+		return FALSE;
+
+	dst = Stream_Buffer(context->channelmix);
 
-	/* Destination has more channels than source */
+	/* The loops below work on whole samples without going through the stream,
+	 * that allows the compiler to vectorize them. */
 	if (context->format.nChannels > srcFormat->nChannels)
 	{
-		switch (srcFormat->nChannels)
+		if (bpp == 2)
 		{
-			case 1:
-				if (!Stream_EnsureCapacity(context->channelmix, size * 2))
-					return FALSE;
-
-				for (x = 0; x < samples; x++)
-				{
-					for (y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->channelmix, src[x * bpp + y]);
-
-					for (y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->channelmix, src[x * bpp + y]);
-				}
-
-				Stream_SealLength(context->channelmix);
-				*data = Stream_Buffer(context->channelmix);
-				*length = Stream_Length(context->channelmix);
-				return TRUE;
-
-			case 2:  /* We only support stereo, so we can not handle this case. */
-			default: /* Unsupported number of channels */
-				return FALSE;
+			for (x = 0; x < samples; x++)
+			{
+				dst[4 * x] = dst[4 * x + 2] = src[2 * x];
+				dst[4 * x + 1] = dst[4 * x + 3] = src[2 * x + 1];
+			}
+		}
+		else
+		{
+			for (x = 0; x < samples; x++)
+				dst[2 * x] = dst[2 * x + 1] = src[x];
 		}
-	}
 
-	/* Destination has less channels than source */
-	switch (srcFormat->nChannels)
+		Stream_SetLength(context->channelmix, samples * bpp * 2);
+	}
+	else
 	{
-		case 2:
-			if (!Stream_EnsureCapacity(context->channelmix, size / 2))
-				return FALSE;
-
-			/* Simply drop second channel.
-			 * TODO: Calculate average */
+		if (bpp == 2)
+		{
 			for (x = 0; x < samples; x++)
 			{
-				for (y = 0; y < bpp; y++)
-					Stream_Write_UINT8(context->channelmix, src[2 * x * bpp + y]);
+				const INT32 left = read_int16(&src[4 * x]);
+				const INT32 right = read_int16(&src[4 * x + 2]);
+				const UINT16 mixed = (UINT16)(INT16)((left + right) / 2);
+				dst[2 * x] = mixed & 0xFF;
+				dst[2 * x + 1] = (mixed >> 8) & 0xFF;
 			}
+		}
+		else
+		{
+			/* 8 bit PCM is unsigned */
+			for (x = 0; x < samples; x++)
+				dst[x] = (BYTE)((src[2 * x] + src[2 * x + 1]) / 2);
+		}
 
-			Stream_SealLength(context->channelmix);
-			*data = Stream_Buffer(context->channelmix);
-			*length = Stream_Length(context->channelmix);
-			return TRUE;
-
-		case 1:  /* Invalid, do we want to use a 0 channel sound? */
-		default: /* Unsupported number of channels */
-			return FALSE;
+		Stream_SetLength(context->channelmix, samples * bpp);
 	}
 
-	return FALSE;
+	Stream_SetPosition(context->channelmix, Stream_Length(context->channelmix));
+	*data = Stream_Buffer(context->channelmix);
+	*length = Stream_Length(context->channelmix);
+	return TRUE;
 }
 
 /**
@@ -203,6 +242,143 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* context, const BYTE* sr
  * http://download.microsoft.com/download/9/8/6/9863C72A-A3AA-4DDB-B1BA-CA8D17EFD2D4/RIFFNEW.pdf
  */
 
+#if !defined(WITH_SOXR)
+static BOOL freerdp_dsp_resample_init(FREERDP_DSP_CONTEXT* context, UINT32 srcRate)
+{
+	size_t phase, tap;
+	const size_t half = DSP_RESAMPLE_TAPS / 2;
+	const UINT32 dstRate = context->format.nSamplesPerSec;
+	/* cut off below the lower of both nyquist frequencies, relative to the source one */
+	const double cutoff = 0.95 * ((dstRate < srcRate) ? (double)dstRate / srcRate : 1.0);
+	float* filter = context->resampleFilter;
+
+	if (!filter)
+	{
+		filter = calloc((DSP_RESAMPLE_PHASES + 1) * DSP_RESAMPLE_TAPS, sizeof(float));
+
+		if (!filter)
+			return FALSE;
+
+		context->resampleFilter = filter;
+	}
+
+	/* Blackman windowed sinc, for every fraction of an input sample the output falls on */
+	for (phase = 0; phase <= DSP_RESAMPLE_PHASES; phase++)
+	{
+		double sum = 0.0;
+		float* coeffs = &filter[phase * DSP_RESAMPLE_TAPS];
+
+		for (tap = 0; tap < DSP_RESAMPLE_TAPS; tap++)
+		{
+			const double x = (double)tap - (double)(half - 1) - (double)phase / DSP_RESAMPLE_PHASES;
+			const double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2.0 * M_PI * x / half);
+			double h = cutoff;
+
+			if (x != 0.0)
+				h = sin(M_PI * cutoff * x) / (M_PI * x);
+
+			coeffs[tap] = (float)(h * ((fabs(x) < half) ? w : 0.0));
+			sum += coeffs[tap];
+		}
+
+		/* unity gain for every phase */
+		for (tap = 0; tap < DSP_RESAMPLE_TAPS; tap++)
+			coeffs[tap] = (float)(coeffs[tap] / sum);
+	}
+
+	/* start with silence before the first sample, the filter is centered on it */
+	Stream_SetPosition(context->resampleHistory, 0);
+
+	if (!Stream_EnsureCapacity(context->resampleHistory,
+	                           (half - 1) * context->format.nChannels * sizeof(INT16)))
+		return FALSE;
+
+	Stream_Zero(context->resampleHistory, (half - 1) * context->format.nChannels * sizeof(INT16));
+	context->resamplePhase = (half - 1) * 1ull * dstRate;
+	context->resampleRate = srcRate;
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_resample_filter(FREERDP_DSP_CONTEXT* context, const BYTE* src,
+                                        size_t size, UINT32 srcRate)
+{
+	size_t channel, tap;
+	size_t frames, consumed, remaining;
+	const size_t half = DSP_RESAMPLE_TAPS / 2;
+	const size_t channels = context->format.nChannels;
+	const size_t bpf = channels * sizeof(INT16);
+	const UINT64 dstRate = context->format.nSamplesPerSec;
+	const INT16* history;
+
+	if (context->resampleRate != srcRate)
+	{
+		if (!freerdp_dsp_resample_init(context, srcRate))
+			return FALSE;
+	}
+
+	if (!Stream_EnsureRemainingCapacity(context->resampleHistory, size))
+		return FALSE;
+
+	Stream_Write(context->resampleHistory, src, size);
+	frames = Stream_GetPosition(context->resampleHistory) / bpf;
+	history = (const INT16*)Stream_Buffer(context->resampleHistory);
+
+	Stream_SetPosition(context->resample, 0);
+
+	if (!Stream_EnsureCapacity(context->resample,
+	                           ((size / bpf) * dstRate / srcRate + 2) * bpf))
+		return FALSE;
+
+	/* the input position of an output sample is resamplePhase / dstRate */
+	while (context->resamplePhase / dstRate + half < frames)
+	{
+		const size_t index = (size_t)(context->resamplePhase / dstRate);
+		const size_t phase =
+		    (size_t)((context->resamplePhase % dstRate) * DSP_RESAMPLE_PHASES / dstRate);
+		const float* coeffs = &context->resampleFilter[phase * DSP_RESAMPLE_TAPS];
+		const INT16* in = &history[(index - (half - 1)) * channels];
+
+		if (Stream_GetPosition(context->resample) + bpf > Stream_Capacity(context->resample))
+			break;
+
+		for (channel = 0; channel < channels; channel++)
+		{
+			float sum = 0.0f;
+			INT32 value;
+
+			for (tap = 0; tap < DSP_RESAMPLE_TAPS; tap++)
+				sum += coeffs[tap] * in[tap * channels + channel];
+
+			value = (INT32)lrintf(sum);
+
+			if (value > INT16_MAX)
+				value = INT16_MAX;
+			else if (value < INT16_MIN)
+				value = INT16_MIN;
+
+			Stream_Write_INT16(context->resample, (INT16)value);
+		}
+
+		context->resamplePhase += srcRate;
+	}
+
+	/* keep the samples the next output needs */
+	consumed = (size_t)(context->resamplePhase / dstRate) - (half - 1);
+
+	if (consumed > frames)
+		consumed = frames;
+
+	remaining = frames - consumed;
+	memmove(Stream_Buffer(context->resampleHistory), &history[consumed * channels],
+	        remaining * bpf);
+	Stream_SetPosition(context->resampleHistory, remaining * bpf);
+	context->resamplePhase -= consumed * dstRate;
+
+	Stream_SealLength(context->resample);
+	return TRUE;
+}
+#endif
+
 static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context, const BYTE* src, size_t size,
                                  const AUDIO_FORMAT* srcFormat, const BYTE** data, size_t* length)
 {
@@ -212,9 +388,9 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context, const BYTE* src,
 	size_t sframes, rframes;
 	size_t rsize;
 	size_t sbytes, rbytes;
-#endif
 	size_t srcBytesPerFrame, dstBytesPerFrame;
 	size_t srcChannels, dstChannels;
+#endif
 	AUDIO_FORMAT format;
 
 	if (srcFormat->wFormatTag != WAVE_FORMAT_PCM)
@@ -225,10 +401,6 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context, const BYTE* src,
 		return FALSE;
 	}
 
-	srcChannels = srcFormat->nChannels;
-	dstChannels = context->format.nChannels;
-	srcBytesPerFrame = (srcFormat->wBitsPerSample > 8) ? 2 : 1;
-	dstBytesPerFrame = (context->format.wBitsPerSample > 8) ? 2 : 1;
 	/* We want to ignore differences of source and destination format. */
 	format = *srcFormat;
 	format.wFormatTag = WAVE_FORMAT_UNKNOWN;
@@ -242,6 +414,25 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context, const BYTE* src,
 	}
 
 #if defined(WITH_SOXR)
+	srcChannels = srcFormat->nChannels;
+	dstChannels = context->format.nChannels;
+	srcBytesPerFrame = (srcFormat->wBitsPerSample > 8) ? 2 : 1;
+	dstBytesPerFrame = (context->format.wBitsPerSample > 8) ? 2 : 1;
+
+	/* The source rate is only known here */
+	if (!context->sox || (context->resampleRate != srcFormat->nSamplesPerSec))
+	{
+		soxr_io_spec_t iospec = soxr_io_spec(SOXR_INT16, SOXR_INT16);
+		soxr_quality_spec_t qspec = soxr_quality_spec(SOXR_HQ, 0);
+		soxr_delete(context->sox);
+		context->sox = soxr_create(srcFormat->nSamplesPerSec, context->format.nSamplesPerSec,
+		                           dstChannels, &error, &iospec, &qspec, NULL);
+		context->resampleRate = srcFormat->nSamplesPerSec;
+
+		if (!context->sox || (error != 0))
+			return FALSE;
+	}
+
 	sbytes = srcChannels * srcBytesPerFrame;
 	sframes = size / sbytes;
 	rbytes = dstBytesPerFrame * dstChannels;
@@ -260,8 +451,20 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* context, const BYTE* src,
 	*length = Stream_Length(context->resample);
 	return (error == 0) ? TRUE : FALSE;
 #else
-	WLog_ERR(TAG, "Missing resample support, recompile -DWITH_SOXR=ON or -DWITH_DSP_FFMPEG=ON");
-	return FALSE;
+	if ((srcFormat->wBitsPerSample != 16) || (context->format.wBitsPerSample != 16) ||
+	    (srcFormat->nSamplesPerSec == 0) || (context->format.nSamplesPerSec == 0))
+	{
+		WLog_ERR(TAG, "Only 16 bit resampling supported, recompile -DWITH_SOXR=ON or "
+		              "-DWITH_DSP_FFMPEG=ON");
+		return FALSE;
+	}
+
+	if (!freerdp_dsp_resample_filter(context, src, size, srcFormat->nSamplesPerSec))
+		return FALSE;
+
+	*data = Stream_Buffer(context->resample);
+	*length = Stream_Length(context->resample);
+	return TRUE;
 #endif
 }
 
@@ -334,7 +537,7 @@ static BOOL freerdp_dsp_decode_ima_adpcm(FREERDP_DSP_CONTEXT* context, const BYT
 	const UINT32 channels = context->format.nChannels;
 	size_t i;
 
-	if (!Stream_EnsureCapacity(out, out_size))
+	if (!Stream_EnsureRemainingCapacity(out, out_size))
 		return FALSE;
 
 	while (size > 0)
@@ -564,6 +767,224 @@ static BOOL freerdp_dsp_encode_faac(FREERDP_DSP_CONTEXT* context, const BYTE* sr
 }
 #endif
 
+#if defined(WITH_OPUS)
+static BOOL freerdp_dsp_opus_supports_rate(UINT32 rate)
+{
+	switch (rate)
+	{
+		case 8000:
+		case 12000:
+		case 16000:
+		case 24000:
+		case 48000:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+static void freerdp_dsp_opus_close(FREERDP_DSP_CONTEXT* context)
+{
+	opus_encoder_destroy(context->opusEncoder);
+	context->opusEncoder = NULL;
+	opus_decoder_destroy(context->opusDecoder);
+	context->opusDecoder = NULL;
+	opus_repacketizer_destroy(context->opusRepacketizer);
+	context->opusRepacketizer = NULL;
+	Stream_Free(context->opusPackets, TRUE);
+	context->opusPackets = NULL;
+}
+
+/**
+ * The frames of one call are joined to a single packet so that the receiver can decode each
+ * wave on its own. FramesPerPacket selects the longest frame size not exceeding it, the bit
+ * rate is taken from nAvgBytesPerSec.
+ */
+static BOOL freerdp_dsp_opus_open(FREERDP_DSP_CONTEXT* context, UINT32 FramesPerPacket)
+{
+	size_t x;
+	int error = OPUS_OK;
+	const UINT32 rate = context->format.nSamplesPerSec;
+	const int channels = context->format.nChannels;
+	/* frame durations in 1/10 ms */
+	const size_t durations[] = { 25, 50, 100, 200, 400, 600 };
+
+	freerdp_dsp_opus_close(context);
+
+	if (!freerdp_dsp_opus_supports_rate(rate) || (channels < 1) || (channels > 2))
+		return FALSE;
+
+	context->opusFrameSize = rate / 50;
+
+	for (x = 0; (FramesPerPacket > 0) && (x < ARRAYSIZE(durations)); x++)
+	{
+		const size_t frameSize = rate * durations[x] / 10000;
+
+		if ((frameSize <= FramesPerPacket) || (x == 0))
+			context->opusFrameSize = frameSize;
+	}
+
+	if (context->encoder)
+	{
+		context->opusEncoder = opus_encoder_create((opus_int32)rate, channels,
+		                                           OPUS_APPLICATION_AUDIO, &error);
+
+		if (!context->opusEncoder || (error != OPUS_OK))
+			return FALSE;
+
+		if (context->format.nAvgBytesPerSec > 0)
+		{
+			const opus_int32 bitrate = (opus_int32)(context->format.nAvgBytesPerSec * 8);
+
+			if (opus_encoder_ctl(context->opusEncoder, OPUS_SET_BITRATE(bitrate)) != OPUS_OK)
+				return FALSE;
+		}
+
+		context->opusPending = 0;
+		context->opusRepacketizer = opus_repacketizer_create();
+		context->opusPackets = Stream_New(NULL, 4096);
+
+		if (!context->opusRepacketizer || !context->opusPackets)
+			return FALSE;
+
+		Stream_SetPosition(context->buffer, 0);
+	}
+	else
+	{
+		context->opusDecoder = opus_decoder_create((opus_int32)rate, channels, &error);
+
+		if (!context->opusDecoder || (error != OPUS_OK))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_encode_opus(FREERDP_DSP_CONTEXT* context, const BYTE* src, size_t size,
+                                    wStream* out)
+{
+	size_t frames, encoded, remaining, maxFrames;
+	const size_t frameBytes =
+	    context->opusFrameSize * context->format.nChannels * sizeof(opus_int16);
+	size_t pending = context->opusPending;
+	const BYTE* next = NULL;
+	BYTE* buffer;
+	opus_int32 rc;
+
+	if (!context->opusEncoder || (frameBytes == 0))
+		return FALSE;
+
+	/* keep what does not fill a frame for the next call */
+	if (!Stream_EnsureRemainingCapacity(context->buffer, size))
+		return FALSE;
+
+	Stream_Write(context->buffer, src, size);
+	buffer = Stream_Buffer(context->buffer);
+	frames = Stream_GetPosition(context->buffer) / frameBytes;
+	maxFrames = OPUS_MAX_PACKET_MS * context->format.nSamplesPerSec / 1000 /
+	            context->opusFrameSize;
+	frames = MIN(frames, maxFrames - ((pending > 0) ? 1 : 0));
+
+	if ((frames == 0) && (pending == 0))
+		return TRUE;
+
+	if (!Stream_EnsureCapacity(context->opusPackets, pending + frames * OPUS_MAX_FRAME_BYTES))
+		return FALSE;
+
+	/* a frame left over from the last call comes first */
+	opus_repacketizer_init(context->opusRepacketizer);
+	Stream_SetPosition(context->opusPackets, pending);
+	context->opusPending = 0;
+
+	if ((pending > 0) && (opus_repacketizer_cat(context->opusRepacketizer,
+	                                            Stream_Buffer(context->opusPackets),
+	                                            (opus_int32)pending) != OPUS_OK))
+		return FALSE;
+
+	for (encoded = 0; encoded < frames; encoded++)
+	{
+		BYTE* packet = Stream_Pointer(context->opusPackets);
+		rc = opus_encode(context->opusEncoder, (const opus_int16*)&buffer[encoded * frameBytes],
+		                 (int)context->opusFrameSize, packet, OPUS_MAX_FRAME_BYTES);
+
+		if (rc < 0)
+		{
+			WLog_ERR(TAG, "opus_encode failed with %s", opus_strerror(rc));
+			return FALSE;
+		}
+
+		Stream_Seek(context->opusPackets, (size_t)rc);
+
+		/* the encoder switched its mode, the frame starts the next packet */
+		if (opus_repacketizer_cat(context->opusRepacketizer, packet, rc) != OPUS_OK)
+		{
+			next = packet;
+			context->opusPending = (size_t)rc;
+			encoded++;
+			break;
+		}
+	}
+
+	if (!Stream_EnsureRemainingCapacity(out, (frames + 1) * OPUS_MAX_FRAME_BYTES + 2))
+		return FALSE;
+
+	rc = opus_repacketizer_out(context->opusRepacketizer, Stream_Pointer(out),
+	                           (opus_int32)Stream_GetRemainingCapacity(out));
+
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "opus_repacketizer_out failed with %s", opus_strerror(rc));
+		return FALSE;
+	}
+
+	if (rc < OPUS_MIN_PACKET_BYTES)
+	{
+		if (opus_packet_pad(Stream_Pointer(out), rc, OPUS_MIN_PACKET_BYTES) != OPUS_OK)
+			return FALSE;
+
+		rc = OPUS_MIN_PACKET_BYTES;
+	}
+
+	Stream_Seek(out, (size_t)rc);
+
+	/* the repacketizer references the frames until here */
+	if (next)
+		memmove(Stream_Buffer(context->opusPackets), next, context->opusPending);
+
+	remaining = Stream_GetPosition(context->buffer) - encoded * frameBytes;
+	memmove(buffer, &buffer[encoded * frameBytes], remaining);
+	Stream_SetPosition(context->buffer, remaining);
+	return TRUE;
+}
+
+static BOOL freerdp_dsp_decode_opus(FREERDP_DSP_CONTEXT* context, const BYTE* src, size_t size,
+                                    wStream* out)
+{
+	int rc;
+	const size_t channels = context->format.nChannels;
+	const size_t maxFrames = OPUS_MAX_PACKET_MS * context->format.nSamplesPerSec / 1000;
+
+	if (!context->opusDecoder || (size > INT32_MAX))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(out, maxFrames * channels * sizeof(opus_int16)))
+		return FALSE;
+
+	rc = opus_decode(context->opusDecoder, src, (opus_int32)size,
+	                 (opus_int16*)Stream_Pointer(out), (int)maxFrames, 0);
+
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "opus_decode failed with %s", opus_strerror(rc));
+		return FALSE;
+	}
+
+	Stream_Seek(out, (size_t)rc * channels * sizeof(opus_int16));
+	return TRUE;
+}
+#endif
+
 #if defined(WITH_FAAD2)
 static BOOL freerdp_dsp_decode_faad(FREERDP_DSP_CONTEXT* context, const BYTE* src, size_t size,
                                     wStream* out)
@@ -825,7 +1246,7 @@ static BOOL freerdp_dsp_decode_ms_adpcm(FREERDP_DSP_CONTEXT* context, const BYTE
 	const UINT32 channels = context->format.nChannels;
 	const UINT32 block_size = context->format.nBlockAlign;
 
-	if (!Stream_EnsureCapacity(out, out_size))
+	if (!Stream_EnsureRemainingCapacity(out, out_size))
 		return FALSE;
 
 	while (size > 0)
@@ -1038,6 +1459,13 @@ FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(BOOL encoder)
 	if (!context->buffer)
 		goto fail;
 
+#if !defined(WITH_SOXR)
+	context->resampleHistory = Stream_New(NULL, 4096);
+
+	if (!context->resampleHistory)
+		goto fail;
+#endif
+
 	context->encoder = encoder;
 #if defined(WITH_GSM)
 	context->gsm = gsm_create();
@@ -1101,6 +1529,10 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 		Stream_Free(context->channelmix, TRUE);
 		Stream_Free(context->resample, TRUE);
 		Stream_Free(context->buffer, TRUE);
+#if !defined(WITH_SOXR)
+		Stream_Free(context->resampleHistory, TRUE);
+		free(context->resampleFilter);
+#endif
 #if defined(WITH_GSM)
 		gsm_destroy(context->gsm);
 #endif
@@ -1124,6 +1556,9 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 			faacEncClose(context->faac);
 
 #endif
+#if defined(WITH_OPUS)
+		freerdp_dsp_opus_close(context);
+#endif
 #if defined(WITH_SOXR)
 		soxr_delete(context->sox);
 #endif
@@ -1185,6 +1620,11 @@ BOOL freerdp_dsp_encode(FREERDP_DSP_CONTEXT* context, const AUDIO_FORMAT* srcFor
 		case WAVE_FORMAT_AAC_MS:
 			return freerdp_dsp_encode_faac(context, data, length, out);
 #endif
+#if defined(WITH_OPUS)
+
+		case WAVE_FORMAT_OPUS:
+			return freerdp_dsp_encode_opus(context, data, length, out);
+#endif
 
 		default:
 			return FALSE;
@@ -1233,6 +1673,11 @@ BOOL freerdp_dsp_decode(FREERDP_DSP_CONTEXT* context, const AUDIO_FORMAT* srcFor
 		case WAVE_FORMAT_AAC_MS:
 			return freerdp_dsp_decode_faad(context, data, length, out);
 #endif
+#if defined(WITH_OPUS)
+
+		case WAVE_FORMAT_OPUS:
+			return freerdp_dsp_decode_opus(context, data, length, out);
+#endif
 
 		default:
 			return FALSE;
@@ -1292,6 +1737,13 @@ BOOL freerdp_dsp_supports_format(const AUDIO_FORMAT* format, BOOL encode)
 			if (encode)
 				return TRUE;
 
+#endif
+			return FALSE;
+#if defined(WITH_OPUS)
+
+		case WAVE_FORMAT_OPUS:
+			return freerdp_dsp_opus_supports_rate(format->nSamplesPerSec) &&
+			       (format->nChannels >= 1) && (format->nChannels <= 2);
 #endif
 
 		default:
@@ -1357,17 +1809,22 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* context, const AUDIO_FORMAT*
 	}
 
 #endif
-#if defined(WITH_SOXR)
-	{
-		soxr_io_spec_t iospec = soxr_io_spec(SOXR_INT16, SOXR_INT16);
-		soxr_error_t error;
-		soxr_delete(context->sox);
-		context->sox = soxr_create(context->format.nSamplesPerSec, targetFormat->nSamplesPerSec,
-		                           targetFormat->nChannels, &error, &iospec, NULL, NULL);
+#if defined(WITH_OPUS)
 
-		if (!context->sox || (error != 0))
+	if (context->format.wFormatTag == WAVE_FORMAT_OPUS)
+	{
+		if (!freerdp_dsp_opus_open(context, FramesPerPacket))
 			return FALSE;
 	}
+	else
+		freerdp_dsp_opus_close(context);
+
+#endif
+	/* set up again for the source rate on the next resample */
+	context->resampleRate = 0;
+#if defined(WITH_SOXR)
+	soxr_delete(context->sox);
+	context->sox = NULL;
 #endif
 	return TRUE;
 #endif
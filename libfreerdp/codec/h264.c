@@ -25,6 +25,7 @@
 #include <winpr/library.h>
 #include <winpr/bitstream.h>
 #include <winpr/synch.h>
+#include <winpr/pool.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/codec/h264.h>
@@ -35,6 +36,13 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/* A tile that changed in at least this many of the last 8 frames is treated as video */
+#define H264_VIDEO_TILE_CHANGES 5
+/* QP increase for video tiles, text and UI keep the configured QP */
+#define H264_VIDEO_TILE_QP_OFFSET 6
+/* Frames between updates of the auxiliary (chroma) stream while the luma keeps changing */
+#define H264_CHROMA_REFRESH_INTERVAL 4
+
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight);
 
 BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
@@ -81,6 +89,30 @@ BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT3
 			if (!tmp1 || !tmp2)
 				return FALSE;
 		}
+
+		if (h264->Compressor)
+		{
+			const UINT32 tiles = ((width + 63) / 64) * ((height + 63) / 64);
+
+			for (x = 0; x < 2; x++)
+			{
+				BYTE* tmp = realloc(h264->pChangeHistory[x], MAX(tiles, 1));
+				if (!tmp)
+					return FALSE;
+				h264->pChangeHistory[x] = tmp;
+				ZeroMemory(tmp, tiles);
+			}
+
+			{
+				BYTE* tmp = realloc(h264->pPendingChroma, MAX(tiles, 1));
+				if (!tmp)
+					return FALSE;
+				h264->pPendingChroma = tmp;
+				ZeroMemory(tmp, tiles);
+			}
+			h264->changeHistorySize = tiles;
+			h264->chromaFrameCount = 0;
+		}
 	}
 
 	return TRUE;
@@ -96,6 +128,7 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	if (!h264 || h264->Compressor)
 		return -1001;
 
+	h264->FrameRendered = FALSE;
 	status = h264->subsystem->Decompress(h264, pSrcData, SrcSize);
 
 	if (status == 0)
@@ -104,6 +137,10 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	if (status < 0)
 		return status;
 
+	/* the decoder presented the frame in OutputWindow, there is nothing to convert */
+	if (h264->FrameRendered)
+		return 1;
+
 	pYUVData[0] = h264->pYUVData[0];
 	pYUVData[1] = h264->pYUVData[1];
 	pYUVData[2] = h264->pYUVData[2];
@@ -114,6 +151,30 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	return 1;
 }
 
+INT32 avc420_decompress_yuv(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize,
+                            const BYTE* pYUVData[3], UINT32 iStride[3])
+{
+	int status;
+	size_t x;
+
+	if (!h264 || h264->Compressor || !pYUVData || !iStride)
+		return -1001;
+
+	h264->FrameRendered = FALSE;
+	status = h264->subsystem->Decompress(h264, pSrcData, SrcSize);
+
+	if ((status <= 0) || h264->FrameRendered)
+		return (status < 0) ? status : 0;
+
+	for (x = 0; x < 3; x++)
+	{
+		pYUVData[x] = h264->pYUVData[x];
+		iStride[x] = h264->iStride[x];
+	}
+
+	return 1;
+}
+
 static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
                                     RDPGFX_H264_METABLOCK* meta, size_t count)
 {
@@ -180,12 +241,39 @@ static INLINE BOOL diff_tile(const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
 	return FALSE;
 }
 
-static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE_16* regionRect,
-                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3],
-                           RDPGFX_H264_METABLOCK* meta)
+static INLINE UINT32 count_changes(BYTE history)
 {
-	size_t count = 0, wc, hc;
+	UINT32 count = 0;
+
+	for (; history; history &= (BYTE)(history - 1))
+		count++;
+
+	return count;
+}
+
+/* Record the change state of a 64x64 tile, returns TRUE if it looks like video content */
+static BOOL update_change_history(H264_CONTEXT* h264, BYTE* history, const RECTANGLE_16* rect,
+                                  BOOL changed)
+{
+	const size_t columns = (h264->width + 63) / 64;
+	const size_t index = (rect->top / 64) * columns + rect->left / 64;
+
+	if (!history || (index >= h264->changeHistorySize))
+		return FALSE;
+
+	history[index] = (BYTE)((history[index] << 1) | (changed ? 1 : 0));
+	return count_changes(history[index]) >= H264_VIDEO_TILE_CHANGES;
+}
+
+static BOOL detect_changes(H264_CONTEXT* h264, BOOL firstFrameDone, BYTE* history,
+                           const RECTANGLE_16* regionRect, BYTE* pYUVData[3], BYTE* pOldYUVData[3],
+                           UINT32 const iStride[3], RDPGFX_H264_METABLOCK* meta)
+{
+	size_t x, y, count = 0, wc, hc;
 	RECTANGLE_16* rectangles;
+	BOOL* video;
+	BOOL rc = FALSE;
+	const UINT32 QP = h264->QP;
 
 	if (!regionRect || !pYUVData || !pOldYUVData || !iStride || !meta)
 		return FALSE;
@@ -193,8 +281,9 @@ static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE
 	wc = (regionRect->right - regionRect->left) / 64 + 1;
 	hc = (regionRect->bottom - regionRect->top) / 64 + 1;
 	rectangles = calloc(wc * hc, sizeof(RECTANGLE_16));
-	if (!rectangles)
-		return FALSE;
+	video = calloc(wc * hc, sizeof(BOOL));
+	if (!rectangles || !video)
+		goto fail;
 	if (!firstFrameDone)
 	{
 		rectangles[0] = *regionRect;
@@ -202,26 +291,47 @@ static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE
 	}
 	else
 	{
-		size_t x, y;
 		for (y = regionRect->top; y < regionRect->bottom; y += 64)
 		{
 			for (x = regionRect->left; x < regionRect->right; x += 64)
 			{
+				BOOL changed;
 				RECTANGLE_16 rect;
-				rect.left = (UINT16)MIN(UINT16_MAX, regionRect->left + x);
-				rect.top = (UINT16)MIN(UINT16_MAX, regionRect->top + y);
-				rect.right =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->left + x + 64, regionRect->right));
-				rect.bottom =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->top + y + 64, regionRect->bottom));
-				if (diff_tile(&rect, pYUVData, pOldYUVData, iStride))
+				rect.left = (UINT16)MIN(UINT16_MAX, x);
+				rect.top = (UINT16)MIN(UINT16_MAX, y);
+				rect.right = (UINT16)MIN(UINT16_MAX, MIN(x + 64, regionRect->right));
+				rect.bottom = (UINT16)MIN(UINT16_MAX, MIN(y + 64, regionRect->bottom));
+				changed = diff_tile(&rect, pYUVData, pOldYUVData, iStride);
+				video[count] = update_change_history(h264, history, &rect, changed);
+				if (changed)
 					rectangles[count++] = rect;
 			}
 		}
 	}
 	if (!allocate_h264_metablock(QP, rectangles, meta, count))
-		return FALSE;
-	return TRUE;
+	{
+		rectangles = NULL; /* owned by meta now */
+		goto fail;
+	}
+	rectangles = NULL;
+
+	/* Frequently changing tiles are cheaper, the encoder picks the QP up from meta */
+	for (x = 0; x < count; x++)
+	{
+		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
+		const UINT32 qp = MIN(51, (QP & 0x3F) + H264_VIDEO_TILE_QP_OFFSET);
+
+		if (!video[x])
+			continue;
+
+		cur->qp = (UINT8)((QP & 0xC0) | qp);
+		cur->qualityVal = (UINT8)(100 - qp);
+	}
+	rc = TRUE;
+fail:
+	free(rectangles);
+	free(video);
+	return rc;
 }
 
 INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
@@ -265,8 +375,8 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                           regionRect, 1))
 		return -1;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData, pOldYUVData,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, h264->pChangeHistory[0], regionRect,
+	                    pYUVData, pOldYUVData, h264->iStride, meta))
 		return -1;
 
 	if (meta->numRegionRects == 0)
@@ -275,12 +385,110 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	for (x = 0; x < 3; x++)
 		pcYUVData[x] = pYUVData[x];
 
-	rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
+	rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, meta, ppDstData, pDstSize);
 	if (rc >= 0)
 		h264->firstLumaFrameDone = TRUE;
 	return rc;
 }
 
+typedef struct
+{
+	H264_CONTEXT* h264;
+	const RECTANGLE_16* region;
+	BYTE** pYUVData;
+	BYTE** pOldYUVData;
+	RDPGFX_H264_METABLOCK* meta;
+	BOOL rc;
+} H264_DETECT_WORK_PARAM;
+
+static void CALLBACK avc444_detect_chroma_changes(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                  PTP_WORK work)
+{
+	H264_DETECT_WORK_PARAM* param = (H264_DETECT_WORK_PARAM*)context;
+	H264_CONTEXT* h264 = param->h264;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	param->rc = detect_changes(h264, h264->firstChromaFrameDone, h264->pChangeHistory[1],
+	                           param->region, param->pYUVData, param->pOldYUVData, h264->iStride,
+	                           param->meta);
+}
+
+/**
+ * Chroma changes are collected per 64x64 tile and only sent every ChromaRefreshInterval
+ * frames, or as soon as the luma is idle. In between the client shows the chroma of the
+ * main view. Tiles outside of the encoded region stay pending, the buffers only hold
+ * current data inside of it.
+ */
+static BOOL avc444_schedule_chroma(H264_CONTEXT* h264, const RECTANGLE_16* region, BOOL lumaIdle,
+                                   RDPGFX_H264_METABLOCK* auxMeta)
+{
+	size_t x, y, index;
+	size_t count = 0;
+	RECTANGLE_16* rectangles;
+	const size_t columns = (h264->width + 63) / 64;
+	const size_t rows = (h264->height + 63) / 64;
+	BYTE* pending = h264->pPendingChroma;
+
+	if ((h264->ChromaRefreshInterval <= 1) || !pending || (columns * rows > h264->changeHistorySize))
+		return TRUE;
+
+	for (index = 0; index < auxMeta->numRegionRects; index++)
+	{
+		const RECTANGLE_16* rect = &auxMeta->regionRects[index];
+
+		for (y = rect->top / 64; (y < rows) && (y * 64 < rect->bottom); y++)
+		{
+			for (x = rect->left / 64; (x < columns) && (x * 64 < rect->right); x++)
+				pending[y * columns + x] = 1;
+		}
+	}
+
+	h264->chromaFrameCount++;
+
+	if (h264->firstChromaFrameDone && !lumaIdle &&
+	    (h264->chromaFrameCount < h264->ChromaRefreshInterval))
+	{
+		free_h264_metablock(auxMeta);
+		return TRUE;
+	}
+
+	free_h264_metablock(auxMeta);
+	h264->chromaFrameCount = 0;
+	rectangles = calloc(columns * rows, sizeof(RECTANGLE_16));
+
+	if (!rectangles)
+		return FALSE;
+
+	for (y = 0; y < rows; y++)
+	{
+		for (x = 0; x < columns; x++)
+		{
+			RECTANGLE_16 rect;
+
+			if (!pending[y * columns + x])
+				continue;
+
+			rect.left = (UINT16)MAX(x * 64, region->left);
+			rect.top = (UINT16)MAX(y * 64, region->top);
+			rect.right = (UINT16)MIN(MIN(x * 64 + 64, h264->width), region->right);
+			rect.bottom = (UINT16)MIN(MIN(y * 64 + 64, h264->height), region->bottom);
+
+			if ((rect.left >= rect.right) || (rect.top >= rect.bottom))
+				continue;
+
+			if ((rect.left == x * 64) && (rect.top == y * 64) &&
+			    (rect.right == MIN(x * 64 + 64, h264->width)) &&
+			    (rect.bottom == MIN(y * 64 + 64, h264->height)))
+				pending[y * columns + x] = 0;
+
+			rectangles[count++] = rect;
+		}
+	}
+
+	return allocate_h264_metablock(h264->QP, rectangles, auxMeta, count);
+}
+
 INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
                       UINT32 nSrcWidth, UINT32 nSrcHeight, BYTE version, const RECTANGLE_16* region,
                       BYTE* op, BYTE** ppDstData, UINT32* pDstSize, BYTE** ppAuxDstData,
@@ -293,6 +501,9 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	BYTE** pOldYUV444Data;
 	BYTE** pYUVData;
 	BYTE** pOldYUVData;
+	H264_DETECT_WORK_PARAM param = { 0 };
+	PTP_WORK work = NULL;
+	INT32 rc = -1;
 
 	if (!h264 || !h264->Compressor)
 		return -1;
@@ -326,12 +537,48 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                           pYUV444Data, pYUVData, region, 1))
 		return -1;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, region, pYUV444Data, pOldYUV444Data,
-	                    h264->iStride, meta))
-		return -1;
-	if (!detect_changes(h264->firstChromaFrameDone, h264->QP, region, pYUVData, pOldYUVData,
-	                    h264->iStride, auxMeta))
-		return -1;
+	/* Both streams go through the same encoder (the client decodes them with a single
+	 * decoder as well), so only the chroma change detection runs next to the luma encode */
+	param.h264 = h264;
+	param.region = region;
+	param.pYUVData = pYUVData;
+	param.pOldYUVData = pOldYUVData;
+	param.meta = auxMeta;
+	work = CreateThreadpoolWork(avc444_detect_chroma_changes, &param, NULL);
+	if (work)
+		SubmitThreadpoolWork(work);
+	else
+		avc444_detect_chroma_changes(NULL, &param, NULL);
+
+	if (!detect_changes(h264, h264->firstLumaFrameDone, h264->pChangeHistory[0], region,
+	                    pYUV444Data, pOldYUV444Data, h264->iStride, meta))
+		goto fail;
+
+	if (meta->numRegionRects > 0)
+	{
+		const BYTE* pcYUV444Data[3] = { pYUV444Data[0], pYUV444Data[1], pYUV444Data[2] };
+
+		if (h264->subsystem->Compress(h264, pcYUV444Data, h264->iStride, meta, &coded,
+		                              &codedSize) < 0)
+			goto fail;
+		h264->firstLumaFrameDone = TRUE;
+		memcpy(h264->lumaData, coded, codedSize);
+		*ppDstData = h264->lumaData;
+		*pDstSize = codedSize;
+	}
+
+	if (work)
+	{
+		WaitForThreadpoolWorkCallbacks(work, FALSE);
+		CloseThreadpoolWork(work);
+		work = NULL;
+	}
+
+	if (!param.rc)
+		goto fail;
+
+	if (!avc444_schedule_chroma(h264, region, meta->numRegionRects == 0, auxMeta))
+		goto fail;
 
 	/* [MS-RDPEGFX] 2.2.4.5 RFX_AVC444_BITMAP_STREAM
 	 * LC:
@@ -351,30 +598,26 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 		return 0;
 	}
 
-	if ((*op == 0) || (*op == 1))
-	{
-		const BYTE* pcYUV444Data[3] = { pYUV444Data[0], pYUV444Data[1], pYUV444Data[2] };
-
-		if (h264->subsystem->Compress(h264, pcYUV444Data, h264->iStride, &coded, &codedSize) < 0)
-			return -1;
-		h264->firstLumaFrameDone = TRUE;
-		memcpy(h264->lumaData, coded, codedSize);
-		*ppDstData = h264->lumaData;
-		*pDstSize = codedSize;
-	}
-
 	if ((*op == 0) || (*op == 2))
 	{
 		const BYTE* pcYUVData[3] = { pYUVData[0], pYUVData[1], pYUVData[2] };
 
-		if (h264->subsystem->Compress(h264, pcYUVData, h264->iStride, &coded, &codedSize) < 0)
-			return -1;
+		if (h264->subsystem->Compress(h264, pcYUVData, h264->iStride, auxMeta, &coded,
+		                              &codedSize) < 0)
+			goto fail;
 		h264->firstChromaFrameDone = TRUE;
 		*ppAuxDstData = coded;
 		*pAuxDstSize = codedSize;
 	}
 
-	return 1;
+	rc = 1;
+fail:
+	if (work)
+	{
+		WaitForThreadpoolWorkCallbacks(work, FALSE);
+		CloseThreadpoolWork(work);
+	}
+	return rc;
 }
 
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
@@ -494,6 +737,10 @@ INT32 avc444_decompress(H264_CONTEXT* h264, BYTE op, const RECTANGLE_16* regionR
 	if (!h264 || !regionRects || !pSrcData || !pDstData || h264->Compressor)
 		return -1001;
 
+	/* both streams are combined in memory, a window only takes AVC420 */
+	if (h264->OutputWindow)
+		return -1001;
+
 	switch (op)
 	{
 		case 0: /* YUV420 in stream 1
@@ -587,6 +834,13 @@ static BOOL CALLBACK h264_register_subsystems(PINIT_ONCE once, PVOID param, PVOI
 		i++;
 	}
 #endif
+#if defined(__APPLE__) && defined(WITH_VIDEO_TOOLBOX)
+	{
+		extern H264_CONTEXT_SUBSYSTEM g_Subsystem_VideoToolbox;
+		subSystems[i] = &g_Subsystem_VideoToolbox;
+		i++;
+	}
+#endif
 #ifdef WITH_OPENH264
 	{
 		extern H264_CONTEXT_SUBSYSTEM g_Subsystem_OpenH264;
@@ -636,6 +890,23 @@ static BOOL h264_context_init(H264_CONTEXT* h264)
 	return FALSE;
 }
 
+BOOL h264_context_set_output_window(H264_CONTEXT* h264, void* window)
+{
+	if (!h264 || h264->Compressor)
+		return FALSE;
+
+	if (h264->OutputWindow == window)
+		return TRUE;
+
+	/* the window is passed to the decoder when it is configured */
+	if (h264->subsystem)
+		h264->subsystem->Uninit(h264);
+
+	h264->OutputWindow = window;
+	h264->FrameRendered = FALSE;
+	return h264_context_init(h264);
+}
+
 BOOL h264_context_reset(H264_CONTEXT* h264, UINT32 width, UINT32 height)
 {
 	if (!h264)
@@ -661,6 +932,7 @@ H264_CONTEXT* h264_context_new(BOOL Compressor)
 		/* Default compressor settings, may be changed by caller */
 		h264->BitRate = 1000000;
 		h264->FrameRate = 30;
+		h264->ChromaRefreshInterval = H264_CHROMA_REFRESH_INTERVAL;
 	}
 
 	if (!h264_context_init(h264))
@@ -696,6 +968,9 @@ void h264_context_free(H264_CONTEXT* h264)
 			_aligned_free(h264->pOldYUV444Data[x]);
 		}
 		_aligned_free(h264->lumaData);
+		free(h264->pChangeHistory[0]);
+		free(h264->pChangeHistory[1]);
+		free(h264->pPendingChroma);
 
 		yuv_context_free(h264->yuv);
 		free(h264);
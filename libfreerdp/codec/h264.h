@@ -28,8 +28,10 @@ typedef BOOL (*pfnH264SubsystemInit)(H264_CONTEXT* h264);
 typedef void (*pfnH264SubsystemUninit)(H264_CONTEXT* h264);
 
 typedef int (*pfnH264SubsystemDecompress)(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize);
+/* meta lists the changed regions and their QP, everything else is unchanged */
 typedef int (*pfnH264SubsystemCompress)(H264_CONTEXT* h264, const BYTE** pSrcYuv,
-                                        const UINT32* pStride, BYTE** ppDstData, UINT32* pDstSize);
+                                        const UINT32* pStride, const RDPGFX_H264_METABLOCK* meta,
+                                        BYTE** ppDstData, UINT32* pDstSize);
 
 struct S_H264_CONTEXT_SUBSYSTEM
 {
@@ -114,55 +114,53 @@ static void libavcodec_destroy_encoder(H264_CONTEXT* h264)
 	sys->codecEncoderContext = NULL;
 }
 
-static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
+static void libavcodec_set_rate_control(H264_CONTEXT* h264, AVCodecContext* context)
 {
-	BOOL recreate = FALSE;
-	H264_CONTEXT_LIBAVCODEC* sys;
-
-	if (!h264 || !h264->subsystem)
-		return FALSE;
+	/* Unknown options are ignored, not every encoder knows all of them */
+	switch (h264->RateControlMode)
+	{
+		case H264_RATECONTROL_VBR:
+			context->bit_rate = h264->BitRate;
+			break;
 
-	if ((h264->width > INT_MAX) || (h264->height > INT_MAX))
-		return FALSE;
+		case H264_RATECONTROL_CBR:
+			context->bit_rate = h264->BitRate;
+			context->rc_min_rate = h264->BitRate;
+			context->rc_max_rate = h264->BitRate;
+			/* a single frame of buffering keeps the latency low */
+			context->rc_buffer_size = (int)MIN(INT32_MAX, h264->BitRate / MAX(h264->FrameRate, 1));
+			av_opt_set(context, "nal-hrd", "cbr", AV_OPT_SEARCH_CHILDREN);
+			break;
 
-	sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
-	recreate = !sys->codecEncoder || !sys->codecEncoderContext;
+		case H264_RATECONTROL_CQP:
+			av_opt_set_int(context, "qp", h264->QP, AV_OPT_SEARCH_CHILDREN);
+			break;
 
-	if (sys->codecEncoderContext)
-	{
-		if ((sys->codecEncoderContext->width != (int)h264->width) ||
-		    (sys->codecEncoderContext->height != (int)h264->height))
-			recreate = TRUE;
+		default:
+			break;
 	}
 
-	if (!recreate)
-		return TRUE;
+	if (h264->MinQP > 0)
+		context->qmin = (int)MIN(INT32_MAX, h264->MinQP);
 
-	libavcodec_destroy_encoder(h264);
-	sys->codecEncoder = avcodec_find_encoder(AV_CODEC_ID_H264);
+	if (h264->MaxQP > 0)
+		context->qmax = (int)MIN(INT32_MAX, h264->MaxQP);
+}
 
-	if (!sys->codecEncoder)
-		goto EXCEPTION;
+static BOOL libavcodec_open_encoder(H264_CONTEXT* h264, AVCodec* codec)
+{
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+
+	if (!codec)
+		return FALSE;
 
+	sys->codecEncoder = codec;
 	sys->codecEncoderContext = avcodec_alloc_context3(sys->codecEncoder);
 
 	if (!sys->codecEncoderContext)
 		goto EXCEPTION;
 
-	switch (h264->RateControlMode)
-	{
-		case H264_RATECONTROL_VBR:
-			sys->codecEncoderContext->bit_rate = h264->BitRate;
-			break;
-
-		case H264_RATECONTROL_CQP:
-			/* TODO: sys->codecEncoderContext-> = h264->QP; */
-			break;
-
-		default:
-			break;
-	}
-
+	libavcodec_set_rate_control(h264, sys->codecEncoderContext);
 	sys->codecEncoderContext->width = (int)MIN(INT32_MAX, h264->width);
 	sys->codecEncoderContext->height = (int)MIN(INT32_MAX, h264->height);
 	sys->codecEncoderContext->delay = 0;
@@ -178,6 +176,53 @@ static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
 	if (avcodec_open2(sys->codecEncoderContext, sys->codecEncoder, NULL) < 0)
 		goto EXCEPTION;
 
+	WLog_Print(h264->log, WLOG_DEBUG, "Using %s to encode %" PRIu32 "x%" PRIu32 " frames",
+	           codec->name, h264->width, h264->height);
+	return TRUE;
+EXCEPTION:
+	if (sys->codecEncoderContext)
+	{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55, 69, 100)
+		avcodec_free_context(&sys->codecEncoderContext);
+#else
+		av_free(sys->codecEncoderContext);
+#endif
+	}
+
+	sys->codecEncoder = NULL;
+	sys->codecEncoderContext = NULL;
+	return FALSE;
+}
+
+static BOOL libavcodec_create_encoder(H264_CONTEXT* h264)
+{
+	BOOL recreate = FALSE;
+	H264_CONTEXT_LIBAVCODEC* sys;
+
+	if (!h264 || !h264->subsystem)
+		return FALSE;
+
+	if ((h264->width > INT_MAX) || (h264->height > INT_MAX))
+		return FALSE;
+
+	sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	recreate = !sys->codecEncoder || !sys->codecEncoderContext;
+
+	if (sys->codecEncoderContext)
+	{
+		if ((sys->codecEncoderContext->width != (int)h264->width) ||
+		    (sys->codecEncoderContext->height != (int)h264->height))
+			recreate = TRUE;
+	}
+
+	if (!recreate)
+		return TRUE;
+
+	libavcodec_destroy_encoder(h264);
+
+	if (!libavcodec_open_encoder(h264, avcodec_find_encoder(AV_CODEC_ID_H264)))
+		goto EXCEPTION;
+
 	return TRUE;
 EXCEPTION:
 	libavcodec_destroy_encoder(h264);
@@ -194,8 +239,6 @@ static int libavcodec_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
 	av_init_packet(sys->packet);
-#else
-	sys->packet = av_packet_alloc();
 #endif
 	sys->packet->data = (BYTE*)pSrcData;
 	sys->packet->size = (int)MIN(SrcSize, INT32_MAX);
@@ -204,11 +247,8 @@ static int libavcodec_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 
 	status = avcodec_send_packet(sys->codecDecoderContext, sys->packet);
 
-#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
+	/* the packet does not own the data, this only resets it for the next frame */
 	av_packet_unref(sys->packet);
-#else
-	av_packet_free(&sys->packet);
-#endif
 
 	if (status < 0)
 	{
@@ -296,11 +336,61 @@ static int libavcodec_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 	return 1;
 }
 
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 25, 100)
+/* Pass the changed regions with their QP as regions of interest, the rest of the frame did
+ * not change and is made as cheap as possible. */
+static BOOL libavcodec_set_regions_of_interest(H264_CONTEXT* h264, AVFrame* frame,
+                                               const RDPGFX_H264_METABLOCK* meta)
+{
+	UINT32 x;
+	AVFrameSideData* sd;
+	AVRegionOfInterest* roi;
+	const int frameQP = (int)(h264->QP & 0x3F);
+
+	av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+
+	if (!meta || !meta->regionRects || !meta->quantQualityVals || (meta->numRegionRects == 0))
+		return TRUE;
+
+	sd = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+	                            (meta->numRegionRects + 1ull) * sizeof(AVRegionOfInterest));
+
+	if (!sd)
+		return FALSE;
+
+	roi = (AVRegionOfInterest*)sd->data;
+
+	for (x = 0; x < meta->numRegionRects; x++)
+	{
+		const RECTANGLE_16* rect = &meta->regionRects[x];
+		const int qp = meta->quantQualityVals[x].qp & 0x3F;
+
+		roi[x].self_size = sizeof(AVRegionOfInterest);
+		roi[x].top = rect->top;
+		roi[x].bottom = rect->bottom;
+		roi[x].left = rect->left;
+		roi[x].right = rect->right;
+		roi[x].qoffset = av_make_q(qp - frameQP, 51);
+	}
+
+	/* The first region containing a macroblock applies, so this only covers static areas */
+	roi[x].self_size = sizeof(AVRegionOfInterest);
+	roi[x].top = 0;
+	roi[x].bottom = frame->height;
+	roi[x].left = 0;
+	roi[x].right = frame->width;
+	roi[x].qoffset = av_make_q(1, 1);
+	return TRUE;
+}
+#endif
+
 static int libavcodec_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const UINT32* pStride,
-                               BYTE** ppDstData, UINT32* pDstSize)
+                               const RDPGFX_H264_METABLOCK* meta, BYTE** ppDstData,
+                               UINT32* pDstSize)
 {
 	int status;
 	int gotFrame = 0;
+	AVFrame* frame;
 	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
 
 	if (!libavcodec_create_encoder(h264))
@@ -313,8 +403,6 @@ static int libavcodec_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const U
 #endif
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
 	av_init_packet(sys->packet);
-#else
-	sys->packet = av_packet_alloc();
 #endif
 	sys->packet->data = NULL;
 	sys->packet->size = 0;
@@ -334,9 +422,18 @@ static int libavcodec_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const U
 	sys->videoFrame->linesize[1] = (int)pStride[1];
 	sys->videoFrame->linesize[2] = (int)pStride[2];
 	sys->videoFrame->pts++;
+	frame = sys->videoFrame;
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 25, 100)
+
+	if (!libavcodec_set_regions_of_interest(h264, frame, meta))
+		return -1;
+
+#else
+	WINPR_UNUSED(meta);
+#endif
 	/* avcodec_encode_video2 is deprecated with libavcodec 57.48.101 */
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-	status = avcodec_send_frame(sys->codecEncoderContext, sys->videoFrame);
+	status = avcodec_send_frame(sys->codecEncoderContext, frame);
 
 	if (status < 0)
 	{
@@ -359,8 +456,8 @@ static int libavcodec_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const U
 
 	do
 	{
-		status = avcodec_encode_video2(sys->codecEncoderContext, sys->packet, sys->videoFrame,
-		                               &gotFrame);
+		status =
+		    avcodec_encode_video2(sys->codecEncoderContext, sys->packet, frame, &gotFrame);
 	} while ((status >= 0) && (gotFrame == 0));
 
 #else
@@ -406,6 +503,15 @@ static void libavcodec_uninit(H264_CONTEXT* h264)
 	if (!sys)
 		return;
 
+	if (sys->packet)
+	{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 133, 100)
+		av_packet_free(&sys->packet);
+#elif LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 39, 100)
+		av_packet_unref(sys->packet);
+#endif
+	}
+
 	if (sys->videoFrame)
 	{
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55, 18, 102)
@@ -521,11 +627,21 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 		goto EXCEPTION;
 	}
 
+	h264->pSystemData = (void*)sys;
+
+	/* allocated once, the packet is reused for every frame */
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
 	sys->packet = &sys->bufferpacket;
-#endif
+	av_init_packet(sys->packet);
+#else
+	sys->packet = av_packet_alloc();
 
-	h264->pSystemData = (void*)sys;
+	if (!sys->packet)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "Failed to allocate libav packet");
+		goto EXCEPTION;
+	}
+#endif
 
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)
 	avcodec_register_all();
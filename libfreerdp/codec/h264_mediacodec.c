@@ -24,6 +24,7 @@
 #include <freerdp/log.h>
 #include <freerdp/codec/h264.h>
 
+#include <android/native_window.h>
 #include <media/NdkMediaCodec.h>
 #include <media/NdkMediaFormat.h>
 
@@ -48,6 +49,7 @@ typedef struct
 	int32_t outputWidth;
 	int32_t outputHeight;
 	ssize_t currentOutputBufferIndex;
+	ANativeWindow* window; /* output surface, frames are rendered instead of read back */
 } H264_CONTEXT_MEDIACODEC;
 
 static AMediaFormat* mediacodec_format_new(wLog* log, int width, int height)
@@ -212,13 +214,15 @@ static void release_current_outputbuffer(H264_CONTEXT* h264)
 }
 
 static int mediacodec_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const UINT32* pStride,
-                               BYTE** ppDstData, UINT32* pDstSize)
+                               const RDPGFX_H264_METABLOCK* meta, BYTE** ppDstData,
+                               UINT32* pDstSize)
 {
 	WINPR_ASSERT(h264);
 	WINPR_ASSERT(pSrcYuv);
 	WINPR_ASSERT(pStride);
 	WINPR_ASSERT(ppDstData);
 	WINPR_ASSERT(pDstSize);
+	WINPR_UNUSED(meta);
 
 	WLog_Print(h264->log, WLOG_ERROR, "MediaCodec is not supported as an encoder");
 	return -1;
@@ -243,6 +247,8 @@ static int mediacodec_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 	pYUVData = h264->pYUVData;
 	WINPR_ASSERT(pYUVData);
 
+	h264->FrameRendered = FALSE;
+
 	iStride = h264->iStride;
 	WINPR_ASSERT(iStride);
 
@@ -332,7 +338,21 @@ static int mediacodec_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 		{
 			AMediaCodecBufferInfo bufferInfo;
 			ssize_t outputBufferId = AMediaCodec_dequeueOutputBuffer(sys->decoder, &bufferInfo, -1);
-			if (outputBufferId >= 0)
+			if ((outputBufferId >= 0) && sys->window)
+			{
+				/* the frame goes straight to the surface, no copy and no YUV conversion */
+				status = AMediaCodec_releaseOutputBuffer(sys->decoder, outputBufferId, TRUE);
+				if (status != AMEDIA_OK)
+				{
+					WLog_Print(h264->log, WLOG_ERROR, "Error AMediaCodec_releaseOutputBuffer %d",
+					           status);
+					return -1;
+				}
+
+				h264->FrameRendered = TRUE;
+				break;
+			}
+			else if (outputBufferId >= 0)
 			{
 				sys->currentOutputBufferIndex = outputBufferId;
 
@@ -433,6 +453,9 @@ static void mediacodec_uninit(H264_CONTEXT* h264)
 	set_mediacodec_format(h264, &sys->inputFormat, NULL);
 	set_mediacodec_format(h264, &sys->outputFormat, NULL);
 
+	if (sys->window)
+		ANativeWindow_release(sys->window);
+
 	free(sys);
 	h264->pSystemData = NULL;
 }
@@ -489,7 +512,13 @@ static BOOL mediacodec_init(H264_CONTEXT* h264)
 	set_mediacodec_format(h264, &sys->inputFormat,
 	                      mediacodec_format_new(h264->log, sys->width, sys->height));
 
-	status = AMediaCodec_configure(sys->decoder, sys->inputFormat, NULL, NULL, 0);
+	if (h264->OutputWindow)
+	{
+		sys->window = (ANativeWindow*)h264->OutputWindow;
+		ANativeWindow_acquire(sys->window);
+	}
+
+	status = AMediaCodec_configure(sys->decoder, sys->inputFormat, sys->window, NULL, 0);
 	if (status != AMEDIA_OK)
 	{
 		WLog_Print(h264->log, WLOG_ERROR, "AMediaCodec_configure failed: %d", status);
@@ -83,6 +83,7 @@ typedef struct
 	UINT32 frameHeight;
 	IMFSample* outputSample;
 	IMFMediaBuffer* outputBuffer;
+	IMFMediaBuffer* lockedBuffer; /* output buffer currently exposed in pYUVData */
 	HMODULE mfplat;
 	pfnMFStartup MFStartup;
 	pfnMFShutdown MFShutdown;
@@ -169,6 +170,17 @@ error:
 	return hr;
 }
 
+static void mf_release_locked_buffer(H264_CONTEXT* h264, H264_CONTEXT_MF* sys)
+{
+	if (!sys->lockedBuffer)
+		return;
+
+	sys->lockedBuffer->lpVtbl->Unlock(sys->lockedBuffer);
+	sys->lockedBuffer->lpVtbl->Release(sys->lockedBuffer);
+	sys->lockedBuffer = NULL;
+	memset(h264->pYUVData, 0, sizeof(h264->pYUVData));
+}
+
 static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize)
 {
 	HRESULT hr;
@@ -183,6 +195,10 @@ static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSiz
 	H264_CONTEXT_MF* sys = (H264_CONTEXT_MF*)h264->pSystemData;
 	UINT32* iStride = h264->iStride;
 	BYTE** pYUVData = h264->pYUVData;
+	int status = 0;
+
+	/* the previous frame is done with, give its buffer back to the decoder */
+	mf_release_locked_buffer(h264, sys);
 	hr = sys->MFCreateMemoryBuffer(SrcSize, &inputBuffer);
 
 	if (FAILED(hr))
@@ -241,12 +257,17 @@ static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSiz
 		goto error;
 	}
 
-	hr = mf_create_output_sample(h264, sys);
-
-	if (FAILED(hr))
+	/* the output sample is reused until the stream changes */
+	if (!sys->outputSample)
 	{
-		WLog_Print(h264->log, WLOG_ERROR, "mf_create_output_sample failure: 0x%08" PRIX32 "", hr);
-		goto error;
+		hr = mf_create_output_sample(h264, sys);
+
+		if (FAILED(hr))
+		{
+			WLog_Print(h264->log, WLOG_ERROR, "mf_create_output_sample failure: 0x%08" PRIX32 "",
+			           hr);
+			goto error;
+		}
 	}
 
 	outputDataBuffer.dwStreamID = 0;
@@ -312,8 +333,9 @@ static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSiz
 			goto error;
 		}
 
-		if (!avc420_ensure_buffer(h264, stride, sys->frameWidth, sys->frameHeight))
-			goto error;
+		iStride[0] = stride;
+		iStride[1] = (stride + 1) / 2;
+		iStride[2] = (stride + 1) / 2;
 	}
 	else if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT)
 	{
@@ -325,7 +347,7 @@ static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSiz
 	}
 	else
 	{
-		int offset = 0;
+		size_t offset = 0;
 		BYTE* buffer = NULL;
 		DWORD bufferCount = 0;
 		DWORD cbMaxLength = 0;
@@ -354,32 +376,34 @@ static int mf_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSiz
 			goto error;
 		}
 
-		CopyMemory(pYUVData[0], &buffer[offset], iStride[0] * sys->frameHeight);
-		offset += iStride[0] * sys->frameHeight;
-		CopyMemory(pYUVData[1], &buffer[offset], iStride[1] * (sys->frameHeight / 2));
-		offset += iStride[1] * (sys->frameHeight / 2);
-		CopyMemory(pYUVData[2], &buffer[offset], iStride[2] * (sys->frameHeight / 2));
-		offset += iStride[2] * (sys->frameHeight / 2);
-		hr = outputBuffer->lpVtbl->Unlock(outputBuffer);
+		/* IYUV planes are used in place, the buffer stays locked until the next frame */
+		sys->lockedBuffer = outputBuffer;
 
-		if (FAILED(hr))
+		if (cbCurrentLength <
+		    iStride[0] * sys->frameHeight + 2 * iStride[1] * (sys->frameHeight / 2))
 		{
-			WLog_Print(h264->log, WLOG_ERROR, "Unlock failure: 0x%08" PRIX32 "", hr);
+			WLog_Print(h264->log, WLOG_ERROR, "output buffer too small: %" PRIu32 "",
+			           cbCurrentLength);
 			goto error;
 		}
 
-		outputBuffer->lpVtbl->Release(outputBuffer);
+		pYUVData[0] = &buffer[offset];
+		offset += iStride[0] * sys->frameHeight;
+		pYUVData[1] = &buffer[offset];
+		offset += iStride[1] * (sys->frameHeight / 2);
+		pYUVData[2] = &buffer[offset];
+		status = 1;
 	}
 
 	inputSample->lpVtbl->Release(inputSample);
-	return 1;
+	return status;
 error:
 	fprintf(stderr, "mf_decompress error\n");
 	return -1;
 }
 
 static int mf_compress(H264_CONTEXT* h264, const BYTE** ppSrcYuv, const UINT32* pStride,
-                       BYTE** ppDstData, UINT32* pDstSize)
+                       const RDPGFX_H264_METABLOCK* meta, BYTE** ppDstData, UINT32* pDstSize)
 {
 	H264_CONTEXT_MF* sys = (H264_CONTEXT_MF*)h264->pSystemData;
 	return 1;
@@ -393,7 +417,6 @@ static BOOL mf_plat_loaded(H264_CONTEXT_MF* sys)
 
 static void mf_uninit(H264_CONTEXT* h264)
 {
-	UINT32 x;
 	H264_CONTEXT_MF* sys = (H264_CONTEXT_MF*)h264->pSystemData;
 
 	if (sys)
@@ -422,6 +445,8 @@ static void mf_uninit(H264_CONTEXT* h264)
 			sys->outputType = NULL;
 		}
 
+		mf_release_locked_buffer(h264, sys);
+
 		if (sys->outputSample)
 		{
 			sys->outputSample->lpVtbl->Release(sys->outputSample);
@@ -440,9 +465,6 @@ static void mf_uninit(H264_CONTEXT* h264)
 				CoUninitialize();
 		}
 
-		for (x = 0; x < sizeof(h264->pYUVData) / sizeof(h264->pYUVData[0]); x++)
-			_aligned_free(h264->pYUVData[x]);
-
 		memset(h264->pYUVData, 0, sizeof(h264->pYUVData));
 		memset(h264->iStride, 0, sizeof(h264->iStride));
 
@@ -179,11 +179,28 @@ static int openh264_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32
 	return 1;
 }
 
+/* OpenH264 has no per macroblock QP, use the best quality any changed region asks for */
+static UINT32 openh264_frame_qp(H264_CONTEXT* h264, const RDPGFX_H264_METABLOCK* meta)
+{
+	UINT32 x;
+	UINT32 qp = UINT32_MAX;
+
+	if (!meta || !meta->quantQualityVals)
+		return h264->QP;
+
+	for (x = 0; x < meta->numRegionRects; x++)
+		qp = MIN(qp, meta->quantQualityVals[x].qp & 0x3FU);
+
+	return (qp == UINT32_MAX) ? h264->QP : qp;
+}
+
 static int openh264_compress(H264_CONTEXT* h264, const BYTE** pYUVData, const UINT32* iStride,
-                             BYTE** ppDstData, UINT32* pDstSize)
+                             const RDPGFX_H264_METABLOCK* meta, BYTE** ppDstData,
+                             UINT32* pDstSize)
 {
 	int i, j;
 	int status;
+	UINT32 qp;
 	SFrameBSInfo info = { 0 };
 	SSourcePicture pic = { 0 };
 
@@ -197,6 +214,7 @@ static int openh264_compress(H264_CONTEXT* h264, const BYTE** pYUVData, const UI
 
 	sys = &((H264_CONTEXT_OPENH264*)h264->pSystemData)[0];
 	WINPR_ASSERT(sys);
+	qp = openh264_frame_qp(h264, meta);
 
 	if (!sys->pEncoder)
 		return -1;
@@ -249,12 +267,31 @@ static int openh264_compress(H264_CONTEXT* h264, const BYTE** pYUVData, const UI
 				    sys->EncParamExt.iTargetBitrate;
 				break;
 
+			case H264_RATECONTROL_CBR:
+				/* same as VBR, but the bitrate is capped at the target */
+				sys->EncParamExt.iRCMode = RC_BITRATE_MODE;
+				sys->EncParamExt.iTargetBitrate = (int)h264->BitRate;
+				sys->EncParamExt.iMaxBitrate = sys->EncParamExt.iTargetBitrate;
+				sys->EncParamExt.sSpatialLayers[0].iSpatialBitrate =
+				    sys->EncParamExt.iTargetBitrate;
+				sys->EncParamExt.sSpatialLayers[0].iMaxSpatialBitrate =
+				    sys->EncParamExt.iTargetBitrate;
+				break;
+
 			case H264_RATECONTROL_CQP:
 				sys->EncParamExt.iRCMode = RC_OFF_MODE;
-				sys->EncParamExt.sSpatialLayers[0].iDLayerQp = (int)h264->QP;
+				sys->EncParamExt.sSpatialLayers[0].iDLayerQp = (int)qp;
 				break;
 		}
 
+#if (OPENH264_MAJOR > 1) || (OPENH264_MINOR > 5)
+		if (h264->MinQP > 0)
+			sys->EncParamExt.iMinQp = (int)MIN(INT32_MAX, h264->MinQP);
+
+		if (h264->MaxQP > 0)
+			sys->EncParamExt.iMaxQp = (int)MIN(INT32_MAX, h264->MaxQP);
+#endif
+
 		if (sys->EncParamExt.iMultipleThreadIdc > 1)
 		{
 #if (OPENH264_MAJOR == 1) && (OPENH264_MINOR <= 5)
@@ -291,6 +328,7 @@ static int openh264_compress(H264_CONTEXT* h264, const BYTE** pYUVData, const UI
 		switch (h264->RateControlMode)
 		{
 			case H264_RATECONTROL_VBR:
+			case H264_RATECONTROL_CBR:
 				if (sys->EncParamExt.iTargetBitrate != (int)h264->BitRate)
 				{
 					SBitrateInfo bitrate = { 0 };
@@ -331,9 +369,9 @@ static int openh264_compress(H264_CONTEXT* h264, const BYTE** pYUVData, const UI
 				break;
 
 			case H264_RATECONTROL_CQP:
-				if (sys->EncParamExt.sSpatialLayers[0].iDLayerQp != (int)h264->QP)
+				if (sys->EncParamExt.sSpatialLayers[0].iDLayerQp != (int)qp)
 				{
-					sys->EncParamExt.sSpatialLayers[0].iDLayerQp = (int)h264->QP;
+					sys->EncParamExt.sSpatialLayers[0].iDLayerQp = (int)qp;
 
 					WINPR_ASSERT((*sys->pEncoder)->SetOption);
 					status = (*sys->pEncoder)
@@ -0,0 +1,486 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * H.264 Bitmap Compression - VideoToolbox decoder
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wlog.h>
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/h264.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreMedia/CoreMedia.h>
+#include <CoreVideo/CoreVideo.h>
+#include <VideoToolbox/VideoToolbox.h>
+
+#include "h264.h"
+
+#define NAL_TYPE_SPS 7
+#define NAL_TYPE_PPS 8
+#define NAL_TYPE_AUD 9
+
+typedef struct
+{
+	VTDecompressionSessionRef session;
+	CMVideoFormatDescriptionRef format;
+	BYTE* sps;
+	size_t spsSize;
+	BYTE* pps;
+	size_t ppsSize;
+	BOOL formatChanged;
+	BYTE* sample; /* length prefixed NAL units of the current frame */
+	size_t sampleSize;
+	size_t sampleCapacity;
+	OSStatus decodeStatus;
+	CVPixelBufferRef decoded; /* set by the output callback */
+	CVPixelBufferRef locked;  /* planes currently exposed in pYUVData */
+} H264_CONTEXT_VIDEOTOOLBOX;
+
+static void videotoolbox_release_locked(H264_CONTEXT_VIDEOTOOLBOX* sys)
+{
+	if (!sys->locked)
+		return;
+
+	CVPixelBufferUnlockBaseAddress(sys->locked, kCVPixelBufferLock_ReadOnly);
+	CVPixelBufferRelease(sys->locked);
+	sys->locked = NULL;
+}
+
+static void videotoolbox_output(void* decompressionOutputRefCon, void* sourceFrameRefCon,
+                                OSStatus status, VTDecodeInfoFlags infoFlags,
+                                CVImageBufferRef imageBuffer, CMTime presentationTimeStamp,
+                                CMTime presentationDuration)
+{
+	H264_CONTEXT_VIDEOTOOLBOX* sys = (H264_CONTEXT_VIDEOTOOLBOX*)decompressionOutputRefCon;
+
+	WINPR_UNUSED(sourceFrameRefCon);
+	WINPR_UNUSED(infoFlags);
+	WINPR_UNUSED(presentationTimeStamp);
+	WINPR_UNUSED(presentationDuration);
+	WINPR_ASSERT(sys);
+
+	sys->decodeStatus = status;
+
+	if ((status != noErr) || !imageBuffer)
+		return;
+
+	if (sys->decoded)
+		CVPixelBufferRelease(sys->decoded);
+
+	sys->decoded = CVPixelBufferRetain(imageBuffer);
+}
+
+static BOOL videotoolbox_set_parameter_set(BYTE** pData, size_t* pSize, const BYTE* nal,
+                                           size_t size, BOOL* changed)
+{
+	BYTE* data;
+
+	if ((*pSize == size) && (memcmp(*pData, nal, size) == 0))
+		return TRUE;
+
+	data = (BYTE*)realloc(*pData, size);
+
+	if (!data)
+		return FALSE;
+
+	memcpy(data, nal, size);
+	*pData = data;
+	*pSize = size;
+	*changed = TRUE;
+	return TRUE;
+}
+
+static BOOL videotoolbox_append_nal(H264_CONTEXT_VIDEOTOOLBOX* sys, const BYTE* nal, size_t size)
+{
+	BYTE* dst;
+	const size_t required = sys->sampleSize + 4 + size;
+
+	if (required > sys->sampleCapacity)
+	{
+		BYTE* sample = (BYTE*)realloc(sys->sample, required * 2);
+
+		if (!sample)
+			return FALSE;
+
+		sys->sample = sample;
+		sys->sampleCapacity = required * 2;
+	}
+
+	/* VideoToolbox takes AVCC samples, the start code is replaced by a big endian length */
+	dst = &sys->sample[sys->sampleSize];
+	dst[0] = (size >> 24) & 0xFF;
+	dst[1] = (size >> 16) & 0xFF;
+	dst[2] = (size >> 8) & 0xFF;
+	dst[3] = size & 0xFF;
+	memcpy(&dst[4], nal, size);
+	sys->sampleSize = required;
+	return TRUE;
+}
+
+static const BYTE* videotoolbox_next_start_code(const BYTE* data, const BYTE* end, size_t* length)
+{
+	while (end - data >= 3)
+	{
+		if ((data[0] == 0) && (data[1] == 0))
+		{
+			if (data[2] == 1)
+			{
+				*length = 3;
+				return data;
+			}
+
+			if ((end - data >= 4) && (data[2] == 0) && (data[3] == 1))
+			{
+				*length = 4;
+				return data;
+			}
+		}
+
+		data++;
+	}
+
+	*length = 0;
+	return end;
+}
+
+static BOOL videotoolbox_parse(H264_CONTEXT* h264, H264_CONTEXT_VIDEOTOOLBOX* sys,
+                               const BYTE* pSrcData, UINT32 SrcSize)
+{
+	size_t length;
+	const BYTE* end = &pSrcData[SrcSize];
+	const BYTE* nal = videotoolbox_next_start_code(pSrcData, end, &length);
+
+	sys->sampleSize = 0;
+
+	while (nal < end)
+	{
+		size_t nextLength;
+		const BYTE* start = &nal[length];
+		const BYTE* next = videotoolbox_next_start_code(start, end, &nextLength);
+		const size_t size = (size_t)(next - start);
+
+		if (size > 0)
+		{
+			switch (start[0] & 0x1F)
+			{
+				case NAL_TYPE_SPS:
+					if (!videotoolbox_set_parameter_set(&sys->sps, &sys->spsSize, start, size,
+					                                    &sys->formatChanged))
+						return FALSE;
+					break;
+
+				case NAL_TYPE_PPS:
+					if (!videotoolbox_set_parameter_set(&sys->pps, &sys->ppsSize, start, size,
+					                                    &sys->formatChanged))
+						return FALSE;
+					break;
+
+				case NAL_TYPE_AUD:
+					break;
+
+				default:
+					if (!videotoolbox_append_nal(sys, start, size))
+						return FALSE;
+					break;
+			}
+		}
+
+		nal = next;
+		length = nextLength;
+	}
+
+	if (sys->sampleSize == 0)
+		WLog_Print(h264->log, WLOG_DEBUG, "VideoToolbox: no picture data in %" PRIu32 " bytes",
+		           SrcSize);
+
+	return TRUE;
+}
+
+static void videotoolbox_session_free(H264_CONTEXT_VIDEOTOOLBOX* sys)
+{
+	if (sys->session)
+	{
+		VTDecompressionSessionInvalidate(sys->session);
+		CFRelease(sys->session);
+		sys->session = NULL;
+	}
+
+	if (sys->format)
+	{
+		CFRelease(sys->format);
+		sys->format = NULL;
+	}
+}
+
+static CFDictionaryRef videotoolbox_image_attributes(void)
+{
+	const SInt32 pixelFormat = kCVPixelFormatType_420YpCbCr8Planar;
+	CFNumberRef number = NULL;
+	CFDictionaryRef surface = NULL;
+	CFMutableDictionaryRef attributes = CFDictionaryCreateMutable(
+	    kCFAllocatorDefault, 2, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+	if (!attributes)
+		return NULL;
+
+	number = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &pixelFormat);
+	surface = CFDictionaryCreate(kCFAllocatorDefault, NULL, NULL, 0,
+	                             &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+	if (!number || !surface)
+		goto fail;
+
+	/* planar 4:2:0 matches pYUVData, IOSurface backing lets the planes be mapped without a copy */
+	CFDictionarySetValue(attributes, kCVPixelBufferPixelFormatTypeKey, number);
+	CFDictionarySetValue(attributes, kCVPixelBufferIOSurfacePropertiesKey, surface);
+	CFRelease(number);
+	CFRelease(surface);
+	return attributes;
+fail:
+	if (number)
+		CFRelease(number);
+
+	if (surface)
+		CFRelease(surface);
+
+	CFRelease(attributes);
+	return NULL;
+}
+
+static BOOL videotoolbox_session_new(H264_CONTEXT* h264, H264_CONTEXT_VIDEOTOOLBOX* sys)
+{
+	OSStatus status;
+	CFDictionaryRef attributes;
+	VTDecompressionOutputCallbackRecord callback = { videotoolbox_output, sys };
+	const uint8_t* parameterSets[] = { sys->sps, sys->pps };
+	const size_t parameterSetSizes[] = { sys->spsSize, sys->ppsSize };
+
+	videotoolbox_session_free(sys);
+
+	status = CMVideoFormatDescriptionCreateFromH264ParameterSets(
+	    kCFAllocatorDefault, 2, parameterSets, parameterSetSizes, 4, &sys->format);
+
+	if (status != noErr)
+	{
+		WLog_Print(h264->log, WLOG_ERROR,
+		           "CMVideoFormatDescriptionCreateFromH264ParameterSets failed: %d", (int)status);
+		return FALSE;
+	}
+
+	attributes = videotoolbox_image_attributes();
+
+	if (!attributes)
+		return FALSE;
+
+	status = VTDecompressionSessionCreate(kCFAllocatorDefault, sys->format, NULL, attributes,
+	                                      &callback, &sys->session);
+	CFRelease(attributes);
+
+	if (status != noErr)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "VTDecompressionSessionCreate failed: %d", (int)status);
+		return FALSE;
+	}
+
+	sys->formatChanged = FALSE;
+	return TRUE;
+}
+
+static int videotoolbox_compress(H264_CONTEXT* h264, const BYTE** pSrcYuv, const UINT32* pStride,
+                                 const RDPGFX_H264_METABLOCK* meta, BYTE** ppDstData,
+                                 UINT32* pDstSize)
+{
+	WINPR_ASSERT(h264);
+	WINPR_UNUSED(pSrcYuv);
+	WINPR_UNUSED(pStride);
+	WINPR_UNUSED(meta);
+	WINPR_UNUSED(ppDstData);
+	WINPR_UNUSED(pDstSize);
+
+	WLog_Print(h264->log, WLOG_ERROR, "VideoToolbox is not supported as an encoder");
+	return -1;
+}
+
+static int videotoolbox_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize)
+{
+	int rc = -1;
+	size_t i;
+	OSStatus status;
+	VTDecodeInfoFlags infoFlags = 0;
+	CMBlockBufferRef block = NULL;
+	CMSampleBufferRef sample = NULL;
+	H264_CONTEXT_VIDEOTOOLBOX* sys;
+
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(pSrcData);
+
+	sys = (H264_CONTEXT_VIDEOTOOLBOX*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	videotoolbox_release_locked(sys);
+
+	if (!videotoolbox_parse(h264, sys, pSrcData, SrcSize))
+		return -1;
+
+	if (sys->formatChanged && sys->sps && sys->pps)
+	{
+		if (!videotoolbox_session_new(h264, sys))
+			return -1;
+	}
+
+	if (sys->sampleSize == 0)
+		return 0;
+
+	if (!sys->session)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "VideoToolbox: picture data before SPS/PPS");
+		return -1;
+	}
+
+	status = CMBlockBufferCreateWithMemoryBlock(kCFAllocatorDefault, sys->sample, sys->sampleSize,
+	                                            kCFAllocatorNull, NULL, 0, sys->sampleSize, 0,
+	                                            &block);
+
+	if (status != kCMBlockBufferNoErr)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "CMBlockBufferCreateWithMemoryBlock failed: %d",
+		           (int)status);
+		goto fail;
+	}
+
+	status = CMSampleBufferCreateReady(kCFAllocatorDefault, block, sys->format, 1, 0, NULL, 1,
+	                                   &sys->sampleSize, &sample);
+
+	if (status != noErr)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "CMSampleBufferCreateReady failed: %d", (int)status);
+		goto fail;
+	}
+
+	/* synchronous decode, the output callback has run once the wait returns */
+	sys->decodeStatus = noErr;
+	status = VTDecompressionSessionDecodeFrame(sys->session, sample, 0, NULL, &infoFlags);
+
+	if (status == noErr)
+		status = VTDecompressionSessionWaitForAsynchronousFrames(sys->session);
+
+	if ((status != noErr) || (sys->decodeStatus != noErr))
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "VTDecompressionSessionDecodeFrame failed: %d/%d",
+		           (int)status, (int)sys->decodeStatus);
+		goto fail;
+	}
+
+	if (!sys->decoded)
+	{
+		rc = 0;
+		goto fail;
+	}
+
+	if ((CVPixelBufferGetWidth(sys->decoded) < h264->width) ||
+	    (CVPixelBufferGetHeight(sys->decoded) < h264->height))
+	{
+		WLog_Print(h264->log, WLOG_ERROR,
+		           "VideoToolbox: frame %" PRIuz "x%" PRIuz " smaller than %" PRIu32 "x%" PRIu32,
+		           CVPixelBufferGetWidth(sys->decoded), CVPixelBufferGetHeight(sys->decoded),
+		           h264->width, h264->height);
+		goto fail;
+	}
+
+	if (CVPixelBufferLockBaseAddress(sys->decoded, kCVPixelBufferLock_ReadOnly) !=
+	    kCVReturnSuccess)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "CVPixelBufferLockBaseAddress failed");
+		goto fail;
+	}
+
+	/* the planes stay mapped until the next frame or uninit, no copy into pYUVData */
+	sys->locked = sys->decoded;
+	sys->decoded = NULL;
+
+	for (i = 0; i < 3; i++)
+	{
+		h264->pYUVData[i] = (BYTE*)CVPixelBufferGetBaseAddressOfPlane(sys->locked, i);
+		h264->iStride[i] = (UINT32)CVPixelBufferGetBytesPerRowOfPlane(sys->locked, i);
+	}
+
+	rc = 1;
+fail:
+	if (sys->decoded)
+	{
+		CVPixelBufferRelease(sys->decoded);
+		sys->decoded = NULL;
+	}
+
+	if (sample)
+		CFRelease(sample);
+
+	if (block)
+		CFRelease(block);
+
+	return rc;
+}
+
+static void videotoolbox_uninit(H264_CONTEXT* h264)
+{
+	H264_CONTEXT_VIDEOTOOLBOX* sys;
+
+	WINPR_ASSERT(h264);
+
+	sys = (H264_CONTEXT_VIDEOTOOLBOX*)h264->pSystemData;
+
+	if (!sys)
+		return;
+
+	videotoolbox_release_locked(sys);
+	videotoolbox_session_free(sys);
+
+	if (sys->decoded)
+		CVPixelBufferRelease(sys->decoded);
+
+	free(sys->sps);
+	free(sys->pps);
+	free(sys->sample);
+	free(sys);
+	h264->pSystemData = NULL;
+}
+
+static BOOL videotoolbox_init(H264_CONTEXT* h264)
+{
+	H264_CONTEXT_VIDEOTOOLBOX* sys;
+
+	WINPR_ASSERT(h264);
+
+	if (h264->Compressor)
+	{
+		WLog_Print(h264->log, WLOG_DEBUG, "VideoToolbox is not supported as an encoder");
+		return FALSE;
+	}
+
+	sys = (H264_CONTEXT_VIDEOTOOLBOX*)calloc(1, sizeof(H264_CONTEXT_VIDEOTOOLBOX));
+
+	if (!sys)
+		return FALSE;
+
+	/* the session is created once the first SPS/PPS arrive */
+	h264->pSystemData = (void*)sys;
+	WLog_Print(h264->log, WLOG_DEBUG, "Initializing VideoToolbox");
+	return TRUE;
+}
+
+H264_CONTEXT_SUBSYSTEM g_Subsystem_VideoToolbox = { "VideoToolbox", videotoolbox_init,
+	                                                videotoolbox_uninit, videotoolbox_decompress,
+	                                                videotoolbox_compress };
@@ -151,10 +151,9 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					DESTWRITEPIXEL(pbDest, BLACK_PIXEL);
-					DESTNEXTPIXEL(pbDest);
-				});
+				/* BLACK_PIXEL is all zero bits */
+				ZeroMemory(pbDest, runLength * PIXEL_SIZE);
+				pbDest += runLength * PIXEL_SIZE;
 			}
 			else
 			{
@@ -173,11 +172,7 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					DESTREADPIXEL(temp, pbDest - rowDelta);
-					DESTWRITEPIXEL(pbDest, temp);
-					DESTNEXTPIXEL(pbDest);
-				});
+				pbDest = copy_previous_line(pbDest, rowDelta, runLength * PIXEL_SIZE);
 			}
 
 			/* A follow-on background run order will need a foreground pel inserted. */
@@ -201,7 +196,7 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 
 				if (code == LITE_SET_FG_FG_RUN || code == MEGA_MEGA_SET_FG_RUN)
 				{
-					if (pbSrc >= pbEnd)
+					if (!buffer_within_range(pbSrc, PIXEL_SIZE, pbEnd))
 						return FALSE;
 					SRCREADPIXEL(fgPel, pbSrc);
 					SRCNEXTPIXEL(pbSrc);
@@ -212,10 +207,11 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 
 				if (fFirstLine)
 				{
-					UNROLL(runLength, {
+					if (runLength > 0)
+					{
 						DESTWRITEPIXEL(pbDest, fgPel);
-						DESTNEXTPIXEL(pbDest);
-					});
+						pbDest = write_run(pbDest, PIXEL_SIZE, runLength * PIXEL_SIZE);
+					}
 				}
 				else
 				{
@@ -233,24 +229,22 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 			case MEGA_MEGA_DITHERED_RUN:
 				runLength = ExtractRunLength(code, pbSrc, pbEnd, &advance);
 				pbSrc = pbSrc + advance;
-				if (pbSrc >= pbEnd)
+				if (!buffer_within_range(pbSrc, 2 * PIXEL_SIZE, pbEnd))
 					return FALSE;
 				SRCREADPIXEL(pixelA, pbSrc);
 				SRCNEXTPIXEL(pbSrc);
-				if (pbSrc >= pbEnd)
-					return FALSE;
 				SRCREADPIXEL(pixelB, pbSrc);
 				SRCNEXTPIXEL(pbSrc);
 
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength * 2))
 					return FALSE;
 
-				UNROLL(runLength, {
+				if (runLength > 0)
+				{
 					DESTWRITEPIXEL(pbDest, pixelA);
-					DESTNEXTPIXEL(pbDest);
-					DESTWRITEPIXEL(pbDest, pixelB);
-					DESTNEXTPIXEL(pbDest);
-				});
+					DESTWRITEPIXEL(pbDest + PIXEL_SIZE, pixelB);
+					pbDest = write_run(pbDest, 2 * PIXEL_SIZE, runLength * 2 * PIXEL_SIZE);
+				}
 				break;
 
 			/* Handle Color Run Orders. */
@@ -258,7 +252,7 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 			case MEGA_MEGA_COLOR_RUN:
 				runLength = ExtractRunLength(code, pbSrc, pbEnd, &advance);
 				pbSrc = pbSrc + advance;
-				if (pbSrc >= pbEnd)
+				if (!buffer_within_range(pbSrc, PIXEL_SIZE, pbEnd))
 					return FALSE;
 				SRCREADPIXEL(pixelA, pbSrc);
 				SRCNEXTPIXEL(pbSrc);
@@ -266,10 +260,11 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
+				if (runLength > 0)
+				{
 					DESTWRITEPIXEL(pbDest, pixelA);
-					DESTNEXTPIXEL(pbDest);
-				});
+					pbDest = write_run(pbDest, PIXEL_SIZE, runLength * PIXEL_SIZE);
+				}
 				break;
 
 			/* Handle Foreground/Background Image Orders. */
@@ -284,10 +279,19 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 					return FALSE;
 				if (code == LITE_SET_FG_FGBG_IMAGE || code == MEGA_MEGA_SET_FGBG_IMAGE)
 				{
+					if (!buffer_within_range(pbSrc, PIXEL_SIZE, pbEnd))
+						return FALSE;
 					SRCREADPIXEL(fgPel, pbSrc);
 					SRCNEXTPIXEL(pbSrc);
 				}
 
+				/* one bitmask byte per 8 pixels */
+				if (!buffer_within_range(pbSrc, (runLength + 7) / 8, pbEnd))
+					return FALSE;
+
+				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
+					return FALSE;
+
 				if (fFirstLine)
 				{
 					while (runLength > 8)
@@ -347,14 +351,13 @@ static INLINE BOOL RLEDECOMPRESS(const BYTE* pbSrcBuffer, UINT32 cbSrcBuffer, BY
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					if (pbSrc >= pbEnd)
-						return FALSE;
-					SRCREADPIXEL(temp, pbSrc);
-					SRCNEXTPIXEL(pbSrc);
-					DESTWRITEPIXEL(pbDest, temp);
-					DESTNEXTPIXEL(pbDest);
-				});
+				/* source and destination share the pixel layout */
+				if (!buffer_within_range(pbSrc, runLength * PIXEL_SIZE, pbEnd))
+					return FALSE;
+
+				CopyMemory(pbDest, pbSrc, runLength * PIXEL_SIZE);
+				pbDest += runLength * PIXEL_SIZE;
+				pbSrc += runLength * PIXEL_SIZE;
 				break;
 
 			/* Handle Special Order 1. */
@@ -232,6 +232,49 @@ static INLINE BOOL ensure_capacity(const BYTE* start, const BYTE* end, size_t si
 	return rc && (start <= end);
 }
 
+static INLINE BOOL buffer_within_range(const BYTE* pbSrc, size_t size, const BYTE* pbEnd)
+{
+	return (pbSrc <= pbEnd) && ((size_t)(pbEnd - pbSrc) >= size);
+}
+
+/**
+ * Repeat the pattern in the first filled bytes of pbDest until size bytes are written.
+ * The capacity has to be checked by the caller, the pattern doubles with every copy.
+ */
+static INLINE BYTE* write_run(BYTE* pbDest, size_t filled, size_t size)
+{
+	if (filled == 1)
+		FillMemory(&pbDest[1], size - 1, pbDest[0]);
+	else
+	{
+		while (filled < size)
+		{
+			const size_t count = MIN(filled, size - filled);
+			CopyMemory(&pbDest[filled], pbDest, count);
+			filled += count;
+		}
+	}
+
+	return &pbDest[size];
+}
+
+/**
+ * Copy size bytes from the previous line. Chunks of at most rowDelta bytes never
+ * overlap, so this behaves like copying pixel by pixel.
+ */
+static INLINE BYTE* copy_previous_line(BYTE* pbDest, size_t rowDelta, size_t size)
+{
+	while (size > 0)
+	{
+		const size_t count = MIN(rowDelta, size);
+		CopyMemory(pbDest, pbDest - rowDelta, count);
+		pbDest += count;
+		size -= count;
+	}
+
+	return pbDest;
+}
+
 static INLINE void write_pixel_8(BYTE* _buf, BYTE _pix)
 {
 	*_buf = _pix;
@@ -260,7 +303,9 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
+#undef PIXEL_SIZE
 #define WHITE_PIXEL 0xFF
+#define PIXEL_SIZE 1
 #define DESTWRITEPIXEL(_buf, _pix) write_pixel_8(_buf, _pix)
 #define DESTREADPIXEL(_pix, _buf) _pix = (_buf)[0]
 #define SRCREADPIXEL(_pix, _buf) _pix = (_buf)[0]
@@ -284,7 +329,9 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
+#undef PIXEL_SIZE
 #define WHITE_PIXEL 0xFFFF
+#define PIXEL_SIZE 2
 #define DESTWRITEPIXEL(_buf, _pix) write_pixel_16(_buf, _pix)
 #define DESTREADPIXEL(_pix, _buf) _pix = ((UINT16*)(_buf))[0]
 #define SRCREADPIXEL(_pix, _buf) _pix = (_buf)[0] | ((_buf)[1] << 8)
@@ -308,7 +355,9 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 #undef RLEDECOMPRESS
 #undef RLEEXTRA
 #undef WHITE_PIXEL
+#undef PIXEL_SIZE
 #define WHITE_PIXEL 0xFFFFFF
+#define PIXEL_SIZE 3
 #define DESTWRITEPIXEL(_buf, _pix) write_pixel_24(_buf, _pix)
 #define DESTREADPIXEL(_pix, _buf) _pix = (_buf)[0] | ((_buf)[1] << 8) | ((_buf)[2] << 16)
 #define SRCREADPIXEL(_pix, _buf) _pix = (_buf)[0] | ((_buf)[1] << 8) | ((_buf)[2] << 16)
@@ -22,6 +22,7 @@
 #include <freerdp/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/assert.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
 
@@ -30,6 +31,9 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/* the hash chain walk stops early once a match is this long */
+#define NCRUSH_NICE_MATCH_LENGTH 258
+
 struct s_NCRUSH_CONTEXT
 {
 	BOOL Compressor;
@@ -42,6 +46,8 @@ struct s_NCRUSH_CONTEXT
 	UINT32 OffsetCache[4];
 	UINT16 HashTable[65536];
 	UINT16 MatchTable[65536];
+	UINT32 MaxChainDepth;
+	BOOL LazyMatching;
 	BYTE HuffTableCopyOffset[1024];
 	BYTE HuffTableLOM[4096];
 };
@@ -2400,6 +2406,49 @@ static int ncrush_find_best_match(NCRUSH_CONTEXT* ncrush, UINT16 HistoryOffset,
 	return MatchLength;
 }
 
+/**
+ * Walks the hash chain of HistoryOffset, looking at up to MaxChainDepth earlier
+ * occurrences of its first two bytes, and returns the longest match (0 if none).
+ * Two byte matches are only usable for small copy offsets.
+ */
+static UINT32 ncrush_find_chain_match(NCRUSH_CONTEXT* ncrush, UINT32 HistoryOffset,
+                                      UINT32* pMatchOffset)
+{
+	UINT32 depth;
+	UINT32 MatchLength = 0;
+	UINT32 Offset = ncrush->MatchTable[HistoryOffset];
+	const BYTE* HistoryBuffer = ncrush->HistoryBuffer;
+	const BYTE* CurrentPtr = &HistoryBuffer[HistoryOffset];
+	const UINT32 MaxLength = MIN((UINT32)(ncrush->HistoryPtr - CurrentPtr), 16385);
+
+	for (depth = 0; (depth < ncrush->MaxChainDepth) && Offset && (Offset < HistoryOffset);
+	     depth++)
+	{
+		const BYTE* CandidatePtr = &HistoryBuffer[Offset];
+
+		/* a candidate can only be longer if it matches at the current length */
+		if ((MatchLength < MaxLength) && (CandidatePtr[MatchLength] == CurrentPtr[MatchLength]))
+		{
+			const UINT32 Length = MIN(
+			    (UINT32)ncrush_find_match_length(CurrentPtr, CandidatePtr, ncrush->HistoryPtr),
+			    MaxLength);
+
+			if ((Length > MatchLength) && ((Length > 2) || (HistoryOffset - Offset < 64)))
+			{
+				MatchLength = Length;
+				*pMatchOffset = Offset;
+
+				if (MatchLength >= NCRUSH_NICE_MATCH_LENGTH)
+					break;
+			}
+		}
+
+		Offset = ncrush->MatchTable[Offset];
+	}
+
+	return MatchLength;
+}
+
 static int ncrush_move_encoder_windows(NCRUSH_CONTEXT* ncrush, BYTE* HistoryPtr)
 {
 	int i, j;
@@ -2480,6 +2529,9 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 	UINT32 CopyOffsetIndex;
 	UINT32 CopyOffsetBits;
 	UINT32 CompressionLevel;
+	UINT32 LazyOffset = 0;
+	UINT32 LazyLength = 0;
+	UINT32 LazyMatchOffset = 0;
 	CompressionLevel = 2;
 	HistoryBuffer = ncrush->HistoryBuffer;
 	*pFlags = 0;
@@ -2546,7 +2598,33 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSize
 		if (HistoryOffset >= 65536)
 			return -1004;
 
-		if (ncrush->MatchTable[HistoryOffset])
+		if (ncrush->MaxChainDepth > 0)
+		{
+			MatchOffset = 0;
+
+			if (HistoryOffset == LazyOffset)
+			{
+				MatchLength = LazyLength;
+				MatchOffset = LazyMatchOffset;
+			}
+			else
+				MatchLength = ncrush_find_chain_match(ncrush, HistoryOffset, &MatchOffset);
+
+			LazyOffset = 0;
+
+			/* emit a literal instead if the next position starts a longer match */
+			if (ncrush->LazyMatching && (MatchLength > 0) &&
+			    (MatchLength < NCRUSH_NICE_MATCH_LENGTH) && (SrcPtr + 1 < (SrcEndPtr - 2)))
+			{
+				LazyOffset = HistoryOffset + 1;
+				LazyMatchOffset = 0;
+				LazyLength = ncrush_find_chain_match(ncrush, LazyOffset, &LazyMatchOffset);
+
+				if (LazyLength > MatchLength)
+					MatchLength = 0;
+			}
+		}
+		else if (ncrush->MatchTable[HistoryOffset])
 		{
 			int rc;
 
@@ -2862,6 +2940,13 @@ void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush)
 	ncrush->HistoryPtr = &(ncrush->HistoryBuffer[ncrush->HistoryOffset]);
 }
 
+void ncrush_set_match_finder(NCRUSH_CONTEXT* ncrush, UINT32 MaxChainDepth, BOOL LazyMatching)
+{
+	WINPR_ASSERT(ncrush);
+	ncrush->MaxChainDepth = MaxChainDepth;
+	ncrush->LazyMatching = LazyMatching;
+}
+
 NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor)
 {
 	NCRUSH_CONTEXT* ncrush;
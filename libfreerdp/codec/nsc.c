@@ -35,6 +35,7 @@
 #include "nsc_encode.h"
 
 #include "nsc_sse2.h"
+#include "nsc_avx2.h"
 
 #ifndef NSC_INIT_SIMD
 #define NSC_INIT_SIMD(_nsc_context) \
@@ -45,23 +46,28 @@
 
 static BOOL nsc_decode(NSC_CONTEXT* context)
 {
-	UINT16 x;
-	UINT16 y;
-	UINT16 rw;
+	UINT32 x;
+	UINT32 y;
+	UINT32 rw;
+	UINT32 cs;
 	BYTE shift;
 	BYTE* bmpdata;
-	size_t pos = 0;
 
 	if (!context)
 		return FALSE;
 
 	rw = ROUND_UP_TO(context->width, 8);
-	shift = context->ColorLossLevel - 1; /* colorloss recovery + YCoCg shift */
+	cs = context->ChromaSubsamplingLevel ? 1 : 0; /* chroma planes hold every second pixel */
+	shift = context->ColorLossLevel - 1;          /* colorloss recovery + YCoCg shift */
 	bmpdata = context->BitmapData;
 
 	if (!bmpdata)
 		return FALSE;
 
+	/* all rows are checked at once so the pixel loop runs without bounds checks */
+	if (4ull * context->width * context->height > context->BitmapDataLength)
+		return FALSE;
+
 	for (y = 0; y < context->height; y++)
 	{
 		const BYTE* yplane;
@@ -84,25 +90,16 @@ static BOOL nsc_decode(NSC_CONTEXT* context)
 
 		for (x = 0; x < context->width; x++)
 		{
-			INT16 y_val = (INT16)*yplane;
-			INT16 co_val = (INT16)(INT8)(*coplane << shift);
-			INT16 cg_val = (INT16)(INT8)(*cgplane << shift);
-			INT16 r_val = y_val + co_val - cg_val;
-			INT16 g_val = y_val + cg_val;
-			INT16 b_val = y_val - co_val - cg_val;
-
-			if (pos + 4 > context->BitmapDataLength)
-				return FALSE;
-
-			pos += 4;
+			const INT16 y_val = (INT16)yplane[x];
+			const INT16 co_val = (INT16)(INT8)(coplane[x >> cs] << shift);
+			const INT16 cg_val = (INT16)(INT8)(cgplane[x >> cs] << shift);
+			const INT16 r_val = y_val + co_val - cg_val;
+			const INT16 g_val = y_val + cg_val;
+			const INT16 b_val = y_val - co_val - cg_val;
 			*bmpdata++ = MINMAX(b_val, 0, 0xFF);
 			*bmpdata++ = MINMAX(g_val, 0, 0xFF);
 			*bmpdata++ = MINMAX(r_val, 0, 0xFF);
-			*bmpdata++ = *aplane;
-			yplane++;
-			coplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			cgplane += (context->ChromaSubsamplingLevel ? x % 2 : 1);
-			aplane++;
+			*bmpdata++ = aplane[x];
 		}
 	}
 
@@ -118,16 +115,7 @@ static BOOL nsc_rle_decode(BYTE* in, BYTE* out, UINT32 outSize, UINT32 originalS
 		const BYTE value = *in++;
 		UINT32 len = 0;
 
-		if (left == 5)
-		{
-			if (outSize < 1)
-				return FALSE;
-
-			outSize--;
-			*out++ = value;
-			left--;
-		}
-		else if (value == *in)
+		if ((left > 5) && (value == *in))
 		{
 			in++;
 
@@ -155,12 +143,25 @@ static BOOL nsc_rle_decode(BYTE* in, BYTE* out, UINT32 outSize, UINT32 originalS
 		}
 		else
 		{
-			if (outSize < 1)
+			/* Copy all literals up to the next pair of equal bytes at once. The last byte
+			 * before the 4 raw trailing bytes is always a literal. */
+			const BYTE* literal = in - 1;
+			UINT32 count = 1;
+
+			while ((left - count > 5) && (literal[count] != literal[count + 1]))
+				count++;
+
+			if (left - count == 5)
+				count++;
+
+			if (outSize < count)
 				return FALSE;
 
-			outSize--;
-			*out++ = value;
-			left--;
+			outSize -= count;
+			CopyMemory(out, literal, count);
+			out += count;
+			in += count - 1;
+			left -= count;
 		}
 	}
 
@@ -352,6 +353,9 @@ NSC_CONTEXT* nsc_context_new(void)
 	context->ChromaSubsamplingLevel = 1;
 	/* init optimized methods */
 	NSC_INIT_SIMD(context);
+#if defined(WITH_SSE2)
+	nsc_init_avx2(context);
+#endif
 	return context;
 error:
 	nsc_context_free(context);
@@ -370,6 +374,9 @@ void nsc_context_free(NSC_CONTEXT* context)
 		for (i = 0; i < 5; i++)
 			free(context->priv->PlaneBuffers[i]);
 
+		for (i = 0; i < 4; i++)
+			free(context->priv->RleBuffers[i]);
+
 		nsc_profiler_print(context->priv);
 		PROFILER_FREE(context->priv->prof_nsc_rle_decompress_data)
 		PROFILER_FREE(context->priv->prof_nsc_decode)
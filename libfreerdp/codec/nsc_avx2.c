@@ -0,0 +1,247 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * NSCodec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include <freerdp/codec/color.h>
+
+#include "nsc_types.h"
+#include "nsc_avx2.h"
+
+/**
+ * The results are bit exact with nsc_encode, formats other than 32 bpp RGB
+ * are left to the previously installed encoder.
+ */
+
+typedef BOOL (*nsc_encode_fkt)(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline);
+
+static nsc_encode_fkt nsc_encode_fallback = NULL;
+
+static BOOL nsc_get_channel_offsets(UINT32 format, BYTE* r, BYTE* g, BYTE* b, BYTE* a)
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			*b = 0;
+			*g = 1;
+			*r = 2;
+			*a = 3;
+			return TRUE;
+
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			*r = 0;
+			*g = 1;
+			*b = 2;
+			*a = 3;
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+static BOOL nsc_encode_argb_to_aycocg_avx2(NSC_CONTEXT* context, const BYTE* data,
+                                           UINT32 scanline)
+{
+	UINT32 x, y;
+	BYTE r, g, b, a;
+	const BYTE ccl = (BYTE)context->ColorLossLevel;
+	const BOOL withAlpha =
+	    (context->format == PIXEL_FORMAT_BGRA32) || (context->format == PIXEL_FORMAT_RGBA32);
+	const UINT32 tempWidth = ROUND_UP_TO(context->width, 8);
+	const UINT32 rw = (context->ChromaSubsamplingLevel ? tempWidth : context->width);
+	const __m128i shift = _mm_cvtsi32_si128(ccl);
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	/* y, co, cg and a of 4 pixels in one 32 bit group each, per 128 bit half */
+	const __m256i transpose =
+	    _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, 0, 4, 8, 12, 1, 5,
+	                     9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	if (!nsc_get_channel_offsets(context->format, &r, &g, &b, &a))
+		return FALSE;
+
+	for (y = 0; y < context->height; y++)
+	{
+		const BYTE* src = data + (context->height - 1 - y) * scanline;
+		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
+		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
+		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
+		BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width;
+
+		for (x = 0; x + 8 <= context->width; x += 8)
+		{
+			const __m256i v = _mm256_loadu_si256((const __m256i*)src);
+			const __m256i r_val = _mm256_and_si256(_mm256_srli_epi32(v, 8 * r), byteMask);
+			const __m256i g_val = _mm256_and_si256(_mm256_srli_epi32(v, 8 * g), byteMask);
+			const __m256i b_val = _mm256_and_si256(_mm256_srli_epi32(v, 8 * b), byteMask);
+			const __m256i a_val = withAlpha ? _mm256_and_si256(v, opaque) : opaque;
+			const __m256i r_half = _mm256_srli_epi32(r_val, 1);
+			const __m256i b_half = _mm256_srli_epi32(b_val, 1);
+			const __m256i y_val =
+			    _mm256_add_epi32(_mm256_add_epi32(_mm256_srli_epi32(r_val, 2),
+			                                      _mm256_srli_epi32(g_val, 1)),
+			                     _mm256_srli_epi32(b_val, 2));
+			/* Perform color loss reduction here */
+			const __m256i co_val = _mm256_sra_epi32(_mm256_sub_epi32(r_val, b_val), shift);
+			const __m256i cg_val = _mm256_sra_epi32(
+			    _mm256_sub_epi32(_mm256_sub_epi32(g_val, r_half), b_half), shift);
+			__m256i packed = _mm256_or_si256(
+			    _mm256_or_si256(_mm256_and_si256(y_val, byteMask),
+			                    _mm256_slli_epi32(_mm256_and_si256(co_val, byteMask), 8)),
+			    _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(cg_val, byteMask), 16),
+			                    a_val));
+			__m128i lo, hi;
+			packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(packed, transpose), order);
+			lo = _mm256_castsi256_si128(packed);
+			hi = _mm256_extracti128_si256(packed, 1);
+			_mm_storel_epi64((__m128i*)yplane, lo);
+			_mm_storel_epi64((__m128i*)coplane, _mm_unpackhi_epi64(lo, lo));
+			_mm_storel_epi64((__m128i*)cgplane, hi);
+			_mm_storel_epi64((__m128i*)aplane, _mm_unpackhi_epi64(hi, hi));
+			src += 32;
+			yplane += 8;
+			coplane += 8;
+			cgplane += 8;
+			aplane += 8;
+		}
+
+		for (; x < context->width; x++)
+		{
+			const INT16 r_val = src[r];
+			const INT16 g_val = src[g];
+			const INT16 b_val = src[b];
+			*yplane++ = (BYTE)((r_val >> 2) + (g_val >> 1) + (b_val >> 2));
+			*coplane++ = (BYTE)((r_val - b_val) >> ccl);
+			*cgplane++ = (BYTE)((-(r_val >> 1) + g_val - (b_val >> 1)) >> ccl);
+			*aplane++ = withAlpha ? src[a] : 0xFF;
+			src += 4;
+		}
+
+		if (context->ChromaSubsamplingLevel && (x % 2) == 1)
+		{
+			*yplane = *(yplane - 1);
+			*coplane = *(coplane - 1);
+			*cgplane = *(cgplane - 1);
+		}
+	}
+
+	if (context->ChromaSubsamplingLevel && (y % 2) == 1)
+	{
+		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
+		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
+		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
+		CopyMemory(yplane, yplane - rw, rw);
+		CopyMemory(coplane, coplane - rw, rw);
+		CopyMemory(cgplane, cgplane - rw, rw);
+	}
+
+	return TRUE;
+}
+
+/* Average 2x2 blocks of signed chroma values, in place like nsc_encode_subsampling */
+static void nsc_subsample_plane_avx2(BYTE* plane, UINT32 tempWidth, UINT32 tempHeight)
+{
+	UINT32 y;
+	const UINT32 halfWidth = tempWidth >> 1;
+	const __m256i ones = _mm256_set1_epi8(1);
+
+	for (y = 0; y < tempHeight >> 1; y++)
+	{
+		UINT32 x;
+		BYTE* dst = plane + y * halfWidth;
+		const INT8* src0 = (const INT8*)plane + (y << 1) * tempWidth;
+		const INT8* src1 = src0 + tempWidth;
+
+		/* dst never overtakes the source bytes that are still to be read */
+		for (x = 0; x + 32 <= halfWidth; x += 32)
+		{
+			const __m256i a0 = _mm256_loadu_si256((const __m256i*)&src0[2 * x]);
+			const __m256i a1 = _mm256_loadu_si256((const __m256i*)&src0[2 * x + 32]);
+			const __m256i b0 = _mm256_loadu_si256((const __m256i*)&src1[2 * x]);
+			const __m256i b1 = _mm256_loadu_si256((const __m256i*)&src1[2 * x + 32]);
+			/* sums of horizontal pairs, the second operand is treated as signed */
+			const __m256i s0 = _mm256_add_epi16(_mm256_maddubs_epi16(ones, a0),
+			                                    _mm256_maddubs_epi16(ones, b0));
+			const __m256i s1 = _mm256_add_epi16(_mm256_maddubs_epi16(ones, a1),
+			                                    _mm256_maddubs_epi16(ones, b1));
+			const __m256i avg = _mm256_packs_epi16(_mm256_srai_epi16(s0, 2),
+			                                       _mm256_srai_epi16(s1, 2));
+			_mm256_storeu_si256((__m256i*)&dst[x], _mm256_permute4x64_epi64(avg, 0xD8));
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			dst[x] = (BYTE)(((INT16)src0[2 * x] + (INT16)src0[2 * x + 1] + (INT16)src1[2 * x] +
+			                 (INT16)src1[2 * x + 1]) >>
+			                2);
+		}
+	}
+}
+
+static BOOL nsc_encode_subsampling_avx2(NSC_CONTEXT* context)
+{
+	const UINT32 tempWidth = ROUND_UP_TO(context->width, 8);
+	const UINT32 tempHeight = ROUND_UP_TO(context->height, 2);
+
+	if (tempHeight == 0)
+		return FALSE;
+
+	if (tempWidth > context->priv->PlaneBuffersLength / tempHeight)
+		return FALSE;
+
+	nsc_subsample_plane_avx2(context->priv->PlaneBuffers[1], tempWidth, tempHeight);
+	nsc_subsample_plane_avx2(context->priv->PlaneBuffers[2], tempWidth, tempHeight);
+	return TRUE;
+}
+
+static BOOL nsc_encode_avx2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+{
+	if (!context || !data || (scanline == 0))
+		return FALSE;
+
+	if (!nsc_encode_argb_to_aycocg_avx2(context, data, scanline))
+		return nsc_encode_fallback(context, data, scanline);
+
+	if (context->ChromaSubsamplingLevel)
+	{
+		if (!nsc_encode_subsampling_avx2(context))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void nsc_init_avx2(NSC_CONTEXT* context)
+{
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return;
+
+	if (context->encode != nsc_encode_avx2)
+		nsc_encode_fallback = context->encode;
+
+	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_avx2")
+	context->encode = nsc_encode_avx2;
+}
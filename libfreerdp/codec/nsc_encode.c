@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include <winpr/crt.h>
+#include <winpr/pool.h>
 
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
@@ -33,6 +34,9 @@
 #include "nsc_types.h"
 #include "nsc_encode.h"
 
+/* Planes smaller than this are RLE encoded on the calling thread */
+#define NSC_PARALLEL_RLE_MIN_SIZE (256 * 256)
+
 typedef struct
 {
 	UINT32 x;
@@ -82,6 +86,21 @@ static BOOL nsc_context_initialize_encode(NSC_CONTEXT* context)
 		context->priv->PlaneBuffersLength = length;
 	}
 
+	if (length > context->priv->RleBuffersLength)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			BYTE* tmp = (BYTE*)realloc(context->priv->RleBuffers[i], length);
+
+			if (!tmp)
+				return FALSE;
+
+			context->priv->RleBuffers[i] = tmp;
+		}
+
+		context->priv->RleBuffersLength = length;
+	}
+
 	if (context->ChromaSubsamplingLevel)
 	{
 		context->OrgByteCount[0] = tempWidth * context->height;
@@ -385,33 +404,77 @@ static UINT32 nsc_rle_encode(const BYTE* in, BYTE* out, UINT32 originalSize)
 	return planeSize;
 }
 
-static void nsc_rle_compress_data(NSC_CONTEXT* context)
+typedef struct
+{
+	NSC_CONTEXT* context;
+	UINT32 plane;
+} NSC_RLE_WORK_PARAM;
+
+static void nsc_rle_compress_plane(NSC_CONTEXT* context, UINT32 i)
 {
-	UINT16 i;
 	UINT32 planeSize;
-	UINT32 originalSize;
+	const UINT32 originalSize = context->OrgByteCount[i];
 
-	for (i = 0; i < 4; i++)
+	if (originalSize == 0)
+	{
+		planeSize = 0;
+	}
+	else
 	{
-		originalSize = context->OrgByteCount[i];
+		planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i], context->priv->RleBuffers[i],
+		                           originalSize);
 
-		if (originalSize == 0)
-		{
-			planeSize = 0;
-		}
+		if (planeSize < originalSize)
+			CopyMemory(context->priv->PlaneBuffers[i], context->priv->RleBuffers[i], planeSize);
 		else
-		{
-			planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i],
-			                           context->priv->PlaneBuffers[4], originalSize);
-
-			if (planeSize < originalSize)
-				CopyMemory(context->priv->PlaneBuffers[i], context->priv->PlaneBuffers[4],
-				           planeSize);
-			else
-				planeSize = originalSize;
-		}
+			planeSize = originalSize;
+	}
+
+	context->PlaneByteCount[i] = planeSize;
+}
+
+static void CALLBACK nsc_rle_compress_plane_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                          void* context, PTP_WORK work)
+{
+	NSC_RLE_WORK_PARAM* param = (NSC_RLE_WORK_PARAM*)context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	nsc_rle_compress_plane(param->context, param->plane);
+}
+
+static void nsc_rle_compress_data(NSC_CONTEXT* context)
+{
+	UINT32 i;
+	PTP_WORK work_objects[4] = { 0 };
+	NSC_RLE_WORK_PARAM params[4];
+
+	/* The planes are independent, encode the alpha and chroma planes on the thread pool
+	 * while the luma plane is done here */
+	for (i = 1; i < 4; i++)
+	{
+		params[i].context = context;
+		params[i].plane = i;
+
+		if (context->OrgByteCount[i] >= NSC_PARALLEL_RLE_MIN_SIZE)
+			work_objects[i] =
+			    CreateThreadpoolWork(nsc_rle_compress_plane_work_callback, &params[i], NULL);
+
+		if (work_objects[i])
+			SubmitThreadpoolWork(work_objects[i]);
+		else
+			nsc_rle_compress_plane(context, i);
+	}
+
+	nsc_rle_compress_plane(context, 0);
+
+	for (i = 1; i < 4; i++)
+	{
+		if (!work_objects[i])
+			continue;
 
-		context->PlaneByteCount[i] = planeSize;
+		WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
+		CloseThreadpoolWork(work_objects[i]);
 	}
 }
 
@@ -39,6 +39,8 @@ typedef struct
 
 	BYTE* PlaneBuffers[5];     /* Decompressed Plane Buffers in the respective order */
 	UINT32 PlaneBuffersLength; /* Lengths of each plane buffer */
+	BYTE* RleBuffers[4];       /* Encoder output, one per plane so they can run in parallel */
+	UINT32 RleBuffersLength;
 
 	/* profilers */
 	PROFILER_DEFINE(prof_nsc_rle_decompress_data)
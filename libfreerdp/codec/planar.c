@@ -943,6 +943,9 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* planar, con
                                               UINT32 format, UINT32 width, UINT32 height,
                                               UINT32 scanline, BYTE* planes[4])
 {
+	INT32 step;
+	const primitives_t* prims = primitives_get();
+
 	WINPR_ASSERT(planar);
 
 	if ((width > INT32_MAX) || (height > INT32_MAX) || (scanline > INT32_MAX))
@@ -951,43 +954,17 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* planar, con
 	if (scanline == 0)
 		scanline = width * GetBytesPerPixel(format);
 
-	if (planar->topdown)
-	{
-		UINT32 i, j, k = 0;
-		for (i = 0; i < height; i++)
-		{
-			const BYTE* pixel = &data[scanline * (UINT32)i];
+	step = (INT32)scanline;
 
-			for (j = 0; j < width; j++)
-			{
-				const UINT32 color = ReadColor(pixel, format);
-				pixel += GetBytesPerPixel(format);
-				SplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				           &planes[0][k], NULL);
-				k++;
-			}
-		}
-	}
-	else
+	/* bottom up images are read from the last line on */
+	if (!planar->topdown && (height > 0))
 	{
-		INT64 i;
-		UINT32 j, k = 0;
-
-		for (i = (INT64)height - 1; i >= 0; i--)
-		{
-			const BYTE* pixel = &data[scanline * (UINT32)i];
-
-			for (j = 0; j < width; j++)
-			{
-				const UINT32 color = ReadColor(pixel, format);
-				pixel += GetBytesPerPixel(format);
-				SplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				           &planes[0][k], NULL);
-				k++;
-			}
-		}
+		data = &data[(size_t)scanline * (height - 1)];
+		step = -step;
 	}
-	return TRUE;
+
+	return prims->RGBToPlanar_8u_C4P4(data, format, step, planes, width, height) ==
+	       PRIMITIVES_SUCCESS;
 }
 
 static INLINE UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* pInBuffer, UINT32 cRawBytes,
@@ -1104,82 +1081,38 @@ static INLINE UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* pInBuffer
 	return (pOutput - pOutBuffer);
 }
 
-static INLINE UINT32 freerdp_bitmap_planar_encode_rle_bytes(const BYTE* pInBuffer,
+static INLINE UINT32 freerdp_bitmap_planar_encode_rle_bytes(const primitives_t* prims,
+                                                            const BYTE* pInBuffer,
                                                             UINT32 inBufferSize, BYTE* pOutBuffer,
                                                             UINT32 outBufferSize)
 {
-	BYTE symbol;
-	const BYTE* pInput;
-	BYTE* pOutput;
-	const BYTE* pBytes;
-	UINT32 cRawBytes;
-	UINT32 nRunLength;
-	UINT32 bSymbolMatch;
-	UINT32 nBytesWritten;
-	UINT32 nTotalBytesWritten;
-	symbol = 0;
-	cRawBytes = 0;
-	nRunLength = 0;
-	pInput = pInBuffer;
-	pOutput = pOutBuffer;
-	nTotalBytesWritten = 0;
+	UINT32 start = 0;
+	UINT32 nTotalBytesWritten = 0;
 
 	if (!outBufferSize)
 		return 0;
 
-	do
+	while (start < inBufferSize)
 	{
-		if (!inBufferSize)
-			break;
-
-		bSymbolMatch = (symbol == *pInput) ? TRUE : FALSE;
-		symbol = *pInput;
-		pInput++;
-		inBufferSize--;
+		UINT32 cRawBytes, nRunLength;
+		UINT32 nBytesWritten;
 
-		if (nRunLength && !bSymbolMatch)
-		{
-			if (nRunLength < 3)
-			{
-				cRawBytes += nRunLength;
-				nRunLength = 0;
-			}
-			else
-			{
-				pBytes = pInput - (cRawBytes + nRunLength + 1);
-				nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-				                                                      pOutput, outBufferSize);
-				nRunLength = 0;
-
-				if (!nBytesWritten || (nBytesWritten > outBufferSize))
-					return nRunLength;
-
-				nTotalBytesWritten += nBytesWritten;
-				outBufferSize -= nBytesWritten;
-				pOutput += nBytesWritten;
-				cRawBytes = 0;
-			}
-		}
-
-		nRunLength += bSymbolMatch;
-		cRawBytes += (!bSymbolMatch) ? TRUE : FALSE;
-	} while (outBufferSize);
+		if (prims->planarRleScan_8u(pInBuffer, start, inBufferSize, &cRawBytes, &nRunLength) !=
+		    PRIMITIVES_SUCCESS)
+			return 0;
 
-	if (cRawBytes || nRunLength)
-	{
-		pBytes = pInput - (cRawBytes + nRunLength);
-		nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-		                                                      pOutput, outBufferSize);
+		nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(
+		    &pInBuffer[start], cRawBytes, nRunLength, pOutBuffer, outBufferSize);
 
-		if (!nBytesWritten)
+		if (!nBytesWritten || (nBytesWritten > outBufferSize))
 			return 0;
 
 		nTotalBytesWritten += nBytesWritten;
+		outBufferSize -= nBytesWritten;
+		pOutBuffer += nBytesWritten;
+		start += cRawBytes + nRunLength;
 	}
 
-	if (inBufferSize)
-		return 0;
-
 	return nTotalBytesWritten;
 }
 
@@ -1192,6 +1125,7 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* inPlane, UINT32 width,
 	UINT32 outBufferSize;
 	UINT32 nBytesWritten;
 	UINT32 nTotalBytesWritten;
+	const primitives_t* prims = primitives_get();
 
 	if (!outPlane)
 		return FALSE;
@@ -1205,7 +1139,7 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* inPlane, UINT32 width,
 	while (outBufferSize)
 	{
 		nBytesWritten =
-		    freerdp_bitmap_planar_encode_rle_bytes(pInput, width, pOutput, outBufferSize);
+		    freerdp_bitmap_planar_encode_rle_bytes(prims, pInput, width, pOutput, outBufferSize);
 
 		if ((!nBytesWritten) || (nBytesWritten > outBufferSize))
 			return FALSE;
@@ -1278,10 +1212,7 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* inPlanes[4],
 BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* inPlane, UINT32 width, UINT32 height,
                                                BYTE* outPlane)
 {
-	char s2c;
-	UINT32 y, x;
-	BYTE* outPtr;
-	const BYTE *srcPtr, *prevLinePtr;
+	const primitives_t* prims = primitives_get();
 
 	if (!outPlane)
 	{
@@ -1292,24 +1223,7 @@ BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* inPlane, UINT32 width
 			return NULL;
 	}
 
-	// first line is copied as is
-	CopyMemory(outPlane, inPlane, width);
-	outPtr = outPlane + width;
-	srcPtr = inPlane + width;
-	prevLinePtr = inPlane;
-
-	for (y = 1; y < height; y++)
-	{
-		for (x = 0; x < width; x++, outPtr++, srcPtr++, prevLinePtr++)
-		{
-			INT32 delta = *srcPtr - *prevLinePtr;
-			s2c = (delta >= 0) ? (char)delta : (char)(~((BYTE)(-delta)) + 1);
-			s2c = (s2c >= 0) ? (char)((UINT32)s2c << 1)
-			                 : (char)(((UINT32)(~((BYTE)s2c) + 1) << 1) - 1);
-			*outPtr = (BYTE)s2c;
-		}
-	}
-
+	prims->planarDeltaEncode_8u_P1(inPlane, outPlane, width, height);
 	return outPlane;
 }
 
@@ -1361,11 +1275,10 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* context, const BYTE*
 		                                               context->deltaPlanes))
 			return NULL;
 
-		if (!freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
-		                                               context->rlePlanesBuffer, dstSizes,
-		                                               context->AllowSkipAlpha))
-			return NULL;
-
+		/* small or noisy bitmaps can grow with RLE, the raw planes are sent then */
+		if (freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
+		                                              context->rlePlanesBuffer, dstSizes,
+		                                              context->AllowSkipAlpha))
 		{
 			int offset = 0;
 			FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
@@ -35,6 +35,7 @@
 #include "rfx_differential.h"
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
+#include "rfx_encode.h"
 #include "rfx_rlgr.h"
 #include "rfx_types.h"
 #include "progressive.h"
@@ -374,63 +375,153 @@ progressive_get_surface_data(PROGRESSIVE_CONTEXT* progressive, UINT16 surfaceId)
 	return pData;
 }
 
-static void progressive_tile_free(RFX_PROGRESSIVE_TILE* tile)
+static BYTE* progressive_coeff_buffer_take(PROGRESSIVE_CONTEXT* progressive)
 {
-	if (tile)
-	{
-		_aligned_free(tile->sign);
-		_aligned_free(tile->current);
-		_aligned_free(tile->data);
-	}
+	BYTE* buffer;
+
+	if (progressive->numCoeffPool > 0)
+		buffer = progressive->coeffPool[--progressive->numCoeffPool];
+	else
+		buffer = (BYTE*)_aligned_malloc(PROGRESSIVE_COEFF_BUFFER_SIZE, 16);
+
+	if (buffer)
+		ZeroMemory(buffer, PROGRESSIVE_COEFF_BUFFER_SIZE);
+
+	return buffer;
+}
+
+static void progressive_coeff_buffer_return(PROGRESSIVE_CONTEXT* progressive, BYTE* buffer)
+{
+	if (!buffer)
+		return;
+
+	if (progressive->numCoeffPool < ARRAYSIZE(progressive->coeffPool))
+		progressive->coeffPool[progressive->numCoeffPool++] = buffer;
+	else
+		_aligned_free(buffer);
+}
+
+static void progressive_surface_account(PROGRESSIVE_SURFACE_CONTEXT* surface, size_t added,
+                                        size_t removed)
+{
+	surface->tileBytes += added;
+	surface->tileBytes -= removed;
+
+	if (surface->tileBytes > surface->peakTileBytes)
+		surface->peakTileBytes = surface->tileBytes;
 }
 
-static void progressive_surface_context_free(PROGRESSIVE_SURFACE_CONTEXT* surface)
+static void progressive_tile_free(PROGRESSIVE_CONTEXT* progressive,
+                                  PROGRESSIVE_SURFACE_CONTEXT* surface, RFX_PROGRESSIVE_TILE* tile)
+{
+	size_t removed = 0;
+
+	if (!tile)
+		return;
+
+	if (tile->sign)
+		removed += PROGRESSIVE_COEFF_BUFFER_SIZE;
+	if (tile->current)
+		removed += PROGRESSIVE_COEFF_BUFFER_SIZE;
+	if (tile->data)
+		removed += 1ull * tile->stride * tile->height;
+
+	progressive_coeff_buffer_return(progressive, tile->sign);
+	progressive_coeff_buffer_return(progressive, tile->current);
+	_aligned_free(tile->data);
+	tile->sign = NULL;
+	tile->current = NULL;
+	tile->data = NULL;
+	progressive_surface_account(surface, 0, removed);
+}
+
+/**
+ * Tiles at full quality never receive another upgrade, the sign state is only needed by
+ * upgrades. current is kept as first passes with RFX_TILE_DIFFERENCE refer to it.
+ */
+static void progressive_tile_compact(PROGRESSIVE_CONTEXT* progressive,
+                                     PROGRESSIVE_SURFACE_CONTEXT* surface,
+                                     RFX_PROGRESSIVE_TILE* tile)
+{
+	if (!tile->sign || (tile->quality != 0xFF))
+		return;
+
+	progressive_coeff_buffer_return(progressive, tile->sign);
+	tile->sign = NULL;
+	progressive_surface_account(surface, 0, PROGRESSIVE_COEFF_BUFFER_SIZE);
+}
+
+static void progressive_surface_context_free(PROGRESSIVE_CONTEXT* progressive,
+                                             PROGRESSIVE_SURFACE_CONTEXT* surface)
 {
 	UINT32 index;
 
+	if (!surface)
+		return;
+
 	for (index = 0; index < surface->gridSize; index++)
 	{
 		RFX_PROGRESSIVE_TILE* tile = &(surface->tiles[index]);
-		progressive_tile_free(tile);
+		progressive_tile_free(progressive, surface, tile);
 	}
 
+	WLog_Print(progressive->log, WLOG_DEBUG,
+	           "surface %" PRIu16 " peak tile memory %" PRIuz " bytes", surface->id,
+	           surface->peakTileBytes);
+
 	free(surface->tiles);
 	free(surface->updatedTileIndices);
 	free(surface);
 }
 
-static INLINE BOOL progressive_tile_allocate(RFX_PROGRESSIVE_TILE* tile)
+/* Tile buffers are allocated on first use, the encoder does not keep decoded pixels */
+static BOOL progressive_tile_allocate(PROGRESSIVE_CONTEXT* progressive,
+                                      PROGRESSIVE_SURFACE_CONTEXT* surface,
+                                      RFX_PROGRESSIVE_TILE* tile)
 {
-	BOOL rc = FALSE;
+	size_t added = 0;
+	BOOL rc = TRUE;
+
 	if (!tile)
 		return FALSE;
 
-	tile->width = 64;
-	tile->height = 64;
-	tile->stride = 4 * tile->width;
-
+	if (!progressive->Compressor && !tile->data)
 	{
-		size_t dataLen = tile->stride * tile->height * 1ULL;
+		size_t dataLen;
+
+		tile->width = 64;
+		tile->height = 64;
+		tile->stride = 4 * tile->width;
+		dataLen = tile->stride * tile->height * 1ULL;
 		tile->data = (BYTE*)_aligned_malloc(dataLen, 16);
 		if (tile->data)
+		{
 			memset(tile->data, 0xFF, dataLen);
+			added += dataLen;
+		}
+		else
+			rc = FALSE;
 	}
 
+	if (!tile->sign)
 	{
-		size_t signLen = (8192 + 32) * 3;
-		tile->sign = (BYTE*)_aligned_malloc(signLen, 16);
+		tile->sign = progressive_coeff_buffer_take(progressive);
+		if (tile->sign)
+			added += PROGRESSIVE_COEFF_BUFFER_SIZE;
+		else
+			rc = FALSE;
 	}
 
+	if (!tile->current)
 	{
-		size_t currentLen = (8192 + 32) * 3;
-		tile->current = (BYTE*)_aligned_malloc(currentLen, 16);
+		tile->current = progressive_coeff_buffer_take(progressive);
+		if (tile->current)
+			added += PROGRESSIVE_COEFF_BUFFER_SIZE;
+		else
+			rc = FALSE;
 	}
 
-	rc = tile->data && tile->sign && tile->current;
-
-	if (!rc)
-		progressive_tile_free(tile);
-
+	progressive_surface_account(surface, added, 0);
 	return rc;
 }
 
@@ -441,9 +532,12 @@ static BOOL progressive_allocate_tile_cache(PROGRESSIVE_SURFACE_CONTEXT* surface
 	WINPR_ASSERT(surface);
 	WINPR_ASSERT(surface->gridSize > 0);
 
-	oldIndex = surface->gridSize;
+	oldIndex = 0;
 	if (surface->tiles)
+	{
+		oldIndex = surface->gridSize;
 		surface->gridSize *= 2;
+	}
 
 	{
 		void* tmp = realloc(surface->tiles, surface->gridSize * sizeof(RFX_PROGRESSIVE_TILE));
@@ -467,7 +561,6 @@ static BOOL progressive_allocate_tile_cache(PROGRESSIVE_SURFACE_CONTEXT* surface
 static PROGRESSIVE_SURFACE_CONTEXT* progressive_surface_context_new(UINT16 surfaceId, UINT32 width,
                                                                     UINT32 height)
 {
-	UINT32 x;
 	PROGRESSIVE_SURFACE_CONTEXT* surface;
 	surface = (PROGRESSIVE_SURFACE_CONTEXT*)calloc(1, sizeof(PROGRESSIVE_SURFACE_CONTEXT));
 
@@ -483,22 +576,17 @@ static PROGRESSIVE_SURFACE_CONTEXT* progressive_surface_context_new(UINT16 surfa
 
 	if (!progressive_allocate_tile_cache(surface))
 	{
-		progressive_surface_context_free(surface);
+		free(surface->tiles);
+		free(surface->updatedTileIndices);
+		free(surface);
 		return NULL;
 	}
-	for (x = 0; x < surface->gridSize; x++)
-	{
-		if (!progressive_tile_allocate(&surface->tiles[x]))
-		{
-			progressive_surface_context_free(surface);
-			return NULL;
-		}
-	}
 
 	return surface;
 }
 
-static BOOL progressive_surface_tile_replace(PROGRESSIVE_SURFACE_CONTEXT* surface,
+static BOOL progressive_surface_tile_replace(PROGRESSIVE_CONTEXT* progressive,
+                                             PROGRESSIVE_SURFACE_CONTEXT* surface,
                                              PROGRESSIVE_BLOCK_REGION* region,
                                              const RFX_PROGRESSIVE_TILE* tile, BOOL upgrade)
 {
@@ -518,6 +606,9 @@ static BOOL progressive_surface_tile_replace(PROGRESSIVE_SURFACE_CONTEXT* surfac
 
 	t = &surface->tiles[zIdx];
 
+	if (!progressive_tile_allocate(progressive, surface, t))
+		return FALSE;
+
 	if (upgrade)
 	{
 		t->blockType = tile->blockType;
@@ -599,7 +690,7 @@ INT32 progressive_create_surface_context(PROGRESSIVE_CONTEXT* progressive, UINT1
 
 		if (!progressive_set_surface_data(progressive, surfaceId, (void*)surface))
 		{
-			progressive_surface_context_free(surface);
+			progressive_surface_context_free(progressive, surface);
 			return -1;
 		}
 	}
@@ -614,7 +705,7 @@ int progressive_delete_surface_context(PROGRESSIVE_CONTEXT* progressive, UINT16
 	if (surface)
 	{
 		progressive_set_surface_data(progressive, surfaceId, NULL);
-		progressive_surface_context_free(surface);
+		progressive_surface_context_free(progressive, surface);
 	}
 
 	return 1;
@@ -857,7 +948,7 @@ static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* progressive
 		CopyMemory(buffer, current, 4096 * 2);
 	else
 		CopyMemory(current, buffer, 4096 * 2);
-	temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
+	temp = (INT16*)rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_DWT);
 	if (!temp)
 		return -2;
 
@@ -871,7 +962,6 @@ static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* progressive
 		progressive_rfx_dwt_2d_decode_block(&buffer[3007], temp, 2);
 		progressive_rfx_dwt_2d_decode_block(&buffer[0], temp, 1);
 	}
-	BufferPool_Return(progressive->bufferPool, temp);
 	return 1;
 }
 
@@ -1039,7 +1129,10 @@ static INLINE int progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* progres
 	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
+	pBuffer = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_TILE);
+	if (!pBuffer)
+		return -1;
+
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
@@ -1062,7 +1155,6 @@ static INLINE int progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* progres
 	rc = prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
 	                                    tile->stride, progressive->format, &roi_64x64);
 fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return rc;
 }
 
@@ -1464,7 +1556,10 @@ static INLINE int progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* progr
 	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
+	pBuffer = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_TILE);
+	if (!pBuffer)
+		return -1;
+
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
@@ -1496,7 +1591,6 @@ static INLINE int progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* progr
 	status = prims->yCbCrToRGB_16s8u_P3AC4R((const INT16* const*)pSrcDst, 64 * 2, tile->data,
 	                                        tile->stride, progressive->format, &roi_64x64);
 fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return status;
 }
 
@@ -1579,7 +1673,7 @@ static INLINE BOOL progressive_tile_read_upgrade(PROGRESSIVE_CONTEXT* progressiv
 		return FALSE;
 	}
 
-	return progressive_surface_tile_replace(surface, region, &tile, TRUE);
+	return progressive_surface_tile_replace(progressive, surface, region, &tile, TRUE);
 }
 
 static INLINE BOOL progressive_tile_read(PROGRESSIVE_CONTEXT* progressive, BOOL simple, wStream* s,
@@ -1645,7 +1739,7 @@ static INLINE BOOL progressive_tile_read(PROGRESSIVE_CONTEXT* progressive, BOOL
 		return FALSE;
 	}
 
-	return progressive_surface_tile_replace(surface, region, &tile, FALSE);
+	return progressive_surface_tile_replace(progressive, surface, region, &tile, FALSE);
 }
 
 typedef struct
@@ -1865,7 +1959,8 @@ static INLINE BOOL progressive_write_wb_sync(PROGRESSIVE_CONTEXT* progressive, w
 	return TRUE;
 }
 
-static INLINE BOOL progressive_write_wb_context(PROGRESSIVE_CONTEXT* progressive, wStream* s)
+static INLINE BOOL progressive_write_wb_context(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                                BYTE flags)
 {
 	const UINT32 blockLen = 10;
 	WINPR_ASSERT(progressive);
@@ -1878,7 +1973,7 @@ static INLINE BOOL progressive_write_wb_context(PROGRESSIVE_CONTEXT* progressive
 	Stream_Write_UINT32(s, blockLen);                /* blockLen (4 bytes) */
 	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
 	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
-	Stream_Write_UINT8(s, 0);                        /* flags (1 byte) */
+	Stream_Write_UINT8(s, flags);                    /* flags (1 byte) */
 	return TRUE;
 }
 
@@ -1949,19 +2044,18 @@ static INLINE BOOL progressive_write_region(PROGRESSIVE_CONTEXT* progressive, wS
 }
 
 static INLINE BOOL progressive_write_frame_begin(PROGRESSIVE_CONTEXT* progressive, wStream* s,
-                                                 const RFX_MESSAGE* msg)
+                                                 UINT32 frameIndex)
 {
 	const UINT32 blockLen = 12;
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(msg);
 
 	if (!Stream_EnsureRemainingCapacity(s, blockLen))
 		return FALSE;
 
 	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
 	Stream_Write_UINT32(s, blockLen);                    /* blockLen (4 bytes) */
-	Stream_Write_UINT32(s, msg->frameIdx);               /* frameIndex (4 bytes) */
+	Stream_Write_UINT32(s, frameIndex);                  /* frameIndex (4 bytes) */
 	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
 
 	return TRUE;
@@ -2588,6 +2682,7 @@ INT32 progressive_decompress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcD
 		}
 
 		region16_uninit(&updateRegion);
+		progressive_tile_compact(progressive, surface, tile);
 	}
 
 	region16_uninit(&clippingRects);
@@ -2616,10 +2711,10 @@ static BOOL progressive_rfx_write_message_progressive_simple(PROGRESSIVE_CONTEXT
 	if (!progressive_write_wb_sync(progressive, s))
 		return FALSE;
 
-	if (!progressive_write_wb_context(progressive, s))
+	if (!progressive_write_wb_context(progressive, s, 0))
 		return FALSE;
 
-	if (!progressive_write_frame_begin(progressive, s, msg))
+	if (!progressive_write_frame_begin(progressive, s, msg->frameIdx))
 		return FALSE;
 
 	if (!progressive_write_region(progressive, s, msg))
@@ -2760,78 +2855,1151 @@ fail:
 	return res;
 }
 
-BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* progressive)
+/* Default RemoteFX quantization in RDPEGFX band order, see progressive_write_region */
+static const RFX_COMPONENT_CODEC_QUANT progressive_encode_quant = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+
+/**
+ * Quality layers of the progressive encoder. The first pass of a tile uses the
+ * first entry, every upgrade pass moves on to the next one and the last upgrade
+ * is sent with quality 0xFF (no progressive quantization).
+ */
+static const RFX_PROGRESSIVE_CODEC_QUANT progressive_encode_quant_prog[] = {
+	{ 25,
+	  { 2, 4, 4, 4, 4, 4, 4, 4, 4, 4 },
+	  { 2, 4, 4, 4, 4, 4, 4, 4, 4, 4 },
+	  { 2, 4, 4, 4, 4, 4, 4, 4, 4, 4 } },
+	{ 60,
+	  { 1, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+	  { 1, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+	  { 1, 2, 2, 2, 2, 2, 2, 2, 2, 2 } }
+};
+
+static INLINE INT16 progressive_rfx_clamp16(INT32 value)
 {
-	if (!progressive)
-		return FALSE;
+	if (value > INT16_MAX)
+		return INT16_MAX;
 
-	return TRUE;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+
+	return (INT16)value;
 }
 
-PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor)
+/**
+ * Forward transform of progressive_rfx_idwt_x/progressive_rfx_idwt_y for one line of
+ * nLowCount + nHighCount samples. Level 1 has two more low than high band samples,
+ * the last one extrapolates the final sample of the line.
+ */
+static INLINE void progressive_rfx_dwt(const INT16* pSrc, size_t nSrcStep, INT16* pLowBand,
+                                       size_t nLowStep, INT16* pHighBand, size_t nHighStep,
+                                       size_t nLowCount, size_t nHighCount)
 {
-	PROGRESSIVE_CONTEXT* progressive = (PROGRESSIVE_CONTEXT*)calloc(1, sizeof(PROGRESSIVE_CONTEXT));
+	size_t i;
+	INT32 X0, X1, X2;
+	INT32 H0, H1;
 
-	if (!progressive)
-		return NULL;
+	for (i = 0; i < nHighCount; i++)
+	{
+		X0 = pSrc[(2 * i) * nSrcStep];
+		X1 = pSrc[(2 * i + 1) * nSrcStep];
+		X2 = pSrc[(2 * i + 2) * nSrcStep];
+		pHighBand[i * nHighStep] = progressive_rfx_clamp16((X1 - ((X0 + X2) / 2)) / 2);
+	}
 
-	progressive->Compressor = Compressor;
-	progressive->quantProgValFull.quality = 100;
-	progressive->log = WLog_Get(TAG);
-	if (!progressive->log)
-		goto fail;
-	progressive->rfx_context = rfx_context_new(Compressor);
-	if (!progressive->rfx_context)
-		goto fail;
-	progressive->buffer = Stream_New(NULL, 1024);
-	if (!progressive->buffer)
-		goto fail;
-	progressive->rects = Stream_New(NULL, 1024);
-	if (!progressive->rects)
-		goto fail;
-	progressive->bufferPool = BufferPool_New(TRUE, (8192 + 32) * 3, 16);
-	if (!progressive->bufferPool)
-		goto fail;
-	progressive->SurfaceContexts = HashTable_New(TRUE);
-	if (!progressive->SurfaceContexts)
+	H0 = pHighBand[0];
+	pLowBand[0] = progressive_rfx_clamp16(pSrc[0] + H0);
+
+	for (i = 1; i < nHighCount; i++)
+	{
+		H1 = pHighBand[i * nHighStep];
+		X0 = pSrc[(2 * i) * nSrcStep];
+		pLowBand[i * nLowStep] = progressive_rfx_clamp16(X0 + ((H0 + H1) / 2));
+		H0 = H1;
+	}
+
+	X0 = pSrc[(2 * nHighCount) * nSrcStep];
+
+	if (nLowCount > (nHighCount + 1))
+	{
+		X1 = pSrc[(2 * nHighCount + 1) * nSrcStep];
+		pLowBand[nHighCount * nLowStep] = progressive_rfx_clamp16(X0 + (H0 / 2));
+		pLowBand[(nHighCount + 1) * nLowStep] = progressive_rfx_clamp16((2 * X1) - X0);
+	}
+	else
+		pLowBand[nHighCount * nLowStep] = progressive_rfx_clamp16(X0 + H0);
+}
+
+static INLINE void progressive_rfx_dwt_2d_encode_block(INT16* buffer, INT16* temp, size_t level)
+{
+	size_t i;
+	size_t nStep;
+	INT16 *HL, *LH;
+	INT16 *HH, *LL;
+	INT16 *L, *H;
+
+	const size_t nBandL = progressive_rfx_get_band_l_count(level);
+	const size_t nBandH = progressive_rfx_get_band_h_count(level);
+	size_t offset = 0;
+
+	HL = &buffer[offset];
+	offset += (nBandH * nBandL);
+	LH = &buffer[offset];
+	offset += (nBandL * nBandH);
+	HH = &buffer[offset];
+	offset += (nBandH * nBandH);
+	LL = &buffer[offset];
+	nStep = (nBandL + nBandH);
+	L = &temp[0];
+	H = &temp[nBandL * nStep];
+
+	/* vertical (LLx -> L + H) */
+	for (i = 0; i < nStep; i++)
+		progressive_rfx_dwt(&buffer[i], nStep, &L[i], nStep, &H[i], nStep, nBandL, nBandH);
+
+	/* horizontal (L -> LL + HL) */
+	for (i = 0; i < nBandL; i++)
+		progressive_rfx_dwt(&L[i * nStep], 1, &LL[i * nBandL], 1, &HL[i * nBandH], 1, nBandL,
+		                    nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (i = 0; i < nBandH; i++)
+		progressive_rfx_dwt(&H[i * nStep], 1, &LH[i * nBandL], 1, &HH[i * nBandH], 1, nBandL,
+		                    nBandH);
+}
+
+static INLINE int progressive_rfx_dwt_2d_encode(PROGRESSIVE_CONTEXT* progressive, INT16* buffer)
+{
+	INT16* temp;
+
+	temp = (INT16*)rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_DWT);
+	if (!temp)
+		return -2;
+
+	progressive_rfx_dwt_2d_encode_block(&buffer[0], temp, 1);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3007], temp, 2);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3807], temp, 3);
+	return 1;
+}
+
+/**
+ * Stores the coefficients rounded to the final quantization in current and the first
+ * pass values in sign. Bands other than LL3 are truncated as sign and magnitude so that
+ * upgrade passes only add magnitude bits, LL3 is refined with unsigned raw bits.
+ */
+static INLINE void progressive_rfx_encode_block(const INT16* buffer, INT16* current, INT16* sign,
+                                                UINT32 length, UINT32 quant, UINT32 shift,
+                                                BOOL nonLL)
+{
+	UINT32 index;
+	const INT32 half = 1 << (quant - 2);
+
+	for (index = 0; index < length; index++)
+	{
+		const INT32 value = buffer[index];
+
+		if (nonLL)
+		{
+			const INT32 mag = MIN(((value < 0) ? -value : value) + half, INT16_MAX);
+			current[index] = (INT16)((value < 0) ? -mag : mag);
+			sign[index] = (INT16)((value < 0) ? -(mag >> shift) : (mag >> shift));
+		}
+		else
+		{
+			current[index] = progressive_rfx_clamp16(value + half);
+			sign[index] = (INT16)(current[index] >> shift);
+		}
+	}
+}
+
+static INLINE int progressive_rfx_encode_component(PROGRESSIVE_CONTEXT* progressive,
+                                                   const RFX_COMPONENT_CODEC_QUANT* quant,
+                                                   const RFX_COMPONENT_CODEC_QUANT* shift,
+                                                   INT16* buffer, INT16* current, INT16* sign,
+                                                   BYTE* pDstData, UINT32 DstSize)
+{
+	int rc;
+	UINT32 length = 4096;
+
+	rc = progressive_rfx_dwt_2d_encode(progressive, buffer);
+	if (rc < 0)
+		return rc;
+
+	progressive_rfx_encode_block(&buffer[0], &current[0], &sign[0], 1023, quant->HL1,
+	                             shift->HL1, TRUE); /* HL1 */
+	progressive_rfx_encode_block(&buffer[1023], &current[1023], &sign[1023], 1023, quant->LH1,
+	                             shift->LH1, TRUE); /* LH1 */
+	progressive_rfx_encode_block(&buffer[2046], &current[2046], &sign[2046], 961, quant->HH1,
+	                             shift->HH1, TRUE); /* HH1 */
+	progressive_rfx_encode_block(&buffer[3007], &current[3007], &sign[3007], 272, quant->HL2,
+	                             shift->HL2, TRUE); /* HL2 */
+	progressive_rfx_encode_block(&buffer[3279], &current[3279], &sign[3279], 272, quant->LH2,
+	                             shift->LH2, TRUE); /* LH2 */
+	progressive_rfx_encode_block(&buffer[3551], &current[3551], &sign[3551], 256, quant->HH2,
+	                             shift->HH2, TRUE); /* HH2 */
+	progressive_rfx_encode_block(&buffer[3807], &current[3807], &sign[3807], 72, quant->HL3,
+	                             shift->HL3, TRUE); /* HL3 */
+	progressive_rfx_encode_block(&buffer[3879], &current[3879], &sign[3879], 72, quant->LH3,
+	                             shift->LH3, TRUE); /* LH3 */
+	progressive_rfx_encode_block(&buffer[3951], &current[3951], &sign[3951], 64, quant->HH3,
+	                             shift->HH3, TRUE); /* HH3 */
+	progressive_rfx_encode_block(&buffer[4015], &current[4015], &sign[4015], 81, quant->LL3,
+	                             shift->LL3, FALSE); /* LL3 */
+
+	CopyMemory(buffer, sign, 4096 * 2);
+	rfx_differential_encode(&buffer[4015], 81); /* LL3 */
+
+	/**
+	 * rfx_rlgr_encode terminates a trailing run of zeros with a value of one. Append a
+	 * sentinel instead, the decoder stops after 4096 coefficients and drops it.
+	 */
+	if (buffer[4095] == 0)
+		buffer[length++] = 1;
+
+	return progressive->rfx_context->rlgr_encode(RLGR1, buffer, length, pDstData, DstSize);
+}
+
+static INLINE void
+progressive_component_codec_quant_write(wStream* s, const RFX_COMPONENT_CODEC_QUANT* quantVal)
+{
+	Stream_Write_UINT8(s, quantVal->LL3 | (quantVal->HL3 << 4)); /* LL3 (4-bit), HL3 (4-bit) */
+	Stream_Write_UINT8(s, quantVal->LH3 | (quantVal->HH3 << 4)); /* LH3 (4-bit), HH3 (4-bit) */
+	Stream_Write_UINT8(s, quantVal->HL2 | (quantVal->LH2 << 4)); /* HL2 (4-bit), LH2 (4-bit) */
+	Stream_Write_UINT8(s, quantVal->HH2 | (quantVal->HL1 << 4)); /* HH2 (4-bit), HL1 (4-bit) */
+	Stream_Write_UINT8(s, quantVal->LH1 | (quantVal->HH1 << 4)); /* LH1 (4-bit), HH1 (4-bit) */
+}
+
+static INLINE const RFX_PROGRESSIVE_CODEC_QUANT*
+progressive_encode_get_quant_prog(PROGRESSIVE_CONTEXT* progressive, BYTE quality)
+{
+	if (quality == 0xFF)
+		return &progressive->quantProgValFull;
+
+	WINPR_ASSERT(quality < ARRAYSIZE(progressive_encode_quant_prog));
+	return &progressive_encode_quant_prog[quality];
+}
+
+static BOOL progressive_encode_tile_first(PROGRESSIVE_CONTEXT* progressive,
+                                          RFX_PROGRESSIVE_TILE* tile, const RFX_TILE* source,
+                                          wStream* s)
+{
+	int rc;
+	size_t i;
+	size_t start, end;
+	BYTE* pBuffer;
+	INT16* pSign[3];
+	INT16* pSrcDst[3];
+	INT16* pCurrent[3];
+	UINT16 len[3] = { 0 };
+	RFX_COMPONENT_CODEC_QUANT shift = { 0 };
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg;
+	BOOL res = FALSE;
+
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(source);
+
+	quantProg = progressive_encode_get_quant_prog(progressive, 0);
+	tile->blockType = PROGRESSIVE_WBT_TILE_FIRST;
+	tile->quantIdxY = 0;
+	tile->quantIdxCb = 0;
+	tile->quantIdxCr = 0;
+	tile->flags = 0;
+	tile->quality = 0;
+	tile->yQuant = progressive_encode_quant;
+	tile->cbQuant = progressive_encode_quant;
+	tile->crQuant = progressive_encode_quant;
+	tile->yProgQuant = quantProg->yQuantValues;
+	tile->cbProgQuant = quantProg->cbQuantValues;
+	tile->crProgQuant = quantProg->crQuantValues;
+	progressive_rfx_quant_add(&tile->yQuant, &tile->yProgQuant, &tile->yBitPos);
+	progressive_rfx_quant_add(&tile->cbQuant, &tile->cbProgQuant, &tile->cbBitPos);
+	progressive_rfx_quant_add(&tile->crQuant, &tile->crProgQuant, &tile->crBitPos);
+
+	pBuffer = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_TILE);
+	if (!pBuffer)
+		return FALSE;
+
+	for (i = 0; i < 3; i++)
+	{
+		pSign[i] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * i) + 16]));
+		pCurrent[i] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * i) + 16]));
+		pSrcDst[i] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * i) + 16]));
+	}
+
+	rfx_encode_ycbcr(progressive->rfx_context, source, pSrcDst);
+
+	start = Stream_GetPosition(s);
+	if (!Stream_EnsureRemainingCapacity(s, 23))
 		goto fail;
+	Stream_Seek(s, 23);
 
-	return progressive;
+	for (i = 0; i < 3; i++)
+	{
+		const RFX_COMPONENT_CODEC_QUANT* bitPos = (i == 0)   ? &tile->yBitPos
+		                                          : (i == 1) ? &tile->cbBitPos
+		                                                     : &tile->crBitPos;
+		size_t capacity;
+
+		shift = *bitPos;
+		progressive_rfx_quant_lsub(&shift, 1); /* -6 + 5 = -1 */
+
+		if (!Stream_EnsureRemainingCapacity(s, 16384))
+			goto fail;
+
+		capacity = Stream_GetRemainingCapacity(s);
+		rc = progressive_rfx_encode_component(progressive, &progressive_encode_quant, &shift,
+		                                      pSrcDst[i], pCurrent[i], pSign[i],
+		                                      Stream_Pointer(s), (UINT32)capacity);
+		if ((rc <= 0) || ((size_t)rc >= capacity) || (rc > UINT16_MAX))
+		{
+			WLog_Print(progressive->log, WLOG_ERROR, "failed to encode tile component %" PRIuz,
+			           i);
+			goto fail;
+		}
+
+		len[i] = (UINT16)rc;
+		Stream_Seek(s, len[i]);
+	}
+
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - start));      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, tile->quantIdxY);             /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, tile->quantIdxCb);            /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, tile->quantIdxCr);            /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                 /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                 /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, tile->flags);                 /* flags (1 byte) */
+	Stream_Write_UINT8(s, tile->quality);               /* quality (1 byte) */
+	Stream_Write_UINT16(s, len[0]);                     /* yLen (2 bytes) */
+	Stream_Write_UINT16(s, len[1]);                     /* cbLen (2 bytes) */
+	Stream_Write_UINT16(s, len[2]);                     /* crLen (2 bytes) */
+	Stream_Write_UINT16(s, 0);                          /* tailLen (2 bytes) */
+	Stream_SetPosition(s, end);
+
+	tile->blockLen = (UINT32)(end - start);
+	tile->pass = 1;
+	res = TRUE;
 fail:
-	progressive_context_free(progressive);
-	return NULL;
+	return res;
 }
 
-void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
+/* Inverse of progressive_rfx_srl_read, value is coded with numBits > 0 */
+static INLINE void progressive_rfx_srl_write(RFX_PROGRESSIVE_UPGRADE_STATE* state, INT16 value,
+                                             UINT32 numBits)
 {
-	int count;
-	int index;
-	ULONG_PTR* pKeys = NULL;
-	PROGRESSIVE_SURFACE_CONTEXT* surface;
+	UINT32 k;
+	UINT32 mag;
+	UINT32 max;
+	wBitStream* bs = state->srl;
 
-	if (!progressive)
+	if (value == 0)
+	{
+		state->nz++;
 		return;
+	}
 
-	Stream_Free(progressive->buffer, TRUE);
-	Stream_Free(progressive->rects, TRUE);
-	rfx_context_free(progressive->rfx_context);
+	k = state->kp / 8;
 
-	BufferPool_Free(progressive->bufferPool);
+	/* '0' bit, nz >= (1 << k) */
+	while (state->nz >= (1 << k))
+	{
+		BitStream_Write_Bits(bs, 0, 1);
+		state->nz -= (1 << k);
+		state->kp += 4;
 
-	if (progressive->SurfaceContexts)
+		if (state->kp > 80)
+			state->kp = 80;
+
+		k = state->kp / 8;
+	}
+
+	/* '1' bit, nz < (1 << k) in the next k bits */
+	BitStream_Write_Bits(bs, 1, 1);
+
+	if (k)
+		BitStream_Write_Bits(bs, (UINT32)state->nz, k);
+
+	state->nz = 0;
+
+	/* sign bit */
+	BitStream_Write_Bits(bs, (value < 0) ? 1 : 0, 1);
+
+	if (state->kp < 6)
+		state->kp = 0;
+	else
+		state->kp -= 6;
+
+	if (numBits == 1)
+		return;
+
+	/* unary encoding, the largest magnitude has no terminating bit */
+	mag = (value < 0) ? -value : value;
+	max = (1 << numBits) - 1;
+
+	if (mag < max)
+		BitStream_Write_Bits(bs, 1, mag);
+	else
+		BitStream_Write_Bits(bs, 0, max - 1);
+}
+
+static INLINE void progressive_rfx_srl_write_end(RFX_PROGRESSIVE_UPGRADE_STATE* state)
+{
+	/* every '0' bit covers up to (1 << k) trailing zeros */
+	while (state->nz > 0)
 	{
-		count = HashTable_GetKeys(progressive->SurfaceContexts, &pKeys);
+		const int run = (1 << (state->kp / 8));
 
-		for (index = 0; index < count; index++)
-		{
-			surface = (PROGRESSIVE_SURFACE_CONTEXT*)HashTable_GetItemValue(
-			    progressive->SurfaceContexts, (void*)pKeys[index]);
-			progressive_surface_context_free(surface);
-		}
+		BitStream_Write_Bits(state->srl, 0, 1);
+		state->nz = (state->nz > run) ? (state->nz - run) : 0;
+		state->kp += 4;
 
-		free(pKeys);
-		HashTable_Free(progressive->SurfaceContexts);
+		if (state->kp > 80)
+			state->kp = 80;
 	}
+}
+
+/* Inverse of progressive_rfx_upgrade_block, sign is updated the same way */
+static INLINE void progressive_rfx_encode_upgrade_block(RFX_PROGRESSIVE_UPGRADE_STATE* state,
+                                                        const INT16* current, INT16* sign,
+                                                        UINT32 length, UINT32 shift,
+                                                        UINT32 numBits)
+{
+	UINT32 index;
+	const UINT32 mask = (1 << numBits) - 1;
+
+	if (!numBits)
+		return;
+
+	if (!state->nonLL)
+	{
+		for (index = 0; index < length; index++)
+			BitStream_Write_Bits(state->raw, (UINT32)(current[index] >> shift) & mask, numBits);
+
+		return;
+	}
+
+	for (index = 0; index < length; index++)
+	{
+		const INT32 value = current[index];
+		const UINT32 mag = (UINT32)((value < 0) ? -value : value) >> shift;
+
+		if (sign[index] != 0)
+		{
+			/* sign != 0, magnitude bits to raw */
+			BitStream_Write_Bits(state->raw, mag & mask, numBits);
+		}
+		else
+		{
+			/* sign == 0, coefficient to srl */
+			sign[index] = (INT16)((value < 0) ? -(INT32)mag : (INT32)mag);
+			progressive_rfx_srl_write(state, sign[index], numBits);
+		}
+	}
+}
+
+static INLINE int progressive_rfx_encode_upgrade_component(
+    const RFX_COMPONENT_CODEC_QUANT* shift, const RFX_COMPONENT_CODEC_QUANT* numBits,
+    const INT16* current, INT16* sign, BYTE* srlData, UINT32 srlSize, BYTE* rawData,
+    UINT32 rawSize, UINT32* srlLen, UINT32* rawLen)
+{
+	wBitStream s_srl = { 0 };
+	wBitStream s_raw = { 0 };
+	RFX_PROGRESSIVE_UPGRADE_STATE state = { 0 };
+
+	state.kp = 8;
+	state.mode = 0;
+	state.srl = &s_srl;
+	state.raw = &s_raw;
+	BitStream_Attach(state.srl, srlData, srlSize);
+	BitStream_Attach(state.raw, rawData, rawSize);
+
+	state.nonLL = TRUE;
+	progressive_rfx_encode_upgrade_block(&state, &current[0], &sign[0], 1023, shift->HL1,
+	                                     numBits->HL1); /* HL1 */
+	progressive_rfx_encode_upgrade_block(&state, &current[1023], &sign[1023], 1023, shift->LH1,
+	                                     numBits->LH1); /* LH1 */
+	progressive_rfx_encode_upgrade_block(&state, &current[2046], &sign[2046], 961, shift->HH1,
+	                                     numBits->HH1); /* HH1 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3007], &sign[3007], 272, shift->HL2,
+	                                     numBits->HL2); /* HL2 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3279], &sign[3279], 272, shift->LH2,
+	                                     numBits->LH2); /* LH2 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3551], &sign[3551], 256, shift->HH2,
+	                                     numBits->HH2); /* HH2 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3807], &sign[3807], 72, shift->HL3,
+	                                     numBits->HL3); /* HL3 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3879], &sign[3879], 72, shift->LH3,
+	                                     numBits->LH3); /* LH3 */
+	progressive_rfx_encode_upgrade_block(&state, &current[3951], &sign[3951], 64, shift->HH3,
+	                                     numBits->HH3); /* HH3 */
+	progressive_rfx_srl_write_end(&state);
+
+	state.nonLL = FALSE;
+	progressive_rfx_encode_upgrade_block(&state, &current[4015], &sign[4015], 81, shift->LL3,
+	                                     numBits->LL3); /* LL3 */
+
+	BitStream_Flush(state.srl);
+	BitStream_Flush(state.raw);
+	*srlLen = (state.srl->position + 7) / 8;
+	*rawLen = (state.raw->position + 7) / 8;
+
+	if ((*srlLen >= srlSize) || (*rawLen >= rawSize))
+		return -1;
+
+	return 1;
+}
+
+/**
+ * Writes the next upgrade pass of a tile if the block fits into budget bytes.
+ * Returns 1 if the block was written, 0 if it did not fit and < 0 on error.
+ */
+static int progressive_encode_tile_upgrade(PROGRESSIVE_CONTEXT* progressive,
+                                           RFX_PROGRESSIVE_TILE* tile, wStream* s,
+                                           size_t budget)
+{
+	int rc = -1;
+	size_t i;
+	size_t start, end;
+	BYTE quality;
+	BYTE* pSign = NULL;
+	BYTE* pSrl = NULL;
+	BYTE* pRaw = NULL;
+	UINT32 srlLen[3] = { 0 };
+	UINT32 rawLen[3] = { 0 };
+	RFX_COMPONENT_CODEC_QUANT bitPos[3] = { 0 };
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg;
+
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(tile->quality != 0xFF);
+
+	quality = tile->quality + 1;
+	if (quality >= ARRAYSIZE(progressive_encode_quant_prog))
+		quality = 0xFF;
+
+	quantProg = progressive_encode_get_quant_prog(progressive, quality);
+	progressive_rfx_quant_add(&tile->yQuant, &quantProg->yQuantValues, &bitPos[0]);
+	progressive_rfx_quant_add(&tile->cbQuant, &quantProg->cbQuantValues, &bitPos[1]);
+	progressive_rfx_quant_add(&tile->crQuant, &quantProg->crQuantValues, &bitPos[2]);
+
+	pSign = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_TILE);
+	pSrl = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_DWT);
+	pRaw = rfx_scratch_get(progressive->scratchPool, PROGRESSIVE_SCRATCH_RAW);
+	if (!pSign || !pSrl || !pRaw)
+		goto fail;
+
+	/* work on a copy of the sign state, it is only kept if the block is sent */
+	CopyMemory(pSign, tile->sign, (8192 + 32) * 3);
+
+	start = Stream_GetPosition(s);
+	if (!Stream_EnsureRemainingCapacity(s, 26))
+		goto fail;
+	Stream_Seek(s, 26);
+
+	for (i = 0; i < 3; i++)
+	{
+		const RFX_COMPONENT_CODEC_QUANT* oldBitPos = (i == 0)   ? &tile->yBitPos
+		                                             : (i == 1) ? &tile->cbBitPos
+		                                                        : &tile->crBitPos;
+		const INT16* current = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * i) + 16]));
+		INT16* sign = (INT16*)((BYTE*)(&pSign[((8192 + 32) * i) + 16]));
+		RFX_COMPONENT_CODEC_QUANT shift = bitPos[i];
+		RFX_COMPONENT_CODEC_QUANT numBits = { 0 };
+
+		progressive_rfx_quant_lsub(&shift, 1); /* -6 + 5 = -1 */
+		progressive_rfx_quant_sub(oldBitPos, &bitPos[i], &numBits);
+
+		if (progressive_rfx_encode_upgrade_component(&shift, &numBits, current, sign, pSrl,
+		                                             (8192 + 32) * 3, pRaw, (8192 + 32) * 3,
+		                                             &srlLen[i], &rawLen[i]) < 0)
+			goto fail;
+
+		if (!Stream_EnsureRemainingCapacity(s, srlLen[i] + rawLen[i]))
+			goto fail;
+
+		Stream_Write(s, pSrl, srlLen[i]);
+		Stream_Write(s, pRaw, rawLen[i]);
+	}
+
+	end = Stream_GetPosition(s);
+	if ((end - start) > budget)
+	{
+		Stream_SetPosition(s, start);
+		rc = 0;
+		goto fail;
+	}
+
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - start));        /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, tile->quantIdxY);               /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, tile->quantIdxCb);              /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, tile->quantIdxCr);              /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                   /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                   /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, quality);                       /* quality (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)srlLen[0]);            /* ySrlLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)rawLen[0]);            /* yRawLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)srlLen[1]);            /* cbSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)rawLen[1]);            /* cbRawLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)srlLen[2]);            /* crSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, (UINT16)rawLen[2]);            /* crRawLen (2 bytes) */
+	Stream_SetPosition(s, end);
+
+	CopyMemory(tile->sign, pSign, (8192 + 32) * 3);
+	tile->blockType = PROGRESSIVE_WBT_TILE_UPGRADE;
+	tile->blockLen = (UINT32)(end - start);
+	tile->quality = quality;
+	tile->yProgQuant = quantProg->yQuantValues;
+	tile->cbProgQuant = quantProg->cbQuantValues;
+	tile->crProgQuant = quantProg->crQuantValues;
+	tile->yBitPos = bitPos[0];
+	tile->cbBitPos = bitPos[1];
+	tile->crBitPos = bitPos[2];
+	tile->pass++;
+	rc = 1;
+fail:
+	return rc;
+}
+
+static INLINE BOOL progressive_write_region_progressive(PROGRESSIVE_CONTEXT* progressive,
+                                                        wStream* s, const RFX_RECT* rects,
+                                                        UINT16 numRects, UINT16 numTiles,
+                                                        wStream* tiles)
+{
+	/* RFX_PROGRESSIVE_REGION */
+	UINT16 i;
+	UINT32 blockLen = 18;
+	const UINT32 tilesDataSize = (UINT32)Stream_GetPosition(tiles);
+	const BYTE numProgQuant = ARRAYSIZE(progressive_encode_quant_prog);
+
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(rects);
+
+	blockLen += numRects * 8;
+	blockLen += 5;
+	blockLen += numProgQuant * 16;
+	blockLen += tilesDataSize;
+
+	if (!Stream_EnsureRemainingCapacity(s, blockLen))
+		return FALSE;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);    /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, blockLen);                  /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64);                         /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, numRects);                  /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, 1);                          /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, numProgQuant);               /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE); /* flags (1 byte) */
+	Stream_Write_UINT16(s, numTiles);                  /* numTiles (2 bytes) */
+	Stream_Write_UINT32(s, tilesDataSize);             /* tilesDataSize (4 bytes) */
+
+	for (i = 0; i < numRects; i++)
+	{
+		/* TS_RFX_RECT */
+		Stream_Write_UINT16(s, rects[i].x);      /* x (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].y);      /* y (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].width);  /* width (2 bytes) */
+		Stream_Write_UINT16(s, rects[i].height); /* height (2 bytes) */
+	}
+
+	progressive_component_codec_quant_write(s, &progressive_encode_quant);
+
+	for (i = 0; i < numProgQuant; i++)
+	{
+		/* RFX_PROGRESSIVE_CODEC_QUANT */
+		const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = &progressive_encode_quant_prog[i];
+		Stream_Write_UINT8(s, quantProg->quality); /* quality (1 byte) */
+		progressive_component_codec_quant_write(s, &quantProg->yQuantValues);
+		progressive_component_codec_quant_write(s, &quantProg->cbQuantValues);
+		progressive_component_codec_quant_write(s, &quantProg->crQuantValues);
+	}
+
+	Stream_Write(s, Stream_Buffer(tiles), tilesDataSize);
+	return TRUE;
+}
+
+static BOOL progressive_encode_add_rect(PROGRESSIVE_CONTEXT* progressive,
+                                        const PROGRESSIVE_SURFACE_CONTEXT* surface,
+                                        const RFX_PROGRESSIVE_TILE* tile, UINT32 Width,
+                                        UINT32 Height)
+{
+	RFX_RECT* rect;
+	wStream* s = progressive->rects;
+
+	if (!Stream_EnsureRemainingCapacity(s, sizeof(RFX_RECT)))
+		return FALSE;
+
+	rect = (RFX_RECT*)Stream_Pointer(s);
+	rect->x = (UINT16)tile->x;
+	rect->y = (UINT16)tile->y;
+	rect->width = (UINT16)MIN(64, MIN(surface->width, Width) - tile->x);
+	rect->height = (UINT16)MIN(64, MIN(surface->height, Height) - tile->y);
+	Stream_Seek(s, sizeof(RFX_RECT));
+	return TRUE;
+}
+
+struct S_PROGRESSIVE_TILE_ENCODE_WORK_PARAM
+{
+	PROGRESSIVE_CONTEXT* progressive;
+	RFX_PROGRESSIVE_TILE* tile;
+	RFX_TILE source;
+	wStream* s;
+	BOOL success;
+};
+
+static void CALLBACK progressive_encode_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                           void* context, PTP_WORK work)
+{
+	PROGRESSIVE_TILE_ENCODE_WORK_PARAM* param = (PROGRESSIVE_TILE_ENCODE_WORK_PARAM*)context;
+
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	Stream_SetPosition(param->s, 0);
+	param->success =
+	    progressive_encode_tile_first(param->progressive, param->tile, &param->source, param->s);
+}
+
+static BOOL progressive_encode_setup_workers(PROGRESSIVE_CONTEXT* progressive, UINT32 nbTiles)
+{
+	UINT32 i;
+	void* pmem;
+
+	if (!progressive->rfx_context->priv->UseThreads)
+		return TRUE;
+
+	if (nbTiles <= progressive->numTileWorkParams)
+		return TRUE;
+
+	if (!(pmem = realloc((void*)progressive->workObjects, sizeof(PTP_WORK) * nbTiles)))
+		return FALSE;
+
+	progressive->workObjects = (PTP_WORK*)pmem;
+
+	if (!(pmem = realloc((void*)progressive->tileWorkParams,
+	                     sizeof(PROGRESSIVE_TILE_ENCODE_WORK_PARAM) * nbTiles)))
+		return FALSE;
+
+	progressive->tileWorkParams = (PROGRESSIVE_TILE_ENCODE_WORK_PARAM*)pmem;
+
+	/* the per tile streams are kept to avoid reallocating them on every frame */
+	for (i = progressive->numTileWorkParams; i < nbTiles; i++)
+	{
+		PROGRESSIVE_TILE_ENCODE_WORK_PARAM* param = &progressive->tileWorkParams[i];
+
+		ZeroMemory(param, sizeof(PROGRESSIVE_TILE_ENCODE_WORK_PARAM));
+		param->s = Stream_New(NULL, 1024);
+		if (!param->s)
+			return FALSE;
+
+		progressive->numTileWorkParams = i + 1;
+	}
+
+	return TRUE;
+}
+
+static void progressive_encode_tile_source(RFX_PROGRESSIVE_TILE* tile, RFX_TILE* source,
+                                           const PROGRESSIVE_SURFACE_CONTEXT* surface,
+                                           UINT32 index, const BYTE* pSrcData, UINT32 bpp,
+                                           UINT32 Width, UINT32 Height, UINT32 ScanLine)
+{
+	tile->xIdx = (UINT16)(index % surface->gridWidth);
+	tile->yIdx = (UINT16)(index / surface->gridWidth);
+	tile->x = tile->xIdx * 64;
+	tile->y = tile->yIdx * 64;
+
+	ZeroMemory(source, sizeof(RFX_TILE));
+	source->x = (UINT16)tile->x;
+	source->y = (UINT16)tile->y;
+	source->width = (UINT16)MIN(64, Width - tile->x);
+	source->height = (UINT16)MIN(64, Height - tile->y);
+	source->scanline = ScanLine;
+	source->data = (BYTE*)&pSrcData[(tile->y * ScanLine) + (tile->x * bpp)];
+}
+
+int progressive_compress_surface(PROGRESSIVE_CONTEXT* progressive, UINT16 surfaceId,
+                                 const BYTE* pSrcData, UINT32 SrcSize, UINT32 SrcFormat,
+                                 UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                                 const REGION16* invalidRegion, UINT32 upgradeBudget,
+                                 BYTE** ppDstData, UINT32* pDstSize)
+{
+	int res = -1;
+	size_t budget = upgradeBudget;
+	UINT32 i, numRects;
+	UINT32 index;
+	UINT32 numTiles = 0;
+	UINT32 numUpdated = 0;
+	UINT32 numWorkObjects = 0;
+	BYTE quality;
+	BYTE* updated = NULL;
+	BOOL useThreads;
+	wStream* s;
+	const RECTANGLE_16* region_rects = NULL;
+	PROGRESSIVE_SURFACE_CONTEXT* surface;
+	const UINT32 bpp = GetBytesPerPixel(SrcFormat);
+
+	if (!progressive || !ppDstData || !pDstSize)
+		return -1;
+
+	surface = progressive_get_surface_data(progressive, surfaceId);
+	if (!surface)
+	{
+		WLog_Print(progressive->log, WLOG_ERROR, "surface %" PRIu16 " does not exist",
+		           surfaceId);
+		return -1;
+	}
+
+	if ((Width > surface->width) || (Height > surface->height))
+		return -3;
+
+	if (!invalidRegion)
+		numRects = 1;
+	else
+		numRects = region16_n_rects(invalidRegion);
+
+	if (numRects > 0)
+	{
+		if (!pSrcData || (bpp == 0))
+			return -2;
+
+		if (ScanLine == 0)
+			ScanLine = Width * bpp;
+
+		if (SrcSize < Height * ScanLine)
+			return -4;
+	}
+
+	updated = (BYTE*)calloc(surface->gridSize, sizeof(BYTE));
+	if (!updated)
+		return -5;
+
+	if (invalidRegion)
+		region_rects = region16_rects(invalidRegion, NULL);
+
+	useThreads = progressive->rfx_context->priv->UseThreads;
+	Stream_SetPosition(progressive->rects, 0);
+	Stream_SetPosition(progressive->tiles, 0);
+	progressive->rfx_context->mode = RLGR1;
+	rfx_context_set_pixel_format(progressive->rfx_context, SrcFormat);
+
+	for (i = 0; i < numRects; i++)
+	{
+		UINT32 xIdx, yIdx;
+		RECTANGLE_16 r = { 0, 0, (UINT16)Width, (UINT16)Height };
+
+		if (invalidRegion)
+		{
+			r = region_rects[i];
+			r.right = MIN(r.right, Width);
+			r.bottom = MIN(r.bottom, Height);
+		}
+
+		for (yIdx = r.top / 64; yIdx * 64 < r.bottom; yIdx++)
+		{
+			for (xIdx = r.left / 64; xIdx * 64 < r.right; xIdx++)
+				updated[yIdx * surface->gridWidth + xIdx] = 1;
+		}
+	}
+
+	for (index = 0; index < surface->gridSize; index++)
+		numUpdated += updated[index];
+
+	if (!progressive_encode_setup_workers(progressive, numUpdated))
+		goto fail;
+
+	/**
+	 * First pass of every tile touched by the invalid region. With threads the tiles
+	 * are encoded into separate streams and appended in grid order afterwards, so the
+	 * output does not depend on the scheduling.
+	 */
+	for (index = 0; index < surface->gridSize; index++)
+	{
+		RFX_PROGRESSIVE_TILE* tile = &surface->tiles[index];
+
+		if (!updated[index])
+			continue;
+
+		if (!progressive_tile_allocate(progressive, surface, tile))
+			goto fail;
+
+		if (useThreads)
+		{
+			PROGRESSIVE_TILE_ENCODE_WORK_PARAM* param = &progressive->tileWorkParams[numTiles];
+			PTP_WORK* workObject = &progressive->workObjects[numTiles];
+
+			param->progressive = progressive;
+			param->tile = tile;
+			param->success = FALSE;
+			progressive_encode_tile_source(tile, &param->source, surface, index, pSrcData, bpp,
+			                               Width, Height, ScanLine);
+
+			if (!(*workObject =
+			          CreateThreadpoolWork(progressive_encode_tile_work_callback, (void*)param,
+			                               &progressive->rfx_context->priv->ThreadPoolEnv)))
+			{
+				WLog_Print(progressive->log, WLOG_ERROR, "CreateThreadpoolWork failed.");
+				break;
+			}
+
+			SubmitThreadpoolWork(*workObject);
+			numWorkObjects++;
+		}
+		else
+		{
+			RFX_TILE source;
+
+			progressive_encode_tile_source(tile, &source, surface, index, pSrcData, bpp, Width,
+			                               Height, ScanLine);
+
+			if (!progressive_encode_tile_first(progressive, tile, &source, progressive->tiles))
+				goto fail;
+
+			if (!progressive_encode_add_rect(progressive, surface, tile, Width, Height))
+				goto fail;
+		}
+
+		numTiles++;
+	}
+
+	if (useThreads)
+	{
+		BOOL success = (numWorkObjects == numUpdated);
+
+		for (i = 0; i < numWorkObjects; i++)
+		{
+			WaitForThreadpoolWorkCallbacks(progressive->workObjects[i], FALSE);
+			CloseThreadpoolWork(progressive->workObjects[i]);
+		}
+
+		for (i = 0; success && (i < numWorkObjects); i++)
+		{
+			const PROGRESSIVE_TILE_ENCODE_WORK_PARAM* param = &progressive->tileWorkParams[i];
+			const size_t length = Stream_GetPosition(param->s);
+
+			if (!param->success)
+				success = FALSE;
+			else if (!Stream_EnsureRemainingCapacity(progressive->tiles, length))
+				success = FALSE;
+			else
+			{
+				Stream_Write(progressive->tiles, Stream_Buffer(param->s), length);
+				success = progressive_encode_add_rect(progressive, surface, param->tile, Width,
+				                                      Height);
+			}
+		}
+
+		if (!success)
+			goto fail;
+	}
+
+	/* spend the budget on upgrades, coarsest tiles first */
+	for (quality = 0; quality < ARRAYSIZE(progressive_encode_quant_prog); quality++)
+	{
+		for (index = 0; index < surface->gridSize; index++)
+		{
+			int rc;
+			size_t start;
+			RFX_PROGRESSIVE_TILE* tile = &surface->tiles[index];
+
+			if (updated[index] || (tile->pass == 0) || (tile->quality != quality))
+				continue;
+
+			if (numTiles >= UINT16_MAX)
+				break;
+
+			start = Stream_GetPosition(progressive->tiles);
+			rc = progressive_encode_tile_upgrade(progressive, tile, progressive->tiles, budget);
+			if (rc < 0)
+				goto fail;
+
+			if (rc == 0)
+				break;
+
+			budget -= Stream_GetPosition(progressive->tiles) - start;
+			updated[index] = 1;
+			progressive_tile_compact(progressive, surface, tile);
+
+			if (!progressive_encode_add_rect(progressive, surface, tile, surface->width,
+			                                 surface->height))
+				goto fail;
+
+			numTiles++;
+		}
+
+		if (index < surface->gridSize)
+			break;
+	}
+
+	*ppDstData = NULL;
+	*pDstSize = 0;
+	res = 0;
+
+	if (numTiles == 0)
+		goto fail;
+
+	s = progressive->buffer;
+	Stream_SetPosition(s, 0);
+
+	res = -6;
+	if (!progressive_write_wb_sync(progressive, s))
+		goto fail;
+
+	if (!progressive_write_wb_context(progressive, s, RFX_SUBBAND_DIFFING))
+		goto fail;
+
+	if (!progressive_write_frame_begin(progressive, s, surface->frameId++))
+		goto fail;
+
+	if (!progressive_write_region_progressive(progressive, s,
+	                                          (const RFX_RECT*)Stream_Buffer(progressive->rects),
+	                                          (UINT16)numTiles, (UINT16)numTiles,
+	                                          progressive->tiles))
+		goto fail;
+
+	if (!progressive_write_frame_end(progressive, s))
+		goto fail;
+
+	*pDstSize = (UINT32)Stream_GetPosition(s);
+	*ppDstData = Stream_Buffer(s);
+	res = 1;
+fail:
+	free(updated);
+	return res;
+}
+
+UINT32 progressive_surface_pending_upgrades(PROGRESSIVE_CONTEXT* progressive, UINT16 surfaceId)
+{
+	UINT32 index;
+	UINT32 pending = 0;
+	const PROGRESSIVE_SURFACE_CONTEXT* surface =
+	    progressive_get_surface_data(progressive, surfaceId);
+
+	if (!surface)
+		return 0;
+
+	for (index = 0; index < surface->gridSize; index++)
+	{
+		const RFX_PROGRESSIVE_TILE* tile = &surface->tiles[index];
+
+		if ((tile->pass > 0) && (tile->quality != 0xFF))
+			pending++;
+	}
+
+	return pending;
+}
+
+BOOL progressive_get_surface_memory(PROGRESSIVE_CONTEXT* progressive, UINT16 surfaceId,
+                                    size_t* pCurrent, size_t* pPeak)
+{
+	const PROGRESSIVE_SURFACE_CONTEXT* surface =
+	    progressive_get_surface_data(progressive, surfaceId);
+
+	if (!surface)
+		return FALSE;
+
+	if (pCurrent)
+		*pCurrent = surface->tileBytes;
+
+	if (pPeak)
+		*pPeak = surface->peakTileBytes;
+
+	return TRUE;
+}
+
+BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* progressive)
+{
+	if (!progressive)
+		return FALSE;
+
+	return TRUE;
+}
+
+PROGRESSIVE_CONTEXT* progressive_context_new(BOOL Compressor)
+{
+	return progressive_context_new_ex(Compressor, 0);
+}
+
+PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 ThreadingFlags)
+{
+	PROGRESSIVE_CONTEXT* progressive = (PROGRESSIVE_CONTEXT*)calloc(1, sizeof(PROGRESSIVE_CONTEXT));
+
+	if (!progressive)
+		return NULL;
+
+	progressive->Compressor = Compressor;
+	progressive->quantProgValFull.quality = 100;
+	progressive->log = WLog_Get(TAG);
+	if (!progressive->log)
+		goto fail;
+	progressive->rfx_context = rfx_context_new_ex(Compressor, ThreadingFlags);
+	if (!progressive->rfx_context)
+		goto fail;
+	progressive->buffer = Stream_New(NULL, 1024);
+	if (!progressive->buffer)
+		goto fail;
+	progressive->rects = Stream_New(NULL, 1024);
+	if (!progressive->rects)
+		goto fail;
+	progressive->tiles = Stream_New(NULL, 1024);
+	if (!progressive->tiles)
+		goto fail;
+	progressive->scratchPool = rfx_scratch_pool_new(PROGRESSIVE_SCRATCH_COUNT);
+	if (!progressive->scratchPool)
+		goto fail;
+	progressive->SurfaceContexts = HashTable_New(TRUE);
+	if (!progressive->SurfaceContexts)
+		goto fail;
+
+	return progressive;
+fail:
+	progressive_context_free(progressive);
+	return NULL;
+}
+
+void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
+{
+	int count;
+	int index;
+	ULONG_PTR* pKeys = NULL;
+	PROGRESSIVE_SURFACE_CONTEXT* surface;
+
+	if (!progressive)
+		return;
+
+	Stream_Free(progressive->buffer, TRUE);
+	Stream_Free(progressive->rects, TRUE);
+	Stream_Free(progressive->tiles, TRUE);
+	rfx_context_free(progressive->rfx_context);
+
+	for (index = 0; index < (int)progressive->numTileWorkParams; index++)
+		Stream_Free(progressive->tileWorkParams[index].s, TRUE);
+
+	free(progressive->tileWorkParams);
+	free(progressive->workObjects);
+
+	rfx_scratch_pool_free(progressive->scratchPool);
+
+	if (progressive->SurfaceContexts)
+	{
+		count = HashTable_GetKeys(progressive->SurfaceContexts, &pKeys);
+
+		for (index = 0; index < count; index++)
+		{
+			surface = (PROGRESSIVE_SURFACE_CONTEXT*)HashTable_GetItemValue(
+			    progressive->SurfaceContexts, (void*)pKeys[index]);
+			progressive_surface_context_free(progressive, surface);
+		}
+
+		free(pKeys);
+		HashTable_Free(progressive->SurfaceContexts);
+	}
+
+	while (progressive->numCoeffPool > 0)
+		_aligned_free(progressive->coeffPool[--progressive->numCoeffPool]);
 
 	free(progressive);
 }
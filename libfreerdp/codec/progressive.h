@@ -22,10 +22,13 @@
 #define INTERNAL_CODEC_PROGRESSIVE_H
 
 #include <winpr/wlog.h>
+#include <winpr/pool.h>
 #include <winpr/collections.h>
 
 #include <freerdp/codec/rfx.h>
 
+#include "rfx_scratch.h"
+
 #define RFX_SUBBAND_DIFFING 0x01
 
 #define RFX_TILE_DIFFERENCE 0x01
@@ -41,6 +44,18 @@
 #define PROGRESSIVE_WBT_TILE_FIRST 0xCCC6
 #define PROGRESSIVE_WBT_TILE_UPGRADE 0xCCC7
 
+/* Scratch buffer indices, the DWT runs nested in the tile decode and encode */
+#define PROGRESSIVE_SCRATCH_TILE 0
+#define PROGRESSIVE_SCRATCH_DWT 1
+#define PROGRESSIVE_SCRATCH_RAW 2
+#define PROGRESSIVE_SCRATCH_COUNT 3
+
+/* Size of the sign and current coefficient buffers of a tile */
+#define PROGRESSIVE_COEFF_BUFFER_SIZE ((8192 + 32) * 3)
+
+/* Coefficient buffers kept for reuse by later tiles and surfaces of a context */
+#define PROGRESSIVE_COEFF_POOL_SIZE 64
+
 typedef struct
 {
 	BYTE LL3;
@@ -194,8 +209,12 @@ typedef struct
 	UINT32 frameId;
 	UINT32 numUpdatedTiles;
 	UINT32* updatedTileIndices;
+	size_t tileBytes;     /* tile buffers currently allocated */
+	size_t peakTileBytes; /* high water mark of tileBytes */
 } PROGRESSIVE_SURFACE_CONTEXT;
 
+typedef struct S_PROGRESSIVE_TILE_ENCODE_WORK_PARAM PROGRESSIVE_TILE_ENCODE_WORK_PARAM;
+
 typedef enum
 {
 	FLAG_WBT_SYNC = 0x01,
@@ -209,7 +228,7 @@ struct S_PROGRESSIVE_CONTEXT
 {
 	BOOL Compressor;
 
-	wBufferPool* bufferPool;
+	RFX_SCRATCH_POOL* scratchPool;
 
 	UINT32 format;
 	UINT32 state;
@@ -222,7 +241,15 @@ struct S_PROGRESSIVE_CONTEXT
 	wLog* log;
 	wStream* buffer;
 	wStream* rects;
+	wStream* tiles;
 	RFX_CONTEXT* rfx_context;
+
+	PTP_WORK* workObjects;
+	PROGRESSIVE_TILE_ENCODE_WORK_PARAM* tileWorkParams;
+	UINT32 numTileWorkParams;
+
+	BYTE* coeffPool[PROGRESSIVE_COEFF_POOL_SIZE];
+	UINT32 numCoeffPool;
 };
 
 #endif /* INTERNAL_CODEC_PROGRESSIVE_H */
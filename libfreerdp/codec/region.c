@@ -75,6 +75,8 @@ struct S_REGION16_DATA
 };
 
 static REGION16_DATA empty_region = { 0, 0 };
+/* a region of a single rectangle stores it in its extents, it needs no allocation */
+static REGION16_DATA single_region = { 0, 1 };
 
 void region16_init(REGION16* region)
 {
@@ -108,6 +110,9 @@ const RECTANGLE_16* region16_rects(const REGION16* region, UINT32* nbRects)
 	if (nbRects)
 		*nbRects = data->nbRects;
 
+	if (data == &single_region)
+		return &region->extents;
+
 	return (RECTANGLE_16*)(data + 1);
 }
 
@@ -119,6 +124,9 @@ static INLINE RECTANGLE_16* region16_rects_noconst(REGION16* region)
 	if (!data)
 		return NULL;
 
+	if (data == &single_region)
+		return &region->extents;
+
 	return (RECTANGLE_16*)(&data[1]);
 }
 
@@ -217,7 +225,7 @@ BOOL region16_copy(REGION16* dst, const REGION16* src)
 		free(dst->data);
 
 	if (src->data->size == 0)
-		dst->data = &empty_region;
+		dst->data = src->data;
 	else
 	{
 		dst->data = allocateRegion(src->data->nbRects);
@@ -376,6 +384,45 @@ static BOOL band_match(const RECTANGLE_16* band1, const RECTANGLE_16* band2, REC
 	return (band2 == endPtr) || (band2->top != refBand2);
 }
 
+/** finds the first band that ends below top
+ * @param rects the rectangles of the region
+ * @param endPtr end of the region
+ * @param top the coordinate to look for
+ * @return the first item of that band, endPtr if there is none
+ */
+static const RECTANGLE_16* band_below(const RECTANGLE_16* rects, const RECTANGLE_16* endPtr,
+                                      UINT16 top)
+{
+	/* the bottoms of the bands increase, the items of a band share theirs */
+	size_t count = (size_t)(endPtr - rects);
+
+	while (count > 0)
+	{
+		const size_t half = count / 2;
+
+		if (rects[half].bottom <= top)
+		{
+			rects += half + 1;
+			count -= half + 1;
+		}
+		else
+			count = half;
+	}
+
+	return rects;
+}
+
+/** @return the item after the band of item */
+static const RECTANGLE_16* band_end(const RECTANGLE_16* item, const RECTANGLE_16* endPtr)
+{
+	const UINT16 refY = item->top;
+
+	while ((item < endPtr) && (item->top == refY))
+		item++;
+
+	return item;
+}
+
 /** compute if the rectangle is fully included in the band
  * @param band a pointer on the beginning of the band
  * @param endPtr end of the region
@@ -404,6 +451,17 @@ static BOOL rectangle_contained_in_band(const RECTANGLE_16* band, const RECTANGL
 	return FALSE;
 }
 
+/* drops the allocation of a region that is down to a single rectangle */
+static void region16_pack(REGION16* region)
+{
+	if ((region->data->nbRects != 1) || (region->data->size == 0))
+		return;
+
+	region->extents = *region16_rects_noconst(region);
+	free(region->data);
+	region->data = &single_region;
+}
+
 static BOOL region16_simplify_bands(REGION16* region)
 {
 	/** Simplify consecutive bands that touch and have the same items
@@ -423,7 +481,10 @@ static BOOL region16_simplify_bands(REGION16* region)
 	finalNbRects = nbRects = region16_n_rects(region);
 
 	if (nbRects < 2)
+	{
+		region16_pack(region);
 		return TRUE;
+	}
 
 	band1 = region16_rects_noconst(region);
 	endPtr = band1 + nbRects;
@@ -482,6 +543,7 @@ static BOOL region16_simplify_bands(REGION16* region)
 		region->data->size = allocSize;
 	}
 
+	region16_pack(region);
 	return TRUE;
 }
 
@@ -504,17 +566,11 @@ BOOL region16_union_rect(REGION16* dst, const REGION16* src, const RECTANGLE_16*
 	if (!region16_n_rects(src))
 	{
 		/* source is empty, so the union is rect */
-		dst->extents = *rect;
-		dst->data = allocateRegion(1);
+		const RECTANGLE_16 single = *rect;
 
-		if (!dst->data)
-			return FALSE;
-
-		dstRect = region16_rects_noconst(dst);
-		dstRect->top = rect->top;
-		dstRect->left = rect->left;
-		dstRect->right = rect->right;
-		dstRect->bottom = rect->bottom;
+		region16_clear(dst);
+		dst->extents = single;
+		dst->data = &single_region;
 		return TRUE;
 	}
 
@@ -682,6 +738,186 @@ BOOL region16_union_rect(REGION16* dst, const REGION16* src, const RECTANGLE_16*
 	return region16_simplify_bands(dst);
 }
 
+static int region16_compare_top(const void* a, const void* b)
+{
+	const RECTANGLE_16* r1 = (const RECTANGLE_16*)a;
+	const RECTANGLE_16* r2 = (const RECTANGLE_16*)b;
+
+	if (r1->top != r2->top)
+		return (r1->top < r2->top) ? -1 : 1;
+
+	return (r1->left < r2->left) ? -1 : (r1->left > r2->left);
+}
+
+static int region16_compare_y(const void* a, const void* b)
+{
+	const UINT16 y1 = *(const UINT16*)a;
+	const UINT16 y2 = *(const UINT16*)b;
+	return (y1 < y2) ? -1 : (y1 > y2);
+}
+
+static BOOL region16_append_rect(REGION16_DATA** data, UINT32* capacity, UINT16 left,
+                                 UINT16 top, UINT16 right, UINT16 bottom)
+{
+	RECTANGLE_16* rect;
+
+	if ((UINT32)(*data)->nbRects == *capacity)
+	{
+		const size_t allocSize =
+		    sizeof(REGION16_DATA) + (*capacity * 2ull * sizeof(RECTANGLE_16));
+		REGION16_DATA* tmp = realloc(*data, allocSize);
+
+		if (!tmp)
+			return FALSE;
+
+		*data = tmp;
+		*capacity *= 2;
+	}
+
+	rect = (RECTANGLE_16*)(&(*data)[1]) + (*data)->nbRects;
+	rect->left = left;
+	rect->top = top;
+	rect->right = right;
+	rect->bottom = bottom;
+	(*data)->nbRects++;
+	return TRUE;
+}
+
+BOOL region16_union_rects(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                          UINT32 count)
+{
+	BOOL rc = FALSE;
+	const RECTANGLE_16* srcRects;
+	RECTANGLE_16* items = NULL;
+	RECTANGLE_16* active = NULL;
+	UINT16* ys = NULL;
+	REGION16_DATA* newItems = NULL;
+	RECTANGLE_16 newExtents = { 0 };
+	UINT32 srcNbRects, nbItems = 0, nbYs = 0, nbActive = 0, next = 0, capacity;
+	UINT32 x, y, i;
+
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(src->data);
+	WINPR_ASSERT(rects || (count == 0));
+
+	if (count == 0)
+		return region16_copy(dst, src);
+
+	srcRects = region16_rects(src, &srcNbRects);
+	items = calloc(srcNbRects + count, sizeof(RECTANGLE_16));
+	active = calloc(srcNbRects + count, sizeof(RECTANGLE_16));
+	ys = calloc(2ull * (srcNbRects + count), sizeof(UINT16));
+
+	if (!items || !active || !ys)
+		goto out;
+
+	/* the source is copied first, dst may be src */
+	for (x = 0; x < srcNbRects; x++)
+		items[nbItems++] = srcRects[x];
+
+	for (x = 0; x < count; x++)
+	{
+		if (!rectangle_is_empty(&rects[x]))
+			items[nbItems++] = rects[x];
+	}
+
+	if (nbItems == 0)
+	{
+		region16_clear(dst);
+		rc = TRUE;
+		goto out;
+	}
+
+	newExtents = items[0];
+
+	for (x = 0; x < nbItems; x++)
+	{
+		newExtents.left = MIN(newExtents.left, items[x].left);
+		newExtents.top = MIN(newExtents.top, items[x].top);
+		newExtents.right = MAX(newExtents.right, items[x].right);
+		newExtents.bottom = MAX(newExtents.bottom, items[x].bottom);
+		ys[nbYs++] = items[x].top;
+		ys[nbYs++] = items[x].bottom;
+	}
+
+	qsort(items, nbItems, sizeof(RECTANGLE_16), region16_compare_top);
+	qsort(ys, nbYs, sizeof(UINT16), region16_compare_y);
+
+	capacity = nbItems * 2;
+	newItems = allocateRegion(capacity);
+
+	if (!newItems)
+		goto out;
+
+	newItems->nbRects = 0;
+
+	/* sweep the bands between consecutive edges, the active items are kept sorted by left */
+	for (y = 0; y + 1 < nbYs; y++)
+	{
+		const UINT16 top = ys[y];
+		const UINT16 bottom = ys[y + 1];
+		UINT16 left, right;
+
+		if (top == bottom)
+			continue;
+
+		for (x = 0, i = 0; x < nbActive; x++)
+		{
+			if (active[x].bottom > top)
+				active[i++] = active[x];
+		}
+
+		nbActive = i;
+
+		for (; (next < nbItems) && (items[next].top == top); next++)
+		{
+			for (i = nbActive; (i > 0) && (active[i - 1].left > items[next].left); i--)
+				active[i] = active[i - 1];
+
+			active[i] = items[next];
+			nbActive++;
+		}
+
+		if (nbActive == 0)
+			continue;
+
+		/* items of a band must not touch */
+		left = active[0].left;
+		right = active[0].right;
+
+		for (x = 1; x < nbActive; x++)
+		{
+			if (active[x].left <= right)
+				right = MAX(right, active[x].right);
+			else
+			{
+				if (!region16_append_rect(&newItems, &capacity, left, top, right, bottom))
+					goto out;
+
+				left = active[x].left;
+				right = active[x].right;
+			}
+		}
+
+		if (!region16_append_rect(&newItems, &capacity, left, top, right, bottom))
+			goto out;
+	}
+
+	newItems->size = sizeof(REGION16_DATA) + (newItems->nbRects * sizeof(RECTANGLE_16));
+	region16_clear(dst);
+	dst->data = newItems;
+	dst->extents = newExtents;
+	newItems = NULL;
+	rc = region16_simplify_bands(dst);
+out:
+	free(newItems);
+	free(ys);
+	free(active);
+	free(items);
+	return rc;
+}
+
 BOOL region16_intersects_rect(const REGION16* src, const RECTANGLE_16* arg2)
 {
 	const RECTANGLE_16 *rect, *endPtr, *srcExtents;
@@ -703,10 +939,22 @@ BOOL region16_intersects_rect(const REGION16* src, const RECTANGLE_16* arg2)
 	if (!rectangles_intersects(srcExtents, arg2))
 		return FALSE;
 
-	for (endPtr = rect + nbRects; (rect < endPtr) && (arg2->bottom > rect->top); rect++)
+	endPtr = rect + nbRects;
+	rect = band_below(rect, endPtr, arg2->top);
+
+	while ((rect < endPtr) && (arg2->bottom > rect->top))
 	{
+		/* the items of a band are sorted, the next ones are right of arg2 too */
+		if (rect->left >= arg2->right)
+		{
+			rect = band_end(rect, endPtr);
+			continue;
+		}
+
 		if (rectangles_intersects(rect, arg2))
 			return TRUE;
+
+		rect++;
 	}
 
 	return FALSE;
@@ -754,8 +1002,18 @@ BOOL region16_intersect_rect(REGION16* dst, const REGION16* src, const RECTANGLE
 	/* accumulate intersecting rectangles, the final region16_simplify_bands() will
 	 * do all the bad job to recreate correct rectangles
 	 */
-	for (endPtr = srcPtr + nbRects; (srcPtr < endPtr) && (rect->bottom > srcPtr->top); srcPtr++)
+	endPtr = srcPtr + nbRects;
+	srcPtr = band_below(srcPtr, endPtr, rect->top);
+
+	for (; (srcPtr < endPtr) && (rect->bottom > srcPtr->top); srcPtr++)
 	{
+		/* the items of a band are sorted, the next ones are right of rect too */
+		if (srcPtr->left >= rect->right)
+		{
+			srcPtr = band_end(srcPtr, endPtr) - 1;
+			continue;
+		}
+
 		if (rectangles_intersection(srcPtr, rect, &common))
 		{
 			*dstPtr = common;
@@ -798,6 +1056,113 @@ BOOL region16_intersect_rect(REGION16* dst, const REGION16* src, const RECTANGLE
 	return region16_simplify_bands(dst);
 }
 
+/* merges the items of each band that are at most gap apart, in place
+ * @return the new number of rectangles
+ */
+static UINT32 region16_coalesce_gaps(RECTANGLE_16* rects, UINT32 nbRects, UINT32 gap)
+{
+	RECTANGLE_16 *band, *next, *item, *bandStart, *tmp;
+	RECTANGLE_16* endPtr = rects + nbRects;
+	RECTANGLE_16* prevBand = NULL;
+	RECTANGLE_16* dst = rects;
+	int bandItems;
+
+	/* dst never passes the item read, the items are rewritten in place */
+	for (band = rects; band < endPtr; band = next)
+	{
+		RECTANGLE_16 merged = *band;
+
+		next = next_band(band, endPtr, &bandItems);
+		bandStart = dst;
+
+		for (item = band + 1; item < next; item++)
+		{
+			if ((UINT32)(item->left - merged.right) <= gap)
+				merged.right = item->right;
+			else
+			{
+				*dst++ = merged;
+				merged = *item;
+			}
+		}
+
+		*dst++ = merged;
+
+		/* the band may now be the same as the one right above */
+		if (prevBand && (prevBand->bottom == bandStart->top) &&
+		    band_match(prevBand, bandStart, dst))
+		{
+			for (tmp = prevBand; tmp < bandStart; tmp++)
+				tmp->bottom = bandStart->bottom;
+
+			dst = bandStart;
+		}
+		else
+			prevBand = bandStart;
+	}
+
+	return (UINT32)(dst - rects);
+}
+
+/* stacks groups of perRect neighbouring single item bands, in place
+ * @return the new number of rectangles
+ */
+static UINT32 region16_coalesce_bands(RECTANGLE_16* rects, UINT32 nbRects, UINT32 perRect)
+{
+	UINT32 x, y;
+	RECTANGLE_16* dst = rects;
+
+	for (x = 0; x < nbRects; x += perRect)
+	{
+		const UINT32 count = MIN(perRect, nbRects - x);
+		RECTANGLE_16 merged = rects[x];
+
+		for (y = 1; y < count; y++)
+		{
+			merged.left = MIN(merged.left, rects[x + y].left);
+			merged.right = MAX(merged.right, rects[x + y].right);
+		}
+
+		merged.bottom = rects[x + count - 1].bottom;
+
+		if ((dst > rects) && (dst[-1].bottom == merged.top) && (dst[-1].left == merged.left) &&
+		    (dst[-1].right == merged.right))
+			dst[-1].bottom = merged.bottom;
+		else
+			*dst++ = merged;
+	}
+
+	return (UINT32)(dst - rects);
+}
+
+void region16_coalesce(REGION16* region, UINT32 maxRects)
+{
+	RECTANGLE_16* rects;
+	UINT32 nbRects, gap;
+
+	WINPR_ASSERT(region);
+	WINPR_ASSERT(region->data);
+
+	nbRects = (UINT32)region16_n_rects(region);
+
+	if ((maxRects == 0) || (nbRects <= maxRects))
+		return;
+
+	rects = region16_rects_noconst(region);
+
+	/* close the smallest gaps first, once no gap is left each band is a single rectangle */
+	for (gap = 16; (nbRects > maxRects) && (gap <= UINT16_MAX + 1); gap *= 2)
+		nbRects = region16_coalesce_gaps(rects, nbRects, gap);
+
+	if (nbRects > maxRects)
+		nbRects = region16_coalesce_bands(rects, nbRects, (nbRects + maxRects - 1) / maxRects);
+
+	/* the allocation is only shrunk logically, it is freed as a whole */
+	region->data->nbRects = nbRects;
+	region->data->size = sizeof(REGION16_DATA) + (nbRects * sizeof(RECTANGLE_16));
+	region16_pack(region);
+}
+
 void region16_uninit(REGION16* region)
 {
 	WINPR_ASSERT(region);
@@ -47,8 +47,10 @@
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
 #include "rfx_rlgr.h"
+#include "rfx_shared_cache.h"
 
 #include "rfx_sse2.h"
+#include "rfx_avx2.h"
 #include "rfx_neon.h"
 
 #define TAG FREERDP_TAG("codec")
@@ -140,6 +142,18 @@ static void rfx_profiler_print(RFX_CONTEXT* context)
 	PROFILER_PRINT(context->priv->prof_rfx_rgb_to_ycbcr)
 	PROFILER_PRINT(context->priv->prof_rfx_encode_format_rgb)
 	PROFILER_PRINT_FOOTER
+#ifdef WITH_PROFILER
+	{
+		UINT32 arenas = 0;
+		UINT32 contended = 0;
+		UINT64 uses = 0;
+		rfx_scratch_pool_stats(context->priv->ScratchPool, &arenas, &uses, &contended);
+		WLog_INFO(TAG,
+		          "scratch buffers: %" PRIu32 " thread arenas, %" PRIu64 " uses, %" PRIu32
+		          " contended locks",
+		          arenas, uses, contended);
+	}
+#endif
 }
 
 static void rfx_tile_init(void* obj)
@@ -259,15 +273,25 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	 * Additionally we add 32 bytes (16 in front and 16 at the back of the buffer)
 	 * in order to allow optimized functions (SEE, NEON) to read from positions
 	 * that are actually in front/beyond the buffer. Offset calculations are
-	 * performed at the BufferPool_Take function calls in rfx_encode/decode.c.
+	 * performed at the rfx_scratch_get function calls in rfx_encode/decode.c.
 	 *
 	 * We then multiply by 3 to use a single, partioned buffer for all 3 channels.
+	 *
+	 * The per tile scratch buffers are private to each worker thread, the shared
+	 * pool only holds the encoder tile data that lives as long as a message.
 	 */
-	priv->BufferPool = BufferPool_New(TRUE, (8192 + 32) * 3, 16);
+	priv->BufferPool = BufferPool_New(TRUE, RFX_SCRATCH_BUFFER_SIZE, 16);
 
 	if (!priv->BufferPool)
 		goto fail;
 
+	priv->ScratchPool = rfx_scratch_pool_new(RFX_SCRATCH_COUNT);
+
+	if (!priv->ScratchPool)
+		goto fail;
+
+	priv->TileCacheEnabled = encoder;
+
 	if (!(ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS))
 	{
 #ifdef _WIN32
@@ -344,9 +368,14 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	context->quantization_encode = rfx_quantization_encode;
 	context->dwt_2d_decode = rfx_dwt_2d_decode;
 	context->dwt_2d_encode = rfx_dwt_2d_encode;
+	context->quantization_dwt_2d_decode = rfx_quantization_dwt_2d_decode;
 	context->rlgr_decode = rfx_rlgr_decode;
 	context->rlgr_encode = rfx_rlgr_encode;
 	RFX_INIT_SIMD(context);
+#if defined(WITH_SSE2)
+	/* AVX2 kernels replace the SSE2 ones when the CPU supports them */
+	rfx_init_avx2(context);
+#endif
 	context->state = RFX_STATE_SEND_HEADERS;
 	context->expectedDataBlockType = WBT_FRAME_BEGIN;
 	return context;
@@ -355,6 +384,221 @@ fail:
 	return NULL;
 }
 
+static void rfx_tile_cache_free(RFX_CONTEXT_PRIV* priv)
+{
+	size_t i;
+
+	if (priv->TileCache)
+	{
+		for (i = 0; i < (size_t)priv->TileCacheColumns * priv->TileCacheRows; i++)
+		{
+			free(priv->TileCache[i].pixels);
+			free(priv->TileCache[i].data);
+		}
+	}
+
+	free(priv->TileCache);
+	priv->TileCache = NULL;
+	priv->TileCacheColumns = 0;
+	priv->TileCacheRows = 0;
+}
+
+static BOOL rfx_tile_cache_resize(RFX_CONTEXT* context, UINT32 width, UINT32 height)
+{
+	RFX_CONTEXT_PRIV* priv = context->priv;
+	const UINT32 columns = (width + 63) / 64;
+	const UINT32 rows = (height + 63) / 64;
+
+	if ((priv->TileCacheColumns == columns) && (priv->TileCacheRows == rows))
+		return TRUE;
+
+	rfx_tile_cache_free(priv);
+	priv->TileCache = (RFX_TILE_CACHE_ENTRY*)calloc((size_t)columns * rows,
+	                                                sizeof(RFX_TILE_CACHE_ENTRY));
+
+	if (!priv->TileCache)
+		return FALSE;
+
+	priv->TileCacheColumns = columns;
+	priv->TileCacheRows = rows;
+	return TRUE;
+}
+
+static RFX_TILE_CACHE_ENTRY* rfx_tile_cache_entry(RFX_CONTEXT* context, const RFX_TILE* tile)
+{
+	RFX_CONTEXT_PRIV* priv = context->priv;
+
+	if (!priv->TileCache || (tile->xIdx >= priv->TileCacheColumns) ||
+	    (tile->yIdx >= priv->TileCacheRows))
+		return NULL;
+
+	return &priv->TileCache[(size_t)tile->yIdx * priv->TileCacheColumns + tile->xIdx];
+}
+
+static void rfx_tile_cache_get_quant_vals(RFX_CONTEXT* context, const RFX_TILE* tile,
+                                          UINT32* quantVals)
+{
+	CopyMemory(&quantVals[0], &context->quants[tile->quantIdxY * 10], 10 * sizeof(UINT32));
+	CopyMemory(&quantVals[10], &context->quants[tile->quantIdxCb * 10], 10 * sizeof(UINT32));
+	CopyMemory(&quantVals[20], &context->quants[tile->quantIdxCr * 10], 10 * sizeof(UINT32));
+}
+
+/* Fills the tile with the cached data if pixels and encoder parameters did not change */
+static BOOL rfx_tile_cache_lookup(RFX_CONTEXT* context, RFX_TILE* tile)
+{
+	UINT32 y;
+	UINT32 quantVals[3 * 10];
+	const size_t bpp = context->bits_per_pixel / 8;
+	const RFX_TILE_CACHE_ENTRY* entry = rfx_tile_cache_entry(context, tile);
+
+	if (!entry || !entry->valid)
+		return FALSE;
+
+	if ((entry->width != tile->width) || (entry->height != tile->height) ||
+	    (entry->format != context->pixel_format) || (entry->mode != context->mode))
+		return FALSE;
+
+	rfx_tile_cache_get_quant_vals(context, tile, quantVals);
+
+	if (memcmp(entry->quantVals, quantVals, sizeof(quantVals)) != 0)
+		return FALSE;
+
+	for (y = 0; y < tile->height; y++)
+	{
+		if (memcmp(&entry->pixels[y * 64 * bpp], &tile->data[y * tile->scanline],
+		           tile->width * bpp) != 0)
+			return FALSE;
+	}
+
+	CopyMemory(tile->YData, entry->data, entry->YLen);
+	CopyMemory(tile->CbData, &entry->data[entry->YLen], entry->CbLen);
+	CopyMemory(tile->CrData, &entry->data[entry->YLen + entry->CbLen], entry->CrLen);
+	tile->YLen = entry->YLen;
+	tile->CbLen = entry->CbLen;
+	tile->CrLen = entry->CrLen;
+	return TRUE;
+}
+
+static void rfx_tile_cache_store(RFX_CONTEXT* context, const RFX_TILE* tile)
+{
+	UINT32 y;
+	const size_t bpp = context->bits_per_pixel / 8;
+	const size_t size = (size_t)tile->YLen + tile->CbLen + tile->CrLen;
+	RFX_TILE_CACHE_ENTRY* entry = rfx_tile_cache_entry(context, tile);
+
+	if (!entry)
+		return;
+
+	entry->valid = FALSE;
+
+	if (!tile->YLen || !tile->CbLen || !tile->CrLen)
+		return;
+
+	if (!entry->pixels)
+	{
+		if (!(entry->pixels = (BYTE*)malloc(64 * 64 * 4)))
+			return;
+	}
+
+	if (entry->dataSize < size)
+	{
+		BYTE* data = (BYTE*)realloc(entry->data, size);
+
+		if (!data)
+			return;
+
+		entry->data = data;
+		entry->dataSize = size;
+	}
+
+	for (y = 0; y < tile->height; y++)
+		CopyMemory(&entry->pixels[y * 64 * bpp], &tile->data[y * tile->scanline],
+		           tile->width * bpp);
+
+	CopyMemory(entry->data, tile->YData, tile->YLen);
+	CopyMemory(&entry->data[tile->YLen], tile->CbData, tile->CbLen);
+	CopyMemory(&entry->data[tile->YLen + tile->CbLen], tile->CrData, tile->CrLen);
+	entry->YLen = tile->YLen;
+	entry->CbLen = tile->CbLen;
+	entry->CrLen = tile->CrLen;
+	entry->width = tile->width;
+	entry->height = tile->height;
+	entry->format = context->pixel_format;
+	entry->mode = context->mode;
+	rfx_tile_cache_get_quant_vals(context, tile, entry->quantVals);
+	entry->valid = TRUE;
+}
+
+BOOL rfx_context_set_tile_cache(RFX_CONTEXT* context, BOOL enable)
+{
+	if (!context || !context->priv || !context->encoder)
+		return FALSE;
+
+	context->priv->TileCacheEnabled = enable;
+
+	if (!enable)
+		rfx_tile_cache_free(context->priv);
+
+	return TRUE;
+}
+
+BOOL rfx_context_set_shared_tile_cache(RFX_CONTEXT* context, BOOL enable)
+{
+	if (!context || !context->priv || !context->encoder)
+		return FALSE;
+
+	context->priv->SharedTileCache = enable;
+	return TRUE;
+}
+
+BOOL rfx_context_get_tile_stats(RFX_CONTEXT* context, UINT64* tilesEncoded, UINT64* tilesSkipped)
+{
+	if (!context || !context->priv)
+		return FALSE;
+
+	if (tilesEncoded)
+		*tilesEncoded = context->priv->TilesEncoded;
+
+	if (tilesSkipped)
+		*tilesSkipped = context->priv->TilesSkipped;
+
+	return TRUE;
+}
+
+BOOL rfx_context_set_quantization_offset(RFX_CONTEXT* context, UINT32 offset)
+{
+	size_t x;
+	UINT32* quants;
+
+	if (!context || !context->encoder)
+		return FALSE;
+
+	quants = (UINT32*)realloc(context->quants, sizeof(rfx_default_quantization_values));
+	if (!quants)
+		return FALSE;
+
+	/* 15 is the coarsest quantization the format allows */
+	for (x = 0; x < ARRAYSIZE(rfx_default_quantization_values); x++)
+		quants[x] = MIN(rfx_default_quantization_values[x] + offset, 15);
+
+	context->quants = quants;
+	context->numQuant = 1;
+	context->quantIdxY = 0;
+	context->quantIdxCb = 0;
+	context->quantIdxCr = 0;
+	return TRUE;
+}
+
+void rfx_context_trim(RFX_CONTEXT* context)
+{
+	if (!context)
+		return;
+
+	WINPR_ASSERT(context->priv);
+	ObjectPool_Clear(context->priv->TilePool);
+	BufferPool_Clear(context->priv->BufferPool);
+}
+
 void rfx_context_free(RFX_CONTEXT* context)
 {
 	RFX_CONTEXT_PRIV* priv;
@@ -390,6 +634,11 @@ void rfx_context_free(RFX_CONTEXT* context)
 		}
 
 		BufferPool_Free(priv->BufferPool);
+		rfx_scratch_pool_free(priv->ScratchPool);
+		rfx_tile_cache_free(priv);
+		free(priv->DirectTiles);
+		_aligned_free(priv->BatchCoefficients);
+		free(priv->BatchQuants);
 		free(priv);
 	}
 	free(context);
@@ -754,13 +1003,113 @@ typedef struct
 {
 	RFX_TILE* tile;
 	RFX_CONTEXT* context;
+	BYTE* dst;
+	UINT32 stride;
 } RFX_TILE_PROCESS_WORK_PARAM;
 
 static void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
                                                             void* context, PTP_WORK work)
 {
 	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
-	rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4);
+	rfx_decode_rgb(param->context, param->tile, param->dst, param->stride);
+}
+
+/* The union of the message rects, moved to the target position and clipped to the target */
+static void rfx_get_clipping_region(const RFX_MESSAGE* message, const RFX_DECODE_TARGET* target,
+                                    REGION16* clippingRects)
+{
+	UINT32 i;
+
+	for (i = 0; i < message->numRects; i++)
+	{
+		RECTANGLE_16 clippingRect;
+		const RFX_RECT* rect = &(message->rects[i]);
+		clippingRect.left = MIN(target->left + rect->x, target->width);
+		clippingRect.top = MIN(target->top + rect->y, target->height);
+		clippingRect.right = MIN(clippingRect.left + rect->width, target->width);
+		clippingRect.bottom = MIN(clippingRect.top + rect->height, target->height);
+		region16_union_rect(clippingRects, clippingRects, &clippingRect);
+	}
+}
+
+/**
+ * The color conversion may leave the X byte of 32bpp pixels alone. The tile buffers are
+ * initialized to 0xFF, so set it for tiles decoded in place to get the same result.
+ */
+static void rfx_set_opaque(BYTE* dst, UINT32 format, UINT32 stride, UINT32 x, UINT32 y,
+                           UINT32 width, UINT32 height)
+{
+	UINT32 i, j, k;
+	BYTE mask[4];
+	const UINT32 alpha = ~FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0);
+
+	if (GetBytesPerPixel(format) != 4)
+		return;
+
+	/* 32bpp colors are stored most significant byte first, see WriteColor */
+	for (k = 0; k < 4; k++)
+		mask[k] = (BYTE)(alpha >> (24 - 8 * k));
+
+	for (j = 0; j < height; j++)
+	{
+		BYTE* pixel = &dst[1ull * (y + j) * stride + 4ull * x];
+
+		for (i = 0; i < width; i++)
+		{
+			for (k = 0; k < 4; k++)
+				pixel[k] |= mask[k];
+
+			pixel += 4;
+		}
+	}
+}
+
+/**
+ * Returns where a tile is decoded to: the target itself if the tile is not clipped
+ * and the target matches the tile layout, the tile buffer otherwise.
+ */
+static BYTE* rfx_get_tile_destination(RFX_CONTEXT* context, const REGION16* clippingRects,
+                                      const RFX_TILE* tile, UINT32* pStride)
+{
+	UINT32 i;
+	UINT32 nbRects = 0;
+	UINT32 area = 0;
+	BYTE* dst;
+	REGION16 tileRegion;
+	RECTANGLE_16 tileRect;
+	const RECTANGLE_16* rects;
+	const RFX_DECODE_TARGET* target = &context->priv->DecodeTarget;
+
+	*pStride = 64 * 4;
+
+	if (!target->data || (target->format != context->pixel_format) || (target->stride & 0x0f))
+		return tile->data;
+
+	tileRect.left = target->left + tile->x;
+	tileRect.top = target->top + tile->y;
+	tileRect.right = tileRect.left + 64;
+	tileRect.bottom = tileRect.top + 64;
+	region16_init(&tileRegion);
+	region16_intersect_rect(&tileRegion, clippingRects, &tileRect);
+	rects = region16_rects(&tileRegion, &nbRects);
+
+	for (i = 0; i < nbRects; i++)
+		area += (UINT32)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+
+	region16_uninit(&tileRegion);
+
+	if (area != 64 * 64)
+		return tile->data;
+
+	/* the SIMD color conversion needs an aligned destination */
+	dst = &target->data[1ull * tileRect.top * target->stride +
+	                    1ull * tileRect.left * GetBytesPerPixel(target->format)];
+
+	if ((ULONG_PTR)dst & 0x0f)
+		return tile->data;
+
+	*pStride = target->stride;
+	return dst;
 }
 
 static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* message, wStream* s,
@@ -778,7 +1127,12 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	UINT32 tilesDataSize;
 	PTP_WORK* work_objects = NULL;
 	RFX_TILE_PROCESS_WORK_PARAM* params = NULL;
+	BYTE** batchDst = NULL;
+	UINT32* batchStride = NULL;
+	REGION16 clippingRects;
 	void* pmem;
+	/* primitives decoding on a GPU take all tiles of the message at once */
+	const BOOL batch = (primitives_get()->RFXDecodeTiles_16s8u != NULL);
 
 	if (*pExpectedBlockType != WBT_EXTENSION)
 	{
@@ -868,6 +1222,19 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 		message->tiles[i] = NULL;
 	}
 
+	if (context->priv->DirectTilesSize < numTiles)
+	{
+		BOOL* directTiles = (BOOL*)realloc(context->priv->DirectTiles, numTiles * sizeof(BOOL));
+
+		if (!directTiles)
+			return FALSE;
+
+		context->priv->DirectTiles = directTiles;
+		context->priv->DirectTilesSize = numTiles;
+	}
+
+	ZeroMemory(context->priv->DirectTiles, numTiles * sizeof(BOOL));
+
 	tmpTiles = (RFX_TILE**)realloc(message->tiles, numTiles * sizeof(RFX_TILE*));
 	if (!tmpTiles)
 		return FALSE;
@@ -875,7 +1242,20 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	message->tiles = tmpTiles;
 	message->numTiles = numTiles;
 
-	if (context->priv->UseThreads)
+
+	if (batch)
+	{
+		batchDst = (BYTE**)calloc(message->numTiles, sizeof(BYTE*));
+		batchStride = (UINT32*)calloc(message->numTiles, sizeof(UINT32));
+
+		if (!batchDst || !batchStride)
+		{
+			free(batchDst);
+			free(batchStride);
+			return FALSE;
+		}
+	}
+	else if (context->priv->UseThreads)
 	{
 		work_objects = (PTP_WORK*)calloc(message->numTiles, sizeof(PTP_WORK));
 		params = (RFX_TILE_PROCESS_WORK_PARAM*)calloc(message->numTiles,
@@ -897,6 +1277,10 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 	/* tiles */
 	close_cnt = 0;
 	rc = FALSE;
+	region16_init(&clippingRects);
+
+	if (context->priv->DecodeTarget.data)
+		rfx_get_clipping_region(message, &context->priv->DecodeTarget, &clippingRects);
 
 	if (Stream_GetRemainingLength(s) >= tilesDataSize)
 	{
@@ -905,6 +1289,8 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 		{
 			wStream subBuffer;
 			wStream* sub;
+			BYTE* dst;
+			UINT32 stride;
 
 			if (!(tile = (RFX_TILE*)ObjectPool_Take(context->priv->TilePool)))
 			{
@@ -980,8 +1366,15 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 			}
 			tile->x = tile->xIdx * 64;
 			tile->y = tile->yIdx * 64;
+			dst = rfx_get_tile_destination(context, &clippingRects, tile, &stride);
+			context->priv->DirectTiles[i] = (dst != tile->data);
 
-			if (context->priv->UseThreads)
+			if (batch)
+			{
+				batchDst[i] = dst;
+				batchStride[i] = stride;
+			}
+			else if (context->priv->UseThreads)
 			{
 				if (!params)
 				{
@@ -991,6 +1384,8 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 
 				params[i].context = context;
 				params[i].tile = message->tiles[i];
+				params[i].dst = dst;
+				params[i].stride = stride;
 
 				if (!(work_objects[i] =
 				          CreateThreadpoolWork(rfx_process_message_tile_work_callback,
@@ -1006,11 +1401,17 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 			}
 			else
 			{
-				rfx_decode_rgb(context, tile, tile->data, 64 * 4);
+				rfx_decode_rgb(context, tile, dst, stride);
 			}
 		}
+
+		if (batch && rc)
+			rc = rfx_decode_rgb_batch(context, message->tiles, message->numTiles, batchDst,
+			                          batchStride);
 	}
 
+	region16_uninit(&clippingRects);
+
 	if (context->priv->UseThreads)
 	{
 		for (i = 0; i < close_cnt; i++)
@@ -1022,6 +1423,8 @@ static BOOL rfx_process_message_tileset(RFX_CONTEXT* context, RFX_MESSAGE* messa
 
 	free(work_objects);
 	free(params);
+	free(batchDst);
+	free(batchStride);
 
 	for (i = 0; i < message->numTiles; i++)
 	{
@@ -1050,6 +1453,13 @@ BOOL rfx_process_message(RFX_CONTEXT* context, const BYTE* data, UINT32 length,
 		return FALSE;
 
 	message = &context->currentMessage;
+	context->priv->DecodeTarget.data = dst;
+	context->priv->DecodeTarget.format = dstFormat;
+	context->priv->DecodeTarget.stride = dstStride;
+	context->priv->DecodeTarget.width = dstStride / GetBytesPerPixel(dstFormat);
+	context->priv->DecodeTarget.height = dstHeight;
+	context->priv->DecodeTarget.left = left;
+	context->priv->DecodeTarget.top = top;
 
 	s = Stream_StaticConstInit(&inStream, data, length);
 
@@ -1193,19 +1603,8 @@ BOOL rfx_process_message(RFX_CONTEXT* context, const BYTE* data, UINT32 length,
 		REGION16 clippingRects;
 		const RECTANGLE_16* updateRects;
 		const DWORD formatSize = GetBytesPerPixel(context->pixel_format);
-		const UINT32 dstWidth = dstStride / GetBytesPerPixel(dstFormat);
 		region16_init(&clippingRects);
-
-		for (i = 0; i < message->numRects; i++)
-		{
-			RECTANGLE_16 clippingRect;
-			const RFX_RECT* rect = &(message->rects[i]);
-			clippingRect.left = MIN(left + rect->x, dstWidth);
-			clippingRect.top = MIN(top + rect->y, dstHeight);
-			clippingRect.right = MIN(clippingRect.left + rect->width, dstWidth);
-			clippingRect.bottom = MIN(clippingRect.top + rect->height, dstHeight);
-			region16_union_rect(&clippingRects, &clippingRects, &clippingRect);
-		}
+		rfx_get_clipping_region(message, &context->priv->DecodeTarget, &clippingRects);
 
 		for (i = 0; i < message->numTiles; i++)
 		{
@@ -1229,9 +1628,12 @@ BOOL rfx_process_message(RFX_CONTEXT* context, const BYTE* data, UINT32 length,
 				const UINT32 nWidth = updateRects[j].right - updateRects[j].left;
 				const UINT32 nHeight = updateRects[j].bottom - updateRects[j].top;
 
-				if (!freerdp_image_copy(dst, dstFormat, dstStride, nXDst, nYDst, nWidth, nHeight,
-				                        tile->data, context->pixel_format, stride, nXSrc, nYSrc,
-				                        NULL, FREERDP_FLIP_NONE))
+				/* tiles decoded in place are already there */
+				if (context->priv->DirectTiles[i])
+					rfx_set_opaque(dst, dstFormat, dstStride, nXDst, nYDst, nWidth, nHeight);
+				else if (!freerdp_image_copy(dst, dstFormat, dstStride, nXDst, nYDst, nWidth,
+				                             nHeight, tile->data, context->pixel_format, stride,
+				                             nXSrc, nYSrc, NULL, FREERDP_FLIP_NONE))
 				{
 					region16_uninit(&updateRegion);
 					return FALSE;
@@ -1403,11 +1805,37 @@ struct S_RFX_TILE_COMPOSE_WORK_PARAM
 	RFX_CONTEXT* context;
 };
 
+static void rfx_encode_tile(RFX_CONTEXT* context, RFX_TILE* tile)
+{
+	rfx_encode_rgb(context, tile);
+
+	if (context->priv->TileCache)
+		rfx_tile_cache_store(context, tile);
+
+	if (context->priv->SharedTileCacheActive)
+		rfx_shared_cache_store(context, tile);
+}
+
+/* Fills the tile from the tile cache of the context or the shared tile cache */
+static BOOL rfx_encode_tile_cached(RFX_CONTEXT* context, RFX_TILE* tile)
+{
+	if (context->priv->TileCache && rfx_tile_cache_lookup(context, tile))
+		return TRUE;
+
+	if (!context->priv->SharedTileCacheActive || !rfx_shared_cache_lookup(context, tile))
+		return FALSE;
+
+	if (context->priv->TileCache)
+		rfx_tile_cache_store(context, tile);
+
+	return TRUE;
+}
+
 static void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
                                                             void* context, PTP_WORK work)
 {
 	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*)context;
-	rfx_encode_rgb(param->context, param->tile);
+	rfx_encode_tile(param->context, param->tile);
 }
 
 static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16* region, int width,
@@ -1509,6 +1937,17 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 	message->quantVals = context->quants;
 	bytesPerPixel = (context->bits_per_pixel / 8);
 
+	/* palette formats depend on the palette content as well, do not cache them */
+	if (context->priv->TileCacheEnabled && (bytesPerPixel > 1))
+	{
+		if (!rfx_tile_cache_resize(context, width, height))
+			goto skip_encoding_loop;
+	}
+	else
+		rfx_tile_cache_free(context->priv);
+
+	context->priv->SharedTileCacheActive = context->priv->SharedTileCache && (bytesPerPixel > 1);
+
 	if (!computeRegion(rects, numRects, &rectsRegion, width, height))
 		goto skip_encoding_loop;
 
@@ -1610,8 +2049,21 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 				message->tiles[message->numTiles] = tile;
 				message->numTiles++;
 
-				if (context->priv->UseThreads)
+				if (rfx_encode_tile_cached(context, tile))
 				{
+					context->priv->TilesSkipped++;
+
+					if (context->priv->UseThreads)
+					{
+						*workObject = NULL;
+						workObject++;
+						workParam++;
+					}
+				}
+				else if (context->priv->UseThreads)
+				{
+					context->priv->TilesEncoded++;
+
 					workParam->context = context;
 					workParam->tile = tile;
 
@@ -1628,7 +2080,8 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* context, const RFX_RECT* rects, siz
 				}
 				else
 				{
-					rfx_encode_rgb(context, tile);
+					context->priv->TilesEncoded++;
+					rfx_encode_tile(context, tile);
 				}
 
 				if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
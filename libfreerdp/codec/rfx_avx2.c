@@ -0,0 +1,485 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "rfx_types.h"
+#include "rfx_avx2.h"
+#include "rfx_quantization.h"
+
+#ifdef _MSC_VER
+#define __attribute__(...)
+#endif
+
+#ifndef __clang__
+#define ATTRIBUTES __gnu_inline__, __always_inline__, __artificial__
+#else
+#define ATTRIBUTES __gnu_inline__, __always_inline__
+#endif
+
+/**
+ * The generic implementation computes all intermediate sums as int and only
+ * truncates when storing to INT16. The helpers below compute the same results
+ * without 16 bit overflow so that the output is bit exact for any input.
+ */
+
+/* (a + b) >> 1 */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_avg_floor_avx2(__m256i a, __m256i b)
+{
+	return _mm256_add_epi16(_mm256_and_si256(a, b), _mm256_srai_epi16(_mm256_xor_si256(a, b), 1));
+}
+
+/* (a + b + 1) >> 1 */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_avg_ceil_avx2(__m256i a, __m256i b)
+{
+	return _mm256_sub_epi16(_mm256_or_si256(a, b), _mm256_srai_epi16(_mm256_xor_si256(a, b), 1));
+}
+
+/* (a - b) >> 1 */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_half_diff_avx2(__m256i a, __m256i b)
+{
+	const __m256i diff = _mm256_sub_epi16(_mm256_srai_epi16(a, 1), _mm256_srai_epi16(b, 1));
+	const __m256i borrow = _mm256_and_si256(_mm256_andnot_si256(a, b), _mm256_set1_epi16(1));
+	return _mm256_sub_epi16(diff, borrow);
+}
+
+/* [first, a0, ..., a14] */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_shift_in_first_avx2(__m256i a, INT16 first)
+{
+	const __m256i t = _mm256_permute2x128_si256(a, a, 0x08);
+	return _mm256_insert_epi16(_mm256_alignr_epi8(a, t, 14), first, 0);
+}
+
+/* [a1, ..., a15, last] */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_shift_in_last_avx2(__m256i a, INT16 last)
+{
+	const __m256i t = _mm256_permute2x128_si256(a, a, 0x81);
+	return _mm256_insert_epi16(_mm256_alignr_epi8(t, a, 2), last, 15);
+}
+
+/* per 128 bit lane: [a0, a0, ..., a6] */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_lane_shift_in_first_avx2(__m256i a)
+{
+	const __m256i t = _mm256_shuffle_epi8(a, _mm256_set1_epi16(0x0100));
+	return _mm256_alignr_epi8(a, t, 14);
+}
+
+/* per 128 bit lane: [a1, ..., a7, a7] */
+static __inline __m256i __attribute__((ATTRIBUTES)) rfx_lane_shift_in_last_avx2(__m256i a)
+{
+	const __m256i t = _mm256_shuffle_epi8(a, _mm256_set1_epi16(0x0F0E));
+	return _mm256_alignr_epi8(t, a, 2);
+}
+
+/* splits src[0..31] into the 16 even and the 16 odd coefficients */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_deinterleave_avx2(const INT16* src, __m256i* even, __m256i* odd)
+{
+	const __m256i mask = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15, 0,
+	                                      1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	const __m256i a = _mm256_permute4x64_epi64(
+	    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), mask), 0xD8);
+	const __m256i b = _mm256_permute4x64_epi64(
+	    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&src[16]), mask), 0xD8);
+	*even = _mm256_permute2x128_si256(a, b, 0x20);
+	*odd = _mm256_permute2x128_si256(a, b, 0x31);
+}
+
+/* stores even0, odd0, even1, odd1, ... to dst[0..31] */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_interleave_avx2(INT16* dst, __m256i even, __m256i odd)
+{
+	const __m256i lo = _mm256_unpacklo_epi16(even, odd);
+	const __m256i hi = _mm256_unpackhi_epi16(even, odd);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)&dst[16], _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_quantization_decode_block_avx2(INT16* buffer, const size_t buffer_size, const UINT32 factor)
+{
+	__m256i* ptr = (__m256i*)buffer;
+	const __m256i* buf_end = (const __m256i*)(buffer + buffer_size);
+	const __m128i count = _mm_cvtsi32_si128((int)factor);
+
+	if (factor == 0)
+		return;
+
+	do
+	{
+		const __m256i a = _mm256_loadu_si256(ptr);
+		_mm256_storeu_si256(ptr, _mm256_sll_epi16(a, count));
+		ptr++;
+	} while (ptr < buf_end);
+}
+
+static void rfx_quantization_decode_avx2(INT16* buffer, const UINT32* quantVals)
+{
+	rfx_quantization_decode_block_avx2(&buffer[0], 1024, quantVals[8] - 1);    /* HL1 */
+	rfx_quantization_decode_block_avx2(&buffer[1024], 1024, quantVals[7] - 1); /* LH1 */
+	rfx_quantization_decode_block_avx2(&buffer[2048], 1024, quantVals[9] - 1); /* HH1 */
+	rfx_quantization_decode_block_avx2(&buffer[3072], 256, quantVals[5] - 1);  /* HL2 */
+	rfx_quantization_decode_block_avx2(&buffer[3328], 256, quantVals[4] - 1);  /* LH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3584], 256, quantVals[6] - 1);  /* HH2 */
+	rfx_quantization_decode_block_avx2(&buffer[3840], 64, quantVals[2] - 1);   /* HL3 */
+	rfx_quantization_decode_block_avx2(&buffer[3904], 64, quantVals[1] - 1);   /* LH3 */
+	rfx_quantization_decode_block_avx2(&buffer[3968], 64, quantVals[3] - 1);   /* HH3 */
+	rfx_quantization_decode_block_avx2(&buffer[4032], 64, quantVals[0] - 1);   /* LL3 */
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_quantization_encode_block_avx2(INT16* buffer, const size_t buffer_size, const UINT32 factor)
+{
+	__m256i* ptr = (__m256i*)buffer;
+	const __m256i* buf_end = (const __m256i*)(buffer + buffer_size);
+	const __m128i count = _mm_cvtsi32_si128((int)factor);
+	__m256i half;
+	__m256i mask;
+
+	if (factor == 0)
+		return;
+
+	half = _mm256_set1_epi16((INT16)(1 << (factor - 1)));
+	mask = _mm256_set1_epi16((INT16)((1 << factor) - 1));
+
+	do
+	{
+		/* (a + half) >> factor == (a >> factor) + (((a & mask) + half) >> factor) */
+		const __m256i a = _mm256_loadu_si256(ptr);
+		const __m256i q = _mm256_sra_epi16(a, count);
+		const __m256i r =
+		    _mm256_srl_epi16(_mm256_add_epi16(_mm256_and_si256(a, mask), half), count);
+		_mm256_storeu_si256(ptr, _mm256_add_epi16(q, r));
+		ptr++;
+	} while (ptr < buf_end);
+}
+
+static void rfx_quantization_encode_avx2(INT16* buffer, const UINT32* quantization_values)
+{
+	rfx_quantization_encode_block_avx2(buffer, 1024, quantization_values[8] - 6);        /* HL1 */
+	rfx_quantization_encode_block_avx2(buffer + 1024, 1024, quantization_values[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_avx2(buffer + 2048, 1024, quantization_values[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_avx2(buffer + 3072, 256, quantization_values[5] - 6);  /* HL2 */
+	rfx_quantization_encode_block_avx2(buffer + 3328, 256, quantization_values[4] - 6);  /* LH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3584, 256, quantization_values[6] - 6);  /* HH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3840, 64, quantization_values[2] - 6);   /* HL3 */
+	rfx_quantization_encode_block_avx2(buffer + 3904, 64, quantization_values[1] - 6);   /* LH3 */
+	rfx_quantization_encode_block_avx2(buffer + 3968, 64, quantization_values[3] - 6);   /* HH3 */
+	rfx_quantization_encode_block_avx2(buffer + 4032, 64, quantization_values[0] - 6);   /* LL3 */
+	rfx_quantization_encode_block_avx2(buffer, 4096, 5);
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_horiz_avx2(const INT16* l, const INT16* h, INT16* dst,
+                                   size_t subband_width, UINT32 lshift, UINT32 hshift)
+{
+	size_t y, n;
+	/* the dequantization of both sub-bands is done as they are loaded */
+	const __m128i l_count = _mm_cvtsi32_si128((int)lshift);
+	const __m128i h_count = _mm_cvtsi32_si128((int)hshift);
+
+	if (subband_width == 8)
+	{
+		/* One row per 128 bit lane */
+		for (y = 0; y < subband_width; y += 2)
+		{
+			const __m256i l_n = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)l), l_count);
+			const __m256i h_n = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)h), h_count);
+			const __m256i h_n_m = rfx_lane_shift_in_first_avx2(h_n);
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+			const __m256i dst_2n = _mm256_sub_epi16(l_n, rfx_avg_ceil_avx2(h_n_m, h_n));
+			const __m256i dst_2n_p = rfx_lane_shift_in_last_avx2(dst_2n);
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+			const __m256i dst_2n_1 =
+			    _mm256_add_epi16(_mm256_slli_epi16(h_n, 1), rfx_avg_floor_avx2(dst_2n, dst_2n_p));
+			rfx_interleave_avx2(dst, dst_2n, dst_2n_1);
+			l += 16;
+			h += 16;
+			dst += 32;
+		}
+
+		return;
+	}
+
+	for (y = 0; y < subband_width; y++)
+	{
+		for (n = 0; n < subband_width; n += 16)
+		{
+			INT16 next;
+			const __m256i l_n =
+			    _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)&l[n]), l_count);
+			const __m256i h_n =
+			    _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)&h[n]), h_count);
+			const __m256i h_n_m = rfx_shift_in_first_avx2(
+			    h_n, rfx_quantization_dequantize((n == 0) ? h[0] : h[n - 1], hshift));
+			const __m256i dst_2n = _mm256_sub_epi16(l_n, rfx_avg_ceil_avx2(h_n_m, h_n));
+			__m256i dst_2n_p;
+			__m256i dst_2n_1;
+
+			if (n + 16 < subband_width)
+			{
+				const INT16 l_next = rfx_quantization_dequantize(l[n + 16], lshift);
+				const INT16 h_last = rfx_quantization_dequantize(h[n + 15], hshift);
+				const INT16 h_next = rfx_quantization_dequantize(h[n + 16], hshift);
+				next = (INT16)(l_next - ((h_last + h_next + 1) >> 1));
+			}
+			else
+				next = (INT16)_mm256_extract_epi16(dst_2n, 15);
+
+			dst_2n_p = rfx_shift_in_last_avx2(dst_2n, next);
+			dst_2n_1 =
+			    _mm256_add_epi16(_mm256_slli_epi16(h_n, 1), rfx_avg_floor_avx2(dst_2n, dst_2n_p));
+			rfx_interleave_avx2(&dst[2 * n], dst_2n, dst_2n_1);
+		}
+
+		l += subband_width;
+		h += subband_width;
+		dst += 2 * subband_width;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_vert_avx2(const INT16* l, const INT16* h, INT16* dst, size_t subband_width)
+{
+	size_t x, n;
+	const size_t total_width = subband_width << 1;
+
+	for (n = 0; n < subband_width; n++)
+	{
+		const INT16* l_row = &l[n * total_width];
+		const INT16* h_row = &h[n * total_width];
+		INT16* dst_row = &dst[2 * n * total_width];
+
+		for (x = 0; x < total_width; x += 16)
+		{
+			const __m256i l_n = _mm256_loadu_si256((const __m256i*)&l_row[x]);
+			const __m256i h_n = _mm256_loadu_si256((const __m256i*)&h_row[x]);
+			const __m256i h_n_m =
+			    (n == 0) ? h_n : _mm256_loadu_si256((const __m256i*)&h_row[x - total_width]);
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+			const __m256i dst_2n = _mm256_sub_epi16(l_n, rfx_avg_ceil_avx2(h_n_m, h_n));
+			_mm256_storeu_si256((__m256i*)&dst_row[x], dst_2n);
+
+			/* dst[2n - 1] = (h[n - 1] << 1) + ((dst[2n - 2] + dst[2n]) >> 1); */
+			if (n > 0)
+			{
+				const __m256i dst_2n_m =
+				    _mm256_loadu_si256((const __m256i*)&dst_row[x - 2 * total_width]);
+				_mm256_storeu_si256((__m256i*)&dst_row[x - total_width],
+				                    _mm256_add_epi16(_mm256_slli_epi16(h_n_m, 1),
+				                                     rfx_avg_floor_avx2(dst_2n_m, dst_2n)));
+			}
+
+			if (n == subband_width - 1)
+				_mm256_storeu_si256((__m256i*)&dst_row[x + total_width],
+				                    _mm256_add_epi16(_mm256_slli_epi16(h_n, 1), dst_2n));
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_decode_block_avx2(INT16* buffer, INT16* idwt, size_t subband_width,
+                             const UINT32 factors[4])
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_dst, *h_dst;
+	/* Inverse DWT in horizontal direction, results in 2 sub-bands in L, H order in tmp buffer idwt.
+	 */
+	/* The 4 sub-bands are stored in HL(0), LH(1), HH(2), LL(3) order. */
+	/* The lower part L uses LL(3) and HL(0). */
+	/* The higher part H uses LH(1) and HH(2). */
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	l_dst = idwt;
+	rfx_dwt_2d_decode_block_horiz_avx2(ll, hl, l_dst, subband_width, factors[3], factors[0]);
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	h_dst = idwt + subband_width * subband_width * 2;
+	rfx_dwt_2d_decode_block_horiz_avx2(lh, hh, h_dst, subband_width, factors[1], factors[2]);
+	/* Inverse DWT in vertical direction, results are stored in original buffer. */
+	rfx_dwt_2d_decode_block_vert_avx2(l_dst, h_dst, buffer, subband_width);
+}
+
+static void rfx_dwt_2d_decode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	static const UINT32 none[4] = { 0 };
+
+	rfx_dwt_2d_decode_block_avx2(&buffer[3840], dwt_buffer, 8, none);
+	rfx_dwt_2d_decode_block_avx2(&buffer[3072], dwt_buffer, 16, none);
+	rfx_dwt_2d_decode_block_avx2(&buffer[0], dwt_buffer, 32, none);
+}
+
+static void rfx_quantization_dwt_2d_decode_avx2(INT16* buffer, INT16* dwt_buffer,
+                                                const UINT32* quantization_values)
+{
+	UINT32 factors[4];
+
+	rfx_quantization_level_factors(quantization_values, 3, factors);
+	rfx_dwt_2d_decode_block_avx2(&buffer[3840], dwt_buffer, 8, factors);
+	rfx_quantization_level_factors(quantization_values, 2, factors);
+	rfx_dwt_2d_decode_block_avx2(&buffer[3072], dwt_buffer, 16, factors);
+	rfx_quantization_level_factors(quantization_values, 1, factors);
+	rfx_dwt_2d_decode_block_avx2(&buffer[0], dwt_buffer, 32, factors);
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_vert_avx2(const INT16* src, INT16* l, INT16* h, size_t subband_width)
+{
+	size_t x, n;
+	const size_t total_width = subband_width << 1;
+
+	for (n = 0; n < subband_width; n++)
+	{
+		const INT16* src_row = &src[2 * n * total_width];
+		INT16* l_row = &l[n * total_width];
+		INT16* h_row = &h[n * total_width];
+
+		for (x = 0; x < total_width; x += 16)
+		{
+			const __m256i src_2n = _mm256_loadu_si256((const __m256i*)&src_row[x]);
+			const __m256i src_2n_1 = _mm256_loadu_si256((const __m256i*)&src_row[x + total_width]);
+			const __m256i src_2n_2 =
+			    (n < subband_width - 1)
+			        ? _mm256_loadu_si256((const __m256i*)&src_row[x + 2 * total_width])
+			        : src_2n;
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			const __m256i h_n = rfx_half_diff_avx2(src_2n_1, rfx_avg_floor_avx2(src_2n, src_2n_2));
+			const __m256i h_n_m =
+			    (n == 0) ? h_n : _mm256_loadu_si256((const __m256i*)&h_row[x - total_width]);
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			const __m256i l_n = _mm256_add_epi16(src_2n, rfx_avg_floor_avx2(h_n_m, h_n));
+			_mm256_storeu_si256((__m256i*)&h_row[x], h_n);
+			_mm256_storeu_si256((__m256i*)&l_row[x], l_n);
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_horiz_avx2(const INT16* src, INT16* l, INT16* h, size_t subband_width)
+{
+	size_t y, n;
+	__m256i src_2n;
+	__m256i src_2n_1;
+
+	if (subband_width == 8)
+	{
+		/* One row per 128 bit lane */
+		for (y = 0; y < subband_width; y += 2)
+		{
+			__m256i src_2n_2;
+			__m256i h_n;
+			__m256i l_n;
+			rfx_deinterleave_avx2(src, &src_2n, &src_2n_1);
+			src_2n_2 = rfx_lane_shift_in_last_avx2(src_2n);
+			h_n = rfx_half_diff_avx2(src_2n_1, rfx_avg_floor_avx2(src_2n, src_2n_2));
+			l_n = _mm256_add_epi16(src_2n,
+			                       rfx_avg_floor_avx2(rfx_lane_shift_in_first_avx2(h_n), h_n));
+			_mm256_storeu_si256((__m256i*)h, h_n);
+			_mm256_storeu_si256((__m256i*)l, l_n);
+			src += 32;
+			l += 16;
+			h += 16;
+		}
+
+		return;
+	}
+
+	for (y = 0; y < subband_width; y++)
+	{
+		for (n = 0; n < subband_width; n += 16)
+		{
+			INT16 next;
+			INT16 first;
+			__m256i src_2n_2;
+			__m256i h_n;
+			__m256i l_n;
+			rfx_deinterleave_avx2(&src[2 * n], &src_2n, &src_2n_1);
+
+			if (n + 16 < subband_width)
+				next = src[2 * n + 32];
+			else
+				next = (INT16)_mm256_extract_epi16(src_2n, 15);
+
+			src_2n_2 = rfx_shift_in_last_avx2(src_2n, next);
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			h_n = rfx_half_diff_avx2(src_2n_1, rfx_avg_floor_avx2(src_2n, src_2n_2));
+
+			if (n == 0)
+				first = (INT16)_mm256_extract_epi16(h_n, 0);
+			else
+				first = h[n - 1];
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			l_n = _mm256_add_epi16(src_2n,
+			                       rfx_avg_floor_avx2(rfx_shift_in_first_avx2(h_n, first), h_n));
+			_mm256_storeu_si256((__m256i*)&h[n], h_n);
+			_mm256_storeu_si256((__m256i*)&l[n], l_n);
+		}
+
+		src += 2 * subband_width;
+		l += subband_width;
+		h += subband_width;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_avx2(INT16* buffer, INT16* dwt, size_t subband_width)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_src, *h_src;
+	/* DWT in vertical direction, results in 2 sub-bands in L, H order in tmp buffer dwt. */
+	l_src = dwt;
+	h_src = dwt + subband_width * subband_width * 2;
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, l_src, h_src, subband_width);
+	/* DWT in horizontal direction, results in 4 sub-bands in HL(0), LH(1), HH(2), LL(3) order,
+	 * stored in original buffer. */
+	/* The lower part L generates LL(3) and HL(0). */
+	/* The higher part H generates LH(1) and HH(2). */
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	rfx_dwt_2d_encode_block_horiz_avx2(l_src, ll, hl, subband_width);
+	rfx_dwt_2d_encode_block_horiz_avx2(h_src, lh, hh, subband_width);
+}
+
+static void rfx_dwt_2d_encode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	rfx_dwt_2d_encode_block_avx2(buffer, dwt_buffer, 32);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3072, dwt_buffer, 16);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3840, dwt_buffer, 8);
+}
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return;
+
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_decode, "rfx_quantization_decode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode_avx2")
+	context->quantization_decode = rfx_quantization_decode_avx2;
+	context->quantization_encode = rfx_quantization_encode_avx2;
+	context->dwt_2d_decode = rfx_dwt_2d_decode_avx2;
+	context->quantization_dwt_2d_decode = rfx_quantization_dwt_2d_decode_avx2;
+	context->dwt_2d_encode = rfx_dwt_2d_encode_avx2;
+}
@@ -35,26 +35,32 @@
 
 #include "rfx_decode.h"
 
-void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values, const BYTE* data,
-                          int size, INT16* buffer)
+static void rfx_decode_entropy(RFX_CONTEXT* context, const BYTE* data, int size, INT16* buffer)
 {
-	INT16* dwt_buffer;
-	dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
-	PROFILER_ENTER(context->priv->prof_rfx_decode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_rlgr_decode)
 	context->rlgr_decode(context->mode, data, size, buffer, 4096);
 	PROFILER_EXIT(context->priv->prof_rfx_rlgr_decode)
 	PROFILER_ENTER(context->priv->prof_rfx_differential_decode)
 	rfx_differential_decode(buffer + 4032, 64);
 	PROFILER_EXIT(context->priv->prof_rfx_differential_decode)
-	PROFILER_ENTER(context->priv->prof_rfx_quantization_decode)
-	context->quantization_decode(buffer, quantization_values);
-	PROFILER_EXIT(context->priv->prof_rfx_quantization_decode)
+}
+
+void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values, const BYTE* data,
+                          int size, INT16* buffer)
+{
+	INT16* dwt_buffer;
+	dwt_buffer = (INT16*)rfx_scratch_get(context->priv->ScratchPool, RFX_SCRATCH_DWT);
+
+	if (!dwt_buffer)
+		return;
+
+	PROFILER_ENTER(context->priv->prof_rfx_decode_component)
+	rfx_decode_entropy(context, data, size, buffer);
+	/* the sub-bands are dequantized while the inverse DWT loads them */
 	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_decode)
-	context->dwt_2d_decode(buffer, dwt_buffer);
+	context->quantization_dwt_2d_decode(buffer, dwt_buffer, quantization_values);
 	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_component)
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
 }
 
 /* rfx_decode_ycbcr_to_rgb code now resides in the primitives library. */
@@ -72,7 +78,11 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer
 	y_quants = context->quants + (tile->quantIdxY * 10);
 	cb_quants = context->quants + (tile->quantIdxCb * 10);
 	cr_quants = context->quants + (tile->quantIdxCr * 10);
-	pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1);
+	pBuffer = rfx_scratch_get(context->priv->ScratchPool, RFX_SCRATCH_TILE);
+
+	if (!pBuffer)
+		return FALSE;
+
 	pSrcDst[0] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 0) + 16]));             /* y_r_buffer */
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16]));             /* cb_g_buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16]));             /* cr_b_buffer */
@@ -88,6 +98,89 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BYTE* rgb_buffer
 
 	PROFILER_EXIT(context->priv->prof_rfx_ycbcr_to_rgb)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_rgb)
-	BufferPool_Return(context->priv->BufferPool, pBuffer);
+	return rc;
+}
+
+static BOOL rfx_decode_batch_reserve(RFX_CONTEXT_PRIV* priv, UINT32 numTiles)
+{
+	INT16* coefficients;
+	UINT32* quants;
+
+	if (priv->BatchSize >= numTiles)
+		return TRUE;
+
+	coefficients = (INT16*)_aligned_realloc(priv->BatchCoefficients,
+	                                        3ull * 4096 * sizeof(INT16) * numTiles, 32);
+	if (!coefficients)
+		return FALSE;
+	priv->BatchCoefficients = coefficients;
+
+	quants = (UINT32*)realloc(priv->BatchQuants, 3ull * 10 * sizeof(UINT32) * numTiles);
+	if (!quants)
+		return FALSE;
+	priv->BatchQuants = quants;
+
+	priv->BatchSize = numTiles;
+	return TRUE;
+}
+
+BOOL rfx_decode_rgb_batch(RFX_CONTEXT* context, RFX_TILE* const* tiles, UINT32 numTiles,
+                          BYTE* const* dst, const UINT32* stride)
+{
+	UINT32 i, x;
+	BOOL rc = TRUE;
+	INT16* dwt_buffer;
+	static const prim_size_t roi_64x64 = { 64, 64 };
+	const primitives_t* prims = primitives_get();
+	RFX_CONTEXT_PRIV* priv = context->priv;
+
+	if (!prims->RFXDecodeTiles_16s8u || !rfx_decode_batch_reserve(priv, numTiles))
+		return FALSE;
+
+	/* The entropy decoding stays on the CPU, the rest of all tiles is done in one call */
+	for (i = 0; i < numTiles; i++)
+	{
+		const RFX_TILE* tile = tiles[i];
+		const BYTE quantIdx[3] = { tile->quantIdxY, tile->quantIdxCb, tile->quantIdxCr };
+		const BYTE* data[3] = { tile->YData, tile->CbData, tile->CrData };
+		const int size[3] = { tile->YLen, tile->CbLen, tile->CrLen };
+
+		for (x = 0; x < 3; x++)
+		{
+			const size_t component = 3ull * i + x;
+			rfx_decode_entropy(context, data[x], size[x],
+			                   &priv->BatchCoefficients[component * 4096]);
+			CopyMemory(&priv->BatchQuants[component * 10], &context->quants[quantIdx[x] * 10],
+			           10 * sizeof(UINT32));
+		}
+	}
+
+	if (prims->RFXDecodeTiles_16s8u(priv->BatchCoefficients, priv->BatchQuants, numTiles, dst,
+	                                stride, context->pixel_format) == PRIMITIVES_SUCCESS)
+		return TRUE;
+
+	/* The GPU does not handle the format or failed, finish the batch on the CPU */
+	dwt_buffer = (INT16*)rfx_scratch_get(priv->ScratchPool, RFX_SCRATCH_DWT);
+	if (!dwt_buffer)
+		return FALSE;
+
+	for (i = 0; i < numTiles; i++)
+	{
+		INT16* pSrcDst[3];
+
+		for (x = 0; x < 3; x++)
+		{
+			const size_t component = 3ull * i + x;
+			pSrcDst[x] = &priv->BatchCoefficients[component * 4096];
+			context->quantization_dwt_2d_decode(pSrcDst[x], dwt_buffer,
+			                                    &priv->BatchQuants[component * 10]);
+		}
+
+		if (prims->yCbCrToRGB_16s8u_P3AC4R((const INT16**)pSrcDst, 64 * sizeof(INT16), dst[i],
+		                                   stride[i], context->pixel_format,
+		                                   &roi_64x64) != PRIMITIVES_SUCCESS)
+			rc = FALSE;
+	}
+
 	return rc;
 }
@@ -28,4 +28,7 @@ FREERDP_LOCAL BOOL rfx_decode_rgb(RFX_CONTEXT* context, const RFX_TILE* tile, BY
                                   UINT32 stride);
 FREERDP_LOCAL void rfx_decode_component(RFX_CONTEXT* context, const UINT32* quantization_values,
                                         const BYTE* data, int size, INT16* buffer);
+/* decodes all tiles with one RFXDecodeTiles_16s8u call, tile i is written to dst[i] */
+FREERDP_LOCAL BOOL rfx_decode_rgb_batch(RFX_CONTEXT* context, RFX_TILE* const* tiles,
+                                        UINT32 numTiles, BYTE* const* dst, const UINT32* stride);
 #endif /* FREERDP_LIB_CODEC_RFX_DECODE_H */
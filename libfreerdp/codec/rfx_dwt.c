@@ -24,12 +24,24 @@
 #include <string.h>
 
 #include "rfx_dwt.h"
+#include "rfx_quantization.h"
 
-static void rfx_dwt_2d_decode_block(INT16* buffer, INT16* idwt, int subband_width)
+static void rfx_dwt_dequantize_row(INT16* dst, const INT16* src, int count, UINT32 factor)
+{
+	int n;
+
+	for (n = 0; n < count; n++)
+		dst[n] = rfx_quantization_dequantize(src[n], factor);
+}
+
+/* factors are the dequantization shifts of the HL, LH, HH and LL sub-bands */
+static void rfx_dwt_2d_decode_block(INT16* buffer, INT16* idwt, int subband_width,
+                                    const UINT32 factors[4])
 {
 	INT16 *dst, *l, *h;
 	INT16 *l_dst, *h_dst;
-	INT16 *hl, *lh, *hh, *ll;
+	const INT16 *hl_src, *lh_src, *hh_src, *ll_src;
+	INT16 hl[32], lh[32], hh[32], ll[32];
 	int total_width;
 	int x, y;
 	int n;
@@ -42,16 +54,21 @@ static void rfx_dwt_2d_decode_block(INT16* buffer, INT16* idwt, int subband_widt
 	/* The lower part L uses LL(3) and HL(0). */
 	/* The higher part H uses LH(1) and HH(2). */
 
-	ll = buffer + subband_width * subband_width * 3;
-	hl = buffer;
+	ll_src = buffer + subband_width * subband_width * 3;
+	hl_src = buffer;
 	l_dst = idwt;
 
-	lh = buffer + subband_width * subband_width;
-	hh = buffer + subband_width * subband_width * 2;
+	lh_src = buffer + subband_width * subband_width;
+	hh_src = buffer + subband_width * subband_width * 2;
 	h_dst = idwt + subband_width * subband_width * 2;
 
 	for (y = 0; y < subband_width; y++)
 	{
+		rfx_dwt_dequantize_row(hl, hl_src, subband_width, factors[0]);
+		rfx_dwt_dequantize_row(lh, lh_src, subband_width, factors[1]);
+		rfx_dwt_dequantize_row(hh, hh_src, subband_width, factors[2]);
+		rfx_dwt_dequantize_row(ll, ll_src, subband_width, factors[3]);
+
 		/* Even coefficients */
 		l_dst[0] = ll[0] - ((hl[0] + hl[0] + 1) >> 1);
 		h_dst[0] = lh[0] - ((hh[0] + hh[0] + 1) >> 1);
@@ -73,12 +90,12 @@ static void rfx_dwt_2d_decode_block(INT16* buffer, INT16* idwt, int subband_widt
 		l_dst[x + 1] = (hl[n] << 1) + (l_dst[x]);
 		h_dst[x + 1] = (hh[n] << 1) + (h_dst[x]);
 
-		ll += subband_width;
-		hl += subband_width;
+		ll_src += subband_width;
+		hl_src += subband_width;
 		l_dst += total_width;
 
-		lh += subband_width;
-		hh += subband_width;
+		lh_src += subband_width;
+		hh_src += subband_width;
 		h_dst += total_width;
 	}
 
@@ -111,9 +128,24 @@ static void rfx_dwt_2d_decode_block(INT16* buffer, INT16* idwt, int subband_widt
 
 void rfx_dwt_2d_decode(INT16* buffer, INT16* dwt_buffer)
 {
-	rfx_dwt_2d_decode_block(&buffer[3840], dwt_buffer, 8);
-	rfx_dwt_2d_decode_block(&buffer[3072], dwt_buffer, 16);
-	rfx_dwt_2d_decode_block(&buffer[0], dwt_buffer, 32);
+	static const UINT32 none[4] = { 0 };
+
+	rfx_dwt_2d_decode_block(&buffer[3840], dwt_buffer, 8, none);
+	rfx_dwt_2d_decode_block(&buffer[3072], dwt_buffer, 16, none);
+	rfx_dwt_2d_decode_block(&buffer[0], dwt_buffer, 32, none);
+}
+
+void rfx_quantization_dwt_2d_decode(INT16* buffer, INT16* dwt_buffer,
+                                    const UINT32* quantization_values)
+{
+	UINT32 factors[4];
+
+	rfx_quantization_level_factors(quantization_values, 3, factors);
+	rfx_dwt_2d_decode_block(&buffer[3840], dwt_buffer, 8, factors);
+	rfx_quantization_level_factors(quantization_values, 2, factors);
+	rfx_dwt_2d_decode_block(&buffer[3072], dwt_buffer, 16, factors);
+	rfx_quantization_level_factors(quantization_values, 1, factors);
+	rfx_dwt_2d_decode_block(&buffer[0], dwt_buffer, 32, factors);
 }
 
 static void rfx_dwt_2d_encode_block(INT16* buffer, INT16* dwt, int subband_width)
@@ -24,6 +24,8 @@
 #include <freerdp/api.h>
 
 FREERDP_LOCAL void rfx_dwt_2d_decode(INT16* buffer, INT16* dwt_buffer);
+FREERDP_LOCAL void rfx_quantization_dwt_2d_decode(INT16* buffer, INT16* dwt_buffer,
+                                                  const UINT32* quantization_values);
 FREERDP_LOCAL void rfx_dwt_2d_encode(INT16* buffer, INT16* dwt_buffer);
 
 #endif /* FREERDP_LIB_CODEC_RFX_DWT_H */
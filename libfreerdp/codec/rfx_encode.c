@@ -234,7 +234,14 @@ static void rfx_encode_component(RFX_CONTEXT* context, const UINT32* quantizatio
                                  INT16* data, BYTE* buffer, int buffer_size, int* size)
 {
 	INT16* dwt_buffer;
-	dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
+	dwt_buffer = (INT16*)rfx_scratch_get(context->priv->ScratchPool, RFX_SCRATCH_DWT);
+
+	if (!dwt_buffer)
+	{
+		*size = 0;
+		return;
+	}
+
 	PROFILER_ENTER(context->priv->prof_rfx_encode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_encode)
 	context->dwt_2d_encode(data, dwt_buffer);
@@ -249,7 +256,22 @@ static void rfx_encode_component(RFX_CONTEXT* context, const UINT32* quantizatio
 	*size = context->rlgr_encode(context->mode, data, 4096, buffer, buffer_size);
 	PROFILER_EXIT(context->priv->prof_rfx_rlgr_encode)
 	PROFILER_EXIT(context->priv->prof_rfx_encode_component)
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
+}
+
+void rfx_encode_ycbcr(RFX_CONTEXT* context, const RFX_TILE* tile, INT16* pSrcDst[3])
+{
+	primitives_t* prims = primitives_get();
+	static const prim_size_t roi_64x64 = { 64, 64 };
+
+	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
+	rfx_encode_format_rgb(tile->data, tile->width, tile->height, tile->scanline,
+	                      context->pixel_format, context->palette, pSrcDst[0], pSrcDst[1],
+	                      pSrcDst[2]);
+	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
+	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
+	prims->RGBToYCbCr_16s16s_P3P3((const INT16**)pSrcDst, 64 * sizeof(INT16), pSrcDst,
+	                              64 * sizeof(INT16), &roi_64x64);
+	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
 }
 
 void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
@@ -258,10 +280,8 @@ void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
 	INT16* pSrcDst[3];
 	int YLen, CbLen, CrLen;
 	UINT32 *YQuant, *CbQuant, *CrQuant;
-	primitives_t* prims = primitives_get();
-	static const prim_size_t roi_64x64 = { 64, 64 };
 
-	if (!(pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1)))
+	if (!(pBuffer = rfx_scratch_get(context->priv->ScratchPool, RFX_SCRATCH_TILE)))
 		return;
 
 	YLen = CbLen = CrLen = 0;
@@ -272,15 +292,7 @@ void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
 	pSrcDst[1] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 1) + 16])); /* cb_g_buffer */
 	pSrcDst[2] = (INT16*)((BYTE*)(&pBuffer[((8192 + 32) * 2) + 16])); /* cr_b_buffer */
 	PROFILER_ENTER(context->priv->prof_rfx_encode_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
-	rfx_encode_format_rgb(tile->data, tile->width, tile->height, tile->scanline,
-	                      context->pixel_format, context->palette, pSrcDst[0], pSrcDst[1],
-	                      pSrcDst[2]);
-	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
-	prims->RGBToYCbCr_16s16s_P3P3((const INT16**)pSrcDst, 64 * sizeof(INT16), pSrcDst,
-	                              64 * sizeof(INT16), &roi_64x64);
-	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
+	rfx_encode_ycbcr(context, tile, pSrcDst);
 	/**
 	 * We need to clear the buffers as the RLGR encoder expects it to be initialized to zero.
 	 * This allows simplifying and improving the performance of the encoding process.
@@ -295,5 +307,4 @@ void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile)
 	tile->CbLen = (UINT16)CbLen;
 	tile->CrLen = (UINT16)CrLen;
 	PROFILER_EXIT(context->priv->prof_rfx_encode_rgb)
-	BufferPool_Return(context->priv->BufferPool, pBuffer);
 }
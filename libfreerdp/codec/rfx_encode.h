@@ -23,6 +23,8 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+FREERDP_LOCAL void rfx_encode_ycbcr(RFX_CONTEXT* context, const RFX_TILE* tile,
+                                   INT16* pSrcDst[3]);
 FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile);
 
 #endif /* FREERDP_LIB_CODEC_RFX_ENCODE_H */
@@ -29,6 +29,7 @@
 
 #include "rfx_types.h"
 #include "rfx_neon.h"
+#include "rfx_quantization.h"
 
 /* rfx_decode_YCbCr_to_RGB_NEON code now resides in the primitives library. */
 
@@ -63,12 +64,17 @@ static void rfx_quantization_decode_NEON(INT16* buffer, const UINT32* quantVals)
 }
 
 static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
-rfx_dwt_2d_decode_block_horiz_NEON(INT16* l, INT16* h, INT16* dst, int subband_width)
+rfx_dwt_2d_decode_block_horiz_NEON(INT16* l, INT16* h, INT16* dst, int subband_width,
+                                   UINT32 lshift, UINT32 hshift)
 {
 	int y, n;
 	INT16* l_ptr = l;
 	INT16* h_ptr = h;
 	INT16* dst_ptr = dst;
+	/* the dequantization of both sub-bands is done as they are loaded */
+	const int16x8_t l_count = vdupq_n_s16((INT16)lshift);
+	const int16x8_t h_count = vdupq_n_s16((INT16)hshift);
+	const int16x8_t h_count_odd = vdupq_n_s16((INT16)(hshift + 1));
 
 	for (y = 0; y < subband_width; y++)
 	{
@@ -76,9 +82,9 @@ rfx_dwt_2d_decode_block_horiz_NEON(INT16* l, INT16* h, INT16* dst, int subband_w
 		for (n = 0; n < subband_width; n += 8)
 		{
 			// dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1);
-			int16x8_t l_n = vld1q_s16(l_ptr);
-			int16x8_t h_n = vld1q_s16(h_ptr);
-			int16x8_t h_n_m = vld1q_s16(h_ptr - 1);
+			int16x8_t l_n = vshlq_s16(vld1q_s16(l_ptr), l_count);
+			int16x8_t h_n = vshlq_s16(vld1q_s16(h_ptr), h_count);
+			int16x8_t h_n_m = vshlq_s16(vld1q_s16(h_ptr - 1), h_count);
 
 			if (n == 0)
 			{
@@ -103,7 +109,7 @@ rfx_dwt_2d_decode_block_horiz_NEON(INT16* l, INT16* h, INT16* dst, int subband_w
 		{
 			// dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1);
 			int16x8_t h_n = vld1q_s16(h_ptr);
-			h_n = vshlq_n_s16(h_n, 1);
+			h_n = vshlq_s16(h_n, h_count_odd);
 			int16x8x2_t dst_n;
 			dst_n.val[0] = vld1q_s16(l_ptr);
 			int16x8_t dst_n_p = vld1q_s16(l_ptr + 1);
@@ -197,7 +203,8 @@ rfx_dwt_2d_decode_block_vert_NEON(INT16* l, INT16* h, INT16* dst, int subband_wi
 }
 
 static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
-rfx_dwt_2d_decode_block_NEON(INT16* buffer, INT16* idwt, int subband_width)
+rfx_dwt_2d_decode_block_NEON(INT16* buffer, INT16* idwt, int subband_width,
+                             const UINT32 factors[4])
 {
 	INT16 *hl, *lh, *hh, *ll;
 	INT16 *l_dst, *h_dst;
@@ -209,20 +216,35 @@ rfx_dwt_2d_decode_block_NEON(INT16* buffer, INT16* idwt, int subband_width)
 	ll = buffer + subband_width * subband_width * 3;
 	hl = buffer;
 	l_dst = idwt;
-	rfx_dwt_2d_decode_block_horiz_NEON(ll, hl, l_dst, subband_width);
+	rfx_dwt_2d_decode_block_horiz_NEON(ll, hl, l_dst, subband_width, factors[3], factors[0]);
 	lh = buffer + subband_width * subband_width;
 	hh = buffer + subband_width * subband_width * 2;
 	h_dst = idwt + subband_width * subband_width * 2;
-	rfx_dwt_2d_decode_block_horiz_NEON(lh, hh, h_dst, subband_width);
+	rfx_dwt_2d_decode_block_horiz_NEON(lh, hh, h_dst, subband_width, factors[1], factors[2]);
 	/* Inverse DWT in vertical direction, results are stored in original buffer. */
 	rfx_dwt_2d_decode_block_vert_NEON(l_dst, h_dst, buffer, subband_width);
 }
 
 static void rfx_dwt_2d_decode_NEON(INT16* buffer, INT16* dwt_buffer)
 {
-	rfx_dwt_2d_decode_block_NEON(buffer + 3840, dwt_buffer, 8);
-	rfx_dwt_2d_decode_block_NEON(buffer + 3072, dwt_buffer, 16);
-	rfx_dwt_2d_decode_block_NEON(buffer, dwt_buffer, 32);
+	static const UINT32 none[4] = { 0 };
+
+	rfx_dwt_2d_decode_block_NEON(buffer + 3840, dwt_buffer, 8, none);
+	rfx_dwt_2d_decode_block_NEON(buffer + 3072, dwt_buffer, 16, none);
+	rfx_dwt_2d_decode_block_NEON(buffer, dwt_buffer, 32, none);
+}
+
+static void rfx_quantization_dwt_2d_decode_NEON(INT16* buffer, INT16* dwt_buffer,
+                                                const UINT32* quantization_values)
+{
+	UINT32 factors[4];
+
+	rfx_quantization_level_factors(quantization_values, 3, factors);
+	rfx_dwt_2d_decode_block_NEON(buffer + 3840, dwt_buffer, 8, factors);
+	rfx_quantization_level_factors(quantization_values, 2, factors);
+	rfx_dwt_2d_decode_block_NEON(buffer + 3072, dwt_buffer, 16, factors);
+	rfx_quantization_level_factors(quantization_values, 1, factors);
+	rfx_dwt_2d_decode_block_NEON(buffer, dwt_buffer, 32, factors);
 }
 
 void rfx_init_neon(RFX_CONTEXT* context)
@@ -236,6 +258,7 @@ void rfx_init_neon(RFX_CONTEXT* context)
 		PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode_NEON");
 		context->quantization_decode = rfx_quantization_decode_NEON;
 		context->dwt_2d_decode = rfx_dwt_2d_decode_NEON;
+		context->quantization_dwt_2d_decode = rfx_quantization_dwt_2d_decode_NEON;
 	}
 }
 
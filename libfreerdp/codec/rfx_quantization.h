@@ -26,4 +26,25 @@
 FREERDP_LOCAL void rfx_quantization_decode(INT16* buffer, const UINT32* quantization_values);
 FREERDP_LOCAL void rfx_quantization_encode(INT16* buffer, const UINT32* quantization_values);
 
+static INLINE INT16 rfx_quantization_dequantize(INT16 value, UINT32 factor)
+{
+	return (INT16)((UINT16)value << factor);
+}
+
+/* The dequantization shifts of the HL, LH, HH and LL sub-bands of one DWT level (1 to 3).
+ * Only level 3 has a quantized LL band, the others are the output of the level below. */
+static INLINE void rfx_quantization_level_factors(const UINT32* quantization_values,
+                                                  size_t level, UINT32 factors[4])
+{
+	static const BYTE index[3][4] = { { 8, 7, 9, 0xFF }, { 5, 4, 6, 0xFF }, { 2, 1, 3, 0 } };
+	size_t x;
+
+	for (x = 0; x < 4; x++)
+	{
+		const BYTE i = index[level - 1][x];
+		const UINT32 quant = (i != 0xFF) ? quantization_values[i] : 0;
+		factors[x] = (quant > 0) ? quant - 1 : 0;
+	}
+}
+
 #endif /* FREERDP_LIB_CODEC_RFX_QUANTIZATION_H */
@@ -34,8 +34,6 @@
 #include <winpr/bitstream.h>
 #include <winpr/intrin.h>
 
-#include "rfx_bitstream.h"
-
 #include "rfx_rlgr.h"
 
 /* Constants used in RLGR1/RLGR3 algorithm */
@@ -46,19 +44,6 @@
 #define UQ_GR (3)  /* increase in kp after nonzero symbol in GR mode */
 #define DQ_GR (3)  /* decrease in kp after zero symbol in GR mode */
 
-/* Returns the least number of bits required to represent a given value */
-#define GetMinBits(_val, _nbits) \
-	do                           \
-	{                            \
-		UINT32 _v = _val;        \
-		_nbits = 0;              \
-		while (_v)               \
-		{                        \
-			_v >>= 1;            \
-			_nbits++;            \
-		}                        \
-	} while (0)
-
 /*
  * Update the passed parameter and clamp it to the range [0, KPMAX]
  * Return the value of parameter right-shifted by LSGR
@@ -89,6 +74,10 @@ static INLINE UINT32 lzcnt_s(UINT32 x)
 	if (!x)
 		return 32;
 
+#if defined(__GNUC__)
+	/* __builtin_clz falls back to bsr on CPUs without lzcnt */
+	return __lzcnt(x);
+#else
 	if (!g_LZCNT)
 	{
 		UINT32 y;
@@ -124,6 +113,7 @@ static INLINE UINT32 lzcnt_s(UINT32 x)
 	}
 
 	return __lzcnt(x);
+#endif
 }
 
 int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* pSrcData, UINT32 SrcSize, INT16* pDstData,
@@ -572,17 +562,95 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* pSrcData, UINT32 SrcSize, INT16*
 	} while (0)
 
 /* Emit bitPattern to the output bitstream */
-#define OutputBits(numBits, bitPattern) rfx_bitstream_put_bits(bs, bitPattern, numBits)
+#define OutputBits(numBits, bitPattern) rfx_rlgr_put_bits(bs, bitPattern, numBits)
 
 /* Emit a bit (0 or 1), count number of times, to the output bitstream */
-#define OutputBit(count, bit)                                    \
-	do                                                           \
-	{                                                            \
-		UINT16 _b = (bit ? 0xFFFF : 0);                          \
-		int _c = (count);                                        \
-		for (; _c > 0; _c -= 16)                                 \
-			rfx_bitstream_put_bits(bs, _b, (_c > 16 ? 16 : _c)); \
-	} while (0)
+#define OutputBit(count, bit) rfx_rlgr_put_bit(bs, bit, count)
+
+typedef struct
+{
+	BYTE* buffer;
+	size_t size;
+	size_t pos;
+	UINT64 accumulator;
+	UINT32 bits;
+} RFX_RLGR_WRITER;
+
+static INLINE void rfx_rlgr_write_byte(RFX_RLGR_WRITER* bs, BYTE value)
+{
+	if (bs->pos < bs->size)
+		bs->buffer[bs->pos++] = value;
+}
+
+static INLINE void rfx_rlgr_write_uint32(RFX_RLGR_WRITER* bs, UINT32 value)
+{
+	if (bs->pos + 4 <= bs->size)
+	{
+		BYTE* dst = &bs->buffer[bs->pos];
+		dst[0] = (BYTE)(value >> 24);
+		dst[1] = (BYTE)(value >> 16);
+		dst[2] = (BYTE)(value >> 8);
+		dst[3] = (BYTE)value;
+		bs->pos += 4;
+	}
+	else
+	{
+		rfx_rlgr_write_byte(bs, (BYTE)(value >> 24));
+		rfx_rlgr_write_byte(bs, (BYTE)(value >> 16));
+		rfx_rlgr_write_byte(bs, (BYTE)(value >> 8));
+		rfx_rlgr_write_byte(bs, (BYTE)value);
+	}
+}
+
+/* Appends the nbits (at most 32) lower bits of value, flushing 32 bits at a time */
+static INLINE void rfx_rlgr_put_bits(RFX_RLGR_WRITER* bs, UINT32 value, UINT32 nbits)
+{
+	if (nbits == 0)
+		return;
+
+	if (nbits < 32)
+		value &= (1u << nbits) - 1;
+
+	bs->accumulator = (bs->accumulator << nbits) | value;
+	bs->bits += nbits;
+
+	if (bs->bits >= 32)
+	{
+		bs->bits -= 32;
+		rfx_rlgr_write_uint32(bs, (UINT32)(bs->accumulator >> bs->bits));
+	}
+}
+
+static INLINE void rfx_rlgr_put_bit(RFX_RLGR_WRITER* bs, UINT32 bit, UINT32 count)
+{
+	const UINT32 pattern = bit ? 0xFFFFFFFF : 0;
+
+	for (; count > 32; count -= 32)
+		rfx_rlgr_put_bits(bs, pattern, 32);
+
+	rfx_rlgr_put_bits(bs, pattern, count);
+}
+
+/**
+ * Pads with zero bits and returns the number of bytes written.
+ * The padding length equals the number of bits used in the last byte, which may
+ * add a trailing zero byte. This keeps the output identical to earlier releases.
+ */
+static INLINE size_t rfx_rlgr_flush(RFX_RLGR_WRITER* bs)
+{
+	rfx_rlgr_put_bits(bs, 0, bs->bits & 7);
+
+	while (bs->bits >= 8)
+	{
+		bs->bits -= 8;
+		rfx_rlgr_write_byte(bs, (BYTE)(bs->accumulator >> bs->bits));
+	}
+
+	if (bs->bits > 0)
+		rfx_rlgr_write_byte(bs, (BYTE)(bs->accumulator << (8 - bs->bits)));
+
+	return bs->pos;
+}
 
 /* Converts the input value to (2 * abs(input) - sign(input)), where sign(input) = (input < 0 ? 1 :
  * 0) and returns it */
@@ -591,7 +659,7 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* pSrcData, UINT32 SrcSize, INT16*
 /* Outputs the Golomb/Rice encoding of a non-negative integer */
 #define CodeGR(krp, val) rfx_rlgr_code_gr(bs, krp, val)
 
-static void rfx_rlgr_code_gr(RFX_BITSTREAM* bs, int* krp, UINT32 val)
+static void rfx_rlgr_code_gr(RFX_RLGR_WRITER* bs, int* krp, UINT32 val)
 {
 	int kr = *krp >> LSGR;
 
@@ -624,13 +692,13 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* data, UINT32 data_size, BYTE* b
 	int k;
 	int kp;
 	int krp;
-	RFX_BITSTREAM* bs;
-	int processed_size;
+	RFX_RLGR_WRITER s_bs = { 0 };
+	RFX_RLGR_WRITER* bs = &s_bs;
 
-	if (!(bs = (RFX_BITSTREAM*)calloc(1, sizeof(RFX_BITSTREAM))))
-		return 0;
+	InitOnceExecuteOnce(&rfx_rlgr_init_once, rfx_rlgr_init, NULL, NULL);
 
-	rfx_bitstream_attach(bs, buffer, buffer_size);
+	bs->buffer = buffer;
+	bs->size = buffer_size;
 
 	/* initialize the parameters */
 	k = 1;
@@ -736,7 +804,7 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* data, UINT32 data_size, BYTE* b
 				CodeGR(&krp, sum2Ms);
 
 				/* encode binary representation of the first input (twoMs1). */
-				GetMinBits(sum2Ms, nIdx);
+				nIdx = 32 - lzcnt_s(sum2Ms);
 				OutputBits(nIdx, twoMs1);
 
 				/* update k,kp for the two input values */
@@ -753,9 +821,5 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* data, UINT32 data_size, BYTE* b
 		}
 	}
 
-	rfx_bitstream_flush(bs);
-	processed_size = rfx_bitstream_get_processed_bytes(bs);
-	free(bs);
-
-	return processed_size;
+	return (int)rfx_rlgr_flush(bs);
 }
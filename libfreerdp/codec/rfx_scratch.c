@@ -0,0 +1,181 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - Per Thread Scratch Buffers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include "rfx_scratch.h"
+
+/* Arenas and buffers start on their own cache line, threads never share one */
+#define RFX_SCRATCH_ALIGNMENT 64
+#define RFX_SCRATCH_STRIDE \
+	((RFX_SCRATCH_BUFFER_SIZE + RFX_SCRATCH_ALIGNMENT - 1) & ~(size_t)(RFX_SCRATCH_ALIGNMENT - 1))
+
+typedef struct S_RFX_SCRATCH_ARENA RFX_SCRATCH_ARENA;
+
+struct S_RFX_SCRATCH_ARENA
+{
+	DWORD threadId;
+	UINT64 uses;
+	BYTE* data;
+	RFX_SCRATCH_ARENA* next;
+};
+
+struct S_RFX_SCRATCH_POOL
+{
+	size_t count;
+	RFX_SCRATCH_ARENA* volatile arenas;
+	CRITICAL_SECTION lock;
+	UINT32 numArenas;
+	UINT32 contended;
+};
+
+RFX_SCRATCH_POOL* rfx_scratch_pool_new(size_t count)
+{
+	RFX_SCRATCH_POOL* pool;
+
+	if (count == 0)
+		return NULL;
+
+	pool = (RFX_SCRATCH_POOL*)calloc(1, sizeof(RFX_SCRATCH_POOL));
+
+	if (!pool)
+		return NULL;
+
+	pool->count = count;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->lock, 4000))
+	{
+		free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void rfx_scratch_pool_free(RFX_SCRATCH_POOL* pool)
+{
+	RFX_SCRATCH_ARENA* arena;
+
+	if (!pool)
+		return;
+
+	arena = pool->arenas;
+
+	while (arena)
+	{
+		RFX_SCRATCH_ARENA* next = arena->next;
+		_aligned_free(arena->data);
+		_aligned_free(arena);
+		arena = next;
+	}
+
+	DeleteCriticalSection(&pool->lock);
+	free(pool);
+}
+
+static RFX_SCRATCH_ARENA* rfx_scratch_arena_new(RFX_SCRATCH_POOL* pool, DWORD threadId)
+{
+	/* pad the header to a full line, the use counter is written on every call */
+	const size_t size = (sizeof(RFX_SCRATCH_ARENA) + RFX_SCRATCH_ALIGNMENT - 1) &
+	                    ~(size_t)(RFX_SCRATCH_ALIGNMENT - 1);
+	RFX_SCRATCH_ARENA* arena = (RFX_SCRATCH_ARENA*)_aligned_malloc(size, RFX_SCRATCH_ALIGNMENT);
+
+	if (!arena)
+		return NULL;
+
+	arena->threadId = threadId;
+	arena->uses = 0;
+	arena->data = (BYTE*)_aligned_malloc(pool->count * RFX_SCRATCH_STRIDE,
+	                                          RFX_SCRATCH_ALIGNMENT);
+
+	if (!arena->data)
+	{
+		_aligned_free(arena);
+		return NULL;
+	}
+
+	/* only readers of the arena list run concurrently, publish the arena once it is complete */
+	if (!TryEnterCriticalSection(&pool->lock))
+	{
+		InterlockedIncrement((LONG*)&pool->contended);
+		EnterCriticalSection(&pool->lock);
+	}
+
+	arena->next = pool->arenas;
+	InterlockedCompareExchangePointer((PVOID volatile*)&pool->arenas, arena, arena->next);
+	pool->numArenas++;
+	LeaveCriticalSection(&pool->lock);
+	return arena;
+}
+
+BYTE* rfx_scratch_get(RFX_SCRATCH_POOL* pool, size_t index)
+{
+	DWORD threadId;
+	RFX_SCRATCH_ARENA* arena;
+
+	if (!pool || (index >= pool->count))
+		return NULL;
+
+	threadId = GetCurrentThreadId();
+	arena = (RFX_SCRATCH_ARENA*)InterlockedCompareExchangePointer(
+	    (PVOID volatile*)&pool->arenas, NULL, NULL);
+
+	while (arena && (arena->threadId != threadId))
+		arena = arena->next;
+
+	if (!arena)
+	{
+		arena = rfx_scratch_arena_new(pool, threadId);
+
+		if (!arena)
+			return NULL;
+	}
+
+	arena->uses++;
+	return &arena->data[index * RFX_SCRATCH_STRIDE];
+}
+
+void rfx_scratch_pool_stats(RFX_SCRATCH_POOL* pool, UINT32* arenas, UINT64* uses,
+                            UINT32* contended)
+{
+	UINT64 total = 0;
+	RFX_SCRATCH_ARENA* arena;
+
+	if (!pool)
+		return;
+
+	EnterCriticalSection(&pool->lock);
+
+	for (arena = pool->arenas; arena; arena = arena->next)
+		total += arena->uses;
+
+	if (arenas)
+		*arenas = pool->numArenas;
+
+	if (contended)
+		*contended = pool->contended;
+
+	LeaveCriticalSection(&pool->lock);
+
+	if (uses)
+		*uses = total;
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - Per Thread Scratch Buffers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_RFX_SCRATCH_H
+#define FREERDP_LIB_CODEC_RFX_SCRATCH_H
+
+#include <winpr/wtypes.h>
+#include <freerdp/api.h>
+
+/* Size of a single scratch buffer: three 64x64 INT16 planes with 16 bytes of slack around each */
+#define RFX_SCRATCH_BUFFER_SIZE ((8192 + 32) * 3)
+
+typedef struct S_RFX_SCRATCH_POOL RFX_SCRATCH_POOL;
+
+/**
+ * Every thread using the pool gets its own arena of count buffers, allocated on first use and
+ * kept until the pool is freed. The lock is only taken to register a new arena, buffers are
+ * addressed by index, nested users (tile and DWT) have to use different indices.
+ */
+FREERDP_LOCAL RFX_SCRATCH_POOL* rfx_scratch_pool_new(size_t count);
+FREERDP_LOCAL void rfx_scratch_pool_free(RFX_SCRATCH_POOL* pool);
+
+FREERDP_LOCAL BYTE* rfx_scratch_get(RFX_SCRATCH_POOL* pool, size_t index);
+
+FREERDP_LOCAL void rfx_scratch_pool_stats(RFX_SCRATCH_POOL* pool, UINT32* arenas, UINT64* uses,
+                                          UINT32* contended);
+
+#endif /* FREERDP_LIB_CODEC_RFX_SCRATCH_H */
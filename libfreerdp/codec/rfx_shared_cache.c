@@ -0,0 +1,340 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - Process Wide Tile Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include "rfx_shared_cache.h"
+
+#define RFX_SHARED_CACHE_BUCKETS 4096
+
+typedef struct S_RFX_SHARED_TILE RFX_SHARED_TILE;
+
+struct S_RFX_SHARED_TILE
+{
+	UINT64 hash;
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	RLGR_MODE mode;
+	UINT32 quantVals[3 * 10];
+	UINT16 YLen;
+	UINT16 CbLen;
+	UINT16 CrLen;
+	size_t size;
+	BYTE* pixels; /* width * height pixels without padding */
+	BYTE* data;   /* YData, CbData and CrData */
+	RFX_SHARED_TILE* next;
+	RFX_SHARED_TILE* lruPrev;
+	RFX_SHARED_TILE* lruNext;
+};
+
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	RFX_SHARED_TILE* buckets[RFX_SHARED_CACHE_BUCKETS];
+	RFX_SHARED_TILE* lruHead; /* most recently used tile */
+	RFX_SHARED_TILE* lruTail; /* least recently used tile */
+	size_t bytes;
+	size_t limit;
+	UINT64 hits;
+	UINT64 misses;
+} RFX_SHARED_CACHE;
+
+static RFX_SHARED_CACHE rfx_shared_cache = { 0 };
+static INIT_ONCE rfx_shared_cache_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK rfx_shared_cache_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	if (!InitializeCriticalSectionAndSpinCount(&rfx_shared_cache.lock, 4000))
+		return FALSE;
+
+	rfx_shared_cache.limit = RFX_SHARED_CACHE_DEFAULT_LIMIT;
+	return TRUE;
+}
+
+static RFX_SHARED_CACHE* rfx_shared_cache_get(void)
+{
+	if (!InitOnceExecuteOnce(&rfx_shared_cache_once, rfx_shared_cache_init, NULL, NULL))
+		return NULL;
+
+	return &rfx_shared_cache;
+}
+
+static INLINE UINT64 rfx_shared_cache_mix(UINT64 hash, UINT64 value)
+{
+	hash ^= value;
+	hash *= 0x9E3779B97F4A7C15ull;
+	return hash ^ (hash >> 29);
+}
+
+static UINT64 rfx_shared_cache_hash(const RFX_TILE* tile, size_t bpp, const UINT32* quantVals)
+{
+	size_t x;
+	UINT32 y;
+	const size_t rowSize = tile->width * bpp;
+	UINT64 hash = ((UINT64)tile->width << 32) | tile->height;
+
+	for (x = 0; x < 3 * 10; x++)
+		hash = rfx_shared_cache_mix(hash, quantVals[x]);
+
+	for (y = 0; y < tile->height; y++)
+	{
+		const BYTE* row = &tile->data[y * tile->scanline];
+
+		for (x = 0; x + 8 <= rowSize; x += 8)
+		{
+			UINT64 value;
+			memcpy(&value, &row[x], sizeof(value));
+			hash = rfx_shared_cache_mix(hash, value);
+		}
+
+		for (; x < rowSize; x++)
+			hash = rfx_shared_cache_mix(hash, row[x]);
+	}
+
+	return hash;
+}
+
+static void rfx_shared_cache_get_quant_vals(RFX_CONTEXT* context, const RFX_TILE* tile,
+                                            UINT32* quantVals)
+{
+	CopyMemory(&quantVals[0], &context->quants[tile->quantIdxY * 10], 10 * sizeof(UINT32));
+	CopyMemory(&quantVals[10], &context->quants[tile->quantIdxCb * 10], 10 * sizeof(UINT32));
+	CopyMemory(&quantVals[20], &context->quants[tile->quantIdxCr * 10], 10 * sizeof(UINT32));
+}
+
+static BOOL rfx_shared_cache_equals(const RFX_SHARED_TILE* entry, RFX_CONTEXT* context,
+                                    const RFX_TILE* tile, UINT64 hash, size_t bpp,
+                                    const UINT32* quantVals)
+{
+	UINT32 y;
+	const size_t rowSize = tile->width * bpp;
+
+	if ((entry->hash != hash) || (entry->width != tile->width) ||
+	    (entry->height != tile->height) || (entry->format != context->pixel_format) ||
+	    (entry->mode != context->mode))
+		return FALSE;
+
+	if (memcmp(entry->quantVals, quantVals, sizeof(entry->quantVals)) != 0)
+		return FALSE;
+
+	for (y = 0; y < tile->height; y++)
+	{
+		if (memcmp(&entry->pixels[y * rowSize], &tile->data[y * tile->scanline], rowSize) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void rfx_shared_cache_lru_unlink(RFX_SHARED_CACHE* cache, RFX_SHARED_TILE* entry)
+{
+	if (entry->lruPrev)
+		entry->lruPrev->lruNext = entry->lruNext;
+	else
+		cache->lruHead = entry->lruNext;
+
+	if (entry->lruNext)
+		entry->lruNext->lruPrev = entry->lruPrev;
+	else
+		cache->lruTail = entry->lruPrev;
+}
+
+static void rfx_shared_cache_lru_push(RFX_SHARED_CACHE* cache, RFX_SHARED_TILE* entry)
+{
+	entry->lruPrev = NULL;
+	entry->lruNext = cache->lruHead;
+
+	if (cache->lruHead)
+		cache->lruHead->lruPrev = entry;
+	else
+		cache->lruTail = entry;
+
+	cache->lruHead = entry;
+}
+
+static void rfx_shared_cache_remove(RFX_SHARED_CACHE* cache, RFX_SHARED_TILE* entry)
+{
+	RFX_SHARED_TILE** link = &cache->buckets[entry->hash % RFX_SHARED_CACHE_BUCKETS];
+
+	while (*link != entry)
+		link = &(*link)->next;
+
+	*link = entry->next;
+	rfx_shared_cache_lru_unlink(cache, entry);
+	cache->bytes -= entry->size;
+	free(entry);
+}
+
+/* called with the lock held */
+static void rfx_shared_cache_evict(RFX_SHARED_CACHE* cache)
+{
+	while (cache->lruTail && (cache->bytes > cache->limit))
+		rfx_shared_cache_remove(cache, cache->lruTail);
+}
+
+BOOL rfx_shared_cache_lookup(RFX_CONTEXT* context, RFX_TILE* tile)
+{
+	BOOL found = FALSE;
+	UINT64 hash;
+	UINT32 quantVals[3 * 10];
+	RFX_SHARED_TILE* entry;
+	const size_t bpp = context->bits_per_pixel / 8;
+	RFX_SHARED_CACHE* cache = rfx_shared_cache_get();
+
+	if (!cache)
+		return FALSE;
+
+	rfx_shared_cache_get_quant_vals(context, tile, quantVals);
+	hash = rfx_shared_cache_hash(tile, bpp, quantVals);
+	EnterCriticalSection(&cache->lock);
+
+	for (entry = cache->buckets[hash % RFX_SHARED_CACHE_BUCKETS]; entry; entry = entry->next)
+	{
+		if (!rfx_shared_cache_equals(entry, context, tile, hash, bpp, quantVals))
+			continue;
+
+		CopyMemory(tile->YData, entry->data, entry->YLen);
+		CopyMemory(tile->CbData, &entry->data[entry->YLen], entry->CbLen);
+		CopyMemory(tile->CrData, &entry->data[entry->YLen + entry->CbLen], entry->CrLen);
+		tile->YLen = entry->YLen;
+		tile->CbLen = entry->CbLen;
+		tile->CrLen = entry->CrLen;
+		rfx_shared_cache_lru_unlink(cache, entry);
+		rfx_shared_cache_lru_push(cache, entry);
+		found = TRUE;
+		break;
+	}
+
+	if (found)
+		cache->hits++;
+	else
+		cache->misses++;
+
+	LeaveCriticalSection(&cache->lock);
+	return found;
+}
+
+void rfx_shared_cache_store(RFX_CONTEXT* context, const RFX_TILE* tile)
+{
+	UINT32 y;
+	RFX_SHARED_TILE* entry;
+	RFX_SHARED_TILE* cur;
+	RFX_SHARED_TILE** bucket;
+	const size_t bpp = context->bits_per_pixel / 8;
+	const size_t rowSize = tile->width * bpp;
+	const size_t pixelSize = rowSize * tile->height;
+	const size_t dataSize = (size_t)tile->YLen + tile->CbLen + tile->CrLen;
+	const size_t size = sizeof(RFX_SHARED_TILE) + pixelSize + dataSize;
+	RFX_SHARED_CACHE* cache = rfx_shared_cache_get();
+
+	if (!cache || !tile->YLen || !tile->CbLen || !tile->CrLen)
+		return;
+
+	/* racy read, the limit is checked again below */
+	if (size > cache->limit)
+		return;
+
+	entry = (RFX_SHARED_TILE*)calloc(1, size);
+
+	if (!entry)
+		return;
+
+	entry->pixels = (BYTE*)&entry[1];
+	entry->data = &entry->pixels[pixelSize];
+	entry->size = size;
+	entry->width = tile->width;
+	entry->height = tile->height;
+	entry->format = context->pixel_format;
+	entry->mode = context->mode;
+	entry->YLen = tile->YLen;
+	entry->CbLen = tile->CbLen;
+	entry->CrLen = tile->CrLen;
+	rfx_shared_cache_get_quant_vals(context, tile, entry->quantVals);
+	entry->hash = rfx_shared_cache_hash(tile, bpp, entry->quantVals);
+
+	for (y = 0; y < tile->height; y++)
+		CopyMemory(&entry->pixels[y * rowSize], &tile->data[y * tile->scanline], rowSize);
+
+	CopyMemory(entry->data, tile->YData, tile->YLen);
+	CopyMemory(&entry->data[tile->YLen], tile->CbData, tile->CbLen);
+	CopyMemory(&entry->data[tile->YLen + tile->CbLen], tile->CrData, tile->CrLen);
+
+	EnterCriticalSection(&cache->lock);
+	bucket = &cache->buckets[entry->hash % RFX_SHARED_CACHE_BUCKETS];
+
+	/* another session may have encoded the same tile in the meantime */
+	for (cur = *bucket; cur; cur = cur->next)
+	{
+		if (rfx_shared_cache_equals(cur, context, tile, entry->hash, bpp, entry->quantVals))
+			break;
+	}
+
+	if (cur || (size > cache->limit))
+		free(entry);
+	else
+	{
+		entry->next = *bucket;
+		*bucket = entry;
+		rfx_shared_cache_lru_push(cache, entry);
+		cache->bytes += size;
+		rfx_shared_cache_evict(cache);
+	}
+
+	LeaveCriticalSection(&cache->lock);
+}
+
+void rfx_shared_tile_cache_set_limit(size_t bytes)
+{
+	RFX_SHARED_CACHE* cache = rfx_shared_cache_get();
+
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	cache->limit = bytes;
+	rfx_shared_cache_evict(cache);
+	LeaveCriticalSection(&cache->lock);
+}
+
+void rfx_shared_tile_cache_get_stats(size_t* bytes, UINT64* hits, UINT64* misses)
+{
+	RFX_SHARED_CACHE* cache = rfx_shared_cache_get();
+
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+
+	if (bytes)
+		*bytes = cache->bytes;
+
+	if (hits)
+		*hits = cache->hits;
+
+	if (misses)
+		*misses = cache->misses;
+
+	LeaveCriticalSection(&cache->lock);
+}
@@ -0,0 +1,34 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - Process Wide Tile Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_RFX_SHARED_CACHE_H
+#define FREERDP_LIB_CODEC_RFX_SHARED_CACHE_H
+
+#include "rfx_types.h"
+
+/* Default memory limit of the shared tile cache */
+#define RFX_SHARED_CACHE_DEFAULT_LIMIT (64ull * 1024ull * 1024ull)
+
+/**
+ * Encoded tiles of all encoder contexts that enabled sharing, addressed by a hash of the
+ * pixels, the pixel format, the entropy mode and the quantization values. Hits compare the
+ * pixels, a hash collision never returns data of another tile.
+ */
+FREERDP_LOCAL BOOL rfx_shared_cache_lookup(RFX_CONTEXT* context, RFX_TILE* tile);
+FREERDP_LOCAL void rfx_shared_cache_store(RFX_CONTEXT* context, const RFX_TILE* tile);
+
+#endif /* FREERDP_LIB_CODEC_RFX_SHARED_CACHE_H */
@@ -30,6 +30,7 @@
 
 #include "rfx_types.h"
 #include "rfx_sse2.h"
+#include "rfx_quantization.h"
 
 #ifdef _MSC_VER
 #define __attribute__(...)
@@ -137,7 +138,8 @@ static void rfx_quantization_encode_sse2(INT16* buffer, const UINT32* quantizati
 }
 
 static __inline void __attribute__((ATTRIBUTES))
-rfx_dwt_2d_decode_block_horiz_sse2(INT16* l, INT16* h, INT16* dst, int subband_width)
+rfx_dwt_2d_decode_block_horiz_sse2(INT16* l, INT16* h, INT16* dst, int subband_width,
+                                   UINT32 lshift, UINT32 hshift)
 {
 	int y, n;
 	INT16* l_ptr = l;
@@ -145,6 +147,10 @@ rfx_dwt_2d_decode_block_horiz_sse2(INT16* l, INT16* h, INT16* dst, int subband_w
 	INT16* dst_ptr = dst;
 	int first;
 	int last;
+	/* the dequantization of both sub-bands is done as they are loaded */
+	const __m128i l_count = _mm_cvtsi32_si128((int)lshift);
+	const __m128i h_count = _mm_cvtsi32_si128((int)hshift);
+	const __m128i h_count_odd = _mm_cvtsi32_si128((int)hshift + 1);
 	__m128i l_n;
 	__m128i h_n;
 	__m128i h_n_m;
@@ -160,9 +166,9 @@ rfx_dwt_2d_decode_block_horiz_sse2(INT16* l, INT16* h, INT16* dst, int subband_w
 		for (n = 0; n < subband_width; n += 8)
 		{
 			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
-			l_n = _mm_load_si128((__m128i*)l_ptr);
-			h_n = _mm_load_si128((__m128i*)h_ptr);
-			h_n_m = _mm_loadu_si128((__m128i*)(h_ptr - 1));
+			l_n = _mm_sll_epi16(_mm_load_si128((__m128i*)l_ptr), l_count);
+			h_n = _mm_sll_epi16(_mm_load_si128((__m128i*)h_ptr), h_count);
+			h_n_m = _mm_sll_epi16(_mm_loadu_si128((__m128i*)(h_ptr - 1)), h_count);
 
 			if (n == 0)
 			{
@@ -187,7 +193,7 @@ rfx_dwt_2d_decode_block_horiz_sse2(INT16* l, INT16* h, INT16* dst, int subband_w
 		{
 			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
 			h_n = _mm_load_si128((__m128i*)h_ptr);
-			h_n = _mm_slli_epi16(h_n, 1);
+			h_n = _mm_sll_epi16(h_n, h_count_odd);
 			dst_n = _mm_load_si128((__m128i*)(l_ptr));
 			dst_n_p = _mm_loadu_si128((__m128i*)(l_ptr + 1));
 
@@ -290,7 +296,8 @@ rfx_dwt_2d_decode_block_vert_sse2(INT16* l, INT16* h, INT16* dst, int subband_wi
 }
 
 static __inline void __attribute__((ATTRIBUTES))
-rfx_dwt_2d_decode_block_sse2(INT16* buffer, INT16* idwt, int subband_width)
+rfx_dwt_2d_decode_block_sse2(INT16* buffer, INT16* idwt, int subband_width,
+                             const UINT32 factors[4])
 {
 	INT16 *hl, *lh, *hh, *ll;
 	INT16 *l_dst, *h_dst;
@@ -303,21 +310,37 @@ rfx_dwt_2d_decode_block_sse2(INT16* buffer, INT16* idwt, int subband_width)
 	ll = buffer + subband_width * subband_width * 3;
 	hl = buffer;
 	l_dst = idwt;
-	rfx_dwt_2d_decode_block_horiz_sse2(ll, hl, l_dst, subband_width);
+	rfx_dwt_2d_decode_block_horiz_sse2(ll, hl, l_dst, subband_width, factors[3], factors[0]);
 	lh = buffer + subband_width * subband_width;
 	hh = buffer + subband_width * subband_width * 2;
 	h_dst = idwt + subband_width * subband_width * 2;
-	rfx_dwt_2d_decode_block_horiz_sse2(lh, hh, h_dst, subband_width);
+	rfx_dwt_2d_decode_block_horiz_sse2(lh, hh, h_dst, subband_width, factors[1], factors[2]);
 	/* Inverse DWT in vertical direction, results are stored in original buffer. */
 	rfx_dwt_2d_decode_block_vert_sse2(l_dst, h_dst, buffer, subband_width);
 }
 
 static void rfx_dwt_2d_decode_sse2(INT16* buffer, INT16* dwt_buffer)
 {
+	static const UINT32 none[4] = { 0 };
+
+	_mm_prefetch_buffer((char*)buffer, 4096 * sizeof(INT16));
+	rfx_dwt_2d_decode_block_sse2(&buffer[3840], dwt_buffer, 8, none);
+	rfx_dwt_2d_decode_block_sse2(&buffer[3072], dwt_buffer, 16, none);
+	rfx_dwt_2d_decode_block_sse2(&buffer[0], dwt_buffer, 32, none);
+}
+
+static void rfx_quantization_dwt_2d_decode_sse2(INT16* buffer, INT16* dwt_buffer,
+                                                const UINT32* quantization_values)
+{
+	UINT32 factors[4];
+
 	_mm_prefetch_buffer((char*)buffer, 4096 * sizeof(INT16));
-	rfx_dwt_2d_decode_block_sse2(&buffer[3840], dwt_buffer, 8);
-	rfx_dwt_2d_decode_block_sse2(&buffer[3072], dwt_buffer, 16);
-	rfx_dwt_2d_decode_block_sse2(&buffer[0], dwt_buffer, 32);
+	rfx_quantization_level_factors(quantization_values, 3, factors);
+	rfx_dwt_2d_decode_block_sse2(&buffer[3840], dwt_buffer, 8, factors);
+	rfx_quantization_level_factors(quantization_values, 2, factors);
+	rfx_dwt_2d_decode_block_sse2(&buffer[3072], dwt_buffer, 16, factors);
+	rfx_quantization_level_factors(quantization_values, 1, factors);
+	rfx_dwt_2d_decode_block_sse2(&buffer[0], dwt_buffer, 32, factors);
 }
 
 static __inline void __attribute__((ATTRIBUTES))
@@ -465,5 +488,6 @@ void rfx_init_sse2(RFX_CONTEXT* context)
 	context->quantization_decode = rfx_quantization_decode_sse2;
 	context->quantization_encode = rfx_quantization_encode_sse2;
 	context->dwt_2d_decode = rfx_dwt_2d_decode_sse2;
+	context->quantization_dwt_2d_decode = rfx_quantization_dwt_2d_decode_sse2;
 	context->dwt_2d_encode = rfx_dwt_2d_encode_sse2;
 }
@@ -29,8 +29,16 @@
 
 #include <freerdp/log.h>
 #include <freerdp/utils/profiler.h>
+#include <freerdp/codec/rfx.h>
+
+#include "rfx_scratch.h"
 
 #define RFX_TAG FREERDP_TAG("codec.rfx")
+
+/* Scratch buffer indices, rfx_encode/decode_component run nested in rfx_encode/decode_rgb */
+#define RFX_SCRATCH_TILE 0
+#define RFX_SCRATCH_DWT 1
+#define RFX_SCRATCH_COUNT 2
 #ifdef WITH_DEBUG_RFX
 #define DEBUG_RFX(...) WLog_DBG(RFX_TAG, __VA_ARGS__)
 #else
@@ -42,6 +50,35 @@
 
 typedef struct S_RFX_TILE_COMPOSE_WORK_PARAM RFX_TILE_COMPOSE_WORK_PARAM;
 
+/* Last encoded state of a tile grid position, used to skip encoding unchanged tiles */
+typedef struct
+{
+	BOOL valid;
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	RLGR_MODE mode;
+	UINT32 quantVals[3 * 10];
+	BYTE* pixels;
+	BYTE* data;
+	size_t dataSize;
+	UINT16 YLen;
+	UINT16 CbLen;
+	UINT16 CrLen;
+} RFX_TILE_CACHE_ENTRY;
+
+/* Destination of the message being decoded by rfx_process_message */
+typedef struct
+{
+	BYTE* data;
+	UINT32 format;
+	UINT32 stride;
+	UINT32 width;
+	UINT32 height;
+	UINT32 left;
+	UINT32 top;
+} RFX_DECODE_TARGET;
+
 struct S_RFX_CONTEXT_PRIV
 {
 	wLog* log;
@@ -58,6 +95,28 @@ struct S_RFX_CONTEXT_PRIV
 	TP_CALLBACK_ENVIRON ThreadPoolEnv;
 
 	wBufferPool* BufferPool;
+	RFX_SCRATCH_POOL* ScratchPool;
+
+	BOOL TileCacheEnabled;
+	RFX_TILE_CACHE_ENTRY* TileCache;
+	UINT32 TileCacheColumns;
+	UINT32 TileCacheRows;
+	UINT64 TilesEncoded;
+	UINT64 TilesSkipped;
+
+	/* share encoded tiles with the other contexts of the process, see rfx_shared_cache.h */
+	BOOL SharedTileCache;
+	BOOL SharedTileCacheActive;
+
+	/* tiles fully inside the clipping region are decoded straight into the target */
+	RFX_DECODE_TARGET DecodeTarget;
+	BOOL* DirectTiles;
+	UINT32 DirectTilesSize;
+
+	/* coefficients and quantization values of a message for RFXDecodeTiles_16s8u */
+	INT16* BatchCoefficients;
+	UINT32* BatchQuants;
+	UINT32 BatchSize;
 
 	/* profilers */
 	PROFILER_DEFINE(prof_rfx_decode_rgb)
@@ -71,6 +71,134 @@ fail:
 	return rc;
 }
 
+static void test_ClearFillImage(BYTE* data, UINT32 width, UINT32 height, BOOL photo)
+{
+	UINT32 x, y;
+	UINT32 seed = width ^ (height << 16);
+
+	/* white background with text-like glyphs, a frame and optionally a noisy image */
+	for (y = 0; y < height; y++)
+	{
+		UINT32* row = (UINT32*)&data[y * width * 4];
+
+		for (x = 0; x < width; x++)
+		{
+			UINT32 color = 0xFFFFFFFF;
+			seed = seed * 1103515245 + 12345;
+
+			if ((x == 0) || (y == 0) || (x == width - 1) || (y == height - 1))
+				color = 0xFF0078D7;
+			else if (((y % 12) > 2) && ((y % 12) < 10) && ((x % 7) < 4) && ((x / 7) % 3))
+				color = ((x % 7) == 3) ? 0xFF808080 : 0xFF000000;
+			else if (photo && (x > width / 2) && (y > height / 2))
+				color = 0xFF000000 | (seed >> 8);
+
+			row[x] = color;
+		}
+	}
+}
+
+static BOOL test_ClearRoundtrip(CLEAR_CONTEXT* encoder, CLEAR_CONTEXT* decoder,
+                                const BYTE* pSrcData, UINT32 width, UINT32 height, BOOL exact,
+                                UINT32* pDstSize)
+{
+	BOOL rc = FALSE;
+	int status;
+	BYTE* pCompressedData = NULL;
+	UINT32 CompressedSize = 0;
+	BYTE* pDstData = calloc(width * height, 4);
+
+	if (!pDstData)
+		goto fail;
+
+	status = clear_compress(encoder, pSrcData, PIXEL_FORMAT_BGRX32, width * 4, width, height,
+	                        &pCompressedData, &CompressedSize);
+
+	if (status < 0)
+		goto fail;
+
+	status = clear_decompress(decoder, pCompressedData, CompressedSize, width, height, pDstData,
+	                          PIXEL_FORMAT_BGRX32, width * 4, 0, 0, width, height, NULL);
+
+	if (status != 0)
+		goto fail;
+
+	if (exact && (memcmp(pSrcData, pDstData, width * height * 4) != 0))
+		goto fail;
+
+	if (pDstSize)
+		*pDstSize = CompressedSize;
+
+	rc = TRUE;
+fail:
+	free(pDstData);
+	return rc;
+}
+
+static BOOL test_ClearCompress(void)
+{
+	BOOL rc = FALSE;
+	UINT32 i;
+	UINT32 size = 0;
+	const UINT32 width = 213;
+	const UINT32 height = 97;
+	BYTE* pSrcData = calloc(width * height, 4);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+
+	if (!pSrcData || !encoder || !decoder)
+		goto fail;
+
+	test_ClearFillImage(pSrcData, width, height, FALSE);
+
+	/* the second pass must be served from the vBar caches */
+	for (i = 0; i < 2; i++)
+	{
+		UINT32 DstSize = 0;
+
+		if (!test_ClearRoundtrip(encoder, decoder, pSrcData, width, height, TRUE, &DstSize))
+			goto fail;
+
+		printf("clear_compress %" PRIu32 "x%" PRIu32 " pass %" PRIu32 ": %" PRIu32 " bytes\n",
+		       width, height, i, DstSize);
+
+		if ((i > 0) && (DstSize >= size))
+			goto fail;
+
+		size = DstSize;
+	}
+
+	/* lossy NSCodec subcodec areas */
+	test_ClearFillImage(pSrcData, width, height, TRUE);
+
+	if (!test_ClearRoundtrip(encoder, decoder, pSrcData, width, height, FALSE, NULL))
+		goto fail;
+
+	/* small sizes and glyph cache hits */
+	for (i = 1; i <= 32; i += 3)
+	{
+		UINT32 DstSize = 0;
+		test_ClearFillImage(pSrcData, i, i + 1, FALSE);
+
+		if (!test_ClearRoundtrip(encoder, decoder, pSrcData, i, i + 1, TRUE, NULL))
+			goto fail;
+
+		if (!test_ClearRoundtrip(encoder, decoder, pSrcData, i, i + 1, TRUE, &DstSize))
+			goto fail;
+
+		if (DstSize != 4)
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	printf("clear_compress roundtrip: %s\n", rc ? "success" : "failure");
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(pSrcData);
+	return rc;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -90,5 +218,8 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 	if (!test_ClearDecompressExample(4, 7, 15, TEST_CLEAR_EXAMPLE_4, sizeof(TEST_CLEAR_EXAMPLE_4)))
 		return -1;
 
+	if (!test_ClearCompress())
+		return -1;
+
 	return 0;
 }
@@ -0,0 +1,299 @@
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/color.h>
+
+#define COPY_WIDTH 1200
+#define COPY_HEIGHT 1000
+
+typedef struct
+{
+	DWORD SrcFormat;
+	DWORD DstFormat;
+	UINT32 flags;
+} copy_test_case;
+
+/* The banded copy has to produce the same image as the single threaded one */
+static BOOL test_image_copy_parallel(void)
+{
+	const copy_test_case cases[] = {
+		{ PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRX32, FREERDP_FLIP_NONE },
+		{ PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32, FREERDP_FLIP_VERTICAL },
+		{ PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGBX32, FREERDP_FLIP_NONE },
+		{ PIXEL_FORMAT_RGB16, PIXEL_FORMAT_BGRA32, FREERDP_FLIP_NONE },
+	};
+	const UINT32 srcStep = COPY_WIDTH * 4 + 64;
+	const UINT32 dstStep = COPY_WIDTH * 4 + 20;
+	const size_t srcSize = (size_t)srcStep * COPY_HEIGHT;
+	const size_t dstSize = (size_t)dstStep * COPY_HEIGHT;
+	const size_t threshold = freerdp_image_copy_get_parallel_threshold();
+	BOOL rc = FALSE;
+	size_t x;
+	BYTE* src = malloc(srcSize);
+	BYTE* dst1 = malloc(dstSize);
+	BYTE* dst2 = malloc(dstSize);
+
+	if (!src || !dst1 || !dst2)
+		goto fail;
+
+	winpr_RAND(src, srcSize);
+
+	for (x = 0; x < ARRAYSIZE(cases); x++)
+	{
+		const copy_test_case* cur = &cases[x];
+		/* odd offsets, the rows do not start aligned. A vertical flip reads the lines
+		 * upwards from nHeight - 1, it takes no source line offset. */
+		const UINT32 nXSrc = 3;
+		const UINT32 nYSrc = (cur->flags & FREERDP_FLIP_VERTICAL) ? 0 : 5;
+		const UINT32 nXDst = 7;
+		const UINT32 nYDst = 2;
+		const UINT32 nWidth = COPY_WIDTH - 13;
+		const UINT32 nHeight = COPY_HEIGHT - 9;
+
+		memset(dst1, 0xA5, dstSize);
+		memset(dst2, 0xA5, dstSize);
+
+		freerdp_image_copy_set_parallel_threshold(0);
+		if (!freerdp_image_copy(dst1, cur->DstFormat, dstStep, nXDst, nYDst, nWidth, nHeight, src,
+		                        cur->SrcFormat, srcStep, nXSrc, nYSrc, NULL, cur->flags))
+			goto fail;
+
+		freerdp_image_copy_set_parallel_threshold(1);
+		if (!freerdp_image_copy(dst2, cur->DstFormat, dstStep, nXDst, nYDst, nWidth, nHeight, src,
+		                        cur->SrcFormat, srcStep, nXSrc, nYSrc, NULL, cur->flags))
+			goto fail;
+
+		if (memcmp(dst1, dst2, dstSize) != 0)
+		{
+			printf("parallel copy %s -> %s mismatch\n", FreeRDPGetColorFormatName(cur->SrcFormat),
+			       FreeRDPGetColorFormatName(cur->DstFormat));
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	freerdp_image_copy_set_parallel_threshold(threshold);
+	free(src);
+	free(dst1);
+	free(dst2);
+	return rc;
+}
+
+/* Overlapping copies stay on the ordered path */
+static BOOL test_image_copy_overlap(void)
+{
+	const UINT32 step = COPY_WIDTH * 4;
+	const size_t size = (size_t)step * COPY_HEIGHT;
+	const size_t threshold = freerdp_image_copy_get_parallel_threshold();
+	BOOL rc = FALSE;
+	BYTE* image = malloc(size);
+	BYTE* expected = malloc(size);
+
+	if (!image || !expected)
+		goto fail;
+
+	winpr_RAND(image, size);
+	memcpy(expected, image, size);
+	memmove(expected, &expected[step * 10], size - step * 10);
+
+	freerdp_image_copy_set_parallel_threshold(1);
+	if (!freerdp_image_copy(image, PIXEL_FORMAT_BGRX32, step, 0, 0, COPY_WIDTH, COPY_HEIGHT - 10,
+	                        image, PIXEL_FORMAT_BGRX32, step, 0, 10, NULL, FREERDP_FLIP_NONE))
+		goto fail;
+
+	if (memcmp(image, expected, size) != 0)
+	{
+		printf("overlapping copy mismatch\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	freerdp_image_copy_set_parallel_threshold(threshold);
+	free(image);
+	free(expected);
+	return rc;
+}
+
+/* The per format converters have to match FreeRDPConvertColor for every pixel */
+static BOOL test_image_copy_convert(void)
+{
+	const DWORD srcFormats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
+		                         PIXEL_FORMAT_XBGR32, PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32,
+		                         PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGB24,
+		                         PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_RGB16 };
+	const DWORD dstFormats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
+		                         PIXEL_FORMAT_XBGR32, PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32,
+		                         PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGB24,
+		                         PIXEL_FORMAT_BGR24 };
+	const UINT32 widths[] = { 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33, 67 };
+	const UINT32 height = 3;
+	const UINT32 step = 80 * 4;
+	BOOL rc = FALSE;
+	size_t i, j, k;
+	BYTE* src = malloc(step * height);
+	BYTE* dst1 = malloc(step * height);
+	BYTE* dst2 = malloc(step * height);
+
+	if (!src || !dst1 || !dst2)
+		goto fail;
+
+	winpr_RAND(src, step * height);
+
+	for (i = 0; i < ARRAYSIZE(srcFormats); i++)
+	{
+		for (j = 0; j < ARRAYSIZE(dstFormats); j++)
+		{
+			const DWORD SrcFormat = srcFormats[i];
+			const DWORD DstFormat = dstFormats[j];
+			const UINT32 srcByte = GetBytesPerPixel(SrcFormat);
+			const UINT32 dstByte = GetBytesPerPixel(DstFormat);
+
+			/* these are plain copies */
+			if (AreColorFormatsEqualNoAlpha(SrcFormat, DstFormat))
+				continue;
+
+			for (k = 0; k < ARRAYSIZE(widths); k++)
+			{
+				UINT32 x, y;
+				const UINT32 width = widths[k];
+
+				memset(dst1, 0xA5, step * height);
+				memset(dst2, 0xA5, step * height);
+
+				for (y = 0; y < height; y++)
+				{
+					for (x = 0; x < width; x++)
+					{
+						const UINT32 color =
+						    ReadColor(&src[y * step + (x + 1) * srcByte], SrcFormat);
+						WriteColor(&dst1[y * step + (x + 2) * dstByte], DstFormat,
+						           FreeRDPConvertColor(color, SrcFormat, DstFormat, NULL));
+					}
+				}
+
+				if (!freerdp_image_copy(dst2, DstFormat, step, 2, 0, width, height, src,
+				                        SrcFormat, step, 1, 0, NULL, FREERDP_FLIP_NONE))
+					goto fail;
+
+				if (memcmp(dst1, dst2, step * height) != 0)
+				{
+					printf("conversion %s -> %s mismatch for width %" PRIu32 "\n",
+					       FreeRDPGetColorFormatName(SrcFormat),
+					       FreeRDPGetColorFormatName(DstFormat), width);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst1);
+	free(dst2);
+	return rc;
+}
+
+/* 32 bpp pointers are converted a row at a time, the AND mask cases have to match the per
+ * pixel rules */
+static BOOL test_image_copy_pointer(void)
+{
+	const DWORD formats[] = { PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_XRGB32,
+		                      PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGB16 };
+	const UINT32 width = 37;
+	const UINT32 height = 21;
+	const UINT32 xorStep = width * 4;
+	const UINT32 andStep = ((width + 7) / 8 + 1) & ~1u;
+	BOOL rc = FALSE;
+	BYTE* xorMask = malloc(xorStep * height);
+	BYTE* andMask = malloc(andStep * height);
+	BYTE* dst = malloc(width * 4 * height);
+	size_t i;
+	UINT32 x, y;
+
+	if (!xorMask || !andMask || !dst)
+		goto fail;
+
+	winpr_RAND(xorMask, xorStep * height);
+	winpr_RAND(andMask, andStep * height);
+
+	/* plenty of the black and white pixels the AND mask turns transparent and inverted */
+	for (x = 0; x < width * height; x += 3)
+		WriteColor(&xorMask[x * 4], PIXEL_FORMAT_BGRA32, (x % 2) ? 0xFFFFFFFF : 0x000000FF);
+
+	for (i = 0; i < ARRAYSIZE(formats); i++)
+	{
+		const DWORD format = formats[i];
+		const UINT32 bpp = GetBytesPerPixel(format);
+
+		if (!freerdp_image_copy_from_pointer_data(dst, format, 0, 0, 0, width, height, xorMask,
+		                                          xorStep * height, andMask, andStep * height, 32,
+		                                          NULL))
+			goto fail;
+
+		for (y = 0; y < height; y++)
+		{
+			/* the masks are bottom up */
+			const BYTE* xorBits = &xorMask[(height - y - 1) * xorStep];
+			const BYTE* andBits = &andMask[(height - y - 1) * andStep];
+
+			for (x = 0; x < width; x++)
+			{
+				UINT32 color = FreeRDPConvertColor(ReadColor(&xorBits[x * 4], PIXEL_FORMAT_BGRA32),
+				                                   PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_ARGB32, NULL);
+				UINT32 value;
+
+				if (andBits[x / 8] & (0x80 >> (x % 8)))
+				{
+					if (color == 0xFF000000)
+						color = 0;
+					else if (color == 0xFFFFFFFF)
+						color = ((x + y) & 1) ? 0xFF000000 : 0xFFFFFFFF;
+				}
+
+				color = FreeRDPConvertColor(color, PIXEL_FORMAT_ARGB32, format, NULL);
+				value = ReadColor(&dst[(y * width + x) * bpp], format);
+
+				if (value != color)
+				{
+					printf("pointer %s: pixel %" PRIu32 ",%" PRIu32 " is 0x%08" PRIx32
+					       " instead of 0x%08" PRIx32 "\n",
+					       FreeRDPGetColorFormatName(format), x, y, value, color);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(xorMask);
+	free(andMask);
+	free(dst);
+	return rc;
+}
+
+int TestFreeRDPCodecCopy(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_image_copy_parallel())
+		return -1;
+
+	if (!test_image_copy_overlap())
+		return -1;
+
+	if (!test_image_copy_convert())
+		return -1;
+
+	if (!test_image_copy_pointer())
+		return -1;
+
+	return 0;
+}
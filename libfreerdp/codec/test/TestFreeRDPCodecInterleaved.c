@@ -5,6 +5,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
@@ -153,6 +154,141 @@ fail:
 	return rc;
 }
 
+/* Desktop like content: solid areas, gradients, dithering and some noise */
+static void fill_desktop_image(BYTE* data, UINT32 width, UINT32 height, size_t step,
+                               UINT32 format)
+{
+	UINT32 x, y;
+	BYTE noise[4];
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			UINT32 color;
+
+			if (y < 8)
+				color = FreeRDPGetColor(format, 0x10, 0x40, 0xA0, 0xFF);
+			else if (x < 16)
+				color = FreeRDPGetColor(format, (BYTE)(y * 4), (BYTE)(y * 4), 0x80, 0xFF);
+			else if ((y > 40) && (y < 48))
+				color = ((x ^ y) & 1) ? FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF)
+				                      : FreeRDPGetColor(format, 0x00, 0x00, 0x00, 0xFF);
+			else if ((y % 12) == 3)
+			{
+				winpr_RAND(noise, sizeof(noise));
+				color = FreeRDPGetColor(format, noise[0], noise[1], noise[2], 0xFF);
+			}
+			else
+				color = FreeRDPGetColor(format, 0xE0, 0xE0, 0xE0, 0xFF);
+
+			WriteColor(&data[y * step + x * GetBytesPerPixel(format)], format, color);
+		}
+	}
+}
+
+/* Random data only produces copy orders, the run orders need runs and two color patterns */
+static BOOL TestEncodeRuns(BITMAP_INTERLEAVED_CONTEXT* encoder,
+                           BITMAP_INTERLEAVED_CONTEXT* decoder)
+{
+	BOOL rc = FALSE;
+	UINT32 x, y;
+	const UINT32 w = 64;
+	const UINT32 h = 64;
+	const UINT32 format = PIXEL_FORMAT_XRGB32;
+	const size_t step = w * 4;
+	const size_t size = step * h;
+	UINT32 DstSize = (UINT32)size;
+	BYTE* pSrcData = calloc(1, size);
+	BYTE* pDstData = calloc(1, size);
+	BYTE* tmp = calloc(1, size);
+
+	if (!pSrcData || !pDstData || !tmp)
+		goto fail;
+
+	fill_desktop_image(pSrcData, w, h, step, format);
+
+	if (!interleaved_compress(encoder, tmp, &DstSize, w, h, pSrcData, format, step, 0, 0, NULL,
+	                          24))
+		goto fail;
+
+	if (!interleaved_decompress(decoder, tmp, DstSize, w, h, 24, pDstData, format, step, 0, 0, w,
+	                            h, NULL))
+		goto fail;
+
+	for (y = 0; y < h; y++)
+	{
+		for (x = 0; x < w; x++)
+		{
+			const UINT32 srcColor = ReadColor(&pSrcData[y * step + x * 4], format);
+			const UINT32 dstColor = ReadColor(&pDstData[y * step + x * 4], format);
+
+			if ((srcColor & 0xFFFFFF) != (dstColor & 0xFFFFFF))
+			{
+				printf("interleaved run mismatch at %" PRIu32 "x%" PRIu32 ": %08" PRIx32
+				       " != %08" PRIx32 "\n",
+				       x, y, srcColor, dstColor);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(pSrcData);
+	free(pDstData);
+	free(tmp);
+	return rc;
+}
+
+static BOOL TestDecompressBenchmark(UINT16 bpp, BITMAP_INTERLEAVED_CONTEXT* encoder,
+                                    BITMAP_INTERLEAVED_CONTEXT* decoder)
+{
+	BOOL rc = FALSE;
+	UINT32 i;
+	UINT64 start, duration;
+	const UINT32 w = 64;
+	const UINT32 h = 64;
+	const UINT32 iterations = 5000;
+	const UINT32 format = PIXEL_FORMAT_BGRX32;
+	const size_t step = w * 4;
+	const size_t size = step * h;
+	UINT32 DstSize = (UINT32)size;
+	BYTE* pSrcData = calloc(1, size);
+	BYTE* pDstData = calloc(1, size);
+	BYTE* tmp = calloc(1, size);
+
+	if (!pSrcData || !pDstData || !tmp)
+		goto fail;
+
+	fill_desktop_image(pSrcData, w, h, step, format);
+
+	if (!interleaved_compress(encoder, tmp, &DstSize, w, h, pSrcData, format, step, 0, 0, NULL,
+	                          bpp))
+		goto fail;
+
+	start = GetTickCount64();
+
+	for (i = 0; i < iterations; i++)
+	{
+		if (!interleaved_decompress(decoder, tmp, DstSize, w, h, bpp, pDstData, format, step, 0, 0,
+		                            w, h, NULL))
+			goto fail;
+	}
+
+	duration = GetTickCount64() - start;
+	/* throughput of the decoded bitmap in the bitmaps own color depth */
+	printf("interleaved_decompress %2" PRIu16 "bpp: %" PRIu32 " bytes compressed, %.1f MB/s\n",
+	       bpp, DstSize,
+	       (double)w * h * ((bpp + 7) / 8) * iterations / 1000.0 / (double)MAX(duration, 1));
+	rc = TRUE;
+fail:
+	free(pSrcData);
+	free(pDstData);
+	free(tmp);
+	return rc;
+}
+
 static BOOL TestColorConversion(void)
 {
 	const UINT32 formats[] = { PIXEL_FORMAT_RGB15,  PIXEL_FORMAT_BGR15, PIXEL_FORMAT_ABGR15,
@@ -205,6 +341,18 @@ int TestFreeRDPCodecInterleaved(int argc, char* argv[])
 	if (!TestColorConversion())
 		goto fail;
 
+	if (!TestEncodeRuns(encoder, decoder))
+		goto fail;
+
+	if (!TestDecompressBenchmark(24, encoder, decoder))
+		goto fail;
+
+	if (!TestDecompressBenchmark(16, encoder, decoder))
+		goto fail;
+
+	if (!TestDecompressBenchmark(15, encoder, decoder))
+		goto fail;
+
 	rc = 0;
 fail:
 	bitmap_interleaved_context_free(encoder);
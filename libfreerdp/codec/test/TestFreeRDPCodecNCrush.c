@@ -1,8 +1,12 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/codec/ncrush.h>
 
+#define NCRUSH_TEST_PACKET_SIZE 16000
+#define NCRUSH_TEST_PACKETS 64
+
 static const BYTE TEST_BELLS_DATA[] = "for.whom.the.bell.tolls,.the.bell.tolls.for.thee!";
 
 static const BYTE TEST_BELLS_NCRUSH[] =
@@ -113,6 +117,139 @@ fail:
 	return rc;
 }
 
+/* Update like data: repeated records with small changes, text and some noise */
+static void test_NCrushFillData(BYTE* data, size_t size)
+{
+	size_t i = 0;
+	UINT32 seed = 0x5EED;
+	static const char* words[] = { "for", "whom", "the", "bell", "tolls", "thee", "window",
+		                           "surface", "glyph", "cache", "order", "bitmap" };
+
+	while (i < size)
+	{
+		size_t j;
+		const char* word;
+		seed = seed * 1103515245 + 12345;
+		word = words[(seed >> 16) % ARRAYSIZE(words)];
+
+		switch ((seed >> 8) % 4)
+		{
+			case 0:
+				for (j = 0; (word[j] != '\0') && (i < size); j++)
+					data[i++] = (BYTE)word[j];
+				break;
+
+			case 1:
+				/* copy of an earlier record */
+				if (i > 1024)
+				{
+					const size_t length = MIN(((seed >> 4) % 200) + 3, size - i);
+					const size_t distance = ((seed >> 12) % 1000) + 1;
+					for (j = 0; j < length; j++, i++)
+						data[i] = data[i - distance];
+				}
+				break;
+
+			case 2:
+				data[i++] = (BYTE)(seed >> 24);
+				break;
+
+			default:
+				for (j = 0; (j < ((seed >> 20) % 16)) && (i < size); j++)
+					data[i++] = 0;
+				break;
+		}
+	}
+}
+
+static BOOL test_NCrushRoundtrip(UINT32 depth, BOOL lazy, const BYTE* data, BYTE* buffer)
+{
+	size_t i;
+	BOOL rc = FALSE;
+	UINT64 start, duration = 0;
+	size_t compressed = 0;
+	NCRUSH_CONTEXT* encoder = ncrush_context_new(TRUE);
+	NCRUSH_CONTEXT* decoder = ncrush_context_new(FALSE);
+
+	if (!encoder || !decoder)
+		goto fail;
+
+	ncrush_set_match_finder(encoder, depth, lazy);
+
+	for (i = 0; i < NCRUSH_TEST_PACKETS; i++)
+	{
+		int status;
+		UINT32 Flags;
+		UINT32 DstSize = NCRUSH_TEST_PACKET_SIZE;
+		BYTE* pDstData = buffer;
+		const BYTE* pSrcData = &data[i * NCRUSH_TEST_PACKET_SIZE];
+		const BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+
+		start = GetTickCount64();
+		status = ncrush_compress(encoder, pSrcData, NCRUSH_TEST_PACKET_SIZE, &pDstData, &DstSize,
+		                         &Flags);
+		duration += GetTickCount64() - start;
+
+		if (status < 0)
+		{
+			printf("ncrush_compress failed with %d (depth %" PRIu32 ")\n", status, depth);
+			goto fail;
+		}
+
+		compressed += DstSize;
+		status = ncrush_decompress(decoder, pDstData, DstSize, &pOutData, &OutSize, Flags);
+
+		if ((status < 0) || (OutSize != NCRUSH_TEST_PACKET_SIZE) ||
+		    (memcmp(pOutData, pSrcData, OutSize) != 0))
+		{
+			printf("NCrush round trip mismatch in packet %" PRIuz " (depth %" PRIu32
+			       ", lazy %d)\n",
+			       i, depth, lazy);
+			goto fail;
+		}
+	}
+
+	printf("depth %3" PRIu32 " lazy %d: ratio %.3f, %.1f MB/s\n", depth, lazy,
+	       (double)(NCRUSH_TEST_PACKET_SIZE * NCRUSH_TEST_PACKETS) / (double)compressed,
+	       (NCRUSH_TEST_PACKET_SIZE * NCRUSH_TEST_PACKETS) / 1000.0 / (double)MAX(duration, 1));
+	rc = TRUE;
+fail:
+	ncrush_context_free(encoder);
+	ncrush_context_free(decoder);
+	return rc;
+}
+
+/* Ratio and throughput of the legacy match finder (depth 0) and the hash chain search */
+static BOOL test_NCrushMatchFinder(void)
+{
+	size_t i;
+	BOOL rc = FALSE;
+	const UINT32 depths[] = { 0, 1, 4, 16, 64, 256 };
+	BYTE* data = malloc(NCRUSH_TEST_PACKET_SIZE * NCRUSH_TEST_PACKETS);
+	BYTE* buffer = malloc(NCRUSH_TEST_PACKET_SIZE);
+
+	if (!data || !buffer)
+		goto fail;
+
+	test_NCrushFillData(data, NCRUSH_TEST_PACKET_SIZE * NCRUSH_TEST_PACKETS);
+
+	for (i = 0; i < ARRAYSIZE(depths); i++)
+	{
+		if (!test_NCrushRoundtrip(depths[i], FALSE, data, buffer))
+			goto fail;
+
+		if ((depths[i] > 0) && !test_NCrushRoundtrip(depths[i], TRUE, data, buffer))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(data);
+	free(buffer);
+	return rc;
+}
+
 int TestFreeRDPCodecNCrush(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -124,5 +261,8 @@ int TestFreeRDPCodecNCrush(int argc, char* argv[])
 	if (!test_NCrushDecompressBells())
 		return -1;
 
+	if (!test_NCrushMatchFinder())
+		return -1;
+
 	return 0;
 }
@@ -0,0 +1,165 @@
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/print.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/color.h>
+
+#include "../nsc_types.h"
+#include "../nsc_encode.h"
+#include "../nsc_avx2.h"
+
+#define NSC_BENCH_WIDTH 1920
+#define NSC_BENCH_HEIGHT 1080
+#define NSC_BENCH_ITERATIONS 30
+
+/* Random pixels with horizontal runs, like text and UI content */
+static void test_NscFillImage(BYTE* data, size_t size, UINT32* seed)
+{
+	size_t i;
+	UINT32 color = 0;
+
+	for (i = 0; i + 4 <= size; i += 4)
+	{
+		*seed = *seed * 1103515245 + 12345;
+		if ((*seed >> 16) % 4 == 0)
+			color = *seed ^ (*seed << 13);
+		memcpy(&data[i], &color, 4);
+	}
+}
+
+static BOOL test_NscCompose(NSC_CONTEXT* context, wStream* s, const BYTE* data, UINT32 width,
+                            UINT32 height)
+{
+	Stream_SetPosition(s, 0);
+	return nsc_compose_message(context, s, data, width, height, width * 4);
+}
+
+#if defined(WITH_SSE2)
+static BOOL test_NscAvx2(void)
+{
+	BOOL rc = FALSE;
+	size_t i, j, k;
+	UINT32 seed = 0x5EED;
+	NSC_CONTEXT* ref = nsc_context_new();
+	NSC_CONTEXT* opt = nsc_context_new();
+	wStream* s1 = Stream_New(NULL, 1024);
+	wStream* s2 = Stream_New(NULL, 1024);
+	BYTE* data = calloc(300 * 4, 240);
+	const UINT32 formats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGBX32,
+		                       PIXEL_FORMAT_RGBA32 };
+	const UINT32 sizes[][2] = { { 1, 1 }, { 7, 3 }, { 64, 64 }, { 67, 19 }, { 300, 240 } };
+
+	if (!ref || !opt || !s1 || !s2 || !data)
+		goto fail;
+
+	ref->encode = nsc_encode;
+	opt->encode = nsc_encode;
+	nsc_init_avx2(opt);
+
+	if (opt->encode == nsc_encode)
+	{
+		printf("AVX2 not available, skipping NSCodec AVX2 test\n");
+		rc = TRUE;
+		goto fail;
+	}
+
+	for (i = 0; i < ARRAYSIZE(formats); i++)
+	{
+		for (j = 0; j < ARRAYSIZE(sizes); j++)
+		{
+			for (k = 0; k < 4; k++)
+			{
+				const UINT32 width = sizes[j][0];
+				const UINT32 height = sizes[j][1];
+				const UINT32 subsampling = k % 2;
+				const UINT32 colorLoss = (UINT32)k + 1;
+
+				nsc_context_set_parameters(ref, NSC_COLOR_FORMAT, formats[i]);
+				nsc_context_set_parameters(opt, NSC_COLOR_FORMAT, formats[i]);
+				nsc_context_set_parameters(ref, NSC_ALLOW_SUBSAMPLING, subsampling);
+				nsc_context_set_parameters(opt, NSC_ALLOW_SUBSAMPLING, subsampling);
+				nsc_context_set_parameters(ref, NSC_COLOR_LOSS_LEVEL, colorLoss);
+				nsc_context_set_parameters(opt, NSC_COLOR_LOSS_LEVEL, colorLoss);
+				test_NscFillImage(data, (size_t)width * height * 4, &seed);
+
+				if (!test_NscCompose(ref, s1, data, width, height) ||
+				    !test_NscCompose(opt, s2, data, width, height))
+					goto fail;
+
+				if ((Stream_GetPosition(s1) != Stream_GetPosition(s2)) ||
+				    (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), Stream_GetPosition(s1)) != 0))
+				{
+					printf("NSCodec AVX2 mismatch for %s %" PRIu32 "x%" PRIu32
+					       " subsampling %" PRIu32 " color loss %" PRIu32 "\n",
+					       FreeRDPGetColorFormatName(formats[i]), width, height, subsampling,
+					       colorLoss);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	nsc_context_free(ref);
+	nsc_context_free(opt);
+	Stream_Free(s1, TRUE);
+	Stream_Free(s2, TRUE);
+	free(data);
+	return rc;
+}
+#endif
+
+static BOOL test_NscBenchmark(void)
+{
+	BOOL rc = FALSE;
+	size_t i;
+	UINT64 start, duration;
+	UINT32 seed = 0x1080;
+	NSC_CONTEXT* context = nsc_context_new();
+	wStream* s = Stream_New(NULL, 1024);
+	BYTE* data = calloc(NSC_BENCH_WIDTH * 4, NSC_BENCH_HEIGHT);
+
+	if (!context || !s || !data)
+		goto fail;
+
+	nsc_context_set_parameters(context, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32);
+	test_NscFillImage(data, NSC_BENCH_WIDTH * 4 * NSC_BENCH_HEIGHT, &seed);
+
+	start = GetTickCount64();
+	for (i = 0; i < NSC_BENCH_ITERATIONS; i++)
+	{
+		if (!test_NscCompose(context, s, data, NSC_BENCH_WIDTH, NSC_BENCH_HEIGHT))
+			goto fail;
+	}
+	duration = GetTickCount64() - start;
+
+	printf("NSCodec: %dx%d BGRX32, %.1f frames/s, %" PRIuz " bytes per frame\n", NSC_BENCH_WIDTH,
+	       NSC_BENCH_HEIGHT, NSC_BENCH_ITERATIONS * 1000.0 / (double)MAX(duration, 1),
+	       Stream_GetPosition(s));
+	rc = TRUE;
+fail:
+	nsc_context_free(context);
+	Stream_Free(s, TRUE);
+	free(data);
+	return rc;
+}
+
+int TestFreeRDPCodecNsc(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+#if defined(WITH_SSE2)
+	if (!test_NscAvx2())
+		return -1;
+#endif
+
+	if (!test_NscBenchmark())
+		return -1;
+
+	return 0;
+}
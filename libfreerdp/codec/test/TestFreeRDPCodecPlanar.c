@@ -4,6 +4,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
@@ -5764,6 +5765,96 @@ fail:
 	return rc;
 }
 
+#define PLANAR_BENCH_WIDTH 256
+#define PLANAR_BENCH_HEIGHT 256
+#define PLANAR_BENCH_ITERATIONS 200
+
+/* Desktop like content: flat areas, gradients and a noisy picture */
+static void FillBenchmarkBitmap(BYTE* data, UINT32 format, UINT32 width, UINT32 height)
+{
+	UINT32 x, y;
+	UINT32 seed = 0x5EED;
+
+	for (y = 0; y < height; y++)
+	{
+		BYTE* line = &data[y * width * GetBytesPerPixel(format)];
+
+		for (x = 0; x < width; x++)
+		{
+			UINT32 color;
+
+			if (y < height / 4)
+				color = FreeRDPGetColor(format, 0xF0, 0xF0, 0xF0, 0xFF);
+			else if (x < width / 2)
+				color = FreeRDPGetColor(format, (BYTE)x, (BYTE)y, 0x40, 0xFF);
+			else
+			{
+				seed = seed * 1103515245 + 12345;
+				color = FreeRDPGetColor(format, (BYTE)(seed >> 16), (BYTE)(seed >> 20),
+				                        (BYTE)(seed >> 24), 0xFF);
+			}
+
+			WriteColor(line, format, color);
+			line += GetBytesPerPixel(format);
+		}
+	}
+}
+
+static BOOL TestPlanarEncodeBenchmark(const UINT32 format)
+{
+	UINT32 i;
+	UINT64 start, elapsed;
+	BOOL rc = FALSE;
+	UINT32 compressedSize = 0;
+	BYTE* compressedBitmap = NULL;
+	const DWORD planarFlags = PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE;
+	const UINT32 size = PLANAR_BENCH_WIDTH * PLANAR_BENCH_HEIGHT * GetBytesPerPixel(format);
+	const double pixels =
+	    (double)PLANAR_BENCH_WIDTH * PLANAR_BENCH_HEIGHT * PLANAR_BENCH_ITERATIONS;
+	BITMAP_PLANAR_CONTEXT* planar =
+	    freerdp_bitmap_planar_context_new(planarFlags, PLANAR_BENCH_WIDTH, PLANAR_BENCH_HEIGHT);
+	BYTE* bmp = malloc(size);
+	BYTE* decompressedBitmap = malloc(size);
+
+	if (!planar || !bmp || !decompressedBitmap)
+		goto fail;
+
+	freerdp_planar_topdown_image(planar, TRUE);
+	FillBenchmarkBitmap(bmp, format, PLANAR_BENCH_WIDTH, PLANAR_BENCH_HEIGHT);
+
+	start = GetTickCount64();
+	for (i = 0; i < PLANAR_BENCH_ITERATIONS; i++)
+	{
+		free(compressedBitmap);
+		compressedBitmap =
+		    freerdp_bitmap_compress_planar(planar, bmp, format, PLANAR_BENCH_WIDTH,
+		                                   PLANAR_BENCH_HEIGHT, 0, NULL, &compressedSize);
+		if (!compressedBitmap)
+			goto fail;
+	}
+	elapsed = GetTickCount64() - start;
+
+	if (!planar_decompress(planar, compressedBitmap, compressedSize, PLANAR_BENCH_WIDTH,
+	                       PLANAR_BENCH_HEIGHT, decompressedBitmap, format, 0, 0, 0,
+	                       PLANAR_BENCH_WIDTH, PLANAR_BENCH_HEIGHT, FALSE))
+		goto fail;
+
+	if (!CompareBitmap(decompressedBitmap, format, bmp, format, PLANAR_BENCH_WIDTH,
+	                   PLANAR_BENCH_HEIGHT))
+		goto fail;
+
+	printf("%s [%s]: %" PRIu32 " bytes, encode %.1f Mpixel/s\n", __FUNCTION__,
+	       FreeRDPGetColorFormatName(format), compressedSize,
+	       pixels / 1000.0 / (double)MAX(elapsed, 1));
+	rc = TRUE;
+fail:
+	free(compressedBitmap);
+	free(decompressedBitmap);
+	free(bmp);
+	freerdp_bitmap_planar_context_free(planar);
+	return rc;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	UINT32 x;
@@ -5779,5 +5870,11 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 			return -1;
 	}
 
+	if (!TestPlanarEncodeBenchmark(PIXEL_FORMAT_BGRX32))
+		return -3;
+
+	if (!TestPlanarEncodeBenchmark(PIXEL_FORMAT_RGB24))
+		return -3;
+
 	return 0;
 }
@@ -8,6 +8,7 @@
 #include <winpr/sysinfo.h>
 #include <winpr/file.h>
 
+#include <freerdp/settings.h>
 #include <freerdp/codec/region.h>
 
 #include <freerdp/codec/progressive.h>
@@ -1119,6 +1120,229 @@ fail:
 	return res;
 }
 
+static UINT64 image_error(const wImage* image, const BYTE* data, UINT32 format)
+{
+	int x, y;
+	UINT64 error = 0;
+
+	for (y = 0; y < image->height; y++)
+	{
+		for (x = 0; x < image->width; x++)
+		{
+			BYTE ar, ag, ab, br, bg, bb;
+			const UINT32 a = ReadColor(&image->data[y * image->scanline + x * 4], format);
+			const UINT32 b = ReadColor(&data[y * image->scanline + x * 4], format);
+			SplitColor(a, format, &ar, &ag, &ab, NULL, NULL);
+			SplitColor(b, format, &br, &bg, &bb, NULL, NULL);
+			error += (UINT64)(MAX(ar, br) - MIN(ar, br));
+			error += (UINT64)(MAX(ag, bg) - MIN(ag, bg));
+			error += (UINT64)(MAX(ab, bb) - MIN(ab, bb));
+		}
+	}
+
+	return error;
+}
+
+static BOOL test_encode_decode_upgrade(const char* path)
+{
+	int x, y;
+	int rc;
+	UINT32 pass;
+	UINT64 error;
+	UINT64 lastError;
+	BOOL res = FALSE;
+	BYTE* resultData = NULL;
+	BYTE* dstData = NULL;
+	UINT32 dstSize = 0;
+	UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	REGION16 invalidRegion = { 0 };
+	REGION16 emptyRegion = { 0 };
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveEnc = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveDec = progressive_context_new(FALSE);
+
+	region16_init(&invalidRegion);
+	region16_init(&emptyRegion);
+	if (!image || !name || !progressiveEnc || !progressiveDec)
+		goto fail;
+
+	rc = winpr_image_read(image, name);
+	if (rc <= 0)
+		goto fail;
+
+	resultData = calloc(image->scanline, image->height);
+	if (!resultData)
+		goto fail;
+
+	if ((progressive_create_surface_context(progressiveEnc, 0, image->width, image->height) <= 0) ||
+	    (progressive_create_surface_context(progressiveDec, 0, image->width, image->height) <= 0))
+		goto fail;
+
+	// Coarse first pass of all tiles, no budget for upgrades
+	rc = progressive_compress_surface(progressiveEnc, 0, image->data,
+	                                  image->scanline * image->height, ColorFormat, image->width,
+	                                  image->height, image->scanline, NULL, 0, &dstData, &dstSize);
+	if (rc <= 0)
+		goto fail;
+
+	rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+	                            image->scanline, 0, 0, &invalidRegion, 0, 0);
+	if (rc < 0)
+		goto fail;
+
+	if (progressive_surface_pending_upgrades(progressiveEnc, 0) == 0)
+		goto fail;
+
+	// An upgrade pass never fits into a single byte
+	rc = progressive_compress_surface(progressiveEnc, 0, NULL, 0, ColorFormat, image->width,
+	                                  image->height, 0, &emptyRegion, 1, &dstData, &dstSize);
+	if (rc != 0)
+		goto fail;
+
+	lastError = image_error(image, resultData, ColorFormat);
+
+	// Upgrade passes must improve the image until all tiles reached full quality
+	for (pass = 0; progressive_surface_pending_upgrades(progressiveEnc, 0) > 0; pass++)
+	{
+		if (pass >= 16)
+			goto fail;
+
+		rc = progressive_compress_surface(progressiveEnc, 0, NULL, 0, ColorFormat, image->width,
+		                                  image->height, 0, &emptyRegion, UINT32_MAX, &dstData,
+		                                  &dstSize);
+		if (rc <= 0)
+			goto fail;
+
+		region16_clear(&invalidRegion);
+		rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                            image->scanline, 0, 0, &invalidRegion, 0, pass + 1);
+		if (rc < 0)
+			goto fail;
+
+		error = image_error(image, resultData, ColorFormat);
+		printf("progressive pass %" PRIu32 ": %" PRIu32 " bytes, error %" PRIu64 " -> %" PRIu64
+		       "\n",
+		       pass + 2, dstSize, lastError, error);
+		if (error >= lastError)
+			goto fail;
+
+		lastError = error;
+	}
+
+	// Tiles at full quality release their upgrade state
+	for (pass = 0; pass < 2; pass++)
+	{
+		size_t current = 0;
+		size_t peak = 0;
+
+		if (!progressive_get_surface_memory((pass == 0) ? progressiveEnc : progressiveDec, 0,
+		                                    &current, &peak))
+			goto fail;
+
+		if ((current == 0) || (current >= peak))
+			goto fail;
+	}
+
+	for (y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &resultData[y * image->scanline];
+		for (x = 0; x < image->width; x++)
+		{
+			const DWORD a = ReadColor(&orig[x * 4], ColorFormat);
+			const DWORD b = ReadColor(&dec[x * 4], ColorFormat);
+			if (!colordiff(ColorFormat, a, b))
+			{
+				printf("xxxxxxx [%u:%u] %08X != %08X\n", x, y, a, b);
+				goto fail;
+			}
+		}
+	}
+	res = TRUE;
+fail:
+	region16_uninit(&invalidRegion);
+	region16_uninit(&emptyRegion);
+	progressive_context_free(progressiveEnc);
+	progressive_context_free(progressiveDec);
+	winpr_image_free(image, TRUE);
+	free(resultData);
+	free(name);
+	return res;
+}
+
+static BOOL test_encode_threads(const char* path)
+{
+	int rc;
+	UINT32 i;
+	BOOL res = FALSE;
+	BYTE* dstData[2] = { 0 };
+	UINT32 dstSize[2] = { 0 };
+	UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	REGION16 invalidRegion = { 0 };
+	REGION16 emptyRegion = { 0 };
+	RECTANGLE_16 rect = { 70, 30, 400, 200 };
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveEnc[2] = {
+		progressive_context_new_ex(TRUE, 0),
+		progressive_context_new_ex(TRUE, THREADING_FLAGS_DISABLE_THREADS)
+	};
+
+	region16_init(&invalidRegion);
+	region16_init(&emptyRegion);
+	if (!image || !name || !progressiveEnc[0] || !progressiveEnc[1])
+		goto fail;
+
+	rc = winpr_image_read(image, name);
+	if (rc <= 0)
+		goto fail;
+
+	if (!region16_union_rect(&invalidRegion, &invalidRegion, &rect))
+		goto fail;
+
+	for (i = 0; i < ARRAYSIZE(progressiveEnc); i++)
+	{
+		if (progressive_create_surface_context(progressiveEnc[i], 0, image->width,
+		                                       image->height) <= 0)
+			goto fail;
+	}
+
+	// Threaded and single threaded encoders must produce the same bitstream
+	for (i = 0; i < 3; i++)
+	{
+		UINT32 j;
+
+		for (j = 0; j < ARRAYSIZE(progressiveEnc); j++)
+		{
+			const REGION16* region = (i == 0) ? NULL : (i == 1) ? &invalidRegion : &emptyRegion;
+
+			rc = progressive_compress_surface(progressiveEnc[j], 0, image->data,
+			                                  image->scanline * image->height, ColorFormat,
+			                                  image->width, image->height, image->scanline, region,
+			                                  (i == 0) ? 0 : 40000, &dstData[j], &dstSize[j]);
+			if (rc <= 0)
+				goto fail;
+		}
+
+		if ((dstSize[0] != dstSize[1]) || (memcmp(dstData[0], dstData[1], dstSize[0]) != 0))
+		{
+			printf("threaded progressive encoding differs in frame %" PRIu32 "\n", i);
+			goto fail;
+		}
+	}
+
+	res = TRUE;
+fail:
+	region16_uninit(&invalidRegion);
+	region16_uninit(&emptyRegion);
+	for (i = 0; i < ARRAYSIZE(progressiveEnc); i++)
+		progressive_context_free(progressiveEnc[i]);
+	winpr_image_free(image, TRUE);
+	free(name);
+	return res;
+}
+
 int TestFreeRDPCodecProgressive(int argc, char* argv[])
 {
 	int rc = -1;
@@ -1150,6 +1374,10 @@ int TestFreeRDPCodecProgressive(int argc, char* argv[])
 		    */
 		if (!test_encode_decode(ms_sample_path))
 			goto fail;
+		if (!test_encode_decode_upgrade(ms_sample_path))
+			goto fail;
+		if (!test_encode_threads(ms_sample_path))
+			goto fail;
 		rc = 0;
 	}
 
@@ -1,8 +1,16 @@
+#include <freerdp/config.h>
+
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
+#include <freerdp/primitives.h>
+
+#include "../rfx_dwt.h"
+#include "../rfx_quantization.h"
+#include "../rfx_avx2.h"
 
 static BYTE encodeHeaderSample[] = {
 	/* as in 4.2.2 */
@@ -843,17 +851,473 @@ static BOOL fuzzyCompareImage(const UINT32* crefImage, const BYTE* img, size_t n
 	return TRUE;
 }
 
-int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
+#if defined(WITH_SSE2)
+static BOOL test_RemoteFXAvx2(void)
+{
+	BOOL rc = FALSE;
+	size_t i, pass;
+	UINT32 seed = 0x12345678;
+	UINT32 quantVals[10];
+	RFX_CONTEXT* context = NULL;
+	INT16* ref = NULL;
+	INT16* opt = NULL;
+	INT16* dwt = NULL;
+	const size_t size = 4096 * sizeof(INT16);
+
+	context = rfx_context_new(TRUE);
+	ref = _aligned_malloc(size, 32);
+	opt = _aligned_malloc(size, 32);
+	dwt = _aligned_malloc(size, 32);
+	if (!context || !ref || !opt || !dwt)
+		goto fail;
+
+	context->quantization_decode = rfx_quantization_decode;
+	context->quantization_encode = rfx_quantization_encode;
+	context->dwt_2d_decode = rfx_dwt_2d_decode;
+	context->dwt_2d_encode = rfx_dwt_2d_encode;
+	rfx_init_avx2(context);
+
+	if (context->dwt_2d_encode == rfx_dwt_2d_encode)
+	{
+		printf("AVX2 not available, skipping RemoteFX AVX2 test\n");
+		rc = TRUE;
+		goto fail;
+	}
+
+	for (pass = 0; pass < 16; pass++)
+	{
+		for (i = 0; i < 10; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			quantVals[i] = 6 + (seed >> 16) % 10;
+		}
+
+		/* The first passes use tile like input, the later ones the full INT16 range */
+		for (i = 0; i < 4096; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			if (pass < 8)
+				ref[i] = (INT16)((INT32)((seed >> 16) % 8192) - 4096);
+			else
+				ref[i] = (INT16)(seed >> 16);
+		}
+
+		memcpy(opt, ref, size);
+		rfx_dwt_2d_encode(ref, dwt);
+		context->dwt_2d_encode(opt, dwt);
+		if (memcmp(ref, opt, size) != 0)
+		{
+			fprintf(stderr, "AVX2 dwt_2d_encode mismatch in pass %" PRIuz "\n", pass);
+			goto fail;
+		}
+
+		rfx_quantization_encode(ref, quantVals);
+		context->quantization_encode(opt, quantVals);
+		if (memcmp(ref, opt, size) != 0)
+		{
+			fprintf(stderr, "AVX2 quantization_encode mismatch in pass %" PRIuz "\n", pass);
+			goto fail;
+		}
+
+		rfx_quantization_decode(ref, quantVals);
+		context->quantization_decode(opt, quantVals);
+		if (memcmp(ref, opt, size) != 0)
+		{
+			fprintf(stderr, "AVX2 quantization_decode mismatch in pass %" PRIuz "\n", pass);
+			goto fail;
+		}
+
+		rfx_dwt_2d_decode(ref, dwt);
+		context->dwt_2d_decode(opt, dwt);
+		if (memcmp(ref, opt, size) != 0)
+		{
+			fprintf(stderr, "AVX2 dwt_2d_decode mismatch in pass %" PRIuz "\n", pass);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	rfx_context_free(context);
+	_aligned_free(ref);
+	_aligned_free(opt);
+	_aligned_free(dwt);
+	return rc;
+}
+#endif
+
+/* The fused dequantization and inverse DWT has to match the two separate passes */
+static BOOL test_RemoteFXQuantizationDwtDecode(void)
+{
+	BOOL rc = FALSE;
+	size_t i, pass;
+	UINT32 seed = 0x87654321;
+	UINT32 quantVals[10];
+	RFX_CONTEXT* context = NULL;
+	INT16* ref = NULL;
+	INT16* gen = NULL;
+	INT16* opt = NULL;
+	INT16* dwt = NULL;
+	const size_t size = 4096 * sizeof(INT16);
+
+	context = rfx_context_new(FALSE);
+	ref = _aligned_malloc(size, 32);
+	gen = _aligned_malloc(size, 32);
+	opt = _aligned_malloc(size, 32);
+	dwt = _aligned_malloc(size, 32);
+	if (!context || !ref || !gen || !opt || !dwt)
+		goto fail;
+
+	for (pass = 0; pass < 16; pass++)
+	{
+		for (i = 0; i < 10; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			quantVals[i] = 6 + (seed >> 16) % 10;
+		}
+
+		/* Encoded tile like input, the SSE2 transform works on wrapping 16 bit sums */
+		for (i = 0; i < 4096; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			ref[i] = (INT16)((INT32)((seed >> 16) % 8192) - 4096);
+		}
+
+		rfx_dwt_2d_encode(ref, dwt);
+		rfx_quantization_encode(ref, quantVals);
+		memcpy(gen, ref, size);
+		memcpy(opt, ref, size);
+		rfx_quantization_decode(ref, quantVals);
+		rfx_dwt_2d_decode(ref, dwt);
+		rfx_quantization_dwt_2d_decode(gen, dwt, quantVals);
+		context->quantization_dwt_2d_decode(opt, dwt, quantVals);
+
+		if ((memcmp(ref, gen, size) != 0) || (memcmp(ref, opt, size) != 0))
+		{
+			fprintf(stderr, "quantization_dwt_2d_decode mismatch in pass %" PRIuz "\n", pass);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	rfx_context_free(context);
+	_aligned_free(ref);
+	_aligned_free(gen);
+	_aligned_free(opt);
+	_aligned_free(dwt);
+	return rc;
+}
+
+static BOOL test_RemoteFXEncodeFrame(RFX_CONTEXT* context, const BYTE* image, UINT32 width,
+                                     UINT32 height, wStream* s)
+{
+	const RFX_RECT rect = { 0, 0, (UINT16)width, (UINT16)height };
+
+	Stream_SetPosition(s, 0);
+	return rfx_compose_message(context, s, &rect, 1, image, width, height, width * 4);
+}
+
+static BOOL test_RemoteFXTileCache(void)
+{
+	BOOL rc = FALSE;
+	size_t x, y;
+	UINT64 encoded = 0, skipped = 0;
+	const UINT32 width = 200;
+	const UINT32 height = 136;
+	const UINT64 tiles = 4 * 3;
+	BYTE* image = NULL;
+	RFX_CONTEXT* context = NULL;
+	RFX_CONTEXT* reference = NULL;
+	wStream* first = Stream_New(NULL, 1024);
+	wStream* second = Stream_New(NULL, 1024);
+
+	if (!first || !second)
+		goto fail;
+
+	if (!(image = calloc(width * height, 4)))
+		goto fail;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* pixel = &image[(y * width + x) * 4];
+			pixel[0] = (BYTE)(x * 3);
+			pixel[1] = (BYTE)(y * 5);
+			pixel[2] = (BYTE)(x ^ y);
+		}
+	}
+
+	if (!(context = rfx_context_new(TRUE)))
+		goto fail;
+
+	context->mode = RLGR3;
+	rfx_context_set_pixel_format(context, PIXEL_FORMAT_BGRX32);
+
+	if (!rfx_context_reset(context, width, height))
+		goto fail;
+
+	/* the first frame encodes everything */
+	if (!test_RemoteFXEncodeFrame(context, image, width, height, first))
+		goto fail;
+
+	if (!rfx_context_get_tile_stats(context, &encoded, &skipped) || (encoded != tiles) ||
+	    (skipped != 0))
+		goto fail;
+
+	/* an identical frame reuses all tiles and must produce the same tile data */
+	if (!test_RemoteFXEncodeFrame(context, image, width, height, second))
+		goto fail;
+
+	if (!rfx_context_get_tile_stats(context, &encoded, &skipped) || (encoded != tiles) ||
+	    (skipped != tiles))
+		goto fail;
+
+	/* compare against the second frame of an encoder without tile cache */
+	if (!(reference = rfx_context_new(TRUE)) || !rfx_context_set_tile_cache(reference, FALSE))
+		goto fail;
+
+	reference->mode = RLGR3;
+	rfx_context_set_pixel_format(reference, PIXEL_FORMAT_BGRX32);
+
+	if (!rfx_context_reset(reference, width, height) ||
+	    !test_RemoteFXEncodeFrame(reference, image, width, height, first) ||
+	    !test_RemoteFXEncodeFrame(reference, image, width, height, first))
+		goto fail;
+
+	if ((Stream_GetPosition(first) != Stream_GetPosition(second)) ||
+	    (memcmp(Stream_Buffer(first), Stream_Buffer(second), Stream_GetPosition(first)) != 0))
+	{
+		fprintf(stderr, "RemoteFX tile cache output differs from the encoded output\n");
+		goto fail;
+	}
+
+	/* changing a single pixel of the last (partial) tile encodes exactly that tile */
+	image[((height - 1) * width + width - 1) * 4] ^= 0xFF;
+
+	if (!test_RemoteFXEncodeFrame(context, image, width, height, second))
+		goto fail;
+
+	if (!rfx_context_get_tile_stats(context, &encoded, &skipped) || (encoded != tiles + 1) ||
+	    (skipped != 2 * tiles - 1))
+		goto fail;
+
+	/* different quantization values invalidate the cached data */
+	context->quants[0]++;
+
+	if (!test_RemoteFXEncodeFrame(context, image, width, height, second))
+		goto fail;
+
+	if (!rfx_context_get_tile_stats(context, &encoded, &skipped) ||
+	    (encoded != 2 * tiles + 1) || (skipped != 2 * tiles - 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		fprintf(stderr, "RemoteFX tile cache test failed: encoded %" PRIu64 " skipped %" PRIu64
+		                "\n",
+		        encoded, skipped);
+	rfx_context_free(context);
+	rfx_context_free(reference);
+	Stream_Free(first, TRUE);
+	Stream_Free(second, TRUE);
+	free(image);
+	return rc;
+}
+
+/* A second session showing the same content reuses the tiles of the first one */
+static BOOL test_RemoteFXSharedTileCache(void)
 {
-	int rc = -1;
+	BOOL rc = FALSE;
+	size_t x, y;
+	size_t bytes = 0;
+	UINT64 encoded = 0, skipped = 0, hits = 0, misses = 0;
+	const UINT32 width = 200;
+	const UINT32 height = 136;
+	const UINT64 tiles = 4 * 3;
+	BYTE* image = NULL;
+	RFX_CONTEXT* sessions[2] = { 0 };
+	wStream* first = Stream_New(NULL, 1024);
+	wStream* second = Stream_New(NULL, 1024);
+
+	if (!first || !second || !(image = calloc(width * height, 4)))
+		goto fail;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* pixel = &image[(y * width + x) * 4];
+			pixel[0] = (BYTE)(x * 7);
+			pixel[1] = (BYTE)(y * 3);
+			pixel[2] = (BYTE)(x + y);
+		}
+	}
+
+	for (x = 0; x < ARRAYSIZE(sessions); x++)
+	{
+		if (!(sessions[x] = rfx_context_new(TRUE)) ||
+		    !rfx_context_set_shared_tile_cache(sessions[x], TRUE))
+			goto fail;
+
+		sessions[x]->mode = RLGR3;
+		rfx_context_set_pixel_format(sessions[x], PIXEL_FORMAT_BGRX32);
+
+		if (!rfx_context_reset(sessions[x], width, height))
+			goto fail;
+	}
+
+	if (!test_RemoteFXEncodeFrame(sessions[0], image, width, height, first) ||
+	    !test_RemoteFXEncodeFrame(sessions[1], image, width, height, second))
+		goto fail;
+
+	if (!rfx_context_get_tile_stats(sessions[1], &encoded, &skipped) || (encoded != 0) ||
+	    (skipped != tiles))
+		goto fail;
+
+	if ((Stream_GetPosition(first) != Stream_GetPosition(second)) ||
+	    (memcmp(Stream_Buffer(first), Stream_Buffer(second), Stream_GetPosition(first)) != 0))
+	{
+		fprintf(stderr, "RemoteFX shared tile cache output differs from the encoded output\n");
+		goto fail;
+	}
+
+	rfx_shared_tile_cache_get_stats(&bytes, &hits, &misses);
+
+	if ((bytes == 0) || (hits < tiles))
+		goto fail;
+
+	/* without memory every tile is encoded again */
+	rfx_shared_tile_cache_set_limit(0);
+	rfx_shared_tile_cache_get_stats(&bytes, NULL, NULL);
+
+	if (bytes != 0)
+		goto fail;
+
+	image[0] ^= 0xFF;
+
+	if (!test_RemoteFXEncodeFrame(sessions[1], image, width, height, second) ||
+	    !rfx_context_get_tile_stats(sessions[1], &encoded, &skipped) || (encoded != 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		fprintf(stderr, "RemoteFX shared tile cache test failed: encoded %" PRIu64
+		                " skipped %" PRIu64 "\n",
+		        encoded, skipped);
+	rfx_shared_tile_cache_set_limit(64 * 1024 * 1024);
+	rfx_context_free(sessions[0]);
+	rfx_context_free(sessions[1]);
+	Stream_Free(first, TRUE);
+	Stream_Free(second, TRUE);
+	free(image);
+	return rc;
+}
+
+/* Tiles decoded in place must give the same result as tiles copied from the tile buffers */
+static BOOL test_RemoteFXDecodeInPlace(void)
+{
+	BOOL rc = FALSE;
+	size_t x, y;
+	const UINT32 width = 200;
+	const UINT32 height = 136;
+	const UINT32 dstStride = 256 * 4;
+	const size_t dstSize = 1ull * dstStride * 192 + 16;
+	const RECTANGLE_16* extents;
+	BYTE* image = NULL;
+	BYTE* aligned = NULL;
+	BYTE* unaligned = NULL;
+	RFX_CONTEXT* encoder = NULL;
+	RFX_CONTEXT* decoder = NULL;
+	REGION16 region1, region2;
+	wStream* s = Stream_New(NULL, 1024);
+
+	region16_init(&region1);
+	region16_init(&region2);
+
+	if (!s || !(image = calloc(width * height, 4)))
+		goto fail;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* pixel = &image[(y * width + x) * 4];
+			pixel[0] = (BYTE)(x * 7);
+			pixel[1] = (BYTE)(y * 3);
+			pixel[2] = (BYTE)(x + y);
+		}
+	}
+
+	aligned = _aligned_malloc(dstSize, 16);
+	unaligned = _aligned_malloc(dstSize, 16);
+	encoder = rfx_context_new(TRUE);
+	decoder = rfx_context_new(FALSE);
+
+	if (!aligned || !unaligned || !encoder || !decoder)
+		goto fail;
+
+	rfx_context_set_pixel_format(encoder, PIXEL_FORMAT_BGRX32);
+	rfx_context_set_pixel_format(decoder, PIXEL_FORMAT_BGRX32);
+
+	if (!rfx_context_reset(encoder, width, height) ||
+	    !test_RemoteFXEncodeFrame(encoder, image, width, height, s))
+		goto fail;
+
+	memset(aligned, 0xCD, dstSize);
+	memset(unaligned, 0xCD, dstSize);
+
+	/* the inner tiles are decoded in place, the right column and the last row are clipped */
+	if (!rfx_process_message(decoder, Stream_Buffer(s), (UINT32)Stream_GetPosition(s), 8, 3,
+	                         aligned, PIXEL_FORMAT_BGRX32, dstStride, 192, &region1))
+		goto fail;
+
+	/* no tile destination is aligned here, everything is copied */
+	if (!rfx_process_message(decoder, Stream_Buffer(s), (UINT32)Stream_GetPosition(s), 8, 3,
+	                         &unaligned[4], PIXEL_FORMAT_BGRX32, dstStride, 192, &region2))
+		goto fail;
+
+	if (memcmp(aligned, &unaligned[4], dstSize - 4) != 0)
+	{
+		fprintf(stderr, "RemoteFX in place decoding differs from the tile copies\n");
+		goto fail;
+	}
+
+	extents = region16_extents(&region1);
+
+	if ((extents->left != 8) || (extents->top != 3) || (extents->right != 8 + width) ||
+	    (extents->bottom != 3 + height))
+		goto fail;
+
+	if (memcmp(extents, region16_extents(&region2), sizeof(RECTANGLE_16)) != 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		fprintf(stderr, "RemoteFX in place decoding test failed\n");
+	region16_uninit(&region1);
+	region16_uninit(&region2);
+	rfx_context_free(encoder);
+	rfx_context_free(decoder);
+	_aligned_free(aligned);
+	_aligned_free(unaligned);
+	Stream_Free(s, TRUE);
+	free(image);
+	return rc;
+}
+
+static BOOL test_RemoteFXDecodeSample(void)
+{
+	BOOL rc = FALSE;
 	REGION16 region = { 0 };
 	RFX_CONTEXT* context = NULL;
 	BYTE* dest = NULL;
 	size_t stride = FORMAT_SIZE * IMG_WIDTH;
 
-	WINPR_UNUSED(argc);
-	WINPR_UNUSED(argv);
-
 	/* use default threading options here, pass zero as
 	 * ThreadingFlags */
 	context = rfx_context_new(FALSE);
@@ -884,10 +1348,110 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	if (!fuzzyCompareImage(srefImage, dest, IMG_WIDTH * IMG_HEIGHT))
 		goto fail;
 
-	rc = 0;
+	rc = TRUE;
 fail:
 	region16_uninit(&region);
 	rfx_context_free(context);
 	free(dest);
 	return rc;
 }
+
+/* A CPU version of the GPU tile batch contract */
+static pstatus_t test_RFXDecodeTiles(const INT16* pSrc, const UINT32* quantVals, UINT32 numTiles,
+                                     BYTE* const pDst[], const UINT32 dstStep[], UINT32 DstFormat)
+{
+	static const prim_size_t roi = { 64, 64 };
+	const primitives_t* prims = primitives_get_generic();
+	UINT32 i, x;
+	INT16* buffer = _aligned_malloc(3 * 4096 * sizeof(INT16), 32);
+	INT16* dwt = _aligned_malloc(4096 * sizeof(INT16), 32);
+	pstatus_t status = -1;
+
+	if (!buffer || !dwt)
+		goto fail;
+
+	for (i = 0; i < numTiles; i++)
+	{
+		const INT16* planes[3] = { &buffer[0], &buffer[4096], &buffer[8192] };
+
+		memcpy(buffer, &pSrc[3ull * 4096 * i], 3 * 4096 * sizeof(INT16));
+		for (x = 0; x < 3; x++)
+			rfx_quantization_dwt_2d_decode(&buffer[x * 4096], dwt, &quantVals[(3 * i + x) * 10]);
+
+		if (prims->yCbCrToRGB_16s8u_P3AC4R(planes, 64 * sizeof(INT16), pDst[i], dstStep[i],
+		                                   DstFormat, &roi) != PRIMITIVES_SUCCESS)
+			goto fail;
+	}
+
+	status = PRIMITIVES_SUCCESS;
+fail:
+	_aligned_free(buffer);
+	_aligned_free(dwt);
+	return status;
+}
+
+static pstatus_t test_RFXDecodeTilesFail(const INT16* pSrc, const UINT32* quantVals,
+                                         UINT32 numTiles, BYTE* const pDst[],
+                                         const UINT32 dstStep[], UINT32 DstFormat)
+{
+	WINPR_UNUSED(pSrc);
+	WINPR_UNUSED(quantVals);
+	WINPR_UNUSED(numTiles);
+	WINPR_UNUSED(pDst);
+	WINPR_UNUSED(dstStep);
+	WINPR_UNUSED(DstFormat);
+	return -1;
+}
+
+/* Messages are handed to RFXDecodeTiles_16s8u in one batch when the primitives provide it, the
+ * CPU finishes the batch when the call fails */
+static BOOL test_RemoteFXDecodeBatch(void)
+{
+	BOOL rc = FALSE;
+	primitives_t* prims = primitives_get();
+	const __RFXDecodeTiles_16s8u_t saved = prims->RFXDecodeTiles_16s8u;
+
+	prims->RFXDecodeTiles_16s8u = test_RFXDecodeTiles;
+	if (!test_RemoteFXDecodeSample())
+		goto fail;
+
+	prims->RFXDecodeTiles_16s8u = test_RFXDecodeTilesFail;
+	if (!test_RemoteFXDecodeSample())
+		goto fail;
+
+	rc = TRUE;
+fail:
+	prims->RFXDecodeTiles_16s8u = saved;
+	return rc;
+}
+
+int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+#if defined(WITH_SSE2)
+	if (!test_RemoteFXAvx2())
+		return -1;
+#endif
+
+	if (!test_RemoteFXQuantizationDwtDecode())
+		return -1;
+
+	if (!test_RemoteFXTileCache())
+		return -1;
+
+	if (!test_RemoteFXSharedTileCache())
+		return -1;
+
+	if (!test_RemoteFXDecodeInPlace())
+		return -1;
+
+	if (!test_RemoteFXDecodeSample())
+		return -1;
+
+	if (!test_RemoteFXDecodeBatch())
+		return -1;
+
+	return 0;
+}
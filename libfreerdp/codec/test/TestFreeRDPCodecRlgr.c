@@ -0,0 +1,138 @@
+#include <winpr/crt.h>
+#include <winpr/print.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/rfx.h>
+
+#include "../rfx_rlgr.h"
+
+#define RLGR_COEFFS 4096
+#define RLGR_BUFFER_SIZE (RLGR_COEFFS * 4)
+#define RLGR_BENCH_ITERATIONS 2000
+
+/* Fills a tile worth of coefficients, every density-th value being non zero */
+static void test_RlgrFillCoefficients(INT16* data, UINT32 density, INT32 range, UINT32* seed)
+{
+	size_t i;
+
+	for (i = 0; i < RLGR_COEFFS; i++)
+	{
+		*seed = *seed * 1103515245 + 12345;
+
+		if ((density > 1) && ((*seed >> 16) % density))
+			data[i] = 0;
+		else
+			data[i] = (INT16)((INT32)((*seed >> 8) % (UINT32)(2 * range + 1)) - range);
+	}
+
+	/* The encoder always terminates with a coded value, see rfx_rlgr_encode */
+	if (data[RLGR_COEFFS - 1] == 0)
+		data[RLGR_COEFFS - 1] = 1;
+}
+
+static BOOL test_RlgrRoundtrip(RLGR_MODE mode, const INT16* data, BYTE* buffer, INT16* output)
+{
+	int size;
+
+	/* the encoder must not depend on a zeroed output buffer */
+	memset(buffer, 0xCD, RLGR_BUFFER_SIZE);
+	size = rfx_rlgr_encode(mode, data, RLGR_COEFFS, buffer, RLGR_BUFFER_SIZE);
+	if ((size <= 0) || (size > RLGR_BUFFER_SIZE))
+	{
+		fprintf(stderr, "rfx_rlgr_encode failed: %d\n", size);
+		return FALSE;
+	}
+
+	if (rfx_rlgr_decode(mode, buffer, (UINT32)size, output, RLGR_COEFFS) < 0)
+	{
+		fprintf(stderr, "rfx_rlgr_decode failed\n");
+		return FALSE;
+	}
+
+	if (memcmp(data, output, RLGR_COEFFS * sizeof(INT16)) != 0)
+	{
+		fprintf(stderr, "RLGR%d round trip mismatch\n", (mode == RLGR1) ? 1 : 3);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_RlgrBenchmark(RLGR_MODE mode, const INT16* data, BYTE* buffer, INT16* output)
+{
+	size_t i;
+	int size = 0;
+	UINT64 start, encode, decode;
+	const double coeffs = (double)RLGR_COEFFS * RLGR_BENCH_ITERATIONS;
+
+	start = GetTickCount64();
+	for (i = 0; i < RLGR_BENCH_ITERATIONS; i++)
+	{
+		size = rfx_rlgr_encode(mode, data, RLGR_COEFFS, buffer, RLGR_BUFFER_SIZE);
+	}
+	encode = GetTickCount64() - start;
+
+	if (size <= 0)
+		return FALSE;
+
+	start = GetTickCount64();
+	for (i = 0; i < RLGR_BENCH_ITERATIONS; i++)
+	{
+		if (rfx_rlgr_decode(mode, buffer, (UINT32)size, output, RLGR_COEFFS) < 0)
+			return FALSE;
+	}
+	decode = GetTickCount64() - start;
+
+	printf("RLGR%d: %d bytes per tile, encode %.1f Mcoeff/s, decode %.1f Mcoeff/s\n",
+	       (mode == RLGR1) ? 1 : 3, size, coeffs / 1000.0 / (double)MAX(encode, 1),
+	       coeffs / 1000.0 / (double)MAX(decode, 1));
+	return TRUE;
+}
+
+int TestFreeRDPCodecRlgr(int argc, char* argv[])
+{
+	int rc = -1;
+	UINT32 seed = 0x5EED;
+	UINT32 density;
+	INT32 range;
+	INT16* data = NULL;
+	INT16* output = NULL;
+	BYTE* buffer = NULL;
+	const RLGR_MODE modes[] = { RLGR1, RLGR3 };
+	size_t i;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	data = calloc(RLGR_COEFFS, sizeof(INT16));
+	output = calloc(RLGR_COEFFS, sizeof(INT16));
+	buffer = calloc(RLGR_BUFFER_SIZE, 1);
+	if (!data || !output || !buffer)
+		goto fail;
+
+	for (i = 0; i < ARRAYSIZE(modes); i++)
+	{
+		/* from mostly zero (long runs, RL mode) to dense (GR mode) input */
+		for (density = 1; density <= 64; density *= 2)
+		{
+			for (range = 1; range <= 4096; range *= 8)
+			{
+				test_RlgrFillCoefficients(data, density, range, &seed);
+				if (!test_RlgrRoundtrip(modes[i], data, buffer, output))
+					goto fail;
+			}
+		}
+
+		/* Typical quantized tile: few significant coefficients of small magnitude */
+		test_RlgrFillCoefficients(data, 4, 32, &seed);
+		if (!test_RlgrBenchmark(modes[i], data, buffer, output))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(data);
+	free(output);
+	free(buffer);
+	return rc;
+}
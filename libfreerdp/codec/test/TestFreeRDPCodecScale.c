@@ -0,0 +1,338 @@
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/types.h>
+#include <freerdp/codec/color.h>
+
+typedef struct
+{
+	UINT32 srcWidth;
+	UINT32 srcHeight;
+	UINT32 dstWidth;
+	UINT32 dstHeight;
+} scale_test_size;
+
+static const scale_test_size test_sizes[] = {
+	{ 64, 64, 32, 32 },   { 64, 48, 128, 96 }, { 67, 33, 17, 61 },  { 1, 1, 9, 7 },
+	{ 5, 3, 1, 1 },       { 9, 1, 4, 5 },      { 100, 80, 99, 81 }, { 333, 211, 40, 100 },
+	{ 31, 17, 1920, 15 },
+};
+
+/* The weights of every output pixel add up to exactly 1.0, a plain color stays unchanged */
+static BOOL test_scale_solid(DWORD SrcFormat, DWORD DstFormat)
+{
+	BOOL rc = FALSE;
+	size_t x;
+	const UINT32 color = FreeRDPGetColor(PIXEL_FORMAT_BGRA32, 0x12, 0x9A, 0xF0, 0x7F);
+	const UINT32 srcColor = FreeRDPConvertColor(color, PIXEL_FORMAT_BGRA32, SrcFormat, NULL);
+	const UINT32 expected = FreeRDPConvertColor(srcColor, SrcFormat, DstFormat, NULL);
+	const UINT32 srcBpp = GetBytesPerPixel(SrcFormat);
+	const UINT32 dstBpp = GetBytesPerPixel(DstFormat);
+	BYTE* src = NULL;
+	BYTE* dst = NULL;
+
+	for (x = 0; x < ARRAYSIZE(test_sizes); x++)
+	{
+		const scale_test_size* size = &test_sizes[x];
+		const UINT32 srcStep = size->srcWidth * srcBpp + 12;
+		const UINT32 dstStep = size->dstWidth * dstBpp + 4;
+		UINT32 i, j;
+
+		src = calloc(size->srcHeight, srcStep);
+		dst = calloc(size->dstHeight, dstStep);
+
+		if (!src || !dst)
+			goto fail;
+
+		if (!freerdp_image_fill(src, SrcFormat, srcStep, 0, 0, size->srcWidth, size->srcHeight,
+		                        srcColor))
+			goto fail;
+
+		if (!freerdp_image_scale(dst, DstFormat, dstStep, 0, 0, size->dstWidth, size->dstHeight,
+		                         src, SrcFormat, srcStep, 0, 0, size->srcWidth,
+		                         size->srcHeight))
+		{
+			fprintf(stderr, "freerdp_image_scale %" PRIu32 "x%" PRIu32 " -> %" PRIu32
+			                "x%" PRIu32 " failed\n",
+			        size->srcWidth, size->srcHeight, size->dstWidth, size->dstHeight);
+			goto fail;
+		}
+
+		for (j = 0; j < size->dstHeight; j++)
+		{
+			for (i = 0; i < size->dstWidth; i++)
+			{
+				const UINT32 value = ReadColor(&dst[j * dstStep + i * dstBpp], DstFormat);
+
+				if (value != expected)
+				{
+					fprintf(stderr,
+					        "%s -> %s %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32
+					        ": pixel %" PRIu32 ",%" PRIu32 " is 0x%08" PRIx32
+					        " instead of 0x%08" PRIx32 "\n",
+					        FreeRDPGetColorFormatName(SrcFormat),
+					        FreeRDPGetColorFormatName(DstFormat), size->srcWidth,
+					        size->srcHeight, size->dstWidth, size->dstHeight, i, j, value,
+					        expected);
+					goto fail;
+				}
+			}
+		}
+
+		free(src);
+		free(dst);
+		src = dst = NULL;
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+/* Halving both sides is a box filter over 2x2 pixels, the result is the rounded average */
+static BOOL test_scale_half(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 94;
+	const UINT32 height = 62;
+	const UINT32 srcStep = width * 4;
+	const UINT32 dstStep = width / 2 * 4;
+	BYTE* src = malloc(1ull * srcStep * height);
+	BYTE* dst = calloc(height / 2, dstStep);
+	UINT32 x, y;
+	size_t c;
+
+	if (!src || !dst)
+		goto fail;
+
+	winpr_RAND(src, 1ull * srcStep * height);
+
+	if (!freerdp_image_scale(dst, PIXEL_FORMAT_BGRA32, dstStep, 0, 0, width / 2, height / 2,
+	                         src, PIXEL_FORMAT_BGRA32, srcStep, 0, 0, width, height))
+		goto fail;
+
+	for (y = 0; y < height / 2; y++)
+	{
+		for (x = 0; x < width / 2; x++)
+		{
+			for (c = 0; c < 4; c++)
+			{
+				const BYTE* s = &src[2 * y * srcStep + 2 * x * 4 + c];
+				const UINT32 sum = s[0] + s[4] + s[srcStep] + s[srcStep + 4];
+				const BYTE value = dst[y * dstStep + x * 4 + c];
+
+				if (value != (sum + 2) / 4)
+				{
+					fprintf(stderr,
+					        "half size: pixel %" PRIu32 ",%" PRIu32 " channel %" PRIuz
+					        " is %" PRIu8 " instead of %" PRIu32 "\n",
+					        x, y, c, value, (sum + 2) / 4);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+/* Without negative lobes every output lies between the darkest and brightest source pixel of
+ * a channel, an offset source rectangle must not read outside of it */
+static BOOL test_scale_bounds(void)
+{
+	BOOL rc = FALSE;
+	size_t x;
+	BYTE* src = NULL;
+	BYTE* dst = NULL;
+
+	for (x = 0; x < ARRAYSIZE(test_sizes); x++)
+	{
+		const scale_test_size* size = &test_sizes[x];
+		const UINT32 srcStep = (size->srcWidth + 6) * 4;
+		const UINT32 dstStep = (size->dstWidth + 3) * 4;
+		const size_t srcSize = 1ull * srcStep * (size->srcHeight + 4);
+		UINT32 i, j;
+		size_t c;
+
+		src = calloc(1, srcSize);
+		dst = calloc(size->dstHeight + 2, dstStep);
+
+		if (!src || !dst)
+			goto fail;
+
+		for (j = 0; j < size->srcHeight; j++)
+		{
+			BYTE* line = &src[(j + 2) * srcStep + 3 * 4];
+			winpr_RAND(line, size->srcWidth * 4);
+
+			for (i = 0; i < size->srcWidth * 4; i++)
+				line[i] = (BYTE)(64 + line[i] / 2);
+		}
+
+		if (!freerdp_image_scale(dst, PIXEL_FORMAT_BGRX32, dstStep, 3, 2, size->dstWidth,
+		                         size->dstHeight, src, PIXEL_FORMAT_BGRX32, srcStep, 3, 2,
+		                         size->srcWidth, size->srcHeight))
+			goto fail;
+
+		for (j = 0; j < size->dstHeight; j++)
+		{
+			for (i = 0; i < size->dstWidth; i++)
+			{
+				for (c = 0; c < 4; c++)
+				{
+					const BYTE value = dst[(j + 2) * dstStep + (i + 3) * 4 + c];
+
+					if ((value < 64) || (value > 64 + 127))
+					{
+						fprintf(stderr,
+						        "%" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32
+						        ": pixel %" PRIu32 ",%" PRIu32 " out of range\n",
+						        size->srcWidth, size->srcHeight, size->dstWidth,
+						        size->dstHeight, i, j);
+						goto fail;
+					}
+				}
+			}
+		}
+
+		free(src);
+		free(dst);
+		src = dst = NULL;
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst);
+	return rc;
+}
+
+/* Scaling an image tile by tile gives the same pixels as scaling it at once, and nothing
+ * outside of a tile is written */
+static BOOL test_scale_rect(DWORD SrcFormat, DWORD DstFormat)
+{
+	BOOL rc = FALSE;
+	size_t x;
+	const UINT32 srcBpp = GetBytesPerPixel(SrcFormat);
+	const UINT32 dstBpp = GetBytesPerPixel(DstFormat);
+	BYTE* src = NULL;
+	BYTE* full = NULL;
+	BYTE* tiled = NULL;
+
+	for (x = 0; x < ARRAYSIZE(test_sizes); x++)
+	{
+		const scale_test_size* size = &test_sizes[x];
+		const UINT32 srcStep = size->srcWidth * srcBpp;
+		const UINT32 dstStep = size->dstWidth * dstBpp;
+		const size_t dstSize = 1ull * dstStep * size->dstHeight;
+		const UINT32 tileWidth = (size->dstWidth + 2) / 3;
+		const UINT32 tileHeight = (size->dstHeight + 1) / 2;
+		UINT32 i, j;
+
+		src = malloc(1ull * srcStep * size->srcHeight);
+		full = calloc(1, dstSize);
+		tiled = calloc(1, dstSize);
+
+		if (!src || !full || !tiled)
+			goto fail;
+
+		winpr_RAND(src, 1ull * srcStep * size->srcHeight);
+
+		if (!freerdp_image_scale_rect(full, DstFormat, dstStep, 0, 0, size->dstWidth,
+		                              size->dstHeight, src, SrcFormat, srcStep, 0, 0,
+		                              size->srcWidth, size->srcHeight, 0, 0, size->dstWidth,
+		                              size->dstHeight))
+			goto fail;
+
+		for (j = 0; j < size->dstHeight; j += tileHeight)
+		{
+			for (i = 0; i < size->dstWidth; i += tileWidth)
+			{
+				const UINT32 w = MIN(tileWidth, size->dstWidth - i);
+				const UINT32 h = MIN(tileHeight, size->dstHeight - j);
+				UINT32 k;
+
+				if (!freerdp_image_scale_rect(tiled, DstFormat, dstStep, 0, 0, size->dstWidth,
+				                              size->dstHeight, src, SrcFormat, srcStep, 0, 0,
+				                              size->srcWidth, size->srcHeight, i, j, w, h))
+					goto fail;
+
+				/* the next tile is still empty */
+				for (k = 0; k < h; k++)
+				{
+					const size_t offset = 1ull * (j + k) * dstStep + 1ull * (i + w) * dstBpp;
+
+					if ((i + w < size->dstWidth) && (tiled[offset] != 0))
+					{
+						fprintf(stderr, "tile %" PRIu32 ",%" PRIu32 " written outside\n", i,
+						        j);
+						goto fail;
+					}
+				}
+			}
+		}
+
+		if (memcmp(full, tiled, dstSize) != 0)
+		{
+			fprintf(stderr,
+			        "%s -> %s %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32
+			        ": tiles differ from the whole image\n",
+			        FreeRDPGetColorFormatName(SrcFormat), FreeRDPGetColorFormatName(DstFormat),
+			        size->srcWidth, size->srcHeight, size->dstWidth, size->dstHeight);
+			goto fail;
+		}
+
+		free(src);
+		free(full);
+		free(tiled);
+		src = full = tiled = NULL;
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(full);
+	free(tiled);
+	return rc;
+}
+
+int TestFreeRDPCodecScale(int argc, char* argv[])
+{
+	const DWORD formats[][2] = {
+		{ PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRA32 },
+		{ PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGBX32 },
+		{ PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_BGRA32 },
+		{ PIXEL_FORMAT_RGB24, PIXEL_FORMAT_BGRX32 },
+		{ PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGR24 },
+		{ PIXEL_FORMAT_RGB16, PIXEL_FORMAT_RGB16 },
+	};
+	size_t x;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	for (x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		if (!test_scale_solid(formats[x][0], formats[x][1]))
+			return -1;
+
+		if (!test_scale_rect(formats[x][0], formats[x][1]))
+			return -1;
+	}
+
+	if (!test_scale_half())
+		return -1;
+
+	if (!test_scale_bounds())
+		return -1;
+
+	return 0;
+}
@@ -1,8 +1,12 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/codec/xcrush.h>
 
+#define XCRUSH_TEST_PACKET_SIZE 16000
+#define XCRUSH_TEST_PACKETS 128
+
 static const BYTE TEST_BELLS_DATA[] = "for.whom.the.bell.tolls,.the.bell.tolls.for.thee!";
 
 static const BYTE TEST_BELLS_DATA_XCRUSH[] =
@@ -136,6 +140,110 @@ static int test_XCrushCompressIsland(void)
 	return 1;
 }
 
+/* Packets that repeat pieces of earlier ones, mixed with fresh random data */
+static void test_XCrushFillData(BYTE* data, size_t size)
+{
+	size_t i = 0;
+	UINT32 seed = 0x5EED;
+
+	while (i < size)
+	{
+		size_t j;
+		size_t length;
+		seed = seed * 1103515245 + 12345;
+		length = MIN(((seed >> 8) % 600) + 16, size - i);
+
+		if ((i > 4096) && ((seed >> 4) % 4))
+		{
+			const size_t from = (seed >> 10) % (i - length);
+
+			for (j = 0; j < length; j++)
+				data[i + j] = data[from + j];
+		}
+		else
+		{
+			for (j = 0; j < length; j++)
+			{
+				seed = seed * 1103515245 + 12345;
+				data[i + j] = (BYTE)(seed >> 16);
+			}
+		}
+
+		i += length;
+	}
+}
+
+static int test_XCrushRoundtrip(void)
+{
+	size_t i;
+	int rc = -1;
+	UINT64 start, duration = 0;
+	size_t compressed = 0;
+	BYTE* data = malloc(XCRUSH_TEST_PACKET_SIZE * XCRUSH_TEST_PACKETS);
+	BYTE* buffer = malloc(XCRUSH_TEST_PACKET_SIZE + 2);
+	XCRUSH_CONTEXT* encoder = xcrush_context_new(TRUE);
+	XCRUSH_CONTEXT* decoder = xcrush_context_new(FALSE);
+
+	if (!data || !buffer || !encoder || !decoder)
+		goto fail;
+
+	test_XCrushFillData(data, XCRUSH_TEST_PACKET_SIZE * XCRUSH_TEST_PACKETS);
+
+	for (i = 0; i < XCRUSH_TEST_PACKETS; i++)
+	{
+		int status;
+		UINT32 Flags = 0;
+		UINT32 DstSize = XCRUSH_TEST_PACKET_SIZE + 2;
+		BYTE* pDstData = buffer;
+		const BYTE* pSrcData = &data[i * XCRUSH_TEST_PACKET_SIZE];
+		const BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+
+		start = GetTickCount64();
+		status = xcrush_compress(encoder, pSrcData, XCRUSH_TEST_PACKET_SIZE, &pDstData, &DstSize,
+		                         &Flags);
+		duration += GetTickCount64() - start;
+
+		if (status < 0)
+		{
+			printf("xcrush_compress failed with %d\n", status);
+			goto fail;
+		}
+
+		compressed += DstSize;
+
+		if (Flags & PACKET_COMPRESSED)
+		{
+			status = xcrush_decompress(decoder, pDstData, DstSize, &pOutData, &OutSize, Flags);
+
+			if (status < 0)
+				goto fail;
+		}
+		else
+		{
+			pOutData = pDstData;
+			OutSize = DstSize;
+		}
+
+		if ((OutSize != XCRUSH_TEST_PACKET_SIZE) || (memcmp(pOutData, pSrcData, OutSize) != 0))
+		{
+			printf("XCrush round trip mismatch in packet %" PRIuz "\n", i);
+			goto fail;
+		}
+	}
+
+	printf("XCrush: ratio %.3f, %.1f MB/s\n",
+	       (double)(XCRUSH_TEST_PACKET_SIZE * XCRUSH_TEST_PACKETS) / (double)compressed,
+	       (XCRUSH_TEST_PACKET_SIZE * XCRUSH_TEST_PACKETS) / 1000.0 / (double)MAX(duration, 1));
+	rc = 0;
+fail:
+	xcrush_context_free(encoder);
+	xcrush_context_free(decoder);
+	free(data);
+	free(buffer);
+	return rc;
+}
+
 int TestFreeRDPCodecXCrush(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -146,5 +254,8 @@ int TestFreeRDPCodecXCrush(int argc, char* argv[])
 	if (test_XCrushCompressIsland() < 0)
 		return -1;
 
+	if (test_XCrushRoundtrip() < 0)
+		return -1;
+
 	return 0;
 }
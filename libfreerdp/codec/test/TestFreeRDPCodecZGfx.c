@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,6 +254,351 @@ fail:
 	return rc;
 }
 
+static void test_ZGfxFillSurfaceLike(BYTE* data, size_t size, UINT32 seed)
+{
+	size_t x;
+
+	/* rows of a synthetic 32bpp desktop: flat areas, gradients and some noise */
+	for (x = 0; x < size; x++)
+	{
+		const size_t pixel = x / 4;
+		const size_t column = pixel % 256;
+
+		seed = seed * 1103515245 + 12345;
+
+		if (column < 96)
+			data[x] = 0xFF;
+		else if (column < 160)
+			data[x] = (BYTE)(column * (x % 4 + 1));
+		else if (column < 200)
+			data[x] = (BYTE)((pixel / 256) + (x % 4) * 17);
+		else
+			data[x] = (BYTE)(seed >> 16);
+	}
+}
+
+static BOOL test_ZGfxRoundtrip(ZGFX_CONTEXT* compressor, ZGFX_CONTEXT* decompressor,
+                               const BYTE* pSrcData, UINT32 SrcSize, UINT32* pCompressedSize)
+{
+	BOOL rc = FALSE;
+	UINT32 Flags = 0;
+	UINT32 DstSize = 0;
+	UINT32 CompressedSize = 0;
+	BYTE* pDstData = NULL;
+	BYTE* pCompressedData = NULL;
+
+	if (zgfx_compress(compressor, pSrcData, SrcSize, &pCompressedData, &CompressedSize, &Flags) <
+	    0)
+		goto fail;
+
+	if (zgfx_decompress(decompressor, pCompressedData, CompressedSize, &pDstData, &DstSize, Flags) <
+	    0)
+		goto fail;
+
+	if ((DstSize != SrcSize) || (memcmp(pDstData, pSrcData, SrcSize) != 0))
+	{
+		printf("test_ZGfxRoundtrip: output mismatch for %" PRIu32 " bytes\n", SrcSize);
+		goto fail;
+	}
+
+	if (pCompressedSize)
+		*pCompressedSize = CompressedSize;
+
+	rc = TRUE;
+fail:
+	free(pDstData);
+	free(pCompressedData);
+	return rc;
+}
+
+static int test_ZGfxCompressRoundtrip(void)
+{
+	int rc = -1;
+	UINT32 level;
+	const UINT32 sizes[] = { 1, 3, 4, 31, 4096, 65535, 65536, 200000 };
+	const size_t bufferSize = 200000;
+	BYTE* buffer = malloc(bufferSize);
+
+	if (!buffer)
+		return -1;
+
+	for (level = ZGFX_COMPRESSION_NONE; level <= ZGFX_COMPRESSION_LAZY; level++)
+	{
+		size_t x;
+		ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+		ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+		if (!compressor || !decompressor ||
+		    !zgfx_context_set_compression_level(compressor, level))
+		{
+			zgfx_context_free(compressor);
+			zgfx_context_free(decompressor);
+			goto fail;
+		}
+
+		/* repeated calls exercise matches into the history of previous PDUs */
+		for (x = 0; x < ARRAYSIZE(sizes) * 2; x++)
+		{
+			const UINT32 size = sizes[x % ARRAYSIZE(sizes)];
+			test_ZGfxFillSurfaceLike(buffer, size, (UINT32)(x / 3));
+
+			if (!test_ZGfxRoundtrip(compressor, decompressor, buffer, size, NULL))
+			{
+				printf("test_ZGfxCompressRoundtrip: level %" PRIu32 " failed\n", level);
+				zgfx_context_free(compressor);
+				zgfx_context_free(decompressor);
+				goto fail;
+			}
+		}
+
+		zgfx_context_free(compressor);
+		zgfx_context_free(decompressor);
+	}
+
+	rc = 0;
+fail:
+	free(buffer);
+	return rc;
+}
+
+/* the in place framing must produce the same packets as zgfx_compress */
+static int test_ZGfxCompressInPlace(void)
+{
+	int rc = -1;
+	UINT32 level;
+	const UINT32 sizes[] = { 1, 3, 31, 4096, 65535, 65536, 200000 };
+	const size_t headroom = zgfx_compress_headroom(200000);
+	BYTE* buffer = malloc(200000);
+	wStream* s = Stream_New(NULL, headroom + 200000);
+
+	if (!buffer || !s)
+		goto fail;
+
+	for (level = ZGFX_COMPRESSION_NONE; level <= ZGFX_COMPRESSION_LAZY; level++)
+	{
+		size_t x;
+		BOOL success = TRUE;
+		ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+		ZGFX_CONTEXT* reference = zgfx_context_new(TRUE);
+
+		if (!compressor || !reference || !zgfx_context_set_compression_level(compressor, level) ||
+		    !zgfx_context_set_compression_level(reference, level))
+			success = FALSE;
+
+		for (x = 0; success && (x < ARRAYSIZE(sizes) * 2); x++)
+		{
+			size_t start = 0;
+			UINT32 Flags = 0;
+			UINT32 RefFlags = 0;
+			UINT32 RefSize = 0;
+			BYTE* pRefData = NULL;
+			const UINT32 size = sizes[x % ARRAYSIZE(sizes)];
+			test_ZGfxFillSurfaceLike(buffer, size, (UINT32)(x / 3));
+			Stream_SetLength(s, Stream_Capacity(s));
+			Stream_SetPosition(s, headroom);
+			Stream_Write(s, buffer, size);
+
+			if ((zgfx_compress_in_place(compressor, s, headroom, &start, &Flags) != 1) ||
+			    (zgfx_compress(reference, buffer, size, &pRefData, &RefSize, &RefFlags) < 0) ||
+			    (Flags != RefFlags) || (Stream_GetPosition(s) - start != RefSize) ||
+			    (memcmp(Stream_Buffer(s) + start, pRefData, RefSize) != 0))
+			{
+				printf("test_ZGfxCompressInPlace: level %" PRIu32 " size %" PRIu32 " failed\n",
+				       level, size);
+				success = FALSE;
+			}
+
+			free(pRefData);
+		}
+
+		/* not enough headroom for a multipart packet */
+		Stream_SetLength(s, Stream_Capacity(s));
+		Stream_SetPosition(s, 2 + 70000);
+
+		if (success)
+		{
+			size_t start = 0;
+			UINT32 Flags = 0;
+			success = zgfx_compress_in_place(compressor, s, 2, &start, &Flags) == 0;
+		}
+
+		zgfx_context_free(compressor);
+		zgfx_context_free(reference);
+
+		if (!success)
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	Stream_Free(s, TRUE);
+	free(buffer);
+	return rc;
+}
+
+static int test_ZGfxCompressBenchmark(void)
+{
+	int rc = -1;
+	UINT32 level;
+	const UINT32 frameSize = 256 * 1024;
+	const UINT32 frames = 16;
+	BYTE* buffer = malloc(frameSize);
+
+	if (!buffer)
+		return -1;
+
+	for (level = ZGFX_COMPRESSION_NONE; level <= ZGFX_COMPRESSION_LAZY; level++)
+	{
+		UINT32 x;
+		UINT64 start, end;
+		UINT64 compressed = 0;
+		ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+		ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+		if (!compressor || !decompressor ||
+		    !zgfx_context_set_compression_level(compressor, level))
+		{
+			zgfx_context_free(compressor);
+			zgfx_context_free(decompressor);
+			goto fail;
+		}
+
+		start = GetTickCount64();
+
+		for (x = 0; x < frames; x++)
+		{
+			UINT32 CompressedSize = 0;
+			test_ZGfxFillSurfaceLike(buffer, frameSize, x);
+
+			if (!test_ZGfxRoundtrip(compressor, decompressor, buffer, frameSize,
+			                        &CompressedSize))
+			{
+				zgfx_context_free(compressor);
+				zgfx_context_free(decompressor);
+				goto fail;
+			}
+
+			compressed += CompressedSize;
+		}
+
+		end = GetTickCount64();
+		printf("zgfx level %" PRIu32 ": %" PRIu32 " bytes -> %" PRIu64 " bytes (%.1f%%), "
+		       "%" PRIu64 " ms round trip\n",
+		       level, frameSize * frames, compressed,
+		       100.0 * (double)compressed / (frameSize * frames), end - start);
+
+		zgfx_context_free(compressor);
+		zgfx_context_free(decompressor);
+
+		if ((level != ZGFX_COMPRESSION_NONE) && (compressed >= (UINT64)frameSize * frames))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(buffer);
+	return rc;
+}
+
+/* A receiver that reuses one stream only allocates while it grows to the largest message,
+ * zgfx_decompress allocates once per message */
+static int test_ZGfxDecompressToStream(void)
+{
+	int rc = -1;
+	UINT32 x;
+	const UINT32 frames = 64;
+	const UINT32 maxSize = 256 * 1024;
+	UINT64 start, end;
+	UINT64 streamTime = 0;
+	UINT64 mallocTime = 0;
+	size_t allocations = 0;
+	BYTE* buffer = malloc(maxSize);
+	BYTE** compressed = calloc(frames, sizeof(BYTE*));
+	UINT32* compressedSize = calloc(frames, sizeof(UINT32));
+	UINT32* frameSize = calloc(frames, sizeof(UINT32));
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+	ZGFX_CONTEXT* reference = zgfx_context_new(FALSE);
+	wStream* s = Stream_New(NULL, 1024);
+
+	if (!buffer || !compressed || !compressedSize || !frameSize || !compressor || !decompressor ||
+	    !reference || !s)
+		goto fail;
+
+	/* messages of varying size, some of them multipart */
+	for (x = 0; x < frames; x++)
+	{
+		UINT32 Flags = 0;
+		frameSize[x] = 1 + (x * 7919u) % maxSize;
+		test_ZGfxFillSurfaceLike(buffer, frameSize[x], x);
+
+		if (zgfx_compress(compressor, buffer, frameSize[x], &compressed[x], &compressedSize[x],
+		                  &Flags) < 0)
+			goto fail;
+	}
+
+	for (x = 0; x < frames; x++)
+	{
+		BYTE* pDstData = NULL;
+		UINT32 DstSize = 0;
+		const BYTE* last = Stream_Buffer(s);
+
+		start = GetTickCount64();
+		Stream_SetPosition(s, 0);
+
+		if (zgfx_decompress_to_stream(decompressor, compressed[x], compressedSize[x], s, 0) < 0)
+			goto fail;
+
+		end = GetTickCount64();
+		streamTime += end - start;
+
+		if (Stream_Buffer(s) != last)
+			allocations++;
+
+		if (zgfx_decompress(reference, compressed[x], compressedSize[x], &pDstData, &DstSize,
+		                    0) < 0)
+			goto fail;
+
+		mallocTime += GetTickCount64() - end;
+
+		if ((Stream_GetPosition(s) != frameSize[x]) || (DstSize != frameSize[x]) ||
+		    (memcmp(Stream_Buffer(s), pDstData, DstSize) != 0))
+		{
+			printf("test_ZGfxDecompressToStream: output mismatch for %" PRIu32 " bytes\n",
+			       frameSize[x]);
+			free(pDstData);
+			goto fail;
+		}
+
+		free(pDstData);
+	}
+
+	printf("zgfx decompress %" PRIu32 " messages: %" PRIuz " allocations and %" PRIu64
+	       " ms with a reused stream, %" PRIu32 " allocations and %" PRIu64 " ms without\n",
+	       frames, allocations, streamTime, frames, mallocTime);
+
+	if (allocations >= frames / 4)
+		goto fail;
+
+	rc = 0;
+fail:
+	if (compressed)
+	{
+		for (x = 0; x < frames; x++)
+			free(compressed[x]);
+	}
+
+	free(compressed);
+	free(compressedSize);
+	free(frameSize);
+	free(buffer);
+	Stream_Free(s, TRUE);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	zgfx_context_free(reference);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -270,5 +616,17 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressRoundtrip() < 0)
+		return -1;
+
+	if (test_ZGfxCompressInPlace() < 0)
+		return -1;
+
+	if (test_ZGfxCompressBenchmark() < 0)
+		return -1;
+
+	if (test_ZGfxDecompressToStream() < 0)
+		return -1;
+
 	return 0;
 }
@@ -19,6 +19,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/codec/region.h>
 
@@ -814,6 +815,295 @@ out:
 	return retCode;
 }
 
+static UINT64 region_area(const REGION16* region)
+{
+	UINT32 x, nbRects;
+	UINT64 area = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+
+	for (x = 0; x < nbRects; x++)
+		area += (UINT64)(rects[x].right - rects[x].left) * (rects[x].bottom - rects[x].top);
+
+	return area;
+}
+
+#define TEST_MAX_TILES (30 * 17)
+
+/* 64x64 tiles of a 1920x1080 surface in a few busy areas, as RemoteFX updates leave them */
+static UINT32 region_get_tiles(RECTANGLE_16* tiles, UINT32 seed)
+{
+	size_t i;
+	UINT16 x, y;
+	UINT32 count = 0;
+	const RECTANGLE_16 areas[] = { { 64, 64, 704, 512 },
+	                               { 1024, 128, 1856, 640 },
+	                               { 256, 704, 1408, 960 },
+	                               { 0, 1024, 1920, 1080 } };
+
+	for (y = 0; y < 1080; y += 64)
+	{
+		for (x = 0; x < 1920; x += 64)
+		{
+			const RECTANGLE_16 tile = { x, y, MIN(x + 64, 1920), MIN(y + 64, 1080) };
+
+			if (((x / 64 * 7 + y / 64 * 13 + seed) % 5) == 0)
+				continue;
+
+			for (i = 0; i < ARRAYSIZE(areas); i++)
+			{
+				if (!rectangles_intersects(&tile, &areas[i]))
+					continue;
+
+				tiles[count++] = tile;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+static BOOL region_add_tiles(REGION16* region, UINT32 seed)
+{
+	UINT32 x;
+	RECTANGLE_16 tiles[TEST_MAX_TILES];
+	const UINT32 count = region_get_tiles(tiles, seed);
+
+	for (x = 0; x < count; x++)
+	{
+		if (!region16_union_rect(region, region, &tiles[x]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* region16_union_rect may leave touching items in a band, only the covered pixels must match */
+static BOOL compareRegions(const REGION16* r1, const REGION16* r2)
+{
+	BOOL rc = FALSE;
+	UINT32 x, nbRects;
+	REGION16 inter;
+	const RECTANGLE_16* rects = region16_rects(r1, &nbRects);
+	region16_init(&inter);
+
+	if (!compareRectangles(region16_extents(r1), region16_extents(r2), 1))
+		goto out;
+
+	if (region_area(r1) != region_area(r2))
+		goto out;
+
+	for (x = 0; x < nbRects; x++)
+	{
+		if (!region16_intersect_rect(&inter, r2, &rects[x]))
+			goto out;
+
+		if (region_area(&inter) !=
+		    (UINT64)(rects[x].right - rects[x].left) * (rects[x].bottom - rects[x].top))
+			goto out;
+	}
+
+	rc = TRUE;
+out:
+	region16_uninit(&inter);
+	return rc;
+}
+
+/* overlapping rectangles of any size, as the caches and the solid fills leave them */
+static UINT32 region_get_random(RECTANGLE_16* rects, UINT32 count, UINT32 seed)
+{
+	UINT32 x;
+
+	for (x = 0; x < count; x++)
+	{
+		seed = seed * 1103515245 + 12345;
+		rects[x].left = (seed >> 8) % 1800;
+		rects[x].top = (seed >> 4) % 1000;
+		seed = seed * 1103515245 + 12345;
+		rects[x].right = rects[x].left + 1 + (seed >> 8) % 300;
+		rects[x].bottom = rects[x].top + 1 + (seed >> 4) % 200;
+	}
+
+	return count;
+}
+
+static int test_union_rects(void)
+{
+	REGION16 region, bulk;
+	RECTANGLE_16 rects[TEST_MAX_TILES];
+	const UINT32 rounds = 200;
+	int retCode = -1;
+	UINT32 x, y, count, nbRects;
+	UINT64 start, single, multi, intersect;
+	const RECTANGLE_16* regionRects;
+	region16_init(&region);
+	region16_init(&bulk);
+
+	for (x = 0; x < 16; x++)
+	{
+		count = (x % 2) ? region_get_random(rects, 64 + x, x) : region_get_tiles(rects, x);
+
+		/* union with an empty region, then with a region already set */
+		for (y = 0; y < 2; y++)
+		{
+			if (y == 0)
+				region16_clear(&region);
+			else
+				region_get_random(rects, count / 2, x + 100);
+
+			if (!region16_copy(&bulk, &region))
+				goto out;
+
+			for (nbRects = 0; nbRects < count; nbRects++)
+			{
+				if (!region16_union_rect(&region, &region, &rects[nbRects]))
+					goto out;
+			}
+
+			if (!region16_union_rects(&bulk, &bulk, rects, count))
+				goto out;
+
+			if (!compareRegions(&region, &bulk))
+			{
+				fprintf(stderr, "region16_union_rects differs from region16_union_rect\n");
+				goto out;
+			}
+		}
+	}
+
+	count = region_get_tiles(rects, 0);
+	start = GetTickCount64();
+
+	for (x = 0; x < rounds; x++)
+	{
+		region16_clear(&region);
+
+		for (y = 0; y < count; y++)
+		{
+			if (!region16_union_rect(&region, &region, &rects[y]))
+				goto out;
+		}
+	}
+
+	single = GetTickCount64() - start;
+	start = GetTickCount64();
+
+	for (x = 0; x < rounds; x++)
+	{
+		region16_clear(&bulk);
+
+		if (!region16_union_rects(&bulk, &bulk, rects, count))
+			goto out;
+	}
+
+	multi = GetTickCount64() - start;
+	regionRects = region16_rects(&region, &nbRects);
+	start = GetTickCount64();
+
+	for (x = 0; x < rounds; x++)
+	{
+		for (y = 0; y < count; y++)
+		{
+			if (!region16_intersect_rect(&bulk, &region, &rects[y]))
+				goto out;
+
+			if (!region16_intersects_rect(&region, &regionRects[y % nbRects]))
+				goto out;
+		}
+	}
+
+	intersect = GetTickCount64() - start;
+	printf("%" PRIu32 " tiles, %" PRIu32 " frames: union %" PRIu64 " ms, bulk union %" PRIu64
+	       " ms, intersections %" PRIu64 " ms\n",
+	       count, rounds, single, multi, intersect);
+	retCode = 0;
+out:
+	region16_uninit(&bulk);
+	region16_uninit(&region);
+	return retCode;
+}
+
+static int test_coalesce(void)
+{
+	REGION16 region, coalesced, inter;
+	const UINT32 limits[] = { 0, 256, 64, 16, 4, 1 };
+	const UINT32 rounds = 200;
+	int retCode = -1;
+	size_t i;
+	UINT32 x, nbRects;
+	const RECTANGLE_16* rects;
+	region16_init(&region);
+	region16_init(&coalesced);
+	region16_init(&inter);
+
+	if (!region_add_tiles(&region, 0))
+		goto out;
+
+	rects = region16_rects(&region, &nbRects);
+
+	for (i = 0; i < ARRAYSIZE(limits); i++)
+	{
+		UINT64 start, duration;
+
+		if (!region16_copy(&coalesced, &region))
+			goto out;
+
+		region16_coalesce(&coalesced, limits[i]);
+
+		if ((limits[i] > 0) && ((UINT32)region16_n_rects(&coalesced) > limits[i]))
+			goto out;
+
+		if (!compareRectangles(region16_extents(&coalesced), region16_extents(&region), 1))
+			goto out;
+
+		/* every tile must still be covered */
+		for (x = 0; x < nbRects; x++)
+		{
+			if (!region16_intersect_rect(&inter, &coalesced, &rects[x]))
+				goto out;
+
+			if (region_area(&inter) != (UINT64)(rects[x].right - rects[x].left) *
+			                               (rects[x].bottom - rects[x].top))
+				goto out;
+		}
+
+		/* the region must still be usable */
+		if (!region_add_tiles(&coalesced, 1))
+			goto out;
+
+		start = GetTickCount64();
+
+		for (x = 0; x < rounds; x++)
+		{
+			region16_clear(&coalesced);
+
+			if (!region_add_tiles(&coalesced, x))
+				goto out;
+
+			region16_coalesce(&coalesced, limits[i]);
+		}
+
+		duration = GetTickCount64() - start;
+
+		if (!region16_copy(&coalesced, &region))
+			goto out;
+
+		region16_coalesce(&coalesced, limits[i]);
+		printf("max %3" PRIu32 " rects: %3d of %3" PRIu32 " rects, overdraw %5.1f%%, %" PRIu64
+		       " ms per %" PRIu32 " frames\n",
+		       limits[i], region16_n_rects(&coalesced), nbRects,
+		       100.0 * (region_area(&coalesced) - region_area(&region)) / region_area(&region),
+		       duration, rounds);
+	}
+
+	retCode = 0;
+out:
+	region16_uninit(&inter);
+	region16_uninit(&coalesced);
+	region16_uninit(&region);
+	return retCode;
+}
+
 typedef int (*TestFunction)(void);
 struct UnitaryTest
 {
@@ -835,6 +1125,8 @@ static struct UnitaryTest tests[] = { { "Basic trivial tests", test_basic },
 	                                  { "norbert's case", test_norbert_case },
 	                                  { "norbert's case 2", test_norbert2_case },
 	                                  { "empty rectangle case", test_empty_rectangle },
+	                                  { "coalesce tiles", test_coalesce },
+	                                  { "union of many rectangles", test_union_rects },
 
 	                                  { NULL, NULL } };
 
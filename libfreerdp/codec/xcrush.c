@@ -24,12 +24,28 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/codec/xcrush.h>
 
+#if defined(WITH_SSE2)
+#include "xcrush_sse2.h"
+#include "xcrush_avx2.h"
+#endif
+
 #define TAG FREERDP_TAG("codec")
 
+/* The chunk table is 4 way set associative, each set holds the most recent chunks first */
+#define XCRUSH_CHUNK_TABLE_SIZE 65536
+#define XCRUSH_CHUNK_WAYS 4
+#define XCRUSH_CHUNK_EMPTY 0xFFFFFFFF
+
+/* A chunk ends where the top 7 bits of the rolling hash are zero, 128 bytes on average */
+#define XCRUSH_CHUNK_BOUNDARY_MASK 0xFE000000
+
+typedef UINT32 (*xcrush_compare_fkt)(const BYTE* data1, const BYTE* data2, UINT32 length);
+
 #pragma pack(push, 1)
 
 typedef struct
@@ -41,13 +57,13 @@ typedef struct
 
 typedef struct
 {
+	UINT32 seed;
 	UINT32 offset;
-	UINT32 next;
 } XCRUSH_CHUNK;
 
 typedef struct
 {
-	UINT16 seed;
+	UINT32 seed;
 	UINT16 size;
 } XCRUSH_SIGNATURE;
 
@@ -84,10 +100,8 @@ struct s_XCRUSH_CONTEXT
 	UINT32 SignatureCount;
 	XCRUSH_SIGNATURE Signatures[1000];
 
-	UINT32 ChunkHead;
-	UINT32 ChunkTail;
-	XCRUSH_CHUNK Chunks[65534];
-	UINT16 NextChunks[65536];
+	XCRUSH_CHUNK Chunks[XCRUSH_CHUNK_TABLE_SIZE];
+	xcrush_compare_fkt CompareBytes;
 
 	UINT32 OriginalMatchCount;
 	UINT32 OptimizedMatchCount;
@@ -162,31 +176,75 @@ static const char* xcrush_get_level_1_compression_flags_string(UINT32 flags)
 }
 #endif
 
+/* Random values for the gear rolling hash of xcrush_compute_chunks */
+static const UINT32 XCrushGearTable[256] = {
+	0x9DC4E295, 0xDEDE5F35, 0xAD35BF7A, 0xB8F75E7E, 0x56AE6301, 0x140AA0D7, 0x235BC2DE, 0xE0D68135,
+	0x926EDEB1, 0x882D6A5D, 0xDC992C9C, 0x6E06AE08, 0x0A1D9D9D, 0x8C5AA08D, 0xE2D0EA38, 0x0755AD36,
+	0xE19BB48C, 0xA05EAC9C, 0xE44A59AA, 0xBA6649C7, 0xE9421F75, 0x2369D1AE, 0x89CA4DDA, 0xF3CD1378,
+	0x6DC6D354, 0x03F27C25, 0x6BE8F950, 0xEDE84714, 0x3E420603, 0x3D34966B, 0xBF47AE52, 0xF275C44D,
+	0x82B0B61D, 0xF3E78E82, 0x8B016FF6, 0x8FC9ECB6, 0x7BAF2E10, 0x59C16364, 0x622BE1D8, 0xE4ACF169,
+	0x13EF8C39, 0xA1112BDD, 0xC80614BD, 0xC3051EF8, 0x5E84A1B1, 0x7F02A249, 0x5EAA839F, 0x4B1B98F3,
+	0x3008F737, 0x16945B5F, 0x32C862FE, 0x45401ECE, 0x25A36CEF, 0x8B7F1AD7, 0x0890E879, 0x00647732,
+	0x44BC82ED, 0xEDFE9937, 0x169B7DCC, 0x89C235DC, 0x935AA842, 0x6DC31B32, 0xCD5627B2, 0x59A77937,
+	0x1637DF55, 0xB1FEC8BA, 0x6C960F33, 0x1AF734B9, 0xA7AA6A9C, 0xD899211A, 0x2A30BABE, 0xB0A79E5F,
+	0x32E743E1, 0xC9B96AD4, 0x50EB223E, 0x7742814D, 0x53C35852, 0xCEEDDB51, 0x302961B5, 0x2379A5D0,
+	0x84D2981C, 0x2D6705FB, 0xB1FC9E58, 0xE163568E, 0x8CFAF11C, 0xF906B0DF, 0x1BF0F18B, 0x4454CDCD,
+	0x542D3497, 0x62C9A045, 0xFD2A9545, 0x4ED0C2A0, 0xF48E62C9, 0x2F21E29F, 0x8F8DBE7A, 0xAAB1F4A6,
+	0x0F09E343, 0xF6BC2EF6, 0x50C419AB, 0x21A4F301, 0xCBC4D74D, 0x534962AD, 0xF8A07CB1, 0x6513F1B3,
+	0x83E2C5A9, 0xCF5D6649, 0xC778BC7E, 0x756431E4, 0x2E86BB1D, 0x90E65307, 0x3560C5BD, 0x1811496B,
+	0x81E612AE, 0x12683ADD, 0x6CF58C03, 0xA71D4B6C, 0xAD945ABB, 0x648DB29E, 0x3F1703ED, 0x8FD8D9CF,
+	0x37834473, 0x82ADAB6D, 0xF224B012, 0x609078CB, 0xC9617E54, 0xAE3D602F, 0xF3AC60AC, 0x16F9C0F7,
+	0xBC400506, 0xE8AE16D2, 0x8AAA72CF, 0x03EB27B4, 0x8A9163F8, 0x71A61711, 0xE3392E4F, 0xABB8B195,
+	0x08F754F5, 0xBC1D7CAC, 0xD18B6E2F, 0xF272B732, 0xCC1C1BC4, 0x82EB5842, 0xE7A9F772, 0xAE0841E4,
+	0xCB7EC08C, 0xF7D96F45, 0x95D6D0C0, 0x70AB2EB6, 0xEEAF5F7E, 0xB6FF514D, 0x12A384E9, 0x2FFF5E5F,
+	0x8A1304D1, 0x2CB49964, 0xEAB03822, 0xEF0DEEE7, 0x059CF8C4, 0x238A8C0B, 0x9D835628, 0x5B36B6AB,
+	0x97AE55FC, 0xCB5D0D3E, 0x19CF3A43, 0x79B6F55A, 0xCA243744, 0x14502E33, 0x1D3F3DB8, 0xDA3A79A8,
+	0xD703482A, 0xE03A4AE7, 0xF08361F3, 0xB85BF650, 0x204D3E2D, 0xF8CEACF1, 0x1C368BC3, 0x0904743E,
+	0x04E3BCD6, 0x29D9A510, 0xFE35DE66, 0xEA0818C9, 0x82917A30, 0xC89956B5, 0x7645FD9D, 0x1BFA0254,
+	0x6740AB03, 0x1CC6BEA4, 0x6A69B00A, 0x8B11A6B9, 0x5BA29637, 0x19AE6E5A, 0x806C8CF9, 0xCAF9F975,
+	0xE25E8F56, 0x20DA4129, 0xC618ACC5, 0x9CCAB122, 0x1FA419A6, 0x23A74F4A, 0x814E2C90, 0x6175D1D7,
+	0x259FECF0, 0xB0356B60, 0x78F93C0B, 0x94AC3BCF, 0x0D19F310, 0x5E381174, 0xFF0AB9E6, 0xB9C2D9CB,
+	0x02CDA7DD, 0x9B6212D7, 0xD2AA68BA, 0x14E2E432, 0xEBA1FB9C, 0x1E94EE42, 0x435CC4FB, 0x17ECBCA8,
+	0xB2B8D50C, 0x5DD78E52, 0x404F181B, 0x3DD2307F, 0x1BBE57E1, 0x0B41CAD7, 0x385A06A6, 0x5641A19D,
+	0x5B3FA79A, 0xB435A81B, 0xE1941A0E, 0x918E762D, 0x21FE7A19, 0x76C31A19, 0xB8CB8CDD, 0x874EE198,
+	0x584145DB, 0xFE571AFF, 0x2ADD0DA7, 0x197B896C, 0xF405FAF4, 0xB2B000C4, 0x9F809F63, 0x81AD9370,
+	0x4763A859, 0xF0986671, 0x49BB34B9, 0xD47E1A7A, 0x3F904EC7, 0x68F8947B, 0x58F12C81, 0x4F86368A,
+	0xE314D849, 0xAAF221D5, 0xCCE682EC, 0xDCF90D16, 0xB9F7D872, 0x0A1D8784, 0xE22DEE43, 0xEA465559
+};
+
+/* FNV-1a over the words of the first 32 bytes of a chunk */
 static UINT32 xcrush_update_hash(const BYTE* data, UINT32 size)
 {
-	const BYTE* end;
-	UINT32 seed = 5381; /* same value as in djb2 */
+	UINT32 i;
+	UINT32 seed = 2166136261;
 
 	if (size > 32)
-	{
 		size = 32;
-		seed = 5413;
-	}
-
-	end = &data[size - 4];
 
-	while (data < end)
+	for (i = 0; i + 4 <= size; i += 4)
 	{
-		seed += (data[3] ^ data[0]) + (data[1] << 8);
-		data += 4;
+		seed ^= (UINT32)data[i] | ((UINT32)data[i + 1] << 8) | ((UINT32)data[i + 2] << 16) |
+		        ((UINT32)data[i + 3] << 24);
+		seed *= 16777619;
 	}
 
-	return (UINT16)seed;
+	return seed;
+}
+
+/* Number of equal leading bytes of data1 and data2, at most length */
+static UINT32 xcrush_compare_bytes(const BYTE* data1, const BYTE* data2, UINT32 length)
+{
+	UINT32 i = 0;
+
+	while ((i < length) && (data1[i] == data2[i]))
+		i++;
+
+	return i;
 }
 
 static int xcrush_append_chunk(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32* beg, UINT32 end)
 {
-	UINT16 seed;
+	UINT32 seed;
 	UINT32 size;
 
 	if (xcrush->SignatureIndex >= xcrush->SignatureCount)
@@ -199,7 +257,7 @@ static int xcrush_append_chunk(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT32*
 
 	if (size >= 15)
 	{
-		seed = xcrush_update_hash(&data[*beg], (UINT16)size);
+		seed = xcrush_update_hash(&data[*beg], size);
 		xcrush->Signatures[xcrush->SignatureIndex].size = size;
 		xcrush->Signatures[xcrush->SignatureIndex].seed = seed;
 		xcrush->SignatureIndex++;
@@ -214,58 +272,27 @@ static int xcrush_compute_chunks(XCRUSH_CONTEXT* xcrush, const BYTE* data, UINT3
 {
 	UINT32 i = 0;
 	UINT32 offset = 0;
-	UINT32 rotation = 0;
-	UINT32 accumulator = 0;
+	UINT32 hash = 0;
 	*pIndex = 0;
 	xcrush->SignatureIndex = 0;
 
 	if (size < 128)
 		return 0;
 
+	/**
+	 * Gear hash: a byte is shifted out of the state after 32 steps, so the bits
+	 * tested for a boundary depend on the last 32 bytes only.
+	 */
 	for (i = 0; i < 32; i++)
-	{
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i] ^ rotation;
-	}
+		hash = (hash << 1) + XCrushGearTable[data[i]];
 
-	for (i = 0; i < size - 64; i++)
+	for (; i < size - 32; i++)
 	{
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
+		hash = (hash << 1) + XCrushGearTable[data[i]];
 
-		if (!(accumulator & 0x7F))
+		if (!(hash & XCRUSH_CHUNK_BOUNDARY_MASK))
 		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
-
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
-
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
+			if (!xcrush_append_chunk(xcrush, data, &offset, i))
 				return 0;
 		}
 	}
@@ -289,116 +316,38 @@ static UINT32 xcrush_compute_signatures(XCRUSH_CONTEXT* xcrush, const BYTE* data
 	return 0;
 }
 
-static void xcrush_clear_hash_table_range(XCRUSH_CONTEXT* xcrush, UINT32 beg, UINT32 end)
-{
-	UINT32 index;
-
-	for (index = 0; index < 65536; index++)
-	{
-		if (xcrush->NextChunks[index] >= beg)
-		{
-			if (xcrush->NextChunks[index] <= end)
-			{
-				xcrush->NextChunks[index] = 0;
-			}
-		}
-	}
-
-	for (index = 0; index < 65534; index++)
-	{
-		if (xcrush->Chunks[index].next >= beg)
-		{
-			if (xcrush->Chunks[index].next <= end)
-			{
-				xcrush->Chunks[index].next = 0;
-			}
-		}
-	}
-}
-
-static int xcrush_find_next_matching_chunk(XCRUSH_CONTEXT* xcrush, XCRUSH_CHUNK* chunk,
-                                           XCRUSH_CHUNK** pNextChunk)
-{
-	UINT32 index;
-	XCRUSH_CHUNK* next = NULL;
-
-	if (!chunk)
-		return -4001; /* error */
-
-	if (chunk->next)
-	{
-		index = (chunk - xcrush->Chunks) / sizeof(XCRUSH_CHUNK);
-
-		if (index >= 65534)
-			return -4002; /* error */
-
-		if ((index < xcrush->ChunkHead) || (chunk->next >= xcrush->ChunkHead))
-		{
-			if (chunk->next >= 65534)
-				return -4003; /* error */
-
-			next = &xcrush->Chunks[chunk->next];
-		}
-	}
-
-	*pNextChunk = next;
-	return 1;
-}
-
-static int xcrush_insert_chunk(XCRUSH_CONTEXT* xcrush, XCRUSH_SIGNATURE* signature, UINT32 offset,
-                               XCRUSH_CHUNK** pPrevChunk)
+/**
+ * Returns the offsets of the earlier chunks with the same signature, most recent
+ * first, and inserts the new chunk in front of its set.
+ */
+static UINT32 xcrush_insert_chunk(XCRUSH_CONTEXT* xcrush, const XCRUSH_SIGNATURE* signature,
+                                  UINT32 offset, UINT32 Candidates[XCRUSH_CHUNK_WAYS])
 {
-	UINT32 seed;
-	UINT32 index;
-
-	if (xcrush->ChunkHead >= 65530)
-	{
-		xcrush->ChunkHead = 1;
-		xcrush->ChunkTail = 1;
-	}
+	UINT32 i;
+	UINT32 count = 0;
+	XCRUSH_CHUNK* set =
+	    &xcrush->Chunks[signature->seed & (XCRUSH_CHUNK_TABLE_SIZE - XCRUSH_CHUNK_WAYS)];
 
-	if (xcrush->ChunkHead >= xcrush->ChunkTail)
+	for (i = 0; i < XCRUSH_CHUNK_WAYS; i++)
 	{
-		xcrush_clear_hash_table_range(xcrush, xcrush->ChunkTail, xcrush->ChunkTail + 10000);
-		xcrush->ChunkTail += 10000;
+		if ((set[i].offset != XCRUSH_CHUNK_EMPTY) && (set[i].seed == signature->seed))
+			Candidates[count++] = set[i].offset;
 	}
 
-	index = xcrush->ChunkHead++;
-
-	if (xcrush->ChunkHead >= 65534)
-		return -3001; /* error */
-
-	xcrush->Chunks[index].offset = offset;
-	seed = signature->seed;
-
-	if (seed >= 65536)
-		return -3002; /* error */
-
-	if (xcrush->NextChunks[seed])
-	{
-		if (xcrush->NextChunks[seed] >= 65534)
-			return -3003; /* error */
-
-		*pPrevChunk = &xcrush->Chunks[xcrush->NextChunks[seed]];
-	}
-
-	xcrush->Chunks[index].next = xcrush->NextChunks[seed] & 0xFFFF;
-	xcrush->NextChunks[seed] = index;
-	return 1;
+	MoveMemory(&set[1], &set[0], sizeof(XCRUSH_CHUNK) * (XCRUSH_CHUNK_WAYS - 1));
+	set[0].seed = signature->seed;
+	set[0].offset = offset;
+	return count;
 }
 
 static int xcrush_find_match_length(XCRUSH_CONTEXT* xcrush, UINT32 MatchOffset, UINT32 ChunkOffset,
                                     UINT32 HistoryOffset, UINT32 SrcSize, UINT32 MaxMatchLength,
                                     XCRUSH_MATCH_INFO* MatchInfo)
 {
-	UINT32 MatchSymbol;
-	UINT32 ChunkSymbol;
 	BYTE* ChunkBuffer;
 	BYTE* MatchBuffer;
 	BYTE* MatchStartPtr;
-	BYTE* ForwardChunkPtr;
 	BYTE* ReverseChunkPtr;
-	BYTE* ForwardMatchPtr;
 	BYTE* ReverseMatchPtr;
 	BYTE* HistoryBufferEnd;
 	UINT32 ReverseMatchLength;
@@ -431,28 +380,17 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* xcrush, UINT32 MatchOffset,
 	if (ChunkBuffer < HistoryBuffer)
 		return -2005; /* error */
 
-	ForwardMatchPtr = &HistoryBuffer[MatchOffset];
-	ForwardChunkPtr = &HistoryBuffer[ChunkOffset];
-
 	if ((&MatchBuffer[MaxMatchLength + 1] < HistoryBufferEnd) &&
 	    (MatchBuffer[MaxMatchLength + 1] != ChunkBuffer[MaxMatchLength + 1]))
 	{
 		return 0;
 	}
 
-	while (1)
-	{
-		MatchSymbol = *ForwardMatchPtr++;
-		ChunkSymbol = *ForwardChunkPtr++;
-
-		if (MatchSymbol != ChunkSymbol)
-			break;
-
-		if (ForwardMatchPtr > HistoryBufferEnd)
-			break;
-
-		ForwardMatchLength++;
-	}
+	/* the match ends with the packet, the chunk side with the history buffer */
+	ForwardMatchLength =
+	    xcrush->CompareBytes(MatchBuffer, ChunkBuffer,
+	                         MIN((UINT32)(HistoryBufferEnd - MatchBuffer),
+	                             HistoryBufferSize - ChunkOffset));
 
 	ReverseMatchPtr = MatchBuffer - 1;
 	ReverseChunkPtr = ChunkBuffer - 1;
@@ -485,11 +423,12 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* xcrush, UINT32 SignatureIndex
 {
 	UINT32 i = 0;
 	UINT32 j = 0;
+	UINT32 k = 0;
 	int status = 0;
 	UINT32 offset = 0;
-	UINT32 ChunkIndex = 0;
 	UINT32 ChunkCount = 0;
-	XCRUSH_CHUNK* chunk = NULL;
+	UINT32 ChunkOffset = 0;
+	UINT32 Candidates[XCRUSH_CHUNK_WAYS] = { 0 };
 	UINT32 MatchLength = 0;
 	UINT32 MaxMatchLength = 0;
 	UINT32 PrevMatchEnd = 0;
@@ -505,23 +444,21 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* xcrush, UINT32 SignatureIndex
 		if (!Signatures[i].size)
 			return -1001; /* error */
 
-		status = xcrush_insert_chunk(xcrush, &Signatures[i], offset, &chunk);
-
-		if (status < 0)
-			return status;
+		ChunkCount = xcrush_insert_chunk(xcrush, &Signatures[i], offset, Candidates);
 
-		if (chunk && (SrcOffset + HistoryOffset + Signatures[i].size >= PrevMatchEnd))
+		if (ChunkCount && (SrcOffset + HistoryOffset + Signatures[i].size >= PrevMatchEnd))
 		{
-			ChunkCount = 0;
 			MaxMatchLength = 0;
 			ZeroMemory(&MaxMatchInfo, sizeof(XCRUSH_MATCH_INFO));
 
-			while (chunk)
+			for (k = 0; k < ChunkCount; k++)
 			{
-				if ((chunk->offset < HistoryOffset) || (chunk->offset < offset) ||
-				    (chunk->offset > SrcSize + HistoryOffset))
+				ChunkOffset = Candidates[k];
+
+				if ((ChunkOffset < HistoryOffset) || (ChunkOffset < offset) ||
+				    (ChunkOffset > SrcSize + HistoryOffset))
 				{
-					status = xcrush_find_match_length(xcrush, offset, chunk->offset, HistoryOffset,
+					status = xcrush_find_match_length(xcrush, offset, ChunkOffset, HistoryOffset,
 					                                  SrcSize, MaxMatchLength, &MatchInfo);
 
 					if (status < 0)
@@ -540,16 +477,6 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* xcrush, UINT32 SignatureIndex
 							break;
 					}
 				}
-
-				ChunkIndex = ChunkCount++;
-
-				if (ChunkIndex > 4)
-					break;
-
-				status = xcrush_find_next_matching_chunk(xcrush, chunk, &chunk);
-
-				if (status < 0)
-					return status; /* error */
 			}
 
 			if (MaxMatchLength)
@@ -1079,9 +1006,7 @@ void xcrush_context_reset(XCRUSH_CONTEXT* xcrush, BOOL flush)
 	xcrush->SignatureCount = 1000;
 	ZeroMemory(&(xcrush->Signatures), sizeof(XCRUSH_SIGNATURE) * xcrush->SignatureCount);
 	xcrush->CompressionFlags = 0;
-	xcrush->ChunkHead = xcrush->ChunkTail = 1;
-	ZeroMemory(&(xcrush->Chunks), sizeof(xcrush->Chunks));
-	ZeroMemory(&(xcrush->NextChunks), sizeof(xcrush->NextChunks));
+	FillMemory(&(xcrush->Chunks), sizeof(xcrush->Chunks), 0xFF);
 	ZeroMemory(&(xcrush->OriginalMatches), sizeof(xcrush->OriginalMatches));
 	ZeroMemory(&(xcrush->OptimizedMatches), sizeof(xcrush->OptimizedMatches));
 
@@ -1104,6 +1029,13 @@ XCRUSH_CONTEXT* xcrush_context_new(BOOL Compressor)
 		xcrush->mppc = mppc_context_new(1, Compressor);
 		xcrush->HistoryOffset = 0;
 		xcrush->HistoryBufferSize = 2000000;
+		xcrush->CompareBytes = xcrush_compare_bytes;
+#if defined(WITH_SSE2)
+		if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+			xcrush->CompareBytes = xcrush_compare_bytes_avx2;
+		else if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+			xcrush->CompareBytes = xcrush_compare_bytes_sse2;
+#endif
 		xcrush_context_reset(xcrush, FALSE);
 	}
 
@@ -0,0 +1,70 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * XCrush (RDP6.1) Bulk Data Compression - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <immintrin.h>
+
+#include "xcrush_avx2.h"
+
+static INLINE UINT32 xcrush_ctz32(UINT32 x)
+{
+#if defined(__GNUC__)
+	return (UINT32)__builtin_ctz(x);
+#else
+	UINT32 n = 0;
+
+	while (!(x & 1))
+	{
+		x >>= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+/* Number of equal leading bytes of data1 and data2, at most length */
+UINT32 xcrush_compare_bytes_avx2(const BYTE* data1, const BYTE* data2, UINT32 length)
+{
+	UINT32 i = 0;
+
+	for (; i + 32 <= length; i += 32)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i*)&data1[i]);
+		const __m256i b = _mm256_loadu_si256((const __m256i*)&data2[i]);
+		const UINT32 equal = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+
+		if (equal != 0xFFFFFFFF)
+			return i + xcrush_ctz32(~equal);
+	}
+
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)&data1[i]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)&data2[i]);
+		const UINT32 equal = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+
+		if (equal != 0xFFFF)
+			return i + xcrush_ctz32(~equal);
+	}
+
+	while ((i < length) && (data1[i] == data2[i]))
+		i++;
+
+	return i;
+}
@@ -0,0 +1,26 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * XCrush (RDP6.1) Bulk Data Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_XCRUSH_SSE2_H
+#define FREERDP_LIB_CODEC_XCRUSH_SSE2_H
+
+#include <winpr/wtypes.h>
+#include <freerdp/api.h>
+
+FREERDP_LOCAL UINT32 xcrush_compare_bytes_sse2(const BYTE* data1, const BYTE* data2, UINT32 length);
+
+#endif /* FREERDP_LIB_CODEC_XCRUSH_SSE2_H */
@@ -16,6 +16,12 @@ struct S_YUV_CONTEXT
 
 	PTP_POOL threadPool;
 	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+
+	/* kept between frames, see allocate_objects */
+	PTP_WORK* work_objects;
+	void* work_params;
+	UINT32 work_object_count;
+	size_t work_param_size;
 };
 
 typedef struct
@@ -182,6 +188,8 @@ void yuv_context_free(YUV_CONTEXT* context)
 			CloseThreadpool(context->threadPool);
 		DestroyThreadpoolEnvironment(&context->ThreadPoolEnv);
 	}
+	free(context->work_objects);
+	free(context->work_params);
 	free(context);
 }
 
@@ -207,29 +215,34 @@ static INLINE YUV_PROCESS_WORK_PARAM pool_decode_param(const RECTANGLE_16* rect,
 	return current;
 }
 
-static BOOL allocate_objects(PTP_WORK** work, void** params, size_t size, UINT32 count)
+/* The arrays only grow, so decoding frames of the same size does not allocate */
+static BOOL allocate_objects(YUV_CONTEXT* context, PTP_WORK** work, void** params, size_t size,
+                             UINT32 count)
 {
 	if (count == 0)
 		return FALSE;
 
 	count *= 2;
+	if (count > context->work_object_count)
 	{
-		PTP_WORK* tmp;
-		PTP_WORK* cur = *work;
-		tmp = realloc(cur, sizeof(PTP_WORK*) * count);
+		PTP_WORK* tmp = realloc(context->work_objects, sizeof(PTP_WORK) * count);
 		if (!tmp)
 			return FALSE;
-		*work = tmp;
-		memset(tmp, 0, sizeof(PTP_WORK*) * count);
+		context->work_objects = tmp;
+		context->work_object_count = count;
 	}
+	if (size * count > context->work_param_size)
 	{
-		void* cur = *params;
-		void* tmp = realloc(cur, size * count);
+		void* tmp = realloc(context->work_params, size * count);
 		if (!tmp)
 			return FALSE;
-		memset(tmp, 0, size * count);
-		*params = tmp;
+		context->work_params = tmp;
+		context->work_param_size = size * count;
 	}
+	memset(context->work_objects, 0, sizeof(PTP_WORK) * count);
+	memset(context->work_params, 0, size * count);
+	*work = context->work_objects;
+	*params = context->work_params;
 	return TRUE;
 }
 
@@ -247,7 +260,7 @@ static BOOL submit_object(PTP_WORK* work_object, PTP_WORK_CALLBACK cb, const voi
 	return TRUE;
 }
 
-static void free_objects(PTP_WORK* work_objects, void* params, UINT32 waitCount)
+static void free_objects(PTP_WORK* work_objects, UINT32 waitCount)
 {
 	if (work_objects)
 	{
@@ -260,9 +273,6 @@ static void free_objects(PTP_WORK* work_objects, void* params, UINT32 waitCount)
 			CloseThreadpoolWork(work_objects[i]);
 		}
 	}
-
-	free(work_objects);
-	free(params);
 }
 
 static BOOL pool_decode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE* pYUVData[3],
@@ -293,7 +303,8 @@ static BOOL pool_decode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 	steps = MAX((context->nthreads + numRegionRects / 2 + 1) / numRegionRects, 1);
 	nobjects = numRegionRects * steps;
 
-	if (!allocate_objects(&work_objects, (void**)&params, sizeof(YUV_PROCESS_WORK_PARAM), nobjects))
+	if (!allocate_objects(context, &work_objects, (void**)&params, sizeof(YUV_PROCESS_WORK_PARAM),
+	                      nobjects))
 		goto fail;
 
 	for (x = 0; x < numRegionRects; x++)
@@ -325,7 +336,7 @@ static BOOL pool_decode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 	}
 	rc = TRUE;
 fail:
-	free_objects(work_objects, params, nobjects);
+	free_objects(work_objects, nobjects);
 	return rc;
 }
 
@@ -421,7 +432,7 @@ static BOOL pool_decode_rect(YUV_CONTEXT* context, BYTE type, const BYTE* pYUVDa
 	}
 
 	/* case where we use threads */
-	if (!allocate_objects(&work_objects, (void**)&params, sizeof(YUV_COMBINE_WORK_PARAM),
+	if (!allocate_objects(context, &work_objects, (void**)&params, sizeof(YUV_COMBINE_WORK_PARAM),
 	                      numRegionRects))
 		goto fail;
 
@@ -437,7 +448,7 @@ static BOOL pool_decode_rect(YUV_CONTEXT* context, BYTE type, const BYTE* pYUVDa
 
 	rc = TRUE;
 fail:
-	free_objects(work_objects, params, waitCount);
+	free_objects(work_objects, waitCount);
 	return rc;
 }
 
@@ -635,9 +646,12 @@ static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 		waitCount += steps;
 	}
 
-	if (!allocate_objects(&work_objects, (void**)&params, sizeof(YUV_ENCODE_WORK_PARAM), nobjects))
+	if (!allocate_objects(context, &work_objects, (void**)&params, sizeof(YUV_ENCODE_WORK_PARAM),
+	                      nobjects))
 		goto fail;
 
+	waitCount = 0;
+
 	for (x = 0; x < numRegionRects; x++)
 	{
 		const RECTANGLE_16* rect = &regionRects[x];
@@ -659,7 +673,7 @@ static BOOL pool_encode(YUV_CONTEXT* context, PTP_WORK_CALLBACK cb, const BYTE*
 
 	rc = TRUE;
 fail:
-	free_objects(work_objects, params, waitCount);
+	free_objects(work_objects, waitCount);
 	return rc;
 }
 
@@ -67,8 +67,46 @@ struct S_ZGFX_CONTEXT
 	BYTE HistoryBuffer[2500000];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	UINT32 CompressionLevel;
+	UINT32* HashHead;
+	UINT32* HashChain;
+	BYTE* CompressBuffer; /* output of a segment compressed in place, see zgfx_compress_in_place */
+	BYTE LiteralBits[256];
+	UINT16 LiteralCode[256];
 };
 
+/**
+ * Compressor tuning:
+ *
+ * The match finder uses hash chains over the history ring, keyed by the next
+ * three bytes. Chain entries are ring indices, the distance of a candidate is
+ * derived from the current ring position and must grow strictly while walking
+ * a chain, which makes stale entries harmless.
+ */
+
+#define ZGFX_HASH_BITS 16
+#define ZGFX_HASH_SIZE (1 << ZGFX_HASH_BITS)
+#define ZGFX_HASH_NIL UINT32_MAX
+
+#define ZGFX_MIN_MATCH 3
+#define ZGFX_MAX_UNENCODED 32767
+#define ZGFX_MIN_UNENCODED 32
+
+#define ZGFX_FAST_CHAIN_DEPTH 16
+#define ZGFX_FAST_NICE_LENGTH 258
+#define ZGFX_FAST_MAX_INSERT 32
+#define ZGFX_LAZY_CHAIN_DEPTH 128
+#define ZGFX_LAZY_NICE_LENGTH 1024
+
+typedef struct
+{
+	BYTE* pbOutput;
+	UINT64 Accumulator;
+	UINT32 AccumulatorBits;
+	size_t TotalBits;
+} ZGFX_BIT_WRITER;
+
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	// len code vbits type  vbase
 	{ 1, 0, 8, 0, 0 },           // 0
@@ -360,15 +398,17 @@ static BOOL zgfx_decompress_segment(ZGFX_CONTEXT* zgfx, wStream* stream, size_t
 	return TRUE;
 }
 
-int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
-                    UINT32* pDstSize, UINT32 flags)
+int zgfx_decompress_to_stream(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize,
+                              wStream* sDst, UINT32 flags)
 {
 	int status = -1;
 	BYTE descriptor;
 	wStream sbuffer = { 0 };
 	wStream* stream = Stream_StaticConstInit(&sbuffer, pSrcData, SrcSize);
 
-	if (!stream)
+	WINPR_UNUSED(flags);
+
+	if (!stream || !sDst)
 		return -1;
 
 	if (Stream_GetRemainingLength(stream) < 1)
@@ -381,16 +421,11 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BY
 		if (!zgfx_decompress_segment(zgfx, stream, Stream_GetRemainingLength(stream)))
 			goto fail;
 
-		*ppDstData = NULL;
-
-		if (zgfx->OutputCount > 0)
-			*ppDstData = (BYTE*)malloc(zgfx->OutputCount);
-
-		if (!*ppDstData)
+		if ((zgfx->OutputCount == 0) ||
+		    !Stream_EnsureRemainingCapacity(sDst, zgfx->OutputCount))
 			goto fail;
 
-		*pDstSize = zgfx->OutputCount;
-		CopyMemory(*ppDstData, zgfx->OutputBuffer, zgfx->OutputCount);
+		Stream_Write(sDst, zgfx->OutputBuffer, zgfx->OutputCount);
 	}
 	else if (descriptor == ZGFX_SEGMENTED_MULTIPART)
 	{
@@ -398,7 +433,6 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BY
 		UINT16 segmentNumber;
 		UINT16 segmentCount;
 		UINT32 uncompressedSize;
-		BYTE* pConcatenated;
 		size_t used = 0;
 
 		if (Stream_GetRemainingLength(stream) < 6)
@@ -410,14 +444,9 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BY
 		if (Stream_GetRemainingLength(stream) / sizeof(UINT32) < segmentCount)
 			goto fail;
 
-		pConcatenated = (BYTE*)malloc(uncompressedSize);
-
-		if (!pConcatenated)
+		if (!Stream_EnsureRemainingCapacity(sDst, uncompressedSize))
 			goto fail;
 
-		*ppDstData = pConcatenated;
-		*pDstSize = uncompressedSize;
-
 		for (segmentNumber = 0; segmentNumber < segmentCount; segmentNumber++)
 		{
 			if (Stream_GetRemainingLength(stream) < sizeof(UINT32))
@@ -434,10 +463,12 @@ int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BY
 			if (used + zgfx->OutputCount > uncompressedSize)
 				goto fail;
 
-			CopyMemory(pConcatenated, zgfx->OutputBuffer, zgfx->OutputCount);
-			pConcatenated += zgfx->OutputCount;
+			Stream_Write(sDst, zgfx->OutputBuffer, zgfx->OutputCount);
 			used += zgfx->OutputCount;
 		}
+
+		/* the size announced is the size of the data, missing segments are zeroed */
+		Stream_Zero(sDst, uncompressedSize - used);
 	}
 	else
 	{
@@ -449,18 +480,405 @@ fail:
 	return status;
 }
 
+int zgfx_decompress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
+                    UINT32* pDstSize, UINT32 flags)
+{
+	int status;
+	wStream* s = Stream_New(NULL, 1024);
+
+	if (!s)
+		return -1;
+
+	status = zgfx_decompress_to_stream(zgfx, pSrcData, SrcSize, s, flags);
+
+	if ((status < 0) || (Stream_GetPosition(s) > UINT32_MAX))
+	{
+		Stream_Free(s, TRUE);
+		return -1;
+	}
+
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = (UINT32)Stream_GetPosition(s);
+	Stream_Free(s, FALSE);
+	return status;
+}
+
+static INLINE void zgfx_write_bits(ZGFX_BIT_WRITER* bw, UINT32 value, UINT32 nbits)
+{
+	bw->Accumulator = (bw->Accumulator << nbits) | value;
+	bw->AccumulatorBits += nbits;
+	bw->TotalBits += nbits;
+
+	while (bw->AccumulatorBits >= 8)
+	{
+		bw->AccumulatorBits -= 8;
+		*bw->pbOutput++ = (BYTE)(bw->Accumulator >> bw->AccumulatorBits);
+	}
+}
+
+static INLINE UINT32 zgfx_align_bits(const ZGFX_BIT_WRITER* bw)
+{
+	return (8 - (bw->TotalBits % 8)) % 8;
+}
+
+static INLINE UINT32 zgfx_count_bits(UINT32 count)
+{
+	UINT32 extra = 2;
+	UINT32 base = 4;
+
+	if (count == 3)
+		return 1;
+
+	while (count >= base * 2)
+	{
+		base *= 2;
+		extra++;
+	}
+
+	return 2 * extra;
+}
+
+static INLINE const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	size_t index;
+
+	for (index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
+
+		if (token->tokenType != 1)
+			continue;
+
+		if ((distance - token->valueBase) < (1UL << token->valueBits))
+			return token;
+	}
+
+	return NULL;
+}
+
+static INLINE UINT32 zgfx_match_bits(UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+
+	if (!token)
+		return UINT32_MAX;
+
+	return token->prefixLength + token->valueBits + zgfx_count_bits(count);
+}
+
+static INLINE void zgfx_write_literal(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, BYTE c)
+{
+	zgfx_write_bits(bw, zgfx->LiteralCode[c], zgfx->LiteralBits[c]);
+}
+
+static INLINE void zgfx_write_match(ZGFX_BIT_WRITER* bw, UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+	UINT32 extra = 2;
+	UINT32 base = 4;
+
+	zgfx_write_bits(bw, token->prefixCode, token->prefixLength);
+	zgfx_write_bits(bw, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+	{
+		zgfx_write_bits(bw, 0, 1);
+		return;
+	}
+
+	zgfx_write_bits(bw, 1, 1);
+
+	while (count >= base * 2)
+	{
+		zgfx_write_bits(bw, 1, 1);
+		base *= 2;
+		extra++;
+	}
+
+	zgfx_write_bits(bw, 0, 1);
+	zgfx_write_bits(bw, count - base, extra);
+}
+
+static INLINE void zgfx_write_unencoded(ZGFX_BIT_WRITER* bw, const BYTE* src, UINT32 count)
+{
+	/* distance 0 with the shortest match prefix marks unencoded bytes */
+	zgfx_write_bits(bw, ZGFX_TOKEN_TABLE[1].prefixCode, ZGFX_TOKEN_TABLE[1].prefixLength);
+	zgfx_write_bits(bw, 0, ZGFX_TOKEN_TABLE[1].valueBits);
+	zgfx_write_bits(bw, count, 15);
+	zgfx_write_bits(bw, 0, zgfx_align_bits(bw));
+	CopyMemory(bw->pbOutput, src, count);
+	bw->pbOutput += count;
+	bw->TotalBits += 8ULL * count;
+}
+
+static void zgfx_write_literals(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, const BYTE* src,
+                                UINT32 count)
+{
+	while (count > 0)
+	{
+		UINT32 index;
+		size_t literalBits = 0;
+		const UINT32 run = MIN(count, ZGFX_MAX_UNENCODED);
+
+		if (run >= ZGFX_MIN_UNENCODED)
+		{
+			for (index = 0; index < run; index++)
+				literalBits += zgfx->LiteralBits[src[index]];
+		}
+
+		if (run >= ZGFX_MIN_UNENCODED && (ZGFX_TOKEN_TABLE[1].prefixLength +
+		                                  ZGFX_TOKEN_TABLE[1].valueBits + 15 + 7 + 8ULL * run) <
+		                                     literalBits)
+			zgfx_write_unencoded(bw, src, run);
+		else
+		{
+			for (index = 0; index < run; index++)
+				zgfx_write_literal(zgfx, bw, src[index]);
+		}
+
+		src += run;
+		count -= run;
+	}
+}
+
+static INLINE UINT32 zgfx_hash(const ZGFX_CONTEXT* zgfx, UINT32 index)
+{
+	const UINT32 size = zgfx->HistoryBufferSize;
+	const BYTE* history = zgfx->HistoryBuffer;
+	UINT32 value;
+
+	if (index + 2 < size)
+		value = ((UINT32)history[index] << 16) | ((UINT32)history[index + 1] << 8) |
+		        history[index + 2];
+	else
+		value = ((UINT32)history[index] << 16) | ((UINT32)history[(index + 1) % size] << 8) |
+		        history[(index + 2) % size];
+
+	return (UINT32)(value * 2654435761U) >> (32 - ZGFX_HASH_BITS);
+}
+
+static INLINE void zgfx_hash_insert(ZGFX_CONTEXT* zgfx, UINT32 index)
+{
+	const UINT32 hash = zgfx_hash(zgfx, index);
+	zgfx->HashChain[index] = zgfx->HashHead[hash];
+	zgfx->HashHead[hash] = index;
+}
+
+static INLINE UINT32 zgfx_match_length(const ZGFX_CONTEXT* zgfx, UINT32 candidate, UINT32 index,
+                                       UINT32 maxLength)
+{
+	const UINT32 size = zgfx->HistoryBufferSize;
+	const BYTE* history = zgfx->HistoryBuffer;
+	UINT32 length = 0;
+
+	if ((candidate + maxLength <= size) && (index + maxLength <= size))
+	{
+		const BYTE* a = &history[candidate];
+		const BYTE* b = &history[index];
+
+		while ((length + 8 <= maxLength) && (memcmp(&a[length], &b[length], 8) == 0))
+			length += 8;
+
+		while ((length < maxLength) && (a[length] == b[length]))
+			length++;
+
+		return length;
+	}
+
+	while ((length < maxLength) && (history[candidate] == history[index]))
+	{
+		length++;
+
+		if (++candidate == size)
+			candidate = 0;
+
+		if (++index == size)
+			index = 0;
+	}
+
+	return length;
+}
+
+static UINT32 zgfx_find_match(const ZGFX_CONTEXT* zgfx, UINT32 index, UINT32 maxLength,
+                              UINT32 maxDistance, UINT32* pDistance)
+{
+	const UINT32 size = zgfx->HistoryBufferSize;
+	const BOOL lazy = zgfx->CompressionLevel >= ZGFX_COMPRESSION_LAZY;
+	UINT32 depth = lazy ? ZGFX_LAZY_CHAIN_DEPTH : ZGFX_FAST_CHAIN_DEPTH;
+	const UINT32 niceLength = lazy ? ZGFX_LAZY_NICE_LENGTH : ZGFX_FAST_NICE_LENGTH;
+	UINT32 candidate = zgfx->HashHead[zgfx_hash(zgfx, index)];
+	UINT32 lastDistance = 0;
+	UINT32 bestLength = 0;
+
+	while ((candidate != ZGFX_HASH_NIL) && (depth-- > 0))
+	{
+		UINT32 length;
+		const UINT32 distance = (index + size - candidate) % size;
+
+		if ((distance <= lastDistance) || (distance > maxDistance))
+			break;
+
+		lastDistance = distance;
+		length = zgfx_match_length(zgfx, candidate, index, maxLength);
+
+		if (length > bestLength)
+		{
+			bestLength = length;
+			*pDistance = distance;
+
+			if (length >= niceLength)
+				break;
+		}
+
+		candidate = zgfx->HashChain[candidate];
+	}
+
+	return bestLength;
+}
+
+static INLINE BOOL zgfx_match_worthwhile(const ZGFX_CONTEXT* zgfx, const BYTE* src, UINT32 length,
+                                         UINT32 distance)
+{
+	UINT32 index;
+	UINT32 literalBits = 0;
+
+	if (length < ZGFX_MIN_MATCH)
+		return FALSE;
+
+	if (length > 8)
+		return TRUE;
+
+	for (index = 0; index < length; index++)
+		literalBits += zgfx->LiteralBits[src[index]];
+
+	return zgfx_match_bits(distance, length) < literalBits;
+}
+
+static size_t zgfx_encode_segment(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* bw, const BYTE* pSrcData,
+                                  UINT32 SrcSize, UINT32 start)
+{
+	UINT32 i = 0;
+	UINT32 literalStart = 0;
+	UINT32 length = 0;
+	UINT32 distance = 0;
+	BOOL pending = FALSE;
+	const UINT32 size = zgfx->HistoryBufferSize;
+	const BOOL lazy = zgfx->CompressionLevel >= ZGFX_COMPRESSION_LAZY;
+
+	while (i < SrcSize)
+	{
+		const UINT32 index = (start + i) % size;
+		const UINT32 remaining = SrcSize - i;
+		/* bytes not yet produced by the decoder must not be referenced */
+		const UINT32 maxDistance = size - remaining;
+
+		if (remaining < ZGFX_MIN_MATCH)
+			break;
+
+		if (!pending)
+			length = zgfx_find_match(zgfx, index, remaining, maxDistance, &distance);
+
+		pending = FALSE;
+
+		if (!zgfx_match_worthwhile(zgfx, &pSrcData[i], length, distance))
+		{
+			zgfx_hash_insert(zgfx, index);
+			i++;
+			continue;
+		}
+
+		zgfx_hash_insert(zgfx, index);
+
+		if (lazy && (length < ZGFX_LAZY_NICE_LENGTH) && (remaining > ZGFX_MIN_MATCH))
+		{
+			UINT32 nextDistance = 0;
+			const UINT32 nextLength = zgfx_find_match(zgfx, (index + 1) % size, remaining - 1,
+			                                          maxDistance + 1, &nextDistance);
+
+			if ((nextLength > length) &&
+			    zgfx_match_worthwhile(zgfx, &pSrcData[i + 1], nextLength, nextDistance))
+			{
+				length = nextLength;
+				distance = nextDistance;
+				pending = TRUE;
+				i++;
+				continue;
+			}
+		}
+
+		zgfx_write_literals(zgfx, bw, &pSrcData[literalStart], i - literalStart);
+		zgfx_write_match(bw, distance, length);
+
+		/* greedy mode does not index the inside of long matches */
+		if (!lazy && (length > ZGFX_FAST_MAX_INSERT))
+			i += length;
+		else
+		{
+			for (i++, length--; length > 0; i++, length--)
+			{
+				if (i + ZGFX_MIN_MATCH <= SrcSize)
+					zgfx_hash_insert(zgfx, (start + i) % size);
+			}
+		}
+
+		literalStart = i;
+	}
+
+	zgfx_write_literals(zgfx, bw, &pSrcData[literalStart], SrcSize - literalStart);
+	return bw->TotalBits;
+}
+
+/* literals are at most 9 bits, plus header, alignment and padding count */
+#define ZGFX_SEGMENT_BOUND(size) (1 + ((size)*9ULL + 7) / 8 + 2)
+
+/* the history must already contain the segment, returns the compressed size or 0 */
+static size_t zgfx_compress_segment_data(ZGFX_CONTEXT* zgfx, BYTE* pDstData, const BYTE* pSrcData,
+                                         UINT32 SrcSize, UINT32 start)
+{
+	size_t bits;
+	size_t DstSize;
+	UINT32 padding;
+	ZGFX_BIT_WRITER bw = { 0 };
+
+	if ((zgfx->CompressionLevel == ZGFX_COMPRESSION_NONE) || (SrcSize <= ZGFX_MIN_MATCH))
+		return 0;
+
+	bw.pbOutput = pDstData;
+	bits = zgfx_encode_segment(zgfx, &bw, pSrcData, SrcSize, start);
+	padding = zgfx_align_bits(&bw);
+	zgfx_write_bits(&bw, 0, padding);
+	*bw.pbOutput++ = (BYTE)padding;
+	DstSize = (bits + padding) / 8 + 1;
+	return (DstSize < SrcSize) ? DstSize : 0;
+}
+
 static BOOL zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pSrcData,
                                   UINT32 SrcSize, UINT32* pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
-	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
+	BYTE flags = ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
+	const UINT32 start = zgfx->HistoryIndex;
+	size_t DstSize;
+
+	if (!Stream_EnsureRemainingCapacity(s, ZGFX_SEGMENT_BOUND(SrcSize)))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
 		return FALSE;
 	}
 
-	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
-	Stream_Write_UINT8(s, (*pFlags));         /* header (1 byte) */
+	zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+	DstSize = zgfx_compress_segment_data(zgfx, Stream_Pointer(s) + 1, pSrcData, SrcSize, start);
+
+	if (DstSize > 0)
+	{
+		flags |= PACKET_COMPRESSED;
+		(*pFlags) |= flags;
+		Stream_Write_UINT8(s, flags); /* header (1 byte) */
+		Stream_Seek(s, DstSize);
+		return TRUE;
+	}
+
+	(*pFlags) |= flags;
+	Stream_Write_UINT8(s, flags); /* header (1 byte) */
 	Stream_Write(s, pSrcData, SrcSize);
 	return TRUE;
 }
@@ -559,9 +977,149 @@ int zgfx_compress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BYTE
 	return status;
 }
 
+size_t zgfx_compress_headroom(size_t uncompressedSize)
+{
+	const size_t segments = (uncompressedSize + ZGFX_SEGMENTED_MAXSIZE - 1) / ZGFX_SEGMENTED_MAXSIZE;
+
+	/* descriptor and header of a single segment */
+	if (segments <= 1)
+		return 2;
+
+	/* descriptor, segmentCount, uncompressedSize and size and header of every segment */
+	return 7 + segments * 5;
+}
+
+/**
+ * The segments are written from the front of the headroom on. The framing of a segment is five
+ * bytes and the headroom holds five bytes per segment, so the output never reaches the part of
+ * the data that was not consumed yet. Compressed segments are encoded into CompressBuffer first.
+ */
+int zgfx_compress_in_place(ZGFX_CONTEXT* zgfx, wStream* s, size_t offset, size_t* pStart,
+                           UINT32* pFlags)
+{
+	BYTE* out;
+	const BYTE* src;
+	size_t headroom;
+	size_t remaining;
+	UINT16 segments;
+
+	if (!zgfx || !zgfx->Compressor || !s || !pStart || !pFlags)
+		return -1;
+
+	if (Stream_GetPosition(s) < offset)
+		return -1;
+
+	remaining = Stream_GetPosition(s) - offset;
+	headroom = zgfx_compress_headroom(remaining);
+
+	if ((remaining > UINT32_MAX) || (headroom > offset) || (headroom > 7 + UINT16_MAX * 5))
+		return 0;
+
+	if (!zgfx->CompressBuffer)
+	{
+		zgfx->CompressBuffer = (BYTE*)malloc(ZGFX_SEGMENT_BOUND(ZGFX_SEGMENTED_MAXSIZE));
+
+		if (!zgfx->CompressBuffer)
+			return -1;
+	}
+
+	*pStart = offset - headroom;
+	out = Stream_Buffer(s) + *pStart;
+	src = Stream_Buffer(s) + offset;
+	segments = (UINT16)((headroom - 7) / 5);
+
+	if (headroom == 2)
+		*out++ = ZGFX_SEGMENTED_SINGLE;
+	else
+	{
+		*out++ = ZGFX_SEGMENTED_MULTIPART;
+		Data_Write_UINT16(out, segments);
+		Data_Write_UINT32(out + 2, (UINT32)remaining);
+		out += 6;
+	}
+
+	do
+	{
+		const UINT32 SrcSize =
+		    (UINT32)((remaining > ZGFX_SEGMENTED_MAXSIZE) ? ZGFX_SEGMENTED_MAXSIZE : remaining);
+		const UINT32 start = zgfx->HistoryIndex;
+		BYTE flags = ZGFX_PACKET_COMPR_TYPE_RDP8;
+		BYTE* segment = (headroom == 2) ? out : out + 4;
+		size_t DstSize;
+
+		zgfx_history_buffer_ring_write(zgfx, src, SrcSize);
+		DstSize = zgfx_compress_segment_data(zgfx, zgfx->CompressBuffer, src, SrcSize, start);
+
+		if (DstSize > 0)
+		{
+			flags |= PACKET_COMPRESSED;
+			MoveMemory(segment + 1, zgfx->CompressBuffer, DstSize);
+		}
+		else
+		{
+			DstSize = SrcSize;
+			MoveMemory(segment + 1, src, DstSize);
+		}
+
+		if (headroom != 2)
+			Data_Write_UINT32(out, (UINT32)(DstSize + 1)); /* size (4 bytes) */
+
+		segment[0] = flags; /* header (1 byte) */
+		(*pFlags) |= flags;
+		out = segment + 1 + DstSize;
+		src += SrcSize;
+		remaining -= SrcSize;
+	} while (remaining > 0);
+
+	Stream_SetPosition(s, (size_t)(out - Stream_Buffer(s)));
+	Stream_SealLength(s);
+	return 1;
+}
+
 void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+
+	if (zgfx->HashHead)
+		FillMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32), 0xFF);
+}
+
+BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level)
+{
+	if (!zgfx || !zgfx->Compressor || (level > ZGFX_COMPRESSION_LAZY))
+		return FALSE;
+
+	zgfx->CompressionLevel = level;
+	return TRUE;
+}
+
+static void zgfx_init_literal_codes(ZGFX_CONTEXT* zgfx)
+{
+	size_t index;
+	UINT32 c;
+
+	/* generic literal: prefix followed by the raw byte */
+	for (c = 0; c < 256; c++)
+	{
+		zgfx->LiteralBits[c] = ZGFX_TOKEN_TABLE[0].prefixLength + ZGFX_TOKEN_TABLE[0].valueBits;
+		zgfx->LiteralCode[c] =
+		    (ZGFX_TOKEN_TABLE[0].prefixCode << ZGFX_TOKEN_TABLE[0].valueBits) | c;
+	}
+
+	/* dedicated short codes for frequent bytes */
+	for (index = 1; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
+
+		if ((token->tokenType != 0) || (token->valueBits != 0))
+			continue;
+
+		if (token->prefixLength < zgfx->LiteralBits[token->valueBase])
+		{
+			zgfx->LiteralBits[token->valueBase] = token->prefixLength;
+			zgfx->LiteralCode[token->valueBase] = token->prefixCode;
+		}
+	}
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -573,6 +1131,22 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	{
 		zgfx->Compressor = Compressor;
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+
+		if (Compressor)
+		{
+			zgfx->CompressionLevel = ZGFX_COMPRESSION_FAST;
+			zgfx->HashHead = (UINT32*)calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+			zgfx->HashChain = (UINT32*)calloc(zgfx->HistoryBufferSize, sizeof(UINT32));
+
+			if (!zgfx->HashHead || !zgfx->HashChain)
+			{
+				zgfx_context_free(zgfx);
+				return NULL;
+			}
+
+			zgfx_init_literal_codes(zgfx);
+		}
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -581,5 +1155,11 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->HashHead);
+	free(zgfx->HashChain);
+	free(zgfx->CompressBuffer);
 	free(zgfx);
 }
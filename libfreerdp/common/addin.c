@@ -27,13 +27,94 @@
 #include <winpr/path.h>
 #include <winpr/string.h>
 #include <winpr/library.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
 
 #include <freerdp/addin.h>
 #include <freerdp/build-config.h>
+#include <freerdp/utils/trace.h>
 
 #include <freerdp/log.h>
 #define TAG FREERDP_TAG("addin")
 
+/**
+ * Dynamic add-ins are never unloaded, so the entry found in a library stays
+ * valid for the lifetime of the process. Remember it, and remember libraries
+ * that do not exist, so reconnects and subsystem fallbacks (rdpsnd, audin, ...)
+ * do not probe the file system again.
+ */
+static INIT_ONCE addin_cache_once = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION addin_cache_lock;
+static wHashTable* addin_cache = NULL; /* "path|entry" -> PVIRTUALCHANNELENTRY */
+static const BYTE addin_cache_missing = 0;
+
+static BOOL CALLBACK freerdp_addin_cache_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	if (!(addin_cache = HashTable_New(FALSE)))
+		return FALSE;
+
+	if (!HashTable_SetupForStringData(addin_cache, FALSE) ||
+	    !InitializeCriticalSectionAndSpinCount(&addin_cache_lock, 4000))
+	{
+		HashTable_Free(addin_cache);
+		addin_cache = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static PVIRTUALCHANNELENTRY freerdp_load_library_entry(LPCSTR pszFilePath, LPCSTR pszEntryName)
+{
+	char* key = NULL;
+	size_t cchKey;
+	const void* cached;
+	HINSTANCE library;
+	PVIRTUALCHANNELENTRY entry = NULL;
+
+	if (!InitOnceExecuteOnce(&addin_cache_once, freerdp_addin_cache_init, NULL, NULL))
+		return NULL;
+
+	cchKey = strlen(pszFilePath) + strlen(pszEntryName) + 2;
+
+	if (!(key = (char*)malloc(cchKey)))
+		return NULL;
+
+	sprintf_s(key, cchKey, "%s|%s", pszFilePath, pszEntryName);
+	EnterCriticalSection(&addin_cache_lock);
+	cached = HashTable_GetItemValue(addin_cache, key);
+
+	if (cached)
+	{
+		if (cached != &addin_cache_missing)
+			entry = (PVIRTUALCHANNELENTRY)cached;
+
+		goto out;
+	}
+
+	library = LoadLibraryX(pszFilePath);
+
+	if (library)
+	{
+		entry = (PVIRTUALCHANNELENTRY)GetProcAddress(library, pszEntryName);
+
+		if (!entry)
+			FreeLibrary(library);
+	}
+
+	if (!HashTable_Insert(addin_cache, key, entry ? (const void*)entry : &addin_cache_missing))
+		WLog_WARN(TAG, "Failed to cache add-in %s", key);
+
+out:
+	LeaveCriticalSection(&addin_cache_lock);
+	free(key);
+	return entry;
+}
+
 static INLINE BOOL is_path_required(LPCSTR path, size_t len)
 {
 	if (!path || (len <= 1))
@@ -143,7 +224,6 @@ PVIRTUALCHANNELENTRY freerdp_load_dynamic_addin(LPCSTR pszFileName, LPCSTR pszPa
 	BOOL bHasExt = TRUE;
 	PCSTR pszExt;
 	size_t cchExt = 0;
-	HINSTANCE library = NULL;
 	size_t cchFileName;
 	size_t cchFilePath;
 	LPSTR pszAddinFile = NULL;
@@ -223,21 +303,15 @@ PVIRTUALCHANNELENTRY freerdp_load_dynamic_addin(LPCSTR pszFileName, LPCSTR pszPa
 	else
 		pszFilePath = _strdup(pszRelativeFilePath);
 
-	library = LoadLibraryX(pszFilePath);
-
-	if (!library)
+	if (!pszFilePath)
 		goto fail;
 
-	entry = (PVIRTUALCHANNELENTRY)GetProcAddress(library, pszEntryName);
+	entry = freerdp_load_library_entry(pszFilePath, pszEntryName);
 fail:
 	free(pszRelativeFilePath);
 	free(pszAddinFile);
 	free(pszFilePath);
 	free(pszAddinInstallPath);
-
-	if (!entry && library)
-		FreeLibrary(library);
-
 	return entry;
 }
 
@@ -368,6 +442,7 @@ PVIRTUALCHANNELENTRY freerdp_load_channel_addin_entry(LPCSTR pszName, LPCSTR psz
                                                       LPCSTR pszType, DWORD dwFlags)
 {
 	PVIRTUALCHANNELENTRY entry = NULL;
+	FREERDP_TRACE_SPAN_BEGIN(span);
 
 	if (freerdp_load_static_channel_addin_entry)
 		entry = freerdp_load_static_channel_addin_entry(pszName, pszSubsystem, pszType, dwFlags);
@@ -375,6 +450,8 @@ PVIRTUALCHANNELENTRY freerdp_load_channel_addin_entry(LPCSTR pszName, LPCSTR psz
 	if (!entry)
 		entry = freerdp_load_dynamic_channel_addin_entry(pszName, pszSubsystem, pszType, dwFlags);
 
+	FREERDP_TRACE_SPAN_END(span, "freerdp_load_channel_addin_entry");
+
 	if (!entry)
 		WLog_WARN(TAG, "Failed to load channel %s [%s]", pszName, pszSubsystem);
 
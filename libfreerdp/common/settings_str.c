@@ -1,5 +1,10 @@
 /* Generated by  */
 
+#include <stddef.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+
 #include <freerdp/settings.h>
 #include <freerdp/log.h>
 
@@ -12,413 +17,743 @@ struct settings_str_entry
 	size_t id;
 	size_t type;
 	const char* str;
+	size_t offset;
 };
 static const struct settings_str_entry settings_map[] = {
-	{ FreeRDP_AllowCacheWaitingList, 0, "FreeRDP_AllowCacheWaitingList" },
-	{ FreeRDP_AllowDesktopComposition, 0, "FreeRDP_AllowDesktopComposition" },
-	{ FreeRDP_AllowFontSmoothing, 0, "FreeRDP_AllowFontSmoothing" },
-	{ FreeRDP_AllowUnanouncedOrdersFromServer, 0, "FreeRDP_AllowUnanouncedOrdersFromServer" },
-	{ FreeRDP_AltSecFrameMarkerSupport, 0, "FreeRDP_AltSecFrameMarkerSupport" },
-	{ FreeRDP_AsyncChannels, 0, "FreeRDP_AsyncChannels" },
-	{ FreeRDP_AsyncInput, 0, "FreeRDP_AsyncInput" },
-	{ FreeRDP_AsyncUpdate, 0, "FreeRDP_AsyncUpdate" },
-	{ FreeRDP_AudioCapture, 0, "FreeRDP_AudioCapture" },
-	{ FreeRDP_AudioPlayback, 0, "FreeRDP_AudioPlayback" },
-	{ FreeRDP_Authentication, 0, "FreeRDP_Authentication" },
-	{ FreeRDP_AuthenticationOnly, 0, "FreeRDP_AuthenticationOnly" },
-	{ FreeRDP_AutoAcceptCertificate, 0, "FreeRDP_AutoAcceptCertificate" },
-	{ FreeRDP_AutoDenyCertificate, 0, "FreeRDP_AutoDenyCertificate" },
-	{ FreeRDP_AutoLogonEnabled, 0, "FreeRDP_AutoLogonEnabled" },
-	{ FreeRDP_AutoReconnectionEnabled, 0, "FreeRDP_AutoReconnectionEnabled" },
-	{ FreeRDP_BitmapCacheEnabled, 0, "FreeRDP_BitmapCacheEnabled" },
-	{ FreeRDP_BitmapCachePersistEnabled, 0, "FreeRDP_BitmapCachePersistEnabled" },
-	{ FreeRDP_BitmapCacheV3Enabled, 0, "FreeRDP_BitmapCacheV3Enabled" },
-	{ FreeRDP_BitmapCompressionDisabled, 0, "FreeRDP_BitmapCompressionDisabled" },
-	{ FreeRDP_CertificateCallbackPreferPEM, 0, "FreeRDP_CertificateCallbackPreferPEM" },
-	{ FreeRDP_CertificateUseKnownHosts, 0, "FreeRDP_CertificateUseKnownHosts" },
-	{ FreeRDP_ColorPointerFlag, 0, "FreeRDP_ColorPointerFlag" },
-	{ FreeRDP_CompressionEnabled, 0, "FreeRDP_CompressionEnabled" },
-	{ FreeRDP_ConsoleSession, 0, "FreeRDP_ConsoleSession" },
-	{ FreeRDP_CredentialsFromStdin, 0, "FreeRDP_CredentialsFromStdin" },
-	{ FreeRDP_DeactivateClientDecoding, 0, "FreeRDP_DeactivateClientDecoding" },
-	{ FreeRDP_Decorations, 0, "FreeRDP_Decorations" },
-	{ FreeRDP_DesktopResize, 0, "FreeRDP_DesktopResize" },
-	{ FreeRDP_DeviceRedirection, 0, "FreeRDP_DeviceRedirection" },
-	{ FreeRDP_DisableCredentialsDelegation, 0, "FreeRDP_DisableCredentialsDelegation" },
-	{ FreeRDP_DisableCtrlAltDel, 0, "FreeRDP_DisableCtrlAltDel" },
-	{ FreeRDP_DisableCursorBlinking, 0, "FreeRDP_DisableCursorBlinking" },
-	{ FreeRDP_DisableCursorShadow, 0, "FreeRDP_DisableCursorShadow" },
-	{ FreeRDP_DisableFullWindowDrag, 0, "FreeRDP_DisableFullWindowDrag" },
-	{ FreeRDP_DisableMenuAnims, 0, "FreeRDP_DisableMenuAnims" },
-	{ FreeRDP_DisableRemoteAppCapsCheck, 0, "FreeRDP_DisableRemoteAppCapsCheck" },
-	{ FreeRDP_DisableThemes, 0, "FreeRDP_DisableThemes" },
-	{ FreeRDP_DisableWallpaper, 0, "FreeRDP_DisableWallpaper" },
-	{ FreeRDP_DrawAllowColorSubsampling, 0, "FreeRDP_DrawAllowColorSubsampling" },
-	{ FreeRDP_DrawAllowDynamicColorFidelity, 0, "FreeRDP_DrawAllowDynamicColorFidelity" },
-	{ FreeRDP_DrawAllowSkipAlpha, 0, "FreeRDP_DrawAllowSkipAlpha" },
-	{ FreeRDP_DrawGdiPlusCacheEnabled, 0, "FreeRDP_DrawGdiPlusCacheEnabled" },
-	{ FreeRDP_DrawGdiPlusEnabled, 0, "FreeRDP_DrawGdiPlusEnabled" },
-	{ FreeRDP_DrawNineGridEnabled, 0, "FreeRDP_DrawNineGridEnabled" },
-	{ FreeRDP_DumpRemoteFx, 0, "FreeRDP_DumpRemoteFx" },
-	{ FreeRDP_DynamicDaylightTimeDisabled, 0, "FreeRDP_DynamicDaylightTimeDisabled" },
-	{ FreeRDP_DynamicResolutionUpdate, 0, "FreeRDP_DynamicResolutionUpdate" },
-	{ FreeRDP_EmbeddedWindow, 0, "FreeRDP_EmbeddedWindow" },
-	{ FreeRDP_EnableWindowsKey, 0, "FreeRDP_EnableWindowsKey" },
-	{ FreeRDP_EncomspVirtualChannel, 0, "FreeRDP_EncomspVirtualChannel" },
-	{ FreeRDP_ExtSecurity, 0, "FreeRDP_ExtSecurity" },
-	{ FreeRDP_ExternalCertificateManagement, 0, "FreeRDP_ExternalCertificateManagement" },
-	{ FreeRDP_FIPSMode, 0, "FreeRDP_FIPSMode" },
-	{ FreeRDP_FastPathInput, 0, "FreeRDP_FastPathInput" },
-	{ FreeRDP_FastPathOutput, 0, "FreeRDP_FastPathOutput" },
-	{ FreeRDP_ForceEncryptedCsPdu, 0, "FreeRDP_ForceEncryptedCsPdu" },
-	{ FreeRDP_ForceMultimon, 0, "FreeRDP_ForceMultimon" },
-	{ FreeRDP_FrameMarkerCommandEnabled, 0, "FreeRDP_FrameMarkerCommandEnabled" },
-	{ FreeRDP_Fullscreen, 0, "FreeRDP_Fullscreen" },
-	{ FreeRDP_GatewayBypassLocal, 0, "FreeRDP_GatewayBypassLocal" },
-	{ FreeRDP_GatewayEnabled, 0, "FreeRDP_GatewayEnabled" },
-	{ FreeRDP_GatewayHttpTransport, 0, "FreeRDP_GatewayHttpTransport" },
-	{ FreeRDP_GatewayHttpUseWebsockets, 0, "FreeRDP_GatewayHttpUseWebsockets" },
-	{ FreeRDP_GatewayRpcTransport, 0, "FreeRDP_GatewayRpcTransport" },
-	{ FreeRDP_GatewayUdpTransport, 0, "FreeRDP_GatewayUdpTransport" },
-	{ FreeRDP_GatewayUseSameCredentials, 0, "FreeRDP_GatewayUseSameCredentials" },
-	{ FreeRDP_GfxAVC444, 0, "FreeRDP_GfxAVC444" },
-	{ FreeRDP_GfxAVC444v2, 0, "FreeRDP_GfxAVC444v2" },
-	{ FreeRDP_GfxH264, 0, "FreeRDP_GfxH264" },
-	{ FreeRDP_GfxPlanar, 0, "FreeRDP_GfxPlanar" },
-	{ FreeRDP_GfxProgressive, 0, "FreeRDP_GfxProgressive" },
-	{ FreeRDP_GfxProgressiveV2, 0, "FreeRDP_GfxProgressiveV2" },
-	{ FreeRDP_GfxSendQoeAck, 0, "FreeRDP_GfxSendQoeAck" },
-	{ FreeRDP_GfxSmallCache, 0, "FreeRDP_GfxSmallCache" },
-	{ FreeRDP_GfxThinClient, 0, "FreeRDP_GfxThinClient" },
-	{ FreeRDP_GrabKeyboard, 0, "FreeRDP_GrabKeyboard" },
-	{ FreeRDP_GrabMouse, 0, "FreeRDP_GrabMouse" },
-	{ FreeRDP_HasExtendedMouseEvent, 0, "FreeRDP_HasExtendedMouseEvent" },
-	{ FreeRDP_HasHorizontalWheel, 0, "FreeRDP_HasHorizontalWheel" },
-	{ FreeRDP_HasMonitorAttributes, 0, "FreeRDP_HasMonitorAttributes" },
-	{ FreeRDP_HiDefRemoteApp, 0, "FreeRDP_HiDefRemoteApp" },
-	{ FreeRDP_IPv6Enabled, 0, "FreeRDP_IPv6Enabled" },
-	{ FreeRDP_IgnoreCertificate, 0, "FreeRDP_IgnoreCertificate" },
-	{ FreeRDP_JpegCodec, 0, "FreeRDP_JpegCodec" },
-	{ FreeRDP_ListMonitors, 0, "FreeRDP_ListMonitors" },
-	{ FreeRDP_LocalConnection, 0, "FreeRDP_LocalConnection" },
-	{ FreeRDP_LogonErrors, 0, "FreeRDP_LogonErrors" },
-	{ FreeRDP_LogonNotify, 0, "FreeRDP_LogonNotify" },
-	{ FreeRDP_LongCredentialsSupported, 0, "FreeRDP_LongCredentialsSupported" },
-	{ FreeRDP_LyncRdpMode, 0, "FreeRDP_LyncRdpMode" },
-	{ FreeRDP_MaximizeShell, 0, "FreeRDP_MaximizeShell" },
-	{ FreeRDP_MouseAttached, 0, "FreeRDP_MouseAttached" },
-	{ FreeRDP_MouseHasWheel, 0, "FreeRDP_MouseHasWheel" },
-	{ FreeRDP_MouseMotion, 0, "FreeRDP_MouseMotion" },
-	{ FreeRDP_MouseUseRelativeMove, 0, "FreeRDP_MouseUseRelativeMove" },
-	{ FreeRDP_MstscCookieMode, 0, "FreeRDP_MstscCookieMode" },
-	{ FreeRDP_MultiTouchGestures, 0, "FreeRDP_MultiTouchGestures" },
-	{ FreeRDP_MultiTouchInput, 0, "FreeRDP_MultiTouchInput" },
-	{ FreeRDP_NSCodec, 0, "FreeRDP_NSCodec" },
-	{ FreeRDP_NSCodecAllowDynamicColorFidelity, 0, "FreeRDP_NSCodecAllowDynamicColorFidelity" },
-	{ FreeRDP_NSCodecAllowSubsampling, 0, "FreeRDP_NSCodecAllowSubsampling" },
-	{ FreeRDP_NegotiateSecurityLayer, 0, "FreeRDP_NegotiateSecurityLayer" },
-	{ FreeRDP_NetworkAutoDetect, 0, "FreeRDP_NetworkAutoDetect" },
-	{ FreeRDP_NlaSecurity, 0, "FreeRDP_NlaSecurity" },
-	{ FreeRDP_NoBitmapCompressionHeader, 0, "FreeRDP_NoBitmapCompressionHeader" },
-	{ FreeRDP_OldLicenseBehaviour, 0, "FreeRDP_OldLicenseBehaviour" },
-	{ FreeRDP_PasswordIsSmartcardPin, 0, "FreeRDP_PasswordIsSmartcardPin" },
-	{ FreeRDP_PercentScreenUseHeight, 0, "FreeRDP_PercentScreenUseHeight" },
-	{ FreeRDP_PercentScreenUseWidth, 0, "FreeRDP_PercentScreenUseWidth" },
-	{ FreeRDP_PlayRemoteFx, 0, "FreeRDP_PlayRemoteFx" },
-	{ FreeRDP_PreferIPv6OverIPv4, 0, "FreeRDP_PreferIPv6OverIPv4" },
-	{ FreeRDP_PrintReconnectCookie, 0, "FreeRDP_PrintReconnectCookie" },
-	{ FreeRDP_PromptForCredentials, 0, "FreeRDP_PromptForCredentials" },
-	{ FreeRDP_RdpSecurity, 0, "FreeRDP_RdpSecurity" },
-	{ FreeRDP_RedirectClipboard, 0, "FreeRDP_RedirectClipboard" },
-	{ FreeRDP_RedirectDrives, 0, "FreeRDP_RedirectDrives" },
-	{ FreeRDP_RedirectHomeDrive, 0, "FreeRDP_RedirectHomeDrive" },
-	{ FreeRDP_RedirectParallelPorts, 0, "FreeRDP_RedirectParallelPorts" },
-	{ FreeRDP_RedirectPrinters, 0, "FreeRDP_RedirectPrinters" },
-	{ FreeRDP_RedirectSerialPorts, 0, "FreeRDP_RedirectSerialPorts" },
-	{ FreeRDP_RedirectSmartCards, 0, "FreeRDP_RedirectSmartCards" },
-	{ FreeRDP_RefreshRect, 0, "FreeRDP_RefreshRect" },
-	{ FreeRDP_RemdeskVirtualChannel, 0, "FreeRDP_RemdeskVirtualChannel" },
-	{ FreeRDP_RemoteAppLanguageBarSupported, 0, "FreeRDP_RemoteAppLanguageBarSupported" },
-	{ FreeRDP_RemoteApplicationMode, 0, "FreeRDP_RemoteApplicationMode" },
-	{ FreeRDP_RemoteAssistanceMode, 0, "FreeRDP_RemoteAssistanceMode" },
-	{ FreeRDP_RemoteAssistanceRequestControl, 0, "FreeRDP_RemoteAssistanceRequestControl" },
-	{ FreeRDP_RemoteConsoleAudio, 0, "FreeRDP_RemoteConsoleAudio" },
-	{ FreeRDP_RemoteFxCodec, 0, "FreeRDP_RemoteFxCodec" },
-	{ FreeRDP_RemoteFxImageCodec, 0, "FreeRDP_RemoteFxImageCodec" },
-	{ FreeRDP_RemoteFxOnly, 0, "FreeRDP_RemoteFxOnly" },
-	{ FreeRDP_RestrictedAdminModeRequired, 0, "FreeRDP_RestrictedAdminModeRequired" },
-	{ FreeRDP_SaltedChecksum, 0, "FreeRDP_SaltedChecksum" },
-	{ FreeRDP_SendPreconnectionPdu, 0, "FreeRDP_SendPreconnectionPdu" },
-	{ FreeRDP_ServerMode, 0, "FreeRDP_ServerMode" },
-	{ FreeRDP_SmartSizing, 0, "FreeRDP_SmartSizing" },
-	{ FreeRDP_SmartcardEmulation, 0, "FreeRDP_SmartcardEmulation" },
-	{ FreeRDP_SmartcardLogon, 0, "FreeRDP_SmartcardLogon" },
-	{ FreeRDP_SoftwareGdi, 0, "FreeRDP_SoftwareGdi" },
-	{ FreeRDP_SoundBeepsEnabled, 0, "FreeRDP_SoundBeepsEnabled" },
-	{ FreeRDP_SpanMonitors, 0, "FreeRDP_SpanMonitors" },
-	{ FreeRDP_SupportAsymetricKeys, 0, "FreeRDP_SupportAsymetricKeys" },
-	{ FreeRDP_SupportDisplayControl, 0, "FreeRDP_SupportDisplayControl" },
-	{ FreeRDP_SupportDynamicChannels, 0, "FreeRDP_SupportDynamicChannels" },
-	{ FreeRDP_SupportDynamicTimeZone, 0, "FreeRDP_SupportDynamicTimeZone" },
-	{ FreeRDP_SupportEchoChannel, 0, "FreeRDP_SupportEchoChannel" },
-	{ FreeRDP_SupportErrorInfoPdu, 0, "FreeRDP_SupportErrorInfoPdu" },
-	{ FreeRDP_SupportGeometryTracking, 0, "FreeRDP_SupportGeometryTracking" },
-	{ FreeRDP_SupportGraphicsPipeline, 0, "FreeRDP_SupportGraphicsPipeline" },
-	{ FreeRDP_SupportHeartbeatPdu, 0, "FreeRDP_SupportHeartbeatPdu" },
-	{ FreeRDP_SupportMonitorLayoutPdu, 0, "FreeRDP_SupportMonitorLayoutPdu" },
-	{ FreeRDP_SupportMultitransport, 0, "FreeRDP_SupportMultitransport" },
-	{ FreeRDP_SupportSSHAgentChannel, 0, "FreeRDP_SupportSSHAgentChannel" },
-	{ FreeRDP_SupportStatusInfoPdu, 0, "FreeRDP_SupportStatusInfoPdu" },
-	{ FreeRDP_SupportVideoOptimized, 0, "FreeRDP_SupportVideoOptimized" },
-	{ FreeRDP_SuppressOutput, 0, "FreeRDP_SuppressOutput" },
-	{ FreeRDP_SurfaceCommandsEnabled, 0, "FreeRDP_SurfaceCommandsEnabled" },
-	{ FreeRDP_SurfaceFrameMarkerEnabled, 0, "FreeRDP_SurfaceFrameMarkerEnabled" },
-	{ FreeRDP_SuspendInput, 0, "FreeRDP_SuspendInput" },
-	{ FreeRDP_TcpKeepAlive, 0, "FreeRDP_TcpKeepAlive" },
-	{ FreeRDP_TlsSecurity, 0, "FreeRDP_TlsSecurity" },
-	{ FreeRDP_ToggleFullscreen, 0, "FreeRDP_ToggleFullscreen" },
-	{ FreeRDP_TransportDump, 0, "FreeRDP_TransportDump" },
-	{ FreeRDP_TransportDumpReplay, 0, "FreeRDP_TransportDumpReplay" },
-	{ FreeRDP_UnicodeInput, 0, "FreeRDP_UnicodeInput" },
-	{ FreeRDP_UnmapButtons, 0, "FreeRDP_UnmapButtons" },
-	{ FreeRDP_UseMultimon, 0, "FreeRDP_UseMultimon" },
-	{ FreeRDP_UseRdpSecurityLayer, 0, "FreeRDP_UseRdpSecurityLayer" },
-	{ FreeRDP_UsingSavedCredentials, 0, "FreeRDP_UsingSavedCredentials" },
-	{ FreeRDP_VideoDisable, 0, "FreeRDP_VideoDisable" },
-	{ FreeRDP_VmConnectMode, 0, "FreeRDP_VmConnectMode" },
-	{ FreeRDP_WaitForOutputBufferFlush, 0, "FreeRDP_WaitForOutputBufferFlush" },
-	{ FreeRDP_Workarea, 0, "FreeRDP_Workarea" },
-	{ FreeRDP_DesktopOrientation, 1, "FreeRDP_DesktopOrientation" },
-	{ FreeRDP_ProxyPort, 1, "FreeRDP_ProxyPort" },
-	{ FreeRDP_AcceptedCertLength, 3, "FreeRDP_AcceptedCertLength" },
-	{ FreeRDP_AuthenticationLevel, 3, "FreeRDP_AuthenticationLevel" },
-	{ FreeRDP_AutoReconnectMaxRetries, 3, "FreeRDP_AutoReconnectMaxRetries" },
-	{ FreeRDP_BitmapCacheV2NumCells, 3, "FreeRDP_BitmapCacheV2NumCells" },
-	{ FreeRDP_BitmapCacheV3CodecId, 3, "FreeRDP_BitmapCacheV3CodecId" },
-	{ FreeRDP_BitmapCacheVersion, 3, "FreeRDP_BitmapCacheVersion" },
-	{ FreeRDP_BrushSupportLevel, 3, "FreeRDP_BrushSupportLevel" },
-	{ FreeRDP_ChannelCount, 3, "FreeRDP_ChannelCount" },
-	{ FreeRDP_ChannelDefArraySize, 3, "FreeRDP_ChannelDefArraySize" },
-	{ FreeRDP_ClientBuild, 3, "FreeRDP_ClientBuild" },
-	{ FreeRDP_ClientRandomLength, 3, "FreeRDP_ClientRandomLength" },
-	{ FreeRDP_ClusterInfoFlags, 3, "FreeRDP_ClusterInfoFlags" },
-	{ FreeRDP_ColorDepth, 3, "FreeRDP_ColorDepth" },
-	{ FreeRDP_CompDeskSupportLevel, 3, "FreeRDP_CompDeskSupportLevel" },
-	{ FreeRDP_CompressionLevel, 3, "FreeRDP_CompressionLevel" },
-	{ FreeRDP_ConnectionType, 3, "FreeRDP_ConnectionType" },
-	{ FreeRDP_CookieMaxLength, 3, "FreeRDP_CookieMaxLength" },
-	{ FreeRDP_DesktopHeight, 3, "FreeRDP_DesktopHeight" },
-	{ FreeRDP_DesktopPhysicalHeight, 3, "FreeRDP_DesktopPhysicalHeight" },
-	{ FreeRDP_DesktopPhysicalWidth, 3, "FreeRDP_DesktopPhysicalWidth" },
-	{ FreeRDP_DesktopPosX, 3, "FreeRDP_DesktopPosX" },
-	{ FreeRDP_DesktopPosY, 3, "FreeRDP_DesktopPosY" },
-	{ FreeRDP_DesktopScaleFactor, 3, "FreeRDP_DesktopScaleFactor" },
-	{ FreeRDP_DesktopWidth, 3, "FreeRDP_DesktopWidth" },
-	{ FreeRDP_DeviceArraySize, 3, "FreeRDP_DeviceArraySize" },
-	{ FreeRDP_DeviceCount, 3, "FreeRDP_DeviceCount" },
-	{ FreeRDP_DeviceScaleFactor, 3, "FreeRDP_DeviceScaleFactor" },
-	{ FreeRDP_DrawNineGridCacheEntries, 3, "FreeRDP_DrawNineGridCacheEntries" },
-	{ FreeRDP_DrawNineGridCacheSize, 3, "FreeRDP_DrawNineGridCacheSize" },
-	{ FreeRDP_DynamicChannelArraySize, 3, "FreeRDP_DynamicChannelArraySize" },
-	{ FreeRDP_DynamicChannelCount, 3, "FreeRDP_DynamicChannelCount" },
-	{ FreeRDP_EarlyCapabilityFlags, 3, "FreeRDP_EarlyCapabilityFlags" },
-	{ FreeRDP_EncryptionLevel, 3, "FreeRDP_EncryptionLevel" },
-	{ FreeRDP_EncryptionMethods, 3, "FreeRDP_EncryptionMethods" },
-	{ FreeRDP_ExtEncryptionMethods, 3, "FreeRDP_ExtEncryptionMethods" },
-	{ FreeRDP_Floatbar, 3, "FreeRDP_Floatbar" },
-	{ FreeRDP_FrameAcknowledge, 3, "FreeRDP_FrameAcknowledge" },
-	{ FreeRDP_GatewayAcceptedCertLength, 3, "FreeRDP_GatewayAcceptedCertLength" },
-	{ FreeRDP_GatewayCredentialsSource, 3, "FreeRDP_GatewayCredentialsSource" },
-	{ FreeRDP_GatewayPort, 3, "FreeRDP_GatewayPort" },
-	{ FreeRDP_GatewayUsageMethod, 3, "FreeRDP_GatewayUsageMethod" },
-	{ FreeRDP_GfxCapsFilter, 3, "FreeRDP_GfxCapsFilter" },
-	{ FreeRDP_GlyphSupportLevel, 3, "FreeRDP_GlyphSupportLevel" },
-	{ FreeRDP_JpegCodecId, 3, "FreeRDP_JpegCodecId" },
-	{ FreeRDP_JpegQuality, 3, "FreeRDP_JpegQuality" },
-	{ FreeRDP_KeySpec, 3, "FreeRDP_KeySpec" },
-	{ FreeRDP_KeyboardCodePage, 3, "FreeRDP_KeyboardCodePage" },
-	{ FreeRDP_KeyboardFunctionKey, 3, "FreeRDP_KeyboardFunctionKey" },
-	{ FreeRDP_KeyboardHook, 3, "FreeRDP_KeyboardHook" },
-	{ FreeRDP_KeyboardLayout, 3, "FreeRDP_KeyboardLayout" },
-	{ FreeRDP_KeyboardSubType, 3, "FreeRDP_KeyboardSubType" },
-	{ FreeRDP_KeyboardType, 3, "FreeRDP_KeyboardType" },
-	{ FreeRDP_LargePointerFlag, 3, "FreeRDP_LargePointerFlag" },
-	{ FreeRDP_LoadBalanceInfoLength, 3, "FreeRDP_LoadBalanceInfoLength" },
-	{ FreeRDP_MaxTimeInCheckLoop, 3, "FreeRDP_MaxTimeInCheckLoop" },
-	{ FreeRDP_MonitorCount, 3, "FreeRDP_MonitorCount" },
-	{ FreeRDP_MonitorDefArraySize, 3, "FreeRDP_MonitorDefArraySize" },
-	{ FreeRDP_MonitorLocalShiftX, 3, "FreeRDP_MonitorLocalShiftX" },
-	{ FreeRDP_MonitorLocalShiftY, 3, "FreeRDP_MonitorLocalShiftY" },
-	{ FreeRDP_MultifragMaxRequestSize, 3, "FreeRDP_MultifragMaxRequestSize" },
-	{ FreeRDP_MultitransportFlags, 3, "FreeRDP_MultitransportFlags" },
-	{ FreeRDP_NSCodecColorLossLevel, 3, "FreeRDP_NSCodecColorLossLevel" },
-	{ FreeRDP_NSCodecId, 3, "FreeRDP_NSCodecId" },
-	{ FreeRDP_NegotiationFlags, 3, "FreeRDP_NegotiationFlags" },
-	{ FreeRDP_NumMonitorIds, 3, "FreeRDP_NumMonitorIds" },
-	{ FreeRDP_OffscreenCacheEntries, 3, "FreeRDP_OffscreenCacheEntries" },
-	{ FreeRDP_OffscreenCacheSize, 3, "FreeRDP_OffscreenCacheSize" },
-	{ FreeRDP_OffscreenSupportLevel, 3, "FreeRDP_OffscreenSupportLevel" },
-	{ FreeRDP_OsMajorType, 3, "FreeRDP_OsMajorType" },
-	{ FreeRDP_OsMinorType, 3, "FreeRDP_OsMinorType" },
-	{ FreeRDP_Password51Length, 3, "FreeRDP_Password51Length" },
-	{ FreeRDP_PduSource, 3, "FreeRDP_PduSource" },
-	{ FreeRDP_PercentScreen, 3, "FreeRDP_PercentScreen" },
-	{ FreeRDP_PerformanceFlags, 3, "FreeRDP_PerformanceFlags" },
-	{ FreeRDP_PointerCacheSize, 3, "FreeRDP_PointerCacheSize" },
-	{ FreeRDP_PreconnectionId, 3, "FreeRDP_PreconnectionId" },
-	{ FreeRDP_ProxyType, 3, "FreeRDP_ProxyType" },
-	{ FreeRDP_RdpVersion, 3, "FreeRDP_RdpVersion" },
-	{ FreeRDP_ReceivedCapabilitiesSize, 3, "FreeRDP_ReceivedCapabilitiesSize" },
-	{ FreeRDP_RedirectedSessionId, 3, "FreeRDP_RedirectedSessionId" },
-	{ FreeRDP_RedirectionAcceptedCertLength, 3, "FreeRDP_RedirectionAcceptedCertLength" },
-	{ FreeRDP_RedirectionFlags, 3, "FreeRDP_RedirectionFlags" },
-	{ FreeRDP_RedirectionPasswordLength, 3, "FreeRDP_RedirectionPasswordLength" },
-	{ FreeRDP_RedirectionPreferType, 3, "FreeRDP_RedirectionPreferType" },
-	{ FreeRDP_RedirectionTsvUrlLength, 3, "FreeRDP_RedirectionTsvUrlLength" },
-	{ FreeRDP_RemoteAppNumIconCacheEntries, 3, "FreeRDP_RemoteAppNumIconCacheEntries" },
-	{ FreeRDP_RemoteAppNumIconCaches, 3, "FreeRDP_RemoteAppNumIconCaches" },
-	{ FreeRDP_RemoteApplicationExpandCmdLine, 3, "FreeRDP_RemoteApplicationExpandCmdLine" },
-	{ FreeRDP_RemoteApplicationExpandWorkingDir, 3, "FreeRDP_RemoteApplicationExpandWorkingDir" },
-	{ FreeRDP_RemoteApplicationSupportLevel, 3, "FreeRDP_RemoteApplicationSupportLevel" },
-	{ FreeRDP_RemoteApplicationSupportMask, 3, "FreeRDP_RemoteApplicationSupportMask" },
-	{ FreeRDP_RemoteFxCaptureFlags, 3, "FreeRDP_RemoteFxCaptureFlags" },
-	{ FreeRDP_RemoteFxCodecId, 3, "FreeRDP_RemoteFxCodecId" },
-	{ FreeRDP_RemoteFxCodecMode, 3, "FreeRDP_RemoteFxCodecMode" },
-	{ FreeRDP_RemoteWndSupportLevel, 3, "FreeRDP_RemoteWndSupportLevel" },
-	{ FreeRDP_RequestedProtocols, 3, "FreeRDP_RequestedProtocols" },
-	{ FreeRDP_SelectedProtocol, 3, "FreeRDP_SelectedProtocol" },
-	{ FreeRDP_ServerCertificateLength, 3, "FreeRDP_ServerCertificateLength" },
-	{ FreeRDP_ServerPort, 3, "FreeRDP_ServerPort" },
-	{ FreeRDP_ServerRandomLength, 3, "FreeRDP_ServerRandomLength" },
-	{ FreeRDP_ShareId, 3, "FreeRDP_ShareId" },
-	{ FreeRDP_SmartSizingHeight, 3, "FreeRDP_SmartSizingHeight" },
-	{ FreeRDP_SmartSizingWidth, 3, "FreeRDP_SmartSizingWidth" },
-	{ FreeRDP_StaticChannelArraySize, 3, "FreeRDP_StaticChannelArraySize" },
-	{ FreeRDP_StaticChannelCount, 3, "FreeRDP_StaticChannelCount" },
-	{ FreeRDP_TargetNetAddressCount, 3, "FreeRDP_TargetNetAddressCount" },
-	{ FreeRDP_TcpAckTimeout, 3, "FreeRDP_TcpAckTimeout" },
-	{ FreeRDP_TcpConnectTimeout, 3, "FreeRDP_TcpConnectTimeout" },
-	{ FreeRDP_TcpKeepAliveDelay, 3, "FreeRDP_TcpKeepAliveDelay" },
-	{ FreeRDP_TcpKeepAliveInterval, 3, "FreeRDP_TcpKeepAliveInterval" },
-	{ FreeRDP_TcpKeepAliveRetries, 3, "FreeRDP_TcpKeepAliveRetries" },
-	{ FreeRDP_ThreadingFlags, 3, "FreeRDP_ThreadingFlags" },
-	{ FreeRDP_TlsSecLevel, 3, "FreeRDP_TlsSecLevel" },
-	{ FreeRDP_VirtualChannelChunkSize, 3, "FreeRDP_VirtualChannelChunkSize" },
-	{ FreeRDP_VirtualChannelCompressionFlags, 3, "FreeRDP_VirtualChannelCompressionFlags" },
-	{ FreeRDP_XPan, 4, "FreeRDP_XPan" },
-	{ FreeRDP_YPan, 4, "FreeRDP_YPan" },
-	{ FreeRDP_ParentWindowId, 5, "FreeRDP_ParentWindowId" },
-	{ FreeRDP_AcceptedCert, 7, "FreeRDP_AcceptedCert" },
-	{ FreeRDP_ActionScript, 7, "FreeRDP_ActionScript" },
-	{ FreeRDP_AllowedTlsCiphers, 7, "FreeRDP_AllowedTlsCiphers" },
-	{ FreeRDP_AlternateShell, 7, "FreeRDP_AlternateShell" },
-	{ FreeRDP_AssistanceFile, 7, "FreeRDP_AssistanceFile" },
-	{ FreeRDP_AuthenticationServiceClass, 7, "FreeRDP_AuthenticationServiceClass" },
-	{ FreeRDP_CardName, 7, "FreeRDP_CardName" },
-	{ FreeRDP_CertificateAcceptedFingerprints, 7, "FreeRDP_CertificateAcceptedFingerprints" },
-	{ FreeRDP_CertificateContent, 7, "FreeRDP_CertificateContent" },
-	{ FreeRDP_CertificateFile, 7, "FreeRDP_CertificateFile" },
-	{ FreeRDP_CertificateName, 7, "FreeRDP_CertificateName" },
-	{ FreeRDP_ClientAddress, 7, "FreeRDP_ClientAddress" },
-	{ FreeRDP_ClientDir, 7, "FreeRDP_ClientDir" },
-	{ FreeRDP_ClientHostname, 7, "FreeRDP_ClientHostname" },
-	{ FreeRDP_ClientProductId, 7, "FreeRDP_ClientProductId" },
-	{ FreeRDP_ComputerName, 7, "FreeRDP_ComputerName" },
-	{ FreeRDP_ConfigPath, 7, "FreeRDP_ConfigPath" },
-	{ FreeRDP_ConnectionFile, 7, "FreeRDP_ConnectionFile" },
-	{ FreeRDP_ContainerName, 7, "FreeRDP_ContainerName" },
-	{ FreeRDP_CspName, 7, "FreeRDP_CspName" },
-	{ FreeRDP_CurrentPath, 7, "FreeRDP_CurrentPath" },
-	{ FreeRDP_Domain, 7, "FreeRDP_Domain" },
-	{ FreeRDP_DrivesToRedirect, 7, "FreeRDP_DrivesToRedirect" },
-	{ FreeRDP_DumpRemoteFxFile, 7, "FreeRDP_DumpRemoteFxFile" },
-	{ FreeRDP_DynamicDSTTimeZoneKeyName, 7, "FreeRDP_DynamicDSTTimeZoneKeyName" },
-	{ FreeRDP_GatewayAcceptedCert, 7, "FreeRDP_GatewayAcceptedCert" },
-	{ FreeRDP_GatewayAccessToken, 7, "FreeRDP_GatewayAccessToken" },
-	{ FreeRDP_GatewayDomain, 7, "FreeRDP_GatewayDomain" },
-	{ FreeRDP_GatewayHostname, 7, "FreeRDP_GatewayHostname" },
-	{ FreeRDP_GatewayPassword, 7, "FreeRDP_GatewayPassword" },
-	{ FreeRDP_GatewayUsername, 7, "FreeRDP_GatewayUsername" },
-	{ FreeRDP_HomePath, 7, "FreeRDP_HomePath" },
-	{ FreeRDP_ImeFileName, 7, "FreeRDP_ImeFileName" },
-	{ FreeRDP_KerberosArmor, 7, "FreeRDP_KerberosArmor" },
-	{ FreeRDP_KerberosCache, 7, "FreeRDP_KerberosCache" },
-	{ FreeRDP_KerberosKdc, 7, "FreeRDP_KerberosKdc" },
-	{ FreeRDP_KerberosLifeTime, 7, "FreeRDP_KerberosLifeTime" },
-	{ FreeRDP_KerberosRealm, 7, "FreeRDP_KerberosRealm" },
-	{ FreeRDP_KerberosRenewableLifeTime, 7, "FreeRDP_KerberosRenewableLifeTime" },
-	{ FreeRDP_KerberosStartTime, 7, "FreeRDP_KerberosStartTime" },
-	{ FreeRDP_KeyboardRemappingList, 7, "FreeRDP_KeyboardRemappingList" },
-	{ FreeRDP_NtlmSamFile, 7, "FreeRDP_NtlmSamFile" },
-	{ FreeRDP_Password, 7, "FreeRDP_Password" },
-	{ FreeRDP_PasswordHash, 7, "FreeRDP_PasswordHash" },
-	{ FreeRDP_Pkcs11Module, 7, "FreeRDP_Pkcs11Module" },
-	{ FreeRDP_PkinitAnchors, 7, "FreeRDP_PkinitAnchors" },
-	{ FreeRDP_PlayRemoteFxFile, 7, "FreeRDP_PlayRemoteFxFile" },
-	{ FreeRDP_PreconnectionBlob, 7, "FreeRDP_PreconnectionBlob" },
-	{ FreeRDP_PrivateKeyContent, 7, "FreeRDP_PrivateKeyContent" },
-	{ FreeRDP_PrivateKeyFile, 7, "FreeRDP_PrivateKeyFile" },
-	{ FreeRDP_ProxyHostname, 7, "FreeRDP_ProxyHostname" },
-	{ FreeRDP_ProxyPassword, 7, "FreeRDP_ProxyPassword" },
-	{ FreeRDP_ProxyUsername, 7, "FreeRDP_ProxyUsername" },
-	{ FreeRDP_RDP2TCPArgs, 7, "FreeRDP_RDP2TCPArgs" },
-	{ FreeRDP_RdpKeyContent, 7, "FreeRDP_RdpKeyContent" },
-	{ FreeRDP_RdpKeyFile, 7, "FreeRDP_RdpKeyFile" },
-	{ FreeRDP_ReaderName, 7, "FreeRDP_ReaderName" },
-	{ FreeRDP_RedirectionAcceptedCert, 7, "FreeRDP_RedirectionAcceptedCert" },
-	{ FreeRDP_RedirectionDomain, 7, "FreeRDP_RedirectionDomain" },
-	{ FreeRDP_RedirectionTargetFQDN, 7, "FreeRDP_RedirectionTargetFQDN" },
-	{ FreeRDP_RedirectionTargetNetBiosName, 7, "FreeRDP_RedirectionTargetNetBiosName" },
-	{ FreeRDP_RedirectionUsername, 7, "FreeRDP_RedirectionUsername" },
-	{ FreeRDP_RemoteApplicationCmdLine, 7, "FreeRDP_RemoteApplicationCmdLine" },
-	{ FreeRDP_RemoteApplicationFile, 7, "FreeRDP_RemoteApplicationFile" },
-	{ FreeRDP_RemoteApplicationGuid, 7, "FreeRDP_RemoteApplicationGuid" },
-	{ FreeRDP_RemoteApplicationIcon, 7, "FreeRDP_RemoteApplicationIcon" },
-	{ FreeRDP_RemoteApplicationName, 7, "FreeRDP_RemoteApplicationName" },
-	{ FreeRDP_RemoteApplicationProgram, 7, "FreeRDP_RemoteApplicationProgram" },
-	{ FreeRDP_RemoteApplicationWorkingDir, 7, "FreeRDP_RemoteApplicationWorkingDir" },
-	{ FreeRDP_RemoteAssistancePassStub, 7, "FreeRDP_RemoteAssistancePassStub" },
-	{ FreeRDP_RemoteAssistancePassword, 7, "FreeRDP_RemoteAssistancePassword" },
-	{ FreeRDP_RemoteAssistanceRCTicket, 7, "FreeRDP_RemoteAssistanceRCTicket" },
-	{ FreeRDP_RemoteAssistanceSessionId, 7, "FreeRDP_RemoteAssistanceSessionId" },
-	{ FreeRDP_ServerHostname, 7, "FreeRDP_ServerHostname" },
-	{ FreeRDP_ShellWorkingDirectory, 7, "FreeRDP_ShellWorkingDirectory" },
-	{ FreeRDP_SmartcardCertificate, 7, "FreeRDP_SmartcardCertificate" },
-	{ FreeRDP_SmartcardPin, 7, "FreeRDP_SmartcardPin" },
-	{ FreeRDP_SmartcardPrivateKey, 7, "FreeRDP_SmartcardPrivateKey" },
-	{ FreeRDP_TargetNetAddress, 7, "FreeRDP_TargetNetAddress" },
-	{ FreeRDP_TransportDumpFile, 7, "FreeRDP_TransportDumpFile" },
-	{ FreeRDP_Username, 7, "FreeRDP_Username" },
-	{ FreeRDP_WindowTitle, 7, "FreeRDP_WindowTitle" },
-	{ FreeRDP_WmClass, 7, "FreeRDP_WmClass" },
-	{ FreeRDP_BitmapCacheV2CellInfo, 8, "FreeRDP_BitmapCacheV2CellInfo" },
-	{ FreeRDP_ChannelDefArray, 8, "FreeRDP_ChannelDefArray" },
-	{ FreeRDP_ClientAutoReconnectCookie, 8, "FreeRDP_ClientAutoReconnectCookie" },
-	{ FreeRDP_ClientRandom, 8, "FreeRDP_ClientRandom" },
-	{ FreeRDP_ClientTimeZone, 8, "FreeRDP_ClientTimeZone" },
-	{ FreeRDP_DeviceArray, 8, "FreeRDP_DeviceArray" },
-	{ FreeRDP_DynamicChannelArray, 8, "FreeRDP_DynamicChannelArray" },
-	{ FreeRDP_FragCache, 8, "FreeRDP_FragCache" },
-	{ FreeRDP_GlyphCache, 8, "FreeRDP_GlyphCache" },
-	{ FreeRDP_LoadBalanceInfo, 8, "FreeRDP_LoadBalanceInfo" },
-	{ FreeRDP_MonitorDefArray, 8, "FreeRDP_MonitorDefArray" },
-	{ FreeRDP_MonitorIds, 8, "FreeRDP_MonitorIds" },
-	{ FreeRDP_OrderSupport, 8, "FreeRDP_OrderSupport" },
-	{ FreeRDP_Password51, 8, "FreeRDP_Password51" },
-	{ FreeRDP_RdpServerCertificate, 8, "FreeRDP_RdpServerCertificate" },
-	{ FreeRDP_RdpServerRsaKey, 8, "FreeRDP_RdpServerRsaKey" },
-	{ FreeRDP_ReceivedCapabilities, 8, "FreeRDP_ReceivedCapabilities" },
-	{ FreeRDP_RedirectionPassword, 8, "FreeRDP_RedirectionPassword" },
-	{ FreeRDP_RedirectionTsvUrl, 8, "FreeRDP_RedirectionTsvUrl" },
-	{ FreeRDP_ServerAutoReconnectCookie, 8, "FreeRDP_ServerAutoReconnectCookie" },
-	{ FreeRDP_ServerCertificate, 8, "FreeRDP_ServerCertificate" },
-	{ FreeRDP_ServerRandom, 8, "FreeRDP_ServerRandom" },
-	{ FreeRDP_StaticChannelArray, 8, "FreeRDP_StaticChannelArray" },
-	{ FreeRDP_TargetNetAddresses, 8, "FreeRDP_TargetNetAddresses" },
-	{ FreeRDP_TargetNetPorts, 8, "FreeRDP_TargetNetPorts" },
-	{ FreeRDP_instance, 8, "FreeRDP_instance" },
+	{ FreeRDP_AllowCacheWaitingList, 0, "FreeRDP_AllowCacheWaitingList",
+	  offsetof(rdpSettings, AllowCacheWaitingList) },
+	{ FreeRDP_AllowDesktopComposition, 0, "FreeRDP_AllowDesktopComposition",
+	  offsetof(rdpSettings, AllowDesktopComposition) },
+	{ FreeRDP_AllowFontSmoothing, 0, "FreeRDP_AllowFontSmoothing",
+	  offsetof(rdpSettings, AllowFontSmoothing) },
+	{ FreeRDP_AllowUnanouncedOrdersFromServer, 0, "FreeRDP_AllowUnanouncedOrdersFromServer",
+	  offsetof(rdpSettings, AllowUnanouncedOrdersFromServer) },
+	{ FreeRDP_AltSecFrameMarkerSupport, 0, "FreeRDP_AltSecFrameMarkerSupport",
+	  offsetof(rdpSettings, AltSecFrameMarkerSupport) },
+	{ FreeRDP_AsyncChannels, 0, "FreeRDP_AsyncChannels", offsetof(rdpSettings, AsyncChannels) },
+	{ FreeRDP_AsyncInput, 0, "FreeRDP_AsyncInput", offsetof(rdpSettings, AsyncInput) },
+	{ FreeRDP_AsyncUpdate, 0, "FreeRDP_AsyncUpdate", offsetof(rdpSettings, AsyncUpdate) },
+	{ FreeRDP_AudioCapture, 0, "FreeRDP_AudioCapture", offsetof(rdpSettings, AudioCapture) },
+	{ FreeRDP_AudioPlayback, 0, "FreeRDP_AudioPlayback", offsetof(rdpSettings, AudioPlayback) },
+	{ FreeRDP_Authentication, 0, "FreeRDP_Authentication", offsetof(rdpSettings, Authentication) },
+	{ FreeRDP_AuthenticationOnly, 0, "FreeRDP_AuthenticationOnly",
+	  offsetof(rdpSettings, AuthenticationOnly) },
+	{ FreeRDP_AutoAcceptCertificate, 0, "FreeRDP_AutoAcceptCertificate",
+	  offsetof(rdpSettings, AutoAcceptCertificate) },
+	{ FreeRDP_AutoDenyCertificate, 0, "FreeRDP_AutoDenyCertificate",
+	  offsetof(rdpSettings, AutoDenyCertificate) },
+	{ FreeRDP_AutoLogonEnabled, 0, "FreeRDP_AutoLogonEnabled",
+	  offsetof(rdpSettings, AutoLogonEnabled) },
+	{ FreeRDP_AutoReconnectionEnabled, 0, "FreeRDP_AutoReconnectionEnabled",
+	  offsetof(rdpSettings, AutoReconnectionEnabled) },
+	{ FreeRDP_BitmapCacheEnabled, 0, "FreeRDP_BitmapCacheEnabled",
+	  offsetof(rdpSettings, BitmapCacheEnabled) },
+	{ FreeRDP_BitmapCachePersistEnabled, 0, "FreeRDP_BitmapCachePersistEnabled",
+	  offsetof(rdpSettings, BitmapCachePersistEnabled) },
+	{ FreeRDP_BitmapCacheV3Enabled, 0, "FreeRDP_BitmapCacheV3Enabled",
+	  offsetof(rdpSettings, BitmapCacheV3Enabled) },
+	{ FreeRDP_BitmapCompressionDisabled, 0, "FreeRDP_BitmapCompressionDisabled",
+	  offsetof(rdpSettings, BitmapCompressionDisabled) },
+	{ FreeRDP_CertificateCallbackPreferPEM, 0, "FreeRDP_CertificateCallbackPreferPEM",
+	  offsetof(rdpSettings, CertificateCallbackPreferPEM) },
+	{ FreeRDP_CertificateUseKnownHosts, 0, "FreeRDP_CertificateUseKnownHosts",
+	  offsetof(rdpSettings, CertificateUseKnownHosts) },
+	{ FreeRDP_ColorPointerFlag, 0, "FreeRDP_ColorPointerFlag",
+	  offsetof(rdpSettings, ColorPointerFlag) },
+	{ FreeRDP_CompressionEnabled, 0, "FreeRDP_CompressionEnabled",
+	  offsetof(rdpSettings, CompressionEnabled) },
+	{ FreeRDP_ConsoleSession, 0, "FreeRDP_ConsoleSession", offsetof(rdpSettings, ConsoleSession) },
+	{ FreeRDP_CredentialsFromStdin, 0, "FreeRDP_CredentialsFromStdin",
+	  offsetof(rdpSettings, CredentialsFromStdin) },
+	{ FreeRDP_DeactivateClientDecoding, 0, "FreeRDP_DeactivateClientDecoding",
+	  offsetof(rdpSettings, DeactivateClientDecoding) },
+	{ FreeRDP_Decorations, 0, "FreeRDP_Decorations", offsetof(rdpSettings, Decorations) },
+	{ FreeRDP_DesktopResize, 0, "FreeRDP_DesktopResize", offsetof(rdpSettings, DesktopResize) },
+	{ FreeRDP_DeviceRedirection, 0, "FreeRDP_DeviceRedirection",
+	  offsetof(rdpSettings, DeviceRedirection) },
+	{ FreeRDP_DisableCredentialsDelegation, 0, "FreeRDP_DisableCredentialsDelegation",
+	  offsetof(rdpSettings, DisableCredentialsDelegation) },
+	{ FreeRDP_DisableCtrlAltDel, 0, "FreeRDP_DisableCtrlAltDel",
+	  offsetof(rdpSettings, DisableCtrlAltDel) },
+	{ FreeRDP_DisableCursorBlinking, 0, "FreeRDP_DisableCursorBlinking",
+	  offsetof(rdpSettings, DisableCursorBlinking) },
+	{ FreeRDP_DisableCursorShadow, 0, "FreeRDP_DisableCursorShadow",
+	  offsetof(rdpSettings, DisableCursorShadow) },
+	{ FreeRDP_DisableFullWindowDrag, 0, "FreeRDP_DisableFullWindowDrag",
+	  offsetof(rdpSettings, DisableFullWindowDrag) },
+	{ FreeRDP_DisableMenuAnims, 0, "FreeRDP_DisableMenuAnims",
+	  offsetof(rdpSettings, DisableMenuAnims) },
+	{ FreeRDP_DisableRemoteAppCapsCheck, 0, "FreeRDP_DisableRemoteAppCapsCheck",
+	  offsetof(rdpSettings, DisableRemoteAppCapsCheck) },
+	{ FreeRDP_DisableThemes, 0, "FreeRDP_DisableThemes", offsetof(rdpSettings, DisableThemes) },
+	{ FreeRDP_DisableWallpaper, 0, "FreeRDP_DisableWallpaper",
+	  offsetof(rdpSettings, DisableWallpaper) },
+	{ FreeRDP_DrawAllowColorSubsampling, 0, "FreeRDP_DrawAllowColorSubsampling",
+	  offsetof(rdpSettings, DrawAllowColorSubsampling) },
+	{ FreeRDP_DrawAllowDynamicColorFidelity, 0, "FreeRDP_DrawAllowDynamicColorFidelity",
+	  offsetof(rdpSettings, DrawAllowDynamicColorFidelity) },
+	{ FreeRDP_DrawAllowSkipAlpha, 0, "FreeRDP_DrawAllowSkipAlpha",
+	  offsetof(rdpSettings, DrawAllowSkipAlpha) },
+	{ FreeRDP_DrawGdiPlusCacheEnabled, 0, "FreeRDP_DrawGdiPlusCacheEnabled",
+	  offsetof(rdpSettings, DrawGdiPlusCacheEnabled) },
+	{ FreeRDP_DrawGdiPlusEnabled, 0, "FreeRDP_DrawGdiPlusEnabled",
+	  offsetof(rdpSettings, DrawGdiPlusEnabled) },
+	{ FreeRDP_DrawNineGridEnabled, 0, "FreeRDP_DrawNineGridEnabled",
+	  offsetof(rdpSettings, DrawNineGridEnabled) },
+	{ FreeRDP_DumpRemoteFx, 0, "FreeRDP_DumpRemoteFx", offsetof(rdpSettings, DumpRemoteFx) },
+	{ FreeRDP_DynamicDaylightTimeDisabled, 0, "FreeRDP_DynamicDaylightTimeDisabled",
+	  offsetof(rdpSettings, DynamicDaylightTimeDisabled) },
+	{ FreeRDP_DynamicResolutionUpdate, 0, "FreeRDP_DynamicResolutionUpdate",
+	  offsetof(rdpSettings, DynamicResolutionUpdate) },
+	{ FreeRDP_EmbeddedWindow, 0, "FreeRDP_EmbeddedWindow", offsetof(rdpSettings, EmbeddedWindow) },
+	{ FreeRDP_EnableWindowsKey, 0, "FreeRDP_EnableWindowsKey",
+	  offsetof(rdpSettings, EnableWindowsKey) },
+	{ FreeRDP_EncomspVirtualChannel, 0, "FreeRDP_EncomspVirtualChannel",
+	  offsetof(rdpSettings, EncomspVirtualChannel) },
+	{ FreeRDP_ExtSecurity, 0, "FreeRDP_ExtSecurity", offsetof(rdpSettings, ExtSecurity) },
+	{ FreeRDP_ExternalCertificateManagement, 0, "FreeRDP_ExternalCertificateManagement",
+	  offsetof(rdpSettings, ExternalCertificateManagement) },
+	{ FreeRDP_FIPSMode, 0, "FreeRDP_FIPSMode", offsetof(rdpSettings, FIPSMode) },
+	{ FreeRDP_FastPathInput, 0, "FreeRDP_FastPathInput", offsetof(rdpSettings, FastPathInput) },
+	{ FreeRDP_FastPathOutput, 0, "FreeRDP_FastPathOutput", offsetof(rdpSettings, FastPathOutput) },
+	{ FreeRDP_ForceEncryptedCsPdu, 0, "FreeRDP_ForceEncryptedCsPdu",
+	  offsetof(rdpSettings, ForceEncryptedCsPdu) },
+	{ FreeRDP_ForceMultimon, 0, "FreeRDP_ForceMultimon", offsetof(rdpSettings, ForceMultimon) },
+	{ FreeRDP_FrameMarkerCommandEnabled, 0, "FreeRDP_FrameMarkerCommandEnabled",
+	  offsetof(rdpSettings, FrameMarkerCommandEnabled) },
+	{ FreeRDP_Fullscreen, 0, "FreeRDP_Fullscreen", offsetof(rdpSettings, Fullscreen) },
+	{ FreeRDP_GatewayBypassLocal, 0, "FreeRDP_GatewayBypassLocal",
+	  offsetof(rdpSettings, GatewayBypassLocal) },
+	{ FreeRDP_GatewayEnabled, 0, "FreeRDP_GatewayEnabled", offsetof(rdpSettings, GatewayEnabled) },
+	{ FreeRDP_GatewayHttpTransport, 0, "FreeRDP_GatewayHttpTransport",
+	  offsetof(rdpSettings, GatewayHttpTransport) },
+	{ FreeRDP_GatewayHttpUseWebsockets, 0, "FreeRDP_GatewayHttpUseWebsockets",
+	  offsetof(rdpSettings, GatewayHttpUseWebsockets) },
+	{ FreeRDP_GatewayRpcTransport, 0, "FreeRDP_GatewayRpcTransport",
+	  offsetof(rdpSettings, GatewayRpcTransport) },
+	{ FreeRDP_GatewayUdpTransport, 0, "FreeRDP_GatewayUdpTransport",
+	  offsetof(rdpSettings, GatewayUdpTransport) },
+	{ FreeRDP_GatewayUseSameCredentials, 0, "FreeRDP_GatewayUseSameCredentials",
+	  offsetof(rdpSettings, GatewayUseSameCredentials) },
+	{ FreeRDP_GfxAVC444, 0, "FreeRDP_GfxAVC444", offsetof(rdpSettings, GfxAVC444) },
+	{ FreeRDP_GfxAVC444v2, 0, "FreeRDP_GfxAVC444v2", offsetof(rdpSettings, GfxAVC444v2) },
+	{ FreeRDP_GfxClearCodec, 0, "FreeRDP_GfxClearCodec", offsetof(rdpSettings, GfxClearCodec) },
+	{ FreeRDP_GfxH264, 0, "FreeRDP_GfxH264", offsetof(rdpSettings, GfxH264) },
+	{ FreeRDP_GfxPlanar, 0, "FreeRDP_GfxPlanar", offsetof(rdpSettings, GfxPlanar) },
+	{ FreeRDP_GfxProgressive, 0, "FreeRDP_GfxProgressive", offsetof(rdpSettings, GfxProgressive) },
+	{ FreeRDP_GfxProgressiveV2, 0, "FreeRDP_GfxProgressiveV2",
+	  offsetof(rdpSettings, GfxProgressiveV2) },
+	{ FreeRDP_GfxSendQoeAck, 0, "FreeRDP_GfxSendQoeAck", offsetof(rdpSettings, GfxSendQoeAck) },
+	{ FreeRDP_GfxSmallCache, 0, "FreeRDP_GfxSmallCache", offsetof(rdpSettings, GfxSmallCache) },
+	{ FreeRDP_GfxThinClient, 0, "FreeRDP_GfxThinClient", offsetof(rdpSettings, GfxThinClient) },
+	{ FreeRDP_GrabKeyboard, 0, "FreeRDP_GrabKeyboard", offsetof(rdpSettings, GrabKeyboard) },
+	{ FreeRDP_GrabMouse, 0, "FreeRDP_GrabMouse", offsetof(rdpSettings, GrabMouse) },
+	{ FreeRDP_HasExtendedMouseEvent, 0, "FreeRDP_HasExtendedMouseEvent",
+	  offsetof(rdpSettings, HasExtendedMouseEvent) },
+	{ FreeRDP_HasHorizontalWheel, 0, "FreeRDP_HasHorizontalWheel",
+	  offsetof(rdpSettings, HasHorizontalWheel) },
+	{ FreeRDP_HasMonitorAttributes, 0, "FreeRDP_HasMonitorAttributes",
+	  offsetof(rdpSettings, HasMonitorAttributes) },
+	{ FreeRDP_HiDefRemoteApp, 0, "FreeRDP_HiDefRemoteApp", offsetof(rdpSettings, HiDefRemoteApp) },
+	{ FreeRDP_IPv6Enabled, 0, "FreeRDP_IPv6Enabled", offsetof(rdpSettings, IPv6Enabled) },
+	{ FreeRDP_IgnoreCertificate, 0, "FreeRDP_IgnoreCertificate",
+	  offsetof(rdpSettings, IgnoreCertificate) },
+	{ FreeRDP_JpegCodec, 0, "FreeRDP_JpegCodec", offsetof(rdpSettings, JpegCodec) },
+	{ FreeRDP_ListMonitors, 0, "FreeRDP_ListMonitors", offsetof(rdpSettings, ListMonitors) },
+	{ FreeRDP_LocalConnection, 0, "FreeRDP_LocalConnection",
+	  offsetof(rdpSettings, LocalConnection) },
+	{ FreeRDP_LogonErrors, 0, "FreeRDP_LogonErrors", offsetof(rdpSettings, LogonErrors) },
+	{ FreeRDP_LogonNotify, 0, "FreeRDP_LogonNotify", offsetof(rdpSettings, LogonNotify) },
+	{ FreeRDP_LongCredentialsSupported, 0, "FreeRDP_LongCredentialsSupported",
+	  offsetof(rdpSettings, LongCredentialsSupported) },
+	{ FreeRDP_LyncRdpMode, 0, "FreeRDP_LyncRdpMode", offsetof(rdpSettings, LyncRdpMode) },
+	{ FreeRDP_MaximizeShell, 0, "FreeRDP_MaximizeShell", offsetof(rdpSettings, MaximizeShell) },
+	{ FreeRDP_MouseAttached, 0, "FreeRDP_MouseAttached", offsetof(rdpSettings, MouseAttached) },
+	{ FreeRDP_MouseHasWheel, 0, "FreeRDP_MouseHasWheel", offsetof(rdpSettings, MouseHasWheel) },
+	{ FreeRDP_MouseMotion, 0, "FreeRDP_MouseMotion", offsetof(rdpSettings, MouseMotion) },
+	{ FreeRDP_MouseUseRelativeMove, 0, "FreeRDP_MouseUseRelativeMove",
+	  offsetof(rdpSettings, MouseUseRelativeMove) },
+	{ FreeRDP_MstscCookieMode, 0, "FreeRDP_MstscCookieMode",
+	  offsetof(rdpSettings, MstscCookieMode) },
+	{ FreeRDP_MultiTouchGestures, 0, "FreeRDP_MultiTouchGestures",
+	  offsetof(rdpSettings, MultiTouchGestures) },
+	{ FreeRDP_MultiTouchInput, 0, "FreeRDP_MultiTouchInput",
+	  offsetof(rdpSettings, MultiTouchInput) },
+	{ FreeRDP_NCrushLazyMatching, 0, "FreeRDP_NCrushLazyMatching",
+	  offsetof(rdpSettings, NCrushLazyMatching) },
+	{ FreeRDP_NSCodec, 0, "FreeRDP_NSCodec", offsetof(rdpSettings, NSCodec) },
+	{ FreeRDP_NSCodecAllowDynamicColorFidelity, 0, "FreeRDP_NSCodecAllowDynamicColorFidelity",
+	  offsetof(rdpSettings, NSCodecAllowDynamicColorFidelity) },
+	{ FreeRDP_NSCodecAllowSubsampling, 0, "FreeRDP_NSCodecAllowSubsampling",
+	  offsetof(rdpSettings, NSCodecAllowSubsampling) },
+	{ FreeRDP_NegotiateSecurityLayer, 0, "FreeRDP_NegotiateSecurityLayer",
+	  offsetof(rdpSettings, NegotiateSecurityLayer) },
+	{ FreeRDP_NetworkAutoDetect, 0, "FreeRDP_NetworkAutoDetect",
+	  offsetof(rdpSettings, NetworkAutoDetect) },
+	{ FreeRDP_NlaSecurity, 0, "FreeRDP_NlaSecurity", offsetof(rdpSettings, NlaSecurity) },
+	{ FreeRDP_NoBitmapCompressionHeader, 0, "FreeRDP_NoBitmapCompressionHeader",
+	  offsetof(rdpSettings, NoBitmapCompressionHeader) },
+	{ FreeRDP_OldLicenseBehaviour, 0, "FreeRDP_OldLicenseBehaviour",
+	  offsetof(rdpSettings, OldLicenseBehaviour) },
+	{ FreeRDP_PasswordIsSmartcardPin, 0, "FreeRDP_PasswordIsSmartcardPin",
+	  offsetof(rdpSettings, PasswordIsSmartcardPin) },
+	{ FreeRDP_PercentScreenUseHeight, 0, "FreeRDP_PercentScreenUseHeight",
+	  offsetof(rdpSettings, PercentScreenUseHeight) },
+	{ FreeRDP_PercentScreenUseWidth, 0, "FreeRDP_PercentScreenUseWidth",
+	  offsetof(rdpSettings, PercentScreenUseWidth) },
+	{ FreeRDP_PlayRemoteFx, 0, "FreeRDP_PlayRemoteFx", offsetof(rdpSettings, PlayRemoteFx) },
+	{ FreeRDP_PreferIPv6OverIPv4, 0, "FreeRDP_PreferIPv6OverIPv4",
+	  offsetof(rdpSettings, PreferIPv6OverIPv4) },
+	{ FreeRDP_PrintReconnectCookie, 0, "FreeRDP_PrintReconnectCookie",
+	  offsetof(rdpSettings, PrintReconnectCookie) },
+	{ FreeRDP_PromptForCredentials, 0, "FreeRDP_PromptForCredentials",
+	  offsetof(rdpSettings, PromptForCredentials) },
+	{ FreeRDP_RdpSecurity, 0, "FreeRDP_RdpSecurity", offsetof(rdpSettings, RdpSecurity) },
+	{ FreeRDP_RedirectClipboard, 0, "FreeRDP_RedirectClipboard",
+	  offsetof(rdpSettings, RedirectClipboard) },
+	{ FreeRDP_RedirectDrives, 0, "FreeRDP_RedirectDrives", offsetof(rdpSettings, RedirectDrives) },
+	{ FreeRDP_RedirectHomeDrive, 0, "FreeRDP_RedirectHomeDrive",
+	  offsetof(rdpSettings, RedirectHomeDrive) },
+	{ FreeRDP_RedirectParallelPorts, 0, "FreeRDP_RedirectParallelPorts",
+	  offsetof(rdpSettings, RedirectParallelPorts) },
+	{ FreeRDP_RedirectPrinters, 0, "FreeRDP_RedirectPrinters",
+	  offsetof(rdpSettings, RedirectPrinters) },
+	{ FreeRDP_RedirectSerialPorts, 0, "FreeRDP_RedirectSerialPorts",
+	  offsetof(rdpSettings, RedirectSerialPorts) },
+	{ FreeRDP_RedirectSmartCards, 0, "FreeRDP_RedirectSmartCards",
+	  offsetof(rdpSettings, RedirectSmartCards) },
+	{ FreeRDP_RefreshRect, 0, "FreeRDP_RefreshRect", offsetof(rdpSettings, RefreshRect) },
+	{ FreeRDP_RemdeskVirtualChannel, 0, "FreeRDP_RemdeskVirtualChannel",
+	  offsetof(rdpSettings, RemdeskVirtualChannel) },
+	{ FreeRDP_RemoteAppLanguageBarSupported, 0, "FreeRDP_RemoteAppLanguageBarSupported",
+	  offsetof(rdpSettings, RemoteAppLanguageBarSupported) },
+	{ FreeRDP_RemoteApplicationMode, 0, "FreeRDP_RemoteApplicationMode",
+	  offsetof(rdpSettings, RemoteApplicationMode) },
+	{ FreeRDP_RemoteAssistanceMode, 0, "FreeRDP_RemoteAssistanceMode",
+	  offsetof(rdpSettings, RemoteAssistanceMode) },
+	{ FreeRDP_RemoteAssistanceRequestControl, 0, "FreeRDP_RemoteAssistanceRequestControl",
+	  offsetof(rdpSettings, RemoteAssistanceRequestControl) },
+	{ FreeRDP_RemoteConsoleAudio, 0, "FreeRDP_RemoteConsoleAudio",
+	  offsetof(rdpSettings, RemoteConsoleAudio) },
+	{ FreeRDP_RemoteFxCodec, 0, "FreeRDP_RemoteFxCodec", offsetof(rdpSettings, RemoteFxCodec) },
+	{ FreeRDP_RemoteFxImageCodec, 0, "FreeRDP_RemoteFxImageCodec",
+	  offsetof(rdpSettings, RemoteFxImageCodec) },
+	{ FreeRDP_RemoteFxOnly, 0, "FreeRDP_RemoteFxOnly", offsetof(rdpSettings, RemoteFxOnly) },
+	{ FreeRDP_RestrictedAdminModeRequired, 0, "FreeRDP_RestrictedAdminModeRequired",
+	  offsetof(rdpSettings, RestrictedAdminModeRequired) },
+	{ FreeRDP_SaltedChecksum, 0, "FreeRDP_SaltedChecksum", offsetof(rdpSettings, SaltedChecksum) },
+	{ FreeRDP_SendPreconnectionPdu, 0, "FreeRDP_SendPreconnectionPdu",
+	  offsetof(rdpSettings, SendPreconnectionPdu) },
+	{ FreeRDP_ServerMode, 0, "FreeRDP_ServerMode", offsetof(rdpSettings, ServerMode) },
+	{ FreeRDP_SmartSizing, 0, "FreeRDP_SmartSizing", offsetof(rdpSettings, SmartSizing) },
+	{ FreeRDP_SmartcardEmulation, 0, "FreeRDP_SmartcardEmulation",
+	  offsetof(rdpSettings, SmartcardEmulation) },
+	{ FreeRDP_SmartcardLogon, 0, "FreeRDP_SmartcardLogon", offsetof(rdpSettings, SmartcardLogon) },
+	{ FreeRDP_SoftwareGdi, 0, "FreeRDP_SoftwareGdi", offsetof(rdpSettings, SoftwareGdi) },
+	{ FreeRDP_SoundBeepsEnabled, 0, "FreeRDP_SoundBeepsEnabled",
+	  offsetof(rdpSettings, SoundBeepsEnabled) },
+	{ FreeRDP_SpanMonitors, 0, "FreeRDP_SpanMonitors", offsetof(rdpSettings, SpanMonitors) },
+	{ FreeRDP_SupportAsymetricKeys, 0, "FreeRDP_SupportAsymetricKeys",
+	  offsetof(rdpSettings, SupportAsymetricKeys) },
+	{ FreeRDP_SupportDisplayControl, 0, "FreeRDP_SupportDisplayControl",
+	  offsetof(rdpSettings, SupportDisplayControl) },
+	{ FreeRDP_SupportDynamicChannels, 0, "FreeRDP_SupportDynamicChannels",
+	  offsetof(rdpSettings, SupportDynamicChannels) },
+	{ FreeRDP_SupportDynamicTimeZone, 0, "FreeRDP_SupportDynamicTimeZone",
+	  offsetof(rdpSettings, SupportDynamicTimeZone) },
+	{ FreeRDP_SupportEchoChannel, 0, "FreeRDP_SupportEchoChannel",
+	  offsetof(rdpSettings, SupportEchoChannel) },
+	{ FreeRDP_SupportErrorInfoPdu, 0, "FreeRDP_SupportErrorInfoPdu",
+	  offsetof(rdpSettings, SupportErrorInfoPdu) },
+	{ FreeRDP_SupportGeometryTracking, 0, "FreeRDP_SupportGeometryTracking",
+	  offsetof(rdpSettings, SupportGeometryTracking) },
+	{ FreeRDP_SupportGraphicsPipeline, 0, "FreeRDP_SupportGraphicsPipeline",
+	  offsetof(rdpSettings, SupportGraphicsPipeline) },
+	{ FreeRDP_SupportHeartbeatPdu, 0, "FreeRDP_SupportHeartbeatPdu",
+	  offsetof(rdpSettings, SupportHeartbeatPdu) },
+	{ FreeRDP_SupportMonitorLayoutPdu, 0, "FreeRDP_SupportMonitorLayoutPdu",
+	  offsetof(rdpSettings, SupportMonitorLayoutPdu) },
+	{ FreeRDP_SupportMultitransport, 0, "FreeRDP_SupportMultitransport",
+	  offsetof(rdpSettings, SupportMultitransport) },
+	{ FreeRDP_SupportSSHAgentChannel, 0, "FreeRDP_SupportSSHAgentChannel",
+	  offsetof(rdpSettings, SupportSSHAgentChannel) },
+	{ FreeRDP_SupportStatusInfoPdu, 0, "FreeRDP_SupportStatusInfoPdu",
+	  offsetof(rdpSettings, SupportStatusInfoPdu) },
+	{ FreeRDP_SupportVideoOptimized, 0, "FreeRDP_SupportVideoOptimized",
+	  offsetof(rdpSettings, SupportVideoOptimized) },
+	{ FreeRDP_SuppressOutput, 0, "FreeRDP_SuppressOutput", offsetof(rdpSettings, SuppressOutput) },
+	{ FreeRDP_SurfaceCommandsEnabled, 0, "FreeRDP_SurfaceCommandsEnabled",
+	  offsetof(rdpSettings, SurfaceCommandsEnabled) },
+	{ FreeRDP_SurfaceFrameMarkerEnabled, 0, "FreeRDP_SurfaceFrameMarkerEnabled",
+	  offsetof(rdpSettings, SurfaceFrameMarkerEnabled) },
+	{ FreeRDP_SuspendInput, 0, "FreeRDP_SuspendInput", offsetof(rdpSettings, SuspendInput) },
+	{ FreeRDP_TcpKeepAlive, 0, "FreeRDP_TcpKeepAlive", offsetof(rdpSettings, TcpKeepAlive) },
+	{ FreeRDP_TlsSecurity, 0, "FreeRDP_TlsSecurity", offsetof(rdpSettings, TlsSecurity) },
+	{ FreeRDP_ToggleFullscreen, 0, "FreeRDP_ToggleFullscreen",
+	  offsetof(rdpSettings, ToggleFullscreen) },
+	{ FreeRDP_TransportDump, 0, "FreeRDP_TransportDump", offsetof(rdpSettings, TransportDump) },
+	{ FreeRDP_TransportDumpReplay, 0, "FreeRDP_TransportDumpReplay",
+	  offsetof(rdpSettings, TransportDumpReplay) },
+	{ FreeRDP_UnicodeInput, 0, "FreeRDP_UnicodeInput", offsetof(rdpSettings, UnicodeInput) },
+	{ FreeRDP_UnmapButtons, 0, "FreeRDP_UnmapButtons", offsetof(rdpSettings, UnmapButtons) },
+	{ FreeRDP_UseMultimon, 0, "FreeRDP_UseMultimon", offsetof(rdpSettings, UseMultimon) },
+	{ FreeRDP_UseRdpSecurityLayer, 0, "FreeRDP_UseRdpSecurityLayer",
+	  offsetof(rdpSettings, UseRdpSecurityLayer) },
+	{ FreeRDP_UsingSavedCredentials, 0, "FreeRDP_UsingSavedCredentials",
+	  offsetof(rdpSettings, UsingSavedCredentials) },
+	{ FreeRDP_VideoDisable, 0, "FreeRDP_VideoDisable", offsetof(rdpSettings, VideoDisable) },
+	{ FreeRDP_VmConnectMode, 0, "FreeRDP_VmConnectMode", offsetof(rdpSettings, VmConnectMode) },
+	{ FreeRDP_WaitForOutputBufferFlush, 0, "FreeRDP_WaitForOutputBufferFlush",
+	  offsetof(rdpSettings, WaitForOutputBufferFlush) },
+	{ FreeRDP_Workarea, 0, "FreeRDP_Workarea", offsetof(rdpSettings, Workarea) },
+	{ FreeRDP_DesktopOrientation, 1, "FreeRDP_DesktopOrientation",
+	  offsetof(rdpSettings, DesktopOrientation) },
+	{ FreeRDP_ProxyPort, 1, "FreeRDP_ProxyPort", offsetof(rdpSettings, ProxyPort) },
+	{ FreeRDP_AcceptedCertLength, 3, "FreeRDP_AcceptedCertLength",
+	  offsetof(rdpSettings, AcceptedCertLength) },
+	{ FreeRDP_AuthenticationLevel, 3, "FreeRDP_AuthenticationLevel",
+	  offsetof(rdpSettings, AuthenticationLevel) },
+	{ FreeRDP_AutoReconnectMaxRetries, 3, "FreeRDP_AutoReconnectMaxRetries",
+	  offsetof(rdpSettings, AutoReconnectMaxRetries) },
+	{ FreeRDP_BitmapCacheV2NumCells, 3, "FreeRDP_BitmapCacheV2NumCells",
+	  offsetof(rdpSettings, BitmapCacheV2NumCells) },
+	{ FreeRDP_BitmapCacheV3CodecId, 3, "FreeRDP_BitmapCacheV3CodecId",
+	  offsetof(rdpSettings, BitmapCacheV3CodecId) },
+	{ FreeRDP_BitmapCacheVersion, 3, "FreeRDP_BitmapCacheVersion",
+	  offsetof(rdpSettings, BitmapCacheVersion) },
+	{ FreeRDP_BrushSupportLevel, 3, "FreeRDP_BrushSupportLevel",
+	  offsetof(rdpSettings, BrushSupportLevel) },
+	{ FreeRDP_ChannelCount, 3, "FreeRDP_ChannelCount", offsetof(rdpSettings, ChannelCount) },
+	{ FreeRDP_ChannelDefArraySize, 3, "FreeRDP_ChannelDefArraySize",
+	  offsetof(rdpSettings, ChannelDefArraySize) },
+	{ FreeRDP_ClientBuild, 3, "FreeRDP_ClientBuild", offsetof(rdpSettings, ClientBuild) },
+	{ FreeRDP_ClientRandomLength, 3, "FreeRDP_ClientRandomLength",
+	  offsetof(rdpSettings, ClientRandomLength) },
+	{ FreeRDP_ClusterInfoFlags, 3, "FreeRDP_ClusterInfoFlags",
+	  offsetof(rdpSettings, ClusterInfoFlags) },
+	{ FreeRDP_ColorDepth, 3, "FreeRDP_ColorDepth", offsetof(rdpSettings, ColorDepth) },
+	{ FreeRDP_CompDeskSupportLevel, 3, "FreeRDP_CompDeskSupportLevel",
+	  offsetof(rdpSettings, CompDeskSupportLevel) },
+	{ FreeRDP_CompressionLevel, 3, "FreeRDP_CompressionLevel",
+	  offsetof(rdpSettings, CompressionLevel) },
+	{ FreeRDP_ConnectionType, 3, "FreeRDP_ConnectionType", offsetof(rdpSettings, ConnectionType) },
+	{ FreeRDP_CookieMaxLength, 3, "FreeRDP_CookieMaxLength",
+	  offsetof(rdpSettings, CookieMaxLength) },
+	{ FreeRDP_DesktopHeight, 3, "FreeRDP_DesktopHeight", offsetof(rdpSettings, DesktopHeight) },
+	{ FreeRDP_DesktopPhysicalHeight, 3, "FreeRDP_DesktopPhysicalHeight",
+	  offsetof(rdpSettings, DesktopPhysicalHeight) },
+	{ FreeRDP_DesktopPhysicalWidth, 3, "FreeRDP_DesktopPhysicalWidth",
+	  offsetof(rdpSettings, DesktopPhysicalWidth) },
+	{ FreeRDP_DesktopPosX, 3, "FreeRDP_DesktopPosX", offsetof(rdpSettings, DesktopPosX) },
+	{ FreeRDP_DesktopPosY, 3, "FreeRDP_DesktopPosY", offsetof(rdpSettings, DesktopPosY) },
+	{ FreeRDP_DesktopScaleFactor, 3, "FreeRDP_DesktopScaleFactor",
+	  offsetof(rdpSettings, DesktopScaleFactor) },
+	{ FreeRDP_DesktopWidth, 3, "FreeRDP_DesktopWidth", offsetof(rdpSettings, DesktopWidth) },
+	{ FreeRDP_DeviceArraySize, 3, "FreeRDP_DeviceArraySize",
+	  offsetof(rdpSettings, DeviceArraySize) },
+	{ FreeRDP_DeviceCount, 3, "FreeRDP_DeviceCount", offsetof(rdpSettings, DeviceCount) },
+	{ FreeRDP_DeviceScaleFactor, 3, "FreeRDP_DeviceScaleFactor",
+	  offsetof(rdpSettings, DeviceScaleFactor) },
+	{ FreeRDP_DrawNineGridCacheEntries, 3, "FreeRDP_DrawNineGridCacheEntries",
+	  offsetof(rdpSettings, DrawNineGridCacheEntries) },
+	{ FreeRDP_DrawNineGridCacheSize, 3, "FreeRDP_DrawNineGridCacheSize",
+	  offsetof(rdpSettings, DrawNineGridCacheSize) },
+	{ FreeRDP_DynamicChannelArraySize, 3, "FreeRDP_DynamicChannelArraySize",
+	  offsetof(rdpSettings, DynamicChannelArraySize) },
+	{ FreeRDP_DynamicChannelCount, 3, "FreeRDP_DynamicChannelCount",
+	  offsetof(rdpSettings, DynamicChannelCount) },
+	{ FreeRDP_EarlyCapabilityFlags, 3, "FreeRDP_EarlyCapabilityFlags",
+	  offsetof(rdpSettings, EarlyCapabilityFlags) },
+	{ FreeRDP_EncryptionLevel, 3, "FreeRDP_EncryptionLevel",
+	  offsetof(rdpSettings, EncryptionLevel) },
+	{ FreeRDP_EncryptionMethods, 3, "FreeRDP_EncryptionMethods",
+	  offsetof(rdpSettings, EncryptionMethods) },
+	{ FreeRDP_ExtEncryptionMethods, 3, "FreeRDP_ExtEncryptionMethods",
+	  offsetof(rdpSettings, ExtEncryptionMethods) },
+	{ FreeRDP_Floatbar, 3, "FreeRDP_Floatbar", offsetof(rdpSettings, Floatbar) },
+	{ FreeRDP_FrameAcknowledge, 3, "FreeRDP_FrameAcknowledge",
+	  offsetof(rdpSettings, FrameAcknowledge) },
+	{ FreeRDP_GatewayAcceptedCertLength, 3, "FreeRDP_GatewayAcceptedCertLength",
+	  offsetof(rdpSettings, GatewayAcceptedCertLength) },
+	{ FreeRDP_GatewayCredentialsSource, 3, "FreeRDP_GatewayCredentialsSource",
+	  offsetof(rdpSettings, GatewayCredentialsSource) },
+	{ FreeRDP_GatewayPort, 3, "FreeRDP_GatewayPort", offsetof(rdpSettings, GatewayPort) },
+	{ FreeRDP_GatewayUsageMethod, 3, "FreeRDP_GatewayUsageMethod",
+	  offsetof(rdpSettings, GatewayUsageMethod) },
+	{ FreeRDP_GfxCapsFilter, 3, "FreeRDP_GfxCapsFilter", offsetof(rdpSettings, GfxCapsFilter) },
+	{ FreeRDP_GfxOutputMaxRects, 3, "FreeRDP_GfxOutputMaxRects",
+	  offsetof(rdpSettings, GfxOutputMaxRects) },
+	{ FreeRDP_GlyphSupportLevel, 3, "FreeRDP_GlyphSupportLevel",
+	  offsetof(rdpSettings, GlyphSupportLevel) },
+	{ FreeRDP_HandshakeQueueTimeout, 3, "FreeRDP_HandshakeQueueTimeout",
+	  offsetof(rdpSettings, HandshakeQueueTimeout) },
+	{ FreeRDP_JpegCodecId, 3, "FreeRDP_JpegCodecId", offsetof(rdpSettings, JpegCodecId) },
+	{ FreeRDP_JpegQuality, 3, "FreeRDP_JpegQuality", offsetof(rdpSettings, JpegQuality) },
+	{ FreeRDP_KeySpec, 3, "FreeRDP_KeySpec", offsetof(rdpSettings, KeySpec) },
+	{ FreeRDP_KeyboardCodePage, 3, "FreeRDP_KeyboardCodePage",
+	  offsetof(rdpSettings, KeyboardCodePage) },
+	{ FreeRDP_KeyboardFunctionKey, 3, "FreeRDP_KeyboardFunctionKey",
+	  offsetof(rdpSettings, KeyboardFunctionKey) },
+	{ FreeRDP_KeyboardHook, 3, "FreeRDP_KeyboardHook", offsetof(rdpSettings, KeyboardHook) },
+	{ FreeRDP_KeyboardLayout, 3, "FreeRDP_KeyboardLayout", offsetof(rdpSettings, KeyboardLayout) },
+	{ FreeRDP_KeyboardSubType, 3, "FreeRDP_KeyboardSubType",
+	  offsetof(rdpSettings, KeyboardSubType) },
+	{ FreeRDP_KeyboardType, 3, "FreeRDP_KeyboardType", offsetof(rdpSettings, KeyboardType) },
+	{ FreeRDP_LargePointerFlag, 3, "FreeRDP_LargePointerFlag",
+	  offsetof(rdpSettings, LargePointerFlag) },
+	{ FreeRDP_LoadBalanceInfoLength, 3, "FreeRDP_LoadBalanceInfoLength",
+	  offsetof(rdpSettings, LoadBalanceInfoLength) },
+	{ FreeRDP_MaxConcurrentHandshakes, 3, "FreeRDP_MaxConcurrentHandshakes",
+	  offsetof(rdpSettings, MaxConcurrentHandshakes) },
+	{ FreeRDP_MaxTimeInCheckLoop, 3, "FreeRDP_MaxTimeInCheckLoop",
+	  offsetof(rdpSettings, MaxTimeInCheckLoop) },
+	{ FreeRDP_MonitorCount, 3, "FreeRDP_MonitorCount", offsetof(rdpSettings, MonitorCount) },
+	{ FreeRDP_MonitorDefArraySize, 3, "FreeRDP_MonitorDefArraySize",
+	  offsetof(rdpSettings, MonitorDefArraySize) },
+	{ FreeRDP_MonitorLocalShiftX, 3, "FreeRDP_MonitorLocalShiftX",
+	  offsetof(rdpSettings, MonitorLocalShiftX) },
+	{ FreeRDP_MonitorLocalShiftY, 3, "FreeRDP_MonitorLocalShiftY",
+	  offsetof(rdpSettings, MonitorLocalShiftY) },
+	{ FreeRDP_MultifragMaxRequestSize, 3, "FreeRDP_MultifragMaxRequestSize",
+	  offsetof(rdpSettings, MultifragMaxRequestSize) },
+	{ FreeRDP_MultitransportFlags, 3, "FreeRDP_MultitransportFlags",
+	  offsetof(rdpSettings, MultitransportFlags) },
+	{ FreeRDP_NCrushMaxChainDepth, 3, "FreeRDP_NCrushMaxChainDepth",
+	  offsetof(rdpSettings, NCrushMaxChainDepth) },
+	{ FreeRDP_NSCodecColorLossLevel, 3, "FreeRDP_NSCodecColorLossLevel",
+	  offsetof(rdpSettings, NSCodecColorLossLevel) },
+	{ FreeRDP_NSCodecId, 3, "FreeRDP_NSCodecId", offsetof(rdpSettings, NSCodecId) },
+	{ FreeRDP_NegotiationFlags, 3, "FreeRDP_NegotiationFlags",
+	  offsetof(rdpSettings, NegotiationFlags) },
+	{ FreeRDP_NumMonitorIds, 3, "FreeRDP_NumMonitorIds", offsetof(rdpSettings, NumMonitorIds) },
+	{ FreeRDP_OffscreenCacheEntries, 3, "FreeRDP_OffscreenCacheEntries",
+	  offsetof(rdpSettings, OffscreenCacheEntries) },
+	{ FreeRDP_OffscreenCacheSize, 3, "FreeRDP_OffscreenCacheSize",
+	  offsetof(rdpSettings, OffscreenCacheSize) },
+	{ FreeRDP_OffscreenSupportLevel, 3, "FreeRDP_OffscreenSupportLevel",
+	  offsetof(rdpSettings, OffscreenSupportLevel) },
+	{ FreeRDP_OsMajorType, 3, "FreeRDP_OsMajorType", offsetof(rdpSettings, OsMajorType) },
+	{ FreeRDP_OsMinorType, 3, "FreeRDP_OsMinorType", offsetof(rdpSettings, OsMinorType) },
+	{ FreeRDP_Password51Length, 3, "FreeRDP_Password51Length",
+	  offsetof(rdpSettings, Password51Length) },
+	{ FreeRDP_PduSource, 3, "FreeRDP_PduSource", offsetof(rdpSettings, PduSource) },
+	{ FreeRDP_PercentScreen, 3, "FreeRDP_PercentScreen", offsetof(rdpSettings, PercentScreen) },
+	{ FreeRDP_PerformanceFlags, 3, "FreeRDP_PerformanceFlags",
+	  offsetof(rdpSettings, PerformanceFlags) },
+	{ FreeRDP_PointerCacheSize, 3, "FreeRDP_PointerCacheSize",
+	  offsetof(rdpSettings, PointerCacheSize) },
+	{ FreeRDP_PreconnectionId, 3, "FreeRDP_PreconnectionId",
+	  offsetof(rdpSettings, PreconnectionId) },
+	{ FreeRDP_ProxyType, 3, "FreeRDP_ProxyType", offsetof(rdpSettings, ProxyType) },
+	{ FreeRDP_RdpVersion, 3, "FreeRDP_RdpVersion", offsetof(rdpSettings, RdpVersion) },
+	{ FreeRDP_ReceivedCapabilitiesSize, 3, "FreeRDP_ReceivedCapabilitiesSize",
+	  offsetof(rdpSettings, ReceivedCapabilitiesSize) },
+	{ FreeRDP_RedirectedSessionId, 3, "FreeRDP_RedirectedSessionId",
+	  offsetof(rdpSettings, RedirectedSessionId) },
+	{ FreeRDP_RedirectionAcceptedCertLength, 3, "FreeRDP_RedirectionAcceptedCertLength",
+	  offsetof(rdpSettings, RedirectionAcceptedCertLength) },
+	{ FreeRDP_RedirectionFlags, 3, "FreeRDP_RedirectionFlags",
+	  offsetof(rdpSettings, RedirectionFlags) },
+	{ FreeRDP_RedirectionPasswordLength, 3, "FreeRDP_RedirectionPasswordLength",
+	  offsetof(rdpSettings, RedirectionPasswordLength) },
+	{ FreeRDP_RedirectionPreferType, 3, "FreeRDP_RedirectionPreferType",
+	  offsetof(rdpSettings, RedirectionPreferType) },
+	{ FreeRDP_RedirectionTsvUrlLength, 3, "FreeRDP_RedirectionTsvUrlLength",
+	  offsetof(rdpSettings, RedirectionTsvUrlLength) },
+	{ FreeRDP_RemoteAppNumIconCacheEntries, 3, "FreeRDP_RemoteAppNumIconCacheEntries",
+	  offsetof(rdpSettings, RemoteAppNumIconCacheEntries) },
+	{ FreeRDP_RemoteAppNumIconCaches, 3, "FreeRDP_RemoteAppNumIconCaches",
+	  offsetof(rdpSettings, RemoteAppNumIconCaches) },
+	{ FreeRDP_RemoteApplicationExpandCmdLine, 3, "FreeRDP_RemoteApplicationExpandCmdLine",
+	  offsetof(rdpSettings, RemoteApplicationExpandCmdLine) },
+	{ FreeRDP_RemoteApplicationExpandWorkingDir, 3, "FreeRDP_RemoteApplicationExpandWorkingDir",
+	  offsetof(rdpSettings, RemoteApplicationExpandWorkingDir) },
+	{ FreeRDP_RemoteApplicationSupportLevel, 3, "FreeRDP_RemoteApplicationSupportLevel",
+	  offsetof(rdpSettings, RemoteApplicationSupportLevel) },
+	{ FreeRDP_RemoteApplicationSupportMask, 3, "FreeRDP_RemoteApplicationSupportMask",
+	  offsetof(rdpSettings, RemoteApplicationSupportMask) },
+	{ FreeRDP_RemoteFxCaptureFlags, 3, "FreeRDP_RemoteFxCaptureFlags",
+	  offsetof(rdpSettings, RemoteFxCaptureFlags) },
+	{ FreeRDP_RemoteFxCodecId, 3, "FreeRDP_RemoteFxCodecId",
+	  offsetof(rdpSettings, RemoteFxCodecId) },
+	{ FreeRDP_RemoteFxCodecMode, 3, "FreeRDP_RemoteFxCodecMode",
+	  offsetof(rdpSettings, RemoteFxCodecMode) },
+	{ FreeRDP_RemoteWndSupportLevel, 3, "FreeRDP_RemoteWndSupportLevel",
+	  offsetof(rdpSettings, RemoteWndSupportLevel) },
+	{ FreeRDP_RequestedProtocols, 3, "FreeRDP_RequestedProtocols",
+	  offsetof(rdpSettings, RequestedProtocols) },
+	{ FreeRDP_SelectedProtocol, 3, "FreeRDP_SelectedProtocol",
+	  offsetof(rdpSettings, SelectedProtocol) },
+	{ FreeRDP_ServerCertificateLength, 3, "FreeRDP_ServerCertificateLength",
+	  offsetof(rdpSettings, ServerCertificateLength) },
+	{ FreeRDP_ServerPort, 3, "FreeRDP_ServerPort", offsetof(rdpSettings, ServerPort) },
+	{ FreeRDP_ServerRandomLength, 3, "FreeRDP_ServerRandomLength",
+	  offsetof(rdpSettings, ServerRandomLength) },
+	{ FreeRDP_ShareId, 3, "FreeRDP_ShareId", offsetof(rdpSettings, ShareId) },
+	{ FreeRDP_SmartSizingHeight, 3, "FreeRDP_SmartSizingHeight",
+	  offsetof(rdpSettings, SmartSizingHeight) },
+	{ FreeRDP_SmartSizingWidth, 3, "FreeRDP_SmartSizingWidth",
+	  offsetof(rdpSettings, SmartSizingWidth) },
+	{ FreeRDP_StaticChannelArraySize, 3, "FreeRDP_StaticChannelArraySize",
+	  offsetof(rdpSettings, StaticChannelArraySize) },
+	{ FreeRDP_StaticChannelCount, 3, "FreeRDP_StaticChannelCount",
+	  offsetof(rdpSettings, StaticChannelCount) },
+	{ FreeRDP_TargetNetAddressCount, 3, "FreeRDP_TargetNetAddressCount",
+	  offsetof(rdpSettings, TargetNetAddressCount) },
+	{ FreeRDP_TcpAckTimeout, 3, "FreeRDP_TcpAckTimeout", offsetof(rdpSettings, TcpAckTimeout) },
+	{ FreeRDP_TcpConnectTimeout, 3, "FreeRDP_TcpConnectTimeout",
+	  offsetof(rdpSettings, TcpConnectTimeout) },
+	{ FreeRDP_TcpKeepAliveDelay, 3, "FreeRDP_TcpKeepAliveDelay",
+	  offsetof(rdpSettings, TcpKeepAliveDelay) },
+	{ FreeRDP_TcpKeepAliveInterval, 3, "FreeRDP_TcpKeepAliveInterval",
+	  offsetof(rdpSettings, TcpKeepAliveInterval) },
+	{ FreeRDP_TcpKeepAliveRetries, 3, "FreeRDP_TcpKeepAliveRetries",
+	  offsetof(rdpSettings, TcpKeepAliveRetries) },
+	{ FreeRDP_ThreadingFlags, 3, "FreeRDP_ThreadingFlags", offsetof(rdpSettings, ThreadingFlags) },
+	{ FreeRDP_TlsSecLevel, 3, "FreeRDP_TlsSecLevel", offsetof(rdpSettings, TlsSecLevel) },
+	{ FreeRDP_VirtualChannelChunkSize, 3, "FreeRDP_VirtualChannelChunkSize",
+	  offsetof(rdpSettings, VirtualChannelChunkSize) },
+	{ FreeRDP_VirtualChannelCompressionFlags, 3, "FreeRDP_VirtualChannelCompressionFlags",
+	  offsetof(rdpSettings, VirtualChannelCompressionFlags) },
+	{ FreeRDP_XPan, 4, "FreeRDP_XPan", offsetof(rdpSettings, XPan) },
+	{ FreeRDP_YPan, 4, "FreeRDP_YPan", offsetof(rdpSettings, YPan) },
+	{ FreeRDP_ParentWindowId, 5, "FreeRDP_ParentWindowId", offsetof(rdpSettings, ParentWindowId) },
+	{ FreeRDP_AcceptedCert, 7, "FreeRDP_AcceptedCert", offsetof(rdpSettings, AcceptedCert) },
+	{ FreeRDP_ActionScript, 7, "FreeRDP_ActionScript", offsetof(rdpSettings, ActionScript) },
+	{ FreeRDP_AllowedTlsCiphers, 7, "FreeRDP_AllowedTlsCiphers",
+	  offsetof(rdpSettings, AllowedTlsCiphers) },
+	{ FreeRDP_AlternateShell, 7, "FreeRDP_AlternateShell", offsetof(rdpSettings, AlternateShell) },
+	{ FreeRDP_AssistanceFile, 7, "FreeRDP_AssistanceFile", offsetof(rdpSettings, AssistanceFile) },
+	{ FreeRDP_AuthenticationServiceClass, 7, "FreeRDP_AuthenticationServiceClass",
+	  offsetof(rdpSettings, AuthenticationServiceClass) },
+	{ FreeRDP_BitmapCachePersistFile, 7, "FreeRDP_BitmapCachePersistFile",
+	  offsetof(rdpSettings, BitmapCachePersistFile) },
+	{ FreeRDP_CardName, 7, "FreeRDP_CardName", offsetof(rdpSettings, CardName) },
+	{ FreeRDP_CertificateAcceptedFingerprints, 7, "FreeRDP_CertificateAcceptedFingerprints",
+	  offsetof(rdpSettings, CertificateAcceptedFingerprints) },
+	{ FreeRDP_CertificateContent, 7, "FreeRDP_CertificateContent",
+	  offsetof(rdpSettings, CertificateContent) },
+	{ FreeRDP_CertificateFile, 7, "FreeRDP_CertificateFile",
+	  offsetof(rdpSettings, CertificateFile) },
+	{ FreeRDP_CertificateName, 7, "FreeRDP_CertificateName",
+	  offsetof(rdpSettings, CertificateName) },
+	{ FreeRDP_ClientAddress, 7, "FreeRDP_ClientAddress", offsetof(rdpSettings, ClientAddress) },
+	{ FreeRDP_ClientDir, 7, "FreeRDP_ClientDir", offsetof(rdpSettings, ClientDir) },
+	{ FreeRDP_ClientHostname, 7, "FreeRDP_ClientHostname", offsetof(rdpSettings, ClientHostname) },
+	{ FreeRDP_ClientProductId, 7, "FreeRDP_ClientProductId",
+	  offsetof(rdpSettings, ClientProductId) },
+	{ FreeRDP_ComputerName, 7, "FreeRDP_ComputerName", offsetof(rdpSettings, ComputerName) },
+	{ FreeRDP_ConfigPath, 7, "FreeRDP_ConfigPath", offsetof(rdpSettings, ConfigPath) },
+	{ FreeRDP_ConnectionFile, 7, "FreeRDP_ConnectionFile", offsetof(rdpSettings, ConnectionFile) },
+	{ FreeRDP_ContainerName, 7, "FreeRDP_ContainerName", offsetof(rdpSettings, ContainerName) },
+	{ FreeRDP_CspName, 7, "FreeRDP_CspName", offsetof(rdpSettings, CspName) },
+	{ FreeRDP_CurrentPath, 7, "FreeRDP_CurrentPath", offsetof(rdpSettings, CurrentPath) },
+	{ FreeRDP_Domain, 7, "FreeRDP_Domain", offsetof(rdpSettings, Domain) },
+	{ FreeRDP_DrivesToRedirect, 7, "FreeRDP_DrivesToRedirect",
+	  offsetof(rdpSettings, DrivesToRedirect) },
+	{ FreeRDP_DumpRemoteFxFile, 7, "FreeRDP_DumpRemoteFxFile",
+	  offsetof(rdpSettings, DumpRemoteFxFile) },
+	{ FreeRDP_DynamicDSTTimeZoneKeyName, 7, "FreeRDP_DynamicDSTTimeZoneKeyName",
+	  offsetof(rdpSettings, DynamicDSTTimeZoneKeyName) },
+	{ FreeRDP_GatewayAcceptedCert, 7, "FreeRDP_GatewayAcceptedCert",
+	  offsetof(rdpSettings, GatewayAcceptedCert) },
+	{ FreeRDP_GatewayAccessToken, 7, "FreeRDP_GatewayAccessToken",
+	  offsetof(rdpSettings, GatewayAccessToken) },
+	{ FreeRDP_GatewayDomain, 7, "FreeRDP_GatewayDomain", offsetof(rdpSettings, GatewayDomain) },
+	{ FreeRDP_GatewayHostname, 7, "FreeRDP_GatewayHostname",
+	  offsetof(rdpSettings, GatewayHostname) },
+	{ FreeRDP_GatewayInnerTlsCiphers, 7, "FreeRDP_GatewayInnerTlsCiphers",
+	  offsetof(rdpSettings, GatewayInnerTlsCiphers) },
+	{ FreeRDP_GatewayPassword, 7, "FreeRDP_GatewayPassword",
+	  offsetof(rdpSettings, GatewayPassword) },
+	{ FreeRDP_GatewayUsername, 7, "FreeRDP_GatewayUsername",
+	  offsetof(rdpSettings, GatewayUsername) },
+	{ FreeRDP_HomePath, 7, "FreeRDP_HomePath", offsetof(rdpSettings, HomePath) },
+	{ FreeRDP_ImeFileName, 7, "FreeRDP_ImeFileName", offsetof(rdpSettings, ImeFileName) },
+	{ FreeRDP_KerberosArmor, 7, "FreeRDP_KerberosArmor", offsetof(rdpSettings, KerberosArmor) },
+	{ FreeRDP_KerberosCache, 7, "FreeRDP_KerberosCache", offsetof(rdpSettings, KerberosCache) },
+	{ FreeRDP_KerberosKdc, 7, "FreeRDP_KerberosKdc", offsetof(rdpSettings, KerberosKdc) },
+	{ FreeRDP_KerberosLifeTime, 7, "FreeRDP_KerberosLifeTime",
+	  offsetof(rdpSettings, KerberosLifeTime) },
+	{ FreeRDP_KerberosRealm, 7, "FreeRDP_KerberosRealm", offsetof(rdpSettings, KerberosRealm) },
+	{ FreeRDP_KerberosRenewableLifeTime, 7, "FreeRDP_KerberosRenewableLifeTime",
+	  offsetof(rdpSettings, KerberosRenewableLifeTime) },
+	{ FreeRDP_KerberosStartTime, 7, "FreeRDP_KerberosStartTime",
+	  offsetof(rdpSettings, KerberosStartTime) },
+	{ FreeRDP_KeyboardRemappingList, 7, "FreeRDP_KeyboardRemappingList",
+	  offsetof(rdpSettings, KeyboardRemappingList) },
+	{ FreeRDP_NtlmSamFile, 7, "FreeRDP_NtlmSamFile", offsetof(rdpSettings, NtlmSamFile) },
+	{ FreeRDP_Password, 7, "FreeRDP_Password", offsetof(rdpSettings, Password) },
+	{ FreeRDP_PasswordHash, 7, "FreeRDP_PasswordHash", offsetof(rdpSettings, PasswordHash) },
+	{ FreeRDP_Pkcs11Module, 7, "FreeRDP_Pkcs11Module", offsetof(rdpSettings, Pkcs11Module) },
+	{ FreeRDP_PkinitAnchors, 7, "FreeRDP_PkinitAnchors", offsetof(rdpSettings, PkinitAnchors) },
+	{ FreeRDP_PlayRemoteFxFile, 7, "FreeRDP_PlayRemoteFxFile",
+	  offsetof(rdpSettings, PlayRemoteFxFile) },
+	{ FreeRDP_PreconnectionBlob, 7, "FreeRDP_PreconnectionBlob",
+	  offsetof(rdpSettings, PreconnectionBlob) },
+	{ FreeRDP_PrivateKeyContent, 7, "FreeRDP_PrivateKeyContent",
+	  offsetof(rdpSettings, PrivateKeyContent) },
+	{ FreeRDP_PrivateKeyFile, 7, "FreeRDP_PrivateKeyFile", offsetof(rdpSettings, PrivateKeyFile) },
+	{ FreeRDP_ProxyHostname, 7, "FreeRDP_ProxyHostname", offsetof(rdpSettings, ProxyHostname) },
+	{ FreeRDP_ProxyPassword, 7, "FreeRDP_ProxyPassword", offsetof(rdpSettings, ProxyPassword) },
+	{ FreeRDP_ProxyUsername, 7, "FreeRDP_ProxyUsername", offsetof(rdpSettings, ProxyUsername) },
+	{ FreeRDP_RDP2TCPArgs, 7, "FreeRDP_RDP2TCPArgs", offsetof(rdpSettings, RDP2TCPArgs) },
+	{ FreeRDP_RdpKeyContent, 7, "FreeRDP_RdpKeyContent", offsetof(rdpSettings, RdpKeyContent) },
+	{ FreeRDP_RdpKeyFile, 7, "FreeRDP_RdpKeyFile", offsetof(rdpSettings, RdpKeyFile) },
+	{ FreeRDP_ReaderName, 7, "FreeRDP_ReaderName", offsetof(rdpSettings, ReaderName) },
+	{ FreeRDP_RedirectionAcceptedCert, 7, "FreeRDP_RedirectionAcceptedCert",
+	  offsetof(rdpSettings, RedirectionAcceptedCert) },
+	{ FreeRDP_RedirectionDomain, 7, "FreeRDP_RedirectionDomain",
+	  offsetof(rdpSettings, RedirectionDomain) },
+	{ FreeRDP_RedirectionTargetFQDN, 7, "FreeRDP_RedirectionTargetFQDN",
+	  offsetof(rdpSettings, RedirectionTargetFQDN) },
+	{ FreeRDP_RedirectionTargetNetBiosName, 7, "FreeRDP_RedirectionTargetNetBiosName",
+	  offsetof(rdpSettings, RedirectionTargetNetBiosName) },
+	{ FreeRDP_RedirectionUsername, 7, "FreeRDP_RedirectionUsername",
+	  offsetof(rdpSettings, RedirectionUsername) },
+	{ FreeRDP_RemoteApplicationCmdLine, 7, "FreeRDP_RemoteApplicationCmdLine",
+	  offsetof(rdpSettings, RemoteApplicationCmdLine) },
+	{ FreeRDP_RemoteApplicationFile, 7, "FreeRDP_RemoteApplicationFile",
+	  offsetof(rdpSettings, RemoteApplicationFile) },
+	{ FreeRDP_RemoteApplicationGuid, 7, "FreeRDP_RemoteApplicationGuid",
+	  offsetof(rdpSettings, RemoteApplicationGuid) },
+	{ FreeRDP_RemoteApplicationIcon, 7, "FreeRDP_RemoteApplicationIcon",
+	  offsetof(rdpSettings, RemoteApplicationIcon) },
+	{ FreeRDP_RemoteApplicationName, 7, "FreeRDP_RemoteApplicationName",
+	  offsetof(rdpSettings, RemoteApplicationName) },
+	{ FreeRDP_RemoteApplicationProgram, 7, "FreeRDP_RemoteApplicationProgram",
+	  offsetof(rdpSettings, RemoteApplicationProgram) },
+	{ FreeRDP_RemoteApplicationWorkingDir, 7, "FreeRDP_RemoteApplicationWorkingDir",
+	  offsetof(rdpSettings, RemoteApplicationWorkingDir) },
+	{ FreeRDP_RemoteAssistancePassStub, 7, "FreeRDP_RemoteAssistancePassStub",
+	  offsetof(rdpSettings, RemoteAssistancePassStub) },
+	{ FreeRDP_RemoteAssistancePassword, 7, "FreeRDP_RemoteAssistancePassword",
+	  offsetof(rdpSettings, RemoteAssistancePassword) },
+	{ FreeRDP_RemoteAssistanceRCTicket, 7, "FreeRDP_RemoteAssistanceRCTicket",
+	  offsetof(rdpSettings, RemoteAssistanceRCTicket) },
+	{ FreeRDP_RemoteAssistanceSessionId, 7, "FreeRDP_RemoteAssistanceSessionId",
+	  offsetof(rdpSettings, RemoteAssistanceSessionId) },
+	{ FreeRDP_ServerHostname, 7, "FreeRDP_ServerHostname", offsetof(rdpSettings, ServerHostname) },
+	{ FreeRDP_ShellWorkingDirectory, 7, "FreeRDP_ShellWorkingDirectory",
+	  offsetof(rdpSettings, ShellWorkingDirectory) },
+	{ FreeRDP_SmartcardCertificate, 7, "FreeRDP_SmartcardCertificate",
+	  offsetof(rdpSettings, SmartcardCertificate) },
+	{ FreeRDP_SmartcardPin, 7, "FreeRDP_SmartcardPin", offsetof(rdpSettings, SmartcardPin) },
+	{ FreeRDP_SmartcardPrivateKey, 7, "FreeRDP_SmartcardPrivateKey",
+	  offsetof(rdpSettings, SmartcardPrivateKey) },
+	{ FreeRDP_TargetNetAddress, 7, "FreeRDP_TargetNetAddress",
+	  offsetof(rdpSettings, TargetNetAddress) },
+	{ FreeRDP_TransportDumpFile, 7, "FreeRDP_TransportDumpFile",
+	  offsetof(rdpSettings, TransportDumpFile) },
+	{ FreeRDP_Username, 7, "FreeRDP_Username", offsetof(rdpSettings, Username) },
+	{ FreeRDP_WindowTitle, 7, "FreeRDP_WindowTitle", offsetof(rdpSettings, WindowTitle) },
+	{ FreeRDP_WmClass, 7, "FreeRDP_WmClass", offsetof(rdpSettings, WmClass) },
+	{ FreeRDP_BitmapCacheV2CellInfo, 8, "FreeRDP_BitmapCacheV2CellInfo",
+	  offsetof(rdpSettings, BitmapCacheV2CellInfo) },
+	{ FreeRDP_ChannelDefArray, 8, "FreeRDP_ChannelDefArray",
+	  offsetof(rdpSettings, ChannelDefArray) },
+	{ FreeRDP_ClientAutoReconnectCookie, 8, "FreeRDP_ClientAutoReconnectCookie",
+	  offsetof(rdpSettings, ClientAutoReconnectCookie) },
+	{ FreeRDP_ClientRandom, 8, "FreeRDP_ClientRandom", offsetof(rdpSettings, ClientRandom) },
+	{ FreeRDP_ClientTimeZone, 8, "FreeRDP_ClientTimeZone", offsetof(rdpSettings, ClientTimeZone) },
+	{ FreeRDP_DeviceArray, 8, "FreeRDP_DeviceArray", offsetof(rdpSettings, DeviceArray) },
+	{ FreeRDP_DynamicChannelArray, 8, "FreeRDP_DynamicChannelArray",
+	  offsetof(rdpSettings, DynamicChannelArray) },
+	{ FreeRDP_FragCache, 8, "FreeRDP_FragCache", offsetof(rdpSettings, FragCache) },
+	{ FreeRDP_GlyphCache, 8, "FreeRDP_GlyphCache", offsetof(rdpSettings, GlyphCache) },
+	{ FreeRDP_LoadBalanceInfo, 8, "FreeRDP_LoadBalanceInfo",
+	  offsetof(rdpSettings, LoadBalanceInfo) },
+	{ FreeRDP_MonitorDefArray, 8, "FreeRDP_MonitorDefArray",
+	  offsetof(rdpSettings, MonitorDefArray) },
+	{ FreeRDP_MonitorIds, 8, "FreeRDP_MonitorIds", offsetof(rdpSettings, MonitorIds) },
+	{ FreeRDP_OrderSupport, 8, "FreeRDP_OrderSupport", offsetof(rdpSettings, OrderSupport) },
+	{ FreeRDP_Password51, 8, "FreeRDP_Password51", offsetof(rdpSettings, Password51) },
+	{ FreeRDP_RdpServerCertificate, 8, "FreeRDP_RdpServerCertificate",
+	  offsetof(rdpSettings, RdpServerCertificate) },
+	{ FreeRDP_RdpServerRsaKey, 8, "FreeRDP_RdpServerRsaKey",
+	  offsetof(rdpSettings, RdpServerRsaKey) },
+	{ FreeRDP_ReceivedCapabilities, 8, "FreeRDP_ReceivedCapabilities",
+	  offsetof(rdpSettings, ReceivedCapabilities) },
+	{ FreeRDP_RedirectionPassword, 8, "FreeRDP_RedirectionPassword",
+	  offsetof(rdpSettings, RedirectionPassword) },
+	{ FreeRDP_RedirectionTsvUrl, 8, "FreeRDP_RedirectionTsvUrl",
+	  offsetof(rdpSettings, RedirectionTsvUrl) },
+	{ FreeRDP_ServerAutoReconnectCookie, 8, "FreeRDP_ServerAutoReconnectCookie",
+	  offsetof(rdpSettings, ServerAutoReconnectCookie) },
+	{ FreeRDP_ServerCertificate, 8, "FreeRDP_ServerCertificate",
+	  offsetof(rdpSettings, ServerCertificate) },
+	{ FreeRDP_ServerRandom, 8, "FreeRDP_ServerRandom", offsetof(rdpSettings, ServerRandom) },
+	{ FreeRDP_StaticChannelArray, 8, "FreeRDP_StaticChannelArray",
+	  offsetof(rdpSettings, StaticChannelArray) },
+	{ FreeRDP_TargetNetAddresses, 8, "FreeRDP_TargetNetAddresses",
+	  offsetof(rdpSettings, TargetNetAddresses) },
+	{ FreeRDP_TargetNetPorts, 8, "FreeRDP_TargetNetPorts", offsetof(rdpSettings, TargetNetPorts) },
+	{ FreeRDP_instance, 8, "FreeRDP_instance", offsetof(rdpSettings, instance) },
 };
 
+/* Every key occupies one 64bit slot of rdpSettings, the key is the slot index.
+ * settings_index maps a key to its settings_map entry + 1, 0 marks unused slots. */
+static UINT16 settings_index[sizeof(rdpSettings) / sizeof(UINT64)];
+static INIT_ONCE settings_index_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK settings_index_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	size_t x;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	for (x = 0; x < ARRAYSIZE(settings_map); x++)
+	{
+		const struct settings_str_entry* cur = &settings_map[x];
+		WINPR_ASSERT(cur->id < ARRAYSIZE(settings_index));
+		settings_index[cur->id] = (UINT16)(x + 1);
+	}
+
+	return TRUE;
+}
+
+static const struct settings_str_entry* settings_entry_for_key(size_t key)
+{
+	size_t index;
+
+	if (key >= ARRAYSIZE(settings_index))
+		return NULL;
+
+	InitOnceExecuteOnce(&settings_index_once, settings_index_init, NULL, NULL);
+	index = settings_index[key];
+
+	if (index == 0)
+		return NULL;
+
+	return &settings_map[index - 1];
+}
+
+void* freerdp_settings_get_field_writable(rdpSettings* settings, size_t id, size_t type)
+{
+	const struct settings_str_entry* cur = settings_entry_for_key(id);
+
+	WINPR_ASSERT(settings);
+
+	if (!cur || (cur->type != type))
+		return NULL;
+
+	return (BYTE*)settings + cur->offset;
+}
+
+const void* freerdp_settings_get_field(const rdpSettings* settings, size_t id, size_t type)
+{
+	const struct settings_str_entry* cur = settings_entry_for_key(id);
+
+	WINPR_ASSERT(settings);
+
+	if (!cur || (cur->type != type))
+		return NULL;
+
+	return (const BYTE*)settings + cur->offset;
+}
+
 BOOL freerdp_settings_clone_keys(rdpSettings* dst, const rdpSettings* src)
 {
 	size_t x;
@@ -608,24 +943,16 @@ SSIZE_T freerdp_settings_get_type_for_name(const char* value)
 
 SSIZE_T freerdp_settings_get_type_for_key(size_t key)
 {
-	size_t x;
-	for (x = 0; x < ARRAYSIZE(settings_map); x++)
-	{
-		const struct settings_str_entry* cur = &settings_map[x];
-		if (cur->id == key)
-			return cur->type;
-	}
-	return -1;
+	const struct settings_str_entry* cur = settings_entry_for_key(key);
+	if (!cur)
+		return -1;
+	return (SSIZE_T)cur->type;
 }
 
 const char* freerdp_settings_get_name_for_key(size_t key)
 {
-	size_t x;
-	for (x = 0; x < ARRAYSIZE(settings_map); x++)
-	{
-		const struct settings_str_entry* cur = &settings_map[x];
-		if (cur->id == key)
-			return cur->str;
-	}
-	return NULL;
+	const struct settings_str_entry* cur = settings_entry_for_key(key);
+	if (!cur)
+		return NULL;
+	return cur->str;
 }
@@ -21,8 +21,11 @@
 
 #include <winpr/assert.h>
 
+#include <freerdp/cache/cache.h>
+
 #include "activation.h"
 #include "display.h"
+#include "../cache/bitmap.h"
 
 #define TAG FREERDP_TAG("core.activation")
 
@@ -244,43 +247,122 @@ static BOOL rdp_write_persistent_list_entry(wStream* s, UINT32 key1, UINT32 key2
 	return TRUE;
 }
 
-static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, const rdpSettings* settings)
+/* [MS-RDPBCGR] 2.2.1.17.1 a PDU carries at most 169 keys */
+#define PERSIST_MAX_KEYS_PER_PDU 169
+
+static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, const rdpBitmapCache* cache,
+                                                     UINT32 first, UINT32 count, BYTE flags)
 {
+	UINT32 x, index;
+	UINT32 offset = 0;
+	UINT16 numEntries[5] = { 0 };
+	UINT16 totalEntries[5] = { 0 };
+
 	WINPR_ASSERT(s);
-	WINPR_ASSERT(settings);
 
-	if (Stream_GetRemainingCapacity(s) < 24)
-		return FALSE;
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache4 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache4 (2 bytes) */
-	Stream_Write_UINT8(s, PERSIST_FIRST_PDU | PERSIST_LAST_PDU); /* bBitMask (1 byte) */
-	Stream_Write_UINT8(s, 0);                                    /* pad1 (1 byte) */
-	Stream_Write_UINT16(s, 0);                                   /* pad3 (2 bytes) */
-	                                                             /* entries */
+	for (x = 0; x < ARRAYSIZE(totalEntries); x++)
+	{
+		const UINT32 total = bitmap_cache_get_persistent_count(cache, x);
+		WINPR_ASSERT(total <= UINT16_MAX);
+		totalEntries[x] = (UINT16)total;
+
+		/* the keys of this PDU continue where the previous one stopped */
+		if ((first < offset + total) && (first + count > offset))
+			numEntries[x] = (UINT16)(MIN(first + count, offset + total) - MAX(first, offset));
+
+		offset += total;
+	}
+
+	if (Stream_GetRemainingCapacity(s) < 24ull + 8ull * count)
+		return FALSE;
+
+	for (x = 0; x < ARRAYSIZE(numEntries); x++)
+		Stream_Write_UINT16(s, numEntries[x]); /* numEntriesCacheX (2 bytes) */
+
+	for (x = 0; x < ARRAYSIZE(totalEntries); x++)
+		Stream_Write_UINT16(s, totalEntries[x]); /* totalEntriesCacheX (2 bytes) */
+
+	Stream_Write_UINT8(s, flags); /* bBitMask (1 byte) */
+	Stream_Write_UINT8(s, 0);     /* pad1 (1 byte) */
+	Stream_Write_UINT16(s, 0);    /* pad3 (2 bytes) */
+
+	/* entries */
+	offset = 0;
+
+	for (x = 0; x < ARRAYSIZE(totalEntries); x++)
+	{
+		for (index = 0; index < totalEntries[x]; index++, offset++)
+		{
+			UINT64 key;
+
+			if ((offset < first) || (offset >= first + count))
+				continue;
+
+			key = bitmap_cache_get_persistent_key(cache, x, index);
+
+			if (!rdp_write_persistent_list_entry(s, (UINT32)(key & UINT32_MAX),
+			                                     (UINT32)(key >> 32)))
+				return FALSE;
+		}
+	}
+
 	return TRUE;
 }
 
+/**
+ * Sends the keys of the bitmaps loaded from the persistent cache, split into PDUs of at most
+ * PERSIST_MAX_KEYS_PER_PDU keys. Without a persistent cache a single empty list is sent.
+ */
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
-	wStream* s = rdp_data_pdu_init(rdp);
-	if (!s)
-		return FALSE;
-	if (!rdp_write_client_persistent_key_list_pdu(s, rdp->settings))
+	UINT32 x;
+	UINT32 first = 0;
+	UINT32 total = 0;
+	const rdpBitmapCache* cache = NULL;
+
+	WINPR_ASSERT(rdp);
+	WINPR_ASSERT(rdp->context);
+
+	if (rdp->context->cache)
+		cache = rdp->context->cache->bitmap;
+
+	for (x = 0; x < 5; x++)
+		total += bitmap_cache_get_persistent_count(cache, x);
+
+	do
 	{
-		Stream_Free(s, TRUE);
-		return FALSE;
-	}
+		wStream* s;
+		BYTE flags = 0;
+		const UINT32 count = MIN(total - first, PERSIST_MAX_KEYS_PER_PDU);
 
-	WINPR_ASSERT(rdp->mcs);
-	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST, rdp->mcs->userId);
+		if (first == 0)
+			flags |= PERSIST_FIRST_PDU;
+
+		if (first + count >= total)
+			flags |= PERSIST_LAST_PDU;
+
+		s = rdp_data_pdu_init(rdp);
+
+		if (!s)
+			return FALSE;
+
+		if (!rdp_write_client_persistent_key_list_pdu(s, cache, first, count, flags))
+		{
+			Stream_Free(s, TRUE);
+			return FALSE;
+		}
+
+		WINPR_ASSERT(rdp->mcs);
+
+		if (!rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST,
+		                       rdp->mcs->userId))
+			return FALSE;
+
+		first += count;
+	} while (first < total);
+
+	WLog_DBG(TAG, "sent %" PRIu32 " persistent bitmap cache keys", total);
+	return TRUE;
 }
 
 BOOL rdp_recv_client_font_list_pdu(wStream* s)
@@ -407,6 +407,9 @@ static BOOL autodetect_recv_rtt_measure_response(rdpRdp* rdp, wStream* s,
 	    rdp->autodetect->netCharBaseRTT > rdp->autodetect->netCharAverageRTT)
 		rdp->autodetect->netCharBaseRTT = rdp->autodetect->netCharAverageRTT;
 
+	metrics_histogram_record(rdp->context->metrics, FREERDP_METRIC_RTT,
+	                         rdp->autodetect->netCharAverageRTT * 1000ull);
+
 	IFCALLRET(rdp->autodetect->RTTMeasureResponse, success, rdp->context,
 	          autodetectRspPdu->sequenceNumber);
 	return success;
@@ -566,6 +569,9 @@ static BOOL autodetect_recv_netchar_result(rdpRdp* rdp, wStream* s,
 			break;
 	}
 
+	metrics_histogram_record(rdp->context->metrics, FREERDP_METRIC_RTT,
+	                         rdp->autodetect->netCharAverageRTT * 1000ull);
+
 	WLog_VRB(AUTODETECT_TAG,
 	         "received Network Characteristics Result PDU -> baseRTT=%" PRIu32
 	         ", bandwidth=%" PRIu32 ", averageRTT=%" PRIu32 "",
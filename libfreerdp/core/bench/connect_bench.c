@@ -0,0 +1,916 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Connection Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Runs a minimal server and a number of clients in one process and connects them over the
+ * loopback interface until the requested number of connections went through TCP accept,
+ * TLS, NLA, the capabilities exchange and activation. The clients disconnect as soon as they
+ * are active.
+ *
+ * Reported are connections per second, the client connect latency, the server side
+ * accept to activation time, the time the clients spent per connection phase and the CPU
+ * time per connection, split into the client threads and the rest of the process.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/ntlm.h>
+#include <winpr/synch.h>
+#include <winpr/ssl.h>
+#include <winpr/thread.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+#include <winpr/winsock.h>
+#include <winpr/interlocked.h>
+#include <winpr/tools/makecert.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/listener.h>
+#include <freerdp/peer.h>
+#include <freerdp/log.h>
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#define BENCH_USER "bench"
+#define BENCH_PASSWORD "bench"
+#define BENCH_PORT_ATTEMPTS 32
+#define BENCH_SHUTDOWN_TIMEOUT 10000
+
+typedef enum
+{
+	BENCH_SECURITY_NLA,
+	BENCH_SECURITY_TLS,
+	BENCH_SECURITY_RDP
+} BENCH_SECURITY;
+
+static const char* bench_security_names[] = { "nla", "tls", "rdp" };
+
+/* Client connection phases, every phase spans a range of connection states */
+typedef struct
+{
+	const char* name;
+	CONNECTION_STATE first;
+	CONNECTION_STATE last;
+} BENCH_PHASE;
+
+static const BENCH_PHASE bench_phases[] = {
+	{ "nego", CONNECTION_STATE_NEGO, CONNECTION_STATE_NEGO }, /* TCP, X.224 and TLS */
+	{ "nla", CONNECTION_STATE_NLA, CONNECTION_STATE_NLA },
+	{ "mcs", CONNECTION_STATE_MCS_CONNECT, CONNECTION_STATE_MCS_CHANNEL_JOIN },
+	{ "security", CONNECTION_STATE_RDP_SECURITY_COMMENCEMENT,
+	  CONNECTION_STATE_CONNECT_TIME_AUTO_DETECT },
+	{ "licensing", CONNECTION_STATE_LICENSING, CONNECTION_STATE_MULTITRANSPORT_BOOTSTRAPPING },
+	{ "caps", CONNECTION_STATE_CAPABILITIES_EXCHANGE, CONNECTION_STATE_CAPABILITIES_EXCHANGE },
+	{ "finalize", CONNECTION_STATE_FINALIZATION, CONNECTION_STATE_FINALIZATION }
+};
+
+typedef struct
+{
+	/* configuration */
+	size_t connections;
+	size_t concurrency;
+	long workers;
+	UINT32 maxHandshakes;
+	BENCH_SECURITY security;
+	UINT16 port;
+	char* directory;
+	char* certificateFile;
+	char* privateKeyFile;
+	char* samFile;
+
+	/* server */
+	freerdp_listener* listener;
+	freerdp_peer_reactor* reactor;
+	HANDLE stopEvent;
+	HANDLE listenerThread;
+	volatile LONG peers;
+	volatile LONG activated;
+	UINT64* serverTimes;
+
+	/* clients */
+	volatile LONG next;
+	volatile LONG succeeded;
+	volatile LONG failed;
+	UINT64* clientTimes;
+	CRITICAL_SECTION lock;
+	UINT64 phaseTimes[ARRAYSIZE(bench_phases)];
+	UINT64 clientCpu;
+} BENCH;
+
+typedef struct
+{
+	rdpContext _p;
+
+	BENCH* bench;
+	UINT64 accepted;
+} benchPeerContext;
+
+static UINT64 bench_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count;
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&count);
+	return (UINT64)((count.QuadPart / frequency.QuadPart) * 1000000000ULL +
+	                ((count.QuadPart % frequency.QuadPart) * 1000000000ULL) / frequency.QuadPart);
+#else
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (UINT64)ts.tv_sec * 1000000000ULL + (UINT64)ts.tv_nsec;
+#endif
+}
+
+#ifdef _WIN32
+static UINT64 bench_filetime_ns(const FILETIME* kernel, const FILETIME* user)
+{
+	const UINT64 k = ((UINT64)kernel->dwHighDateTime << 32) | kernel->dwLowDateTime;
+	const UINT64 u = ((UINT64)user->dwHighDateTime << 32) | user->dwLowDateTime;
+	return (k + u) * 100ULL;
+}
+#endif
+
+/* CPU time of the calling thread in nanoseconds */
+static UINT64 bench_thread_cpu(void)
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	return bench_filetime_ns(&kernel, &user);
+#else
+	struct timespec ts = { 0 };
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+
+	return (UINT64)ts.tv_sec * 1000000000ULL + (UINT64)ts.tv_nsec;
+#endif
+}
+
+/* CPU time of the whole process in nanoseconds */
+static UINT64 bench_process_cpu(void)
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	return bench_filetime_ns(&kernel, &user);
+#else
+	struct rusage usage = { 0 };
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return ((UINT64)usage.ru_utime.tv_sec + (UINT64)usage.ru_stime.tv_sec) * 1000000000ULL +
+	       ((UINT64)usage.ru_utime.tv_usec + (UINT64)usage.ru_stime.tv_usec) * 1000ULL;
+#endif
+}
+
+static BOOL bench_set_security(rdpSettings* settings, BENCH_SECURITY security)
+{
+	return freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity,
+	                                 security == BENCH_SECURITY_NLA) &&
+	       freerdp_settings_set_bool(settings, FreeRDP_TlsSecurity,
+	                                 security == BENCH_SECURITY_TLS) &&
+	       freerdp_settings_set_bool(settings, FreeRDP_RdpSecurity,
+	                                 security == BENCH_SECURITY_RDP);
+}
+
+static BOOL bench_prepare_credentials(BENCH* bench)
+{
+	BOOL rc = FALSE;
+	size_t x;
+	BYTE hash[16] = { 0 };
+	char name[] = "bench";
+	char* makecert_argv[] = { "makecert", "-rdp", "-live", "-silent", "-y", "1" };
+	MAKECERT_CONTEXT* makecert = NULL;
+	FILE* fp = NULL;
+	char subdir[64] = { 0 };
+
+	sprintf_s(subdir, sizeof(subdir), "freerdp-connect-bench.%" PRIu32, GetCurrentProcessId());
+	bench->directory = GetKnownSubPath(KNOWN_PATH_TEMP, subdir);
+
+	if (!bench->directory)
+		return FALSE;
+
+	if (!winpr_PathFileExists(bench->directory) && !winpr_PathMakePath(bench->directory, NULL))
+	{
+		fprintf(stderr, "failed to create %s\n", bench->directory);
+		return FALSE;
+	}
+
+	bench->certificateFile = GetCombinedPath(bench->directory, "bench.crt");
+	bench->privateKeyFile = GetCombinedPath(bench->directory, "bench.key");
+	bench->samFile = GetCombinedPath(bench->directory, "bench.sam");
+
+	if (!bench->certificateFile || !bench->privateKeyFile || !bench->samFile)
+		return FALSE;
+
+	makecert = makecert_context_new();
+
+	if (!makecert)
+		return FALSE;
+
+	if ((makecert_context_process(makecert, ARRAYSIZE(makecert_argv), makecert_argv) < 0) ||
+	    (makecert_context_set_output_file_name(makecert, name) != 1) ||
+	    (makecert_context_output_certificate_file(makecert, bench->directory) != 1) ||
+	    (makecert_context_output_private_key_file(makecert, bench->directory) != 1))
+	{
+		fprintf(stderr, "failed to create the server certificate\n");
+		goto fail;
+	}
+
+	/* SAM entry of the NLA user: User:Domain:LmHash:NtHash::: */
+	if (!NTOWFv1A(BENCH_PASSWORD, strlen(BENCH_PASSWORD), hash))
+		goto fail;
+
+	fp = winpr_fopen(bench->samFile, "w");
+
+	if (!fp)
+		goto fail;
+
+	fprintf(fp, "%s:::", BENCH_USER);
+
+	for (x = 0; x < sizeof(hash); x++)
+		fprintf(fp, "%02" PRIx8, hash[x]);
+
+	fprintf(fp, ":::\n");
+	rc = fclose(fp) == 0;
+fail:
+	makecert_context_free(makecert);
+	return rc;
+}
+
+static void bench_remove_credentials(BENCH* bench)
+{
+	if (bench->certificateFile)
+		winpr_DeleteFile(bench->certificateFile);
+
+	if (bench->privateKeyFile)
+		winpr_DeleteFile(bench->privateKeyFile);
+
+	if (bench->samFile)
+		winpr_DeleteFile(bench->samFile);
+
+	if (bench->directory)
+		RemoveDirectoryA(bench->directory);
+
+	free(bench->certificateFile);
+	free(bench->privateKeyFile);
+	free(bench->samFile);
+	free(bench->directory);
+}
+
+static BOOL bench_peer_post_connect(freerdp_peer* client)
+{
+	WINPR_UNUSED(client);
+	return TRUE;
+}
+
+static BOOL bench_peer_activate(freerdp_peer* client)
+{
+	LONG index;
+	benchPeerContext* context = (benchPeerContext*)client->context;
+	BENCH* bench = context->bench;
+
+	index = InterlockedIncrement(&bench->activated) - 1;
+
+	if ((size_t)index < bench->connections)
+		bench->serverTimes[index] = bench_now() - context->accepted;
+
+	return TRUE;
+}
+
+static void bench_peer_disconnected(freerdp_peer* client)
+{
+	BENCH* bench = ((benchPeerContext*)client->context)->bench;
+
+	client->Disconnect(client);
+	freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+	InterlockedDecrement(&bench->peers);
+}
+
+static DWORD WINAPI bench_peer_thread(LPVOID arg)
+{
+	HANDLE handles[32] = { 0 };
+	freerdp_peer* client = (freerdp_peer*)arg;
+
+	while (TRUE)
+	{
+		const DWORD count = client->GetEventHandles(client, handles, ARRAYSIZE(handles));
+
+		if (count == 0)
+			break;
+
+		if (WaitForMultipleObjects(count, handles, FALSE, INFINITE) == WAIT_FAILED)
+			break;
+
+		if (!client->CheckFileDescriptor(client))
+			break;
+	}
+
+	bench_peer_disconnected(client);
+	return 0;
+}
+
+static BOOL bench_peer_setup(BENCH* bench, freerdp_peer* client)
+{
+	rdpSettings* settings;
+	benchPeerContext* context;
+
+	client->ContextSize = sizeof(benchPeerContext);
+
+	if (!freerdp_peer_context_new(client))
+		return FALSE;
+
+	context = (benchPeerContext*)client->context;
+	context->bench = bench;
+	context->accepted = bench_now();
+	settings = client->context->settings;
+
+	if (!freerdp_settings_set_string(settings, FreeRDP_CertificateFile, bench->certificateFile) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_PrivateKeyFile, bench->privateKeyFile) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_RdpKeyFile, bench->privateKeyFile) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_NtlmSamFile, bench->samFile) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_MaxConcurrentHandshakes,
+	                                 bench->maxHandshakes) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_EncryptionLevel,
+	                                 ENCRYPTION_LEVEL_CLIENT_COMPATIBLE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ColorDepth, 32) ||
+	    !bench_set_security(settings, bench->security))
+		goto fail;
+
+	client->PostConnect = bench_peer_post_connect;
+	client->Activate = bench_peer_activate;
+
+	if (!client->Initialize(client))
+		goto fail;
+
+	return TRUE;
+fail:
+	freerdp_peer_context_free(client);
+	return FALSE;
+}
+
+static BOOL bench_peer_accepted(freerdp_listener* listener, freerdp_peer* client)
+{
+	HANDLE thread;
+	BENCH* bench = (BENCH*)listener->info;
+
+	if (!bench_peer_setup(bench, client))
+		return FALSE;
+
+	InterlockedIncrement(&bench->peers);
+
+	if (bench->reactor)
+	{
+		client->ReactorRemoved = bench_peer_disconnected;
+
+		if (freerdp_peer_reactor_add(bench->reactor, client))
+			return TRUE;
+	}
+	else
+	{
+		thread = CreateThread(NULL, 0, bench_peer_thread, client, 0, NULL);
+
+		if (thread)
+		{
+			CloseHandle(thread);
+			return TRUE;
+		}
+	}
+
+	InterlockedDecrement(&bench->peers);
+	freerdp_peer_context_free(client);
+	return FALSE;
+}
+
+static DWORD WINAPI bench_listener_thread(LPVOID arg)
+{
+	HANDLE handles[32] = { 0 };
+	BENCH* bench = (BENCH*)arg;
+	freerdp_listener* listener = bench->listener;
+
+	while (TRUE)
+	{
+		DWORD status;
+		DWORD count = listener->GetEventHandles(listener, handles, ARRAYSIZE(handles) - 1);
+
+		if (count == 0)
+			break;
+
+		handles[count++] = bench->stopEvent;
+		status = WaitForMultipleObjects(count, handles, FALSE, INFINITE);
+
+		if ((status == WAIT_FAILED) || (status == WAIT_OBJECT_0 + count - 1))
+			break;
+
+		if (!listener->CheckFileDescriptor(listener))
+			break;
+	}
+
+	return 0;
+}
+
+static BOOL bench_server_start(BENCH* bench)
+{
+	size_t attempt;
+	UINT16 port = bench->port;
+
+	bench->listener = freerdp_listener_new();
+
+	if (!bench->listener)
+		return FALSE;
+
+	bench->listener->info = bench;
+	bench->listener->PeerAccepted = bench_peer_accepted;
+
+	if (bench->workers >= 0)
+	{
+		bench->reactor = freerdp_peer_reactor_new((DWORD)bench->workers);
+
+		if (!bench->reactor)
+			return FALSE;
+	}
+
+	/* without a fixed port try a few random ones, parallel test runs must not collide */
+	for (attempt = 0; attempt < BENCH_PORT_ATTEMPTS; attempt++)
+	{
+		if (bench->port == 0)
+		{
+			UINT16 random = 0;
+			winpr_RAND((BYTE*)&random, sizeof(random));
+			port = (UINT16)(20000 + random % 20000);
+		}
+
+		if (bench->listener->Open(bench->listener, "127.0.0.1", port))
+			break;
+
+		if (bench->port != 0)
+			attempt = BENCH_PORT_ATTEMPTS;
+	}
+
+	if (attempt >= BENCH_PORT_ATTEMPTS)
+	{
+		fprintf(stderr, "failed to listen on 127.0.0.1\n");
+		return FALSE;
+	}
+
+	bench->port = port;
+	bench->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!bench->stopEvent)
+		return FALSE;
+
+	bench->listenerThread = CreateThread(NULL, 0, bench_listener_thread, bench, 0, NULL);
+	return bench->listenerThread != NULL;
+}
+
+static void bench_server_stop(BENCH* bench)
+{
+	const UINT64 start = GetTickCount64();
+
+	if (bench->listenerThread)
+	{
+		SetEvent(bench->stopEvent);
+		WaitForSingleObject(bench->listenerThread, INFINITE);
+		CloseHandle(bench->listenerThread);
+	}
+
+	/* the peers go away once their client disconnected */
+	while ((bench->peers > 0) && (GetTickCount64() - start < BENCH_SHUTDOWN_TIMEOUT))
+		Sleep(10);
+
+	if (bench->peers > 0)
+		fprintf(stderr, "%" PRId32 " peers did not disconnect\n", bench->peers);
+
+	freerdp_peer_reactor_free(bench->reactor);
+
+	if (bench->listener)
+		bench->listener->Close(bench->listener);
+
+	freerdp_listener_free(bench->listener);
+
+	if (bench->stopEvent)
+		CloseHandle(bench->stopEvent);
+}
+
+static BOOL bench_client_connect(BENCH* bench, UINT64 phases[ARRAYSIZE(bench_phases)],
+                                 UINT64* duration)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	UINT64 start;
+	rdpSettings* settings;
+	freerdp* instance = freerdp_new();
+
+	if (!instance)
+		return FALSE;
+
+	instance->ContextSize = sizeof(rdpContext);
+
+	if (!freerdp_context_new(instance))
+		goto fail;
+
+	settings = instance->context->settings;
+
+	if (!freerdp_settings_set_string(settings, FreeRDP_ServerHostname, "127.0.0.1") ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ServerPort, bench->port) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_Username, BENCH_USER) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_Password, BENCH_PASSWORD) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_IgnoreCertificate, TRUE) ||
+	    !bench_set_security(settings, bench->security))
+		goto fail;
+
+	start = bench_now();
+
+	if (!freerdp_connect(instance))
+		goto disconnect;
+
+	*duration = bench_now() - start;
+
+	for (x = 0; x < ARRAYSIZE(bench_phases); x++)
+	{
+		const BENCH_PHASE* phase = &bench_phases[x];
+		CONNECTION_STATE state;
+
+		for (state = phase->first; state <= phase->last; state++)
+			phases[x] += freerdp_get_state_duration(instance->context, state);
+	}
+
+	rc = TRUE;
+disconnect:
+	freerdp_disconnect(instance);
+fail:
+	freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
+
+static DWORD WINAPI bench_client_thread(LPVOID arg)
+{
+	size_t x;
+	BENCH* bench = (BENCH*)arg;
+	UINT64 phases[ARRAYSIZE(bench_phases)] = { 0 };
+
+	while (TRUE)
+	{
+		UINT64 duration = 0;
+		const LONG index = InterlockedIncrement(&bench->next) - 1;
+
+		if ((size_t)index >= bench->connections)
+			break;
+
+		if (bench_client_connect(bench, phases, &duration))
+		{
+			bench->clientTimes[index] = duration;
+			InterlockedIncrement(&bench->succeeded);
+		}
+		else
+			InterlockedIncrement(&bench->failed);
+	}
+
+	EnterCriticalSection(&bench->lock);
+
+	for (x = 0; x < ARRAYSIZE(phases); x++)
+		bench->phaseTimes[x] += phases[x];
+
+	bench->clientCpu += bench_thread_cpu();
+	LeaveCriticalSection(&bench->lock);
+	return 0;
+}
+
+static int bench_compare_times(const void* a, const void* b)
+{
+	const UINT64 ta = *(const UINT64*)a;
+	const UINT64 tb = *(const UINT64*)b;
+	return (ta > tb) - (ta < tb);
+}
+
+typedef struct
+{
+	double mean;
+	double p50;
+	double p99;
+} BENCH_SUMMARY;
+
+/* Times in nanoseconds, zero entries are connections that did not complete */
+static void bench_summarize(UINT64* times, size_t count, BENCH_SUMMARY* summary)
+{
+	size_t x;
+	size_t first = 0;
+	UINT64 total = 0;
+
+	ZeroMemory(summary, sizeof(BENCH_SUMMARY));
+	qsort(times, count, sizeof(UINT64), bench_compare_times);
+
+	while ((first < count) && (times[first] == 0))
+		first++;
+
+	if (first == count)
+		return;
+
+	for (x = first; x < count; x++)
+		total += times[x];
+
+	count -= first;
+	times += first;
+	summary->mean = (double)total / (double)count / 1000000.0;
+	summary->p50 = (double)times[(count - 1) * 50 / 100] / 1000000.0;
+	summary->p99 = (double)times[(count - 1) * 99 / 100] / 1000000.0;
+}
+
+static void bench_print(BENCH* bench, UINT64 elapsed, UINT64 processCpu, BOOL json)
+{
+	size_t x;
+	BENCH_SUMMARY client, server;
+	const size_t succeeded = (size_t)bench->succeeded;
+	const double seconds = (double)elapsed / 1000000000.0;
+	const double rate = (seconds > 0.0) ? (double)succeeded / seconds : 0.0;
+	const double divisor = (double)MAX(succeeded, 1);
+	const UINT64 serverCpu = (processCpu > bench->clientCpu) ? processCpu - bench->clientCpu : 0;
+	const double clientCpuMs = (double)bench->clientCpu / 1000000.0 / divisor;
+	const double serverCpuMs = (double)serverCpu / 1000000.0 / divisor;
+
+	bench_summarize(bench->clientTimes, bench->connections, &client);
+	bench_summarize(bench->serverTimes, bench->connections, &server);
+
+	if (json)
+	{
+		printf("{\"security\":\"%s\",\"connections\":%" PRIuz ",\"concurrency\":%" PRIuz
+		       ",\"workers\":%ld,\"max_handshakes\":%" PRIu32 ",\"succeeded\":%" PRIuz
+		       ",\"failed\":%" PRId32 ",\"seconds\":%.3f,\"connections_per_s\":%.1f",
+		       bench_security_names[bench->security], bench->connections, bench->concurrency,
+		       bench->workers, bench->maxHandshakes, succeeded, bench->failed, seconds, rate);
+		printf(",\"connect_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f}", client.mean,
+		       client.p50, client.p99);
+		printf(",\"accept_to_active_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f}", server.mean,
+		       server.p50, server.p99);
+		printf(",\"phases_ms\":{");
+
+		for (x = 0; x < ARRAYSIZE(bench_phases); x++)
+			printf("%s\"%s\":%.3f", x ? "," : "", bench_phases[x].name,
+			       (double)bench->phaseTimes[x] / divisor);
+
+		printf("},\"cpu_ms_per_connection\":{\"server\":%.3f,\"client\":%.3f}}\n", serverCpuMs,
+		       clientCpuMs);
+		return;
+	}
+
+	printf("%" PRIuz " of %" PRIuz " connections (%s, %" PRIuz " concurrent) in %.3f s: "
+	       "%.1f connections/s\n",
+	       succeeded, bench->connections, bench_security_names[bench->security],
+	       bench->concurrency, seconds, rate);
+	printf("%-22s %9s %9s %9s\n", "", "mean ms", "p50 ms", "p99 ms");
+	printf("%-22s %9.3f %9.3f %9.3f\n", "client connect", client.mean, client.p50, client.p99);
+	printf("%-22s %9.3f %9.3f %9.3f\n", "server accept->active", server.mean, server.p50,
+	       server.p99);
+	printf("client phases ms/connection:");
+
+	for (x = 0; x < ARRAYSIZE(bench_phases); x++)
+		printf(" %s %.2f", bench_phases[x].name, (double)bench->phaseTimes[x] / divisor);
+
+	printf("\ncpu ms/connection: server %.3f client %.3f\n", serverCpuMs, clientCpuMs);
+}
+
+static BOOL bench_run(BENCH* bench, BOOL json)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	UINT64 start;
+	UINT64 cpu;
+	HANDLE* threads = NULL;
+
+	bench->clientTimes = calloc(bench->connections, sizeof(UINT64));
+	bench->serverTimes = calloc(bench->connections, sizeof(UINT64));
+	threads = calloc(bench->concurrency, sizeof(HANDLE));
+
+	if (!bench->clientTimes || !bench->serverTimes || !threads)
+		goto fail;
+
+	if (!bench_prepare_credentials(bench) || !bench_server_start(bench))
+		goto fail;
+
+	start = bench_now();
+	cpu = bench_process_cpu();
+
+	for (x = 0; x < bench->concurrency; x++)
+	{
+		threads[x] = CreateThread(NULL, 0, bench_client_thread, bench, 0, NULL);
+
+		if (!threads[x])
+		{
+			/* let the started threads handle all connections */
+			fprintf(stderr, "failed to start client thread %" PRIuz "\n", x);
+			break;
+		}
+	}
+
+	for (x = 0; x < bench->concurrency; x++)
+	{
+		if (threads[x])
+		{
+			WaitForSingleObject(threads[x], INFINITE);
+			CloseHandle(threads[x]);
+		}
+	}
+
+	bench_print(bench, bench_now() - start, bench_process_cpu() - cpu, json);
+	rc = (bench->failed == 0) && ((size_t)bench->succeeded == bench->connections);
+fail:
+	bench_server_stop(bench);
+	bench_remove_credentials(bench);
+	free(threads);
+	free(bench->clientTimes);
+	free(bench->serverTimes);
+	return rc;
+}
+
+static void usage(const char* name)
+{
+	printf("%s: measure how fast the server side accepts and activates connections\n\n", name);
+	printf("Usage: %s [options]\n", name);
+	printf("  -n <connections>   connections to make (default 200)\n");
+	printf("  -c <clients>       clients connecting concurrently (default 8)\n");
+	printf("  -s <nla|tls|rdp>   security protocol (default nla)\n");
+	printf("  -r <workers>       serve peers with a reactor, 0 for one worker per processor\n");
+	printf("                     (default one thread per peer)\n");
+	printf("  -m <handshakes>    limit concurrent server handshakes (default unlimited)\n");
+	printf("  -p <port>          listen on this port (default random)\n");
+	printf("  -j                 print the results as JSON object\n");
+	printf("  -v                 keep the library log output\n");
+}
+
+static BOOL bench_parse_size(const char* arg, unsigned long min, unsigned long max,
+                             unsigned long* value)
+{
+	char* end = NULL;
+
+	errno = 0;
+	*value = strtoul(arg, &end, 0);
+	return (errno == 0) && end && (*end == '\0') && (*value >= min) && (*value <= max);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int rc = 1;
+	BOOL json = FALSE;
+	BOOL verbose = FALSE;
+	unsigned long value;
+	WSADATA wsaData;
+	BENCH bench = { 0 };
+
+	bench.connections = 200;
+	bench.concurrency = 8;
+	bench.workers = -1;
+	bench.security = BENCH_SECURITY_NLA;
+
+	for (index = 1; index < argc; index++)
+	{
+		const char* arg = argv[index];
+
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		else if (strcmp(arg, "-j") == 0)
+			json = TRUE;
+		else if (strcmp(arg, "-v") == 0)
+			verbose = TRUE;
+		else if (index + 1 >= argc)
+		{
+			fprintf(stderr, "missing argument for %s\n", arg);
+			return 1;
+		}
+		else if (strcmp(arg, "-n") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, 1000000, &value))
+			{
+				fprintf(stderr, "invalid connection count %s\n", argv[index]);
+				return 1;
+			}
+
+			bench.connections = value;
+		}
+		else if (strcmp(arg, "-c") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, 4096, &value))
+			{
+				fprintf(stderr, "invalid client count %s\n", argv[index]);
+				return 1;
+			}
+
+			bench.concurrency = value;
+		}
+		else if (strcmp(arg, "-r") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 0, 1024, &value))
+			{
+				fprintf(stderr, "invalid worker count %s\n", argv[index]);
+				return 1;
+			}
+
+			bench.workers = (long)value;
+		}
+		else if (strcmp(arg, "-m") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 0, UINT32_MAX, &value))
+			{
+				fprintf(stderr, "invalid handshake limit %s\n", argv[index]);
+				return 1;
+			}
+
+			bench.maxHandshakes = (UINT32)value;
+		}
+		else if (strcmp(arg, "-p") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, UINT16_MAX, &value))
+			{
+				fprintf(stderr, "invalid port %s\n", argv[index]);
+				return 1;
+			}
+
+			bench.port = (UINT16)value;
+		}
+		else if (strcmp(arg, "-s") == 0)
+		{
+			size_t x;
+			const char* security = argv[++index];
+
+			for (x = 0; x < ARRAYSIZE(bench_security_names); x++)
+			{
+				if (strcmp(security, bench_security_names[x]) == 0)
+					break;
+			}
+
+			if (x >= ARRAYSIZE(bench_security_names))
+			{
+				fprintf(stderr, "invalid security %s\n", security);
+				return 1;
+			}
+
+			bench.security = (BENCH_SECURITY)x;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	bench.concurrency = MIN(bench.concurrency, bench.connections);
+
+	/* a failing connection is reported in the summary, keep the per connection noise out */
+	if (!verbose)
+		WLog_SetLogLevel(WLog_GetRoot(), WLOG_FATAL);
+
+	/* the legacy provider is needed to hash the NLA password */
+	if (!winpr_InitializeSSL(WINPR_SSL_INIT_DEFAULT))
+		return 1;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return 1;
+
+	if (!InitializeCriticalSectionAndSpinCount(&bench.lock, 4000))
+		goto fail;
+
+	rc = bench_run(&bench, json) ? 0 : 1;
+	DeleteCriticalSection(&bench.lock);
+fail:
+	WSACleanup();
+	return rc;
+}
@@ -19,6 +19,8 @@
 
 #include <freerdp/config.h>
 
+#include <math.h>
+
 #include "bulk.h"
 
 #define TAG "com.freerdp.core"
@@ -35,7 +37,6 @@ struct rdp_bulk
 	NCRUSH_CONTEXT* ncrushSend;
 	XCRUSH_CONTEXT* xcrushRecv;
 	XCRUSH_CONTEXT* xcrushSend;
-	BYTE OutputBuffer[65536];
 };
 
 #if WITH_BULK_DEBUG
@@ -80,19 +81,76 @@ UINT32 bulk_compression_max_size(rdpBulk* bulk)
 	return bulk->CompressionMaxSize;
 }
 
+/* Payloads up to this size are always compressed, the estimate would cost about as much */
+#define BULK_ENTROPY_MIN_SIZE 1024
+#define BULK_ENTROPY_CHUNKS 16
+#define BULK_ENTROPY_CHUNK_SIZE 32
+#define BULK_ENTROPY_SAMPLES (BULK_ENTROPY_CHUNKS * BULK_ENTROPY_CHUNK_SIZE)
+/* Random data estimates at about 7.6 bits per byte with 512 samples, text and orders stay
+ * below 6. Smooth bitmaps can come close, they are caught by their repeats instead. */
+#define BULK_ENTROPY_THRESHOLD 7.2
+#define BULK_ENTROPY_MAX_REPEATS (BULK_ENTROPY_SAMPLES / 32)
+
+/* Estimates from chunks sampled across the payload whether compressing it is worthwhile.
+ * Payloads that look like noise (already compressed bitmaps, encrypted data) have a flat
+ * byte histogram and (almost) no bytes repeating the previous byte or pixel. Sending them
+ * uncompressed saves the compressor run and leaves the history untouched, where a failed
+ * compression would flush it. */
+static BOOL bulk_is_compressible(const BYTE* pSrcData, UINT32 SrcSize)
+{
+	size_t x;
+	size_t repeats = 0;
+	double sum = 0.0;
+	UINT32 histogram[256] = { 0 };
+	const size_t stride = SrcSize / BULK_ENTROPY_CHUNKS;
+
+	if (SrcSize < BULK_ENTROPY_MIN_SIZE)
+		return TRUE;
+
+	for (x = 0; x < BULK_ENTROPY_CHUNKS; x++)
+	{
+		size_t y;
+		const BYTE* chunk = &pSrcData[x * stride];
+
+		for (y = 0; y < BULK_ENTROPY_CHUNK_SIZE; y++)
+		{
+			histogram[chunk[y]]++;
+
+			if (((y >= 1) && (chunk[y] == chunk[y - 1])) ||
+			    ((y >= 4) && (chunk[y] == chunk[y - 4])))
+				repeats++;
+		}
+	}
+
+	if (repeats > BULK_ENTROPY_MAX_REPEATS)
+		return TRUE;
+
+	for (x = 0; x < ARRAYSIZE(histogram); x++)
+	{
+		const double count = histogram[x];
+
+		if (count > 0.0)
+			sum += count * log2(count);
+	}
+
+	return (log2(BULK_ENTROPY_SAMPLES) - sum / BULK_ENTROPY_SAMPLES) < BULK_ENTROPY_THRESHOLD;
+}
+
 #if WITH_BULK_DEBUG
-static INLINE int bulk_compress_validate(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize,
-                                         BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
+/* Decompresses the output again, this uses (and so breaks) the receive history. Only done
+ * with the TRACE log level as it doubles the cost of every compressed PDU */
+static INLINE int bulk_compress_validate(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize,
+                                         const BYTE* pDstData, UINT32 DstSize, UINT32 Flags)
 {
 	int status;
-	BYTE* _pSrcData = NULL;
-	BYTE* _pDstData = NULL;
+	const BYTE* _pSrcData = NULL;
+	const BYTE* _pDstData = NULL;
 	UINT32 _SrcSize = 0;
 	UINT32 _DstSize = 0;
 	UINT32 _Flags = 0;
-	_pSrcData = *ppDstData;
-	_SrcSize = *pDstSize;
-	_Flags = *pFlags | bulk->CompressionLevel;
+	_pSrcData = pDstData;
+	_SrcSize = DstSize;
+	_Flags = Flags | bulk->CompressionLevel;
 	status = bulk_decompress(bulk, _pSrcData, _SrcSize, &_pDstData, &_DstSize, _Flags);
 
 	if (status < 0)
@@ -211,7 +269,7 @@ int bulk_decompress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, const B
 	return status;
 }
 
-int bulk_compress(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData, UINT32* pDstSize,
+int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, wStream* s,
                   UINT32* pFlags)
 {
 	int status = -1;
@@ -219,17 +277,28 @@ int bulk_compress(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstDat
 	UINT32 CompressedBytes;
 	UINT32 UncompressedBytes;
 	double CompressionRatio;
+	BYTE* pDstData;
+	UINT32 DstSize;
+
+	WINPR_ASSERT(bulk);
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(pFlags);
+
 	metrics = bulk->context->metrics;
+	*pFlags = 0;
 
 	if ((SrcSize <= 50) || (SrcSize >= 16384))
-	{
-		*ppDstData = pSrcData;
-		*pDstSize = SrcSize;
 		return 0;
-	}
 
-	*ppDstData = bulk->OutputBuffer;
-	*pDstSize = sizeof(bulk->OutputBuffer);
+	if (!bulk_is_compressible(pSrcData, SrcSize))
+		return 0;
+
+	/* RDP6.1 prepends two bytes of level 1 and 2 flags */
+	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 2))
+		return -1;
+
+	pDstData = Stream_Pointer(s);
+	DstSize = (UINT32)Stream_GetRemainingCapacity(s);
 	bulk_compression_level(bulk);
 	bulk_compression_max_size(bulk);
 
@@ -238,15 +307,19 @@ int bulk_compress(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstDat
 		case PACKET_COMPR_TYPE_8K:
 		case PACKET_COMPR_TYPE_64K:
 			mppc_set_compression_level(bulk->mppcSend, bulk->CompressionLevel);
-			status = mppc_compress(bulk->mppcSend, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+			status = mppc_compress(bulk->mppcSend, pSrcData, SrcSize, &pDstData, &DstSize, pFlags);
 			break;
 		case PACKET_COMPR_TYPE_RDP6:
-			status =
-			    ncrush_compress(bulk->ncrushSend, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+			ncrush_set_match_finder(
+			    bulk->ncrushSend,
+			    freerdp_settings_get_uint32(bulk->context->settings, FreeRDP_NCrushMaxChainDepth),
+			    freerdp_settings_get_bool(bulk->context->settings, FreeRDP_NCrushLazyMatching));
+			status = ncrush_compress(bulk->ncrushSend, pSrcData, SrcSize, &pDstData, &DstSize,
+			                         pFlags);
 			break;
 		case PACKET_COMPR_TYPE_RDP61:
-			status =
-			    xcrush_compress(bulk->xcrushSend, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+			status = xcrush_compress(bulk->xcrushSend, pSrcData, SrcSize, &pDstData, &DstSize,
+			                         pFlags);
 			break;
 		case PACKET_COMPR_TYPE_RDP8:
 			WLog_ERR(TAG, "Unsupported bulk compression type %08" PRIx32, bulk->CompressionLevel);
@@ -258,31 +331,45 @@ int bulk_compress(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstDat
 			break;
 	}
 
-	if (status >= 0)
+	if (status < 0)
+		return status;
+
+	if (*pFlags == 0)
+		DstSize = SrcSize;
+	else if (pDstData == Stream_Pointer(s))
+		Stream_Seek(s, DstSize);
+	else
 	{
-		CompressedBytes = *pDstSize;
-		UncompressedBytes = SrcSize;
-		CompressionRatio = metrics_write_bytes(metrics, UncompressedBytes, CompressedBytes);
+		/* flushed, the compressor handed back the input */
+		Stream_Write(s, pDstData, DstSize);
+		pDstData = Stream_Pointer(s) - DstSize;
+	}
+
+	CompressedBytes = DstSize;
+	UncompressedBytes = SrcSize;
+	CompressionRatio = metrics_write_bytes(metrics, UncompressedBytes, CompressedBytes);
 #ifdef WITH_BULK_DEBUG
-		{
-			WLog_DBG(TAG,
-			         "Compress Type: %" PRIu32 " Flags: %s (0x%08" PRIX32
-			         ") Compression Ratio: %f (%" PRIu32 " / %" PRIu32 "), Total: %f (%" PRIu64
-			         " / %" PRIu64 ")",
-			         bulk->CompressionLevel, bulk_get_compression_flags_string(*pFlags), *pFlags,
-			         CompressionRatio, CompressedBytes, UncompressedBytes,
-			         metrics->TotalCompressionRatio, metrics->TotalCompressedBytes,
-			         metrics->TotalUncompressedBytes);
-		}
+	{
+		WLog_DBG(TAG,
+		         "Compress Type: %" PRIu32 " Flags: %s (0x%08" PRIX32
+		         ") Compression Ratio: %f (%" PRIu32 " / %" PRIu32 "), Total: %f (%" PRIu64
+		         " / %" PRIu64 ")",
+		         bulk->CompressionLevel, bulk_get_compression_flags_string(*pFlags), *pFlags,
+		         CompressionRatio, CompressedBytes, UncompressedBytes,
+		         metrics->TotalCompressionRatio, metrics->TotalCompressedBytes,
+		         metrics->TotalUncompressedBytes);
+	}
 #else
-		WINPR_UNUSED(CompressionRatio);
+	WINPR_UNUSED(CompressionRatio);
 #endif
-	}
 
 #if WITH_BULK_DEBUG
 
-	if (bulk_compress_validate(bulk, pSrcData, SrcSize, ppDstData, pDstSize, pFlags) < 0)
-		status = -1;
+	if (*pFlags && WLog_IsLevelActive(WLog_Get(TAG), WLOG_TRACE))
+	{
+		if (bulk_compress_validate(bulk, pSrcData, SrcSize, pDstData, DstSize, *pFlags) < 0)
+			status = -1;
+	}
 
 #endif
 	return status;
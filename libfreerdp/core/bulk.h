@@ -36,8 +36,11 @@ FREERDP_LOCAL UINT32 bulk_compression_max_size(rdpBulk* bulk);
 
 FREERDP_LOCAL int bulk_decompress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize,
                                   const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
-FREERDP_LOCAL int bulk_compress(rdpBulk* bulk, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
-                                UINT32* pDstSize, UINT32* pFlags);
+/* Compresses into s at its current position. If *pFlags is set on return the payload (as
+ * given by the flags) was written and s advanced, otherwise s is untouched and the data
+ * has to be sent uncompressed */
+FREERDP_LOCAL int bulk_compress(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize, wStream* s,
+                                UINT32* pFlags);
 
 FREERDP_LOCAL void bulk_reset(rdpBulk* bulk);
 
@@ -1787,6 +1787,8 @@ static BOOL rdp_print_bitmap_cache_host_support_capability_set(wStream* s)
 	return TRUE;
 }
 
+#endif
+
 static void rdp_read_bitmap_cache_cell_info(wStream* s, BITMAP_CACHE_V2_CELL_INFO* cellInfo)
 {
 	UINT32 info;
@@ -1798,16 +1800,17 @@ static void rdp_read_bitmap_cache_cell_info(wStream* s, BITMAP_CACHE_V2_CELL_INF
 	cellInfo->numEntries = (info & 0x7FFFFFFF);
 	cellInfo->persistent = (info & 0x80000000) ? 1 : 0;
 }
-#endif
 
-static void rdp_write_bitmap_cache_cell_info(wStream* s, BITMAP_CACHE_V2_CELL_INFO* cellInfo)
+static void rdp_write_bitmap_cache_cell_info(wStream* s, const BITMAP_CACHE_V2_CELL_INFO* cellInfo,
+                                             BOOL persistent)
 {
 	UINT32 info;
 	/**
 	 * numEntries is in the first 31 bits, while the last bit (k)
 	 * is used to indicate a persistent bitmap cache.
 	 */
-	info = (cellInfo->numEntries | (cellInfo->persistent << 31));
+	persistent = persistent || cellInfo->persistent;
+	info = (cellInfo->numEntries | ((persistent ? 1UL : 0UL) << 31));
 	Stream_Write_UINT32(s, info);
 }
 
@@ -1821,19 +1824,34 @@ static void rdp_write_bitmap_cache_cell_info(wStream* s, BITMAP_CACHE_V2_CELL_IN
 
 static BOOL rdp_read_bitmap_cache_v2_capability_set(wStream* s, rdpSettings* settings)
 {
-	WINPR_UNUSED(settings);
+	UINT32 x;
+	BYTE numCellCaches;
+	BITMAP_CACHE_V2_CELL_INFO cellInfo[5] = { 0 };
+
 	if (Stream_GetRemainingLength(s) < 36)
 		return FALSE;
 
-	Stream_Seek_UINT16(s); /* cacheFlags (2 bytes) */
-	Stream_Seek_UINT8(s);  /* pad2 (1 byte) */
-	Stream_Seek_UINT8(s);  /* numCellCaches (1 byte) */
-	Stream_Seek(s, 4);     /* bitmapCache0CellInfo (4 bytes) */
-	Stream_Seek(s, 4);     /* bitmapCache1CellInfo (4 bytes) */
-	Stream_Seek(s, 4);     /* bitmapCache2CellInfo (4 bytes) */
-	Stream_Seek(s, 4);     /* bitmapCache3CellInfo (4 bytes) */
-	Stream_Seek(s, 4);     /* bitmapCache4CellInfo (4 bytes) */
-	Stream_Seek(s, 12);    /* pad3 (12 bytes) */
+	Stream_Seek_UINT16(s);               /* cacheFlags (2 bytes) */
+	Stream_Seek_UINT8(s);                /* pad2 (1 byte) */
+	Stream_Read_UINT8(s, numCellCaches); /* numCellCaches (1 byte) */
+
+	for (x = 0; x < ARRAYSIZE(cellInfo); x++)
+		rdp_read_bitmap_cache_cell_info(s, &cellInfo[x]); /* bitmapCacheXCellInfo (4 bytes) */
+
+	Stream_Seek(s, 12); /* pad3 (12 bytes) */
+
+	/* a server needs the cell sizes of the client to send bitmap cache orders */
+	if (settings->ServerMode && settings->BitmapCacheV2CellInfo)
+	{
+		settings->BitmapCacheV2NumCells = MIN(numCellCaches, ARRAYSIZE(cellInfo));
+
+		for (x = 0; x < settings->BitmapCacheV2NumCells; x++)
+			settings->BitmapCacheV2CellInfo[x] = cellInfo[x];
+
+		if (settings->BitmapCacheVersion < 2)
+			settings->BitmapCacheVersion = 2;
+	}
+
 	return TRUE;
 }
 
@@ -1846,6 +1864,7 @@ static BOOL rdp_read_bitmap_cache_v2_capability_set(wStream* s, rdpSettings* set
 
 static BOOL rdp_write_bitmap_cache_v2_capability_set(wStream* s, const rdpSettings* settings)
 {
+	size_t x;
 	size_t header;
 	UINT16 cacheFlags;
 
@@ -1863,17 +1882,12 @@ static BOOL rdp_write_bitmap_cache_v2_capability_set(wStream* s, const rdpSettin
 	Stream_Write_UINT16(s, cacheFlags);                     /* cacheFlags (2 bytes) */
 	Stream_Write_UINT8(s, 0);                               /* pad2 (1 byte) */
 	Stream_Write_UINT8(s, settings->BitmapCacheV2NumCells); /* numCellCaches (1 byte) */
-	rdp_write_bitmap_cache_cell_info(
-	    s, &settings->BitmapCacheV2CellInfo[0]); /* bitmapCache0CellInfo (4 bytes) */
-	rdp_write_bitmap_cache_cell_info(
-	    s, &settings->BitmapCacheV2CellInfo[1]); /* bitmapCache1CellInfo (4 bytes) */
-	rdp_write_bitmap_cache_cell_info(
-	    s, &settings->BitmapCacheV2CellInfo[2]); /* bitmapCache2CellInfo (4 bytes) */
-	rdp_write_bitmap_cache_cell_info(
-	    s, &settings->BitmapCacheV2CellInfo[3]); /* bitmapCache3CellInfo (4 bytes) */
-	rdp_write_bitmap_cache_cell_info(
-	    s, &settings->BitmapCacheV2CellInfo[4]); /* bitmapCache4CellInfo (4 bytes) */
-	Stream_Zero(s, 12);                          /* pad3 (12 bytes) */
+	/* bitmapCache0CellInfo ... bitmapCache4CellInfo (4 bytes each) */
+	for (x = 0; x < 5; x++)
+		rdp_write_bitmap_cache_cell_info(s, &settings->BitmapCacheV2CellInfo[x],
+		                                 settings->BitmapCachePersistEnabled);
+
+	Stream_Zero(s, 12); /* pad3 (12 bytes) */
 	return rdp_capability_set_finish(s, header, CAPSET_TYPE_BITMAP_CACHE_V2);
 }
 
@@ -47,6 +47,25 @@
 
 #define TAG FREERDP_TAG("core.channels")
 
+static void freerdp_channel_metrics(rdpRdp* rdp, UINT16 channelId, size_t bytesIn,
+                                    size_t bytesOut)
+{
+	UINT32 index;
+	const char* name = NULL;
+	rdpMcs* mcs = rdp->mcs;
+
+	for (index = 0; index < mcs->channelCount; index++)
+	{
+		if (mcs->channels[index].ChannelId == channelId)
+		{
+			name = mcs->channels[index].Name;
+			break;
+		}
+	}
+
+	metrics_channel_bytes(rdp->context->metrics, channelId, name, bytesIn, bytesOut);
+}
+
 BOOL freerdp_channel_send(rdpRdp* rdp, UINT16 channelId, const BYTE* data, size_t size)
 {
 	DWORD i;
@@ -139,6 +158,7 @@ BOOL freerdp_channel_process(freerdp* instance, wStream* s, UINT16 channelId, si
 		WLog_ERR(TAG, "Expected %" PRIu32 " bytes, but have %" PRIdz, length, chunkLength);
 		return FALSE;
 	}
+	freerdp_channel_metrics(instance->context->rdp, channelId, chunkLength, 0);
 	IFCALLRET(instance->ReceiveChannelData, rc, instance, channelId, Stream_Pointer(s), chunkLength,
 	          flags, length);
 	if (!rc)
@@ -162,6 +182,7 @@ BOOL freerdp_channel_peer_process(freerdp_peer* client, wStream* s, UINT16 chann
 	Stream_Read_UINT32(s, length);
 	Stream_Read_UINT32(s, flags);
 	chunkLength = Stream_GetRemainingLength(s);
+	freerdp_channel_metrics(client->context->rdp, channelId, chunkLength, 0);
 
 	if (client->VirtualChannelRead)
 	{
@@ -298,6 +319,7 @@ BOOL freerdp_channel_send_packet(rdpRdp* rdp, UINT16 channelId, size_t totalSize
 	}
 
 	Stream_Write(s, data, chunkSize);
+	freerdp_channel_metrics(rdp, channelId, 0, chunkSize);
 
 	/* WLog_DBG(TAG, "%s: sending data (flags=0x%x size=%d)", __FUNCTION__, flags, size); */
 	return rdp_send(rdp, s, channelId);
@@ -617,11 +617,14 @@ fail:
 static int freerdp_channels_process_sync(rdpChannels* channels, freerdp* instance)
 {
 	int status = TRUE;
-	wMessage message;
+	size_t index;
+	size_t count;
+	wMessage messages[32];
 
-	while (MessageQueue_Peek(channels->queue, &message, TRUE))
+	while ((count = MessageQueue_GetBatch(channels->queue, messages, ARRAYSIZE(messages))) > 0)
 	{
-		freerdp_channels_process_message(instance, &message);
+		for (index = 0; index < count; index++)
+			freerdp_channels_process_message(instance, &messages[index]);
 	}
 
 	return status;
@@ -24,127 +24,175 @@
 #include "rdp.h"
 
 #include <freerdp/codecs.h>
+#include <freerdp/metrics.h>
 
 #define TAG FREERDP_TAG("core.codecs")
 
-static void codecs_free_int(rdpCodecs* codecs)
+static void codecs_count(rdpCodecs* codecs, INT64 contexts)
+{
+	rdpMetrics* metrics = codecs->context ? codecs->context->metrics : NULL;
+	metrics_gauge_add(metrics, FREERDP_METRIC_CODEC_CONTEXTS, contexts);
+}
+
+static void codecs_release_int(rdpCodecs* codecs, UINT32 flags)
 {
 	WINPR_ASSERT(codecs);
-	if (codecs->rfx)
+	if ((flags & FREERDP_CODEC_REMOTEFX) && codecs->rfx)
 	{
 		rfx_context_free(codecs->rfx);
 		codecs->rfx = NULL;
+		codecs_count(codecs, -1);
 	}
 
-	if (codecs->nsc)
+	if ((flags & FREERDP_CODEC_NSCODEC) && codecs->nsc)
 	{
 		nsc_context_free(codecs->nsc);
 		codecs->nsc = NULL;
+		codecs_count(codecs, -1);
 	}
 
 #ifdef WITH_GFX_H264
-	if (codecs->h264)
+	if ((flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444)) && codecs->h264)
 	{
 		h264_context_free(codecs->h264);
 		codecs->h264 = NULL;
+		codecs_count(codecs, -1);
 	}
 #endif
 
-	if (codecs->clear)
+	if ((flags & FREERDP_CODEC_CLEARCODEC) && codecs->clear)
 	{
 		clear_context_free(codecs->clear);
 		codecs->clear = NULL;
+		codecs_count(codecs, -1);
 	}
 
-	if (codecs->progressive)
+	if ((flags & FREERDP_CODEC_PROGRESSIVE) && codecs->progressive)
 	{
 		progressive_context_free(codecs->progressive);
 		codecs->progressive = NULL;
+		codecs_count(codecs, -1);
 	}
 
-	if (codecs->planar)
+	if ((flags & FREERDP_CODEC_PLANAR) && codecs->planar)
 	{
 		freerdp_bitmap_planar_context_free(codecs->planar);
 		codecs->planar = NULL;
+		codecs_count(codecs, -1);
 	}
 
-	if (codecs->interleaved)
+	if ((flags & FREERDP_CODEC_INTERLEAVED) && codecs->interleaved)
 	{
 		bitmap_interleaved_context_free(codecs->interleaved);
 		codecs->interleaved = NULL;
+		codecs_count(codecs, -1);
 	}
 }
-BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width, UINT32 height)
+
+static BOOL codecs_create_int(rdpCodecs* codecs, UINT32 flags)
 {
-	codecs_free_int(codecs);
-	if ((flags & FREERDP_CODEC_INTERLEAVED))
+	UINT32 created = 0;
+
+	WINPR_ASSERT(codecs);
+
+	if ((flags & FREERDP_CODEC_INTERLEAVED) && !codecs->interleaved)
 	{
 		if (!(codecs->interleaved = bitmap_interleaved_context_new(FALSE)))
 		{
 			WLog_ERR(TAG, "Failed to create interleaved codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_INTERLEAVED;
 	}
 
-	if ((flags & FREERDP_CODEC_PLANAR))
+	if ((flags & FREERDP_CODEC_PLANAR) && !codecs->planar)
 	{
 		if (!(codecs->planar = freerdp_bitmap_planar_context_new(FALSE, 64, 64)))
 		{
 			WLog_ERR(TAG, "Failed to create planar bitmap codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_PLANAR;
 	}
 
-	if ((flags & FREERDP_CODEC_NSCODEC))
+	if ((flags & FREERDP_CODEC_NSCODEC) && !codecs->nsc)
 	{
 		if (!(codecs->nsc = nsc_context_new()))
 		{
 			WLog_ERR(TAG, "Failed to create nsc codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_NSCODEC;
 	}
 
-	if ((flags & FREERDP_CODEC_REMOTEFX))
+	if ((flags & FREERDP_CODEC_REMOTEFX) && !codecs->rfx)
 	{
 		if (!(codecs->rfx = rfx_context_new_ex(FALSE, codecs->context->settings->ThreadingFlags)))
 		{
 			WLog_ERR(TAG, "Failed to create rfx codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_REMOTEFX;
 	}
 
-	if ((flags & FREERDP_CODEC_CLEARCODEC))
+	if ((flags & FREERDP_CODEC_CLEARCODEC) && !codecs->clear)
 	{
 		if (!(codecs->clear = clear_context_new(FALSE)))
 		{
 			WLog_ERR(TAG, "Failed to create clear codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_CLEARCODEC;
 	}
 
 	if (flags & FREERDP_CODEC_ALPHACODEC)
 	{
 	}
 
-	if ((flags & FREERDP_CODEC_PROGRESSIVE))
+	if ((flags & FREERDP_CODEC_PROGRESSIVE) && !codecs->progressive)
 	{
-		if (!(codecs->progressive = progressive_context_new(FALSE)))
+		if (!(codecs->progressive = progressive_context_new_ex(
+		          FALSE, codecs->context->settings->ThreadingFlags)))
 		{
 			WLog_ERR(TAG, "Failed to create progressive codec context");
 			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= FREERDP_CODEC_PROGRESSIVE;
 	}
 
 #ifdef WITH_GFX_H264
-	if ((flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444)))
+	if ((flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444)) && !codecs->h264)
 	{
 		if (!(codecs->h264 = h264_context_new(FALSE)))
 		{
 			WLog_WARN(TAG, "Failed to create h264 codec context");
+			return FALSE;
 		}
+		codecs_count(codecs, 1);
+		created |= flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444);
 	}
 #endif
 
+	return freerdp_client_codecs_reset(codecs, created, codecs->width, codecs->height);
+}
+
+/**
+ * Records the codecs to decode and the size to decode to, their contexts are created on first
+ * use with freerdp_client_codecs_ensure. Sessions usually only see a few of the codecs
+ * negotiated, and idle sessions none of them.
+ */
+BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(codecs);
+
+	codecs_release_int(codecs, FREERDP_CODEC_ALL);
+	codecs->flags = flags;
 	return freerdp_client_codecs_reset(codecs, flags, width, height);
 }
 
@@ -152,6 +200,11 @@ BOOL freerdp_client_codecs_reset(rdpCodecs* codecs, UINT32 flags, UINT32 width,
 {
 	BOOL rc = TRUE;
 
+	WINPR_ASSERT(codecs);
+
+	codecs->width = width;
+	codecs->height = height;
+
 	if (flags & FREERDP_CODEC_INTERLEAVED)
 	{
 		if (codecs->interleaved)
@@ -217,6 +270,40 @@ BOOL freerdp_client_codecs_reset(rdpCodecs* codecs, UINT32 flags, UINT32 width,
 	return rc;
 }
 
+/**
+ * Creates the missing contexts of the codecs in flags, they must have been prepared.
+ */
+BOOL freerdp_client_codecs_ensure(rdpCodecs* codecs, UINT32 flags)
+{
+	if (!codecs)
+		return FALSE;
+
+	if ((flags & codecs->flags) != flags)
+	{
+		WLog_ERR(TAG, "codecs 0x%08" PRIx32 " were not prepared", flags & ~codecs->flags);
+		return FALSE;
+	}
+
+	return codecs_create_int(codecs, flags);
+}
+
+/**
+ * Frees the contexts of the codecs in flags, the next freerdp_client_codecs_ensure creates them
+ * again. Only the FREERDP_CODEC_STATELESS codecs can be released while the server is still
+ * sending, the others would lose the state the following messages build on.
+ */
+void freerdp_client_codecs_release(rdpCodecs* codecs, UINT32 flags)
+{
+	if (!codecs)
+		return;
+
+	codecs_release_int(codecs, flags);
+
+	/* the idle buffers of the tile pools are rebuilt as needed */
+	if (codecs->rfx)
+		rfx_context_trim(codecs->rfx);
+}
+
 rdpCodecs* codecs_new(rdpContext* context)
 {
 	rdpCodecs* codecs;
@@ -233,7 +320,7 @@ void codecs_free(rdpCodecs* codecs)
 	if (!codecs)
 		return;
 
-	codecs_free_int(codecs);
+	codecs_release_int(codecs, FREERDP_CODEC_ALL);
 
 	free(codecs);
 }
@@ -31,6 +31,9 @@
 #include <winpr/crt.h>
 #include <winpr/crypto.h>
 #include <winpr/ssl.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
 
 #include <freerdp/log.h>
 #include <freerdp/error.h>
@@ -186,6 +189,7 @@
 
 static int rdp_client_connect_finalize(rdpRdp* rdp);
 static BOOL rdp_set_state(rdpRdp* rdp, CONNECTION_STATE state);
+static void rdp_log_connection_timing(rdpRdp* rdp);
 
 static BOOL rdp_client_reset_codecs(rdpContext* context)
 {
@@ -213,12 +217,15 @@ static BOOL rdp_client_reset_codecs(rdpContext* context)
  * If no backend is available disable it before the channel is loaded.
  */
 #if defined(WITH_GFX_H264) && defined(WITH_OPENH264_LOADING)
-	if (!context->codecs->h264)
+	if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_AVC420))
 	{
 		settings->GfxH264 = FALSE;
 		settings->GfxAVC444 = FALSE;
 		settings->GfxAVC444v2 = FALSE;
 	}
+
+	/* the surfaces have decoders of their own, this one only probed for a backend */
+	freerdp_client_codecs_release(context->codecs, FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444);
 #endif
 	}
 
@@ -240,7 +247,7 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 	/* make sure SSL is initialize for earlier enough for crypto, by taking advantage of winpr SSL
 	 * FIPS flag for openssl initialization */
 	DWORD flags = WINPR_SSL_INIT_DEFAULT;
-	UINT32 timeout;
+	UINT64 start;
 
 	WINPR_ASSERT(rdp);
 
@@ -377,8 +384,13 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 			return FALSE;
 	}
 
-	for (timeout = 0; timeout < settings->TcpAckTimeout; timeout += 100)
+	start = GetTickCount64();
+
+	while (GetTickCount64() - start < settings->TcpAckTimeout)
 	{
+		DWORD count;
+		HANDLE events[MAXIMUM_WAIT_OBJECTS] = { 0 };
+
 		if (rdp_check_fds(rdp) < 0)
 		{
 			freerdp_set_last_error_if_not(rdp->context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
@@ -388,7 +400,12 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 		if (rdp_get_state(rdp) == CONNECTION_STATE_ACTIVE)
 			return TRUE;
 
-		Sleep(100);
+		/* Wake up as soon as the next PDU arrives instead of sleeping a fixed interval,
+		 * every sleep used to add up to 100ms to each round trip of the activation. */
+		count = transport_get_event_handles(rdp->transport, events, ARRAYSIZE(events));
+
+		if ((count == 0) || (WaitForMultipleObjects(count, events, FALSE, 100) == WAIT_FAILED))
+			Sleep(100);
 	}
 
 	WLog_ERR(TAG, "Timeout waiting for activation");
@@ -1171,6 +1188,10 @@ int rdp_client_transition_to_state(rdpRdp* rdp, CONNECTION_STATE state)
 		{
 			ActivatedEventArgs activatedEvent;
 			rdpContext* context = rdp->context;
+
+			if (!rdp->deactivation_reactivation)
+				rdp_log_connection_timing(rdp);
+
 			EventArgsInit(&activatedEvent, "libfreerdp");
 			activatedEvent.firstActivation = !rdp->deactivation_reactivation;
 			PubSub_OnActivated(context->pubSub, context, &activatedEvent);
@@ -1194,11 +1215,107 @@ int rdp_client_transition_to_state(rdpRdp* rdp, CONNECTION_STATE state)
 	return status;
 }
 
+/**
+ * TLS and NLA are the CPU heavy part of accepting a connection. With
+ * FreeRDP_MaxConcurrentHandshakes set, peers beyond that limit queue for up to
+ * FreeRDP_HandshakeQueueTimeout milliseconds and are rejected afterwards, so a
+ * burst of reconnects is served at a steady rate instead of all at once.
+ */
+
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	UINT32 active;
+	HANDLE released; /* manual reset, set when a slot is freed, reset by peers finding none */
+} rdpHandshakeGate;
+
+static INIT_ONCE handshake_gate_once = INIT_ONCE_STATIC_INIT;
+static rdpHandshakeGate handshake_gate = { 0 };
+
+static BOOL CALLBACK rdp_handshake_gate_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	if (!InitializeCriticalSectionAndSpinCount(&handshake_gate.lock, 4000))
+		return FALSE;
+
+	handshake_gate.released = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!handshake_gate.released)
+	{
+		DeleteCriticalSection(&handshake_gate.lock);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL rdp_handshake_gate_enter(const rdpSettings* settings, BOOL* admitted)
+{
+	const UINT32 max = freerdp_settings_get_uint32(settings, FreeRDP_MaxConcurrentHandshakes);
+	const UINT32 timeout = freerdp_settings_get_uint32(settings, FreeRDP_HandshakeQueueTimeout);
+	const UINT64 start = GetTickCount64();
+
+	WINPR_ASSERT(admitted);
+	*admitted = FALSE;
+
+	if (max == 0)
+		return TRUE;
+
+	if (!InitOnceExecuteOnce(&handshake_gate_once, rdp_handshake_gate_init, NULL, NULL))
+		return FALSE;
+
+	for (;;)
+	{
+		UINT64 elapsed;
+
+		EnterCriticalSection(&handshake_gate.lock);
+
+		if (handshake_gate.active < max)
+		{
+			handshake_gate.active++;
+			LeaveCriticalSection(&handshake_gate.lock);
+			*admitted = TRUE;
+			return TRUE;
+		}
+
+		/* Block until the next slot is freed, the reset happens under the lock so a release
+		 * after this check still wakes us */
+		ResetEvent(handshake_gate.released);
+		LeaveCriticalSection(&handshake_gate.lock);
+		elapsed = GetTickCount64() - start;
+
+		if (elapsed >= timeout)
+		{
+			WLog_WARN(TAG, "%" PRIu32 " handshakes in progress for %" PRIu32 "ms, rejecting peer",
+			          max, timeout);
+			return FALSE;
+		}
+
+		WaitForSingleObject(handshake_gate.released, (DWORD)(timeout - elapsed));
+	}
+}
+
+static void rdp_handshake_gate_leave(BOOL admitted)
+{
+	if (!admitted)
+		return;
+
+	EnterCriticalSection(&handshake_gate.lock);
+	WINPR_ASSERT(handshake_gate.active > 0);
+	handshake_gate.active--;
+	SetEvent(handshake_gate.released);
+	LeaveCriticalSection(&handshake_gate.lock);
+}
+
 BOOL rdp_server_accept_nego(rdpRdp* rdp, wStream* s)
 {
 	UINT32 SelectedProtocol = 0;
 	UINT32 RequestedProtocols;
 	BOOL status;
+	BOOL admitted;
 	rdpSettings* settings;
 	rdpNego* nego;
 
@@ -1283,6 +1400,9 @@ BOOL rdp_server_accept_nego(rdpRdp* rdp, wStream* s)
 	SelectedProtocol = nego_get_selected_protocol(nego);
 	status = FALSE;
 
+	if (!rdp_handshake_gate_enter(settings, &admitted))
+		return FALSE;
+
 	if (SelectedProtocol & PROTOCOL_HYBRID)
 		status = transport_accept_nla(rdp->transport);
 	else if (SelectedProtocol & PROTOCOL_SSL)
@@ -1290,6 +1410,8 @@ BOOL rdp_server_accept_nego(rdpRdp* rdp, wStream* s)
 	else if (SelectedProtocol == PROTOCOL_RDP) /* 0 */
 		status = transport_accept_rdp(rdp->transport);
 
+	rdp_handshake_gate_leave(admitted);
+
 	if (!status)
 		return FALSE;
 
@@ -1465,6 +1587,8 @@ int rdp_server_transition_to_state(rdpRdp* rdp, CONNECTION_STATE state)
 			{
 				if (!client->connected)
 				{
+					rdp_log_connection_timing(rdp);
+
 					/**
 					 * PostConnect should only be called once and should not
 					 * be called after a reactivation sequence.
@@ -1553,13 +1677,113 @@ CONNECTION_STATE rdp_get_state(const rdpRdp* rdp)
 	return rdp->state;
 }
 
+/**
+ * Besides the state, record how long the previous state lasted. Leaving
+ * CONNECTION_STATE_INITIAL starts a new connection and resets the timing.
+ */
 BOOL rdp_set_state(rdpRdp* rdp, CONNECTION_STATE state)
 {
+	const UINT64 now = GetTickCount64();
+
 	WINPR_ASSERT(rdp);
+
+	if ((rdp->state == CONNECTION_STATE_INITIAL) && (state != CONNECTION_STATE_INITIAL))
+	{
+		ZeroMemory(rdp->stateDuration, sizeof(rdp->stateDuration));
+		rdp->connectStart = now;
+		rdp->firstUpdate = 0;
+	}
+	else if ((size_t)rdp->state < ARRAYSIZE(rdp->stateDuration))
+		rdp->stateDuration[rdp->state] += now - rdp->stateStart;
+
+	rdp->stateStart = now;
 	rdp->state = state;
 	return TRUE;
 }
 
+UINT64 rdp_get_state_duration(const rdpRdp* rdp, CONNECTION_STATE state)
+{
+	UINT64 duration;
+
+	WINPR_ASSERT(rdp);
+
+	if ((size_t)state >= ARRAYSIZE(rdp->stateDuration))
+		return 0;
+
+	duration = rdp->stateDuration[state];
+
+	/* include the time spent in the current state so far */
+	if ((state == rdp->state) && (state != CONNECTION_STATE_INITIAL))
+		duration += GetTickCount64() - rdp->stateStart;
+
+	return duration;
+}
+
+UINT64 rdp_get_time_to_first_update(const rdpRdp* rdp)
+{
+	LONGLONG firstUpdate;
+
+	WINPR_ASSERT(rdp);
+
+	firstUpdate = rdp->firstUpdate;
+
+	if (firstUpdate == 0)
+		return 0;
+
+	return (UINT64)firstUpdate - rdp->connectStart;
+}
+
+/**
+ * Called for every graphics update, only the first one after the connection
+ * became active is recorded.
+ */
+void rdp_first_update_received(rdpRdp* rdp)
+{
+	LONGLONG now;
+
+	WINPR_ASSERT(rdp);
+
+	if ((rdp->firstUpdate != 0) || (rdp->state != CONNECTION_STATE_ACTIVE))
+		return;
+
+	now = (LONGLONG)GetTickCount64();
+
+	if (InterlockedCompareExchange64(&rdp->firstUpdate, now, 0) == 0)
+		WLog_INFO(TAG, "time to first graphics update: %" PRIu64 " ms",
+		          rdp_get_time_to_first_update(rdp));
+}
+
+static void rdp_log_connection_timing(rdpRdp* rdp)
+{
+	size_t state;
+	size_t offset = 0;
+	char buffer[512] = { 0 };
+	const size_t prefix = strlen("CONNECTION_STATE_");
+
+	for (state = CONNECTION_STATE_NEGO; state < CONNECTION_STATE_ACTIVE; state++)
+	{
+		int rc;
+		const char* name = rdp_state_string((CONNECTION_STATE)state);
+
+		if (rdp->stateDuration[state] == 0)
+			continue;
+
+		if (strlen(name) > prefix)
+			name += prefix;
+
+		rc = sprintf_s(&buffer[offset], sizeof(buffer) - offset, "%s%s %" PRIu64 " ms",
+		               (offset > 0) ? ", " : "", name, rdp->stateDuration[state]);
+
+		if (rc < 0)
+			break;
+
+		offset += (size_t)rc;
+	}
+
+	WLog_INFO(TAG, "connection activated after %" PRIu64 " ms [%s]",
+	          GetTickCount64() - rdp->connectStart, buffer);
+}
+
 const char* rdp_get_state_string(rdpRdp* rdp)
 {
 	CONNECTION_STATE state = rdp_get_state(rdp);
@@ -51,6 +51,10 @@ FREERDP_LOCAL int rdp_client_transition_to_state(rdpRdp* rdp, CONNECTION_STATE s
 FREERDP_LOCAL CONNECTION_STATE rdp_get_state(const rdpRdp* rdp);
 FREERDP_LOCAL const char* rdp_state_string(CONNECTION_STATE state);
 
+FREERDP_LOCAL UINT64 rdp_get_state_duration(const rdpRdp* rdp, CONNECTION_STATE state);
+FREERDP_LOCAL UINT64 rdp_get_time_to_first_update(const rdpRdp* rdp);
+FREERDP_LOCAL void rdp_first_update_received(rdpRdp* rdp);
+
 FREERDP_LOCAL BOOL rdp_server_accept_nego(rdpRdp* rdp, wStream* s);
 FREERDP_LOCAL BOOL rdp_server_accept_mcs_connect_initial(rdpRdp* rdp, wStream* s);
 FREERDP_LOCAL BOOL rdp_server_accept_mcs_erect_domain_request(rdpRdp* rdp, wStream* s);
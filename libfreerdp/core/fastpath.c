@@ -33,6 +33,7 @@
 #include <freerdp/api.h>
 #include <freerdp/log.h>
 #include <freerdp/crypto/per.h>
+#include <freerdp/utils/trace.h>
 
 #include "orders.h"
 #include "update.h"
@@ -256,7 +257,7 @@ static BOOL fastpath_recv_orders(rdpFastPath* fastpath, wStream* s)
 		numberOrders--;
 	}
 
-	return TRUE;
+	return update_flush_orders_batch(update);
 }
 
 static BOOL fastpath_recv_update_common(rdpFastPath* fastpath, wStream* s)
@@ -292,8 +293,11 @@ static BOOL fastpath_recv_update_common(rdpFastPath* fastpath, wStream* s)
 			if (!bitmap_update)
 				return FALSE;
 
+			update_offer_parsed(update, bitmap_update);
 			rc = IFCALLRESULT(defaultReturn, update->BitmapUpdate, context, bitmap_update);
-			free_bitmap_update(context, bitmap_update);
+
+			if (update_withdraw_parsed(update, bitmap_update))
+				free_bitmap_update(context, bitmap_update);
 		}
 		break;
 
@@ -327,6 +331,26 @@ static BOOL fastpath_recv_update_synchronize(rdpFastPath* fastpath, wStream* s)
 	return TRUE;
 }
 
+/* updates without state of the connection (orders and surface commands reference caches) */
+static BOOL fastpath_update_is_forwardable(BYTE updateCode)
+{
+	switch (updateCode)
+	{
+		case FASTPATH_UPDATETYPE_BITMAP:
+		case FASTPATH_UPDATETYPE_PTR_NULL:
+		case FASTPATH_UPDATETYPE_PTR_DEFAULT:
+		case FASTPATH_UPDATETYPE_PTR_POSITION:
+		case FASTPATH_UPDATETYPE_COLOR:
+		case FASTPATH_UPDATETYPE_CACHED:
+		case FASTPATH_UPDATETYPE_POINTER:
+		case FASTPATH_UPDATETYPE_LARGE_POINTER:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
 static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream* s)
 {
 	BOOL rc = FALSE;
@@ -356,6 +380,22 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 #endif
 
 	defaultReturn = freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding);
+	if ((updateCode == FASTPATH_UPDATETYPE_ORDERS) || (updateCode == FASTPATH_UPDATETYPE_BITMAP) ||
+	    (updateCode == FASTPATH_UPDATETYPE_SURFCMDS))
+		rdp_first_update_received(fastpath->rdp);
+
+	if (update->FastPathUpdate && fastpath_update_is_forwardable(updateCode))
+	{
+		if (!update->FastPathUpdate(context, updateCode, s))
+		{
+			WLog_ERR(TAG, "Fastpath update %s [%" PRIx8 "] forwarding failed",
+			         fastpath_update_to_string(updateCode), updateCode);
+			return -1;
+		}
+
+		return 0;
+	}
+
 	switch (updateCode)
 	{
 		case FASTPATH_UPDATETYPE_ORDERS:
@@ -470,6 +510,31 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	return status;
 }
 
+/* Dispatches the reassembled update, a payload the update proxy kept is replaced */
+static int fastpath_recv_update_payload(rdpFastPath* fastpath, BYTE updateCode)
+{
+	int status;
+	rdpUpdate* update = fastpath->rdp->update;
+
+	Stream_SealLength(fastpath->updateData);
+	Stream_SetPosition(fastpath->updateData, 0);
+	update_set_payload(update, fastpath->updateData);
+	status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
+
+	if (update_clear_payload(update))
+	{
+		Stream_Release(fastpath->updateData);
+		fastpath->updateData = update_new_payload(update, FASTPATH_MAX_PACKET_SIZE);
+
+		if (!fastpath->updateData)
+			return -1;
+	}
+	else
+		Stream_SetPosition(fastpath->updateData, 0);
+
+	return status;
+}
+
 static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 {
 	int status;
@@ -545,10 +610,7 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			goto out_fail;
 		}
 
-		Stream_SealLength(fastpath->updateData);
-		Stream_SetPosition(fastpath->updateData, 0);
-		status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
-		Stream_SetPosition(fastpath->updateData, 0);
+		status = fastpath_recv_update_payload(fastpath, updateCode);
 
 		if (status < 0)
 		{
@@ -603,10 +665,7 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			}
 
 			fastpath->fragmentation = -1;
-			Stream_SealLength(fastpath->updateData);
-			Stream_SetPosition(fastpath->updateData, 0);
-			status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
-			Stream_SetPosition(fastpath->updateData, 0);
+			status = fastpath_recv_update_payload(fastpath, updateCode);
 
 			if (status < 0)
 			{
@@ -630,6 +689,7 @@ int fastpath_recv_updates(rdpFastPath* fastpath, wStream* s)
 		return -1;
 
 	update = fastpath->rdp->update;
+	FREERDP_TRACE_SPAN_BEGIN(span);
 
 	if (!update_begin_paint(update))
 		goto fail;
@@ -648,8 +708,9 @@ int fastpath_recv_updates(rdpFastPath* fastpath, wStream* s)
 fail:
 
 	if (!update_end_paint(update))
-		return -4;
+		rc = -4;
 
+	FREERDP_TRACE_SPAN_END(span, "fastpath_recv_updates");
 	return rc;
 }
 
@@ -1119,12 +1180,15 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 			rdp->sec_flags |= SEC_SECURE_CHECKSUM;
 	}
 
+	/* the fragments of an update leave in as few TLS records as possible */
+	if (!transport_cork(rdp->transport))
+		return FALSE;
+
 	for (fragment = 0; (totalLength > 0) || (fragment == 0); fragment++)
 	{
 		BYTE* pSrcData;
 		UINT32 SrcSize;
 		UINT32 DstSize = 0;
-		BYTE* pDstData = NULL;
 		UINT32 compressionFlags = 0;
 		BYTE pad = 0;
 		BYTE* pSignature = NULL;
@@ -1134,7 +1198,7 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 		fpUpdateHeader.compressionFlags = 0;
 		fpUpdateHeader.updateCode = updateCode;
 		fpUpdateHeader.size = (totalLength > maxLength) ? maxLength : totalLength;
-		pSrcData = pDstData = Stream_Pointer(s);
+		pSrcData = Stream_Pointer(s);
 		SrcSize = DstSize = fpUpdateHeader.size;
 
 		if (rdp->sec_flags & SEC_ENCRYPT)
@@ -1145,23 +1209,22 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 
 		if (settings->CompressionEnabled && !skipCompression)
 		{
-			if (bulk_compress(rdp->bulk, pSrcData, SrcSize, &pDstData, &DstSize,
-			                  &compressionFlags) >= 0)
+			/* compress straight behind the headers, which then carry the compression flags */
+			const size_t dataOffset =
+			    fastpath_get_update_pdu_header_size(&fpUpdatePduHeader, rdp) + 4;
+
+			Stream_SetPosition(fs, dataOffset);
+			if (bulk_compress(rdp->bulk, pSrcData, SrcSize, fs, &compressionFlags) >= 0)
 			{
 				if (compressionFlags)
 				{
 					fpUpdateHeader.compressionFlags = compressionFlags;
 					fpUpdateHeader.compression = FASTPATH_OUTPUT_COMPRESSION_USED;
+					DstSize = (UINT32)(Stream_GetPosition(fs) - dataOffset);
 				}
 			}
 		}
 
-		if (!fpUpdateHeader.compression)
-		{
-			pDstData = Stream_Pointer(s);
-			DstSize = fpUpdateHeader.size;
-		}
-
 		fpUpdateHeader.size = DstSize;
 		totalLength -= SrcSize;
 
@@ -1198,7 +1261,25 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 		Stream_SetPosition(fs, 0);
 		fastpath_write_update_pdu_header(fs, &fpUpdatePduHeader, rdp);
 		fastpath_write_update_header(fs, &fpUpdateHeader);
-		Stream_Write(fs, pDstData, DstSize);
+
+		/* without encryption the payload is sent straight from the update stream, only the
+		 * signature and cipher need the headers and payload in one buffer */
+		if (!fpUpdateHeader.compression && !(rdp->sec_flags & SEC_ENCRYPT))
+		{
+			if (transport_write_gather(rdp->transport, fs, pSrcData, DstSize) < 0)
+			{
+				status = FALSE;
+				break;
+			}
+
+			Stream_Seek(s, SrcSize);
+			continue;
+		}
+
+		if (fpUpdateHeader.compression)
+			Stream_Seek(fs, DstSize);
+		else
+			Stream_Write(fs, pSrcData, DstSize);
 
 		if (pad)
 			Stream_Zero(fs, pad);
@@ -1211,7 +1292,10 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 			if (rdp->settings->EncryptionMethods == ENCRYPTION_METHOD_FIPS)
 			{
 				if (!security_hmac_signature(data, dataSize - pad, pSignature, rdp))
-					return FALSE;
+				{
+					status = FALSE;
+					break;
+				}
 
 				security_fips_encrypt(data, dataSize, rdp);
 			}
@@ -1223,7 +1307,10 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 					status = security_mac_signature(rdp, data, dataSize, pSignature);
 
 				if (!status || !security_encrypt(data, dataSize, rdp))
-					return FALSE;
+				{
+					status = FALSE;
+					break;
+				}
 			}
 		}
 
@@ -1238,6 +1325,9 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 		Stream_Seek(s, SrcSize);
 	}
 
+	if (!transport_uncork(rdp->transport))
+		status = FALSE;
+
 	rdp->sec_flags = 0;
 	return status;
 }
@@ -1256,7 +1346,7 @@ rdpFastPath* fastpath_new(rdpRdp* rdp)
 	fastpath->rdp = rdp;
 	fastpath->fragmentation = -1;
 	fastpath->fs = Stream_New(NULL, FASTPATH_MAX_PACKET_SIZE);
-	fastpath->updateData = Stream_New(NULL, FASTPATH_MAX_PACKET_SIZE);
+	fastpath->updateData = update_new_payload(rdp->update, FASTPATH_MAX_PACKET_SIZE);
 
 	if (!fastpath->fs || !fastpath->updateData)
 		goto out_free;
@@ -1271,7 +1361,8 @@ void fastpath_free(rdpFastPath* fastpath)
 {
 	if (fastpath)
 	{
-		Stream_Free(fastpath->updateData, TRUE);
+		if (fastpath->updateData)
+			Stream_Release(fastpath->updateData);
 		Stream_Free(fastpath->fs, TRUE);
 		free(fastpath);
 	}
@@ -51,6 +51,7 @@
 #include <freerdp/version.h>
 #include <freerdp/log.h>
 #include <freerdp/cache/pointer.h>
+#include <freerdp/utils/trace.h>
 
 #include "settings.h"
 #include "utils.h"
@@ -75,6 +76,7 @@ BOOL freerdp_connect(freerdp* instance)
 	BOOL status = TRUE;
 	rdpSettings* settings;
 	ConnectionResultEventArgs e;
+	UINT64 span;
 
 	if (!instance)
 		return FALSE;
@@ -99,12 +101,16 @@ BOOL freerdp_connect(freerdp* instance)
 	if (!freerdp_settings_set_default_order_support(settings))
 		return FALSE;
 
+	/* Startup breakdown when tracing: add-in loading happens in PreConnect */
+	span = freerdp_trace_begin();
 	IFCALLRET(instance->PreConnect, status, instance);
 	instance->ConnectionCallbackState = CLIENT_STATE_PRECONNECT_PASSED;
 
 	if (status)
 		status2 = freerdp_channels_pre_connect(instance->context->channels, instance);
 
+	freerdp_trace_end("freerdp_pre_connect", span);
+
 	if (settings->KeyboardLayout == KBD_JAPANESE ||
 	    settings->KeyboardLayout == KBD_JAPANESE_INPUT_SYSTEM_MS_IME2002)
 	{
@@ -121,7 +127,9 @@ BOOL freerdp_connect(freerdp* instance)
 		goto freerdp_connect_finally;
 	}
 
+	span = freerdp_trace_begin();
 	status = rdp_client_connect(rdp);
+	freerdp_trace_end("rdp_client_connect", span);
 
 	/* Pointers might have changed inbetween */
 	if (rdp && rdp->settings)
@@ -147,11 +155,14 @@ BOOL freerdp_connect(freerdp* instance)
 	if (status)
 	{
 		pointer_cache_register_callbacks(instance->context->update);
+		span = freerdp_trace_begin();
 		IFCALLRET(instance->PostConnect, status, instance);
 		instance->ConnectionCallbackState = CLIENT_STATE_POSTCONNECT_PASSED;
 
 		if (status)
 			status2 = freerdp_channels_post_connect(instance->context->channels, instance);
+
+		freerdp_trace_end("freerdp_post_connect", span);
 	}
 	else
 	{
@@ -289,12 +300,13 @@ BOOL freerdp_check_fds(freerdp* instance)
 		return FALSE;
 	}
 
-	return TRUE;
+	return input_flush(rdp->input);
 }
 
 DWORD freerdp_get_event_handles(rdpContext* context, HANDLE* events, DWORD count)
 {
 	DWORD nCount = 0;
+	HANDLE inputEvent;
 
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->rdp);
@@ -324,6 +336,17 @@ DWORD freerdp_get_event_handles(rdpContext* context, HANDLE* events, DWORD count
 		    freerdp_get_message_queue_event_handle(context->instance, FREERDP_INPUT_MESSAGE_QUEUE);
 	}
 
+	/* signaled while input events wait for freerdp_check_event_handles */
+	inputEvent = input_get_event_handle(context->rdp->input);
+
+	if (inputEvent)
+	{
+		if (nCount >= count)
+			return 0;
+
+		events[nCount++] = inputEvent;
+	}
+
 	return nCount;
 }
 
@@ -373,6 +396,10 @@ BOOL freerdp_check_event_handles(rdpContext* context)
 			return FALSE;
 		else
 			status = TRUE;
+
+		/* send the events of the processed messages right away */
+		if (!input_flush(context->rdp->input))
+			return FALSE;
 	}
 
 	return status;
@@ -489,6 +516,10 @@ BOOL freerdp_disconnect(freerdp* instance)
 	if (!rdp_client_disconnect(rdp))
 		rc = FALSE;
 
+	/* no reconnect follows, do not keep the gateway tunnel open */
+	rdg_free(rdp->gatewayTunnel);
+	rdp->gatewayTunnel = NULL;
+
 	up = update_cast(rdp->update);
 
 	update_post_disconnect(instance->update);
@@ -1113,6 +1144,18 @@ const char* freerdp_state_string(CONNECTION_STATE state)
 	return rdp_state_string(state);
 }
 
+UINT64 freerdp_get_state_duration(const rdpContext* context, CONNECTION_STATE state)
+{
+	WINPR_ASSERT(context);
+	return rdp_get_state_duration(context->rdp, state);
+}
+
+UINT64 freerdp_get_time_to_first_update(const rdpContext* context)
+{
+	WINPR_ASSERT(context);
+	return rdp_get_time_to_first_update(context->rdp);
+}
+
 BOOL freerdp_channels_from_mcs(rdpSettings* settings, const rdpContext* context)
 {
 	WINPR_ASSERT(context);
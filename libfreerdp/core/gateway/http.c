@@ -43,6 +43,9 @@
 
 #define WEBSOCKET_MAGIC_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 
+#define HTTP_MAX_AUTHENTICATES 8
+#define HTTP_HEADER_END "\r\n\r\n"
+
 struct s_http_context
 {
 	char* Method;
@@ -71,10 +74,17 @@ struct s_http_request
 	TRANSFER_ENCODING TransferEncoding;
 };
 
+typedef struct
+{
+	const char* scheme;
+	size_t schemeLength;
+	const char* value;
+} HttpAuthenticate;
+
 struct s_http_response
 {
-	size_t count;
-	char** lines;
+	size_t count; /* lines of the header, they are terminated in place in data */
+	char* header;
 
 	long StatusCode;
 	const char* ReasonPhrase;
@@ -88,45 +98,11 @@ struct s_http_response
 	size_t BodyLength;
 	BYTE* BodyContent;
 
-	wListDictionary* Authenticates;
+	size_t AuthenticateCount;
+	HttpAuthenticate Authenticates[HTTP_MAX_AUTHENTICATES];
 	wStream* data;
 };
 
-static char* string_strnstr(char* str1, const char* str2, size_t slen)
-{
-	char c, sc;
-	size_t len;
-
-	if ((c = *str2++) != '\0')
-	{
-		len = strnlen(str2, slen + 1);
-
-		do
-		{
-			do
-			{
-				if (slen-- < 1 || (sc = *str1++) == '\0')
-					return NULL;
-			} while (sc != c);
-
-			if (len > slen)
-				return NULL;
-		} while (strncmp(str1, str2, len) != 0);
-
-		str1--;
-	}
-
-	return str1;
-}
-
-static BOOL strings_equals_nocase(const void* obj1, const void* obj2)
-{
-	if (!obj1 || !obj2)
-		return FALSE;
-
-	return _stricmp(obj1, obj2) == 0;
-}
-
 HttpContext* http_context_new(void)
 {
 	return (HttpContext*)calloc(1, sizeof(HttpContext));
@@ -413,12 +389,24 @@ static BOOL http_encode_print(wStream* s, const char* fmt, ...)
 	return TRUE;
 }
 
+static BOOL http_encode_string(wStream* s, const char* str)
+{
+	const size_t length = strlen(str);
+
+	if (!Stream_EnsureRemainingCapacity(s, length))
+		return FALSE;
+
+	Stream_Write(s, str, length);
+	return TRUE;
+}
+
 static BOOL http_encode_body_line(wStream* s, const char* param, const char* value)
 {
 	if (!s || !param || !value)
 		return FALSE;
 
-	return http_encode_print(s, "%s: %s\r\n", param, value);
+	return http_encode_string(s, param) && http_encode_string(s, ": ") &&
+	       http_encode_string(s, value) && http_encode_string(s, "\r\n");
 }
 
 static BOOL http_encode_content_length_line(wStream* s, size_t ContentLength)
@@ -431,7 +419,8 @@ static BOOL http_encode_header_line(wStream* s, const char* Method, const char*
 	if (!s || !Method || !URI)
 		return FALSE;
 
-	return http_encode_print(s, "%s %s HTTP/1.1\r\n", Method, URI);
+	return http_encode_string(s, Method) && http_encode_string(s, " ") &&
+	       http_encode_string(s, URI) && http_encode_string(s, " HTTP/1.1\r\n");
 }
 
 static BOOL http_encode_authorization_line(wStream* s, const char* AuthScheme,
@@ -440,7 +429,30 @@ static BOOL http_encode_authorization_line(wStream* s, const char* AuthScheme,
 	if (!s || !AuthScheme || !AuthParam)
 		return FALSE;
 
-	return http_encode_print(s, "Authorization: %s %s\r\n", AuthScheme, AuthParam);
+	return http_encode_string(s, "Authorization: ") && http_encode_string(s, AuthScheme) &&
+	       http_encode_string(s, " ") && http_encode_string(s, AuthParam) &&
+	       http_encode_string(s, "\r\n");
+}
+
+static size_t http_strlen(const char* str)
+{
+	return str ? strlen(str) : 0;
+}
+
+/* an upper bound of the request size, the request is built without growing the stream */
+static size_t http_request_size_hint(const HttpContext* context, const HttpRequest* request)
+{
+	size_t size = 512; /* header names, separators and the numbers */
+
+	size += http_strlen(request->Method) + http_strlen(request->URI);
+	size += http_strlen(request->Authorization) + http_strlen(request->AuthScheme);
+	size += http_strlen(request->AuthParam);
+	size += http_strlen(context->CacheControl) + http_strlen(context->Pragma);
+	size += http_strlen(context->Accept) + http_strlen(context->UserAgent);
+	size += http_strlen(context->Host) + http_strlen(context->Connection);
+	size += http_strlen(context->RdgConnectionId) + http_strlen(context->RdgAuthScheme);
+	size += sizeof(context->SecWebsocketKey);
+	return size;
 }
 
 wStream* http_request_write(HttpContext* context, HttpRequest* request)
@@ -450,7 +462,7 @@ wStream* http_request_write(HttpContext* context, HttpRequest* request)
 	if (!context || !request)
 		return NULL;
 
-	s = Stream_New(NULL, 1024);
+	s = Stream_New(NULL, http_request_size_hint(context, request));
 
 	if (!s)
 		return NULL;
@@ -646,114 +658,127 @@ static BOOL http_response_parse_header_field(HttpResponse* response, const char*
 	}
 	else if (_stricmp(name, "WWW-Authenticate") == 0)
 	{
-		char* separator = NULL;
-		const char* authScheme = NULL;
-		char* authValue = NULL;
-		separator = strchr(value, ' ');
+		/* WWW-Authenticate: Basic realm=""
+		 * WWW-Authenticate: NTLM base64token
+		 * WWW-Authenticate: Digest realm="testrealm@host.com", qop="auth, auth-int",
+		 * 					nonce="dcd98b7102dd2f0e8b11d0f600bfb0c093",
+		 * 					opaque="5ccc069c403ebaf9f0171e9517f40e41"
+		 *
+		 * The scheme is not terminated in place, the header stays printable.
+		 */
+		const char* separator = strchr(value, ' ');
 
-		if (separator)
+		if (response->AuthenticateCount < ARRAYSIZE(response->Authenticates))
 		{
-			/* WWW-Authenticate: Basic realm=""
-			 * WWW-Authenticate: NTLM base64token
-			 * WWW-Authenticate: Digest realm="testrealm@host.com", qop="auth, auth-int",
-			 * 					nonce="dcd98b7102dd2f0e8b11d0f600bfb0c093",
-			 * 					opaque="5ccc069c403ebaf9f0171e9517f40e41"
-			 */
-			*separator = '\0';
-			authScheme = value;
-			authValue = separator + 1;
-
-			if (!authScheme || !authValue)
-				return FALSE;
+			HttpAuthenticate* auth = &response->Authenticates[response->AuthenticateCount++];
+			auth->scheme = value;
+			auth->schemeLength = separator ? (size_t)(separator - value) : strlen(value);
+			auth->value = separator ? separator + 1 : NULL;
 		}
 		else
-		{
-			authScheme = value;
-
-			if (!authScheme)
-				return FALSE;
-
-			authValue = NULL;
-		}
-
-		status = ListDictionary_Add(response->Authenticates, authScheme, authValue);
+			WLog_WARN(TAG, "ignoring WWW-Authenticate %s, too many challenges", value);
 	}
 
 	return status;
 }
 
-static BOOL http_response_parse_header(HttpResponse* response)
+static BOOL http_response_parse_header_line(HttpResponse* response, char* line)
 {
-	BOOL rc = FALSE;
 	char c;
-	size_t count;
-	char* line;
 	char* name;
 	char* value;
 	char* colon_pos;
 	char* end_of_header;
 	char end_of_header_char;
+	BOOL rc;
+
+	/**
+	 * name         end_of_header
+	 * |            |
+	 * v            v
+	 * <header name>   :     <header value>
+	 *                 ^     ^
+	 *                 |     |
+	 *         colon_pos     value
+	 */
+	colon_pos = strchr(line, ':');
+
+	if ((colon_pos == NULL) || (colon_pos == line))
+		return FALSE;
 
-	if (!response)
-		goto fail;
+	/* retrieve the position just after header name */
+	for (end_of_header = colon_pos; end_of_header != line; end_of_header--)
+	{
+		c = end_of_header[-1];
 
-	if (!response->lines)
-		goto fail;
+		if (c != ' ' && c != '\t' && c != ':')
+			break;
+	}
 
-	if (!http_response_parse_header_status_line(response, response->lines[0]))
-		goto fail;
+	if (end_of_header == line)
+		return FALSE;
+
+	end_of_header_char = *end_of_header;
+	*end_of_header = '\0';
+	name = line;
 
-	for (count = 1; count < response->count; count++)
+	/* eat space and tabs before header value */
+	for (value = colon_pos + 1; *value; value++)
 	{
-		line = response->lines[count];
-
-		/**
-		 * name         end_of_header
-		 * |            |
-		 * v            v
-		 * <header name>   :     <header value>
-		 *                 ^     ^
-		 *                 |     |
-		 *         colon_pos     value
-		 */
-		if (line)
-			colon_pos = strchr(line, ':');
-		else
-			colon_pos = NULL;
+		if ((*value != ' ') && (*value != '\t'))
+			break;
+	}
 
-		if ((colon_pos == NULL) || (colon_pos == line))
-			return FALSE;
+	rc = http_response_parse_header_field(response, name, value);
+	*end_of_header = end_of_header_char;
+	return rc;
+}
 
-		/* retrieve the position just after header name */
-		for (end_of_header = colon_pos; end_of_header != line; end_of_header--)
-		{
-			c = end_of_header[-1];
+/**
+ * Parses the header in one pass over the received bytes. The lines are terminated in place and
+ * the fields point into the buffer, no line or field is copied.
+ */
+static BOOL http_response_parse_header(HttpResponse* response, char* buffer, size_t length)
+{
+	BOOL rc = FALSE;
+	char* line = buffer;
+	char* const end = buffer + length;
 
-			if (c != ' ' && c != '\t' && c != ':')
-				break;
-		}
+	if (!response)
+		goto fail;
+
+	response->header = buffer;
+	response->count = 0;
 
-		if (end_of_header == line)
+	while (line < end)
+	{
+		char* eol = memchr(line, '\n', (size_t)(end - line));
+
+		if (!eol)
 			goto fail;
 
-		end_of_header_char = *end_of_header;
-		*end_of_header = '\0';
-		name = line;
+		*eol = '\0';
+
+		if ((eol > line) && (eol[-1] == '\r'))
+			eol[-1] = '\0';
 
-		/* eat space and tabs before header value */
-		for (value = colon_pos + 1; *value; value++)
+		/* the empty line ends the header */
+		if (*line == '\0')
+			break;
+
+		if (response->count == 0)
 		{
-			if ((*value != ' ') && (*value != '\t'))
-				break;
+			if (!http_response_parse_header_status_line(response, line))
+				goto fail;
 		}
-
-		if (!http_response_parse_header_field(response, name, value))
+		else if (!http_response_parse_header_line(response, line))
 			goto fail;
 
-		*end_of_header = end_of_header_char;
+		response->count++;
+		line = eol + 1;
 	}
 
-	rc = TRUE;
+	rc = response->count > 0;
 fail:
 
 	if (!rc)
@@ -765,12 +790,26 @@ fail:
 BOOL http_response_print(HttpResponse* response)
 {
 	size_t i;
+	const char* line;
 
 	if (!response)
 		return FALSE;
 
-	for (i = 0; i < response->count; i++)
-		WLog_ERR(TAG, "%s", response->lines[i]);
+	line = response->header;
+
+	for (i = 0; line && (i < response->count); i++)
+	{
+		if (i > 0)
+		{
+			/* skip the line before and its terminators */
+			line += strlen(line);
+
+			while (*line == '\0')
+				line++;
+		}
+
+		WLog_ERR(TAG, "%s", line);
+	}
 
 	return TRUE;
 }
@@ -821,6 +860,7 @@ static int print_bio_error(const char* str, size_t len, void* bp)
 HttpResponse* http_response_recv(rdpTls* tls, BOOL readContentLength)
 {
 	size_t position;
+	size_t matched = 0;
 	size_t bodyLength = 0;
 	size_t payloadOffset = 0;
 	HttpResponse* response = http_response_new();
@@ -832,10 +872,11 @@ HttpResponse* http_response_recv(rdpTls* tls, BOOL readContentLength)
 
 	while (payloadOffset == 0)
 	{
-		size_t s;
-		char* end;
-		/* Read until we encounter \r\n\r\n */
-		int status = BIO_read(tls->bio, Stream_Pointer(response->data), 1);
+		size_t x;
+		const BYTE* data;
+		/* Read until we encounter \r\n\r\n, never beyond it. The bytes after the header
+		 * belong to the body or the tunnel protocol and must stay in the TLS layer. */
+		int status = BIO_read(tls->bio, Stream_Pointer(response->data), (int)(4 - matched));
 
 		if (status <= 0)
 		{
@@ -853,6 +894,16 @@ HttpResponse* http_response_recv(rdpTls* tls, BOOL readContentLength)
 #ifdef HAVE_VALGRIND_MEMCHECK_H
 		VALGRIND_MAKE_MEM_DEFINED(Stream_Pointer(response->data), status);
 #endif
+		data = Stream_Pointer(response->data);
+
+		for (x = 0; x < (size_t)status; x++)
+		{
+			if (data[x] == HTTP_HEADER_END[matched])
+				matched++;
+			else
+				matched = (data[x] == '\r') ? 1 : 0;
+		}
+
 		Stream_Seek(response->data, (size_t)status);
 
 		if (!Stream_EnsureRemainingCapacity(response->data, 1024))
@@ -860,59 +911,20 @@ HttpResponse* http_response_recv(rdpTls* tls, BOOL readContentLength)
 
 		position = Stream_GetPosition(response->data);
 
-		if (position < 4)
-			continue;
-		else if (position > RESPONSE_SIZE_LIMIT)
+		if (position > RESPONSE_SIZE_LIMIT)
 		{
-			WLog_ERR(TAG, "Request header too large! (%" PRIdz " bytes) Aborting!", bodyLength);
+			WLog_ERR(TAG, "Request header too large! (%" PRIdz " bytes) Aborting!", position);
 			goto out_error;
 		}
 
-		/* Always check at most the lase 8 bytes for occurance of the desired
-		 * sequence of \r\n\r\n */
-		s = (position > 8) ? 8 : position;
-		end = (char*)Stream_Pointer(response->data) - s;
-
-		if (string_strnstr(end, "\r\n\r\n", s) != NULL)
-			payloadOffset = Stream_GetPosition(response->data);
+		if (matched == 4)
+			payloadOffset = position;
 	}
 
 	if (payloadOffset)
 	{
-		size_t count = 0;
-		char* buffer = (char*)Stream_Buffer(response->data);
-		char* line = (char*)Stream_Buffer(response->data);
-		char* context = NULL;
-
-		while ((line = string_strnstr(line, "\r\n", payloadOffset - (line - buffer) - 2UL)))
-		{
-			line += 2;
-			count++;
-		}
-
-		response->count = count;
-
-		if (count)
-		{
-			response->lines = (char**)calloc(response->count, sizeof(char*));
-
-			if (!response->lines)
-				goto out_error;
-		}
-
-		buffer[payloadOffset - 1] = '\0';
-		buffer[payloadOffset - 2] = '\0';
-		count = 0;
-		line = strtok_s(buffer, "\r\n", &context);
-
-		while (line && (response->count > count))
-		{
-			response->lines[count] = line;
-			line = strtok_s(NULL, "\r\n", &context);
-			count++;
-		}
-
-		if (!http_response_parse_header(response))
+		if (!http_response_parse_header(response, (char*)Stream_Buffer(response->data),
+		                                payloadOffset))
 			goto out_error;
 
 		response->BodyLength = Stream_GetPosition(response->data) - payloadOffset;
@@ -1004,19 +1016,11 @@ HttpResponse* http_response_new(void)
 	if (!response)
 		return NULL;
 
-	response->Authenticates = ListDictionary_New(FALSE);
-
-	if (!response->Authenticates)
-		goto fail;
-
 	response->data = Stream_New(NULL, 2048);
 
 	if (!response->data)
 		goto fail;
 
-	ListDictionary_KeyObject(response->Authenticates)->fnObjectEquals = strings_equals_nocase;
-	ListDictionary_ValueObject(response->Authenticates)->fnObjectEquals = strings_equals_nocase;
-
 	response->TransferEncoding = TransferEncodingIdentity;
 	return response;
 fail:
@@ -1029,8 +1033,6 @@ void http_response_free(HttpResponse* response)
 	if (!response)
 		return;
 
-	free(response->lines);
-	ListDictionary_Free(response->Authenticates);
 	Stream_Free(response->data, TRUE);
 	free(response);
 }
@@ -1078,13 +1080,22 @@ SSIZE_T http_response_get_body_length(HttpResponse* response)
 
 const char* http_response_get_auth_token(HttpResponse* response, const char* method)
 {
+	size_t x;
+
 	if (!response || !method)
 		return NULL;
 
-	if (!ListDictionary_Contains(response->Authenticates, method))
-		return NULL;
+	for (x = 0; x < response->AuthenticateCount; x++)
+	{
+		const HttpAuthenticate* auth = &response->Authenticates[x];
 
-	return ListDictionary_GetItemValue(response->Authenticates, method);
+		/* the first challenge of a scheme wins */
+		if ((auth->schemeLength == strlen(method)) &&
+		    (_strnicmp(auth->scheme, method, auth->schemeLength) == 0))
+			return auth->value;
+	}
+
+	return NULL;
 }
 
 TRANSFER_ENCODING http_response_get_transfer_encoding(HttpResponse* response)
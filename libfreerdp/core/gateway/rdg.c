@@ -158,6 +158,7 @@ typedef struct
 {
 	TRANSFER_ENCODING httpTransferEncoding;
 	BOOL isWebsocketTransport;
+	wStream* readAhead; /* bytes read from the TLS layer but not yet parsed */
 	union _context
 	{
 		rdg_http_encoding_chunked_context chunked;
@@ -176,6 +177,7 @@ struct rdp_rdg
 	rdpNtlm* ntlm;
 	HttpContext* http;
 	CRITICAL_SECTION writeSection;
+	wStream* sendBuffer; /* frames are built here, guarded by writeSection */
 
 	UUID guid;
 
@@ -185,6 +187,7 @@ struct rdp_rdg
 	int timeout;
 	UINT16 extAuth;
 	UINT16 reserved2;
+	BOOL channelClosed; /* the gateway closed the channel, the tunnel stays authorized */
 	rdg_http_encoding_context transferEncoding;
 };
 
@@ -196,6 +199,7 @@ enum
 	RDG_CLIENT_STATE_TUNNEL_AUTHORIZE,
 	RDG_CLIENT_STATE_CHANNEL_CREATE,
 	RDG_CLIENT_STATE_OPENED,
+	RDG_CLIENT_STATE_CHANNEL_CLOSED,
 };
 
 #pragma pack(push, 1)
@@ -339,126 +343,181 @@ static BOOL rdg_read_http_unicode_string(wStream* s, const WCHAR** string, UINT1
 	return TRUE;
 }
 
-static BOOL rdg_write_chunked(BIO* bio, wStream* sPacket)
+/* Writes the chunk of header and data into the send buffer and sends it with one write, so it
+ * leaves in as few TLS records as possible */
+static BOOL rdg_write_chunked(rdpRdg* rdg, const BYTE* header, size_t headerLength,
+                              const BYTE* data, size_t length)
 {
-	size_t len;
-	int status;
-	wStream* sChunk;
+	int rc;
 	char chunkSize[11];
-	sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIXz "\r\n", Stream_Length(sPacket));
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + Stream_Length(sPacket) + 2);
+	wStream* s = rdg->sendBuffer;
+	const size_t payloadLength = headerLength + length;
 
-	if (!sChunk)
+	if (payloadLength > INT_MAX - 16)
 		return FALSE;
 
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
-	Stream_Write(sChunk, Stream_Buffer(sPacket), Stream_Length(sPacket));
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
+	rc = sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIXz "\r\n", payloadLength);
 
-	if (len > INT_MAX)
-	{
-		Stream_Free(sChunk, TRUE);
+	Stream_SetPosition(s, 0);
+	if ((rc < 0) || !Stream_EnsureRemainingCapacity(s, (size_t)rc + payloadLength + 2))
 		return FALSE;
-	}
-
-	status = BIO_write(bio, Stream_Buffer(sChunk), (int)len);
-	Stream_Free(sChunk, TRUE);
 
-	if (status != (SSIZE_T)len)
-		return FALSE;
+	Stream_Write(s, chunkSize, (size_t)rc);
+	Stream_Write(s, header, headerLength);
+	if (length > 0)
+		Stream_Write(s, data, length);
+	Stream_Write(s, "\r\n", 2);
 
-	return TRUE;
+	return tls_write_all(rdg->tlsIn, Stream_Buffer(s), (int)Stream_GetPosition(s)) >= 0;
 }
 
-static BOOL rdg_write_websocket(BIO* bio, wStream* sPacket, WEBSOCKET_OPCODE opcode)
+/* Masks length bytes of src into dst, which may be src. offset is the position of src in the
+ * frame payload, the key repeats every 4 bytes from the start of the payload. The main loop
+ * works on 16 bytes at a time, which compilers turn into vector instructions. */
+static void rdg_websocket_mask(BYTE* dst, const BYTE* src, size_t length, UINT32 maskingKey,
+                               size_t offset)
 {
-	size_t len;
-	size_t fullLen;
-	int status;
-	wStream* sWS;
+	size_t x;
+	UINT64 mask;
+	BYTE pattern[8];
 
-	uint32_t maskingKey;
+	/* the key is sent little endian, its first byte on the wire masks the first payload byte */
+	for (x = 0; x < sizeof(pattern); x++)
+		pattern[x] = (BYTE)(maskingKey >> (8 * ((offset + x) % 4)));
 
-	size_t streamPos;
+	memcpy(&mask, pattern, sizeof(mask));
 
-	len = Stream_Length(sPacket);
-	Stream_SetPosition(sPacket, 0);
-
-	if (len > INT_MAX)
-		return FALSE;
+	for (x = 0; x + 16 <= length; x += 16)
+	{
+		UINT64 lo;
+		UINT64 hi;
+		memcpy(&lo, &src[x], sizeof(lo));
+		memcpy(&hi, &src[x + 8], sizeof(hi));
+		lo ^= mask;
+		hi ^= mask;
+		memcpy(&dst[x], &lo, sizeof(lo));
+		memcpy(&dst[x + 8], &hi, sizeof(hi));
+	}
 
-	if (len < 126)
-		fullLen = len + 6; /* 2 byte "mini header" + 4 byte masking key */
-	else if (len < 0x10000)
-		fullLen = len + 8; /* 2 byte "mini header" + 2 byte length + 4 byte masking key */
-	else
-		fullLen = len + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
+	for (; x < length; x++)
+		dst[x] = src[x] ^ pattern[x % 4];
+}
 
-	sWS = Stream_New(NULL, fullLen);
-	if (!sWS)
+static BOOL rdg_websocket_write_header(wStream* s, WEBSOCKET_OPCODE opcode, size_t length,
+                                       UINT32 maskingKey)
+{
+	/* 2 byte "mini header" + up to 8 byte length + 4 byte masking key */
+	if ((length > INT_MAX - 14) || !Stream_EnsureRemainingCapacity(s, length + 14))
 		return FALSE;
 
-	winpr_RAND((BYTE*)&maskingKey, 4);
-
-	Stream_Write_UINT8(sWS, WEBSOCKET_FIN_BIT | opcode);
-	if (len < 126)
-		Stream_Write_UINT8(sWS, len | WEBSOCKET_MASK_BIT);
-	else if (len < 0x10000)
+	Stream_Write_UINT8(s, WEBSOCKET_FIN_BIT | opcode);
+	if (length < 126)
+		Stream_Write_UINT8(s, (BYTE)length | WEBSOCKET_MASK_BIT);
+	else if (length < 0x10000)
 	{
-		Stream_Write_UINT8(sWS, 126 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT16_BE(sWS, len);
+		Stream_Write_UINT8(s, 126 | WEBSOCKET_MASK_BIT);
+		Stream_Write_UINT16_BE(s, (UINT16)length);
 	}
 	else
 	{
-		Stream_Write_UINT8(sWS, 127 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT32_BE(sWS, 0); /* payload is limited to INT_MAX */
-		Stream_Write_UINT32_BE(sWS, len);
+		Stream_Write_UINT8(s, 127 | WEBSOCKET_MASK_BIT);
+		Stream_Write_UINT32_BE(s, 0); /* payload is limited to INT_MAX */
+		Stream_Write_UINT32_BE(s, (UINT32)length);
 	}
-	Stream_Write_UINT32(sWS, maskingKey);
+	Stream_Write_UINT32(s, maskingKey);
+	return TRUE;
+}
 
-	/* mask as much as possible with 32bit access */
-	for (streamPos = 0; streamPos + 4 <= len; streamPos += 4)
-	{
-		uint32_t data;
-		Stream_Read_UINT32(sPacket, data);
-		Stream_Write_UINT32(sWS, data ^ maskingKey);
-	}
+/* Appends a masked frame with the payload header followed by data to s */
+static BOOL rdg_websocket_write_frame(wStream* s, WEBSOCKET_OPCODE opcode, const BYTE* header,
+                                      size_t headerLength, const BYTE* data, size_t length)
+{
+	UINT32 maskingKey;
 
-	/* mask the rest byte by byte */
-	for (; streamPos < len; streamPos++)
-	{
-		BYTE data;
-		BYTE* partialMask = ((BYTE*)&maskingKey) + (streamPos % 4);
-		Stream_Read_UINT8(sPacket, data);
-		Stream_Write_UINT8(sWS, data ^ *partialMask);
-	}
+	winpr_RAND((BYTE*)&maskingKey, sizeof(maskingKey));
+
+	if (!rdg_websocket_write_header(s, opcode, headerLength + length, maskingKey))
+		return FALSE;
 
-	Stream_SealLength(sWS);
+	rdg_websocket_mask(Stream_Pointer(s), header, headerLength, maskingKey, 0);
+	Stream_Seek(s, headerLength);
+	rdg_websocket_mask(Stream_Pointer(s), data, length, maskingKey, headerLength);
+	Stream_Seek(s, length);
+	return TRUE;
+}
 
-	status = BIO_write(bio, Stream_Buffer(sWS), Stream_Length(sWS));
-	Stream_Free(sWS, TRUE);
+static BOOL rdg_write_websocket(rdpRdg* rdg, const BYTE* header, size_t headerLength,
+                                const BYTE* data, size_t length)
+{
+	wStream* s = rdg->sendBuffer;
 
-	if (status != (SSIZE_T)fullLen)
+	Stream_SetPosition(s, 0);
+	if (!rdg_websocket_write_frame(s, WebsocketBinaryOpcode, header, headerLength, data, length))
 		return FALSE;
 
-	return TRUE;
+	return tls_write_all(rdg->tlsOut, Stream_Buffer(s), (int)Stream_GetPosition(s)) >= 0;
 }
 
 static BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
 {
+	BOOL rc;
+
+	/* the send buffer is shared with the data packets */
+	EnterCriticalSection(&rdg->writeSection);
 	if (rdg->transferEncoding.isWebsocketTransport)
 	{
 		if (rdg->transferEncoding.context.websocket.closeSent)
-			return FALSE;
-		return rdg_write_websocket(rdg->tlsOut->bio, sPacket, WebsocketBinaryOpcode);
+			rc = FALSE;
+		else
+			rc = rdg_write_websocket(rdg, Stream_Buffer(sPacket), Stream_Length(sPacket), NULL,
+			                         0);
+	}
+	else
+		rc = rdg_write_chunked(rdg, Stream_Buffer(sPacket), Stream_Length(sPacket), NULL, 0);
+	LeaveCriticalSection(&rdg->writeSection);
+
+	return rc;
+}
+
+/* Small reads (frame and chunk headers, RDG packet headers) are served from a
+ * read ahead buffer filled with one TLS read, large reads go straight to the
+ * destination once the buffered bytes are consumed. */
+static int rdg_buffered_read(BIO* bio, wStream* readAhead, void* buffer, size_t size)
+{
+	int status;
+	size_t available;
+
+	WINPR_ASSERT(readAhead);
+
+	if (size == 0)
+		return 0;
+
+	available = Stream_GetRemainingLength(readAhead);
+
+	if (available == 0)
+	{
+		if (size >= Stream_Capacity(readAhead))
+			return BIO_read(bio, buffer, (int)MIN(size, INT_MAX));
+
+		Stream_SetPosition(readAhead, 0);
+		Stream_SetLength(readAhead, 0);
+		status = BIO_read(bio, Stream_Buffer(readAhead), (int)Stream_Capacity(readAhead));
+
+		if (status <= 0)
+			return status;
+
+		Stream_SetLength(readAhead, (size_t)status);
+		available = (size_t)status;
 	}
 
-	return rdg_write_chunked(rdg->tlsIn->bio, sPacket);
+	if (size > available)
+		size = available;
+
+	Stream_Read(readAhead, buffer, size);
+	return (int)size;
 }
 
-static int rdg_websocket_read_data(BIO* bio, BYTE* pBuffer, size_t size,
+static int rdg_websocket_read_data(BIO* bio, wStream* readAhead, BYTE* pBuffer, size_t size,
                                    rdg_http_websocket_context* encodingContext)
 {
 	int status;
@@ -469,9 +528,9 @@ static int rdg_websocket_read_data(BIO* bio, BYTE* pBuffer, size_t size,
 		return 0;
 	}
 
-	status =
-	    BIO_read(bio, pBuffer,
-	             (encodingContext->payloadLength < size ? encodingContext->payloadLength : size));
+	status = rdg_buffered_read(
+	    bio, readAhead, pBuffer,
+	    (encodingContext->payloadLength < size ? encodingContext->payloadLength : size));
 	if (status <= 0)
 		return status;
 
@@ -483,7 +542,8 @@ static int rdg_websocket_read_data(BIO* bio, BYTE* pBuffer, size_t size,
 	return status;
 }
 
-static int rdg_websocket_read_discard(BIO* bio, rdg_http_websocket_context* encodingContext)
+static int rdg_websocket_read_discard(BIO* bio, wStream* readAhead,
+                                      rdg_http_websocket_context* encodingContext)
 {
 	char _dummy[256];
 	int status;
@@ -494,7 +554,7 @@ static int rdg_websocket_read_discard(BIO* bio, rdg_http_websocket_context* enco
 		return 0;
 	}
 
-	status = BIO_read(bio, _dummy, sizeof(_dummy));
+	status = rdg_buffered_read(bio, readAhead, _dummy, sizeof(_dummy));
 	if (status <= 0)
 		return status;
 
@@ -506,7 +566,7 @@ static int rdg_websocket_read_discard(BIO* bio, rdg_http_websocket_context* enco
 	return status;
 }
 
-static int rdg_websocket_read_wstream(BIO* bio, wStream* s,
+static int rdg_websocket_read_wstream(BIO* bio, wStream* readAhead, wStream* s,
                                       rdg_http_websocket_context* encodingContext)
 {
 	int status;
@@ -519,7 +579,7 @@ static int rdg_websocket_read_wstream(BIO* bio, wStream* s,
 	if (s == NULL || Stream_GetRemainingCapacity(s) != encodingContext->payloadLength)
 		return -1;
 
-	status = BIO_read(bio, Stream_Pointer(s), encodingContext->payloadLength);
+	status = rdg_buffered_read(bio, readAhead, Stream_Pointer(s), encodingContext->payloadLength);
 	if (status <= 0)
 		return status;
 
@@ -578,29 +638,30 @@ static BOOL rdg_websocket_reply_close(BIO* bio, wStream* s)
 
 static BOOL rdg_websocket_reply_pong(BIO* bio, wStream* s)
 {
-	wStream* closeFrame;
-	uint32_t maskingKey;
 	int status;
+	wStream* pongFrame = Stream_New(NULL, 64);
 
-	if (s != NULL)
-		return rdg_write_websocket(bio, s, WebsocketPongOpcode);
+	if (!pongFrame)
+		return FALSE;
 
-	closeFrame = Stream_New(NULL, 6);
-	Stream_Write_UINT8(closeFrame, WEBSOCKET_FIN_BIT | WebsocketPongOpcode);
-	Stream_Write_UINT8(closeFrame, 0 | WEBSOCKET_MASK_BIT); /* no payload */
-	winpr_RAND((BYTE*)&maskingKey, 4);
-	Stream_Write_UINT32(closeFrame, maskingKey); /* dummy masking key. */
-	Stream_SealLength(closeFrame);
+	/* echo the payload of the ping, if there was one */
+	if (!rdg_websocket_write_frame(pongFrame, WebsocketPongOpcode, NULL, 0,
+	                               s ? Stream_Buffer(s) : NULL, s ? Stream_Length(s) : 0))
+	{
+		Stream_Free(pongFrame, TRUE);
+		return FALSE;
+	}
 
-	status = BIO_write(bio, Stream_Buffer(closeFrame), Stream_Length(closeFrame));
+	status = BIO_write(bio, Stream_Buffer(pongFrame), (int)Stream_GetPosition(pongFrame));
+	Stream_Free(pongFrame, TRUE);
 
 	if (status < 0)
 		return FALSE;
 	return TRUE;
 }
 
-static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
-                                        rdg_http_websocket_context* encodingContext)
+static int rdg_websocket_handle_payload(BIO* bio, wStream* readAhead, BYTE* pBuffer,
+                                        size_t size, rdg_http_websocket_context* encodingContext)
 {
 	int status;
 	BYTE effectiveOpcode = ((encodingContext->opcode & 0xf) == WebsocketContinuationOpcode
@@ -611,7 +672,7 @@ static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
 	{
 		case WebsocketBinaryOpcode:
 		{
-			status = rdg_websocket_read_data(bio, pBuffer, size, encodingContext);
+			status = rdg_websocket_read_data(bio, readAhead, pBuffer, size, encodingContext);
 			if (status < 0)
 				return status;
 
@@ -623,8 +684,8 @@ static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
 				encodingContext->responseStreamBuffer =
 				    Stream_New(NULL, encodingContext->payloadLength);
 
-			status = rdg_websocket_read_wstream(bio, encodingContext->responseStreamBuffer,
-			                                    encodingContext);
+			status = rdg_websocket_read_wstream(
+			    bio, readAhead, encodingContext->responseStreamBuffer, encodingContext);
 			if (status < 0)
 				return status;
 
@@ -645,8 +706,8 @@ static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
 				encodingContext->responseStreamBuffer =
 				    Stream_New(NULL, encodingContext->payloadLength);
 
-			status = rdg_websocket_read_wstream(bio, encodingContext->responseStreamBuffer,
-			                                    encodingContext);
+			status = rdg_websocket_read_wstream(
+			    bio, readAhead, encodingContext->responseStreamBuffer, encodingContext);
 			if (status < 0)
 				return status;
 
@@ -664,7 +725,7 @@ static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
 		default:
 			WLog_WARN(TAG, "Unimplemented websocket opcode %x. Dropping", effectiveOpcode & 0xf);
 
-			status = rdg_websocket_read_discard(bio, encodingContext);
+			status = rdg_websocket_read_discard(bio, readAhead, encodingContext);
 			if (status < 0)
 				return status;
 	}
@@ -673,7 +734,7 @@ static int rdg_websocket_handle_payload(BIO* bio, BYTE* pBuffer, size_t size,
 	return 0;
 }
 
-static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
+static int rdg_websocket_read(BIO* bio, wStream* readAhead, BYTE* pBuffer, size_t size,
                               rdg_http_websocket_context* encodingContext)
 {
 	int status;
@@ -686,7 +747,7 @@ static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
 			case WebsocketStateOpcodeAndFin:
 			{
 				BYTE buffer[1];
-				status = BIO_read(bio, (char*)buffer, 1);
+				status = rdg_buffered_read(bio, readAhead, (char*)buffer, 1);
 				if (status <= 0)
 					return (effectiveDataLen > 0 ? effectiveDataLen : status);
 
@@ -701,7 +762,7 @@ static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
 			{
 				BYTE buffer[1];
 				BYTE len;
-				status = BIO_read(bio, (char*)buffer, 1);
+				status = rdg_buffered_read(bio, readAhead, (char*)buffer, 1);
 				if (status <= 0)
 					return (effectiveDataLen > 0 ? effectiveDataLen : status);
 
@@ -728,7 +789,7 @@ static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
 				BYTE lenLength = (encodingContext->state == WebsocketStateShortLength ? 2 : 8);
 				while (encodingContext->lengthAndMaskPosition < lenLength)
 				{
-					status = BIO_read(bio, (char*)buffer, 1);
+					status = rdg_buffered_read(bio, readAhead, (char*)buffer, 1);
 					if (status <= 0)
 						return (effectiveDataLen > 0 ? effectiveDataLen : status);
 
@@ -748,7 +809,8 @@ static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
 			}
 			case WebSocketStatePayload:
 			{
-				status = rdg_websocket_handle_payload(bio, pBuffer, size, encodingContext);
+				status =
+				    rdg_websocket_handle_payload(bio, readAhead, pBuffer, size, encodingContext);
 				if (status < 0)
 					return (effectiveDataLen > 0 ? effectiveDataLen : status);
 
@@ -765,7 +827,7 @@ static int rdg_websocket_read(BIO* bio, BYTE* pBuffer, size_t size,
 	return -1;
 }
 
-static int rdg_chuncked_read(BIO* bio, BYTE* pBuffer, size_t size,
+static int rdg_chuncked_read(BIO* bio, wStream* readAhead, BYTE* pBuffer, size_t size,
                              rdg_http_encoding_chunked_context* encodingContext)
 {
 	int status;
@@ -777,8 +839,8 @@ static int rdg_chuncked_read(BIO* bio, BYTE* pBuffer, size_t size,
 		{
 			case ChunkStateData:
 			{
-				status = BIO_read(
-				    bio, pBuffer,
+				status = rdg_buffered_read(
+				    bio, readAhead, pBuffer,
 				    (size > encodingContext->nextOffset ? encodingContext->nextOffset : size));
 				if (status <= 0)
 					return (effectiveDataLen > 0 ? effectiveDataLen : status);
@@ -803,7 +865,8 @@ static int rdg_chuncked_read(BIO* bio, BYTE* pBuffer, size_t size,
 				char _dummy[2];
 				WINPR_ASSERT(encodingContext->nextOffset == 0);
 				WINPR_ASSERT(encodingContext->headerFooterPos < 2);
-				status = BIO_read(bio, _dummy, 2 - encodingContext->headerFooterPos);
+				status = rdg_buffered_read(bio, readAhead, _dummy,
+				                           2 - encodingContext->headerFooterPos);
 				if (status >= 0)
 				{
 					encodingContext->headerFooterPos += status;
@@ -825,7 +888,7 @@ static int rdg_chuncked_read(BIO* bio, BYTE* pBuffer, size_t size,
 				WINPR_ASSERT(encodingContext->nextOffset == 0);
 				while (encodingContext->headerFooterPos < 10 && !_haveNewLine)
 				{
-					status = BIO_read(bio, dst, 1);
+					status = rdg_buffered_read(bio, readAhead, dst, 1);
 					if (status >= 0)
 					{
 						if (*dst == '\n')
@@ -873,15 +936,17 @@ static int rdg_socket_read(BIO* bio, BYTE* pBuffer, size_t size,
 
 	if (encodingContext->isWebsocketTransport)
 	{
-		return rdg_websocket_read(bio, pBuffer, size, &encodingContext->context.websocket);
+		return rdg_websocket_read(bio, encodingContext->readAhead, pBuffer, size,
+		                          &encodingContext->context.websocket);
 	}
 
 	switch (encodingContext->httpTransferEncoding)
 	{
 		case TransferEncodingIdentity:
-			return BIO_read(bio, pBuffer, size);
+			return rdg_buffered_read(bio, encodingContext->readAhead, pBuffer, size);
 		case TransferEncodingChunked:
-			return rdg_chuncked_read(bio, pBuffer, size, &encodingContext->context.chunked);
+			return rdg_chuncked_read(bio, encodingContext->readAhead, pBuffer, size,
+			                         &encodingContext->context.chunked);
 		default:
 			return -1;
 	}
@@ -986,6 +1051,8 @@ static BOOL rdg_send_tunnel_request(rdpRdg* rdg)
 	UINT16 fieldsPresent = 0;
 	WCHAR* PAACookie = NULL;
 	int PAACookieLen = 0;
+	/* HTTP_CAPABILITY_UDP_TRANSPORT is not announced, there is no UDP side channel (and no
+	 * DTLS) in this implementation so all traffic stays on the HTTP channel */
 	const UINT32 capabilities = HTTP_CAPABILITY_TYPE_QUAR_SOH |
 	                            HTTP_CAPABILITY_MESSAGING_CONSENT_SIGN |
 	                            HTTP_CAPABILITY_MESSAGING_SERVICE_MSG;
@@ -1315,6 +1382,9 @@ static BOOL rdg_process_tunnel_response_optional(rdpRdg* rdg, wStream* s, UINT16
 
 		Stream_Read_UINT32(s, caps);
 		WLog_DBG(TAG, "capabilities=%s", capabilities_enum_to_string(caps));
+
+		if (caps & HTTP_CAPABILITY_UDP_TRANSPORT)
+			WLog_INFO(TAG, "gateway offers a UDP transport, tunnelling over HTTP only");
 	}
 
 	if (fieldsPresent & HTTP_TUNNEL_RESPONSE_FIELD_SOH_REQ)
@@ -1802,6 +1872,8 @@ static BOOL rdg_establish_data_connection(rdpRdg* rdg, rdpTls* tls, const char*
 			rdg->transferEncoding.isWebsocketTransport = TRUE;
 			rdg->transferEncoding.context.websocket.state = WebsocketStateOpcodeAndFin;
 			rdg->transferEncoding.context.websocket.responseStreamBuffer = NULL;
+			Stream_SetLength(rdg->transferEncoding.readAhead, 0);
+			Stream_SetPosition(rdg->transferEncoding.readAhead, 0);
 
 			return TRUE;
 		default:
@@ -1810,6 +1882,9 @@ static BOOL rdg_establish_data_connection(rdpRdg* rdg, rdpTls* tls, const char*
 
 	if (strcmp(method, "RDG_OUT_DATA") == 0)
 	{
+		Stream_SetLength(rdg->transferEncoding.readAhead, 0);
+		Stream_SetPosition(rdg->transferEncoding.readAhead, 0);
+
 		if (encoding == TransferEncodingChunked)
 		{
 			rdg->transferEncoding.httpTransferEncoding = TransferEncodingChunked;
@@ -1906,149 +1981,39 @@ BOOL rdg_connect(rdpRdg* rdg, DWORD timeout, BOOL* rpcFallback)
 	return TRUE;
 }
 
-static int rdg_write_websocket_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
+static int rdg_write_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
 {
-	size_t payloadSize;
-	size_t fullLen;
-	int status;
-	wStream* sWS;
-
-	uint32_t maskingKey;
-	BYTE* maskingKeyByte1 = (BYTE*)&maskingKey;
-	BYTE* maskingKeyByte2 = maskingKeyByte1 + 1;
-	BYTE* maskingKeyByte3 = maskingKeyByte1 + 2;
-	BYTE* maskingKeyByte4 = maskingKeyByte1 + 3;
-
-	int streamPos;
-
-	winpr_RAND((BYTE*)&maskingKey, 4);
+	BOOL rc;
+	wStream sbuffer;
+	BYTE header[10];
+	wStream* s = Stream_StaticInit(&sbuffer, header, sizeof(header));
 
-	payloadSize = isize + 10;
 	if ((isize < 0) || (isize > UINT16_MAX))
 		return -1;
 
-	if (payloadSize < 1)
-		return 0;
-
-	if (payloadSize < 126)
-		fullLen = payloadSize + 6; /* 2 byte "mini header" + 4 byte masking key */
-	else if (payloadSize < 0x10000)
-		fullLen = payloadSize + 8; /* 2 byte "mini header" + 2 byte length + 4 byte masking key */
-	else
-		fullLen = payloadSize + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
+	Stream_Write_UINT16(s, PKT_TYPE_DATA);                    /* Type */
+	Stream_Write_UINT16(s, 0);                                /* Reserved */
+	Stream_Write_UINT32(s, (UINT32)(isize + sizeof(header))); /* Packet length */
+	Stream_Write_UINT16(s, (UINT16)isize);                    /* Data size */
 
-	sWS = Stream_New(NULL, fullLen);
-	if (!sWS)
-		return FALSE;
-
-	Stream_Write_UINT8(sWS, WEBSOCKET_FIN_BIT | WebsocketBinaryOpcode);
-	if (payloadSize < 126)
-		Stream_Write_UINT8(sWS, payloadSize | WEBSOCKET_MASK_BIT);
-	else if (payloadSize < 0x10000)
+	/* the payload goes from buf into the frame directly, masked on the way if needed */
+	if (rdg->transferEncoding.isWebsocketTransport)
 	{
-		Stream_Write_UINT8(sWS, 126 | WEBSOCKET_MASK_BIT);
-		Stream_Write_UINT16_BE(sWS, payloadSize);
+		if (rdg->transferEncoding.context.websocket.closeSent == TRUE)
+			return -1;
+		rc = rdg_write_websocket(rdg, header, sizeof(header), buf, (size_t)isize);
 	}
 	else
 	{
-		Stream_Write_UINT8(sWS, 127 | WEBSOCKET_MASK_BIT);
-		/* biggest packet possible is 0xffff + 0xa, so 32bit is always enough */
-		Stream_Write_UINT32_BE(sWS, 0);
-		Stream_Write_UINT32_BE(sWS, payloadSize);
-	}
-	Stream_Write_UINT32(sWS, maskingKey);
-
-	Stream_Write_UINT16(sWS, PKT_TYPE_DATA ^ (*maskingKeyByte1 | *maskingKeyByte2 << 8)); /* Type */
-	Stream_Write_UINT16(sWS, 0 ^ (*maskingKeyByte3 | *maskingKeyByte4 << 8)); /* Reserved */
-	Stream_Write_UINT32(sWS, (UINT32)payloadSize ^ maskingKey);               /* Packet length */
-	Stream_Write_UINT16(sWS,
-	                    (UINT16)isize ^ (*maskingKeyByte1 | *maskingKeyByte2 << 8)); /* Data size */
-
-	/* masking key is now off by 2 bytes. fix that */
-	maskingKey = (maskingKey & 0xffff) << 16 | (maskingKey >> 16);
-
-	/* mask as much as possible with 32bit access */
-	for (streamPos = 0; streamPos + 4 <= isize; streamPos += 4)
-	{
-		uint32_t masked = *((const uint32_t*)((const BYTE*)buf + streamPos)) ^ maskingKey;
-		Stream_Write_UINT32(sWS, masked);
-	}
-
-	/* mask the rest byte by byte */
-	for (; streamPos < isize; streamPos++)
-	{
-		BYTE* partialMask = (BYTE*)(&maskingKey) + streamPos % 4;
-		BYTE masked = *((const BYTE*)((const BYTE*)buf + streamPos)) ^ *partialMask;
-		Stream_Write_UINT8(sWS, masked);
-	}
-
-	Stream_SealLength(sWS);
-
-	status = tls_write_all(rdg->tlsOut, Stream_Buffer(sWS), Stream_Length(sWS));
-	Stream_Free(sWS, TRUE);
-
-	if (status < 0)
-		return status;
-
-	return isize;
-}
-
-static int rdg_write_chunked_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
-{
-	int status;
-	size_t len;
-	wStream* sChunk;
-	size_t size = (size_t)isize;
-	size_t packetSize = size + 10;
-	char chunkSize[11];
-
-	if ((isize < 0) || (isize > UINT16_MAX))
-		return -1;
-
-	if (size < 1)
-		return 0;
-
-	sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIxz "\r\n", packetSize);
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + packetSize + 2);
-
-	if (!sChunk)
-		return -1;
-
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
-	Stream_Write_UINT16(sChunk, PKT_TYPE_DATA);      /* Type */
-	Stream_Write_UINT16(sChunk, 0);                  /* Reserved */
-	Stream_Write_UINT32(sChunk, (UINT32)packetSize); /* Packet length */
-	Stream_Write_UINT16(sChunk, (UINT16)size);       /* Data size */
-	Stream_Write(sChunk, buf, size);                 /* Data */
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
-
-	if (len > INT_MAX)
-	{
-		Stream_Free(sChunk, TRUE);
-		return -1;
+		if (isize == 0)
+			return 0;
+		rc = rdg_write_chunked(rdg, header, sizeof(header), buf, (size_t)isize);
 	}
 
-	status = tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), (int)len);
-	Stream_Free(sChunk, TRUE);
-
-	if (status < 0)
+	if (!rc)
 		return -1;
 
-	return (int)size;
-}
-
-static int rdg_write_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
-{
-	if (rdg->transferEncoding.isWebsocketTransport)
-	{
-		if (rdg->transferEncoding.context.websocket.closeSent == TRUE)
-			return -1;
-		return rdg_write_websocket_data_packet(rdg, buf, isize);
-	}
-	else
-		return rdg_write_chunked_data_packet(rdg, buf, isize);
+	return isize;
 }
 
 static BOOL rdg_process_close_packet(rdpRdg* rdg, wStream* s)
@@ -2066,6 +2031,7 @@ static BOOL rdg_process_close_packet(rdpRdg* rdg, wStream* s)
 	if (errorCode != 0)
 		freerdp_set_last_error_log(rdg->context, errorCode);
 
+	rdg->channelClosed = TRUE;
 	sClose = Stream_New(NULL, packetSize);
 	if (!sClose)
 		return FALSE;
@@ -2252,6 +2218,10 @@ static int rdg_read_data_packet(rdpRdg* rdg, BYTE* buffer, int size)
 			if (!status)
 				return -1;
 
+			/* the socket will not signal packets that were already read ahead */
+			if (Stream_GetRemainingLength(rdg->transferEncoding.readAhead) > 0)
+				return rdg_read_data_packet(rdg, buffer, size);
+
 			return 0;
 		}
 
@@ -2297,10 +2267,13 @@ static int rdg_bio_write(BIO* bio, const char* buf, int num)
 {
 	int status;
 	rdpRdg* rdg = (rdpRdg*)BIO_get_data(bio);
+	const UINT64 start = metrics_get_time_us();
 	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
 	EnterCriticalSection(&rdg->writeSection);
 	status = rdg_write_data_packet(rdg, (const BYTE*)buf, num);
 	LeaveCriticalSection(&rdg->writeSection);
+	metrics_counter_add(rdg->context->metrics, FREERDP_METRIC_GATEWAY_IO_TIME,
+	                    metrics_get_time_us() - start);
 
 	if (status < 0)
 	{
@@ -2324,7 +2297,10 @@ static int rdg_bio_read(BIO* bio, char* buf, int size)
 {
 	int status;
 	rdpRdg* rdg = (rdpRdg*)BIO_get_data(bio);
+	const UINT64 start = metrics_get_time_us();
 	status = rdg_read_data_packet(rdg, (BYTE*)buf, size);
+	metrics_counter_add(rdg->context->metrics, FREERDP_METRIC_GATEWAY_IO_TIME,
+	                    metrics_get_time_us() - start);
 
 	if (status < 0)
 	{
@@ -2381,7 +2357,11 @@ static long rdg_bio_ctrl(BIO* in_bio, int cmd, long arg1, void* arg2)
 	else if (cmd == BIO_C_READ_BLOCKED)
 	{
 		BIO* cbio = tlsOut->bio;
-		status = BIO_read_blocked(cbio);
+
+		if (Stream_GetRemainingLength(rdg->transferEncoding.readAhead) > 0)
+			status = 0;
+		else
+			status = BIO_read_blocked(cbio);
 	}
 	else if (cmd == BIO_C_WRITE_BLOCKED)
 	{
@@ -2469,6 +2449,120 @@ static BIO_METHOD* BIO_s_rdg(void)
 	return bio_methods;
 }
 
+static BOOL rdg_send_close_channel(rdpRdg* rdg)
+{
+	BOOL status;
+	wStream* sClose;
+	const UINT32 packetSize = 12;
+
+	sClose = Stream_New(NULL, packetSize);
+
+	if (!sClose)
+		return FALSE;
+
+	Stream_Write_UINT16(sClose, PKT_TYPE_CLOSE_CHANNEL); /* Type */
+	Stream_Write_UINT16(sClose, 0);                      /* Reserved */
+	Stream_Write_UINT32(sClose, packetSize);             /* Packet length */
+	Stream_Write_UINT32(sClose, 0);                      /* Status code */
+	Stream_SealLength(sClose);
+	status = rdg_write_packet(rdg, sClose);
+	Stream_Free(sClose, TRUE);
+	return status;
+}
+
+BOOL rdg_release_channel(rdpRdg* rdg)
+{
+	if (!rdg || (rdg->state != RDG_CLIENT_STATE_OPENED))
+		return FALSE;
+
+	/* the rest of a data packet would be read as the header of the next one */
+	if (rdg->packetRemainingCount > 0)
+		return FALSE;
+
+	if (rdg->transferEncoding.isWebsocketTransport &&
+	    rdg->transferEncoding.context.websocket.closeSent)
+		return FALSE;
+
+	if (!rdg->channelClosed && !rdg_send_close_channel(rdg))
+		return FALSE;
+
+	/* the front BIO was freed together with the TLS layer of the session */
+	rdg->frontBio = BIO_new(BIO_s_rdg());
+
+	if (!rdg->frontBio)
+		return FALSE;
+
+	BIO_set_data(rdg->frontBio, rdg);
+	rdg->attached = FALSE;
+	rdg->state = RDG_CLIENT_STATE_CHANNEL_CLOSED;
+	WLog_DBG(TAG, "keeping the gateway tunnel for a reconnect");
+	return TRUE;
+}
+
+/* while the channel is recreated the gateway may still send packets of the old channel */
+static BOOL rdg_process_reopen_packet(rdpRdg* rdg, wStream* s)
+{
+	UINT16 type;
+
+	Stream_SetPosition(s, 0);
+
+	if (Stream_GetRemainingLength(s) < 8)
+		return FALSE;
+
+	Stream_Read_UINT16(s, type);
+
+	switch (type)
+	{
+		case PKT_TYPE_DATA:
+		case PKT_TYPE_CLOSE_CHANNEL:
+		case PKT_TYPE_CLOSE_CHANNEL_RESPONSE:
+			WLog_DBG(TAG, "dropping packet 0x%04" PRIx16 " of the previous channel", type);
+			return TRUE;
+
+		case PKT_TYPE_KEEPALIVE:
+		{
+			BOOL status;
+
+			EnterCriticalSection(&rdg->writeSection);
+			status = rdg_process_keep_alive_packet(rdg);
+			LeaveCriticalSection(&rdg->writeSection);
+			return status;
+		}
+
+		default:
+			return rdg_process_packet(rdg, s);
+	}
+}
+
+BOOL rdg_reopen_channel(rdpRdg* rdg)
+{
+	if (!rdg || (rdg->state != RDG_CLIENT_STATE_CHANNEL_CLOSED))
+		return FALSE;
+
+	rdg->channelClosed = FALSE;
+
+	if (!rdg_send_channel_create(rdg))
+		return FALSE;
+
+	while (rdg->state < RDG_CLIENT_STATE_OPENED)
+	{
+		BOOL status;
+		wStream* s = rdg_receive_packet(rdg);
+
+		if (!s)
+			return FALSE;
+
+		status = rdg_process_reopen_packet(rdg, s);
+		Stream_Free(s, TRUE);
+
+		if (!status)
+			return FALSE;
+	}
+
+	WLog_INFO(TAG, "reusing the gateway tunnel, only the channel was created again");
+	return TRUE;
+}
+
 rdpRdg* rdg_new(rdpContext* context)
 {
 	rdpRdg* rdg;
@@ -2553,6 +2647,19 @@ rdpRdg* rdg_new(rdpContext* context)
 		BIO_set_data(rdg->frontBio, rdg);
 		InitializeCriticalSection(&rdg->writeSection);
 
+		rdg->sendBuffer = Stream_New(NULL, 4096);
+
+		if (!rdg->sendBuffer)
+			goto rdg_alloc_error;
+
+		/* one TLS record worth of payload */
+		rdg->transferEncoding.readAhead = Stream_New(NULL, 16384);
+
+		if (!rdg->transferEncoding.readAhead)
+			goto rdg_alloc_error;
+
+		Stream_SetLength(rdg->transferEncoding.readAhead, 0);
+
 		rdg->transferEncoding.httpTransferEncoding = TransferEncodingIdentity;
 		rdg->transferEncoding.isWebsocketTransport = FALSE;
 	}
@@ -2577,6 +2684,8 @@ void rdg_free(rdpRdg* rdg)
 		BIO_free_all(rdg->frontBio);
 
 	DeleteCriticalSection(&rdg->writeSection);
+	Stream_Free(rdg->sendBuffer, TRUE);
+	Stream_Free(rdg->transferEncoding.readAhead, TRUE);
 
 	if (rdg->transferEncoding.isWebsocketTransport)
 	{
@@ -47,4 +47,8 @@ FREERDP_LOCAL BIO* rdg_get_front_bio_and_take_ownership(rdpRdg* rdg);
 FREERDP_LOCAL BOOL rdg_connect(rdpRdg* rdg, DWORD timeout, BOOL* rpcFallback);
 FREERDP_LOCAL DWORD rdg_get_event_handles(rdpRdg* rdg, HANDLE* events, DWORD count);
 
+/* keeps the authorized tunnel when the inner session ended, see rdg_reopen_channel */
+FREERDP_LOCAL BOOL rdg_release_channel(rdpRdg* rdg);
+FREERDP_LOCAL BOOL rdg_reopen_channel(rdpRdg* rdg);
+
 #endif /* FREERDP_LIB_CORE_GATEWAY_RDG_H */
@@ -28,7 +28,6 @@
 #include <winpr/interlocked.h>
 
 #include <freerdp/log.h>
-#include <freerdp/utils/ringbuffer.h>
 
 typedef struct rdp_rpc rdpRpc;
 
@@ -585,7 +584,8 @@ typedef struct
 	rdpContext* context;
 	RPC_PDU* pdu;
 	HANDLE PipeEvent;
-	RingBuffer ReceivePipe;
+	wQueue* ReceivePipe; /* fragments carrying pipe data, positioned at the unread stub bytes */
+	wStreamPool* FragmentPool;
 	wStream* ReceiveFragment;
 	CRITICAL_SECTION PipeLock;
 	wArrayList* ClientCallList;
@@ -79,48 +79,72 @@ static void rpc_pdu_free(RPC_PDU* pdu)
 	free(pdu);
 }
 
-static int rpc_client_receive_pipe_write(RpcClient* client, const BYTE* buffer, size_t length)
+/* Queues the received fragment itself instead of copying its stub, the client continues
+ * with a fresh fragment buffer from the pool */
+static BOOL rpc_client_receive_pipe_push(RpcClient* client, wStream* fragment, size_t offset,
+                                         size_t length)
 {
-	int status = 0;
+	wStream* next;
 
-	if (!client || !buffer)
-		return -1;
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(fragment == client->ReceiveFragment);
 
-	EnterCriticalSection(&(client->PipeLock));
+	if (length == 0)
+		return TRUE;
+
+	next = StreamPool_Take(client->FragmentPool, 0);
 
-	if (ringbuffer_write(&(client->ReceivePipe), buffer, length))
-		status += (int)length;
+	if (!next)
+		return FALSE;
+
+	Stream_SetLength(fragment, offset + length);
+	Stream_SetPosition(fragment, offset);
+
+	EnterCriticalSection(&(client->PipeLock));
 
-	if (ringbuffer_used(&(client->ReceivePipe)) > 0)
-		SetEvent(client->PipeEvent);
+	if (!Queue_Enqueue(client->ReceivePipe, fragment))
+	{
+		LeaveCriticalSection(&(client->PipeLock));
+		Stream_Release(next);
+		return FALSE;
+	}
 
+	SetEvent(client->PipeEvent);
 	LeaveCriticalSection(&(client->PipeLock));
-	return status;
+
+	client->ReceiveFragment = next;
+	return TRUE;
 }
 
 int rpc_client_receive_pipe_read(RpcClient* client, BYTE* buffer, size_t length)
 {
-	int index = 0;
 	size_t status = 0;
-	int nchunks = 0;
-	DataChunk chunks[2];
 
 	if (!client || !buffer)
 		return -1;
 
 	EnterCriticalSection(&(client->PipeLock));
-	nchunks = ringbuffer_peek(&(client->ReceivePipe), chunks, length);
 
-	for (index = 0; index < nchunks; index++)
+	while (status < length)
 	{
-		CopyMemory(&buffer[status], chunks[index].data, chunks[index].size);
-		status += chunks[index].size;
-	}
+		size_t size;
+		wStream* fragment = Queue_Peek(client->ReceivePipe);
+
+		if (!fragment)
+			break;
 
-	if (status > 0)
-		ringbuffer_commit_read_bytes(&(client->ReceivePipe), status);
+		size = MIN(length - status, Stream_GetRemainingLength(fragment));
+		Stream_Read(fragment, &buffer[status], size);
+		status += size;
 
-	if (ringbuffer_used(&(client->ReceivePipe)) < 1)
+		if (Stream_GetRemainingLength(fragment) == 0)
+		{
+			Queue_Dequeue(client->ReceivePipe);
+			Stream_Release(fragment);
+		}
+	}
+
+	if (Queue_Count(client->ReceivePipe) < 1)
 		ResetEvent(client->PipeEvent);
 
 	LeaveCriticalSection(&(client->PipeLock));
@@ -426,9 +450,9 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 			const rpcconn_response_hdr_t* response = &header.response;
 			if (Stream_Length(fragment) < StubOffset + StubLength)
 				goto fail;
-			Stream_SetPosition(fragment, StubOffset);
-			rpc_client_receive_pipe_write(rpc->client, Stream_Pointer(fragment),
-			                              (size_t)StubLength);
+			if (!rpc_client_receive_pipe_push(rpc->client, fragment, StubOffset, StubLength))
+				goto fail;
+
 			rpc->StubFragCount++;
 
 			if (response->alloc_hint == StubLength)
@@ -677,6 +701,8 @@ static int rpc_client_default_out_channel_recv(rdpRpc* rpc)
 					return 0;
 				}
 
+				/* pipe data keeps the fragment, continue with the replacement */
+				fragment = rpc->client->ReceiveFragment;
 				Stream_SetPosition(fragment, 0);
 			}
 		}
@@ -905,6 +931,11 @@ static void rpc_array_client_call_free(void* call)
 	rpc_client_call_free((RpcClientCall*)call);
 }
 
+static void rpc_client_fragment_release(void* fragment)
+{
+	Stream_Release((wStream*)fragment);
+}
+
 int rpc_in_channel_send_pdu(RpcInChannel* inChannel, const BYTE* buffer, size_t length)
 {
 	SSIZE_T status;
@@ -1115,7 +1146,12 @@ RpcClient* rpc_client_new(rdpContext* context, UINT32 max_recv_frag)
 	if (!client->pdu)
 		goto fail;
 
-	client->ReceiveFragment = Stream_New(NULL, max_recv_frag);
+	client->FragmentPool = StreamPool_New(TRUE, max_recv_frag);
+
+	if (!client->FragmentPool)
+		goto fail;
+
+	client->ReceiveFragment = StreamPool_Take(client->FragmentPool, 0);
 
 	if (!client->ReceiveFragment)
 		goto fail;
@@ -1125,9 +1161,14 @@ RpcClient* rpc_client_new(rdpContext* context, UINT32 max_recv_frag)
 	if (!client->PipeEvent)
 		goto fail;
 
-	if (!ringbuffer_init(&(client->ReceivePipe), 4096))
+	client->ReceivePipe = Queue_New(FALSE, -1, -1);
+
+	if (!client->ReceivePipe)
 		goto fail;
 
+	obj = Queue_Object(client->ReceivePipe);
+	obj->fnObjectFree = rpc_client_fragment_release;
+
 	if (!InitializeCriticalSectionAndSpinCount(&(client->PipeLock), 4000))
 		goto fail;
 
@@ -1151,13 +1192,15 @@ void rpc_client_free(RpcClient* client)
 
 	free(client->host);
 
+	Queue_Free(client->ReceivePipe);
+
 	if (client->ReceiveFragment)
-		Stream_Free(client->ReceiveFragment, TRUE);
+		Stream_Release(client->ReceiveFragment);
+
+	StreamPool_Free(client->FragmentPool);
 
 	if (client->PipeEvent)
 		CloseHandle(client->PipeEvent);
-
-	ringbuffer_destroy(&(client->ReceivePipe));
 	DeleteCriticalSection(&(client->PipeLock));
 
 	if (client->pdu)
@@ -2567,15 +2567,27 @@ void tsg_free(rdpTsg* tsg)
 	}
 }
 
+static void tsg_add_io_time(rdpTsg* tsg, UINT64 start)
+{
+	rdpContext* context = transport_get_context(tsg->transport);
+
+	if (context)
+		metrics_counter_add(context->metrics, FREERDP_METRIC_GATEWAY_IO_TIME,
+		                    metrics_get_time_us() - start);
+}
+
 static int transport_bio_tsg_write(BIO* bio, const char* buf, int num)
 {
 	int status;
+	UINT64 start;
 	rdpTsg* tsg = (rdpTsg*)BIO_get_data(bio);
 	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
 
 	if (num < 0)
 		return -1;
+	start = metrics_get_time_us();
 	status = tsg_write(tsg, (const BYTE*)buf, (UINT32)num);
+	tsg_add_io_time(tsg, start);
 
 	if (status < 0)
 	{
@@ -2598,6 +2610,7 @@ static int transport_bio_tsg_write(BIO* bio, const char* buf, int num)
 static int transport_bio_tsg_read(BIO* bio, char* buf, int size)
 {
 	int status;
+	UINT64 start;
 	rdpTsg* tsg = (rdpTsg*)BIO_get_data(bio);
 
 	if (!tsg || (size < 0))
@@ -2607,7 +2620,9 @@ static int transport_bio_tsg_read(BIO* bio, char* buf, int size)
 	}
 
 	BIO_clear_flags(bio, BIO_FLAGS_READ);
+	start = metrics_get_time_us();
 	status = tsg_read(tsg, (BYTE*)buf, (size_t)size);
+	tsg_add_io_time(tsg, start);
 
 	if (status < 0)
 	{
@@ -263,18 +263,20 @@ BOOL gcc_read_conference_create_request(wStream* s, rdpMcs* mcs)
  * Write a GCC Conference Create Request.\n
  * @msdn{cc240836}
  * @param s stream
- * @param user_data client data blocks
+ * @param mcs MCS module, the client data blocks are written in place
  */
 
-BOOL gcc_write_conference_create_request(wStream* s, wStream* userData)
+BOOL gcc_write_conference_create_request(wStream* s, rdpMcs* mcs)
 {
+	size_t connectPDU, userData;
+
 	/* ConnectData */
 	if (!per_write_choice(s, 0)) /* From Key select object (0) of type OBJECT_IDENTIFIER */
 		return FALSE;
 	if (!per_write_object_identifier(s, t124_02_98_oid)) /* ITU-T T.124 (02/98) OBJECT_IDENTIFIER */
 		return FALSE;
 	/* ConnectData::connectPDU (OCTET_STRING) */
-	if (!per_write_length(s, Stream_GetPosition(userData) + 14)) /* connectPDU length */
+	if (!per_write_length_begin(s, &connectPDU)) /* connectPDU length */
 		return FALSE;
 	/* ConnectGCCPDU */
 	if (!per_write_choice(s, 0)) /* From ConnectGCCPDU select conferenceCreateRequest (0) of type
@@ -297,8 +299,11 @@ BOOL gcc_write_conference_create_request(wStream* s, wStream* userData)
 	                            4)) /* h221NonStandard, client-to-server H.221 key, "Duca" */
 		return FALSE;
 	/* userData::value (OCTET_STRING) */
-	return per_write_octet_string(s, Stream_Buffer(userData), Stream_GetPosition(userData),
-	                              0); /* array of client data blocks */
+	if (!per_write_length_begin(s, &userData))
+		return FALSE;
+	if (!gcc_write_client_data_blocks(s, mcs)) /* array of client data blocks */
+		return FALSE;
+	return per_write_length_end(s, userData) && per_write_length_end(s, connectPDU);
 }
 
 BOOL gcc_read_conference_create_response(wStream* s, rdpMcs* mcs)
@@ -360,8 +365,10 @@ BOOL gcc_read_conference_create_response(wStream* s, rdpMcs* mcs)
 	return TRUE;
 }
 
-BOOL gcc_write_conference_create_response(wStream* s, wStream* userData)
+BOOL gcc_write_conference_create_response(wStream* s, rdpMcs* mcs)
 {
+	size_t userData;
+
 	/* ConnectData */
 	if (!per_write_choice(s, 0))
 		return FALSE;
@@ -394,8 +401,11 @@ BOOL gcc_write_conference_create_response(wStream* s, wStream* userData)
 	                            4)) /* h221NonStandard, server-to-client H.221 key, "McDn" */
 		return FALSE;
 	/* userData (OCTET_STRING) */
-	return per_write_octet_string(s, Stream_Buffer(userData), Stream_GetPosition(userData),
-	                              0); /* array of server data blocks */
+	if (!per_write_length_begin(s, &userData))
+		return FALSE;
+	if (!gcc_write_server_data_blocks(s, mcs)) /* array of server data blocks */
+		return FALSE;
+	return per_write_length_end(s, userData);
 }
 
 BOOL gcc_read_client_data_blocks(wStream* s, rdpMcs* mcs, UINT16 length)
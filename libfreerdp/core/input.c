@@ -262,52 +262,138 @@ static BOOL input_send_keyboard_pause_event(rdpInput* input)
 	                                 RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
 }
 
-static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+/* Must be called with the lock held */
+static BOOL input_send_fastpath_events(rdpInput* input)
 {
 	wStream* s;
 	rdpRdp* rdp;
+	size_t numEvents;
+	rdp_input_internal* in = input_cast(input);
 
-	if (!input || !input->context)
-		return FALSE;
+	if (in->numEvents == 0)
+		return TRUE;
 
+	WINPR_ASSERT(input->context);
 	rdp = input->context->rdp;
-	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
-	s = fastpath_input_pdu_init(rdp->fastpath, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC);
+	numEvents = in->numEvents;
+	s = fastpath_input_pdu_init_header(rdp->fastpath);
+
+	if (s && !Stream_EnsureRemainingCapacity(s, in->eventsLength))
+	{
+		Stream_Release(s);
+		s = NULL;
+	}
+
+	if (s)
+		Stream_Write(s, in->events, in->eventsLength);
+
+	in->numEvents = 0;
+	in->eventsLength = 0;
+	in->moveOffset = 0;
 
 	if (!s)
 		return FALSE;
 
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, numEvents);
+}
+
+/**
+ * Appends an event to the batch, must be called with the lock held.
+ * A plain mouse move replaces the one queued right before it, all other events keep their order.
+ */
+static BOOL input_queue_fastpath_event(rdpInput* input, BYTE eventFlags, BYTE eventCode,
+                                       const BYTE* data, size_t length, BOOL move)
+{
+	BYTE* event;
+	rdp_input_internal* in = input_cast(input);
+
+	WINPR_ASSERT(length < INPUT_FASTPATH_MAX_EVENT_LENGTH);
+
+	if (move && (in->moveOffset > 0))
+	{
+		memcpy(&in->events[in->moveOffset], data, length);
+		return TRUE;
+	}
+
+	if (in->numEvents >= INPUT_FASTPATH_MAX_EVENTS)
+	{
+		if (!input_send_fastpath_events(input))
+			return FALSE;
+	}
+
+	event = &in->events[in->eventsLength];
+	event[0] = eventFlags | (eventCode << 5); /* eventHeader (1 byte) */
+	if (length > 0)
+		memcpy(&event[1], data, length);
+	in->moveOffset = move ? in->eventsLength + 1 : 0;
+	in->eventsLength += length + 1;
+	in->numEvents++;
+	return TRUE;
+}
+
+static void input_fastpath_lock(rdpInput* input)
+{
+	rdp_input_internal* in = input_cast(input);
+	EnterCriticalSection(&in->lock);
+}
+
+/* Sends the queued events unless they are batched and releases the lock */
+static BOOL input_fastpath_unlock(rdpInput* input, BOOL rc)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	if (!in->batching)
+	{
+		if (!input_send_fastpath_events(input))
+			rc = FALSE;
+	}
+	else if (in->numEvents > 0)
+		SetEvent(in->flushEvent);
+
+	LeaveCriticalSection(&in->lock);
+	return rc;
+}
+
+static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
+{
+	BOOL rc;
+
+	if (!input || !input->context)
+		return FALSE;
+
+	input_fastpath_lock(input);
+	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
+	rc = input_queue_fastpath_event(input, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC, NULL, 0, FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
 {
-	wStream* s;
+	BOOL rc;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp;
+	BYTE keyCode;
 
 	if (!input || !input->context)
 		return FALSE;
 
-	rdp = input->context->rdp;
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED) ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED1) ? FASTPATH_INPUT_KBDFLAGS_PREFIX_E1 : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE);
-
-	if (!s)
-		return FALSE;
-
 	WINPR_ASSERT(code <= UINT8_MAX);
-	Stream_Write_UINT8(s, (UINT8)code); /* keyCode (1 byte) */
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	keyCode = (BYTE)code; /* keyCode (1 byte) */
+	input_fastpath_lock(input);
+	rc = input_queue_fastpath_event(input, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE, &keyCode,
+	                                sizeof(keyCode), FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
 {
-	wStream* s;
+	BOOL rc;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp;
+	BYTE data[2];
+	wStream buffer;
+	wStream* s;
 
 	if (!input || !input->context)
 		return FALSE;
@@ -318,27 +404,25 @@ static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 f
 		return FALSE;
 	}
 
-	rdp = input->context->rdp;
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_UNICODE);
-
-	if (!s)
-		return FALSE;
-
+	s = Stream_StaticInit(&buffer, data, sizeof(data));
 	Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	input_fastpath_lock(input);
+	rc = input_queue_fastpath_event(input, eventFlags, FASTPATH_INPUT_EVENT_UNICODE, data,
+	                                sizeof(data), FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
 {
+	BOOL rc;
+	BYTE data[6];
+	wStream buffer;
 	wStream* s;
-	rdpRdp* rdp;
 
 	if (!input || !input->context || !input->context->settings)
 		return FALSE;
 
-	rdp = input->context->rdp;
-
 	if (!input->context->settings->HasHorizontalWheel)
 	{
 		if (flags & PTR_FLAGS_HWHEEL)
@@ -351,20 +435,21 @@ static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT1
 		}
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE);
-
-	if (!s)
-		return FALSE;
-
+	s = Stream_StaticInit(&buffer, data, sizeof(data));
 	input_write_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	input_fastpath_lock(input);
+	rc = input_queue_fastpath_event(input, 0, FASTPATH_INPUT_EVENT_MOUSE, data, sizeof(data),
+	                                flags == PTR_FLAGS_MOVE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x,
                                                      UINT16 y)
 {
+	BOOL rc;
+	BYTE data[6];
+	wStream buffer;
 	wStream* s;
-	rdpRdp* rdp;
 
 	if (!input || !input->context)
 		return FALSE;
@@ -378,43 +463,33 @@ static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 fla
 		return TRUE;
 	}
 
-	rdp = input->context->rdp;
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSEX);
-
-	if (!s)
-		return FALSE;
-
+	s = Stream_StaticInit(&buffer, data, sizeof(data));
 	input_write_extended_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s);
+	input_fastpath_lock(input);
+	rc = input_queue_fastpath_event(input, 0, FASTPATH_INPUT_EVENT_MOUSEX, data, sizeof(data),
+	                                FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleStates)
 {
-	wStream* s;
-	BYTE eventFlags = 0;
-	rdpRdp* rdp;
+	BOOL rc;
+	const BYTE tab = 0x0f;
 
 	if (!input || !input->context)
 		return FALSE;
 
-	rdp = input->context->rdp;
-	s = fastpath_input_pdu_init_header(rdp->fastpath);
-
-	if (!s)
-		return FALSE;
-
+	input_fastpath_lock(input);
 	/* send a tab up like mstsc.exe */
-	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
-	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
+	rc = input_queue_fastpath_event(input, FASTPATH_INPUT_KBDFLAGS_RELEASE,
+	                                FASTPATH_INPUT_EVENT_SCANCODE, &tab, sizeof(tab), FALSE);
 	/* send the toggle key states */
-	eventFlags = (toggleStates & 0x1F) | FASTPATH_INPUT_EVENT_SYNC << 5;
-	Stream_Write_UINT8(s, eventFlags); /* toggle state (1 byte) */
+	rc = rc && input_queue_fastpath_event(input, (BYTE)(toggleStates & 0x1F),
+	                                      FASTPATH_INPUT_EVENT_SYNC, NULL, 0, FALSE);
 	/* send another tab up like mstsc.exe */
-	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
-	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 3);
+	rc = rc && input_queue_fastpath_event(input, FASTPATH_INPUT_KBDFLAGS_RELEASE,
+	                                      FASTPATH_INPUT_EVENT_SCANCODE, &tab, sizeof(tab), FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
@@ -423,33 +498,28 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	 * and pause-up sent nothing.  However, reverse engineering mstsc shows
 	 * it sending the following sequence:
 	 */
-	wStream* s;
-	const BYTE keyDownEvent = FASTPATH_INPUT_EVENT_SCANCODE << 5;
-	const BYTE keyUpEvent = (FASTPATH_INPUT_EVENT_SCANCODE << 5) | FASTPATH_INPUT_KBDFLAGS_RELEASE;
-	rdpRdp* rdp;
+	BOOL rc;
+	const BYTE control = RDP_SCANCODE_CODE(RDP_SCANCODE_LCONTROL);
+	const BYTE numlock = RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK);
 
 	if (!input || !input->context)
 		return FALSE;
 
-	rdp = input->context->rdp;
-	s = fastpath_input_pdu_init_header(rdp->fastpath);
-
-	if (!s)
-		return FALSE;
-
+	input_fastpath_lock(input);
 	/* Control down (0x1D) */
-	Stream_Write_UINT8(s, keyDownEvent | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1);
-	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_LCONTROL));
+	rc = input_queue_fastpath_event(input, FASTPATH_INPUT_KBDFLAGS_PREFIX_E1,
+	                                FASTPATH_INPUT_EVENT_SCANCODE, &control, 1, FALSE);
 	/* Numlock down (0x45) */
-	Stream_Write_UINT8(s, keyDownEvent);
-	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
+	rc = rc && input_queue_fastpath_event(input, 0, FASTPATH_INPUT_EVENT_SCANCODE, &numlock, 1,
+	                                      FALSE);
 	/* Control up (0x1D) */
-	Stream_Write_UINT8(s, keyUpEvent | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1);
-	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_LCONTROL));
-	/* Numlock down (0x45) */
-	Stream_Write_UINT8(s, keyUpEvent);
-	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 4);
+	rc = rc && input_queue_fastpath_event(
+	               input, FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_KBDFLAGS_PREFIX_E1,
+	               FASTPATH_INPUT_EVENT_SCANCODE, &control, 1, FALSE);
+	/* Numlock up (0x45) */
+	rc = rc && input_queue_fastpath_event(input, FASTPATH_INPUT_KBDFLAGS_RELEASE,
+	                                      FASTPATH_INPUT_EVENT_SCANCODE, &numlock, 1, FALSE);
+	return input_fastpath_unlock(input, rc);
 }
 
 static BOOL input_recv_sync_event(rdpInput* input, wStream* s)
@@ -644,6 +714,7 @@ BOOL input_register_client_callbacks(rdpInput* input)
 		input->MouseEvent = input_send_fastpath_mouse_event;
 		input->ExtendedMouseEvent = input_send_fastpath_extended_mouse_event;
 		input->FocusInEvent = input_send_fastpath_focus_in_event;
+		in->fastpath = TRUE;
 	}
 	else
 	{
@@ -654,6 +725,8 @@ BOOL input_register_client_callbacks(rdpInput* input)
 		input->MouseEvent = input_send_mouse_event;
 		input->ExtendedMouseEvent = input_send_extended_mouse_event;
 		input->FocusInEvent = input_send_focus_in_event;
+		in->fastpath = FALSE;
+		in->batching = FALSE;
 	}
 
 	in->asynchronous = settings->AsyncInput;
@@ -763,6 +836,60 @@ int input_process_events(rdpInput* input)
 	return input_message_queue_process_pending_messages(input);
 }
 
+HANDLE input_get_event_handle(rdpInput* input)
+{
+	rdp_input_internal* in;
+
+	if (!input)
+		return NULL;
+
+	in = input_cast(input);
+
+	if (!in->fastpath)
+		return NULL;
+
+	/* the caller polls the handle, the events can wait for the next input_flush */
+	EnterCriticalSection(&in->lock);
+	in->batching = TRUE;
+	LeaveCriticalSection(&in->lock);
+	return in->flushEvent;
+}
+
+BOOL input_flush(rdpInput* input)
+{
+	BOOL rc = TRUE;
+	rdp_input_internal* in;
+
+	if (!input)
+		return FALSE;
+
+	in = input_cast(input);
+
+	if (!in->batching)
+		return TRUE;
+
+	EnterCriticalSection(&in->lock);
+	ResetEvent(in->flushEvent);
+
+	if (in->numEvents > 0)
+	{
+		WINPR_ASSERT(input->context);
+
+		/* events queued before the activation or after a disconnect can not be sent */
+		if (rdp_get_state(input->context->rdp) != CONNECTION_STATE_ACTIVE)
+		{
+			in->numEvents = 0;
+			in->eventsLength = 0;
+			in->moveOffset = 0;
+		}
+		else
+			rc = input_send_fastpath_events(input);
+	}
+
+	LeaveCriticalSection(&in->lock);
+	return rc;
+}
+
 static void input_free_queued_message(void* obj)
 {
 	wMessage* msg = (wMessage*)obj;
@@ -787,6 +914,16 @@ rdpInput* input_new(rdpRdp* rdp)
 		return NULL;
 	}
 
+	input->flushEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	if (!input->flushEvent)
+	{
+		MessageQueue_Free(input->queue);
+		free(input);
+		return NULL;
+	}
+
+	InitializeCriticalSection(&input->lock);
 	return &input->common;
 }
 
@@ -799,6 +936,8 @@ void input_free(rdpInput* input)
 			input_message_proxy_free(in->proxy);
 
 		MessageQueue_Free(in->queue);
+		CloseHandle(in->flushEvent);
+		DeleteCriticalSection(&in->lock);
 		free(in);
 	}
 }
@@ -29,6 +29,12 @@
 #include <freerdp/api.h>
 
 #include <winpr/stream.h>
+#include <winpr/synch.h>
+
+/* MS-RDPBCGR 2.2.8.1.2: without the optional numEvents field */
+#define INPUT_FASTPATH_MAX_EVENTS 15
+/* eventHeader and a mouse event */
+#define INPUT_FASTPATH_MAX_EVENT_LENGTH 7
 
 typedef struct
 {
@@ -38,6 +44,16 @@ typedef struct
 	BOOL asynchronous;
 	rdpInputProxy* proxy;
 	wMessageQueue* queue;
+
+	/* fastpath events are batched until input_flush once flushEvent is polled */
+	BOOL fastpath;
+	BOOL batching;
+	HANDLE flushEvent;
+	CRITICAL_SECTION lock;
+	size_t numEvents;
+	size_t eventsLength;
+	size_t moveOffset; /* offset + 1 of the last event if it is a plain mouse move */
+	BYTE events[INPUT_FASTPATH_MAX_EVENTS * INPUT_FASTPATH_MAX_EVENT_LENGTH];
 } rdp_input_internal;
 
 static INLINE rdp_input_internal* input_cast(rdpInput* input)
@@ -55,6 +71,8 @@ static INLINE rdp_input_internal* input_cast(rdpInput* input)
 FREERDP_LOCAL BOOL input_recv(rdpInput* input, wStream* s);
 
 FREERDP_LOCAL int input_process_events(rdpInput* input);
+FREERDP_LOCAL HANDLE input_get_event_handle(rdpInput* input);
+FREERDP_LOCAL BOOL input_flush(rdpInput* input);
 FREERDP_LOCAL BOOL input_register_client_callbacks(rdpInput* input);
 
 FREERDP_LOCAL rdpInput* input_new(rdpRdp* rdp);
@@ -348,54 +348,61 @@ static BOOL freerdp_listener_check_fds(freerdp_listener* instance)
 
 	for (i = 0; i < listener->num_sockfds; i++)
 	{
-		freerdp_peer* client = NULL;
-
 		WSAResetEvent(listener->events[i]);
-		peer_addr_size = sizeof(peer_addr);
-		peer_sockfd = _accept(listener->sockfds[i], (struct sockaddr*)&peer_addr, &peer_addr_size);
-		peer_accepted = FALSE;
 
-		if (peer_sockfd == -1)
+		/* accept every pending connection, a burst of clients only needs one wakeup */
+		while (1)
 		{
-			char buffer[8192] = { 0 };
+			freerdp_peer* client = NULL;
+
+			peer_addr_size = sizeof(peer_addr);
+			peer_sockfd =
+			    _accept(listener->sockfds[i], (struct sockaddr*)&peer_addr, &peer_addr_size);
+			peer_accepted = FALSE;
+
+			if (peer_sockfd == -1)
+			{
+				char buffer[8192] = { 0 };
 #ifdef _WIN32
-			int wsa_error = WSAGetLastError();
+				int wsa_error = WSAGetLastError();
 
-			/* No data available */
-			if (wsa_error == WSAEWOULDBLOCK)
-				continue;
+				/* No data available */
+				if (wsa_error == WSAEWOULDBLOCK)
+					break;
 
 #else
 
-			if (errno == EAGAIN || errno == EWOULDBLOCK)
-				continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
 
 #endif
-			WLog_WARN(TAG, "accept failed with %s", winpr_strerror(errno, buffer, sizeof(buffer)));
-			freerdp_peer_free(client);
-			return FALSE;
-		}
-
-		client = freerdp_peer_new(peer_sockfd);
-
-		if (!client)
-		{
-			closesocket((SOCKET)peer_sockfd);
-			return FALSE;
-		}
-
-		if (!freerdp_peer_set_local_and_hostname(client, &peer_addr))
-		{
-			freerdp_peer_free(client);
-			return FALSE;
-		}
-
-		IFCALLRET(instance->PeerAccepted, peer_accepted, instance, client);
-
-		if (!peer_accepted)
-		{
-			WLog_ERR(TAG, "PeerAccepted callback failed");
-			freerdp_peer_free(client);
+				WLog_WARN(TAG, "accept failed with %s",
+				          winpr_strerror(errno, buffer, sizeof(buffer)));
+				freerdp_peer_free(client);
+				return FALSE;
+			}
+
+			client = freerdp_peer_new(peer_sockfd);
+
+			if (!client)
+			{
+				closesocket((SOCKET)peer_sockfd);
+				return FALSE;
+			}
+
+			if (!freerdp_peer_set_local_and_hostname(client, &peer_addr))
+			{
+				freerdp_peer_free(client);
+				return FALSE;
+			}
+
+			IFCALLRET(instance->PeerAccepted, peer_accepted, instance, client);
+
+			if (!peer_accepted)
+			{
+				WLog_ERR(TAG, "PeerAccepted callback failed");
+				freerdp_peer_free(client);
+			}
 		}
 	}
 
@@ -195,8 +195,8 @@ static BOOL mcs_merge_domain_parameters(DomainParameters* targetParameters,
                                         DomainParameters* maximumParameters,
                                         DomainParameters* pOutParameters);
 
-static BOOL mcs_write_connect_initial(wStream* s, rdpMcs* mcs, wStream* userData);
-static BOOL mcs_write_connect_response(wStream* s, rdpMcs* mcs, wStream* userData);
+static BOOL mcs_write_connect_initial(wStream* s, rdpMcs* mcs);
+static BOOL mcs_write_connect_response(wStream* s, rdpMcs* mcs);
 static BOOL mcs_read_domain_mcspdu_header(wStream* s, enum DomainMCSPDU* domainMCSPDU,
                                           UINT16* length);
 
@@ -336,33 +336,23 @@ static BOOL mcs_read_domain_parameters(wStream* s, DomainParameters* domainParam
 
 static BOOL mcs_write_domain_parameters(wStream* s, DomainParameters* domainParameters)
 {
-	size_t length;
-	wStream* tmps;
+	size_t mark;
 
 	if (!s || !domainParameters)
 		return FALSE;
 
-	tmps = Stream_New(NULL, Stream_Capacity(s));
-
-	if (!tmps)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
+	if (!ber_write_sequence_begin(s, &mark) || !Stream_EnsureRemainingCapacity(s, 8 * 6))
 		return FALSE;
-	}
 
-	ber_write_integer(tmps, domainParameters->maxChannelIds);
-	ber_write_integer(tmps, domainParameters->maxUserIds);
-	ber_write_integer(tmps, domainParameters->maxTokenIds);
-	ber_write_integer(tmps, domainParameters->numPriorities);
-	ber_write_integer(tmps, domainParameters->minThroughput);
-	ber_write_integer(tmps, domainParameters->maxHeight);
-	ber_write_integer(tmps, domainParameters->maxMCSPDUsize);
-	ber_write_integer(tmps, domainParameters->protocolVersion);
-	length = Stream_GetPosition(tmps);
-	ber_write_sequence_tag(s, length);
-	Stream_Write(s, Stream_Buffer(tmps), length);
-	Stream_Free(tmps, TRUE);
-	return TRUE;
+	ber_write_integer(s, domainParameters->maxChannelIds);
+	ber_write_integer(s, domainParameters->maxUserIds);
+	ber_write_integer(s, domainParameters->maxTokenIds);
+	ber_write_integer(s, domainParameters->numPriorities);
+	ber_write_integer(s, domainParameters->minThroughput);
+	ber_write_integer(s, domainParameters->maxHeight);
+	ber_write_integer(s, domainParameters->maxMCSPDUsize);
+	ber_write_integer(s, domainParameters->protocolVersion);
+	return ber_write_end(s, mark);
 }
 
 #ifdef DEBUG_MCS
@@ -522,6 +512,7 @@ BOOL mcs_recv_connect_initial(rdpMcs* mcs, wStream* s)
 {
 	UINT16 li;
 	size_t length;
+	const BYTE* selector;
 	BOOL upwardFlag;
 	UINT16 tlength;
 
@@ -538,17 +529,13 @@ BOOL mcs_recv_connect_initial(rdpMcs* mcs, wStream* s)
 		return FALSE;
 
 	/* callingDomainSelector (OCTET_STRING) */
-	if (!ber_read_octet_string_tag(s, &length) || (Stream_GetRemainingLength(s)) < length)
+	if (!ber_read_octet_string_ref(s, &selector, &length))
 		return FALSE;
 
-	Stream_Seek(s, length);
-
 	/* calledDomainSelector (OCTET_STRING) */
-	if (!ber_read_octet_string_tag(s, &length) || (Stream_GetRemainingLength(s)) < length)
+	if (!ber_read_octet_string_ref(s, &selector, &length))
 		return FALSE;
 
-	Stream_Seek(s, length);
-
 	/* upwardFlag (BOOLEAN) */
 	if (!ber_read_BOOL(s, &upwardFlag))
 		return FALSE;
@@ -583,55 +570,48 @@ BOOL mcs_recv_connect_initial(rdpMcs* mcs, wStream* s)
  * @msdn{cc240508}
  * @param s stream
  * @param mcs MCS module
- * @param user_data GCC Conference Create Request
  */
 
-BOOL mcs_write_connect_initial(wStream* s, rdpMcs* mcs, wStream* userData)
+BOOL mcs_write_connect_initial(wStream* s, rdpMcs* mcs)
 {
-	size_t length;
-	wStream* tmps;
-	BOOL ret = FALSE;
+	size_t connectInitial, userData;
 
-	if (!s || !mcs || !userData)
+	if (!s || !mcs)
 		return FALSE;
 
-	tmps = Stream_New(NULL, Stream_Capacity(s));
+	/* Connect-Initial (APPLICATION 101, IMPLICIT SEQUENCE) */
+	if (!ber_write_application_begin(s, MCS_TYPE_CONNECT_INITIAL, &connectInitial))
+		return FALSE;
 
-	if (!tmps)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
+	if (!Stream_EnsureRemainingCapacity(s, sizeof(callingDomainSelector) +
+	                                           sizeof(calledDomainSelector) + 16))
 		return FALSE;
-	}
 
 	/* callingDomainSelector (OCTET_STRING) */
-	ber_write_octet_string(tmps, callingDomainSelector, sizeof(callingDomainSelector));
+	ber_write_octet_string(s, callingDomainSelector, sizeof(callingDomainSelector));
 	/* calledDomainSelector (OCTET_STRING) */
-	ber_write_octet_string(tmps, calledDomainSelector, sizeof(calledDomainSelector));
+	ber_write_octet_string(s, calledDomainSelector, sizeof(calledDomainSelector));
 	/* upwardFlag (BOOLEAN) */
-	ber_write_BOOL(tmps, TRUE);
+	ber_write_BOOL(s, TRUE);
 
 	/* targetParameters (DomainParameters) */
-	if (!mcs_write_domain_parameters(tmps, &mcs->targetParameters))
-		goto out;
+	if (!mcs_write_domain_parameters(s, &mcs->targetParameters))
+		return FALSE;
 
 	/* minimumParameters (DomainParameters) */
-	if (!mcs_write_domain_parameters(tmps, &mcs->minimumParameters))
-		goto out;
+	if (!mcs_write_domain_parameters(s, &mcs->minimumParameters))
+		return FALSE;
 
 	/* maximumParameters (DomainParameters) */
-	if (!mcs_write_domain_parameters(tmps, &mcs->maximumParameters))
-		goto out;
+	if (!mcs_write_domain_parameters(s, &mcs->maximumParameters))
+		return FALSE;
 
-	/* userData (OCTET_STRING) */
-	ber_write_octet_string(tmps, Stream_Buffer(userData), Stream_GetPosition(userData));
-	length = Stream_GetPosition(tmps);
-	/* Connect-Initial (APPLICATION 101, IMPLICIT SEQUENCE) */
-	ber_write_application_tag(s, MCS_TYPE_CONNECT_INITIAL, length);
-	Stream_Write(s, Stream_Buffer(tmps), length);
-	ret = TRUE;
-out:
-	Stream_Free(tmps, TRUE);
-	return ret;
+	/* userData (OCTET_STRING), the GCC Conference Create Request */
+	if (!ber_write_octet_string_begin(s, &userData) ||
+	    !gcc_write_conference_create_request(s, mcs) || !ber_write_end(s, userData))
+		return FALSE;
+
+	return ber_write_end(s, connectInitial);
 }
 
 /**
@@ -639,41 +619,31 @@ out:
  * @msdn{cc240508}
  * @param s stream
  * @param mcs MCS module
- * @param user_data GCC Conference Create Response
  */
 
-BOOL mcs_write_connect_response(wStream* s, rdpMcs* mcs, wStream* userData)
+BOOL mcs_write_connect_response(wStream* s, rdpMcs* mcs)
 {
-	size_t length;
-	wStream* tmps;
-	BOOL ret = FALSE;
+	size_t connectResponse, userData;
 
-	if (!s || !mcs || !userData)
+	if (!s || !mcs)
 		return FALSE;
 
-	tmps = Stream_New(NULL, Stream_Capacity(s));
-
-	if (!tmps)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
+	if (!ber_write_application_begin(s, MCS_TYPE_CONNECT_RESPONSE, &connectResponse) ||
+	    !Stream_EnsureRemainingCapacity(s, 16))
 		return FALSE;
-	}
 
-	ber_write_enumerated(tmps, 0, MCS_Result_enum_length);
-	ber_write_integer(tmps, 0); /* calledConnectId */
+	ber_write_enumerated(s, 0, MCS_Result_enum_length);
+	ber_write_integer(s, 0); /* calledConnectId */
 
-	if (!mcs_write_domain_parameters(tmps, &(mcs->domainParameters)))
-		goto out;
+	if (!mcs_write_domain_parameters(s, &(mcs->domainParameters)))
+		return FALSE;
 
-	/* userData (OCTET_STRING) */
-	ber_write_octet_string(tmps, Stream_Buffer(userData), Stream_GetPosition(userData));
-	length = Stream_GetPosition(tmps);
-	ber_write_application_tag(s, MCS_TYPE_CONNECT_RESPONSE, length);
-	Stream_Write(s, Stream_Buffer(tmps), length);
-	ret = TRUE;
-out:
-	Stream_Free(tmps, TRUE);
-	return ret;
+	/* userData (OCTET_STRING), the GCC Conference Create Response */
+	if (!ber_write_octet_string_begin(s, &userData) ||
+	    !gcc_write_conference_create_response(s, mcs) || !ber_write_end(s, userData))
+		return FALSE;
+
+	return ber_write_end(s, connectResponse);
 }
 
 /**
@@ -688,8 +658,6 @@ BOOL mcs_send_connect_initial(rdpMcs* mcs)
 	size_t length;
 	wStream* s = NULL;
 	size_t bm, em;
-	wStream* gcc_CCrq = NULL;
-	wStream* client_data = NULL;
 	rdpContext* context;
 
 	if (!mcs)
@@ -699,39 +667,19 @@ BOOL mcs_send_connect_initial(rdpMcs* mcs)
 	WINPR_ASSERT(context);
 
 	mcs_initialize_client_channels(mcs, context->settings);
-	client_data = Stream_New(NULL, 512);
-
-	if (!client_data)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
-		return FALSE;
-	}
-
-	if (!gcc_write_client_data_blocks(client_data, mcs))
-		goto out;
-	gcc_CCrq = Stream_New(NULL, 1024);
-
-	if (!gcc_CCrq)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
-		goto out;
-	}
-
-	if (!gcc_write_conference_create_request(gcc_CCrq, client_data))
-		goto out;
-	length = Stream_GetPosition(gcc_CCrq) + 7;
-	s = Stream_New(NULL, 1024 + length);
+	s = Stream_New(NULL, 1024);
 
 	if (!s)
 	{
 		WLog_ERR(TAG, "Stream_New failed!");
-		goto out;
+		return FALSE;
 	}
 
 	bm = Stream_GetPosition(s);
 	Stream_Seek(s, 7);
 
-	if (!mcs_write_connect_initial(s, mcs, gcc_CCrq))
+	/* the GCC request and the client data blocks are written in place */
+	if (!mcs_write_connect_initial(s, mcs))
 	{
 		WLog_ERR(TAG, "mcs_write_connect_initial failed!");
 		goto out;
@@ -750,8 +698,6 @@ BOOL mcs_send_connect_initial(rdpMcs* mcs)
 	status = transport_write(mcs->transport, s);
 out:
 	Stream_Free(s, TRUE);
-	Stream_Free(gcc_CCrq, TRUE);
-	Stream_Free(client_data, TRUE);
 	return (status < 0 ? FALSE : TRUE);
 }
 
@@ -808,46 +754,23 @@ BOOL mcs_send_connect_response(rdpMcs* mcs)
 	int status = -1;
 	wStream* s = NULL;
 	size_t bm, em;
-	wStream* gcc_CCrsp = NULL;
-	wStream* server_data = NULL;
 
 	if (!mcs)
 		return FALSE;
 
-	server_data = Stream_New(NULL, 512);
-
-	if (!server_data)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
-		return FALSE;
-	}
-
-	if (!gcc_write_server_data_blocks(server_data, mcs))
-		goto out;
-
-	gcc_CCrsp = Stream_New(NULL, 512 + Stream_Capacity(server_data));
-
-	if (!gcc_CCrsp)
-	{
-		WLog_ERR(TAG, "Stream_New failed!");
-		goto out;
-	}
-
-	if (!gcc_write_conference_create_response(gcc_CCrsp, server_data))
-		goto out;
-	length = Stream_GetPosition(gcc_CCrsp) + 7;
-	s = Stream_New(NULL, length + 1024);
+	s = Stream_New(NULL, 1024);
 
 	if (!s)
 	{
 		WLog_ERR(TAG, "Stream_New failed!");
-		goto out;
+		return FALSE;
 	}
 
 	bm = Stream_GetPosition(s);
 	Stream_Seek(s, 7);
 
-	if (!mcs_write_connect_response(s, mcs, gcc_CCrsp))
+	/* the GCC response and the server data blocks are written in place */
+	if (!mcs_write_connect_response(s, mcs))
 		goto out;
 
 	em = Stream_GetPosition(s);
@@ -863,8 +786,6 @@ BOOL mcs_send_connect_response(rdpMcs* mcs)
 	status = transport_write(mcs->transport, s);
 out:
 	Stream_Free(s, TRUE);
-	Stream_Free(gcc_CCrsp, TRUE);
-	Stream_Free(server_data, TRUE);
 	return (status < 0) ? FALSE : TRUE;
 }
 
@@ -124,14 +124,24 @@ static BOOL update_message_BitmapUpdate(rdpContext* context, const BITMAP_UPDATE
 	if (!context || !context->update || !bitmap)
 		return FALSE;
 
-	wParam = copy_bitmap_update(context, bitmap);
+	/* keep the update the parser offered, it is freed after dispatching like a copy */
+	if (update_take_parsed(context->update, bitmap))
+		wParam = (BITMAP_UPDATE*)bitmap;
+	else
+		wParam = copy_bitmap_update(context, bitmap);
 
 	if (!wParam)
 		return FALSE;
 
 	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, BitmapUpdate),
-	                         (void*)wParam, NULL);
+	if (!MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, BitmapUpdate),
+	                       (void*)wParam, NULL))
+	{
+		free_bitmap_update(context, wParam);
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
 static BOOL update_message_Palette(rdpContext* context, const PALETTE_UPDATE* palette)
@@ -267,19 +277,45 @@ static BOOL update_message_SurfaceBits(rdpContext* context,
                                        const SURFACE_BITS_COMMAND* surfaceBitsCommand)
 {
 	SURFACE_BITS_COMMAND* wParam;
+	wStream* payload;
 	rdp_update_internal* up;
 
 	if (!context || !context->update || !surfaceBitsCommand)
 		return FALSE;
 
-	wParam = copy_surface_bits_command(context, surfaceBitsCommand);
+	/* reference the received payload the bitmap data points into instead of copying it */
+	payload = update_ref_payload(context->update, surfaceBitsCommand->bmp.bitmapData,
+	                             surfaceBitsCommand->bmp.bitmapDataLength);
+
+	if (payload)
+	{
+		wParam = (SURFACE_BITS_COMMAND*)malloc(sizeof(SURFACE_BITS_COMMAND));
+
+		if (wParam)
+			*wParam = *surfaceBitsCommand;
+	}
+	else
+		wParam = copy_surface_bits_command(context, surfaceBitsCommand);
 
 	if (!wParam)
-		return FALSE;
+		goto fail;
 
 	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, SurfaceBits),
-	                         (void*)wParam, NULL);
+	if (!MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, SurfaceBits),
+	                       (void*)wParam, (void*)payload))
+	{
+		if (payload)
+			free(wParam);
+		else
+			free_surface_bits_command(context, wParam);
+		goto fail;
+	}
+
+	return TRUE;
+fail:
+	if (payload)
+		Stream_Release(payload);
+	return FALSE;
 }
 
 static BOOL update_message_SurfaceFrameMarker(rdpContext* context,
@@ -1744,7 +1780,15 @@ static BOOL update_message_free_update_class(wMessage* msg, int type)
 		case Update_SurfaceBits:
 		{
 			SURFACE_BITS_COMMAND* wParam = (SURFACE_BITS_COMMAND*)msg->wParam;
-			free_surface_bits_command(context, wParam);
+
+			/* the bitmap data is either referenced in a payload or owned by the command */
+			if (msg->lParam)
+			{
+				Stream_Release((wStream*)msg->lParam);
+				free(wParam);
+			}
+			else
+				free_surface_bits_command(context, wParam);
 		}
 		break;
 
@@ -2664,19 +2708,25 @@ int update_message_queue_free_message(wMessage* message)
 int update_message_queue_process_pending_messages(rdpUpdate* update)
 {
 	int status;
-	wMessage message;
+	size_t index;
+	size_t count;
+	wMessage messages[32];
 	wMessageQueue* queue;
 	rdp_update_internal* up = update_cast(update);
 
 	status = 1;
 	queue = up->queue;
 
-	while (MessageQueue_Peek(queue, &message, TRUE))
+	/* A batch ends with WMQ_QUIT at the latest, nothing is left behind on quit */
+	while ((count = MessageQueue_GetBatch(queue, messages, ARRAYSIZE(messages))) > 0)
 	{
-		status = update_message_queue_process_message(update, &message);
+		for (index = 0; index < count; index++)
+		{
+			status = update_message_queue_process_message(update, &messages[index]);
 
-		if (!status)
-			break;
+			if (!status)
+				return status;
+		}
 	}
 
 	return status;
@@ -2749,6 +2799,8 @@ static BOOL update_message_register_interface(rdpUpdateProxy* message, rdpUpdate
 	message->LineTo = primary->LineTo;
 	message->Polyline = primary->Polyline;
 	message->MemBlt = primary->MemBlt;
+	/* batches are not proxied, the orders are posted one by one instead */
+	primary->OrdersBatch = NULL;
 	message->Mem3Blt = primary->Mem3Blt;
 	message->SaveBitmap = primary->SaveBitmap;
 	message->GlyphIndex = primary->GlyphIndex;
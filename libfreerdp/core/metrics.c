@@ -19,8 +19,109 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
 #include "rdp.h"
 
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+/* Histograms are log-linear: values below METRICS_SUB_BUCKETS are exact, above that every power
+ * of two is split into METRICS_SUB_BUCKETS buckets, which keeps the relative error below 12.5% */
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_EXPONENT 40 /* about 12 days in microseconds */
+#define METRICS_BUCKETS \
+	(METRICS_SUB_BUCKETS + (METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS) * METRICS_SUB_BUCKETS)
+
+#define METRICS_MAX_CHANNELS 32
+#define METRICS_FRAME_SLOTS 64
+#define METRICS_RATE_WINDOW_MS 1000
+
+typedef struct
+{
+	volatile LONGLONG value;
+	volatile LONGLONG windowStart;
+	volatile LONGLONG windowValue;
+	volatile LONGLONG rate; /* events per second of the last window, times 1000 */
+} rdpMetricsCounter;
+
+typedef struct
+{
+	volatile LONGLONG count;
+	volatile LONGLONG sum;
+	volatile LONGLONG min;
+	volatile LONGLONG max;
+	volatile LONGLONG buckets[METRICS_BUCKETS];
+} rdpMetricsHistogram;
+
+typedef struct
+{
+	volatile LONG channelId; /* channel id + 1, 0 for an unused slot */
+	char name[CHANNEL_NAME_LEN + 1];
+	volatile LONGLONG bytesIn;
+	volatile LONGLONG bytesOut;
+} rdpMetricsChannel;
+
+typedef struct
+{
+	volatile LONGLONG frameId; /* frame id + 1, 0 for an unused slot */
+	volatile LONGLONG sent;
+} rdpMetricsFrame;
+
+typedef struct
+{
+	rdpMetrics common;
+
+	rdpMetricsCounter counters[FREERDP_METRIC_COUNTER_COUNT];
+	volatile LONGLONG gauges[FREERDP_METRIC_GAUGE_COUNT];
+	rdpMetricsHistogram histograms[FREERDP_METRIC_HISTOGRAM_COUNT];
+	rdpMetricsChannel channels[METRICS_MAX_CHANNELS];
+	rdpMetricsFrame frames[METRICS_FRAME_SLOTS];
+} rdp_metrics_internal;
+
+static INLINE rdp_metrics_internal* metrics_cast(rdpMetrics* metrics)
+{
+	union
+	{
+		rdpMetrics* pub;
+		rdp_metrics_internal* internal;
+	} cnv;
+
+	cnv.pub = metrics;
+	return cnv.internal;
+}
+
+static INLINE LONGLONG metrics_read64(volatile LONGLONG* target)
+{
+	return InterlockedCompareExchange64(target, 0, 0);
+}
+
+static INLINE LONGLONG metrics_add64(volatile LONGLONG* target, LONGLONG value)
+{
+	LONGLONG cur;
+
+	do
+	{
+		cur = *target;
+	} while (InterlockedCompareExchange64(target, cur + value, cur) != cur);
+
+	return cur + value;
+}
+
+static INLINE void metrics_set64(volatile LONGLONG* target, LONGLONG value)
+{
+	LONGLONG cur;
+
+	do
+	{
+		cur = *target;
+	} while (InterlockedCompareExchange64(target, value, cur) != cur);
+}
+
 double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32 CompressedBytes)
 {
 	double CompressionRatio = 0.0;
@@ -37,21 +138,534 @@ double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32
 	return CompressionRatio;
 }
 
-rdpMetrics* metrics_new(rdpContext* context)
+UINT64 metrics_get_time_us(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (UINT64)((count.QuadPart / freq.QuadPart) * 1000000ull +
+	                ((count.QuadPart % freq.QuadPart) * 1000000ull) / freq.QuadPart);
+#else
+	struct timespec ts = { 0 };
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return GetTickCount64() * 1000ull;
+	return (UINT64)ts.tv_sec * 1000000ull + (UINT64)ts.tv_nsec / 1000ull;
+#endif
+}
+
+void metrics_counter_add(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter, UINT64 value)
+{
+	LONGLONG now;
+	LONGLONG start;
+	rdpMetricsCounter* cur;
+
+	if (!metrics || (counter >= FREERDP_METRIC_COUNTER_COUNT))
+		return;
+
+	cur = &metrics_cast(metrics)->counters[counter];
+	metrics_add64(&cur->value, (LONGLONG)value);
+
+	/* The first update after a window elapsed closes it, everyone else just counts */
+	now = (LONGLONG)GetTickCount64();
+	start = cur->windowStart;
+	if ((now - start >= METRICS_RATE_WINDOW_MS) &&
+	    (InterlockedCompareExchange64(&cur->windowStart, now, start) == start))
+	{
+		const LONGLONG total = metrics_read64(&cur->value);
+		const LONGLONG delta = total - metrics_read64(&cur->windowValue);
+
+		metrics_set64(&cur->rate, delta * 1000000ll / (now - start));
+		metrics_set64(&cur->windowValue, total);
+	}
+}
+
+UINT64 metrics_counter_get(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter)
+{
+	if (!metrics || (counter >= FREERDP_METRIC_COUNTER_COUNT))
+		return 0;
+
+	return (UINT64)metrics_read64(&metrics_cast(metrics)->counters[counter].value);
+}
+
+double metrics_counter_rate(rdpMetrics* metrics, FREERDP_METRIC_COUNTER counter)
+{
+	LONGLONG now;
+	LONGLONG start;
+	rdpMetricsCounter* cur;
+
+	if (!metrics || (counter >= FREERDP_METRIC_COUNTER_COUNT))
+		return 0.0;
+
+	cur = &metrics_cast(metrics)->counters[counter];
+	now = (LONGLONG)GetTickCount64();
+	start = metrics_read64(&cur->windowStart);
+
+	/* Without updates the last window never closes, report what happened since */
+	if (now - start >= 2 * METRICS_RATE_WINDOW_MS)
+		return (double)(metrics_read64(&cur->value) - metrics_read64(&cur->windowValue)) *
+		       1000.0 / (double)(now - start);
+
+	return (double)metrics_read64(&cur->rate) / 1000.0;
+}
+
+const char* metrics_counter_name(FREERDP_METRIC_COUNTER counter)
+{
+	switch (counter)
+	{
+		case FREERDP_METRIC_BYTES_IN:
+			return "bytes_in";
+		case FREERDP_METRIC_BYTES_OUT:
+			return "bytes_out";
+		case FREERDP_METRIC_PDUS_IN:
+			return "pdus_in";
+		case FREERDP_METRIC_PDUS_OUT:
+			return "pdus_out";
+		case FREERDP_METRIC_FRAMES_DECODED:
+			return "frames_decoded";
+		case FREERDP_METRIC_FRAMES_ENCODED:
+			return "frames_encoded";
+		case FREERDP_METRIC_FRAMES_ACKNOWLEDGED:
+			return "frames_acknowledged";
+		case FREERDP_METRIC_TRANSPORT_IO_TIME:
+			return "transport_io_microseconds";
+		case FREERDP_METRIC_GATEWAY_IO_TIME:
+			return "gateway_io_microseconds";
+		default:
+			return "unknown";
+	}
+}
+
+void metrics_gauge_add(rdpMetrics* metrics, FREERDP_METRIC_GAUGE gauge, INT64 value)
+{
+	if (!metrics || (gauge >= FREERDP_METRIC_GAUGE_COUNT))
+		return;
+
+	metrics_add64(&metrics_cast(metrics)->gauges[gauge], value);
+}
+
+INT64 metrics_gauge_get(rdpMetrics* metrics, FREERDP_METRIC_GAUGE gauge)
+{
+	if (!metrics || (gauge >= FREERDP_METRIC_GAUGE_COUNT))
+		return 0;
+
+	return metrics_read64(&metrics_cast(metrics)->gauges[gauge]);
+}
+
+const char* metrics_gauge_name(FREERDP_METRIC_GAUGE gauge)
+{
+	switch (gauge)
+	{
+		case FREERDP_METRIC_CODEC_CONTEXTS:
+			return "codec_contexts";
+		case FREERDP_METRIC_SURFACE_BYTES:
+			return "surface_bytes";
+		default:
+			return "unknown";
+	}
+}
+
+static size_t metrics_histogram_index(UINT64 value)
+{
+	size_t exponent = 0;
+	UINT64 v = value;
+
+	if (value < METRICS_SUB_BUCKETS)
+		return (size_t)value;
+
+	while (v >>= 1)
+		exponent++;
+
+	if (exponent >= METRICS_MAX_EXPONENT)
+		return METRICS_BUCKETS - 1;
+
+	return METRICS_SUB_BUCKETS + (exponent - METRICS_SUB_BUCKET_BITS) * METRICS_SUB_BUCKETS +
+	       (size_t)((value >> (exponent - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1));
+}
+
+/* The middle of the range of values a bucket holds */
+static UINT64 metrics_histogram_value(size_t index)
+{
+	size_t exponent;
+	UINT64 sub;
+
+	if (index < METRICS_SUB_BUCKETS)
+		return index;
+
+	exponent = (index - METRICS_SUB_BUCKETS) / METRICS_SUB_BUCKETS + METRICS_SUB_BUCKET_BITS;
+	sub = (index - METRICS_SUB_BUCKETS) % METRICS_SUB_BUCKETS;
+	return ((METRICS_SUB_BUCKETS + sub) << (exponent - METRICS_SUB_BUCKET_BITS)) +
+	       ((1ull << (exponent - METRICS_SUB_BUCKET_BITS)) >> 1);
+}
+
+void metrics_histogram_record(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM histogram,
+                              UINT64 value)
+{
+	LONGLONG cur;
+	rdpMetricsHistogram* h;
+	const LONGLONG v = (LONGLONG)MIN(value, INT64_MAX);
+
+	if (!metrics || (histogram >= FREERDP_METRIC_HISTOGRAM_COUNT))
+		return;
+
+	h = &metrics_cast(metrics)->histograms[histogram];
+	metrics_add64(&h->buckets[metrics_histogram_index(value)], 1);
+	metrics_add64(&h->sum, v);
+
+	/* min is stored as the complement so an unused histogram can stay all zero */
+	do
+	{
+		cur = h->min;
+		if ((cur != 0) && (~cur <= v))
+			break;
+	} while (InterlockedCompareExchange64(&h->min, ~v, cur) != cur);
+
+	do
+	{
+		cur = h->max;
+		if (cur >= v)
+			break;
+	} while (InterlockedCompareExchange64(&h->max, v, cur) != cur);
+
+	metrics_add64(&h->count, 1);
+}
+
+static UINT64 metrics_histogram_find(rdpMetricsHistogram* h, UINT64 total, double percentile)
+{
+	size_t x;
+	UINT64 seen = 0;
+	UINT64 rank;
+
+	if (total == 0)
+		return 0;
+
+	if (percentile < 0.0)
+		percentile = 0.0;
+	if (percentile > 100.0)
+		percentile = 100.0;
+
+	rank = (UINT64)((percentile / 100.0) * (double)total + 0.5);
+	if (rank == 0)
+		rank = 1;
+	if (rank >= total)
+		return (UINT64)metrics_read64(&h->max);
+
+	for (x = 0; x < METRICS_BUCKETS; x++)
+	{
+		seen += (UINT64)metrics_read64(&h->buckets[x]);
+		if (seen >= rank)
+		{
+			const UINT64 value = metrics_histogram_value(x);
+			const UINT64 max = (UINT64)metrics_read64(&h->max);
+			return MIN(value, max);
+		}
+	}
+
+	return (UINT64)metrics_read64(&h->max);
+}
+
+UINT64 metrics_histogram_percentile(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM histogram,
+                                    double percentile)
+{
+	rdpMetricsHistogram* h;
+
+	if (!metrics || (histogram >= FREERDP_METRIC_HISTOGRAM_COUNT))
+		return 0;
+
+	h = &metrics_cast(metrics)->histograms[histogram];
+	return metrics_histogram_find(h, (UINT64)metrics_read64(&h->count), percentile);
+}
+
+BOOL metrics_histogram_get(rdpMetrics* metrics, FREERDP_METRIC_HISTOGRAM histogram,
+                           FREERDP_METRIC_HISTOGRAM_SUMMARY* summary)
+{
+	rdpMetricsHistogram* h;
+
+	if (!metrics || !summary || (histogram >= FREERDP_METRIC_HISTOGRAM_COUNT))
+		return FALSE;
+
+	h = &metrics_cast(metrics)->histograms[histogram];
+	summary->count = (UINT64)metrics_read64(&h->count);
+	summary->sum = (UINT64)metrics_read64(&h->sum);
+	summary->min = (summary->count > 0) ? (UINT64)~metrics_read64(&h->min) : 0;
+	summary->max = (UINT64)metrics_read64(&h->max);
+	summary->p50 = metrics_histogram_find(h, summary->count, 50.0);
+	summary->p90 = metrics_histogram_find(h, summary->count, 90.0);
+	summary->p99 = metrics_histogram_find(h, summary->count, 99.0);
+	return TRUE;
+}
+
+const char* metrics_histogram_name(FREERDP_METRIC_HISTOGRAM histogram)
+{
+	switch (histogram)
+	{
+		case FREERDP_METRIC_RTT:
+			return "rtt";
+		case FREERDP_METRIC_FRAME_ACK_LATENCY:
+			return "frame_ack_latency";
+		case FREERDP_METRIC_DECODE_TIME:
+			return "decode_time";
+		case FREERDP_METRIC_PRESENT_TIME:
+			return "present_time";
+		case FREERDP_METRIC_NETWORK_WAIT:
+			return "network_wait";
+		case FREERDP_METRIC_FRAME_LATENCY:
+			return "frame_latency";
+		case FREERDP_METRIC_FRAME_DECODE_TIME:
+			return "frame_decode_time";
+		case FREERDP_METRIC_FRAME_TIME:
+			return "frame_time";
+		default:
+			return "unknown";
+	}
+}
+
+void metrics_channel_bytes(rdpMetrics* metrics, UINT16 channelId, const char* name,
+                           UINT64 bytesIn, UINT64 bytesOut)
+{
+	size_t x;
+	const LONG id = (LONG)channelId + 1;
+	rdp_metrics_internal* internal = metrics_cast(metrics);
+
+	if (!metrics)
+		return;
+
+	for (x = 0; x < METRICS_MAX_CHANNELS; x++)
+	{
+		rdpMetricsChannel* channel = &internal->channels[x];
+		LONG cur = channel->channelId;
+
+		/* claim the first free slot for a channel seen for the first time */
+		if (cur == 0)
+		{
+			cur = InterlockedCompareExchange(&channel->channelId, id, 0);
+			if (cur == 0)
+			{
+				if (name)
+					strncpy(channel->name, name, CHANNEL_NAME_LEN);
+				cur = id;
+			}
+		}
+
+		if (cur == id)
+		{
+			if (bytesIn > 0)
+				metrics_add64(&channel->bytesIn, (LONGLONG)bytesIn);
+			if (bytesOut > 0)
+				metrics_add64(&channel->bytesOut, (LONGLONG)bytesOut);
+			return;
+		}
+	}
+}
+
+size_t metrics_channel_count(rdpMetrics* metrics)
+{
+	size_t x;
+	rdp_metrics_internal* internal = metrics_cast(metrics);
+
+	if (!metrics)
+		return 0;
+
+	for (x = 0; x < METRICS_MAX_CHANNELS; x++)
+	{
+		if (internal->channels[x].channelId == 0)
+			break;
+	}
+
+	return x;
+}
+
+BOOL metrics_channel_get(rdpMetrics* metrics, size_t index, const char** name, UINT64* bytesIn,
+                         UINT64* bytesOut)
+{
+	rdpMetricsChannel* channel;
+
+	if (!metrics || (index >= METRICS_MAX_CHANNELS))
+		return FALSE;
+
+	channel = &metrics_cast(metrics)->channels[index];
+	if (channel->channelId == 0)
+		return FALSE;
+
+	if (name)
+		*name = channel->name;
+	if (bytesIn)
+		*bytesIn = (UINT64)metrics_read64(&channel->bytesIn);
+	if (bytesOut)
+		*bytesOut = (UINT64)metrics_read64(&channel->bytesOut);
+	return TRUE;
+}
+
+void metrics_frame_sent(rdpMetrics* metrics, UINT32 frameId)
+{
+	rdpMetricsFrame* frame;
+
+	if (!metrics)
+		return;
+
+	frame = &metrics_cast(metrics)->frames[frameId % METRICS_FRAME_SLOTS];
+	metrics_set64(&frame->sent, (LONGLONG)metrics_get_time_us());
+	metrics_set64(&frame->frameId, (LONGLONG)frameId + 1);
+	metrics_counter_add(metrics, FREERDP_METRIC_FRAMES_ENCODED, 1);
+}
+
+void metrics_frame_acknowledged(rdpMetrics* metrics, UINT32 frameId)
+{
+	LONGLONG sent;
+	rdpMetricsFrame* frame;
+	const LONGLONG id = (LONGLONG)frameId + 1;
+
+	if (!metrics)
+		return;
+
+	metrics_counter_add(metrics, FREERDP_METRIC_FRAMES_ACKNOWLEDGED, 1);
+
+	/* frames that were overwritten by newer ones in the meantime are not timed */
+	frame = &metrics_cast(metrics)->frames[frameId % METRICS_FRAME_SLOTS];
+	sent = metrics_read64(&frame->sent);
+	if (InterlockedCompareExchange64(&frame->frameId, 0, id) != id)
+		return;
+
+	metrics_histogram_record(metrics, FREERDP_METRIC_FRAME_ACK_LATENCY,
+	                         metrics_get_time_us() - (UINT64)sent);
+}
+
+static BOOL metrics_export_line(pMetricsExportLine fkt, void* custom, const char* fmt, ...)
 {
-	rdpMetrics* metrics;
+	int rc;
+	va_list ap;
+	char line[512] = { 0 };
 
-	metrics = (rdpMetrics*)calloc(1, sizeof(rdpMetrics));
+	va_start(ap, fmt);
+	rc = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
 
-	if (metrics)
+	if ((rc < 0) || ((size_t)rc >= sizeof(line)))
+		return FALSE;
+
+	return fkt(custom, line);
+}
+
+BOOL metrics_export(rdpMetrics* metrics, const char* labels, pMetricsExportLine fkt,
+                    void* custom)
+{
+	size_t x;
+	const char* sep;
+	const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+	if (!metrics || !fkt)
+		return FALSE;
+
+	if (!labels)
+		labels = "";
+	sep = (labels[0] != '\0') ? "," : "";
+
+	for (x = 0; x < FREERDP_METRIC_COUNTER_COUNT; x++)
+	{
+		const char* name = metrics_counter_name((FREERDP_METRIC_COUNTER)x);
+
+		if (!metrics_export_line(fkt, custom, "# TYPE freerdp_%s_total counter", name) ||
+		    !metrics_export_line(fkt, custom, "freerdp_%s_total{%s} %" PRIu64, name, labels,
+		                         metrics_counter_get(metrics, (FREERDP_METRIC_COUNTER)x)))
+			return FALSE;
+	}
+
+	for (x = 0; x < FREERDP_METRIC_GAUGE_COUNT; x++)
 	{
-		metrics->context = context;
+		const char* name = metrics_gauge_name((FREERDP_METRIC_GAUGE)x);
+
+		if (!metrics_export_line(fkt, custom, "# TYPE freerdp_%s gauge", name) ||
+		    !metrics_export_line(fkt, custom, "freerdp_%s{%s} %" PRId64, name, labels,
+		                         metrics_gauge_get(metrics, (FREERDP_METRIC_GAUGE)x)))
+			return FALSE;
 	}
 
-	return metrics;
+	if (!metrics_export_line(fkt, custom, "# TYPE freerdp_channel_bytes_in_total counter"))
+		return FALSE;
+	for (x = 0; x < METRICS_MAX_CHANNELS; x++)
+	{
+		const char* name = NULL;
+		UINT64 bytesIn = 0;
+
+		if (!metrics_channel_get(metrics, x, &name, &bytesIn, NULL))
+			break;
+		if (!metrics_export_line(fkt, custom,
+		                         "freerdp_channel_bytes_in_total{%s%schannel=\"%s\"} %" PRIu64,
+		                         labels, sep, name, bytesIn))
+			return FALSE;
+	}
+
+	if (!metrics_export_line(fkt, custom, "# TYPE freerdp_channel_bytes_out_total counter"))
+		return FALSE;
+	for (x = 0; x < METRICS_MAX_CHANNELS; x++)
+	{
+		const char* name = NULL;
+		UINT64 bytesOut = 0;
+
+		if (!metrics_channel_get(metrics, x, &name, NULL, &bytesOut))
+			break;
+		if (!metrics_export_line(fkt, custom,
+		                         "freerdp_channel_bytes_out_total{%s%schannel=\"%s\"} %" PRIu64,
+		                         labels, sep, name, bytesOut))
+			return FALSE;
+	}
+
+	for (x = 0; x < FREERDP_METRIC_HISTOGRAM_COUNT; x++)
+	{
+		size_t y;
+		FREERDP_METRIC_HISTOGRAM_SUMMARY summary = { 0 };
+		const char* name = metrics_histogram_name((FREERDP_METRIC_HISTOGRAM)x);
+
+		if (!metrics_histogram_get(metrics, (FREERDP_METRIC_HISTOGRAM)x, &summary))
+			return FALSE;
+		if (!metrics_export_line(fkt, custom, "# TYPE freerdp_%s_microseconds summary", name))
+			return FALSE;
+
+		for (y = 0; y < ARRAYSIZE(quantiles); y++)
+		{
+			const UINT64 value = metrics_histogram_percentile(
+			    metrics, (FREERDP_METRIC_HISTOGRAM)x, quantiles[y] * 100.0);
+
+			if (!metrics_export_line(fkt, custom,
+			                         "freerdp_%s_microseconds{%s%squantile=\"%g\"} %" PRIu64, name,
+			                         labels, sep, quantiles[y], value))
+				return FALSE;
+		}
+
+		if (!metrics_export_line(fkt, custom, "freerdp_%s_microseconds_sum{%s} %" PRIu64, name,
+		                         labels, summary.sum) ||
+		    !metrics_export_line(fkt, custom, "freerdp_%s_microseconds_count{%s} %" PRIu64, name,
+		                         labels, summary.count))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+rdpMetrics* metrics_new(rdpContext* context)
+{
+	size_t x;
+	rdp_metrics_internal* metrics;
+	const LONGLONG now = (LONGLONG)GetTickCount64();
+
+	metrics = (rdp_metrics_internal*)calloc(1, sizeof(rdp_metrics_internal));
+
+	if (!metrics)
+		return NULL;
+
+	metrics->common.context = context;
+
+	for (x = 0; x < FREERDP_METRIC_COUNTER_COUNT; x++)
+		metrics->counters[x].windowStart = now;
+
+	return &metrics->common;
 }
 
 void metrics_free(rdpMetrics* metrics)
 {
-	free(metrics);
+	free(metrics_cast(metrics));
 }
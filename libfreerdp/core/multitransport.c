@@ -19,29 +19,188 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/assert.h>
+#include <winpr/crypto.h>
+
 #include "multitransport.h"
 
+static const char* multitransport_protocol_string(UINT16 protocol)
+{
+	switch (protocol)
+	{
+		case INITITATE_REQUEST_PROTOCOL_UDPFECR:
+			return "INITITATE_REQUEST_PROTOCOL_UDPFECR";
+		case INITITATE_REQUEST_PROTOCOL_UDPFECL:
+			return "INITITATE_REQUEST_PROTOCOL_UDPFECL";
+		default:
+			return "INITITATE_REQUEST_PROTOCOL_UNKNOWN";
+	}
+}
+
+/**
+ * Send an Initiate Multitransport Response PDU (MS-RDPBCGR 2.2.15.2).
+ */
+static BOOL multitransport_client_send_response(rdpMultitransport* multitransport, HRESULT hr)
+{
+	wStream* s;
+	rdpRdp* rdp;
+
+	WINPR_ASSERT(multitransport);
+	rdp = multitransport->rdp;
+
+	s = rdp_message_channel_pdu_init(rdp);
+	if (!s)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 8))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+
+	Stream_Write_UINT32(s, multitransport->requestId); /* requestId (4 bytes) */
+	Stream_Write_UINT32(s, (UINT32)hr);                /* hrResponse (4 bytes) */
+	return rdp_send_message_channel_pdu(rdp, s, SEC_TRANSPORT_RSP);
+}
+
+/**
+ * Read an Initiate Multitransport Request PDU (MS-RDPBCGR 2.2.15.1).
+ *
+ * There is no RDP-UDP transport to set up the sideband channel with, so the request is
+ * declined with E_ABORT. The server then keeps all traffic on the main connection instead of
+ * waiting for a tunnel that never arrives.
+ */
 int rdp_recv_multitransport_packet(rdpRdp* rdp, wStream* s)
 {
-	UINT32 requestId;
-	UINT16 requestedProtocol;
 	UINT16 reserved;
-	BYTE securityCookie[16];
+	rdpMultitransport* multitransport;
+
+	WINPR_ASSERT(rdp);
+	multitransport = rdp->multitransport;
+	WINPR_ASSERT(multitransport);
 
 	if (Stream_GetRemainingLength(s) < 24)
 		return -1;
 
-	Stream_Read_UINT32(s, requestId);         /* requestId (4 bytes) */
-	Stream_Read_UINT16(s, requestedProtocol); /* requestedProtocol (2 bytes) */
-	Stream_Read_UINT16(s, reserved);          /* reserved (2 bytes) */
-	Stream_Read(s, securityCookie, 16);       /* securityCookie (16 bytes) */
+	Stream_Read_UINT32(s, multitransport->requestId);         /* requestId (4 bytes) */
+	Stream_Read_UINT16(s, multitransport->requestedProtocol); /* requestedProtocol (2 bytes) */
+	Stream_Read_UINT16(s, reserved);                          /* reserved (2 bytes) */
+	Stream_Read(s, multitransport->securityCookie, 16);       /* securityCookie (16 bytes) */
+
+	WINPR_UNUSED(reserved);
+	WLog_DBG(MULTITRANSPORT_TAG,
+	         "received Initiate Multitransport Request: requestId=%" PRIu32 ", protocol=%s",
+	         multitransport->requestId,
+	         multitransport_protocol_string(multitransport->requestedProtocol));
+
+	multitransport->state = MULTITRANSPORT_STATE_DECLINED;
+	multitransport->hrResponse = E_ABORT;
+
+	if (!multitransport_client_send_response(multitransport, multitransport->hrResponse))
+		return -1;
 
 	return 0;
 }
 
-rdpMultitransport* multitransport_new(void)
+/**
+ * Read an Initiate Multitransport Response PDU (MS-RDPBCGR 2.2.15.2).
+ */
+int rdp_recv_multitransport_response(rdpRdp* rdp, wStream* s)
 {
-	return (rdpMultitransport*)calloc(1, sizeof(rdpMultitransport));
+	UINT32 requestId;
+	UINT32 hrResponse;
+	rdpMultitransport* multitransport;
+
+	WINPR_ASSERT(rdp);
+	multitransport = rdp->multitransport;
+	WINPR_ASSERT(multitransport);
+
+	if (Stream_GetRemainingLength(s) < 8)
+		return -1;
+
+	Stream_Read_UINT32(s, requestId);  /* requestId (4 bytes) */
+	Stream_Read_UINT32(s, hrResponse); /* hrResponse (4 bytes) */
+
+	if ((multitransport->state != MULTITRANSPORT_STATE_REQUESTED) ||
+	    (requestId != multitransport->requestId))
+	{
+		WLog_WARN(MULTITRANSPORT_TAG,
+		          "unexpected Initiate Multitransport Response for requestId=%" PRIu32,
+		          requestId);
+		return 0;
+	}
+
+	multitransport->hrResponse = (HRESULT)hrResponse;
+	multitransport->state = SUCCEEDED(multitransport->hrResponse)
+	                            ? MULTITRANSPORT_STATE_ACCEPTED
+	                            : MULTITRANSPORT_STATE_DECLINED;
+	WLog_DBG(MULTITRANSPORT_TAG,
+	         "received Initiate Multitransport Response: requestId=%" PRIu32
+	         ", hrResponse=0x%08" PRIx32,
+	         requestId, hrResponse);
+	return 0;
+}
+
+/**
+ * Send an Initiate Multitransport Request PDU (MS-RDPBCGR 2.2.15.1) to the client.
+ */
+BOOL multitransport_server_send_request(rdpMultitransport* multitransport,
+                                        UINT16 requestedProtocol)
+{
+	wStream* s;
+	rdpRdp* rdp;
+
+	WINPR_ASSERT(multitransport);
+	rdp = multitransport->rdp;
+	WINPR_ASSERT(rdp);
+
+	if ((requestedProtocol != INITITATE_REQUEST_PROTOCOL_UDPFECR) &&
+	    (requestedProtocol != INITITATE_REQUEST_PROTOCOL_UDPFECL))
+		return FALSE;
+
+	s = rdp_message_channel_pdu_init(rdp);
+	if (!s)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 24))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+
+	multitransport->requestId++;
+	multitransport->requestedProtocol = requestedProtocol;
+	winpr_RAND(multitransport->securityCookie, sizeof(multitransport->securityCookie));
+
+	Stream_Write_UINT32(s, multitransport->requestId); /* requestId (4 bytes) */
+	Stream_Write_UINT16(s, requestedProtocol);         /* requestedProtocol (2 bytes) */
+	Stream_Write_UINT16(s, 0);                         /* reserved (2 bytes) */
+	Stream_Write(s, multitransport->securityCookie,
+	             sizeof(multitransport->securityCookie)); /* securityCookie (16 bytes) */
+
+	if (!rdp_send_message_channel_pdu(rdp, s, SEC_TRANSPORT_REQ))
+		return FALSE;
+
+	multitransport->state = MULTITRANSPORT_STATE_REQUESTED;
+	return TRUE;
+}
+
+MULTITRANSPORT_STATE multitransport_get_state(const rdpMultitransport* multitransport)
+{
+	WINPR_ASSERT(multitransport);
+	return multitransport->state;
+}
+
+rdpMultitransport* multitransport_new(rdpRdp* rdp)
+{
+	rdpMultitransport* multitransport =
+	    (rdpMultitransport*)calloc(1, sizeof(rdpMultitransport));
+
+	if (!multitransport)
+		return NULL;
+
+	multitransport->rdp = rdp;
+	return multitransport;
 }
 
 void multitransport_free(rdpMultitransport* multitransport)
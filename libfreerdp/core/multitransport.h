@@ -25,18 +25,43 @@ typedef struct rdp_multitransport rdpMultitransport;
 #include "rdp.h"
 
 #include <freerdp/freerdp.h>
+#include <freerdp/log.h>
 #include <freerdp/api.h>
 
 #include <winpr/stream.h>
 
+#define MULTITRANSPORT_TAG FREERDP_TAG("core.multitransport")
+
+#define INITITATE_REQUEST_PROTOCOL_UDPFECR 0x01
+#define INITITATE_REQUEST_PROTOCOL_UDPFECL 0x02
+
+typedef enum
+{
+	MULTITRANSPORT_STATE_NONE,
+	MULTITRANSPORT_STATE_REQUESTED,
+	MULTITRANSPORT_STATE_DECLINED,
+	MULTITRANSPORT_STATE_ACCEPTED
+} MULTITRANSPORT_STATE;
+
 struct rdp_multitransport
 {
-	UINT32 placeholder;
+	rdpRdp* rdp;
+	MULTITRANSPORT_STATE state;
+	UINT32 requestId;
+	UINT16 requestedProtocol;
+	BYTE securityCookie[16];
+	HRESULT hrResponse;
 };
 
 FREERDP_LOCAL int rdp_recv_multitransport_packet(rdpRdp* rdp, wStream* s);
+FREERDP_LOCAL int rdp_recv_multitransport_response(rdpRdp* rdp, wStream* s);
+
+FREERDP_LOCAL BOOL multitransport_server_send_request(rdpMultitransport* multitransport,
+                                                      UINT16 requestedProtocol);
+FREERDP_LOCAL MULTITRANSPORT_STATE
+multitransport_get_state(const rdpMultitransport* multitransport);
 
-FREERDP_LOCAL rdpMultitransport* multitransport_new(void);
+FREERDP_LOCAL rdpMultitransport* multitransport_new(rdpRdp* rdp);
 FREERDP_LOCAL void multitransport_free(rdpMultitransport* multitransport);
 
 #endif /* FREERDP_LIB_CORE_MULTITRANSPORT_H */
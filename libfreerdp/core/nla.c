@@ -194,17 +194,14 @@ static BOOL nla_sec_buffer_alloc_from_buffer(SecBuffer* buffer, const SecBuffer*
 
 static BOOL nla_decode_to_buffer(wStream* s, SecBuffer* buffer)
 {
-	BOOL rc = FALSE;
 	size_t length;
+	const BYTE* data;
 	if (!s || !buffer)
 		return FALSE;
-	if (!ber_read_octet_string_tag(s, &length) || /* OCTET STRING */
-	    Stream_GetRemainingLength(s) < length)
+	if (!ber_read_octet_string_ref(s, &data, &length)) /* OCTET STRING */
 		return FALSE;
 
-	rc = nla_sec_buffer_alloc_from_data(buffer, Stream_Pointer(s), 0, length);
-	Stream_Seek(s, length);
-	return rc;
+	return nla_sec_buffer_alloc_from_data(buffer, data, 0, length);
 }
 
 static BOOL nla_set_package_name(rdpNla* nla, const TCHAR* name)
@@ -467,25 +464,17 @@ static SECURITY_STATUS nla_encrypt(rdpNla* nla, SecBuffer* buffer, size_t header
 	return status;
 }
 
-static size_t ber_sizeof_sequence_octet_string(size_t length)
+/* [context] OCTET STRING, the content is copied once straight into the stream */
+static BOOL nla_write_contextual_octet_string(wStream* s, BYTE context, const SecBuffer* buffer)
 {
-	size_t rc = ber_sizeof_contextual_tag(ber_sizeof_octet_string(length));
-	rc += ber_sizeof_octet_string(length);
-	return rc;
-}
+	size_t mark;
 
-static size_t ber_write_sequence_octet_string(wStream* stream, BYTE context, const BYTE* value,
-                                              size_t length)
-{
-	size_t rc = ber_write_contextual_tag(stream, context, ber_sizeof_octet_string(length), TRUE);
-	rc += ber_write_octet_string(stream, value, length);
-	return rc;
-}
+	if (!ber_write_contextual_begin(s, context, &mark) ||
+	    !Stream_EnsureRemainingCapacity(s, ber_sizeof_octet_string(buffer->cbBuffer)))
+		return FALSE;
 
-static size_t ber_write_sequence_octet_string_from_secbuffer(wStream* stream, BYTE context,
-                                                             const SecBuffer* buffer)
-{
-	return ber_write_sequence_octet_string(stream, context, buffer->pvBuffer, buffer->cbBuffer);
+	ber_write_octet_string(s, buffer->pvBuffer, buffer->cbBuffer);
+	return ber_write_end(s, mark);
 }
 
 /* CredSSP Client-To-Server Binding Hash\0 */
@@ -1613,10 +1602,10 @@ static int nla_server_authenticate(rdpNla* nla)
 
 			if (nla->status != SEC_E_OK)
 				goto fail;
-
-			rc = 1;
 		}
 
+		/* errors of this round jump to fail, SEC_I_CONTINUE_NEEDED continues the exchange */
+		rc = 1;
 	fail:
 		sspi_SecBufferFree(&inputBuffer);
 		sspi_SecBufferFree(&outputBuffer);
@@ -2201,93 +2190,22 @@ static SECURITY_STATUS nla_decrypt_ts_credentials(rdpNla* nla)
 	return SEC_E_OK;
 }
 
-static size_t nla_sizeof_nego_token(size_t length)
-{
-	length = ber_sizeof_octet_string(length);
-	length += ber_sizeof_contextual_tag(length);
-	return length;
-}
-
-static size_t nla_sizeof_nego_tokens(const SecBuffer* buffer)
-{
-	size_t length = buffer->cbBuffer;
-	if (length == 0)
-		return 0;
-	length = nla_sizeof_nego_token(length);
-	length += ber_sizeof_sequence_tag(length);
-	length += ber_sizeof_sequence_tag(length);
-	length += ber_sizeof_contextual_tag(length);
-	return length;
-}
-
-static size_t nla_sizeof_pub_key_auth(const SecBuffer* buffer)
-{
-	size_t length = buffer->cbBuffer;
-	if (length == 0)
-		return 0;
-	length = ber_sizeof_octet_string(length);
-	length += ber_sizeof_contextual_tag(length);
-	return length;
-}
-
-static size_t nla_sizeof_auth_info(const SecBuffer* buffer)
-{
-	size_t length = buffer->cbBuffer;
-	if (length == 0)
-		return 0;
-	length = ber_sizeof_octet_string(length);
-	length += ber_sizeof_contextual_tag(length);
-	return length;
-}
-
-static size_t nla_sizeof_client_nonce(const SecBuffer* buffer)
-{
-	size_t length = buffer->cbBuffer;
-	if (length == 0)
-		return 0;
-	length = ber_sizeof_octet_string(length);
-	length += ber_sizeof_contextual_tag(length);
-	return length;
-}
-
-static size_t nla_sizeof_ts_request(size_t length)
-{
-	length += ber_sizeof_integer(2);
-	length += ber_sizeof_contextual_tag(3);
-	return length;
-}
-
 static BOOL nla_client_write_nego_token(wStream* s, const SecBuffer* negoToken)
 {
-	const size_t nego_tokens_length = nla_sizeof_nego_tokens(negoToken);
-
-	if (Stream_GetRemainingCapacity(s) < nego_tokens_length)
-		return FALSE;
+	size_t negoData, negoDataSeq, negoDataItem;
 
-	if (nego_tokens_length > 0)
-	{
-		size_t length;
-
-		WLog_DBG(TAG, "   ----->> nego token");
-		length =
-		    ber_write_contextual_tag(s, 1,
-		                             ber_sizeof_sequence(ber_sizeof_sequence(
-		                                 ber_sizeof_sequence_octet_string(negoToken->cbBuffer))),
-		                             TRUE); /* NegoData */
-		length +=
-		    ber_write_sequence_tag(s, ber_sizeof_sequence(ber_sizeof_sequence_octet_string(
-		                                  negoToken->cbBuffer))); /* SEQUENCE OF NegoDataItem */
-		length += ber_write_sequence_tag(
-		    s, ber_sizeof_sequence_octet_string(negoToken->cbBuffer)); /* NegoDataItem */
-		length +=
-		    ber_write_sequence_octet_string_from_secbuffer(s, 0, negoToken); /* OCTET STRING */
-
-		if (length != nego_tokens_length)
-			return FALSE;
-	}
+	if (negoToken->cbBuffer == 0)
+		return TRUE;
 
-	return TRUE;
+	WLog_DBG(TAG, "   ----->> nego token");
+	return ber_write_contextual_begin(s, 1, &negoData) &&        /* NegoData */
+	       ber_write_sequence_begin(s, &negoDataSeq) &&          /* SEQUENCE OF NegoDataItem */
+	       ber_write_sequence_begin(s, &negoDataItem) &&         /* NegoDataItem */
+	       nla_write_contextual_octet_string(s, 0, negoToken) && /* OCTET STRING */
+	       ber_write_end(s, negoDataItem) && ber_write_end(s, negoDataSeq) &&
+	       ber_write_end(s, negoData);
 }
+
 /**
  * Send CredSSP message.
  * @param credssp
@@ -2297,25 +2215,12 @@ BOOL nla_send(rdpNla* nla)
 {
 	BOOL rc = FALSE;
 	wStream* s;
-	size_t length;
-	size_t ts_request_length;
-	size_t error_code_context_length = 0;
-	size_t error_code_length = 0;
-	const size_t nego_tokens_length = nla_sizeof_nego_tokens(&nla->negoToken);
-	const size_t pub_key_auth_length = nla_sizeof_pub_key_auth(&nla->pubKeyAuth);
-	const size_t auth_info_length = nla_sizeof_auth_info(&nla->authInfo);
-	const size_t client_nonce_length = nla_sizeof_client_nonce(&nla->ClientNonce);
+	size_t tsRequest, version;
+	/* the lengths are filled in as the elements are written, the tags fit in the slack */
+	const size_t capacity = nla->negoToken.cbBuffer + nla->pubKeyAuth.cbBuffer +
+	                        nla->authInfo.cbBuffer + nla->ClientNonce.cbBuffer + 128;
 
-	if (nla->peerVersion >= 3 && nla->peerVersion != 5 && nla->errorCode != 0)
-	{
-		error_code_length = ber_sizeof_integer(nla->errorCode);
-		error_code_context_length = ber_sizeof_contextual_tag(error_code_length);
-	}
-
-	length = nego_tokens_length + pub_key_auth_length + auth_info_length +
-	         error_code_context_length + error_code_length + client_nonce_length;
-	ts_request_length = nla_sizeof_ts_request(length);
-	s = Stream_New(NULL, ber_sizeof_sequence(ts_request_length));
+	s = Stream_New(NULL, capacity);
 
 	if (!s)
 	{
@@ -2325,54 +2230,63 @@ BOOL nla_send(rdpNla* nla)
 
 	WLog_DBG(TAG, "----->> sending...");
 	/* TSRequest */
-	ber_write_sequence_tag(s, ts_request_length); /* SEQUENCE */
-	/* [0] version */
-	ber_write_contextual_tag(s, 0, 3, TRUE);
+	if (!ber_write_sequence_begin(s, &tsRequest)) /* SEQUENCE */
+		goto fail;
 
+	/* [0] version */
 	WLog_DBG(TAG, "   ----->> protocol version %" PRIu32, nla->version);
+	if (!ber_write_contextual_begin(s, 0, &version) || !Stream_EnsureRemainingCapacity(s, 6))
+		goto fail;
 	ber_write_integer(s, nla->version); /* INTEGER */
+	if (!ber_write_end(s, version))
+		goto fail;
 
 	/* [1] negoTokens (NegoData) */
 	if (!nla_client_write_nego_token(s, &nla->negoToken))
 		goto fail;
 
 	/* [2] authInfo (OCTET STRING) */
-	if (auth_info_length > 0)
+	if (nla->authInfo.cbBuffer > 0)
 	{
 		WLog_DBG(TAG, "   ----->> auth info");
-		if (ber_write_sequence_octet_string_from_secbuffer(s, 2, &nla->authInfo) !=
-		    auth_info_length)
+		if (!nla_write_contextual_octet_string(s, 2, &nla->authInfo))
 			goto fail;
 	}
 
 	/* [3] pubKeyAuth (OCTET STRING) */
-	if (pub_key_auth_length > 0)
+	if (nla->pubKeyAuth.cbBuffer > 0)
 	{
 		WLog_DBG(TAG, "   ----->> public key auth");
-		if (ber_write_sequence_octet_string_from_secbuffer(s, 3, &nla->pubKeyAuth) !=
-		    pub_key_auth_length)
+		if (!nla_write_contextual_octet_string(s, 3, &nla->pubKeyAuth))
 			goto fail;
 	}
 
 	/* [4] errorCode (INTEGER) */
-	if (error_code_length > 0)
+	if (nla->peerVersion >= 3 && nla->peerVersion != 5 && nla->errorCode != 0)
 	{
+		size_t errorCode;
 		char buffer[1024];
 		WLog_DBG(TAG, "   ----->> error code %s 0x%08" PRIx32,
 		         winpr_strerror(nla->errorCode, buffer, sizeof(buffer)), nla->errorCode);
-		ber_write_contextual_tag(s, 4, error_code_length, TRUE);
+		if (!ber_write_contextual_begin(s, 4, &errorCode) || !Stream_EnsureRemainingCapacity(s, 6))
+			goto fail;
 		ber_write_integer(s, nla->errorCode);
+		if (!ber_write_end(s, errorCode))
+			goto fail;
 	}
 
 	/* [5] clientNonce (OCTET STRING) */
-	if (client_nonce_length > 0)
+	if (nla->ClientNonce.cbBuffer > 0)
 	{
 		WLog_DBG(TAG, "   ----->> client nonce");
-		if (ber_write_sequence_octet_string_from_secbuffer(s, 5, &nla->ClientNonce) !=
-		    client_nonce_length)
+		if (!nla_write_contextual_octet_string(s, 5, &nla->ClientNonce))
 			goto fail;
 	}
 
+	if (!ber_write_end(s, tsRequest))
+		goto fail;
+
+	Stream_SealLength(s);
 	WLog_DBG(TAG, "[%" PRIuz " bytes]", Stream_GetPosition(s));
 	if (transport_write(nla->transport, s) < 0)
 		goto fail;
@@ -795,7 +795,7 @@ static INLINE BOOL update_read_delta(wStream* s, INT32* value)
 {
 	BYTE byte;
 
-	if (Stream_GetRemainingLength(s) < 1)
+	if (!Stream_CheckRequiredLength(s, 1))
 	{
 		WLog_ERR(TAG, "Stream_GetRemainingLength(s) < 1");
 		return FALSE;
@@ -810,7 +810,7 @@ static INLINE BOOL update_read_delta(wStream* s, INT32* value)
 
 	if (byte & 0x80)
 	{
-		if (Stream_GetRemainingLength(s) < 1)
+		if (!Stream_CheckRequiredLength(s, 1))
 		{
 			WLog_ERR(TAG, "Stream_GetRemainingLength(s) < 1");
 			return FALSE;
@@ -3502,6 +3502,93 @@ static BOOL read_primary_order(wLog* log, const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static BOOL update_order_is_batched(rdpPrimaryUpdate* primary, UINT32 orderType)
+{
+	if (!primary->OrdersBatch)
+		return FALSE;
+
+	switch (orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+		case ORDER_TYPE_SCRBLT:
+		case ORDER_TYPE_OPAQUE_RECT:
+		case ORDER_TYPE_MEMBLT:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+BOOL update_flush_orders_batch(rdpUpdate* update)
+{
+	BOOL rc;
+	rdp_primary_update_internal* primary;
+
+	WINPR_ASSERT(update);
+	primary = primary_update_cast(update->primary);
+
+	if (primary->batch.count == 0)
+		return TRUE;
+
+	primary->batch.orderType = primary->batchOrderType;
+	primary->batch.index = primary->batchIndex;
+	primary->batch.hasBounds = primary->batchHasBounds;
+	primary->batch.bounds = primary->batchBounds;
+	primary->batch.dstblt = primary->batchDstblt;
+	primary->batch.scrblt = primary->batchScrblt;
+	primary->batch.opaqueRect = primary->batchOpaqueRect;
+	primary->batch.memblt = primary->batchMemblt;
+
+	rc = IFCALLRESULT(TRUE, primary->common.OrdersBatch, update->context, &primary->batch);
+
+	primary->batch.count = 0;
+	primary->batchDstbltCount = 0;
+	primary->batchScrbltCount = 0;
+	primary->batchOpaqueRectCount = 0;
+	primary->batchMembltCount = 0;
+	return rc;
+}
+
+static BOOL update_batch_primary_order(rdpUpdate* update, const ORDER_INFO* orderInfo,
+                                       BOOL hasBounds)
+{
+	UINT32 n;
+	UINT32 index;
+	rdp_primary_update_internal* primary = primary_update_cast(update->primary);
+
+	if ((primary->batch.count == ORDERS_BATCH_MAX) && !update_flush_orders_batch(update))
+		return FALSE;
+
+	switch (orderInfo->orderType)
+	{
+		case ORDER_TYPE_DSTBLT:
+			index = primary->batchDstbltCount++;
+			primary->batchDstblt[index] = primary->dstblt;
+			break;
+		case ORDER_TYPE_SCRBLT:
+			index = primary->batchScrbltCount++;
+			primary->batchScrblt[index] = primary->scrblt;
+			break;
+		case ORDER_TYPE_OPAQUE_RECT:
+			index = primary->batchOpaqueRectCount++;
+			primary->batchOpaqueRect[index] = primary->opaque_rect;
+			break;
+		case ORDER_TYPE_MEMBLT:
+			index = primary->batchMembltCount++;
+			primary->batchMemblt[index] = primary->memblt;
+			break;
+		default:
+			return FALSE;
+	}
+
+	n = primary->batch.count++;
+	primary->batchOrderType[n] = orderInfo->orderType;
+	primary->batchIndex[n] = index;
+	primary->batchHasBounds[n] = hasBounds;
+	primary->batchBounds[n] = orderInfo->bounds;
+	return TRUE;
+}
+
 static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 {
 	BYTE field;
@@ -3513,6 +3600,7 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 	rdpSettings* settings;
 	const char* orderName;
 	BOOL defaultReturn;
+	BOOL batched;
 
 	WINPR_ASSERT(s);
 
@@ -3542,6 +3630,11 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 	if (!check_primary_order_supported(up->log, settings, orderInfo->orderType, orderName))
 		return FALSE;
 
+	/* orders outside of a batch must not overtake the ones collected so far */
+	batched = update_order_is_batched(&primary->common, orderInfo->orderType);
+	if (!batched && !update_flush_orders_batch(update))
+		return FALSE;
+
 	field = get_primary_drawing_order_field_bytes(orderInfo->orderType, &rc);
 	if (!rc)
 		return FALSE;
@@ -3563,10 +3656,13 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 			}
 		}
 
-		rc = IFCALLRESULT(defaultReturn, update->SetBounds, context, &orderInfo->bounds);
+		if (!batched)
+		{
+			rc = IFCALLRESULT(defaultReturn, update->SetBounds, context, &orderInfo->bounds);
 
-		if (!rc)
-			return FALSE;
+			if (!rc)
+				return FALSE;
+		}
 	}
 
 	orderInfo->deltaCoordinates = (flags & ORDER_DELTA_COORDINATES) ? TRUE : FALSE;
@@ -3578,6 +3674,9 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 	if (!rc)
 		return FALSE;
 
+	if (batched)
+		return update_batch_primary_order(update, orderInfo, (flags & ORDER_BOUNDS) != 0);
+
 	switch (orderInfo->orderType)
 	{
 		case ORDER_TYPE_DSTBLT:
@@ -4164,6 +4263,11 @@ BOOL update_recv_order(rdpUpdate* update, wStream* s)
 
 	Stream_Read_UINT8(s, controlFlags); /* controlFlags (1 byte) */
 
+	/* secondary and alternate secondary orders may change what batched orders refer to */
+	if (((controlFlags & ORDER_SECONDARY) || !(controlFlags & ORDER_STANDARD)) &&
+	    !update_flush_orders_batch(update))
+		return FALSE;
+
 	if (!(controlFlags & ORDER_STANDARD))
 		rc = update_recv_altsec_order(update, s, controlFlags);
 	else if (controlFlags & ORDER_SECONDARY)
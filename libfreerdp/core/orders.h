@@ -192,6 +192,7 @@
 FREERDP_LOCAL BYTE get_primary_drawing_order_field_bytes(UINT32 orderType, BOOL* pValid);
 
 FREERDP_LOCAL BOOL update_recv_order(rdpUpdate* update, wStream* s);
+FREERDP_LOCAL BOOL update_flush_orders_batch(rdpUpdate* update);
 
 FREERDP_LOCAL BOOL update_write_field_flags(wStream* s, UINT32 fieldFlags, BYTE flags,
                                             BYTE fieldBytes);
@@ -23,6 +23,10 @@
 #include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/winsock.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/collections.h>
 
 #include "info.h"
 #include "certificate.h"
@@ -376,6 +380,7 @@ static BOOL peer_recv_data_pdu(freerdp_peer* client, wStream* s, UINT16 totalLen
 				return FALSE;
 
 			Stream_Read_UINT32(s, client->ack_frame_id);
+			metrics_frame_acknowledged(client->context->metrics, client->ack_frame_id);
 			IFCALL(client->update->SurfaceFrameAcknowledge, client->update->context,
 			       client->ack_frame_id);
 			break;
@@ -1043,3 +1048,425 @@ void freerdp_peer_free(freerdp_peer* client)
 	closesocket((SOCKET)client->sockfd);
 	free(client);
 }
+
+#define PEER_REACTOR_MAX_HANDLES 32
+#define PEER_REACTOR_MAX_EVENTS 64
+
+typedef struct
+{
+	freerdp_peer* peer;
+	UINT64 generation;
+	DWORD count;
+	HANDLE handles[PEER_REACTOR_MAX_HANDLES];
+} rdpPeerReactorClient;
+
+/* Each peer is owned by a single worker, so its callbacks never run concurrently.
+ * handles and owners mirror the wait set: the n-th handle of the set belongs to owners[n],
+ * the stop event and the pending queue come first and have no owner. */
+typedef struct
+{
+	freerdp_peer_reactor* reactor;
+	HANDLE thread;
+	wQueue* pending;
+	WINPR_WAIT_SET* set;
+	HANDLE* handles;
+	rdpPeerReactorClient** owners;
+	DWORD count;
+	DWORD capacity;
+	UINT64 generation;
+	volatile LONG load;
+} rdpPeerReactorWorker;
+
+struct rdp_freerdp_peer_reactor
+{
+	HANDLE stopEvent;
+	DWORD count;
+	rdpPeerReactorWorker* workers;
+};
+
+static void peer_reactor_release_peer(freerdp_peer* peer)
+{
+	WINPR_ASSERT(peer);
+
+	if (peer->ReactorRemoved)
+	{
+		peer->ReactorRemoved(peer);
+		return;
+	}
+
+	WINPR_ASSERT(peer->Disconnect);
+	peer->Disconnect(peer);
+	freerdp_peer_context_free(peer);
+	freerdp_peer_free(peer);
+}
+
+static BOOL peer_reactor_worker_add_handle(rdpPeerReactorWorker* worker, HANDLE handle,
+                                           rdpPeerReactorClient* owner)
+{
+	WINPR_ASSERT(worker);
+
+	if (worker->count == worker->capacity)
+	{
+		const DWORD capacity = MAX(16, worker->capacity * 2);
+		HANDLE* handles = realloc(worker->handles, capacity * sizeof(HANDLE));
+		rdpPeerReactorClient** owners;
+
+		if (!handles)
+			return FALSE;
+		worker->handles = handles;
+
+		owners = realloc(worker->owners, capacity * sizeof(rdpPeerReactorClient*));
+		if (!owners)
+			return FALSE;
+		worker->owners = owners;
+		worker->capacity = capacity;
+	}
+
+	if (!winpr_WaitSetAdd(worker->set, handle))
+		return FALSE;
+
+	worker->handles[worker->count] = handle;
+	worker->owners[worker->count] = owner;
+	worker->count++;
+	return TRUE;
+}
+
+static void peer_reactor_worker_remove_handle(rdpPeerReactorWorker* worker, HANDLE handle,
+                                              const rdpPeerReactorClient* owner)
+{
+	DWORD first;
+	DWORD index;
+
+	WINPR_ASSERT(worker);
+
+	for (first = 0; first < worker->count; first++)
+	{
+		if (worker->handles[first] == handle)
+			break;
+	}
+
+	if (first == worker->count)
+		return;
+
+	/* The wait set drops the first copy of a handle shared by several peers, hand its owner
+	 * over to the copy being removed to keep both in sync */
+	for (index = first; index < worker->count; index++)
+	{
+		if ((worker->handles[index] == handle) && (worker->owners[index] == owner))
+		{
+			worker->owners[index] = worker->owners[first];
+			break;
+		}
+	}
+
+	winpr_WaitSetRemove(worker->set, handle);
+	MoveMemory(&worker->handles[first], &worker->handles[first + 1],
+	           (worker->count - first - 1) * sizeof(HANDLE));
+	MoveMemory(&worker->owners[first], &worker->owners[first + 1],
+	           (worker->count - first - 1) * sizeof(rdpPeerReactorClient*));
+	worker->count--;
+}
+
+static DWORD peer_reactor_get_event_handles(freerdp_peer* peer, HANDLE* handles, DWORD count)
+{
+	DWORD nCount;
+
+	WINPR_ASSERT(peer);
+	WINPR_ASSERT(peer->GetEventHandles);
+
+	nCount = peer->GetEventHandles(peer, handles, count);
+	if (nCount == 0)
+	{
+		WLog_ERR(TAG, "Failed to get FreeRDP transport event handles");
+		return 0;
+	}
+
+	if (peer->ReactorGetEventHandles)
+	{
+		const DWORD tmp = peer->ReactorGetEventHandles(peer, &handles[nCount], count - nCount);
+
+		if (tmp == 0)
+		{
+			WLog_ERR(TAG, "Failed to get peer event handles");
+			return 0;
+		}
+
+		nCount += tmp;
+	}
+
+	return nCount;
+}
+
+static void peer_reactor_worker_detach(rdpPeerReactorWorker* worker, rdpPeerReactorClient* client)
+{
+	DWORD index;
+
+	WINPR_ASSERT(client);
+
+	for (index = 0; index < client->count; index++)
+		peer_reactor_worker_remove_handle(worker, client->handles[index], client);
+
+	client->count = 0;
+}
+
+static BOOL peer_reactor_worker_attach(rdpPeerReactorWorker* worker, rdpPeerReactorClient* client)
+{
+	DWORD index;
+
+	WINPR_ASSERT(client);
+
+	for (index = 0; index < client->count; index++)
+	{
+		if (!peer_reactor_worker_add_handle(worker, client->handles[index], client))
+		{
+			client->count = index;
+			peer_reactor_worker_detach(worker, client);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The transport handles change with the security layer, register the current ones */
+static BOOL peer_reactor_worker_update(rdpPeerReactorWorker* worker, rdpPeerReactorClient* client)
+{
+	HANDLE handles[PEER_REACTOR_MAX_HANDLES] = { 0 };
+	const DWORD count = peer_reactor_get_event_handles(client->peer, handles, ARRAYSIZE(handles));
+
+	if (count == 0)
+		return FALSE;
+
+	if ((count == client->count) && (memcmp(handles, client->handles, count * sizeof(HANDLE)) == 0))
+		return TRUE;
+
+	peer_reactor_worker_detach(worker, client);
+	memcpy(client->handles, handles, count * sizeof(HANDLE));
+	client->count = count;
+	return peer_reactor_worker_attach(worker, client);
+}
+
+static void peer_reactor_worker_remove(rdpPeerReactorWorker* worker, rdpPeerReactorClient* client)
+{
+	freerdp_peer* peer;
+
+	WINPR_ASSERT(worker);
+	WINPR_ASSERT(client);
+
+	peer = client->peer;
+	peer_reactor_worker_detach(worker, client);
+	free(client);
+	InterlockedDecrement(&worker->load);
+	peer_reactor_release_peer(peer);
+}
+
+static void peer_reactor_worker_add(rdpPeerReactorWorker* worker, freerdp_peer* peer)
+{
+	rdpPeerReactorClient* client = calloc(1, sizeof(rdpPeerReactorClient));
+
+	if (!client)
+	{
+		InterlockedDecrement(&worker->load);
+		peer_reactor_release_peer(peer);
+		return;
+	}
+
+	client->peer = peer;
+
+	if (!peer_reactor_worker_update(worker, client))
+		peer_reactor_worker_remove(worker, client);
+}
+
+static void peer_reactor_worker_service(rdpPeerReactorWorker* worker, rdpPeerReactorClient* client)
+{
+	BOOL rc;
+	freerdp_peer* peer = client->peer;
+
+	WINPR_ASSERT(peer);
+	WINPR_ASSERT(peer->CheckFileDescriptor);
+
+	rc = peer->CheckFileDescriptor(peer);
+
+	if (rc && peer->ReactorCheckEvents)
+		rc = peer->ReactorCheckEvents(peer);
+
+	if (rc)
+		rc = peer_reactor_worker_update(worker, client);
+
+	if (!rc)
+		peer_reactor_worker_remove(worker, client);
+}
+
+static DWORD WINAPI peer_reactor_worker_thread(LPVOID arg)
+{
+	rdpPeerReactorWorker* worker = (rdpPeerReactorWorker*)arg;
+	DWORD indices[PEER_REACTOR_MAX_EVENTS] = { 0 };
+	rdpPeerReactorClient* ready[PEER_REACTOR_MAX_EVENTS] = { 0 };
+	freerdp_peer* peer;
+
+	WINPR_ASSERT(worker);
+
+	while (1)
+	{
+		DWORD index;
+		DWORD signaled = 0;
+		DWORD nready = 0;
+		const DWORD status =
+		    winpr_WaitSetWaitEx(worker->set, INFINITE, indices, ARRAYSIZE(indices), &signaled);
+
+		if (status != WAIT_OBJECT_0)
+		{
+			WLog_ERR(TAG, "peer reactor wait failed with 0x%08" PRIx32, status);
+			break;
+		}
+
+		/* collect first, servicing a peer may remove handles and shift the indices */
+		worker->generation++;
+
+		for (index = 0; index < signaled; index++)
+		{
+			rdpPeerReactorClient* client = worker->owners[indices[index]];
+
+			if (indices[index] == 0)
+				goto out;
+
+			if (!client)
+			{
+				while ((peer = Queue_Dequeue(worker->pending)))
+					peer_reactor_worker_add(worker, peer);
+			}
+			else if (client->generation != worker->generation)
+			{
+				client->generation = worker->generation;
+				ready[nready++] = client;
+			}
+		}
+
+		for (index = 0; index < nready; index++)
+			peer_reactor_worker_service(worker, ready[index]);
+	}
+
+out:
+	while (worker->count > 2)
+		peer_reactor_worker_remove(worker, worker->owners[worker->count - 1]);
+
+	while ((peer = Queue_Dequeue(worker->pending)))
+	{
+		InterlockedDecrement(&worker->load);
+		peer_reactor_release_peer(peer);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+freerdp_peer_reactor* freerdp_peer_reactor_new(DWORD workers)
+{
+	DWORD index;
+	freerdp_peer_reactor* reactor = calloc(1, sizeof(freerdp_peer_reactor));
+
+	if (!reactor)
+		return NULL;
+
+	if (workers == 0)
+	{
+		SYSTEM_INFO sysinfo;
+		GetNativeSystemInfo(&sysinfo);
+		workers = MAX(1, sysinfo.dwNumberOfProcessors);
+	}
+
+	reactor->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	reactor->workers = calloc(workers, sizeof(rdpPeerReactorWorker));
+
+	if (!reactor->stopEvent || !reactor->workers)
+		goto fail;
+
+	for (index = 0; index < workers; index++)
+	{
+		rdpPeerReactorWorker* worker = &reactor->workers[index];
+
+		worker->reactor = reactor;
+		worker->pending = Queue_New(TRUE, -1, -1);
+		worker->set = winpr_WaitSetNew();
+		reactor->count++;
+
+		if (!worker->pending || !worker->set)
+			goto fail;
+
+		if (!peer_reactor_worker_add_handle(worker, reactor->stopEvent, NULL) ||
+		    !peer_reactor_worker_add_handle(worker, Queue_Event(worker->pending), NULL))
+			goto fail;
+
+		worker->thread = CreateThread(NULL, 0, peer_reactor_worker_thread, worker, 0, NULL);
+		if (!worker->thread)
+			goto fail;
+	}
+
+	return reactor;
+
+fail:
+	WLog_ERR(TAG, "failed to create peer reactor with %" PRIu32 " workers", workers);
+	freerdp_peer_reactor_free(reactor);
+	return NULL;
+}
+
+void freerdp_peer_reactor_free(freerdp_peer_reactor* reactor)
+{
+	DWORD index;
+
+	if (!reactor)
+		return;
+
+	if (reactor->stopEvent)
+		SetEvent(reactor->stopEvent);
+
+	for (index = 0; index < reactor->count; index++)
+	{
+		rdpPeerReactorWorker* worker = &reactor->workers[index];
+
+		if (worker->thread)
+		{
+			WaitForSingleObject(worker->thread, INFINITE);
+			CloseHandle(worker->thread);
+		}
+
+		winpr_WaitSetFree(worker->set);
+		Queue_Free(worker->pending);
+		free(worker->handles);
+		free(worker->owners);
+	}
+
+	free(reactor->workers);
+
+	if (reactor->stopEvent)
+		CloseHandle(reactor->stopEvent);
+
+	free(reactor);
+}
+
+BOOL freerdp_peer_reactor_add(freerdp_peer_reactor* reactor, freerdp_peer* peer)
+{
+	DWORD index;
+	rdpPeerReactorWorker* worker;
+
+	if (!reactor || !peer || !peer->context)
+		return FALSE;
+
+	worker = &reactor->workers[0];
+
+	for (index = 1; index < reactor->count; index++)
+	{
+		if (reactor->workers[index].load < worker->load)
+			worker = &reactor->workers[index];
+	}
+
+	InterlockedIncrement(&worker->load);
+
+	if (!Queue_Enqueue(worker->pending, peer))
+	{
+		InterlockedDecrement(&worker->load);
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -1131,6 +1131,12 @@ int rdp_recv_message_channel_pdu(rdpRdp* rdp, wStream* s, UINT16 securityFlags)
 		return rdp_recv_multitransport_packet(rdp, s);
 	}
 
+	if (securityFlags & SEC_TRANSPORT_RSP)
+	{
+		/* Initiate Multitransport Response PDU */
+		return rdp_recv_multitransport_response(rdp, s);
+	}
+
 	return -1;
 }
 
@@ -1521,6 +1527,10 @@ int rdp_recv_callback(rdpTransport* transport, wStream* s, void* extra)
 			return 0;
 	}
 
+	/* Continuous bandwidth detection measures all traffic between start and stop */
+	if (rdp->autodetect && rdp->autodetect->bandwidthMeasureStarted)
+		rdp->autodetect->bandwidthMeasureByteCount += (UINT32)Stream_Length(s);
+
 	switch (rdp_get_state(rdp))
 	{
 		case CONNECTION_STATE_NLA:
@@ -1877,7 +1887,7 @@ rdpRdp* rdp_new(rdpContext* context)
 	if (!rdp->heartbeat)
 		goto fail;
 
-	rdp->multitransport = multitransport_new();
+	rdp->multitransport = multitransport_new(rdp);
 
 	if (!rdp->multitransport)
 		goto fail;
@@ -1901,11 +1911,17 @@ static void rdp_reset_free(rdpRdp* rdp)
 	winpr_RC4_Free(rdp->rc4_encrypt_key);
 	winpr_Cipher_Free(rdp->fips_encrypt);
 	winpr_Cipher_Free(rdp->fips_decrypt);
+	winpr_Digest_Free(rdp->mac_sha1);
+	winpr_Digest_Free(rdp->mac_md5);
+	winpr_HMAC_Free(rdp->fips_hmac);
 
 	rdp->rc4_decrypt_key = NULL;
 	rdp->rc4_encrypt_key = NULL;
 	rdp->fips_encrypt = NULL;
 	rdp->fips_decrypt = NULL;
+	rdp->mac_sha1 = NULL;
+	rdp->mac_md5 = NULL;
+	rdp->fips_hmac = NULL;
 
 	mcs_free(rdp->mcs);
 	nego_free(rdp->nego);
@@ -2001,6 +2017,8 @@ void rdp_free(rdpRdp* rdp)
 	{
 		DeleteCriticalSection(&rdp->critical);
 		rdp_reset_free(rdp);
+		SSL_SESSION_free(rdp->tlsSession);
+		rdg_free(rdp->gatewayTunnel);
 
 		freerdp_settings_free(rdp->settings);
 
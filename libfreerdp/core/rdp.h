@@ -155,6 +155,9 @@ struct rdp_rdp
 	int encrypt_checksum_use_count;
 	WINPR_CIPHER_CTX* fips_encrypt;
 	WINPR_CIPHER_CTX* fips_decrypt;
+	WINPR_DIGEST_CTX* mac_sha1; /* reused for every PDU, guarded by critical */
+	WINPR_DIGEST_CTX* mac_md5;
+	WINPR_HMAC_CTX* fips_hmac;
 	UINT32 sec_flags;
 	BOOL do_crypt;
 	BOOL do_crypt_license;
@@ -179,6 +182,18 @@ struct rdp_rdp
 	UINT64 outPackets;
 	CRITICAL_SECTION critical;
 	rdpTransportIo* io;
+
+	/* connection startup timing in milliseconds, see rdp_set_state */
+	UINT64 stateStart;
+	UINT64 connectStart;
+	volatile LONGLONG firstUpdate;
+	UINT64 stateDuration[CONNECTION_STATE_ACTIVE + 1];
+
+	/* client TLS session kept across transport resets to resume on reconnect */
+	SSL_SESSION* tlsSession;
+
+	/* authorized RD Gateway tunnel kept across transport resets, see rdg_release_channel */
+	rdpRdg* gatewayTunnel;
 };
 
 FREERDP_LOCAL BOOL rdp_read_security_header(wStream* s, UINT16* flags, UINT16* length);
@@ -23,6 +23,7 @@
 #include "security.h"
 
 #include <freerdp/log.h>
+#include <winpr/assert.h>
 #include <winpr/crypto.h>
 
 #define TAG FREERDP_TAG("core")
@@ -323,78 +324,96 @@ out:
 	return result;
 }
 
-BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BYTE* output)
+/* The digest contexts live as long as the connection, the caller holds rdp->critical */
+static BOOL security_get_mac_digests(rdpRdp* rdp, WINPR_DIGEST_CTX** sha1, WINPR_DIGEST_CTX** md5)
+{
+	WINPR_ASSERT(rdp);
+
+	if (!rdp->mac_sha1)
+		rdp->mac_sha1 = winpr_Digest_New();
+
+	if (!rdp->mac_md5)
+		rdp->mac_md5 = winpr_Digest_New();
+
+	*sha1 = rdp->mac_sha1;
+	*md5 = rdp->mac_md5;
+	return rdp->mac_sha1 && rdp->mac_md5;
+}
+
+/* The salted variant appends the encryption count, use_count_le is NULL otherwise */
+static BOOL security_mac_signature_locked(rdpRdp* rdp, const BYTE* data, UINT32 length,
+                                          const BYTE* use_count_le, BYTE* output)
 {
 	WINPR_DIGEST_CTX* sha1 = NULL;
 	WINPR_DIGEST_CTX* md5 = NULL;
 	BYTE length_le[4];
 	BYTE md5_digest[WINPR_MD5_DIGEST_LENGTH];
 	BYTE sha1_digest[WINPR_SHA1_DIGEST_LENGTH];
-	BOOL result = FALSE;
+
 	security_UINT32_le(length_le, length); /* length must be little-endian */
 
-	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	if (!(sha1 = winpr_Digest_New()))
-		goto out;
+	if (!security_get_mac_digests(rdp, &sha1, &md5))
+		return FALSE;
 
+	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
 	if (!winpr_Digest_Init(sha1, WINPR_MD_SHA1))
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, pad1, sizeof(pad1))) /* pad1 */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, length_le, sizeof(length_le))) /* length */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, data, length)) /* data */
-		goto out;
+		return FALSE;
+
+	if (use_count_le && !winpr_Digest_Update(sha1, use_count_le, 4)) /* encryptionCount */
+		return FALSE;
 
 	if (!winpr_Digest_Final(sha1, sha1_digest, sizeof(sha1_digest)))
-		goto out;
+		return FALSE;
 
 	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	if (!(md5 = winpr_Digest_New()))
-		goto out;
-
 	if (!winpr_Digest_Init(md5, WINPR_MD_MD5))
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, pad2, sizeof(pad2))) /* pad2 */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, sha1_digest, sizeof(sha1_digest))) /* SHA1_Digest */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Final(md5, md5_digest, sizeof(md5_digest)))
-		goto out;
+		return FALSE;
 
 	memcpy(output, md5_digest, 8);
-	result = TRUE;
-out:
-	winpr_Digest_Free(sha1);
-	winpr_Digest_Free(md5);
+	return TRUE;
+}
+
+BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BYTE* output)
+{
+	BOOL result;
+
+	EnterCriticalSection(&rdp->critical);
+	result = security_mac_signature_locked(rdp, data, length, NULL, output);
+	LeaveCriticalSection(&rdp->critical);
 	return result;
 }
 
 BOOL security_salted_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BOOL encryption,
                                    BYTE* output)
 {
-	WINPR_DIGEST_CTX* sha1 = NULL;
-	WINPR_DIGEST_CTX* md5 = NULL;
-	BYTE length_le[4];
 	BYTE use_count_le[4];
-	BYTE md5_digest[WINPR_MD5_DIGEST_LENGTH];
-	BYTE sha1_digest[WINPR_SHA1_DIGEST_LENGTH];
-	BOOL result = FALSE;
+	BOOL result;
 
 	EnterCriticalSection(&rdp->critical);
-	security_UINT32_le(length_le, length); /* length must be little-endian */
 
 	if (encryption)
 	{
@@ -409,56 +428,8 @@ BOOL security_salted_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length,
 		security_UINT32_le(use_count_le, rdp->decrypt_checksum_use_count - 1);
 	}
 
-	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	if (!(sha1 = winpr_Digest_New()))
-		goto out;
-
-	if (!winpr_Digest_Init(sha1, WINPR_MD_SHA1))
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, pad1, sizeof(pad1))) /* pad1 */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, length_le, sizeof(length_le))) /* length */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, data, length)) /* data */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, use_count_le, sizeof(use_count_le))) /* encryptionCount */
-		goto out;
-
-	if (!winpr_Digest_Final(sha1, sha1_digest, sizeof(sha1_digest)))
-		goto out;
-
-	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	if (!(md5 = winpr_Digest_New()))
-		goto out;
-
-	if (!winpr_Digest_Init(md5, WINPR_MD_MD5))
-		goto out;
-
-	if (!winpr_Digest_Update(md5, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
-
-	if (!winpr_Digest_Update(md5, pad2, sizeof(pad2))) /* pad2 */
-		goto out;
-
-	if (!winpr_Digest_Update(md5, sha1_digest, sizeof(sha1_digest))) /* SHA1_Digest */
-		goto out;
-
-	if (!winpr_Digest_Final(md5, md5_digest, sizeof(md5_digest)))
-		goto out;
-
-	memcpy(output, md5_digest, 8);
-	result = TRUE;
-out:
+	result = security_mac_signature_locked(rdp, data, length, use_count_le, output);
 	LeaveCriticalSection(&rdp->critical);
-	winpr_Digest_Free(sha1);
-	winpr_Digest_Free(md5);
 	return result;
 }
 
@@ -658,7 +629,8 @@ static BOOL security_key_update(BYTE* key, BYTE* update_key, size_t key_len, rdp
 	BOOL result = FALSE;
 	WLog_DBG(TAG, "updating RDP key");
 
-	if (!(sha1 = winpr_Digest_New()))
+	/* called from security_encrypt/decrypt with rdp->critical held */
+	if (!security_get_mac_digests(rdp, &sha1, &md5))
 		goto out;
 
 	if (!winpr_Digest_Init(sha1, WINPR_MD_SHA1))
@@ -676,9 +648,6 @@ static BOOL security_key_update(BYTE* key, BYTE* update_key, size_t key_len, rdp
 	if (!winpr_Digest_Final(sha1, sha1h, sizeof(sha1h)))
 		goto out;
 
-	if (!(md5 = winpr_Digest_New()))
-		goto out;
-
 	if (!winpr_Digest_Init(md5, WINPR_MD_MD5))
 		goto out;
 
@@ -707,8 +676,6 @@ static BOOL security_key_update(BYTE* key, BYTE* update_key, size_t key_len, rdp
 
 	result = TRUE;
 out:
-	winpr_Digest_Free(sha1);
-	winpr_Digest_Free(md5);
 	winpr_RC4_Free(rc4);
 	return result;
 }
@@ -774,35 +741,42 @@ fail:
 	return rc;
 }
 
+/* HMAC-SHA1 over data and the use count, the caller holds rdp->critical */
+static BOOL security_fips_hmac_locked(rdpRdp* rdp, const BYTE* data, size_t length,
+                                      const BYTE* use_count_le, BYTE* output)
+{
+	WINPR_ASSERT(rdp);
+
+	if (!rdp->fips_hmac && !(rdp->fips_hmac = winpr_HMAC_New()))
+		return FALSE;
+
+	if (!winpr_HMAC_Init(rdp->fips_hmac, WINPR_MD_SHA1, rdp->fips_sign_key,
+	                     WINPR_SHA1_DIGEST_LENGTH))
+		return FALSE;
+
+	if (!winpr_HMAC_Update(rdp->fips_hmac, data, length))
+		return FALSE;
+
+	if (!winpr_HMAC_Update(rdp->fips_hmac, use_count_le, 4))
+		return FALSE;
+
+	return winpr_HMAC_Final(rdp->fips_hmac, output, WINPR_SHA1_DIGEST_LENGTH);
+}
+
 BOOL security_hmac_signature(const BYTE* data, size_t length, BYTE* output, rdpRdp* rdp)
 {
 	BYTE buf[WINPR_SHA1_DIGEST_LENGTH];
 	BYTE use_count_le[4];
-	WINPR_HMAC_CTX* hmac;
-	BOOL result = FALSE;
+	BOOL result;
+
 	EnterCriticalSection(&rdp->critical);
 	security_UINT32_le(use_count_le, rdp->encrypt_use_count);
+	result = security_fips_hmac_locked(rdp, data, length, use_count_le, buf);
 	LeaveCriticalSection(&rdp->critical);
 
-	if (!(hmac = winpr_HMAC_New()))
-		return FALSE;
-
-	if (!winpr_HMAC_Init(hmac, WINPR_MD_SHA1, rdp->fips_sign_key, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, data, length))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, use_count_le, 4))
-		goto out;
+	if (result)
+		memmove(output, buf, 8);
 
-	if (!winpr_HMAC_Final(hmac, buf, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
-
-	memmove(output, buf, 8);
-	result = TRUE;
-out:
-	winpr_HMAC_Free(hmac);
 	return result;
 }
 
@@ -839,31 +813,15 @@ BOOL security_fips_check_signature(const BYTE* data, size_t length, const BYTE*
 {
 	BYTE buf[WINPR_SHA1_DIGEST_LENGTH];
 	BYTE use_count_le[4];
-	WINPR_HMAC_CTX* hmac;
-	BOOL result = FALSE;
+	BOOL result;
+
 	EnterCriticalSection(&rdp->critical);
 	security_UINT32_le(use_count_le, rdp->decrypt_use_count++);
+	result = security_fips_hmac_locked(rdp, data, length, use_count_le, buf);
 	LeaveCriticalSection(&rdp->critical);
 
-	if (!(hmac = winpr_HMAC_New()))
-		return FALSE;
+	if (result && (memcmp(sig, buf, 8) != 0))
+		result = FALSE;
 
-	if (!winpr_HMAC_Init(hmac, WINPR_MD_SHA1, rdp->fips_sign_key, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, data, length))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, use_count_le, 4))
-		goto out;
-
-	if (!winpr_HMAC_Final(hmac, buf, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
-
-	if (!memcmp(sig, buf, 8))
-		result = TRUE;
-
-out:
-	winpr_HMAC_Free(hmac);
 	return result;
 }
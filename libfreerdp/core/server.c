@@ -48,14 +48,6 @@
 	} while (0)
 #endif
 
-typedef struct
-{
-	UINT16 channelId;
-	UINT16 reserved;
-	UINT32 length;
-	UINT32 offset;
-} wtsChannelMessage;
-
 static DWORD g_SessionId = 1;
 static wHashTable* g_ServerHandles = NULL;
 
@@ -86,23 +78,47 @@ static rdpPeerChannel* wts_get_dvc_channel_by_id(WTSVirtualChannelManager* vcm,
 	return found ? channel : NULL;
 }
 
-static BOOL wts_queue_receive_data(rdpPeerChannel* channel, const BYTE* Buffer, UINT32 Length)
+static wtsChannelMessage* wts_channel_message_new(rdpPeerChannel* channel, UINT32 Length)
 {
-	BYTE* buffer;
 	wtsChannelMessage* messageCtx;
 
 	WINPR_ASSERT(channel);
 	messageCtx = (wtsChannelMessage*)malloc(sizeof(wtsChannelMessage) + Length);
 
 	if (!messageCtx)
-		return FALSE;
+		return NULL;
 
 	messageCtx->channelId = channel->channelId;
 	messageCtx->length = Length;
 	messageCtx->offset = 0;
+	return messageCtx;
+}
+
+static BOOL wts_queue_message(rdpPeerChannel* channel, wtsChannelMessage* messageCtx)
+{
+	WINPR_ASSERT(channel);
+	WINPR_ASSERT(messageCtx);
+
+	if (!MessageQueue_Post(channel->queue, messageCtx, 0, NULL, NULL))
+	{
+		free(messageCtx);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL wts_queue_receive_data(rdpPeerChannel* channel, const BYTE* Buffer, UINT32 Length)
+{
+	BYTE* buffer;
+	wtsChannelMessage* messageCtx = wts_channel_message_new(channel, Length);
+
+	if (!messageCtx)
+		return FALSE;
+
 	buffer = (BYTE*)(messageCtx + 1);
 	CopyMemory(buffer, Buffer, Length);
-	return MessageQueue_Post(channel->queue, messageCtx, 0, NULL, NULL);
+	return wts_queue_message(channel, messageCtx);
 }
 
 static BOOL wts_queue_send_item(rdpPeerChannel* channel, BYTE* Buffer, UINT32 Length)
@@ -198,49 +214,67 @@ static BOOL wts_read_drdynvc_data_first(rdpPeerChannel* channel, wStream* s, int
                                         UINT32 length)
 {
 	int value;
+	UINT32 totalLength;
+	wtsChannelMessage* messageCtx;
+
 	WINPR_ASSERT(channel);
 	WINPR_ASSERT(s);
-	value = wts_read_variable_uint(s, cbLen, &channel->dvc_total_length);
+	value = wts_read_variable_uint(s, cbLen, &totalLength);
 
 	if (value == 0)
 		return FALSE;
 
 	length -= value;
 
-	if (length > channel->dvc_total_length)
+	if (length > totalLength)
 		return FALSE;
 
-	Stream_SetPosition(channel->receiveData, 0);
+	free(channel->dvc_message);
+	channel->dvc_message = NULL;
 
-	if (!Stream_EnsureRemainingCapacity(channel->receiveData, channel->dvc_total_length))
+	if (length == totalLength)
+		return wts_queue_receive_data(channel, Stream_Pointer(s), length);
+
+	/* The fragments are reassembled in the message handed to the reader, offset is the
+	 * number of bytes received until it is queued */
+	messageCtx = wts_channel_message_new(channel, totalLength);
+
+	if (!messageCtx)
 		return FALSE;
 
-	Stream_Write(channel->receiveData, Stream_Pointer(s), length);
+	CopyMemory(messageCtx + 1, Stream_Pointer(s), length);
+	messageCtx->offset = length;
+	channel->dvc_message = messageCtx;
 	return TRUE;
 }
 
 static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 length)
 {
 	BOOL ret = FALSE;
+	wtsChannelMessage* messageCtx;
 
 	WINPR_ASSERT(channel);
 	WINPR_ASSERT(s);
-	if (channel->dvc_total_length > 0)
+	messageCtx = channel->dvc_message;
+
+	if (messageCtx)
 	{
-		if (Stream_GetPosition(channel->receiveData) + length > channel->dvc_total_length)
+		if (messageCtx->length - messageCtx->offset < length)
 		{
-			channel->dvc_total_length = 0;
+			free(messageCtx);
+			channel->dvc_message = NULL;
 			WLog_ERR(TAG, "incorrect fragment data, discarded.");
 			return FALSE;
 		}
 
-		Stream_Write(channel->receiveData, Stream_Pointer(s), length);
+		CopyMemory((BYTE*)(messageCtx + 1) + messageCtx->offset, Stream_Pointer(s), length);
+		messageCtx->offset += length;
 
-		if (Stream_GetPosition(channel->receiveData) >= channel->dvc_total_length)
+		if (messageCtx->offset == messageCtx->length)
 		{
-			ret = wts_queue_receive_data(channel, Stream_Buffer(channel->receiveData),
-			                             channel->dvc_total_length);
-			channel->dvc_total_length = 0;
+			channel->dvc_message = NULL;
+			messageCtx->offset = 0;
+			ret = wts_queue_message(channel, messageCtx);
 		}
 		else
 			ret = TRUE;
@@ -570,6 +604,11 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			return FALSE;
 	}
 
+	/* queued channel PDUs, e.g. all PDUs of a graphics pipeline frame, share TLS records */
+	WINPR_ASSERT(vcm->rdp);
+	if (!transport_cork(vcm->rdp->transport))
+		return FALSE;
+
 	while (MessageQueue_Peek(vcm->queue, &message, TRUE))
 	{
 		BYTE* buffer;
@@ -592,6 +631,9 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			break;
 	}
 
+	if (!transport_uncork(vcm->rdp->transport))
+		status = FALSE;
+
 	return status;
 }
 
@@ -1148,6 +1190,7 @@ void channel_free(rdpPeerChannel* channel)
 
 	MessageQueue_Free(channel->queue);
 	Stream_Free(channel->receiveData, TRUE);
+	free(channel->dvc_message);
 	free(channel);
 }
 
@@ -49,6 +49,14 @@ enum
 	DVC_OPEN_STATE_CLOSED = 3
 };
 
+typedef struct
+{
+	UINT16 channelId;
+	UINT16 reserved;
+	UINT32 length;
+	UINT32 offset;
+} wtsChannelMessage;
+
 struct rdp_peer_channel
 {
 	WTSVirtualChannelManager* vcm;
@@ -64,7 +72,7 @@ struct rdp_peer_channel
 	wMessageQueue* queue;
 
 	BYTE dvc_open_state;
-	UINT32 dvc_total_length;
+	wtsChannelMessage* dvc_message;
 	rdpMcsChannel* mcsChannel;
 };
 
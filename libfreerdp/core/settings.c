@@ -330,6 +330,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	                               (flags & FREERDP_SETTINGS_SERVER_MODE) ? TRUE : FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_WaitForOutputBufferFlush, TRUE) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_MaxTimeInCheckLoop, 100) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_MaxConcurrentHandshakes, 0) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_HandshakeQueueTimeout, 10000) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_DesktopWidth, 1024) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_DesktopHeight, 768) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_Workarea, FALSE) ||
@@ -381,6 +383,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_LogonNotify, TRUE) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_BrushSupportLevel, BRUSH_COLOR_FULL) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP61) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_NCrushMaxChainDepth, 0) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_NCrushLazyMatching, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_Authentication, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_AuthenticationOnly, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_CredentialsFromStdin, FALSE) ||
@@ -566,6 +570,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxProgressive, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxProgressiveV2, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_GfxClearCodec, FALSE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_GfxOutputMaxRects, 64) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxH264, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxAVC444, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxSendQoeAck, FALSE))
@@ -45,4 +45,11 @@ FREERDP_LOCAL void freerdp_settings_free_keys(rdpSettings* dst, BOOL cleanup);
 FREERDP_LOCAL BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char* val,
                                                 size_t len, BOOL cleanup);
 
+/* Returns the storage of key id or NULL if the key is unknown or not of the given
+ * RDP_SETTINGS_TYPE_* */
+FREERDP_LOCAL void* freerdp_settings_get_field_writable(rdpSettings* settings, size_t id,
+                                                        size_t type);
+FREERDP_LOCAL const void* freerdp_settings_get_field(const rdpSettings* settings, size_t id,
+                                                     size_t type);
+
 #endif /* FREERDP_LIB_CORE_SETTINGS_H */
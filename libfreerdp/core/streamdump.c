@@ -22,17 +22,39 @@
 #include <winpr/path.h>
 #include <winpr/string.h>
 
+#include <freerdp/log.h>
 #include <freerdp/streamdump.h>
 #include <freerdp/transport_io.h>
 
+#define TAG FREERDP_TAG("core.streamdump")
+
+/* timestamp and size of a record */
+#define STREAM_DUMP_HEADER_SIZE (2 * sizeof(UINT64))
+
+typedef struct
+{
+	UINT64 pts;
+	UINT64 offset;
+} rdpStreamDumpIndexEntry;
+
+struct stream_dump_index
+{
+	rdpStreamDumpIndexEntry* entries;
+	size_t count;
+	size_t capacity;
+};
+
 struct stream_dump_context
 {
 	rdpTransportIo io;
-	size_t writeDumpOffset;
-	size_t readDumpOffset;
 	size_t replayOffset;
 	UINT64 replayTime;
 	CONNECTION_STATE state;
+	FILE* writeFile;  /* kept open while recording, instead of reopened for every PDU */
+	FILE* readFile;
+	FILE* replayFile; /* kept open while replaying */
+	rdpStreamDumpIndex* replayIndex;
+	UINT32 replaySpeed;
 };
 
 BOOL stream_dump_read_line(FILE* fp, wStream* s, UINT64* pts, size_t* pOffset)
@@ -105,6 +127,120 @@ fail:
 	return rc;
 }
 
+rdpStreamDumpIndex* stream_dump_index_new(FILE* fp)
+{
+	INT64 end;
+	UINT64 offset = 0;
+	rdpStreamDumpIndex* index;
+
+	if (!fp)
+		return NULL;
+
+	if ((_fseeki64(fp, 0, SEEK_END) != 0) || ((end = _ftelli64(fp)) < 0))
+		return NULL;
+
+	index = calloc(1, sizeof(rdpStreamDumpIndex));
+	if (!index)
+		return NULL;
+
+	/* only the record headers are read, payloads are skipped */
+	while (offset + STREAM_DUMP_HEADER_SIZE <= (UINT64)end)
+	{
+		UINT64 ts;
+		UINT64 size;
+
+		if ((_fseeki64(fp, (INT64)offset, SEEK_SET) != 0) ||
+		    (fread(&ts, 1, sizeof(ts), fp) != sizeof(ts)) ||
+		    (fread(&size, 1, sizeof(size), fp) != sizeof(size)))
+			goto fail;
+
+		/* a truncated record at the end of a dump that was not closed */
+		if (size > (UINT64)end - offset - STREAM_DUMP_HEADER_SIZE)
+			break;
+
+		if (index->count == index->capacity)
+		{
+			const size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+			rdpStreamDumpIndexEntry* entries =
+			    realloc(index->entries, capacity * sizeof(rdpStreamDumpIndexEntry));
+
+			if (!entries)
+				goto fail;
+
+			index->entries = entries;
+			index->capacity = capacity;
+		}
+
+		index->entries[index->count].pts = ts;
+		index->entries[index->count].offset = offset;
+		index->count++;
+		offset += STREAM_DUMP_HEADER_SIZE + size;
+	}
+
+	return index;
+fail:
+	stream_dump_index_free(index);
+	return NULL;
+}
+
+void stream_dump_index_free(rdpStreamDumpIndex* index)
+{
+	if (!index)
+		return;
+
+	free(index->entries);
+	free(index);
+}
+
+size_t stream_dump_index_count(const rdpStreamDumpIndex* index)
+{
+	if (!index)
+		return 0;
+
+	return index->count;
+}
+
+BOOL stream_dump_index_get(const rdpStreamDumpIndex* index, size_t entry, UINT64* pts,
+                           size_t* offset)
+{
+	if (!index || (entry >= index->count))
+		return FALSE;
+
+	if (pts)
+		*pts = index->entries[entry].pts;
+	if (offset)
+		*offset = (size_t)index->entries[entry].offset;
+	return TRUE;
+}
+
+BOOL stream_dump_index_find(const rdpStreamDumpIndex* index, UINT64 pts, size_t* entry)
+{
+	size_t low = 0;
+	size_t high;
+
+	if (!index || !entry)
+		return FALSE;
+
+	/* first record at or after pts, timestamps of a dump never decrease */
+	high = index->count;
+
+	while (low < high)
+	{
+		const size_t mid = low + (high - low) / 2;
+
+		if (index->entries[mid].pts < pts)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low >= index->count)
+		return FALSE;
+
+	*entry = low;
+	return TRUE;
+}
+
 static FILE* stream_dump_get_file(const rdpSettings* settings, const char* name, const char* mode)
 {
 	const char* cfolder;
@@ -212,6 +348,27 @@ fail:
 	return rc;
 }
 
+static SSIZE_T stream_dump_append_cached(const rdpContext* context, FILE** pfp, const char* name,
+                                         wStream* s)
+{
+	CONNECTION_STATE state = freerdp_get_state(context);
+
+	if (state < context->dump->state)
+		return 0;
+
+	if (!*pfp)
+	{
+		*pfp = stream_dump_get_file(context->settings, name, "ab");
+		if (!*pfp)
+			return -1;
+	}
+
+	if (!stream_dump_write_line(*pfp, s))
+		return -1;
+
+	return (SSIZE_T)Stream_Length(s);
+}
+
 static int stream_dump_transport_write(rdpTransport* transport, wStream* s)
 {
 	SSIZE_T r;
@@ -221,7 +378,7 @@ static int stream_dump_transport_write(rdpTransport* transport, wStream* s)
 	WINPR_ASSERT(ctx->dump);
 	WINPR_ASSERT(s);
 
-	r = stream_dump_append(ctx, "write", s, &ctx->dump->writeDumpOffset);
+	r = stream_dump_append_cached(ctx, &ctx->dump->writeFile, "write", s);
 	if (r < 0)
 		return -1;
 
@@ -242,7 +399,7 @@ static int stream_dump_transport_read(rdpTransport* transport, wStream* s)
 	rc = ctx->dump->io.ReadPdu(transport, s);
 	if (rc > 0)
 	{
-		SSIZE_T r = stream_dump_append(ctx, "read", s, &ctx->dump->readDumpOffset);
+		SSIZE_T r = stream_dump_append_cached(ctx, &ctx->dump->readFile, "read", s);
 		if (r < 0)
 			return -1;
 	}
@@ -280,37 +437,95 @@ static int stream_dump_replay_transport_write(rdpTransport* transport, wStream*
 	WINPR_ASSERT(s);
 
 	size = Stream_Length(s);
-	WLog_ERR("abc", "replay write %" PRIuz, size);
+	WLog_DBG(TAG, "replay write %" PRIuz, size);
 	// TODO: Compare with write file
 
 	return 1;
 }
 
+static BOOL stream_dump_open_replay(rdpContext* context)
+{
+	rdpStreamDumpContext* dump = context->dump;
+
+	if (dump->replayFile)
+		return TRUE;
+
+	dump->replayFile = stream_dump_get_file(context->settings, NULL, "rb");
+	return dump->replayFile != NULL;
+}
+
+BOOL stream_dump_replay_seek(rdpContext* context, UINT64 ms)
+{
+	size_t entry;
+	size_t offset;
+	UINT64 first;
+	rdpStreamDumpContext* dump;
+
+	if (!context || !context->dump)
+		return FALSE;
+
+	dump = context->dump;
+
+	if (!stream_dump_open_replay(context))
+		return FALSE;
+
+	if (!dump->replayIndex)
+	{
+		dump->replayIndex = stream_dump_index_new(dump->replayFile);
+		if (!dump->replayIndex)
+			return FALSE;
+	}
+
+	if (!stream_dump_index_get(dump->replayIndex, 0, &first, NULL) ||
+	    !stream_dump_index_find(dump->replayIndex, first + ms, &entry) ||
+	    !stream_dump_index_get(dump->replayIndex, entry, NULL, &offset))
+		return FALSE;
+
+	dump->replayOffset = offset;
+	/* do not wait for the time that was skipped */
+	dump->replayTime = 0;
+	return TRUE;
+}
+
+void stream_dump_set_replay_speed(rdpContext* context, UINT32 percent)
+{
+	if (!context || !context->dump)
+		return;
+
+	context->dump->replaySpeed = percent;
+}
+
 static int stream_dump_replay_transport_read(rdpTransport* transport, wStream* s)
 {
 	rdpContext* ctx = transport_get_context(transport);
 
 	size_t size = 0;
-	time_t slp = 0;
+	UINT64 slp = 0;
 	UINT64 ts = 0;
+	rdpStreamDumpContext* dump;
 
 	WINPR_ASSERT(ctx);
 	WINPR_ASSERT(ctx->dump);
 	WINPR_ASSERT(s);
 
-	if (stream_dump_get(ctx, NULL, s, &ctx->dump->replayOffset, &ts) < 0)
+	dump = ctx->dump;
+
+	if (!stream_dump_open_replay(ctx))
 		return -1;
 
-	if ((ctx->dump->replayTime > 0) && (ts > ctx->dump->replayTime))
-		slp = ts - ctx->dump->replayTime;
-	ctx->dump->replayTime = ts;
+	if (!stream_dump_read_line(dump->replayFile, s, &ts, &dump->replayOffset))
+		return -1;
+
+	if ((dump->replayTime > 0) && (ts > dump->replayTime) && (dump->replaySpeed > 0))
+		slp = (ts - dump->replayTime) * 100 / dump->replaySpeed;
+	dump->replayTime = ts;
 
 	size = Stream_Length(s);
 	Stream_SetPosition(s, 0);
-	WLog_ERR("abc", "replay read %" PRIuz, size);
+	WLog_DBG(TAG, "replay read %" PRIuz, size);
 
 	if (slp > 0)
-		Sleep(slp);
+		Sleep((DWORD)MIN(slp, UINT32_MAX));
 
 	return 1;
 }
@@ -378,6 +593,16 @@ BOOL stream_dump_register_handlers(rdpContext* context, CONNECTION_STATE state)
 
 void stream_dump_free(rdpStreamDumpContext* dump)
 {
+	if (!dump)
+		return;
+
+	if (dump->writeFile)
+		fclose(dump->writeFile);
+	if (dump->readFile)
+		fclose(dump->readFile);
+	if (dump->replayFile)
+		fclose(dump->replayFile);
+	stream_dump_index_free(dump->replayIndex);
 	free(dump);
 }
 
@@ -387,5 +612,6 @@ rdpStreamDumpContext* stream_dump_new(void)
 	if (!dump)
 		return NULL;
 
+	dump->replaySpeed = 100;
 	return dump;
 }
@@ -161,6 +161,9 @@ static BOOL update_recv_surfcmd_frame_marker(rdpUpdate* update, wStream* s)
 		return FALSE;
 	}
 
+	if (marker.frameAction == SURFACECMD_FRAMEACTION_END)
+		metrics_counter_add(update->context->metrics, FREERDP_METRIC_FRAMES_DECODED, 1);
+
 	return update->SurfaceFrameMarker(update->context, &marker);
 }
 
@@ -201,9 +204,9 @@ int update_recv_surfcmds(rdpUpdate* update, wStream* s)
 		if (up->dump_rfx)
 		{
 			const size_t size = Stream_GetPosition(s) - start;
-			/* TODO: treat return values */
-			pcap_add_record(up->pcap_rfx, mark, size);
-			pcap_flush(up->pcap_rfx);
+			/* the record is copied and written in the background */
+			if (!pcap_add_record(up->pcap_rfx, mark, size))
+				WLog_DBG(TAG, "surface command was not captured");
 		}
 	}
 
@@ -794,37 +794,99 @@ static BOOL freerdp_tcp_is_hostname_resolvable(rdpContext* context, const char*
 	return TRUE;
 }
 
-static BOOL freerdp_tcp_connect_timeout(rdpContext* context, int sockfd, struct sockaddr* addr,
-                                        socklen_t addrlen, UINT32 timeout)
+/* RFC 8305 connection attempt delay */
+#define TCP_CONNECT_ATTEMPT_DELAY 250
+#define TCP_CONNECT_MAX_ATTEMPTS 16
+
+typedef struct
 {
-	BOOL rc = FALSE;
-	HANDLE handles[2];
-	int status = 0;
-	int count = 0;
-	u_long arg = 0;
-	DWORD tout = (timeout > 0) ? timeout : INFINITE;
+	SOCKET s;
+	HANDLE event;
+} t_connect_attempt;
+
+static void connect_attempt_free(t_connect_attempt* attempt)
+{
+	if (attempt->s != INVALID_SOCKET)
+		closesocket(attempt->s);
+
+	if (attempt->event)
+		CloseHandle(attempt->event);
+
+	attempt->s = INVALID_SOCKET;
+	attempt->event = NULL;
+}
+
+/**
+ * Orders the resolved addresses like RFC 8305 section 4 does, alternating
+ * between the address families starting with the preferred one.
+ */
+static size_t freerdp_tcp_sort_addresses(const struct addrinfo* result, BOOL preferIPv6,
+                                         const struct addrinfo** sorted, size_t max)
+{
+	size_t x;
+	size_t count = 0;
+	size_t npreferred = 0;
+	size_t nother = 0;
+	const struct addrinfo* addr;
+	const struct addrinfo* preferred[TCP_CONNECT_MAX_ATTEMPTS] = { 0 };
+	const struct addrinfo* other[TCP_CONNECT_MAX_ATTEMPTS] = { 0 };
+	const int family = preferIPv6 ? AF_INET6 : AF_INET;
+
+	max = MIN(max, TCP_CONNECT_MAX_ATTEMPTS);
+
+	for (addr = result; addr; addr = addr->ai_next)
+	{
+		if ((addr->ai_family == family) && (npreferred < max))
+			preferred[npreferred++] = addr;
+		else if ((addr->ai_family != family) && (nother < max))
+			other[nother++] = addr;
+	}
+
+	for (x = 0; (count < max) && ((x < npreferred) || (x < nother)); x++)
+	{
+		if (x < npreferred)
+			sorted[count++] = preferred[x];
+
+		if ((x < nother) && (count < max))
+			sorted[count++] = other[x];
+	}
+
+	return count;
+}
 
-	handles[count] = CreateEvent(NULL, TRUE, FALSE, NULL);
+static BOOL freerdp_tcp_start_connect(t_connect_attempt* attempt, const struct addrinfo* addr)
+{
+	int status;
+	char* peerAddress;
 
-	if (!handles[count])
+	attempt->s = _socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+
+	if (attempt->s == INVALID_SOCKET)
 		return FALSE;
 
-	status = WSAEventSelect(sockfd, handles[count++], FD_READ | FD_WRITE | FD_CONNECT | FD_CLOSE);
+	attempt->event = CreateEvent(NULL, TRUE, FALSE, NULL);
 
-	if (status < 0)
+	if (!attempt->event)
+		goto fail;
+
+	if (WSAEventSelect(attempt->s, attempt->event, FD_READ | FD_WRITE | FD_CONNECT | FD_CLOSE) < 0)
 	{
 		WLog_ERR(TAG, "WSAEventSelect failed with %d", WSAGetLastError());
 		goto fail;
 	}
 
-	handles[count++] = context->abortEvent;
-	status = _connect(sockfd, addr, addrlen);
+	if ((peerAddress = freerdp_tcp_address_to_string(
+	         (const struct sockaddr_storage*)addr->ai_addr, NULL)) != NULL)
+	{
+		WLog_DBG(TAG, "connecting to peer %s", peerAddress);
+		free(peerAddress);
+	}
+
+	status = _connect(attempt->s, addr->ai_addr, addr->ai_addrlen);
 
 	if (status < 0)
 	{
-		status = WSAGetLastError();
-
-		switch (status)
+		switch (WSAGetLastError())
 		{
 			case WSAEINPROGRESS:
 			case WSAEWOULDBLOCK:
@@ -835,34 +897,143 @@ static BOOL freerdp_tcp_connect_timeout(rdpContext* context, int sockfd, struct
 		}
 	}
 
-	status = WaitForMultipleObjects(count, handles, FALSE, tout);
+	return TRUE;
+fail:
+	connect_attempt_free(attempt);
+	return FALSE;
+}
 
-	if (WAIT_OBJECT_0 != status)
-		goto fail;
+static BOOL freerdp_tcp_connect_succeeded(const t_connect_attempt* attempt)
+{
+	int error = 0;
+	socklen_t length = sizeof(error);
+
+	if (getsockopt(attempt->s, SOL_SOCKET, SO_ERROR, (void*)&error, &length) != 0)
+		return FALSE;
 
-	status = recv(sockfd, NULL, 0, 0);
+	if (error != 0)
+		return FALSE;
 
-	if (status == SOCKET_ERROR)
+	if (recv(attempt->s, NULL, 0, 0) == SOCKET_ERROR)
 	{
 		if (WSAGetLastError() == WSAECONNRESET)
-			goto fail;
+			return FALSE;
 	}
 
-	status = WSAEventSelect(sockfd, handles[0], 0);
+	return TRUE;
+}
 
-	if (status < 0)
+/**
+ * Connects to the first reachable resolved address. Attempts are started
+ * TCP_CONNECT_ATTEMPT_DELAY ms apart, or as soon as the previous one failed,
+ * and the first one to complete wins (RFC 8305 happy eyeballs).
+ *
+ * @return the connected blocking socket or -1
+ */
+static int freerdp_tcp_connect_addresses(rdpContext* context, const struct addrinfo* result,
+                                         BOOL preferIPv6, DWORD timeout)
+{
+	size_t x;
+	size_t count;
+	size_t next = 0;
+	size_t active = 0;
+	SOCKET sockfd = INVALID_SOCKET;
+	const UINT64 start = GetTickCount64();
+	UINT64 nextAttempt = start;
+	const struct addrinfo* addrs[TCP_CONNECT_MAX_ATTEMPTS] = { 0 };
+	t_connect_attempt attempts[TCP_CONNECT_MAX_ATTEMPTS];
+
+	count = freerdp_tcp_sort_addresses(result, preferIPv6, addrs, ARRAYSIZE(addrs));
+
+	for (x = 0; x < ARRAYSIZE(attempts); x++)
 	{
-		WLog_ERR(TAG, "WSAEventSelect failed with %d", WSAGetLastError());
-		goto fail;
+		attempts[x].s = INVALID_SOCKET;
+		attempts[x].event = NULL;
 	}
 
-	if (_ioctlsocket(sockfd, FIONBIO, &arg) != 0)
-		goto fail;
+	while (sockfd == INVALID_SOCKET)
+	{
+		DWORD status;
+		DWORD nhandles = 0;
+		DWORD wait = INFINITE;
+		HANDLE handles[TCP_CONNECT_MAX_ATTEMPTS + 1];
+		size_t index[TCP_CONNECT_MAX_ATTEMPTS + 1] = { 0 };
+		const UINT64 now = GetTickCount64();
+
+		if ((timeout > 0) && (now - start >= timeout))
+			break;
 
-	rc = TRUE;
-fail:
-	CloseHandle(handles[0]);
-	return rc;
+		if ((next < count) && (now >= nextAttempt))
+		{
+			if (freerdp_tcp_start_connect(&attempts[next], addrs[next]))
+			{
+				active++;
+				nextAttempt = now + TCP_CONNECT_ATTEMPT_DELAY;
+			}
+
+			next++;
+			continue;
+		}
+
+		if (active == 0)
+			break;
+
+		handles[nhandles++] = context->abortEvent;
+
+		for (x = 0; x < next; x++)
+		{
+			if (!attempts[x].event)
+				continue;
+
+			index[nhandles] = x;
+			handles[nhandles++] = attempts[x].event;
+		}
+
+		if (next < count)
+			wait = (DWORD)(nextAttempt - now);
+
+		if (timeout > 0)
+			wait = MIN(wait, (DWORD)(timeout - (now - start)));
+
+		status = WaitForMultipleObjects(nhandles, handles, FALSE, wait);
+
+		if (status == WAIT_TIMEOUT)
+			continue;
+
+		if ((status <= WAIT_OBJECT_0) || (status >= WAIT_OBJECT_0 + nhandles))
+			break;
+
+		x = index[status - WAIT_OBJECT_0];
+
+		if (freerdp_tcp_connect_succeeded(&attempts[x]))
+		{
+			u_long arg = 0;
+
+			if ((WSAEventSelect(attempts[x].s, attempts[x].event, 0) == 0) &&
+			    (_ioctlsocket(attempts[x].s, FIONBIO, &arg) == 0))
+			{
+				sockfd = attempts[x].s;
+				attempts[x].s = INVALID_SOCKET;
+			}
+			else
+				WLog_ERR(TAG, "failed to reset socket mode");
+
+			break;
+		}
+
+		/* start the next attempt right away */
+		connect_attempt_free(&attempts[x]);
+		active--;
+		nextAttempt = now;
+	}
+
+	for (x = 0; x < ARRAYSIZE(attempts); x++)
+		connect_attempt_free(&attempts[x]);
+
+	if (sockfd == INVALID_SOCKET)
+		return -1;
+
+	return (int)sockfd;
 }
 
 typedef struct
@@ -1114,8 +1285,6 @@ int freerdp_tcp_default_connect(rdpContext* context, rdpSettings* settings, cons
 
 		if (sockfd <= 0)
 		{
-			char* peerAddress;
-			struct addrinfo* addr;
 			struct addrinfo* result;
 
 			result = freerdp_tcp_resolve_host(hostname, port, 0);
@@ -1128,43 +1297,12 @@ int freerdp_tcp_default_connect(rdpContext* context, rdpSettings* settings, cons
 			}
 			freerdp_set_last_error_log(context, 0);
 
-			addr = result;
-
-			if ((addr->ai_family == AF_INET6) && (addr->ai_next != 0) &&
-			    !settings->PreferIPv6OverIPv4)
-			{
-				while ((addr = addr->ai_next))
-				{
-					if (addr->ai_family == AF_INET)
-						break;
-				}
-
-				if (!addr)
-					addr = result;
-			}
-
-			sockfd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+			sockfd = freerdp_tcp_connect_addresses(context, result,
+			                                       settings->PreferIPv6OverIPv4, timeout);
 
 			if (sockfd < 0)
 			{
-				freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_FAILED);
-
 				freeaddrinfo(result);
-				return -1;
-			}
-
-			if ((peerAddress = freerdp_tcp_address_to_string(
-			         (const struct sockaddr_storage*)addr->ai_addr, NULL)) != NULL)
-			{
-				WLog_DBG(TAG, "connecting to peer %s", peerAddress);
-				free(peerAddress);
-			}
-
-			if (!freerdp_tcp_connect_timeout(context, sockfd, addr->ai_addr, addr->ai_addrlen,
-			                                 timeout))
-			{
-				freeaddrinfo(result);
-				close(sockfd);
 
 				freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_FAILED);
 
@@ -0,0 +1,64 @@
+#include <winpr/crt.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/codecs.h>
+
+int TestCodecs(int argc, char* argv[])
+{
+	int rc = -1;
+	rdpCodecs* codecs = NULL;
+	rdpMetrics* metrics = NULL;
+	freerdp* instance = freerdp_new();
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	metrics = instance->context->metrics;
+	codecs = codecs_new(instance->context);
+
+	if (!codecs)
+		goto fail;
+
+	/* preparing allocates nothing */
+	if (!freerdp_client_codecs_prepare(codecs, FREERDP_CODEC_PLANAR | FREERDP_CODEC_REMOTEFX, 64,
+	                                   64))
+		goto fail;
+
+	if (codecs->planar || codecs->rfx ||
+	    (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 0))
+		goto fail;
+
+	if (!freerdp_client_codecs_ensure(codecs, FREERDP_CODEC_PLANAR) || !codecs->planar ||
+	    codecs->rfx || (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 1))
+		goto fail;
+
+	if (!freerdp_client_codecs_ensure(codecs, FREERDP_CODEC_PLANAR | FREERDP_CODEC_REMOTEFX) ||
+	    !codecs->rfx || (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 2))
+		goto fail;
+
+	/* codecs that were not prepared are never created */
+	if (freerdp_client_codecs_ensure(codecs, FREERDP_CODEC_NSCODEC) || codecs->nsc)
+		goto fail;
+
+	freerdp_client_codecs_release(codecs, FREERDP_CODEC_STATELESS);
+
+	if (codecs->planar || !codecs->rfx ||
+	    (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 1))
+		goto fail;
+
+	codecs_free(codecs);
+	codecs = NULL;
+
+	if (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 0)
+		goto fail;
+
+	rc = 0;
+fail:
+	codecs_free(codecs);
+	if (instance)
+		freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
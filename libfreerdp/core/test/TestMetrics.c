@@ -0,0 +1,112 @@
+#include <winpr/crt.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
+
+static BOOL test_metrics_line(void* custom, const char* line)
+{
+	size_t* lines = custom;
+
+	if (!line || (strlen(line) == 0))
+		return FALSE;
+
+	(*lines)++;
+	return TRUE;
+}
+
+int TestMetrics(int argc, char* argv[])
+{
+	int rc = -1;
+	size_t x;
+	size_t lines = 0;
+	UINT64 bytesIn = 0;
+	UINT64 bytesOut = 0;
+	const char* name = NULL;
+	FREERDP_METRIC_HISTOGRAM_SUMMARY summary = { 0 };
+	rdpMetrics* metrics;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	metrics = metrics_new(NULL);
+	if (!metrics)
+		return -1;
+
+	metrics_counter_add(metrics, FREERDP_METRIC_BYTES_IN, 100);
+	metrics_counter_add(metrics, FREERDP_METRIC_BYTES_IN, 23);
+	metrics_counter_add(metrics, FREERDP_METRIC_COUNTER_COUNT, 1);
+	if (metrics_counter_get(metrics, FREERDP_METRIC_BYTES_IN) != 123)
+		goto fail;
+
+	metrics_gauge_add(metrics, FREERDP_METRIC_SURFACE_BYTES, 4096);
+	metrics_gauge_add(metrics, FREERDP_METRIC_SURFACE_BYTES, -1024);
+	metrics_gauge_add(metrics, FREERDP_METRIC_GAUGE_COUNT, 1);
+	if ((metrics_gauge_get(metrics, FREERDP_METRIC_SURFACE_BYTES) != 3072) ||
+	    (metrics_gauge_get(metrics, FREERDP_METRIC_CODEC_CONTEXTS) != 0))
+		goto fail;
+
+	/* an unused histogram reports all zero */
+	if (!metrics_histogram_get(metrics, FREERDP_METRIC_RTT, &summary) || (summary.count != 0) ||
+	    (summary.min != 0) || (summary.max != 0) || (summary.p99 != 0))
+		goto fail;
+
+	for (x = 1; x <= 1000; x++)
+		metrics_histogram_record(metrics, FREERDP_METRIC_RTT, x * 10);
+
+	if (!metrics_histogram_get(metrics, FREERDP_METRIC_RTT, &summary))
+		goto fail;
+
+	if ((summary.count != 1000) || (summary.sum != 5005000) || (summary.min != 10) ||
+	    (summary.max != 10000))
+		goto fail;
+
+	/* buckets are accurate to 12.5% */
+	if ((summary.p50 < 4375) || (summary.p50 > 5625) || (summary.p90 < 7875) ||
+	    (summary.p90 > 10125) || (summary.p99 < 8662) || (summary.p99 > 10000))
+		goto fail;
+
+	if (metrics_histogram_percentile(metrics, FREERDP_METRIC_RTT, 100.0) != 10000)
+		goto fail;
+
+	metrics_channel_bytes(metrics, 1004, "rdpsnd", 10, 0);
+	metrics_channel_bytes(metrics, 1005, "drdynvc", 0, 20);
+	metrics_channel_bytes(metrics, 1004, NULL, 5, 7);
+
+	if (metrics_channel_count(metrics) != 2)
+		goto fail;
+
+	if (!metrics_channel_get(metrics, 0, &name, &bytesIn, &bytesOut) ||
+	    (strcmp(name, "rdpsnd") != 0) || (bytesIn != 15) || (bytesOut != 7))
+		goto fail;
+
+	if (metrics_channel_get(metrics, 2, &name, &bytesIn, &bytesOut))
+		goto fail;
+
+	/* only acknowledged frames that are still tracked are timed */
+	metrics_frame_sent(metrics, 1);
+	metrics_frame_sent(metrics, 2);
+	metrics_frame_acknowledged(metrics, 2);
+	metrics_frame_acknowledged(metrics, 2);
+	metrics_frame_acknowledged(metrics, 3);
+
+	if ((metrics_counter_get(metrics, FREERDP_METRIC_FRAMES_ENCODED) != 2) ||
+	    (metrics_counter_get(metrics, FREERDP_METRIC_FRAMES_ACKNOWLEDGED) != 3))
+		goto fail;
+
+	if (!metrics_histogram_get(metrics, FREERDP_METRIC_FRAME_ACK_LATENCY, &summary) ||
+	    (summary.count != 1))
+		goto fail;
+
+	if (!metrics_export(metrics, "session=\"1\"", test_metrics_line, &lines))
+		goto fail;
+
+	/* two lines per counter and gauge, two headers plus one line per channel, six lines per
+	 * histogram */
+	if (lines != FREERDP_METRIC_COUNTER_COUNT * 2 + FREERDP_METRIC_GAUGE_COUNT * 2 + 2 + 4 +
+	                 FREERDP_METRIC_HISTOGRAM_COUNT * 6)
+		goto fail;
+
+	rc = 0;
+fail:
+	metrics_free(metrics);
+	return rc;
+}
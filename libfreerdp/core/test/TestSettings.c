@@ -189,6 +189,16 @@ int TestSettings(int argc, char* argv[])
 	}
 
 #endif
+	/* unknown keys and keys of another type must be rejected */
+	if (freerdp_settings_set_uint32(settings, FreeRDP_Username, 1))
+		goto fail;
+	if (freerdp_settings_set_bool(settings, 1, TRUE) || freerdp_settings_get_name_for_key(1))
+		goto fail;
+	if (freerdp_settings_get_type_for_key(SIZE_MAX) != -1)
+		goto fail;
+	if (freerdp_settings_get_type_for_key(FreeRDP_Username) != RDP_SETTINGS_TYPE_STRING)
+		goto fail;
+
 	cloned2 = freerdp_settings_clone(settings);
 	if (!cloned2)
 		goto fail;
@@ -86,6 +86,93 @@ fail:
 	return rc;
 }
 
+static BOOL write_record(FILE* fp, UINT64 ts, const BYTE* data, UINT64 size)
+{
+	if (fwrite(&ts, 1, sizeof(ts), fp) != sizeof(ts))
+		return FALSE;
+	if (fwrite(&size, 1, sizeof(size), fp) != sizeof(size))
+		return FALSE;
+	return fwrite(data, 1, size, fp) == size;
+}
+
+static BOOL test_index(void)
+{
+	BOOL rc = FALSE;
+	FILE* fp = NULL;
+	char* name = NULL;
+	wStream* s = NULL;
+	rdpStreamDumpIndex* index = NULL;
+	BYTE data[64] = { 0 };
+	size_t x, entry, offset;
+	UINT64 ts;
+
+	name = GetKnownSubPath(KNOWN_PATH_TEMP, "TestStreamDumpIndex.dump");
+	s = Stream_New(NULL, sizeof(data));
+	if (!name || !s)
+		goto fail;
+
+	fp = fopen(name, "wb");
+	if (!fp)
+		goto fail;
+
+	/* one record every 10ms, with growing sizes */
+	for (x = 0; x < 100; x++)
+	{
+		data[0] = (BYTE)x;
+		if (!write_record(fp, 1000 + x * 10, data, 1 + x % sizeof(data)))
+			goto fail;
+	}
+
+	/* a truncated record must not be indexed */
+	ts = 5000;
+	if (fwrite(&ts, 1, sizeof(ts), fp) != sizeof(ts))
+		goto fail;
+	fclose(fp);
+
+	fp = fopen(name, "rb");
+	if (!fp)
+		goto fail;
+
+	index = stream_dump_index_new(fp);
+	if (!index || (stream_dump_index_count(index) != 100))
+	{
+		fprintf(stderr, "[%s] unexpected number of records\n", __FUNCTION__);
+		goto fail;
+	}
+
+	/* timestamps between records find the next one */
+	if (!stream_dump_index_find(index, 1455, &entry) || (entry != 46))
+		goto fail;
+	if (!stream_dump_index_find(index, 0, &entry) || (entry != 0))
+		goto fail;
+	if (stream_dump_index_find(index, 2000, &entry))
+		goto fail;
+
+	if (!stream_dump_index_get(index, 46, &ts, &offset) || (ts != 1460))
+		goto fail;
+
+	if (!stream_dump_read_line(fp, s, &ts, &offset))
+		goto fail;
+
+	if ((ts != 1460) || (Stream_Length(s) != 1 + 46 % sizeof(data)) ||
+	    (Stream_Buffer(s)[0] != 46))
+	{
+		fprintf(stderr, "[%s] indexed record does not match\n", __FUNCTION__);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	stream_dump_index_free(index);
+	Stream_Free(s, TRUE);
+	if (fp)
+		fclose(fp);
+	if (name)
+		DeleteFileA(name);
+	free(name);
+	return rc;
+}
+
 int TestStreamDump(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -93,5 +180,7 @@ int TestStreamDump(int argc, char* argv[])
 
 	if (!test_entry_read_write())
 		return -1;
+	if (!test_index())
+		return -1;
 	return 0;
 }
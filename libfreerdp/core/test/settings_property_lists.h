@@ -72,6 +72,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_GatewayUseSameCredentials,
 	FreeRDP_GfxAVC444,
 	FreeRDP_GfxAVC444v2,
+	FreeRDP_GfxClearCodec,
 	FreeRDP_GfxH264,
 	FreeRDP_GfxPlanar,
 	FreeRDP_GfxProgressive,
@@ -102,6 +103,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_MstscCookieMode,
 	FreeRDP_MultiTouchGestures,
 	FreeRDP_MultiTouchInput,
+	FreeRDP_NCrushLazyMatching,
 	FreeRDP_NSCodec,
 	FreeRDP_NSCodecAllowDynamicColorFidelity,
 	FreeRDP_NSCodecAllowSubsampling,
@@ -229,7 +231,9 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_GatewayPort,
 	FreeRDP_GatewayUsageMethod,
 	FreeRDP_GfxCapsFilter,
+	FreeRDP_GfxOutputMaxRects,
 	FreeRDP_GlyphSupportLevel,
+	FreeRDP_HandshakeQueueTimeout,
 	FreeRDP_JpegCodecId,
 	FreeRDP_JpegQuality,
 	FreeRDP_KeySpec,
@@ -241,6 +245,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_KeyboardType,
 	FreeRDP_LargePointerFlag,
 	FreeRDP_LoadBalanceInfoLength,
+	FreeRDP_MaxConcurrentHandshakes,
 	FreeRDP_MaxTimeInCheckLoop,
 	FreeRDP_MonitorCount,
 	FreeRDP_MonitorDefArraySize,
@@ -248,6 +253,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_MonitorLocalShiftY,
 	FreeRDP_MultifragMaxRequestSize,
 	FreeRDP_MultitransportFlags,
+	FreeRDP_NCrushMaxChainDepth,
 	FreeRDP_NSCodecColorLossLevel,
 	FreeRDP_NSCodecId,
 	FreeRDP_NegotiationFlags,
@@ -323,6 +329,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_AlternateShell,
 	FreeRDP_AssistanceFile,
 	FreeRDP_AuthenticationServiceClass,
+	FreeRDP_BitmapCachePersistFile,
 	FreeRDP_CardName,
 	FreeRDP_CertificateAcceptedFingerprints,
 	FreeRDP_CertificateContent,
@@ -346,6 +353,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_GatewayAccessToken,
 	FreeRDP_GatewayDomain,
 	FreeRDP_GatewayHostname,
+	FreeRDP_GatewayInnerTlsCiphers,
 	FreeRDP_GatewayPassword,
 	FreeRDP_GatewayUsername,
 	FreeRDP_HomePath,
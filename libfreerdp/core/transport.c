@@ -31,6 +31,7 @@
 #include <freerdp/log.h>
 #include <freerdp/error.h>
 #include <freerdp/utils/ringbuffer.h>
+#include <freerdp/utils/trace.h>
 
 #include <openssl/bio.h>
 #include <time.h>
@@ -56,6 +57,10 @@
 #define TAG FREERDP_TAG("core.transport")
 
 #define BUFFER_SIZE 16384
+/* One TLS record, PDU bodies at least this long are read directly into the PDU stream */
+#define READ_AHEAD_SIZE 16384
+/* Corked output is sent once it fills 4 TLS records */
+#define CORK_FLUSH_SIZE (4 * 16384)
 
 struct rdp_transport
 {
@@ -80,6 +85,13 @@ struct rdp_transport
 	ULONG written;
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
+	/* bytes received beyond the PDU being read, served before reading from the layer again */
+	BYTE* ReadAhead;
+	size_t ReadAheadOffset;
+	size_t ReadAheadLength;
+	/* PDUs written while corked, they go out together with the final transport_uncork */
+	wStream* CorkBuffer;
+	UINT32 CorkDepth;
 	wLog* log;
 	rdpTransportIo io;
 };
@@ -150,6 +162,19 @@ wStream* transport_send_stream_init(rdpTransport* transport, size_t size)
 	return s;
 }
 
+/* Buffered bytes belong to the layer they were read from, drop them when it is replaced */
+static void transport_reset_read_ahead(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	if (transport->ReadAheadOffset < transport->ReadAheadLength)
+		WLog_Print(transport->log, WLOG_WARN, "dropping %" PRIuz " bytes received ahead",
+		           transport->ReadAheadLength - transport->ReadAheadOffset);
+
+	transport->ReadAheadOffset = 0;
+	transport->ReadAheadLength = 0;
+}
+
 BOOL transport_attach(rdpTransport* transport, int sockfd)
 {
 	if (!transport)
@@ -177,6 +202,7 @@ static BOOL transport_default_attach(rdpTransport* transport, int sockfd)
 
 	bufferedBio = BIO_push(bufferedBio, socketBio);
 	WINPR_ASSERT(!transport->frontBio);
+	transport_reset_read_ahead(transport);
 	transport->frontBio = bufferedBio;
 	return TRUE;
 fail:
@@ -261,6 +287,15 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 		tls->port = 3389;
 
 	tls->isGatewayTransport = FALSE;
+	tls->isTunneled = transport->GatewayEnabled;
+
+	/* hand a session from an earlier connection to tls_connect for resumption */
+	if (context->rdp)
+	{
+		tls->session = context->rdp->tlsSession;
+		context->rdp->tlsSession = NULL;
+	}
+
 	tlsStatus = tls_connect(tls, transport->frontBio);
 
 	if (tlsStatus < 1)
@@ -277,6 +312,7 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 		return FALSE;
 	}
 
+	transport_reset_read_ahead(transport);
 	transport->frontBio = tls->bio;
 	BIO_callback_ctrl(tls->bio, BIO_CTRL_SET_CALLBACK, (bio_info_cb*)(void*)transport_ssl_cb);
 	SSL_set_app_data(tls->ssl, transport);
@@ -363,6 +399,27 @@ BOOL transport_connect(rdpTransport* transport, const char* hostname, UINT16 por
 
 	if (transport->GatewayEnabled)
 	{
+		if (!status && settings->GatewayHttpTransport && context->rdp &&
+		    context->rdp->gatewayTunnel)
+		{
+			rdpRdg* rdg = context->rdp->gatewayTunnel;
+
+			/* a tunnel that was closed by the gateway meanwhile is set up from scratch */
+			context->rdp->gatewayTunnel = NULL;
+
+			if (rdg_reopen_channel(rdg))
+			{
+				transport->rdg = rdg;
+				WINPR_ASSERT(!transport->frontBio);
+				transport->frontBio = rdg_get_front_bio_and_take_ownership(transport->rdg);
+				BIO_set_nonblock(transport->frontBio, 0);
+				transport->layer = TRANSPORT_LAYER_TSG;
+				status = TRUE;
+			}
+			else
+				rdg_free(rdg);
+		}
+
 		if (!status && settings->GatewayHttpTransport)
 		{
 			transport->rdg = rdg_new(context);
@@ -475,6 +532,7 @@ static BOOL transport_default_accept_tls(rdpTransport* transport)
 	if (!tls_accept(transport->tls, transport->frontBio, settings))
 		return FALSE;
 
+	transport_reset_read_ahead(transport);
 	transport->frontBio = transport->tls->bio;
 	return TRUE;
 }
@@ -564,7 +622,9 @@ static void transport_bio_error_log(rdpTransport* transport, LPCSTR biofunc, BIO
 	}
 }
 
-static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t bytes)
+/* Reads bytes, or with partial set whatever the first successful BIO_read returns */
+static SSIZE_T transport_read_layer_ex(rdpTransport* transport, BYTE* data, size_t bytes,
+                                       BOOL partial)
 {
 	SSIZE_T read = 0;
 	rdpRdp* rdp;
@@ -589,8 +649,12 @@ static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t
 	{
 		const SSIZE_T tr = (SSIZE_T)bytes - read;
 		int r = (int)((tr > INT_MAX) ? INT_MAX : tr);
+		const UINT64 start = metrics_get_time_us();
 		int status = BIO_read(transport->frontBio, data + read, r);
 
+		metrics_counter_add(context->metrics, FREERDP_METRIC_TRANSPORT_IO_TIME,
+		                    metrics_get_time_us() - start);
+
 		if (freerdp_shall_disconnect(context->instance))
 			return -1;
 
@@ -631,11 +695,19 @@ static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t
 #endif
 		read += status;
 		rdp->inBytes += status;
+
+		if (partial)
+			break;
 	}
 
 	return read;
 }
 
+static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t bytes)
+{
+	return transport_read_layer_ex(transport, data, bytes, FALSE);
+}
+
 /**
  * @brief Tries to read toRead bytes from the specified transport
  *
@@ -668,6 +740,69 @@ static SSIZE_T transport_read_layer_bytes(rdpTransport* transport, wStream* s, s
 	return status == (SSIZE_T)toRead ? 1 : 0;
 }
 
+/**
+ * @brief Like transport_read_layer_bytes, but served from the read ahead buffer
+ *
+ * The buffer is refilled with as many bytes as one read of the layer returns, so a single
+ * socket or TLS read usually yields several PDUs. Bodies the buffer can not hold are read
+ * directly into the stream.
+ *
+ * @return < 0 on error; 0 if not enough data is available (non blocking mode); 1 toRead bytes read
+ */
+static SSIZE_T transport_read_ahead_bytes(rdpTransport* transport, wStream* s, size_t toRead)
+{
+	WINPR_ASSERT(transport);
+
+	while (toRead > 0)
+	{
+		size_t count;
+
+		if (transport->ReadAheadOffset >= transport->ReadAheadLength)
+		{
+			SSIZE_T status;
+
+			if (toRead >= READ_AHEAD_SIZE)
+				return transport_read_layer_bytes(transport, s, toRead);
+
+			status = transport_read_layer_ex(transport, transport->ReadAhead, READ_AHEAD_SIZE,
+			                                 TRUE);
+			if (status <= 0)
+				return status;
+
+			transport->ReadAheadOffset = 0;
+			transport->ReadAheadLength = (size_t)status;
+		}
+
+		count = MIN(toRead, transport->ReadAheadLength - transport->ReadAheadOffset);
+		Stream_Write(s, &transport->ReadAhead[transport->ReadAheadOffset], count);
+		transport->ReadAheadOffset += count;
+		toRead -= count;
+	}
+
+	return 1;
+}
+
+/* TRUE if the read ahead buffer holds at least one complete PDU */
+static BOOL transport_read_ahead_has_pdu(rdpTransport* transport)
+{
+	BOOL incomplete = TRUE;
+	SSIZE_T pduLength;
+	wStream sbuffer = { 0 };
+	wStream* s;
+	const size_t length = transport->ReadAheadLength - transport->ReadAheadOffset;
+
+	if (length == 0)
+		return FALSE;
+
+	s = Stream_StaticConstInit(&sbuffer, &transport->ReadAhead[transport->ReadAheadOffset],
+	                           length);
+	Stream_SetPosition(s, length);
+	pduLength = transport_parse_pdu(transport, s, &incomplete);
+
+	/* an error also covers more than one buffered PDU, reading them tells the cases apart */
+	return (pduLength < 0) || ((pduLength > 0) && !incomplete);
+}
+
 /**
  * @brief Try to read a complete PDU (NLA, fast-path or tpkt) from the underlying transport.
  *
@@ -684,7 +819,11 @@ int transport_read_pdu(rdpTransport* transport, wStream* s)
 {
 	if (!transport)
 		return -1;
-	return IFCALLRESULT(-1, transport->io.ReadPdu, transport, s);
+
+	FREERDP_TRACE_SPAN_BEGIN(span);
+	const int rc = IFCALLRESULT(-1, transport->io.ReadPdu, transport, s);
+	FREERDP_TRACE_SPAN_END(span, "transport_read_pdu");
+	return rc;
 }
 
 SSIZE_T transport_parse_pdu(rdpTransport* transport, wStream* s, BOOL* incomplete)
@@ -819,10 +958,15 @@ static int transport_default_read_pdu(rdpTransport* transport, wStream* s)
 	SSIZE_T status;
 	size_t pduLength;
 	size_t position;
+	SSIZE_T (*readBytes)(rdpTransport*, wStream*, size_t) = transport_read_layer_bytes;
 
 	WINPR_ASSERT(transport);
 	WINPR_ASSERT(s);
 
+	/* Custom ReadBytes callbacks may block until all requested bytes arrived */
+	if (transport->ReadAhead && (transport->io.ReadBytes == transport_read_layer))
+		readBytes = transport_read_ahead_bytes;
+
 	/* Read in pdu length */
 	status = transport_parse_pdu(transport, s, &incomplete);
 	while ((status == 0) && incomplete)
@@ -830,7 +974,7 @@ static int transport_default_read_pdu(rdpTransport* transport, wStream* s)
 		int rc;
 		if (!Stream_EnsureRemainingCapacity(s, 1))
 			return -1;
-		rc = transport_read_layer_bytes(transport, s, 1);
+		rc = readBytes(transport, s, 1);
 		if (rc != 1)
 			return rc;
 		status = transport_parse_pdu(transport, s, &incomplete);
@@ -849,7 +993,7 @@ static int transport_default_read_pdu(rdpTransport* transport, wStream* s)
 	if (position > pduLength)
 		return -1;
 
-	status = transport_read_layer_bytes(transport, s, pduLength - Stream_GetPosition(s));
+	status = readBytes(transport, s, pduLength - Stream_GetPosition(s));
 
 	if (status != 1)
 		return status;
@@ -867,45 +1011,24 @@ int transport_write(rdpTransport* transport, wStream* s)
 	if (!transport)
 		return -1;
 
-	return IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
+	FREERDP_TRACE_SPAN_BEGIN(span);
+	const int rc = IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
+	FREERDP_TRACE_SPAN_END(span, "transport_write");
+	return rc;
 }
 
-static int transport_default_write(rdpTransport* transport, wStream* s)
+/* Writes length bytes to the front BIO, the caller holds the WriteLock */
+static int transport_write_layer(rdpTransport* transport, const BYTE* data, size_t length)
 {
-	size_t length;
 	int status = -1;
-	int writtenlength = 0;
-	rdpRdp* rdp;
-	rdpContext* context;
-
-	if (!s)
-		return -1;
-
-	context = transport_get_context(transport);
-	if (!transport || !context)
-		goto fail;
-
-	rdp = context->rdp;
-	if (!rdp)
-		goto fail;
-
-	EnterCriticalSection(&(transport->WriteLock));
-	if (!transport->frontBio)
-		goto out_cleanup;
-
-	length = Stream_GetPosition(s);
-	writtenlength = length;
-	Stream_SetPosition(s, 0);
-
-	if (length > 0)
-	{
-		rdp->outBytes += length;
-		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
-	}
 
 	while (length > 0)
 	{
-		status = BIO_write(transport->frontBio, Stream_Pointer(s), length);
+		const int chunk = (int)MIN(length, INT_MAX);
+		const UINT64 start = metrics_get_time_us();
+		status = BIO_write(transport->frontBio, data, chunk);
+		metrics_counter_add(transport_get_context(transport)->metrics,
+		                    FREERDP_METRIC_TRANSPORT_IO_TIME, metrics_get_time_us() - start);
 
 		if (status <= 0)
 		{
@@ -916,21 +1039,20 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 			if (!BIO_should_retry(transport->frontBio))
 			{
 				WLog_ERR_BIO(transport, "BIO_should_retry", transport->frontBio);
-				goto out_cleanup;
+				return status;
 			}
 
 			/* non-blocking can live with blocked IOs */
 			if (!transport->blocking)
 			{
 				WLog_ERR_BIO(transport, "BIO_write", transport->frontBio);
-				goto out_cleanup;
+				return status;
 			}
 
 			if (BIO_wait_write(transport->frontBio, 100) < 0)
 			{
 				WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
-				status = -1;
-				goto out_cleanup;
+				return -1;
 			}
 
 			continue;
@@ -943,24 +1065,104 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 				if (BIO_wait_write(transport->frontBio, 100) < 0)
 				{
 					WLog_Print(transport->log, WLOG_ERROR, "error when selecting for write");
-					status = -1;
-					goto out_cleanup;
+					return -1;
 				}
 
 				if (BIO_flush(transport->frontBio) < 1)
 				{
 					WLog_Print(transport->log, WLOG_ERROR, "error when flushing outputBuffer");
-					status = -1;
-					goto out_cleanup;
+					return -1;
 				}
 			}
 		}
 
-		length -= status;
-		Stream_Seek(s, status);
+		length -= (size_t)status;
+		data += status;
 	}
 
-	transport->written += writtenlength;
+	return status;
+}
+
+/* Sends the corked output, the caller holds the WriteLock */
+static int transport_cork_flush(rdpTransport* transport)
+{
+	const size_t length = Stream_GetPosition(transport->CorkBuffer);
+
+	if (length == 0)
+		return 1;
+
+	Stream_SetPosition(transport->CorkBuffer, 0);
+	return transport_write_layer(transport, Stream_Buffer(transport->CorkBuffer), length);
+}
+
+/* Queues a PDU while corked, the caller holds the WriteLock */
+static int transport_cork_write(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	wStream* s = transport->CorkBuffer;
+
+	if ((length > INT_MAX) || !Stream_EnsureRemainingCapacity(s, length))
+		return -1;
+
+	Stream_Write(s, data, length);
+
+	if (Stream_GetPosition(s) >= CORK_FLUSH_SIZE)
+		return transport_cork_flush(transport);
+
+	return (int)length;
+}
+
+/* Writes a PDU made of a header and an optional payload, length is the header plus payload
+ * size */
+static int transport_write_buffers(rdpTransport* transport, const BYTE* header,
+                                   size_t headerLength, const BYTE* data, size_t length)
+{
+	int status = -1;
+	rdpRdp* rdp;
+	rdpContext* context;
+	const size_t totalLength = headerLength + length;
+
+	context = transport_get_context(transport);
+	if (!transport || !context)
+		return -1;
+
+	rdp = context->rdp;
+	if (!rdp)
+		return -1;
+
+	EnterCriticalSection(&(transport->WriteLock));
+	if (!transport->frontBio)
+		goto out_cleanup;
+
+	if (totalLength > 0)
+	{
+		rdp->outBytes += totalLength;
+		WLog_Packet(transport->log, WLOG_TRACE, header, headerLength, WLOG_PACKET_OUTBOUND);
+
+		if (length > 0)
+			WLog_Packet(transport->log, WLOG_TRACE, data, length, WLOG_PACKET_OUTBOUND);
+	}
+
+	if ((transport->CorkDepth > 0) && (totalLength > 0))
+	{
+		status = transport_cork_write(transport, header, headerLength);
+
+		if ((status > 0) && (length > 0))
+			status = transport_cork_write(transport, data, length);
+	}
+	else
+	{
+		status = transport_write_layer(transport, header, headerLength);
+
+		if ((status > 0) && (length > 0))
+			status = transport_write_layer(transport, data, length);
+	}
+
+	if (status > 0)
+	{
+		transport->written += totalLength;
+		metrics_counter_add(context->metrics, FREERDP_METRIC_BYTES_OUT, totalLength);
+		metrics_counter_add(context->metrics, FREERDP_METRIC_PDUS_OUT, 1);
+	}
 out_cleanup:
 
 	if (status < 0)
@@ -971,11 +1173,100 @@ out_cleanup:
 	}
 
 	LeaveCriticalSection(&(transport->WriteLock));
-fail:
+	return status;
+}
+
+static int transport_default_write(rdpTransport* transport, wStream* s)
+{
+	int status;
+	size_t length;
+
+	if (!s)
+		return -1;
+
+	length = Stream_GetPosition(s);
+	Stream_SetPosition(s, 0);
+	status = transport_write_buffers(transport, Stream_Buffer(s), length, NULL, 0);
+	Stream_Release(s);
+	return status;
+}
+
+/**
+ * Sends the PDU whose headers are in s, up to the current position, followed by length bytes
+ * of data without copying them behind the headers first. While corked both end up in the same
+ * TLS record. Hooked transports still get the PDU in one stream.
+ */
+int transport_write_gather(rdpTransport* transport, wStream* s, const BYTE* data, size_t length)
+{
+	int status;
+	size_t headerLength;
+
+	if (!transport || !s || (length && !data))
+		return -1;
+
+	if (transport->io.WritePdu != transport_default_write)
+	{
+		if (!Stream_EnsureRemainingCapacity(s, length))
+			return -1;
+
+		Stream_Write(s, data, length);
+		return transport_write(transport, s);
+	}
+
+	headerLength = Stream_GetPosition(s);
+	Stream_SetPosition(s, 0);
+	status = transport_write_buffers(transport, Stream_Buffer(s), headerLength, data, length);
 	Stream_Release(s);
 	return status;
 }
 
+/**
+ * Holds back the PDUs written from now on, so that the PDUs of a frame share TLS records and
+ * socket writes. Nests, the output is sent by the matching final transport_uncork or once it
+ * grows too large. Other threads writing meanwhile are held back as well, so cork and uncork
+ * within a single call and never keep the transport corked while waiting for anything.
+ */
+BOOL transport_cork(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	transport->CorkDepth++;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return TRUE;
+}
+
+BOOL transport_uncork(rdpTransport* transport)
+{
+	int status = 1;
+
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+
+	if (transport->CorkDepth == 0)
+	{
+		WLog_Print(transport->log, WLOG_WARN, "transport_uncork without transport_cork");
+		LeaveCriticalSection(&(transport->WriteLock));
+		return FALSE;
+	}
+
+	transport->CorkDepth--;
+
+	if ((transport->CorkDepth == 0) && transport->frontBio)
+		status = transport_cork_flush(transport);
+
+	if (status < 0)
+	{
+		transport->layer = TRANSPORT_LAYER_CLOSED;
+		freerdp_set_last_error_if_not(transport_get_context(transport),
+		                              FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+	}
+
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status >= 0;
+}
+
 DWORD transport_get_event_handles(rdpTransport* transport, HANDLE* events, DWORD count)
 {
 	DWORD nCount = 1; /* always the reread Event */
@@ -1151,6 +1442,8 @@ int transport_check_fds(rdpTransport* transport)
 		}
 
 		received = transport->ReceiveBuffer;
+		metrics_counter_add(context->metrics, FREERDP_METRIC_BYTES_IN, Stream_Length(received));
+		metrics_counter_add(context->metrics, FREERDP_METRIC_PDUS_IN, 1);
 
 		if (!(transport->ReceiveBuffer = StreamPool_Take(transport->ReceivePool, 0)))
 			return -1;
@@ -1168,6 +1461,13 @@ int transport_check_fds(rdpTransport* transport)
 		/* session redirection or activation */
 		if (recv_status == 1 || recv_status == 2)
 		{
+			/* PDUs that already arrived would otherwise wait for the next socket event */
+			if (transport_read_ahead_has_pdu(transport))
+			{
+				SetEvent(transport->rereadEvent);
+				transport->haveMoreBytesToRead = TRUE;
+			}
+
 			return recv_status;
 		}
 
@@ -1231,6 +1531,16 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 
 	if (transport->tls)
 	{
+		rdpContext* context = transport_get_context(transport);
+
+		/* keep the client session for the next connection, see transport_default_connect_tls */
+		if (transport->tls->session && context && context->rdp)
+		{
+			SSL_SESSION_free(context->rdp->tlsSession);
+			context->rdp->tlsSession = transport->tls->session;
+			transport->tls->session = NULL;
+		}
+
 		tls_free(transport->tls);
 		transport->tls = NULL;
 	}
@@ -1248,11 +1558,25 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 
 	if (transport->rdg)
 	{
-		rdg_free(transport->rdg);
+		rdpContext* context = transport_get_context(transport);
+
+		/* keep the authorized tunnel, a reconnect only has to create a new channel */
+		if (context && context->rdp && rdg_release_channel(transport->rdg))
+		{
+			rdg_free(context->rdp->gatewayTunnel);
+			context->rdp->gatewayTunnel = transport->rdg;
+		}
+		else
+			rdg_free(transport->rdg);
+
 		transport->rdg = NULL;
 	}
 
 	transport->frontBio = NULL;
+	transport->ReadAheadOffset = 0;
+	transport->ReadAheadLength = 0;
+	if (transport->CorkBuffer)
+		Stream_SetPosition(transport->CorkBuffer, 0);
 	transport->layer = TRANSPORT_LAYER_TCP;
 	return status;
 }
@@ -1293,6 +1617,16 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!transport->ReceiveBuffer)
 		goto fail;
 
+	transport->ReadAhead = (BYTE*)malloc(READ_AHEAD_SIZE);
+
+	if (!transport->ReadAhead)
+		goto fail;
+
+	transport->CorkBuffer = Stream_New(NULL, CORK_FLUSH_SIZE);
+
+	if (!transport->CorkBuffer)
+		goto fail;
+
 	transport->connectedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
 	if (!transport->connectedEvent || transport->connectedEvent == INVALID_HANDLE_VALUE)
@@ -1331,6 +1665,8 @@ void transport_free(rdpTransport* transport)
 		Stream_Release(transport->ReceiveBuffer);
 
 	nla_free(transport->nla);
+	free(transport->ReadAhead);
+	Stream_Free(transport->CorkBuffer, TRUE);
 	StreamPool_Free(transport->ReceivePool);
 	CloseHandle(transport->connectedEvent);
 	CloseHandle(transport->rereadEvent);
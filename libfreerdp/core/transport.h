@@ -66,6 +66,10 @@ FREERDP_LOCAL BOOL transport_accept_nla(rdpTransport* transport);
 
 FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
+FREERDP_LOCAL int transport_write_gather(rdpTransport* transport, wStream* s, const BYTE* data,
+                                         size_t length);
+FREERDP_LOCAL BOOL transport_cork(rdpTransport* transport);
+FREERDP_LOCAL BOOL transport_uncork(rdpTransport* transport);
 
 #if defined(WITH_FREERDP_DEPRECATED)
 FREERDP_LOCAL void transport_get_fds(rdpTransport* transport, void** rfds, int* rcount);
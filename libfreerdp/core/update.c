@@ -32,6 +32,7 @@
 #include "message.h"
 #include "info.h"
 #include "window.h"
+#include "connection.h"
 
 #include <freerdp/log.h>
 #include <freerdp/peer.h>
@@ -78,7 +79,7 @@ static BOOL update_recv_orders(rdpUpdate* update, wStream* s)
 		numberOrders--;
 	}
 
-	return TRUE;
+	return update_flush_orders_batch(update);
 }
 
 static BOOL update_read_bitmap_data(rdpUpdate* update, wStream* s, BITMAP_DATA* bitmapData)
@@ -778,6 +779,9 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 	if (!update_begin_paint(update))
 		goto fail;
 
+	if ((updateType == UPDATE_TYPE_ORDERS) || (updateType == UPDATE_TYPE_BITMAP))
+		rdp_first_update_received(context->rdp);
+
 	switch (updateType)
 	{
 		case UPDATE_TYPE_ORDERS:
@@ -794,8 +798,11 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 				goto fail;
 			}
 
+			update_offer_parsed(update, bitmap_update);
 			rc = IFCALLRESULT(FALSE, update->BitmapUpdate, context, bitmap_update);
-			free_bitmap_update(update->context, bitmap_update);
+
+			if (update_withdraw_parsed(update, bitmap_update))
+				free_bitmap_update(update->context, bitmap_update);
 		}
 		break;
 
@@ -1271,6 +1278,8 @@ static BOOL update_send_surface_frame_marker(rdpContext* context,
 		goto out_fail;
 
 	update_force_flush(context);
+	if (surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_END)
+		metrics_frame_sent(context->metrics, surfaceFrameMarker->frameId);
 	ret = TRUE;
 out_fail:
 	Stream_Release(s);
@@ -1307,6 +1316,8 @@ static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BI
 	ret = fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s,
 	                               cmd->skipCompression);
 	update_force_flush(context);
+	if (ret && last)
+		metrics_frame_sent(context->metrics, frameId);
 out_fail:
 	Stream_Release(s);
 	return ret;
@@ -3089,6 +3100,11 @@ rdpUpdate* update_new(rdpRdp* rdp)
 	if (!update->queue)
 		goto fail;
 
+	update->payloadPool = StreamPool_New(TRUE, 0);
+
+	if (!update->payloadPool)
+		goto fail;
+
 	return &update->common;
 fail:
 	update_free(&update->common);
@@ -3125,12 +3141,109 @@ void update_free(rdpUpdate* update)
 			free(update->window);
 		}
 
+		/* queued messages may still reference payloads, free them first */
 		MessageQueue_Free(up->queue);
+		StreamPool_Free(up->payloadPool);
 		DeleteCriticalSection(&up->mux);
 		free(update);
 	}
 }
 
+/**
+ * Payload streams hold received update data while it is parsed. They come from a pool owned
+ * by the update, which outlives the message queue, so the message proxy can keep a reference
+ * to a payload instead of copying the data it points to.
+ */
+wStream* update_new_payload(rdpUpdate* update, size_t size)
+{
+	rdp_update_internal* up = update_cast(update);
+	wStream* s = StreamPool_Take(up->payloadPool, size);
+
+	if (s)
+		Stream_SetPosition(s, 0);
+
+	return s;
+}
+
+void update_set_payload(rdpUpdate* update, wStream* s)
+{
+	rdp_update_internal* up = update_cast(update);
+	up->payload = s;
+	up->payloadReferenced = FALSE;
+}
+
+/**
+ * Ends the processing of the current payload.
+ *
+ * @return TRUE if the payload is still referenced and must not be reused
+ */
+BOOL update_clear_payload(rdpUpdate* update)
+{
+	rdp_update_internal* up = update_cast(update);
+	const BOOL referenced = up->payloadReferenced;
+
+	up->payload = NULL;
+	up->payloadReferenced = FALSE;
+	return referenced;
+}
+
+/**
+ * Takes a reference on the current payload if data lies within it.
+ *
+ * @return the referenced payload, NULL if the data has to be copied
+ */
+wStream* update_ref_payload(rdpUpdate* update, const BYTE* data, size_t length)
+{
+	const BYTE* start;
+	rdp_update_internal* up = update_cast(update);
+
+	if (!up->payload || !data)
+		return NULL;
+
+	start = Stream_Buffer(up->payload);
+
+	if ((data < start) || (length > Stream_Capacity(up->payload)) ||
+	    ((size_t)(data - start) > Stream_Capacity(up->payload) - length))
+		return NULL;
+
+	Stream_AddRef(up->payload);
+	up->payloadReferenced = TRUE;
+	return up->payload;
+}
+
+/**
+ * A parsed update offered around its callback can be kept by the message proxy, which then
+ * frees it after dispatching instead of the parser.
+ */
+void update_offer_parsed(rdpUpdate* update, void* parsed)
+{
+	rdp_update_internal* up = update_cast(update);
+	up->parsed = parsed;
+}
+
+BOOL update_take_parsed(rdpUpdate* update, const void* parsed)
+{
+	rdp_update_internal* up = update_cast(update);
+
+	if (!parsed || (up->parsed != parsed))
+		return FALSE;
+
+	up->parsed = NULL;
+	return TRUE;
+}
+
+/**
+ * @return TRUE if the parser still owns the parsed update and has to free it
+ */
+BOOL update_withdraw_parsed(rdpUpdate* update, const void* parsed)
+{
+	rdp_update_internal* up = update_cast(update);
+	const BOOL owned = (up->parsed == parsed);
+
+	up->parsed = NULL;
+	return owned;
+}
+
 void rdp_update_lock(rdpUpdate* update)
 {
 	rdp_update_internal* up = update_cast(update);
@@ -3143,9 +3256,46 @@ void rdp_update_unlock(rdpUpdate* update)
 	LeaveCriticalSection(&up->mux);
 }
 
+/**
+ * Sends an already serialized fastpath update, e.g. a payload received by
+ * rdpUpdate::FastPathUpdate on another connection.
+ * Bulk compression, fragmentation and encryption are done for this connection.
+ */
+BOOL rdp_update_send_fastpath(rdpUpdate* update, BYTE updateCode, const BYTE* data, size_t length)
+{
+	wStream* s;
+	rdpRdp* rdp;
+	BOOL ret = FALSE;
+
+	WINPR_ASSERT(update);
+	WINPR_ASSERT(update->context);
+	WINPR_ASSERT(data || (length == 0));
+
+	rdp = update->context->rdp;
+	WINPR_ASSERT(rdp);
+
+	update_force_flush(update->context);
+	s = fastpath_update_pdu_init(rdp->fastpath);
+
+	if (!s)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, length))
+		goto out_fail;
+
+	Stream_Write(s, data, length);
+	ret = fastpath_send_update_pdu(rdp->fastpath, updateCode, s, FALSE);
+out_fail:
+	Stream_Release(s);
+	return ret;
+}
+
 BOOL update_begin_paint(rdpUpdate* update)
 {
+	rdp_update_internal* up = update_cast(update);
+
 	rdp_update_lock(update);
+	up->paintStart = metrics_get_time_us();
 
 	if (!update->BeginPaint)
 		return TRUE;
@@ -3156,12 +3306,28 @@ BOOL update_begin_paint(rdpUpdate* update)
 BOOL update_end_paint(rdpUpdate* update)
 {
 	BOOL rc = FALSE;
+	UINT64 start;
+	rdpContext* context;
+	rdp_update_internal* up;
 
 	if (!update)
 		return FALSE;
 
+	up = update_cast(update);
+	context = update->context;
+	start = metrics_get_time_us();
+
 	if (update->EndPaint)
-		rc = update->EndPaint(update->context);
+		rc = update->EndPaint(context);
+
+	/* On the client side the updates between begin and end paint were just decoded */
+	if (context && !context->settings->ServerMode)
+	{
+		const UINT64 end = metrics_get_time_us();
+		metrics_histogram_record(context->metrics, FREERDP_METRIC_DECODE_TIME,
+		                         start - up->paintStart);
+		metrics_histogram_record(context->metrics, FREERDP_METRIC_PRESENT_TIME, end - start);
+	}
 
 	rdp_update_unlock(update);
 	return rc;
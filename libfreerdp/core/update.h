@@ -35,6 +35,8 @@
 #define UPDATE_TYPE_PALETTE 0x0002
 #define UPDATE_TYPE_SYNCHRONIZE 0x0003
 
+#define ORDERS_BATCH_MAX 256
+
 #define BITMAP_COMPRESSION 0x0001
 #define NO_BITMAP_COMPRESSION_HDR 0x0400
 
@@ -59,7 +61,14 @@ typedef struct
 	BOOL combineUpdates;
 	rdpBounds currentBounds;
 	rdpBounds previousBounds;
+	UINT64 paintStart;
 	CRITICAL_SECTION mux;
+
+	/* received update payloads, referenced by the message proxy instead of copied */
+	wStreamPool* payloadPool;
+	wStream* payload;
+	BOOL payloadReferenced;
+	void* parsed; /* parsed update the message proxy may keep instead of copying */
 } rdp_update_internal;
 
 typedef struct
@@ -107,6 +116,21 @@ typedef struct
 	POLYGON_CB_ORDER polygon_cb;
 	ELLIPSE_SC_ORDER ellipse_sc;
 	ELLIPSE_CB_ORDER ellipse_cb;
+
+	/* storage of the orders collected for rdpPrimaryUpdate::OrdersBatch */
+	ORDERS_BATCH batch;
+	UINT32 batchOrderType[ORDERS_BATCH_MAX];
+	UINT32 batchIndex[ORDERS_BATCH_MAX];
+	BOOL batchHasBounds[ORDERS_BATCH_MAX];
+	rdpBounds batchBounds[ORDERS_BATCH_MAX];
+	UINT32 batchDstbltCount;
+	UINT32 batchScrbltCount;
+	UINT32 batchOpaqueRectCount;
+	UINT32 batchMembltCount;
+	DSTBLT_ORDER batchDstblt[ORDERS_BATCH_MAX];
+	SCRBLT_ORDER batchScrblt[ORDERS_BATCH_MAX];
+	OPAQUE_RECT_ORDER batchOpaqueRect[ORDERS_BATCH_MAX];
+	MEMBLT_ORDER batchMemblt[ORDERS_BATCH_MAX];
 } rdp_primary_update_internal;
 
 typedef struct
@@ -195,6 +219,15 @@ FREERDP_LOCAL void update_register_server_callbacks(rdpUpdate* update);
 FREERDP_LOCAL void update_register_client_callbacks(rdpUpdate* update);
 FREERDP_LOCAL int update_process_messages(rdpUpdate* update);
 
+FREERDP_LOCAL wStream* update_new_payload(rdpUpdate* update, size_t size);
+FREERDP_LOCAL void update_set_payload(rdpUpdate* update, wStream* s);
+FREERDP_LOCAL BOOL update_clear_payload(rdpUpdate* update);
+FREERDP_LOCAL wStream* update_ref_payload(rdpUpdate* update, const BYTE* data, size_t length);
+
+FREERDP_LOCAL void update_offer_parsed(rdpUpdate* update, void* parsed);
+FREERDP_LOCAL BOOL update_take_parsed(rdpUpdate* update, const void* parsed);
+FREERDP_LOCAL BOOL update_withdraw_parsed(rdpUpdate* update, const void* parsed);
+
 FREERDP_LOCAL BOOL update_begin_paint(rdpUpdate* update);
 FREERDP_LOCAL BOOL update_end_paint(rdpUpdate* update);
 
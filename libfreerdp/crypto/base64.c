@@ -22,179 +22,55 @@
 #include <winpr/crt.h>
 
 #include <freerdp/crypto/crypto.h>
-
-static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#include <freerdp/primitives.h>
 
 char* crypto_base64_encode(const BYTE* data, size_t length)
 {
-	int c;
-	const BYTE* q;
-	char* p;
 	char* ret;
-	int i = 0;
-	int blocks;
+	const size_t outputLen = (length + 2) / 3 * 4;
+	primitives_t* prims = primitives_get();
 
-	q = data;
-	p = ret = (char*)malloc((length + 3) * 4 / 3 + 1);
-	if (!p)
+	if (!prims || (length > UINT32_MAX / 4 * 3))
 		return NULL;
 
-	/* b1, b2, b3 are input bytes
-	 *
-	 * 0         1         2
-	 * 012345678901234567890123
-	 * |  b1  |  b2   |  b3   |
-	 *
-	 * [ c1 ]     [  c3 ]
-	 *      [  c2 ]     [  c4 ]
-	 *
-	 * c1, c2, c3, c4 are output chars in base64
-	 */
-
-	/* first treat complete blocks */
-	blocks = length - (length % 3);
-	for (i = 0; i < blocks; i += 3, q += 3)
-	{
-		c = (q[0] << 16) + (q[1] << 8) + q[2];
-
-		*p++ = base64[(c & 0x00FC0000) >> 18];
-		*p++ = base64[(c & 0x0003F000) >> 12];
-		*p++ = base64[(c & 0x00000FC0) >> 6];
-		*p++ = base64[c & 0x0000003F];
-	}
+	ret = (char*)malloc(outputLen + 1);
+	if (!ret)
+		return NULL;
 
-	/* then remainder */
-	switch (length % 3)
+	if (prims->base64Encode(data, (UINT32)length, ret) != PRIMITIVES_SUCCESS)
 	{
-		case 0:
-			break;
-		case 1:
-			c = (q[0] << 16);
-			*p++ = base64[(c & 0x00FC0000) >> 18];
-			*p++ = base64[(c & 0x0003F000) >> 12];
-			*p++ = '=';
-			*p++ = '=';
-			break;
-		case 2:
-			c = (q[0] << 16) + (q[1] << 8);
-			*p++ = base64[(c & 0x00FC0000) >> 18];
-			*p++ = base64[(c & 0x0003F000) >> 12];
-			*p++ = base64[(c & 0x00000FC0) >> 6];
-			*p++ = '=';
-			break;
+		free(ret);
+		return NULL;
 	}
 
-	*p = 0;
-
+	ret[outputLen] = 0;
 	return ret;
 }
 
-static int base64_decode_char(char c)
-{
-	if (c >= 'A' && c <= 'Z')
-		return c - 'A';
-
-	if (c >= 'a' && c <= 'z')
-		return c - 'a' + 26;
-
-	if (c >= '0' && c <= '9')
-		return c - '0' + 52;
-
-	if (c == '+')
-		return 62;
-
-	if (c == '/')
-		return 63;
-
-	if (c == '=')
-		return -1;
-
-	return -1;
-}
-
 static void* base64_decode(const char* s, size_t length, size_t* data_len)
 {
-	int n[4];
-	BYTE* q;
 	BYTE* data;
-	size_t nBlocks, i, outputLen;
+	UINT32 outputLen = 0;
+	primitives_t* prims = primitives_get();
 
-	if (length % 4)
+	if (!prims || (length % 4) || (length < 4) || (length > UINT32_MAX))
 		return NULL;
 
-	q = data = (BYTE*)malloc(length / 4 * 3 + 1);
-	if (!q)
+	data = (BYTE*)malloc(length / 4 * 3 + 1);
+	if (!data)
 		return NULL;
 
-	/* first treat complete blocks */
-	nBlocks = (length / 4);
-	outputLen = 0;
-
-	if (nBlocks < 1)
+	if (prims->base64Decode(s, (UINT32)length, data, &outputLen) != PRIMITIVES_SUCCESS)
 	{
 		free(data);
 		return NULL;
 	}
 
-	for (i = 0; i < nBlocks - 1; i++, q += 3)
-	{
-		n[0] = base64_decode_char(*s++);
-		n[1] = base64_decode_char(*s++);
-		n[2] = base64_decode_char(*s++);
-		n[3] = base64_decode_char(*s++);
-
-		if ((n[0] == -1) || (n[1] == -1) || (n[2] == -1) || (n[3] == -1))
-			goto out_free;
-
-		q[0] = (n[0] << 2) + (n[1] >> 4);
-		q[1] = ((n[1] & 15) << 4) + (n[2] >> 2);
-		q[2] = ((n[2] & 3) << 6) + n[3];
-		outputLen += 3;
-	}
-
-	/* treat last block */
-	n[0] = base64_decode_char(*s++);
-	n[1] = base64_decode_char(*s++);
-	if ((n[0] == -1) || (n[1] == -1))
-		goto out_free;
-
-	n[2] = base64_decode_char(*s++);
-	n[3] = base64_decode_char(*s++);
-
-	q[0] = (n[0] << 2) + (n[1] >> 4);
-	if (n[2] == -1)
-	{
-		/* XX== */
-		outputLen += 1;
-		if (n[3] != -1)
-			goto out_free;
-
-		q[1] = ((n[1] & 15) << 4);
-	}
-	else if (n[3] == -1)
-	{
-		/* yyy= */
-		outputLen += 2;
-		q[1] = ((n[1] & 15) << 4) + (n[2] >> 2);
-		q[2] = ((n[2] & 3) << 6);
-	}
-	else
-	{
-		/* XXXX */
-		outputLen += 3;
-		q[0] = (n[0] << 2) + (n[1] >> 4);
-		q[1] = ((n[1] & 15) << 4) + (n[2] >> 2);
-		q[2] = ((n[2] & 3) << 6) + n[3];
-	}
-
 	if (data_len)
 		*data_len = outputLen;
 	data[outputLen] = '\0';
 
 	return data;
-out_free:
-	free(data);
-	return NULL;
 }
 
 void crypto_base64_decode(const char* enc_data, size_t length, BYTE** dec_data, size_t* res_length)
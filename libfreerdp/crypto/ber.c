@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <winpr/crt.h>
 #include <winpr/string.h>
+#include <winpr/assert.h>
 
 #include <freerdp/log.h>
 #include <freerdp/crypto/ber.h>
@@ -96,6 +97,102 @@ size_t _ber_sizeof_length(size_t length)
 	return 1;
 }
 
+/**
+ * Start a constructed element whose length is not known yet. A single length byte is
+ * reserved, ber_write_end() fills it in once the content has been written.
+ * @param s stream
+ * @param identifier the identifier octet(s) of the element
+ * @param count number of identifier octets
+ * @param mark receives the position of the length, pass it to ber_write_end()
+ */
+
+static BOOL ber_write_begin(wStream* s, const BYTE* identifier, size_t count, size_t* mark)
+{
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(mark);
+
+	if (!Stream_EnsureRemainingCapacity(s, count + 1))
+		return FALSE;
+
+	Stream_Write(s, identifier, count);
+	*mark = Stream_GetPosition(s);
+	Stream_Write_UINT8(s, 0);
+	return TRUE;
+}
+
+BOOL ber_write_sequence_begin(wStream* s, size_t* mark)
+{
+	const BYTE identifier = (BER_CLASS_UNIV | BER_CONSTRUCT) | (BER_TAG_MASK & BER_TAG_SEQUENCE);
+	return ber_write_begin(s, &identifier, 1, mark);
+}
+
+BOOL ber_write_contextual_begin(wStream* s, BYTE tag, size_t* mark)
+{
+	const BYTE identifier = (BER_CLASS_CTXT | BER_CONSTRUCT) | (BER_TAG_MASK & tag);
+	return ber_write_begin(s, &identifier, 1, mark);
+}
+
+BOOL ber_write_application_begin(wStream* s, BYTE tag, size_t* mark)
+{
+	BYTE identifier[2] = { (BER_CLASS_APPL | BER_CONSTRUCT) | BER_TAG_MASK, tag };
+
+	if (tag > 30)
+		return ber_write_begin(s, identifier, 2, mark);
+
+	identifier[0] = (BER_CLASS_APPL | BER_CONSTRUCT) | (BER_TAG_MASK & tag);
+	return ber_write_begin(s, identifier, 1, mark);
+}
+
+BOOL ber_write_octet_string_begin(wStream* s, size_t* mark)
+{
+	const BYTE identifier =
+	    (BER_CLASS_UNIV | BER_PRIMITIVE) | (BER_TAG_MASK & BER_TAG_OCTET_STRING);
+	return ber_write_begin(s, &identifier, 1, mark);
+}
+
+/**
+ * Finish an element started with one of the ber_write_*_begin() functions. Content longer
+ * than 127 bytes is moved up to make room for the long form of the length.
+ * @param s stream, positioned at the end of the content
+ * @param mark position returned by the begin function
+ */
+
+BOOL ber_write_end(wStream* s, size_t mark)
+{
+	size_t extra;
+	size_t length;
+	const size_t end = Stream_GetPosition(s);
+
+	WINPR_ASSERT(s);
+
+	if (end < mark + 1)
+		return FALSE;
+
+	length = end - mark - 1;
+
+	/* ber_read_length only understands up to two length octets */
+	if (length > UINT16_MAX)
+		return FALSE;
+
+	extra = _ber_sizeof_length(length) - 1;
+
+	if (extra > 0)
+	{
+		BYTE* buffer;
+
+		if (!Stream_EnsureRemainingCapacity(s, extra))
+			return FALSE;
+
+		buffer = Stream_Buffer(s);
+		MoveMemory(&buffer[mark + 1 + extra], &buffer[mark + 1], length);
+	}
+
+	Stream_SetPosition(s, mark);
+	ber_write_length(s, length);
+	Stream_SetPosition(s, end + extra);
+	return TRUE;
+}
+
 /**
  * Read BER Universal tag.
  * @param s stream
@@ -441,6 +538,26 @@ BOOL ber_read_octet_string(wStream* s, BYTE** content, size_t* length)
 	return TRUE;
 }
 
+/**
+ * Read a BER OCTET_STRING without copying it
+ * @param s stream, advanced past the string
+ * @param content receives a pointer to the string inside the stream
+ * @param length receives the string length
+ */
+
+BOOL ber_read_octet_string_ref(wStream* s, const BYTE** content, size_t* length)
+{
+	WINPR_ASSERT(content);
+	WINPR_ASSERT(length);
+
+	if (!ber_read_octet_string_tag(s, length) || Stream_GetRemainingLength(s) < *length)
+		return FALSE;
+
+	*content = Stream_Pointer(s);
+	Stream_Seek(s, *length);
+	return TRUE;
+}
+
 size_t ber_write_octet_string_tag(wStream* s, size_t length)
 {
 	ber_write_universal_tag(s, BER_TAG_OCTET_STRING, FALSE);
@@ -19,6 +19,8 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/crt.h>
+
 #include <freerdp/crypto/per.h>
 
 /**
@@ -78,6 +80,57 @@ BOOL per_write_length(wStream* s, UINT16 length)
 	return TRUE;
 }
 
+/**
+ * Reserve a PER length that is only known once the content has been written.
+ * @param s stream
+ * @param mark receives the position of the length, pass it to per_write_length_end()
+ */
+
+BOOL per_write_length_begin(wStream* s, size_t* mark)
+{
+	if (!Stream_EnsureRemainingCapacity(s, 2))
+		return FALSE;
+
+	*mark = Stream_GetPosition(s);
+	Stream_Zero(s, 2);
+	return TRUE;
+}
+
+/**
+ * Fill in a length reserved with per_write_length_begin(), short content is moved down
+ * by one byte for the single byte form.
+ * @param s stream, positioned at the end of the content
+ * @param mark position returned by per_write_length_begin()
+ */
+
+BOOL per_write_length_end(wStream* s, size_t mark)
+{
+	size_t length;
+	const size_t end = Stream_GetPosition(s);
+
+	if (end < mark + 2)
+		return FALSE;
+
+	length = end - mark - 2;
+
+	if (length > 0x7FFF)
+		return FALSE;
+
+	if (length <= 0x7F)
+	{
+		BYTE* buffer = Stream_Buffer(s);
+		MoveMemory(&buffer[mark + 1], &buffer[mark + 2], length);
+		buffer[mark] = (BYTE)length;
+		Stream_SetPosition(s, end - 1);
+		return TRUE;
+	}
+
+	Stream_SetPosition(s, mark);
+	Stream_Write_UINT16_BE(s, (UINT16)(length | 0x8000));
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
 /**
  * Read PER choice.
  * @param s stream
@@ -462,7 +515,6 @@ BOOL per_read_octet_string(wStream* s, const BYTE* oct_str, UINT16 length, UINT1
 
 BOOL per_write_octet_string(wStream* s, const BYTE* oct_str, UINT16 length, UINT16 min)
 {
-	UINT16 i;
 	UINT16 mlength;
 
 	mlength = (length >= min) ? length - min : min;
@@ -472,8 +524,7 @@ BOOL per_write_octet_string(wStream* s, const BYTE* oct_str, UINT16 length, UINT
 
 	if (!Stream_EnsureRemainingCapacity(s, length))
 		return FALSE;
-	for (i = 0; i < length; i++)
-		Stream_Write_UINT8(s, oct_str[i]);
+	Stream_Write(s, oct_str, length);
 	return TRUE;
 }
 
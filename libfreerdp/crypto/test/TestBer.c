@@ -0,0 +1,197 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/crypto/ber.h>
+#include <freerdp/crypto/per.h>
+
+static const size_t test_lengths[] = { 0, 1, 100, 120, 121, 127, 128, 200, 255, 256, 1000, 40000 };
+
+/* [3] { SEQUENCE { OCTET STRING } } written with precomputed lengths */
+static BOOL test_write_two_pass(wStream* s, const BYTE* data, size_t length)
+{
+	const size_t octetString = ber_sizeof_octet_string(length);
+	const size_t sequence = ber_sizeof_sequence(octetString);
+
+	if (!Stream_EnsureRemainingCapacity(s, 16 + sequence))
+		return FALSE;
+
+	ber_write_application_tag(s, 101, ber_sizeof_contextual_tag(sequence) + sequence);
+	ber_write_contextual_tag(s, 3, sequence, TRUE);
+	ber_write_sequence_tag(s, octetString);
+	ber_write_octet_string(s, data, length);
+	return TRUE;
+}
+
+static BOOL test_write_single_pass(wStream* s, const BYTE* data, size_t length)
+{
+	size_t application, contextual, sequence, octetString;
+
+	if (!ber_write_application_begin(s, 101, &application) ||
+	    !ber_write_contextual_begin(s, 3, &contextual) ||
+	    !ber_write_sequence_begin(s, &sequence) || !ber_write_octet_string_begin(s, &octetString))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, length))
+		return FALSE;
+
+	Stream_Write(s, data, length);
+	return ber_write_end(s, octetString) && ber_write_end(s, sequence) &&
+	       ber_write_end(s, contextual) && ber_write_end(s, application);
+}
+
+static BOOL test_ber_writers(const BYTE* data)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	wStream* s1 = Stream_New(NULL, 16);
+	wStream* s2 = Stream_New(NULL, 16);
+
+	if (!s1 || !s2)
+		goto fail;
+
+	for (x = 0; x < ARRAYSIZE(test_lengths); x++)
+	{
+		size_t length;
+		const BYTE* content;
+
+		Stream_SetPosition(s1, 0);
+		Stream_SetPosition(s2, 0);
+
+		if (!test_write_two_pass(s1, data, test_lengths[x]) ||
+		    !test_write_single_pass(s2, data, test_lengths[x]))
+			goto fail;
+
+		if ((Stream_GetPosition(s1) != Stream_GetPosition(s2)) ||
+		    (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), Stream_GetPosition(s1)) != 0))
+		{
+			printf("BER mismatch for length %" PRIuz "\n", test_lengths[x]);
+			goto fail;
+		}
+
+		/* read back, the octet string is not copied */
+		Stream_SealLength(s2);
+		Stream_SetPosition(s2, 0);
+
+		if (!ber_read_application_tag(s2, 101, &length) ||
+		    !ber_read_contextual_tag(s2, 3, &length, TRUE) ||
+		    !ber_read_sequence_tag(s2, &length) ||
+		    !ber_read_octet_string_ref(s2, &content, &length))
+			goto fail;
+
+		if ((length != test_lengths[x]) || (Stream_GetRemainingLength(s2) != 0) ||
+		    ((length > 0) &&
+		     ((content < Stream_Buffer(s2)) || (memcmp(content, data, length) != 0))))
+		{
+			printf("BER read back failed for length %" PRIuz "\n", test_lengths[x]);
+			goto fail;
+		}
+	}
+
+	/* a truncated octet string fails */
+	Stream_SetLength(s2, Stream_Length(s2) - 1);
+	Stream_SetPosition(s2, 0);
+	{
+		size_t length;
+		const BYTE* content;
+
+		if (ber_read_application_tag(s2, 101, &length) &&
+		    ber_read_contextual_tag(s2, 3, &length, TRUE) && ber_read_sequence_tag(s2, &length) &&
+		    ber_read_octet_string_ref(s2, &content, &length))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s1, TRUE);
+	Stream_Free(s2, TRUE);
+	return rc;
+}
+
+static BOOL test_per_length(const BYTE* data)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	wStream* s1 = Stream_New(NULL, 16);
+	wStream* s2 = Stream_New(NULL, 16);
+
+	if (!s1 || !s2)
+		goto fail;
+
+	for (x = 0; x < ARRAYSIZE(test_lengths); x++)
+	{
+		size_t mark;
+		const size_t length = test_lengths[x];
+
+		if (length > 0x7FFF)
+			continue;
+
+		Stream_SetPosition(s1, 0);
+		Stream_SetPosition(s2, 0);
+
+		if (!per_write_length(s1, (UINT16)length) || !Stream_EnsureRemainingCapacity(s1, length))
+			goto fail;
+		Stream_Write(s1, data, length);
+
+		if (!per_write_length_begin(s2, &mark) || !Stream_EnsureRemainingCapacity(s2, length))
+			goto fail;
+		Stream_Write(s2, data, length);
+		if (!per_write_length_end(s2, mark))
+			goto fail;
+
+		if ((Stream_GetPosition(s1) != Stream_GetPosition(s2)) ||
+		    (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), Stream_GetPosition(s1)) != 0))
+		{
+			printf("PER mismatch for length %" PRIuz "\n", length);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s1, TRUE);
+	Stream_Free(s2, TRUE);
+	return rc;
+}
+
+int TestBer(int argc, char* argv[])
+{
+	size_t x;
+	BYTE* data;
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(data = malloc(40000)))
+		return -1;
+
+	for (x = 0; x < 40000; x++)
+		data[x] = (BYTE)(x * 7);
+
+	if (!test_ber_writers(data))
+		goto fail;
+
+	if (!test_per_length(data))
+		goto fail;
+
+	rc = 0;
+fail:
+	free(data);
+	return rc;
+}
@@ -27,6 +27,8 @@
 #include <winpr/string.h>
 #include <winpr/sspi.h>
 #include <winpr/ssl.h>
+#include <winpr/sysinfo.h>
+#include <winpr/synch.h>
 
 #include <winpr/stream.h>
 #include <freerdp/utils/ringbuffer.h>
@@ -36,6 +38,8 @@
 #include "../core/tcp.h"
 #include "opensslcompat.h"
 
+#include <openssl/rand.h>
+
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
@@ -46,6 +50,9 @@
 
 #define TAG FREERDP_TAG("crypto")
 
+/* key name, HMAC and AES key of the session ticket keys */
+#define TLS_TICKET_KEYS_LENGTH 80
+
 /**
  * Earlier Microsoft iOS RDP clients have sent a null or even double null
  * terminated hostname in the SNI TLS extension.
@@ -68,10 +75,23 @@
  * #define MICROSOFT_IOS_SNI_BUG
  */
 
+/**
+ * Record sizing: after an idle period the congestion window of the socket is small again, and
+ * a full 16k record can only be decrypted once all of its segments arrived. Until
+ * TLS_SMALL_RECORD_BYTES were sent, records are kept small enough to fit one TCP segment
+ * together with the TLS overhead, so input echo and cursor updates are not held up behind a
+ * half received record. Bulk transfers afterwards use the full record size.
+ */
+#define TLS_SMALL_RECORD_SIZE 1360
+#define TLS_SMALL_RECORD_BYTES (128 * 1024)
+#define TLS_IDLE_RESET_MS 1000
+
 typedef struct
 {
 	SSL* ssl;
 	CRITICAL_SECTION lock;
+	UINT64 lastWrite;
+	size_t sinceIdle;
 } BIO_RDP_TLS;
 
 static int tls_verify_certificate(rdpTls* tls, CryptoCert cert, const char* hostname, UINT16 port);
@@ -92,8 +112,36 @@ static int bio_rdp_tls_write(BIO* bio, const char* buf, int size)
 
 	BIO_clear_flags(bio, BIO_FLAGS_WRITE | BIO_FLAGS_READ | BIO_FLAGS_IO_SPECIAL);
 	EnterCriticalSection(&tls->lock);
-	status = SSL_write(tls->ssl, buf, size);
-	error = SSL_get_error(tls->ssl, status);
+	{
+		const UINT64 now = GetTickCount64();
+		int offset = 0;
+
+		if (now - tls->lastWrite > TLS_IDLE_RESET_MS)
+			tls->sinceIdle = 0;
+
+		tls->lastWrite = now;
+
+		/* one SSL_write per record while ramping up, the rest in a single call */
+		do
+		{
+			int chunk = size - offset;
+
+			if (tls->sinceIdle < TLS_SMALL_RECORD_BYTES)
+				chunk = MIN(chunk, TLS_SMALL_RECORD_SIZE);
+
+			status = SSL_write(tls->ssl, &buf[offset], chunk);
+			error = SSL_get_error(tls->ssl, status);
+
+			if (status <= 0)
+				break;
+
+			offset += status;
+			tls->sinceIdle += (size_t)status;
+		} while (offset < size);
+
+		if (offset > 0)
+			status = offset;
+	}
 	LeaveCriticalSection(&tls->lock);
 
 	if (status <= 0)
@@ -672,7 +720,27 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 	SSL_CTX_set_security_level(tls->ctx, settings->TlsSecLevel);
 #endif
 
-	if (settings->AllowedTlsCiphers)
+	if (tls->isTunneled && settings->GatewayInnerTlsCiphers)
+	{
+		/* The gateway already encrypts the tunnel, policy may pick cheaper ciphers for the
+		 * RDP TLS layer inside it */
+		if (!SSL_CTX_set_cipher_list(tls->ctx, settings->GatewayInnerTlsCiphers))
+		{
+			WLog_ERR(TAG, "SSL_CTX_set_cipher_list %s failed", settings->GatewayInnerTlsCiphers);
+			return FALSE;
+		}
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+		/* TLS 1.3 suites are not part of the cipher list, offer ChaCha20 first if asked to */
+		if (strstr(settings->GatewayInnerTlsCiphers, "CHACHA20") &&
+		    !SSL_CTX_set_ciphersuites(tls->ctx, "TLS_CHACHA20_POLY1305_SHA256:"
+		                                        "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384"))
+		{
+			WLog_ERR(TAG, "SSL_CTX_set_ciphersuites failed");
+			return FALSE;
+		}
+#endif
+	}
+	else if (settings->AllowedTlsCiphers)
 	{
 		if (!SSL_CTX_set_cipher_list(tls->ctx, settings->AllowedTlsCiphers))
 		{
@@ -823,9 +891,90 @@ out:
 	return verify_status;
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+#define TLS_SESSION_RESUMPTION
+
+/**
+ * Keeps the latest session (ticket) the server handed out, with TLS 1.3 these
+ * arrive after the handshake so they can not be fetched once tls_connect returns.
+ */
+static int tls_new_session_cb(SSL* ssl, SSL_SESSION* session)
+{
+	rdpTls* tls = (rdpTls*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+	if (!tls || !SSL_SESSION_is_resumable(session))
+		return 0;
+
+	/* servers rarely acknowledge SNI, remember which host the session belongs to */
+	if (tls->hostname && (SSL_SESSION_set1_hostname(session, tls->hostname) != 1))
+		return 0;
+
+	SSL_SESSION_free(tls->session);
+	tls->session = session;
+	return 1;
+}
+
+static void tls_prepare_session_resumption(rdpTls* tls)
+{
+	const char* hostname;
+
+	SSL_CTX_set_app_data(tls->ctx, tls);
+	SSL_CTX_set_session_cache_mode(tls->ctx,
+	                               SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(tls->ctx, tls_new_session_cb);
+
+	if (!tls->session)
+		return;
+
+	/* only resume a session with the server it was established with */
+	hostname = SSL_SESSION_get0_hostname(tls->session);
+
+	if (!hostname || !tls->hostname || (_stricmp(hostname, tls->hostname) != 0) ||
+	    (SSL_set_session(tls->ssl, tls->session) != 1))
+	{
+		SSL_SESSION_free(tls->session);
+		tls->session = NULL;
+	}
+}
+
+static BOOL CALLBACK tls_init_ticket_keys(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	BYTE* keys = (BYTE*)param;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(context);
+	return RAND_bytes(keys, TLS_TICKET_KEYS_LENGTH) == 1;
+}
+
+/**
+ * Every accepted connection has its own SSL_CTX, share one ticket key per process
+ * so clients can resume sessions from earlier connections to the same listener.
+ */
+static void tls_set_ticket_keys(rdpTls* tls)
+{
+	static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+	static BYTE keys[TLS_TICKET_KEYS_LENGTH] = { 0 };
+
+	if (SSL_CTX_get_tlsext_ticket_keys(tls->ctx, NULL, 0) != TLS_TICKET_KEYS_LENGTH)
+		return;
+
+	if (!InitOnceExecuteOnce(&once, tls_init_ticket_keys, keys, NULL))
+	{
+		WLog_WARN(TAG, "failed to create TLS session ticket keys");
+		return;
+	}
+
+	if (SSL_CTX_set_tlsext_ticket_keys(tls->ctx, keys, sizeof(keys)) != 1)
+		WLog_WARN(TAG, "failed to set TLS session ticket keys");
+}
+#endif
+
 int tls_connect(rdpTls* tls, BIO* underlying)
 {
 	int options = 0;
+#if defined(TLS_SESSION_RESUMPTION)
+	int status;
+#endif
 	/**
 	 * SSL_OP_NO_COMPRESSION:
 	 *
@@ -868,7 +1017,17 @@ int tls_connect(rdpTls* tls, BIO* underlying)
 #if !defined(OPENSSL_NO_TLSEXT) && !defined(LIBRESSL_VERSION_NUMBER)
 	SSL_set_tlsext_host_name(tls->ssl, tls->hostname);
 #endif
+#if defined(TLS_SESSION_RESUMPTION)
+	tls_prepare_session_resumption(tls);
+	status = tls_do_handshake(tls, TRUE);
+
+	if ((status > 0) && SSL_session_reused(tls->ssl))
+		WLog_DBG(TAG, "resumed TLS session with %s:%d", tls->hostname, tls->port);
+
+	return status;
+#else
 	return tls_do_handshake(tls, TRUE);
+#endif
 }
 
 #if defined(MICROSOFT_IOS_SNI_BUG) && !defined(OPENSSL_NO_TLSEXT) && \
@@ -928,6 +1087,10 @@ BOOL tls_accept(rdpTls* tls, BIO* underlying, rdpSettings* settings)
 	if (!tls_prepare(tls, underlying, SSLv23_server_method(), options, FALSE))
 		return FALSE;
 
+#if defined(TLS_SESSION_RESUMPTION)
+	tls_set_ticket_keys(tls);
+#endif
+
 	if (settings->PrivateKeyFile)
 	{
 		bio = BIO_new_file(settings->PrivateKeyFile, "rb");
@@ -1669,6 +1832,12 @@ void tls_free(rdpTls* tls)
 		tls->ctx = NULL;
 	}
 
+	if (tls->session)
+	{
+		SSL_SESSION_free(tls->session);
+		tls->session = NULL;
+	}
+
 	/* tls->underlying is a stacked BIO under tls->bio.
 	 * BIO_free_all will free recursivly. */
 	if (tls->bio)
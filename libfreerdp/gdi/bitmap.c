@@ -37,6 +37,7 @@
 
 #include "brush.h"
 #include "clipping.h"
+#include "rop.h"
 #include "../gdi/gdi.h"
 
 #define TAG FREERDP_TAG("gdi.bitmap")
@@ -548,6 +549,181 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 	return TRUE;
 }
 
+static void BitBlt_fill_row(BYTE* row, UINT32 format, UINT32 color, INT32 nWidth)
+{
+	INT32 x;
+	const UINT32 bpp = GetBytesPerPixel(format);
+
+	WriteColor(row, format, color);
+
+	for (x = 1; x < nWidth; x++)
+		memcpy(&row[1ull * x * bpp], row, bpp);
+}
+
+/* converts a row of the source as BitBlt_write does for each pixel */
+static BOOL BitBlt_convert_row(BYTE* row, HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc,
+                               INT32 nWidth, const gdiPalette* palette)
+{
+	INT32 x;
+	const UINT32 bpp = GetBytesPerPixel(hdcDest->format);
+
+	for (x = 0; x < nWidth; x++)
+	{
+		UINT32 color;
+		const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc + x, nYSrc);
+
+		if (!srcp)
+			return FALSE;
+
+		color = ReadColor(srcp, hdcSrc->format);
+		color = FreeRDPConvertColor(color, hdcSrc->format, hdcDest->format, palette);
+		WriteColor(&row[1ull * x * bpp], hdcDest->format, color);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Same as BitBlt_process for the raster operations with a row kernel. The operands are
+ * gathered into rows in the destination format, then the kernel runs on the whole row.
+ */
+static BOOL BitBlt_process_rows(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                                INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc,
+                                const gdiRopKernel* kernel, const gdiPalette* palette)
+{
+	BOOL rc = FALSE;
+	INT32 x, y;
+	UINT32 style = GDI_BS_SOLID;
+	BOOL sameFormat;
+	size_t length;
+	BYTE* srcRow = NULL;
+	BYTE* patRow = NULL;
+	const UINT32 format = hdcDest->format;
+	const UINT32 bpp = GetBytesPerPixel(format);
+
+	if (!adjust_src_dst_coordinates(hdcDest, &nXSrc, &nYSrc, &nXDest, &nYDest, &nWidth, &nHeight))
+		return FALSE;
+
+	if (kernel->useSrc)
+	{
+		if (!hdcSrc || !adjust_src_coordinates(hdcSrc, nWidth, nHeight, &nXSrc, &nYSrc))
+			return FALSE;
+	}
+
+	if ((nWidth == 0) || (nHeight == 0))
+		return TRUE;
+
+	length = 1ull * nWidth * bpp;
+
+	/* bits no format uses may differ from the per pixel evaluation, palettes need a lookup */
+	sameFormat = kernel->useSrc && (hdcSrc->format == format) && (GetBitsPerPixel(format) > 8);
+
+	if (kernel->useSrc && (!sameFormat || (hdcSrc->selectedObject == hdcDest->selectedObject)))
+	{
+		srcRow = malloc(length);
+
+		if (!srcRow)
+			goto fail;
+	}
+
+	if (kernel->pattern != GDI_ROP_PATTERN_NONE)
+	{
+		patRow = malloc(length);
+
+		if (!patRow)
+			goto fail;
+	}
+
+	switch (kernel->pattern)
+	{
+		case GDI_ROP_PATTERN_BLACK:
+			BitBlt_fill_row(patRow, format, FreeRDPGetColor(format, 0, 0, 0, 0xFF), nWidth);
+			break;
+
+		case GDI_ROP_PATTERN_WHITE:
+			BitBlt_fill_row(patRow, format, FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF),
+			                nWidth);
+			break;
+
+		case GDI_ROP_PATTERN_BRUSH:
+			style = gdi_GetBrushStyle(hdcDest);
+
+			switch (style)
+			{
+				case GDI_BS_SOLID:
+					BitBlt_fill_row(patRow, format, hdcDest->brush->color, nWidth);
+					break;
+
+				case GDI_BS_HATCHED:
+				case GDI_BS_PATTERN:
+					break;
+
+				default:
+					WLog_ERR(TAG, "Invalid brush!!");
+					goto fail;
+			}
+
+			break;
+
+		default:
+			break;
+	}
+
+	for (y = 0; y < nHeight; y++)
+	{
+		/* rows are read before they are overwritten, as in BitBlt_process */
+		const INT32 row = (nYDest > nYSrc) ? nHeight - 1 - y : y;
+		const BYTE* src = NULL;
+		BYTE* dst = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + row);
+
+		if (!dst)
+			goto fail;
+
+		if (kernel->useSrc)
+		{
+			if (!sameFormat)
+			{
+				if (!BitBlt_convert_row(srcRow, hdcDest, hdcSrc, nXSrc, nYSrc + row, nWidth,
+				                        palette))
+					goto fail;
+
+				src = srcRow;
+			}
+			else
+			{
+				src = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + row);
+
+				if (!src)
+					goto fail;
+
+				/* the row may overlap the destination row */
+				if (srcRow)
+				{
+					memcpy(srcRow, src, length);
+					src = srcRow;
+				}
+			}
+		}
+
+		if ((kernel->pattern == GDI_ROP_PATTERN_BRUSH) && (style != GDI_BS_SOLID))
+		{
+			for (x = 0; x < nWidth; x++)
+			{
+				const BYTE* patp = gdi_get_brush_pointer(hdcDest, nXDest + x, nYDest + row);
+				memcpy(&patRow[1ull * x * bpp], patp, bpp);
+			}
+		}
+
+		kernel->row(dst, src, patRow, length);
+	}
+
+	rc = TRUE;
+fail:
+	free(srcRow);
+	free(patRow);
+	return rc;
+}
+
 /**
  * Perform a bit blit operation on the given pixel buffers.\n
  * @msdn{dd183370}
@@ -627,11 +803,20 @@ BOOL gdi_BitBlt(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32
 			break;
 
 		default:
-			if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
-			                    gdi_rop_to_string(rop), palette))
-				return FALSE;
+		{
+			const gdiRopKernel* kernel = gdi_rop_kernel(rop);
 
-			break;
+			if (kernel && (GetBytesPerPixel(hdcDest->format) > 0))
+			{
+				if (!BitBlt_process_rows(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc,
+				                         nYSrc, kernel, palette))
+					return FALSE;
+			}
+			else if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc,
+			                         nYSrc, gdi_rop_to_string(rop), palette))
+				return FALSE;
+		}
+		break;
 	}
 
 	if (!gdi_InvalidateRegion(hdcDest, nXDest, nYDest, nWidth, nHeight))
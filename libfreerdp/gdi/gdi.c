@@ -1028,10 +1028,11 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 	switch (cmd->bmp.codecID)
 	{
 		case RDP_CODEC_ID_REMOTEFX:
-			if (!rfx_process_message(context->codecs->rfx, cmd->bmp.bitmapData,
-			                         cmd->bmp.bitmapDataLength, cmd->destLeft, cmd->destTop,
-			                         gdi->primary_buffer, gdi->dstFormat, gdi->stride, gdi->height,
-			                         &region))
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_REMOTEFX) ||
+			    !rfx_process_message(context->codecs->rfx, cmd->bmp.bitmapData,
+			                             cmd->bmp.bitmapDataLength, cmd->destLeft, cmd->destTop,
+			                             gdi->primary_buffer, gdi->dstFormat, gdi->stride,
+			                             gdi->height, &region))
 			{
 				WLog_ERR(TAG, "Failed to process RemoteFX message");
 				goto out;
@@ -1042,11 +1043,12 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 		case RDP_CODEC_ID_NSCODEC:
 			format = gdi->dstFormat;
 
-			if (!nsc_process_message(context->codecs->nsc, cmd->bmp.bpp, cmd->bmp.width,
-			                         cmd->bmp.height, cmd->bmp.bitmapData,
-			                         cmd->bmp.bitmapDataLength, gdi->primary_buffer, format,
-			                         gdi->stride, cmd->destLeft, cmd->destTop, cmd->bmp.width,
-			                         cmd->bmp.height, FREERDP_FLIP_VERTICAL))
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_NSCODEC) ||
+			    !nsc_process_message(context->codecs->nsc, cmd->bmp.bpp, cmd->bmp.width,
+			                             cmd->bmp.height, cmd->bmp.bitmapData,
+			                             cmd->bmp.bitmapDataLength, gdi->primary_buffer, format,
+			                             gdi->stride, cmd->destLeft, cmd->destTop,
+			                             cmd->bmp.width, cmd->bmp.height, FREERDP_FLIP_VERTICAL))
 			{
 				WLog_ERR(TAG, "Failed to process NSCodec message");
 				goto out;
@@ -1110,6 +1112,118 @@ out:
  * @return
  */
 
+/* Grows dst by src if both are filled with the same color and form one rectangle */
+static BOOL gdi_merge_opaque_rect(OPAQUE_RECT_ORDER* dst, const OPAQUE_RECT_ORDER* src)
+{
+	if (dst->color != src->color)
+		return FALSE;
+
+	if ((dst->nTopRect == src->nTopRect) && (dst->nHeight == src->nHeight) &&
+	    (dst->nLeftRect + dst->nWidth == src->nLeftRect))
+	{
+		dst->nWidth += src->nWidth;
+		return TRUE;
+	}
+
+	if ((dst->nLeftRect == src->nLeftRect) && (dst->nWidth == src->nWidth) &&
+	    (dst->nTopRect + dst->nHeight == src->nTopRect))
+	{
+		dst->nHeight += src->nHeight;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static BOOL gdi_batch_same_bounds(const ORDERS_BATCH* batch, UINT32 a, UINT32 b)
+{
+	const rdpBounds* ba = &batch->bounds[a];
+	const rdpBounds* bb = &batch->bounds[b];
+
+	if (batch->hasBounds[a] != batch->hasBounds[b])
+		return FALSE;
+
+	if (!batch->hasBounds[a])
+		return TRUE;
+
+	return (ba->left == bb->left) && (ba->top == bb->top) && (ba->right == bb->right) &&
+	       (ba->bottom == bb->bottom);
+}
+
+/**
+ * Runs a batch of orders through the registered primary callbacks. Runs of opaque rects
+ * with the same color and clipping that line up are filled as one rectangle.
+ */
+static BOOL gdi_orders_batch(rdpContext* context, const ORDERS_BATCH* batch)
+{
+	UINT32 n = 0;
+	BOOL rc = TRUE;
+	rdpUpdate* update;
+	rdpPrimaryUpdate* primary;
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(batch);
+
+	update = context->update;
+	WINPR_ASSERT(update);
+	primary = update->primary;
+	WINPR_ASSERT(primary);
+
+	while (rc && (n < batch->count))
+	{
+		const UINT32 index = batch->index[n];
+		UINT32 next = n + 1;
+
+		if ((n == 0) || !gdi_batch_same_bounds(batch, n - 1, n))
+		{
+			const rdpBounds* bounds = batch->hasBounds[n] ? &batch->bounds[n] : NULL;
+
+			if (!IFCALLRESULT(TRUE, update->SetBounds, context, bounds))
+				return FALSE;
+		}
+
+		switch (batch->orderType[n])
+		{
+			case ORDERS_BATCH_TYPE_DSTBLT:
+				rc = IFCALLRESULT(TRUE, primary->DstBlt, context, &batch->dstblt[index]);
+				break;
+
+			case ORDERS_BATCH_TYPE_SCRBLT:
+				rc = IFCALLRESULT(TRUE, primary->ScrBlt, context, &batch->scrblt[index]);
+				break;
+
+			case ORDERS_BATCH_TYPE_MEMBLT:
+				rc = IFCALLRESULT(TRUE, primary->MemBlt, context, &batch->memblt[index]);
+				break;
+
+			case ORDERS_BATCH_TYPE_OPAQUE_RECT:
+			{
+				OPAQUE_RECT_ORDER rect = batch->opaqueRect[index];
+
+				while ((next < batch->count) &&
+				       (batch->orderType[next] == ORDERS_BATCH_TYPE_OPAQUE_RECT) &&
+				       gdi_batch_same_bounds(batch, n, next) &&
+				       gdi_merge_opaque_rect(&rect, &batch->opaqueRect[batch->index[next]]))
+					next++;
+
+				rc = IFCALLRESULT(TRUE, primary->OpaqueRect, context, &rect);
+			}
+			break;
+
+			default:
+				rc = FALSE;
+				break;
+		}
+
+		n = next;
+	}
+
+	if (!IFCALLRESULT(TRUE, update->SetBounds, context, NULL))
+		return FALSE;
+
+	return rc;
+}
+
 static void gdi_register_update_callbacks(rdpUpdate* update)
 {
 	rdpPrimaryUpdate* primary;
@@ -1150,6 +1264,7 @@ static void gdi_register_update_callbacks(rdpUpdate* update)
 	primary->PolygonCB = gdi_polygon_cb;
 	primary->EllipseSC = gdi_ellipse_sc;
 	primary->EllipseCB = gdi_ellipse_cb;
+	primary->OrdersBatch = gdi_orders_batch;
 	update->SurfaceBits = gdi_surface_bits;
 	update->SurfaceFrameMarker = gdi_surface_frame_marker;
 	update->altsec->FrameMarker = gdi_frame_marker;
@@ -1363,6 +1478,16 @@ BOOL gdi_send_suppress_output(rdpGdi* gdi, BOOL suppress)
 		return TRUE;
 
 	gdi->suppressOutput = suppress;
+
+	/* nothing is drawn until output is allowed again, free what the next updates can rebuild */
+	if (suppress)
+	{
+		freerdp_client_codecs_release(gdi->context->codecs, FREERDP_CODEC_STATELESS);
+
+		if (gdi->gfx)
+			gdi_graphics_pipeline_trim(gdi->gfx);
+	}
+
 	settings = gdi->context->settings;
 	update = gdi->context->update;
 	rect.left = 0;
@@ -21,11 +21,16 @@
 
 #include <freerdp/config.h>
 
+#include <math.h>
+
 #include "../core/update.h"
+#include "../core/connection.h"
+#include "gdi.h"
 
 #include <freerdp/log.h>
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/gdi/region.h>
+#include <freerdp/utils/trace.h>
 
 #define TAG FREERDP_TAG("gdi")
 
@@ -155,6 +160,7 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
 	UINT32 surfaceX, surfaceY;
+	UINT32 targetWidth, targetHeight;
 	RECTANGLE_16 surfaceRect;
 	const RECTANGLE_16* rects;
 	UINT32 i, nbRects;
@@ -178,36 +184,61 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 	surfaceRect.right = surface->mappedWidth;
 	surfaceRect.bottom = surface->mappedHeight;
 	region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
+	/* a little overdraw is cheaper than a blit per tile */
+	region16_coalesce(&surface->invalidRegion,
+	                  freerdp_settings_get_uint32(gdi->context->settings,
+	                                              FreeRDP_GfxOutputMaxRects));
 	sx = surface->outputTargetWidth / (double)surface->mappedWidth;
 	sy = surface->outputTargetHeight / (double)surface->mappedHeight;
 
 	if (!(rects = region16_rects(&surface->invalidRegion, &nbRects)) || !nbRects)
 		return CHANNEL_RC_OK;
 
+	if ((surfaceX >= (UINT32)gdi->width) || (surfaceY >= (UINT32)gdi->height))
+	{
+		rc = CHANNEL_RC_OK;
+		goto out;
+	}
+
+	targetWidth = MIN(surface->outputTargetWidth, (UINT32)gdi->width - surfaceX);
+	targetHeight = MIN(surface->outputTargetHeight, (UINT32)gdi->height - surfaceY);
+
 	if (!update_begin_paint(update))
 		goto fail;
 
 	for (i = 0; i < nbRects; i++)
 	{
-		const UINT32 nXSrc = rects[i].left;
-		const UINT32 nYSrc = rects[i].top;
-		const UINT32 nXDst = (UINT32)MIN(surfaceX + nXSrc * sx, gdi->width - 1);
-		const UINT32 nYDst = (UINT32)MIN(surfaceY + nYSrc * sy, gdi->height - 1);
-		const UINT32 swidth = rects[i].right - rects[i].left;
-		const UINT32 sheight = rects[i].bottom - rects[i].top;
-		const UINT32 dwidth = MIN((UINT32)(swidth * sx), (UINT32)gdi->width - nXDst);
-		const UINT32 dheight = MIN((UINT32)(sheight * sy), (UINT32)gdi->height - nYDst);
-
-		if (!freerdp_image_scale(gdi->primary_buffer, gdi->dstFormat, gdi->stride, nXDst, nYDst,
-		                         dwidth, dheight, surface->data, surface->format, surface->scanline,
-		                         nXSrc, nYSrc, swidth, sheight))
+		/* the filter reads one source pixel around the output, so the output next to the
+		 * invalid rect changes as well */
+		const UINT32 radiusX = (surface->outputTargetWidth != surface->mappedWidth) ? 1 : 0;
+		const UINT32 radiusY = (surface->outputTargetHeight != surface->mappedHeight) ? 1 : 0;
+		const UINT32 left = (rects[i].left > radiusX) ? rects[i].left - radiusX : 0;
+		const UINT32 top = (rects[i].top > radiusY) ? rects[i].top - radiusY : 0;
+		const UINT32 right = MIN(rects[i].right + radiusX, surface->mappedWidth);
+		const UINT32 bottom = MIN(rects[i].bottom + radiusY, surface->mappedHeight);
+		const UINT32 nXDst = MIN((UINT32)floor(left * sx), targetWidth);
+		const UINT32 nYDst = MIN((UINT32)floor(top * sy), targetHeight);
+		const UINT32 dwidth = MIN((UINT32)ceil(right * sx), targetWidth) - nXDst;
+		const UINT32 dheight = MIN((UINT32)ceil(bottom * sy), targetHeight) - nYDst;
+
+		if ((dwidth == 0) || (dheight == 0))
+			continue;
+
+		/* scale as part of the whole surface, invalid rects are scaled without seams and
+		 * the scaler reuses the filter tables of the surface */
+		if (!freerdp_image_scale_rect(gdi->primary_buffer, gdi->dstFormat, gdi->stride, surfaceX,
+		                              surfaceY, surface->outputTargetWidth,
+		                              surface->outputTargetHeight, surface->data,
+		                              surface->format, surface->scanline, 0, 0,
+		                              surface->mappedWidth, surface->mappedHeight, nXDst, nYDst,
+		                              dwidth, dheight))
 		{
 			rc = CHANNEL_RC_NULL_DATA;
 			goto fail;
 		}
 
-		gdi_InvalidateRegion(gdi->primary->hdc, (INT32)nXDst, (INT32)nYDst, (INT32)dwidth,
-		                     (INT32)dheight);
+		gdi_InvalidateRegion(gdi->primary->hdc, (INT32)(surfaceX + nXDst),
+		                     (INT32)(surfaceY + nYDst), (INT32)dwidth, (INT32)dheight);
 	}
 
 	rc = CHANNEL_RC_OK;
@@ -216,6 +247,7 @@ fail:
 	if (!update_end_paint(update))
 		rc = ERROR_INTERNAL_ERROR;
 
+out:
 	region16_clear(&(surface->invalidRegion));
 	return rc;
 }
@@ -234,6 +266,7 @@ static UINT gdi_UpdateSurfaces(RdpgfxClientContext* context)
 	gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
 
+	FREERDP_TRACE_SPAN_BEGIN(span);
 	EnterCriticalSection(&context->mux);
 	context->GetSurfaceIds(context, &pSurfaceIds, &count);
 	status = CHANNEL_RC_OK;
@@ -263,6 +296,7 @@ static UINT gdi_UpdateSurfaces(RdpgfxClientContext* context)
 
 	free(pSurfaceIds);
 	LeaveCriticalSection(&context->mux);
+	FREERDP_TRACE_SPAN_END(span, "gdi_UpdateSurfaces");
 	return status;
 }
 
@@ -271,6 +305,44 @@ static UINT gdi_UpdateSurfaces(RdpgfxClientContext* context)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+/* the frame timestamp is the UTC time of day of the server */
+static void gdi_record_frame_latency(rdpGdi* gdi, UINT32 timestamp)
+{
+	UINT64 sent;
+	UINT64 now;
+	SYSTEMTIME sTime = { 0 };
+	const UINT64 day = 24ULL * 3600ULL * 1000ULL;
+
+	GetSystemTime(&sTime);
+	sent = ((timestamp >> 22) & 0x3FF) * 3600000ULL + ((timestamp >> 16) & 0x3F) * 60000ULL +
+	       ((timestamp >> 10) & 0x3F) * 1000ULL + (timestamp & 0x3FF);
+	now = sTime.wHour * 3600000ULL + sTime.wMinute * 60000ULL + sTime.wSecond * 1000ULL +
+	      sTime.wMilliseconds;
+
+	if (now < sent)
+		now += day;
+
+	/* clocks that are not synchronized give no useful value */
+	if (now - sent > 60000)
+		return;
+
+	metrics_histogram_record(gdi->context->metrics, FREERDP_METRIC_FRAME_LATENCY,
+	                         (now - sent) * 1000);
+}
+
+/* the decoding of queued surface commands is finished by the start and the end of a frame,
+ * only adding up needs to be atomic */
+static void gdi_add_frame_decode_time(rdpGdi* gdi, UINT64 value)
+{
+	LONGLONG cur;
+
+	do
+	{
+		cur = gdi->frameDecodeTime;
+	} while (InterlockedCompareExchange64(&gdi->frameDecodeTime, cur + (LONGLONG)value, cur) !=
+	         cur);
+}
+
 static UINT gdi_StartFrame(RdpgfxClientContext* context, const RDPGFX_START_FRAME_PDU* startFrame)
 {
 	rdpGdi* gdi;
@@ -280,8 +352,13 @@ static UINT gdi_StartFrame(RdpgfxClientContext* context, const RDPGFX_START_FRAM
 
 	gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->context);
+	rdp_first_update_received(gdi->context->rdp);
 	gdi->inGfxFrame = TRUE;
 	gdi->frameId = startFrame->frameId;
+	gdi->frameStart = metrics_get_time_us();
+	gdi->frameDecodeTime = 0;
+	gdi_record_frame_latency(gdi, startFrame->timestamp);
 	return CHANNEL_RC_OK;
 }
 
@@ -294,14 +371,28 @@ static UINT gdi_EndFrame(RdpgfxClientContext* context, const RDPGFX_END_FRAME_PD
 {
 	UINT status = CHANNEL_RC_OK;
 	rdpGdi* gdi;
+	UINT64 start;
+	UINT64 end;
 
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(endFrame);
 
 	gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
+	start = metrics_get_time_us();
 	IFCALLRET(context->UpdateSurfaces, status, context);
 	gdi->inGfxFrame = FALSE;
+	end = metrics_get_time_us();
+	metrics_histogram_record(gdi->context->metrics, FREERDP_METRIC_PRESENT_TIME, end - start);
+	metrics_histogram_record(gdi->context->metrics, FREERDP_METRIC_FRAME_DECODE_TIME,
+	                         (UINT64)gdi->frameDecodeTime);
+
+	if (gdi->frameStart != 0)
+		metrics_histogram_record(gdi->context->metrics, FREERDP_METRIC_FRAME_TIME,
+		                         end - gdi->frameStart);
+
+	gdi->frameStart = 0;
+	metrics_counter_add(gdi->context->metrics, FREERDP_METRIC_FRAMES_DECODED, 1);
 	return status;
 }
 
@@ -380,7 +471,7 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	gdiGfxSurface* surface;
 	REGION16 invalidRegion;
 	const RECTANGLE_16* rects;
-	UINT32 nrRects, x;
+	UINT32 nrRects;
 	WINPR_ASSERT(gdi);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(cmd);
@@ -394,6 +485,9 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	}
 
 	WINPR_ASSERT(surface->codecs);
+	if (!freerdp_client_codecs_ensure(surface->codecs, FREERDP_CODEC_REMOTEFX))
+		return ERROR_INTERNAL_ERROR;
+
 	rfx_context_set_pixel_format(surface->codecs->rfx, cmd->format);
 	region16_init(&invalidRegion);
 
@@ -412,8 +506,7 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 
 	if (!gdi->inGfxFrame)
 	{
@@ -451,6 +544,9 @@ static UINT gdi_SurfaceCommand_ClearCodec(rdpGdi* gdi, RdpgfxClientContext* cont
 	}
 
 	WINPR_ASSERT(surface->codecs);
+	if (!freerdp_client_codecs_ensure(surface->codecs, FREERDP_CODEC_CLEARCODEC))
+		return ERROR_INTERNAL_ERROR;
+
 	rc = clear_decompress(surface->codecs->clear, cmd->data, cmd->length, cmd->width, cmd->height,
 	                      surface->data, surface->format, surface->scanline, cmd->left, cmd->top,
 	                      surface->width, surface->height, &gdi->palette);
@@ -511,6 +607,9 @@ static UINT gdi_SurfaceCommand_Planar(rdpGdi* gdi, RdpgfxClientContext* context,
 	if (!is_within_surface(surface, cmd))
 		return ERROR_INVALID_DATA;
 
+	if (!freerdp_client_codecs_ensure(surface->codecs, FREERDP_CODEC_PLANAR))
+		return ERROR_INTERNAL_ERROR;
+
 	if (!planar_decompress(surface->codecs->planar, cmd->data, cmd->length, cmd->width, cmd->height,
 	                       DstData, surface->format, surface->scanline, cmd->left, cmd->top,
 	                       cmd->width, cmd->height, FALSE))
@@ -577,6 +676,14 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 
 		if (!h264_context_reset(surface->h264, surface->width, surface->height))
 			return ERROR_INTERNAL_ERROR;
+
+		if (context->GetSurfaceOutputWindow)
+		{
+			void* window = context->GetSurfaceOutputWindow(context, surface->surfaceId);
+
+			if (window && !h264_context_set_output_window(surface->h264, window))
+				return ERROR_INTERNAL_ERROR;
+		}
 	}
 
 	if (!surface->h264)
@@ -598,11 +705,14 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
-	for (i = 0; i < meta->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    (RECTANGLE_16*)&(meta->regionRects[i]));
-	}
+	/* already on screen, surface->data was not touched */
+	if (surface->h264->FrameRendered)
+		return CHANNEL_RC_OK;
+
+	EnterCriticalSection(&context->mux);
+
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, meta->regionRects,
+	                     meta->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta->numRegionRects, meta->regionRects);
@@ -617,6 +727,7 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 	}
 
 fail:
+	LeaveCriticalSection(&context->mux);
 	return status;
 #else
 	return ERROR_NOT_SUPPORTED;
@@ -690,11 +801,10 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
-	for (i = 0; i < meta1->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta1->regionRects[i]));
-	}
+	EnterCriticalSection(&context->mux);
+
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, meta1->regionRects,
+	                     meta1->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta1->numRegionRects, meta1->regionRects);
@@ -702,11 +812,8 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (i = 0; i < meta2->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta2->regionRects[i]));
-	}
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, meta2->regionRects,
+	                     meta2->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta2->numRegionRects, meta2->regionRects);
@@ -721,6 +828,7 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	}
 
 fail:
+	LeaveCriticalSection(&context->mux);
 	return status;
 #else
 	return ERROR_NOT_SUPPORTED;
@@ -912,7 +1020,7 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	gdiGfxSurface* surface;
 	REGION16 invalidRegion;
 	const RECTANGLE_16* rects;
-	UINT32 nrRects, x;
+	UINT32 nrRects;
 	/**
 	 * Note: Since this comes via a Wire-To-Surface-2 PDU the
 	 * cmd's top/left/right/bottom/width/height members are always zero!
@@ -934,6 +1042,9 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 		return ERROR_INVALID_DATA;
 
 	WINPR_ASSERT(surface->codecs);
+	if (!freerdp_client_codecs_ensure(surface->codecs, FREERDP_CODEC_PROGRESSIVE))
+		return ERROR_INTERNAL_ERROR;
+
 	rc = progressive_create_surface_context(surface->codecs->progressive, cmd->surfaceId,
 	                                        surface->width, surface->height);
 
@@ -963,8 +1074,7 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 
 	region16_uninit(&invalidRegion);
 
@@ -983,17 +1093,41 @@ fail:
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+/**
+ * The h264 decoders belong to their surface, the channel decodes AVC commands of different
+ * surfaces in parallel. They only lock to update the surface, all other codecs are shared.
+ */
+static BOOL gdi_is_surface_codec(UINT32 codecId)
+{
+	switch (codecId)
+	{
+		case RDPGFX_CODECID_AVC420:
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
 static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFACE_COMMAND* cmd)
 {
 	UINT status = CHANNEL_RC_OK;
 	rdpGdi* gdi;
+	UINT64 start;
+	BOOL locked;
 
 	if (!context || !cmd)
 		return ERROR_INVALID_PARAMETER;
 
 	gdi = (rdpGdi*)context->custom;
+	locked = !gdi_is_surface_codec(cmd->codecId);
 
-	EnterCriticalSection(&context->mux);
+	if (locked)
+		EnterCriticalSection(&context->mux);
+
+	start = metrics_get_time_us();
 	WLog_Print(gdi->log, WLOG_TRACE,
 	           "surfaceId=%" PRIu32 ", codec=%" PRIu32 ", contextId=%" PRIu32 ", format=%s, "
 	           "left=%" PRIu32 ", top=%" PRIu32 ", right=%" PRIu32 ", bottom=%" PRIu32
@@ -1047,7 +1181,13 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 			break;
 	}
 
-	LeaveCriticalSection(&context->mux);
+	const UINT64 elapsed = metrics_get_time_us() - start;
+	metrics_histogram_record(gdi->context->metrics, FREERDP_METRIC_DECODE_TIME, elapsed);
+	gdi_add_frame_decode_time(gdi, elapsed);
+
+	if (locked)
+		LeaveCriticalSection(&context->mux);
+
 	return status;
 }
 
@@ -1068,6 +1208,14 @@ gdi_DeleteEncodingContext(RdpgfxClientContext* context,
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+static void gdi_count_surface_bytes(rdpGdi* gdi, const gdiGfxSurface* surface, INT64 sign)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(surface);
+	metrics_gauge_add(gdi->context ? gdi->context->metrics : NULL, FREERDP_METRIC_SURFACE_BYTES,
+	                  sign * (INT64)surface->scanline * surface->height);
+}
+
 static UINT gdi_CreateSurface(RdpgfxClientContext* context,
                               const RDPGFX_CREATE_SURFACE_PDU* createSurface)
 {
@@ -1121,7 +1269,16 @@ static UINT gdi_CreateSurface(RdpgfxClientContext* context,
 	}
 
 	surface->scanline = gfx_align_scanline(surface->width * 4UL, 16);
-	surface->data = (BYTE*)_aligned_malloc(surface->scanline * surface->height * 1ULL, 16);
+
+	if (context->spareSurfaceData &&
+	    (context->spareSurfaceSize >= (size_t)surface->scanline * surface->height))
+	{
+		surface->data = (BYTE*)context->spareSurfaceData;
+		context->spareSurfaceData = NULL;
+		context->spareSurfaceSize = 0;
+	}
+	else
+		surface->data = (BYTE*)_aligned_malloc(surface->scanline * surface->height * 1ULL, 16);
 
 	if (!surface->data)
 	{
@@ -1129,15 +1286,53 @@ static UINT gdi_CreateSurface(RdpgfxClientContext* context,
 		goto fail;
 	}
 
+	if (context->spareH264)
+	{
+		if (h264_context_reset(context->spareH264, surface->width, surface->height))
+			surface->h264 = context->spareH264;
+		else
+			h264_context_free(context->spareH264);
+
+		context->spareH264 = NULL;
+	}
+
 	memset(surface->data, 0xFF, (size_t)surface->scanline * surface->height);
 	surface->outputMapped = FALSE;
 	region16_init(&surface->invalidRegion);
+	gdi_count_surface_bytes(gdi, surface, 1);
 	rc = context->SetSurfaceData(context, surface->surfaceId, (void*)surface);
 fail:
 	LeaveCriticalSection(&context->mux);
 	return rc;
 }
 
+/**
+ * Keep the buffer and h264 decoder of a deleted surface around, the server
+ * usually recreates its surfaces right away after a resize.
+ */
+static void gdi_retire_surface(RdpgfxClientContext* context, gdiGfxSurface* surface)
+{
+	const size_t size = (size_t)surface->scanline * surface->height;
+
+	if (size >= context->spareSurfaceSize)
+	{
+		_aligned_free(context->spareSurfaceData);
+		context->spareSurfaceData = surface->data;
+		context->spareSurfaceSize = size;
+	}
+	else
+		_aligned_free(surface->data);
+
+	surface->data = NULL;
+
+	if (surface->h264 && !context->spareH264)
+		context->spareH264 = surface->h264;
+	else
+		h264_context_free(surface->h264);
+
+	surface->h264 = NULL;
+}
+
 /**
  * Function description
  *
@@ -1158,12 +1353,10 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 			rc = IFCALLRESULT(CHANNEL_RC_OK, context->UnmapWindowForSurface, context,
 			                  surface->windowId);
 
-#ifdef WITH_GFX_H264
-		h264_context_free(surface->h264);
-#endif
 		region16_uninit(&surface->invalidRegion);
 		codecs = surface->codecs;
-		_aligned_free(surface->data);
+		gdi_count_surface_bytes((rdpGdi*)context->custom, surface, -1);
+		gdi_retire_surface(context, surface);
 		free(surface);
 	}
 
@@ -1344,6 +1537,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!cacheEntry)
 		goto fail;
 
+	cacheEntry->cacheKey = surfaceToCache->cacheKey;
 	cacheEntry->width = (UINT32)(rect->right - rect->left);
 	cacheEntry->height = (UINT32)(rect->bottom - rect->top);
 	cacheEntry->format = surface->format;
@@ -1467,6 +1661,110 @@ static UINT gdi_EvictCacheEntry(RdpgfxClientContext* context,
 	return rc;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 const PERSISTENT_CACHE_ENTRY* importCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	gdiGfxCacheEntry* oldEntry;
+	UINT rc = ERROR_INTERNAL_ERROR;
+	EnterCriticalSection(&context->mux);
+	cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
+
+	if (!cacheEntry)
+		goto fail;
+
+	cacheEntry->cacheKey = importCacheEntry->key64;
+	cacheEntry->width = importCacheEntry->width;
+	cacheEntry->height = importCacheEntry->height;
+	cacheEntry->format = PIXEL_FORMAT_BGRA32;
+	cacheEntry->scanline = gfx_align_scanline(cacheEntry->width * 4, 16);
+	cacheEntry->data = (BYTE*)calloc(cacheEntry->height, cacheEntry->scanline);
+
+	if (!cacheEntry->data)
+	{
+		free(cacheEntry);
+		goto fail;
+	}
+
+	/* persistent cache entries are stored bottom up */
+	if (!freerdp_image_copy(cacheEntry->data, cacheEntry->format, cacheEntry->scanline, 0, 0,
+	                        cacheEntry->width, cacheEntry->height, importCacheEntry->data,
+	                        PIXEL_FORMAT_BGRA32, importCacheEntry->width * 4, 0, 0, NULL,
+	                        FREERDP_FLIP_VERTICAL))
+	{
+		free(cacheEntry->data);
+		free(cacheEntry);
+		goto fail;
+	}
+
+	oldEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot);
+	rc = context->SetCacheSlotData(context, cacheSlot, (void*)cacheEntry);
+
+	if (rc != CHANNEL_RC_OK)
+	{
+		free(cacheEntry->data);
+		free(cacheEntry);
+	}
+	else if (oldEntry)
+	{
+		free(oldEntry->data);
+		free(oldEntry);
+	}
+
+fail:
+	LeaveCriticalSection(&context->mux);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ExportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 PERSISTENT_CACHE_ENTRY* exportCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	UINT rc = ERROR_NOT_FOUND;
+	EnterCriticalSection(&context->mux);
+	cacheEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot);
+
+	/* entries without a key can not be offered to the server */
+	if (!cacheEntry || (cacheEntry->cacheKey == 0) || (cacheEntry->width > UINT16_MAX) ||
+	    (cacheEntry->height > UINT16_MAX))
+		goto fail;
+
+	exportCacheEntry->key64 = cacheEntry->cacheKey;
+	exportCacheEntry->width = (UINT16)cacheEntry->width;
+	exportCacheEntry->height = (UINT16)cacheEntry->height;
+	exportCacheEntry->size = 4UL * cacheEntry->width * cacheEntry->height;
+	exportCacheEntry->data = (BYTE*)malloc(exportCacheEntry->size);
+	rc = ERROR_INTERNAL_ERROR;
+
+	if (!exportCacheEntry->data)
+		goto fail;
+
+	if (!freerdp_image_copy(exportCacheEntry->data, PIXEL_FORMAT_BGRA32,
+	                        exportCacheEntry->width * 4, 0, 0, cacheEntry->width,
+	                        cacheEntry->height, cacheEntry->data, cacheEntry->format,
+	                        cacheEntry->scanline, 0, 0, NULL, FREERDP_FLIP_VERTICAL))
+	{
+		free(exportCacheEntry->data);
+		exportCacheEntry->data = NULL;
+		goto fail;
+	}
+
+	rc = CHANNEL_RC_OK;
+fail:
+	LeaveCriticalSection(&context->mux);
+	return rc;
+}
+
 /**
  * Function description
  *
@@ -1617,6 +1915,8 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	gfx->CacheToSurface = gdi_CacheToSurface;
 	gfx->CacheImportReply = gdi_CacheImportReply;
 	gfx->EvictCacheEntry = gdi_EvictCacheEntry;
+	gfx->ImportCacheEntry = gdi_ImportCacheEntry;
+	gfx->ExportCacheEntry = gdi_ExportCacheEntry;
 	gfx->MapSurfaceToOutput = gdi_MapSurfaceToOutput;
 	gfx->MapSurfaceToWindow = gdi_MapSurfaceToWindow;
 	gfx->MapSurfaceToScaledOutput = gdi_MapSurfaceToScaledOutput;
@@ -1655,6 +1955,24 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	return TRUE;
 }
 
+/**
+ * Frees what the pipeline rebuilds on demand while the output is suppressed: the contexts of the
+ * stateless codecs, the idle tile pools and the buffer and decoder kept from deleted surfaces.
+ */
+void gdi_graphics_pipeline_trim(RdpgfxClientContext* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	EnterCriticalSection(&gfx->mux);
+	freerdp_client_codecs_release(gfx->codecs, FREERDP_CODEC_STATELESS);
+	_aligned_free(gfx->spareSurfaceData);
+	gfx->spareSurfaceData = NULL;
+	gfx->spareSurfaceSize = 0;
+	h264_context_free(gfx->spareH264);
+	gfx->spareH264 = NULL;
+	LeaveCriticalSection(&gfx->mux);
+}
+
 void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 {
 	if (gdi)
@@ -1666,6 +1984,11 @@ void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 	gfx->custom = NULL;
 	codecs_free(gfx->codecs);
 	gfx->codecs = NULL;
+	_aligned_free(gfx->spareSurfaceData);
+	gfx->spareSurfaceData = NULL;
+	gfx->spareSurfaceSize = 0;
+	h264_context_free(gfx->spareH264);
+	gfx->spareH264 = NULL;
 	DeleteCriticalSection(&gfx->mux);
 	PROFILER_PRINT_HEADER
 	PROFILER_PRINT(gfx->SurfaceProfiler)
@@ -153,13 +153,18 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 	{
 		if (bpp < 32)
 		{
-			if (!interleaved_decompress(context->codecs->interleaved, pSrcData, SrcSize, DstWidth,
-			                            DstHeight, bpp, bitmap->data, bitmap->format, 0, 0, 0,
-			                            DstWidth, DstHeight, &gdi->palette))
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_INTERLEAVED) ||
+			    !interleaved_decompress(context->codecs->interleaved, pSrcData, SrcSize,
+			                                DstWidth, DstHeight, bpp, bitmap->data,
+			                                bitmap->format, 0, 0, 0, DstWidth, DstHeight,
+			                                &gdi->palette))
 				return FALSE;
 		}
 		else
 		{
+			if (!freerdp_client_codecs_ensure(context->codecs, FREERDP_CODEC_PLANAR))
+				return FALSE;
+
 			freerdp_planar_switch_bgr(context->codecs->planar,
 			                          context->settings->DrawAllowDynamicColorFidelity);
 			if (!planar_decompress(context->codecs->planar, pSrcData, SrcSize, DstWidth, DstHeight,
@@ -319,6 +324,90 @@ static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x,
 	return rc;
 }
 
+/**
+ * Draws a text run with a single brush and invalidates its bounding box once,
+ * set glyph pixels are replaced with the text color like GDI_GLYPH_ORDER does.
+ */
+static BOOL gdi_Glyph_DrawRun(rdpContext* context, const GLYPH_RUN_ENTRY* entries, size_t count,
+                              BOOL fOpRedundant)
+{
+	size_t index;
+	UINT32 color;
+	UINT32 bpp;
+	HGDI_DC hdc;
+	HGDI_BITMAP hDstBmp;
+	INT32 left = INT32_MAX;
+	INT32 top = INT32_MAX;
+	INT32 right = INT32_MIN;
+	INT32 bottom = INT32_MIN;
+
+	WINPR_UNUSED(fOpRedundant);
+
+	if (!context || !context->gdi || !entries)
+		return FALSE;
+
+	if (!context->gdi->drawing || !context->gdi->drawing->hdc)
+		return FALSE;
+
+	hdc = context->gdi->drawing->hdc;
+	hDstBmp = (HGDI_BITMAP)hdc->selectedObject;
+
+	if (!hDstBmp)
+		return FALSE;
+
+	color = hdc->textColor;
+	bpp = GetBytesPerPixel(hDstBmp->format);
+
+	for (index = 0; index < count; index++)
+	{
+		INT32 row;
+		const GLYPH_RUN_ENTRY* entry = &entries[index];
+		const gdiGlyph* gdi_glyph = (const gdiGlyph*)entry->glyph;
+		const HGDI_BITMAP hSrcBmp = gdi_glyph->bitmap;
+		INT32 x = entry->x;
+		INT32 y = entry->y;
+		INT32 w = entry->w;
+		INT32 h = entry->h;
+		INT32 sx = entry->sx;
+		INT32 sy = entry->sy;
+
+		if (!gdi_ClipCoords(hdc, &x, &y, &w, &h, &sx, &sy))
+			continue;
+
+		if ((sx < 0) || (sy < 0) || (sx >= hSrcBmp->width) || (sy >= hSrcBmp->height))
+			continue;
+
+		w = MIN(w, hSrcBmp->width - sx);
+		h = MIN(h, hSrcBmp->height - sy);
+
+		if ((w <= 0) || (h <= 0))
+			continue;
+
+		for (row = 0; row < h; row++)
+		{
+			INT32 col;
+			const BYTE* mask = &hSrcBmp->data[1ULL * (sy + row) * hSrcBmp->scanline + sx];
+			BYTE* dst = &hDstBmp->data[1ULL * (y + row) * hDstBmp->scanline + 1ULL * x * bpp];
+
+			for (col = 0; col < w; col++)
+			{
+				if (mask[col])
+					WriteColor(&dst[1ULL * col * bpp], hDstBmp->format, color);
+			}
+		}
+
+		left = MIN(left, x);
+		top = MIN(top, y);
+		right = MAX(right, x + w);
+		bottom = MAX(bottom, y + h);
+	}
+
+	if ((left >= right) || (top >= bottom))
+		return TRUE;
+
+	return gdi_InvalidateRegion(hdc, left, top, right - left, bottom - top);
+}
+
 static BOOL gdi_Glyph_SetBounds(rdpContext* context, INT32 x, INT32 y, INT32 width, INT32 height)
 {
 	rdpGdi* gdi;
@@ -424,6 +513,7 @@ BOOL gdi_register_graphics(rdpGraphics* graphics)
 	glyph.BeginDraw = gdi_Glyph_BeginDraw;
 	glyph.EndDraw = gdi_Glyph_EndDraw;
 	glyph.SetBounds = gdi_Glyph_SetBounds;
+	glyph.DrawRun = gdi_Glyph_DrawRun;
 	graphics_register_glyph(graphics, &glyph);
 	return TRUE;
 }
@@ -0,0 +1,127 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/crt.h>
+
+#include "rop.h"
+
+/**
+ * The common raster operations are compiled to row kernels working on 8 bytes at a time, the
+ * operands are loaded with memcpy so any alignment works. The other operations keep the
+ * generic per pixel evaluation in bitmap.c.
+ */
+
+#define GDI_ROP_ROW(_name, _op)                                                         \
+	static void gdi_rop_row_##_name(BYTE* dst, const BYTE* src, const BYTE* pat,        \
+	                                size_t length)                                      \
+	{                                                                                   \
+		size_t x = 0;                                                                   \
+                                                                                        \
+		for (; x + sizeof(UINT64) <= length; x += sizeof(UINT64))                       \
+		{                                                                               \
+			UINT64 D, S = 0, P = 0;                                                     \
+			memcpy(&D, &dst[x], sizeof(D));                                             \
+			if (src)                                                                    \
+				memcpy(&S, &src[x], sizeof(S));                                         \
+			if (pat)                                                                    \
+				memcpy(&P, &pat[x], sizeof(P));                                         \
+			D = (_op);                                                                  \
+			memcpy(&dst[x], &D, sizeof(D));                                             \
+		}                                                                               \
+                                                                                        \
+		for (; x < length; x++)                                                         \
+		{                                                                               \
+			const BYTE D = dst[x];                                                      \
+			const BYTE S = src ? src[x] : 0;                                            \
+			const BYTE P = pat ? pat[x] : 0;                                            \
+			WINPR_UNUSED(D);                                                            \
+			WINPR_UNUSED(S);                                                            \
+			WINPR_UNUSED(P);                                                            \
+			dst[x] = (BYTE)(_op);                                                       \
+		}                                                                               \
+	}
+
+GDI_ROP_ROW(P, P)
+GDI_ROP_ROW(Pn, ~P)
+GDI_ROP_ROW(Dn, ~D)
+GDI_ROP_ROW(Sn, ~S)
+GDI_ROP_ROW(DSo, D | S)
+GDI_ROP_ROW(DSa, D & S)
+GDI_ROP_ROW(DSx, D ^ S)
+GDI_ROP_ROW(DSxn, ~(D ^ S))
+GDI_ROP_ROW(DSon, ~(D | S))
+GDI_ROP_ROW(DSna, D & ~S)
+GDI_ROP_ROW(DSno, D | ~S)
+GDI_ROP_ROW(SDna, S & ~D)
+GDI_ROP_ROW(DPo, D | P)
+GDI_ROP_ROW(DPa, D & P)
+GDI_ROP_ROW(DPx, D ^ P)
+GDI_ROP_ROW(DPna, D & ~P)
+GDI_ROP_ROW(PDxn, ~(P ^ D))
+GDI_ROP_ROW(PSo, P | S)
+GDI_ROP_ROW(PSa, P & S)
+GDI_ROP_ROW(SPna, S & ~P)
+GDI_ROP_ROW(DPSnoo, D | P | ~S)
+GDI_ROP_ROW(PSDPxax, P ^ (S & (D ^ P)))
+GDI_ROP_ROW(DSPDxax, D ^ (S & (P ^ D)))
+GDI_ROP_ROW(SPaDSnao, (S & P) | (D & ~S))
+
+static const gdiRopKernel rop_kernels[] = {
+	{ GDI_BLACKNESS, FALSE, GDI_ROP_PATTERN_BLACK, gdi_rop_row_P },
+	{ GDI_WHITENESS, FALSE, GDI_ROP_PATTERN_WHITE, gdi_rop_row_P },
+	{ GDI_PATCOPY, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_P },
+	{ GDI_Pn, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_Pn },
+	{ GDI_DSTINVERT, FALSE, GDI_ROP_PATTERN_NONE, gdi_rop_row_Dn },
+	{ GDI_NOTSRCCOPY, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_Sn },
+	{ GDI_SRCPAINT, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSo },
+	{ GDI_SRCAND, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSa },
+	{ GDI_SRCINVERT, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSx },
+	{ GDI_DSxn, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSxn },
+	{ GDI_NOTSRCERASE, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSon },
+	{ GDI_DSna, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSna },
+	{ GDI_MERGEPAINT, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_DSno },
+	{ GDI_SRCERASE, TRUE, GDI_ROP_PATTERN_NONE, gdi_rop_row_SDna },
+	{ GDI_DPo, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DPo },
+	{ GDI_DPa, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DPa },
+	{ GDI_PATINVERT, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DPx },
+	{ GDI_DPna, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DPna },
+	{ GDI_PDxn, FALSE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_PDxn },
+	{ GDI_PSo, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_PSo },
+	{ GDI_MERGECOPY, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_PSa },
+	{ GDI_SPna, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_SPna },
+	{ GDI_PATPAINT, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DPSnoo },
+	{ GDI_PSDPxax, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_PSDPxax },
+	{ GDI_DSPDxax, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_DSPDxax },
+	{ GDI_GLYPH_ORDER, TRUE, GDI_ROP_PATTERN_BRUSH, gdi_rop_row_SPaDSnao }
+};
+
+const gdiRopKernel* gdi_rop_kernel(DWORD rop)
+{
+	size_t x;
+
+	for (x = 0; x < ARRAYSIZE(rop_kernels); x++)
+	{
+		if (rop_kernels[x].rop == rop)
+			return &rop_kernels[x];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Raster Operation Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_ROP_H
+#define FREERDP_LIB_GDI_ROP_H
+
+#include <freerdp/api.h>
+#include <freerdp/gdi/gdi.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/* the pattern operand of a kernel */
+	typedef enum
+	{
+		GDI_ROP_PATTERN_NONE,
+		GDI_ROP_PATTERN_BRUSH,
+		GDI_ROP_PATTERN_BLACK,
+		GDI_ROP_PATTERN_WHITE
+	} gdiRopPattern;
+
+	/**
+	 * Applies a raster operation to a row of pixels in place of dst. The operation is bitwise,
+	 * so it works on the raw bytes of any pixel format. src and pat hold length bytes in the
+	 * format of dst, they are NULL if the operation does not use them.
+	 */
+	typedef void (*pGdiRopRow)(BYTE* dst, const BYTE* src, const BYTE* pat, size_t length);
+
+	typedef struct
+	{
+		DWORD rop;
+		BOOL useSrc;
+		gdiRopPattern pattern;
+		pGdiRopRow row;
+	} gdiRopKernel;
+
+	/** @return the row kernel of rop, NULL if rop has to be evaluated per pixel */
+	FREERDP_LOCAL const gdiRopKernel* gdi_rop_kernel(DWORD rop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_ROP_H */
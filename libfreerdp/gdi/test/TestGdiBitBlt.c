@@ -7,7 +7,10 @@
 #include <freerdp/gdi/bitmap.h>
 
 #include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
+#include "../gdi.h"
 #include "line.h"
 #include "brush.h"
 #include "helpers.h"
@@ -535,6 +538,281 @@ fail:
 	return TRUE; // rc;
 }
 
+/* evaluates rop per pixel, as the generic BitBlt implementation does */
+static UINT32 test_eval_rop(const char* rop, UINT32 D, UINT32 S, UINT32 P, UINT32 format)
+{
+	UINT32 stack[10] = { 0 };
+	UINT32 n = 0;
+
+	for (; *rop != '\0'; rop++)
+	{
+		switch (*rop)
+		{
+			case '0':
+				stack[n++] = FreeRDPGetColor(format, 0, 0, 0, 0xFF);
+				break;
+			case '1':
+				stack[n++] = FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF);
+				break;
+			case 'D':
+				stack[n++] = D;
+				break;
+			case 'S':
+				stack[n++] = S;
+				break;
+			case 'P':
+				stack[n++] = P;
+				break;
+			case 'n':
+				stack[n - 1] = ~stack[n - 1];
+				break;
+			case 'a':
+				n--;
+				stack[n - 1] &= stack[n];
+				break;
+			case 'o':
+				n--;
+				stack[n - 1] |= stack[n];
+				break;
+			case 'x':
+				n--;
+				stack[n - 1] ^= stack[n];
+				break;
+			default:
+				break;
+		}
+	}
+
+	return stack[0];
+}
+
+static HGDI_BITMAP test_random_bitmap(UINT32 width, UINT32 height, UINT32 format)
+{
+	const size_t size = 1ull * width * height * GetBytesPerPixel(format);
+	BYTE* data = _aligned_malloc(size, 16);
+	HGDI_BITMAP bmp;
+
+	if (!data)
+		return NULL;
+
+	winpr_RAND(data, size);
+	bmp = gdi_CreateBitmap(width, height, format, data);
+
+	if (!bmp)
+		_aligned_free(data);
+
+	return bmp;
+}
+
+/* the rops with a row kernel, all results must match the per pixel evaluation */
+static const UINT32 kernel_rops[] = {
+	GDI_BLACKNESS,   GDI_WHITENESS,   GDI_PATCOPY,    GDI_Pn,        GDI_DSTINVERT,
+	GDI_NOTSRCCOPY,  GDI_SRCPAINT,    GDI_SRCAND,     GDI_SRCINVERT, GDI_DSxn,
+	GDI_NOTSRCERASE, GDI_DSna,        GDI_MERGEPAINT, GDI_SRCERASE,  GDI_DPo,
+	GDI_DPa,         GDI_PATINVERT,   GDI_DPna,       GDI_PDxn,      GDI_PSo,
+	GDI_MERGECOPY,   GDI_SPna,        GDI_PATPAINT,   GDI_PSDPxax,   GDI_DSPDxax,
+	GDI_GLYPH_ORDER, GDI_PDSona
+};
+
+static BOOL test_same_color(const BYTE* a, const BYTE* b, UINT32 format, const gdiPalette* palette)
+{
+	BYTE r1, g1, b1, a1, r2, g2, b2, a2;
+
+	/* bits no format uses may differ */
+	SplitColor(ReadColor(a, format), format, &r1, &g1, &b1, &a1, palette);
+	SplitColor(ReadColor(b, format), format, &r2, &g2, &b2, &a2, palette);
+	return (r1 == r2) && (g1 == g2) && (b1 == b2) && (a1 == a2);
+}
+
+static BOOL test_rop_kernel(HGDI_DC hdcDst, HGDI_DC hdcSrc, INT32 dx, INT32 dy, UINT32 rop,
+                            const gdiPalette* palette)
+{
+	BOOL rc = FALSE;
+	INT32 x, y;
+	HGDI_BITMAP hBmpDst = (HGDI_BITMAP)hdcDst->selectedObject;
+	HGDI_BITMAP hBmpSrc = (HGDI_BITMAP)hdcSrc->selectedObject;
+	const UINT32 bpp = GetBytesPerPixel(hdcDst->format);
+	const size_t size = 1ull * hBmpDst->scanline * hBmpDst->height;
+	const INT32 width = hBmpDst->width - dx;
+	const INT32 height = hBmpDst->height - dy;
+	BYTE* expected = malloc(size);
+	BYTE* source = malloc(1ull * hBmpSrc->scanline * hBmpSrc->height);
+
+	if (!expected || !source)
+		goto fail;
+
+	/* the source may be the destination, keep the original pixels */
+	memcpy(expected, hBmpDst->data, size);
+	memcpy(source, hBmpSrc->data, 1ull * hBmpSrc->scanline * hBmpSrc->height);
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			BYTE* d = &expected[(y + dy) * hBmpDst->scanline + (x + dx) * bpp];
+			const BYTE* s = &source[y * hBmpSrc->scanline +
+			                        x * GetBytesPerPixel(hdcSrc->format)];
+			const UINT32 D = ReadColor(d, hdcDst->format);
+			UINT32 S = ReadColor(s, hdcSrc->format);
+			UINT32 P = hdcDst->brush->color;
+
+			/* the conversion is lossy for some 16bpp green values, skipped for equal formats */
+			if (hdcSrc->format != hdcDst->format)
+				S = FreeRDPConvertColor(S, hdcSrc->format, hdcDst->format, palette);
+
+			if (hdcDst->brush->style == GDI_BS_PATTERN)
+				P = ReadColor(gdi_get_brush_pointer(hdcDst, x + dx, y + dy), hdcDst->format);
+
+			WriteColor(d, hdcDst->format,
+			           test_eval_rop(gdi_rop_to_string(rop), D, S, P, hdcDst->format));
+		}
+	}
+
+	if (!gdi_BitBlt(hdcDst, dx, dy, width, height, hdcSrc, 0, 0, rop, palette))
+		goto fail;
+
+	for (y = 0; y < hBmpDst->height; y++)
+	{
+		for (x = 0; x < hBmpDst->width; x++)
+		{
+			const size_t offset = 1ull * y * hBmpDst->scanline + 1ull * x * bpp;
+
+			if (!test_same_color(&hBmpDst->data[offset], &expected[offset], hdcDst->format,
+			                     palette))
+			{
+				fprintf(stderr, "%s %s <- %s: pixel %" PRId32 "x%" PRId32 " differs\n",
+				        gdi_rop_to_string(rop), FreeRDPGetColorFormatName(hdcDst->format),
+				        FreeRDPGetColorFormatName(hdcSrc->format), x, y);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(expected);
+	free(source);
+	return rc;
+}
+
+static BOOL test_gdi_BitBlt_kernels(UINT32 SrcFormat, UINT32 DstFormat)
+{
+	BOOL rc = FALSE;
+	size_t x, y;
+	HGDI_DC hdcSrc = NULL;
+	HGDI_DC hdcDst = NULL;
+	HGDI_BITMAP hBmpSrc = NULL;
+	HGDI_BITMAP hBmpDst = NULL;
+	HGDI_BITMAP hBmpPattern = NULL;
+	HGDI_BRUSH brushes[2] = { NULL };
+	gdiPalette palette = { 0 };
+
+	palette.format = DstFormat;
+
+	for (x = 0; x < 256; x++)
+		palette.palette[x] = FreeRDPGetColor(DstFormat, x, x, x, 0xFF);
+
+	hdcSrc = gdi_GetDC();
+	hdcDst = gdi_GetDC();
+	/* an odd width leaves a tail after the 8 byte blocks */
+	hBmpSrc = test_random_bitmap(67, 13, SrcFormat);
+	hBmpDst = test_random_bitmap(67, 13, DstFormat);
+	hBmpPattern = test_random_bitmap(8, 8, DstFormat);
+
+	if (!hdcSrc || !hdcDst || !hBmpSrc || !hBmpDst || !hBmpPattern)
+		goto fail;
+
+	hdcSrc->format = SrcFormat;
+	hdcDst->format = DstFormat;
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	brushes[0] = gdi_CreateSolidBrush(FreeRDPGetColor(DstFormat, 0x12, 0x34, 0x56, 0xFF));
+	brushes[1] = gdi_CreatePatternBrush(hBmpPattern);
+
+	if (!brushes[0] || !brushes[1])
+		goto fail;
+
+	brushes[1]->nXOrg = 3;
+	brushes[1]->nYOrg = 5;
+
+	for (x = 0; x < ARRAYSIZE(brushes); x++)
+	{
+		gdi_SelectObject(hdcDst, (HGDIOBJECT)brushes[x]);
+
+		for (y = 0; y < ARRAYSIZE(kernel_rops); y++)
+		{
+			if (!test_rop_kernel(hdcDst, hdcSrc, 0, 0, kernel_rops[y], &palette))
+				goto fail;
+		}
+
+		/* overlapping source and destination */
+		if ((SrcFormat == DstFormat) &&
+		    !test_rop_kernel(hdcDst, hdcDst, 3, 1, GDI_SRCINVERT, &palette))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	gdi_SelectObject(hdcDst, NULL);
+
+	for (x = 0; x < ARRAYSIZE(brushes); x++)
+		gdi_DeleteObject((HGDIOBJECT)brushes[x]);
+
+	gdi_DeleteObject((HGDIOBJECT)hBmpPattern);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	return rc;
+}
+
+/* the last rop has no row kernel, it shows the cost of the per pixel evaluation */
+static BOOL test_gdi_BitBlt_speed(void)
+{
+	BOOL rc = FALSE;
+	size_t x, y;
+	HGDI_DC hdcSrc = gdi_GetDC();
+	HGDI_DC hdcDst = gdi_GetDC();
+	HGDI_BITMAP hBmpSrc = test_random_bitmap(1024, 768, PIXEL_FORMAT_BGRX32);
+	HGDI_BITMAP hBmpDst = test_random_bitmap(1024, 768, PIXEL_FORMAT_BGRX32);
+	HGDI_BRUSH brush = gdi_CreateSolidBrush(0x123456);
+	const UINT32 rops[] = { GDI_PATINVERT, GDI_SRCAND, GDI_PSDPxax, GDI_PDSona };
+	const size_t rounds = 10;
+
+	if (!hdcSrc || !hdcDst || !hBmpSrc || !hBmpDst || !brush)
+		goto fail;
+
+	hdcSrc->format = PIXEL_FORMAT_BGRX32;
+	hdcDst->format = PIXEL_FORMAT_BGRX32;
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)brush);
+
+	for (x = 0; x < ARRAYSIZE(rops); x++)
+	{
+		const UINT64 start = GetTickCount64();
+
+		for (y = 0; y < rounds; y++)
+		{
+			if (!gdi_BitBlt(hdcDst, 0, 0, 1024, 768, hdcSrc, 0, 0, rops[x], NULL))
+				goto fail;
+		}
+
+		printf("%-10s 1024x768: %" PRIu64 " ms per %" PRIuz " blits\n",
+		       gdi_rop_to_string(rops[x]), GetTickCount64() - start, rounds);
+	}
+
+	rc = TRUE;
+fail:
+	gdi_SelectObject(hdcDst, NULL);
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	return rc;
+}
+
 int TestGdiBitBlt(int argc, char* argv[])
 {
 	int rc = 0;
@@ -561,8 +839,14 @@ int TestGdiBitBlt(int argc, char* argv[])
 				        FreeRDPGetColorFormatName(formatList[y]));
 				rc = -y;
 			}
+
+			if (!test_gdi_BitBlt_kernels(formatList[x], formatList[y]))
+				rc = -1;
 		}
 	}
 
+	if (!test_gdi_BitBlt_speed())
+		rc = -1;
+
 	return rc;
 }
@@ -0,0 +1,1358 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Primitives Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Times every function of primitives_t for each available implementation (generic, CPU
+ * optimized and OpenCL) on a RemoteFX tile, a 1080p and a 4K frame.
+ *
+ * The result is the time per pixel of the best batch of calls and, where the time stamp
+ * counter can be read, the cycles per pixel. The counter runs at the nominal clock of the CPU,
+ * so turbo and power saving show up in the cycles. The speedup is relative to the generic
+ * implementation.
+ *
+ * A baseline is a CSV file with lines of
+ *
+ * <cpu>,<function>,<size>,<implementation>,<speedup>
+ *
+ * where <cpu> names the architecture and the best instruction set of the machine it was
+ * taken on. Only the lines matching the running machine are compared, a speedup falling
+ * more than the tolerance below the baseline, or a missing implementation, is a regression.
+ * Speedups are compared instead of times as they transfer between machines of a kind.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#include <winpr/crt.h>
+#include <winpr/string.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/utils/stopwatch.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define BENCH_HAVE_TSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+#define BENCH_FORMAT PIXEL_FORMAT_BGRX32
+#define BENCH_TILE_SIZE 64
+#define BENCH_BATCH_TIME 1000 /* us, batches are grown until a batch takes this long */
+#define BENCH_MIN_BATCHES 3
+#define BENCH_MAX_IMPLEMENTATIONS 3
+#define BENCH_DEFAULT_TOLERANCE 25 /* percent */
+
+typedef struct
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 tiles;
+	BYTE* rgb[3];
+	BYTE* yuv[3];
+	BYTE* main[3];
+	BYTE* aux[3];
+	INT16* plane[3];
+	INT16* planeDst[3];
+	BYTE* runs;
+	INT16* coefficients;
+	UINT32* quants;
+	BYTE** tileDst;
+	UINT32* tileStep;
+	char* base64; /* the first 3 bytes per pixel of rgb[0], base64 encoded */
+} BENCH_DATA;
+
+/* Returns the number of pixels processed or 0 on failure */
+typedef UINT64 (*bench_fn)(const primitives_t* prims, BENCH_DATA* data);
+typedef void (*primitives_fn)(void);
+
+typedef struct
+{
+	const char* name;
+	size_t offset;
+	bench_fn run;
+} BENCH_ENTRY;
+
+typedef struct
+{
+	const char* name;
+	UINT32 width;
+	UINT32 height;
+} BENCH_SIZE;
+
+typedef struct
+{
+	const char* name;
+	const primitives_t* prims;
+} BENCH_IMPLEMENTATION;
+
+typedef struct
+{
+	char function[64];
+	char size[32];
+	char implementation[32];
+	double speedup;
+} BENCH_BASELINE_ENTRY;
+
+typedef struct
+{
+	size_t count;
+	BENCH_BASELINE_ENTRY* entries;
+} BENCH_BASELINE;
+
+typedef struct
+{
+	UINT64 pixels;
+	UINT64 calls;
+	double nsPerPixel;
+	double cyclesPerPixel;
+} BENCH_RESULT;
+
+typedef struct
+{
+	BOOL json;
+	BOOL csv;
+	const char* functions;
+	const char* sizes;
+	unsigned long time;
+	unsigned long tolerance;
+	const BENCH_BASELINE* baseline;
+	BENCH_BASELINE* update;
+	BOOL regression;
+} BENCH_OPTIONS;
+
+static const BENCH_SIZE bench_sizes[] = {
+	{ "tile", BENCH_TILE_SIZE, BENCH_TILE_SIZE },
+	{ "1080p", 1920, 1080 },
+	{ "4k", 3840, 2160 },
+};
+
+static UINT64 bench_pixels(const BENCH_DATA* data)
+{
+	return (UINT64)data->width * data->height;
+}
+
+static UINT32 bench_len(const BENCH_DATA* data)
+{
+	return data->width * data->height;
+}
+
+static UINT64 bench_copy(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->copy(data->rgb[0], data->rgb[2], (INT32)bench_len(data) * 4) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_copy_8u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->copy_8u(data->rgb[0], data->rgb[2], (INT32)bench_len(data) * 4) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_copy_8u_AC4r(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT32 step = (INT32)data->width * 4;
+
+	if (prims->copy_8u_AC4r(data->rgb[0], step, data->rgb[2], step, (INT32)data->width,
+	                        (INT32)data->height) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_set_8u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->set_8u(0xA5, data->rgb[2], bench_len(data) * 4) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_set_32s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->set_32s(-0x5A5A5A5A, (INT32*)data->rgb[2], bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_set_32u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->set_32u(0xA5A5A5A5, (UINT32*)data->rgb[2], bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_zero(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->zero(data->rgb[2], bench_pixels(data) * 4) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_add_16s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->add_16s(data->plane[0], data->plane[1], data->planeDst[0], bench_len(data)) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_andC_32u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->andC_32u((const UINT32*)data->rgb[0], 0x00FFFFFF, (UINT32*)data->rgb[2],
+	                    (INT32)bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_orC_32u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->orC_32u((const UINT32*)data->rgb[0], 0xFF000000, (UINT32*)data->rgb[2],
+	                   (INT32)bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_lShiftC_16s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->lShiftC_16s(data->plane[0], 2, data->planeDst[0], bench_len(data)) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_lShiftC_16u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->lShiftC_16u((const UINT16*)data->plane[0], 2, (UINT16*)data->planeDst[0],
+	                       bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_rShiftC_16s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->rShiftC_16s(data->plane[0], 2, data->planeDst[0], bench_len(data)) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_rShiftC_16u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->rShiftC_16u((const UINT16*)data->plane[0], 2, (UINT16*)data->planeDst[0],
+	                       bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_shiftC_16s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->shiftC_16s(data->plane[0], -2, data->planeDst[0], bench_len(data)) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_shiftC_16u(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->shiftC_16u((const UINT16*)data->plane[0], -2, (UINT16*)data->planeDst[0],
+	                      bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_alphaComp_argb(const primitives_t* prims, BENCH_DATA* data)
+{
+	const UINT32 step = data->width * 4;
+
+	if (prims->alphaComp_argb(data->rgb[0], step, data->rgb[1], step, data->rgb[2], step,
+	                          data->width, data->height) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_alphaCompPremultiplied_argb(const primitives_t* prims, BENCH_DATA* data)
+{
+	const UINT32 step = data->width * 4;
+
+	if (prims->alphaCompPremultiplied_argb(data->rgb[0], step, data->rgb[1], step, data->rgb[2],
+	                                       step, data->width,
+	                                       data->height) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_sign_16s(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->sign_16s(data->plane[0], data->planeDst[0], bench_len(data)) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_yCbCrToRGB_16s8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT16* src[3] = { data->plane[0], data->plane[1], data->plane[2] };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->yCbCrToRGB_16s8u_P3AC4R(src, data->width * sizeof(INT16), data->rgb[2],
+	                                   data->width * 4, BENCH_FORMAT,
+	                                   &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_yCbCrToRGB_16s16s_P3P3(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT16* src[3] = { data->plane[0], data->plane[1], data->plane[2] };
+	const prim_size_t roi = { data->width, data->height };
+	const INT32 step = (INT32)(data->width * sizeof(INT16));
+
+	if (prims->yCbCrToRGB_16s16s_P3P3(src, step, data->planeDst, step, &roi) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToYCbCr_16s16s_P3P3(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT16* src[3] = { data->plane[0], data->plane[1], data->plane[2] };
+	const prim_size_t roi = { data->width, data->height };
+	const INT32 step = (INT32)(data->width * sizeof(INT16));
+
+	if (prims->RGBToYCbCr_16s16s_P3P3(src, step, data->planeDst, step, &roi) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToRGB_16s8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT16* src[3] = { data->plane[0], data->plane[1], data->plane[2] };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->RGBToRGB_16s8u_P3AC4R(src, data->width * sizeof(INT16), data->rgb[2],
+	                                 data->width * 4, BENCH_FORMAT,
+	                                 &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_YCoCgToRGB_8u_AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const INT32 step = (INT32)data->width * 4;
+
+	if (prims->YCoCgToRGB_8u_AC4R(data->rgb[0], step, data->rgb[2], BENCH_FORMAT, step,
+	                              data->width, data->height, 1, FALSE) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGB565ToARGB_16u32u_C3C4(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->RGB565ToARGB_16u32u_C3C4((const UINT16*)data->rgb[0], (INT32)data->width * 2,
+	                                    (UINT32*)data->rgb[2], (INT32)data->width * 4, data->width,
+	                                    data->height, BENCH_FORMAT) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_YUV420ToRGB_8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	const UINT32 steps[3] = { data->width, data->width / 2, data->width / 2 };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->YUV420ToRGB_8u_P3AC4R(src, steps, data->rgb[2], data->width * 4, BENCH_FORMAT,
+	                                 &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToYUV420_8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const UINT32 steps[3] = { data->width, data->width / 2, data->width / 2 };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->RGBToYUV420_8u_P3AC4R(data->rgb[0], BENCH_FORMAT, data->width * 4, data->main,
+	                                 steps, &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToYUV444_8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	UINT32 steps[3] = { data->width, data->width, data->width };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->RGBToYUV444_8u_P3AC4R(data->rgb[0], BENCH_FORMAT, data->width * 4, data->main,
+	                                 steps, &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_YUV420CombineToYUV444(const primitives_t* prims, BENCH_DATA* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	const UINT32 steps420[3] = { data->width, data->width / 2, data->width / 2 };
+	const UINT32 steps444[3] = { data->width, data->width, data->width };
+	const RECTANGLE_16 rect = { 0, 0, (UINT16)data->width, (UINT16)data->height };
+
+	/* a AVC444 frame updates the luma and one of the chroma layouts */
+	if (prims->YUV420CombineToYUV444(AVC444_LUMA, src, steps420, data->width, data->height,
+	                                 data->main, steps444, &rect) != PRIMITIVES_SUCCESS)
+		return 0;
+
+	if (prims->YUV420CombineToYUV444(AVC444_CHROMAv1, src, steps420, data->width, data->height,
+	                                 data->main, steps444, &rect) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_YUV444SplitToYUV420(const primitives_t* prims, BENCH_DATA* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	const UINT32 steps420[3] = { data->width, data->width / 2, data->width / 2 };
+	const UINT32 steps444[3] = { data->width, data->width, data->width };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->YUV444SplitToYUV420(src, steps444, data->main, steps420, data->aux, steps420,
+	                               &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_YUV444ToRGB_8u_P3AC4R(const primitives_t* prims, BENCH_DATA* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	const UINT32 steps[3] = { data->width, data->width, data->width };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->YUV444ToRGB_8u_P3AC4R(src, steps, data->rgb[2], data->width * 4, BENCH_FORMAT,
+	                                 &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToAVC444YUV(const primitives_t* prims, BENCH_DATA* data)
+{
+	const UINT32 steps[3] = { data->width, data->width / 2, data->width / 2 };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->RGBToAVC444YUV(data->rgb[0], BENCH_FORMAT, data->width * 4, data->main, steps,
+	                          data->aux, steps, &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToAVC444YUVv2(const primitives_t* prims, BENCH_DATA* data)
+{
+	const UINT32 steps[3] = { data->width, data->width / 2, data->width / 2 };
+	const prim_size_t roi = { data->width, data->height };
+
+	if (prims->RGBToAVC444YUVv2(data->rgb[0], BENCH_FORMAT, data->width * 4, data->main, steps,
+	                            data->aux, steps, &roi) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RGBToPlanar_8u_C4P4(const primitives_t* prims, BENCH_DATA* data)
+{
+	BYTE* planes[4] = { data->main[0], data->main[1], data->main[2], data->aux[0] };
+
+	if (prims->RGBToPlanar_8u_C4P4(data->rgb[0], BENCH_FORMAT, (INT32)data->width * 4, planes,
+	                               data->width, data->height) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_planarDeltaEncode_8u_P1(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->planarDeltaEncode_8u_P1(data->yuv[0], data->main[0], data->width,
+	                                   data->height) != PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_planarRleScan_8u(const primitives_t* prims, BENCH_DATA* data)
+{
+	UINT32 y;
+
+	/* the planar encoder scans every line of a delta encoded plane for runs */
+	for (y = 0; y < data->height; y++)
+	{
+		const BYTE* line = &data->runs[(size_t)y * data->width];
+		UINT32 start = 0;
+
+		while (start < data->width)
+		{
+			UINT32 rawBytes = 0;
+			UINT32 runLength = 0;
+
+			if (prims->planarRleScan_8u(line, start, data->width, &rawBytes, &runLength) !=
+			    PRIMITIVES_SUCCESS)
+				return 0;
+
+			start += rawBytes + runLength;
+		}
+	}
+
+	return bench_pixels(data);
+}
+
+static UINT64 bench_RFXDecodeTiles_16s8u(const primitives_t* prims, BENCH_DATA* data)
+{
+	/* the whole frame is decoded as a single tile batch */
+	if ((data->tiles == 0) ||
+	    (prims->RFXDecodeTiles_16s8u(data->coefficients, data->quants, data->tiles, data->tileDst,
+	                                 data->tileStep, BENCH_FORMAT) != PRIMITIVES_SUCCESS))
+		return 0;
+	return 4096ull * data->tiles;
+}
+
+static UINT64 bench_base64Encode(const primitives_t* prims, BENCH_DATA* data)
+{
+	if (prims->base64Encode(data->rgb[0], bench_len(data) * 3, data->base64) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+static UINT64 bench_base64Decode(const primitives_t* prims, BENCH_DATA* data)
+{
+	UINT32 length = 0;
+
+	if (prims->base64Decode(data->base64, bench_len(data) * 4, data->rgb[2], &length) !=
+	    PRIMITIVES_SUCCESS)
+		return 0;
+	return bench_pixels(data);
+}
+
+#define BENCH_SLOT(slot)                                  \
+	{                                                     \
+		#slot, offsetof(primitives_t, slot), bench_##slot \
+	}
+
+/* Every function of primitives_t */
+static const BENCH_ENTRY bench_entries[] = {
+	BENCH_SLOT(copy),
+	BENCH_SLOT(copy_8u),
+	BENCH_SLOT(copy_8u_AC4r),
+	BENCH_SLOT(set_8u),
+	BENCH_SLOT(set_32s),
+	BENCH_SLOT(set_32u),
+	BENCH_SLOT(zero),
+	BENCH_SLOT(add_16s),
+	BENCH_SLOT(andC_32u),
+	BENCH_SLOT(orC_32u),
+	BENCH_SLOT(lShiftC_16s),
+	BENCH_SLOT(lShiftC_16u),
+	BENCH_SLOT(rShiftC_16s),
+	BENCH_SLOT(rShiftC_16u),
+	BENCH_SLOT(shiftC_16s),
+	BENCH_SLOT(shiftC_16u),
+	BENCH_SLOT(alphaComp_argb),
+	BENCH_SLOT(alphaCompPremultiplied_argb),
+	BENCH_SLOT(sign_16s),
+	BENCH_SLOT(yCbCrToRGB_16s8u_P3AC4R),
+	BENCH_SLOT(yCbCrToRGB_16s16s_P3P3),
+	BENCH_SLOT(RGBToYCbCr_16s16s_P3P3),
+	BENCH_SLOT(RGBToRGB_16s8u_P3AC4R),
+	BENCH_SLOT(YCoCgToRGB_8u_AC4R),
+	BENCH_SLOT(RGB565ToARGB_16u32u_C3C4),
+	BENCH_SLOT(YUV420ToRGB_8u_P3AC4R),
+	BENCH_SLOT(RGBToYUV420_8u_P3AC4R),
+	BENCH_SLOT(RGBToYUV444_8u_P3AC4R),
+	BENCH_SLOT(YUV420CombineToYUV444),
+	BENCH_SLOT(YUV444SplitToYUV420),
+	BENCH_SLOT(YUV444ToRGB_8u_P3AC4R),
+	BENCH_SLOT(RGBToAVC444YUV),
+	BENCH_SLOT(RGBToAVC444YUVv2),
+	BENCH_SLOT(RGBToPlanar_8u_C4P4),
+	BENCH_SLOT(planarDeltaEncode_8u_P1),
+	BENCH_SLOT(planarRleScan_8u),
+	BENCH_SLOT(RFXDecodeTiles_16s8u),
+	BENCH_SLOT(base64Encode),
+	BENCH_SLOT(base64Decode),
+};
+
+static primitives_fn bench_get(const primitives_t* prims, const BENCH_ENTRY* entry)
+{
+	primitives_fn fn;
+	memcpy(&fn, (const BYTE*)prims + entry->offset, sizeof(fn));
+	return fn;
+}
+
+/* The data is the same for every run, so that the results of two runs can be compared */
+static void bench_fill(BYTE* buffer, size_t size, UINT32 seed)
+{
+	size_t x;
+	UINT32 state = seed;
+
+	for (x = 0; x < size; x++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		buffer[x] = (BYTE)(state >> 24);
+	}
+}
+
+static void bench_data_free(BENCH_DATA* data)
+{
+	size_t x;
+
+	for (x = 0; x < 3; x++)
+	{
+		_aligned_free(data->rgb[x]);
+		_aligned_free(data->yuv[x]);
+		_aligned_free(data->main[x]);
+		_aligned_free(data->aux[x]);
+		_aligned_free(data->plane[x]);
+		_aligned_free(data->planeDst[x]);
+	}
+
+	_aligned_free(data->runs);
+	_aligned_free(data->coefficients);
+	free(data->quants);
+	free(data->tileDst);
+	free(data->tileStep);
+	free(data->base64);
+	ZeroMemory(data, sizeof(BENCH_DATA));
+}
+
+static BOOL bench_data_init(BENCH_DATA* data, UINT32 width, UINT32 height)
+{
+	size_t x, y;
+	const size_t pixels = (size_t)width * height;
+	/* CHROMAv1 reads up to 16 lines past the height, it works on the padded frame */
+	const size_t planeSize = (size_t)width * (height + 16);
+	static const UINT32 quant[10] = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+
+	ZeroMemory(data, sizeof(BENCH_DATA));
+	data->width = width;
+	data->height = height;
+	data->tiles = (width / BENCH_TILE_SIZE) * (height / BENCH_TILE_SIZE);
+
+	for (x = 0; x < 3; x++)
+	{
+		data->rgb[x] = _aligned_malloc(pixels * 4, 32);
+		data->yuv[x] = _aligned_malloc(planeSize, 32);
+		data->main[x] = _aligned_malloc(planeSize, 32);
+		data->aux[x] = _aligned_malloc(planeSize, 32);
+		data->plane[x] = _aligned_malloc(pixels * sizeof(INT16), 32);
+		data->planeDst[x] = _aligned_malloc(pixels * sizeof(INT16), 32);
+
+		if (!data->rgb[x] || !data->yuv[x] || !data->main[x] || !data->aux[x] ||
+		    !data->plane[x] || !data->planeDst[x])
+			goto fail;
+
+		bench_fill(data->rgb[x], pixels * 4, 0x12345678 + (UINT32)x);
+		bench_fill(data->yuv[x], planeSize, 0x87654321 + (UINT32)x);
+		ZeroMemory(data->main[x], planeSize);
+		ZeroMemory(data->aux[x], planeSize);
+		ZeroMemory(data->planeDst[x], pixels * sizeof(INT16));
+
+		/* RemoteFX coefficients are 11 bit fixed point values */
+		for (y = 0; y < pixels; y++)
+			data->plane[x][y] = (INT16)((data->yuv[x][y] - 128) << 4);
+	}
+
+	/* runs of a delta encoded plane, a few bytes long */
+	data->runs = _aligned_malloc(pixels, 32);
+	if (!data->runs)
+		goto fail;
+
+	bench_fill(data->runs, pixels, 0x5A5A5A5A);
+	for (y = 1; y < pixels; y++)
+	{
+		if ((data->runs[y] & 0x03) != 0)
+			data->runs[y] = data->runs[y - 1];
+	}
+
+	/* the input of the base64 decoder */
+	data->base64 = malloc(pixels * 4);
+	if (!data->base64 || (bench_base64Encode(primitives_get_generic(), data) == 0))
+		goto fail;
+
+	if (data->tiles > 0)
+	{
+		const UINT32 tilesPerLine = width / BENCH_TILE_SIZE;
+
+		data->coefficients = _aligned_malloc(3ull * 4096 * sizeof(INT16) * data->tiles, 32);
+		data->quants = calloc(3ull * 10 * data->tiles, sizeof(UINT32));
+		data->tileDst = calloc(data->tiles, sizeof(BYTE*));
+		data->tileStep = calloc(data->tiles, sizeof(UINT32));
+
+		if (!data->coefficients || !data->quants || !data->tileDst || !data->tileStep)
+			goto fail;
+
+		/* the decoded coefficients of a tile are mostly small */
+		for (y = 0; y < 3ull * 4096 * data->tiles; y++)
+			data->coefficients[y] = (INT16)((data->yuv[0][y % planeSize] % 64) - 32);
+
+		for (y = 0; y < 3ull * 10 * data->tiles; y++)
+			data->quants[y] = quant[y % ARRAYSIZE(quant)];
+
+		for (y = 0; y < data->tiles; y++)
+		{
+			const size_t tx = (y % tilesPerLine) * BENCH_TILE_SIZE;
+			const size_t ty = (y / tilesPerLine) * BENCH_TILE_SIZE;
+
+			data->tileDst[y] = &data->rgb[2][(ty * width + tx) * 4];
+			data->tileStep[y] = width * 4;
+		}
+	}
+
+	return TRUE;
+
+fail:
+	bench_data_free(data);
+	return FALSE;
+}
+
+static UINT64 bench_elapsed(STOPWATCH* sw)
+{
+	UINT32 sec = 0;
+	UINT32 usec = 0;
+	stopwatch_get_elapsed_time_in_useconds(sw, &sec, &usec);
+	return 1000000ull * sec + usec;
+}
+
+static UINT64 bench_cycles(void)
+{
+#if defined(BENCH_HAVE_TSC)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Calls are done in batches long enough for the timer, the fastest batch counts */
+static BOOL bench_measure(const BENCH_ENTRY* entry, const primitives_t* prims, BENCH_DATA* data,
+                          unsigned long time, BENCH_RESULT* result)
+{
+	BOOL rc = FALSE;
+	UINT64 i, total = 0;
+	UINT64 batches = 0;
+	UINT64 calls = 1;
+	UINT64 bestTime = UINT64_MAX;
+	UINT64 bestCycles = UINT64_MAX;
+	STOPWATCH* sw = stopwatch_create();
+
+	ZeroMemory(result, sizeof(BENCH_RESULT));
+
+	if (!sw)
+		return FALSE;
+
+	/* a first dry run to initialize caches and such */
+	result->pixels = entry->run(prims, data);
+	if (result->pixels == 0)
+		goto fail;
+
+	for (;;)
+	{
+		stopwatch_reset(sw);
+		stopwatch_start(sw);
+		for (i = 0; i < calls; i++)
+		{
+			if (entry->run(prims, data) == 0)
+				goto fail;
+		}
+		stopwatch_stop(sw);
+
+		if ((bench_elapsed(sw) >= BENCH_BATCH_TIME) || (calls >= (1ull << 20)))
+			break;
+		calls *= 2;
+	}
+
+	while ((batches < BENCH_MIN_BATCHES) || (total < time * 1000ull))
+	{
+		UINT64 elapsed, cycles;
+		const UINT64 start = bench_cycles();
+
+		stopwatch_reset(sw);
+		stopwatch_start(sw);
+		for (i = 0; i < calls; i++)
+		{
+			if (entry->run(prims, data) == 0)
+				goto fail;
+		}
+		stopwatch_stop(sw);
+
+		cycles = bench_cycles() - start;
+		elapsed = bench_elapsed(sw);
+		bestTime = MIN(bestTime, elapsed);
+		bestCycles = MIN(bestCycles, cycles);
+		total += elapsed;
+		batches++;
+	}
+
+	result->calls = calls * batches;
+	result->nsPerPixel = 1000.0 * (double)bestTime / (double)(calls * result->pixels);
+#if defined(BENCH_HAVE_TSC)
+	result->cyclesPerPixel = (double)bestCycles / (double)(calls * result->pixels);
+#else
+	result->cyclesPerPixel = -1.0;
+#endif
+	rc = TRUE;
+
+fail:
+	stopwatch_free(sw);
+	return rc;
+}
+
+static const char* bench_cpu_name(void)
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return "x86_64-avx2";
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3))
+		return "x86_64-ssse3";
+	return "x86_64-sse2";
+#elif defined(_M_IX86) || defined(__i386__)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return "x86-avx2";
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3))
+		return "x86-ssse3";
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return "x86-sse2";
+	return "x86";
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	return "arm64-neon";
+#elif defined(_M_ARM) || defined(__arm__)
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		return "arm-neon";
+	return "arm";
+#else
+	return "generic";
+#endif
+}
+
+static BOOL bench_baseline_add(BENCH_BASELINE* baseline, const char* function, const char* size,
+                               const char* implementation, double speedup)
+{
+	BENCH_BASELINE_ENTRY* entry;
+	BENCH_BASELINE_ENTRY* entries =
+	    realloc(baseline->entries, (baseline->count + 1) * sizeof(BENCH_BASELINE_ENTRY));
+
+	if (!entries)
+		return FALSE;
+
+	baseline->entries = entries;
+	entry = &entries[baseline->count++];
+	ZeroMemory(entry, sizeof(BENCH_BASELINE_ENTRY));
+	sprintf_s(entry->function, sizeof(entry->function), "%s", function);
+	sprintf_s(entry->size, sizeof(entry->size), "%s", size);
+	sprintf_s(entry->implementation, sizeof(entry->implementation), "%s", implementation);
+	entry->speedup = speedup;
+	return TRUE;
+}
+
+/* Lines of other machines are skipped, empty lines and lines starting with # are comments */
+static BOOL bench_baseline_load(const char* path, BENCH_BASELINE* baseline)
+{
+	BOOL rc = TRUE;
+	size_t lineNumber = 0;
+	char line[256] = { 0 };
+	const char* cpu = bench_cpu_name();
+	FILE* fp = winpr_fopen(path, "r");
+
+	ZeroMemory(baseline, sizeof(BENCH_BASELINE));
+
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open baseline %s\n", path);
+		return FALSE;
+	}
+
+	while (rc && fgets(line, sizeof(line), fp))
+	{
+		char machine[32] = { 0 };
+		char function[64] = { 0 };
+		char size[32] = { 0 };
+		char implementation[32] = { 0 };
+		double speedup = 0.0;
+
+		lineNumber++;
+		if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r') || (line[0] == '\0'))
+			continue;
+
+		if ((sscanf(line, "%31[^,],%63[^,],%31[^,],%31[^,],%lf", machine, function, size,
+		            implementation, &speedup) != 5) ||
+		    (speedup <= 0.0))
+		{
+			fprintf(stderr, "%s:%" PRIuz ": invalid baseline line\n", path, lineNumber);
+			rc = FALSE;
+		}
+		else if (strcmp(machine, cpu) == 0)
+			rc = bench_baseline_add(baseline, function, size, implementation, speedup);
+	}
+
+	fclose(fp);
+
+	if (!rc)
+	{
+		free(baseline->entries);
+		ZeroMemory(baseline, sizeof(BENCH_BASELINE));
+	}
+
+	return rc;
+}
+
+static BOOL bench_baseline_save(const char* path, const BENCH_BASELINE* baseline)
+{
+	size_t x;
+	BOOL rc = TRUE;
+	const char* cpu = bench_cpu_name();
+	FILE* fp = winpr_fopen(path, "w");
+
+	if (!fp)
+	{
+		fprintf(stderr, "failed to create baseline %s\n", path);
+		return FALSE;
+	}
+
+	if (fprintf(fp, "# freerdp-primitives-bench baseline, speedup over the generic code\n"
+	                "# cpu,function,size,implementation,speedup\n") < 0)
+		rc = FALSE;
+
+	for (x = 0; rc && (x < baseline->count); x++)
+	{
+		const BENCH_BASELINE_ENTRY* entry = &baseline->entries[x];
+
+		if (fprintf(fp, "%s,%s,%s,%s,%.2f\n", cpu, entry->function, entry->size,
+		            entry->implementation, entry->speedup) < 0)
+			rc = FALSE;
+	}
+
+	if (fclose(fp) != 0)
+		rc = FALSE;
+
+	if (!rc)
+		fprintf(stderr, "failed to write baseline %s\n", path);
+
+	return rc;
+}
+
+static const BENCH_BASELINE_ENTRY* bench_baseline_find(const BENCH_BASELINE* baseline,
+                                                       const char* function, const char* size,
+                                                       const char* implementation)
+{
+	size_t x;
+
+	if (!baseline)
+		return NULL;
+
+	for (x = 0; x < baseline->count; x++)
+	{
+		const BENCH_BASELINE_ENTRY* entry = &baseline->entries[x];
+
+		if ((strcmp(entry->function, function) == 0) && (strcmp(entry->size, size) == 0) &&
+		    (strcmp(entry->implementation, implementation) == 0))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static BOOL bench_selected(const char* list, const char* name)
+{
+	const size_t length = strlen(name);
+	const char* cur = list;
+
+	if (!list)
+		return TRUE;
+
+	while ((cur = strstr(cur, name)))
+	{
+		if (((cur == list) || (cur[-1] == ',')) && ((cur[length] == '\0') || (cur[length] == ',')))
+			return TRUE;
+
+		cur += length;
+	}
+
+	return FALSE;
+}
+
+static void bench_print_header(const BENCH_OPTIONS* options)
+{
+	if (options->json)
+		return;
+
+	if (options->csv)
+		printf("cpu,function,size,width,height,implementation,pixels,calls,ns_per_pixel,"
+		       "cycles_per_pixel,speedup,baseline,status\n");
+	else
+		printf("%-28s %-6s %-10s %10s %10s %8s %8s %s\n", "function", "size", "impl", "ns/px",
+		       "cycles/px", "speedup", "baseline", "status");
+}
+
+static void bench_print(const BENCH_OPTIONS* options, const BENCH_ENTRY* entry,
+                        const BENCH_SIZE* size, const char* implementation,
+                        const BENCH_RESULT* result, double speedup, double baseline,
+                        const char* status)
+{
+	const char* cpu = bench_cpu_name();
+
+	if (options->json)
+	{
+		printf("{\"cpu\":\"%s\",\"function\":\"%s\",\"size\":\"%s\",\"width\":%" PRIu32
+		       ",\"height\":%" PRIu32 ",\"implementation\":\"%s\",\"pixels\":%" PRIu64
+		       ",\"calls\":%" PRIu64 ",\"ns_per_pixel\":%.4f",
+		       cpu, entry->name, size->name, size->width, size->height, implementation,
+		       result->pixels, result->calls, result->nsPerPixel);
+		if (result->cyclesPerPixel >= 0.0)
+			printf(",\"cycles_per_pixel\":%.4f", result->cyclesPerPixel);
+		else
+			printf(",\"cycles_per_pixel\":null");
+		if (speedup > 0.0)
+			printf(",\"speedup\":%.3f", speedup);
+		else
+			printf(",\"speedup\":null");
+		if (baseline > 0.0)
+			printf(",\"baseline\":%.2f", baseline);
+		else
+			printf(",\"baseline\":null");
+		printf(",\"status\":\"%s\"}\n", status);
+	}
+	else if (options->csv)
+	{
+		printf("%s,%s,%s,%" PRIu32 ",%" PRIu32 ",%s,%" PRIu64 ",%" PRIu64 ",%.4f,", cpu,
+		       entry->name, size->name, size->width, size->height, implementation,
+		       result->pixels, result->calls, result->nsPerPixel);
+		if (result->cyclesPerPixel >= 0.0)
+			printf("%.4f", result->cyclesPerPixel);
+		printf(",");
+		if (speedup > 0.0)
+			printf("%.3f", speedup);
+		printf(",");
+		if (baseline > 0.0)
+			printf("%.2f", baseline);
+		printf(",%s\n", status);
+	}
+	else
+	{
+		char cycles[32] = "-";
+		char gain[32] = "-";
+		char base[32] = "-";
+
+		if (result->cyclesPerPixel >= 0.0)
+			sprintf_s(cycles, sizeof(cycles), "%.3f", result->cyclesPerPixel);
+		if (speedup > 0.0)
+			sprintf_s(gain, sizeof(gain), "%.2fx", speedup);
+		if (baseline > 0.0)
+			sprintf_s(base, sizeof(base), "%.2fx", baseline);
+		printf("%-28s %-6s %-10s %10.3f %10s %8s %8s %s\n", entry->name, size->name,
+		       implementation, result->nsPerPixel, cycles, gain, base, status);
+	}
+}
+
+static BOOL bench_run_entry(BENCH_OPTIONS* options, const BENCH_ENTRY* entry,
+                            const BENCH_SIZE* size, BENCH_DATA* data,
+                            const BENCH_IMPLEMENTATION* implementations, size_t count)
+{
+	size_t x, y;
+	BOOL rc = TRUE;
+	double genericTime = 0.0;
+	BOOL measured[BENCH_MAX_IMPLEMENTATIONS] = { 0 };
+
+	for (x = 0; x < count; x++)
+	{
+		BENCH_RESULT result = { 0 };
+		double speedup = 0.0;
+		double reference = 0.0;
+		const char* status = "";
+		const BENCH_BASELINE_ENTRY* baseline;
+		const char* name = implementations[x].name;
+		const primitives_fn fn = bench_get(implementations[x].prims, entry);
+		BOOL shared = (fn == NULL);
+
+		/* implementations sharing the code of an earlier one are not timed again */
+		for (y = 0; !shared && (y < x); y++)
+			shared = (bench_get(implementations[y].prims, entry) == fn);
+
+		if (shared)
+			continue;
+
+		measured[x] = TRUE;
+		if (!bench_measure(entry, implementations[x].prims, data, options->time, &result))
+		{
+			fprintf(stderr, "%s %s %s failed\n", entry->name, size->name, name);
+			rc = FALSE;
+			continue;
+		}
+
+		if (x == 0)
+			genericTime = result.nsPerPixel;
+		else if (genericTime > 0.0)
+			speedup = genericTime / result.nsPerPixel;
+
+		baseline = bench_baseline_find(options->baseline, entry->name, size->name, name);
+		if (baseline && (speedup > 0.0))
+		{
+			reference = baseline->speedup;
+			status = "ok";
+
+			if (speedup * 100.0 < reference * (100.0 - (double)options->tolerance))
+			{
+				status = "REGRESSION";
+				options->regression = TRUE;
+			}
+		}
+
+		if (options->update && (speedup > 0.0) &&
+		    !bench_baseline_add(options->update, entry->name, size->name, name, speedup))
+			rc = FALSE;
+
+		bench_print(options, entry, size, name, &result, speedup, reference, status);
+	}
+
+	/* an implementation of the baseline that is gone is a regression as well */
+	if (options->baseline)
+	{
+		for (x = 1; x < count; x++)
+		{
+			const char* name = implementations[x].name;
+
+			if (!measured[x] &&
+			    bench_baseline_find(options->baseline, entry->name, size->name, name))
+			{
+				fprintf(stderr, "%s %s: the %s implementation is missing\n", entry->name,
+				        size->name, name);
+				options->regression = TRUE;
+			}
+		}
+	}
+
+	return rc;
+}
+
+static size_t bench_get_implementations(BENCH_IMPLEMENTATION* implementations, size_t count)
+{
+	size_t used = 0;
+#if defined(WITH_SSE2) || defined(WITH_NEON)
+	static primitives_t cpu = { 0 };
+#endif
+#if defined(WITH_OPENCL)
+	static primitives_t gpu = { 0 };
+#endif
+
+	/* the optimized tables are set up by the first primitives_get */
+	primitives_get();
+
+	if (used < count)
+	{
+		implementations[used].name = "generic";
+		implementations[used++].prims = primitives_get_generic();
+	}
+
+#if defined(WITH_SSE2) || defined(WITH_NEON)
+	if ((used < count) && primitives_init(&cpu, PRIMITIVES_ONLY_CPU))
+	{
+		implementations[used].name = "optimized";
+		implementations[used++].prims = &cpu;
+	}
+#endif
+#if defined(WITH_OPENCL)
+	if ((used < count) && primitives_init(&gpu, PRIMITIVES_ONLY_GPU) &&
+	    (gpu.flags & PRIM_FLAGS_HAVE_EXTGPU))
+	{
+		implementations[used].name = "opencl";
+		implementations[used++].prims = &gpu;
+	}
+#endif
+
+	return used;
+}
+
+static BOOL bench_run(BENCH_OPTIONS* options)
+{
+	size_t x, y;
+	BOOL rc = TRUE;
+	BENCH_IMPLEMENTATION implementations[BENCH_MAX_IMPLEMENTATIONS] = { 0 };
+	const size_t count = bench_get_implementations(implementations, ARRAYSIZE(implementations));
+
+	bench_print_header(options);
+
+	for (x = 0; x < ARRAYSIZE(bench_sizes); x++)
+	{
+		BENCH_DATA data = { 0 };
+		const BENCH_SIZE* size = &bench_sizes[x];
+
+		if (!bench_selected(options->sizes, size->name))
+			continue;
+
+		if (!bench_data_init(&data, size->width, size->height))
+		{
+			fprintf(stderr, "failed to allocate the %s buffers\n", size->name);
+			return FALSE;
+		}
+
+		for (y = 0; y < ARRAYSIZE(bench_entries); y++)
+		{
+			const BENCH_ENTRY* entry = &bench_entries[y];
+
+			if (!bench_selected(options->functions, entry->name))
+				continue;
+
+			if (!bench_run_entry(options, entry, size, &data, implementations, count))
+				rc = FALSE;
+		}
+
+		bench_data_free(&data);
+	}
+
+	return rc;
+}
+
+static void usage(const char* name)
+{
+	size_t i;
+
+	printf("%s: benchmark the FreeRDP primitives\n\n", name);
+	printf("Usage: %s [options]\n", name);
+	printf("  -f <function,...>  functions to run (default all, see -l)\n");
+	printf("  -s <size,...>      sizes to run (default all:");
+	for (i = 0; i < ARRAYSIZE(bench_sizes); i++)
+		printf(" %s", bench_sizes[i].name);
+	printf(")\n");
+	printf("  -t <ms>            time every function for at least this long (default 200)\n");
+	printf("  -j                 print one JSON object per result\n");
+	printf("  -C                 print the results as CSV\n");
+	printf("  -b <file>          compare the speedups with a baseline, fail on regressions\n");
+	printf("  -r <percent>       tolerated speedup regression (default %d)\n",
+	       BENCH_DEFAULT_TOLERANCE);
+	printf("  -w <file>          write the speedups of this run as baseline\n");
+	printf("  -l                 list the functions and exit\n");
+}
+
+static BOOL bench_parse_size(const char* arg, unsigned long min, unsigned long max,
+                             unsigned long* value)
+{
+	char* end = NULL;
+
+	errno = 0;
+	*value = strtoul(arg, &end, 0);
+	return (errno == 0) && end && (*end == '\0') && (*value >= min) && (*value <= max);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int rc = 1;
+	const char* baselineFile = NULL;
+	const char* updateFile = NULL;
+	BENCH_BASELINE baseline = { 0 };
+	BENCH_BASELINE update = { 0 };
+	BENCH_OPTIONS options = { 0 };
+
+	options.time = 200;
+	options.tolerance = BENCH_DEFAULT_TOLERANCE;
+
+	for (index = 1; index < argc; index++)
+	{
+		const char* arg = argv[index];
+
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		else if (strcmp(arg, "-l") == 0)
+		{
+			size_t i;
+
+			for (i = 0; i < ARRAYSIZE(bench_entries); i++)
+				printf("%s\n", bench_entries[i].name);
+			return 0;
+		}
+		else if (strcmp(arg, "-j") == 0)
+			options.json = TRUE;
+		else if (strcmp(arg, "-C") == 0)
+			options.csv = TRUE;
+		else if (index + 1 >= argc)
+		{
+			fprintf(stderr, "missing argument for %s\n", arg);
+			return 1;
+		}
+		else if (strcmp(arg, "-f") == 0)
+			options.functions = argv[++index];
+		else if (strcmp(arg, "-s") == 0)
+			options.sizes = argv[++index];
+		else if (strcmp(arg, "-b") == 0)
+			baselineFile = argv[++index];
+		else if (strcmp(arg, "-w") == 0)
+			updateFile = argv[++index];
+		else if (strcmp(arg, "-t") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 1, 60000, &options.time))
+			{
+				fprintf(stderr, "invalid time %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "-r") == 0)
+		{
+			if (!bench_parse_size(argv[++index], 0, 99, &options.tolerance))
+			{
+				fprintf(stderr, "invalid tolerance %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (baselineFile)
+	{
+		if (!bench_baseline_load(baselineFile, &baseline))
+			return 1;
+		options.baseline = &baseline;
+	}
+
+	if (updateFile)
+		options.update = &update;
+
+	if (bench_run(&options))
+		rc = 0;
+
+	if (rc == 0 && updateFile && !bench_baseline_save(updateFile, &update))
+		rc = 1;
+
+	if (options.regression)
+	{
+		fprintf(stderr, "%s: regressions against the baseline %s\n", bench_cpu_name(),
+		        baselineFile);
+		rc = 1;
+	}
+
+	free(baseline.entries);
+	free(update.entries);
+	return rc;
+}
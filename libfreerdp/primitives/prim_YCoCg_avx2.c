@@ -0,0 +1,139 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized YCoCg<->RGB conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+/* Byte shuffle moving BGRA ordered pixels to the byte order of the destination format */
+static BOOL avx2_YCoCg_get_shuffle(UINT32 DstFormat, __m256i* shuffle, BOOL* identity)
+{
+	BYTE offsets[4];
+	BYTE alpha;
+	char mask[32];
+	size_t x;
+
+	if (!get_pixel_layout(DstFormat, offsets, &alpha))
+		return FALSE;
+
+	/* the alpha byte is written for all formats, just as the generic code does */
+	for (x = 0; x < 32; x += 4)
+	{
+		mask[x + offsets[0]] = (char)((x % 16) + 2);
+		mask[x + offsets[1]] = (char)((x % 16) + 1);
+		mask[x + offsets[2]] = (char)((x % 16) + 0);
+		mask[x + offsets[3]] = (char)((x % 16) + 3);
+	}
+
+	*identity = (offsets[0] == 2) && (offsets[1] == 1) && (offsets[2] == 0);
+	*shuffle = _mm256_loadu_si256((const __m256i*)mask);
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_YCoCgToRGB_8u_AC4R(const BYTE* pSrc, INT32 srcStep, BYTE* pDst,
+                                         UINT32 DstFormat, INT32 dstStep, UINT32 width,
+                                         UINT32 height, UINT8 shift, BOOL withAlpha)
+{
+	UINT32 y;
+	BOOL identity;
+	__m256i dstShuffle;
+	/* Shift left by "shift" and divide by two is the same as shift left by "shift-1". */
+	const int cll = shift - 1;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i mask = _mm256_set1_epi8((char)(0xFFU << cll));
+	const __m256i opaque = _mm256_set1_epi16(0xFF);
+	/* Cg,Co,Y,A of 4 pixels to planes of 4 bytes */
+	const __m256i planes = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+	                                        0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	/* 8 bytes of one channel followed by 8 of another to interleaved pairs */
+	const __m256i pairs = _mm256_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15,
+	                                       0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+
+	if ((shift < 1) || (shift > 8) || (width < 16) ||
+	    !avx2_YCoCg_get_shuffle(DstFormat, &dstShuffle, &identity))
+		return generic->YCoCgToRGB_8u_AC4R(pSrc, srcStep, pDst, DstFormat, dstStep, width, height,
+		                                   shift, withAlpha);
+
+	for (y = 0; y < height; y++)
+	{
+		UINT32 x;
+		const BYTE* sptr = &pSrc[1ll * srcStep * y];
+		BYTE* dptr = &pDst[1ll * dstStep * y];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			/* Each lane holds the planes of 4 pixels, lane 0 of a pixels 0-3, of b 8-11 */
+			const __m256i a = _mm256_shuffle_epi8(
+			    _mm256_loadu_si256((const __m256i*)&sptr[x * 4]), planes);
+			const __m256i b = _mm256_shuffle_epi8(
+			    _mm256_loadu_si256((const __m256i*)&sptr[x * 4 + 32]), planes);
+			/* Cg and Co, lane 0 holds pixels 0-3 and 8-11, lane 1 pixels 4-7 and 12-15 */
+			const __m256i go =
+			    _mm256_and_si256(_mm256_slli_epi16(_mm256_unpacklo_epi32(a, b), cll), mask);
+			const __m256i ya = _mm256_unpackhi_epi32(a, b);
+			/* sign extend the shifted chroma bytes */
+			const __m256i Cg = _mm256_srai_epi16(_mm256_unpacklo_epi8(go, go), 8);
+			const __m256i Co = _mm256_srai_epi16(_mm256_unpackhi_epi8(go, go), 8);
+			const __m256i Y = _mm256_unpacklo_epi8(ya, zero);
+			const __m256i A = withAlpha ? _mm256_unpackhi_epi8(ya, zero) : opaque;
+			const __m256i T = _mm256_sub_epi16(Y, Cg);
+			const __m256i B = _mm256_add_epi16(T, Co);
+			const __m256i G = _mm256_add_epi16(Y, Cg);
+			const __m256i R = _mm256_sub_epi16(T, Co);
+			const __m256i bg = _mm256_shuffle_epi8(_mm256_packus_epi16(B, G), pairs);
+			const __m256i ra = _mm256_shuffle_epi8(_mm256_packus_epi16(R, A), pairs);
+			/* the lane order of the planes puts pixels 0-7 in lo and 8-15 in hi */
+			__m256i lo = _mm256_unpacklo_epi16(bg, ra);
+			__m256i hi = _mm256_unpackhi_epi16(bg, ra);
+
+			if (!identity)
+			{
+				lo = _mm256_shuffle_epi8(lo, dstShuffle);
+				hi = _mm256_shuffle_epi8(hi, dstShuffle);
+			}
+
+			_mm256_storeu_si256((__m256i*)&dptr[x * 4], lo);
+			_mm256_storeu_si256((__m256i*)&dptr[x * 4 + 32], hi);
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status =
+			    generic->YCoCgToRGB_8u_AC4R(&sptr[x * 4], srcStep, &dptr[x * 4], DstFormat,
+			                                dstStep, width - x, 1, shift, withAlpha);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_YCoCg_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->YCoCgToRGB_8u_AC4R = avx2_YCoCgToRGB_8u_AC4R;
+}
@@ -564,6 +564,9 @@ void primitives_init_YCoCg_opt(primitives_t* prims)
 		prims->YCoCgToRGB_8u_AC4R = ssse3_YCoCgRToRGB_8u_AC4R;
 	}
 
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_YCoCg_avx2(prims);
+
 #elif defined(WITH_NEON)
 
 	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
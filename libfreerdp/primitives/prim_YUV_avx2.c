@@ -0,0 +1,1076 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized YUV/RGB conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* Store the first n (16, 8 or 4) bytes of v */
+static INLINE void avx2_store_half(BYTE* dst, __m128i v, UINT32 n)
+{
+	if (n == 16)
+		_mm_storeu_si128((__m128i*)dst, v);
+	else if (n == 8)
+		_mm_storel_epi64((__m128i*)dst, v);
+	else
+	{
+		const INT32 val = _mm_cvtsi128_si32(v);
+		memcpy(dst, &val, sizeof(val));
+	}
+}
+
+/* Store the first n (32, 16, 8 or 4) bytes of v */
+static INLINE void avx2_store_bytes(BYTE* dst, __m256i v, UINT32 n)
+{
+	if (n == 32)
+		_mm256_storeu_si256((__m256i*)dst, v);
+	else
+		avx2_store_half(dst, _mm256_castsi256_si128(v), n);
+}
+
+/****************************************************************************/
+/* AVX2 YUV -> RGB conversion                                               */
+/****************************************************************************/
+
+/* The 403 and 475 factors are split into 256 + x, that keeps all products in 16 bit and
+ * gives the same results as YUV2R, YUV2G and YUV2B */
+static INLINE void avx2_YUV2RGB16(__m256i y, __m256i u, __m256i v, __m256i* r, __m256i* g,
+                                  __m256i* b)
+{
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i d = _mm256_sub_epi16(u, c128);
+	const __m256i e = _mm256_sub_epi16(v, c128);
+	const __m256i rd = _mm256_srai_epi16(_mm256_mullo_epi16(e, _mm256_set1_epi16(147)), 8);
+	const __m256i gd = _mm256_srai_epi16(
+	    _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(-48)),
+	                     _mm256_mullo_epi16(e, _mm256_set1_epi16(-120))),
+	    8);
+	const __m256i bd = _mm256_srai_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(219)), 8);
+	*r = _mm256_add_epi16(y, _mm256_add_epi16(e, rd));
+	*g = _mm256_add_epi16(y, gd);
+	*b = _mm256_add_epi16(y, _mm256_add_epi16(d, bd));
+}
+
+/* Write 8 BGRX pixels, the X bytes of the destination are not touched */
+static INLINE void avx2_store_BGRX(BYTE* dst, __m256i bgr)
+{
+	const __m256i alpha = _mm256_set1_epi32((INT32)0xFF000000);
+	const __m256i old = _mm256_loadu_si256((const __m256i*)dst);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_or_si256(bgr, _mm256_and_si256(old, alpha)));
+}
+
+/* Convert the first n (32 or 16) pixels of Y, U and V (in pixel order) to BGRX */
+static INLINE void avx2_YUV444Pixels(BYTE* dst, __m256i Y, __m256i U, __m256i V, UINT32 n)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i rl, gl, bl, rh, gh, bh;
+	__m256i R, G, B, bgLo, bgHi, rxLo, rxHi, p0, p1, p2, p3;
+	avx2_YUV2RGB16(_mm256_unpacklo_epi8(Y, zero), _mm256_unpacklo_epi8(U, zero),
+	               _mm256_unpacklo_epi8(V, zero), &rl, &gl, &bl);
+	avx2_YUV2RGB16(_mm256_unpackhi_epi8(Y, zero), _mm256_unpackhi_epi8(U, zero),
+	               _mm256_unpackhi_epi8(V, zero), &rh, &gh, &bh);
+	/* unpack and pack work per 128 bit half, the pixel order is restored here */
+	R = _mm256_packus_epi16(rl, rh);
+	G = _mm256_packus_epi16(gl, gh);
+	B = _mm256_packus_epi16(bl, bh);
+	bgLo = _mm256_unpacklo_epi8(B, G);
+	bgHi = _mm256_unpackhi_epi8(B, G);
+	rxLo = _mm256_unpacklo_epi8(R, zero);
+	rxHi = _mm256_unpackhi_epi8(R, zero);
+	p0 = _mm256_unpacklo_epi16(bgLo, rxLo); /* pixels 0 - 3 and 16 - 19 */
+	p1 = _mm256_unpackhi_epi16(bgLo, rxLo); /* pixels 4 - 7 and 20 - 23 */
+	p2 = _mm256_unpacklo_epi16(bgHi, rxHi); /* pixels 8 - 11 and 24 - 27 */
+	p3 = _mm256_unpackhi_epi16(bgHi, rxHi); /* pixels 12 - 15 and 28 - 31 */
+	avx2_store_BGRX(dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+	avx2_store_BGRX(dst + 32, _mm256_permute2x128_si256(p2, p3, 0x20));
+
+	if (n == 32)
+	{
+		avx2_store_BGRX(dst + 64, _mm256_permute2x128_si256(p0, p1, 0x31));
+		avx2_store_BGRX(dst + 96, _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+}
+
+/* Duplicate the 16 (or 8) chroma samples of v for 32 (or 16) pixels */
+static INLINE __m256i avx2_duplicate(__m128i v)
+{
+	const __m256i q = _mm256_permute4x64_epi64(_mm256_castsi128_si256(v), 0x50);
+	return _mm256_unpacklo_epi8(q, q);
+}
+
+static pstatus_t avx2_YUV420ToRGB_BGRX(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                       UINT32 dstStep, const prim_size_t* roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	UINT32 y;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		BYTE* dst = pDst + dstStep * y;
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + (y / 2) * srcStep[1];
+		const BYTE* VData = pSrc[2] + (y / 2) * srcStep[2];
+
+		for (x = 0; x + 32 <= nWidth; x += 32)
+		{
+			const __m256i Y = _mm256_loadu_si256((const __m256i*)&YData[x]);
+			const __m256i U = avx2_duplicate(_mm_loadu_si128((const __m128i*)&UData[x / 2]));
+			const __m256i V = avx2_duplicate(_mm_loadu_si128((const __m128i*)&VData[x / 2]));
+			avx2_YUV444Pixels(&dst[4 * x], Y, U, V, 32);
+		}
+
+		if (x + 16 <= nWidth)
+		{
+			const __m256i Y = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&YData[x]));
+			const __m256i U = avx2_duplicate(_mm_loadl_epi64((const __m128i*)&UData[x / 2]));
+			const __m256i V = avx2_duplicate(_mm_loadl_epi64((const __m128i*)&VData[x / 2]));
+			avx2_YUV444Pixels(&dst[4 * x], Y, U, V, 16);
+			x += 16;
+		}
+
+		for (; x < nWidth; x++)
+		{
+			const BYTE Y = YData[x];
+			const BYTE U = UData[x / 2];
+			const BYTE V = VData[x / 2];
+			const BYTE r = YUV2R(Y, U, V);
+			const BYTE g = YUV2G(Y, U, V);
+			const BYTE b = YUV2B(Y, U, V);
+			writePixelBGRX(&dst[4 * x], 4, PIXEL_FORMAT_BGRX32, r, g, b, 0);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420ToRGB(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                  UINT32 dstStep, UINT32 DstFormat, const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV420ToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV420ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R_BGRX(const BYTE* const* pSrc, const UINT32* srcStep,
+                                                 BYTE* pDst, UINT32 dstStep,
+                                                 const prim_size_t* roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	UINT32 y;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		BYTE* dst = pDst + dstStep * y;
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + y * srcStep[1];
+		const BYTE* VData = pSrc[2] + y * srcStep[2];
+
+		for (x = 0; x + 32 <= nWidth; x += 32)
+		{
+			const __m256i Y = _mm256_loadu_si256((const __m256i*)&YData[x]);
+			const __m256i U = _mm256_loadu_si256((const __m256i*)&UData[x]);
+			const __m256i V = _mm256_loadu_si256((const __m256i*)&VData[x]);
+			avx2_YUV444Pixels(&dst[4 * x], Y, U, V, 32);
+		}
+
+		if (x + 16 <= nWidth)
+		{
+			const __m256i Y = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&YData[x]));
+			const __m256i U = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&UData[x]));
+			const __m256i V = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)&VData[x]));
+			avx2_YUV444Pixels(&dst[4 * x], Y, U, V, 16);
+			x += 16;
+		}
+
+		for (; x < nWidth; x++)
+		{
+			const BYTE Y = YData[x];
+			const BYTE U = UData[x];
+			const BYTE V = VData[x];
+			const BYTE r = YUV2R(Y, U, V);
+			const BYTE g = YUV2G(Y, U, V);
+			const BYTE b = YUV2B(Y, U, V);
+			writePixelBGRX(&dst[4 * x], 4, PIXEL_FORMAT_BGRX32, r, g, b, 0);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE* const* pSrc, const UINT32* srcStep,
+                                            BYTE* pDst, UINT32 dstStep, UINT32 DstFormat,
+                                            const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV444ToRGB_8u_P3AC4R_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> YUV420 conversion                                            */
+/****************************************************************************/
+
+/* Same factors and shifts as prim_YUV_ssse3.c (see the notes there), both implementations
+ * produce identical results. The factors are given in BGRX byte order. */
+#define AVX2_BGRX_FACTORS(b, g, r) \
+	_mm256_set1_epi32((INT32)(((UINT32)(BYTE)(r) << 16) | ((UINT32)(BYTE)(g) << 8) | (BYTE)(b)))
+#define BGRX_Y_FACTORS AVX2_BGRX_FACTORS(9, 92, 27)
+#define BGRX_U_FACTORS AVX2_BGRX_FACTORS(127, -99, -29)
+#define BGRX_V_FACTORS AVX2_BGRX_FACTORS(-12, -116, 127)
+#define CONST128_FACTORS _mm256_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+/* Load the BGRX pixels 8 * i to 8 * i + 7 of a block of n (32 or 16) pixels, pixels past n
+ * are zero */
+static INLINE __m256i avx2_load_BGRX(const BYTE* src, UINT32 n, UINT32 i)
+{
+	if (8 * i >= n)
+		return _mm256_setzero_si256();
+
+	return _mm256_loadu_si256((const __m256i*)&src[32 * i]);
+}
+
+/* hadd and pack work per 128 bit half, this restores the pixel order of 32 results */
+static INLINE __m256i avx2_pixel_order(__m256i v)
+{
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+/* Luma of 32 pixels */
+static INLINE __m256i avx2_BGRX_Y(__m256i x1, __m256i x2, __m256i x3, __m256i x4)
+{
+	const __m256i y_factors = BGRX_Y_FACTORS;
+	const __m256i y1 =
+	    _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x1, y_factors),
+	                                        _mm256_maddubs_epi16(x2, y_factors)),
+	                      Y_SHIFT);
+	const __m256i y2 =
+	    _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x3, y_factors),
+	                                        _mm256_maddubs_epi16(x4, y_factors)),
+	                      Y_SHIFT);
+	return avx2_pixel_order(_mm256_packus_epi16(y1, y2));
+}
+
+/* U or V of 32 pixels (U_SHIFT and V_SHIFT are the same). If pairs is not NULL it receives
+ * the 16 bit sums of horizontally adjacent pixels (before adding 128), in the word order
+ * avx2_pack_UV expects. */
+static INLINE __m256i avx2_BGRX_Chroma(__m256i x1, __m256i x2, __m256i x3, __m256i x4,
+                                       __m256i factors, __m256i* pairs)
+{
+	const __m256i vector128 = CONST128_FACTORS;
+	const __m256i c1 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x1, factors), _mm256_maddubs_epi16(x2, factors)),
+	    U_SHIFT);
+	const __m256i c2 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x3, factors), _mm256_maddubs_epi16(x4, factors)),
+	    U_SHIFT);
+
+	if (pairs)
+		*pairs = _mm256_hadd_epi16(c1, c2);
+
+	return avx2_pixel_order(_mm256_sub_epi8(_mm256_packs_epi16(c1, c2), vector128));
+}
+
+/* Pack 16 U and 16 V words, ordered the way two hadd steps leave them, into the U (low half)
+ * and V (high half) bytes and add 128 */
+static INLINE __m256i avx2_pack_UV(__m256i u, __m256i v)
+{
+	const __m256i vector128 = CONST128_FACTORS;
+	const __m256i order = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+	                                       0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(u, v), 0xD8);
+	return _mm256_sub_epi8(_mm256_shuffle_epi8(packed, order), vector128);
+}
+
+/* Even samples of 32 in the low, odd samples in the high 128 bits */
+static INLINE __m256i avx2_split_even_odd(__m256i v)
+{
+	const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+	                                       0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, split), 0xD8);
+}
+
+/* Odd samples of 32 in the low 128 bits, samples 4x in the low and samples 4x + 2 in the
+ * high 64 bits of the upper half */
+static INLINE __m256i avx2_split_odd_quarters(__m256i v)
+{
+	const __m256i split = _mm256_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, 0, 4, 8, 12, 2, 6, 10, 14,
+	                                       1, 3, 5, 7, 9, 11, 13, 15, 0, 4, 8, 12, 2, 6, 10, 14);
+	const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 6, 3, 7);
+	return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, split), order);
+}
+
+/* compute the luma (Y) component from a single rgb source line */
+static INLINE void avx2_RGBToYUV420_BGRX_Y(const BYTE* src, BYTE* dst, UINT32 width)
+{
+	UINT32 x;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const UINT32 n = MIN(32, width - x);
+		const BYTE* argb = &src[4 * x];
+		const __m256i y =
+		    avx2_BGRX_Y(avx2_load_BGRX(argb, n, 0), avx2_load_BGRX(argb, n, 1),
+		                avx2_load_BGRX(argb, n, 2), avx2_load_BGRX(argb, n, 3));
+		avx2_store_bytes(&dst[x], y, n);
+	}
+}
+
+/* compute the chrominance (UV) components from two rgb source lines */
+static INLINE void avx2_RGBToYUV420_BGRX_UV(const BYTE* src1, const BYTE* src2, BYTE* dst1,
+                                            BYTE* dst2, UINT32 width)
+{
+	UINT32 x;
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const UINT32 n = MIN(32, width - x);
+		const BYTE* rgb1 = &src1[4 * x];
+		const BYTE* rgb2 = &src2[4 * x];
+		/* subsample 32x2 pixels into 32x1 pixels */
+		const __m256 x0 = _mm256_castsi256_ps(
+		    _mm256_avg_epu8(avx2_load_BGRX(rgb1, n, 0), avx2_load_BGRX(rgb2, n, 0)));
+		const __m256 x1 = _mm256_castsi256_ps(
+		    _mm256_avg_epu8(avx2_load_BGRX(rgb1, n, 1), avx2_load_BGRX(rgb2, n, 1)));
+		const __m256 x2 = _mm256_castsi256_ps(
+		    _mm256_avg_epu8(avx2_load_BGRX(rgb1, n, 2), avx2_load_BGRX(rgb2, n, 2)));
+		const __m256 x3 = _mm256_castsi256_ps(
+		    _mm256_avg_epu8(avx2_load_BGRX(rgb1, n, 3), avx2_load_BGRX(rgb2, n, 3)));
+		/* subsample these 32x1 pixels into 16x1 pixels, same shuffle controls as SSSE3 */
+		const __m256i s01 =
+		    _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(x0, x1, 0x88)),
+		                    _mm256_castps_si256(_mm256_shuffle_ps(x0, x1, 0xdd)));
+		const __m256i s23 =
+		    _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(x2, x3, 0x88)),
+		                    _mm256_castps_si256(_mm256_shuffle_ps(x2, x3, 0xdd)));
+		const __m256i u = _mm256_srai_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(s01, u_factors),
+		                                                      _mm256_maddubs_epi16(s23, u_factors)),
+		                                    U_SHIFT);
+		const __m256i v = _mm256_srai_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(s01, v_factors),
+		                                                      _mm256_maddubs_epi16(s23, v_factors)),
+		                                    V_SHIFT);
+		const __m256i uv = avx2_pack_UV(u, v);
+		avx2_store_half(&dst1[x / 2], _mm256_castsi256_si128(uv), n / 2);
+		avx2_store_half(&dst2[x / 2], _mm256_extracti128_si256(uv, 1), n / 2);
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                       BYTE* pDst[3], const UINT32 dstStep[3],
+                                       const prim_size_t* roi)
+{
+	UINT32 y;
+	const BYTE* argb = pSrc;
+	BYTE* ydst = pDst[0];
+	BYTE* udst = pDst[1];
+	BYTE* vdst = pDst[2];
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 16)
+		return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+	for (y = 0; y < roi->height - 1; y += 2)
+	{
+		const BYTE* line1 = argb;
+		const BYTE* line2 = argb + srcStep;
+		avx2_RGBToYUV420_BGRX_UV(line1, line2, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line1, ydst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line2, ydst + dstStep[0], roi->width);
+		argb += 2 * srcStep;
+		ydst += 2 * dstStep[0];
+		udst += 1 * dstStep[1];
+		vdst += 1 * dstStep[2];
+	}
+
+	if (roi->height & 1)
+	{
+		/* pass the same last line of an odd height twice for UV */
+		avx2_RGBToYUV420_BGRX_UV(argb, argb, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(argb, ydst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                  BYTE* pDst[3], const UINT32 dstStep[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> AVC444-YUV conversion                                        */
+/****************************************************************************/
+
+/* Distribute the U (or V) values of n pixels of an even (ce) and odd (co) line according to
+ * 3.3.8.3.2 YUV420p Stream Combination for YUV444 mode:
+ * 2x   2y    -> b2
+ * x    2y+1  -> b4
+ * 2x+1 2y    -> b6 */
+static INLINE void avx2_RGBToAVC444YUV_SPLIT(__m256i ce, __m256i co, BOOL odd, BYTE* b2,
+                                             BYTE* b4, BYTE* b6, UINT32 n)
+{
+	const __m256i split = avx2_split_even_odd(ce);
+
+	if (odd)
+	{
+		/* average of the 2x2 block */
+		const __m256i ones = _mm256_set1_epi8(1);
+		const __m256i sum =
+		    _mm256_add_epi16(_mm256_maddubs_epi16(ce, ones), _mm256_maddubs_epi16(co, ones));
+		const __m256i avg16 = _mm256_srli_epi16(sum, 2);
+		const __m256i avg = _mm256_packus_epi16(avg16, avg16);
+		avx2_store_bytes(b2, _mm256_permute4x64_epi64(avg, 0x08), n / 2);
+		avx2_store_bytes(b4, co, n);
+	}
+	else
+		avx2_store_bytes(b2, split, n / 2);
+
+	avx2_store_half(b6, _mm256_extracti128_si256(split, 1), n / 2);
+}
+
+static INLINE void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(const BYTE* srcEven, const BYTE* srcOdd,
+                                                       BYTE* b1Even, BYTE* b1Odd, BYTE* b2,
+                                                       BYTE* b3, BYTE* b4, BYTE* b5, BYTE* b6,
+                                                       BYTE* b7, UINT32 width)
+{
+	UINT32 x;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const UINT32 n = MIN(32, width - x);
+		const BYTE* argbEven = &srcEven[4 * x];
+		const BYTE* argbOdd = &srcOdd[4 * x];
+		const __m256i xe1 = avx2_load_BGRX(argbEven, n, 0);
+		const __m256i xe2 = avx2_load_BGRX(argbEven, n, 1);
+		const __m256i xe3 = avx2_load_BGRX(argbEven, n, 2);
+		const __m256i xe4 = avx2_load_BGRX(argbEven, n, 3);
+		const __m256i xo1 = avx2_load_BGRX(argbOdd, n, 0);
+		const __m256i xo2 = avx2_load_BGRX(argbOdd, n, 1);
+		const __m256i xo3 = avx2_load_BGRX(argbOdd, n, 2);
+		const __m256i xo4 = avx2_load_BGRX(argbOdd, n, 3);
+		const __m256i ue = avx2_BGRX_Chroma(xe1, xe2, xe3, xe4, u_factors, NULL);
+		const __m256i ve = avx2_BGRX_Chroma(xe1, xe2, xe3, xe4, v_factors, NULL);
+		__m256i uo = zero;
+		__m256i vo = zero;
+		/* store y [b1] */
+		avx2_store_bytes(&b1Even[x], avx2_BGRX_Y(xe1, xe2, xe3, xe4), n);
+
+		if (b1Odd)
+		{
+			avx2_store_bytes(&b1Odd[x], avx2_BGRX_Y(xo1, xo2, xo3, xo4), n);
+			uo = avx2_BGRX_Chroma(xo1, xo2, xo3, xo4, u_factors, NULL);
+			vo = avx2_BGRX_Chroma(xo1, xo2, xo3, xo4, v_factors, NULL);
+		}
+
+		avx2_RGBToAVC444YUV_SPLIT(ue, uo, b1Odd != NULL, &b2[x / 2], &b4[x], &b6[x / 2], n);
+		avx2_RGBToAVC444YUV_SPLIT(ve, vo, b1Odd != NULL, &b3[x / 2], &b5[x], &b7[x / 2], n);
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                          BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                          const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	UINT32 y;
+	const BYTE* pMaxSrc = pSrc + (roi->height - 1) * srcStep;
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 16)
+		return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+		                               roi);
+
+	for (y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = y < roi->height ? pSrc + y * srcStep : pMaxSrc;
+		const BYTE* srcOdd = !last ? pSrc + (y + 1) * srcStep : pMaxSrc;
+		const UINT32 i = y >> 1;
+		const UINT32 n = (i & ~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = !last ? (b1Even + dst1Step[0]) : NULL;
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + dst2Step[0] * n;
+		BYTE* b5 = b4 + 8 * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                     BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                     const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                dst2Step, roi);
+
+		default:
+			return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/* Distribute the U (or V) values of n pixels of an even (ce) and odd (co) line according to
+ * 3.3.8.3.3 YUV420p Stream Combination for YUV444v2 mode, lumaAvg is the 2x2 average
+ * from avx2_pack_UV:
+ * 2x   2y    -> lumaDst
+ * 2x+1  y    -> yEvenChromaDst, yOddChromaDst
+ * 4x   2y+1  -> chromaDst1
+ * 4x+2 2y+1  -> chromaDst2 */
+static INLINE void avx2_RGBToAVC444YUVv2_SPLIT(__m256i ce, __m256i co, __m128i lumaAvg, BOOL odd,
+                                               BYTE* lumaDst, BYTE* yEvenChromaDst,
+                                               BYTE* yOddChromaDst, BYTE* chromaDst1,
+                                               BYTE* chromaDst2, UINT32 n)
+{
+	const __m256i even = avx2_split_even_odd(ce);
+	avx2_store_half(yEvenChromaDst, _mm256_extracti128_si256(even, 1), n / 2);
+
+	if (odd)
+	{
+		const __m256i quarters = avx2_split_odd_quarters(co);
+		const __m128i q = _mm256_extracti128_si256(quarters, 1);
+		avx2_store_half(lumaDst, lumaAvg, n / 2);
+		avx2_store_half(yOddChromaDst, _mm256_castsi256_si128(quarters), n / 2);
+		avx2_store_half(chromaDst1, q, n / 4);
+		avx2_store_half(chromaDst2, _mm_srli_si128(q, 8), n / 4);
+	}
+	else
+		avx2_store_half(lumaDst, _mm256_castsi256_si128(even), n / 2);
+}
+
+static INLINE void avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+    const BYTE* srcEven, const BYTE* srcOdd, BYTE* yLumaDstEven, BYTE* yLumaDstOdd, BYTE* uLumaDst,
+    BYTE* vLumaDst, BYTE* yEvenChromaDst1, BYTE* yEvenChromaDst2, BYTE* yOddChromaDst1,
+    BYTE* yOddChromaDst2, BYTE* uChromaDst1, BYTE* uChromaDst2, BYTE* vChromaDst1,
+    BYTE* vChromaDst2, UINT32 width)
+{
+	UINT32 x;
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const UINT32 n = MIN(32, width - x);
+		const BYTE* argbEven = &srcEven[4 * x];
+		const BYTE* argbOdd = &srcOdd[4 * x];
+		const __m256i xe1 = avx2_load_BGRX(argbEven, n, 0);
+		const __m256i xe2 = avx2_load_BGRX(argbEven, n, 1);
+		const __m256i xe3 = avx2_load_BGRX(argbEven, n, 2);
+		const __m256i xe4 = avx2_load_BGRX(argbEven, n, 3);
+		const __m256i xo1 = avx2_load_BGRX(argbOdd, n, 0);
+		const __m256i xo2 = avx2_load_BGRX(argbOdd, n, 1);
+		const __m256i xo3 = avx2_load_BGRX(argbOdd, n, 2);
+		const __m256i xo4 = avx2_load_BGRX(argbOdd, n, 3);
+		__m256i uePairs, uoPairs, vePairs, voPairs, avg;
+		const __m256i ue = avx2_BGRX_Chroma(xe1, xe2, xe3, xe4, u_factors, &uePairs);
+		const __m256i uo = avx2_BGRX_Chroma(xo1, xo2, xo3, xo4, u_factors, &uoPairs);
+		const __m256i ve = avx2_BGRX_Chroma(xe1, xe2, xe3, xe4, v_factors, &vePairs);
+		const __m256i vo = avx2_BGRX_Chroma(xo1, xo2, xo3, xo4, v_factors, &voPairs);
+		/* store y [b1] */
+		avx2_store_bytes(&yLumaDstEven[x], avx2_BGRX_Y(xe1, xe2, xe3, xe4), n);
+
+		if (yLumaDstOdd)
+			avx2_store_bytes(&yLumaDstOdd[x], avx2_BGRX_Y(xo1, xo2, xo3, xo4), n);
+
+		avg = avx2_pack_UV(_mm256_srai_epi16(_mm256_add_epi16(uePairs, uoPairs), 2),
+		                   _mm256_srai_epi16(_mm256_add_epi16(vePairs, voPairs), 2));
+		avx2_RGBToAVC444YUVv2_SPLIT(ue, uo, _mm256_castsi256_si128(avg), yLumaDstOdd != NULL,
+		                            &uLumaDst[x / 2], &yEvenChromaDst1[x / 2],
+		                            &yOddChromaDst1[x / 2], &uChromaDst1[x / 4],
+		                            &vChromaDst1[x / 4], n);
+		avx2_RGBToAVC444YUVv2_SPLIT(ve, vo, _mm256_extracti128_si256(avg, 1),
+		                            yLumaDstOdd != NULL, &vLumaDst[x / 2], &yEvenChromaDst2[x / 2],
+		                            &yOddChromaDst2[x / 2], &uChromaDst2[x / 4],
+		                            &vChromaDst2[x / 4], n);
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                            BYTE* pDst1[3], const UINT32 dst1Step[3],
+                                            BYTE* pDst2[3], const UINT32 dst2Step[3],
+                                            const prim_size_t* roi)
+{
+	UINT32 y;
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 16)
+		return generic->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+		                                 roi);
+
+	for (y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = (pSrc + y * srcStep);
+		/* the odd values of a missing last line are not stored, do not read past the image */
+		const BYTE* srcOdd = !last ? (srcEven + srcStep) : srcEven;
+		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
+		BYTE* dstLumaYOdd = !last ? (dstLumaYEven + dst1Step[0]) : NULL;
+		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstOddChromaY1 = dstEvenChromaY1 + dst2Step[0];
+		BYTE* dstOddChromaY2 = dstEvenChromaY2 + dst2Step[0];
+		BYTE* dstChromaU1 = (pDst2[1] + (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(srcEven, srcOdd, dstLumaYEven, dstLumaYOdd, dstLumaU,
+		                                      dstLumaV, dstEvenChromaY1, dstEvenChromaY2,
+		                                      dstOddChromaY1, dstOddChromaY2, dstChromaU1,
+		                                      dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                       BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                       const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUVv2_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                  dst2Step, roi);
+
+		default:
+			return generic->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                 dst2Step, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 YUV420 combine -> YUV444 conversion                                 */
+/****************************************************************************/
+
+/* Store the 32 bytes of v at the odd (mask 0x80 on odd bytes) or even positions of dst */
+static INLINE void avx2_store_masked(BYTE* dst, __m256i v, __m256i mask)
+{
+	const __m256i old = _mm256_loadu_si256((const __m256i*)dst);
+	_mm256_storeu_si256((__m256i*)dst, _mm256_blendv_epi8(old, v, mask));
+}
+
+static pstatus_t avx2_LumaToYUV444(const BYTE* const pSrcRaw[3], const UINT32 srcStep[3],
+                                   BYTE* pDstRaw[3], const UINT32 dstStep[3],
+                                   const RECTANGLE_16* roi)
+{
+	UINT32 x, y, i;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
+
+	/* Y data is already here... */
+	/* B1 */
+	for (y = 0; y < nHeight; y++)
+	{
+		const BYTE* Ym = pSrc[0] + srcStep[0] * y;
+		BYTE* pY = pDst[0] + dstStep[0] * y;
+		memcpy(pY, Ym, nWidth);
+	}
+
+	/* The first half of U, V are already here part of this frame. */
+	/* B2 and B3 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		for (i = 1; i < 3; i++)
+		{
+			const BYTE* Um = pSrc[i] + srcStep[i] * y;
+			BYTE* pU = pDst[i] + dstStep[i] * (2 * y);
+			BYTE* pU1 = pU + dstStep[i];
+
+			for (x = 0; x + 32 <= halfWidth; x += 32)
+			{
+				const __m256i u = _mm256_loadu_si256((const __m256i*)&Um[x]);
+				const __m256i lo = _mm256_unpacklo_epi8(u, u);
+				const __m256i hi = _mm256_unpackhi_epi8(u, u);
+				const __m256i u1 = _mm256_permute2x128_si256(lo, hi, 0x20);
+				const __m256i u2 = _mm256_permute2x128_si256(lo, hi, 0x31);
+				_mm256_storeu_si256((__m256i*)&pU[2 * x], u1);
+				_mm256_storeu_si256((__m256i*)&pU[2 * x + 32], u2);
+				_mm256_storeu_si256((__m256i*)&pU1[2 * x], u1);
+				_mm256_storeu_si256((__m256i*)&pU1[2 * x + 32], u2);
+			}
+
+			for (; x < halfWidth; x++)
+			{
+				pU[2 * x] = Um[x];
+				pU[2 * x + 1] = Um[x];
+				pU1[2 * x] = Um[x];
+				pU1[2 * x + 1] = Um[x];
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* pSrcDst[2x] = CLIP(4 * pSrcDst[2x] - pSrcDst[2x + 1] - pSrc2[2x] - pSrc2[2x + 1])
+ * for 16 values of x, ssse3_filter with twice the width */
+static INLINE void avx2_filter(BYTE* pSrcDst, const BYTE* pSrc2)
+{
+	const __m256i even = _mm256_setr_epi8(0, 0x80, 2, 0x80, 4, 0x80, 6, 0x80, 8, 0x80, 10, 0x80,
+	                                      12, 0x80, 14, 0x80, 0, 0x80, 2, 0x80, 4, 0x80, 6, 0x80,
+	                                      8, 0x80, 10, 0x80, 12, 0x80, 14, 0x80);
+	const __m256i odd = _mm256_setr_epi8(1, 0x80, 3, 0x80, 5, 0x80, 7, 0x80, 9, 0x80, 11, 0x80,
+	                                     13, 0x80, 15, 0x80, 1, 0x80, 3, 0x80, 5, 0x80, 7, 0x80,
+	                                     9, 0x80, 11, 0x80, 13, 0x80, 15, 0x80);
+	const __m256i interleave = _mm256_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14,
+	                                            7, 15, 0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13,
+	                                            6, 14, 7, 15);
+	const __m256i u = _mm256_loadu_si256((const __m256i*)pSrcDst);
+	const __m256i u1 = _mm256_loadu_si256((const __m256i*)pSrc2);
+	const __m256i uEven4 = _mm256_slli_epi16(_mm256_shuffle_epi8(u, even), 2);
+	const __m256i uOdd = _mm256_shuffle_epi8(u, odd);
+	const __m256i u1Even = _mm256_shuffle_epi8(u1, even);
+	const __m256i u1Odd = _mm256_shuffle_epi8(u1, odd);
+	const __m256i tmp = _mm256_add_epi16(_mm256_add_epi16(uOdd, u1Even), u1Odd);
+	const __m256i result = _mm256_sub_epi16(uEven4, tmp);
+	const __m256i packed = _mm256_packus_epi16(result, uOdd);
+	_mm256_storeu_si256((__m256i*)pSrcDst, _mm256_shuffle_epi8(packed, interleave));
+}
+
+static pstatus_t avx2_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], const RECTANGLE_16* roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	UINT32 x, y;
+
+	/* Filter */
+	for (y = roi->top; y < halfHeight + roi->top; y++)
+	{
+		const UINT32 val2y = y * 2;
+		const UINT32 val2y1 = val2y + 1;
+		BYTE* pU1 = pDst[1] + dstStep[1] * val2y1;
+		BYTE* pV1 = pDst[2] + dstStep[2] * val2y1;
+		BYTE* pU = pDst[1] + dstStep[1] * val2y;
+		BYTE* pV = pDst[2] + dstStep[2] * val2y;
+
+		if (val2y1 > nHeight)
+			continue;
+
+		for (x = roi->left; (x + 16 <= halfWidth + roi->left) && (2 * x + 31 <= nWidth); x += 16)
+		{
+			avx2_filter(&pU[2 * x], &pU1[2 * x]);
+			avx2_filter(&pV[2 * x], &pV1[2 * x]);
+		}
+
+		for (; x < halfWidth + roi->left; x++)
+		{
+			const UINT32 val2x = (x * 2);
+			const UINT32 val2x1 = val2x + 1;
+			const INT32 up = pU[val2x] * 4;
+			const INT32 vp = pV[val2x] * 4;
+			INT32 u2020;
+			INT32 v2020;
+
+			if (val2x1 > nWidth)
+				continue;
+
+			u2020 = up - pU[val2x1] - pU1[val2x] - pU1[val2x1];
+			v2020 = vp - pV[val2x1] - pV1[val2x] - pV1[val2x1];
+			pU[val2x] = CLIP(u2020);
+			pV[val2x] = CLIP(v2020);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT32 srcStep[3],
+                                       BYTE* pDstRaw[3], const UINT32 dstStep[3],
+                                       const RECTANGLE_16* roi)
+{
+	const UINT32 mod = 16;
+	UINT32 uY = 0;
+	UINT32 vY = 0;
+	UINT32 x, y, i;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth) / 2;
+	const UINT32 halfHeight = (nHeight) / 2;
+	/* The auxilary frame is aligned to multiples of 16x16.
+	 * We need the padded height for B4 and B5 conversion. */
+	const UINT32 padHeigth = nHeight + 16 - nHeight % 16;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i oddMask = _mm256_set1_epi16((INT16)0x8000);
+
+	/* The second half of U and V is a bit more tricky... */
+	/* B4 and B5 */
+	for (y = 0; y < padHeigth; y++)
+	{
+		const BYTE* Ya = pSrc[0] + srcStep[0] * y;
+		BYTE* pX;
+
+		if ((y) % mod < (mod + 1) / 2)
+		{
+			const UINT32 pos = (2 * uY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[1] + dstStep[1] * pos;
+		}
+		else
+		{
+			const UINT32 pos = (2 * vY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[2] + dstStep[2] * pos;
+		}
+
+		memcpy(pX, Ya, nWidth);
+	}
+
+	/* B6 and B7 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		for (i = 1; i < 3; i++)
+		{
+			const BYTE* Ua = pSrc[i] + srcStep[i] * y;
+			BYTE* pU = pDst[i] + dstStep[i] * (2 * y);
+
+			for (x = 0; x + 32 <= halfWidth; x += 32)
+			{
+				const __m256i u = _mm256_loadu_si256((const __m256i*)&Ua[x]);
+				const __m256i lo = _mm256_unpacklo_epi8(zero, u);
+				const __m256i hi = _mm256_unpackhi_epi8(zero, u);
+				avx2_store_masked(&pU[2 * x], _mm256_permute2x128_si256(lo, hi, 0x20), oddMask);
+				avx2_store_masked(&pU[2 * x + 32], _mm256_permute2x128_si256(lo, hi, 0x31),
+				                  oddMask);
+			}
+
+			for (; x < halfWidth; x++)
+				pU[2 * x + 1] = Ua[x];
+		}
+	}
+
+	/* Filter */
+	return avx2_ChromaFilter(pDst, dstStep, roi);
+}
+
+static pstatus_t avx2_ChromaV2ToYUV444(const BYTE* const pSrc[3], const UINT32 srcStep[3],
+                                       UINT32 nTotalWidth, UINT32 nTotalHeight, BYTE* pDst[3],
+                                       const UINT32 dstStep[3], const RECTANGLE_16* roi)
+{
+	UINT32 x, y;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 quaterWidth = (nWidth + 3) / 4;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i oddMask = _mm256_set1_epi16((INT16)0x8000);
+	const __m256i evenMask = _mm256_set1_epi16(0x0080);
+	WINPR_UNUSED(nTotalHeight);
+
+	/* B4 and B5: odd UV values for width/2, height */
+	for (y = 0; y < nHeight; y++)
+	{
+		const UINT32 yTop = y + roi->top;
+		const BYTE* pYaU = pSrc[0] + srcStep[0] * yTop + roi->left / 2;
+		const BYTE* pYaV = pYaU + nTotalWidth / 2;
+		BYTE* pU = pDst[1] + dstStep[1] * yTop + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * yTop + roi->left;
+
+		/* the masked stores touch (but keep) the last byte of a block, stay within nWidth */
+		for (x = 0; x + 32 <= nWidth / 2; x += 32)
+		{
+			const __m256i u = _mm256_loadu_si256((const __m256i*)&pYaU[x]);
+			const __m256i v = _mm256_loadu_si256((const __m256i*)&pYaV[x]);
+			const __m256i ulo = _mm256_unpacklo_epi8(zero, u);
+			const __m256i uhi = _mm256_unpackhi_epi8(zero, u);
+			const __m256i vlo = _mm256_unpacklo_epi8(zero, v);
+			const __m256i vhi = _mm256_unpackhi_epi8(zero, v);
+			avx2_store_masked(&pU[2 * x], _mm256_permute2x128_si256(ulo, uhi, 0x20), oddMask);
+			avx2_store_masked(&pU[2 * x + 32], _mm256_permute2x128_si256(ulo, uhi, 0x31), oddMask);
+			avx2_store_masked(&pV[2 * x], _mm256_permute2x128_si256(vlo, vhi, 0x20), oddMask);
+			avx2_store_masked(&pV[2 * x + 32], _mm256_permute2x128_si256(vlo, vhi, 0x31), oddMask);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			const UINT32 odd = 2 * x + 1;
+			pU[odd] = pYaU[x];
+			pV[odd] = pYaV[x];
+		}
+	}
+
+	/* B6 - B9 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		const BYTE* pUaU = pSrc[1] + srcStep[1] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pUaV = pUaU + nTotalWidth / 4;
+		const BYTE* pVaU = pSrc[2] + srcStep[2] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pVaV = pVaU + nTotalWidth / 4;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y + 1 + roi->top) + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y + 1 + roi->top) + roi->left;
+
+		for (x = 0; x + 32 <= nWidth / 4; x += 32)
+		{
+			const __m256i uU = _mm256_loadu_si256((const __m256i*)&pUaU[x]);
+			const __m256i uV = _mm256_loadu_si256((const __m256i*)&pVaU[x]);
+			const __m256i vU = _mm256_loadu_si256((const __m256i*)&pUaV[x]);
+			const __m256i vV = _mm256_loadu_si256((const __m256i*)&pVaV[x]);
+			const __m256i uLow = _mm256_unpacklo_epi8(uU, uV);
+			const __m256i uHigh = _mm256_unpackhi_epi8(uU, uV);
+			const __m256i vLow = _mm256_unpacklo_epi8(vU, vV);
+			const __m256i vHigh = _mm256_unpackhi_epi8(vU, vV);
+			/* spread each pair to 4x and 4x + 2 */
+			const __m256i u1 = _mm256_unpacklo_epi8(uLow, zero);  /* x 0 - 3, 16 - 19 */
+			const __m256i u2 = _mm256_unpackhi_epi8(uLow, zero);  /* x 4 - 7, 20 - 23 */
+			const __m256i u3 = _mm256_unpacklo_epi8(uHigh, zero); /* x 8 - 11, 24 - 27 */
+			const __m256i u4 = _mm256_unpackhi_epi8(uHigh, zero); /* x 12 - 15, 28 - 31 */
+			const __m256i v1 = _mm256_unpacklo_epi8(vLow, zero);
+			const __m256i v2 = _mm256_unpackhi_epi8(vLow, zero);
+			const __m256i v3 = _mm256_unpacklo_epi8(vHigh, zero);
+			const __m256i v4 = _mm256_unpackhi_epi8(vHigh, zero);
+			avx2_store_masked(&pU[4 * x + 0], _mm256_permute2x128_si256(u1, u2, 0x20), evenMask);
+			avx2_store_masked(&pU[4 * x + 32], _mm256_permute2x128_si256(u3, u4, 0x20), evenMask);
+			avx2_store_masked(&pU[4 * x + 64], _mm256_permute2x128_si256(u1, u2, 0x31), evenMask);
+			avx2_store_masked(&pU[4 * x + 96], _mm256_permute2x128_si256(u3, u4, 0x31), evenMask);
+			avx2_store_masked(&pV[4 * x + 0], _mm256_permute2x128_si256(v1, v2, 0x20), evenMask);
+			avx2_store_masked(&pV[4 * x + 32], _mm256_permute2x128_si256(v3, v4, 0x20), evenMask);
+			avx2_store_masked(&pV[4 * x + 64], _mm256_permute2x128_si256(v1, v2, 0x31), evenMask);
+			avx2_store_masked(&pV[4 * x + 96], _mm256_permute2x128_si256(v3, v4, 0x31), evenMask);
+		}
+
+		for (; x < quaterWidth; x++)
+		{
+			pU[4 * x + 0] = pUaU[x];
+			pV[4 * x + 0] = pUaV[x];
+			pU[4 * x + 2] = pVaU[x];
+			pV[4 * x + 2] = pVaV[x];
+		}
+	}
+
+	return avx2_ChromaFilter(pDst, dstStep, roi);
+}
+
+static pstatus_t avx2_YUV420CombineToYUV444(avc444_frame_type type, const BYTE* const pSrc[3],
+                                            const UINT32 srcStep[3], UINT32 nWidth, UINT32 nHeight,
+                                            BYTE* pDst[3], const UINT32 dstStep[3],
+                                            const RECTANGLE_16* roi)
+{
+	if (!pSrc || !pSrc[0] || !pSrc[1] || !pSrc[2])
+		return -1;
+
+	if (!pDst || !pDst[0] || !pDst[1] || !pDst[2])
+		return -1;
+
+	if (!roi)
+		return -1;
+
+	switch (type)
+	{
+		case AVC444_LUMA:
+			return avx2_LumaToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv1:
+			return avx2_ChromaV1ToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv2:
+			return avx2_ChromaV2ToYUV444(pSrc, srcStep, nWidth, nHeight, pDst, dstStep, roi);
+
+		default:
+			return -1;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_YUV_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+	prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+	prims->RGBToAVC444YUVv2 = avx2_RGBToAVC444YUVv2;
+	prims->YUV420ToRGB_8u_P3AC4R = avx2_YUV420ToRGB;
+	prims->YUV444ToRGB_8u_P3AC4R = avx2_YUV444ToRGB_8u_P3AC4R;
+	prims->YUV420CombineToYUV444 = avx2_YUV420CombineToYUV444;
+}
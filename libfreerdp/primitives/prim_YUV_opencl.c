@@ -1,6 +1,6 @@
 /**
  * FreeRDP: A Remote Desktop Protocol Implementation
- * Optimized YUV/RGB conversion operations using openCL
+ * Optimized YUV/RGB conversion and RemoteFX tile decoding using openCL
  *
  * Copyright 2019 David Fort <contact@hardening-consulting.com>
  * Copyright 2019 Rangee Gmbh
@@ -367,6 +367,152 @@ static pstatus_t opencl_YUV444ToRGB_8u_P3AC4R(const BYTE* const pSrc[3], const U
 	return opencl_YUVToRGB(kernel_name, pSrc, srcStep, pDst, dstStep, roi);
 }
 
+static pstatus_t opencl_RFXDecodeTiles_16s8u(const INT16* pSrc, const UINT32* quantVals,
+                                             UINT32 numTiles, BYTE* const pDst[],
+                                             const UINT32 dstStep[], UINT32 DstFormat)
+{
+	cl_int ret;
+	UINT32 i;
+	pstatus_t status = -1;
+	const char* kernel_name;
+	cl_kernel decodeKernel = NULL;
+	cl_kernel colorKernel = NULL;
+	cl_mem coefficientsObj = NULL;
+	cl_mem quantsObj = NULL;
+	cl_mem destObj = NULL;
+	size_t decodeIndexes[1];
+	size_t decodeGroup[1];
+	size_t colorIndexes[2];
+	const size_t tileSize = 64 * 64 * 4;
+	primitives_opencl_context* cl = primitives_get_opencl_context();
+
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			kernel_name = "rfx_tiles_to_bgra";
+			break;
+		case PIXEL_FORMAT_XRGB32:
+		case PIXEL_FORMAT_ARGB32:
+			kernel_name = "rfx_tiles_to_argb";
+			break;
+		default:
+			/* the caller decodes the batch on the CPU */
+			return -1;
+	}
+
+	if (numTiles == 0)
+		return PRIMITIVES_SUCCESS;
+
+	decodeKernel = clCreateKernel(cl->program, "rfx_decode_component", &ret);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "openCL: unable to create kernel rfx_decode_component");
+		goto fail;
+	}
+
+	colorKernel = clCreateKernel(cl->program, kernel_name, &ret);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "openCL: unable to create kernel %s", kernel_name);
+		goto fail;
+	}
+
+	/* all tiles of the batch go up in one transfer and are decoded by one dispatch */
+	coefficientsObj =
+	    clCreateBuffer(cl->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+	                   sizeof(INT16) * 3 * 4096 * numTiles, (void*)pSrc, &ret);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to create coefficients obj");
+		goto fail;
+	}
+
+	quantsObj = clCreateBuffer(cl->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+	                           sizeof(UINT32) * 3 * 10 * numTiles, (void*)quantVals, &ret);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to create quants obj");
+		goto fail;
+	}
+
+	destObj = clCreateBuffer(cl->context, CL_MEM_WRITE_ONLY, tileSize * numTiles, NULL, &ret);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to create dest obj");
+		goto fail;
+	}
+
+	if ((clSetKernelArg(decodeKernel, 0, sizeof(cl_mem), &coefficientsObj) != CL_SUCCESS) ||
+	    (clSetKernelArg(decodeKernel, 1, sizeof(cl_mem), &quantsObj) != CL_SUCCESS) ||
+	    (clSetKernelArg(colorKernel, 0, sizeof(cl_mem), &coefficientsObj) != CL_SUCCESS) ||
+	    (clSetKernelArg(colorKernel, 1, sizeof(cl_mem), &destObj) != CL_SUCCESS))
+	{
+		WLog_ERR(TAG, "unable to set kernel args");
+		goto fail;
+	}
+
+	/* one work group of 64 items per tile component */
+	decodeIndexes[0] = 64ull * 3 * numTiles;
+	decodeGroup[0] = 64;
+	ret = clEnqueueNDRangeKernel(cl->commandQueue, decodeKernel, 1, NULL, decodeIndexes,
+	                             decodeGroup, 0, NULL, NULL);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to enqueue call kernel rfx_decode_component");
+		goto fail;
+	}
+
+	/* the queue is in order, the conversion sees the decoded coefficients */
+	colorIndexes[0] = 64;
+	colorIndexes[1] = 64ull * numTiles;
+	ret = clEnqueueNDRangeKernel(cl->commandQueue, colorKernel, 2, NULL, colorIndexes, NULL, 0,
+	                             NULL, NULL);
+	if (ret != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to enqueue call kernel %s", kernel_name);
+		goto fail;
+	}
+
+	/* Transfer the tiles to their destinations */
+	for (i = 0; i < numTiles; i++)
+	{
+		const size_t bufferOrigin[3] = { 0, 64ull * i, 0 };
+		const size_t hostOrigin[3] = { 0, 0, 0 };
+		const size_t region[3] = { 64 * 4, 64, 1 };
+
+		ret = clEnqueueReadBufferRect(cl->commandQueue, destObj, CL_FALSE, bufferOrigin,
+		                              hostOrigin, region, 64 * 4, 0, dstStep[i], 0, pDst[i], 0,
+		                              NULL, NULL);
+		if (ret != CL_SUCCESS)
+		{
+			WLog_ERR(TAG, "unable to read back tile %" PRIu32, i);
+			clFinish(cl->commandQueue);
+			goto fail;
+		}
+	}
+
+	if (clFinish(cl->commandQueue) != CL_SUCCESS)
+	{
+		WLog_ERR(TAG, "unable to finish the tile transfers");
+		goto fail;
+	}
+
+	status = PRIMITIVES_SUCCESS;
+fail:
+	if (destObj)
+		clReleaseMemObject(destObj);
+	if (quantsObj)
+		clReleaseMemObject(quantsObj);
+	if (coefficientsObj)
+		clReleaseMemObject(coefficientsObj);
+	if (colorKernel)
+		clReleaseKernel(colorKernel);
+	if (decodeKernel)
+		clReleaseKernel(decodeKernel);
+	return status;
+}
+
 BOOL primitives_init_opencl(primitives_t* prims)
 {
 	primitives_t* p = primitives_get_by_type(PRIMITIVES_ONLY_CPU);
@@ -379,6 +525,7 @@ BOOL primitives_init_opencl(primitives_t* prims)
 
 	prims->YUV420ToRGB_8u_P3AC4R = opencl_YUV420ToRGB_8u_P3AC4R;
 	prims->YUV444ToRGB_8u_P3AC4R = opencl_YUV444ToRGB_8u_P3AC4R;
+	prims->RFXDecodeTiles_16s8u = opencl_RFXDecodeTiles_16s8u;
 	prims->flags |= PRIM_FLAGS_HAVE_EXTGPU;
 	prims->uninit = primitives_uninit_opencl;
 	return TRUE;
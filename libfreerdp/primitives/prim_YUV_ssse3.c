@@ -1010,10 +1010,12 @@ static pstatus_t ssse3_RGBToAVC444YUVv2_BGRX(const BYTE* pSrc, UINT32 srcFormat,
 
 	for (y = 0; y < roi->height; y += 2)
 	{
+		const BOOL last = (y >= (roi->height - 1));
 		const BYTE* srcEven = (pSrc + y * srcStep);
-		const BYTE* srcOdd = (srcEven + srcStep);
+		/* the odd values of a missing last line are not stored, do not read past the image */
+		const BYTE* srcOdd = !last ? (srcEven + srcStep) : srcEven;
 		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
-		BYTE* dstLumaYOdd = (y < roi->height - 1) ? (dstLumaYEven + dst1Step[0]) : NULL;
+		BYTE* dstLumaYOdd = !last ? (dstLumaYEven + dst1Step[0]) : NULL;
 		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
 		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
 		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
@@ -1184,8 +1186,11 @@ static pstatus_t ssse3_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], cons
 
 		for (x = roi->left; x < halfWidth + roi->left - halfPad; x += 16)
 		{
+			/* ssse3_filter handles 8 values of x, filter both halves */
 			ssse3_filter(&pU[2 * x], &pU1[2 * x]);
+			ssse3_filter(&pU[2 * x + 16], &pU1[2 * x + 16]);
 			ssse3_filter(&pV[2 * x], &pV1[2 * x]);
+			ssse3_filter(&pV[2 * x + 16], &pV1[2 * x + 16]);
 		}
 
 		for (; x < halfWidth + roi->left; x++)
@@ -1236,8 +1241,9 @@ static pstatus_t ssse3_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT
 		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
 		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
 	const __m128i zero = _mm_setzero_si128();
+	/* B6 and B7 go to the odd positions 2x + 1 */
 	const __m128i mask =
-	    _mm_set_epi8(0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80);
+	    _mm_set_epi8(0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0);
 
 	/* The second half of U and V is a bit more tricky... */
 	/* B4 and B5 */
@@ -1281,15 +1287,15 @@ static pstatus_t ssse3_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT
 		{
 			{
 				const __m128i u = _mm_loadu_si128((const __m128i*)&Ua[x]);
-				const __m128i u2 = _mm_unpackhi_epi8(u, zero);
-				const __m128i u1 = _mm_unpacklo_epi8(u, zero);
+				const __m128i u2 = _mm_unpackhi_epi8(zero, u);
+				const __m128i u1 = _mm_unpacklo_epi8(zero, u);
 				_mm_maskmoveu_si128(u1, mask, (char*)&pU[2 * x]);
 				_mm_maskmoveu_si128(u2, mask, (char*)&pU[2 * x + 16]);
 			}
 			{
 				const __m128i u = _mm_loadu_si128((const __m128i*)&Va[x]);
-				const __m128i u2 = _mm_unpackhi_epi8(u, zero);
-				const __m128i u1 = _mm_unpacklo_epi8(u, zero);
+				const __m128i u2 = _mm_unpackhi_epi8(zero, u);
+				const __m128i u1 = _mm_unpacklo_epi8(zero, u);
 				_mm_maskmoveu_si128(u1, mask, (char*)&pV[2 * x]);
 				_mm_maskmoveu_si128(u2, mask, (char*)&pV[2 * x + 16]);
 			}
@@ -1463,4 +1469,7 @@ void primitives_init_YUV_opt(primitives_t* prims)
 		prims->YUV444ToRGB_8u_P3AC4R = ssse3_YUV444ToRGB_8u_P3AC4R;
 		prims->YUV420CombineToYUV444 = ssse3_YUV420CombineToYUV444;
 	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_YUV_avx2(prims);
 }
@@ -89,8 +89,58 @@ static pstatus_t general_alphaComp_argb(const BYTE* pSrc1, UINT32 src1Step, cons
 	return PRIMITIVES_SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+/* (a * b) / 255, rounded to nearest */
+static INLINE UINT32 mul_div255(UINT32 a, UINT32 b)
+{
+	const UINT32 t = a * b + 0x80;
+	return ((t >> 8) + t) >> 8;
+}
+
+/* The first operand has premultiplied alpha, as cursor images do:
+ *   newval = val1 + (1-alpha1)*val2
+ * for all four channels, saturated. */
+static pstatus_t general_alphaCompPremultiplied_argb(const BYTE* pSrc1, UINT32 src1Step,
+                                                     const BYTE* pSrc2, UINT32 src2Step,
+                                                     BYTE* pDst, UINT32 dstStep, UINT32 width,
+                                                     UINT32 height)
+{
+	UINT32 y;
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT32* sptr1 = (const UINT32*)(pSrc1 + y * src1Step);
+		const UINT32* sptr2 = (const UINT32*)(pSrc2 + y * src2Step);
+		UINT32* dptr = (UINT32*)(pDst + y * dstStep);
+		UINT32 x;
+
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 src1 = *sptr1++;
+			const UINT32 src2 = *sptr2++;
+			const UINT32 alpha = 0xFF - ALPHA(src1);
+
+			if (alpha == 0)
+				*dptr++ = src1;
+			else if (src1 == 0)
+				*dptr++ = src2;
+			else
+			{
+				const UINT32 a = MIN(ALPHA(src1) + mul_div255(ALPHA(src2), alpha), 0xFF);
+				const UINT32 r = MIN(RED(src1) + mul_div255(RED(src2), alpha), 0xFF);
+				const UINT32 g = MIN(GRN(src1) + mul_div255(GRN(src2), alpha), 0xFF);
+				const UINT32 b = MIN(BLU(src1) + mul_div255(BLU(src2), alpha), 0xFF);
+				*dptr++ = (a << 24) | (r << 16) | (g << 8) | b;
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 /* ------------------------------------------------------------------------- */
 void primitives_init_alphaComp(primitives_t* prims)
 {
 	prims->alphaComp_argb = general_alphaComp_argb;
+	prims->alphaCompPremultiplied_argb = general_alphaCompPremultiplied_argb;
 }
@@ -0,0 +1,141 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized alpha blending routines.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+#if !defined(WITH_IPP) || defined(ALL_PRIMITIVES_VERSIONS)
+/* (src1 - src2) * (alpha + 1) / 256 + src2 of 4 pixels in 16 bit lanes, like the SSE2 code */
+static INLINE __m256i avx2_alpha_blend(__m256i src1, __m256i src2)
+{
+	const __m256i diff = _mm256_subs_epi16(src1, src2);
+	__m256i alpha = _mm256_shufflelo_epi16(src1, 0xff);
+	alpha = _mm256_shufflehi_epi16(alpha, 0xff);
+	alpha = _mm256_adds_epi16(alpha, _mm256_set1_epi16(1));
+	alpha = _mm256_srai_epi16(_mm256_mullo_epi16(alpha, diff), 8);
+	return _mm256_and_si256(_mm256_adds_epi16(alpha, src2), _mm256_set1_epi16(0x00FF));
+}
+
+static pstatus_t avx2_alphaComp_argb(const BYTE* pSrc1, UINT32 src1Step, const BYTE* pSrc2,
+                                     UINT32 src2Step, BYTE* pDst, UINT32 dstStep, UINT32 width,
+                                     UINT32 height)
+{
+	UINT32 y;
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* sptr1 = pSrc1 + y * src1Step;
+		const BYTE* sptr2 = pSrc2 + y * src2Step;
+		BYTE* dptr = pDst + y * dstStep;
+		UINT32 x = 0;
+
+		/* 8 pixels per round */
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m256i s1 = _mm256_loadu_si256((const __m256i*)&sptr1[x * 4]);
+			const __m256i s2 = _mm256_loadu_si256((const __m256i*)&sptr2[x * 4]);
+			const __m256i lo =
+			    avx2_alpha_blend(_mm256_unpacklo_epi8(s1, zero), _mm256_unpacklo_epi8(s2, zero));
+			const __m256i hi =
+			    avx2_alpha_blend(_mm256_unpackhi_epi8(s1, zero), _mm256_unpackhi_epi8(s2, zero));
+			_mm256_storeu_si256((__m256i*)&dptr[x * 4], _mm256_packus_epi16(lo, hi));
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status =
+			    generic->alphaComp_argb(&sptr1[x * 4], src1Step, &sptr2[x * 4], src2Step,
+			                            &dptr[x * 4], dstStep, width - x, 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* !defined(WITH_IPP) || defined(ALL_PRIMITIVES_VERSIONS) */
+
+/* ------------------------------------------------------------------------- */
+/* (val * (255 - alpha)) / 255 of 4 pixels in 16 bit lanes, rounded to nearest */
+static INLINE __m256i avx2_mul_inv_alpha(__m256i val, __m256i alpha)
+{
+	const __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), alpha);
+	const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(val, inv), _mm256_set1_epi16(0x80));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static pstatus_t avx2_alphaCompPremultiplied_argb(const BYTE* pSrc1, UINT32 src1Step,
+                                                  const BYTE* pSrc2, UINT32 src2Step, BYTE* pDst,
+                                                  UINT32 dstStep, UINT32 width, UINT32 height)
+{
+	UINT32 y;
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* sptr1 = pSrc1 + y * src1Step;
+		const BYTE* sptr2 = pSrc2 + y * src2Step;
+		BYTE* dptr = pDst + y * dstStep;
+		UINT32 x = 0;
+
+		/* 8 pixels per round */
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m256i s1 = _mm256_loadu_si256((const __m256i*)&sptr1[x * 4]);
+			const __m256i s2 = _mm256_loadu_si256((const __m256i*)&sptr2[x * 4]);
+			/* the alpha of every pixel in all of its 16 bit channels */
+			const __m256i a32 = _mm256_srli_epi32(s1, 24);
+			const __m256i a16 = _mm256_or_si256(a32, _mm256_slli_epi32(a32, 16));
+			const __m256i lo = avx2_mul_inv_alpha(_mm256_unpacklo_epi8(s2, zero),
+			                                      _mm256_unpacklo_epi32(a16, a16));
+			const __m256i hi = avx2_mul_inv_alpha(_mm256_unpackhi_epi8(s2, zero),
+			                                      _mm256_unpackhi_epi32(a16, a16));
+			_mm256_storeu_si256((__m256i*)&dptr[x * 4],
+			                    _mm256_adds_epu8(s1, _mm256_packus_epi16(lo, hi)));
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status = generic->alphaCompPremultiplied_argb(
+			    &sptr1[x * 4], src1Step, &sptr2[x * 4], src2Step, &dptr[x * 4], dstStep,
+			    width - x, 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_alphaComp_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+#if !defined(WITH_IPP) || defined(ALL_PRIMITIVES_VERSIONS)
+	prims->alphaComp_argb = avx2_alphaComp_argb;
+#endif
+	prims->alphaCompPremultiplied_argb = avx2_alphaCompPremultiplied_argb;
+}
@@ -31,6 +31,10 @@
 #include <pmmintrin.h>
 #endif /* WITH_SSE2 */
 
+#ifdef WITH_NEON
+#include <arm_neon.h>
+#endif /* WITH_NEON */
+
 #ifdef WITH_IPP
 #include <ippi.h>
 #endif /* WITH_IPP */
@@ -202,8 +206,154 @@ static pstatus_t sse2_alphaComp_argb(const BYTE* pSrc1, UINT32 src1Step, const B
 	return PRIMITIVES_SUCCESS;
 }
 #endif /* !defined(WITH_IPP) || defined(ALL_PRIMITIVES_VERSIONS) */
+
+/* ------------------------------------------------------------------------- */
+/* (val * (255 - alpha)) / 255 of 2 pixels in 16 bit lanes, rounded to nearest */
+static INLINE __m128i sse2_mul_inv_alpha(__m128i val, __m128i alpha)
+{
+	const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+	const __m128i t = _mm_add_epi16(_mm_mullo_epi16(val, inv), _mm_set1_epi16(0x80));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static pstatus_t sse2_alphaCompPremultiplied_argb(const BYTE* pSrc1, UINT32 src1Step,
+                                                  const BYTE* pSrc2, UINT32 src2Step, BYTE* pDst,
+                                                  UINT32 dstStep, UINT32 width, UINT32 height)
+{
+	UINT32 y;
+	const __m128i zero = _mm_setzero_si128();
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* sptr1 = pSrc1 + y * src1Step;
+		const BYTE* sptr2 = pSrc2 + y * src2Step;
+		BYTE* dptr = pDst + y * dstStep;
+		UINT32 x = 0;
+
+		/* 4 pixels per round */
+		for (; x + 4 <= width; x += 4)
+		{
+			const __m128i s1 = _mm_loadu_si128((const __m128i*)&sptr1[x * 4]);
+			const __m128i s2 = _mm_loadu_si128((const __m128i*)&sptr2[x * 4]);
+			/* the alpha of every pixel in all of its 16 bit channels */
+			const __m128i a32 = _mm_srli_epi32(s1, 24);
+			const __m128i a16 = _mm_or_si128(a32, _mm_slli_epi32(a32, 16));
+			const __m128i lo =
+			    sse2_mul_inv_alpha(_mm_unpacklo_epi8(s2, zero), _mm_unpacklo_epi32(a16, a16));
+			const __m128i hi =
+			    sse2_mul_inv_alpha(_mm_unpackhi_epi8(s2, zero), _mm_unpackhi_epi32(a16, a16));
+			_mm_storeu_si128((__m128i*)&dptr[x * 4],
+			                 _mm_adds_epu8(s1, _mm_packus_epi16(lo, hi)));
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status = generic->alphaCompPremultiplied_argb(
+			    &sptr1[x * 4], src1Step, &sptr2[x * 4], src2Step, &dptr[x * 4], dstStep,
+			    width - x, 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif
 
+#ifdef WITH_NEON
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_alphaComp_argb(const BYTE* pSrc1, UINT32 src1Step, const BYTE* pSrc2,
+                                     UINT32 src2Step, BYTE* pDst, UINT32 dstStep, UINT32 width,
+                                     UINT32 height)
+{
+	UINT32 y;
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* sptr1 = pSrc1 + y * src1Step;
+		const BYTE* sptr2 = pSrc2 + y * src2Step;
+		BYTE* dptr = pDst + y * dstStep;
+		UINT32 x = 0;
+
+		/* 8 pixels per round, the same arithmetic as the SSE2 code */
+		for (; x + 8 <= width; x += 8)
+		{
+			const uint8x8x4_t s1 = vld4_u8(&sptr1[x * 4]);
+			const uint8x8x4_t s2 = vld4_u8(&sptr2[x * 4]);
+			const int16x8_t alpha = vreinterpretq_s16_u16(vaddw_u8(vdupq_n_u16(1), s1.val[3]));
+			uint8x8x4_t d;
+			size_t c;
+
+			for (c = 0; c < 4; c++)
+			{
+				const int16x8_t diff = vreinterpretq_s16_u16(vsubl_u8(s1.val[c], s2.val[c]));
+				const int16x8_t val =
+				    vaddq_s16(vshrq_n_s16(vmulq_s16(diff, alpha), 8),
+				              vreinterpretq_s16_u16(vmovl_u8(s2.val[c])));
+				d.val[c] = vmovn_u16(vreinterpretq_u16_s16(val));
+			}
+
+			vst4_u8(&dptr[x * 4], d);
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status =
+			    generic->alphaComp_argb(&sptr1[x * 4], src1Step, &sptr2[x * 4], src2Step,
+			                            &dptr[x * 4], dstStep, width - x, 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t neon_alphaCompPremultiplied_argb(const BYTE* pSrc1, UINT32 src1Step,
+                                                  const BYTE* pSrc2, UINT32 src2Step, BYTE* pDst,
+                                                  UINT32 dstStep, UINT32 width, UINT32 height)
+{
+	UINT32 y;
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* sptr1 = pSrc1 + y * src1Step;
+		const BYTE* sptr2 = pSrc2 + y * src2Step;
+		BYTE* dptr = pDst + y * dstStep;
+		UINT32 x = 0;
+
+		for (; x + 8 <= width; x += 8)
+		{
+			const uint8x8x4_t s1 = vld4_u8(&sptr1[x * 4]);
+			const uint8x8x4_t s2 = vld4_u8(&sptr2[x * 4]);
+			const uint8x8_t alpha = vmvn_u8(s1.val[3]);
+			uint8x8x4_t d;
+			size_t c;
+
+			for (c = 0; c < 4; c++)
+			{
+				/* (t + ((t + 128) >> 8) + 128) >> 8 is t / 255 rounded */
+				const uint16x8_t t = vmull_u8(s2.val[c], alpha);
+				d.val[c] = vqadd_u8(s1.val[c], vraddhn_u16(t, vrshrq_n_u16(t, 8)));
+			}
+
+			vst4_u8(&dptr[x * 4], d);
+		}
+
+		if (x < width)
+		{
+			const pstatus_t status = generic->alphaCompPremultiplied_argb(
+			    &sptr1[x * 4], src1Step, &sptr2[x * 4], src2Step, &dptr[x * 4], dstStep,
+			    width - x, 1);
+			if (status != PRIMITIVES_SUCCESS)
+				return status;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_NEON */
+
 #ifdef WITH_IPP
 /* ------------------------------------------------------------------------- */
 static pstatus_t ipp_alphaComp_argb(const BYTE* pSrc1, INT32 src1Step, const BYTE* pSrc2,
@@ -232,5 +382,27 @@ void primitives_init_alphaComp_opt(primitives_t* prims)
 		prims->alphaComp_argb = sse2_alphaComp_argb;
 	}
 
+#endif
+#if defined(WITH_SSE2)
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE) &&
+	    IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->alphaCompPremultiplied_argb = sse2_alphaCompPremultiplied_argb;
+	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_alphaComp_avx2(prims);
+
+#elif defined(WITH_NEON)
+
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+#ifndef WITH_IPP
+		prims->alphaComp_argb = neon_alphaComp_argb;
+#endif
+		prims->alphaCompPremultiplied_argb = neon_alphaCompPremultiplied_argb;
+	}
+
 #endif
 }
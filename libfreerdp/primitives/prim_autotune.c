@@ -0,0 +1,718 @@
+/* prim_autotune.c
+ * Selects the fastest implementation for each primitive.
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <ctype.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/sysinfo.h>
+#include <winpr/crypto.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/build-config.h>
+#include <freerdp/primitives.h>
+#include <freerdp/log.h>
+
+#include "prim_internal.h"
+
+#define TAG FREERDP_TAG("primitives")
+
+/* The benchmark works on a 256x256 region, a typical damaged area, and on 64x64 RemoteFX
+ * tiles. The candidates take turns for a few short rounds, the best round of each counts. */
+#define TUNE_WIDTH 256
+#define TUNE_HEIGHT 256
+#define TUNE_TILE 64
+#define TUNE_ROUNDS 3
+#define TUNE_ROUND_TIME 8 /* ms */
+#define TUNE_MAX_CANDIDATES 8
+
+/* Bump when the benchmark changes, old cache files are ignored then */
+#define TUNE_CACHE_VERSION 1
+#define TUNE_CACHE_FILE "primitives.cache"
+
+typedef struct
+{
+	BYTE* rgb[3];
+	BYTE* yuv[3];
+	BYTE* main[3];
+	BYTE* aux[3];
+	INT16* tile[3];
+	INT16* tileDst[3];
+} primitives_tune_data;
+
+typedef BOOL (*primitives_tune_fn)(const primitives_t* prims, primitives_tune_data* data);
+typedef void (*primitives_fn)(void);
+
+typedef struct
+{
+	const char* name;
+	size_t offset;
+	primitives_tune_fn run;
+} primitives_tune_entry;
+
+static const prim_size_t tune_roi = { TUNE_WIDTH, TUNE_HEIGHT };
+static const prim_size_t tune_tile_roi = { TUNE_TILE, TUNE_TILE };
+static const UINT32 tune_steps420[3] = { TUNE_WIDTH, TUNE_WIDTH / 2, TUNE_WIDTH / 2 };
+static const UINT32 tune_steps444[3] = { TUNE_WIDTH, TUNE_WIDTH, TUNE_WIDTH };
+
+static BOOL tune_add_16s(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->add_16s(data->tile[0], data->tile[1], data->tileDst[0],
+	                      TUNE_TILE * TUNE_TILE) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_alphaComp_argb(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->alphaComp_argb(data->rgb[0], TUNE_WIDTH * 4, data->rgb[1], TUNE_WIDTH * 4,
+	                             data->rgb[2], TUNE_WIDTH * 4, TUNE_WIDTH,
+	                             TUNE_HEIGHT) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_alphaCompPremultiplied_argb(const primitives_t* prims,
+                                             primitives_tune_data* data)
+{
+	return prims->alphaCompPremultiplied_argb(data->rgb[0], TUNE_WIDTH * 4, data->rgb[1],
+	                                          TUNE_WIDTH * 4, data->rgb[2], TUNE_WIDTH * 4,
+	                                          TUNE_WIDTH, TUNE_HEIGHT) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_yCbCrToRGB_16s8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	const INT16* src[3] = { data->tile[0], data->tile[1], data->tile[2] };
+	return prims->yCbCrToRGB_16s8u_P3AC4R(src, TUNE_TILE * sizeof(INT16), data->rgb[2],
+	                                      TUNE_TILE * 4, PIXEL_FORMAT_BGRX32,
+	                                      &tune_tile_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_yCbCrToRGB_16s16s_P3P3(const primitives_t* prims, primitives_tune_data* data)
+{
+	const INT16* src[3] = { data->tile[0], data->tile[1], data->tile[2] };
+	return prims->yCbCrToRGB_16s16s_P3P3(src, TUNE_TILE * sizeof(INT16), data->tileDst,
+	                                     TUNE_TILE * sizeof(INT16),
+	                                     &tune_tile_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToYCbCr_16s16s_P3P3(const primitives_t* prims, primitives_tune_data* data)
+{
+	const INT16* src[3] = { data->tile[0], data->tile[1], data->tile[2] };
+	return prims->RGBToYCbCr_16s16s_P3P3(src, TUNE_TILE * sizeof(INT16), data->tileDst,
+	                                     TUNE_TILE * sizeof(INT16),
+	                                     &tune_tile_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToRGB_16s8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	const INT16* src[3] = { data->tile[0], data->tile[1], data->tile[2] };
+	return prims->RGBToRGB_16s8u_P3AC4R(src, TUNE_TILE * sizeof(INT16), data->rgb[2],
+	                                    TUNE_TILE * 4, PIXEL_FORMAT_BGRX32,
+	                                    &tune_tile_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_YCoCgToRGB_8u_AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->YCoCgToRGB_8u_AC4R(data->rgb[0], TUNE_WIDTH * 4, data->rgb[2],
+	                                 PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4, TUNE_WIDTH, TUNE_HEIGHT,
+	                                 1, FALSE) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGB565ToARGB_16u32u_C3C4(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->RGB565ToARGB_16u32u_C3C4((const UINT16*)data->rgb[0], TUNE_WIDTH * 2,
+	                                       (UINT32*)data->rgb[2], TUNE_WIDTH * 4, TUNE_WIDTH,
+	                                       TUNE_HEIGHT, PIXEL_FORMAT_BGRX32) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_YUV420ToRGB_8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	return prims->YUV420ToRGB_8u_P3AC4R(src, tune_steps420, data->rgb[2], TUNE_WIDTH * 4,
+	                                    PIXEL_FORMAT_BGRX32, &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_YUV444ToRGB_8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	return prims->YUV444ToRGB_8u_P3AC4R(src, tune_steps444, data->rgb[2], TUNE_WIDTH * 4,
+	                                    PIXEL_FORMAT_BGRX32, &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToYUV420_8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->RGBToYUV420_8u_P3AC4R(data->rgb[0], PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4,
+	                                    data->main, tune_steps420,
+	                                    &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToYUV444_8u_P3AC4R(const primitives_t* prims, primitives_tune_data* data)
+{
+	UINT32 steps[3] = { TUNE_WIDTH, TUNE_WIDTH, TUNE_WIDTH };
+	return prims->RGBToYUV444_8u_P3AC4R(data->rgb[0], PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4,
+	                                    data->main, steps, &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_YUV420CombineToYUV444(const primitives_t* prims, primitives_tune_data* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	const RECTANGLE_16 rect = { 0, 0, TUNE_WIDTH, TUNE_HEIGHT };
+
+	/* a AVC444 frame updates the luma and one of the chroma layouts */
+	if (prims->YUV420CombineToYUV444(AVC444_LUMA, src, tune_steps420, TUNE_WIDTH, TUNE_HEIGHT,
+	                                 data->main, tune_steps444, &rect) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	return prims->YUV420CombineToYUV444(AVC444_CHROMAv1, src, tune_steps420, TUNE_WIDTH,
+	                                    TUNE_HEIGHT, data->main, tune_steps444,
+	                                    &rect) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_YUV444SplitToYUV420(const primitives_t* prims, primitives_tune_data* data)
+{
+	const BYTE* src[3] = { data->yuv[0], data->yuv[1], data->yuv[2] };
+	return prims->YUV444SplitToYUV420(src, tune_steps444, data->main, tune_steps420, data->aux,
+	                                  tune_steps420, &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToAVC444YUV(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->RGBToAVC444YUV(data->rgb[0], PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4, data->main,
+	                             tune_steps420, data->aux, tune_steps420,
+	                             &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToAVC444YUVv2(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->RGBToAVC444YUVv2(data->rgb[0], PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4,
+	                               data->main, tune_steps420, data->aux, tune_steps420,
+	                               &tune_roi) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RGBToPlanar_8u_C4P4(const primitives_t* prims, primitives_tune_data* data)
+{
+	BYTE* planes[4] = { data->main[0], data->main[1], data->main[2], data->aux[0] };
+	return prims->RGBToPlanar_8u_C4P4(data->rgb[0], PIXEL_FORMAT_BGRX32, TUNE_WIDTH * 4,
+	                                  planes, TUNE_WIDTH, TUNE_HEIGHT) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_planarDeltaEncode_8u_P1(const primitives_t* prims, primitives_tune_data* data)
+{
+	return prims->planarDeltaEncode_8u_P1(data->yuv[0], data->main[0], TUNE_WIDTH,
+	                                      TUNE_HEIGHT) == PRIMITIVES_SUCCESS;
+}
+
+static BOOL tune_RFXDecodeTiles_16s8u(const primitives_t* prims, primitives_tune_data* data)
+{
+	static const UINT32 quants[30] = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9, 6, 6, 6, 6, 7,
+		                               7, 8, 8, 8, 9, 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+	BYTE* dst[1] = { data->rgb[2] };
+	const UINT32 dstStep[1] = { TUNE_WIDTH * 4 };
+	/* a tile batch takes 3 planes of coefficients, the main planes are large enough */
+	return prims->RFXDecodeTiles_16s8u((const INT16*)data->main[0], quants, 1, dst, dstStep,
+	                                   PIXEL_FORMAT_BGRX32) == PRIMITIVES_SUCCESS;
+}
+
+/* Every function of primitives_t, the ones without a benchmark keep the default table */
+#define TUNE_SLOT(slot)                                  \
+	{                                                    \
+		#slot, offsetof(primitives_t, slot), tune_##slot \
+	}
+#define FIXED_SLOT(slot)                          \
+	{                                             \
+		#slot, offsetof(primitives_t, slot), NULL \
+	}
+
+static const primitives_tune_entry tune_entries[] = {
+	FIXED_SLOT(copy),
+	FIXED_SLOT(copy_8u),
+	FIXED_SLOT(copy_8u_AC4r),
+	FIXED_SLOT(set_8u),
+	FIXED_SLOT(set_32s),
+	FIXED_SLOT(set_32u),
+	FIXED_SLOT(zero),
+	TUNE_SLOT(add_16s),
+	FIXED_SLOT(andC_32u),
+	FIXED_SLOT(orC_32u),
+	FIXED_SLOT(lShiftC_16s),
+	FIXED_SLOT(lShiftC_16u),
+	FIXED_SLOT(rShiftC_16s),
+	FIXED_SLOT(rShiftC_16u),
+	FIXED_SLOT(shiftC_16s),
+	FIXED_SLOT(shiftC_16u),
+	TUNE_SLOT(alphaComp_argb),
+	TUNE_SLOT(alphaCompPremultiplied_argb),
+	FIXED_SLOT(sign_16s),
+	TUNE_SLOT(yCbCrToRGB_16s8u_P3AC4R),
+	TUNE_SLOT(yCbCrToRGB_16s16s_P3P3),
+	TUNE_SLOT(RGBToYCbCr_16s16s_P3P3),
+	TUNE_SLOT(RGBToRGB_16s8u_P3AC4R),
+	TUNE_SLOT(YCoCgToRGB_8u_AC4R),
+	TUNE_SLOT(RGB565ToARGB_16u32u_C3C4),
+	TUNE_SLOT(YUV420ToRGB_8u_P3AC4R),
+	TUNE_SLOT(RGBToYUV420_8u_P3AC4R),
+	TUNE_SLOT(RGBToYUV444_8u_P3AC4R),
+	TUNE_SLOT(YUV420CombineToYUV444),
+	TUNE_SLOT(YUV444SplitToYUV420),
+	TUNE_SLOT(YUV444ToRGB_8u_P3AC4R),
+	TUNE_SLOT(RGBToAVC444YUV),
+	TUNE_SLOT(RGBToAVC444YUVv2),
+	TUNE_SLOT(RGBToPlanar_8u_C4P4),
+	TUNE_SLOT(planarDeltaEncode_8u_P1),
+	FIXED_SLOT(planarRleScan_8u),
+	TUNE_SLOT(RFXDecodeTiles_16s8u),
+	FIXED_SLOT(base64Encode),
+	FIXED_SLOT(base64Decode),
+};
+
+static primitives_fn tune_get(const primitives_t* prims, const primitives_tune_entry* entry)
+{
+	primitives_fn fn;
+	memcpy(&fn, (const BYTE*)prims + entry->offset, sizeof(fn));
+	return fn;
+}
+
+static void tune_set(primitives_t* prims, const primitives_tune_entry* entry, primitives_fn fn)
+{
+	memcpy((BYTE*)prims + entry->offset, &fn, sizeof(fn));
+}
+
+static void tune_data_free(primitives_tune_data* data)
+{
+	size_t x;
+
+	for (x = 0; x < 3; x++)
+	{
+		free(data->rgb[x]);
+		free(data->yuv[x]);
+		free(data->main[x]);
+		free(data->aux[x]);
+		free(data->tile[x]);
+		free(data->tileDst[x]);
+	}
+
+	memset(data, 0, sizeof(primitives_tune_data));
+}
+
+static BOOL tune_data_init(primitives_tune_data* data)
+{
+	size_t x;
+	/* CHROMAv1 reads up to 16 lines past the height, it works on the padded frame */
+	const size_t planeSize = (size_t)TUNE_WIDTH * (TUNE_HEIGHT + 16);
+	const size_t rgbSize = (size_t)TUNE_WIDTH * TUNE_HEIGHT * 4;
+	const size_t tileSize = (size_t)TUNE_TILE * TUNE_TILE * sizeof(INT16);
+
+	memset(data, 0, sizeof(primitives_tune_data));
+
+	for (x = 0; x < 3; x++)
+	{
+		size_t y;
+
+		data->rgb[x] = calloc(1, rgbSize);
+		data->yuv[x] = calloc(1, planeSize);
+		data->main[x] = calloc(1, planeSize);
+		data->aux[x] = calloc(1, planeSize);
+		data->tile[x] = calloc(1, tileSize);
+		data->tileDst[x] = calloc(1, tileSize);
+
+		if (!data->rgb[x] || !data->yuv[x] || !data->main[x] || !data->aux[x] ||
+		    !data->tile[x] || !data->tileDst[x])
+		{
+			tune_data_free(data);
+			return FALSE;
+		}
+
+		winpr_RAND(data->rgb[x], rgbSize);
+		winpr_RAND(data->yuv[x], planeSize);
+
+		/* RemoteFX coefficients are 11 bit fixed point values */
+		for (y = 0; y < TUNE_TILE * TUNE_TILE; y++)
+			data->tile[x][y] = (INT16)((data->yuv[x][y] - 128) << 4);
+	}
+
+	return TRUE;
+}
+
+static BOOL tune_run(const primitives_tune_entry* entry, const primitives_t* prims,
+                     primitives_tune_data* data, UINT32* computations)
+{
+	ULONGLONG dueDate;
+
+	*computations = 0;
+
+	/* do a first dry run to initialize cache and such */
+	if (!entry->run(prims, data))
+		return FALSE;
+
+	dueDate = GetTickCount64() + TUNE_ROUND_TIME;
+	while (GetTickCount64() < dueDate)
+	{
+		if (!entry->run(prims, data))
+			return FALSE;
+		*computations = *computations + 1;
+	}
+
+	return TRUE;
+}
+
+/* Returns the index of the fastest candidate for a primitive. Candidates sharing the
+ * implementation of an earlier one are not timed again. */
+static size_t tune_entry(const primitives_tune_entry* entry,
+                         const primitives_candidate* candidates, size_t count,
+                         primitives_tune_data* data, size_t fallback)
+{
+	size_t x, y, round;
+	size_t distinct = 0;
+	size_t best = count;
+	UINT32 counts[TUNE_MAX_CANDIDATES] = { 0 };
+	BOOL active[TUNE_MAX_CANDIDATES] = { 0 };
+
+	for (x = 0; x < count; x++)
+	{
+		const primitives_fn fn = tune_get(candidates[x].prims, entry);
+
+		active[x] = (fn != NULL);
+		for (y = 0; active[x] && (y < x); y++)
+		{
+			if (active[y] && (tune_get(candidates[y].prims, entry) == fn))
+				active[x] = FALSE;
+		}
+
+		if (active[x])
+		{
+			distinct++;
+			best = x;
+		}
+	}
+
+	if (distinct == 0)
+		return fallback;
+
+	if (distinct == 1)
+		return best;
+
+	for (round = 0; round < TUNE_ROUNDS; round++)
+	{
+		for (x = 0; x < count; x++)
+		{
+			UINT32 computations = 0;
+
+			if (!active[x])
+				continue;
+
+			if (!tune_run(entry, candidates[x].prims, data, &computations))
+			{
+				WLog_WARN(TAG, "error running %s %s bench", candidates[x].name, entry->name);
+				active[x] = FALSE;
+				continue;
+			}
+
+			if (computations > counts[x])
+				counts[x] = computations;
+		}
+	}
+
+	best = count;
+	for (x = 0; x < count; x++)
+	{
+		if (!active[x])
+			continue;
+
+		WLog_DBG(TAG, " * %s %s= %" PRIu32, entry->name, candidates[x].name, counts[x]);
+		if ((best == count) || (counts[best] < counts[x]))
+			best = x;
+	}
+
+	return (best < count) ? best : fallback;
+}
+
+static char* tune_cache_dir(void)
+{
+	size_t x;
+	char product[sizeof(FREERDP_PRODUCT_STRING)] = { 0 };
+
+	for (x = 0; x < sizeof(product) - 1; x++)
+		product[x] = (char)tolower(FREERDP_PRODUCT_STRING[x]);
+
+	return GetKnownSubPath(KNOWN_PATH_XDG_CACHE_HOME, product);
+}
+
+/* The selection is only valid for the same build, the same CPU features and the same set
+ * of candidates */
+static void tune_signature(char* signature, size_t size, const primitives_candidate* candidates,
+                           size_t count)
+{
+	const DWORD features[] = { PF_MMX_INSTRUCTIONS_AVAILABLE, PF_XMMI_INSTRUCTIONS_AVAILABLE,
+		                       PF_XMMI64_INSTRUCTIONS_AVAILABLE, PF_SSE3_INSTRUCTIONS_AVAILABLE,
+		                       PF_ARM_NEON_INSTRUCTIONS_AVAILABLE };
+	const DWORD featuresEx[] = { PF_EX_SSSE3, PF_EX_SSE41, PF_EX_SSE42,
+		                         PF_EX_AVX,   PF_EX_FMA,   PF_EX_AVX2 };
+	UINT32 mask = 0;
+	size_t x, len;
+
+	for (x = 0; x < ARRAYSIZE(features); x++)
+	{
+		if (IsProcessorFeaturePresent(features[x]))
+			mask |= 1u << x;
+	}
+
+	for (x = 0; x < ARRAYSIZE(featuresEx); x++)
+	{
+		if (IsProcessorFeaturePresentEx(featuresEx[x]))
+			mask |= 1u << (x + ARRAYSIZE(features));
+	}
+
+	_snprintf(signature, size, "%d-%s-%s-%08" PRIx32, TUNE_CACHE_VERSION,
+	          freerdp_get_version_string(), freerdp_get_build_revision(), mask);
+
+	for (x = 0; x < count; x++)
+	{
+		len = strlen(signature);
+		_snprintf(&signature[len], size - len, "-%s", candidates[x].name);
+	}
+}
+
+static size_t tune_find_entry(const char* name)
+{
+	size_t x;
+
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+	{
+		if (strcmp(tune_entries[x].name, name) == 0)
+			return x;
+	}
+
+	return ARRAYSIZE(tune_entries);
+}
+
+static size_t tune_find_candidate(const char* name, const primitives_candidate* candidates,
+                                  size_t count)
+{
+	size_t x;
+
+	for (x = 0; x < count; x++)
+	{
+		if (strcmp(candidates[x].name, name) == 0)
+			return x;
+	}
+
+	return count;
+}
+
+/* The cache is a text file, the signature on the first line followed by <primitive>=<name>
+ * lines. Entries that can not be matched are benchmarked again. */
+static void tune_cache_load(const char* path, const char* signature,
+                            const primitives_candidate* candidates, size_t count,
+                            size_t* selection)
+{
+	char line[256] = { 0 };
+	FILE* fp = winpr_fopen(path, "r");
+
+	if (!fp)
+		return;
+
+	if (!fgets(line, sizeof(line), fp) || (strncmp(line, signature, strlen(signature)) != 0) ||
+	    ((line[strlen(signature)] != '\n') && (line[strlen(signature)] != '\0')))
+	{
+		WLog_DBG(TAG, "ignoring outdated primitives cache %s", path);
+		fclose(fp);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		size_t entry, candidate;
+		char* value = strchr(line, '=');
+		char* end = strchr(line, '\n');
+
+		if (!value)
+			continue;
+
+		*value++ = '\0';
+		if (end)
+			*end = '\0';
+
+		entry = tune_find_entry(line);
+		candidate = tune_find_candidate(value, candidates, count);
+		if ((entry < ARRAYSIZE(tune_entries)) && (candidate < count))
+			selection[entry] = candidate;
+	}
+
+	fclose(fp);
+}
+
+static void tune_cache_save(const char* path, const char* signature,
+                            const primitives_candidate* candidates, const size_t* selection)
+{
+	size_t x;
+	BOOL rc = TRUE;
+	FILE* fp = winpr_fopen(path, "w");
+
+	if (!fp)
+	{
+		WLog_DBG(TAG, "failed to write primitives cache %s", path);
+		return;
+	}
+
+	if (fprintf(fp, "%s\n", signature) < 0)
+		rc = FALSE;
+
+	for (x = 0; rc && (x < ARRAYSIZE(tune_entries)); x++)
+	{
+		if (!tune_entries[x].run)
+			continue;
+
+		if (fprintf(fp, "%s=%s\n", tune_entries[x].name, candidates[selection[x]].name) < 0)
+			rc = FALSE;
+	}
+
+	if (fclose(fp) != 0)
+		rc = FALSE;
+
+	if (!rc)
+	{
+		WLog_DBG(TAG, "failed to write primitives cache %s", path);
+		winpr_DeleteFile(path);
+	}
+}
+
+BOOL primitives_autotune(primitives_t* prims, const primitives_candidate* candidates, size_t count,
+                         size_t fallback)
+{
+	size_t x;
+	size_t selection[ARRAYSIZE(tune_entries)];
+	size_t missing = 0;
+	char signature[256] = { 0 };
+	char* dir = NULL;
+	char* path = NULL;
+	primitives_tune_data data = { 0 };
+	const primitives_t defaults = *candidates[fallback].prims;
+
+	WINPR_ASSERT(prims);
+	WINPR_ASSERT(candidates);
+	WINPR_ASSERT(count <= TUNE_MAX_CANDIDATES);
+	WINPR_ASSERT(fallback < count);
+
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+		selection[x] = count;
+
+	tune_signature(signature, sizeof(signature), candidates, count);
+	dir = tune_cache_dir();
+	if (dir)
+		path = GetCombinedPath(dir, TUNE_CACHE_FILE);
+	if (path)
+		tune_cache_load(path, signature, candidates, count, selection);
+
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+	{
+		if (tune_entries[x].run && (selection[x] >= count))
+			missing++;
+	}
+
+	if (missing > 0)
+	{
+		WLog_DBG(TAG, "primitives benchmark result:");
+		if (!tune_data_init(&data))
+		{
+			WLog_ERR(TAG, "failed to allocate primitives benchmark data");
+			free(path);
+			free(dir);
+			return FALSE;
+		}
+	}
+
+	*prims = defaults;
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+	{
+		const primitives_tune_entry* entry = &tune_entries[x];
+
+		if (!entry->run)
+			continue;
+
+		if (selection[x] >= count)
+			selection[x] = tune_entry(entry, candidates, count, &data, fallback);
+
+		/* a cached candidate may lack the implementation, keep the default then */
+		if (!tune_get(candidates[selection[x]].prims, entry))
+			selection[x] = fallback;
+
+		tune_set(prims, entry, tune_get(candidates[selection[x]].prims, entry));
+		prims->flags |= candidates[selection[x]].prims->flags;
+	}
+
+	if ((missing > 0) && path)
+	{
+		if (!winpr_PathFileExists(dir))
+			winpr_PathMakePath(dir, NULL);
+		tune_cache_save(path, signature, candidates, selection);
+	}
+
+	tune_data_free(&data);
+	free(path);
+	free(dir);
+	return TRUE;
+}
+
+char* primitives_autotune_describe(const primitives_t* prims,
+                                   const primitives_candidate* candidates, size_t count)
+{
+	size_t x, y;
+	size_t len = 0;
+	size_t size = 1;
+	size_t maxName = strlen("unknown");
+	char* buffer;
+
+	WINPR_ASSERT(prims);
+	WINPR_ASSERT(candidates || (count == 0));
+
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+		size += strlen(tune_entries[x].name) + 3;
+
+	for (y = 0; y < count; y++)
+		maxName = MAX(maxName, strlen(candidates[y].name));
+	size += ARRAYSIZE(tune_entries) * maxName;
+
+	buffer = calloc(size, sizeof(char));
+	if (!buffer)
+		return NULL;
+
+	for (x = 0; x < ARRAYSIZE(tune_entries); x++)
+	{
+		const primitives_tune_entry* entry = &tune_entries[x];
+		const primitives_fn fn = tune_get(prims, entry);
+		const char* name = "unknown";
+
+		/* report the first table providing the function, shared code is named after the
+		 * simplest table */
+		for (y = 0; y < count; y++)
+		{
+			if (tune_get(candidates[y].prims, entry) == fn)
+			{
+				name = candidates[y].name;
+				break;
+			}
+		}
+
+		if (!fn)
+			name = "none";
+
+		_snprintf(&buffer[len], size - len, "%s: %s\n", entry->name, name);
+		len += strlen(&buffer[len]);
+	}
+
+	return buffer;
+}
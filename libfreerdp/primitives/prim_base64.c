@@ -0,0 +1,166 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Base64 encoding and decoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* 0xFF marks characters outside of the alphabet, '=' included */
+static const BYTE base64_values[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 62,   0xFF, 0xFF, 0xFF, 63,
+	52,   53,   54,   55,   56,   57,   58,   59,   60,   61,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    10,   11,   12,   13,   14,
+	15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
+	41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t general_base64Encode(const BYTE* pSrc, UINT32 length, char* pDst)
+{
+	UINT32 x;
+	const UINT32 blocks = length - (length % 3);
+
+	for (x = 0; x < blocks; x += 3)
+	{
+		const UINT32 c = ((UINT32)pSrc[x] << 16) | ((UINT32)pSrc[x + 1] << 8) | pSrc[x + 2];
+
+		*pDst++ = base64_alphabet[(c >> 18) & 0x3F];
+		*pDst++ = base64_alphabet[(c >> 12) & 0x3F];
+		*pDst++ = base64_alphabet[(c >> 6) & 0x3F];
+		*pDst++ = base64_alphabet[c & 0x3F];
+	}
+
+	switch (length - blocks)
+	{
+		case 1:
+		{
+			const UINT32 c = (UINT32)pSrc[x] << 16;
+
+			*pDst++ = base64_alphabet[(c >> 18) & 0x3F];
+			*pDst++ = base64_alphabet[(c >> 12) & 0x3F];
+			*pDst++ = '=';
+			*pDst++ = '=';
+		}
+		break;
+
+		case 2:
+		{
+			const UINT32 c = ((UINT32)pSrc[x] << 16) | ((UINT32)pSrc[x + 1] << 8);
+
+			*pDst++ = base64_alphabet[(c >> 18) & 0x3F];
+			*pDst++ = base64_alphabet[(c >> 12) & 0x3F];
+			*pDst++ = base64_alphabet[(c >> 6) & 0x3F];
+			*pDst++ = '=';
+		}
+		break;
+
+		default:
+			break;
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* The last quantum may be padded */
+static pstatus_t base64_decode_last(const char* pSrc, const BYTE* pDst, BYTE* q,
+                                    UINT32* pDstLength)
+{
+	BYTE n[4];
+
+	n[0] = base64_values[(BYTE)pSrc[0]];
+	n[1] = base64_values[(BYTE)pSrc[1]];
+	n[2] = base64_values[(BYTE)pSrc[2]];
+	n[3] = base64_values[(BYTE)pSrc[3]];
+
+	if ((n[0] == 0xFF) || (n[1] == 0xFF))
+		return -1;
+
+	*q++ = (BYTE)((n[0] << 2) | (n[1] >> 4));
+
+	if (n[2] == 0xFF)
+	{
+		/* XX== */
+		if ((pSrc[2] != '=') || (pSrc[3] != '='))
+			return -1;
+	}
+	else if (n[3] == 0xFF)
+	{
+		/* XXX= */
+		if (pSrc[3] != '=')
+			return -1;
+
+		*q++ = (BYTE)((n[1] << 4) | (n[2] >> 2));
+	}
+	else
+	{
+		*q++ = (BYTE)((n[1] << 4) | (n[2] >> 2));
+		*q++ = (BYTE)((n[2] << 6) | n[3]);
+	}
+
+	*pDstLength = (UINT32)(q - pDst);
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t general_base64Decode(const char* pSrc, UINT32 length, BYTE* pDst,
+                                      UINT32* pDstLength)
+{
+	UINT32 x;
+	BYTE* q = pDst;
+
+	if ((length == 0) || (length % 4) || !pDstLength)
+		return -1;
+
+	for (x = 0; x < length - 4; x += 4)
+	{
+		const BYTE n0 = base64_values[(BYTE)pSrc[x]];
+		const BYTE n1 = base64_values[(BYTE)pSrc[x + 1]];
+		const BYTE n2 = base64_values[(BYTE)pSrc[x + 2]];
+		const BYTE n3 = base64_values[(BYTE)pSrc[x + 3]];
+
+		if ((n0 | n1 | n2 | n3) == 0xFF)
+			return -1;
+
+		*q++ = (BYTE)((n0 << 2) | (n1 >> 4));
+		*q++ = (BYTE)((n1 << 4) | (n2 >> 2));
+		*q++ = (BYTE)((n2 << 6) | n3);
+	}
+
+	return base64_decode_last(&pSrc[x], pDst, q, pDstLength);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_base64(primitives_t* prims)
+{
+	prims->base64Encode = general_base64Encode;
+	prims->base64Decode = general_base64Decode;
+}
@@ -0,0 +1,134 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized base64 encoding and decoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_base64Encode(const BYTE* pSrc, UINT32 length, char* pDst)
+{
+	UINT32 x = 0;
+	/* the same steps as the SSSE3 version, 12 input bytes per 128 bit lane */
+	const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10,
+	                                        11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m256i maskAC = _mm256_set1_epi32(0x0FC0FC00);
+	const __m256i shiftAC = _mm256_set1_epi32(0x04000040);
+	const __m256i maskBD = _mm256_set1_epi32(0x003F03F0);
+	const __m256i shiftBD = _mm256_set1_epi32(0x01000010);
+	const __m256i upper = _mm256_set1_epi8(51);
+	const __m256i lower = _mm256_set1_epi8(26);
+	const __m256i thirteen = _mm256_set1_epi8(13);
+	const __m256i offsets = _mm256_setr_epi8(
+	    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+	    'A', 0, 0);
+
+	/* 24 bytes are encoded per iteration, the loads read 28 */
+	for (; x + 28 <= length; x += 24)
+	{
+		const __m128i lo = _mm_loadu_si128((const __m128i*)&pSrc[x]);
+		const __m128i hi = _mm_loadu_si128((const __m128i*)&pSrc[x + 12]);
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		__m256i indices, range;
+		in = _mm256_shuffle_epi8(in, shuffle);
+		indices = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(in, maskAC), shiftAC),
+		                          _mm256_mullo_epi16(_mm256_and_si256(in, maskBD), shiftBD));
+		range = _mm256_subs_epu8(indices, upper);
+		range = _mm256_or_si256(range,
+		                        _mm256_and_si256(_mm256_cmpgt_epi8(lower, indices), thirteen));
+		_mm256_storeu_si256((__m256i*)pDst,
+		                    _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range)));
+		pDst += 32;
+	}
+
+	return generic->base64Encode(&pSrc[x], length - x, pDst);
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_base64Decode(const char* pSrc, UINT32 length, BYTE* pDst,
+                                   UINT32* pDstLength)
+{
+	UINT32 x = 0;
+	UINT32 written = 0;
+	UINT32 tail = 0;
+	const __m256i lutLo = _mm256_setr_epi8(
+	    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+	    0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+	    0x1B, 0x1A);
+	const __m256i lutHi = _mm256_setr_epi8(
+	    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	    0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	    0x10, 0x10);
+	const __m256i lutRoll =
+	    _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+	                     -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i mergeAB = _mm256_set1_epi32(0x01400140);
+	const __m256i mergeABC = _mm256_set1_epi32(0x00011000);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	                                      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	/* moves the 12 bytes of the upper lane next to the ones of the lower lane */
+	const __m256i order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	if ((length == 0) || (length % 4) || !pDstLength)
+		return -1;
+
+	/* 32 characters are decoded per iteration and the store writes 32 bytes. Keep 16
+	 * characters for the generic code, that covers the 8 extra bytes and the padding. */
+	for (; x + 48 <= length; x += 32)
+	{
+		const __m256i in = _mm256_loadu_si256((const __m256i*)&pSrc[x]);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble);
+		const __m256i lo = _mm256_and_si256(in, nibble);
+		const __m256i check =
+		    _mm256_and_si256(_mm256_shuffle_epi8(lutLo, lo), _mm256_shuffle_epi8(lutHi, hi));
+		__m256i values;
+
+		if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(check, _mm256_setzero_si256())) != 0)
+			return -1;
+
+		values = _mm256_add_epi8(in, _mm256_shuffle_epi8(
+		                                 lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(in, slash), hi)));
+		values = _mm256_madd_epi16(_mm256_maddubs_epi16(values, mergeAB), mergeABC);
+		values = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(values, pack), order);
+		_mm256_storeu_si256((__m256i*)&pDst[written], values);
+		written += 24;
+	}
+
+	if (generic->base64Decode(&pSrc[x], length - x, &pDst[written], &tail) != PRIMITIVES_SUCCESS)
+		return -1;
+
+	*pDstLength = written + tail;
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_base64_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->base64Encode = avx2_base64Encode;
+	prims->base64Decode = avx2_base64Decode;
+}
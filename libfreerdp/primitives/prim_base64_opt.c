@@ -0,0 +1,257 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized base64 encoding and decoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(WITH_NEON)
+#include <arm_neon.h>
+#endif /* WITH_SSE2 else WITH_NEON */
+
+#include "prim_internal.h"
+
+static primitives_t* generic = NULL;
+
+#if defined(WITH_SSE2) || defined(WITH_NEON)
+/* The vector loops leave at least one quantum to the generic code, it handles the padding */
+static pstatus_t base64_decode_tail(const char* pSrc, UINT32 length, BYTE* pDst, UINT32 done,
+                                    UINT32 written, UINT32* pDstLength)
+{
+	UINT32 tail = 0;
+
+	if (generic->base64Decode(&pSrc[done], length - done, &pDst[written], &tail) !=
+	    PRIMITIVES_SUCCESS)
+		return -1;
+
+	*pDstLength = written + tail;
+	return PRIMITIVES_SUCCESS;
+}
+#endif
+
+#ifdef WITH_SSE2
+/* ------------------------------------------------------------------------- */
+static pstatus_t ssse3_base64Encode(const BYTE* pSrc, UINT32 length, char* pDst)
+{
+	UINT32 x = 0;
+	/* 3 input bytes per 32 bit lane in the order needed by the multiplications below */
+	const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i maskAC = _mm_set1_epi32(0x0FC0FC00);
+	const __m128i shiftAC = _mm_set1_epi32(0x04000040);
+	const __m128i maskBD = _mm_set1_epi32(0x003F03F0);
+	const __m128i shiftBD = _mm_set1_epi32(0x01000010);
+	const __m128i upper = _mm_set1_epi8(51);
+	const __m128i lower = _mm_set1_epi8(26);
+	const __m128i thirteen = _mm_set1_epi8(13);
+	/* offset to add to a 6 bit value per range: A-Z, a-z, 0-9, '+' and '/' */
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	                                      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	/* 12 bytes are encoded per iteration, the load reads 16 */
+	for (; x + 16 <= length; x += 12)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)&pSrc[x]);
+		__m128i indices, range;
+		in = _mm_shuffle_epi8(in, shuffle);
+		indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(in, maskAC), shiftAC),
+		                       _mm_mullo_epi16(_mm_and_si128(in, maskBD), shiftBD));
+		/* offsets index: 13 for A-Z, 0 for a-z and 1-12 for digits, '+' and '/' */
+		range = _mm_subs_epu8(indices, upper);
+		range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(lower, indices), thirteen));
+		_mm_storeu_si128((__m128i*)pDst,
+		                 _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+		pDst += 16;
+	}
+
+	return generic->base64Encode(&pSrc[x], length - x, pDst);
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t ssse3_base64Decode(const char* pSrc, UINT32 length, BYTE* pDst,
+                                    UINT32* pDstLength)
+{
+	UINT32 x = 0;
+	UINT32 written = 0;
+	/* a character is valid if the lookups of its nibbles have no common bit */
+	const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+	                                    0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+	                                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll =
+	    _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i mergeAB = _mm_set1_epi32(0x01400140);
+	const __m128i mergeABC = _mm_set1_epi32(0x00011000);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	if ((length == 0) || (length % 4) || !pDstLength)
+		return -1;
+
+	/* 16 characters are decoded per iteration and the store writes 16 bytes. Keep 8 characters
+	 * for the generic code, that covers the 4 extra bytes and the padded last quantum. */
+	for (; x + 24 <= length; x += 16)
+	{
+		const __m128i in = _mm_loadu_si128((const __m128i*)&pSrc[x]);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+		const __m128i lo = _mm_and_si128(in, nibble);
+		const __m128i check =
+		    _mm_and_si128(_mm_shuffle_epi8(lutLo, lo), _mm_shuffle_epi8(lutHi, hi));
+		__m128i values;
+
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(check, _mm_setzero_si128())) != 0)
+			return -1;
+
+		values = _mm_add_epi8(
+		    in, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(in, slash), hi)));
+		values = _mm_madd_epi16(_mm_maddubs_epi16(values, mergeAB), mergeABC);
+		_mm_storeu_si128((__m128i*)&pDst[written], _mm_shuffle_epi8(values, pack));
+		written += 12;
+	}
+
+	return base64_decode_tail(pSrc, length, pDst, x, written, pDstLength);
+}
+
+#elif defined(WITH_NEON)
+/* ------------------------------------------------------------------------- */
+static INLINE uint8x16_t neon_base64_char(uint8x16_t value)
+{
+	/* 'A' + value, adjusted at the start of every range of the alphabet */
+	uint8x16_t c = vaddq_u8(value, vdupq_n_u8('A'));
+	c = vaddq_u8(c, vandq_u8(vcgeq_u8(value, vdupq_n_u8(26)), vdupq_n_u8(6)));
+	c = vsubq_u8(c, vandq_u8(vcgeq_u8(value, vdupq_n_u8(52)), vdupq_n_u8(75)));
+	c = vsubq_u8(c, vandq_u8(vcgeq_u8(value, vdupq_n_u8(62)), vdupq_n_u8(15)));
+	return vaddq_u8(c, vandq_u8(vcgeq_u8(value, vdupq_n_u8(63)), vdupq_n_u8(3)));
+}
+
+static INLINE uint8x16_t neon_base64_range(uint8x16_t c, uint8_t first, uint8_t last)
+{
+	return vandq_u8(vcgeq_u8(c, vdupq_n_u8(first)), vcleq_u8(c, vdupq_n_u8(last)));
+}
+
+/* Returns the 6 bit value of each character, valid is cleared for characters outside of the
+ * alphabet */
+static INLINE uint8x16_t neon_base64_value(uint8x16_t c, uint8x16_t* valid)
+{
+	const uint8x16_t upper = neon_base64_range(c, 'A', 'Z');
+	const uint8x16_t lower = neon_base64_range(c, 'a', 'z');
+	const uint8x16_t digit = neon_base64_range(c, '0', '9');
+	const uint8x16_t plus = vceqq_u8(c, vdupq_n_u8('+'));
+	const uint8x16_t slash = vceqq_u8(c, vdupq_n_u8('/'));
+	const uint8x16_t any = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, vorrq_u8(plus, slash)));
+	uint8x16_t value = vandq_u8(upper, vsubq_u8(c, vdupq_n_u8('A')));
+	value = vorrq_u8(value, vandq_u8(lower, vsubq_u8(c, vdupq_n_u8('a' - 26))));
+	value = vorrq_u8(value, vandq_u8(digit, vaddq_u8(c, vdupq_n_u8(52 - '0'))));
+	value = vorrq_u8(value, vandq_u8(plus, vdupq_n_u8(62)));
+	value = vorrq_u8(value, vandq_u8(slash, vdupq_n_u8(63)));
+	*valid = vandq_u8(*valid, any);
+	return value;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_base64Encode(const BYTE* pSrc, UINT32 length, char* pDst)
+{
+	UINT32 x = 0;
+
+	/* 48 bytes are encoded to 64 characters per iteration */
+	for (; x + 48 <= length; x += 48)
+	{
+		const uint8x16x3_t in = vld3q_u8(&pSrc[x]);
+		uint8x16x4_t out;
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)),
+		                      vdupq_n_u8(0x3F));
+		out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)),
+		                      vdupq_n_u8(0x3F));
+		out.val[3] = vandq_u8(in.val[2], vdupq_n_u8(0x3F));
+		out.val[0] = neon_base64_char(out.val[0]);
+		out.val[1] = neon_base64_char(out.val[1]);
+		out.val[2] = neon_base64_char(out.val[2]);
+		out.val[3] = neon_base64_char(out.val[3]);
+		vst4q_u8((uint8_t*)pDst, out);
+		pDst += 64;
+	}
+
+	return generic->base64Encode(&pSrc[x], length - x, pDst);
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_base64Decode(const char* pSrc, UINT32 length, BYTE* pDst,
+                                   UINT32* pDstLength)
+{
+	UINT32 x = 0;
+	UINT32 written = 0;
+
+	if ((length == 0) || (length % 4) || !pDstLength)
+		return -1;
+
+	/* 64 characters are decoded to 48 bytes per iteration, the last quantum may be padded */
+	for (; x + 64 < length; x += 64)
+	{
+		uint8x16_t valid = vdupq_n_u8(0xFF);
+		const uint8x16x4_t in = vld4q_u8((const uint8_t*)&pSrc[x]);
+		const uint8x16_t a = neon_base64_value(in.val[0], &valid);
+		const uint8x16_t b = neon_base64_value(in.val[1], &valid);
+		const uint8x16_t c = neon_base64_value(in.val[2], &valid);
+		const uint8x16_t d = neon_base64_value(in.val[3], &valid);
+		const uint64x2_t check = vreinterpretq_u64_u8(valid);
+		uint8x16x3_t out;
+
+		if ((vgetq_lane_u64(check, 0) & vgetq_lane_u64(check, 1)) != UINT64_MAX)
+			return -1;
+
+		out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+		out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+		out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+		vst3q_u8(&pDst[written], out);
+		written += 48;
+	}
+
+	return base64_decode_tail(pSrc, length, pDst, x, written, pDstLength);
+}
+#endif /* WITH_SSE2 else WITH_NEON */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_base64_opt(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	primitives_init_base64(prims);
+#if defined(WITH_SSE2)
+
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3) &&
+	    IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->base64Encode = ssse3_base64Encode;
+		prims->base64Decode = ssse3_base64Decode;
+	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_base64_avx2(prims);
+
+#elif defined(WITH_NEON)
+
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->base64Encode = neon_base64Encode;
+		prims->base64Decode = neon_base64Decode;
+	}
+
+#endif /* WITH_SSE2 */
+}
@@ -508,10 +508,33 @@ general_RGBToRGB_16s8u_P3AC4R(const INT16* const pSrc[3], /* 16-bit R,G, and B a
 	}
 }
 /* ------------------------------------------------------------------------- */
+static pstatus_t general_RGB565ToARGB_16u32u_C3C4(const UINT16* pSrc, INT32 srcStep, UINT32* pDst,
+                                                  INT32 dstStep, UINT32 width, UINT32 height,
+                                                  UINT32 format)
+{
+	UINT32 x, y;
+	const UINT32 dstBytes = GetBytesPerPixel(format);
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT16* src = (const UINT16*)((const BYTE*)pSrc + 1ll * srcStep * y);
+		BYTE* dst = (BYTE*)pDst + 1ll * dstStep * y;
+
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 color = FreeRDPConvertColor(src[x], PIXEL_FORMAT_RGB16, format, NULL);
+			WriteColor(&dst[x * dstBytes], format, color);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+/* ------------------------------------------------------------------------- */
 void primitives_init_colors(primitives_t* prims)
 {
 	prims->yCbCrToRGB_16s8u_P3AC4R = general_yCbCrToRGB_16s8u_P3AC4R;
 	prims->yCbCrToRGB_16s16s_P3P3 = general_yCbCrToRGB_16s16s_P3P3;
 	prims->RGBToYCbCr_16s16s_P3P3 = general_RGBToYCbCr_16s16s_P3P3;
 	prims->RGBToRGB_16s8u_P3AC4R = general_RGBToRGB_16s8u_P3AC4R;
+	prims->RGB565ToARGB_16u32u_C3C4 = general_RGB565ToARGB_16u32u_C3C4;
 }
@@ -0,0 +1,88 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized color conversion operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_RGB565ToARGB_16u32u_C3C4(const UINT16* pSrc, INT32 srcStep, UINT32* pDst,
+                                               INT32 dstStep, UINT32 width, UINT32 height,
+                                               UINT32 format)
+{
+	UINT32 y;
+	BYTE offsets[4];
+	BYTE alpha;
+	const __m256i mask5 = _mm256_set1_epi16(0x1F);
+	const __m256i mask6 = _mm256_set1_epi16(0x3F);
+	const __m256i max = _mm256_set1_epi16(0xFF);
+
+	if (!get_pixel_layout(format, offsets, &alpha))
+		return generic->RGB565ToARGB_16u32u_C3C4(pSrc, srcStep, pDst, dstStep, width, height,
+		                                         format);
+
+	for (y = 0; y < height; y++)
+	{
+		UINT32 x;
+		const UINT16* src = (const UINT16*)((const BYTE*)pSrc + 1ll * srcStep * y);
+		BYTE* dst = (BYTE*)pDst + 1ll * dstStep * y;
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			__m256i mem[4];
+			const __m256i c = _mm256_loadu_si256((const __m256i*)&src[x]);
+			const __m256i r5 = _mm256_srli_epi16(c, 11);
+			const __m256i g6 = _mm256_and_si256(_mm256_srli_epi16(c, 5), mask6);
+			const __m256i b5 = _mm256_and_si256(c, mask5);
+			/* the same expansion as SplitColor, green saturates at 255 */
+			mem[offsets[0]] = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+			mem[offsets[1]] = _mm256_min_epi16(
+			    _mm256_add_epi16(_mm256_slli_epi16(g6, 2), _mm256_srli_epi16(g6, 3)), max);
+			mem[offsets[2]] = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
+			mem[offsets[3]] = _mm256_set1_epi16(alpha);
+			{
+				const __m256i lo = _mm256_or_si256(mem[0], _mm256_slli_epi16(mem[1], 8));
+				const __m256i hi = _mm256_or_si256(mem[2], _mm256_slli_epi16(mem[3], 8));
+				/* p0 holds pixels 0-3 and 8-11, p1 pixels 4-7 and 12-15 */
+				const __m256i p0 = _mm256_unpacklo_epi16(lo, hi);
+				const __m256i p1 = _mm256_unpackhi_epi16(lo, hi);
+				_mm256_storeu_si256((__m256i*)&dst[x * 4], _mm256_permute2x128_si256(p0, p1, 0x20));
+				_mm256_storeu_si256((__m256i*)&dst[x * 4 + 32],
+				                    _mm256_permute2x128_si256(p0, p1, 0x31));
+			}
+		}
+
+		if (x < width)
+			generic->RGB565ToARGB_16u32u_C3C4(&src[x], srcStep, (UINT32*)&dst[x * 4], dstStep,
+			                                  width - x, 1, format);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_colors_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->RGB565ToARGB_16u32u_C3C4 = avx2_RGB565ToARGB_16u32u_C3C4;
+}
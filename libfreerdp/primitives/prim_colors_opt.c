@@ -1167,6 +1167,61 @@ sse2_RGBToRGB_16s8u_P3AC4R(const INT16* const pSrc[3], /* 16-bit R,G, and B arra
 			return generic->RGBToRGB_16s8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
 	}
 }
+/* ------------------------------------------------------------------------- */
+static pstatus_t sse2_RGB565ToARGB_16u32u_C3C4(const UINT16* pSrc, INT32 srcStep, UINT32* pDst,
+                                               INT32 dstStep, UINT32 width, UINT32 height,
+                                               UINT32 format)
+{
+	UINT32 y;
+	BYTE offsets[4];
+	BYTE alpha;
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask6 = _mm_set1_epi16(0x3F);
+	const __m128i max = _mm_set1_epi16(0xFF);
+
+	if (!get_pixel_layout(format, offsets, &alpha))
+		return generic->RGB565ToARGB_16u32u_C3C4(pSrc, srcStep, pDst, dstStep, width, height,
+		                                         format);
+
+	for (y = 0; y < height; y++)
+	{
+		UINT32 x;
+		const UINT16* src = (const UINT16*)((const BYTE*)pSrc + 1ll * srcStep * y);
+		BYTE* dst = (BYTE*)pDst + 1ll * dstStep * y;
+
+		for (x = 0; x + 8 <= width; x += 8)
+		{
+			__m128i chan[4];
+			__m128i mem[4];
+			const __m128i c = _mm_loadu_si128((const __m128i*)&src[x]);
+			const __m128i r5 = _mm_srli_epi16(c, 11);
+			const __m128i g6 = _mm_and_si128(_mm_srli_epi16(c, 5), mask6);
+			const __m128i b5 = _mm_and_si128(c, mask5);
+			/* the same expansion as SplitColor, green saturates at 255 */
+			chan[0] = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+			chan[1] =
+			    _mm_min_epi16(_mm_add_epi16(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 3)), max);
+			chan[2] = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+			chan[3] = _mm_set1_epi16(alpha);
+			mem[offsets[0]] = chan[0];
+			mem[offsets[1]] = chan[1];
+			mem[offsets[2]] = chan[2];
+			mem[offsets[3]] = chan[3];
+			{
+				const __m128i lo = _mm_or_si128(mem[0], _mm_slli_epi16(mem[1], 8));
+				const __m128i hi = _mm_or_si128(mem[2], _mm_slli_epi16(mem[3], 8));
+				_mm_storeu_si128((__m128i*)&dst[x * 4], _mm_unpacklo_epi16(lo, hi));
+				_mm_storeu_si128((__m128i*)&dst[x * 4 + 16], _mm_unpackhi_epi16(lo, hi));
+			}
+		}
+
+		if (x < width)
+			generic->RGB565ToARGB_16u32u_C3C4(&src[x], srcStep, (UINT32*)&dst[x * 4], dstStep,
+			                                  width - x, 1, format);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif /* WITH_SSE2 */
 
 /*---------------------------------------------------------------------------*/
@@ -1481,6 +1536,53 @@ neon_RGBToRGB_16s8u_P3AC4R(const INT16* const pSrc[3], /* 16-bit R,G, and B arra
 			return generic->RGBToRGB_16s8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
 	}
 }
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_RGB565ToARGB_16u32u_C3C4(const UINT16* pSrc, INT32 srcStep, UINT32* pDst,
+                                               INT32 dstStep, UINT32 width, UINT32 height,
+                                               UINT32 format)
+{
+	UINT32 y;
+	BYTE offsets[4];
+	BYTE alpha;
+	const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+	const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+	const uint16x8_t max = vdupq_n_u16(0xFF);
+
+	if (!get_pixel_layout(format, offsets, &alpha))
+		return generic->RGB565ToARGB_16u32u_C3C4(pSrc, srcStep, pDst, dstStep, width, height,
+		                                         format);
+
+	for (y = 0; y < height; y++)
+	{
+		UINT32 x;
+		const UINT16* src = (const UINT16*)((const BYTE*)pSrc + 1ll * srcStep * y);
+		BYTE* dst = (BYTE*)pDst + 1ll * dstStep * y;
+
+		for (x = 0; x + 8 <= width; x += 8)
+		{
+			uint8x8x4_t pixels;
+			const uint16x8_t c = vld1q_u16(&src[x]);
+			const uint16x8_t r5 = vshrq_n_u16(c, 11);
+			const uint16x8_t g6 = vandq_u16(vshrq_n_u16(c, 5), mask6);
+			const uint16x8_t b5 = vandq_u16(c, mask5);
+			/* the same expansion as SplitColor, green saturates at 255 */
+			const uint16x8_t r = vorrq_u16(vshlq_n_u16(r5, 3), vshrq_n_u16(r5, 2));
+			const uint16x8_t g = vminq_u16(vaddq_u16(vshlq_n_u16(g6, 2), vshrq_n_u16(g6, 3)), max);
+			const uint16x8_t b = vorrq_u16(vshlq_n_u16(b5, 3), vshrq_n_u16(b5, 2));
+			pixels.val[offsets[0]] = vmovn_u16(r);
+			pixels.val[offsets[1]] = vmovn_u16(g);
+			pixels.val[offsets[2]] = vmovn_u16(b);
+			pixels.val[offsets[3]] = vdup_n_u8(alpha);
+			vst4_u8(&dst[x * 4], pixels);
+		}
+
+		if (x < width)
+			generic->RGB565ToARGB_16u32u_C3C4(&src[x], srcStep, (UINT32*)&dst[x * 4], dstStep,
+			                                  width - x, 1, format);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
 #endif /* WITH_NEON */
 /* I don't see a direct IPP version of this, since the input is INT16
  * YCbCr.  It may be possible via  Deinterleave and then YCbCrToRGB_<mod>.
@@ -1500,8 +1602,12 @@ void primitives_init_colors_opt(primitives_t* prims)
 		prims->yCbCrToRGB_16s16s_P3P3 = sse2_yCbCrToRGB_16s16s_P3P3;
 		prims->yCbCrToRGB_16s8u_P3AC4R = sse2_yCbCrToRGB_16s8u_P3AC4R;
 		prims->RGBToYCbCr_16s16s_P3P3 = sse2_RGBToYCbCr_16s16s_P3P3;
+		prims->RGB565ToARGB_16u32u_C3C4 = sse2_RGB565ToARGB_16u32u_C3C4;
 	}
 
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_colors_avx2(prims);
+
 #elif defined(WITH_NEON)
 
 	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
@@ -1509,6 +1615,7 @@ void primitives_init_colors_opt(primitives_t* prims)
 		prims->RGBToRGB_16s8u_P3AC4R = neon_RGBToRGB_16s8u_P3AC4R;
 		prims->yCbCrToRGB_16s8u_P3AC4R = neon_yCbCrToRGB_16s8u_P3AC4R;
 		prims->yCbCrToRGB_16s16s_P3P3 = neon_yCbCrToRGB_16s16s_P3P3;
+		prims->RGB565ToARGB_16u32u_C3C4 = neon_RGB565ToARGB_16u32u_C3C4;
 	}
 
 #endif /* WITH_SSE2 */
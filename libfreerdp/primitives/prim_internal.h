@@ -250,6 +250,139 @@ static INLINE BYTE YUV2B(INT32 Y, INT32 U, INT32 V)
 	return CLIP(b8);
 }
 
+/* Index of the lowest set bit, x must not be zero */
+static INLINE UINT32 prim_ctz32(UINT32 x)
+{
+#if defined(__GNUC__)
+	return (UINT32)__builtin_ctz(x);
+#else
+	UINT32 n = 0;
+
+	while (!(x & 1))
+	{
+		x >>= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+static INLINE UINT32 prim_ctz64(UINT64 x)
+{
+#if defined(__GNUC__)
+	return (UINT32)__builtin_ctzll(x);
+#else
+	UINT32 n = 0;
+
+	while (!(x & 1))
+	{
+		x >>= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+/**
+ * Byte offsets of the alpha, red, green and blue channels (planar plane order) within a
+ * 32bpp pixel. Returns FALSE for other formats, withAlpha is FALSE for formats where
+ * the alpha plane is filled with 0xFF.
+ */
+static INLINE BOOL planar_get_channel_offsets(UINT32 format, BYTE offsets[4], BOOL* withAlpha)
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			offsets[0] = 0;
+			offsets[1] = 1;
+			offsets[2] = 2;
+			offsets[3] = 3;
+			break;
+
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			offsets[0] = 0;
+			offsets[1] = 3;
+			offsets[2] = 2;
+			offsets[3] = 1;
+			break;
+
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			offsets[0] = 3;
+			offsets[1] = 0;
+			offsets[2] = 1;
+			offsets[3] = 2;
+			break;
+
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			offsets[0] = 3;
+			offsets[1] = 2;
+			offsets[2] = 1;
+			offsets[3] = 0;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	*withAlpha = ColorHasAlpha(format);
+	return TRUE;
+}
+
+/**
+ * Byte offsets of the red, green, blue and alpha channels within a 32bpp pixel. Returns
+ * FALSE for other formats, alpha is the value FreeRDPGetColor stores for opaque colors.
+ */
+static INLINE BOOL get_pixel_layout(UINT32 format, BYTE offsets[4], BYTE* alpha)
+{
+	*alpha = ((format == PIXEL_FORMAT_XRGB32) || (format == PIXEL_FORMAT_XBGR32)) ? 0x00 : 0xFF;
+
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			offsets[0] = 1;
+			offsets[1] = 2;
+			offsets[2] = 3;
+			offsets[3] = 0;
+			break;
+
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			offsets[0] = 3;
+			offsets[1] = 2;
+			offsets[2] = 1;
+			offsets[3] = 0;
+			break;
+
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			offsets[0] = 0;
+			offsets[1] = 1;
+			offsets[2] = 2;
+			offsets[3] = 3;
+			break;
+
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			offsets[0] = 2;
+			offsets[1] = 1;
+			offsets[2] = 0;
+			offsets[3] = 3;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* Function prototypes for all the init/deinit routines. */
 FREERDP_LOCAL void primitives_init_copy(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_set(primitives_t* prims);
@@ -261,6 +394,8 @@ FREERDP_LOCAL void primitives_init_alphaComp(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_colors(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YCoCg(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YUV(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_planar(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_base64(primitives_t* prims);
 
 #if defined(WITH_SSE2) || defined(WITH_NEON)
 FREERDP_LOCAL void primitives_init_copy_opt(primitives_t* prims);
@@ -273,6 +408,17 @@ FREERDP_LOCAL void primitives_init_alphaComp_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_colors_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YCoCg_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_planar_opt(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_base64_opt(primitives_t* prims);
+#endif
+
+#if defined(WITH_SSE2)
+FREERDP_LOCAL void primitives_init_alphaComp_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_colors_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_planar_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_base64_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_YCoCg_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_YUV_avx2(primitives_t* prims);
 #endif
 
 #if defined(WITH_OPENCL)
@@ -281,4 +427,18 @@ FREERDP_LOCAL BOOL primitives_init_opencl(primitives_t* prims);
 
 FREERDP_LOCAL primitives_t* primitives_get_by_type(DWORD type);
 
+typedef struct
+{
+	const char* name;
+	const primitives_t* prims;
+} primitives_candidate;
+
+/* Fills prims with the fastest candidate per function, the fallback candidate provides the
+ * functions that are not benchmarked. The selection is cached in the user cache directory. */
+FREERDP_LOCAL BOOL primitives_autotune(primitives_t* prims, const primitives_candidate* candidates,
+                                       size_t count, size_t fallback);
+FREERDP_LOCAL char* primitives_autotune_describe(const primitives_t* prims,
+                                                 const primitives_candidate* candidates,
+                                                 size_t count);
+
 #endif /* FREERDP_LIB_PRIM_INTERNAL_H */
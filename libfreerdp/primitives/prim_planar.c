@@ -0,0 +1,118 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Planar codec encoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+#include "prim_internal.h"
+
+/* ----------------------------------------------------------------------------
+ * Split pixels into the alpha, red, green and blue planes (in that order),
+ * each plane is width * height bytes. A negative srcStep reads bottom up.
+ */
+static pstatus_t general_RGBToPlanar_8u_C4P4(const BYTE* pSrc, UINT32 SrcFormat, INT32 srcStep,
+                                             BYTE* pDst[4], UINT32 width, UINT32 height)
+{
+	UINT32 x, y;
+	size_t k = 0;
+	const UINT32 bpp = GetBytesPerPixel(SrcFormat);
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* pixel = &pSrc[(INT64)srcStep * y];
+
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 color = ReadColor(pixel, SrcFormat);
+			pixel += bpp;
+			SplitColor(color, SrcFormat, &pDst[1][k], &pDst[2][k], &pDst[3][k], &pDst[0][k],
+			           NULL);
+			k++;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------------
+ * Replace every line but the first with the difference to the previous line,
+ * stored as sign (lowest bit) and magnitude.
+ */
+static pstatus_t general_planarDeltaEncode_8u_P1(const BYTE* pSrc, BYTE* pDst, UINT32 width,
+                                                 UINT32 height)
+{
+	UINT32 x, y;
+
+	CopyMemory(pDst, pSrc, width);
+
+	for (y = 1; y < height; y++)
+	{
+		const BYTE* srcPtr = &pSrc[(size_t)y * width];
+		const BYTE* prevLinePtr = srcPtr - width;
+		BYTE* outPtr = &pDst[(size_t)y * width];
+
+		for (x = 0; x < width; x++)
+		{
+			const INT8 delta = (INT8)(srcPtr[x] - prevLinePtr[x]);
+			outPtr[x] = (BYTE)(((UINT32)delta << 1) ^ (UINT32)(delta >> 7));
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ----------------------------------------------------------------------------
+ * Find the next RLE segment of the len bytes line pSrc starting at start:
+ * pRawBytes literal bytes followed by pRunLength (at least 3) repetitions of the
+ * last of them. The byte preceding the line counts as 0. Without a run the rest of
+ * the line is returned as raw bytes.
+ */
+static pstatus_t general_planarRleScan_8u(const BYTE* pSrc, UINT32 start, UINT32 len,
+                                          UINT32* pRawBytes, UINT32* pRunLength)
+{
+	UINT32 j;
+	BYTE symbol = (start > 0) ? pSrc[start - 1] : 0;
+
+	for (j = start; j + 2 < len; j++)
+	{
+		if ((pSrc[j] == symbol) && (pSrc[j + 1] == symbol) && (pSrc[j + 2] == symbol))
+		{
+			UINT32 k = j + 3;
+
+			while ((k < len) && (pSrc[k] == symbol))
+				k++;
+
+			*pRawBytes = j - start;
+			*pRunLength = k - j;
+			return PRIMITIVES_SUCCESS;
+		}
+
+		symbol = pSrc[j];
+	}
+
+	*pRawBytes = len - start;
+	*pRunLength = 0;
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar(primitives_t* prims)
+{
+	prims->RGBToPlanar_8u_C4P4 = general_RGBToPlanar_8u_C4P4;
+	prims->planarDeltaEncode_8u_P1 = general_planarDeltaEncode_8u_P1;
+	prims->planarRleScan_8u = general_planarRleScan_8u;
+}
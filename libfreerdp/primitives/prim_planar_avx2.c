@@ -0,0 +1,206 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * AVX2 optimized planar codec encoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include <immintrin.h>
+
+#include "prim_internal.h"
+
+/* This file is built with AVX2 enabled, only call it after checking PF_EX_AVX2 */
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_RGBToPlanar_8u_C4P4(const BYTE* pSrc, UINT32 SrcFormat, INT32 srcStep,
+                                          BYTE* pDst[4], UINT32 width, UINT32 height)
+{
+	UINT32 x, y, i;
+	size_t k = 0;
+	BYTE offsets[4];
+	BOOL withAlpha;
+	BYTE shuffle[32];
+	__m256i mask;
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i opaque = _mm256_set1_epi8((char)0xFF);
+
+	if (!planar_get_channel_offsets(SrcFormat, offsets, &withAlpha))
+		return generic->RGBToPlanar_8u_C4P4(pSrc, SrcFormat, srcStep, pDst, width, height);
+
+	/* gather the channels of 4 pixels into one 32 bit lane per plane, in both halves */
+	for (i = 0; i < 32; i++)
+		shuffle[i] = (BYTE)((i % 4) * 4 + offsets[(i % 16) / 4]);
+
+	mask = _mm256_loadu_si256((const __m256i*)shuffle);
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[(INT64)srcStep * y];
+
+		for (x = 0; x + 32 <= width; x += 32)
+		{
+			const __m256i v0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), mask);
+			const __m256i v1 =
+			    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 32)), mask);
+			const __m256i v2 =
+			    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 64)), mask);
+			const __m256i v3 =
+			    _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 96)), mask);
+			const __m256i t0 = _mm256_unpacklo_epi32(v0, v1);
+			const __m256i t1 = _mm256_unpacklo_epi32(v2, v3);
+			const __m256i t2 = _mm256_unpackhi_epi32(v0, v1);
+			const __m256i t3 = _mm256_unpackhi_epi32(v2, v3);
+			/* the unpacks work per 128 bit half, restore the pixel order */
+			const __m256i a = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t0, t1), order);
+			const __m256i r = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t0, t1), order);
+			const __m256i g = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t2, t3), order);
+			const __m256i b = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t2, t3), order);
+			_mm256_storeu_si256((__m256i*)&pDst[0][k], withAlpha ? a : opaque);
+			_mm256_storeu_si256((__m256i*)&pDst[1][k], r);
+			_mm256_storeu_si256((__m256i*)&pDst[2][k], g);
+			_mm256_storeu_si256((__m256i*)&pDst[3][k], b);
+			src += 128;
+			k += 32;
+		}
+
+		for (; x < width; x++)
+		{
+			pDst[0][k] = withAlpha ? src[offsets[0]] : 0xFF;
+			pDst[1][k] = src[offsets[1]];
+			pDst[2][k] = src[offsets[2]];
+			pDst[3][k] = src[offsets[3]];
+			src += 4;
+			k++;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_planarDeltaEncode_8u_P1(const BYTE* pSrc, BYTE* pDst, UINT32 width,
+                                              UINT32 height)
+{
+	UINT32 x, y;
+	const __m256i zero = _mm256_setzero_si256();
+
+	CopyMemory(pDst, pSrc, width);
+
+	for (y = 1; y < height; y++)
+	{
+		const BYTE* srcPtr = &pSrc[(size_t)y * width];
+		const BYTE* prevLinePtr = srcPtr - width;
+		BYTE* outPtr = &pDst[(size_t)y * width];
+
+		for (x = 0; x + 32 <= width; x += 32)
+		{
+			const __m256i cur = _mm256_loadu_si256((const __m256i*)&srcPtr[x]);
+			const __m256i prev = _mm256_loadu_si256((const __m256i*)&prevLinePtr[x]);
+			const __m256i delta = _mm256_sub_epi8(cur, prev);
+			const __m256i sign = _mm256_cmpgt_epi8(zero, delta);
+			_mm256_storeu_si256((__m256i*)&outPtr[x],
+			                    _mm256_xor_si256(_mm256_add_epi8(delta, delta), sign));
+		}
+
+		for (; x < width; x++)
+		{
+			const INT8 delta = (INT8)(srcPtr[x] - prevLinePtr[x]);
+			outPtr[x] = (BYTE)(((UINT32)delta << 1) ^ (UINT32)(delta >> 7));
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_planarRleScan_8u(const BYTE* pSrc, UINT32 start, UINT32 len,
+                                       UINT32* pRawBytes, UINT32* pRunLength)
+{
+	pstatus_t status;
+	UINT32 j = start;
+	UINT32 k;
+	BYTE symbol;
+	__m256i vsymbol;
+
+	/* the vector loop reads pSrc[j - 1], check for a run of the virtual zero first */
+	if (j == 0)
+	{
+		if (len < 3)
+			return generic->planarRleScan_8u(pSrc, start, len, pRawBytes, pRunLength);
+
+		if (!pSrc[0] && !pSrc[1] && !pSrc[2])
+			goto run;
+
+		j = 1;
+	}
+
+	/* candidates j..j+31, each needs pSrc[j - 1] == pSrc[j] == pSrc[j + 1] == pSrc[j + 2] */
+	for (; j + 34 <= len; j += 32)
+	{
+		const __m256i vm1 = _mm256_loadu_si256((const __m256i*)&pSrc[j - 1]);
+		const __m256i v0 = _mm256_loadu_si256((const __m256i*)&pSrc[j]);
+		const __m256i v1 = _mm256_loadu_si256((const __m256i*)&pSrc[j + 1]);
+		const __m256i v2 = _mm256_loadu_si256((const __m256i*)&pSrc[j + 2]);
+		const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(vm1, v0),
+		                                    _mm256_and_si256(_mm256_cmpeq_epi8(v0, v1),
+		                                                     _mm256_cmpeq_epi8(v1, v2)));
+		const UINT32 found = (UINT32)_mm256_movemask_epi8(eq);
+
+		if (found)
+		{
+			j += prim_ctz32(found);
+			goto run;
+		}
+	}
+
+	status = generic->planarRleScan_8u(pSrc, j, len, pRawBytes, pRunLength);
+	*pRawBytes += j - start;
+	return status;
+
+run:
+	symbol = (j > 0) ? pSrc[j - 1] : 0;
+	vsymbol = _mm256_set1_epi8((char)symbol);
+	k = j + 3;
+
+	for (; k + 32 <= len; k += 32)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i*)&pSrc[k]);
+		const UINT32 equal = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vsymbol));
+
+		if (equal != 0xFFFFFFFF)
+		{
+			k += prim_ctz32(~equal);
+			break;
+		}
+	}
+
+	while ((k < len) && (pSrc[k] == symbol))
+		k++;
+
+	*pRawBytes = j - start;
+	*pRunLength = k - j;
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->RGBToPlanar_8u_C4P4 = avx2_RGBToPlanar_8u_C4P4;
+	prims->planarDeltaEncode_8u_P1 = avx2_planarDeltaEncode_8u_P1;
+	prims->planarRleScan_8u = avx2_planarRleScan_8u;
+}
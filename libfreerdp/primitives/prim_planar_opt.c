@@ -0,0 +1,378 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized planar codec encoding operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#ifdef WITH_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#elif defined(WITH_NEON)
+#include <arm_neon.h>
+#endif /* WITH_SSE2 else WITH_NEON */
+
+#include "prim_internal.h"
+
+static primitives_t* generic = NULL;
+
+#ifdef WITH_SSE2
+/* ------------------------------------------------------------------------- */
+static pstatus_t ssse3_RGBToPlanar_8u_C4P4(const BYTE* pSrc, UINT32 SrcFormat, INT32 srcStep,
+                                           BYTE* pDst[4], UINT32 width, UINT32 height)
+{
+	UINT32 x, y, i;
+	size_t k = 0;
+	BYTE offsets[4];
+	BOOL withAlpha;
+	BYTE shuffle[16];
+	__m128i mask;
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+
+	if (!planar_get_channel_offsets(SrcFormat, offsets, &withAlpha))
+		return generic->RGBToPlanar_8u_C4P4(pSrc, SrcFormat, srcStep, pDst, width, height);
+
+	/* gather the channels of 4 pixels into one 32 bit lane per plane */
+	for (i = 0; i < 16; i++)
+		shuffle[i] = (BYTE)((i % 4) * 4 + offsets[i / 4]);
+
+	mask = _mm_loadu_si128((const __m128i*)shuffle);
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[(INT64)srcStep * y];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			const __m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask);
+			const __m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), mask);
+			const __m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 32)), mask);
+			const __m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 48)), mask);
+			const __m128i t0 = _mm_unpacklo_epi32(v0, v1);
+			const __m128i t1 = _mm_unpacklo_epi32(v2, v3);
+			const __m128i t2 = _mm_unpackhi_epi32(v0, v1);
+			const __m128i t3 = _mm_unpackhi_epi32(v2, v3);
+			const __m128i a = withAlpha ? _mm_unpacklo_epi64(t0, t1) : opaque;
+			_mm_storeu_si128((__m128i*)&pDst[0][k], a);
+			_mm_storeu_si128((__m128i*)&pDst[1][k], _mm_unpackhi_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)&pDst[2][k], _mm_unpacklo_epi64(t2, t3));
+			_mm_storeu_si128((__m128i*)&pDst[3][k], _mm_unpackhi_epi64(t2, t3));
+			src += 64;
+			k += 16;
+		}
+
+		for (; x < width; x++)
+		{
+			pDst[0][k] = withAlpha ? src[offsets[0]] : 0xFF;
+			pDst[1][k] = src[offsets[1]];
+			pDst[2][k] = src[offsets[2]];
+			pDst[3][k] = src[offsets[3]];
+			src += 4;
+			k++;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t sse2_planarDeltaEncode_8u_P1(const BYTE* pSrc, BYTE* pDst, UINT32 width,
+                                              UINT32 height)
+{
+	UINT32 x, y;
+	const __m128i zero = _mm_setzero_si128();
+
+	CopyMemory(pDst, pSrc, width);
+
+	for (y = 1; y < height; y++)
+	{
+		const BYTE* srcPtr = &pSrc[(size_t)y * width];
+		const BYTE* prevLinePtr = srcPtr - width;
+		BYTE* outPtr = &pDst[(size_t)y * width];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			const __m128i cur = _mm_loadu_si128((const __m128i*)&srcPtr[x]);
+			const __m128i prev = _mm_loadu_si128((const __m128i*)&prevLinePtr[x]);
+			const __m128i delta = _mm_sub_epi8(cur, prev);
+			const __m128i sign = _mm_cmpgt_epi8(zero, delta);
+			_mm_storeu_si128((__m128i*)&outPtr[x],
+			                 _mm_xor_si128(_mm_add_epi8(delta, delta), sign));
+		}
+
+		for (; x < width; x++)
+		{
+			const INT8 delta = (INT8)(srcPtr[x] - prevLinePtr[x]);
+			outPtr[x] = (BYTE)(((UINT32)delta << 1) ^ (UINT32)(delta >> 7));
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t sse2_planarRleScan_8u(const BYTE* pSrc, UINT32 start, UINT32 len,
+                                       UINT32* pRawBytes, UINT32* pRunLength)
+{
+	pstatus_t status;
+	UINT32 j = start;
+	UINT32 k;
+	BYTE symbol;
+	__m128i vsymbol;
+
+	/* the vector loop reads pSrc[j - 1], check for a run of the virtual zero first */
+	if (j == 0)
+	{
+		if (len < 3)
+			return generic->planarRleScan_8u(pSrc, start, len, pRawBytes, pRunLength);
+
+		if (!pSrc[0] && !pSrc[1] && !pSrc[2])
+			goto run;
+
+		j = 1;
+	}
+
+	/* candidates j..j+15, each needs pSrc[j - 1] == pSrc[j] == pSrc[j + 1] == pSrc[j + 2] */
+	for (; j + 18 <= len; j += 16)
+	{
+		const __m128i vm1 = _mm_loadu_si128((const __m128i*)&pSrc[j - 1]);
+		const __m128i v0 = _mm_loadu_si128((const __m128i*)&pSrc[j]);
+		const __m128i v1 = _mm_loadu_si128((const __m128i*)&pSrc[j + 1]);
+		const __m128i v2 = _mm_loadu_si128((const __m128i*)&pSrc[j + 2]);
+		const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(vm1, v0),
+		                                 _mm_and_si128(_mm_cmpeq_epi8(v0, v1),
+		                                               _mm_cmpeq_epi8(v1, v2)));
+		const UINT32 found = (UINT32)_mm_movemask_epi8(eq);
+
+		if (found)
+		{
+			j += prim_ctz32(found);
+			goto run;
+		}
+	}
+
+	status = generic->planarRleScan_8u(pSrc, j, len, pRawBytes, pRunLength);
+	*pRawBytes += j - start;
+	return status;
+
+run:
+	symbol = (j > 0) ? pSrc[j - 1] : 0;
+	vsymbol = _mm_set1_epi8((char)symbol);
+	k = j + 3;
+
+	for (; k + 16 <= len; k += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&pSrc[k]);
+		const UINT32 equal = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vsymbol));
+
+		if (equal != 0xFFFF)
+		{
+			k += prim_ctz32(~equal);
+			break;
+		}
+	}
+
+	while ((k < len) && (pSrc[k] == symbol))
+		k++;
+
+	*pRawBytes = j - start;
+	*pRunLength = k - j;
+	return PRIMITIVES_SUCCESS;
+}
+
+#elif defined(WITH_NEON)
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_RGBToPlanar_8u_C4P4(const BYTE* pSrc, UINT32 SrcFormat, INT32 srcStep,
+                                          BYTE* pDst[4], UINT32 width, UINT32 height)
+{
+	UINT32 x, y;
+	size_t k = 0;
+	BYTE offsets[4];
+	BOOL withAlpha;
+	const uint8x16_t opaque = vdupq_n_u8(0xFF);
+
+	if (!planar_get_channel_offsets(SrcFormat, offsets, &withAlpha))
+		return generic->RGBToPlanar_8u_C4P4(pSrc, SrcFormat, srcStep, pDst, width, height);
+
+	for (y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[(INT64)srcStep * y];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			/* vld4 splits 16 pixels by byte position */
+			const uint8x16x4_t v = vld4q_u8(src);
+			vst1q_u8(&pDst[0][k], withAlpha ? v.val[offsets[0]] : opaque);
+			vst1q_u8(&pDst[1][k], v.val[offsets[1]]);
+			vst1q_u8(&pDst[2][k], v.val[offsets[2]]);
+			vst1q_u8(&pDst[3][k], v.val[offsets[3]]);
+			src += 64;
+			k += 16;
+		}
+
+		for (; x < width; x++)
+		{
+			pDst[0][k] = withAlpha ? src[offsets[0]] : 0xFF;
+			pDst[1][k] = src[offsets[1]];
+			pDst[2][k] = src[offsets[2]];
+			pDst[3][k] = src[offsets[3]];
+			src += 4;
+			k++;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_planarDeltaEncode_8u_P1(const BYTE* pSrc, BYTE* pDst, UINT32 width,
+                                              UINT32 height)
+{
+	UINT32 x, y;
+
+	CopyMemory(pDst, pSrc, width);
+
+	for (y = 1; y < height; y++)
+	{
+		const BYTE* srcPtr = &pSrc[(size_t)y * width];
+		const BYTE* prevLinePtr = srcPtr - width;
+		BYTE* outPtr = &pDst[(size_t)y * width];
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			const uint8x16_t delta = vsubq_u8(vld1q_u8(&srcPtr[x]), vld1q_u8(&prevLinePtr[x]));
+			const uint8x16_t sign = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(delta), 7));
+			vst1q_u8(&outPtr[x], veorq_u8(vaddq_u8(delta, delta), sign));
+		}
+
+		for (; x < width; x++)
+		{
+			const INT8 delta = (INT8)(srcPtr[x] - prevLinePtr[x]);
+			outPtr[x] = (BYTE)(((UINT32)delta << 1) ^ (UINT32)(delta >> 7));
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* Narrows a byte mask to 4 bits per byte, the index of the first match is ctz / 4 */
+static INLINE UINT64 neon_movemask_u8(uint8x16_t mask)
+{
+	const uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(mask), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(narrow), 0);
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_planarRleScan_8u(const BYTE* pSrc, UINT32 start, UINT32 len,
+                                       UINT32* pRawBytes, UINT32* pRunLength)
+{
+	pstatus_t status;
+	UINT32 j = start;
+	UINT32 k;
+	BYTE symbol;
+	uint8x16_t vsymbol;
+
+	/* the vector loop reads pSrc[j - 1], check for a run of the virtual zero first */
+	if (j == 0)
+	{
+		if (len < 3)
+			return generic->planarRleScan_8u(pSrc, start, len, pRawBytes, pRunLength);
+
+		if (!pSrc[0] && !pSrc[1] && !pSrc[2])
+			goto run;
+
+		j = 1;
+	}
+
+	for (; j + 18 <= len; j += 16)
+	{
+		const uint8x16_t vm1 = vld1q_u8(&pSrc[j - 1]);
+		const uint8x16_t v0 = vld1q_u8(&pSrc[j]);
+		const uint8x16_t v1 = vld1q_u8(&pSrc[j + 1]);
+		const uint8x16_t v2 = vld1q_u8(&pSrc[j + 2]);
+		const uint8x16_t eq =
+		    vandq_u8(vceqq_u8(vm1, v0), vandq_u8(vceqq_u8(v0, v1), vceqq_u8(v1, v2)));
+		const UINT64 found = neon_movemask_u8(eq);
+
+		if (found)
+		{
+			j += prim_ctz64(found) / 4;
+			goto run;
+		}
+	}
+
+	status = generic->planarRleScan_8u(pSrc, j, len, pRawBytes, pRunLength);
+	*pRawBytes += j - start;
+	return status;
+
+run:
+	symbol = (j > 0) ? pSrc[j - 1] : 0;
+	vsymbol = vdupq_n_u8(symbol);
+	k = j + 3;
+
+	for (; k + 16 <= len; k += 16)
+	{
+		const UINT64 differ = neon_movemask_u8(vmvnq_u8(vceqq_u8(vld1q_u8(&pSrc[k]), vsymbol)));
+
+		if (differ)
+		{
+			k += prim_ctz64(differ) / 4;
+			break;
+		}
+	}
+
+	while ((k < len) && (pSrc[k] == symbol))
+		k++;
+
+	*pRawBytes = j - start;
+	*pRunLength = k - j;
+	return PRIMITIVES_SUCCESS;
+}
+#endif /* WITH_SSE2 else WITH_NEON */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar_opt(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	primitives_init_planar(prims);
+#if defined(WITH_SSE2)
+
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->planarDeltaEncode_8u_P1 = sse2_planarDeltaEncode_8u_P1;
+		prims->planarRleScan_8u = sse2_planarRleScan_8u;
+	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3) &&
+	    IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGBToPlanar_8u_C4P4 = ssse3_RGBToPlanar_8u_C4P4;
+	}
+
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_planar_avx2(prims);
+
+#elif defined(WITH_NEON)
+
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		prims->RGBToPlanar_8u_C4P4 = neon_RGBToPlanar_8u_C4P4;
+		prims->planarDeltaEncode_8u_P1 = neon_planarDeltaEncode_8u_P1;
+		prims->planarRleScan_8u = neon_planarRleScan_8u;
+	}
+
+#endif /* WITH_SSE2 */
+}
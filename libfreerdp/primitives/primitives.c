@@ -23,7 +23,6 @@
 
 #include <winpr/synch.h>
 #include <winpr/sysinfo.h>
-#include <winpr/crypto.h>
 #include <freerdp/primitives.h>
 
 #include "prim_internal.h"
@@ -76,6 +75,8 @@ static BOOL primitives_init_generic(primitives_t* prims)
 	primitives_init_colors(prims);
 	primitives_init_YCoCg(prims);
 	primitives_init_YUV(prims);
+	primitives_init_planar(prims);
+	primitives_init_base64(prims);
 	prims->uninit = NULL;
 	return TRUE;
 }
@@ -103,168 +104,79 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	primitives_init_colors_opt(prims);
 	primitives_init_YCoCg_opt(prims);
 	primitives_init_YUV_opt(prims);
+	primitives_init_planar_opt(prims);
+	primitives_init_base64_opt(prims);
 	prims->flags |= PRIM_FLAGS_HAVE_EXTCPU;
 #endif
 	return TRUE;
 }
 
-typedef struct
+/* The candidates in order of preference for shared functions, the generic code first */
+static size_t primitives_get_candidates(primitives_candidate* candidates, size_t count)
 {
-	BYTE* channels[3];
-	UINT32 steps[3];
-	prim_size_t roi;
-	BYTE* outputBuffer;
-	UINT32 outputStride;
-	UINT32 testedFormat;
-} primitives_YUV_benchmark;
-
-static void primitives_YUV_benchmark_free(primitives_YUV_benchmark* bench)
-{
-	int i;
-	if (!bench)
-		return;
-
-	free(bench->outputBuffer);
-
-	for (i = 0; i < 3; i++)
-		free(bench->channels[i]);
-	memset(bench, 0, sizeof(primitives_YUV_benchmark));
-}
-
-static primitives_YUV_benchmark* primitives_YUV_benchmark_init(primitives_YUV_benchmark* ret)
-{
-	int i;
-	prim_size_t* roi;
-	if (!ret)
-		return NULL;
-
-	memset(ret, 0, sizeof(primitives_YUV_benchmark));
-	roi = &ret->roi;
-	roi->width = 1024;
-	roi->height = 768;
-	ret->outputStride = roi->width * 4;
-	ret->testedFormat = PIXEL_FORMAT_BGRA32;
-
-	ret->outputBuffer = calloc(ret->outputStride, roi->height);
-	if (!ret->outputBuffer)
-		goto fail;
-
-	for (i = 0; i < 3; i++)
-	{
-		BYTE* buf = ret->channels[i] = calloc(roi->width, roi->height);
-		if (!buf)
-			goto fail;
-
-		winpr_RAND(buf, roi->width * roi->height * 1ULL);
-		ret->steps[i] = roi->width;
-	}
-
-	return ret;
-
-fail:
-	primitives_YUV_benchmark_free(ret);
-	return ret;
-}
-
-static BOOL primitives_YUV_benchmark_run(primitives_YUV_benchmark* bench, primitives_t* prims,
-                                         UINT64 runTime, UINT32* computations)
-{
-	ULONGLONG dueDate;
-	const BYTE* channels[3] = { 0 };
-	size_t i;
-	pstatus_t status;
-
-	*computations = 0;
-
-	for (i = 0; i < 3; i++)
-		channels[i] = bench->channels[i];
-
-	/* do a first dry run to initialize cache and such */
-	status = prims->YUV420ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
-	                                      bench->outputStride, bench->testedFormat, &bench->roi);
-	if (status != PRIMITIVES_SUCCESS)
-		return FALSE;
-
-	/* let's run the benchmark */
-	dueDate = GetTickCount64() + runTime;
-	while (GetTickCount64() < dueDate)
-	{
-		pstatus_t cstatus =
-		    prims->YUV420ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
-		                                 bench->outputStride, bench->testedFormat, &bench->roi);
-		if (cstatus != PRIMITIVES_SUCCESS)
-			return FALSE;
-		*computations = *computations + 1;
-	}
-	return TRUE;
-}
-
-static BOOL primitives_autodetect_best(primitives_t* prims)
-{
-	size_t x;
-	BOOL ret = FALSE;
-	UINT64 benchDuration = 150; /* 150 ms */
-	struct prim_benchmark
+	size_t used = 0;
+	const struct
 	{
 		const char* name;
-		primitives_t* prims;
-		UINT32 flags;
-		UINT32 count;
-	};
-
-	struct prim_benchmark testcases[] =
-	{
-		{ "generic", NULL, PRIMITIVES_PURE_SOFT, 0 },
+		DWORD type;
+	} tables[] = {
+		{ "generic", PRIMITIVES_PURE_SOFT },
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES)
-		{ "optimized", NULL, PRIMITIVES_ONLY_CPU, 0 },
+		{ "optimized", PRIMITIVES_ONLY_CPU },
 #endif
 #if defined(WITH_OPENCL)
-		{ "opencl", NULL, PRIMITIVES_ONLY_GPU, 0 },
+		{ "opencl", PRIMITIVES_ONLY_GPU },
 #endif
 	};
-	const struct prim_benchmark* best = NULL;
-
-	primitives_YUV_benchmark bench;
-	primitives_YUV_benchmark* yuvBench = primitives_YUV_benchmark_init(&bench);
-	if (!yuvBench)
-		return FALSE;
+	size_t x;
 
-	WLog_DBG(TAG, "primitives benchmark result:");
-	for (x = 0; x < ARRAYSIZE(testcases); x++)
+	for (x = 0; (x < ARRAYSIZE(tables)) && (used < count); x++)
 	{
-		struct prim_benchmark* cur = &testcases[x];
-		cur->prims = primitives_get_by_type(cur->flags);
-		if (!cur->prims)
-		{
-			WLog_WARN(TAG, "Failed to initialize %s primitives", cur->name);
-			continue;
-		}
-		if (!primitives_YUV_benchmark_run(yuvBench, cur->prims, benchDuration, &cur->count))
+		const primitives_t* prims = primitives_get_by_type(tables[x].type);
+
+		/* primitives_get_by_type falls back to the generic table on failure */
+		if (!prims || ((x > 0) && (prims == candidates[0].prims)))
 		{
-			WLog_WARN(TAG, "error running %s YUV bench", cur->name);
+			WLog_WARN(TAG, "Failed to initialize %s primitives", tables[x].name);
 			continue;
 		}
 
-		WLog_DBG(TAG, " * %s= %" PRIu32, cur->name, cur->count);
-		if (!best || (best->count < cur->count))
-			best = cur;
+		candidates[used].name = tables[x].name;
+		candidates[used].prims = prims;
+		used++;
 	}
 
-	if (!best)
+	return used;
+}
+
+static BOOL primitives_autodetect_best(primitives_t* prims)
+{
+	size_t x;
+	size_t fallback = 0;
+	primitives_candidate candidates[3] = { 0 };
+	const size_t count = primitives_get_candidates(candidates, ARRAYSIZE(candidates));
+
+	if (count == 0)
 	{
 		WLog_ERR(TAG, "No primitives to test, aborting.");
-		goto out;
+		*prims = pPrimitivesGeneric;
+		return FALSE;
 	}
-	/* finally compute the results */
-	*prims = *best->prims;
 
-	WLog_DBG(TAG, "primitives autodetect, using %s", best->name);
-	ret = TRUE;
-out:
-	if (!ret)
+	/* functions without a benchmark use the CPU optimized ones */
+	for (x = 0; x < count; x++)
+	{
+		if (strcmp(candidates[x].name, "optimized") == 0)
+			fallback = x;
+	}
+
+	if (!primitives_autotune(prims, candidates, count, fallback))
+	{
 		*prims = pPrimitivesGeneric;
-	primitives_YUV_benchmark_free(yuvBench);
-	return ret;
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
 #if defined(WITH_OPENCL)
@@ -396,3 +308,12 @@ DWORD primitives_flags(primitives_t* p)
 {
 	return p->flags;
 }
+
+char* primitives_get_selection(void)
+{
+	primitives_candidate candidates[3] = { 0 };
+	primitives_t* prims = primitives_get();
+	const size_t count = primitives_get_candidates(candidates, ARRAYSIZE(candidates));
+
+	return primitives_autotune_describe(prims, candidates, count);
+}
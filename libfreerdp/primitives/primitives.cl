@@ -135,4 +135,134 @@ __kernel void yuv444_to_argb_1b(
 	destPtr[1] = clamp_uc((y256 + (403 * V)) >> 8, 0, 255); 	/* R */
 	destPtr[0] = 0xff; /* A */
 }
+
+/**
+ * RemoteFX: one work group of 64 items per tile component. The coefficients are dequantized
+ * while they are loaded into local memory, the 3 levels of the inverse DWT run there.
+ * The commas of this file have to stay inside parentheses, STRINGIFY takes one argument.
+ */
+short rfx_dequantize(short v, uint quant)
+{
+    uint factor = (quant > 0) ? quant - 1 : 0;
+    return (short)(v << factor);
+}
+
+uint rfx_band_quant(__global const uint *quants, int i)
+{
+    /* HL1 LH1 HH1 HL2 LH2 HH2 HL3 LH3 HH3 LL3 */
+    if (i < 1024) return quants[8];
+    if (i < 2048) return quants[7];
+    if (i < 3072) return quants[9];
+    if (i < 3328) return quants[5];
+    if (i < 3584) return quants[4];
+    if (i < 3840) return quants[6];
+    if (i < 3904) return quants[2];
+    if (i < 3968) return quants[1];
+    if (i < 4032) return quants[3];
+    return quants[0];
+}
+
+/* the inverse DWT of one line, low and high hold width values each */
+void rfx_idwt_line(__local const short *low, __local const short *high,
+    __local short *dst, int width, int srcStep, int dstStep)
+{
+    int n;
+
+    dst[0] = low[0] - ((high[0] + high[0] + 1) >> 1);
+    for (n = 1; n < width; n++)
+    {
+        dst[2 * n * dstStep] = low[n * srcStep] -
+            ((high[(n - 1) * srcStep] + high[n * srcStep] + 1) >> 1);
+        dst[(2 * n - 1) * dstStep] = (high[(n - 1) * srcStep] << 1) +
+            ((dst[(2 * n - 2) * dstStep] + dst[2 * n * dstStep]) >> 1);
+    }
+    dst[(2 * width - 1) * dstStep] = (high[(width - 1) * srcStep] << 1) +
+        dst[(2 * width - 2) * dstStep];
+}
+
+void rfx_idwt_block(__local short *buffer, __local short *idwt, int width, int id)
+{
+    int total = 2 * width;
+    int size = width * width;
+
+    /* horizontal: L from LL(3) and HL(0), H from LH(1) and HH(2) */
+    if (id < width)
+        rfx_idwt_line(&buffer[3 * size + id * width], &buffer[id * width],
+            &idwt[id * total], width, 1, 1);
+    else if (id < total)
+        rfx_idwt_line(&buffer[size + (id - width) * width],
+            &buffer[2 * size + (id - width) * width],
+            &idwt[2 * size + (id - width) * total], width, 1, 1);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* vertical, back into the sub-band buffer */
+    if (id < total)
+        rfx_idwt_line(&idwt[id], &idwt[id + width * total], &buffer[id], width, total, total);
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+__kernel void rfx_decode_component(__global short *coefficients, __global const uint *quants)
+{
+    __local short buffer[4096];
+    __local short idwt[4096];
+    int id = get_local_id(0);
+    int component = get_group_id(0);
+    __global short *src = coefficients + component * 4096;
+    __global const uint *quant = quants + component * 10;
+    int i;
+
+    for (i = id; i < 4096; i += 64)
+        buffer[i] = rfx_dequantize(src[i], rfx_band_quant(quant, i));
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    rfx_idwt_block(&buffer[3840], idwt, 8, id);
+    rfx_idwt_block(&buffer[3072], idwt, 16, id);
+    rfx_idwt_block(buffer, idwt, 32, id);
+
+    for (i = id; i < 4096; i += 64)
+        src[i] = buffer[i];
+}
+
+/* the 11.5 fixed point YCbCr to RGB conversion of yCbCrToRGB_16s8u_P3AC4R */
+uchar rfx_clamp(long v)
+{
+    return (uchar)clamp(v, (long)0, (long)255);
+}
+
+/* one item per pixel, the items of dimension 1 cover all rows of all tiles */
+__kernel void rfx_tiles_to_bgra(__global const short *coefficients, __global uchar *dest)
+{
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int tile = y / 64;
+    int offset = (y % 64) * 64 + x;
+    __global const short *src = coefficients + tile * 3 * 4096;
+    long Y = (int)((uint)(src[offset] + 4096) << 16);
+    long Cb = src[4096 + offset];
+    long Cr = src[8192 + offset];
+    __global uchar *destPtr = dest + (tile * 4096 + offset) * 4;
+
+    destPtr[0] = rfx_clamp((short)((Y + Cb * 115992) >> 16) >> 5); /* B */
+    destPtr[1] = rfx_clamp((short)((Y - Cb * 22526 - Cr * 46818) >> 16) >> 5); /* G */
+    destPtr[2] = rfx_clamp((short)((Y + Cr * 91915) >> 16) >> 5); /* R */
+    destPtr[3] = 0xff; /* A */
+}
+
+__kernel void rfx_tiles_to_argb(__global const short *coefficients, __global uchar *dest)
+{
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    int tile = y / 64;
+    int offset = (y % 64) * 64 + x;
+    __global const short *src = coefficients + tile * 3 * 4096;
+    long Y = (int)((uint)(src[offset] + 4096) << 16);
+    long Cb = src[4096 + offset];
+    long Cr = src[8192 + offset];
+    __global uchar *destPtr = dest + (tile * 4096 + offset) * 4;
+
+    destPtr[0] = 0xff; /* A */
+    destPtr[1] = rfx_clamp((Y + Cr * 91915) >> 21); /* R */
+    destPtr[2] = rfx_clamp((Y - Cb * 22526 - Cr * 46818) >> 21); /* G */
+    destPtr[3] = rfx_clamp((Y + Cb * 115992) >> 21); /* B */
+}
 )
@@ -159,6 +159,93 @@ static BOOL test_alphaComp_func(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+#define WIDE_WIDTH 67
+#define WIDE_HEIGHT 3
+
+/* wide enough for the vector loops and their scalar tails */
+static BOOL test_alphaComp_wide(void)
+{
+	UINT32 src1[WIDE_WIDTH * WIDE_HEIGHT];
+	UINT32 src2[WIDE_WIDTH * WIDE_HEIGHT];
+	UINT32 dst[WIDE_WIDTH * WIDE_HEIGHT];
+	const UINT32 step = WIDE_WIDTH * 4;
+	size_t i;
+
+	winpr_RAND((BYTE*)src1, sizeof(src1));
+	winpr_RAND((BYTE*)src2, sizeof(src2));
+
+	for (i = 0; i < ARRAYSIZE(src2); i++)
+		src2[i] |= 0xFF000000U;
+
+	if (optimized->alphaComp_argb((const BYTE*)src1, step, (const BYTE*)src2, step, (BYTE*)dst,
+	                              step, WIDE_WIDTH, WIDE_HEIGHT) != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	return check((const BYTE*)src1, step, (const BYTE*)src2, step, (BYTE*)dst, step, WIDE_WIDTH,
+	             WIDE_HEIGHT);
+}
+
+#define PREMUL_WIDTH 259
+
+static BOOL check_premultiplied(const char* name, __alphaComp_argb_t fkt)
+{
+	UINT32 src1[PREMUL_WIDTH];
+	UINT32 src2[PREMUL_WIDTH];
+	UINT32 dst[PREMUL_WIDTH];
+	UINT32 a, x;
+
+	for (a = 0; a < 256; a++)
+	{
+		for (x = 0; x < PREMUL_WIDTH; x++)
+		{
+			const UINT32 v = x & 0xFF;
+			/* premultiplied colors are not larger than alpha, but may come close */
+			src1[x] = (a << 24) | ((v * a / 255) << 16) | ((a - (v * a / 255)) << 8) | (a / 2);
+			src2[x] = (((v * 7) & 0xFF) << 24) | (v << 16) | ((255 - v) << 8) | (v ^ 0x55);
+		}
+
+		if (fkt((const BYTE*)src1, sizeof(src1), (const BYTE*)src2, sizeof(src2), (BYTE*)dst,
+		        sizeof(dst), PREMUL_WIDTH, 1) != PRIMITIVES_SUCCESS)
+			return FALSE;
+
+		for (x = 0; x < PREMUL_WIDTH; x++)
+		{
+			UINT32 expected = 0;
+			UINT32 shift;
+
+			for (shift = 0; shift < 32; shift += 8)
+			{
+				const UINT32 c1 = (src1[x] >> shift) & 0xFF;
+				const UINT32 c2 = (src2[x] >> shift) & 0xFF;
+				const UINT32 c = c1 + (c2 * (255 - a) + 127) / 255;
+				expected |= MIN(c, 255) << shift;
+			}
+
+			if (dst[x] != expected)
+			{
+				printf("alphaCompPremultiplied-%s: 0x%08" PRIx32 "+0x%08" PRIx32
+				       "=0x%08" PRIx32 ", got 0x%08" PRIx32 "\n",
+				       name, src1[x], src2[x], expected, dst[x]);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_alphaCompPremultiplied_func(void)
+{
+	if (!check_premultiplied("generic", generic->alphaCompPremultiplied_argb))
+		return FALSE;
+
+	if (!check_premultiplied("optimized", optimized->alphaCompPremultiplied_argb))
+		return FALSE;
+
+	return TRUE;
+}
+
 static int test_alphaComp_speed(void)
 {
 	BYTE ALIGN(src1[SRC1_WIDTH * SRC1_HEIGHT]) = { 0 };
@@ -199,6 +286,12 @@ int TestPrimitivesAlphaComp(int argc, char* argv[])
 	if (!test_alphaComp_func())
 		return -1;
 
+	if (!test_alphaComp_wide())
+		return -1;
+
+	if (!test_alphaCompPremultiplied_func())
+		return -1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_alphaComp_speed())
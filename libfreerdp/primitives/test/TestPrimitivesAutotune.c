@@ -0,0 +1,85 @@
+/* TestPrimitivesAutotune.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include "prim_test.h"
+
+/* The selection has to name a known implementation for every function of the table */
+static BOOL test_selection(void)
+{
+	static const char* functions[] = { "copy",
+		                               "zero",
+		                               "add_16s",
+		                               "alphaComp_argb",
+		                               "yCbCrToRGB_16s8u_P3AC4R",
+		                               "YUV420ToRGB_8u_P3AC4R",
+		                               "RGBToAVC444YUVv2",
+		                               "planarRleScan_8u" };
+	BOOL rc = FALSE;
+	size_t x;
+	char* selection = primitives_get_selection();
+	char* line;
+	char* context = NULL;
+
+	if (!selection)
+		return FALSE;
+
+	printf("%s", selection);
+
+	for (x = 0; x < ARRAYSIZE(functions); x++)
+	{
+		char name[64] = { 0 };
+
+		_snprintf(name, sizeof(name), "%s: ", functions[x]);
+		if (!strstr(selection, name))
+		{
+			printf("selection misses %s\n", functions[x]);
+			goto fail;
+		}
+	}
+
+	line = strtok_s(selection, "\n", &context);
+	while (line)
+	{
+		/* the tile batches are only implemented by the GPU primitives */
+		const BOOL gpuOnly = (strcmp(line, "RFXDecodeTiles_16s8u: none") == 0);
+
+		if (!gpuOnly && !strstr(line, ": generic") && !strstr(line, ": optimized") &&
+		    !strstr(line, ": opencl"))
+		{
+			printf("unexpected selection %s\n", line);
+			goto fail;
+		}
+
+		line = strtok_s(NULL, "\n", &context);
+	}
+
+	rc = TRUE;
+fail:
+	free(selection);
+	return rc;
+}
+
+int TestPrimitivesAutotune(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	prim_test_setup(FALSE);
+
+	if (!test_selection())
+		return 1;
+
+	return 0;
+}
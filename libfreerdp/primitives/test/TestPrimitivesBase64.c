@@ -0,0 +1,197 @@
+/* test_base64.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+#define TEST_MAX_LENGTH 300
+#define TEST_ENCODED_LENGTH ((TEST_MAX_LENGTH + 2) / 3 * 4)
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_base64Encode_func(void)
+{
+	UINT32 length;
+	BYTE src[TEST_MAX_LENGTH + 16];
+	char dst1[TEST_ENCODED_LENGTH + 1];
+	char dst2[TEST_ENCODED_LENGTH + 1];
+
+	winpr_RAND(src, sizeof(src));
+
+	/* every length hits another split between the vector loops and the generic tail */
+	for (length = 0; length <= TEST_MAX_LENGTH; length++)
+	{
+		const UINT32 encoded = (length + 2) / 3 * 4;
+
+		memset(dst1, 0, sizeof(dst1));
+		memset(dst2, 0, sizeof(dst2));
+
+		if (generic->base64Encode(src, length, dst1) != PRIMITIVES_SUCCESS)
+			return FALSE;
+
+		if (optimized->base64Encode(src, length, dst2) != PRIMITIVES_SUCCESS)
+			return FALSE;
+
+		if ((memcmp(dst1, dst2, sizeof(dst1)) != 0) || (strlen(dst2) != encoded))
+		{
+			printf("base64Encode mismatch for length %" PRIu32 "\n", length);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_base64Decode_func(void)
+{
+	UINT32 length, pos, c;
+	BYTE src[TEST_MAX_LENGTH];
+	char encoded[TEST_ENCODED_LENGTH];
+	BYTE dst1[TEST_MAX_LENGTH + 16];
+	BYTE dst2[TEST_MAX_LENGTH + 16];
+
+	winpr_RAND(src, sizeof(src));
+
+	for (length = 1; length <= TEST_MAX_LENGTH; length++)
+	{
+		UINT32 len1 = 0;
+		UINT32 len2 = 0;
+		const UINT32 encodedLength = (length + 2) / 3 * 4;
+
+		if (generic->base64Encode(src, length, encoded) != PRIMITIVES_SUCCESS)
+			return FALSE;
+
+		if ((generic->base64Decode(encoded, encodedLength, dst1, &len1) != PRIMITIVES_SUCCESS) ||
+		    (optimized->base64Decode(encoded, encodedLength, dst2, &len2) != PRIMITIVES_SUCCESS))
+		{
+			printf("base64Decode failed for length %" PRIu32 "\n", length);
+			return FALSE;
+		}
+
+		if ((len1 != length) || (len2 != length) || (memcmp(src, dst1, length) != 0) ||
+		    (memcmp(src, dst2, length) != 0))
+		{
+			printf("base64Decode mismatch for length %" PRIu32 "\n", length);
+			return FALSE;
+		}
+	}
+
+	/* every character at every position of a vector block, both have to reject the same */
+	for (pos = 0; pos < 64; pos++)
+	{
+		const UINT32 encodedLength = 96;
+
+		if (generic->base64Encode(src, encodedLength / 4 * 3, encoded) != PRIMITIVES_SUCCESS)
+			return FALSE;
+
+		for (c = 0; c < 256; c++)
+		{
+			UINT32 len1 = 0;
+			UINT32 len2 = 0;
+			pstatus_t status1, status2;
+			const char saved = encoded[pos];
+
+			encoded[pos] = (char)c;
+			status1 = generic->base64Decode(encoded, encodedLength, dst1, &len1);
+			status2 = optimized->base64Decode(encoded, encodedLength, dst2, &len2);
+			encoded[pos] = saved;
+
+			if ((status1 != status2) ||
+			    ((status1 == PRIMITIVES_SUCCESS) &&
+			     ((len1 != len2) || (memcmp(dst1, dst2, len1) != 0))))
+			{
+				printf("base64Decode mismatch for 0x%02" PRIx32 " at %" PRIu32 "\n", c, pos);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_base64_padding(void)
+{
+	size_t x;
+	const struct
+	{
+		const char* input;
+		pstatus_t status;
+	} tests[] = { { "QQ==", PRIMITIVES_SUCCESS }, { "QUI=", PRIMITIVES_SUCCESS },
+		          { "Q===", -1 },                 { "QQ=A", -1 },
+		          { "QQ=", -1 },                  { "=QQQ", -1 },
+		          { "QUI=QUJD", -1 },             { "QUJD", PRIMITIVES_SUCCESS } };
+
+	for (x = 0; x < ARRAYSIZE(tests); x++)
+	{
+		BYTE dst[16];
+		UINT32 len = 0;
+		const UINT32 length = (UINT32)strlen(tests[x].input);
+
+		if ((generic->base64Decode(tests[x].input, length, dst, &len) != tests[x].status) ||
+		    (optimized->base64Decode(tests[x].input, length, dst, &len) != tests[x].status))
+		{
+			printf("base64Decode wrong result for %s\n", tests[x].input);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_base64_speed(void)
+{
+	UINT32 len = 0;
+	BYTE ALIGN(src[MAX_TEST_SIZE * 3]) = { 0 };
+	char ALIGN(encoded[MAX_TEST_SIZE * 4]) = { 0 };
+	BYTE ALIGN(dst[MAX_TEST_SIZE * 3]) = { 0 };
+	winpr_RAND(src, sizeof(src));
+
+	if (!speed_test("base64Encode", "random", g_Iterations,
+	                (speed_test_fkt)generic->base64Encode, (speed_test_fkt)optimized->base64Encode,
+	                src, sizeof(src), encoded))
+		return FALSE;
+
+	if (!speed_test("base64Decode", "random", g_Iterations,
+	                (speed_test_fkt)generic->base64Decode, (speed_test_fkt)optimized->base64Decode,
+	                encoded, sizeof(encoded), dst, &len))
+		return FALSE;
+
+	return TRUE;
+}
+
+int TestPrimitivesBase64(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	prim_test_setup(FALSE);
+
+	if (!test_base64Encode_func())
+		return 1;
+
+	if (!test_base64Decode_func())
+		return 1;
+
+	if (!test_base64_padding())
+		return 1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		if (!test_base64_speed())
+			return 1;
+	}
+
+	return 0;
+}
@@ -255,6 +255,59 @@ static int test_yCbCrToRGB_16s16s_P3P3_speed(void)
 	return TRUE;
 }
 
+/* ========================================================================= */
+static BOOL test_RGB565ToARGB_16u32u_C3C4_func(prim_size_t roi, DWORD DstFormat)
+{
+	BOOL rc = FALSE;
+	UINT32 x, y;
+	/* an odd width covers the scalar tail of the vector loops */
+	const UINT32 width = roi.width + 5;
+	const INT32 srcStride = (INT32)(width * sizeof(UINT16));
+	const INT32 dstStride = (INT32)(width * sizeof(UINT32));
+	UINT16* src = calloc(1ull * width * roi.height, sizeof(UINT16));
+	UINT32* out1 = calloc(1ull * width * roi.height, sizeof(UINT32));
+	UINT32* out2 = calloc(1ull * width * roi.height, sizeof(UINT32));
+
+	if (!src || !out1 || !out2)
+		goto fail;
+
+	winpr_RAND((BYTE*)src, 1ull * width * roi.height * sizeof(UINT16));
+
+	if (generic->RGB565ToARGB_16u32u_C3C4(src, srcStride, out1, dstStride, width, roi.height,
+	                                      DstFormat) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (optimized->RGB565ToARGB_16u32u_C3C4(src, srcStride, out2, dstStride, width, roi.height,
+	                                        DstFormat) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	for (y = 0; y < roi.height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			const size_t i = 1ull * y * width + x;
+			const UINT32 expect =
+			    FreeRDPConvertColor(src[i], PIXEL_FORMAT_RGB16, DstFormat, NULL);
+
+			if ((ReadColor((const BYTE*)&out1[i], DstFormat) != expect) || (out1[i] != out2[i]))
+			{
+				printf("RGB565ToARGB_16u32u_C3C4 %s FAIL[%" PRIu32 "x%" PRIu32 "]: 0x%08" PRIx32
+				       " -> 0x%08" PRIx32 " vs 0x%08" PRIx32 "\n",
+				       FreeRDPGetColorFormatName(DstFormat), x, y, (UINT32)src[i], out1[i],
+				       out2[i]);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(out1);
+	free(out2);
+	return rc;
+}
+
 int TestPrimitivesColors(int argc, char* argv[])
 {
 	const DWORD formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
@@ -271,6 +324,9 @@ int TestPrimitivesColors(int argc, char* argv[])
 		if (!test_RGBToRGB_16s8u_P3AC4R_func(roi, formats[x]))
 			return 1;
 
+		if (!test_RGB565ToARGB_16u32u_C3C4_func(roi, formats[x]))
+			return 1;
+
 #if 0
 
 		if (g_TestPrimitivesPerformance)
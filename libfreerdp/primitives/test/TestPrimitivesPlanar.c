@@ -0,0 +1,236 @@
+/* test_planar.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+#define TEST_WIDTH 67
+#define TEST_HEIGHT 19
+
+static const UINT32 test_formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32,
+	                                   PIXEL_FORMAT_ABGR32, PIXEL_FORMAT_XBGR32,
+	                                   PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32,
+	                                   PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32,
+	                                   PIXEL_FORMAT_RGB24 };
+
+/* Random bytes with runs of different lengths, the RLE scan has to find all of them */
+static void fill_runs(BYTE* data, size_t size)
+{
+	size_t i;
+	BYTE rnd[2];
+
+	winpr_RAND(data, size);
+
+	for (i = 0; i < size;)
+	{
+		size_t run;
+		winpr_RAND(rnd, sizeof(rnd));
+		run = MIN(rnd[0] % 40, size - i);
+
+		if (rnd[1] & 1)
+			memset(&data[i], (rnd[1] & 2) ? 0 : data[i], run);
+
+		i += run + 1;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_RGBToPlanar_func(void)
+{
+	size_t i, p;
+	BOOL rc = FALSE;
+	const size_t size = TEST_WIDTH * TEST_HEIGHT;
+	const INT32 step = TEST_WIDTH * 4 + 12;
+	BYTE* src = calloc(TEST_HEIGHT, (size_t)step);
+	BYTE* planes1 = calloc(4, size);
+	BYTE* planes2 = calloc(4, size);
+
+	if (!src || !planes1 || !planes2)
+		goto fail;
+
+	winpr_RAND(src, (size_t)step * TEST_HEIGHT);
+
+	for (i = 0; i < ARRAYSIZE(test_formats); i++)
+	{
+		BYTE* dst1[4] = { planes1, planes1 + size, planes1 + 2 * size, planes1 + 3 * size };
+		BYTE* dst2[4] = { planes2, planes2 + size, planes2 + 2 * size, planes2 + 3 * size };
+
+		/* top down and bottom up */
+		for (p = 0; p < 2; p++)
+		{
+			const BYTE* start = (p == 0) ? src : &src[(size_t)step * (TEST_HEIGHT - 1)];
+			const INT32 srcStep = (p == 0) ? step : -step;
+			pstatus_t status;
+
+			memset(planes1, 0, 4 * size);
+			memset(planes2, 0xCD, 4 * size);
+			status = generic->RGBToPlanar_8u_C4P4(start, test_formats[i], srcStep, dst1,
+			                                      TEST_WIDTH, TEST_HEIGHT);
+			if (status != PRIMITIVES_SUCCESS)
+				goto fail;
+
+			status = optimized->RGBToPlanar_8u_C4P4(start, test_formats[i], srcStep, dst2,
+			                                        TEST_WIDTH, TEST_HEIGHT);
+			if (status != PRIMITIVES_SUCCESS)
+				goto fail;
+
+			if (memcmp(planes1, planes2, 4 * size) != 0)
+			{
+				printf("RGBToPlanar_8u_C4P4 mismatch for %s\n",
+				       FreeRDPGetColorFormatName(test_formats[i]));
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(planes1);
+	free(planes2);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_planarDeltaEncode_func(void)
+{
+	UINT32 width;
+	BOOL rc = FALSE;
+	BYTE* src = calloc(TEST_HEIGHT, 256);
+	BYTE* dst1 = calloc(TEST_HEIGHT, 256);
+	BYTE* dst2 = calloc(TEST_HEIGHT, 256);
+
+	if (!src || !dst1 || !dst2)
+		goto fail;
+
+	for (width = 1; width <= 256; width += 13)
+	{
+		fill_runs(src, (size_t)width * TEST_HEIGHT);
+		memset(dst2, 0xCD, (size_t)width * TEST_HEIGHT);
+
+		if (generic->planarDeltaEncode_8u_P1(src, dst1, width, TEST_HEIGHT) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+
+		if (optimized->planarDeltaEncode_8u_P1(src, dst2, width, TEST_HEIGHT) !=
+		    PRIMITIVES_SUCCESS)
+			goto fail;
+
+		if (memcmp(dst1, dst2, (size_t)width * TEST_HEIGHT) != 0)
+		{
+			printf("planarDeltaEncode_8u_P1 mismatch for width %" PRIu32 "\n", width);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst1);
+	free(dst2);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_planarRleScan_func(void)
+{
+	UINT32 len, iteration;
+	BYTE line[300];
+
+	for (iteration = 0; iteration < 64; iteration++)
+	{
+		fill_runs(line, sizeof(line));
+
+		for (len = 1; len <= sizeof(line); len += (iteration % 7) + 1)
+		{
+			UINT32 start = 0;
+
+			/* walk all segments of the line, both implementations have to agree */
+			while (start < len)
+			{
+				UINT32 raw1, raw2, run1, run2;
+
+				if (generic->planarRleScan_8u(line, start, len, &raw1, &run1) !=
+				    PRIMITIVES_SUCCESS)
+					return FALSE;
+
+				if (optimized->planarRleScan_8u(line, start, len, &raw2, &run2) !=
+				    PRIMITIVES_SUCCESS)
+					return FALSE;
+
+				if ((raw1 != raw2) || (run1 != run2) || (raw1 + run1 == 0) ||
+				    ((run1 > 0) && (run1 < 3)))
+				{
+					printf("planarRleScan_8u mismatch at %" PRIu32 "/%" PRIu32 ": %" PRIu32
+					       "+%" PRIu32 " != %" PRIu32 "+%" PRIu32 "\n",
+					       start, len, raw1, run1, raw2, run2);
+					return FALSE;
+				}
+
+				start += raw1 + run1;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_planar_speed(void)
+{
+	BYTE ALIGN(src[MAX_TEST_SIZE * 4]) = { 0 };
+	BYTE ALIGN(dst[MAX_TEST_SIZE * 4]) = { 0 };
+	BYTE* planes[4] = { dst, dst + MAX_TEST_SIZE, dst + 2 * MAX_TEST_SIZE,
+		                dst + 3 * MAX_TEST_SIZE };
+	winpr_RAND(src, sizeof(src));
+
+	if (!speed_test("RGBToPlanar_8u_C4P4", "BGRX32", g_Iterations,
+	                (speed_test_fkt)generic->RGBToPlanar_8u_C4P4,
+	                (speed_test_fkt)optimized->RGBToPlanar_8u_C4P4, src, PIXEL_FORMAT_BGRX32,
+	                64 * 4, planes, 64, MAX_TEST_SIZE / 64))
+		return FALSE;
+
+	if (!speed_test("planarDeltaEncode_8u_P1", "64x64", g_Iterations,
+	                (speed_test_fkt)generic->planarDeltaEncode_8u_P1,
+	                (speed_test_fkt)optimized->planarDeltaEncode_8u_P1, src, dst, 64,
+	                MAX_TEST_SIZE / 64))
+		return FALSE;
+
+	return TRUE;
+}
+
+int TestPrimitivesPlanar(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	prim_test_setup(FALSE);
+
+	if (!test_RGBToPlanar_func())
+		return 1;
+
+	if (!test_planarDeltaEncode_func())
+		return 1;
+
+	if (!test_planarRleScan_func())
+		return 1;
+
+	if (g_TestPrimitivesPerformance)
+	{
+		if (!test_planar_speed())
+			return 1;
+	}
+
+	return 0;
+}
@@ -32,8 +32,9 @@ static BOOL test_YCoCgRToRGB_8u_AC4R_func(UINT32 width, UINT32 height)
 	UINT32 i, x;
 	const UINT32 srcStride = width * 4;
 	const UINT32 size = srcStride * height;
-	const UINT32 formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_ABGR32, PIXEL_FORMAT_RGBA32,
-		                       PIXEL_FORMAT_RGBX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32 };
+	const UINT32 formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
+		                       PIXEL_FORMAT_XBGR32, PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32,
+		                       PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32 };
 	PROFILER_DEFINE(genericProf)
 	PROFILER_DEFINE(optProf)
 	in = _aligned_recalloc(NULL, 1, size, 16);
@@ -48,13 +49,16 @@ static BOOL test_YCoCgRToRGB_8u_AC4R_func(UINT32 width, UINT32 height)
 	for (x = 0; x < sizeof(formats) / sizeof(formats[0]); x++)
 	{
 		const UINT32 format = formats[x];
+		/* cycle through the chroma shifts and the alpha handling with the formats */
+		const UINT8 shift = (UINT8)(1 + (x + width) % 7);
+		const BOOL withAlpha = (x & 1) == 0;
 		const UINT32 dstStride = width * GetBytesPerPixel(format);
 		const char* formatName = FreeRDPGetColorFormatName(format);
 		PROFILER_CREATE(genericProf, "YCoCgRToRGB_8u_AC4R-GENERIC")
 		PROFILER_CREATE(optProf, "YCoCgRToRGB_8u_AC4R-OPT")
 		PROFILER_ENTER(genericProf)
 		status = generic->YCoCgToRGB_8u_AC4R(in, srcStride, out_c, format, dstStride, width, height,
-		                                     2, TRUE);
+		                                     shift, withAlpha);
 		PROFILER_EXIT(genericProf)
 
 		if (status != PRIMITIVES_SUCCESS)
@@ -62,7 +66,7 @@ static BOOL test_YCoCgRToRGB_8u_AC4R_func(UINT32 width, UINT32 height)
 
 		PROFILER_ENTER(optProf)
 		status = optimized->YCoCgToRGB_8u_AC4R(in, srcStride, out_sse, format, dstStride, width,
-		                                       height, 2, TRUE);
+		                                       height, shift, withAlpha);
 		PROFILER_EXIT(optProf)
 
 		if (status != PRIMITIVES_SUCCESS)
@@ -854,6 +854,134 @@ fail:
 	return res;
 }
 
+/* The optimized YUV -> RGB and YUV420 combine conversions have to match the generic ones
+ * exactly. The widths cover the vector loops (32 and 16 pixels) and the scalar tails. */
+static BOOL TestPrimitiveYUVOptimized(primitives_t* prims)
+{
+	const UINT32 widths[] = { 1, 2, 14, 16, 18, 30, 32, 34, 48, 64, 66, 96, 100, 130 };
+	const UINT32 heights[] = { 1, 2, 6, 8, 18 };
+	const avc444_frame_type types[] = { AVC444_LUMA, AVC444_CHROMAv1, AVC444_CHROMAv2 };
+	const UINT32 maxWidth = 160;
+	const UINT32 maxHeight = 64;
+	const size_t planeSize = (size_t)maxWidth * maxHeight;
+	const UINT32 dstStep = maxWidth * 4;
+	BOOL rc = FALSE;
+	size_t i, j, k, t;
+	BYTE* yuv[3] = { 0 };
+	BYTE* yuv1[3] = { 0 };
+	BYTE* yuv2[3] = { 0 };
+	BYTE* rgb1 = calloc(maxHeight, dstStep);
+	BYTE* rgb2 = calloc(maxHeight, dstStep);
+
+	if (!rgb1 || !rgb2)
+		goto fail;
+
+	for (i = 0; i < 3; i++)
+	{
+		yuv[i] = calloc(1, planeSize);
+		yuv1[i] = calloc(1, planeSize);
+		yuv2[i] = calloc(1, planeSize);
+
+		if (!yuv[i] || !yuv1[i] || !yuv2[i])
+			goto fail;
+
+		winpr_RAND(yuv[i], planeSize);
+	}
+
+	for (i = 0; i < ARRAYSIZE(widths); i++)
+	{
+		for (j = 0; j < ARRAYSIZE(heights); j++)
+		{
+			const prim_size_t roi = { widths[i], heights[j] };
+			const RECTANGLE_16 rect = { 0, 0, (UINT16)widths[i], (UINT16)heights[j] };
+			const UINT32 step420[3] = { maxWidth, maxWidth / 2, maxWidth / 2 };
+			const UINT32 step444[3] = { maxWidth, maxWidth, maxWidth };
+
+			for (k = 0; k < 2; k++)
+			{
+				const UINT32* steps = (k == 0) ? step420 : step444;
+				pstatus_t status1, status2;
+
+				/* random alpha bytes, they have to survive the conversion */
+				winpr_RAND(rgb1, (size_t)maxHeight * dstStep);
+				memcpy(rgb2, rgb1, (size_t)maxHeight * dstStep);
+
+				if (k == 0)
+				{
+					status1 = generic->YUV420ToRGB_8u_P3AC4R((const BYTE**)yuv, steps, rgb1,
+					                                         dstStep, PIXEL_FORMAT_BGRX32, &roi);
+					status2 = prims->YUV420ToRGB_8u_P3AC4R((const BYTE**)yuv, steps, rgb2,
+					                                       dstStep, PIXEL_FORMAT_BGRX32, &roi);
+				}
+				else
+				{
+					status1 = generic->YUV444ToRGB_8u_P3AC4R((const BYTE**)yuv, steps, rgb1,
+					                                         dstStep, PIXEL_FORMAT_BGRX32, &roi);
+					status2 = prims->YUV444ToRGB_8u_P3AC4R((const BYTE**)yuv, steps, rgb2,
+					                                       dstStep, PIXEL_FORMAT_BGRX32, &roi);
+				}
+
+				if ((status1 != PRIMITIVES_SUCCESS) || (status2 != PRIMITIVES_SUCCESS))
+					goto fail;
+
+				if (memcmp(rgb1, rgb2, (size_t)maxHeight * dstStep) != 0)
+				{
+					printf("YUV%sToRGB mismatch for %" PRIu32 "x%" PRIu32 "\n",
+					       (k == 0) ? "420" : "444", roi.width, roi.height);
+					goto fail;
+				}
+			}
+
+			/* the SSSE3 CHROMAv1 conversion expects even sizes like the codec uses */
+			if ((roi.width % 2) || (roi.height % 2))
+				continue;
+
+			for (t = 0; t < ARRAYSIZE(types); t++)
+			{
+				for (k = 0; k < 3; k++)
+				{
+					winpr_RAND(yuv1[k], planeSize);
+					memcpy(yuv2[k], yuv1[k], planeSize);
+				}
+
+				if (generic->YUV420CombineToYUV444(types[t], (const BYTE**)yuv, step444,
+				                                   roi.width, roi.height, yuv1, step444,
+				                                   &rect) != PRIMITIVES_SUCCESS)
+					goto fail;
+
+				if (prims->YUV420CombineToYUV444(types[t], (const BYTE**)yuv, step444, roi.width,
+				                                 roi.height, yuv2, step444,
+				                                 &rect) != PRIMITIVES_SUCCESS)
+					goto fail;
+
+				for (k = 0; k < 3; k++)
+				{
+					if (memcmp(yuv1[k], yuv2[k], planeSize) != 0)
+					{
+						printf("YUV420CombineToYUV444 type %d mismatch in plane %" PRIuz
+						       " for %" PRIu32 "x%" PRIu32 "\n",
+						       types[t], k, roi.width, roi.height);
+						goto fail;
+					}
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	for (i = 0; i < 3; i++)
+	{
+		free(yuv[i]);
+		free(yuv1[i]);
+		free(yuv2[i]);
+	}
+
+	free(rgb1);
+	free(rgb2);
+	return rc;
+}
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -861,9 +989,20 @@ int TestPrimitivesYUV(int argc, char* argv[])
 	int rc = -1;
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
+	primitives_t cpu = { 0 };
 	prim_test_setup(FALSE);
 	primitives_t* prims = primitives_get();
 
+	/* the autodetection may pick the generic primitives, test the CPU optimized ones */
+	if (primitives_init(&cpu, PRIMITIVES_ONLY_CPU))
+		prims = &cpu;
+
+	if (!TestPrimitiveYUVOptimized(prims))
+	{
+		printf("TestPrimitiveYUVOptimized failed.\n");
+		goto end;
+	}
+
 	for (x = 0; x < 5; x++)
 	{
 		prim_size_t roi;
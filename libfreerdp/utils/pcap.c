@@ -26,9 +26,12 @@
 #include <winpr/wtypes.h>
 #include <winpr/file.h>
 #include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/stream.h>
 #include <freerdp/log.h>
 
-#define TAG FREERDP_TAG("utils")
+#define TAG FREERDP_TAG("utils.pcap")
 
 #ifndef _WIN32
 #include <sys/time.h>
@@ -51,6 +54,37 @@ int gettimeofday(struct timeval* tp, void* tz)
 #include <freerdp/utils/pcap.h>
 
 #define PCAP_MAGIC 0xA1B2C3D4
+#define PCAP_DEFAULT_BUFFER_SIZE (8ull * 1024ull * 1024ull)
+
+/**
+ * Writing is done by a background thread so that capturing does not add file I/O to the thread
+ * producing the records. Records are copied into a bounded pending buffer, the writer swaps it
+ * with its own buffer and writes that one. Records that do not fit into the pending buffer are
+ * dropped and counted instead of blocking the producer or growing the memory use.
+ */
+struct rdp_pcap
+{
+	FILE* fp;
+	char* name;
+	BOOL write;
+	INT64 file_size;
+	int record_count;
+	pcap_header header;
+
+	CRITICAL_SECTION lock;      /* protects pending, dropped and failed */
+	CRITICAL_SECTION writeLock; /* protects writing, fp and the rotation state */
+	BOOL locksInitialized;
+	wStream* pending;
+	wStream* writing;
+	HANDLE thread;
+	HANDLE event;
+	BOOL stop;
+	BOOL failed;
+	size_t dropped;
+	UINT64 rotateSize;
+	UINT64 written;
+	UINT32 rotation;
+};
 
 static BOOL pcap_read_header(rdpPcap* pcap, pcap_header* header)
 {
@@ -67,11 +101,6 @@ static BOOL pcap_read_record_header(rdpPcap* pcap, pcap_record_header* record)
 	return fread((void*)record, sizeof(pcap_record_header), 1, pcap->fp) == 1;
 }
 
-static BOOL pcap_write_record_header(rdpPcap* pcap, pcap_record_header* record)
-{
-	return fwrite((void*)record, sizeof(pcap_record_header), 1, pcap->fp) == 1;
-}
-
 static BOOL pcap_read_record(rdpPcap* pcap, pcap_record* record)
 {
 	if (!pcap_read_record_header(pcap, &record->header))
@@ -91,49 +120,179 @@ static BOOL pcap_read_record(rdpPcap* pcap, pcap_record* record)
 	return TRUE;
 }
 
-static BOOL pcap_write_record(rdpPcap* pcap, pcap_record* record)
+/* the first file keeps the name, the following ones get the rotation number appended */
+static BOOL pcap_rotate(rdpPcap* pcap)
 {
-	return pcap_write_record_header(pcap, &record->header) &&
-	       (fwrite(record->cdata, record->length, 1, pcap->fp) == 1);
+	char* name;
+	size_t size;
+
+	size = strlen(pcap->name) + 12;
+	name = (char*)calloc(size, sizeof(char));
+
+	if (!name)
+		return FALSE;
+
+	sprintf_s(name, size, "%s.%" PRIu32, pcap->name, pcap->rotation + 1);
+
+	if (fclose(pcap->fp) != 0)
+		WLog_WARN(TAG, "failed to close %s", pcap->name);
+
+	pcap->fp = winpr_fopen(name, "w+b");
+
+	if (!pcap->fp)
+	{
+		WLog_ERR(TAG, "failed to open %s", name);
+		free(name);
+		return FALSE;
+	}
+
+	free(name);
+	pcap->rotation++;
+	pcap->written = sizeof(pcap_header);
+	return pcap_write_header(pcap, &pcap->header);
 }
 
-BOOL pcap_add_record(rdpPcap* pcap, const void* data, UINT32 length)
+static BOOL pcap_write_buffer(rdpPcap* pcap, wStream* s)
 {
-	pcap_record* record;
-	struct timeval tp;
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
 
-	if (pcap->tail == NULL)
+	if (pcap->rotateSize == 0)
 	{
-		pcap->tail = (pcap_record*)calloc(1, sizeof(pcap_record));
-		if (!pcap->tail)
+		const size_t length = Stream_Length(s);
+
+		if ((length > 0) && (fwrite(Stream_Buffer(s), length, 1, pcap->fp) != 1))
 			return FALSE;
 
-		pcap->head = pcap->tail;
-		pcap->record = pcap->head;
-		record = pcap->tail;
+		pcap->written += length;
+		return TRUE;
 	}
-	else
+
+	/* rotate between two records, a file only exceeds the limit for a single large record */
+	while (Stream_GetRemainingLength(s) > 0)
 	{
-		record = (pcap_record*)calloc(1, sizeof(pcap_record));
-		if (!record)
+		pcap_record_header header;
+		size_t length;
+
+		Stream_Read(s, &header, sizeof(header));
+		length = sizeof(header) + header.incl_len;
+
+		if ((pcap->written > sizeof(pcap_header)) && (pcap->written + length > pcap->rotateSize))
+		{
+			if (!pcap_rotate(pcap))
+				return FALSE;
+		}
+
+		if (fwrite(Stream_Pointer(s) - sizeof(header), length, 1, pcap->fp) != 1)
 			return FALSE;
 
-		pcap->tail->next = record;
-		pcap->tail = record;
+		Stream_Seek(s, header.incl_len);
+		pcap->written += length;
+	}
+
+	return TRUE;
+}
+
+/* swaps the pending records out and writes them, the caller holds writeLock */
+static BOOL pcap_write_pending(rdpPcap* pcap)
+{
+	BOOL rc;
+	wStream* s;
+
+	EnterCriticalSection(&pcap->lock);
+	s = pcap->pending;
+	pcap->pending = pcap->writing;
+	pcap->writing = s;
+
+	/* the queue is empty now, the next record sets the event again */
+	if (pcap->event && !pcap->stop)
+		ResetEvent(pcap->event);
+
+	LeaveCriticalSection(&pcap->lock);
+
+	if (Stream_GetPosition(s) == 0)
+		return TRUE;
+
+	rc = pcap_write_buffer(pcap, s);
+	Stream_SetPosition(s, 0);
+
+	if (!rc)
+	{
+		WLog_ERR(TAG, "failed to write to %s, stopping the capture", pcap->name);
+		EnterCriticalSection(&pcap->lock);
+		pcap->failed = TRUE;
+		LeaveCriticalSection(&pcap->lock);
+	}
+
+	return rc;
+}
+
+static DWORD WINAPI pcap_writer_thread(LPVOID arg)
+{
+	rdpPcap* pcap = (rdpPcap*)arg;
+	BOOL stop = FALSE;
+
+	while (!stop)
+	{
+		if (WaitForSingleObject(pcap->event, INFINITE) != WAIT_OBJECT_0)
+		{
+			WLog_ERR(TAG, "failed to wait for pcap records");
+			break;
+		}
+
+		EnterCriticalSection(&pcap->lock);
+		stop = pcap->stop;
+		LeaveCriticalSection(&pcap->lock);
+
+		EnterCriticalSection(&pcap->writeLock);
+		pcap_write_pending(pcap);
+		LeaveCriticalSection(&pcap->writeLock);
 	}
 
-	if (pcap->record == NULL)
-		pcap->record = record;
+	return 0;
+}
+
+BOOL pcap_add_record(rdpPcap* pcap, const void* data, UINT32 length)
+{
+	BOOL rc = FALSE;
+	BOOL wasEmpty;
+	struct timeval tp;
+	pcap_record_header header;
 
-	record->cdata = data;
-	record->length = length;
-	record->header.incl_len = length;
-	record->header.orig_len = length;
+	if (!pcap || !pcap->write || (!data && (length > 0)))
+		return FALSE;
 
 	gettimeofday(&tp, 0);
-	record->header.ts_sec = tp.tv_sec;
-	record->header.ts_usec = tp.tv_usec;
-	return TRUE;
+	header.ts_sec = tp.tv_sec;
+	header.ts_usec = tp.tv_usec;
+	header.incl_len = length;
+	header.orig_len = length;
+
+	EnterCriticalSection(&pcap->lock);
+
+	if (pcap->failed)
+		goto out;
+
+	if (Stream_GetRemainingCapacity(pcap->pending) < sizeof(header) + length)
+	{
+		if (pcap->dropped++ == 0)
+			WLog_WARN(TAG, "pcap buffer of %s is full, dropping records", pcap->name);
+
+		goto out;
+	}
+
+	wasEmpty = Stream_GetPosition(pcap->pending) == 0;
+	Stream_Write(pcap->pending, &header, sizeof(header));
+	Stream_Write(pcap->pending, data, length);
+	pcap->record_count++;
+
+	if (wasEmpty)
+		SetEvent(pcap->event);
+
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&pcap->lock);
+	return rc;
 }
 
 BOOL pcap_has_next_record(rdpPcap* pcap)
@@ -166,6 +325,11 @@ BOOL pcap_get_next_record(rdpPcap* pcap, pcap_record* record)
 }
 
 rdpPcap* pcap_open(const char* name, BOOL write)
+{
+	return pcap_open_ex(name, write, 0, 0);
+}
+
+rdpPcap* pcap_open_ex(const char* name, BOOL write, size_t bufferSize, UINT64 rotateSize)
 {
 	rdpPcap* pcap;
 
@@ -183,7 +347,10 @@ rdpPcap* pcap_open(const char* name, BOOL write)
 
 	if (write)
 	{
-		pcap->header.magic_number = 0xA1B2C3D4;
+		if (bufferSize == 0)
+			bufferSize = PCAP_DEFAULT_BUFFER_SIZE;
+
+		pcap->header.magic_number = PCAP_MAGIC;
 		pcap->header.version_major = 2;
 		pcap->header.version_minor = 4;
 		pcap->header.thiszone = 0;
@@ -192,6 +359,31 @@ rdpPcap* pcap_open(const char* name, BOOL write)
 		pcap->header.network = 0;
 		if (!pcap_write_header(pcap, &pcap->header))
 			goto fail;
+
+		pcap->written = sizeof(pcap_header);
+		pcap->rotateSize = rotateSize;
+
+		if (!InitializeCriticalSectionAndSpinCount(&pcap->lock, 4000))
+			goto fail;
+
+		if (!InitializeCriticalSectionAndSpinCount(&pcap->writeLock, 4000))
+		{
+			DeleteCriticalSection(&pcap->lock);
+			goto fail;
+		}
+
+		pcap->locksInitialized = TRUE;
+		pcap->pending = Stream_New(NULL, bufferSize);
+		pcap->writing = Stream_New(NULL, bufferSize);
+
+		if (!pcap->pending || !pcap->writing)
+			goto fail;
+
+		if (!(pcap->event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+			goto fail;
+
+		if (!(pcap->thread = CreateThread(NULL, 0, pcap_writer_thread, pcap, 0, NULL)))
+			goto fail;
 	}
 	else
 	{
@@ -211,14 +403,16 @@ fail:
 
 void pcap_flush(rdpPcap* pcap)
 {
-	while (pcap->record != NULL)
-	{
-		pcap_write_record(pcap, pcap->record);
-		pcap->record = pcap->record->next;
-	}
+	if (!pcap || !pcap->write || !pcap->locksInitialized)
+		return;
+
+	EnterCriticalSection(&pcap->writeLock);
+	pcap_write_pending(pcap);
 
 	if (pcap->fp != NULL)
 		fflush(pcap->fp);
+
+	LeaveCriticalSection(&pcap->writeLock);
 }
 
 void pcap_close(rdpPcap* pcap)
@@ -226,11 +420,35 @@ void pcap_close(rdpPcap* pcap)
 	if (!pcap)
 		return;
 
+	if (pcap->thread)
+	{
+		EnterCriticalSection(&pcap->lock);
+		pcap->stop = TRUE;
+		LeaveCriticalSection(&pcap->lock);
+		SetEvent(pcap->event);
+		WaitForSingleObject(pcap->thread, INFINITE);
+		CloseHandle(pcap->thread);
+	}
+
 	pcap_flush(pcap);
 
+	if (pcap->dropped > 0)
+		WLog_WARN(TAG, "%" PRIuz " records were dropped from %s", pcap->dropped, pcap->name);
+
 	if (pcap->fp != NULL)
 		fclose(pcap->fp);
 
+	if (pcap->event)
+		CloseHandle(pcap->event);
+
+	if (pcap->locksInitialized)
+	{
+		DeleteCriticalSection(&pcap->lock);
+		DeleteCriticalSection(&pcap->writeLock);
+	}
+
+	Stream_Free(pcap->pending, TRUE);
+	Stream_Free(pcap->writing, TRUE);
 	free(pcap->name);
 	free(pcap);
 }
@@ -30,6 +30,8 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/stream.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <winpr/smartcard.h>
 
 #include <freerdp/freerdp.h>
@@ -54,11 +56,29 @@
 
 #define SCARD_MAX_TIMEOUT 60000
 
+/* milliseconds cached answers are used if no reader event was seen */
+#define SCARD_CACHE_TTL 2000
+/* the cache is dropped all at once when there are more entries */
+#define SCARD_CACHE_MAX_ENTRIES 64
+
+typedef struct
+{
+	UINT64 time;
+	DWORD size;
+	BYTE* data;
+} scard_cache_entry;
+
 struct s_scard_call_context
 {
 	HANDLE StartedEvent;
 	wLinkedList* names;
 	wHashTable* rgSCardContextList;
+
+	/* reader lists and card attributes, cleared on reader events, guarded by cacheLock */
+	CRITICAL_SECTION cacheLock;
+	wHashTable* cache;
+	/* the last event state of every reader seen by SCardGetStatusChange */
+	wHashTable* readerStates;
 #if defined(WITH_SMARTCARD_EMULATE)
 	SmartcardEmulationContext* emulation;
 #endif
@@ -75,6 +95,230 @@ struct s_scard_context_element
 	void (*fn_free)(void*);
 };
 
+static void scard_cache_entry_free(void* obj)
+{
+	scard_cache_entry* entry = (scard_cache_entry*)obj;
+
+	if (!entry)
+		return;
+
+	free(entry->data);
+	free(entry);
+}
+
+static char* scard_cache_key(const char* name, const BYTE* data, size_t length, UINT64 value)
+{
+	char* key;
+	char* hex = NULL;
+	size_t size;
+
+	if (data && (length > 0))
+	{
+		hex = winpr_BinToHexString(data, length, FALSE);
+
+		if (!hex)
+			return NULL;
+	}
+
+	size = strlen(name) + (hex ? strlen(hex) : 0) + 20;
+	key = malloc(size);
+
+	if (key)
+		sprintf_s(key, size, "%s:%s:%" PRIx64, name, hex ? hex : "", value);
+
+	free(hex);
+	return key;
+}
+
+/**
+ * @brief scard_cache_get Looks up an answer cached less than SCARD_CACHE_TTL ago
+ * @param data Receives a copy, owned by the caller
+ * @return TRUE if the answer was found
+ */
+static BOOL scard_cache_get(scard_call_context* smartcard, const char* key, BYTE** data,
+                            DWORD* size)
+{
+	BOOL rc = FALSE;
+	const scard_cache_entry* entry;
+
+	WINPR_ASSERT(smartcard);
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(size);
+
+	if (!key)
+		return FALSE;
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	entry = (const scard_cache_entry*)HashTable_GetItemValue(smartcard->cache, key);
+
+	if (entry && (GetTickCount64() - entry->time < SCARD_CACHE_TTL))
+	{
+		*data = malloc(MAX(entry->size, 1));
+
+		if (*data)
+		{
+			memcpy(*data, entry->data, entry->size);
+			*size = entry->size;
+			rc = TRUE;
+		}
+	}
+
+	LeaveCriticalSection(&smartcard->cacheLock);
+	return rc;
+}
+
+static void scard_cache_set(scard_call_context* smartcard, const char* key, const BYTE* data,
+                            DWORD size)
+{
+	scard_cache_entry* entry;
+
+	WINPR_ASSERT(smartcard);
+
+	if (!key)
+		return;
+
+	entry = (scard_cache_entry*)calloc(1, sizeof(scard_cache_entry));
+
+	if (!entry)
+		return;
+
+	entry->time = GetTickCount64();
+	entry->size = size;
+	entry->data = malloc(MAX(size, 1));
+
+	if (!entry->data)
+	{
+		free(entry);
+		return;
+	}
+
+	if (size > 0)
+		memcpy(entry->data, data, size);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	HashTable_Remove(smartcard->cache, key);
+
+	if (HashTable_Count(smartcard->cache) >= SCARD_CACHE_MAX_ENTRIES)
+		HashTable_Clear(smartcard->cache);
+
+	if (!HashTable_Insert(smartcard->cache, key, entry))
+		scard_cache_entry_free(entry);
+
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+static void scard_cache_invalidate(scard_call_context* smartcard)
+{
+	WINPR_ASSERT(smartcard);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	HashTable_Clear(smartcard->cache);
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+/**
+ * Records the event state of a reader returned by SCardGetStatusChange and drops the cache
+ * if it differs from the one seen before: a card or reader came or went.
+ */
+static void scard_cache_update_reader_state(scard_call_context* smartcard, const void* reader,
+                                            size_t length, DWORD dwEventState)
+{
+	char* key;
+	DWORD* state;
+	const DWORD current = dwEventState & ~SCARD_STATE_CHANGED;
+
+	WINPR_ASSERT(smartcard);
+
+	if (!reader)
+		return;
+
+	key = scard_cache_key("state", (const BYTE*)reader, length, 0);
+
+	if (!key)
+		return;
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	state = (DWORD*)HashTable_GetItemValue(smartcard->readerStates, key);
+
+	if (state)
+	{
+		if (*state != current)
+		{
+			*state = current;
+			HashTable_Clear(smartcard->cache);
+		}
+	}
+	else
+	{
+		if (HashTable_Count(smartcard->readerStates) >= SCARD_CACHE_MAX_ENTRIES)
+			HashTable_Clear(smartcard->readerStates);
+
+		state = (DWORD*)malloc(sizeof(DWORD));
+
+		if (state)
+		{
+			*state = current;
+
+			if (!HashTable_Insert(smartcard->readerStates, key, state))
+				free(state);
+		}
+	}
+
+	LeaveCriticalSection(&smartcard->cacheLock);
+	free(key);
+}
+
+/* Attributes of the reader and the inserted card that do not change while it is connected */
+static BOOL scard_cache_attribute(DWORD dwAttrId)
+{
+	switch (dwAttrId)
+	{
+		case SCARD_ATTR_VENDOR_NAME:
+		case SCARD_ATTR_VENDOR_IFD_TYPE:
+		case SCARD_ATTR_VENDOR_IFD_VERSION:
+		case SCARD_ATTR_VENDOR_IFD_SERIAL_NO:
+		case SCARD_ATTR_CHANNEL_ID:
+		case SCARD_ATTR_ATR_STRING:
+		case SCARD_ATTR_DEVICE_UNIT:
+		case SCARD_ATTR_DEVICE_FRIENDLY_NAME_A:
+		case SCARD_ATTR_DEVICE_SYSTEM_NAME_A:
+		case SCARD_ATTR_DEVICE_FRIENDLY_NAME_W:
+		case SCARD_ATTR_DEVICE_SYSTEM_NAME_W:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/* Calls changing readers or card handles, the cached answers might be stale afterwards */
+static BOOL scard_cache_invalidated_by(UINT32 ioControlCode)
+{
+	switch (ioControlCode)
+	{
+		case SCARD_IOCTL_RELEASECONTEXT:
+		case SCARD_IOCTL_INTRODUCEREADERGROUPA:
+		case SCARD_IOCTL_INTRODUCEREADERGROUPW:
+		case SCARD_IOCTL_FORGETREADERGROUPA:
+		case SCARD_IOCTL_FORGETREADERGROUPW:
+		case SCARD_IOCTL_INTRODUCEREADERA:
+		case SCARD_IOCTL_INTRODUCEREADERW:
+		case SCARD_IOCTL_FORGETREADERA:
+		case SCARD_IOCTL_FORGETREADERW:
+		case SCARD_IOCTL_ADDREADERTOGROUPA:
+		case SCARD_IOCTL_ADDREADERTOGROUPW:
+		case SCARD_IOCTL_REMOVEREADERFROMGROUPA:
+		case SCARD_IOCTL_REMOVEREADERFROMGROUPW:
+		case SCARD_IOCTL_CONNECTA:
+		case SCARD_IOCTL_CONNECTW:
+		case SCARD_IOCTL_RECONNECT:
+		case SCARD_IOCTL_DISCONNECT:
+		case SCARD_IOCTL_SETATTRIB:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
 static LONG smartcard_EstablishContext_Call(scard_call_context* smartcard, wStream* out,
                                             SMARTCARD_OPERATION* operation)
 {
@@ -323,36 +567,51 @@ static LONG smartcard_ListReadersA_Call(scard_call_context* smartcard, wStream*
 	LONG status;
 	ListReaders_Return ret = { 0 };
 	LPSTR mszReaders = NULL;
+	BYTE* cached = NULL;
 	DWORD cchReaders = 0;
 	ListReaders_Call* call;
+	char* key;
 
 	WINPR_ASSERT(smartcard);
 	WINPR_ASSERT(out);
 	WINPR_ASSERT(operation);
 
 	call = &operation->call.listReaders;
+	key = scard_cache_key("ListReadersA", call->mszGroups, call->cBytes, 0);
+
+	if (scard_cache_get(smartcard, key, &cached, &ret.cBytes))
+	{
+		ret.msz = cached;
+		status = smartcard_pack_list_readers_return(out, &ret, FALSE);
+		goto out;
+	}
+
 	cchReaders = SCARD_AUTOALLOCATE;
 	status = ret.ReturnCode = wrap(smartcard, SCardListReadersA, operation->hContext,
 	                               (LPCSTR)call->mszGroups, (LPSTR)&mszReaders, &cchReaders);
 
 	if (status != SCARD_S_SUCCESS)
 	{
-		return scard_log_status_error(TAG, "SCardListReadersA", status);
+		status = scard_log_status_error(TAG, "SCardListReadersA", status);
+		goto out;
 	}
 
 	cchReaders = filter_device_by_name_a(smartcard->names, &mszReaders, cchReaders);
 	ret.msz = (BYTE*)mszReaders;
 	ret.cBytes = cchReaders;
+	scard_cache_set(smartcard, key, ret.msz, ret.cBytes);
 
 	status = smartcard_pack_list_readers_return(out, &ret, FALSE);
 	if (status != SCARD_S_SUCCESS)
-	{
-		return scard_log_status_error(TAG, "smartcard_pack_list_readers_return", status);
-	}
+		status = scard_log_status_error(TAG, "smartcard_pack_list_readers_return", status);
 
+out:
 	if (mszReaders)
 		wrap(smartcard, SCardFreeMemory, operation->hContext, mszReaders);
 
+	free(cached);
+	free(key);
+
 	if (status != SCARD_S_SUCCESS)
 		return status;
 
@@ -379,11 +638,22 @@ static LONG smartcard_ListReadersW_Call(scard_call_context* smartcard, wStream*
 		CHAR* pc;
 		BYTE* pb;
 	} mszReaders;
+	BYTE* cached = NULL;
+	char* key;
 
 	WINPR_ASSERT(smartcard);
 	WINPR_ASSERT(operation);
 
 	call = &operation->call.listReaders;
+	mszReaders.pb = NULL;
+	key = scard_cache_key("ListReadersW", call->mszGroups, call->cBytes, 0);
+
+	if (scard_cache_get(smartcard, key, &cached, &ret.cBytes))
+	{
+		ret.msz = cached;
+		status = smartcard_pack_list_readers_return(out, &ret, TRUE);
+		goto out;
+	}
 
 	string.bp = call->mszGroups;
 	cchReaders = SCARD_AUTOALLOCATE;
@@ -391,16 +661,24 @@ static LONG smartcard_ListReadersW_Call(scard_call_context* smartcard, wStream*
 	                               (LPWSTR)&mszReaders.pw, &cchReaders);
 
 	if (status != SCARD_S_SUCCESS)
-		return scard_log_status_error(TAG, "SCardListReadersW", status);
+	{
+		status = scard_log_status_error(TAG, "SCardListReadersW", status);
+		goto out;
+	}
 
 	cchReaders = filter_device_by_name_w(smartcard->names, &mszReaders.pw, cchReaders);
 	ret.msz = mszReaders.pb;
 	ret.cBytes = cchReaders * sizeof(WCHAR);
+	scard_cache_set(smartcard, key, ret.msz, ret.cBytes);
 	status = smartcard_pack_list_readers_return(out, &ret, TRUE);
 
+out:
 	if (mszReaders.pb)
 		wrap(smartcard, SCardFreeMemory, operation->hContext, mszReaders.pb);
 
+	free(cached);
+	free(key);
+
 	if (status != SCARD_S_SUCCESS)
 		return status;
 
@@ -925,6 +1203,10 @@ static LONG smartcard_GetStatusChangeA_Call(scard_call_context* smartcard, wStre
 		const SCARD_READERSTATEA* cur = &rgReaderStates[index];
 		ReaderState_Return* out = &ret.rgReaderStates[index];
 
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && cur->szReader)
+			scard_cache_update_reader_state(smartcard, cur->szReader, strlen(cur->szReader),
+			                                cur->dwEventState);
+
 		out->dwCurrentState = cur->dwCurrentState;
 		out->dwEventState = cur->dwEventState;
 		out->cbAtr = cur->cbAtr;
@@ -988,6 +1270,11 @@ static LONG smartcard_GetStatusChangeW_Call(scard_call_context* smartcard, wStre
 		const SCARD_READERSTATEW* cur = &rgReaderStates[index];
 		ReaderState_Return* out = &ret.rgReaderStates[index];
 
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && cur->szReader)
+			scard_cache_update_reader_state(smartcard, cur->szReader,
+			                                _wcslen(cur->szReader) * sizeof(WCHAR),
+			                                cur->dwEventState);
+
 		out->dwCurrentState = cur->dwCurrentState;
 		out->dwEventState = cur->dwEventState;
 		out->cbAtr = cur->cbAtr;
@@ -1371,12 +1658,41 @@ static LONG smartcard_GetAttrib_Call(scard_call_context* smartcard, wStream* out
 	LPBYTE pbAttr = NULL;
 	GetAttrib_Return ret = { 0 };
 	const GetAttrib_Call* call;
+	char* key = NULL;
 
 	WINPR_ASSERT(smartcard);
 	WINPR_ASSERT(operation);
 
 	call = &operation->call.getAttrib;
 
+	if (scard_cache_attribute(call->dwAttrId))
+	{
+		BYTE* cached = NULL;
+		DWORD cachedLen = 0;
+
+		key = scard_cache_key("GetAttrib", (const BYTE*)&operation->hCard,
+		                      sizeof(operation->hCard), call->dwAttrId);
+
+		/* answer from the cache unless the buffer is too small, PC/SC reports that */
+		if (scard_cache_get(smartcard, key, &cached, &cachedLen))
+		{
+			if (call->fpbAttrIsNULL || (call->cbAttrLen == SCARD_AUTOALLOCATE) ||
+			    (call->cbAttrLen >= cachedLen))
+			{
+				ret.ReturnCode = SCARD_S_SUCCESS;
+				ret.cbAttrLen = cachedLen;
+				ret.pbAttr = call->fpbAttrIsNULL ? NULL : cached;
+				status = smartcard_pack_get_attrib_return(out, &ret, call->dwAttrId,
+				                                          call->cbAttrLen);
+				free(cached);
+				free(key);
+				return status;
+			}
+
+			free(cached);
+		}
+	}
+
 	if (!call->fpbAttrIsNULL)
 	{
 		autoAllocate = (call->cbAttrLen == SCARD_AUTOALLOCATE) ? TRUE : FALSE;
@@ -1397,6 +1713,11 @@ static LONG smartcard_GetAttrib_Call(scard_call_context* smartcard, wStream* out
 	scard_log_status_error(TAG, "SCardGetAttrib", ret.ReturnCode);
 	ret.cbAttrLen = cbAttrLen;
 
+	if ((ret.ReturnCode == SCARD_S_SUCCESS) && ret.pbAttr)
+		scard_cache_set(smartcard, key, ret.pbAttr, cbAttrLen);
+
+	free(key);
+
 	status = smartcard_pack_get_attrib_return(out, &ret, call->dwAttrId, call->cbAttrLen);
 
 	if (autoAllocate)
@@ -1556,6 +1877,9 @@ LONG smartcard_irp_device_control_call(scard_call_context* smartcard, wStream* o
 	Stream_Zero(out, SMARTCARD_PRIVATE_TYPE_HEADER_LENGTH); /* PrivateTypeHeader (8 bytes) */
 	Stream_Write_UINT32(out, 0);                            /* Result (4 bytes) */
 
+	if (scard_cache_invalidated_by(ioControlCode))
+		scard_cache_invalidate(smartcard);
+
 	/* Call */
 	switch (ioControlCode)
 	{
@@ -1828,6 +2152,8 @@ scard_call_context* smartcard_call_context_new(const rdpSettings* settings)
 	if (!ctx)
 		goto fail;
 
+	InitializeCriticalSection(&ctx->cacheLock);
+
 	ctx->stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
 	if (!ctx->stopEvent)
 		goto fail;
@@ -1850,6 +2176,22 @@ scard_call_context* smartcard_call_context_new(const rdpSettings* settings)
 	WINPR_ASSERT(obj);
 	obj->fnObjectFree = context_free;
 
+	ctx->cache = HashTable_New(FALSE);
+	if (!ctx->cache || !HashTable_SetupForStringData(ctx->cache, FALSE))
+		goto fail;
+
+	obj = HashTable_ValueObject(ctx->cache);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = scard_cache_entry_free;
+
+	ctx->readerStates = HashTable_New(FALSE);
+	if (!ctx->readerStates || !HashTable_SetupForStringData(ctx->readerStates, FALSE))
+		goto fail;
+
+	obj = HashTable_ValueObject(ctx->readerStates);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = free;
+
 	return ctx;
 fail:
 	smartcard_call_context_free(ctx);
@@ -1872,6 +2214,9 @@ void smartcard_call_context_free(scard_call_context* ctx)
 	Emulate_Free(ctx->emulation);
 #endif
 	HashTable_Free(ctx->rgSCardContextList);
+	HashTable_Free(ctx->cache);
+	HashTable_Free(ctx->readerStates);
+	DeleteCriticalSection(&ctx->cacheLock);
 	CloseHandle(ctx->stopEvent);
 	free(ctx);
 }
@@ -1896,6 +2241,7 @@ BOOL smartcard_call_cancel_context(scard_call_context* ctx, SCARDCONTEXT hContex
 BOOL smartcard_call_release_context(scard_call_context* ctx, SCARDCONTEXT hContext)
 {
 	WINPR_ASSERT(ctx);
+	scard_cache_invalidate(ctx);
 	wrap(ctx, SCardReleaseContext, hContext);
 	return TRUE;
 }
@@ -1905,6 +2251,7 @@ BOOL smartcard_call_cancel_all_context(scard_call_context* ctx)
 	WINPR_ASSERT(ctx);
 
 	HashTable_Clear(ctx->rgSCardContextList);
+	scard_cache_invalidate(ctx);
 	return TRUE;
 }
 
@@ -0,0 +1,130 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+
+#include <freerdp/utils/pcap.h>
+
+#define TEST_RECORDS 40
+#define TEST_RECORD_SIZE 100
+
+/* reads the records of one file and checks they continue the sequence at *next */
+static BOOL check_file(const char* name, UINT32* next)
+{
+	BOOL rc = TRUE;
+	pcap_record record = { 0 };
+	rdpPcap* pcap = pcap_open(name, FALSE);
+
+	if (!pcap)
+		return FALSE;
+
+	while (rc && pcap_get_next_record(pcap, &record))
+	{
+		UINT32 x;
+		const BYTE* data = (const BYTE*)record.data;
+
+		if (record.length != TEST_RECORD_SIZE)
+			rc = FALSE;
+
+		for (x = 0; rc && (x < record.length); x++)
+		{
+			if (data[x] != (BYTE)*next)
+				rc = FALSE;
+		}
+
+		(*next)++;
+		free(record.data);
+		record.data = NULL;
+	}
+
+	pcap_close(pcap);
+	return rc;
+}
+
+int TestPcap(int argc, char* argv[])
+{
+	int rc = -1;
+	UINT32 x;
+	UINT32 next = 0;
+	UINT32 files = 0;
+	char* tmp_path = NULL;
+	char* pcap_file = NULL;
+	char name[1024] = { 0 };
+	BYTE data[TEST_RECORD_SIZE];
+	rdpPcap* pcap = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+		goto fail;
+
+	if (!(pcap_file = GetCombinedPath(tmp_path, "TestPcap.pcap")))
+		goto fail;
+
+	/* room for a few records only, rotate after about four records */
+	pcap = pcap_open_ex(pcap_file, TRUE, 8 * (16 + TEST_RECORD_SIZE), 500);
+
+	if (!pcap)
+		goto fail;
+
+	for (x = 0; x < TEST_RECORDS; x++)
+	{
+		memset(data, (BYTE)x, sizeof(data));
+
+		if (!pcap_add_record(pcap, data, sizeof(data)))
+			goto fail;
+
+		/* the data is copied, the caller may reuse its buffer at once */
+		memset(data, 0xFF, sizeof(data));
+
+		if ((x % 4) == 3)
+			pcap_flush(pcap);
+	}
+
+	pcap_close(pcap);
+	pcap = NULL;
+
+	if (!check_file(pcap_file, &next))
+		goto fail;
+
+	while (next < TEST_RECORDS)
+	{
+		const UINT32 before = next;
+
+		sprintf_s(name, sizeof(name), "%s.%" PRIu32, pcap_file, ++files);
+
+		if (!check_file(name, &next) || (next == before))
+		{
+			fprintf(stderr, "records missing after %" PRIu32 " files\n", files);
+			goto fail;
+		}
+	}
+
+	if ((next != TEST_RECORDS) || (files < 5))
+	{
+		fprintf(stderr, "unexpected capture: %" PRIu32 " records in %" PRIu32 " files\n", next,
+		        files + 1);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	pcap_close(pcap);
+
+	if (pcap_file)
+	{
+		winpr_DeleteFile(pcap_file);
+
+		for (x = 1; x <= files; x++)
+		{
+			sprintf_s(name, sizeof(name), "%s.%" PRIu32, pcap_file, x);
+			winpr_DeleteFile(name);
+		}
+	}
+
+	free(pcap_file);
+	free(tmp_path);
+	return rc;
+}
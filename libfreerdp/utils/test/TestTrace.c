@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+
+#include <freerdp/utils/trace.h>
+
+static size_t count_occurrences(const char* haystack, const char* needle)
+{
+	size_t count = 0;
+	const char* cur = haystack;
+
+	while ((cur = strstr(cur, needle)))
+	{
+		count++;
+		cur += strlen(needle);
+	}
+
+	return count;
+}
+
+static char* read_file(const char* path)
+{
+	char* data = NULL;
+	long size;
+	FILE* fp = winpr_fopen(path, "rb");
+
+	if (!fp)
+		return NULL;
+
+	if (fseek(fp, 0, SEEK_END) != 0)
+		goto fail;
+
+	size = ftell(fp);
+
+	if ((size <= 0) || (fseek(fp, 0, SEEK_SET) != 0))
+		goto fail;
+
+	data = calloc(1, (size_t)size + 1);
+
+	if (!data)
+		goto fail;
+
+	if (fread(data, 1, (size_t)size, fp) != (size_t)size)
+	{
+		free(data);
+		data = NULL;
+	}
+
+fail:
+	fclose(fp);
+	return data;
+}
+
+int TestTrace(int argc, char* argv[])
+{
+	int rc = -1;
+	size_t index;
+	char* tmp_path = NULL;
+	char* trace_file = NULL;
+	char* data = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (freerdp_trace_is_enabled())
+	{
+		/* started through the environment, do not interfere */
+		return 0;
+	}
+
+	if (freerdp_trace_begin() != 0)
+	{
+		fprintf(stderr, "span started while tracing is disabled\n");
+		goto fail;
+	}
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+		goto fail;
+
+	if (!(trace_file = GetCombinedPath(tmp_path, "test_trace.json")))
+		goto fail;
+
+	if (!freerdp_trace_start(trace_file))
+		goto fail;
+
+	/* wrap the ring once, only the newest spans must be kept */
+	for (index = 0; index < FREERDP_TRACE_RING_SIZE + 10; index++)
+	{
+		FREERDP_TRACE_SPAN_BEGIN(span);
+		FREERDP_TRACE_SPAN_END(span, "test_span");
+	}
+
+	if (!freerdp_trace_stop())
+		goto fail;
+
+	if (freerdp_trace_is_enabled())
+		goto fail;
+
+	if (!(data = read_file(trace_file)))
+		goto fail;
+
+	if (!strstr(data, "\"traceEvents\""))
+	{
+		fprintf(stderr, "trace is not in the trace event format\n");
+		goto fail;
+	}
+
+	if (count_occurrences(data, "\"name\":\"test_span\"") != FREERDP_TRACE_RING_SIZE)
+	{
+		fprintf(stderr, "unexpected number of spans in the trace\n");
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (trace_file)
+		winpr_DeleteFile(trace_file);
+
+	free(data);
+	free(trace_file);
+	free(tmp_path);
+	return rc;
+}
@@ -0,0 +1,379 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Tracing Utils
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+#include <winpr/environment.h>
+
+#include <freerdp/utils/trace.h>
+#include <freerdp/log.h>
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define TAG FREERDP_TAG("utils.trace")
+
+enum
+{
+	TRACE_STATE_UNINITIALIZED = 0,
+	TRACE_STATE_DISABLED = 1,
+	TRACE_STATE_ENABLED = 2
+};
+
+typedef struct
+{
+	const char* name;
+	UINT64 start;
+	UINT64 duration;
+} rdpTraceEvent;
+
+typedef struct s_rdp_trace_ring
+{
+	DWORD tid;
+	CRITICAL_SECTION lock;
+	UINT64 next;
+	rdpTraceEvent events[FREERDP_TRACE_RING_SIZE];
+	struct s_rdp_trace_ring* link;
+} rdpTraceRing;
+
+static volatile LONG g_TraceState = TRACE_STATE_UNINITIALIZED;
+static INIT_ONCE g_TraceOnce = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION g_TraceLock;
+static DWORD g_TraceTls = TLS_OUT_OF_INDEXES;
+/* Rings are never released, a thread may still hold its ring through the TLS slot */
+static rdpTraceRing* g_TraceRings = NULL;
+static char* g_TracePath = NULL;
+#ifdef _WIN32
+static LARGE_INTEGER g_TraceFrequency = { 0 };
+#endif
+
+static UINT64 trace_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return (UINT64)((count.QuadPart / g_TraceFrequency.QuadPart) * 1000000000ULL +
+	                ((count.QuadPart % g_TraceFrequency.QuadPart) * 1000000000ULL) /
+	                    g_TraceFrequency.QuadPart);
+#else
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (UINT64)ts.tv_sec * 1000000000ULL + (UINT64)ts.tv_nsec;
+#endif
+}
+
+static void trace_atexit(void)
+{
+	freerdp_trace_stop();
+}
+
+static char* trace_getenv(void)
+{
+	char* env = NULL;
+	const DWORD envlen = GetEnvironmentVariableA(FREERDP_TRACE_ENV, NULL, 0);
+
+	if (envlen <= 1)
+		return NULL;
+
+	env = calloc(1, envlen);
+
+	if (!env)
+		return NULL;
+
+	if (GetEnvironmentVariableA(FREERDP_TRACE_ENV, env, envlen) != envlen - 1)
+	{
+		free(env);
+		return NULL;
+	}
+
+	return env;
+}
+
+static BOOL CALLBACK trace_init_once(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	char* path = NULL;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+#ifdef _WIN32
+	QueryPerformanceFrequency(&g_TraceFrequency);
+#endif
+
+	if (!InitializeCriticalSectionAndSpinCount(&g_TraceLock, 4000))
+		return FALSE;
+
+	g_TraceTls = TlsAlloc();
+
+	if (g_TraceTls == TLS_OUT_OF_INDEXES)
+	{
+		DeleteCriticalSection(&g_TraceLock);
+		return FALSE;
+	}
+
+	InterlockedExchange(&g_TraceState, TRACE_STATE_DISABLED);
+	path = trace_getenv();
+
+	if (path)
+	{
+		g_TracePath = path;
+		InterlockedExchange(&g_TraceState, TRACE_STATE_ENABLED);
+		WLog_INFO(TAG, "tracing enabled, writing to %s at exit", path);
+		atexit(trace_atexit);
+	}
+
+	return TRUE;
+}
+
+static BOOL trace_init(void)
+{
+	return InitOnceExecuteOnce(&g_TraceOnce, trace_init_once, NULL, NULL);
+}
+
+static rdpTraceRing* trace_get_ring(void)
+{
+	rdpTraceRing* ring = (rdpTraceRing*)TlsGetValue(g_TraceTls);
+
+	if (ring)
+		return ring;
+
+	ring = (rdpTraceRing*)calloc(1, sizeof(rdpTraceRing));
+
+	if (!ring)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&ring->lock, 4000))
+	{
+		free(ring);
+		return NULL;
+	}
+
+	ring->tid = GetCurrentThreadId();
+
+	if (!TlsSetValue(g_TraceTls, ring))
+	{
+		DeleteCriticalSection(&ring->lock);
+		free(ring);
+		return NULL;
+	}
+
+	EnterCriticalSection(&g_TraceLock);
+	ring->link = g_TraceRings;
+	g_TraceRings = ring;
+	LeaveCriticalSection(&g_TraceLock);
+	return ring;
+}
+
+BOOL freerdp_trace_is_enabled(void)
+{
+	if (g_TraceState == TRACE_STATE_UNINITIALIZED)
+		trace_init();
+
+	return g_TraceState == TRACE_STATE_ENABLED;
+}
+
+UINT64 freerdp_trace_begin(void)
+{
+	if (!freerdp_trace_is_enabled())
+		return 0;
+
+	return trace_now();
+}
+
+void freerdp_trace_end(const char* name, UINT64 start)
+{
+	UINT64 end;
+	rdpTraceRing* ring;
+	rdpTraceEvent* event;
+
+	/* The span started before tracing was enabled */
+	if ((start == 0) || (g_TraceState != TRACE_STATE_ENABLED))
+		return;
+
+	end = trace_now();
+	ring = trace_get_ring();
+
+	if (!ring)
+		return;
+
+	/* Only contended while a trace is exported */
+	EnterCriticalSection(&ring->lock);
+	event = &ring->events[ring->next % FREERDP_TRACE_RING_SIZE];
+	event->name = name;
+	event->start = start;
+	event->duration = (end > start) ? end - start : 0;
+	ring->next++;
+	LeaveCriticalSection(&ring->lock);
+}
+
+static BOOL trace_write_ring(FILE* fp, rdpTraceRing* ring, rdpTraceEvent* events, DWORD pid,
+                             BOOL* first)
+{
+	size_t count;
+	size_t index;
+	UINT64 first_event;
+
+	EnterCriticalSection(&ring->lock);
+	count = (size_t)MIN(ring->next, FREERDP_TRACE_RING_SIZE);
+	first_event = ring->next - count;
+
+	for (index = 0; index < count; index++)
+		events[index] = ring->events[(first_event + index) % FREERDP_TRACE_RING_SIZE];
+
+	LeaveCriticalSection(&ring->lock);
+
+	/* Timestamps are in microseconds, keep the nanoseconds as fraction */
+	for (index = 0; index < count; index++)
+	{
+		const rdpTraceEvent* event = &events[index];
+		const int rc =
+		    fprintf(fp,
+		            "%s\n{\"name\":\"%s\",\"cat\":\"freerdp\",\"ph\":\"X\",\"ts\":%" PRIu64
+		            ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64 ",\"pid\":%" PRIu32
+		            ",\"tid\":%" PRIu32 "}",
+		            *first ? "" : ",", event->name, event->start / 1000, event->start % 1000,
+		            event->duration / 1000, event->duration % 1000, pid, ring->tid);
+
+		if (rc < 0)
+			return FALSE;
+
+		*first = FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL freerdp_trace_export(const char* path)
+{
+	BOOL rc = FALSE;
+	BOOL first = TRUE;
+	FILE* fp = NULL;
+	rdpTraceRing* ring;
+	rdpTraceEvent* events = NULL;
+#ifdef _WIN32
+	const DWORD pid = GetCurrentProcessId();
+#else
+	const DWORD pid = (DWORD)getpid();
+#endif
+
+	if (!path || !trace_init())
+		return FALSE;
+
+	events = (rdpTraceEvent*)calloc(FREERDP_TRACE_RING_SIZE, sizeof(rdpTraceEvent));
+
+	if (!events)
+		return FALSE;
+
+	fp = winpr_fopen(path, "w");
+
+	if (!fp)
+	{
+		WLog_ERR(TAG, "failed to open trace file %s", path);
+		goto fail;
+	}
+
+	if (fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") < 0)
+		goto fail;
+
+	EnterCriticalSection(&g_TraceLock);
+
+	for (ring = g_TraceRings; ring; ring = ring->link)
+	{
+		if (!trace_write_ring(fp, ring, events, pid, &first))
+		{
+			LeaveCriticalSection(&g_TraceLock);
+			goto fail;
+		}
+	}
+
+	LeaveCriticalSection(&g_TraceLock);
+
+	if (fprintf(fp, "\n]}\n") < 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (fp && (fclose(fp) != 0))
+		rc = FALSE;
+
+	free(events);
+	return rc;
+}
+
+BOOL freerdp_trace_start(const char* path)
+{
+	rdpTraceRing* ring;
+	char* copy = NULL;
+
+	if (!trace_init())
+		return FALSE;
+
+	if (path)
+	{
+		copy = _strdup(path);
+
+		if (!copy)
+			return FALSE;
+	}
+
+	EnterCriticalSection(&g_TraceLock);
+
+	for (ring = g_TraceRings; ring; ring = ring->link)
+	{
+		EnterCriticalSection(&ring->lock);
+		ring->next = 0;
+		LeaveCriticalSection(&ring->lock);
+	}
+
+	free(g_TracePath);
+	g_TracePath = copy;
+	InterlockedExchange(&g_TraceState, TRACE_STATE_ENABLED);
+	LeaveCriticalSection(&g_TraceLock);
+	return TRUE;
+}
+
+BOOL freerdp_trace_stop(void)
+{
+	BOOL rc = TRUE;
+	char* path;
+
+	if (!trace_init())
+		return FALSE;
+
+	EnterCriticalSection(&g_TraceLock);
+	InterlockedExchange(&g_TraceState, TRACE_STATE_DISABLED);
+	path = g_TracePath;
+	g_TracePath = NULL;
+	LeaveCriticalSection(&g_TraceLock);
+
+	if (path)
+		rc = freerdp_trace_export(path);
+
+	free(path);
+	return rc;
+}
@@ -50,6 +50,15 @@ extern "C"
 	                                          uint16_t height, uint32_t scanline);
 	RDTK_EXPORT void rdtk_surface_free(rdtkSurface* surface);
 
+	/**
+	 * Bounds of everything drawn since the surface was created or the last reset, so callers
+	 * only have to update that area.
+	 * @return 1 if something was drawn, 0 otherwise
+	 */
+	RDTK_EXPORT int rdtk_surface_get_dirty_rect(rdtkSurface* surface, uint16_t* x, uint16_t* y,
+	                                            uint16_t* width, uint16_t* height);
+	RDTK_EXPORT void rdtk_surface_reset_dirty_rect(rdtkSurface* surface);
+
 	/* Font */
 
 	RDTK_EXPORT int rdtk_font_draw_text(rdtkSurface* surface, uint16_t nXDst, uint16_t nYDst,
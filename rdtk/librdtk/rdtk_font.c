@@ -19,6 +19,7 @@
 #include <rdtk/config.h>
 
 #include <errno.h>
+#include <limits.h>
 
 #include <winpr/wtypes.h>
 #include <winpr/crt.h>
@@ -32,93 +33,264 @@
 
 #include "rdtk_font.h"
 
-static int rdtk_font_draw_glyph(rdtkSurface* surface, int nXDst, int nYDst, rdtkFont* font,
-                                rdtkGlyph* glyph)
+#if defined(WITH_SSE2) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define RDTK_FONT_SSE2
+#endif
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+static rdtkGlyph* rdtk_font_get_glyph(rdtkFont* font, char c)
 {
-	int x, y;
-	int nXSrc;
-	int nYSrc;
-	int nWidth;
-	int nHeight;
-	int nSrcStep;
-	int nDstStep;
-	uint8_t* pSrcData;
-	uint8_t* pSrcPixel;
-	uint8_t* pDstData;
-	uint8_t* pDstPixel;
-	uint8_t A, R, G, B;
-	nXDst += glyph->offsetX;
-	nYDst += glyph->offsetY;
-	nXSrc = glyph->rectX;
-	nYSrc = glyph->rectY;
-	nWidth = glyph->rectWidth;
-	nHeight = glyph->rectHeight;
-	nSrcStep = font->image->scanline;
-	pSrcData = font->image->data;
-	pDstData = surface->data;
-	nDstStep = surface->scanline;
+	const size_t index = (size_t)(c - 32);
 
-	for (y = 0; y < nHeight; y++)
+	if (index >= font->glyphCount)
+		return NULL;
+
+	return &font->glyphs[index];
+}
+
+static void rdtk_glyph_run_reset(rdtkGlyphRun* run)
+{
+	free(run->text);
+	free(run->data);
+	memset(run, 0, sizeof(rdtkGlyphRun));
+}
+
+/* d = s + d * (255 - a) / 255, rounded like the original per glyph blend */
+static INLINE uint8_t rdtk_blend_channel(uint8_t s, uint8_t d, uint8_t a)
+{
+	const uint32_t t = d * (255u - a) + 127u;
+	return (uint8_t)(s + ((t + 1u + (t >> 8)) >> 8));
+}
+
+/* renders the glyphs of text, tinted black and premultiplied, into one BGRA image */
+static BOOL rdtk_font_build_run(rdtkFont* font, const char* text, rdtkGlyphRun* run)
+{
+	size_t index;
+	int penX = 0;
+	int left = INT_MAX;
+	int top = INT_MAX;
+	int right = INT_MIN;
+	int bottom = INT_MIN;
+	const size_t length = strlen(text);
+	const uint8_t* pSrcData = font->image->data;
+	const uint32_t nSrcStep = font->image->scanline;
+
+	run->text = _strdup(text);
+
+	if (!run->text)
+		return FALSE;
+
+	for (index = 0; index < length; index++)
 	{
-		pSrcPixel = &pSrcData[((nYSrc + y) * nSrcStep) + (nXSrc * 4)];
-		pDstPixel = &pDstData[((nYDst + y) * nDstStep) + (nXDst * 4)];
+		const rdtkGlyph* glyph = rdtk_font_get_glyph(font, text[index]);
+
+		if (!glyph)
+			continue;
 
-		for (x = 0; x < nWidth; x++)
+		if ((glyph->rectWidth > 0) && (glyph->rectHeight > 0))
 		{
-			B = pSrcPixel[0];
-			G = pSrcPixel[1];
-			R = pSrcPixel[2];
-			A = pSrcPixel[3];
-			pSrcPixel += 4;
+			left = MIN(left, penX + glyph->offsetX);
+			top = MIN(top, glyph->offsetY);
+			right = MAX(right, penX + glyph->offsetX + glyph->rectWidth);
+			bottom = MAX(bottom, glyph->offsetY + glyph->rectHeight);
+		}
 
-			if (1)
-			{
-				/* tint black */
-				R = 255 - R;
-				G = 255 - G;
-				B = 255 - B;
-			}
+		penX += (glyph->width + 1);
+	}
 
-			if (A == 255)
-			{
-				pDstPixel[0] = B;
-				pDstPixel[1] = G;
-				pDstPixel[2] = R;
-			}
-			else
+	/* nothing visible, e.g. only spaces */
+	if ((left >= right) || (top >= bottom))
+		return TRUE;
+
+	run->x = left;
+	run->y = top;
+	run->width = right - left;
+	run->height = bottom - top;
+	run->data = (uint8_t*)calloc((size_t)run->width * run->height, 4);
+
+	if (!run->data)
+		return FALSE;
+
+	penX = 0;
+
+	for (index = 0; index < length; index++)
+	{
+		int x, y;
+		const rdtkGlyph* glyph = rdtk_font_get_glyph(font, text[index]);
+
+		if (!glyph)
+			continue;
+
+		for (y = 0; y < glyph->rectHeight; y++)
+		{
+			const uint8_t* pSrcPixel =
+			    &pSrcData[((glyph->rectY + y) * nSrcStep) + (glyph->rectX * 4)];
+			uint8_t* pDstPixel = &run->data[(((glyph->offsetY - top + y) * run->width) +
+			                                 (penX + glyph->offsetX - left)) *
+			                                4];
+
+			for (x = 0; x < glyph->rectWidth; x++)
 			{
-				R = (R * A) / 255;
-				G = (G * A) / 255;
-				B = (B * A) / 255;
-				pDstPixel[0] = B + (pDstPixel[0] * (255 - A) + (255 / 2)) / 255;
-				pDstPixel[1] = G + (pDstPixel[1] * (255 - A) + (255 / 2)) / 255;
-				pDstPixel[2] = R + (pDstPixel[2] * (255 - A) + (255 / 2)) / 255;
+				const uint8_t A = pSrcPixel[3];
+				/* tint black and premultiply */
+				const uint8_t B = (uint8_t)(((255 - pSrcPixel[0]) * A) / 255);
+				const uint8_t G = (uint8_t)(((255 - pSrcPixel[1]) * A) / 255);
+				const uint8_t R = (uint8_t)(((255 - pSrcPixel[2]) * A) / 255);
+
+				/* glyphs that overlap are composited in drawing order */
+				pDstPixel[0] = rdtk_blend_channel(B, pDstPixel[0], A);
+				pDstPixel[1] = rdtk_blend_channel(G, pDstPixel[1], A);
+				pDstPixel[2] = rdtk_blend_channel(R, pDstPixel[2], A);
+				pDstPixel[3] = rdtk_blend_channel(A, pDstPixel[3], A);
+				pSrcPixel += 4;
+				pDstPixel += 4;
 			}
-
-			pDstPixel[3] = 0xFF;
-			pDstPixel += 4;
 		}
+
+		penX += (glyph->width + 1);
 	}
 
-	return 1;
+	return TRUE;
 }
 
-int rdtk_font_draw_text(rdtkSurface* surface, uint16_t nXDst, uint16_t nYDst, rdtkFont* font,
-                        const char* text)
+static const rdtkGlyphRun* rdtk_font_get_run(rdtkFont* font, const char* text)
 {
 	size_t index;
-	size_t length;
-	rdtkGlyph* glyph;
-	font = surface->engine->font;
-	length = strlen(text);
+	rdtkGlyphRun* run;
 
-	for (index = 0; index < length; index++)
+	for (index = 0; index < RDTK_FONT_RUN_CACHE_SIZE; index++)
+	{
+		run = &font->runs[index];
+
+		if (run->text && (strcmp(run->text, text) == 0))
+			return run;
+	}
+
+	run = &font->runs[font->nextRun];
+	font->nextRun = (font->nextRun + 1) % RDTK_FONT_RUN_CACHE_SIZE;
+	rdtk_glyph_run_reset(run);
+
+	if (!rdtk_font_build_run(font, text, run))
 	{
-		glyph = &font->glyphs[text[index] - 32];
-		rdtk_font_draw_glyph(surface, nXDst, nYDst, font, glyph);
-		nXDst += (glyph->width + 1);
+		rdtk_glyph_run_reset(run);
+		return NULL;
 	}
 
+	return run;
+}
+
+/* source over destination for premultiplied BGRA, the destination becomes opaque */
+static void rdtk_font_blend_row(uint8_t* pDst, const uint8_t* pSrc, int width)
+{
+	int x = 0;
+#if defined(RDTK_FONT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i half = _mm_set1_epi16(127);
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i lo, hi, alo, ahi;
+		const __m128i src = _mm_loadu_si128((const __m128i*)&pSrc[x * 4]);
+		const __m128i dst = _mm_loadu_si128((const __m128i*)&pDst[x * 4]);
+
+		/* 255 - alpha for every channel of two pixels */
+		alo = _mm_unpacklo_epi8(src, zero);
+		ahi = _mm_unpackhi_epi8(src, zero);
+		alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(alo, 0xFF), 0xFF);
+		ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ahi, 0xFF), 0xFF);
+		alo = _mm_sub_epi16(full, alo);
+		ahi = _mm_sub_epi16(full, ahi);
+
+		/* t = d * (255 - a) + 127, t / 255 = (t + 1 + (t >> 8)) >> 8 */
+		lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), alo), half);
+		hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), ahi), half);
+		lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+
+		lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(src, zero));
+		hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(src, zero));
+		_mm_storeu_si128((__m128i*)&pDst[x * 4], _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		const uint8_t* s = &pSrc[x * 4];
+		uint8_t* d = &pDst[x * 4];
+
+		d[0] = rdtk_blend_channel(s[0], d[0], s[3]);
+		d[1] = rdtk_blend_channel(s[1], d[1], s[3]);
+		d[2] = rdtk_blend_channel(s[2], d[2], s[3]);
+		d[3] = 0xFF;
+	}
+}
+
+static void rdtk_font_draw_run(rdtkSurface* surface, int nXDst, int nYDst,
+                               const rdtkGlyphRun* run)
+{
+	int y;
+	int nXSrc = 0;
+	int nYSrc = 0;
+	int nWidth = run->width;
+	int nHeight = run->height;
+
+	nXDst += run->x;
+	nYDst += run->y;
+
+	if (nXDst < 0)
+	{
+		nXSrc = -nXDst;
+		nWidth += nXDst;
+		nXDst = 0;
+	}
+
+	if (nYDst < 0)
+	{
+		nYSrc = -nYDst;
+		nHeight += nYDst;
+		nYDst = 0;
+	}
+
+	nWidth = MIN(nWidth, surface->width - nXDst);
+	nHeight = MIN(nHeight, surface->height - nYDst);
+
+	if ((nWidth <= 0) || (nHeight <= 0))
+		return;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		uint8_t* pDst = &surface->data[((nYDst + y) * surface->scanline) + (nXDst * 4)];
+		const uint8_t* pSrc = &run->data[(((nYSrc + y) * run->width) + nXSrc) * 4];
+		rdtk_font_blend_row(pDst, pSrc, nWidth);
+	}
+
+	rdtk_surface_mark_dirty(surface, nXDst, nYDst, nWidth, nHeight);
+}
+
+int rdtk_font_draw_text(rdtkSurface* surface, uint16_t nXDst, uint16_t nYDst, rdtkFont* font,
+                        const char* text)
+{
+	const rdtkGlyphRun* run;
+	font = surface->engine->font;
+	run = rdtk_font_get_run(font, text);
+
+	if (!run)
+		return -1;
+
+	if (run->data)
+		rdtk_font_draw_run(surface, nXDst, nYDst, run);
+
 	return 1;
 }
 
@@ -720,6 +892,11 @@ void rdtk_font_free(rdtkFont* font)
 {
 	if (font)
 	{
+		size_t index;
+
+		for (index = 0; index < RDTK_FONT_RUN_CACHE_SIZE; index++)
+			rdtk_glyph_run_reset(&font->runs[index]);
+
 		free(font->family);
 		free(font->style);
 		winpr_image_free(font->image, TRUE);
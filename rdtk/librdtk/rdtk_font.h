@@ -39,6 +39,19 @@ struct rdtk_glyph
 	uint8_t code[4];
 };
 
+/* the glyphs of a string drawn once, tinted and premultiplied BGRA */
+typedef struct
+{
+	char* text;
+	int x; /* position relative to the pen, glyph offsets may be negative */
+	int y;
+	int width;
+	int height;
+	uint8_t* data; /* NULL if no glyph is visible */
+} rdtkGlyphRun;
+
+#define RDTK_FONT_RUN_CACHE_SIZE 16
+
 struct rdtk_font
 {
 	rdtkEngine* engine;
@@ -50,6 +63,10 @@ struct rdtk_font
 	wImage* image;
 	uint16_t glyphCount;
 	rdtkGlyph* glyphs;
+
+	/* strings drawn recently, replaced round robin */
+	rdtkGlyphRun runs[RDTK_FONT_RUN_CACHE_SIZE];
+	size_t nextRun;
 };
 
 #ifdef __cplusplus
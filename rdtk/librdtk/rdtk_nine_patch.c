@@ -196,6 +196,7 @@ int rdtk_nine_patch_draw(rdtkSurface* surface, int nXDst, int nYDst, int nWidth,
 	height = ninePatch->height - ninePatch->scaleBottom;
 	rdtk_image_copy_alpha_blend(pDstData, nDstStep, nXDst + x, nYDst + y, width, height, pSrcData,
 	                            nSrcStep, nXSrc, nYSrc);
+	rdtk_surface_mark_dirty(surface, nXDst, nYDst, x + width, ninePatch->height);
 	return 1;
 }
 
@@ -32,14 +32,77 @@ int rdtk_surface_fill(rdtkSurface* surface, uint16_t x, uint16_t y, uint16_t wid
 		uint8_t* line = &surface->data[i * surface->scanline];
 		for (j = x; j < x + width; j++)
 		{
-			uint32_t* pixel = (uint32_t*)&line[j + 4];
+			uint32_t* pixel = (uint32_t*)&line[j * 4];
 			*pixel = color;
 		}
 	}
 
+	rdtk_surface_mark_dirty(surface, x, y, width, height);
 	return 1;
 }
 
+void rdtk_surface_mark_dirty(rdtkSurface* surface, int x, int y, int width, int height)
+{
+	int right = x + width;
+	int bottom = y + height;
+
+	if (x < 0)
+		x = 0;
+
+	if (y < 0)
+		y = 0;
+
+	if (right > surface->width)
+		right = surface->width;
+
+	if (bottom > surface->height)
+		bottom = surface->height;
+
+	if ((x >= right) || (y >= bottom))
+		return;
+
+	if (!surface->dirty)
+	{
+		surface->dirtyLeft = (uint16_t)x;
+		surface->dirtyTop = (uint16_t)y;
+		surface->dirtyRight = (uint16_t)right;
+		surface->dirtyBottom = (uint16_t)bottom;
+		surface->dirty = true;
+		return;
+	}
+
+	if (x < surface->dirtyLeft)
+		surface->dirtyLeft = (uint16_t)x;
+
+	if (y < surface->dirtyTop)
+		surface->dirtyTop = (uint16_t)y;
+
+	if (right > surface->dirtyRight)
+		surface->dirtyRight = (uint16_t)right;
+
+	if (bottom > surface->dirtyBottom)
+		surface->dirtyBottom = (uint16_t)bottom;
+}
+
+int rdtk_surface_get_dirty_rect(rdtkSurface* surface, uint16_t* x, uint16_t* y, uint16_t* width,
+                                uint16_t* height)
+{
+	if (!surface || !surface->dirty)
+		return 0;
+
+	*x = surface->dirtyLeft;
+	*y = surface->dirtyTop;
+	*width = surface->dirtyRight - surface->dirtyLeft;
+	*height = surface->dirtyBottom - surface->dirtyTop;
+	return 1;
+}
+
+void rdtk_surface_reset_dirty_rect(rdtkSurface* surface)
+{
+	if (surface)
+		surface->dirty = false;
+}
+
 rdtkSurface* rdtk_surface_new(rdtkEngine* engine, uint8_t* data, uint16_t width, uint16_t height,
                               uint32_t scanline)
 {
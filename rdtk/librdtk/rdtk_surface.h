@@ -34,5 +34,24 @@ struct rdtk_surface
 	uint32_t scanline;
 	uint8_t* data;
 	bool owner;
+
+	/* bounds of what was drawn since the last rdtk_surface_reset_dirty_rect */
+	bool dirty;
+	uint16_t dirtyLeft;
+	uint16_t dirtyTop;
+	uint16_t dirtyRight;
+	uint16_t dirtyBottom;
 };
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	void rdtk_surface_mark_dirty(rdtkSurface* surface, int x, int y, int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* RDTK_SURFACE_PRIVATE_H */
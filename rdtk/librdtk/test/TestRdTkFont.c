@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <rdtk/rdtk.h>
+#include <winpr/crt.h>
+#include <winpr/error.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 64
+#define TEST_COLOR 0xFFC0C0C0
+
+static BOOL test_draw(rdtkSurface* surface, const char* text, uint16_t nXDst, uint16_t nYDst,
+                      uint8_t* data, uint8_t* copy)
+{
+	uint32_t x, y;
+	uint16_t left, top, width, height;
+	BOOL changed = FALSE;
+
+	rdtk_surface_fill(surface, 0, 0, TEST_WIDTH, TEST_HEIGHT, TEST_COLOR);
+	rdtk_surface_reset_dirty_rect(surface);
+
+	if (rdtk_font_draw_text(surface, nXDst, nYDst, NULL, text) < 0)
+		return FALSE;
+
+	if (!rdtk_surface_get_dirty_rect(surface, &left, &top, &width, &height))
+	{
+		printf("%s: no dirty rect after drawing \"%s\"\n", __FUNCTION__, text);
+		return FALSE;
+	}
+
+	if ((left + width > TEST_WIDTH) || (top + height > TEST_HEIGHT))
+		return FALSE;
+
+	/* every changed pixel lies within the dirty rect */
+	for (y = 0; y < TEST_HEIGHT; y++)
+	{
+		for (x = 0; x < TEST_WIDTH; x++)
+		{
+			uint32_t pixel;
+			memcpy(&pixel, &data[(y * TEST_WIDTH + x) * 4], sizeof(pixel));
+
+			if (pixel == TEST_COLOR)
+				continue;
+
+			if ((x < left) || (x >= left + width) || (y < top) || (y >= top + height))
+			{
+				printf("%s: pixel %" PRIu32 "x%" PRIu32 " outside the dirty rect\n",
+				       __FUNCTION__, x, y);
+				return FALSE;
+			}
+
+			changed = TRUE;
+		}
+	}
+
+	if (!changed)
+		return FALSE;
+
+	/* drawing again from the cache gives the same result */
+	memcpy(copy, data, TEST_WIDTH * TEST_HEIGHT * 4);
+	rdtk_surface_fill(surface, 0, 0, TEST_WIDTH, TEST_HEIGHT, TEST_COLOR);
+
+	if (rdtk_font_draw_text(surface, nXDst, nYDst, NULL, text) < 0)
+		return FALSE;
+
+	if (memcmp(copy, data, TEST_WIDTH * TEST_HEIGHT * 4) != 0)
+	{
+		printf("%s: cached run of \"%s\" differs\n", __FUNCTION__, text);
+		return FALSE;
+	}
+
+	rdtk_surface_reset_dirty_rect(surface);
+	return !rdtk_surface_get_dirty_rect(surface, &left, &top, &width, &height);
+}
+
+int TestRdTkFont(int argc, char* argv[])
+{
+	size_t x;
+	char text[32];
+	rdtkEngine* engine = NULL;
+	rdtkSurface* surface = NULL;
+	uint8_t* data = NULL;
+	uint8_t* copy = NULL;
+	int ret = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(data = calloc(TEST_HEIGHT, TEST_WIDTH * 4)) ||
+	    !(copy = calloc(TEST_HEIGHT, TEST_WIDTH * 4)))
+		goto out;
+
+	if (!(engine = rdtk_engine_new()))
+	{
+		printf("%s: error creating rdtk engine (%" PRIu32 ")\n", __FUNCTION__, GetLastError());
+		goto out;
+	}
+
+	if (!(surface = rdtk_surface_new(engine, data, TEST_WIDTH, TEST_HEIGHT, TEST_WIDTH * 4)))
+		goto out;
+
+	/* odd positions exercise the unaligned tail of the blend */
+	if (!test_draw(surface, "FreeRDP", 3, 5, data, copy) ||
+	    !test_draw(surface, "Welcome to the lobby!", 10, 20, data, copy))
+		goto out;
+
+	/* partially clipped at the right and bottom edges */
+	if (!test_draw(surface, "clipped", TEST_WIDTH - 20, TEST_HEIGHT - 6, data, copy))
+		goto out;
+
+	/* more strings than the cache holds */
+	for (x = 0; x < 40; x++)
+	{
+		sprintf_s(text, sizeof(text), "line %" PRIuz, x);
+
+		if (!test_draw(surface, text, (uint16_t)(x % 7), (uint16_t)(x % 11), data, copy))
+			goto out;
+	}
+
+	ret = 0;
+
+out:
+	if (ret != 0)
+		printf("%s: failed\n", __FUNCTION__);
+
+	rdtk_surface_free(surface);
+	rdtk_engine_free(engine);
+	free(data);
+	free(copy);
+	return ret;
+}
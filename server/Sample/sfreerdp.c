@@ -65,6 +65,7 @@ struct server_info
 	const char* replay_dump;
 	const char* cert;
 	const char* key;
+	freerdp_peer_reactor* reactor;
 };
 
 static void test_peer_context_free(freerdp_peer* client, rdpContext* ctx)
@@ -956,16 +957,11 @@ fail:
 	return -1;
 }
 
-static DWORD WINAPI test_peer_mainloop(LPVOID arg)
+static BOOL test_peer_setup(freerdp_peer* client)
 {
 	BOOL rc;
-	DWORD error = CHANNEL_RC_OK;
-	HANDLE handles[32] = { 0 };
-	DWORD count;
-	DWORD status;
 	testPeerContext* context;
 	struct server_info* info;
-	freerdp_peer* client = (freerdp_peer*)arg;
 
 	const char* key = "server.key";
 	const char* cert = "server.crt";
@@ -976,10 +972,7 @@ static DWORD WINAPI test_peer_mainloop(LPVOID arg)
 	WINPR_ASSERT(info);
 
 	if (!test_peer_init(client))
-	{
-		freerdp_peer_free(client);
-		return 0;
-	}
+		return FALSE;
 
 	if (info->key)
 		key = info->key;
@@ -993,18 +986,14 @@ static DWORD WINAPI test_peer_mainloop(LPVOID arg)
 		if (!freerdp_settings_set_bool(client->settings, FreeRDP_TransportDumpReplay, TRUE) ||
 		    !freerdp_settings_set_string(client->settings, FreeRDP_TransportDumpFile,
 		                                 info->replay_dump))
-		{
-			freerdp_peer_free(client);
-			return 0;
-		}
+			return FALSE;
 	}
 	if (!freerdp_settings_set_string(client->settings, FreeRDP_CertificateFile, cert) ||
 	    !freerdp_settings_set_string(client->settings, FreeRDP_PrivateKeyFile, key) ||
 	    !freerdp_settings_set_string(client->settings, FreeRDP_RdpKeyFile, key))
 	{
 		WLog_ERR(TAG, "Memory allocation failed (strdup)");
-		freerdp_peer_free(client);
-		return 0;
+		return FALSE;
 	}
 
 	client->settings->RdpSecurity = TRUE;
@@ -1054,6 +1043,113 @@ static DWORD WINAPI test_peer_mainloop(LPVOID arg)
 	}
 
 	WLog_INFO(TAG, "We've got a client %s", client->local ? "(local)" : client->hostname);
+	return TRUE;
+}
+
+static BOOL test_peer_check_channels(freerdp_peer* client)
+{
+	testPeerContext* context;
+
+	WINPR_ASSERT(client);
+
+	context = (testPeerContext*)client->context;
+	WINPR_ASSERT(context);
+
+	if (WTSVirtualChannelManagerCheckFileDescriptor(context->vcm) != TRUE)
+		return FALSE;
+
+	/* Handle dynamic virtual channel intializations */
+	if (WTSVirtualChannelManagerIsChannelJoined(context->vcm, DRDYNVC_SVC_CHANNEL_NAME))
+	{
+		switch (WTSVirtualChannelManagerGetDrdynvcState(context->vcm))
+		{
+			case DRDYNVC_STATE_NONE:
+				break;
+
+			case DRDYNVC_STATE_INITIALIZED:
+				break;
+
+			case DRDYNVC_STATE_READY:
+
+				/* Here is the correct state to start dynamic virtual channels */
+				if (sf_peer_audin_running(context) != context->audin_open)
+				{
+					if (!sf_peer_audin_running(context))
+						sf_peer_audin_start(context);
+					else
+						sf_peer_audin_stop(context);
+				}
+
+#if defined(CHANNEL_AINPUT_SERVER)
+				if (sf_peer_ainput_running(context) != context->ainput_open)
+				{
+					if (!sf_peer_ainput_running(context))
+						sf_peer_ainput_start(context);
+					else
+						sf_peer_ainput_stop(context);
+				}
+#endif
+
+				break;
+
+			case DRDYNVC_STATE_FAILED:
+			default:
+				break;
+		}
+	}
+
+	return TRUE;
+}
+
+static void test_peer_disconnected(freerdp_peer* client)
+{
+	WINPR_ASSERT(client);
+
+	WLog_INFO(TAG, "Client %s disconnected.", client->local ? "(local)" : client->hostname);
+
+	WINPR_ASSERT(client->Disconnect);
+	client->Disconnect(client);
+	freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+}
+
+static DWORD test_peer_reactor_get_event_handles(freerdp_peer* client, HANDLE* events,
+                                                 DWORD count)
+{
+	testPeerContext* context;
+
+	WINPR_ASSERT(client);
+
+	context = (testPeerContext*)client->context;
+	WINPR_ASSERT(context);
+
+	if (count < 1)
+		return 0;
+
+	events[0] = WTSVirtualChannelManagerGetEventHandle(context->vcm);
+	return 1;
+}
+
+static DWORD WINAPI test_peer_mainloop(LPVOID arg)
+{
+	DWORD error = CHANNEL_RC_OK;
+	HANDLE handles[32] = { 0 };
+	DWORD count;
+	DWORD status;
+	testPeerContext* context;
+	freerdp_peer* client = (freerdp_peer*)arg;
+
+	WINPR_ASSERT(client);
+
+	if (!test_peer_setup(client))
+	{
+		freerdp_peer_context_free(client);
+		freerdp_peer_free(client);
+		return 0;
+	}
+
+	context = (testPeerContext*)client->context;
+	WINPR_ASSERT(context);
 
 	while (error == CHANNEL_RC_OK)
 	{
@@ -1085,56 +1181,11 @@ static DWORD WINAPI test_peer_mainloop(LPVOID arg)
 		if (client->CheckFileDescriptor(client) != TRUE)
 			break;
 
-		if (WTSVirtualChannelManagerCheckFileDescriptor(context->vcm) != TRUE)
+		if (!test_peer_check_channels(client))
 			break;
-
-		/* Handle dynamic virtual channel intializations */
-		if (WTSVirtualChannelManagerIsChannelJoined(context->vcm, DRDYNVC_SVC_CHANNEL_NAME))
-		{
-			switch (WTSVirtualChannelManagerGetDrdynvcState(context->vcm))
-			{
-				case DRDYNVC_STATE_NONE:
-					break;
-
-				case DRDYNVC_STATE_INITIALIZED:
-					break;
-
-				case DRDYNVC_STATE_READY:
-
-					/* Here is the correct state to start dynamic virtual channels */
-					if (sf_peer_audin_running(context) != context->audin_open)
-					{
-						if (!sf_peer_audin_running(context))
-							sf_peer_audin_start(context);
-						else
-							sf_peer_audin_stop(context);
-					}
-
-#if defined(CHANNEL_AINPUT_SERVER)
-					if (sf_peer_ainput_running(context) != context->ainput_open)
-					{
-						if (!sf_peer_ainput_running(context))
-							sf_peer_ainput_start(context);
-						else
-							sf_peer_ainput_stop(context);
-					}
-#endif
-
-					break;
-
-				case DRDYNVC_STATE_FAILED:
-				default:
-					break;
-			}
-		}
 	}
 
-	WLog_INFO(TAG, "Client %s disconnected.", client->local ? "(local)" : client->hostname);
-
-	WINPR_ASSERT(client->Disconnect);
-	client->Disconnect(client);
-	freerdp_peer_context_free(client);
-	freerdp_peer_free(client);
+	test_peer_disconnected(client);
 	return error;
 }
 
@@ -1151,6 +1202,28 @@ static BOOL test_peer_accepted(freerdp_listener* instance, freerdp_peer* client)
 	info = instance->info;
 	client->ContextExtra = info;
 
+	/* all peers share the worker threads of the reactor */
+	if (info->reactor)
+	{
+		if (!test_peer_setup(client))
+		{
+			freerdp_peer_context_free(client);
+			return FALSE;
+		}
+
+		client->ReactorGetEventHandles = test_peer_reactor_get_event_handles;
+		client->ReactorCheckEvents = test_peer_check_channels;
+		client->ReactorRemoved = test_peer_disconnected;
+
+		if (!freerdp_peer_reactor_add(info->reactor, client))
+		{
+			freerdp_peer_context_free(client);
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
 	if (!(hThread = CreateThread(NULL, 0, test_peer_mainloop, (void*)client, 0, NULL)))
 		return FALSE;
 
@@ -1204,7 +1277,8 @@ static const struct
 	const char slocal_only[13];
 	const char scert[7];
 	const char skey[6];
-} options = { "--pcap=", "--fast", "--port=", "--local-only", "--cert=", "--key=" };
+	const char sreactor[10];
+} options = { "--pcap=", "--fast", "--port=", "--local-only", "--cert=", "--key=", "--reactor=" };
 
 static void print_entry(FILE* fp, const char* fmt, const char* what, size_t size)
 {
@@ -1226,6 +1300,8 @@ static WINPR_NORETURN(void usage(const char* app, const char* invalid))
 	print_entry(fp, "\t%s\n", options.sfast, sizeof(options.sfast));
 	print_entry(fp, "\t%s<port>\n", options.sport, sizeof(options.sport));
 	print_entry(fp, "\t%s\n", options.slocal_only, sizeof(options.slocal_only));
+	print_entry(fp, "\t%s<worker threads, 0 for one per processor>\n", options.sreactor,
+	            sizeof(options.sreactor));
 	exit(-1);
 }
 
@@ -1238,6 +1314,7 @@ int main(int argc, char* argv[])
 	char* file = NULL;
 	char name[MAX_PATH];
 	long port = 3389, i;
+	long workers = -1;
 	BOOL localOnly = FALSE;
 	struct server_info info = { 0 };
 	const char* app = argv[0];
@@ -1280,6 +1357,14 @@ int main(int argc, char* argv[])
 			if (!winpr_PathFileExists(info.key))
 				usage(app, arg);
 		}
+		else if (strncmp(arg, options.sreactor, sizeof(options.sreactor)) == 0)
+		{
+			const char* sworkers = &arg[sizeof(options.sreactor)];
+			workers = strtol(sworkers, NULL, 10);
+
+			if ((workers < 0) || (workers > UINT16_MAX) || (errno != 0))
+				usage(app, arg);
+		}
 		else
 			usage(app, arg);
 	}
@@ -1294,6 +1379,13 @@ int main(int argc, char* argv[])
 	instance->info = (void*)&info;
 	instance->PeerAccepted = test_peer_accepted;
 
+	if (workers >= 0)
+	{
+		info.reactor = freerdp_peer_reactor_new((DWORD)workers);
+		if (!info.reactor)
+			goto fail;
+	}
+
 	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
 		goto fail;
 
@@ -1324,6 +1416,7 @@ int main(int argc, char* argv[])
 
 	rc = 0;
 fail:
+	freerdp_peer_reactor_free(info.reactor);
 	free(file);
 	freerdp_listener_free(instance);
 	WSACleanup();
@@ -42,6 +42,9 @@ size_t server_audin_get_formats(AUDIO_FORMAT** dst_formats)
 	BYTE adpcm_dvi_data_1[] = { 0xf9, 0x01 };
 	BYTE gsm610_data[] = { 0x40, 0x01 };
 	const AUDIO_FORMAT default_supported_audio_formats[] = {
+		/* Opus, preferred when supported by both sides */
+		{ WAVE_FORMAT_OPUS, 1, 48000, 4000, 1, 16, 0, NULL },
+		{ WAVE_FORMAT_OPUS, 1, 16000, 2000, 1, 16, 0, NULL },
 		/* Formats sent by windows 10 server */
 		{ WAVE_FORMAT_AAC_MS, 2, 44100, 24000, 4, 16, 0, NULL },
 		{ WAVE_FORMAT_AAC_MS, 2, 44100, 20000, 4, 16, 0, NULL },
@@ -125,6 +128,7 @@ size_t server_rdpsnd_get_formats(AUDIO_FORMAT** dst_formats)
 	size_t x, y = 0;
 	/* Default supported audio formats */
 	static const AUDIO_FORMAT default_supported_audio_formats[] = {
+		{ WAVE_FORMAT_OPUS, 2, 48000, 12000, 1, 16, 0, NULL },
 		{ WAVE_FORMAT_AAC_MS, 2, 44100, 176400, 4, 16, 0, NULL },
 		{ WAVE_FORMAT_MPEGLAYER3, 2, 44100, 176400, 4, 16, 0, NULL },
 		{ WAVE_FORMAT_MSG723, 2, 44100, 176400, 4, 16, 0, NULL },
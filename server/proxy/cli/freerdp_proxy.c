@@ -20,6 +20,8 @@
  */
 
 #include <winpr/collections.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
 
 #include <freerdp/version.h>
 #include <freerdp/freerdp.h>
@@ -33,6 +35,8 @@
 #define TAG PROXY_TAG("server")
 
 static proxyServer* server = NULL;
+static HANDLE reloadEvent = NULL;
+static volatile BOOL reloadStop = FALSE;
 
 #if defined(_WIN32)
 static const char* strsignal(int signum)
@@ -59,6 +63,14 @@ static void cleanup_handler(int signum)
 	pf_server_stop(server);
 }
 
+#ifndef _WIN32
+static void reload_handler(int signum)
+{
+	WINPR_UNUSED(signum);
+	SetEvent(reloadEvent);
+}
+#endif
+
 static void pf_server_register_signal_handlers(void)
 {
 	signal(SIGINT, cleanup_handler);
@@ -66,9 +78,40 @@ static void pf_server_register_signal_handlers(void)
 #ifndef _WIN32
 	signal(SIGQUIT, cleanup_handler);
 	signal(SIGKILL, cleanup_handler);
+	signal(SIGHUP, reload_handler);
 #endif
 }
 
+/* loads the configuration file again whenever SIGHUP is received */
+static DWORD WINAPI pf_server_reload_thread(LPVOID arg)
+{
+	const char* config_path = arg;
+
+	while (WaitForSingleObject(reloadEvent, INFINITE) == WAIT_OBJECT_0)
+	{
+		proxyConfig* config;
+
+		ResetEvent(reloadEvent);
+
+		if (reloadStop)
+			break;
+
+		WLog_INFO(TAG, "reloading %s", config_path);
+		config = pf_server_config_load_file(config_path);
+		if (!config)
+		{
+			WLog_ERR(TAG, "failed to load %s, keeping the current configuration", config_path);
+			continue;
+		}
+
+		pf_server_config_print(config);
+		pf_server_reload(server, config);
+		pf_server_config_free(config);
+	}
+
+	return 0;
+}
+
 static WINPR_NORETURN(void usage(const char* app))
 {
 	printf("Usage:\n");
@@ -83,8 +126,13 @@ int main(int argc, char* argv[])
 {
 	proxyConfig* config = NULL;
 	char* config_path = "config.ini";
+	HANDLE reloadThread = NULL;
 	int status = -1;
 
+	reloadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!reloadEvent)
+		return -1;
+
 	pf_server_register_signal_handlers();
 
 	WLog_INFO(TAG, "freerdp-proxy version info:");
@@ -128,13 +176,26 @@ int main(int argc, char* argv[])
 	if (!pf_server_start(server))
 		goto fail;
 
+	reloadThread = CreateThread(NULL, 0, pf_server_reload_thread, config_path, 0, NULL);
+	if (!reloadThread)
+		goto fail;
+
 	if (!pf_server_run(server))
 		goto fail;
 
 	status = 0;
 
 fail:
+	if (reloadThread)
+	{
+		reloadStop = TRUE;
+		SetEvent(reloadEvent);
+		WaitForSingleObject(reloadThread, INFINITE);
+		CloseHandle(reloadThread);
+	}
+
 	pf_server_free(server);
+	CloseHandle(reloadEvent);
 
 	return status;
 }
@@ -23,6 +23,27 @@
 
 #include "cap_config.h"
 
+static BOOL capture_plugin_init_max_frames(captureConfig* config)
+{
+	char tmp[16] = { 0 };
+	unsigned long frames;
+	const DWORD nSize = GetEnvironmentVariableA("PROXY_CAPTURE_MAX_FRAMES", tmp, sizeof(tmp));
+
+	config->maxFrames = 2;
+
+	if ((nSize == 0) || (nSize >= sizeof(tmp)))
+		return nSize == 0;
+
+	errno = 0;
+	frames = strtoul(tmp, NULL, 0);
+
+	if ((errno != 0) || (frames == 0) || (frames > 64))
+		return FALSE;
+
+	config->maxFrames = frames;
+	return TRUE;
+}
+
 BOOL capture_plugin_init_config(captureConfig* config)
 {
 	const char* name = "PROXY_CAPTURE_TARGET";
@@ -87,7 +108,7 @@ BOOL capture_plugin_init_config(captureConfig* config)
 		config->port = 8889;
 	}
 
-	return TRUE;
+	return capture_plugin_init_max_frames(config);
 }
 
 void capture_plugin_config_free_internal(captureConfig* config)
@@ -23,6 +23,7 @@ typedef struct capture_config
 {
 	UINT16 port;
 	char* host;
+	size_t maxFrames; /* frames queued per session before the oldest is dropped */
 } captureConfig;
 
 BOOL capture_plugin_init_config(captureConfig* config);
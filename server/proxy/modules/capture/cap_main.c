@@ -30,13 +30,15 @@
 #include <freerdp/server/proxy/proxy_context.h>
 #include "cap_config.h"
 #include "cap_protocol.h"
+#include "cap_sender.h"
 
 #define TAG MODULE_TAG("capture")
 
 #define PLUGIN_NAME "capture"
 #define PLUGIN_DESC "stream egfx connections over tcp"
 
-#define BUFSIZE 8092
+/* time the backend gets to take the queued frames when the session ends */
+#define CAPTURE_CLOSE_TIMEOUT 5000
 
 static SOCKET capture_plugin_init_socket(const captureConfig* cconfig)
 {
@@ -65,70 +67,17 @@ static SOCKET capture_plugin_init_socket(const captureConfig* cconfig)
 	return sockfd;
 }
 
-static BOOL capture_plugin_send_data(SOCKET sockfd, const BYTE* buffer, size_t len)
+static captureSender* capture_plugin_get_sender(proxyPlugin* plugin, proxyData* pdata)
 {
-	int nsent;
-
-	if (!buffer)
-		return FALSE;
-
-	while (len > 0)
-	{
-		int chunk_len = len > BUFSIZE ? BUFSIZE : len;
-		nsent = _send(sockfd, (const char*)buffer, chunk_len, 0);
-		if (nsent == -1)
-			return FALSE;
-
-		buffer += nsent;
-		len -= nsent;
-	}
-
-	return TRUE;
-}
-
-static BOOL capture_plugin_send_packet(SOCKET sockfd, wStream* packet)
-{
-	size_t len;
-	BYTE* buffer;
-	BOOL result = FALSE;
-
-	if (!packet)
-		return FALSE;
-
-	buffer = Stream_Buffer(packet);
-	len = Stream_Capacity(packet);
-
-	if (!capture_plugin_send_data(sockfd, buffer, len))
-	{
-		WLog_ERR(TAG, "error while transmitting frame: errno=%d", errno);
-		goto error;
-	}
-
-	result = TRUE;
-
-error:
-	Stream_Free(packet, TRUE);
-	return result;
-}
-
-static SOCKET capture_plugin_get_socket(proxyPlugin* plugin, proxyData* pdata)
-{
-	void* custom;
-
 	WINPR_ASSERT(plugin);
 	WINPR_ASSERT(plugin->mgr);
 
-	custom = plugin->mgr->GetPluginData(plugin->mgr, PLUGIN_NAME, pdata);
-	if (!custom)
-		return -1;
-
-	return (SOCKET)custom;
+	return plugin->mgr->GetPluginData(plugin->mgr, PLUGIN_NAME, pdata);
 }
 
 static BOOL capture_plugin_session_end(proxyPlugin* plugin, proxyData* pdata, void* custom)
 {
-	SOCKET socket;
-	BOOL ret;
+	captureSender* sender;
 	wStream* s;
 
 	WINPR_ASSERT(pdata);
@@ -136,25 +85,22 @@ static BOOL capture_plugin_session_end(proxyPlugin* plugin, proxyData* pdata, vo
 	WINPR_ASSERT(plugin);
 	WINPR_ASSERT(plugin->mgr);
 
-	socket = capture_plugin_get_socket(plugin, pdata);
-	if (socket == INVALID_SOCKET)
+	sender = capture_plugin_get_sender(plugin, pdata);
+	if (!sender)
 		return FALSE;
 
-	s = capture_plugin_packet_new(SESSION_END_PDU_BASE_SIZE, MESSAGE_TYPE_SESSION_END);
-	if (!s)
-		return FALSE;
-
-	ret = capture_plugin_send_packet(socket, s);
+	plugin->mgr->SetPluginData(plugin->mgr, PLUGIN_NAME, pdata, NULL);
 
-	closesocket(socket);
-	return ret;
+	s = capture_plugin_packet_new(SESSION_END_PDU_BASE_SIZE, MESSAGE_TYPE_SESSION_END);
+	capture_sender_free(sender, s, CAPTURE_CLOSE_TIMEOUT);
+	return s != NULL;
 }
 
-static BOOL capture_plugin_send_frame(pClientContext* pc, SOCKET socket, const BYTE* buffer)
+static BOOL capture_plugin_send_frame(pClientContext* pc, captureSender* sender,
+                                      const BYTE* buffer)
 {
 	size_t frame_size;
-	BOOL ret = FALSE;
-	wStream* s = NULL;
+	BOOL ret;
 	BYTE* bmp_header = NULL;
 	rdpSettings* settings;
 
@@ -169,25 +115,10 @@ static BOOL capture_plugin_send_frame(pClientContext* pc, SOCKET socket, const B
 	if (!bmp_header)
 		return FALSE;
 
-	/*
-	 * capture frame packet indicates a packet that contains a frame buffer. payload length is
-	 * marked as 0, and receiving side must read `frame_size` bytes, a constant size of
-	 * width*height*(bpp/8) from the socket, to receive the full frame buffer.
-	 */
-	s = capture_plugin_packet_new(0, MESSAGE_TYPE_CAPTURED_FRAME);
-	if (!s)
-		goto error;
-
-	if (!capture_plugin_send_packet(socket, s))
-		goto error;
+	/* copied and sent by the sender thread, dropped if the backend falls behind */
+	ret = capture_sender_send_frame(sender, bmp_header, WINPR_IMAGE_BMP_HEADER_LEN, buffer,
+	                                frame_size);
 
-	ret = capture_plugin_send_data(socket, bmp_header, WINPR_IMAGE_BMP_HEADER_LEN);
-	if (!ret)
-		goto error;
-
-	ret = capture_plugin_send_data(socket, buffer, frame_size);
-
-error:
 	free(bmp_header);
 	return ret;
 }
@@ -196,7 +127,7 @@ static BOOL capture_plugin_client_end_paint(proxyPlugin* plugin, proxyData* pdat
 {
 	pClientContext* pc = pdata->pc;
 	rdpGdi* gdi = pc->context.gdi;
-	SOCKET socket;
+	captureSender* sender;
 
 	WINPR_ASSERT(pdata);
 	WINPR_ASSERT(custom);
@@ -209,11 +140,11 @@ static BOOL capture_plugin_client_end_paint(proxyPlugin* plugin, proxyData* pdat
 	if (gdi->primary->hdc->hwnd->ninvalid < 1)
 		return TRUE;
 
-	socket = capture_plugin_get_socket(plugin, pdata);
-	if (socket == INVALID_SOCKET)
+	sender = capture_plugin_get_sender(plugin, pdata);
+	if (!sender)
 		return FALSE;
 
-	if (!capture_plugin_send_frame(pc, socket, gdi->primary_buffer))
+	if (!capture_plugin_send_frame(pc, sender, gdi->primary_buffer))
 	{
 		WLog_ERR(TAG, "capture_plugin_send_frame failed!");
 		return FALSE;
@@ -227,6 +158,7 @@ static BOOL capture_plugin_client_end_paint(proxyPlugin* plugin, proxyData* pdat
 static BOOL capture_plugin_client_post_connect(proxyPlugin* plugin, proxyData* pdata, void* custom)
 {
 	captureConfig* cconfig;
+	captureSender* sender;
 	SOCKET socket;
 	wStream* s;
 
@@ -245,13 +177,21 @@ static BOOL capture_plugin_client_post_connect(proxyPlugin* plugin, proxyData* p
 		return FALSE;
 	}
 
-	plugin->mgr->SetPluginData(plugin->mgr, PLUGIN_NAME, pdata, (void*)socket);
+	sender = capture_sender_new(socket, cconfig->maxFrames);
+	if (!sender)
+	{
+		WLog_ERR(TAG, "failed to start the sender");
+		closesocket(socket);
+		return FALSE;
+	}
+
+	plugin->mgr->SetPluginData(plugin->mgr, PLUGIN_NAME, pdata, sender);
 
 	s = capture_plugin_create_session_info_packet(pdata->pc);
 	if (!s)
 		return FALSE;
 
-	return capture_plugin_send_packet(socket, s);
+	return capture_sender_send_packet(sender, s);
 }
 
 static BOOL capture_plugin_server_post_connect(proxyPlugin* plugin, proxyData* pdata, void* custom)
@@ -334,6 +274,7 @@ BOOL proxy_module_entry_point(proxyPluginsManager* plugins_manager, void* userda
 		return FALSE;
 	}
 
-	WLog_INFO(TAG, "host: %s, port: %" PRIu16 "", cconfig->host, cconfig->port);
+	WLog_INFO(TAG, "host: %s, port: %" PRIu16 ", queued frames: %" PRIuz "", cconfig->host,
+	          cconfig->port, cconfig->maxFrames);
 	return plugins_manager->RegisterPlugin(plugins_manager, &plugin);
 }
@@ -0,0 +1,423 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server Session Capture Module
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+
+#include <freerdp/types.h>
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "cap_protocol.h"
+#include "cap_sender.h"
+
+#define TAG MODULE_TAG("capture")
+
+/**
+ * The session thread only copies the frames into the queue, a thread per session sends them.
+ * Frames are full screen, so a backend falling behind only lowers the recorded frame rate:
+ * once maxFrames are queued the oldest one is dropped. Other packets are never dropped.
+ */
+
+/* a single write is at most this large */
+#define CAPTURE_SENDER_CHUNK_SIZE (256 * 1024)
+/* drops are logged at most once per interval */
+#define CAPTURE_SENDER_LOG_INTERVAL 5000
+
+struct capture_sender
+{
+	SOCKET sockfd;
+	HANDLE thread;
+	HANDLE event;
+	HANDLE drained;
+	CRITICAL_SECTION lock;
+
+	/* guarded by the lock */
+	wQueue* packets;
+	wStream** frames;
+	size_t head;
+	size_t count;
+	size_t maxFrames;
+	wStream* spare;
+	wStream* last;
+	BOOL stopping;
+	BOOL failed;
+	captureSenderStats stats;
+	UINT64 lastLogged;
+};
+
+static BOOL capture_sender_write(captureSender* sender, wStream* s)
+{
+	const BYTE* buffer = Stream_Buffer(s);
+	size_t len = Stream_GetPosition(s);
+
+	while (len > 0)
+	{
+		const int chunk = (int)MIN(len, CAPTURE_SENDER_CHUNK_SIZE);
+		const int nsent = _send(sender->sockfd, (const char*)buffer, chunk, 0);
+
+		if (nsent <= 0)
+		{
+			WLog_ERR(TAG, "error while transmitting frame: errno=%d", errno);
+			return FALSE;
+		}
+
+		buffer += nsent;
+		len -= (size_t)nsent;
+	}
+
+	return TRUE;
+}
+
+/* @return the next packet to send, control packets first, NULL if there is none */
+static wStream* capture_sender_next(captureSender* sender, BOOL* isFrame)
+{
+	wStream* s = Queue_Dequeue(sender->packets);
+
+	*isFrame = FALSE;
+
+	if (s)
+		return s;
+
+	if (sender->count > 0)
+	{
+		s = sender->frames[sender->head];
+		sender->head = (sender->head + 1) % sender->maxFrames;
+		sender->count--;
+		*isFrame = TRUE;
+		return s;
+	}
+
+	/* the last packet goes after everything else */
+	if (sender->stopping && sender->last)
+	{
+		s = sender->last;
+		sender->last = NULL;
+	}
+
+	return s;
+}
+
+static DWORD WINAPI capture_sender_thread(LPVOID arg)
+{
+	captureSender* sender = (captureSender*)arg;
+
+	WINPR_ASSERT(sender);
+
+	while (WaitForSingleObject(sender->event, INFINITE) == WAIT_OBJECT_0)
+	{
+		BOOL isFrame;
+		BOOL rc;
+		wStream* s;
+		size_t length;
+
+		EnterCriticalSection(&sender->lock);
+		s = capture_sender_next(sender, &isFrame);
+
+		if (!s)
+		{
+			ResetEvent(sender->event);
+
+			if (sender->stopping)
+			{
+				LeaveCriticalSection(&sender->lock);
+				break;
+			}
+		}
+
+		LeaveCriticalSection(&sender->lock);
+
+		if (!s)
+			continue;
+
+		length = Stream_GetPosition(s);
+		rc = capture_sender_write(sender, s);
+
+		EnterCriticalSection(&sender->lock);
+
+		if (rc)
+		{
+			sender->stats.bytesSent += length;
+
+			if (isFrame)
+				sender->stats.framesSent++;
+		}
+
+		/* keep one frame buffer around, frames all have the same size */
+		if (isFrame && !sender->spare)
+		{
+			sender->spare = s;
+			s = NULL;
+		}
+
+		sender->failed = !rc;
+		LeaveCriticalSection(&sender->lock);
+
+		Stream_Free(s, TRUE);
+
+		if (!rc)
+			break;
+	}
+
+	SetEvent(sender->drained);
+	return 0;
+}
+
+BOOL capture_sender_send_packet(captureSender* sender, wStream* packet)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(sender);
+
+	if (!packet)
+		return FALSE;
+
+	/* the packets are sent up to their position */
+	Stream_SetPosition(packet, Stream_Capacity(packet));
+
+	EnterCriticalSection(&sender->lock);
+
+	if (!sender->failed)
+		rc = Queue_Enqueue(sender->packets, packet);
+
+	if (rc)
+		SetEvent(sender->event);
+
+	LeaveCriticalSection(&sender->lock);
+
+	if (!rc)
+		Stream_Free(packet, TRUE);
+
+	return rc;
+}
+
+/* must be called with the lock held */
+static wStream* capture_sender_drop_oldest(captureSender* sender)
+{
+	wStream* s = sender->frames[sender->head];
+
+	sender->head = (sender->head + 1) % sender->maxFrames;
+	sender->count--;
+	sender->stats.framesDropped++;
+
+	if (GetTickCount64() - sender->lastLogged >= CAPTURE_SENDER_LOG_INTERVAL)
+	{
+		WLog_WARN(TAG,
+		          "capture backend falls behind, dropped %" PRIu64 " of %" PRIu64 " frames",
+		          sender->stats.framesDropped, sender->stats.framesQueued);
+		sender->lastLogged = GetTickCount64();
+	}
+
+	return s;
+}
+
+BOOL capture_sender_send_frame(captureSender* sender, const BYTE* header, size_t headerSize,
+                               const BYTE* frame, size_t frameSize)
+{
+	wStream* s;
+	const size_t size = HEADER_SIZE + headerSize + frameSize;
+
+	WINPR_ASSERT(sender);
+	WINPR_ASSERT(header);
+	WINPR_ASSERT(frame);
+
+	EnterCriticalSection(&sender->lock);
+
+	if (sender->failed)
+	{
+		LeaveCriticalSection(&sender->lock);
+		return FALSE;
+	}
+
+	s = sender->spare;
+	sender->spare = NULL;
+
+	/* reuse the buffer of the oldest queued frame */
+	if (!s && (sender->count == sender->maxFrames))
+		s = capture_sender_drop_oldest(sender);
+
+	LeaveCriticalSection(&sender->lock);
+
+	if (!s)
+		s = Stream_New(NULL, size);
+	else if (!Stream_EnsureCapacity(s, size))
+	{
+		Stream_Free(s, TRUE);
+		s = NULL;
+	}
+
+	if (!s)
+		return FALSE;
+
+	/*
+	 * capture frame packet indicates a packet that contains a frame buffer. payload length is
+	 * marked as 0, and receiving side must read `frame_size` bytes, a constant size of
+	 * width*height*(bpp/8) from the socket, to receive the full frame buffer.
+	 */
+	Stream_SetPosition(s, 0);
+	Stream_Write_UINT32(s, 0);
+	Stream_Write_UINT16(s, MESSAGE_TYPE_CAPTURED_FRAME);
+	Stream_Write(s, header, headerSize);
+	Stream_Write(s, frame, frameSize);
+
+	EnterCriticalSection(&sender->lock);
+
+	/* still full if the spare buffer was used, drop the oldest frame */
+	if (sender->count == sender->maxFrames)
+		Stream_Free(capture_sender_drop_oldest(sender), TRUE);
+
+	sender->frames[(sender->head + sender->count) % sender->maxFrames] = s;
+	sender->count++;
+	sender->stats.framesQueued++;
+	SetEvent(sender->event);
+	LeaveCriticalSection(&sender->lock);
+	return TRUE;
+}
+
+void capture_sender_get_stats(captureSender* sender, captureSenderStats* stats)
+{
+	WINPR_ASSERT(sender);
+	WINPR_ASSERT(stats);
+
+	EnterCriticalSection(&sender->lock);
+	*stats = sender->stats;
+	LeaveCriticalSection(&sender->lock);
+}
+
+static void capture_sender_stream_free(void* obj)
+{
+	Stream_Free((wStream*)obj, TRUE);
+}
+
+captureSender* capture_sender_new(SOCKET sockfd, size_t maxFrames)
+{
+	wObject* obj;
+	captureSender* sender;
+
+	WINPR_ASSERT(maxFrames > 0);
+
+	sender = calloc(1, sizeof(captureSender));
+	if (!sender)
+		return NULL;
+
+	sender->sockfd = sockfd;
+	sender->maxFrames = maxFrames;
+
+	if (!InitializeCriticalSectionAndSpinCount(&sender->lock, 4000))
+	{
+		free(sender);
+		return NULL;
+	}
+
+	sender->frames = calloc(maxFrames, sizeof(wStream*));
+	if (!sender->frames)
+		goto fail;
+
+	sender->packets = Queue_New(FALSE, -1, -1);
+	if (!sender->packets)
+		goto fail;
+
+	obj = Queue_Object(sender->packets);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = capture_sender_stream_free;
+
+	sender->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!sender->event)
+		goto fail;
+
+	sender->drained = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!sender->drained)
+		goto fail;
+
+	sender->thread = CreateThread(NULL, 0, capture_sender_thread, sender, 0, NULL);
+	if (!sender->thread)
+		goto fail;
+
+	return sender;
+
+fail:
+	/* the caller keeps the socket when failing */
+	sender->sockfd = INVALID_SOCKET;
+	capture_sender_free(sender, NULL, 0);
+	return NULL;
+}
+
+void capture_sender_free(captureSender* sender, wStream* last, DWORD timeout)
+{
+	size_t x;
+
+	if (!sender)
+	{
+		Stream_Free(last, TRUE);
+		return;
+	}
+
+	if (last)
+		Stream_SetPosition(last, Stream_Capacity(last));
+
+	if (sender->thread)
+	{
+		EnterCriticalSection(&sender->lock);
+		sender->last = last;
+		sender->stopping = TRUE;
+		SetEvent(sender->event);
+		LeaveCriticalSection(&sender->lock);
+
+		/* unblock a send to a stalled backend */
+		if (WaitForSingleObject(sender->drained, timeout) != WAIT_OBJECT_0)
+		{
+			WLog_WARN(TAG, "capture backend did not take the queued packets in time");
+			_shutdown(sender->sockfd, SD_BOTH);
+		}
+
+		WaitForSingleObject(sender->thread, INFINITE);
+		CloseHandle(sender->thread);
+
+		WLog_INFO(TAG,
+		          "capture sent %" PRIu64 " of %" PRIu64 " frames, dropped %" PRIu64
+		          ", %" PRIu64 " bytes",
+		          sender->stats.framesSent, sender->stats.framesQueued,
+		          sender->stats.framesDropped, sender->stats.bytesSent);
+	}
+	else
+		Stream_Free(last, TRUE);
+
+	Stream_Free(sender->last, TRUE);
+	Stream_Free(sender->spare, TRUE);
+
+	for (x = 0; x < sender->count; x++)
+		Stream_Free(sender->frames[(sender->head + x) % sender->maxFrames], TRUE);
+
+	free(sender->frames);
+	Queue_Free(sender->packets);
+
+	if (sender->drained)
+		CloseHandle(sender->drained);
+
+	if (sender->event)
+		CloseHandle(sender->event);
+
+	if (sender->sockfd != INVALID_SOCKET)
+		closesocket(sender->sockfd);
+
+	DeleteCriticalSection(&sender->lock);
+	free(sender);
+}
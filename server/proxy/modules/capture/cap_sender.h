@@ -0,0 +1,58 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server Session Capture Module
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/stream.h>
+#include <winpr/winsock.h>
+
+typedef struct capture_sender captureSender;
+
+typedef struct
+{
+	UINT64 framesQueued;
+	UINT64 framesSent;
+	UINT64 framesDropped; /* replaced by a newer frame before they were sent */
+	UINT64 bytesSent;
+} captureSenderStats;
+
+/**
+ * @brief capture_sender_new Starts the thread sending the packets of a session
+ * @param sockfd The connected socket, owned by the sender
+ * @param maxFrames The number of frames queued before the oldest is dropped
+ */
+captureSender* capture_sender_new(SOCKET sockfd, size_t maxFrames);
+
+/**
+ * @brief capture_sender_free Sends what is queued and last, waiting at most timeout ms for a
+ * stalled backend, and closes the socket
+ */
+void capture_sender_free(captureSender* sender, wStream* last, DWORD timeout);
+
+/**
+ * @brief capture_sender_send_packet Queues a packet that is never dropped
+ * @param packet Owned by the sender
+ * @return FALSE if the backend is gone
+ */
+BOOL capture_sender_send_packet(captureSender* sender, wStream* packet);
+
+/**
+ * @brief capture_sender_send_frame Queues a copy of a frame with its bitmap header
+ * @return FALSE if the backend is gone
+ */
+BOOL capture_sender_send_frame(captureSender* sender, const BYTE* header, size_t headerSize,
+                               const BYTE* frame, size_t frameSize);
+
+void capture_sender_get_stats(captureSender* sender, captureSenderStats* stats);
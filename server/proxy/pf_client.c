@@ -28,12 +28,14 @@
 #include <freerdp/client/cmdline.h>
 
 #include <freerdp/server/proxy/proxy_log.h>
+#include <freerdp/server/proxy/proxy_server.h>
 #include <freerdp/channels/drdynvc.h>
 #include <freerdp/channels/encomsp.h>
 #include <freerdp/channels/rdpdr.h>
 #include <freerdp/channels/rdpsnd.h>
 #include <freerdp/channels/cliprdr.h>
 #include <freerdp/channels/channels.h>
+#include <freerdp/transport_io.h>
 
 #include "pf_client.h"
 #include <freerdp/server/proxy/proxy_context.h>
@@ -41,13 +43,14 @@
 #include "pf_input.h"
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
+#include "pf_server.h"
 #include "pf_utils.h"
+#include "pf_qos.h"
 #include "channels/pf_channel_rdpdr.h"
 #include "channels/pf_channel_smartcard.h"
 
 #define TAG PROXY_TAG("client")
 
-static void channel_data_free(void* obj);
 static BOOL proxy_server_reactivate(rdpContext* ps, const rdpContext* pc)
 {
 	WINPR_ASSERT(ps);
@@ -227,6 +230,71 @@ static BOOL freerdp_client_load_static_channel_addin(rdpChannels* channels, rdpS
 	return FALSE;
 }
 
+/* connects with a socket of the target pool if it has one, like with the default otherwise */
+static int pf_client_tcp_connect(rdpContext* context, rdpSettings* settings, const char* hostname,
+                                 int port, DWORD timeout)
+{
+	int sockfd = -1;
+	pClientContext* pc = (pClientContext*)context;
+	pServerContext* ps;
+	proxyServer* server;
+
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
+	WINPR_ASSERT(pc->client_tcp_connect_original);
+	ps = pc->pdata->ps;
+	WINPR_ASSERT(ps);
+	WINPR_ASSERT(ps->context.peer);
+	server = (proxyServer*)ps->context.peer->ContextExtra;
+	WINPR_ASSERT(server);
+
+	/* '/' is a local socket, '|' an external one */
+	if (!hostname || (hostname[0] == '/') || (hostname[0] == '|') || (port <= 0) ||
+	    (port > UINT16_MAX) || freerdp_settings_get_bool(settings, FreeRDP_GatewayEnabled))
+		return pc->client_tcp_connect_original(context, settings, hostname, port, timeout);
+
+	if (server->targets)
+	{
+		sockfd = pf_target_pool_take(server->targets, hostname, (UINT16)port);
+
+		if (sockfd >= 0)
+		{
+			PROXY_LOG_DBG(TAG, pc, "using a pooled connection to %s:%d", hostname, port);
+			sockfd = pc->client_tcp_connect_original(context, settings, "|", sockfd, timeout);
+		}
+	}
+
+	if (sockfd < 0)
+		sockfd = pc->client_tcp_connect_original(context, settings, hostname, port, timeout);
+
+	/* the farms skip targets that can not be reached */
+	if (server->farms)
+		pf_target_resolver_report(server->farms, hostname, (UINT16)port, sockfd >= 0);
+
+	return sockfd;
+}
+
+static BOOL pf_client_register_tcp_connect(pClientContext* pc)
+{
+	rdpTransportIo io;
+	const rdpTransportIo* current;
+
+	WINPR_ASSERT(pc);
+
+	current = freerdp_get_io_callbacks(&pc->context);
+	if (!current)
+		return FALSE;
+
+	/* called again when falling back to TLS, keep the original of the first call */
+	if (current->TCPConnect == pf_client_tcp_connect)
+		return TRUE;
+
+	io = *current;
+	pc->client_tcp_connect_original = io.TCPConnect;
+	io.TCPConnect = pf_client_tcp_connect;
+	return freerdp_set_io_callbacks(&pc->context, &io);
+}
+
 static BOOL pf_client_pre_connect(freerdp* instance)
 {
 	pClientContext* pc;
@@ -256,6 +324,10 @@ static BOOL pf_client_pre_connect(freerdp* instance)
 	settings->GlyphSupportLevel = GLYPH_SUPPORT_NONE;
 	ZeroMemory(settings->OrderSupport, 32);
 
+	/* a retry without NLA counts to the first attempt */
+	if (pc->pdata->client_connect_start_us == 0)
+		pc->pdata->client_connect_start_us = metrics_get_time_us();
+
 	if (WTSVirtualChannelManagerIsChannelJoined(ps->vcm, DRDYNVC_SVC_CHANNEL_NAME))
 		settings->SupportDynamicChannels = TRUE;
 
@@ -311,6 +383,12 @@ static BOOL pf_client_pre_connect(freerdp* instance)
 	if (!pf_client_use_peer_load_balance_info(pc))
 		return FALSE;
 
+	if (!pf_client_register_tcp_connect(pc))
+	{
+		PROXY_LOG_ERR(TAG, pc, "Failed to register the target connect hook");
+		return FALSE;
+	}
+
 	if (!pf_client_load_rdpsnd(pc))
 	{
 		PROXY_LOG_ERR(TAG, pc, "Failed to load rdpsnd client");
@@ -474,6 +552,13 @@ static BOOL pf_client_receive_channel_passthrough(proxyData* pdata,
 	 * so just drop the message. */
 	if (server_channel_id == 0)
 		return TRUE;
+
+	if (ps->qos)
+	{
+		ev.channel_id = server_channel_id;
+		return pf_qos_send(ps->qos, &ev);
+	}
+
 	return ps->context.peer->SendChannelPacket(ps->context.peer, server_channel_id, totalSize,
 	                                           flags, xdata, xsize);
 }
@@ -554,11 +639,51 @@ static BOOL pf_client_on_server_heartbeat(freerdp* instance, BYTE period, BYTE c
 	return freerdp_heartbeat_send_heartbeat_pdu(ps->context.peer, period, count1, count2);
 }
 
+static BOOL pf_client_send_channel_packet(pClientContext* pc, const proxyChannelDataEventInfo* ev)
+{
+	UINT16 channelId;
+
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(ev);
+	WINPR_ASSERT(pc->context.instance);
+
+	channelId = freerdp_channels_get_id_by_name(pc->context.instance, ev->channel_name);
+	/* Ignore unmappable channels */
+	if ((channelId == 0) || (channelId == UINT16_MAX))
+		return TRUE;
+
+	WINPR_ASSERT(pc->context.instance->SendChannelPacket);
+	return pc->context.instance->SendChannelPacket(pc->context.instance, channelId, ev->total_size,
+	                                               ev->flags, ev->data, ev->data_len);
+}
+
+static BOOL pf_client_qos_send(void* context, const proxyChannelDataEventInfo* ev)
+{
+	return pf_client_send_channel_packet((pClientContext*)context, ev);
+}
+
+static BOOL pf_client_send_channel_event(pClientContext* pc, const proxyChannelDataEventInfo* ev)
+{
+	WINPR_ASSERT(pc);
+
+	if (pc->qos)
+		return pf_qos_send(pc->qos, ev);
+
+	return pf_client_send_channel_packet(pc, ev);
+}
+
 static BOOL pf_client_send_channel_data(pClientContext* pc, const proxyChannelDataEventInfo* ev)
 {
 	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
 	WINPR_ASSERT(ev);
 
+	/* Once the connect thread finished both connections are driven by the same thread, the
+	 * fragment is passed through without a copy unless older ones are still queued. */
+	if (pc->connected && !pc->pdata->client_thread &&
+	    (Queue_Count(pc->cached_server_channel_data) == 0))
+		return pf_client_send_channel_event(pc, ev);
+
 	return Queue_Enqueue(pc->cached_server_channel_data, ev);
 }
 
@@ -575,21 +700,8 @@ static BOOL sendQueuedChannelData(pClientContext* pc)
 		Queue_Lock(pc->cached_server_channel_data);
 		while (rc && (ev = Queue_Dequeue(pc->cached_server_channel_data)))
 		{
-			UINT16 channelId;
-			WINPR_ASSERT(pc->context.instance);
-
-			channelId = freerdp_channels_get_id_by_name(pc->context.instance, ev->channel_name);
-			/* Ignore unmappable channels */
-			if ((channelId == 0) || (channelId == UINT16_MAX))
-				rc = TRUE;
-			else
-			{
-				WINPR_ASSERT(pc->context.instance->SendChannelPacket);
-				rc = pc->context.instance->SendChannelPacket(pc->context.instance, channelId,
-				                                             ev->total_size, ev->flags, ev->data,
-				                                             ev->data_len);
-			}
-			channel_data_free(ev);
+			rc = pf_client_send_channel_event(pc, ev);
+			pf_utils_channel_data_free(ev);
 		}
 
 		Queue_Unlock(pc->cached_server_channel_data);
@@ -631,6 +743,8 @@ static BOOL pf_client_post_connect(freerdp* instance)
 	config = pc->pdata->config;
 	WINPR_ASSERT(config);
 
+	pc->pdata->client_connect_us = metrics_get_time_us() - pc->pdata->client_connect_start_us;
+
 	if (!pf_modules_run_hook(pc->pdata->module, HOOK_TYPE_CLIENT_POST_CONNECT, pc->pdata, pc))
 		return FALSE;
 
@@ -641,6 +755,21 @@ static BOOL pf_client_post_connect(freerdp* instance)
 
 	pf_client_register_update_callbacks(update);
 
+	if (config->QoS && !pc->qos)
+	{
+		pc->qos = pf_qos_new(config, pf_client_qos_send, pc);
+		if (!pc->qos)
+			return FALSE;
+	}
+
+	/* without a plugin looking at the frames the graphics updates are not parsed */
+	if (!pf_modules_has_graphics_hooks(pc->pdata->module) &&
+	    freerdp_settings_get_bool(ps->settings, FreeRDP_FastPathOutput))
+	{
+		WLog_INFO(TAG, "graphics cut-through enabled");
+		pf_client_register_cut_through(update);
+	}
+
 	/* virtual channels receive data hook */
 	pc->client_receive_channel_data_original = instance->ReceiveChannelData;
 	instance->ReceiveChannelData = pf_client_receive_channel_data_hook;
@@ -843,17 +972,12 @@ out:
 }
 
 /**
- * RDP main loop.
- * Connects RDP, loops while running and handles event and dispatch, cleans up
- * after the connection ends.
+ * Connects RDP, the proxy's worker handles event and dispatch once connected.
  */
-static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
+static BOOL pf_client_connect_session(pClientContext* pc)
 {
 	freerdp* instance;
 	proxyData* pdata;
-	DWORD nCount = 0;
-	DWORD status;
-	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
 
 	WINPR_ASSERT(pc);
 
@@ -862,14 +986,6 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 
 	pdata = pc->pdata;
 	WINPR_ASSERT(pdata);
-	/*
-	 * during redirection, freerdp's abort event might be overriden (reset) by the library, after
-	 * the server set it in order to shutdown the connection. it means that the server might signal
-	 * the client to abort, but the library code will override the signal and the client will
-	 * continue its work instead of exiting. That's why the client must wait on `pdata->abort_event`
-	 * too, which will never be modified by the library.
-	 */
-	handles[nCount++] = pdata->abort_event;
 
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_INIT_CONNECT, pdata, pc))
 	{
@@ -882,53 +998,97 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 		proxy_data_abort_connect(pdata);
 		return FALSE;
 	}
+
+	return TRUE;
+}
+
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* handles, DWORD count)
+{
+	DWORD nCount = 0;
+	DWORD tmp;
+
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(handles);
+
+	/*
+	 * during redirection, freerdp's abort event might be overriden (reset) by the library, after
+	 * the server set it in order to shutdown the connection. it means that the server might signal
+	 * the client to abort, but the library code will override the signal and the client will
+	 * continue its work instead of exiting. That's why the caller must wait on
+	 * `pdata->abort_event` too, which will never be modified by the library.
+	 */
+	if (count < 1)
+		return 0;
+
 	handles[nCount++] = Queue_Event(pc->cached_server_channel_data);
 
-	while (!freerdp_shall_disconnect(instance))
+	if (pc->qos)
 	{
-		UINT32 tmp = freerdp_get_event_handles(instance->context, &handles[nCount],
-		                                       ARRAYSIZE(handles) - nCount);
+		if (count - nCount < 1)
+			return 0;
+		handles[nCount++] = pf_qos_get_event_handle(pc->qos);
+	}
 
-		if (tmp == 0)
-		{
-			PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
-			break;
-		}
+	tmp = freerdp_get_event_handles(&pc->context, &handles[nCount], count - nCount);
+
+	if (tmp == 0)
+	{
+		PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
+		return 0;
+	}
 
-		status = WaitForMultipleObjects(nCount + tmp, handles, FALSE, INFINITE);
+	return nCount + tmp;
+}
 
-		if (status == WAIT_FAILED)
-		{
-			WLog_ERR(TAG, "%s: WaitForMultipleObjects failed with %" PRIu32 "", __FUNCTION__,
-			         status);
-			break;
-		}
+BOOL pf_client_check_event_handles(pClientContext* pc)
+{
+	freerdp* instance;
+	proxyData* pdata;
 
-		/* abort_event triggered */
-		if (status == WAIT_OBJECT_0)
-			break;
+	WINPR_ASSERT(pc);
 
-		if (freerdp_shall_disconnect(instance))
-			break;
+	instance = pc->context.instance;
+	WINPR_ASSERT(instance);
 
-		if (proxy_data_shall_disconnect(pdata))
-			break;
+	pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
 
-		if (!freerdp_check_event_handles(instance->context))
-		{
-			if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
-				WLog_ERR(TAG, "Failed to check FreeRDP event handles");
+	if (freerdp_shall_disconnect(instance))
+		return FALSE;
 
-			break;
-		}
-		sendQueuedChannelData(pc);
+	if (proxy_data_shall_disconnect(pdata))
+		return FALSE;
+
+	if (!freerdp_check_event_handles(instance->context))
+	{
+		if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
+			WLog_ERR(TAG, "Failed to check FreeRDP event handles");
+
+		return FALSE;
 	}
 
-	freerdp_disconnect(instance);
+	sendQueuedChannelData(pc);
+
+	if (pc->qos && !pf_qos_flush(pc->qos))
+		return FALSE;
+
+	return TRUE;
+}
+
+void pf_client_disconnect(pClientContext* pc)
+{
+	proxyData* pdata;
+
+	WINPR_ASSERT(pc);
+
+	pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+
+	freerdp_disconnect(pc->context.instance);
 
 	pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_UNINIT_CONNECT, pdata, pc);
 
-	return 0;
+	freerdp_client_stop(&pc->context);
 }
 
 static int pf_logon_error_info(freerdp* instance, UINT32 data, UINT32 type)
@@ -953,6 +1113,7 @@ static void pf_client_context_free(freerdp* instance, rdpContext* context)
 
 	pc->sendChannelData = NULL;
 	Queue_Free(pc->cached_server_channel_data);
+	pf_qos_free(pc->qos);
 	Stream_Free(pc->remote_pem, TRUE);
 	free(pc->remote_hostname);
 	free(pc->computerName.v);
@@ -993,46 +1154,6 @@ static int pf_client_verify_X509_certificate(freerdp* instance, const BYTE* data
 	return 1;
 }
 
-void channel_data_free(void* obj)
-{
-	proxyChannelDataEventInfo* dst = obj;
-	if (dst)
-	{
-		free((void*)dst->data);
-		free((void*)dst->channel_name);
-		free(dst);
-	}
-}
-
-static void* channel_data_copy(const void* obj)
-{
-	const proxyChannelDataEventInfo* src = obj;
-	proxyChannelDataEventInfo* dst;
-
-	WINPR_ASSERT(src);
-
-	dst = calloc(1, sizeof(proxyChannelDataEventInfo));
-	if (!dst)
-		goto fail;
-
-	*dst = *src;
-	if (src->channel_name)
-	{
-		dst->channel_name = _strdup(src->channel_name);
-		if (!dst->channel_name)
-			goto fail;
-	}
-	dst->data = malloc(src->data_len);
-	if (!dst->data)
-		goto fail;
-	memcpy((void*)dst->data, src->data, src->data_len);
-	return dst;
-
-fail:
-	channel_data_free(dst);
-	return NULL;
-}
-
 static BOOL pf_client_client_new(freerdp* instance, rdpContext* context)
 {
 	wObject* obj;
@@ -1058,8 +1179,8 @@ static BOOL pf_client_client_new(freerdp* instance, rdpContext* context)
 		return FALSE;
 	obj = Queue_Object(pc->cached_server_channel_data);
 	WINPR_ASSERT(obj);
-	obj->fnObjectNew = channel_data_copy;
-	obj->fnObjectFree = channel_data_free;
+	obj->fnObjectNew = pf_utils_channel_data_copy;
+	obj->fnObjectFree = pf_utils_channel_data_free;
 
 	pc->interceptContextMap = HashTable_New(FALSE);
 	if (!pc->interceptContextMap)
@@ -1107,16 +1228,18 @@ int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
 }
 
 /**
- * Starts running a client connection towards target server.
+ * Starts a client connection towards target server, to be run in it's own thread.
+ * Returns 0 once connected, the connection is then driven with pf_client_check_event_handles
+ * and ended with pf_client_disconnect.
  */
 DWORD WINAPI pf_client_start(LPVOID arg)
 {
-	DWORD rc = 1;
 	pClientContext* pc = (pClientContext*)arg;
 
 	WINPR_ASSERT(pc);
-	if (freerdp_client_start(&pc->context) == 0)
-		rc = pf_client_thread_proc(pc);
+	if ((freerdp_client_start(&pc->context) == 0) && pf_client_connect_session(pc))
+		return 0;
+
 	freerdp_client_stop(&pc->context);
-	return rc;
+	return 1;
 }
@@ -25,7 +25,13 @@
 #include <freerdp/freerdp.h>
 #include <winpr/wtypes.h>
 
+#include <freerdp/server/proxy/proxy_context.h>
+
 int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints);
 DWORD WINAPI pf_client_start(LPVOID arg);
 
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* handles, DWORD count);
+BOOL pf_client_check_event_handles(pClientContext* pc);
+void pf_client_disconnect(pClientContext* pc);
+
 #endif /* FREERDP_SERVER_PROXY_PFCLIENT_H */
@@ -168,6 +168,7 @@ static const char* pf_config_get_str(wIniFile* ini, const char* section, const c
 static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 {
 	const char* host;
+	const char* affinity;
 
 	WINPR_ASSERT(config);
 	host = pf_config_get_str(ini, "Server", "Host", FALSE);
@@ -183,12 +184,34 @@ static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 	if (!pf_config_get_uint16(ini, "Server", "Port", &config->Port, TRUE))
 		return FALSE;
 
+	if (!pf_config_get_uint32(ini, "Server", "Workers", &config->Workers, FALSE))
+		return FALSE;
+
+	if (!pf_config_get_uint32(ini, "Server", "MaxHandshakes", &config->MaxHandshakes, FALSE))
+		return FALSE;
+
+	config->HandshakeTimeout = 10000;
+
+	if (IniFile_GetKeyValueString(ini, "Server", "HandshakeTimeout") &&
+	    !pf_config_get_uint32(ini, "Server", "HandshakeTimeout", &config->HandshakeTimeout, FALSE))
+		return FALSE;
+
+	affinity = pf_config_get_str(ini, "Server", "ThreadAffinity", FALSE);
+
+	if (affinity && (strlen(affinity) > 0) &&
+	    !winpr_ParseProcessorMask(affinity, &config->ThreadAffinity))
+	{
+		WLog_ERR(TAG, "invalid ThreadAffinity %s, expected a cpu list or node:<n>", affinity);
+		return FALSE;
+	}
+
 	return TRUE;
 }
 
 static BOOL pf_config_load_target(wIniFile* ini, proxyConfig* config)
 {
 	const char* target_host;
+	const char* farm_file;
 
 	WINPR_ASSERT(config);
 	config->FixedTarget = pf_config_get_bool(ini, "Target", "FixedTarget", FALSE);
@@ -205,6 +228,41 @@ static BOOL pf_config_load_target(wIniFile* ini, proxyConfig* config)
 	if (!config->TargetHost)
 		return FALSE;
 
+	if (!pf_config_get_uint32(ini, "Target", "PoolSize", &config->TargetPoolSize, FALSE))
+		return FALSE;
+
+	config->TargetPoolIdleTimeout = 30;
+	if (IniFile_GetKeyValueString(ini, "Target", "PoolIdleTimeout"))
+	{
+		if (!pf_config_get_uint32(ini, "Target", "PoolIdleTimeout",
+		                          &config->TargetPoolIdleTimeout, FALSE))
+			return FALSE;
+	}
+
+	farm_file = pf_config_get_str(ini, "Target", "FarmFile", FALSE);
+	if (farm_file && (farm_file[0] != '\0'))
+	{
+		config->FarmFile = _strdup(farm_file);
+		if (!config->FarmFile)
+			return FALSE;
+	}
+
+	config->FarmRefreshInterval = 10;
+	if (IniFile_GetKeyValueString(ini, "Target", "FarmRefreshInterval"))
+	{
+		if (!pf_config_get_uint32(ini, "Target", "FarmRefreshInterval",
+		                          &config->FarmRefreshInterval, FALSE))
+			return FALSE;
+	}
+
+	config->FarmStickyTimeout = 600;
+	if (IniFile_GetKeyValueString(ini, "Target", "FarmStickyTimeout"))
+	{
+		if (!pf_config_get_uint32(ini, "Target", "FarmStickyTimeout",
+		                          &config->FarmStickyTimeout, FALSE))
+			return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -285,6 +343,54 @@ static BOOL pf_config_load_gfx_settings(wIniFile* ini, proxyConfig* config)
 {
 	WINPR_ASSERT(config);
 	config->DecodeGFX = pf_config_get_bool(ini, "GFXSettings", "DecodeGFX", FALSE);
+
+	/* the dynamic channels, and with them the graphics pipeline, are passed through as is */
+	if (config->DecodeGFX && pf_utils_is_passthrough(config))
+		WLog_WARN(TAG, "[GFXSettings] DecodeGFX is deprecated, the graphics pipeline is "
+		               "passed through to the client");
+
+	return TRUE;
+}
+
+static BOOL pf_config_load_qos(wIniFile* ini, proxyConfig* config)
+{
+	WINPR_ASSERT(config);
+	config->QoS = pf_config_get_bool(ini, "QoS", "Enabled", FALSE);
+
+	if (!pf_config_get_uint32(ini, "QoS", "GraphicsRate", &config->QoSGraphicsRate, FALSE))
+		return FALSE;
+	if (!pf_config_get_uint32(ini, "QoS", "AudioRate", &config->QoSAudioRate, FALSE))
+		return FALSE;
+	if (!pf_config_get_uint32(ini, "QoS", "BulkRate", &config->QoSBulkRate, FALSE))
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL pf_config_load_metrics(wIniFile* ini, proxyConfig* config)
+{
+	UINT32 port = 0;
+	const char* host;
+
+	WINPR_ASSERT(config);
+
+	/* 0 is valid here, it disables the endpoint */
+	if (!pf_config_get_uint32(ini, "Metrics", "Port", &port, FALSE))
+		return FALSE;
+
+	if (port > UINT16_MAX)
+	{
+		WLog_ERR(TAG, "[%s]: invalid value %" PRIu32 " for key 'Metrics.Port'.", __FUNCTION__,
+		         port);
+		return FALSE;
+	}
+
+	config->MetricsPort = (UINT16)port;
+
+	host = pf_config_get_str(ini, "Metrics", "Host", FALSE);
+	config->MetricsHost = _strdup(host ? host : "127.0.0.1");
+	if (!config->MetricsHost)
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -432,6 +538,12 @@ proxyConfig* server_config_load_ini(wIniFile* ini)
 		if (!pf_config_load_gfx_settings(ini, config))
 			goto out;
 
+		if (!pf_config_load_qos(ini, config))
+			goto out;
+
+		if (!pf_config_load_metrics(ini, config))
+			goto out;
+
 		if (!pf_config_load_certificates(ini, config))
 			goto out;
 	}
@@ -453,6 +565,14 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueInt(ini, "Server", "Port", 3389) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Server", "Workers", 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Server", "MaxHandshakes", 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Server", "HandshakeTimeout", 10000) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueString(ini, "Server", "ThreadAffinity", "") < 0)
+		goto fail;
 
 	/* Target configuration */
 	if (IniFile_SetKeyValueString(ini, "Target", "Host", "somehost.example.com") < 0)
@@ -461,6 +581,16 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueString(ini, "Target", "FixedTarget", "true") < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Target", "PoolSize", 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Target", "PoolIdleTimeout", 30) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueString(ini, "Target", "FarmFile", "") < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Target", "FarmRefreshInterval", 10) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Target", "FarmStickyTimeout", 600) < 0)
+		goto fail;
 
 	/* Channel configuration */
 	if (IniFile_SetKeyValueString(ini, "Channels", "GFX", "true") < 0)
@@ -530,6 +660,22 @@ BOOL pf_server_config_dump(const char* file)
 	if (IniFile_SetKeyValueString(ini, "GFXSettings", "DecodeGFX", "false") < 0)
 		goto fail;
 
+	/* QoS configuration */
+	if (IniFile_SetKeyValueString(ini, "QoS", "Enabled", "false") < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "QoS", "GraphicsRate", 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "QoS", "AudioRate", 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "QoS", "BulkRate", 0) < 0)
+		goto fail;
+
+	/* Metrics configuration */
+	if (IniFile_SetKeyValueString(ini, "Metrics", "Host", "127.0.0.1") < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, "Metrics", "Port", 0) < 0)
+		goto fail;
+
 	/* Certificate configuration */
 	if (IniFile_SetKeyValueString(ini, "Certificates", "CertificateFile",
 	                              "<absolute path to some certificate file> OR") < 0)
@@ -630,13 +776,26 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION("Server");
 	CONFIG_PRINT_STR(config, Host);
 	CONFIG_PRINT_UINT16(config, Port);
+	CONFIG_PRINT_UINT32(config, Workers);
+	CONFIG_PRINT_UINT32(config, MaxHandshakes);
+	CONFIG_PRINT_UINT32(config, HandshakeTimeout);
+	WLog_INFO(TAG, "\t\t%s: 0x%016" PRIx64 "", "ThreadAffinity", config->ThreadAffinity);
 
+	CONFIG_PRINT_SECTION("Target");
 	if (config->FixedTarget)
 	{
-		CONFIG_PRINT_SECTION("Target");
 		CONFIG_PRINT_STR(config, TargetHost);
 		CONFIG_PRINT_UINT16(config, TargetPort);
 	}
+	CONFIG_PRINT_UINT32(config, TargetPoolSize);
+	if (config->TargetPoolSize > 0)
+		CONFIG_PRINT_UINT32(config, TargetPoolIdleTimeout);
+	if (config->FarmFile)
+	{
+		CONFIG_PRINT_STR(config, FarmFile);
+		CONFIG_PRINT_UINT32(config, FarmRefreshInterval);
+		CONFIG_PRINT_UINT32(config, FarmStickyTimeout);
+	}
 
 	CONFIG_PRINT_SECTION("Input");
 	CONFIG_PRINT_BOOL(config, Keyboard);
@@ -685,6 +844,20 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION("GFXSettings");
 	CONFIG_PRINT_BOOL(config, DecodeGFX);
 
+	CONFIG_PRINT_SECTION("QoS");
+	CONFIG_PRINT_BOOL(config, QoS);
+	if (config->QoS)
+	{
+		CONFIG_PRINT_UINT32(config, QoSGraphicsRate);
+		CONFIG_PRINT_UINT32(config, QoSAudioRate);
+		CONFIG_PRINT_UINT32(config, QoSBulkRate);
+	}
+
+	CONFIG_PRINT_SECTION("Metrics");
+	CONFIG_PRINT_UINT16(config, MetricsPort);
+	if (config->MetricsPort > 0)
+		CONFIG_PRINT_STR(config, MetricsHost);
+
 	/* modules */
 	CONFIG_PRINT_SECTION("Plugins/Modules");
 	for (x = 0; x < config->ModulesCount; x++)
@@ -715,6 +888,8 @@ void pf_server_config_free(proxyConfig* config)
 	free(config->Modules);
 	free(config->TargetHost);
 	free(config->Host);
+	free(config->MetricsHost);
+	free(config->FarmFile);
 	free(config->CertificateFile);
 	free(config->CertificateContent);
 	free(config->PrivateKeyFile);
@@ -802,6 +977,10 @@ BOOL pf_config_clone(proxyConfig** dst, const proxyConfig* config)
 		goto fail;
 	if (!pf_config_copy_string(&tmp->TargetHost, config->TargetHost))
 		goto fail;
+	if (!pf_config_copy_string(&tmp->MetricsHost, config->MetricsHost))
+		goto fail;
+	if (!pf_config_copy_string(&tmp->FarmFile, config->FarmFile))
+		goto fail;
 
 	if (!pf_config_copy_string_list(&tmp->Passthrough, &tmp->PassthroughCount, config->Passthrough,
 	                                config->PassthroughCount))
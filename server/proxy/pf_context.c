@@ -29,6 +29,7 @@
 
 #include "pf_client.h"
 #include "pf_utils.h"
+#include "pf_qos.h"
 #include <freerdp/server/proxy/proxy_context.h>
 
 #include "channels/pf_channel_rdpdr.h"
@@ -144,6 +145,8 @@ void client_to_proxy_context_free(freerdp_peer* client, rdpContext* ctx)
 
 	HashTable_Free(context->interceptContextMap);
 	HashTable_Free(context->channelsById);
+	pf_qos_free(context->qos);
+	context->qos = NULL;
 
 	if (context->vcm && (context->vcm != INVALID_HANDLE_VALUE))
 		WTSCloseServer((HANDLE)context->vcm);
@@ -161,19 +164,35 @@ BOOL pf_context_init_server_context(freerdp_peer* client)
 	return freerdp_peer_context_new(client);
 }
 
-static BOOL pf_context_revert_str_settings(rdpSettings* dst, const rdpSettings* before, size_t nr,
-                                           const size_t* ids)
+static BOOL pf_context_save_str_settings(const rdpSettings* src, size_t nr, const size_t* ids,
+                                         char** saved)
+{
+	size_t x;
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(ids || (nr == 0));
+	WINPR_ASSERT(saved || (nr == 0));
+
+	for (x = 0; x < nr; x++)
+	{
+		const char* what = freerdp_settings_get_string(src, ids[x]);
+		if (what && !(saved[x] = _strdup(what)))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL pf_context_revert_str_settings(rdpSettings* dst, size_t nr, const size_t* ids,
+                                           char* const* saved)
 {
 	size_t x;
 	WINPR_ASSERT(dst);
-	WINPR_ASSERT(before);
 	WINPR_ASSERT(ids || (nr == 0));
+	WINPR_ASSERT(saved || (nr == 0));
 
 	for (x = 0; x < nr; x++)
 	{
-		size_t id = ids[x];
-		const char* what = freerdp_settings_get_string(before, id);
-		if (!freerdp_settings_set_string(dst, id, what))
+		if (!freerdp_settings_set_string(dst, ids[x], saved[x]))
 			return FALSE;
 	}
 
@@ -192,37 +211,40 @@ void intercept_context_entry_free(void* obj)
 
 BOOL pf_context_copy_settings(rdpSettings* dst, const rdpSettings* src)
 {
+	size_t x;
 	BOOL rc = FALSE;
-	rdpSettings* before_copy;
+	BOOL server_mode;
+	freerdp* instance;
 	const size_t to_revert[] = { FreeRDP_ConfigPath,      FreeRDP_PrivateKeyContent,
 		                         FreeRDP_RdpKeyContent,   FreeRDP_RdpKeyFile,
 		                         FreeRDP_PrivateKeyFile,  FreeRDP_CertificateFile,
 		                         FreeRDP_CertificateName, FreeRDP_CertificateContent };
+	char* saved[ARRAYSIZE(to_revert)] = { 0 };
 
 	if (!dst || !src)
 		return FALSE;
 
-	before_copy = freerdp_settings_clone(dst);
-	if (!before_copy)
-		return FALSE;
+	/* Only the values restored below are kept, cloning all of dst is not required */
+	server_mode = dst->ServerMode;
+	instance = dst->instance;
+
+	if (!pf_context_save_str_settings(dst, ARRAYSIZE(to_revert), to_revert, saved))
+		goto out_fail;
 
 	if (!freerdp_settings_copy(dst, src))
-	{
-		freerdp_settings_free(before_copy);
-		return FALSE;
-	}
+		goto out_fail;
 
 	/* keep original ServerMode value */
-	dst->ServerMode = before_copy->ServerMode;
+	dst->ServerMode = server_mode;
 
 	/* revert some values that must not be changed */
-	if (!pf_context_revert_str_settings(dst, before_copy, ARRAYSIZE(to_revert), to_revert))
-		return FALSE;
+	if (!pf_context_revert_str_settings(dst, ARRAYSIZE(to_revert), to_revert, saved))
+		goto out_fail;
 
 	if (!dst->ServerMode)
 	{
 		/* adjust instance pointer */
-		dst->instance = before_copy->instance;
+		dst->instance = instance;
 
 		/*
 		 * RdpServerRsaKey must be set to NULL if `dst` is client's context
@@ -238,7 +260,13 @@ BOOL pf_context_copy_settings(rdpSettings* dst, const rdpSettings* src)
 	rc = freerdp_settings_set_bool(dst, FreeRDP_ExternalCertificateManagement, TRUE);
 
 out_fail:
-	freerdp_settings_free(before_copy);
+	for (x = 0; x < ARRAYSIZE(saved); x++)
+	{
+		if (saved[x])
+			memset(saved[x], 0, strlen(saved[x]));
+		free(saved[x]);
+	}
+
 	return rc;
 }
 
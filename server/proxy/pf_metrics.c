@@ -0,0 +1,478 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/string.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/winsock.h>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#else
+#include <sys/select.h>
+#endif
+#endif
+
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_metrics.h"
+
+#define TAG PROXY_TAG("metrics")
+
+/**
+ * A minimal HTTP/1.0 endpoint for scrapers: one request per connection, answered from the
+ * endpoint's thread. The metrics of all sessions are collected into one response where the
+ * lines of each metric are grouped below a single TYPE line, as the text format requires.
+ */
+#define PF_METRICS_POLL_INTERVAL 1000
+#define PF_METRICS_REQUEST_TIMEOUT 2000
+#define PF_METRICS_MAX_REQUEST 4096
+
+struct proxy_metrics_server
+{
+	SOCKET sockfd;
+	HANDLE thread;
+	HANDLE stopEvent;
+	pf_metrics_collect_fkt collect;
+	void* context;
+};
+
+typedef struct
+{
+	const char* family;
+	size_t familyLength;
+	BOOL isType;
+	size_t sequence;
+	char line[1];
+} proxyMetricsLine;
+
+typedef struct
+{
+	wArrayList* lines;
+	size_t sequence;
+} proxyMetricsCollector;
+
+/* @return 1 if the socket is readable, 0 on timeout and -1 on failure */
+static int pf_metrics_poll(SOCKET s, int timeout)
+{
+	int status;
+#ifdef HAVE_POLL_H
+	struct pollfd pollset = { 0 };
+
+	pollset.fd = s;
+	pollset.events = POLLIN;
+
+	do
+	{
+		status = poll(&pollset, 1, timeout);
+	} while ((status < 0) && (errno == EINTR));
+#else
+	fd_set set;
+	struct timeval tv = { 0 };
+
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+	FD_ZERO(&set);
+	FD_SET(s, &set);
+
+	status = select((int)s + 1, &set, NULL, NULL, &tv);
+#endif
+
+	if (status > 0)
+		return 1;
+
+	return status;
+}
+
+/* the name of the metric a line belongs to, the samples of a summary included */
+static void pf_metrics_line_family(proxyMetricsLine* entry)
+{
+	size_t x;
+	const char* suffixes[] = { "_sum", "_count" };
+	const char* name = entry->line;
+	size_t length;
+
+	entry->isType = (strncmp(name, "# TYPE ", 7) == 0);
+
+	if (entry->isType)
+		name += 7;
+
+	length = strcspn(name, "{ ");
+
+	if (!entry->isType)
+	{
+		for (x = 0; x < ARRAYSIZE(suffixes); x++)
+		{
+			const size_t suffix = strlen(suffixes[x]);
+
+			if ((length > suffix) && (strncmp(&name[length - suffix], suffixes[x], suffix) == 0))
+			{
+				length -= suffix;
+				break;
+			}
+		}
+	}
+
+	entry->family = name;
+	entry->familyLength = length;
+}
+
+static BOOL pf_metrics_collect_line(void* custom, const char* line)
+{
+	proxyMetricsCollector* collector = custom;
+	const size_t length = strlen(line);
+	proxyMetricsLine* entry;
+
+	WINPR_ASSERT(collector);
+
+	/* other comments do not survive the regrouping */
+	if ((line[0] == '#') && (strncmp(line, "# TYPE ", 7) != 0))
+		return TRUE;
+
+	entry = calloc(1, sizeof(proxyMetricsLine) + length);
+	if (!entry)
+		return FALSE;
+
+	memcpy(entry->line, line, length);
+	entry->sequence = collector->sequence++;
+	pf_metrics_line_family(entry);
+
+	if (!ArrayList_Append(collector->lines, entry))
+	{
+		free(entry);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int pf_metrics_line_compare(const void* pa, const void* pb)
+{
+	int rc;
+	const proxyMetricsLine* a = *(proxyMetricsLine* const*)pa;
+	const proxyMetricsLine* b = *(proxyMetricsLine* const*)pb;
+	const size_t length = MIN(a->familyLength, b->familyLength);
+
+	rc = strncmp(a->family, b->family, length);
+	if (rc != 0)
+		return rc;
+
+	if (a->familyLength != b->familyLength)
+		return (a->familyLength < b->familyLength) ? -1 : 1;
+
+	/* the TYPE line first, the samples in the order they were written */
+	if (a->isType != b->isType)
+		return a->isType ? -1 : 1;
+
+	if (a->sequence != b->sequence)
+		return (a->sequence < b->sequence) ? -1 : 1;
+
+	return 0;
+}
+
+static BOOL pf_metrics_write_body(proxyMetricsServer* server, wStream* body)
+{
+	size_t x;
+	size_t count;
+	BOOL rc = FALSE;
+	proxyMetricsLine** lines = NULL;
+	const proxyMetricsLine* lastType = NULL;
+	proxyMetricsCollector collector = { 0 };
+
+	collector.lines = ArrayList_New(FALSE);
+	if (!collector.lines)
+		return FALSE;
+
+	ArrayList_Object(collector.lines)->fnObjectFree = free;
+
+	if (!server->collect(server->context, pf_metrics_collect_line, &collector))
+		goto out;
+
+	count = ArrayList_Count(collector.lines);
+	lines = calloc(count + 1, sizeof(proxyMetricsLine*));
+	if (!lines)
+		goto out;
+
+	for (x = 0; x < count; x++)
+		lines[x] = ArrayList_GetItem(collector.lines, x);
+
+	qsort(lines, count, sizeof(proxyMetricsLine*), pf_metrics_line_compare);
+
+	for (x = 0; x < count; x++)
+	{
+		const proxyMetricsLine* entry = lines[x];
+		const size_t length = strlen(entry->line);
+
+		if (entry->isType)
+		{
+			if (lastType && (lastType->familyLength == entry->familyLength) &&
+			    (strncmp(lastType->family, entry->family, entry->familyLength) == 0))
+				continue;
+
+			lastType = entry;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(body, length + 1))
+			goto out;
+
+		Stream_Write(body, entry->line, length);
+		Stream_Write_UINT8(body, '\n');
+	}
+
+	rc = TRUE;
+out:
+	free(lines);
+	ArrayList_Free(collector.lines);
+	return rc;
+}
+
+static BOOL pf_metrics_send(SOCKET s, const BYTE* data, size_t length)
+{
+	while (length > 0)
+	{
+		const int chunk = (int)MIN(length, INT32_MAX);
+		const int nsent = _send(s, (const char*)data, chunk, 0);
+
+		if (nsent <= 0)
+			return FALSE;
+
+		data += nsent;
+		length -= (size_t)nsent;
+	}
+
+	return TRUE;
+}
+
+static BOOL pf_metrics_respond(SOCKET s, const char* status, wStream* body)
+{
+	char header[256] = { 0 };
+	const size_t length = body ? Stream_GetPosition(body) : 0;
+	const int rc = _snprintf(header, sizeof(header),
+	                         "HTTP/1.0 %s\r\n"
+	                         "Content-Type: text/plain; version=0.0.4\r\n"
+	                         "Content-Length: %" PRIuz "\r\n"
+	                         "Connection: close\r\n\r\n",
+	                         status, length);
+
+	if ((rc < 0) || ((size_t)rc >= sizeof(header)))
+		return FALSE;
+
+	if (!pf_metrics_send(s, (const BYTE*)header, (size_t)rc))
+		return FALSE;
+
+	return (length == 0) || pf_metrics_send(s, Stream_Buffer(body), length);
+}
+
+/* reads the request head, the request body is ignored */
+static BOOL pf_metrics_read_request(SOCKET s, char* buffer, size_t size)
+{
+	size_t length = 0;
+
+	while (length < size - 1)
+	{
+		int nread;
+
+		if (pf_metrics_poll(s, PF_METRICS_REQUEST_TIMEOUT) <= 0)
+			return FALSE;
+
+		nread = _recv(s, &buffer[length], (int)(size - 1 - length), 0);
+		if (nread <= 0)
+			return FALSE;
+
+		length += (size_t)nread;
+		buffer[length] = '\0';
+
+		if (strstr(buffer, "\r\n\r\n") || strstr(buffer, "\n\n"))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void pf_metrics_handle_client(proxyMetricsServer* server, SOCKET s)
+{
+	char request[PF_METRICS_MAX_REQUEST] = { 0 };
+	wStream* body = NULL;
+
+	if (!pf_metrics_read_request(s, request, sizeof(request)))
+	{
+		pf_metrics_respond(s, "400 Bad Request", NULL);
+		return;
+	}
+
+	if ((strncmp(request, "GET /metrics ", 13) != 0) && (strncmp(request, "GET / ", 6) != 0))
+	{
+		pf_metrics_respond(s, "404 Not Found", NULL);
+		return;
+	}
+
+	body = Stream_New(NULL, 64 * 1024);
+
+	if (!body || !pf_metrics_write_body(server, body))
+	{
+		WLog_WARN(TAG, "failed to collect the metrics");
+		pf_metrics_respond(s, "500 Internal Server Error", NULL);
+	}
+	else if (!pf_metrics_respond(s, "200 OK", body))
+		WLog_DBG(TAG, "failed to send the metrics");
+
+	Stream_Free(body, TRUE);
+}
+
+static DWORD WINAPI pf_metrics_thread(LPVOID arg)
+{
+	proxyMetricsServer* server = arg;
+
+	WINPR_ASSERT(server);
+
+	while (WaitForSingleObject(server->stopEvent, 0) != WAIT_OBJECT_0)
+	{
+		SOCKET s;
+		struct sockaddr_storage addr = { 0 };
+		int addrlen = sizeof(addr);
+		const int status = pf_metrics_poll(server->sockfd, PF_METRICS_POLL_INTERVAL);
+
+		if (status < 0)
+		{
+			WLog_ERR(TAG, "waiting for metrics requests failed");
+			break;
+		}
+
+		if (status == 0)
+			continue;
+
+		s = _accept(server->sockfd, (struct sockaddr*)&addr, &addrlen);
+		if (s == INVALID_SOCKET)
+			continue;
+
+		pf_metrics_handle_client(server, s);
+		closesocket(s);
+	}
+
+	return 0;
+}
+
+static SOCKET pf_metrics_listen(const char* host, UINT16 port)
+{
+	int optval = 1;
+	char service[16] = { 0 };
+	struct addrinfo hints = { 0 };
+	struct addrinfo* result = NULL;
+	const struct addrinfo* addr;
+	SOCKET s = INVALID_SOCKET;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	sprintf_s(service, sizeof(service), "%" PRIu16, port);
+
+	if (getaddrinfo(host, service, &hints, &result) != 0)
+	{
+		WLog_ERR(TAG, "failed to resolve %s", host);
+		return INVALID_SOCKET;
+	}
+
+	for (addr = result; addr; addr = addr->ai_next)
+	{
+		s = _socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (s == INVALID_SOCKET)
+			continue;
+
+		if (_setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof(optval)) < 0)
+			WLog_WARN(TAG, "unable to set SO_REUSEADDR");
+
+		if ((_bind(s, addr->ai_addr, (int)addr->ai_addrlen) == 0) && (_listen(s, 8) == 0))
+			break;
+
+		closesocket(s);
+		s = INVALID_SOCKET;
+	}
+
+	freeaddrinfo(result);
+	return s;
+}
+
+proxyMetricsServer* pf_metrics_server_new(const char* host, UINT16 port,
+                                          pf_metrics_collect_fkt collect, void* context)
+{
+	proxyMetricsServer* server;
+
+	WINPR_ASSERT(host);
+	WINPR_ASSERT(collect);
+
+	server = calloc(1, sizeof(proxyMetricsServer));
+	if (!server)
+		return NULL;
+
+	server->collect = collect;
+	server->context = context;
+
+	server->sockfd = pf_metrics_listen(host, port);
+	if (server->sockfd == INVALID_SOCKET)
+	{
+		WLog_ERR(TAG, "failed to listen on %s:%" PRIu16, host, port);
+		goto fail;
+	}
+
+	server->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!server->stopEvent)
+		goto fail;
+
+	server->thread = CreateThread(NULL, 0, pf_metrics_thread, server, 0, NULL);
+	if (!server->thread)
+		goto fail;
+
+	WLog_INFO(TAG, "serving metrics on http://%s:%" PRIu16 "/metrics", host, port);
+	return server;
+
+fail:
+	pf_metrics_server_free(server);
+	return NULL;
+}
+
+void pf_metrics_server_free(proxyMetricsServer* server)
+{
+	if (!server)
+		return;
+
+	if (server->thread)
+	{
+		SetEvent(server->stopEvent);
+		WaitForSingleObject(server->thread, INFINITE);
+		CloseHandle(server->thread);
+	}
+
+	if (server->stopEvent)
+		CloseHandle(server->stopEvent);
+
+	if (server->sockfd != INVALID_SOCKET)
+		closesocket(server->sockfd);
+
+	free(server);
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_PROXY_PFMETRICS_H
+#define FREERDP_SERVER_PROXY_PFMETRICS_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/freerdp.h>
+
+typedef struct proxy_metrics_server proxyMetricsServer;
+
+/**
+ * Writes all current metrics, one line of Prometheus text format per call of fkt. Lines of
+ * the same metric may be written in any order and with repeated TYPE lines, the endpoint
+ * groups them.
+ */
+typedef BOOL (*pf_metrics_collect_fkt)(void* context, pMetricsExportLine fkt, void* custom);
+
+/**
+ * @brief pf_metrics_server_new Starts serving the metrics over HTTP on GET /metrics
+ * @return the new endpoint or NULL on failure
+ */
+proxyMetricsServer* pf_metrics_server_new(const char* host, UINT16 port,
+                                          pf_metrics_collect_fkt collect, void* context);
+void pf_metrics_server_free(proxyMetricsServer* server);
+
+#endif /* FREERDP_SERVER_PROXY_PFMETRICS_H */
@@ -23,6 +23,7 @@
 #include <winpr/assert.h>
 
 #include <winpr/file.h>
+#include <winpr/interlocked.h>
 #include <winpr/wlog.h>
 #include <winpr/path.h>
 #include <winpr/library.h>
@@ -204,12 +205,41 @@ static BOOL pf_modules_proxy_ArrayList_ForEachFkt(void* data, size_t index, va_l
  * @type: hook type to run.
  * @server: pointer of server's rdpContext struct of the current session.
  */
+/* the session is read by the metrics endpoint, so the sums are updated atomically */
+static void pf_modules_add64(volatile LONGLONG* value, LONGLONG add)
+{
+	LONGLONG old;
+
+	do
+	{
+		old = *value;
+	} while (InterlockedCompareExchange64(value, old + add, old) != old);
+}
+
+static void pf_modules_account(proxyData* pdata, UINT64 start)
+{
+	pf_modules_add64(&pdata->module_calls, 1);
+	pf_modules_add64(&pdata->module_time_us, (LONGLONG)(metrics_get_time_us() - start));
+}
+
 BOOL pf_modules_run_hook(proxyModule* module, PF_HOOK_TYPE type, proxyData* pdata, void* custom)
 {
+	BOOL rc;
+	UINT64 start = 0;
+
 	WINPR_ASSERT(module);
 	WINPR_ASSERT(module->plugins);
-	return ArrayList_ForEach(module->plugins, pf_modules_proxy_ArrayList_ForEachFkt, type, pdata,
-	                         custom);
+
+	if (pdata)
+		start = metrics_get_time_us();
+
+	rc = ArrayList_ForEach(module->plugins, pf_modules_proxy_ArrayList_ForEachFkt, type, pdata,
+	                       custom);
+
+	if (pdata)
+		pf_modules_account(pdata, start);
+
+	return rc;
 }
 
 static BOOL pf_modules_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
@@ -284,10 +314,21 @@ static BOOL pf_modules_ArrayList_ForEachFkt(void* data, size_t index, va_list ap
  */
 BOOL pf_modules_run_filter(proxyModule* module, PF_FILTER_TYPE type, proxyData* pdata, void* param)
 {
+	BOOL rc;
+	UINT64 start = 0;
+
 	WINPR_ASSERT(module);
 	WINPR_ASSERT(module->plugins);
 
-	return ArrayList_ForEach(module->plugins, pf_modules_ArrayList_ForEachFkt, type, pdata, param);
+	if (pdata)
+		start = metrics_get_time_us();
+
+	rc = ArrayList_ForEach(module->plugins, pf_modules_ArrayList_ForEachFkt, type, pdata, param);
+
+	if (pdata)
+		pf_modules_account(pdata, start);
+
+	return rc;
 }
 
 /*
@@ -410,6 +451,24 @@ BOOL pf_modules_is_plugin_loaded(proxyModule* module, const char* plugin_name)
 	return ArrayList_ForEach(module->plugins, pf_modules_load_ArrayList_ForEachFkt, plugin_name);
 }
 
+static BOOL pf_modules_graphics_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
+{
+	proxyPlugin* plugin = (proxyPlugin*)data;
+
+	WINPR_UNUSED(index);
+	WINPR_UNUSED(ap);
+
+	/* stops the iteration at the first plugin with a graphics hook */
+	return plugin->ClientEndPaint == NULL;
+}
+
+BOOL pf_modules_has_graphics_hooks(proxyModule* module)
+{
+	WINPR_ASSERT(module);
+	WINPR_ASSERT(module->plugins);
+	return !ArrayList_ForEach(module->plugins, pf_modules_graphics_ArrayList_ForEachFkt);
+}
+
 static BOOL pf_modules_print_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
 {
 	proxyPlugin* plugin = (proxyPlugin*)data;
@@ -0,0 +1,289 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/types.h>
+#include <freerdp/channels/cliprdr.h>
+#include <freerdp/channels/rdpdr.h>
+#include <freerdp/channels/rdpsnd.h>
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_qos.h"
+#include "pf_utils.h"
+
+#define TAG PROXY_TAG("qos")
+
+/**
+ * Channel data is shaped with a token bucket per channel class. A fragment is sent right away
+ * if its class has tokens left and nothing queued, otherwise it is queued and sent once the
+ * bucket refilled. Fragments of a class are always sent in order, so the order within a
+ * channel is kept and only different channels are reordered.
+ *
+ * Input and graphics updates are not channel data and never wait for queued fragments.
+ */
+
+/* a bucket holds at least the tokens of this interval */
+#define PF_QOS_BURST_MS 100
+#define PF_QOS_MIN_BURST (16ull * 1024ull)
+
+typedef struct
+{
+	UINT64 rate; /* bytes per second, 0 for no limit */
+	INT64 tokens;
+	INT64 burst;
+	wQueue* queue;
+} PF_QOS_BUCKET;
+
+struct proxy_qos
+{
+	CRITICAL_SECTION lock;
+	HANDLE timer;
+	UINT64 last;
+	pf_qos_send_fkt send;
+	void* context;
+	PF_QOS_BUCKET buckets[PF_QOS_CLASS_COUNT];
+};
+
+PF_QOS_CLASS pf_qos_channel_class(const char* channel_name)
+{
+	if (!channel_name)
+		return PF_QOS_CLASS_GRAPHICS;
+
+	if (strcmp(channel_name, RDPSND_CHANNEL_NAME) == 0)
+		return PF_QOS_CLASS_AUDIO;
+
+	if ((strcmp(channel_name, RDPDR_SVC_CHANNEL_NAME) == 0) ||
+	    (strcmp(channel_name, CLIPRDR_SVC_CHANNEL_NAME) == 0))
+		return PF_QOS_CLASS_BULK;
+
+	/* drdynvc carries the graphics pipeline besides the other dynamic channels */
+	return PF_QOS_CLASS_GRAPHICS;
+}
+
+static void pf_qos_refill(proxyQos* qos)
+{
+	size_t x;
+	const UINT64 now = GetTickCount64();
+	const UINT64 elapsed = now - qos->last;
+
+	if (elapsed == 0)
+		return;
+
+	for (x = 0; x < ARRAYSIZE(qos->buckets); x++)
+	{
+		PF_QOS_BUCKET* bucket = &qos->buckets[x];
+
+		if (bucket->rate == 0)
+			continue;
+
+		bucket->tokens += (INT64)MIN(bucket->rate * elapsed / 1000, (UINT64)bucket->burst);
+		bucket->tokens = MIN(bucket->tokens, bucket->burst);
+	}
+
+	qos->last = now;
+}
+
+/* arms the timer for the first bucket with queued fragments to have tokens again */
+static void pf_qos_arm(proxyQos* qos)
+{
+	size_t x;
+	UINT64 wait = UINT64_MAX;
+	LARGE_INTEGER due;
+
+	for (x = 0; x < ARRAYSIZE(qos->buckets); x++)
+	{
+		const PF_QOS_BUCKET* bucket = &qos->buckets[x];
+		UINT64 ms = 1;
+
+		if (Queue_Count(bucket->queue) == 0)
+			continue;
+
+		if ((bucket->rate > 0) && (bucket->tokens <= 0))
+			ms = (UINT64)(1 - bucket->tokens) * 1000 / bucket->rate + 1;
+
+		wait = MIN(wait, ms);
+	}
+
+	if (wait == UINT64_MAX)
+		return;
+
+	due.QuadPart = -(LONGLONG)(wait * 10000);
+
+	if (!SetWaitableTimer(qos->timer, &due, 0, NULL, NULL, FALSE))
+		WLog_WARN(TAG, "failed to arm the channel data timer");
+}
+
+static BOOL pf_qos_send_bucket(proxyQos* qos, PF_QOS_BUCKET* bucket,
+                               const proxyChannelDataEventInfo* ev)
+{
+	if (bucket->rate > 0)
+		bucket->tokens -= (INT64)ev->data_len;
+
+	return qos->send(qos->context, ev);
+}
+
+BOOL pf_qos_send(proxyQos* qos, const proxyChannelDataEventInfo* ev)
+{
+	BOOL rc;
+	PF_QOS_BUCKET* bucket;
+
+	WINPR_ASSERT(qos);
+	WINPR_ASSERT(ev);
+
+	EnterCriticalSection(&qos->lock);
+	pf_qos_refill(qos);
+	bucket = &qos->buckets[pf_qos_channel_class(ev->channel_name)];
+
+	if ((Queue_Count(bucket->queue) == 0) && ((bucket->rate == 0) || (bucket->tokens > 0)))
+		rc = pf_qos_send_bucket(qos, bucket, ev);
+	else
+	{
+		rc = Queue_Enqueue(bucket->queue, ev);
+		pf_qos_arm(qos);
+	}
+
+	LeaveCriticalSection(&qos->lock);
+	return rc;
+}
+
+BOOL pf_qos_flush(proxyQos* qos)
+{
+	size_t x;
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(qos);
+
+	EnterCriticalSection(&qos->lock);
+	pf_qos_refill(qos);
+
+	for (x = 0; rc && (x < ARRAYSIZE(qos->buckets)); x++)
+	{
+		PF_QOS_BUCKET* bucket = &qos->buckets[x];
+
+		while (rc && ((bucket->rate == 0) || (bucket->tokens > 0)))
+		{
+			proxyChannelDataEventInfo* ev = Queue_Dequeue(bucket->queue);
+
+			if (!ev)
+				break;
+
+			rc = pf_qos_send_bucket(qos, bucket, ev);
+			pf_utils_channel_data_free(ev);
+		}
+	}
+
+	pf_qos_arm(qos);
+	LeaveCriticalSection(&qos->lock);
+	return rc;
+}
+
+HANDLE pf_qos_get_event_handle(proxyQos* qos)
+{
+	WINPR_ASSERT(qos);
+	return qos->timer;
+}
+
+size_t pf_qos_get_queued(proxyQos* qos)
+{
+	size_t x;
+	size_t count = 0;
+
+	WINPR_ASSERT(qos);
+
+	EnterCriticalSection(&qos->lock);
+	for (x = 0; x < ARRAYSIZE(qos->buckets); x++)
+		count += Queue_Count(qos->buckets[x].queue);
+	LeaveCriticalSection(&qos->lock);
+	return count;
+}
+
+static BOOL pf_qos_bucket_init(PF_QOS_BUCKET* bucket, UINT32 kbps)
+{
+	wObject* obj;
+
+	bucket->rate = kbps * 1000ull / 8ull;
+	bucket->burst = (INT64)MAX(bucket->rate * PF_QOS_BURST_MS / 1000ull, PF_QOS_MIN_BURST);
+	bucket->tokens = bucket->burst;
+
+	bucket->queue = Queue_New(FALSE, -1, -1);
+	if (!bucket->queue)
+		return FALSE;
+
+	obj = Queue_Object(bucket->queue);
+	WINPR_ASSERT(obj);
+	obj->fnObjectNew = pf_utils_channel_data_copy;
+	obj->fnObjectFree = pf_utils_channel_data_free;
+	return TRUE;
+}
+
+proxyQos* pf_qos_new(const proxyConfig* config, pf_qos_send_fkt send, void* context)
+{
+	proxyQos* qos;
+
+	WINPR_ASSERT(config);
+	WINPR_ASSERT(send);
+
+	qos = calloc(1, sizeof(proxyQos));
+	if (!qos)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&qos->lock, 4000))
+	{
+		free(qos);
+		return NULL;
+	}
+
+	qos->send = send;
+	qos->context = context;
+	qos->last = GetTickCount64();
+
+	qos->timer = CreateWaitableTimer(NULL, FALSE, NULL);
+	if (!qos->timer)
+		goto fail;
+
+	if (!pf_qos_bucket_init(&qos->buckets[PF_QOS_CLASS_GRAPHICS], config->QoSGraphicsRate) ||
+	    !pf_qos_bucket_init(&qos->buckets[PF_QOS_CLASS_AUDIO], config->QoSAudioRate) ||
+	    !pf_qos_bucket_init(&qos->buckets[PF_QOS_CLASS_BULK], config->QoSBulkRate))
+		goto fail;
+
+	return qos;
+
+fail:
+	pf_qos_free(qos);
+	return NULL;
+}
+
+void pf_qos_free(proxyQos* qos)
+{
+	size_t x;
+
+	if (!qos)
+		return;
+
+	for (x = 0; x < ARRAYSIZE(qos->buckets); x++)
+		Queue_Free(qos->buckets[x].queue);
+
+	if (qos->timer)
+		CloseHandle(qos->timer);
+
+	DeleteCriticalSection(&qos->lock);
+	free(qos);
+}
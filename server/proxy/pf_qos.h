@@ -0,0 +1,68 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_PROXY_PFQOS_H
+#define FREERDP_SERVER_PROXY_PFQOS_H
+
+#include <freerdp/server/proxy/proxy_config.h>
+#include <freerdp/server/proxy/proxy_context.h>
+#include <freerdp/server/proxy/proxy_modules_api.h>
+
+/** @brief channel classes in order of their priority */
+typedef enum
+{
+	PF_QOS_CLASS_GRAPHICS,
+	PF_QOS_CLASS_AUDIO,
+	PF_QOS_CLASS_BULK,
+	PF_QOS_CLASS_COUNT
+} PF_QOS_CLASS;
+
+typedef BOOL (*pf_qos_send_fkt)(void* context, const proxyChannelDataEventInfo* ev);
+
+/**
+ * @brief pf_qos_new Creates the scheduler of the channel data sent in one direction
+ * @param send Called for each fragment once its class has the bandwidth
+ * @return the new scheduler or NULL on failure
+ */
+proxyQos* pf_qos_new(const proxyConfig* config, pf_qos_send_fkt send, void* context);
+void pf_qos_free(proxyQos* qos);
+
+PF_QOS_CLASS pf_qos_channel_class(const char* channel_name);
+
+/**
+ * @brief pf_qos_send Sends a fragment right away or queues a copy of it
+ */
+BOOL pf_qos_send(proxyQos* qos, const proxyChannelDataEventInfo* ev);
+
+/**
+ * @brief pf_qos_flush Sends the queued fragments the buckets allow, highest priority first
+ */
+BOOL pf_qos_flush(proxyQos* qos);
+
+/**
+ * @brief pf_qos_get_event_handle
+ * @return a handle signaled once queued fragments can be flushed
+ */
+HANDLE pf_qos_get_event_handle(proxyQos* qos);
+
+/**
+ * @brief pf_qos_get_queued
+ * @return the number of fragments waiting for their bucket
+ */
+size_t pf_qos_get_queued(proxyQos* qos);
+
+#endif /* FREERDP_SERVER_PROXY_PFQOS_H */
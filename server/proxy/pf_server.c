@@ -50,15 +50,45 @@
 #include "pf_update.h"
 #include "proxy_modules.h"
 #include "pf_utils.h"
+#include "pf_worker.h"
+#include "pf_qos.h"
 #include "channels/pf_channel_rdpdr.h"
 
 #define TAG PROXY_TAG("server")
 
 typedef struct
 {
-	HANDLE thread;
 	freerdp_peer* client;
-} peer_thread_args;
+	BOOL client_running; /* the proxy's client is connected and driven along with the peer */
+	proxyServerSnapshot* snapshot;
+} peer_session;
+
+static void pf_server_snapshot_release(proxyServerSnapshot* snapshot)
+{
+	if (!snapshot)
+		return;
+
+	if (InterlockedDecrement(&snapshot->refs) > 0)
+		return;
+
+	pf_modules_free(snapshot->module);
+	pf_server_config_free(snapshot->config);
+	free(snapshot);
+}
+
+static proxyServerSnapshot* pf_server_snapshot_acquire(proxyServer* server)
+{
+	proxyServerSnapshot* snapshot;
+
+	WINPR_ASSERT(server);
+
+	EnterCriticalSection(&server->lock);
+	snapshot = server->snapshot;
+	WINPR_ASSERT(snapshot);
+	InterlockedIncrement(&snapshot->refs);
+	LeaveCriticalSection(&server->lock);
+	return snapshot;
+}
 
 static BOOL pf_server_parse_target_from_routing_token(rdpContext* context, char** target,
                                                       DWORD* port)
@@ -109,8 +139,8 @@ static BOOL pf_server_parse_target_from_routing_token(rdpContext* context, char*
 	return TRUE;
 }
 
-static BOOL pf_server_get_target_info(rdpContext* context, rdpSettings* settings,
-                                      const proxyConfig* config)
+static BOOL pf_server_fetch_target_info(rdpContext* context, rdpSettings* settings,
+                                        const proxyConfig* config)
 {
 	pServerContext* ps = (pServerContext*)context;
 	proxyFetchTargetEventInfo ev = { 0 };
@@ -176,6 +206,59 @@ static BOOL pf_server_get_target_info(rdpContext* context, rdpSettings* settings
 	return TRUE;
 }
 
+/* replaces a farm named by the routing token or the configuration with one of its targets */
+static BOOL pf_server_resolve_farm(rdpContext* context, rdpSettings* settings)
+{
+	BOOL found = FALSE;
+	char* hostname = NULL;
+	UINT16 port = 0;
+	const char* user;
+	proxyServer* server;
+	pServerContext* ps = (pServerContext*)context;
+
+	WINPR_ASSERT(ps);
+	WINPR_ASSERT(context->peer);
+	server = (proxyServer*)context->peer->ContextExtra;
+	WINPR_ASSERT(server);
+
+	if (!server->farms)
+		return TRUE;
+
+	/* users without a name on the logon stick to their address */
+	user = freerdp_settings_get_string(context->settings, FreeRDP_Username);
+	if (!user || (user[0] == '\0'))
+		user = context->peer->hostname;
+
+	if (!pf_target_resolver_select(server->farms, settings->ServerHostname, user, ps->pdata,
+	                               &hostname, &port, &found))
+		return FALSE;
+
+	if (!found)
+		return TRUE;
+
+	PROXY_LOG_INFO(TAG, ps, "farm %s selected %s:%" PRIu16, settings->ServerHostname, hostname,
+	               port);
+
+	if (!freerdp_settings_set_string(settings, FreeRDP_ServerHostname, hostname) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ServerPort, port))
+	{
+		free(hostname);
+		return FALSE;
+	}
+
+	free(hostname);
+	return TRUE;
+}
+
+static BOOL pf_server_get_target_info(rdpContext* context, rdpSettings* settings,
+                                      const proxyConfig* config)
+{
+	if (!pf_server_fetch_target_info(context, settings, config))
+		return FALSE;
+
+	return pf_server_resolve_farm(context, settings);
+}
+
 static BOOL pf_server_setup_channels(freerdp_peer* peer)
 {
 	char** accepted_channels = NULL;
@@ -223,6 +306,21 @@ static BOOL pf_server_setup_channels(freerdp_peer* peer)
  * The server may start sending graphics output and receiving keyboard/mouse
  * input after this callback returns.
  */
+static BOOL pf_server_qos_send(void* context, const proxyChannelDataEventInfo* ev)
+{
+	pServerContext* ps = (pServerContext*)context;
+	freerdp_peer* peer;
+
+	WINPR_ASSERT(ps);
+	WINPR_ASSERT(ev);
+
+	peer = ps->context.peer;
+	WINPR_ASSERT(peer);
+	WINPR_ASSERT(peer->SendChannelPacket);
+	return peer->SendChannelPacket(peer, ev->channel_id, ev->total_size, ev->flags, ev->data,
+	                               ev->data_len);
+}
+
 static BOOL pf_server_post_connect(freerdp_peer* peer)
 {
 	pServerContext* ps;
@@ -239,12 +337,20 @@ static BOOL pf_server_post_connect(freerdp_peer* peer)
 	WINPR_ASSERT(pdata);
 
 	PROXY_LOG_INFO(TAG, ps, "Accepted client: %s", peer->settings->ClientHostname);
+	pdata->server_connect_us = metrics_get_time_us() - pdata->connect_start_us;
 	if (!pf_server_setup_channels(peer))
 	{
 		PROXY_LOG_ERR(TAG, ps, "error setting up channels");
 		return FALSE;
 	}
 
+	if (pdata->config->QoS)
+	{
+		ps->qos = pf_qos_new(pdata->config, pf_server_qos_send, ps);
+		if (!ps->qos)
+			return FALSE;
+	}
+
 	pc = pf_context_create_client_context(peer->settings);
 	if (pc == NULL)
 	{
@@ -430,15 +536,16 @@ original_cb:
 	                                                   totalSize);
 }
 
-static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
+static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer,
+                                                 const proxyServerSnapshot* snapshot)
 {
 	pServerContext* ps;
 	rdpSettings* settings;
 	proxyData* pdata;
 	const proxyConfig* config;
-	proxyServer* server;
 
 	WINPR_ASSERT(peer);
+	WINPR_ASSERT(snapshot);
 
 	settings = peer->settings;
 	WINPR_ASSERT(settings);
@@ -450,13 +557,12 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	pdata = proxy_data_new();
 	if (!pdata)
 		return FALSE;
-	server = (proxyServer*)peer->ContextExtra;
-	WINPR_ASSERT(server);
 
 	proxy_data_set_server_context(pdata, ps);
+	pdata->connect_start_us = metrics_get_time_us();
 
-	pdata->module = server->module;
-	config = pdata->config = server->config;
+	pdata->module = snapshot->module;
+	config = pdata->config = snapshot->config;
 
 	/* currently not supporting GDI orders */
 	ZeroMemory(settings->OrderSupport, 32);
@@ -498,6 +604,13 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	settings->RdpSecurity = config->ServerRdpSecurity;
 	settings->TlsSecurity = config->ServerTlsSecurity;
 	settings->NlaSecurity = config->ServerNlaSecurity;
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_MaxConcurrentHandshakes,
+	                                 config->MaxHandshakes) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_HandshakeQueueTimeout,
+	                                 config->HandshakeTimeout))
+		return FALSE;
+
 	settings->EncryptionLevel = ENCRYPTION_LEVEL_CLIENT_COMPATIBLE;
 	settings->ColorDepth = 32;
 	settings->SuppressOutput = TRUE;
@@ -519,37 +632,369 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	return TRUE;
 }
 
+static BOOL pf_server_log_metric(void* custom, const char* line)
+{
+	WINPR_UNUSED(custom);
+	WLog_DBG(TAG, "%s", line);
+	return TRUE;
+}
+
+static BOOL pf_server_export_value(pMetricsExportLine fkt, void* custom, const char* type,
+                                   const char* name, const char* labels, UINT64 value)
+{
+	char line[256] = { 0 };
+
+	_snprintf(line, sizeof(line), "# TYPE %s %s", name, type);
+	if (!fkt(custom, line))
+		return FALSE;
+
+	_snprintf(line, sizeof(line), "%s{%s} %" PRIu64, name, labels, value);
+	return fkt(custom, line);
+}
+
+static BOOL pf_server_export_session(peer_session* session, pMetricsExportLine fkt, void* custom)
+{
+	char labels[128] = { 0 };
+	pServerContext* ps;
+	pClientContext* pc;
+	proxyData* pdata;
+
+	ps = (pServerContext*)session->client->context;
+	if (!ps || !ps->pdata)
+		return TRUE;
+
+	pdata = ps->pdata;
+	_snprintf(labels, sizeof(labels), "session=\"%s\",leg=\"client\"", pdata->session_id);
+
+	if (!metrics_export(ps->context.metrics, labels, fkt, custom) ||
+	    !pf_server_export_value(fkt, custom, "gauge", "freerdp_proxy_connect_microseconds",
+	                            labels, pdata->server_connect_us) ||
+	    !pf_server_export_value(fkt, custom, "gauge", "freerdp_proxy_qos_queued_fragments",
+	                            labels, ps->qos ? pf_qos_get_queued(ps->qos) : 0))
+		return FALSE;
+
+	pc = pdata->pc;
+	if (pc)
+	{
+		_snprintf(labels, sizeof(labels), "session=\"%s\",leg=\"target\"", pdata->session_id);
+
+		if (!metrics_export(pc->context.metrics, labels, fkt, custom) ||
+		    !pf_server_export_value(fkt, custom, "gauge", "freerdp_proxy_connect_microseconds",
+		                            labels, pdata->client_connect_us) ||
+		    !pf_server_export_value(fkt, custom, "gauge", "freerdp_proxy_qos_queued_fragments",
+		                            labels, pc->qos ? pf_qos_get_queued(pc->qos) : 0) ||
+		    !pf_server_export_value(fkt, custom, "gauge", "freerdp_proxy_cached_channel_data",
+		                            labels, Queue_Count(pc->cached_server_channel_data)))
+			return FALSE;
+	}
+
+	_snprintf(labels, sizeof(labels), "session=\"%s\"", pdata->session_id);
+	return pf_server_export_value(fkt, custom, "counter", "freerdp_proxy_module_calls_total",
+	                              labels, (UINT64)pdata->module_calls) &&
+	       pf_server_export_value(fkt, custom, "counter",
+	                              "freerdp_proxy_module_microseconds_total", labels,
+	                              (UINT64)pdata->module_time_us);
+}
+
+/* sessions leave the list before they are freed, holding its lock keeps them alive */
+static BOOL pf_server_collect_metrics(void* context, pMetricsExportLine fkt, void* custom)
+{
+	size_t x;
+	size_t count;
+	BOOL rc = TRUE;
+	char line[128] = { 0 };
+	proxyServer* server = context;
+
+	WINPR_ASSERT(server);
+
+	ArrayList_Lock(server->peer_list);
+	count = ArrayList_Count(server->peer_list);
+
+	for (x = 0; rc && (x < count); x++)
+		rc = pf_server_export_session(ArrayList_GetItem(server->peer_list, x), fkt, custom);
+
+	ArrayList_Unlock(server->peer_list);
+
+	if (!rc || !fkt(custom, "# TYPE freerdp_proxy_sessions gauge"))
+		return FALSE;
+
+	_snprintf(line, sizeof(line), "freerdp_proxy_sessions %" PRIuz, count);
+	return fkt(custom, line);
+}
+
+static DWORD pf_server_session_get_event_handles(void* arg, HANDLE* handles, DWORD count)
+{
+	DWORD nCount;
+	peer_session* session = arg;
+	freerdp_peer* client;
+	pServerContext* ps;
+	proxyData* pdata;
+	HANDLE ChannelEvent;
+
+	WINPR_ASSERT(session);
+	client = session->client;
+	WINPR_ASSERT(client);
+	ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+	pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
+
+	WINPR_ASSERT(client->GetEventHandles);
+	nCount = client->GetEventHandles(client, handles, count);
+
+	if ((nCount == 0) || (count - nCount < 4))
+	{
+		WLog_ERR(TAG, "Failed to get FreeRDP transport event handles");
+		return 0;
+	}
+
+	ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+
+	WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
+	WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
+	handles[nCount++] = ChannelEvent;
+	handles[nCount++] = pdata->abort_event;
+
+	if (ps->qos)
+		handles[nCount++] = pf_qos_get_event_handle(ps->qos);
+
+	if (pdata->client_thread)
+		handles[nCount++] = pdata->client_thread;
+	else if (session->client_running)
+	{
+		const DWORD tmp = pf_client_get_event_handles(pdata->pc, &handles[nCount], count - nCount);
+
+		if (tmp == 0)
+			return 0;
+
+		nCount += tmp;
+	}
+
+	return nCount;
+}
+
+/* Checks both legs of the session, returns FALSE once the session ended */
+static BOOL pf_server_session_check_event_handles(void* arg)
+{
+	peer_session* session = arg;
+	freerdp_peer* client;
+	proxyServer* server;
+	pServerContext* ps;
+	proxyData* pdata;
+	HANDLE ChannelEvent;
+
+	WINPR_ASSERT(session);
+	client = session->client;
+	WINPR_ASSERT(client);
+	server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+	ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+	pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
+
+	WINPR_ASSERT(client->CheckFileDescriptor);
+	if (client->CheckFileDescriptor(client) != TRUE)
+		return FALSE;
+
+	ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+
+	if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+		{
+			WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
+			return FALSE;
+		}
+	}
+
+	/* only disconnect after checking client's and vcm's file descriptors  */
+	if (proxy_data_shall_disconnect(pdata))
+	{
+		WLog_INFO(TAG, "abort event is set, closing connection with peer %s", client->hostname);
+		return FALSE;
+	}
+
+	if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
+	{
+		WLog_INFO(TAG, "Server shutting down, terminating peer");
+		return FALSE;
+	}
+
+	switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+	{
+		/* Dynamic channel status may have been changed after processing */
+		case DRDYNVC_STATE_NONE:
+
+			/* Initialize drdynvc channel */
+			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+			{
+				WLog_ERR(TAG, "Failed to initialize drdynvc channel");
+				return FALSE;
+			}
+
+			break;
+
+		case DRDYNVC_STATE_READY:
+			if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
+			{
+				SetEvent(ps->dynvcReady);
+			}
+
+			break;
+
+		default:
+			break;
+	}
+
+	if (ps->qos && !pf_qos_flush(ps->qos))
+		return FALSE;
+
+	if (session->client_running && !pf_client_check_event_handles(pdata->pc))
+		return FALSE;
+
+	return TRUE;
+}
+
+static void pf_server_session_free(peer_session* session)
+{
+	size_t count;
+	freerdp_peer* client;
+	proxyServer* server;
+	pServerContext* ps;
+	proxyData* pdata = NULL;
+
+	WINPR_ASSERT(session);
+	client = session->client;
+	WINPR_ASSERT(client);
+	server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+
+	ps = (pServerContext*)client->context;
+	if (ps)
+		pdata = ps->pdata;
+
+	PROXY_LOG_INFO(TAG, ps, "freeing proxy data");
+
+	if (pdata && pdata->client_thread)
+	{
+		proxy_data_abort_connect(pdata);
+		WaitForSingleObject(pdata->client_thread, INFINITE);
+	}
+
+	if (pdata && session->client_running)
+	{
+		proxy_data_abort_connect(pdata);
+		pf_client_disconnect(pdata->pc);
+		session->client_running = FALSE;
+	}
+
+	{
+		ArrayList_Lock(server->peer_list);
+		ArrayList_Remove(server->peer_list, session);
+		count = ArrayList_Count(server->peer_list);
+		ArrayList_Unlock(server->peer_list);
+	}
+	PROXY_LOG_DBG(TAG, ps, "Removed peer, %" PRIuz " connected", count);
+
+	if (server->farms && pdata)
+		pf_target_resolver_release(server->farms, pdata);
+
+	freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+	proxy_data_free(pdata);
+	pf_server_snapshot_release(session->snapshot);
+
+#if defined(WITH_DEBUG_EVENTS)
+	DumpEventHandles();
+#endif
+	free(session);
+}
+
+static void pf_server_session_close(void* arg)
+{
+	peer_session* session = arg;
+	freerdp_peer* client;
+	pServerContext* ps;
+	proxyData* pdata;
+
+	WINPR_ASSERT(session);
+	client = session->client;
+	WINPR_ASSERT(client);
+	ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+	pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
+
+	PROXY_LOG_INFO(TAG, ps, "starting shutdown of connection");
+	PROXY_LOG_INFO(TAG, ps, "stopping proxy's client");
+
+	/* Abort the client. */
+	proxy_data_abort_connect(pdata);
+
+	pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_END, pdata, client);
+
+	if (WLog_IsLevelActive(WLog_Get(TAG), WLOG_DEBUG))
+	{
+		char labels[128] = { 0 };
+		_snprintf(labels, sizeof(labels), "session=\"%s\"", pdata->session_id);
+		metrics_export(client->context->metrics, labels, pf_server_log_metric, NULL);
+	}
+
+	PROXY_LOG_INFO(TAG, ps, "freeing server's channels");
+
+	WINPR_ASSERT(client->Close);
+	client->Close(client);
+
+	WINPR_ASSERT(client->Disconnect);
+	client->Disconnect(client);
+
+	pf_server_session_free(session);
+}
+
+static const proxyWorkerCallbacks pf_server_session_callbacks = {
+	pf_server_session_get_event_handles, pf_server_session_check_event_handles,
+	pf_server_session_close
+};
+
 /**
- * Handles an incoming client connection, to be run in it's own thread.
+ * Handles an incoming client connection until the proxy's client connected to the target,
+ * to be run in it's own thread. A worker drives both connections from then on.
  *
- * arg is a pointer to a freerdp_peer representing the client.
+ * arg is a pointer to a peer_session representing the client.
  */
 static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 {
 	HANDLE eventHandles[MAXIMUM_WAIT_OBJECTS] = { 0 };
-	DWORD tmp;
+	WINPR_WAIT_SET* waitSet = NULL;
 	DWORD status;
 	pServerContext* ps = NULL;
 	proxyData* pdata = NULL;
 	freerdp_peer* client;
 	proxyServer* server;
 	size_t count;
-	peer_thread_args* args = arg;
+	peer_session* session = arg;
 
-	WINPR_ASSERT(args);
+	WINPR_ASSERT(session);
 
-	client = args->client;
+	client = session->client;
 	WINPR_ASSERT(client);
 
 	server = (proxyServer*)client->ContextExtra;
 	WINPR_ASSERT(server);
 
+	/* keep the handshake on the workers' processors, the target connection thread inherits it */
+	if ((server->config->ThreadAffinity != 0) &&
+	    (SetThreadAffinityMask(_GetCurrentThread(), (DWORD_PTR)server->config->ThreadAffinity) ==
+	     0))
+		WLog_WARN(TAG, "failed to set the session thread affinity");
+
 	count = ArrayList_Count(server->peer_list);
 
 	if (!pf_context_init_server_context(client))
 		goto out_free_peer;
 
-	if (!pf_server_initialize_peer_connection(client))
+	if (!pf_server_initialize_peer_connection(client, session->snapshot))
 		goto out_free_peer;
 
 	ps = (pServerContext*)client->context;
@@ -565,167 +1010,120 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 	PROXY_LOG_INFO(TAG, ps, "new connection: proxy address: %s, client address: %s",
 	               pdata->config->Host, client->hostname);
 
+	/* the handles rarely change, keep them registered between iterations */
+	waitSet = winpr_WaitSetNew();
+	if (!waitSet)
+		goto fail;
+
 	while (1)
 	{
-		HANDLE ChannelEvent = INVALID_HANDLE_VALUE;
-		DWORD eventCount = 0;
-		{
-			WINPR_ASSERT(client->GetEventHandles);
-			tmp = client->GetEventHandles(client, &eventHandles[eventCount],
-			                              ARRAYSIZE(eventHandles) - eventCount);
+		DWORD eventCount = pf_server_session_get_event_handles(session, eventHandles,
+		                                                       ARRAYSIZE(eventHandles) - 1);
 
-			if (tmp == 0)
-			{
-				WLog_ERR(TAG, "Failed to get FreeRDP transport event handles");
-				break;
-			}
-
-			eventCount += tmp;
-		}
-		/* Main client event handling loop */
-		ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+		if (eventCount == 0)
+			break;
 
-		WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
-		WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
-		eventHandles[eventCount++] = ChannelEvent;
-		eventHandles[eventCount++] = pdata->abort_event;
 		eventHandles[eventCount++] = server->stopEvent;
 
-		status = WaitForMultipleObjects(eventCount, eventHandles, FALSE,
-		                                1000); /* Do periodic polling to avoid client hang */
-
-		if (status == WAIT_FAILED)
+		if (!winpr_WaitSetUpdate(waitSet, eventCount, eventHandles))
 		{
-			WLog_ERR(TAG, "WaitForMultipleObjects failed (status: %d)", status);
+			WLog_ERR(TAG, "winpr_WaitSetUpdate failed");
 			break;
 		}
 
-		WINPR_ASSERT(client->CheckFileDescriptor);
-		if (client->CheckFileDescriptor(client) != TRUE)
-			break;
-
-		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
-		{
-			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-			{
-				WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
-				goto fail;
-			}
-		}
+		/* Do periodic polling to avoid client hang */
+		status = winpr_WaitSetWait(waitSet, 1000);
 
-		/* only disconnect after checking client's and vcm's file descriptors  */
-		if (proxy_data_shall_disconnect(pdata))
+		if (status == WAIT_FAILED)
 		{
-			WLog_INFO(TAG, "abort event is set, closing connection with peer %s", client->hostname);
+			WLog_ERR(TAG, "winpr_WaitSetWait failed (status: %d)", status);
 			break;
 		}
 
-		if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
-		{
-			WLog_INFO(TAG, "Server shutting down, terminating peer");
+		if (!pf_server_session_check_event_handles(session))
 			break;
-		}
 
-		switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+		if (pdata->client_thread && (WaitForSingleObject(pdata->client_thread, 0) == WAIT_OBJECT_0))
 		{
-			/* Dynamic channel status may have been changed after processing */
-			case DRDYNVC_STATE_NONE:
+			DWORD exitCode = 1;
 
-				/* Initialize drdynvc channel */
-				if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-				{
-					WLog_ERR(TAG, "Failed to initialize drdynvc channel");
-					goto fail;
-				}
+			GetExitCodeThread(pdata->client_thread, &exitCode);
+			CloseHandle(pdata->client_thread);
+			pdata->client_thread = NULL;
 
+			if (exitCode != 0)
+			{
+				PROXY_LOG_ERR(TAG, ps, "proxy's client failed to connect");
 				break;
+			}
 
-			case DRDYNVC_STATE_READY:
-				if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
-				{
-					SetEvent(ps->dynvcReady);
-				}
+			/* both connections are established, hand them to a worker */
+			session->client_running = TRUE;
+			winpr_WaitSetFree(waitSet);
 
-				break;
+			if (pf_worker_pool_add(server->workers, session, &pf_server_session_callbacks))
+				goto out;
 
-			default:
-				break;
+			waitSet = NULL;
+			break;
 		}
 	}
 
 fail:
-
-	PROXY_LOG_INFO(TAG, ps, "starting shutdown of connection");
-	PROXY_LOG_INFO(TAG, ps, "stopping proxy's client");
-
-	/* Abort the client. */
-	proxy_data_abort_connect(pdata);
-
-	pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_END, pdata, client);
-
-
-	PROXY_LOG_INFO(TAG, ps, "freeing server's channels");
-
-	WINPR_ASSERT(client->Close);
-	client->Close(client);
-
-	WINPR_ASSERT(client->Disconnect);
-	client->Disconnect(client);
+	winpr_WaitSetFree(waitSet);
+	pf_server_session_close(session);
+	goto out;
 
 out_free_peer:
-	PROXY_LOG_INFO(TAG, ps, "freeing proxy data");
-
-	if (pdata && pdata->client_thread)
-	{
-		proxy_data_abort_connect(pdata);
-		WaitForSingleObject(pdata->client_thread, INFINITE);
-	}
-
-	{
-		ArrayList_Lock(server->peer_list);
-		ArrayList_Remove(server->peer_list, args->thread);
-		count = ArrayList_Count(server->peer_list);
-		ArrayList_Unlock(server->peer_list);
-	}
-	PROXY_LOG_DBG(TAG, ps, "Removed peer, %" PRIuz " connected", count);
-	freerdp_peer_context_free(client);
-	freerdp_peer_free(client);
-	proxy_data_free(pdata);
-
-#if defined(WITH_DEBUG_EVENTS)
-	DumpEventHandles();
-#endif
-	free(args);
+	pf_server_session_free(session);
+out:
 	ExitThread(0);
 	return 0;
 }
 
 static BOOL pf_server_start_peer(freerdp_peer* client)
 {
+	BOOL rc;
 	HANDLE hThread;
 	proxyServer* server;
-	peer_thread_args* args = calloc(1, sizeof(peer_thread_args));
-	if (!args)
+	peer_session* session = calloc(1, sizeof(peer_session));
+	if (!session)
 		return FALSE;
 
 	WINPR_ASSERT(client);
-	args->client = client;
+	session->client = client;
 
 	server = (proxyServer*)client->ContextExtra;
 	WINPR_ASSERT(server);
 
-	hThread = CreateThread(NULL, 0, pf_server_handle_peer, args, CREATE_SUSPENDED, NULL);
-	if (!hThread)
+	/* the session keeps the configuration it started with */
+	session->snapshot = pf_server_snapshot_acquire(server);
+
+	ArrayList_Lock(server->peer_list);
+	rc = ArrayList_Append(server->peer_list, session);
+	ArrayList_Unlock(server->peer_list);
+
+	if (!rc)
+	{
+		pf_server_snapshot_release(session->snapshot);
+		free(session);
 		return FALSE;
+	}
 
-	args->thread = hThread;
-	if (!ArrayList_Append(server->peer_list, hThread))
+	hThread = CreateThread(NULL, 0, pf_server_handle_peer, session, 0, NULL);
+	if (!hThread)
 	{
-		CloseHandle(hThread);
+		ArrayList_Lock(server->peer_list);
+		ArrayList_Remove(server->peer_list, session);
+		ArrayList_Unlock(server->peer_list);
+		pf_server_snapshot_release(session->snapshot);
+		free(session);
 		return FALSE;
 	}
 
-	return ResumeThread(hThread) != (DWORD)-1;
+	/* the session owns itself, the thread is detached */
+	CloseHandle(hThread);
+	return TRUE;
 }
 
 static BOOL pf_server_peer_accepted(freerdp_listener* listener, freerdp_peer* client)
@@ -869,15 +1267,58 @@ static BOOL are_all_required_modules_loaded(proxyModule* module, const proxyConf
 	return TRUE;
 }
 
-static void peer_free(void* obj)
+static BOOL pf_server_add_builtin_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
 {
-	HANDLE hdl = (HANDLE)obj;
-	CloseHandle(hdl);
+	const proxyServerBuiltinModule* builtin = data;
+	proxyModule* module = va_arg(ap, proxyModule*);
+
+	WINPR_UNUSED(index);
+	WINPR_ASSERT(builtin);
+
+	return pf_modules_add(module, builtin->ep, builtin->userdata);
+}
+
+static proxyServerSnapshot* pf_server_snapshot_new(proxyServer* server, const proxyConfig* config)
+{
+	proxyServerSnapshot* snapshot = calloc(1, sizeof(proxyServerSnapshot));
+
+	if (!snapshot)
+		return NULL;
+
+	snapshot->refs = 1;
+
+	if (!pf_config_clone(&snapshot->config, config))
+		goto fail;
+
+	snapshot->module = pf_modules_new(FREERDP_PROXY_PLUGINDIR,
+	                                  pf_config_modules(snapshot->config),
+	                                  pf_config_modules_count(snapshot->config));
+	if (!snapshot->module)
+	{
+		WLog_ERR(TAG, "failed to initialize proxy modules!");
+		goto fail;
+	}
+
+	if (!pf_modules_add(snapshot->module, pf_config_plugin, (void*)snapshot->config))
+		goto fail;
+
+	if (!ArrayList_ForEach(server->builtins, pf_server_add_builtin_ArrayList_ForEachFkt,
+	                       snapshot->module))
+		goto fail;
+
+	pf_modules_list_loaded_plugins(snapshot->module);
+	if (!are_all_required_modules_loaded(snapshot->module, snapshot->config))
+		goto fail;
+
+	return snapshot;
+
+fail:
+	pf_server_snapshot_release(snapshot);
+	return NULL;
 }
 
 proxyServer* pf_server_new(const proxyConfig* config)
 {
-	wObject* obj;
 	proxyServer* server;
 
 	WINPR_ASSERT(config);
@@ -886,19 +1327,23 @@ proxyServer* pf_server_new(const proxyConfig* config)
 	if (!server)
 		return NULL;
 
+	if (!InitializeCriticalSectionAndSpinCount(&server->lock, 4000))
+	{
+		free(server);
+		return NULL;
+	}
+
 	if (!pf_config_clone(&server->config, config))
 		goto out;
 
-	server->module = pf_modules_new(FREERDP_PROXY_PLUGINDIR, pf_config_modules(server->config),
-	                                pf_config_modules_count(server->config));
-	if (!server->module)
-	{
-		WLog_ERR(TAG, "failed to initialize proxy modules!");
+	server->builtins = ArrayList_New(TRUE);
+	if (!server->builtins)
 		goto out;
-	}
 
-	pf_modules_list_loaded_plugins(server->module);
-	if (!are_all_required_modules_loaded(server->module, server->config))
+	ArrayList_Object(server->builtins)->fnObjectFree = free;
+
+	server->snapshot = pf_server_snapshot_new(server, server->config);
+	if (!server->snapshot)
 		goto out;
 
 	server->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
@@ -909,21 +1354,46 @@ proxyServer* pf_server_new(const proxyConfig* config)
 	if (!server->listener)
 		goto out;
 
+	/* the sessions, owned by their thread until connected, by a worker afterwards */
 	server->peer_list = ArrayList_New(FALSE);
 	if (!server->peer_list)
 		goto out;
 
-	obj = ArrayList_Object(server->peer_list);
-	WINPR_ASSERT(obj);
+	server->workers = pf_worker_pool_new(server->config->Workers, server->config->ThreadAffinity);
+	if (!server->workers)
+		goto out;
+
+	if (server->config->TargetPoolSize > 0)
+	{
+		server->targets = pf_target_pool_new(server->config);
+		if (!server->targets)
+			goto out;
+
+		if (server->config->FixedTarget &&
+		    !pf_target_pool_add(server->targets, server->config->TargetHost,
+		                        server->config->TargetPort))
+			goto out;
+	}
+
+	if (server->config->FarmFile)
+	{
+		server->farms = pf_target_resolver_new(server->config);
+		if (!server->farms)
+			goto out;
+	}
 
-	obj->fnObjectFree = peer_free;
+	if (server->config->MetricsPort > 0)
+	{
+		server->metrics =
+		    pf_metrics_server_new(server->config->MetricsHost, server->config->MetricsPort,
+		                          pf_server_collect_metrics, server);
+		if (!server->metrics)
+			goto out;
+	}
 
 	server->listener->info = server;
 	server->listener->PeerAccepted = pf_server_peer_accepted;
 
-	if (!pf_modules_add(server->module, pf_config_plugin, (void*)server->config))
-		goto out;
-
 	return server;
 
 out:
@@ -1009,20 +1479,26 @@ void pf_server_free(proxyServer* server)
 		/* pf_server_stop triggers the threads to shut down.
 		 * loop here until all of them stopped.
 		 *
-		 * This must be done before ArrayList_Free otherwise the thread removal
-		 * in pf_server_handle_peer will deadlock due to both threads trying to
+		 * This must be done before ArrayList_Free otherwise the session removal
+		 * in pf_server_session_free will deadlock due to both threads trying to
 		 * lock the list.
 		 */
 		Sleep(100);
 	}
+	pf_metrics_server_free(server->metrics);
+	pf_worker_pool_free(server->workers);
+	pf_target_pool_free(server->targets);
+	pf_target_resolver_free(server->farms);
 	ArrayList_Free(server->peer_list);
 	freerdp_listener_free(server->listener);
 
 	if (server->stopEvent)
 		CloseHandle(server->stopEvent);
 
+	pf_server_snapshot_release(server->snapshot);
+	ArrayList_Free(server->builtins);
 	pf_server_config_free(server->config);
-	pf_modules_free(server->module);
+	DeleteCriticalSection(&server->lock);
 	free(server);
 
 #if defined(WITH_DEBUG_EVENTS)
@@ -1032,8 +1508,75 @@ void pf_server_free(proxyServer* server)
 
 BOOL pf_server_add_module(proxyServer* server, proxyModuleEntryPoint ep, void* userdata)
 {
+	BOOL rc = FALSE;
+	proxyServerBuiltinModule* builtin;
+
 	WINPR_ASSERT(server);
 	WINPR_ASSERT(ep);
 
-	return pf_modules_add(server->module, ep, userdata);
+	builtin = calloc(1, sizeof(proxyServerBuiltinModule));
+	if (!builtin)
+		return FALSE;
+
+	builtin->ep = ep;
+	builtin->userdata = userdata;
+
+	/* added to the snapshots loaded later, too */
+	EnterCriticalSection(&server->lock);
+
+	if (pf_modules_add(server->snapshot->module, ep, userdata))
+	{
+		rc = ArrayList_Append(server->builtins, builtin);
+		if (rc)
+			builtin = NULL;
+	}
+
+	LeaveCriticalSection(&server->lock);
+	free(builtin);
+	return rc;
+}
+
+BOOL pf_server_reload(proxyServer* server, const proxyConfig* config)
+{
+	proxyServerSnapshot* snapshot;
+	proxyServerSnapshot* old;
+
+	WINPR_ASSERT(server);
+	WINPR_ASSERT(config);
+
+	snapshot = pf_server_snapshot_new(server, config);
+	if (!snapshot)
+	{
+		WLog_ERR(TAG, "failed to load the new configuration, keeping the current one");
+		return FALSE;
+	}
+
+	if ((strcmp(config->Host, server->config->Host) != 0) ||
+	    (config->Port != server->config->Port) || (config->Workers != server->config->Workers) ||
+	    (config->ThreadAffinity != server->config->ThreadAffinity) ||
+	    (config->TargetPoolSize != server->config->TargetPoolSize) ||
+	    (config->TargetPoolIdleTimeout != server->config->TargetPoolIdleTimeout) ||
+	    (strcmp(config->MetricsHost, server->config->MetricsHost) != 0) ||
+	    (config->MetricsPort != server->config->MetricsPort) ||
+	    (strcmp(config->FarmFile ? config->FarmFile : "",
+	            server->config->FarmFile ? server->config->FarmFile : "") != 0) ||
+	    (config->FarmRefreshInterval != server->config->FarmRefreshInterval) ||
+	    (config->FarmStickyTimeout != server->config->FarmStickyTimeout))
+		WLog_WARN(TAG, "changes of the listener, workers, target pool, farm file and metrics "
+		               "endpoint need a restart, the farms in the file are reloaded as it changes");
+
+	if (server->targets && config->FixedTarget &&
+	    !pf_target_pool_add(server->targets, config->TargetHost, config->TargetPort))
+		WLog_WARN(TAG, "failed to pool connections to %s:%" PRIu16, config->TargetHost,
+		          config->TargetPort);
+
+	EnterCriticalSection(&server->lock);
+	old = server->snapshot;
+	server->snapshot = snapshot;
+	LeaveCriticalSection(&server->lock);
+
+	/* the sessions started with the old snapshot keep it until they end */
+	pf_server_snapshot_release(old);
+	WLog_INFO(TAG, "configuration reloaded, new sessions use it");
+	return TRUE;
 }
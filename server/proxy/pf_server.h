@@ -29,15 +29,43 @@
 
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
+#include "pf_worker.h"
+#include "pf_target_pool.h"
+#include "pf_target_resolver.h"
+#include "pf_metrics.h"
 
-struct proxy_server
+/**
+ * A configuration with the modules loaded for it. Sessions keep the snapshot they started with,
+ * it is freed once the last of them ended after a newer snapshot replaced it.
+ */
+typedef struct
 {
-	proxyModule* module;
 	proxyConfig* config;
+	proxyModule* module;
+	volatile LONG refs;
+} proxyServerSnapshot;
+
+typedef struct
+{
+	proxyModuleEntryPoint ep;
+	void* userdata;
+} proxyServerBuiltinModule;
+
+struct proxy_server
+{
+	proxyConfig* config; /* the listener, workers and target pool are set up with this one */
+
+	CRITICAL_SECTION lock;
+	proxyServerSnapshot* snapshot; /* used by new sessions, guarded by the lock */
+	wArrayList* builtins;          /* proxyServerBuiltinModule added to every snapshot */
 
 	freerdp_listener* listener;
 	HANDLE stopEvent;           /* an event used to signal the main thread to stop */
 	wArrayList* peer_list;
+	proxyWorkerPool* workers; /* drive the connected sessions */
+	proxyTargetPool* targets; /* connected sockets to the targets, NULL if disabled */
+	proxyTargetResolver* farms;  /* selects the targets of farms, NULL if disabled */
+	proxyMetricsServer* metrics; /* serves the metrics of the sessions, NULL if disabled */
 };
 
 #endif /* INT_FREERDP_SERVER_PROXY_SERVER_H */
@@ -0,0 +1,584 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/string.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+#include <winpr/winsock.h>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#else
+#include <sys/select.h>
+#endif
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_target_pool.h"
+
+#define TAG PROXY_TAG("target.pool")
+
+/**
+ * The pool keeps up to PoolSize connected TCP sockets per target and hands them to the sessions
+ * connecting there, which saves the name lookup and the TCP handshake when a user logs on.
+ * TLS and NLA can not be established in advance: both start after the X.224 negotiation, which
+ * carries the routing token and the protocols of the session, and NLA uses the user's
+ * credentials.
+ *
+ * The configured fixed target is kept forever, targets selected by a routing token are learned
+ * on their first use and dropped once unused for a while.
+ */
+#define PF_TARGET_POOL_INTERVAL 1000
+#define PF_TARGET_POOL_CONNECT_TIMEOUT 5000
+#define PF_TARGET_POOL_DNS_TTL 60000
+#define PF_TARGET_POOL_MAX_BACKOFF 60000
+#define PF_TARGET_POOL_MAX_TARGETS 64
+/* learned targets are dropped after this many idle timeouts without a session */
+#define PF_TARGET_POOL_STALE_FACTOR 10
+
+typedef struct
+{
+	SOCKET s;
+	UINT64 connected;
+} proxyPooledSocket;
+
+typedef struct
+{
+	char* hostname;
+	UINT16 port;
+	BOOL pinned;
+
+	/* guarded by the pool lock */
+	UINT64 lastUsed;
+	proxyPooledSocket* sockets;
+	size_t count;
+
+	/* only used by the pool thread */
+	struct addrinfo* addresses;
+	UINT64 resolved;
+	UINT64 retry;
+	UINT32 backoff;
+} proxyPoolTarget;
+
+struct proxy_target_pool
+{
+	CRITICAL_SECTION lock;
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE wakeEvent;
+	size_t size;
+	UINT64 idleTimeout;
+
+	/* guarded by the lock, only the pool thread removes targets */
+	proxyPoolTarget** targets;
+	size_t count;
+};
+
+/* @return 1 if the socket is ready, 0 on timeout and -1 on failure */
+static int pf_target_pool_poll(SOCKET s, BOOL write, int timeout)
+{
+	int status;
+#ifdef HAVE_POLL_H
+	struct pollfd pollset = { 0 };
+
+	pollset.fd = s;
+	pollset.events = write ? POLLOUT : POLLIN;
+
+	do
+	{
+		status = poll(&pollset, 1, timeout);
+	} while ((status < 0) && (errno == EINTR));
+#else
+	fd_set set;
+	fd_set except;
+	struct timeval tv = { 0 };
+
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+	FD_ZERO(&set);
+	FD_ZERO(&except);
+	FD_SET(s, &set);
+	FD_SET(s, &except);
+
+	status = select((int)s + 1, write ? NULL : &set, write ? &set : NULL, &except, &tv);
+#endif
+
+	if (status > 0)
+		return 1;
+
+	return status;
+}
+
+/* the target sends nothing before the connection request, anything to read is a close */
+static BOOL pf_target_pool_is_healthy(SOCKET s)
+{
+	return pf_target_pool_poll(s, FALSE, 0) == 0;
+}
+
+static SOCKET pf_target_pool_connect_address(const struct addrinfo* addr)
+{
+	int error = 0;
+	int optval = 1;
+	u_long arg = 1;
+	socklen_t length = sizeof(error);
+	SOCKET s = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+
+	if (s == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	if (_ioctlsocket(s, FIONBIO, &arg) != 0)
+		goto fail;
+
+	if (connect(s, addr->ai_addr, (int)addr->ai_addrlen) != 0)
+	{
+#ifdef _WIN32
+		if (WSAGetLastError() != WSAEWOULDBLOCK)
+			goto fail;
+#else
+		if (errno != EINPROGRESS)
+			goto fail;
+#endif
+
+		if (pf_target_pool_poll(s, TRUE, PF_TARGET_POOL_CONNECT_TIMEOUT) <= 0)
+			goto fail;
+
+		if ((getsockopt(s, SOL_SOCKET, SO_ERROR, (void*)&error, &length) != 0) || (error != 0))
+			goto fail;
+	}
+
+	arg = 0;
+	if (_ioctlsocket(s, FIONBIO, &arg) != 0)
+		goto fail;
+
+	/* the transport does not touch external sockets, set what it would have set */
+	if (setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (void*)&optval, sizeof(optval)) < 0)
+		WLog_WARN(TAG, "unable to set TCP_NODELAY");
+
+	if (setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, (void*)&optval, sizeof(optval)) < 0)
+		WLog_WARN(TAG, "unable to set SO_KEEPALIVE");
+
+	return s;
+
+fail:
+	closesocket(s);
+	return INVALID_SOCKET;
+}
+
+static BOOL pf_target_pool_resolve(proxyPoolTarget* target, UINT64 now)
+{
+	char service[16] = { 0 };
+	struct addrinfo hints = { 0 };
+	struct addrinfo* result = NULL;
+
+	if (target->addresses && (now - target->resolved < PF_TARGET_POOL_DNS_TTL))
+		return TRUE;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	sprintf_s(service, sizeof(service), "%" PRIu16, target->port);
+
+	if (getaddrinfo(target->hostname, service, &hints, &result) != 0)
+	{
+		WLog_WARN(TAG, "failed to resolve %s", target->hostname);
+		/* keep using the last result until the name resolves again */
+		return target->addresses != NULL;
+	}
+
+	if (target->addresses)
+		freeaddrinfo(target->addresses);
+
+	target->addresses = result;
+	target->resolved = now;
+	return TRUE;
+}
+
+static SOCKET pf_target_pool_connect(proxyPoolTarget* target, UINT64 now)
+{
+	const struct addrinfo* addr;
+
+	if (!pf_target_pool_resolve(target, now))
+		return INVALID_SOCKET;
+
+	for (addr = target->addresses; addr; addr = addr->ai_next)
+	{
+		const SOCKET s = pf_target_pool_connect_address(addr);
+
+		if (s != INVALID_SOCKET)
+			return s;
+	}
+
+	/* resolve again on the next attempt, the target might have moved */
+	target->resolved = 0;
+	return INVALID_SOCKET;
+}
+
+static void pf_target_free(proxyPoolTarget* target)
+{
+	size_t x;
+
+	if (!target)
+		return;
+
+	for (x = 0; x < target->count; x++)
+		closesocket(target->sockets[x].s);
+
+	if (target->addresses)
+		freeaddrinfo(target->addresses);
+
+	free(target->sockets);
+	free(target->hostname);
+	free(target);
+}
+
+static proxyPoolTarget* pf_target_new(const proxyTargetPool* pool, const char* hostname,
+                                      UINT16 port, BOOL pinned)
+{
+	proxyPoolTarget* target = calloc(1, sizeof(proxyPoolTarget));
+
+	if (!target)
+		return NULL;
+
+	target->hostname = _strdup(hostname);
+	target->sockets = calloc(pool->size, sizeof(proxyPooledSocket));
+
+	if (!target->hostname || !target->sockets)
+	{
+		pf_target_free(target);
+		return NULL;
+	}
+
+	target->port = port;
+	target->pinned = pinned;
+	target->lastUsed = GetTickCount64();
+	return target;
+}
+
+/* must be called with the lock held */
+static proxyPoolTarget* pf_target_pool_find(proxyTargetPool* pool, const char* hostname,
+                                            UINT16 port)
+{
+	size_t x;
+
+	for (x = 0; x < pool->count; x++)
+	{
+		proxyPoolTarget* target = pool->targets[x];
+
+		if ((target->port == port) && (_stricmp(target->hostname, hostname) == 0))
+			return target;
+	}
+
+	return NULL;
+}
+
+/* must be called with the lock held */
+static BOOL pf_target_pool_register(proxyTargetPool* pool, const char* hostname, UINT16 port,
+                                    BOOL pinned)
+{
+	proxyPoolTarget* target;
+
+	if (pool->count >= PF_TARGET_POOL_MAX_TARGETS)
+		return FALSE;
+
+	target = pf_target_new(pool, hostname, port, pinned);
+	if (!target)
+		return FALSE;
+
+	pool->targets[pool->count++] = target;
+	SetEvent(pool->wakeEvent);
+	return TRUE;
+}
+
+/* closes the expired and broken sockets, must be called with the lock held */
+static void pf_target_pool_expire(proxyTargetPool* pool, proxyPoolTarget* target, UINT64 now)
+{
+	size_t x;
+
+	for (x = target->count; x > 0; x--)
+	{
+		proxyPooledSocket* pooled = &target->sockets[x - 1];
+
+		if ((now - pooled->connected < pool->idleTimeout) && pf_target_pool_is_healthy(pooled->s))
+			continue;
+
+		closesocket(pooled->s);
+		*pooled = target->sockets[--target->count];
+	}
+}
+
+/* @return FALSE if the pool is stopping */
+static BOOL pf_target_pool_refill(proxyTargetPool* pool, proxyPoolTarget* target, size_t missing)
+{
+	while (missing-- > 0)
+	{
+		const UINT64 now = GetTickCount64();
+		SOCKET s;
+
+		if (WaitForSingleObject(pool->stopEvent, 0) == WAIT_OBJECT_0)
+			return FALSE;
+
+		s = pf_target_pool_connect(target, now);
+
+		if (s == INVALID_SOCKET)
+		{
+			target->backoff = MIN(MAX(target->backoff * 2, PF_TARGET_POOL_INTERVAL),
+			                      PF_TARGET_POOL_MAX_BACKOFF);
+			target->retry = now + target->backoff;
+			WLog_WARN(TAG, "failed to connect to %s:%" PRIu16 ", retrying in %" PRIu32 "ms",
+			          target->hostname, target->port, target->backoff);
+			break;
+		}
+
+		target->backoff = 0;
+
+		EnterCriticalSection(&pool->lock);
+
+		if (target->count < pool->size)
+		{
+			target->sockets[target->count].s = s;
+			target->sockets[target->count].connected = GetTickCount64();
+			target->count++;
+			s = INVALID_SOCKET;
+		}
+
+		LeaveCriticalSection(&pool->lock);
+
+		if (s != INVALID_SOCKET)
+			closesocket(s);
+	}
+
+	return TRUE;
+}
+
+static BOOL pf_target_pool_maintain(proxyTargetPool* pool)
+{
+	size_t x = 0;
+
+	while (TRUE)
+	{
+		const UINT64 now = GetTickCount64();
+		proxyPoolTarget* target;
+		size_t missing;
+
+		EnterCriticalSection(&pool->lock);
+
+		if (x >= pool->count)
+		{
+			LeaveCriticalSection(&pool->lock);
+			break;
+		}
+
+		target = pool->targets[x];
+		pf_target_pool_expire(pool, target, now);
+
+		if (!target->pinned &&
+		    (now - target->lastUsed >= pool->idleTimeout * PF_TARGET_POOL_STALE_FACTOR))
+		{
+			pool->targets[x] = pool->targets[--pool->count];
+			LeaveCriticalSection(&pool->lock);
+
+			WLog_DBG(TAG, "dropping unused target %s:%" PRIu16, target->hostname, target->port);
+			pf_target_free(target);
+			continue;
+		}
+
+		missing = pool->size - target->count;
+		LeaveCriticalSection(&pool->lock);
+
+		if ((missing > 0) && (now >= target->retry))
+		{
+			if (!pf_target_pool_refill(pool, target, missing))
+				return FALSE;
+		}
+
+		x++;
+	}
+
+	return TRUE;
+}
+
+static DWORD WINAPI pf_target_pool_thread(LPVOID arg)
+{
+	proxyTargetPool* pool = (proxyTargetPool*)arg;
+	HANDLE handles[2];
+
+	WINPR_ASSERT(pool);
+
+	handles[0] = pool->stopEvent;
+	handles[1] = pool->wakeEvent;
+
+	while (TRUE)
+	{
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE,
+		                                            PF_TARGET_POOL_INTERVAL);
+
+		if ((status == WAIT_OBJECT_0) || (status == WAIT_FAILED))
+			break;
+
+		ResetEvent(pool->wakeEvent);
+
+		if (!pf_target_pool_maintain(pool))
+			break;
+	}
+
+	return 0;
+}
+
+int pf_target_pool_take(proxyTargetPool* pool, const char* hostname, UINT16 port)
+{
+	proxyPoolTarget* target;
+	SOCKET s = INVALID_SOCKET;
+
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(hostname);
+
+	EnterCriticalSection(&pool->lock);
+	target = pf_target_pool_find(pool, hostname, port);
+
+	if (!target)
+	{
+		if (!pf_target_pool_register(pool, hostname, port, FALSE))
+			WLog_DBG(TAG, "not pooling connections to %s:%" PRIu16, hostname, port);
+	}
+	else
+	{
+		target->lastUsed = GetTickCount64();
+
+		/* the most recent socket first, it is the least likely to be timed out */
+		while ((s == INVALID_SOCKET) && (target->count > 0))
+		{
+			s = target->sockets[--target->count].s;
+
+			if (!pf_target_pool_is_healthy(s))
+			{
+				closesocket(s);
+				s = INVALID_SOCKET;
+			}
+		}
+
+		SetEvent(pool->wakeEvent);
+	}
+
+	LeaveCriticalSection(&pool->lock);
+
+	if (s == INVALID_SOCKET)
+		return -1;
+
+	return (int)s;
+}
+
+BOOL pf_target_pool_add(proxyTargetPool* pool, const char* hostname, UINT16 port)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(hostname);
+
+	EnterCriticalSection(&pool->lock);
+
+	if (!pf_target_pool_find(pool, hostname, port))
+		rc = pf_target_pool_register(pool, hostname, port, TRUE);
+
+	LeaveCriticalSection(&pool->lock);
+	return rc;
+}
+
+proxyTargetPool* pf_target_pool_new(const proxyConfig* config)
+{
+	proxyTargetPool* pool;
+
+	WINPR_ASSERT(config);
+	WINPR_ASSERT(config->TargetPoolSize > 0);
+
+	pool = calloc(1, sizeof(proxyTargetPool));
+	if (!pool)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->lock, 4000))
+	{
+		free(pool);
+		return NULL;
+	}
+
+	pool->size = config->TargetPoolSize;
+	pool->idleTimeout = config->TargetPoolIdleTimeout * 1000ull;
+
+	pool->targets = calloc(PF_TARGET_POOL_MAX_TARGETS, sizeof(proxyPoolTarget*));
+	if (!pool->targets)
+		goto fail;
+
+	pool->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!pool->stopEvent)
+		goto fail;
+
+	pool->wakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!pool->wakeEvent)
+		goto fail;
+
+	pool->thread = CreateThread(NULL, 0, pf_target_pool_thread, pool, 0, NULL);
+	if (!pool->thread)
+		goto fail;
+
+	return pool;
+
+fail:
+	WLog_ERR(TAG, "failed to start the target connection pool");
+	pf_target_pool_free(pool);
+	return NULL;
+}
+
+void pf_target_pool_free(proxyTargetPool* pool)
+{
+	size_t x;
+
+	if (!pool)
+		return;
+
+	if (pool->thread)
+	{
+		SetEvent(pool->stopEvent);
+		WaitForSingleObject(pool->thread, INFINITE);
+		CloseHandle(pool->thread);
+	}
+
+	for (x = 0; x < pool->count; x++)
+		pf_target_free(pool->targets[x]);
+
+	free(pool->targets);
+
+	if (pool->wakeEvent)
+		CloseHandle(pool->wakeEvent);
+
+	if (pool->stopEvent)
+		CloseHandle(pool->stopEvent);
+
+	DeleteCriticalSection(&pool->lock);
+	free(pool);
+}
@@ -0,0 +1,46 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_PROXY_PFTARGETPOOL_H
+#define FREERDP_SERVER_PROXY_PFTARGETPOOL_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/server/proxy/proxy_config.h>
+
+typedef struct proxy_target_pool proxyTargetPool;
+
+/**
+ * @brief pf_target_pool_new Starts the thread keeping connected sockets to the targets
+ * @return the new pool or NULL on failure
+ */
+proxyTargetPool* pf_target_pool_new(const proxyConfig* config);
+void pf_target_pool_free(proxyTargetPool* pool);
+
+/**
+ * @brief pf_target_pool_add Registers a target kept connected until the pool is freed
+ */
+BOOL pf_target_pool_add(proxyTargetPool* pool, const char* hostname, UINT16 port);
+
+/**
+ * @brief pf_target_pool_take Takes a connected socket to a target. Unknown targets are
+ * registered and connected for the next sessions.
+ * @return the socket, owned by the caller, or -1 if none is available
+ */
+int pf_target_pool_take(proxyTargetPool* pool, const char* hostname, UINT16 port);
+
+#endif /* FREERDP_SERVER_PROXY_PFTARGETPOOL_H */
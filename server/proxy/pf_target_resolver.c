@@ -0,0 +1,735 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/cmdline.h>
+#include <winpr/collections.h>
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/ini.h>
+#include <winpr/string.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+
+#include <freerdp/types.h>
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_target_resolver.h"
+
+#define TAG PROXY_TAG("target.resolver")
+
+/**
+ * A farm is a name a routing token or the fixed target can use instead of a host, the
+ * resolver sends each session to one of its targets. The farms are read from the [Farms]
+ * section of a file provided by an external broker, "name = host[:port], ...", which is
+ * reloaded by the resolver thread when it changed. Selecting a target only looks up the
+ * tables in memory, sessions never wait for the file.
+ *
+ * Targets are kept across reloads with their session counts and health, a target is dropped
+ * once it is in no farm and has no session left.
+ */
+#define PF_TARGET_RESOLVER_DEFAULT_PORT 3389
+#define PF_TARGET_RESOLVER_MIN_BACKOFF 1000
+#define PF_TARGET_RESOLVER_MAX_BACKOFF 60000
+#define PF_TARGET_RESOLVER_MAX_STICKY 65536
+
+typedef struct
+{
+	char* hostname;
+	UINT16 port;
+	char key[300]; /* hostname:port */
+
+	UINT32 sessions;
+	UINT32 failures;
+	UINT64 downUntil;
+	BOOL listed; /* in a farm of the current file */
+} proxyFarmTarget;
+
+typedef struct
+{
+	proxyFarmTarget** targets;
+	size_t count;
+	size_t next; /* where the search for the least loaded target starts, spreads ties */
+} proxyFarm;
+
+typedef struct
+{
+	char* target; /* the key of the target */
+	UINT64 expires;
+} proxyFarmSticky;
+
+struct proxy_target_resolver
+{
+	char* file;
+	UINT64 interval;
+	UINT64 stickyTimeout;
+
+	HANDLE thread;
+	HANDLE stopEvent;
+	FILETIME lastWrite; /* only used by the resolver thread */
+	BOOL missing;
+
+	/* guarded by the lock */
+	CRITICAL_SECTION lock;
+	wHashTable* farms;    /* name -> proxyFarm */
+	wHashTable* targets;  /* hostname:port -> proxyFarmTarget */
+	wHashTable* sessions; /* session -> proxyFarmTarget */
+	wHashTable* sticky;   /* farm/user -> proxyFarmSticky */
+};
+
+static void pf_farm_target_free(void* obj)
+{
+	proxyFarmTarget* target = obj;
+
+	if (!target)
+		return;
+
+	free(target->hostname);
+	free(target);
+}
+
+static void pf_farm_free(void* obj)
+{
+	proxyFarm* farm = obj;
+
+	if (!farm)
+		return;
+
+	free(farm->targets);
+	free(farm);
+}
+
+static void pf_farm_sticky_free(void* obj)
+{
+	proxyFarmSticky* sticky = obj;
+
+	if (!sticky)
+		return;
+
+	free(sticky->target);
+	free(sticky);
+}
+
+static wHashTable* pf_target_resolver_table_new(BOOL strings, OBJECT_FREE_FN fnValueFree)
+{
+	wHashTable* table = HashTable_New(FALSE);
+	wObject* obj;
+
+	if (!table)
+		return NULL;
+
+	if (strings && !HashTable_SetupForStringData(table, FALSE))
+	{
+		HashTable_Free(table);
+		return NULL;
+	}
+
+	obj = HashTable_ValueObject(table);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = fnValueFree;
+	return table;
+}
+
+/* host, host:port, [v6 address] or [v6 address]:port */
+static BOOL pf_target_resolver_parse_target(const char* entry, char** hostname, UINT16* port)
+{
+	const char* end;
+	const char* last;
+	const char* colon = NULL;
+
+	while (*entry == ' ')
+		entry++;
+
+	last = entry + strlen(entry);
+	while ((last > entry) && (last[-1] == ' '))
+		last--;
+
+	*port = PF_TARGET_RESOLVER_DEFAULT_PORT;
+
+	if (entry[0] == '[')
+	{
+		end = memchr(entry, ']', (size_t)(last - entry));
+		if (!end)
+			return FALSE;
+
+		if ((end + 1 < last) && (end[1] == ':'))
+			colon = end + 1;
+		else if (end + 1 != last)
+			return FALSE;
+
+		entry++;
+	}
+	else
+	{
+		colon = memchr(entry, ':', (size_t)(last - entry));
+		end = colon ? colon : last;
+
+		/* an address with more than one colon has no port */
+		if (colon && memchr(colon + 1, ':', (size_t)(last - colon - 1)))
+		{
+			colon = NULL;
+			end = last;
+		}
+	}
+
+	if (end == entry)
+		return FALSE;
+
+	if (colon)
+	{
+		char* stop = NULL;
+		const unsigned long value = strtoul(colon + 1, &stop, 10);
+
+		if ((stop != last) || (value == 0) || (value > UINT16_MAX))
+			return FALSE;
+
+		*port = (UINT16)value;
+	}
+
+	*hostname = strndup(entry, (size_t)(end - entry));
+	return *hostname != NULL;
+}
+
+/* must be called with the lock held */
+static proxyFarmTarget* pf_target_resolver_get_target(proxyTargetResolver* resolver,
+                                                      const char* hostname, UINT16 port,
+                                                      BOOL create)
+{
+	proxyFarmTarget* target;
+	char key[sizeof(target->key)] = { 0 };
+
+	_snprintf(key, sizeof(key), "%s:%" PRIu16, hostname, port);
+	target = HashTable_GetItemValue(resolver->targets, key);
+
+	if (target || !create)
+		return target;
+
+	target = calloc(1, sizeof(proxyFarmTarget));
+	if (!target)
+		return NULL;
+
+	target->hostname = _strdup(hostname);
+	target->port = port;
+	sprintf_s(target->key, sizeof(target->key), "%s", key);
+
+	if (!target->hostname || !HashTable_Insert(resolver->targets, target->key, target))
+	{
+		pf_farm_target_free(target);
+		return NULL;
+	}
+
+	return target;
+}
+
+/* must be called with the lock held */
+static proxyFarm* pf_target_resolver_farm_new(proxyTargetResolver* resolver, const char* name,
+                                              const char* list)
+{
+	size_t x;
+	size_t count = 0;
+	char** entries = CommandLineParseCommaSeparatedValues(list, &count);
+	proxyFarm* farm = calloc(1, sizeof(proxyFarm));
+
+	if (!farm || !entries || (count == 0))
+		goto fail;
+
+	farm->targets = calloc(count, sizeof(proxyFarmTarget*));
+	if (!farm->targets)
+		goto fail;
+
+	for (x = 0; x < count; x++)
+	{
+		size_t y;
+		char* hostname = NULL;
+		UINT16 port;
+		proxyFarmTarget* target;
+
+		if (!pf_target_resolver_parse_target(entries[x], &hostname, &port))
+		{
+			WLog_WARN(TAG, "farm %s: ignoring invalid target '%s'", name, entries[x]);
+			continue;
+		}
+
+		target = pf_target_resolver_get_target(resolver, hostname, port, TRUE);
+		free(hostname);
+
+		if (!target)
+			goto fail;
+
+		target->listed = TRUE;
+
+		for (y = 0; y < farm->count; y++)
+		{
+			if (farm->targets[y] == target)
+				break;
+		}
+
+		if (y == farm->count)
+			farm->targets[farm->count++] = target;
+	}
+
+	if (farm->count == 0)
+		goto fail;
+
+	free(entries);
+	return farm;
+
+fail:
+	free(entries);
+	pf_farm_free(farm);
+	return NULL;
+}
+
+/* must be called with the lock held */
+static void pf_target_resolver_prune(proxyTargetResolver* resolver, UINT64 now)
+{
+	size_t x;
+	size_t count;
+	ULONG_PTR* keys = NULL;
+
+	count = HashTable_GetKeys(resolver->targets, &keys);
+	for (x = 0; x < count; x++)
+	{
+		const char* key = (const char*)keys[x];
+		proxyFarmTarget* target = HashTable_GetItemValue(resolver->targets, key);
+
+		if (target && !target->listed && (target->sessions == 0))
+			HashTable_Remove(resolver->targets, key);
+	}
+	free(keys);
+
+	keys = NULL;
+	count = HashTable_GetKeys(resolver->sticky, &keys);
+	for (x = 0; x < count; x++)
+	{
+		const char* key = (const char*)keys[x];
+		proxyFarmSticky* sticky = HashTable_GetItemValue(resolver->sticky, key);
+
+		if (sticky && ((sticky->expires <= now) ||
+		               !HashTable_GetItemValue(resolver->targets, sticky->target)))
+			HashTable_Remove(resolver->sticky, key);
+	}
+	free(keys);
+}
+
+/* reads the file outside of the lock, the sessions only wait for the tables to be rebuilt */
+static BOOL pf_target_resolver_load(proxyTargetResolver* resolver)
+{
+	int x;
+	int count = 0;
+	size_t y;
+	size_t nkeys;
+	BOOL rc = FALSE;
+	char** names = NULL;
+	ULONG_PTR* keys = NULL;
+	wHashTable* farms = NULL;
+	wIniFile* ini = IniFile_New();
+
+	if (!ini)
+		return FALSE;
+
+	if (IniFile_ReadFile(ini, resolver->file) < 0)
+	{
+		WLog_ERR(TAG, "failed to parse the farms in %s", resolver->file);
+		goto out;
+	}
+
+	farms = pf_target_resolver_table_new(TRUE, pf_farm_free);
+	if (!farms)
+		goto out;
+
+	names = IniFile_GetSectionKeyNames(ini, "Farms", &count);
+
+	EnterCriticalSection(&resolver->lock);
+
+	nkeys = HashTable_GetKeys(resolver->targets, &keys);
+	for (y = 0; y < nkeys; y++)
+	{
+		proxyFarmTarget* target = HashTable_GetItemValue(resolver->targets, (void*)keys[y]);
+		if (target)
+			target->listed = FALSE;
+	}
+
+	for (x = 0; x < count; x++)
+	{
+		const char* list = IniFile_GetKeyValueString(ini, "Farms", names[x]);
+		proxyFarm* farm = pf_target_resolver_farm_new(resolver, names[x], list ? list : "");
+
+		if (!farm)
+		{
+			WLog_WARN(TAG, "farm %s has no valid target", names[x]);
+			continue;
+		}
+
+		if (!HashTable_Insert(farms, names[x], farm))
+		{
+			pf_farm_free(farm);
+			break;
+		}
+	}
+
+	rc = (x == count);
+
+	if (rc)
+	{
+		HashTable_Free(resolver->farms);
+		resolver->farms = farms;
+		farms = NULL;
+	}
+	else
+	{
+		/* keep the farms of the last file listed */
+		ULONG_PTR* farmKeys = NULL;
+		const size_t nfarms = HashTable_GetKeys(resolver->farms, &farmKeys);
+
+		for (y = 0; y < nfarms; y++)
+		{
+			size_t z;
+			proxyFarm* farm = HashTable_GetItemValue(resolver->farms, (void*)farmKeys[y]);
+
+			for (z = 0; farm && (z < farm->count); z++)
+				farm->targets[z]->listed = TRUE;
+		}
+		free(farmKeys);
+	}
+
+	pf_target_resolver_prune(resolver, GetTickCount64());
+	count = (int)HashTable_Count(resolver->farms);
+	nkeys = HashTable_Count(resolver->targets);
+	LeaveCriticalSection(&resolver->lock);
+
+	if (rc)
+		WLog_INFO(TAG, "loaded %d farms with %" PRIuz " targets from %s", count, nkeys,
+		          resolver->file);
+
+out:
+	free(keys);
+	free(names);
+	HashTable_Free(farms);
+	IniFile_Free(ini);
+	return rc;
+}
+
+static void pf_target_resolver_refresh(proxyTargetResolver* resolver)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data = { 0 };
+
+	if (!GetFileAttributesExA(resolver->file, GetFileExInfoStandard, &data))
+	{
+		if (!resolver->missing)
+			WLog_WARN(TAG, "farm file %s is missing, keeping the current farms", resolver->file);
+
+		resolver->missing = TRUE;
+		return;
+	}
+
+	resolver->missing = FALSE;
+
+	if ((data.ftLastWriteTime.dwLowDateTime == resolver->lastWrite.dwLowDateTime) &&
+	    (data.ftLastWriteTime.dwHighDateTime == resolver->lastWrite.dwHighDateTime))
+		return;
+
+	/* a file failing to parse is retried once it changed again */
+	resolver->lastWrite = data.ftLastWriteTime;
+	pf_target_resolver_load(resolver);
+}
+
+static DWORD WINAPI pf_target_resolver_thread(LPVOID arg)
+{
+	proxyTargetResolver* resolver = arg;
+
+	WINPR_ASSERT(resolver);
+
+	while (WaitForSingleObject(resolver->stopEvent, (DWORD)resolver->interval) == WAIT_TIMEOUT)
+	{
+		pf_target_resolver_refresh(resolver);
+
+		EnterCriticalSection(&resolver->lock);
+		pf_target_resolver_prune(resolver, GetTickCount64());
+		LeaveCriticalSection(&resolver->lock);
+	}
+
+	return 0;
+}
+
+/* must be called with the lock held */
+static proxyFarmTarget* pf_target_resolver_least_loaded(proxyFarm* farm, UINT64 now)
+{
+	size_t x;
+	proxyFarmTarget* best = NULL;
+	proxyFarmTarget* earliest = NULL;
+
+	for (x = 0; x < farm->count; x++)
+	{
+		proxyFarmTarget* target = farm->targets[(farm->next + x) % farm->count];
+
+		if (target->downUntil > now)
+		{
+			if (!earliest || (target->downUntil < earliest->downUntil))
+				earliest = target;
+		}
+		else if (!best || (target->sessions < best->sessions))
+			best = target;
+	}
+
+	farm->next = (farm->next + 1) % farm->count;
+
+	/* all of them are down, try the one coming back first rather than failing */
+	return best ? best : earliest;
+}
+
+/* must be called with the lock held */
+static proxyFarmTarget* pf_target_resolver_sticky(proxyTargetResolver* resolver,
+                                                  const proxyFarm* farm, const char* key,
+                                                  UINT64 now)
+{
+	size_t x;
+	proxyFarmSticky* sticky = HashTable_GetItemValue(resolver->sticky, key);
+
+	if (!sticky || (sticky->expires <= now))
+		return NULL;
+
+	for (x = 0; x < farm->count; x++)
+	{
+		proxyFarmTarget* target = farm->targets[x];
+
+		if ((strcmp(target->key, sticky->target) == 0) && (target->downUntil <= now))
+			return target;
+	}
+
+	return NULL;
+}
+
+/* must be called with the lock held */
+static void pf_target_resolver_stick(proxyTargetResolver* resolver, const char* key,
+                                     const proxyFarmTarget* target, UINT64 now)
+{
+	proxyFarmSticky* sticky = HashTable_GetItemValue(resolver->sticky, key);
+
+	if (!sticky)
+	{
+		if (HashTable_Count(resolver->sticky) >= PF_TARGET_RESOLVER_MAX_STICKY)
+			return;
+
+		sticky = calloc(1, sizeof(proxyFarmSticky));
+		if (!sticky)
+			return;
+
+		if (!HashTable_Insert(resolver->sticky, key, sticky))
+		{
+			free(sticky);
+			return;
+		}
+	}
+
+	if (strcmp(sticky->target ? sticky->target : "", target->key) != 0)
+	{
+		free(sticky->target);
+		sticky->target = _strdup(target->key);
+	}
+
+	sticky->expires = now + resolver->stickyTimeout;
+	if (!sticky->target)
+		HashTable_Remove(resolver->sticky, key);
+}
+
+BOOL pf_target_resolver_select(proxyTargetResolver* resolver, const char* name, const char* user,
+                               const void* session, char** hostname, UINT16* port, BOOL* found)
+{
+	BOOL rc = FALSE;
+	proxyFarm* farm;
+	proxyFarmTarget* target = NULL;
+	char key[512] = { 0 };
+	const UINT64 now = GetTickCount64();
+
+	WINPR_ASSERT(resolver);
+	WINPR_ASSERT(session);
+	WINPR_ASSERT(hostname);
+	WINPR_ASSERT(port);
+	WINPR_ASSERT(found);
+
+	*found = FALSE;
+	if (!name)
+		return TRUE;
+
+	if (user && (user[0] != '\0') && (resolver->stickyTimeout > 0))
+		_snprintf(key, sizeof(key), "%s/%s", name, user);
+
+	EnterCriticalSection(&resolver->lock);
+
+	farm = HashTable_GetItemValue(resolver->farms, name);
+	if (!farm)
+	{
+		rc = TRUE;
+		goto out;
+	}
+
+	*found = TRUE;
+
+	if (key[0] != '\0')
+		target = pf_target_resolver_sticky(resolver, farm, key, now);
+
+	if (!target)
+		target = pf_target_resolver_least_loaded(farm, now);
+
+	*hostname = _strdup(target->hostname);
+	if (!*hostname)
+		goto out;
+
+	if (!HashTable_Insert(resolver->sessions, session, target))
+	{
+		free(*hostname);
+		*hostname = NULL;
+		goto out;
+	}
+
+	*port = target->port;
+	target->sessions++;
+
+	if (key[0] != '\0')
+		pf_target_resolver_stick(resolver, key, target, now);
+
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&resolver->lock);
+	return rc;
+}
+
+void pf_target_resolver_release(proxyTargetResolver* resolver, const void* session)
+{
+	proxyFarmTarget* target;
+
+	WINPR_ASSERT(resolver);
+
+	EnterCriticalSection(&resolver->lock);
+	target = HashTable_GetItemValue(resolver->sessions, session);
+
+	if (target)
+	{
+		WINPR_ASSERT(target->sessions > 0);
+		target->sessions--;
+		HashTable_Remove(resolver->sessions, session);
+	}
+
+	LeaveCriticalSection(&resolver->lock);
+}
+
+void pf_target_resolver_report(proxyTargetResolver* resolver, const char* hostname, UINT16 port,
+                               BOOL connected)
+{
+	proxyFarmTarget* target;
+
+	WINPR_ASSERT(resolver);
+	WINPR_ASSERT(hostname);
+
+	EnterCriticalSection(&resolver->lock);
+	target = pf_target_resolver_get_target(resolver, hostname, port, FALSE);
+
+	if (target && connected)
+	{
+		target->failures = 0;
+		target->downUntil = 0;
+	}
+	else if (target)
+	{
+		const UINT32 shift = MIN(target->failures, 6);
+		const UINT64 backoff =
+		    MIN((UINT64)PF_TARGET_RESOLVER_MIN_BACKOFF << shift, PF_TARGET_RESOLVER_MAX_BACKOFF);
+
+		target->failures++;
+		target->downUntil = GetTickCount64() + backoff;
+		WLog_WARN(TAG, "target %s is down for %" PRIu64 " ms", target->key, backoff);
+	}
+
+	LeaveCriticalSection(&resolver->lock);
+}
+
+proxyTargetResolver* pf_target_resolver_new(const proxyConfig* config)
+{
+	proxyTargetResolver* resolver;
+
+	WINPR_ASSERT(config);
+	WINPR_ASSERT(config->FarmFile);
+
+	resolver = calloc(1, sizeof(proxyTargetResolver));
+	if (!resolver)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&resolver->lock, 4000))
+	{
+		free(resolver);
+		return NULL;
+	}
+
+	resolver->interval = MAX(config->FarmRefreshInterval, 1) * 1000ull;
+	resolver->stickyTimeout = config->FarmStickyTimeout * 1000ull;
+
+	resolver->file = _strdup(config->FarmFile);
+	if (!resolver->file)
+		goto fail;
+
+	resolver->farms = pf_target_resolver_table_new(TRUE, pf_farm_free);
+	resolver->targets = pf_target_resolver_table_new(TRUE, pf_farm_target_free);
+	resolver->sessions = pf_target_resolver_table_new(FALSE, NULL);
+	resolver->sticky = pf_target_resolver_table_new(TRUE, pf_farm_sticky_free);
+	if (!resolver->farms || !resolver->targets || !resolver->sessions || !resolver->sticky)
+		goto fail;
+
+	/* sessions arriving before the thread ran already find the farms */
+	pf_target_resolver_refresh(resolver);
+
+	resolver->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!resolver->stopEvent)
+		goto fail;
+
+	resolver->thread = CreateThread(NULL, 0, pf_target_resolver_thread, resolver, 0, NULL);
+	if (!resolver->thread)
+		goto fail;
+
+	return resolver;
+
+fail:
+	pf_target_resolver_free(resolver);
+	return NULL;
+}
+
+void pf_target_resolver_free(proxyTargetResolver* resolver)
+{
+	if (!resolver)
+		return;
+
+	if (resolver->thread)
+	{
+		SetEvent(resolver->stopEvent);
+		WaitForSingleObject(resolver->thread, INFINITE);
+		CloseHandle(resolver->thread);
+	}
+
+	if (resolver->stopEvent)
+		CloseHandle(resolver->stopEvent);
+
+	HashTable_Free(resolver->sticky);
+	HashTable_Free(resolver->sessions);
+	HashTable_Free(resolver->farms);
+	HashTable_Free(resolver->targets);
+	free(resolver->file);
+	DeleteCriticalSection(&resolver->lock);
+	free(resolver);
+}
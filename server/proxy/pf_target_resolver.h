@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_PROXY_PFTARGETRESOLVER_H
+#define FREERDP_SERVER_PROXY_PFTARGETRESOLVER_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/server/proxy/proxy_config.h>
+
+typedef struct proxy_target_resolver proxyTargetResolver;
+
+/**
+ * @brief pf_target_resolver_new Loads the farms of the configured file and starts the thread
+ * reloading it when it changed
+ * @return the new resolver or NULL on failure
+ */
+proxyTargetResolver* pf_target_resolver_new(const proxyConfig* config);
+void pf_target_resolver_free(proxyTargetResolver* resolver);
+
+/**
+ * @brief pf_target_resolver_select Selects the target of a session if name is a farm: the one
+ * the user was sent to before if it is still healthy, the healthy one with the fewest sessions
+ * otherwise.
+ * @param user Keeps the user on a target for the sticky timeout, may be NULL
+ * @param session Identifies the session in pf_target_resolver_release
+ * @param hostname Receives the target, owned by the caller
+ * @param found Set to FALSE if name is not a farm
+ * @return FALSE on failure
+ */
+BOOL pf_target_resolver_select(proxyTargetResolver* resolver, const char* name, const char* user,
+                               const void* session, char** hostname, UINT16* port, BOOL* found);
+
+/**
+ * @brief pf_target_resolver_release Ends the session counted on the target it was sent to
+ */
+void pf_target_resolver_release(proxyTargetResolver* resolver, const void* session);
+
+/**
+ * @brief pf_target_resolver_report Marks a target down for a while after a failed connection,
+ * up again after a successful one
+ */
+void pf_target_resolver_report(proxyTargetResolver* resolver, const char* hostname, UINT16 port,
+                               BOOL connected);
+
+#endif /* FREERDP_SERVER_PROXY_PFTARGETRESOLVER_H */
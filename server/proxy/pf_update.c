@@ -592,6 +592,31 @@ void pf_server_register_update_callbacks(rdpUpdate* update)
 	update->SuppressOutput = pf_server_suppress_output;
 }
 
+/**
+ * Forwards a bitmap or pointer update of the target server as received, the proxy's client
+ * neither parses nor composes it and the peer only redoes compression and encryption.
+ */
+static BOOL pf_client_fastpath_update(rdpContext* context, BYTE updateCode, wStream* s)
+{
+	pClientContext* pc = (pClientContext*)context;
+	proxyData* pdata;
+	rdpContext* ps;
+	WINPR_ASSERT(pc);
+	pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+	ps = (rdpContext*)pdata->ps;
+	WINPR_ASSERT(ps);
+	WINPR_ASSERT(s);
+	return rdp_update_send_fastpath(ps->update, updateCode, Stream_Pointer(s),
+	                                Stream_GetRemainingLength(s));
+}
+
+void pf_client_register_cut_through(rdpUpdate* update)
+{
+	WINPR_ASSERT(update);
+	update->FastPathUpdate = pf_client_fastpath_update;
+}
+
 void pf_client_register_update_callbacks(rdpUpdate* update)
 {
 	WINPR_ASSERT(update);
@@ -30,5 +30,6 @@
 
 void pf_server_register_update_callbacks(rdpUpdate* update);
 void pf_client_register_update_callbacks(rdpUpdate* update);
+void pf_client_register_cut_through(rdpUpdate* update);
 
 #endif /* FREERDP_SERVER_PROXY_PFUPDATE_H */
@@ -94,3 +94,41 @@ const char* pf_utils_channel_mode_string(pf_utils_channel_mode mode)
 			return "ignored";
 	}
 }
+
+void pf_utils_channel_data_free(void* obj)
+{
+	free(obj);
+}
+
+/* the event, the data and the channel name are kept in one allocation */
+void* pf_utils_channel_data_copy(const void* obj)
+{
+	const proxyChannelDataEventInfo* src = obj;
+	proxyChannelDataEventInfo* dst;
+	BYTE* data;
+	size_t nameLen = 0;
+
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(src->data || (src->data_len == 0));
+
+	if (src->channel_name)
+		nameLen = strlen(src->channel_name) + 1;
+
+	dst = malloc(sizeof(proxyChannelDataEventInfo) + src->data_len + nameLen);
+	if (!dst)
+		return NULL;
+
+	*dst = *src;
+	data = (BYTE*)&dst[1];
+	if (src->data_len > 0)
+		memcpy(data, src->data, src->data_len);
+	dst->data = data;
+
+	if (src->channel_name)
+	{
+		char* name = (char*)&data[src->data_len];
+		memcpy(name, src->channel_name, nameLen);
+		dst->channel_name = name;
+	}
+	return dst;
+}
@@ -40,4 +40,11 @@ const char* pf_utils_channel_mode_string(pf_utils_channel_mode mode);
 
 BOOL pf_utils_is_passthrough(const proxyConfig* config);
 
+/**
+ * @brief pf_utils_channel_data_copy Copies a proxyChannelDataEventInfo, including data and
+ *        channel name, for queueing it. Suitable as wObject::fnObjectNew.
+ */
+void* pf_utils_channel_data_copy(const void* obj);
+void pf_utils_channel_data_free(void* obj);
+
 #endif /* FREERDP_SERVER_PROXY_PFUTILS_H */
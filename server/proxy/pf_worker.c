@@ -0,0 +1,467 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+
+#include <freerdp/types.h>
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_worker.h"
+
+#define TAG PROXY_TAG("worker")
+
+/**
+ * Each worker waits for the handles of all its sessions in one wait set (epoll or kqueue where
+ * available) and only checks the sessions with a signaled handle. All sessions are polled once
+ * per interval, just like the per peer threads did.
+ */
+#define PF_WORKER_SESSION_HANDLES 32
+#define PF_WORKER_SWEEP_INTERVAL 1000
+
+typedef struct
+{
+	void* session;
+	const proxyWorkerCallbacks* callbacks;
+	BOOL ready;
+} proxyWorkerEntry;
+
+typedef struct
+{
+	proxyWorkerPool* pool;
+	HANDLE thread;
+	HANDLE wakeEvent;
+
+	/* guarded by the pool lock */
+	proxyWorkerEntry* pending;
+	size_t pendingCount;
+	size_t pendingSize;
+	size_t sessions;
+	BOOL stopped;
+
+	/* only used by the worker thread */
+	proxyWorkerEntry* entries;
+	size_t count;
+	size_t size;
+	HANDLE* handles;
+	size_t* owners; /* index of the session of each handle */
+	DWORD* indices;
+	size_t handleSize;
+} proxyWorker;
+
+struct proxy_worker_pool
+{
+	CRITICAL_SECTION lock;
+	HANDLE stopEvent;
+	proxyWorker* workers;
+	size_t count;
+};
+
+static BOOL pf_worker_reserve(proxyWorker* worker, size_t sessions)
+{
+	size_t handles;
+
+	WINPR_ASSERT(worker);
+
+	if (sessions > worker->size)
+	{
+		proxyWorkerEntry* entries;
+
+		sessions = MAX(sessions, worker->size * 2);
+		entries = realloc(worker->entries, sessions * sizeof(proxyWorkerEntry));
+
+		if (!entries)
+			return FALSE;
+
+		worker->entries = entries;
+		worker->size = sessions;
+	}
+
+	handles = 2 + worker->size * PF_WORKER_SESSION_HANDLES;
+
+	if (handles > worker->handleSize)
+	{
+		HANDLE* phandles;
+		size_t* owners;
+		DWORD* indices;
+
+		phandles = realloc(worker->handles, handles * sizeof(HANDLE));
+		if (!phandles)
+			return FALSE;
+		worker->handles = phandles;
+
+		owners = realloc(worker->owners, handles * sizeof(size_t));
+		if (!owners)
+			return FALSE;
+		worker->owners = owners;
+
+		indices = realloc(worker->indices, handles * sizeof(DWORD));
+		if (!indices)
+			return FALSE;
+		worker->indices = indices;
+
+		worker->handleSize = handles;
+	}
+
+	return TRUE;
+}
+
+static void pf_worker_take_pending(proxyWorker* worker)
+{
+	size_t x;
+	proxyWorkerPool* pool = worker->pool;
+
+	EnterCriticalSection(&pool->lock);
+
+	if ((worker->pendingCount > 0) &&
+	    pf_worker_reserve(worker, worker->count + worker->pendingCount))
+	{
+		for (x = 0; x < worker->pendingCount; x++)
+			worker->entries[worker->count++] = worker->pending[x];
+
+		worker->pendingCount = 0;
+	}
+
+	LeaveCriticalSection(&pool->lock);
+}
+
+static void pf_worker_close(proxyWorker* worker, size_t index)
+{
+	proxyWorkerPool* pool = worker->pool;
+	const proxyWorkerEntry entry = worker->entries[index];
+
+	WINPR_ASSERT(index < worker->count);
+
+	worker->entries[index] = worker->entries[--worker->count];
+
+	EnterCriticalSection(&pool->lock);
+	worker->sessions--;
+	LeaveCriticalSection(&pool->lock);
+
+	entry.callbacks->Close(entry.session);
+}
+
+/* collects the handles of all sessions, closes the sessions failing to provide them */
+static DWORD pf_worker_get_event_handles(proxyWorker* worker)
+{
+	size_t x;
+	DWORD nCount = 0;
+	BOOL failed = FALSE;
+
+	worker->handles[nCount++] = worker->pool->stopEvent;
+	worker->handles[nCount++] = worker->wakeEvent;
+
+	for (x = 0; x < worker->count; x++)
+	{
+		DWORD i;
+		proxyWorkerEntry* entry = &worker->entries[x];
+		const DWORD count = entry->callbacks->GetEventHandles(
+		    entry->session, &worker->handles[nCount], PF_WORKER_SESSION_HANDLES);
+
+		/* marks the sessions to close */
+		entry->ready = (count == 0);
+		failed |= entry->ready;
+
+		for (i = 0; i < count; i++)
+			worker->owners[nCount++] = x;
+	}
+
+	if (!failed)
+		return nCount;
+
+	for (x = worker->count; x > 0; x--)
+	{
+		if (worker->entries[x - 1].ready)
+		{
+			WLog_ERR(TAG, "failed to get the event handles of a session, closing it");
+			pf_worker_close(worker, x - 1);
+		}
+	}
+
+	return 0;
+}
+
+static DWORD WINAPI pf_worker_thread(LPVOID arg)
+{
+	size_t x;
+	proxyWorker* worker = (proxyWorker*)arg;
+	proxyWorkerPool* pool;
+	WINPR_WAIT_SET* set;
+	UINT64 lastSweep = GetTickCount64();
+
+	WINPR_ASSERT(worker);
+	pool = worker->pool;
+	WINPR_ASSERT(pool);
+
+	set = winpr_WaitSetNew();
+
+	if (!set)
+	{
+		WLog_ERR(TAG, "failed to create the wait set of a worker");
+		goto out;
+	}
+
+	while (TRUE)
+	{
+		DWORD status;
+		DWORD nCount;
+		DWORD signaled = 0;
+		BOOL sweep;
+		UINT64 now;
+
+		pf_worker_take_pending(worker);
+		nCount = pf_worker_get_event_handles(worker);
+
+		if (nCount == 0)
+			continue;
+
+		if (!winpr_WaitSetUpdate(set, nCount, worker->handles))
+		{
+			if (worker->count == 0)
+				break;
+
+			WLog_ERR(TAG, "worker can not wait for %" PRIu32 " handles, dropping a session",
+			         nCount);
+			pf_worker_close(worker, worker->count - 1);
+			continue;
+		}
+
+		status = winpr_WaitSetWaitEx(set, PF_WORKER_SWEEP_INTERVAL, worker->indices, nCount,
+		                             &signaled);
+
+		if (status == WAIT_FAILED)
+		{
+			WLog_ERR(TAG, "winpr_WaitSetWaitEx failed");
+			break;
+		}
+
+		if (WaitForSingleObject(pool->stopEvent, 0) == WAIT_OBJECT_0)
+			break;
+
+		ResetEvent(worker->wakeEvent);
+
+		for (x = 0; x < worker->count; x++)
+			worker->entries[x].ready = FALSE;
+
+		if (status != WAIT_TIMEOUT)
+		{
+			for (x = 0; x < signaled; x++)
+			{
+				const DWORD index = worker->indices[x];
+
+				if (index >= 2)
+					worker->entries[worker->owners[index]].ready = TRUE;
+			}
+		}
+
+		now = GetTickCount64();
+		sweep = (status == WAIT_TIMEOUT) || (now - lastSweep >= PF_WORKER_SWEEP_INTERVAL);
+
+		if (sweep)
+			lastSweep = now;
+
+		/* backwards, closing a session moves the last one to its index */
+		for (x = worker->count; x > 0; x--)
+		{
+			proxyWorkerEntry* entry = &worker->entries[x - 1];
+
+			if (!entry->ready && !sweep)
+				continue;
+
+			if (!entry->callbacks->CheckEventHandles(entry->session))
+				pf_worker_close(worker, x - 1);
+		}
+	}
+
+out:
+	EnterCriticalSection(&pool->lock);
+	worker->stopped = TRUE;
+	LeaveCriticalSection(&pool->lock);
+
+	while (worker->count > 0)
+		pf_worker_close(worker, worker->count - 1);
+
+	/* no sessions are added once stopped */
+	for (x = 0; x < worker->pendingCount; x++)
+		worker->pending[x].callbacks->Close(worker->pending[x].session);
+
+	worker->pendingCount = 0;
+	winpr_WaitSetFree(set);
+	return 0;
+}
+
+BOOL pf_worker_pool_add(proxyWorkerPool* pool, void* session, const proxyWorkerCallbacks* callbacks)
+{
+	size_t x;
+	BOOL rc = FALSE;
+	proxyWorker* worker = NULL;
+
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(session);
+	WINPR_ASSERT(callbacks);
+	WINPR_ASSERT(callbacks->GetEventHandles);
+	WINPR_ASSERT(callbacks->CheckEventHandles);
+	WINPR_ASSERT(callbacks->Close);
+
+	EnterCriticalSection(&pool->lock);
+
+	for (x = 0; x < pool->count; x++)
+	{
+		proxyWorker* candidate = &pool->workers[x];
+
+		if (candidate->stopped || !candidate->thread)
+			continue;
+
+		if (!worker || (candidate->sessions < worker->sessions))
+			worker = candidate;
+	}
+
+	if (!worker)
+		goto out;
+
+	if (worker->pendingCount >= worker->pendingSize)
+	{
+		const size_t size = MAX(16, worker->pendingSize * 2);
+		proxyWorkerEntry* pending = realloc(worker->pending, size * sizeof(proxyWorkerEntry));
+
+		if (!pending)
+			goto out;
+
+		worker->pending = pending;
+		worker->pendingSize = size;
+	}
+
+	worker->pending[worker->pendingCount].session = session;
+	worker->pending[worker->pendingCount].callbacks = callbacks;
+	worker->pending[worker->pendingCount].ready = FALSE;
+	worker->pendingCount++;
+	worker->sessions++;
+	SetEvent(worker->wakeEvent);
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&pool->lock);
+	return rc;
+}
+
+proxyWorkerPool* pf_worker_pool_new(size_t count, UINT64 affinity)
+{
+	size_t x;
+	proxyWorkerPool* pool = calloc(1, sizeof(proxyWorkerPool));
+
+	if (!pool)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->lock, 4000))
+	{
+		free(pool);
+		return NULL;
+	}
+
+	if ((count == 0) && (affinity != 0))
+	{
+		for (x = 0; x < 64; x++)
+		{
+			if (affinity & (1ULL << x))
+				count++;
+		}
+	}
+	else if (count == 0)
+	{
+		SYSTEM_INFO sysinfo = { 0 };
+		GetNativeSystemInfo(&sysinfo);
+		count = MAX(1, sysinfo.dwNumberOfProcessors);
+	}
+
+	pool->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!pool->stopEvent)
+		goto fail;
+
+	pool->workers = calloc(count, sizeof(proxyWorker));
+	if (!pool->workers)
+		goto fail;
+
+	pool->count = count;
+
+	for (x = 0; x < count; x++)
+	{
+		proxyWorker* worker = &pool->workers[x];
+
+		worker->pool = pool;
+		worker->wakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (!worker->wakeEvent || !pf_worker_reserve(worker, 16))
+			goto fail;
+
+		worker->thread = CreateThread(NULL, 0, pf_worker_thread, worker, 0, NULL);
+		if (!worker->thread)
+			goto fail;
+
+		if ((affinity != 0) &&
+		    (SetThreadAffinityMask(worker->thread, (DWORD_PTR)affinity) == 0))
+			goto fail;
+	}
+
+	WLog_INFO(TAG, "started %" PRIuz " workers, processor mask 0x%016" PRIx64, count, affinity);
+	return pool;
+
+fail:
+	WLog_ERR(TAG, "failed to start %" PRIuz " workers", count);
+	pf_worker_pool_free(pool);
+	return NULL;
+}
+
+void pf_worker_pool_free(proxyWorkerPool* pool)
+{
+	size_t x;
+
+	if (!pool)
+		return;
+
+	if (pool->stopEvent)
+		SetEvent(pool->stopEvent);
+
+	for (x = 0; x < pool->count; x++)
+	{
+		proxyWorker* worker = &pool->workers[x];
+
+		if (worker->thread)
+		{
+			WaitForSingleObject(worker->thread, INFINITE);
+			CloseHandle(worker->thread);
+		}
+
+		if (worker->wakeEvent)
+			CloseHandle(worker->wakeEvent);
+
+		free(worker->pending);
+		free(worker->entries);
+		free(worker->handles);
+		free(worker->owners);
+		free(worker->indices);
+	}
+
+	free(pool->workers);
+
+	if (pool->stopEvent)
+		CloseHandle(pool->stopEvent);
+
+	DeleteCriticalSection(&pool->lock);
+	free(pool);
+}
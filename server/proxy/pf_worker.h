@@ -0,0 +1,59 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_PROXY_PFWORKER_H
+#define FREERDP_SERVER_PROXY_PFWORKER_H
+
+#include <winpr/wtypes.h>
+
+typedef struct proxy_worker_pool proxyWorkerPool;
+
+/**
+ * A session driven by a worker thread, all callbacks are called from that thread.
+ */
+typedef struct
+{
+	/** @return the number of handles written, 0 closes the session */
+	DWORD (*GetEventHandles)(void* session, HANDLE* handles, DWORD count);
+	/** @return FALSE if the session ended and has to be closed */
+	BOOL (*CheckEventHandles)(void* session);
+	/** Shuts down and frees the session */
+	void (*Close)(void* session);
+} proxyWorkerCallbacks;
+
+/**
+ * @brief pf_worker_pool_new Starts the worker threads
+ * @param count The number of workers, 0 for one per processor
+ * @param affinity The processors the workers run on, 0 for no restriction
+ * @return the new pool or NULL on failure
+ */
+proxyWorkerPool* pf_worker_pool_new(size_t count, UINT64 affinity);
+
+/**
+ * @brief pf_worker_pool_free Stops the workers, the sessions left are closed
+ */
+void pf_worker_pool_free(proxyWorkerPool* pool);
+
+/**
+ * @brief pf_worker_pool_add Hands a session to the worker driving the fewest sessions
+ * @param callbacks Must stay valid until the session is closed
+ * @return TRUE if a worker took the session, FALSE if the pool is shutting down
+ */
+BOOL pf_worker_pool_add(proxyWorkerPool* pool, void* session,
+                        const proxyWorkerCallbacks* callbacks);
+
+#endif /* FREERDP_SERVER_PROXY_PFWORKER_H */
@@ -78,6 +78,12 @@ extern "C"
 	BOOL pf_modules_is_plugin_loaded(proxyModule* module, const char* plugin_name);
 	void pf_modules_list_loaded_plugins(proxyModule* module);
 
+	/**
+	 * @brief pf_modules_has_graphics_hooks Checks if a plugin inspects the server graphics
+	 * @return TRUE if any loaded plugin registered a ClientEndPaint hook
+	 */
+	BOOL pf_modules_has_graphics_hooks(proxyModule* module);
+
 	BOOL pf_modules_run_filter(proxyModule* module, PF_FILTER_TYPE type, proxyData* pdata,
 	                           void* param);
 	BOOL pf_modules_run_hook(proxyModule* module, PF_HOOK_TYPE type, proxyData* pdata,
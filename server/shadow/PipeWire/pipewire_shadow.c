@@ -0,0 +1,752 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/region.h>
+
+#include <spa/param/video/format-utils.h>
+#include <spa/buffer/meta.h>
+
+#include "pipewire_shadow.h"
+
+#define TAG SERVER_TAG("shadow.pipewire")
+
+/**
+ * Screen capture from a PipeWire video stream.
+ *
+ * The stream is usually set up by the xdg-desktop-portal ScreenCast interface, the process
+ * starting the server passes the PipeWire remote returned by OpenPipeWireRemote in
+ * FREERDP_SHADOW_PIPEWIRE_FD and the stream node in FREERDP_SHADOW_PIPEWIRE_NODE. Without a
+ * remote the default PipeWire daemon is used, the node is always required.
+ *
+ * Frames are copied into the surface as they arrive, limited to the damage rectangles the
+ * compositor attaches to the buffer. The subsystem thread only wakes up when there is damage,
+ * no polling and no full frame compare are needed. Streams without damage metadata fall back
+ * to shadow_capture_compare_region.
+ */
+
+#define PIPEWIRE_SHADOW_NEGOTIATE_TIMEOUT 10 /* seconds */
+#define PIPEWIRE_SHADOW_MAX_DAMAGE 16
+#define PIPEWIRE_SHADOW_DAMAGE_SIZE(n) ((int)(sizeof(struct spa_meta_region) * (n)))
+
+static UINT32 pipewire_shadow_get_pixel_format(enum spa_video_format format)
+{
+	switch (format)
+	{
+		case SPA_VIDEO_FORMAT_BGRx:
+			return PIXEL_FORMAT_BGRX32;
+
+		case SPA_VIDEO_FORMAT_BGRA:
+			return PIXEL_FORMAT_BGRA32;
+
+		case SPA_VIDEO_FORMAT_RGBx:
+			return PIXEL_FORMAT_RGBX32;
+
+		case SPA_VIDEO_FORMAT_RGBA:
+			return PIXEL_FORMAT_RGBA32;
+
+		default:
+			return 0;
+	}
+}
+
+static void pipewire_shadow_on_state_changed(void* data, enum pw_stream_state old,
+                                             enum pw_stream_state state, const char* error)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)data;
+
+	WINPR_UNUSED(old);
+	WLog_DBG(TAG, "stream state %s", pw_stream_state_as_string(state));
+
+	if (state == PW_STREAM_STATE_ERROR)
+	{
+		WLog_ERR(TAG, "stream error: %s", error ? error : "unknown");
+		subsystem->failed = TRUE;
+		pw_thread_loop_signal(subsystem->loop, FALSE);
+	}
+}
+
+static void pipewire_shadow_on_param_changed(void* data, uint32_t id, const struct spa_pod* param)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)data;
+	uint32_t mediaType;
+	uint32_t mediaSubtype;
+	struct spa_video_info_raw format = { 0 };
+	BYTE buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod* params[2];
+
+	if (!param || (id != SPA_PARAM_Format))
+		return;
+
+	if ((spa_format_parse(param, &mediaType, &mediaSubtype) < 0) ||
+	    (mediaType != SPA_MEDIA_TYPE_video) || (mediaSubtype != SPA_MEDIA_SUBTYPE_raw))
+		return;
+
+	if ((spa_format_video_raw_parse(param, &format) < 0) ||
+	    (pipewire_shadow_get_pixel_format(format.format) == 0))
+	{
+		WLog_ERR(TAG, "unsupported stream format");
+		subsystem->failed = TRUE;
+		pw_thread_loop_signal(subsystem->loop, FALSE);
+		return;
+	}
+
+	WLog_INFO(TAG, "stream format %" PRIu32 ", %" PRIu32 "x%" PRIu32, (UINT32)format.format,
+	          format.size.width, format.size.height);
+
+	params[0] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers, SPA_PARAM_BUFFERS_buffers,
+	    SPA_POD_CHOICE_RANGE_Int(8, 2, 16), SPA_PARAM_BUFFERS_dataType,
+	    SPA_POD_CHOICE_FLAGS_Int((1 << SPA_DATA_MemPtr) | (1 << SPA_DATA_MemFd) |
+	                             (1 << SPA_DATA_DmaBuf)));
+	params[1] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type,
+	    SPA_POD_Id(SPA_META_VideoDamage), SPA_PARAM_META_size,
+	    SPA_POD_CHOICE_RANGE_Int(PIPEWIRE_SHADOW_DAMAGE_SIZE(PIPEWIRE_SHADOW_MAX_DAMAGE),
+	                             PIPEWIRE_SHADOW_DAMAGE_SIZE(1),
+	                             PIPEWIRE_SHADOW_DAMAGE_SIZE(PIPEWIRE_SHADOW_MAX_DAMAGE)));
+	pw_stream_update_params(subsystem->stream, params, ARRAYSIZE(params));
+
+	subsystem->format = format;
+	subsystem->negotiated = TRUE;
+	pw_thread_loop_signal(subsystem->loop, FALSE);
+
+	/* wakes the subsystem thread up to apply a size change */
+	SetEvent(subsystem->common.event);
+}
+
+static BOOL pipewire_shadow_get_damage(pipewireShadowSubsystem* subsystem,
+                                       struct spa_buffer* buffer, const BYTE* pSrcData,
+                                       UINT32 nSrcStep, const RECTANGLE_16* surfaceRect,
+                                       REGION16* region)
+{
+	BOOL rc = FALSE;
+	UINT32 index;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects;
+	REGION16 changed;
+	rdpShadowSurface* surface = subsystem->common.server->surface;
+	struct spa_meta* meta = spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+
+	if (subsystem->fullDamage)
+		return region16_union_rect(region, region, surfaceRect);
+
+	if (meta)
+	{
+		struct spa_meta_region* damage;
+
+		spa_meta_for_each(damage, meta)
+		{
+			RECTANGLE_16 rect;
+
+			if (!spa_meta_region_is_valid(damage))
+				break;
+
+			rect.left = (UINT16)MIN(UINT16_MAX, MAX(0, damage->region.position.x));
+			rect.top = (UINT16)MIN(UINT16_MAX, MAX(0, damage->region.position.y));
+			rect.right = (UINT16)MIN(UINT16_MAX, 1LL * rect.left + damage->region.size.width);
+			rect.bottom = (UINT16)MIN(UINT16_MAX, 1LL * rect.top + damage->region.size.height);
+
+			if (!region16_union_rect(region, region, &rect))
+				return FALSE;
+		}
+
+		return region16_intersect_rect(region, region, surfaceRect);
+	}
+
+	/* the compositor did not attach damage, compare with the previous frame */
+	region16_init(&changed);
+
+	if (shadow_capture_compare_region(surface->data, surface->scanline, surface->width,
+	                                  surface->height,
+	                                  &pSrcData[1ULL * surface->y * nSrcStep + surface->x * 4ULL],
+	                                  nSrcStep, NULL, &changed) < 0)
+		goto out;
+
+	rects = region16_rects(&changed, &numRects);
+
+	for (index = 0; index < numRects; index++)
+	{
+		const RECTANGLE_16 rect = { rects[index].left + surface->x, rects[index].top + surface->y,
+			                        rects[index].right + surface->x,
+			                        rects[index].bottom + surface->y };
+
+		if (!region16_union_rect(region, region, &rect))
+			goto out;
+	}
+
+	rc = TRUE;
+out:
+	region16_uninit(&changed);
+	return rc;
+}
+
+static void pipewire_shadow_process_buffer(pipewireShadowSubsystem* subsystem,
+                                           struct pw_buffer* pwBuffer)
+{
+	UINT32 index;
+	UINT32 numRects = 0;
+	UINT32 nSrcStep;
+	const BYTE* pSrcData;
+	const RECTANGLE_16* rects;
+	RECTANGLE_16 surfaceRect;
+	REGION16 region;
+	BYTE* map = NULL;
+	size_t mapLength = 0;
+	struct spa_buffer* buffer = pwBuffer->buffer;
+	struct spa_data* data = &buffer->datas[0];
+	rdpShadowSurface* surface = subsystem->common.server->surface;
+	const UINT32 format = pipewire_shadow_get_pixel_format(subsystem->format.format);
+
+	if ((buffer->n_datas < 1) || !data->chunk || (data->chunk->size == 0) ||
+	    (data->chunk->flags & SPA_CHUNK_FLAG_CORRUPTED))
+		return;
+
+	pSrcData = data->data;
+
+	if (!pSrcData && (data->type == SPA_DATA_DmaBuf))
+	{
+		mapLength = data->maxsize + data->mapoffset;
+		map = (BYTE*)mmap(NULL, mapLength, PROT_READ, MAP_SHARED, (int)data->fd, 0);
+
+		if (map == MAP_FAILED)
+		{
+			WLog_ERR(TAG, "failed to map a DMA-BUF frame: %s", strerror(errno));
+			return;
+		}
+
+		pSrcData = &map[data->mapoffset];
+	}
+
+	if (!pSrcData || (data->chunk->stride <= 0) || (data->chunk->offset >= data->maxsize))
+		goto out;
+
+	pSrcData = &pSrcData[data->chunk->offset];
+	nSrcStep = (UINT32)data->chunk->stride;
+	region16_init(&region);
+	EnterCriticalSection(&surface->lock);
+
+	/* a frame of the new size, the subsystem thread resizes the surface first */
+	if ((subsystem->format.size.width != subsystem->width) ||
+	    (subsystem->format.size.height != subsystem->height) ||
+	    (1ULL * nSrcStep * subsystem->height > data->maxsize - data->chunk->offset))
+	{
+		subsystem->fullDamage = TRUE;
+		goto out_unlock;
+	}
+
+	surfaceRect.left = surface->x;
+	surfaceRect.top = surface->y;
+	surfaceRect.right = surface->x + surface->width;
+	surfaceRect.bottom = surface->y + surface->height;
+
+	if (!pipewire_shadow_get_damage(subsystem, buffer, pSrcData, nSrcStep, &surfaceRect, &region))
+		goto out_unlock;
+
+	rects = region16_rects(&region, &numRects);
+
+	for (index = 0; index < numRects; index++)
+	{
+		/* the damage is in stream coordinates, the surface regions are relative to the surface */
+		const RECTANGLE_16* rect = &rects[index];
+		const RECTANGLE_16 invalid = { rect->left - surface->x, rect->top - surface->y,
+			                           rect->right - surface->x, rect->bottom - surface->y };
+
+		if (!freerdp_image_copy(surface->data, surface->format, surface->scanline, invalid.left,
+		                        invalid.top, invalid.right - invalid.left,
+		                        invalid.bottom - invalid.top, pSrcData, format, nSrcStep,
+		                        rect->left, rect->top, NULL, FREERDP_FLIP_NONE))
+			goto out_unlock;
+
+		if (!region16_union_rect(&subsystem->damage, &subsystem->damage, &invalid))
+			goto out_unlock;
+	}
+
+	subsystem->fullDamage = FALSE;
+
+	if (numRects > 0)
+		SetEvent(subsystem->common.event);
+
+out_unlock:
+	LeaveCriticalSection(&surface->lock);
+	region16_uninit(&region);
+out:
+	if (map)
+		munmap(map, mapLength);
+}
+
+static void pipewire_shadow_on_process(void* data)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)data;
+	struct pw_buffer* buffer;
+
+	/* all queued frames are processed, the damage of each is needed */
+	while ((buffer = pw_stream_dequeue_buffer(subsystem->stream)))
+	{
+		/* the server screen only exists while the subsystem is started */
+		if (subsystem->active)
+			pipewire_shadow_process_buffer(subsystem, buffer);
+
+		pw_stream_queue_buffer(subsystem->stream, buffer);
+	}
+}
+
+static const struct pw_stream_events pipewire_shadow_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = pipewire_shadow_on_state_changed,
+	.param_changed = pipewire_shadow_on_param_changed,
+	.process = pipewire_shadow_on_process,
+};
+
+static void pipewire_shadow_update_monitors(pipewireShadowSubsystem* subsystem)
+{
+	MONITOR_DEF* monitor = &subsystem->common.monitors[0];
+	MONITOR_DEF* virtualScreen = &subsystem->common.virtualScreen;
+
+	monitor->left = 0;
+	monitor->top = 0;
+	monitor->right = (INT32)subsystem->width - 1;
+	monitor->bottom = (INT32)subsystem->height - 1;
+	monitor->flags = 1;
+	*virtualScreen = *monitor;
+	subsystem->common.numMonitors = 1;
+}
+
+static BOOL pipewire_shadow_check_resize(pipewireShadowSubsystem* subsystem)
+{
+	UINT32 width;
+	UINT32 height;
+	rdpShadowSurface* surface = subsystem->common.server->surface;
+
+	pw_thread_loop_lock(subsystem->loop);
+	width = subsystem->format.size.width;
+	height = subsystem->format.size.height;
+	pw_thread_loop_unlock(subsystem->loop);
+
+	if ((width == subsystem->width) && (height == subsystem->height))
+		return FALSE;
+
+	EnterCriticalSection(&surface->lock);
+	subsystem->width = width;
+	subsystem->height = height;
+	region16_clear(&subsystem->damage);
+	subsystem->fullDamage = TRUE;
+	LeaveCriticalSection(&surface->lock);
+
+	/* Screen size changed. Refresh monitor definitions and trigger screen resize */
+	pipewire_shadow_update_monitors(subsystem);
+	shadow_screen_resize(subsystem->common.server->screen);
+	return TRUE;
+}
+
+static void pipewire_shadow_frame_update(pipewireShadowSubsystem* subsystem)
+{
+	BOOL empty;
+	UINT32 count;
+	UINT32 index;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects;
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+	/*
+	 * The stream keeps reporting damage into subsystem->damage while the clients encode, it is
+	 * only moved to the surface here so no damage is cleared before all clients saw it.
+	 */
+	EnterCriticalSection(&surface->lock);
+	rects = region16_rects(&subsystem->damage, &numRects);
+
+	for (index = 0; index < numRects; index++)
+		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[index]);
+
+	region16_clear(&subsystem->damage);
+	empty = region16_is_empty(&surface->invalidRegion);
+	LeaveCriticalSection(&surface->lock);
+
+	if (empty)
+		return;
+
+	count = ArrayList_Count(server->clients);
+	shadow_subsystem_frame_update(&subsystem->common);
+
+	if (count == 1)
+	{
+		rdpShadowClient* client = (rdpShadowClient*)ArrayList_GetItem(server->clients, 0);
+
+		if (client)
+			subsystem->common.captureFrameRate = shadow_encoder_preferred_fps(client->encoder);
+	}
+
+	EnterCriticalSection(&surface->lock);
+	region16_clear(&surface->invalidRegion);
+	LeaveCriticalSection(&surface->lock);
+}
+
+static int pipewire_shadow_subsystem_process_message(pipewireShadowSubsystem* subsystem,
+                                                     wMessage* message)
+{
+	switch (message->id)
+	{
+		case SHADOW_MSG_IN_REFRESH_REQUEST_ID:
+			shadow_subsystem_frame_update((rdpShadowSubsystem*)subsystem);
+			break;
+
+		default:
+			WLog_ERR(TAG, "Unknown message id: %" PRIu32 "", message->id);
+			break;
+	}
+
+	if (message->Free)
+		message->Free(message);
+
+	return 1;
+}
+
+static DWORD WINAPI pipewire_shadow_subsystem_thread(LPVOID arg)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)arg;
+	DWORD nCount = 0;
+	HANDLE events[32];
+	wMessage message;
+	wMessagePipe* MsgPipe = subsystem->common.MsgPipe;
+
+	events[nCount++] = subsystem->common.event;
+	events[nCount++] = MessageQueue_Event(MsgPipe->In);
+	subsystem->common.captureFrameRate = 16;
+
+	while (1)
+	{
+		WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+
+		if (WaitForSingleObject(MessageQueue_Event(MsgPipe->In), 0) == WAIT_OBJECT_0)
+		{
+			if (MessageQueue_Peek(MsgPipe->In, &message, TRUE))
+			{
+				if (message.id == WMQ_QUIT)
+					break;
+
+				pipewire_shadow_subsystem_process_message(subsystem, &message);
+			}
+		}
+
+		if (WaitForSingleObject(subsystem->common.event, 0) == WAIT_OBJECT_0)
+		{
+			ResetEvent(subsystem->common.event);
+			pipewire_shadow_check_resize(subsystem);
+			pipewire_shadow_frame_update(subsystem);
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static BOOL pipewire_shadow_get_env_number(const char* name, long* value)
+{
+	char* end = NULL;
+	const char* str = getenv(name);
+
+	if (!str)
+		return FALSE;
+
+	errno = 0;
+	*value = strtol(str, &end, 0);
+
+	if ((errno != 0) || (end == str) || (*end != '\0') || (*value < 0))
+	{
+		WLog_WARN(TAG, "ignoring invalid %s=%s", name, str);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL pipewire_shadow_connect(pipewireShadowSubsystem* subsystem)
+{
+	long value;
+	BYTE buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod* params[1];
+
+	subsystem->context = pw_context_new(pw_thread_loop_get_loop(subsystem->loop), NULL, 0);
+
+	if (!subsystem->context)
+		return FALSE;
+
+	if (pipewire_shadow_get_env_number("FREERDP_SHADOW_PIPEWIRE_FD", &value))
+	{
+		const int fd = fcntl((int)value, F_DUPFD_CLOEXEC, 3);
+
+		if (fd < 0)
+		{
+			WLog_ERR(TAG, "invalid PipeWire remote %ld: %s", value, strerror(errno));
+			return FALSE;
+		}
+
+		subsystem->core = pw_context_connect_fd(subsystem->context, fd, NULL, 0);
+	}
+	else
+		subsystem->core = pw_context_connect(subsystem->context, NULL, 0);
+
+	if (!subsystem->core)
+	{
+		WLog_ERR(TAG, "failed to connect to PipeWire: %s", strerror(errno));
+		return FALSE;
+	}
+
+	/* PW_ID_ANY would capture whatever video source the session manager links to */
+	if (!pipewire_shadow_get_env_number("FREERDP_SHADOW_PIPEWIRE_NODE", &value) ||
+	    ((unsigned long)value >= PW_ID_ANY))
+	{
+		WLog_ERR(TAG, "FREERDP_SHADOW_PIPEWIRE_NODE must name the screen cast node to capture");
+		return FALSE;
+	}
+
+	subsystem->nodeId = (UINT32)value;
+
+	subsystem->stream = pw_stream_new(
+	    subsystem->core, "FreeRDP shadow",
+	    pw_properties_new(PW_KEY_MEDIA_TYPE, "Video", PW_KEY_MEDIA_CATEGORY, "Capture",
+	                      PW_KEY_MEDIA_ROLE, "Screen", NULL));
+
+	if (!subsystem->stream)
+		return FALSE;
+
+	pw_stream_add_listener(subsystem->stream, &subsystem->streamListener,
+	                       &pipewire_shadow_stream_events, subsystem);
+	params[0] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat, SPA_FORMAT_mediaType,
+	    SPA_POD_Id(SPA_MEDIA_TYPE_video), SPA_FORMAT_mediaSubtype,
+	    SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw), SPA_FORMAT_VIDEO_format,
+	    SPA_POD_CHOICE_ENUM_Id(5, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRx,
+	                           SPA_VIDEO_FORMAT_BGRA, SPA_VIDEO_FORMAT_RGBx,
+	                           SPA_VIDEO_FORMAT_RGBA),
+	    SPA_FORMAT_VIDEO_size,
+	    SPA_POD_CHOICE_RANGE_Rectangle(&SPA_RECTANGLE(1920, 1080), &SPA_RECTANGLE(1, 1),
+	                                   &SPA_RECTANGLE(8192, 8192)),
+	    SPA_FORMAT_VIDEO_framerate,
+	    SPA_POD_CHOICE_RANGE_Fraction(&SPA_FRACTION(0, 1), &SPA_FRACTION(0, 1),
+	                                  &SPA_FRACTION(360, 1)));
+
+	if (pw_stream_connect(subsystem->stream, PW_DIRECTION_INPUT, subsystem->nodeId,
+	                      PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS, params,
+	                      ARRAYSIZE(params)) < 0)
+	{
+		WLog_ERR(TAG, "failed to connect the stream to node %" PRIu32, subsystem->nodeId);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int pipewire_shadow_subsystem_init(rdpShadowSubsystem* sub)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)sub;
+
+	pw_init(NULL, NULL);
+
+	if (!(subsystem->common.event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		return -1;
+
+	subsystem->loop = pw_thread_loop_new("shadow.pipewire", NULL);
+
+	if (!subsystem->loop)
+		return -1;
+
+	pw_thread_loop_lock(subsystem->loop);
+
+	if (pw_thread_loop_start(subsystem->loop) < 0)
+		goto fail;
+
+	if (!pipewire_shadow_connect(subsystem))
+		goto fail;
+
+	/* the surface is created from the monitor size, wait for the negotiated format */
+	while (!subsystem->negotiated && !subsystem->failed)
+	{
+		if (pw_thread_loop_timed_wait(subsystem->loop, PIPEWIRE_SHADOW_NEGOTIATE_TIMEOUT) < 0)
+		{
+			WLog_ERR(TAG, "timed out waiting for the stream format");
+			goto fail;
+		}
+	}
+
+	if (subsystem->failed)
+		goto fail;
+
+	subsystem->width = subsystem->format.size.width;
+	subsystem->height = subsystem->format.size.height;
+	subsystem->fullDamage = TRUE;
+	pw_thread_loop_unlock(subsystem->loop);
+
+	pipewire_shadow_update_monitors(subsystem);
+	return 1;
+fail:
+	pw_thread_loop_unlock(subsystem->loop);
+	return -1;
+}
+
+static int pipewire_shadow_subsystem_uninit(rdpShadowSubsystem* sub)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->loop)
+		pw_thread_loop_stop(subsystem->loop);
+
+	if (subsystem->stream)
+	{
+		pw_stream_destroy(subsystem->stream);
+		subsystem->stream = NULL;
+	}
+
+	if (subsystem->core)
+	{
+		pw_core_disconnect(subsystem->core);
+		subsystem->core = NULL;
+	}
+
+	if (subsystem->context)
+	{
+		pw_context_destroy(subsystem->context);
+		subsystem->context = NULL;
+	}
+
+	if (subsystem->loop)
+	{
+		pw_thread_loop_destroy(subsystem->loop);
+		subsystem->loop = NULL;
+	}
+
+	if (subsystem->common.event)
+	{
+		CloseHandle(subsystem->common.event);
+		subsystem->common.event = NULL;
+	}
+
+	subsystem->negotiated = FALSE;
+	subsystem->failed = FALSE;
+	return 1;
+}
+
+static int pipewire_shadow_subsystem_start(rdpShadowSubsystem* sub)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (!(subsystem->thread =
+	          CreateThread(NULL, 0, pipewire_shadow_subsystem_thread, (void*)subsystem, 0, NULL)))
+	{
+		WLog_ERR(TAG, "Failed to create thread");
+		return -1;
+	}
+
+	pw_thread_loop_lock(subsystem->loop);
+	subsystem->active = TRUE;
+	pw_thread_loop_unlock(subsystem->loop);
+	return 1;
+}
+
+static int pipewire_shadow_subsystem_stop(rdpShadowSubsystem* sub)
+{
+	pipewireShadowSubsystem* subsystem = (pipewireShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->loop)
+	{
+		pw_thread_loop_lock(subsystem->loop);
+		subsystem->active = FALSE;
+		pw_thread_loop_unlock(subsystem->loop);
+	}
+
+	if (subsystem->thread)
+	{
+		if (MessageQueue_PostQuit(subsystem->common.MsgPipe->In, 0))
+			WaitForSingleObject(subsystem->thread, INFINITE);
+
+		CloseHandle(subsystem->thread);
+		subsystem->thread = NULL;
+	}
+
+	return 1;
+}
+
+static rdpShadowSubsystem* pipewire_shadow_subsystem_new(void)
+{
+	pipewireShadowSubsystem* subsystem;
+	subsystem = (pipewireShadowSubsystem*)calloc(1, sizeof(pipewireShadowSubsystem));
+
+	if (!subsystem)
+		return NULL;
+
+	region16_init(&subsystem->damage);
+	return (rdpShadowSubsystem*)subsystem;
+}
+
+static void pipewire_shadow_subsystem_free(rdpShadowSubsystem* subsystem)
+{
+	if (!subsystem)
+		return;
+
+	pipewire_shadow_subsystem_uninit(subsystem);
+	region16_uninit(&((pipewireShadowSubsystem*)subsystem)->damage);
+	free(subsystem);
+}
+
+/* a screen cast stream is a single monitor, its size is only known once it is negotiated */
+static UINT32 pipewire_shadow_enum_monitors(MONITOR_DEF* monitors, UINT32 maxMonitors)
+{
+	if (maxMonitors < 1)
+		return 0;
+
+	ZeroMemory(&monitors[0], sizeof(MONITOR_DEF));
+	monitors[0].flags = 1;
+	return 1;
+}
+
+FREERDP_API int PipeWire_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints)
+{
+	if (!pEntryPoints)
+		return -1;
+
+	pEntryPoints->New = pipewire_shadow_subsystem_new;
+	pEntryPoints->Free = pipewire_shadow_subsystem_free;
+	pEntryPoints->Init = pipewire_shadow_subsystem_init;
+	pEntryPoints->Uninit = pipewire_shadow_subsystem_uninit;
+	pEntryPoints->Start = pipewire_shadow_subsystem_start;
+	pEntryPoints->Stop = pipewire_shadow_subsystem_stop;
+	pEntryPoints->EnumMonitors = pipewire_shadow_enum_monitors;
+	return 1;
+}
@@ -0,0 +1,64 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_PIPEWIRE_H
+#define FREERDP_SERVER_SHADOW_PIPEWIRE_H
+
+#include <freerdp/server/shadow.h>
+
+typedef struct pipewire_shadow_subsystem pipewireShadowSubsystem;
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+
+#include <pipewire/pipewire.h>
+#include <spa/param/video/format-utils.h>
+
+struct pipewire_shadow_subsystem
+{
+	rdpShadowSubsystem common;
+
+	HANDLE thread;
+	UINT32 width;
+	UINT32 height;
+
+	struct pw_thread_loop* loop;
+	struct pw_context* context;
+	struct pw_core* core;
+	struct pw_stream* stream;
+	struct spa_hook streamListener;
+	struct spa_video_info_raw format;
+	UINT32 nodeId;
+	BOOL negotiated;
+	BOOL failed;
+	BOOL active; /* frames are processed, guarded by the loop lock */
+
+	/* damage reported by the stream since the last frame update, guarded by the surface lock */
+	REGION16 damage;
+	BOOL fullDamage;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_PIPEWIRE_H */
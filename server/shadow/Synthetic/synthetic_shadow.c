@@ -0,0 +1,665 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/region.h>
+
+#include "synthetic_shadow.h"
+
+#define TAG SERVER_TAG("shadow.synthetic")
+
+/**
+ * A desktop without a display, for load tests of the server.
+ *
+ * Frames are generated at a fixed rate with a known damage pattern, the same sequence on every
+ * run so results of different builds can be compared:
+ *
+ * static: the desktop is painted once
+ * typing: one character per frame in a document window
+ * scroll: the document window scrolls by one line per frame
+ * video:  a 640x360 area of natural content changes every frame
+ * mixed:  video and typing
+ *
+ * FREERDP_SHADOW_SYNTHETIC_FILE replays recorded frames instead, raw BGRX32 images of the
+ * desktop size read in a loop. The damage is found by comparing them with the previous frame.
+ *
+ * The desktop is configured with FREERDP_SHADOW_SYNTHETIC_WIDTH, FREERDP_SHADOW_SYNTHETIC_HEIGHT,
+ * FREERDP_SHADOW_SYNTHETIC_FPS and FREERDP_SHADOW_SYNTHETIC_PATTERN. Key presses of the clients
+ * are typed into the document, so input latency can be measured with any pattern.
+ */
+
+#define SYNTHETIC_SHADOW_DEFAULT_WIDTH 1920
+#define SYNTHETIC_SHADOW_DEFAULT_HEIGHT 1080
+#define SYNTHETIC_SHADOW_DEFAULT_FPS 30
+#define SYNTHETIC_SHADOW_MIN_SIZE 64
+#define SYNTHETIC_SHADOW_MAX_SIZE 8192
+#define SYNTHETIC_SHADOW_MAX_FPS 240
+#define SYNTHETIC_SHADOW_GLYPH_WIDTH 8
+#define SYNTHETIC_SHADOW_GLYPH_HEIGHT 16
+#define SYNTHETIC_SHADOW_VIDEO_WIDTH 640
+#define SYNTHETIC_SHADOW_VIDEO_HEIGHT 360
+
+static const char* const synthetic_shadow_pattern_names[] = { "static", "typing", "scroll",
+	                                                          "video", "mixed" };
+
+/* xorshift32, the same sequence on every run */
+static UINT32 synthetic_shadow_random(syntheticShadowSubsystem* subsystem)
+{
+	UINT32 x = subsystem->random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	subsystem->random = x;
+	return x;
+}
+
+static void synthetic_shadow_fill(rdpShadowSurface* surface, const RECTANGLE_16* rect,
+                                  UINT32 color)
+{
+	UINT32 x, y;
+
+	for (y = rect->top; y < rect->bottom; y++)
+	{
+		BYTE* line = &surface->data[1ULL * y * surface->scanline + rect->left * 4ULL];
+
+		for (x = 0; x < (UINT32)(rect->right - rect->left); x++)
+			WriteColor(&line[x * 4], surface->format, color);
+	}
+}
+
+static void synthetic_shadow_paint_desktop(syntheticShadowSubsystem* subsystem,
+                                           rdpShadowSurface* surface)
+{
+	UINT32 y;
+	RECTANGLE_16 rect;
+	const UINT32 format = surface->format;
+
+	for (y = 0; y < subsystem->height; y++)
+	{
+		const BYTE c = (BYTE)(0x20 + (0x60 * y) / subsystem->height);
+
+		rect.left = 0;
+		rect.top = (UINT16)y;
+		rect.right = (UINT16)subsystem->width;
+		rect.bottom = (UINT16)(y + 1);
+		synthetic_shadow_fill(surface, &rect, FreeRDPGetColor(format, 0x10, c / 2, c, 0xFF));
+	}
+
+	rect = subsystem->document;
+	rect.top -= SYNTHETIC_SHADOW_GLYPH_HEIGHT;
+	rect.bottom = subsystem->document.top;
+	synthetic_shadow_fill(surface, &rect, FreeRDPGetColor(format, 0x30, 0x50, 0xA0, 0xFF));
+	synthetic_shadow_fill(surface, &subsystem->document,
+	                      FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF));
+	synthetic_shadow_fill(surface, &subsystem->video, FreeRDPGetColor(format, 0, 0, 0, 0xFF));
+	subsystem->cursorX = 0;
+	subsystem->cursorY = 0;
+}
+
+static UINT32 synthetic_shadow_columns(const syntheticShadowSubsystem* subsystem)
+{
+	return (subsystem->document.right - subsystem->document.left) / SYNTHETIC_SHADOW_GLYPH_WIDTH;
+}
+
+static UINT32 synthetic_shadow_rows(const syntheticShadowSubsystem* subsystem)
+{
+	return (subsystem->document.bottom - subsystem->document.top) / SYNTHETIC_SHADOW_GLYPH_HEIGHT;
+}
+
+/* a random dark pattern on white, close enough to text for the codecs */
+static void synthetic_shadow_draw_glyph(syntheticShadowSubsystem* subsystem,
+                                        rdpShadowSurface* surface, UINT32 column, UINT32 row,
+                                        REGION16* damage)
+{
+	UINT32 x, y;
+	RECTANGLE_16 rect;
+	const UINT32 white = FreeRDPGetColor(surface->format, 0xFF, 0xFF, 0xFF, 0xFF);
+	const UINT32 black = FreeRDPGetColor(surface->format, 0x10, 0x10, 0x10, 0xFF);
+
+	rect.left = (UINT16)(subsystem->document.left + column * SYNTHETIC_SHADOW_GLYPH_WIDTH);
+	rect.top = (UINT16)(subsystem->document.top + row * SYNTHETIC_SHADOW_GLYPH_HEIGHT);
+	rect.right = rect.left + SYNTHETIC_SHADOW_GLYPH_WIDTH;
+	rect.bottom = rect.top + SYNTHETIC_SHADOW_GLYPH_HEIGHT;
+
+	for (y = 0; y < SYNTHETIC_SHADOW_GLYPH_HEIGHT; y++)
+	{
+		const UINT32 bits = synthetic_shadow_random(subsystem);
+		BYTE* line = &surface->data[1ULL * (rect.top + y) * surface->scanline + rect.left * 4ULL];
+
+		for (x = 0; x < SYNTHETIC_SHADOW_GLYPH_WIDTH; x++)
+		{
+			const BOOL ink = (y >= 3) && (y < 13) && (x >= 1) && (x < 7) && (bits & (1u << x));
+			WriteColor(&line[x * 4], surface->format, ink ? black : white);
+		}
+	}
+
+	region16_union_rect(damage, damage, &rect);
+}
+
+static void synthetic_shadow_type(syntheticShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                  REGION16* damage)
+{
+	if (subsystem->cursorX >= synthetic_shadow_columns(subsystem))
+	{
+		subsystem->cursorX = 0;
+		subsystem->cursorY++;
+	}
+
+	if (subsystem->cursorY >= synthetic_shadow_rows(subsystem))
+	{
+		synthetic_shadow_fill(surface, &subsystem->document,
+		                      FreeRDPGetColor(surface->format, 0xFF, 0xFF, 0xFF, 0xFF));
+		region16_union_rect(damage, damage, &subsystem->document);
+		subsystem->cursorY = 0;
+	}
+
+	synthetic_shadow_draw_glyph(subsystem, surface, subsystem->cursorX++, subsystem->cursorY,
+	                            damage);
+}
+
+static void synthetic_shadow_scroll(syntheticShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                    REGION16* damage)
+{
+	UINT32 y;
+	UINT32 column;
+	RECTANGLE_16 line;
+	const RECTANGLE_16* doc = &subsystem->document;
+	const UINT32 rows = synthetic_shadow_rows(subsystem);
+	const UINT32 length = synthetic_shadow_random(subsystem) % synthetic_shadow_columns(subsystem);
+	const size_t width = (doc->right - doc->left) * 4ULL;
+
+	for (y = doc->top; y + SYNTHETIC_SHADOW_GLYPH_HEIGHT < doc->bottom; y++)
+	{
+		BYTE* dst = &surface->data[1ULL * y * surface->scanline + doc->left * 4ULL];
+		memmove(dst, &dst[1ULL * SYNTHETIC_SHADOW_GLYPH_HEIGHT * surface->scanline], width);
+	}
+
+	line = *doc;
+	line.top = (UINT16)(doc->top + (rows - 1) * SYNTHETIC_SHADOW_GLYPH_HEIGHT);
+	synthetic_shadow_fill(surface, &line,
+	                      FreeRDPGetColor(surface->format, 0xFF, 0xFF, 0xFF, 0xFF));
+
+	for (column = 0; column < length; column++)
+		synthetic_shadow_draw_glyph(subsystem, surface, column, rows - 1, damage);
+
+	region16_union_rect(damage, damage, doc);
+}
+
+static void synthetic_shadow_play(syntheticShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                  REGION16* damage)
+{
+	UINT32 x, y;
+	const RECTANGLE_16* rect = &subsystem->video;
+	const UINT32 t = (UINT32)subsystem->frameCount;
+
+	for (y = rect->top; y < rect->bottom; y++)
+	{
+		BYTE* line = &surface->data[1ULL * y * surface->scanline + rect->left * 4ULL];
+
+		for (x = 0; x < (UINT32)(rect->right - rect->left); x++)
+		{
+			const BYTE noise = (BYTE)(synthetic_shadow_random(subsystem) & 0x1F);
+			const BYTE r = (BYTE)((x + t * 4) & 0xFF);
+			const BYTE g = (BYTE)((y + t * 2) & 0xFF);
+			const BYTE b = (BYTE)(((x + y) / 2 + t) & 0xFF);
+			WriteColor(&line[x * 4], surface->format,
+			           FreeRDPGetColor(surface->format, r ^ noise, g, b ^ noise, 0xFF));
+		}
+	}
+
+	region16_union_rect(damage, damage, rect);
+}
+
+static BOOL synthetic_shadow_replay(syntheticShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                    REGION16* damage)
+{
+	UINT32 y;
+	const UINT32 step = subsystem->width * 4;
+	const size_t size = 1ULL * step * subsystem->height;
+
+	if (fread(subsystem->frame, size, 1, subsystem->fp) != 1)
+	{
+		if ((_fseeki64(subsystem->fp, 0, SEEK_SET) != 0) ||
+		    (fread(subsystem->frame, size, 1, subsystem->fp) != 1))
+		{
+			WLog_ERR(TAG, "failed to read a %" PRIu32 "x%" PRIu32 " frame from the recording",
+			         subsystem->width, subsystem->height);
+			return FALSE;
+		}
+	}
+
+	if (shadow_capture_compare_region(surface->data, surface->scanline, subsystem->width,
+	                                  subsystem->height, subsystem->frame, step, NULL, damage) < 0)
+		return FALSE;
+
+	for (y = 0; y < subsystem->height; y++)
+		memcpy(&surface->data[1ULL * y * surface->scanline], &subsystem->frame[1ULL * y * step],
+		       step);
+
+	return TRUE;
+}
+
+static BOOL synthetic_shadow_generate(syntheticShadowSubsystem* subsystem,
+                                      rdpShadowSurface* surface, REGION16* damage)
+{
+	const SYNTHETIC_PATTERN pattern = subsystem->pattern;
+
+	if (subsystem->fp)
+		return synthetic_shadow_replay(subsystem, surface, damage);
+
+	if (!subsystem->painted)
+	{
+		RECTANGLE_16 rect = { 0 };
+
+		rect.right = (UINT16)subsystem->width;
+		rect.bottom = (UINT16)subsystem->height;
+		synthetic_shadow_paint_desktop(subsystem, surface);
+		region16_union_rect(damage, damage, &rect);
+		subsystem->painted = TRUE;
+	}
+
+	while (InterlockedCompareExchange(&subsystem->keys, 0, 0) > 0)
+	{
+		InterlockedDecrement(&subsystem->keys);
+		synthetic_shadow_type(subsystem, surface, damage);
+	}
+
+	if ((pattern == SYNTHETIC_PATTERN_TYPING) || (pattern == SYNTHETIC_PATTERN_MIXED))
+		synthetic_shadow_type(subsystem, surface, damage);
+
+	if (pattern == SYNTHETIC_PATTERN_SCROLL)
+		synthetic_shadow_scroll(subsystem, surface, damage);
+
+	if ((pattern == SYNTHETIC_PATTERN_VIDEO) || (pattern == SYNTHETIC_PATTERN_MIXED))
+		synthetic_shadow_play(subsystem, surface, damage);
+
+	return TRUE;
+}
+
+static void synthetic_shadow_frame_update(syntheticShadowSubsystem* subsystem)
+{
+	BOOL rc;
+	BOOL empty;
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+	EnterCriticalSection(&surface->lock);
+	rc = synthetic_shadow_generate(subsystem, surface, &surface->invalidRegion);
+	empty = region16_is_empty(&surface->invalidRegion);
+	LeaveCriticalSection(&surface->lock);
+	subsystem->frameCount++;
+
+	if (!rc)
+	{
+		/* keep the server running, the pattern takes over */
+		fclose(subsystem->fp);
+		subsystem->fp = NULL;
+		subsystem->painted = FALSE;
+	}
+
+	if (empty)
+		return;
+
+	shadow_subsystem_frame_update(&subsystem->common);
+
+	EnterCriticalSection(&surface->lock);
+	region16_clear(&surface->invalidRegion);
+	LeaveCriticalSection(&surface->lock);
+}
+
+static int synthetic_shadow_subsystem_process_message(syntheticShadowSubsystem* subsystem,
+                                                      wMessage* message)
+{
+	switch (message->id)
+	{
+		case SHADOW_MSG_IN_REFRESH_REQUEST_ID:
+			shadow_subsystem_frame_update((rdpShadowSubsystem*)subsystem);
+			break;
+
+		default:
+			WLog_ERR(TAG, "Unknown message id: %" PRIu32 "", message->id);
+			break;
+	}
+
+	if (message->Free)
+		message->Free(message);
+
+	return 1;
+}
+
+static DWORD WINAPI synthetic_shadow_subsystem_thread(LPVOID arg)
+{
+	syntheticShadowSubsystem* subsystem = (syntheticShadowSubsystem*)arg;
+	wMessage message;
+	wMessagePipe* MsgPipe = subsystem->common.MsgPipe;
+	const UINT64 interval = 1000 / subsystem->fps;
+	UINT64 next = GetTickCount64();
+
+	subsystem->common.captureFrameRate = subsystem->fps;
+
+	while (1)
+	{
+		UINT64 now = GetTickCount64();
+		const DWORD timeout = (next > now) ? (DWORD)(next - now) : 0;
+
+		if (WaitForSingleObject(MessageQueue_Event(MsgPipe->In), timeout) == WAIT_OBJECT_0)
+		{
+			if (MessageQueue_Peek(MsgPipe->In, &message, TRUE))
+			{
+				if (message.id == WMQ_QUIT)
+					break;
+
+				synthetic_shadow_subsystem_process_message(subsystem, &message);
+			}
+		}
+
+		now = GetTickCount64();
+
+		if (now < next)
+			continue;
+
+		synthetic_shadow_frame_update(subsystem);
+		next += interval;
+
+		/* frames missed while the clients were busy are dropped, not sent in a burst */
+		if (next < now)
+			next = now + interval;
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static BOOL synthetic_shadow_get_env_number(const char* name, long min, long max, long* value)
+{
+	char* end = NULL;
+	const char* str = getenv(name);
+
+	if (!str)
+		return FALSE;
+
+	errno = 0;
+	*value = strtol(str, &end, 0);
+
+	if ((errno != 0) || (end == str) || (*end != '\0') || (*value < min) || (*value > max))
+	{
+		WLog_WARN(TAG, "ignoring invalid %s=%s", name, str);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void synthetic_shadow_read_config(syntheticShadowSubsystem* subsystem)
+{
+	size_t index;
+	long value;
+	const char* pattern = getenv("FREERDP_SHADOW_SYNTHETIC_PATTERN");
+
+	subsystem->width = SYNTHETIC_SHADOW_DEFAULT_WIDTH;
+	subsystem->height = SYNTHETIC_SHADOW_DEFAULT_HEIGHT;
+	subsystem->fps = SYNTHETIC_SHADOW_DEFAULT_FPS;
+	subsystem->pattern = SYNTHETIC_PATTERN_MIXED;
+
+	if (synthetic_shadow_get_env_number("FREERDP_SHADOW_SYNTHETIC_WIDTH",
+	                                    SYNTHETIC_SHADOW_MIN_SIZE, SYNTHETIC_SHADOW_MAX_SIZE,
+	                                    &value))
+		subsystem->width = (UINT32)value;
+
+	if (synthetic_shadow_get_env_number("FREERDP_SHADOW_SYNTHETIC_HEIGHT",
+	                                    SYNTHETIC_SHADOW_MIN_SIZE, SYNTHETIC_SHADOW_MAX_SIZE,
+	                                    &value))
+		subsystem->height = (UINT32)value;
+
+	if (synthetic_shadow_get_env_number("FREERDP_SHADOW_SYNTHETIC_FPS", 1,
+	                                    SYNTHETIC_SHADOW_MAX_FPS, &value))
+		subsystem->fps = (UINT32)value;
+
+	if (!pattern)
+		return;
+
+	for (index = 0; index < ARRAYSIZE(synthetic_shadow_pattern_names); index++)
+	{
+		if (_stricmp(pattern, synthetic_shadow_pattern_names[index]) == 0)
+		{
+			subsystem->pattern = (SYNTHETIC_PATTERN)index;
+			return;
+		}
+	}
+
+	WLog_WARN(TAG, "ignoring unknown pattern %s", pattern);
+}
+
+static void synthetic_shadow_update_layout(syntheticShadowSubsystem* subsystem)
+{
+	MONITOR_DEF* monitor = &subsystem->common.monitors[0];
+	RECTANGLE_16* doc = &subsystem->document;
+	RECTANGLE_16* video = &subsystem->video;
+	const UINT32 width = subsystem->width;
+	const UINT32 height = subsystem->height;
+	const UINT32 videoWidth = MIN(SYNTHETIC_SHADOW_VIDEO_WIDTH, width / 2 - width / 16);
+	const UINT32 videoHeight = MIN(SYNTHETIC_SHADOW_VIDEO_HEIGHT, height * 3 / 4);
+
+	/* the document on the left half, the video centered on the right half */
+	doc->left = (UINT16)(width / 32);
+	doc->top = (UINT16)(height / 8);
+	doc->right = (UINT16)(doc->left + (width / 2 - 2 * doc->left) / SYNTHETIC_SHADOW_GLYPH_WIDTH *
+	                                      SYNTHETIC_SHADOW_GLYPH_WIDTH);
+	doc->bottom = (UINT16)(doc->top + (height * 3 / 4) / SYNTHETIC_SHADOW_GLYPH_HEIGHT *
+	                                      SYNTHETIC_SHADOW_GLYPH_HEIGHT);
+	video->left = (UINT16)(width / 2 + (width / 2 - videoWidth) / 2);
+	video->top = (UINT16)((height - videoHeight) / 2);
+	video->right = (UINT16)(video->left + videoWidth);
+	video->bottom = (UINT16)(video->top + videoHeight);
+
+	monitor->left = 0;
+	monitor->top = 0;
+	monitor->right = (INT32)width - 1;
+	monitor->bottom = (INT32)height - 1;
+	monitor->flags = 1;
+	subsystem->common.virtualScreen = *monitor;
+	subsystem->common.numMonitors = 1;
+}
+
+static BOOL synthetic_shadow_input_keyboard_event(rdpShadowSubsystem* subsystem,
+                                                  rdpShadowClient* client, UINT16 flags,
+                                                  UINT16 code)
+{
+	syntheticShadowSubsystem* synthetic = (syntheticShadowSubsystem*)subsystem;
+
+	WINPR_UNUSED(client);
+	WINPR_UNUSED(code);
+
+	if (!synthetic)
+		return FALSE;
+
+	if (!(flags & KBD_FLAGS_RELEASE))
+		InterlockedIncrement(&synthetic->keys);
+
+	return TRUE;
+}
+
+static BOOL synthetic_shadow_input_unicode_keyboard_event(rdpShadowSubsystem* subsystem,
+                                                          rdpShadowClient* client, UINT16 flags,
+                                                          UINT16 code)
+{
+	return synthetic_shadow_input_keyboard_event(subsystem, client, flags, code);
+}
+
+static BOOL synthetic_shadow_input_mouse_event(rdpShadowSubsystem* subsystem,
+                                               rdpShadowClient* client, UINT16 flags, UINT16 x,
+                                               UINT16 y)
+{
+	WINPR_UNUSED(client);
+	WINPR_UNUSED(flags);
+
+	if (!subsystem)
+		return FALSE;
+
+	subsystem->pointerX = x;
+	subsystem->pointerY = y;
+	return TRUE;
+}
+
+static int synthetic_shadow_subsystem_init(rdpShadowSubsystem* sub)
+{
+	syntheticShadowSubsystem* subsystem = (syntheticShadowSubsystem*)sub;
+	const char* filename = getenv("FREERDP_SHADOW_SYNTHETIC_FILE");
+
+	synthetic_shadow_read_config(subsystem);
+	synthetic_shadow_update_layout(subsystem);
+	subsystem->random = 0x2545F491;
+
+	if (filename)
+	{
+		subsystem->frame = (BYTE*)calloc(1ULL * subsystem->width * subsystem->height, 4);
+
+		if (!subsystem->frame)
+			return -1;
+
+		subsystem->fp = winpr_fopen(filename, "rb");
+
+		if (!subsystem->fp)
+		{
+			WLog_ERR(TAG, "failed to open the recording %s", filename);
+			return -1;
+		}
+	}
+
+	WLog_INFO(TAG, "synthetic desktop %" PRIu32 "x%" PRIu32 " at %" PRIu32 " fps, %s",
+	          subsystem->width, subsystem->height, subsystem->fps,
+	          filename ? filename : synthetic_shadow_pattern_names[subsystem->pattern]);
+	return 1;
+}
+
+static int synthetic_shadow_subsystem_uninit(rdpShadowSubsystem* sub)
+{
+	syntheticShadowSubsystem* subsystem = (syntheticShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->fp)
+	{
+		fclose(subsystem->fp);
+		subsystem->fp = NULL;
+	}
+
+	free(subsystem->frame);
+	subsystem->frame = NULL;
+	subsystem->painted = FALSE;
+	return 1;
+}
+
+static int synthetic_shadow_subsystem_start(rdpShadowSubsystem* sub)
+{
+	syntheticShadowSubsystem* subsystem = (syntheticShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (!(subsystem->thread =
+	          CreateThread(NULL, 0, synthetic_shadow_subsystem_thread, (void*)subsystem, 0, NULL)))
+	{
+		WLog_ERR(TAG, "Failed to create thread");
+		return -1;
+	}
+
+	return 1;
+}
+
+static int synthetic_shadow_subsystem_stop(rdpShadowSubsystem* sub)
+{
+	syntheticShadowSubsystem* subsystem = (syntheticShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->thread)
+	{
+		if (MessageQueue_PostQuit(subsystem->common.MsgPipe->In, 0))
+			WaitForSingleObject(subsystem->thread, INFINITE);
+
+		CloseHandle(subsystem->thread);
+		subsystem->thread = NULL;
+	}
+
+	return 1;
+}
+
+static rdpShadowSubsystem* synthetic_shadow_subsystem_new(void)
+{
+	syntheticShadowSubsystem* subsystem;
+	subsystem = (syntheticShadowSubsystem*)calloc(1, sizeof(syntheticShadowSubsystem));
+
+	if (!subsystem)
+		return NULL;
+
+	subsystem->common.KeyboardEvent = synthetic_shadow_input_keyboard_event;
+	subsystem->common.UnicodeKeyboardEvent = synthetic_shadow_input_unicode_keyboard_event;
+	subsystem->common.MouseEvent = synthetic_shadow_input_mouse_event;
+	subsystem->common.ExtendedMouseEvent = synthetic_shadow_input_mouse_event;
+	return (rdpShadowSubsystem*)subsystem;
+}
+
+static void synthetic_shadow_subsystem_free(rdpShadowSubsystem* subsystem)
+{
+	if (!subsystem)
+		return;
+
+	synthetic_shadow_subsystem_uninit(subsystem);
+	free(subsystem);
+}
+
+static UINT32 synthetic_shadow_enum_monitors(MONITOR_DEF* monitors, UINT32 maxMonitors)
+{
+	syntheticShadowSubsystem subsystem = { 0 };
+
+	if (maxMonitors < 1)
+		return 0;
+
+	synthetic_shadow_read_config(&subsystem);
+	synthetic_shadow_update_layout(&subsystem);
+	monitors[0] = subsystem.common.monitors[0];
+	return 1;
+}
+
+FREERDP_API int Synthetic_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints)
+{
+	if (!pEntryPoints)
+		return -1;
+
+	pEntryPoints->New = synthetic_shadow_subsystem_new;
+	pEntryPoints->Free = synthetic_shadow_subsystem_free;
+	pEntryPoints->Init = synthetic_shadow_subsystem_init;
+	pEntryPoints->Uninit = synthetic_shadow_subsystem_uninit;
+	pEntryPoints->Start = synthetic_shadow_subsystem_start;
+	pEntryPoints->Stop = synthetic_shadow_subsystem_stop;
+	pEntryPoints->EnumMonitors = synthetic_shadow_enum_monitors;
+	return 1;
+}
@@ -0,0 +1,72 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_SYNTHETIC_H
+#define FREERDP_SERVER_SHADOW_SYNTHETIC_H
+
+#include <stdio.h>
+
+#include <freerdp/server/shadow.h>
+
+typedef struct synthetic_shadow_subsystem syntheticShadowSubsystem;
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+
+typedef enum
+{
+	SYNTHETIC_PATTERN_STATIC,
+	SYNTHETIC_PATTERN_TYPING,
+	SYNTHETIC_PATTERN_SCROLL,
+	SYNTHETIC_PATTERN_VIDEO,
+	SYNTHETIC_PATTERN_MIXED
+} SYNTHETIC_PATTERN;
+
+struct synthetic_shadow_subsystem
+{
+	rdpShadowSubsystem common;
+
+	HANDLE thread;
+	UINT32 width;
+	UINT32 height;
+	UINT32 fps;
+	SYNTHETIC_PATTERN pattern;
+
+	/* recorded BGRX32 frames of width * height, replayed in a loop instead of the pattern */
+	FILE* fp;
+	BYTE* frame;
+
+	UINT32 random;
+	UINT64 frameCount;
+	BOOL painted;
+	RECTANGLE_16 document;
+	RECTANGLE_16 video;
+	UINT32 cursorX;
+	UINT32 cursorY;
+	LONG keys; /* key presses of the clients not typed yet */
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_SYNTHETIC_H */
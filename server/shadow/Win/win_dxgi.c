@@ -496,27 +496,38 @@ int win_shadow_dxgi_uninit(winShadowSubsystem* subsystem)
 	return 1;
 }
 
+/**
+ * Copies the rectangles of region from the desktop image to the staging texture, at the same
+ * position, and maps it. Only the dirty parts of a frame are transferred from the GPU.
+ */
 int win_shadow_dxgi_fetch_frame_data(winShadowSubsystem* subsystem, BYTE** ppDstData,
-                                     int* pnDstStep, int x, int y, int width, int height)
+                                     int* pnDstStep, const REGION16* region)
 {
 	int status;
 	HRESULT hr;
-	D3D11_BOX Box;
+	UINT32 index;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
 	DXGI_MAPPED_RECT mappedRect;
 
-	if ((width * height) < 1)
+	if (numRects < 1)
 		return 0;
 
-	Box.top = x;
-	Box.left = y;
-	Box.right = x + width;
-	Box.bottom = y + height;
-	Box.front = 0;
-	Box.back = 1;
+	for (index = 0; index < numRects; index++)
+	{
+		D3D11_BOX Box;
+
+		Box.left = rects[index].left;
+		Box.top = rects[index].top;
+		Box.right = rects[index].right;
+		Box.bottom = rects[index].bottom;
+		Box.front = 0;
+		Box.back = 1;
 
-	subsystem->dxgiDeviceContext->lpVtbl->CopySubresourceRegion(
-	    subsystem->dxgiDeviceContext, (ID3D11Resource*)subsystem->dxgiStage, 0, 0, 0, 0,
-	    (ID3D11Resource*)subsystem->dxgiDesktopImage, 0, &Box);
+		subsystem->dxgiDeviceContext->lpVtbl->CopySubresourceRegion(
+		    subsystem->dxgiDeviceContext, (ID3D11Resource*)subsystem->dxgiStage, 0, Box.left,
+		    Box.top, 0, (ID3D11Resource*)subsystem->dxgiDesktopImage, 0, &Box);
+	}
 
 	hr = subsystem->dxgiStage->lpVtbl->QueryInterface(subsystem->dxgiStage, &IID_IDXGISurface,
 	                                                  (void**)&(subsystem->dxgiSurface));
@@ -685,6 +696,7 @@ int win_shadow_dxgi_get_invalid_region(winShadowSubsystem* subsystem)
 {
 	UINT i;
 	HRESULT hr;
+	INT64 moveArea = 0;
 	POINT* pSrcPt;
 	RECT* pDstRect;
 	RECT* pDirtyRect;
@@ -774,6 +786,21 @@ int win_shadow_dxgi_get_invalid_region(winShadowSubsystem* subsystem)
 		invalidRect.bottom = (UINT16)pDstRect->bottom;
 
 		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+
+		/* clients replay one move per frame, the largest one saves the most encoding */
+		if (1LL * (pDstRect->right - pDstRect->left) * (pDstRect->bottom - pDstRect->top) >
+		    moveArea)
+		{
+			moveArea = 1LL * (pDstRect->right - pDstRect->left) *
+			           (pDstRect->bottom - pDstRect->top);
+			surface->moveValid = TRUE;
+			surface->moveSrc.left = (UINT16)pSrcPt->x;
+			surface->moveSrc.top = (UINT16)pSrcPt->y;
+			surface->moveSrc.right = (UINT16)(pSrcPt->x + pDstRect->right - pDstRect->left);
+			surface->moveSrc.bottom = (UINT16)(pSrcPt->y + pDstRect->bottom - pDstRect->top);
+			surface->moveDx = pDstRect->left - pSrcPt->x;
+			surface->moveDy = pDstRect->top - pSrcPt->y;
+		}
 	}
 
 	numDirtyRects = DirtyRectsBufferSize / sizeof(RECT);
@@ -308,21 +308,43 @@ static int win_shadow_surface_copy(winShadowSubsystem* subsystem)
 	}
 #elif defined(WITH_DXGI_1_2)
 	DstFormat = PIXEL_FORMAT_BGRX32;
-	status = win_shadow_dxgi_fetch_frame_data(subsystem, &pDstData, &nDstStep, x, y, width, height);
+	status = win_shadow_dxgi_fetch_frame_data(subsystem, &pDstData, &nDstStep,
+	                                          &(surface->invalidRegion));
 #endif
 
 	if (status <= 0)
 		return status;
 
+#if defined(WITH_WDS_API)
 	if (!freerdp_image_copy(surface->data, surface->format, surface->scanline, x, y, width, height,
 	                        pDstData, DstFormat, nDstStep, x, y, NULL, FREERDP_FLIP_NONE))
 		return ERROR_INTERNAL_ERROR;
+#elif defined(WITH_DXGI_1_2)
+	{
+		/* the staging texture only holds the dirty rectangles of this frame */
+		UINT32 index;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects = region16_rects(&(surface->invalidRegion), &numRects);
+
+		for (index = 0; index < numRects; index++)
+		{
+			const RECTANGLE_16* rect = &rects[index];
+
+			if (!freerdp_image_copy(surface->data, surface->format, surface->scanline, rect->left,
+			                        rect->top, rect->right - rect->left, rect->bottom - rect->top,
+			                        pDstData, DstFormat, nDstStep, rect->left, rect->top, NULL,
+			                        FREERDP_FLIP_NONE))
+				return ERROR_INTERNAL_ERROR;
+		}
+	}
+#endif
 
 	ArrayList_Lock(server->clients);
 	count = ArrayList_Count(server->clients);
 	shadow_subsystem_frame_update(&subsystem->base);
 	ArrayList_Unlock(server->clients);
 	region16_clear(&(surface->invalidRegion));
+	surface->moveValid = FALSE;
 	return 1;
 }
 
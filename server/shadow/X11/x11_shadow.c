@@ -42,12 +42,15 @@
 #include <freerdp/log.h>
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/region.h>
+#include <freerdp/primitives.h>
+#include <freerdp/utils/trace.h>
 
 #include "x11_shadow.h"
 
 #define TAG SERVER_TAG("shadow.x11")
 
 static UINT32 x11_shadow_enum_monitors(MONITOR_DEF* monitors, UINT32 maxMonitors);
+static int x11_shadow_xshm_create_buffers(x11ShadowSubsystem* subsystem);
 
 #ifdef WITH_PAM
 
@@ -604,7 +607,6 @@ static void x11_shadow_validate_region(x11ShadowSubsystem* subsystem, int x, int
 
 static int x11_shadow_blend_cursor(x11ShadowSubsystem* subsystem)
 {
-	UINT32 x, y;
 	UINT32 nXSrc;
 	UINT32 nYSrc;
 	UINT32 nXDst;
@@ -615,8 +617,8 @@ static int x11_shadow_blend_cursor(x11ShadowSubsystem* subsystem)
 	UINT32 nDstStep;
 	BYTE* pSrcData;
 	BYTE* pDstData;
-	BYTE A, R, G, B;
 	rdpShadowSurface* surface;
+	primitives_t* prims = primitives_get();
 
 	if (!subsystem)
 		return -1;
@@ -670,35 +672,12 @@ static int x11_shadow_blend_cursor(x11ShadowSubsystem* subsystem)
 	pDstData = surface->data;
 	nDstStep = surface->scanline;
 
-	for (y = 0; y < nHeight; y++)
-	{
-		const BYTE* pSrcPixel = &pSrcData[((nYSrc + y) * nSrcStep) + (nXSrc * 4)];
-		BYTE* pDstPixel = &pDstData[((nYDst + y) * nDstStep) + (nXDst * 4)];
-
-		for (x = 0; x < nWidth; x++)
-		{
-			B = *pSrcPixel++;
-			G = *pSrcPixel++;
-			R = *pSrcPixel++;
-			A = *pSrcPixel++;
-
-			if (A == 0xFF)
-			{
-				pDstPixel[0] = B;
-				pDstPixel[1] = G;
-				pDstPixel[2] = R;
-			}
-			else
-			{
-				pDstPixel[0] = B + (pDstPixel[0] * (0xFF - A) + (0xFF / 2)) / 0xFF;
-				pDstPixel[1] = G + (pDstPixel[1] * (0xFF - A) + (0xFF / 2)) / 0xFF;
-				pDstPixel[2] = R + (pDstPixel[2] * (0xFF - A) + (0xFF / 2)) / 0xFF;
-			}
-
-			pDstPixel[3] = 0xFF;
-			pDstPixel += 4;
-		}
-	}
+	/* XFixes cursor images have premultiplied alpha */
+	if (prims->alphaCompPremultiplied_argb(&pSrcData[nYSrc * nSrcStep + nXSrc * 4], nSrcStep,
+	                                       &pDstData[nYDst * nDstStep + nXDst * 4], nDstStep,
+	                                       &pDstData[nYDst * nDstStep + nXDst * 4], nDstStep,
+	                                       nWidth, nHeight) != PRIMITIVES_SUCCESS)
+		return -1;
 
 	return 1;
 }
@@ -725,6 +704,21 @@ static BOOL x11_shadow_check_resize(x11ShadowSubsystem* subsystem)
 		virtualScreen->right = subsystem->width - 1;
 		virtualScreen->bottom = subsystem->height - 1;
 		virtualScreen->flags = 1;
+
+		/* the surface was detached from the capture buffers when it was resized */
+		if (subsystem->use_xshm)
+		{
+			XLockDisplay(subsystem->display);
+
+			if (x11_shadow_xshm_create_buffers(subsystem) < 0)
+			{
+				WLog_WARN(TAG, "failed to resize the XShm buffers, capturing without XShm");
+				subsystem->use_xshm = FALSE;
+			}
+
+			XUnlockDisplay(subsystem->display);
+		}
+
 		return TRUE;
 	}
 
@@ -757,7 +751,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XImage* image;
 	rdpShadowServer* server;
 	rdpShadowSurface* surface;
-	RECTANGLE_16 invalidRect;
+	REGION16 invalidRegion;
 	RECTANGLE_16 surfaceRect;
 	const RECTANGLE_16* extents;
 	server = subsystem->common.server;
@@ -767,6 +761,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	if (count < 1)
 		return 1;
 
+	region16_init(&invalidRegion);
 	EnterCriticalSection(&surface->lock);
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -783,14 +778,31 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	if (subsystem->use_xshm)
 	{
-		image = subsystem->fb_image;
-		XCopyArea(subsystem->display, subsystem->root_window, subsystem->fb_pixmap,
+		/*
+		 * Frames alternate between two segments. The new frame is compared with the one the
+		 * surface points at, then the surface is switched to it, so neither the compare nor the
+		 * encoders need a copy of the frame.
+		 */
+		const int back = (subsystem->fb_index == 0) ? 1 : 0;
+		BYTE* data;
+
+		image = subsystem->fb[back].image;
+		XCopyArea(subsystem->display, subsystem->root_window, subsystem->fb[back].pixmap,
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
+		XSync(subsystem->display, False);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-		                                surface->height, (BYTE*)&(image->data[surface->width * 4]),
-		                                image->bytes_per_line, &invalidRect);
+		data = (BYTE*)&image->data[1LL * surface->y * image->bytes_per_line + surface->x * 4LL];
+		status = shadow_capture_compare_region(surface->data, surface->scanline, surface->width,
+		                                       surface->height, data, image->bytes_per_line, NULL,
+		                                       &invalidRegion);
+
+		if (status >= 0)
+		{
+			shadow_surface_attach_buffer(surface, data, image->bytes_per_line);
+			subsystem->fb_index = back;
+		}
+
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -801,9 +813,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 		if (image)
 		{
-			status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-			                                surface->height, (BYTE*)image->data,
-			                                image->bytes_per_line, &invalidRect);
+			status = shadow_capture_compare_region(surface->data, surface->scanline,
+			                                       surface->width, surface->height,
+			                                       (BYTE*)image->data, image->bytes_per_line,
+			                                       NULL, &invalidRegion);
 		}
 		LeaveCriticalSection(&surface->lock);
 		if (!image)
@@ -821,16 +834,23 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XSync(subsystem->display, False);
 	XUnlockDisplay(subsystem->display);
 
-	if (status)
+	if (status > 0)
 	{
 		BOOL empty;
+		UINT32 index;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects = region16_rects(&invalidRegion, &numRects);
 		EnterCriticalSection(&surface->lock);
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+
+		for (index = 0; index < numRects; index++)
+			region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
+			                    &rects[index]);
+
 		region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
 		empty = region16_is_empty(&(surface->invalidRegion));
 		LeaveCriticalSection(&surface->lock);
 
-		if (!empty)
+		if (!empty && !subsystem->use_xshm)
 		{
 			BOOL success;
 			EnterCriticalSection(&surface->lock);
@@ -850,7 +870,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 			LeaveCriticalSection(&surface->lock);
 			if (!success)
 				goto fail_capture;
+		}
 
+		if (!empty)
+		{
 			// x11_shadow_blend_cursor(subsystem);
 			count = ArrayList_Count(server->clients);
 			shadow_subsystem_frame_update(&subsystem->common);
@@ -873,6 +896,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	rc = 1;
 fail_capture:
+	region16_uninit(&invalidRegion);
+
 	if (!subsystem->use_xshm && image)
 		XDestroyImage(image);
 
@@ -958,8 +983,10 @@ static DWORD WINAPI x11_shadow_subsystem_thread(LPVOID arg)
 
 		if ((status == WAIT_TIMEOUT) || (GetTickCount64() > frameTime))
 		{
+			FREERDP_TRACE_SPAN_BEGIN(span);
 			x11_shadow_check_resize(subsystem);
 			x11_shadow_screen_grab(subsystem);
+			FREERDP_TRACE_SPAN_END(span, "shadow_screen_grab");
 			x11_shadow_query_cursor(subsystem, FALSE);
 			dwInterval = 1000 / subsystem->common.captureFrameRate;
 			frameTime += dwInterval;
@@ -1083,65 +1110,114 @@ static int x11_shadow_xdamage_init(x11ShadowSubsystem* subsystem)
 #endif
 }
 
-static int x11_shadow_xshm_init(x11ShadowSubsystem* subsystem)
+static void x11_shadow_xshm_free_buffer(x11ShadowSubsystem* subsystem,
+                                        x11ShadowCaptureBuffer* buffer)
 {
-	Bool pixmaps;
-	int major, minor;
-	XGCValues values;
+	if (buffer->pixmap)
+		XFreePixmap(subsystem->display, buffer->pixmap);
 
-	if (!XShmQueryExtension(subsystem->display))
-		return -1;
+	if (buffer->attached)
+		XShmDetach(subsystem->display, &(buffer->info));
 
-	if (!XShmQueryVersion(subsystem->display, &major, &minor, &pixmaps))
-		return -1;
+	if (buffer->info.shmaddr != ((char*)-1))
+		shmdt(buffer->info.shmaddr);
 
-	if (!pixmaps)
-		return -1;
+	if (buffer->image)
+	{
+		buffer->image->data = NULL;
+		XDestroyImage(buffer->image);
+	}
 
-	subsystem->fb_shm_info.shmid = -1;
-	subsystem->fb_shm_info.shmaddr = (char*)-1;
-	subsystem->fb_shm_info.readOnly = False;
-	subsystem->fb_image =
-	    XShmCreateImage(subsystem->display, subsystem->visual, subsystem->depth, ZPixmap, NULL,
-	                    &(subsystem->fb_shm_info), subsystem->width, subsystem->height);
+	ZeroMemory(buffer, sizeof(x11ShadowCaptureBuffer));
+	buffer->info.shmid = -1;
+	buffer->info.shmaddr = (char*)-1;
+}
 
-	if (!subsystem->fb_image)
+static int x11_shadow_xshm_create_buffer(x11ShadowSubsystem* subsystem,
+                                         x11ShadowCaptureBuffer* buffer)
+{
+	buffer->info.shmid = -1;
+	buffer->info.shmaddr = (char*)-1;
+	buffer->info.readOnly = False;
+	buffer->image = XShmCreateImage(subsystem->display, subsystem->visual, subsystem->depth,
+	                                ZPixmap, NULL, &(buffer->info), subsystem->width,
+	                                subsystem->height);
+
+	if (!buffer->image)
 	{
 		WLog_ERR(TAG, "XShmCreateImage failed");
 		return -1;
 	}
 
-	subsystem->fb_shm_info.shmid =
-	    shmget(IPC_PRIVATE, subsystem->fb_image->bytes_per_line * subsystem->fb_image->height,
-	           IPC_CREAT | 0600);
+	buffer->info.shmid = shmget(IPC_PRIVATE, buffer->image->bytes_per_line * buffer->image->height,
+	                            IPC_CREAT | 0600);
 
-	if (subsystem->fb_shm_info.shmid == -1)
+	if (buffer->info.shmid == -1)
 	{
 		WLog_ERR(TAG, "shmget failed");
 		return -1;
 	}
 
-	subsystem->fb_shm_info.shmaddr = shmat(subsystem->fb_shm_info.shmid, 0, 0);
-	subsystem->fb_image->data = subsystem->fb_shm_info.shmaddr;
+	buffer->info.shmaddr = shmat(buffer->info.shmid, 0, 0);
+	buffer->image->data = buffer->info.shmaddr;
 
-	if (subsystem->fb_shm_info.shmaddr == ((char*)-1))
+	if (buffer->info.shmaddr == ((char*)-1))
 	{
 		WLog_ERR(TAG, "shmat failed");
 		return -1;
 	}
 
-	if (!XShmAttach(subsystem->display, &(subsystem->fb_shm_info)))
+	if (!XShmAttach(subsystem->display, &(buffer->info)))
 		return -1;
 
+	buffer->attached = TRUE;
 	XSync(subsystem->display, False);
-	shmctl(subsystem->fb_shm_info.shmid, IPC_RMID, 0);
-	subsystem->fb_pixmap =
-	    XShmCreatePixmap(subsystem->display, subsystem->root_window, subsystem->fb_image->data,
-	                     &(subsystem->fb_shm_info), subsystem->fb_image->width,
-	                     subsystem->fb_image->height, subsystem->fb_image->depth);
+	shmctl(buffer->info.shmid, IPC_RMID, 0);
+	buffer->pixmap =
+	    XShmCreatePixmap(subsystem->display, subsystem->root_window, buffer->image->data,
+	                     &(buffer->info), buffer->image->width, buffer->image->height,
+	                     buffer->image->depth);
 	XSync(subsystem->display, False);
 
-	if (!subsystem->fb_pixmap)
+	if (!buffer->pixmap)
+		return -1;
+
+	return 1;
+}
+
+/* (re)creates the capture buffers for the current screen size */
+static int x11_shadow_xshm_create_buffers(x11ShadowSubsystem* subsystem)
+{
+	size_t index;
+
+	for (index = 0; index < ARRAYSIZE(subsystem->fb); index++)
+	{
+		x11_shadow_xshm_free_buffer(subsystem, &subsystem->fb[index]);
+
+		if (x11_shadow_xshm_create_buffer(subsystem, &subsystem->fb[index]) < 0)
+			return -1;
+	}
+
+	subsystem->fb_index = -1;
+	return 1;
+}
+
+static int x11_shadow_xshm_init(x11ShadowSubsystem* subsystem)
+{
+	Bool pixmaps;
+	int major, minor;
+	XGCValues values;
+
+	if (!XShmQueryExtension(subsystem->display))
+		return -1;
+
+	if (!XShmQueryVersion(subsystem->display, &major, &minor, &pixmaps))
+		return -1;
+
+	if (!pixmaps)
+		return -1;
+
+	if (x11_shadow_xshm_create_buffers(subsystem) < 0)
 		return -1;
 
 	values.subwindow_mode = IncludeInferiors;
@@ -1380,6 +1456,12 @@ static int x11_shadow_subsystem_uninit(rdpShadowSubsystem* sub)
 
 	if (subsystem->display)
 	{
+		size_t index;
+
+		/* the server surfaces are gone, no surface is attached to the buffers anymore */
+		for (index = 0; index < ARRAYSIZE(subsystem->fb); index++)
+			x11_shadow_xshm_free_buffer(subsystem, &subsystem->fb[index]);
+
 		XCloseDisplay(subsystem->display);
 		subsystem->display = NULL;
 	}
@@ -1456,6 +1538,9 @@ static rdpShadowSubsystem* x11_shadow_subsystem_new(void)
 	subsystem->use_xfixes = TRUE;
 	subsystem->use_xdamage = FALSE;
 	subsystem->use_xinerama = TRUE;
+	subsystem->fb_index = -1;
+	subsystem->fb[0].info.shmaddr = (char*)-1;
+	subsystem->fb[1].info.shmaddr = (char*)-1;
 	return (rdpShadowSubsystem*)subsystem;
 }
 
@@ -51,6 +51,15 @@ typedef struct x11_shadow_subsystem x11ShadowSubsystem;
 #include <X11/extensions/Xinerama.h>
 #endif
 
+/* XShm segment frames are captured into, see x11_shadow_screen_grab */
+typedef struct
+{
+	XImage* image;
+	Pixmap pixmap;
+	XShmSegmentInfo info;
+	BOOL attached; /* attached to the X server */
+} x11ShadowCaptureBuffer;
+
 struct x11_shadow_subsystem
 {
 	rdpShadowSubsystem common;
@@ -75,10 +84,9 @@ struct x11_shadow_subsystem
 	BOOL use_xdamage;
 	BOOL use_xinerama;
 
-	XImage* fb_image;
-	Pixmap fb_pixmap;
+	x11ShadowCaptureBuffer fb[2];
+	int fb_index; /* buffer attached to the surface, -1 if none */
 	Window root_window;
-	XShmSegmentInfo fb_shm_info;
 
 	UINT32 cursorHotX;
 	UINT32 cursorHotY;
@@ -47,8 +47,8 @@ int main(int argc, char** argv)
 		  NULL, NULL, -1, NULL,
 		  "An address to bind to. Use '[<ipv6>]' for IPv6 addresses, e.g. '[::1]' for "
 		  "localhost" },
-		{ "monitors", COMMAND_LINE_VALUE_OPTIONAL, "<0,1,2...>", NULL, NULL, -1, NULL,
-		  "Select or list monitors" },
+		{ "monitors", COMMAND_LINE_VALUE_OPTIONAL, "<0,1,2...|all>", NULL, NULL, -1, NULL,
+		  "Select or list monitors, all shares every monitor" },
 		{ "rect", COMMAND_LINE_VALUE_REQUIRED, "<x,y,w,h>", NULL, NULL, -1, NULL,
 		  "Select rectangle within monitor to share" },
 		{ "auth", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
@@ -69,16 +69,27 @@ int main(int argc, char** argv)
 		  "nla extended protocol security" },
 		{ "sam-file", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL,
 		  "NTLM SAM file for NLA authentication" },
+		{ "max-handshakes", COMMAND_LINE_VALUE_REQUIRED, "<count>", NULL, NULL, -1, NULL,
+		  "Maximum number of concurrent TLS/NLA handshakes, 0 for no limit" },
+		{ "handshake-timeout", COMMAND_LINE_VALUE_REQUIRED, "<milliseconds>", NULL, NULL, -1, NULL,
+		  "Time a connection waits for a handshake slot before it is rejected" },
+		{ "affinity", COMMAND_LINE_VALUE_REQUIRED, "<cpu-list|node:<n>>", NULL, NULL, -1, NULL,
+		  "Run the capture, encoder and client threads on the given processors, e.g. the NUMA "
+		  "node of the network card" },
 		{ "gfx-progressive", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX progressive codec" },
 		{ "gfx-rfx", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX RFX codec" },
 		{ "gfx-planar", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX planar codec" },
+		{ "gfx-clear", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+		  "Allow GFX ClearCodec codec" },
 		{ "gfx-avc420", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX AVC420 codec" },
 		{ "gfx-avc444", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
 		  "Allow GFX AVC444 codec" },
+		{ "gfx-mixed", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL,
+		  "Send text and UI content losslessly next to GFX AVC420/AVC444 video" },
 		{ "version", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_VERSION, NULL, NULL, NULL, -1,
 		  NULL, "Print version" },
 		{ "buildconfig", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_BUILDCONFIG, NULL, NULL, NULL,
@@ -20,6 +20,9 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/assert.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 
@@ -77,149 +80,466 @@ int shadow_capture_align_clip_rect(RECTANGLE_16* rect, RECTANGLE_16* clip)
 	return 1;
 }
 
-int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth, UINT32 nHeight, BYTE* pData2,
-                           UINT32 nStep2, RECTANGLE_16* rect)
+#define SHADOW_CAPTURE_BLOCK_SIZE 16
+#define SHADOW_CAPTURE_THREAD_MIN_PIXELS (3840 * 2160)
+#define SHADOW_CAPTURE_MAX_BANDS 16
+
+/* state of a block in the block map */
+#define SHADOW_CAPTURE_BLOCK_SKIP 0    /* outside of the hint */
+#define SHADOW_CAPTURE_BLOCK_COMPARE 1 /* not known to differ yet */
+#define SHADOW_CAPTURE_BLOCK_CHANGED 2
+
+typedef struct
+{
+	const BYTE* pData1;
+	UINT32 nStep1;
+	const BYTE* pData2;
+	UINT32 nStep2;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	UINT32 ncol;
+	BYTE* blocks;
+	UINT32 firstRow;
+	UINT32 lastRow; /* exclusive */
+} SHADOW_CAPTURE_BAND;
+
+/**
+ * Compares the block rows of a band line by line. A line is first compared in one span from the
+ * first to the last block still in question, only lines that differ are split into blocks.
+ * Blocks found to differ are not looked at again.
+ */
+static void shadow_capture_compare_band(SHADOW_CAPTURE_BAND* band)
 {
-	BOOL equal;
-	BOOL allEqual;
-	UINT32 tw, th;
 	UINT32 tx, ty, k;
-	UINT32 nrow, ncol;
-	UINT32 l, t, r, b;
-	BYTE *p1, *p2;
-	BOOL rows[1024];
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	BOOL cols[1024];
-#endif
-	allEqual = TRUE;
-	ZeroMemory(rect, sizeof(RECTANGLE_16));
-	FillMemory(rows, sizeof(rows), 0xFF);
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	FillMemory(cols, sizeof(cols), 0xFF);
-#endif
-	nrow = (nHeight + 15) / 16;
-	ncol = (nWidth + 15) / 16;
-	l = ncol + 1;
-	r = 0;
-	t = nrow + 1;
-	b = 0;
 
-	for (ty = 0; ty < nrow; ty++)
+	for (ty = band->firstRow; ty < band->lastRow; ty++)
 	{
-		th = ((ty + 1) == nrow) ? (nHeight % 16) : 16;
-
-		if (!th)
-			th = 16;
+		BYTE* blocks = &band->blocks[1ULL * ty * band->ncol];
+		const UINT32 y = ty * SHADOW_CAPTURE_BLOCK_SIZE;
+		const UINT32 th = MIN(SHADOW_CAPTURE_BLOCK_SIZE, band->nHeight - y);
 
-		for (tx = 0; tx < ncol; tx++)
+		for (k = 0; k < th; k++)
 		{
-			equal = TRUE;
-			tw = ((tx + 1) == ncol) ? (nWidth % 16) : 16;
+			UINT32 first = band->ncol;
+			UINT32 last = 0;
+			size_t spanLength;
+			const BYTE* p1 = &band->pData1[(1ULL * y + k) * band->nStep1];
+			const BYTE* p2 = &band->pData2[(1ULL * y + k) * band->nStep2];
+
+			for (tx = 0; tx < band->ncol; tx++)
+			{
+				if (blocks[tx] != SHADOW_CAPTURE_BLOCK_COMPARE)
+					continue;
 
-			if (!tw)
-				tw = 16;
+				if (first > tx)
+					first = tx;
 
-			p1 = &pData1[(ty * 16 * nStep1) + (tx * 16 * 4)];
-			p2 = &pData2[(ty * 16 * nStep2) + (tx * 16 * 4)];
+				last = tx;
+			}
 
-			for (k = 0; k < th; k++)
+			if (first > last)
+				break;
+
+			spanLength =
+			    4ULL * (MIN((last + 1) * SHADOW_CAPTURE_BLOCK_SIZE, band->nWidth) -
+			            first * SHADOW_CAPTURE_BLOCK_SIZE);
+
+			if (memcmp(&p1[4ULL * first * SHADOW_CAPTURE_BLOCK_SIZE],
+			           &p2[4ULL * first * SHADOW_CAPTURE_BLOCK_SIZE], spanLength) == 0)
+				continue;
+
+			for (tx = first; tx <= last; tx++)
 			{
-				if (memcmp(p1, p2, tw * 4) != 0)
-				{
-					equal = FALSE;
-					break;
-				}
+				const size_t offset = 4ULL * tx * SHADOW_CAPTURE_BLOCK_SIZE;
+				const size_t length =
+				    4ULL * MIN(SHADOW_CAPTURE_BLOCK_SIZE,
+				               band->nWidth - tx * SHADOW_CAPTURE_BLOCK_SIZE);
+
+				if (blocks[tx] != SHADOW_CAPTURE_BLOCK_COMPARE)
+					continue;
 
-				p1 += nStep1;
-				p2 += nStep2;
+				if (memcmp(&p1[offset], &p2[offset], length) != 0)
+					blocks[tx] = SHADOW_CAPTURE_BLOCK_CHANGED;
 			}
+		}
+	}
+}
+
+static void CALLBACK shadow_capture_compare_band_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                               void* context, PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	shadow_capture_compare_band((SHADOW_CAPTURE_BAND*)context);
+}
+
+static UINT32 shadow_capture_band_count(UINT32 nWidth, UINT32 nHeight, UINT32 nrow)
+{
+	SYSTEM_INFO sysinfos = { 0 };
+	UINT32 count;
+
+	if (1ULL * nWidth * nHeight < SHADOW_CAPTURE_THREAD_MIN_PIXELS)
+		return 1;
+
+	GetNativeSystemInfo(&sysinfos);
+	count = MIN(sysinfos.dwNumberOfProcessors, SHADOW_CAPTURE_MAX_BANDS);
+	return MAX(MIN(count, nrow), 1);
+}
+
+static void shadow_capture_compare_bands(SHADOW_CAPTURE_BAND* base, UINT32 nrow)
+{
+	UINT32 index;
+	SHADOW_CAPTURE_BAND bands[SHADOW_CAPTURE_MAX_BANDS];
+	PTP_WORK work[SHADOW_CAPTURE_MAX_BANDS] = { 0 };
+	const UINT32 count = shadow_capture_band_count(base->nWidth, base->nHeight, nrow);
+
+	for (index = 0; index < count; index++)
+	{
+		bands[index] = *base;
+		bands[index].firstRow = nrow * index / count;
+		bands[index].lastRow = nrow * (index + 1) / count;
+
+		/* the last band is compared by this thread */
+		if (index + 1 < count)
+			work[index] = CreateThreadpoolWork(shadow_capture_compare_band_work_callback,
+			                                   &bands[index], NULL);
+
+		if (work[index])
+			SubmitThreadpoolWork(work[index]);
+		else
+			shadow_capture_compare_band(&bands[index]);
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		if (!work[index])
+			continue;
+
+		WaitForThreadpoolWorkCallbacks(work[index], FALSE);
+		CloseThreadpoolWork(work[index]);
+	}
+}
 
-			if (!equal)
-			{
-				rows[ty] = FALSE;
 #ifdef WITH_DEBUG_SHADOW_CAPTURE
-				cols[tx] = FALSE;
+static void shadow_capture_print_blocks(const BYTE* blocks, UINT32 ncol, UINT32 nrow)
+{
+	UINT32 tx, ty;
+	char* line = calloc(ncol + 1, sizeof(char));
+
+	if (!line)
+		return;
+
+	for (ty = 0; ty < nrow; ty++)
+	{
+		for (tx = 0; tx < ncol; tx++)
+			line[tx] = (blocks[ty * ncol + tx] == SHADOW_CAPTURE_BLOCK_CHANGED) ? 'X' : 'O';
+
+		WLog_INFO(TAG, "|%s|", line);
+	}
+
+	free(line);
+}
 #endif
 
-				if (l > tx)
-					l = tx;
+/**
+ * Compares two 32 bpp images in 16x16 blocks.
+ *
+ * @param hint the areas that may have changed, like XDamage or DXGI dirty rects. NULL to
+ *             compare the whole image
+ * @param region receives the changed blocks, clipped to the image
+ *
+ * @return 1 if the images differ, 0 if they are equal, -1 on failure
+ */
+int shadow_capture_compare_region(const BYTE* pData1, UINT32 nStep1, UINT32 nWidth,
+                                  UINT32 nHeight, const BYTE* pData2, UINT32 nStep2,
+                                  const REGION16* hint, REGION16* region)
+{
+	UINT32 tx, ty;
+	BOOL changed = FALSE;
+	SHADOW_CAPTURE_BAND band = { 0 };
+	const UINT32 nrow = (nHeight + SHADOW_CAPTURE_BLOCK_SIZE - 1) / SHADOW_CAPTURE_BLOCK_SIZE;
+	const UINT32 ncol = (nWidth + SHADOW_CAPTURE_BLOCK_SIZE - 1) / SHADOW_CAPTURE_BLOCK_SIZE;
+
+	WINPR_ASSERT(pData1);
+	WINPR_ASSERT(pData2);
+	WINPR_ASSERT(region);
+
+	region16_clear(region);
+
+	if ((nWidth == 0) || (nHeight == 0) || (nWidth > UINT16_MAX) || (nHeight > UINT16_MAX))
+		return 0;
+
+	band.blocks = (BYTE*)calloc(1ULL * ncol * nrow, sizeof(BYTE));
+
+	if (!band.blocks)
+		return -1;
+
+	if (!hint)
+		FillMemory(band.blocks, 1ULL * ncol * nrow, SHADOW_CAPTURE_BLOCK_COMPARE);
+	else
+	{
+		UINT32 index;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects = region16_rects(hint, &numRects);
+
+		for (index = 0; index < numRects; index++)
+		{
+			const UINT32 right = MIN(rects[index].right, nWidth);
+			const UINT32 bottom = MIN(rects[index].bottom, nHeight);
 
-				if (r < tx)
-					r = tx;
+			for (ty = rects[index].top / SHADOW_CAPTURE_BLOCK_SIZE;
+			     ty * SHADOW_CAPTURE_BLOCK_SIZE < bottom; ty++)
+			{
+				for (tx = rects[index].left / SHADOW_CAPTURE_BLOCK_SIZE;
+				     tx * SHADOW_CAPTURE_BLOCK_SIZE < right; tx++)
+					band.blocks[ty * ncol + tx] = SHADOW_CAPTURE_BLOCK_COMPARE;
 			}
 		}
+	}
+
+	band.pData1 = pData1;
+	band.nStep1 = nStep1;
+	band.pData2 = pData2;
+	band.nStep2 = nStep2;
+	band.nWidth = nWidth;
+	band.nHeight = nHeight;
+	band.ncol = ncol;
+	shadow_capture_compare_bands(&band, nrow);
 
-		if (!rows[ty])
+	/* one rectangle per run of changed blocks in a block row */
+	for (ty = 0; ty < nrow; ty++)
+	{
+		const BYTE* blocks = &band.blocks[1ULL * ty * ncol];
+
+		for (tx = 0; tx < ncol; tx++)
 		{
-			allEqual = FALSE;
+			RECTANGLE_16 rect;
+
+			if (blocks[tx] != SHADOW_CAPTURE_BLOCK_CHANGED)
+				continue;
+
+			rect.left = (UINT16)(tx * SHADOW_CAPTURE_BLOCK_SIZE);
+			rect.top = (UINT16)(ty * SHADOW_CAPTURE_BLOCK_SIZE);
 
-			if (t > ty)
-				t = ty;
+			while ((tx + 1 < ncol) && (blocks[tx + 1] == SHADOW_CAPTURE_BLOCK_CHANGED))
+				tx++;
 
-			if (b < ty)
-				b = ty;
+			rect.right = (UINT16)MIN((tx + 1) * SHADOW_CAPTURE_BLOCK_SIZE, nWidth);
+			rect.bottom = (UINT16)MIN((ty + 1) * SHADOW_CAPTURE_BLOCK_SIZE, nHeight);
+
+			if (!region16_union_rect(region, region, &rect))
+			{
+				free(band.blocks);
+				return -1;
+			}
+
+			changed = TRUE;
 		}
 	}
 
-	if (allEqual)
-		return 0;
+#ifdef WITH_DEBUG_SHADOW_CAPTURE
+	shadow_capture_print_blocks(band.blocks, ncol, nrow);
+#endif
+	free(band.blocks);
+	return changed ? 1 : 0;
+}
+
+/**
+ * Compares two 32 bpp images, rect receives the bounding box of the changed blocks.
+ *
+ * @return 1 if the images differ, 0 otherwise
+ */
+int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth, UINT32 nHeight, BYTE* pData2,
+                           UINT32 nStep2, RECTANGLE_16* rect)
+{
+	int status;
+	REGION16 region;
 
-	WINPR_ASSERT(l * 16 <= UINT16_MAX);
-	WINPR_ASSERT(t * 16 <= UINT16_MAX);
-	WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
-	WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
-	rect->left = (UINT16)l * 16;
-	rect->top = (UINT16)t * 16;
-	rect->right = (UINT16)(r + 1) * 16;
-	rect->bottom = (UINT16)(b + 1) * 16;
+	WINPR_ASSERT(rect);
+	ZeroMemory(rect, sizeof(RECTANGLE_16));
+	region16_init(&region);
+	status = shadow_capture_compare_region(pData1, nStep1, nWidth, nHeight, pData2, nStep2, NULL,
+	                                       &region);
 
-	WINPR_ASSERT(nWidth <= UINT16_MAX);
-	if (rect->right > nWidth)
-		rect->right = (UINT16)nWidth;
+	if (status > 0)
+		*rect = *region16_extents(&region);
 
-	WINPR_ASSERT(nHeight <= UINT16_MAX);
-	if (rect->bottom > nHeight)
-		rect->bottom = (UINT16)nHeight;
+	region16_uninit(&region);
+	return (status > 0) ? 1 : 0;
+}
 
-#ifdef WITH_DEBUG_SHADOW_CAPTURE
-	size_t size = ncol + 1;
-	char* col_str = calloc(size, sizeof(char));
+#define SHADOW_SCROLL_HASH_BASIS 0xCBF29CE484222325ULL
+#define SHADOW_SCROLL_HASH_PRIME 0x100000001B3ULL
+#define SHADOW_SCROLL_MIN_LINES 16
+#define SHADOW_SCROLL_SAMPLES 16
+#define SHADOW_SCROLL_CANDIDATES 32
 
-	if (!col_str)
+static void shadow_capture_hash_lines(const BYTE* pData, UINT32 nStep, const RECTANGLE_16* rect,
+                                      UINT64* rows, UINT64* cols)
+{
+	UINT32 x, y;
+	const UINT32 width = rect->right - rect->left;
+	const UINT32 height = rect->bottom - rect->top;
+
+	for (x = 0; x < width; x++)
+		cols[x] = SHADOW_SCROLL_HASH_BASIS;
+
+	/* row major, the column hashes are updated along the way */
+	for (y = 0; y < height; y++)
 	{
-		WLog_ERR(TAG, "calloc failed!");
-		return 1;
+		UINT64 hash = SHADOW_SCROLL_HASH_BASIS;
+		const UINT32* pixel =
+		    (const UINT32*)&pData[(1ULL * rect->top + y) * nStep + rect->left * 4ULL];
+
+		for (x = 0; x < width; x++)
+		{
+			hash = (hash ^ pixel[x]) * SHADOW_SCROLL_HASH_PRIME;
+			cols[x] = (cols[x] ^ pixel[x]) * SHADOW_SCROLL_HASH_PRIME;
+		}
+
+		rows[y] = hash;
 	}
+}
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "-");
+/**
+ * Lines that changed and differ from their neighbours vote for the offsets they might have been
+ * moved by. The offset whose longest run of matching lines repairs the most changed lines wins.
+ */
+static INT32 shadow_capture_find_offset(const UINT64* cur, const UINT64* prev, INT32 count,
+                                        INT32* pOffset, INT32* pFirst, INT32* pLength)
+{
+	INT32 i, y;
+	INT32 candidates[SHADOW_SCROLL_CANDIDATES];
+	UINT32 numCandidates = 0;
+	INT32 bestGain = 0;
+	const INT32 interval = MAX(count / SHADOW_SCROLL_SAMPLES, 1);
 
-	WLog_INFO(TAG, "%s", col_str);
+	for (y = 0; (y < count) && (numCandidates < ARRAYSIZE(candidates)); y += interval)
+	{
+		if (cur[y] == prev[y])
+			continue;
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "%c", cols[tx] ? 'O' : 'X');
+		if (((y > 0) && (cur[y] == cur[y - 1])) || ((y + 1 < count) && (cur[y] == cur[y + 1])))
+			continue;
 
-	WLog_INFO(TAG, "%s", col_str);
+		for (i = 0; (i < count) && (numCandidates < ARRAYSIZE(candidates)); i++)
+		{
+			UINT32 k;
 
-	for (tx = 0; tx < ncol; tx++)
-		sprintf_s(&col_str[tx], size - tx, "-");
+			if (prev[i] != cur[y])
+				continue;
 
-	WLog_INFO(TAG, "%s", col_str);
+			for (k = 0; k < numCandidates; k++)
+			{
+				if (candidates[k] == y - i)
+					break;
+			}
 
-	for (ty = 0; ty < nrow; ty++)
+			if (k == numCandidates)
+				candidates[numCandidates++] = y - i;
+		}
+	}
+
+	for (i = 0; i < (INT32)numCandidates; i++)
 	{
-		for (tx = 0; tx < ncol; tx++)
-			sprintf_s(&col_str[tx], size - tx, "%c", cols[tx] ? 'O' : 'X');
+		const INT32 offset = candidates[i];
+		const INT32 start = (offset > 0) ? offset : 0;
+		const INT32 end = (offset > 0) ? count : count + offset;
+		INT32 run = 0;
+		INT32 gain = 0;
+
+		for (y = start; y <= end; y++)
+		{
+			if ((y < end) && (cur[y] == prev[y - offset]))
+			{
+				run++;
+
+				if (cur[y] != prev[y])
+					gain++;
+
+				continue;
+			}
 
-		WLog_INFO(TAG, "%s", col_str);
-		WLog_INFO(TAG, "|%s|", rows[ty] ? "O" : "X");
+			if ((run >= SHADOW_SCROLL_MIN_LINES) && (gain > bestGain))
+			{
+				bestGain = gain;
+				*pOffset = offset;
+				*pFirst = y - run;
+				*pLength = run;
+			}
+
+			run = 0;
+			gain = 0;
+		}
 	}
 
-	WLog_INFO(TAG, "left: %d top: %d right: %d bottom: %d ncol: %d nrow: %d", l, t, r, b, ncol,
-	          nrow);
-	free(col_str);
-#endif
-	return 1;
+	return (bestGain >= SHADOW_SCROLL_MIN_LINES) ? bestGain : 0;
+}
+
+/**
+ * Search the part of rect in the previous frame pData2 that was moved vertically or
+ * horizontally in the new frame pData1, like scrolled content.
+ *
+ * @return TRUE if src moved by dx, dy is found
+ */
+BOOL shadow_capture_find_scroll(const BYTE* pData1, UINT32 nStep1, const BYTE* pData2,
+                                UINT32 nStep2, const RECTANGLE_16* rect, RECTANGLE_16* src,
+                                INT32* dx, INT32* dy)
+{
+	INT32 rowGain, colGain;
+	INT32 rowOffset = 0, rowFirst = 0, rowLength = 0;
+	INT32 colOffset = 0, colFirst = 0, colLength = 0;
+	UINT64* hashes;
+	const INT32 width = rect->right - rect->left;
+	const INT32 height = rect->bottom - rect->top;
+
+	WINPR_ASSERT(pData1);
+	WINPR_ASSERT(pData2);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(dx);
+	WINPR_ASSERT(dy);
+
+	if ((width < SHADOW_SCROLL_MIN_LINES) || (height < SHADOW_SCROLL_MIN_LINES))
+		return FALSE;
+
+	hashes = (UINT64*)calloc(2ULL * (width + height), sizeof(UINT64));
+
+	if (!hashes)
+		return FALSE;
+
+	shadow_capture_hash_lines(pData1, nStep1, rect, hashes, &hashes[height]);
+	shadow_capture_hash_lines(pData2, nStep2, rect, &hashes[height + width],
+	                          &hashes[2 * height + width]);
+	rowGain = shadow_capture_find_offset(hashes, &hashes[height + width], height, &rowOffset,
+	                                     &rowFirst, &rowLength);
+	colGain = shadow_capture_find_offset(&hashes[height], &hashes[2 * height + width], width,
+	                                     &colOffset, &colFirst, &colLength);
+	free(hashes);
+
+	if ((rowGain == 0) && (colGain == 0))
+		return FALSE;
+
+	/* compare the repaired area, a row is as wide as the rectangle */
+	if (1LL * rowGain * width >= 1LL * colGain * height)
+	{
+		src->left = rect->left;
+		src->right = rect->right;
+		src->top = (UINT16)(rect->top + rowFirst - rowOffset);
+		src->bottom = (UINT16)(src->top + rowLength);
+		*dx = 0;
+		*dy = rowOffset;
+	}
+	else
+	{
+		src->left = (UINT16)(rect->left + colFirst - colOffset);
+		src->right = (UINT16)(src->left + colLength);
+		src->top = rect->top;
+		src->bottom = rect->bottom;
+		*dx = colOffset;
+		*dy = 0;
+	}
+
+	return TRUE;
 }
 
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
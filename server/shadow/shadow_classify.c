@@ -0,0 +1,329 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+
+#include <freerdp/log.h>
+
+#include "shadow.h"
+
+#include "shadow_classify.h"
+
+#define TAG SERVER_TAG("shadow")
+
+/**
+ * Content classification of the 64x64 tiles of a frame for mixed codec graphics pipeline output.
+ *
+ * A tile that changed in several of the last frames and shows natural content, many colours
+ * and few sharp edges, is video and sent with H.264. Everything else is text or user interface
+ * and sent with a lossless codec. Tiles the client last got from H.264 are sent again losslessly
+ * once they stop changing.
+ */
+
+#define SHADOW_CLASSIFY_TILE_SIZE 64
+#define SHADOW_CLASSIFY_MIN_CHANGES 3   /* changed frames out of the last 8 for video */
+#define SHADOW_CLASSIFY_QUIET_MASK 0x03 /* frames without changes before a lossless refresh */
+#define SHADOW_CLASSIFY_MAX_COLORS 64   /* distinct sampled colours of text and UI tiles */
+#define SHADOW_CLASSIFY_MAX_EDGES 10    /* percent of samples on sharp edges of video tiles */
+#define SHADOW_CLASSIFY_EDGE_DELTA 64   /* luma step of a sharp edge */
+#define SHADOW_CLASSIFY_COLOR_BUCKETS 256
+
+typedef struct
+{
+	BYTE history; /* one bit per frame, set if the tile changed */
+	BOOL lossy;   /* the client shows H.264 output for the tile */
+} SHADOW_CLASSIFY_TILE;
+
+struct s_shadow_classifier
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 gridWidth;
+	UINT32 gridHeight;
+	SHADOW_CLASSIFY_TILE* tiles;
+};
+
+static SHADOW_CLASSIFIER* shadow_classify_get(rdpShadowEncoder* encoder, UINT32 width,
+                                              UINT32 height)
+{
+	SHADOW_CLASSIFIER* classifier;
+
+	WINPR_ASSERT(encoder);
+
+	if (!encoder->classifier)
+	{
+		encoder->classifier = (SHADOW_CLASSIFIER*)calloc(1, sizeof(SHADOW_CLASSIFIER));
+
+		if (!encoder->classifier)
+			return NULL;
+	}
+
+	classifier = encoder->classifier;
+
+	if ((classifier->width != width) || (classifier->height != height) || !classifier->tiles)
+	{
+		const UINT32 gridWidth =
+		    (width + SHADOW_CLASSIFY_TILE_SIZE - 1) / SHADOW_CLASSIFY_TILE_SIZE;
+		const UINT32 gridHeight =
+		    (height + SHADOW_CLASSIFY_TILE_SIZE - 1) / SHADOW_CLASSIFY_TILE_SIZE;
+
+		free(classifier->tiles);
+		classifier->tiles = (SHADOW_CLASSIFY_TILE*)calloc(1ull * gridWidth * gridHeight,
+		                                                   sizeof(SHADOW_CLASSIFY_TILE));
+		classifier->width = width;
+		classifier->height = height;
+		classifier->gridWidth = gridWidth;
+		classifier->gridHeight = gridHeight;
+
+		if (!classifier->tiles)
+		{
+			classifier->width = 0;
+			classifier->height = 0;
+			return NULL;
+		}
+	}
+
+	return classifier;
+}
+
+static RECTANGLE_16 shadow_classify_tile_rect(const SHADOW_CLASSIFIER* classifier, UINT32 tx,
+                                              UINT32 ty)
+{
+	RECTANGLE_16 rect;
+
+	rect.left = (UINT16)(tx * SHADOW_CLASSIFY_TILE_SIZE);
+	rect.top = (UINT16)(ty * SHADOW_CLASSIFY_TILE_SIZE);
+	rect.right = (UINT16)MIN((tx + 1) * SHADOW_CLASSIFY_TILE_SIZE, classifier->width);
+	rect.bottom = (UINT16)MIN((ty + 1) * SHADOW_CLASSIFY_TILE_SIZE, classifier->height);
+	return rect;
+}
+
+static UINT32 shadow_classify_changes(BYTE history)
+{
+	UINT32 count = 0;
+
+	for (; history; history &= (BYTE)(history - 1))
+		count++;
+
+	return count;
+}
+
+/**
+ * Natural content, photos and video, has many colours and only few sharp edges. Every second
+ * pixel of every second row is sampled.
+ */
+static BOOL shadow_classify_natural(const BYTE* pSrcData, UINT32 nSrcStep,
+                                    const RECTANGLE_16* rect)
+{
+	UINT32 x, y;
+	UINT32 colors = 0;
+	UINT32 samples = 0;
+	UINT32 edges = 0;
+	UINT32 table[SHADOW_CLASSIFY_COLOR_BUCKETS] = { 0 };
+
+	for (y = rect->top; y < rect->bottom; y += 2)
+	{
+		const BYTE* line = &pSrcData[1ull * y * nSrcStep];
+		INT32 lastLuma = -1;
+
+		for (x = rect->left; x < rect->right; x += 2)
+		{
+			const BYTE* pixel = &line[4ull * x];
+			const UINT32 color = pixel[0] | ((UINT32)pixel[1] << 8) | ((UINT32)pixel[2] << 16);
+			const INT32 luma = (pixel[0] + pixel[1] * 5 + pixel[2] * 2) >> 3;
+
+			if ((lastLuma >= 0) && (abs(luma - lastLuma) > SHADOW_CLASSIFY_EDGE_DELTA))
+				edges++;
+
+			lastLuma = luma;
+			samples++;
+
+			if (colors <= SHADOW_CLASSIFY_MAX_COLORS)
+			{
+				UINT32 bucket = (color * 2654435761u) >> 24;
+
+				/* entries hold the colour + 1, 0 marks a free bucket */
+				while (table[bucket] && (table[bucket] != color + 1))
+					bucket = (bucket + 1) & (SHADOW_CLASSIFY_COLOR_BUCKETS - 1);
+
+				if (!table[bucket])
+				{
+					table[bucket] = color + 1;
+					colors++;
+				}
+			}
+		}
+	}
+
+	if (colors <= SHADOW_CLASSIFY_MAX_COLORS)
+		return FALSE;
+
+	return (edges * 100) < (samples * SHADOW_CLASSIFY_MAX_EDGES);
+}
+
+/**
+ * Function description
+ *
+ * Splits the changed tiles of a frame into the ones sent with H.264, videoRegion, and the ones
+ * sent losslessly, textRegion. textRegion also gets the tiles that need a lossless refresh.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_classify_region(rdpShadowEncoder* encoder, const BYTE* pSrcData, UINT32 nSrcStep,
+                            UINT32 width, UINT32 height, const REGION16* invalidRegion,
+                            REGION16* videoRegion, REGION16* textRegion)
+{
+	UINT32 tx, ty;
+	BOOL rc = TRUE;
+	SHADOW_CLASSIFIER* classifier;
+	REGION16 tileRegion;
+
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(invalidRegion);
+	WINPR_ASSERT(videoRegion);
+	WINPR_ASSERT(textRegion);
+
+	classifier = shadow_classify_get(encoder, width, height);
+
+	if (!classifier)
+		return FALSE;
+
+	region16_init(&tileRegion);
+
+	for (ty = 0; rc && (ty < classifier->gridHeight); ty++)
+	{
+		for (tx = 0; rc && (tx < classifier->gridWidth); tx++)
+		{
+			SHADOW_CLASSIFY_TILE* tile = &classifier->tiles[ty * classifier->gridWidth + tx];
+			const RECTANGLE_16 rect = shadow_classify_tile_rect(classifier, tx, ty);
+			const BOOL changed = region16_intersects_rect(invalidRegion, &rect);
+
+			tile->history = (BYTE)((tile->history << 1) | (changed ? 1 : 0));
+
+			if (changed)
+			{
+				if ((shadow_classify_changes(tile->history) >= SHADOW_CLASSIFY_MIN_CHANGES) &&
+				    shadow_classify_natural(pSrcData, nSrcStep, &rect))
+				{
+					tile->lossy = TRUE;
+					rc = region16_union_rect(videoRegion, videoRegion, &rect);
+				}
+				else
+				{
+					UINT32 index;
+					UINT32 numRects = 0;
+					const RECTANGLE_16* rects;
+
+					tile->lossy = FALSE;
+					rc = region16_intersect_rect(&tileRegion, invalidRegion, &rect);
+					rects = region16_rects(&tileRegion, &numRects);
+
+					for (index = 0; rc && (index < numRects); index++)
+						rc = region16_union_rect(textRegion, textRegion, &rects[index]);
+				}
+			}
+			else if (tile->lossy && !(tile->history & SHADOW_CLASSIFY_QUIET_MASK))
+			{
+				tile->lossy = FALSE;
+				rc = region16_union_rect(textRegion, textRegion, &rect);
+			}
+		}
+	}
+
+	region16_uninit(&tileRegion);
+	return rc;
+}
+
+/**
+ * H.264 encodes the bounding box of videoRegion, the client only shows the parts listed in the
+ * metablock. Parts outside of videoRegion are dropped, tiles that are shown anyway because a
+ * listed rectangle covers them are refreshed losslessly later.
+ */
+void shadow_classify_filter_meta(rdpShadowEncoder* encoder, const REGION16* videoRegion,
+                                 RDPGFX_H264_METABLOCK* meta)
+{
+	UINT32 index;
+	UINT32 count = 0;
+	SHADOW_CLASSIFIER* classifier;
+
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(videoRegion);
+	WINPR_ASSERT(meta);
+
+	classifier = encoder->classifier;
+
+	if (!classifier || !classifier->tiles)
+		return;
+
+	for (index = 0; index < meta->numRegionRects; index++)
+	{
+		UINT32 tx, ty;
+		const RECTANGLE_16* rect = &meta->regionRects[index];
+
+		if (!region16_intersects_rect(videoRegion, rect))
+			continue;
+
+		for (ty = rect->top / SHADOW_CLASSIFY_TILE_SIZE;
+		     (ty < classifier->gridHeight) && (ty * SHADOW_CLASSIFY_TILE_SIZE < rect->bottom);
+		     ty++)
+		{
+			for (tx = rect->left / SHADOW_CLASSIFY_TILE_SIZE;
+			     (tx < classifier->gridWidth) && (tx * SHADOW_CLASSIFY_TILE_SIZE < rect->right);
+			     tx++)
+			{
+				SHADOW_CLASSIFY_TILE* tile = &classifier->tiles[ty * classifier->gridWidth + tx];
+
+				/* tiles sent losslessly in this frame are drawn after the H.264 output */
+				if (!(tile->history & 1))
+					tile->lossy = TRUE;
+			}
+		}
+
+		meta->regionRects[count] = meta->regionRects[index];
+		meta->quantQualityVals[count] = meta->quantQualityVals[index];
+		count++;
+	}
+
+	meta->numRegionRects = count;
+}
+
+/**
+ * Forgets the tile history, a new surface starts without content.
+ */
+void shadow_classify_reset(rdpShadowEncoder* encoder)
+{
+	SHADOW_CLASSIFIER* classifier;
+
+	WINPR_ASSERT(encoder);
+
+	classifier = encoder->classifier;
+
+	if (classifier && classifier->tiles)
+		ZeroMemory(classifier->tiles, 1ull * classifier->gridWidth * classifier->gridHeight *
+		                                  sizeof(SHADOW_CLASSIFY_TILE));
+}
+
+void shadow_classifier_free(SHADOW_CLASSIFIER* classifier)
+{
+	if (!classifier)
+		return;
+
+	free(classifier->tiles);
+	free(classifier);
+}
@@ -0,0 +1,48 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_CLASSIFY_H
+#define FREERDP_SERVER_SHADOW_CLASSIFY_H
+
+#include <winpr/crt.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/channels/rdpgfx.h>
+
+#include <freerdp/server/shadow.h>
+
+typedef struct s_shadow_classifier SHADOW_CLASSIFIER;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	BOOL shadow_classify_region(rdpShadowEncoder* encoder, const BYTE* pSrcData, UINT32 nSrcStep,
+	                            UINT32 width, UINT32 height, const REGION16* invalidRegion,
+	                            REGION16* videoRegion, REGION16* textRegion);
+	void shadow_classify_filter_meta(rdpShadowEncoder* encoder, const REGION16* videoRegion,
+	                                 RDPGFX_H264_METABLOCK* meta);
+	void shadow_classify_reset(rdpShadowEncoder* encoder);
+
+	void shadow_classifier_free(SHADOW_CLASSIFIER* classifier);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_CLASSIFY_H */
@@ -27,10 +27,12 @@
 #include <winpr/synch.h>
 #include <winpr/thread.h>
 #include <winpr/sysinfo.h>
+#include <winpr/pool.h>
 #include <winpr/interlocked.h>
 
 #include <freerdp/log.h>
 #include <freerdp/channels/drdynvc.h>
+#include <freerdp/utils/trace.h>
 
 #include "shadow.h"
 
@@ -42,44 +44,169 @@ typedef struct
 	BOOL gfxSurfaceCreated;
 } SHADOW_GFX_STATUS;
 
-static INLINE BOOL shadow_client_rdpgfx_new_surface(rdpShadowClient* client)
+/* Continuous network autodetect, probing once the client is activated */
+#define SHADOW_RTT_INTERVAL_MS 1000
+#define SHADOW_BANDWIDTH_INTERVAL_MS 10000
+#define SHADOW_BANDWIDTH_WINDOW_MS 1000
+#define SHADOW_NETDETECT_TICK_MS 250
+
+typedef struct
 {
-	UINT error = CHANNEL_RC_OK;
-	RDPGFX_CREATE_SURFACE_PDU createSurface;
-	RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU surfaceToOutput;
-	RdpgfxServerContext* context;
+	UINT16 sequenceNumber;
+	UINT64 nextRtt;
+	UINT64 nextBandwidth;
+	UINT64 bandwidthStop;
+} SHADOW_NETDETECT_STATUS;
+
+static void shadow_client_gfx_outputs_free(rdpShadowClient* client)
+{
+	UINT32 index;
+
+	WINPR_ASSERT(client);
+
+	for (index = 0; index < client->numOutputs; index++)
+	{
+		SHADOW_GFX_OUTPUT* output = &client->outputs[index];
+
+		if (output->encoder != client->encoder)
+			shadow_encoder_free(output->encoder);
+	}
+
+	ZeroMemory(client->outputs, sizeof(client->outputs));
+	client->numOutputs = 0;
+}
+
+static BOOL shadow_client_gfx_outputs_overlap(const rdpShadowClient* client)
+{
+	UINT32 i, j;
+
+	for (i = 0; i < client->numOutputs; i++)
+	{
+		for (j = i + 1; j < client->numOutputs; j++)
+		{
+			if (rectangles_intersects(&client->outputs[i].rect, &client->outputs[j].rect))
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * Splits the desktop into one output per monitor when all monitors are shared. Every output has
+ * its own surface and encoder, a single output covering the complete desktop is used otherwise.
+ */
+static BOOL shadow_client_gfx_outputs_init(rdpShadowClient* client)
+{
+	UINT32 index;
 	rdpSettings* settings;
+	rdpShadowServer* server;
+	rdpShadowSurface* surface;
+	rdpShadowSubsystem* subsystem;
+	RECTANGLE_16 desktop = { 0 };
 
 	WINPR_ASSERT(client);
-	context = client->rdpgfx;
-	WINPR_ASSERT(context);
-	settings = ((rdpContext*)client)->settings;
+	settings = client->context.settings;
 	WINPR_ASSERT(settings);
+	server = client->server;
+	WINPR_ASSERT(server);
+	subsystem = client->subsystem;
+	WINPR_ASSERT(subsystem);
+
+	shadow_client_gfx_outputs_free(client);
 
 	WINPR_ASSERT(settings->DesktopWidth <= UINT16_MAX);
 	WINPR_ASSERT(settings->DesktopHeight <= UINT16_MAX);
-	createSurface.width = (UINT16)settings->DesktopWidth;
-	createSurface.height = (UINT16)settings->DesktopHeight;
-	createSurface.pixelFormat = GFX_PIXEL_FORMAT_XRGB_8888;
-	createSurface.surfaceId = client->surfaceId;
-	surfaceToOutput.outputOriginX = 0;
-	surfaceToOutput.outputOriginY = 0;
-	surfaceToOutput.surfaceId = client->surfaceId;
-	surfaceToOutput.reserved = 0;
-	IFCALLRET(context->CreateSurface, error, context, &createSurface);
+	desktop.right = (UINT16)settings->DesktopWidth;
+	desktop.bottom = (UINT16)settings->DesktopHeight;
+	surface = client->inLobby ? server->lobby : server->surface;
 
-	if (error)
+	if (server->spanMonitors && !server->shareSubRect && surface && (subsystem->numMonitors > 1))
 	{
-		WLog_ERR(TAG, "CreateSurface failed with error %" PRIu32 "", error);
-		return FALSE;
+		for (index = 0; index < (UINT32)subsystem->numMonitors; index++)
+		{
+			RECTANGLE_16 rect;
+			SHADOW_GFX_OUTPUT* output;
+			const MONITOR_DEF* monitor = &subsystem->monitors[index];
+			const INT64 left = MAX(0, (INT64)monitor->left - surface->x);
+			const INT64 top = MAX(0, (INT64)monitor->top - surface->y);
+			const INT64 right = MIN(desktop.right, (INT64)monitor->right + 1 - surface->x);
+			const INT64 bottom = MIN(desktop.bottom, (INT64)monitor->bottom + 1 - surface->y);
+
+			if ((left >= right) || (top >= bottom) ||
+			    (client->numOutputs >= SHADOW_MAX_GFX_OUTPUTS))
+				continue;
+
+			rect.left = (UINT16)left;
+			rect.top = (UINT16)top;
+			rect.right = (UINT16)right;
+			rect.bottom = (UINT16)bottom;
+			output = &client->outputs[client->numOutputs];
+			output->rect = rect;
+			output->surfaceId = (UINT16)(client->surfaceId + client->numOutputs++);
+			output->encoder = shadow_encoder_new_output(client, rect.right - rect.left,
+			                                            rect.bottom - rect.top);
+
+			if (!output->encoder)
+			{
+				shadow_client_gfx_outputs_free(client);
+				return FALSE;
+			}
+		}
+
+		if ((client->numOutputs > 1) && !shadow_client_gfx_outputs_overlap(client))
+			return TRUE;
+
+		WLog_INFO(TAG, "monitor layout not usable for separate surfaces, sharing one surface");
+		shadow_client_gfx_outputs_free(client);
 	}
 
-	IFCALLRET(context->MapSurfaceToOutput, error, context, &surfaceToOutput);
+	client->numOutputs = 1;
+	client->outputs[0].surfaceId = client->surfaceId;
+	client->outputs[0].rect = desktop;
+	client->outputs[0].encoder = client->encoder;
+	return TRUE;
+}
 
-	if (error)
+static INLINE BOOL shadow_client_rdpgfx_new_surface(rdpShadowClient* client)
+{
+	UINT32 index;
+	UINT error = CHANNEL_RC_OK;
+	RdpgfxServerContext* context;
+
+	WINPR_ASSERT(client);
+	context = client->rdpgfx;
+	WINPR_ASSERT(context);
+
+	for (index = 0; index < client->numOutputs; index++)
 	{
-		WLog_ERR(TAG, "MapSurfaceToOutput failed with error %" PRIu32 "", error);
-		return FALSE;
+		RDPGFX_CREATE_SURFACE_PDU createSurface;
+		RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU surfaceToOutput;
+		const SHADOW_GFX_OUTPUT* output = &client->outputs[index];
+
+		createSurface.width = output->rect.right - output->rect.left;
+		createSurface.height = output->rect.bottom - output->rect.top;
+		createSurface.pixelFormat = GFX_PIXEL_FORMAT_XRGB_8888;
+		createSurface.surfaceId = output->surfaceId;
+		surfaceToOutput.outputOriginX = output->rect.left;
+		surfaceToOutput.outputOriginY = output->rect.top;
+		surfaceToOutput.surfaceId = output->surfaceId;
+		surfaceToOutput.reserved = 0;
+		IFCALLRET(context->CreateSurface, error, context, &createSurface);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "CreateSurface failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+
+		IFCALLRET(context->MapSurfaceToOutput, error, context, &surfaceToOutput);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "MapSurfaceToOutput failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
 	}
 
 	return TRUE;
@@ -87,8 +214,9 @@ static INLINE BOOL shadow_client_rdpgfx_new_surface(rdpShadowClient* client)
 
 static INLINE BOOL shadow_client_rdpgfx_release_surface(rdpShadowClient* client)
 {
+	BOOL rc = TRUE;
+	UINT32 index;
 	UINT error = CHANNEL_RC_OK;
-	RDPGFX_DELETE_SURFACE_PDU pdu;
 	RdpgfxServerContext* context;
 
 	WINPR_ASSERT(client);
@@ -96,22 +224,30 @@ static INLINE BOOL shadow_client_rdpgfx_release_surface(rdpShadowClient* client)
 	context = client->rdpgfx;
 	WINPR_ASSERT(context);
 
-	pdu.surfaceId = client->surfaceId++;
-	IFCALLRET(context->DeleteSurface, error, context, &pdu);
-
-	if (error)
+	for (index = 0; index < client->numOutputs; index++)
 	{
-		WLog_ERR(TAG, "DeleteSurface failed with error %" PRIu32 "", error);
-		return FALSE;
+		RDPGFX_DELETE_SURFACE_PDU pdu;
+
+		pdu.surfaceId = client->outputs[index].surfaceId;
+		IFCALLRET(context->DeleteSurface, error, context, &pdu);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "DeleteSurface failed with error %" PRIu32 "", error);
+			rc = FALSE;
+		}
 	}
 
-	return TRUE;
+	client->surfaceId += (UINT16)MAX(1, client->numOutputs);
+	shadow_client_gfx_outputs_free(client);
+	return rc;
 }
 
 static INLINE BOOL shadow_client_rdpgfx_reset_graphic(rdpShadowClient* client)
 {
 	UINT error = CHANNEL_RC_OK;
 	RDPGFX_RESET_GRAPHICS_PDU pdu = { 0 };
+	MONITOR_DEF monitors[SHADOW_MAX_GFX_OUTPUTS] = { 0 };
 	RdpgfxServerContext* context;
 	rdpSettings* settings;
 
@@ -124,10 +260,35 @@ static INLINE BOOL shadow_client_rdpgfx_reset_graphic(rdpShadowClient* client)
 	settings = client->context.settings;
 	WINPR_ASSERT(settings);
 
+	if (!shadow_client_gfx_outputs_init(client))
+		return FALSE;
+
 	pdu.width = settings->DesktopWidth;
 	pdu.height = settings->DesktopHeight;
 	pdu.monitorCount = client->subsystem->numMonitors;
 	pdu.monitorDefArray = client->subsystem->monitors;
+
+	/* the monitors of the client match the outputs, relative to the shared desktop */
+	if (client->numOutputs > 1)
+	{
+		UINT32 index;
+
+		for (index = 0; index < client->numOutputs; index++)
+		{
+			const RECTANGLE_16* rect = &client->outputs[index].rect;
+			MONITOR_DEF* monitor = &monitors[index];
+
+			monitor->left = rect->left;
+			monitor->top = rect->top;
+			monitor->right = rect->right - 1;
+			monitor->bottom = rect->bottom - 1;
+			monitor->flags = (index == 0) ? MONITOR_PRIMARY : 0;
+		}
+
+		pdu.monitorCount = client->numOutputs;
+		pdu.monitorDefArray = monitors;
+	}
+
 	IFCALLRET(context->ResetGraphics, error, context, &pdu);
 
 	if (error)
@@ -193,6 +354,14 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	settings->DrawAllowDynamicColorFidelity = TRUE;
 	settings->CompressionLevel = PACKET_COMPR_TYPE_RDP6;
 
+	if (!freerdp_settings_set_uint32(
+	        settings, FreeRDP_MaxConcurrentHandshakes,
+	        freerdp_settings_get_uint32(srvSettings, FreeRDP_MaxConcurrentHandshakes)) ||
+	    !freerdp_settings_set_uint32(
+	        settings, FreeRDP_HandshakeQueueTimeout,
+	        freerdp_settings_get_uint32(srvSettings, FreeRDP_HandshakeQueueTimeout)))
+		goto fail_cert_file;
+
 	if (!freerdp_settings_set_string(settings, FreeRDP_CertificateFile, server->CertificateFile))
 		goto fail_cert_file;
 
@@ -215,6 +384,12 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	if (!InitializeCriticalSectionAndSpinCount(&(client->lock), 4000))
 		goto fail_client_lock;
 
+	if (!InitializeCriticalSectionAndSpinCount(&(client->encodeLock), 4000))
+	{
+		DeleteCriticalSection(&(client->lock));
+		goto fail_client_lock;
+	}
+
 	region16_init(&(client->invalidRegion));
 	client->vcm = WTSOpenServerA((LPSTR)peer->context);
 
@@ -239,6 +414,7 @@ fail_message_queue:
 	WTSCloseServer((HANDLE)client->vcm);
 	client->vcm = NULL;
 fail_open_server:
+	DeleteCriticalSection(&(client->encodeLock));
 	DeleteCriticalSection(&(client->lock));
 fail_client_lock:
 	freerdp_settings_set_string(settings, FreeRDP_RdpKeyFile, NULL);
@@ -262,6 +438,7 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 
 	WINPR_ASSERT(server->clients);
 	ArrayList_Remove(server->clients, (void*)client);
+	shadow_client_gfx_outputs_free(client);
 
 	if (client->encoder)
 	{
@@ -276,6 +453,7 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 	WTSCloseServer((HANDLE)client->vcm);
 	client->vcm = NULL;
 	region16_uninit(&(client->invalidRegion));
+	DeleteCriticalSection(&(client->encodeLock));
 	DeleteCriticalSection(&(client->lock));
 }
 
@@ -556,7 +734,23 @@ static BOOL shadow_client_suppress_output(rdpContext* context, BYTE allow, const
 
 	client->suppressOutput = allow ? FALSE : TRUE;
 
-	if (allow)
+	if (!allow)
+	{
+		UINT32 index;
+
+		/* the encode thread may be in the middle of a frame with these contexts */
+		EnterCriticalSection(&(client->encodeLock));
+		shadow_encoder_release(client->encoder);
+
+		for (index = 0; index < client->numOutputs; index++)
+		{
+			if (client->outputs[index].encoder != client->encoder)
+				shadow_encoder_release(client->outputs[index].encoder);
+		}
+
+		LeaveCriticalSection(&(client->encodeLock));
+	}
+	else
 	{
 		if (area)
 		{
@@ -585,15 +779,19 @@ static BOOL shadow_client_activate(freerdp_peer* peer)
 	client = (rdpShadowClient*)peer->context;
 	WINPR_ASSERT(client);
 
+	EnterCriticalSection(&(client->encodeLock));
 	client->activated = TRUE;
 	client->inLobby = client->mayView ? FALSE : TRUE;
 
 	if (shadow_encoder_reset(client->encoder) < 0)
 	{
+		LeaveCriticalSection(&(client->encodeLock));
 		WLog_ERR(TAG, "Failed to reset encoder");
 		return FALSE;
 	}
 
+	LeaveCriticalSection(&(client->encodeLock));
+
 	/* Update full screen in next update */
 	return shadow_client_refresh_rect(&client->context, 0, NULL);
 }
@@ -691,31 +889,21 @@ static BOOL shadow_client_logon(freerdp_peer* peer, const SEC_WINNT_AUTH_IDENTIT
 	return TRUE;
 }
 
-static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* client, UINT32 frameId)
+static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* client, UINT32 frameId,
+                                                          UINT32 queueDepth)
 {
-	/*
-	 * Record the last client acknowledged frame id to
-	 * calculate how much frames are in progress.
-	 * Some rdp clients (win7 mstsc) skips frame ACK if it is
-	 * inactive, we should not expect ACK for each frame.
-	 * So it is OK to calculate inflight frame count according to
-	 * a latest acknowledged frame id.
-	 */
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->encoder);
-	client->encoder->lastAckframeId = frameId;
+	shadow_encoder_frame_acknowledged(client->encoder, frameId, queueDepth);
 }
 
 static BOOL shadow_client_surface_frame_acknowledge(rdpContext* context, UINT32 frameId)
 {
 	rdpShadowClient* client = (rdpShadowClient*)context;
-	shadow_client_common_frame_acknowledge(client, frameId);
 	/*
 	 * Reset queueDepth for legacy none RDPGFX acknowledge
 	 */
-	WINPR_ASSERT(client);
-	WINPR_ASSERT(client->encoder);
-	client->encoder->queueDepth = QUEUE_DEPTH_UNAVAILABLE;
+	shadow_client_common_frame_acknowledge(client, frameId, QUEUE_DEPTH_UNAVAILABLE);
 	return TRUE;
 }
 
@@ -729,14 +917,22 @@ shadow_client_rdpgfx_frame_acknowledge(RdpgfxServerContext* context,
 	WINPR_ASSERT(frameAcknowledge);
 
 	client = (rdpShadowClient*)context->custom;
-	shadow_client_common_frame_acknowledge(client, frameAcknowledge->frameId);
-
-	WINPR_ASSERT(client);
-	WINPR_ASSERT(client->encoder);
-	client->encoder->queueDepth = frameAcknowledge->queueDepth;
+	shadow_client_common_frame_acknowledge(client, frameAcknowledge->frameId,
+	                                       frameAcknowledge->queueDepth);
+	metrics_frame_acknowledged(client->context.metrics, frameAcknowledge->frameId);
 	return CHANNEL_RC_OK;
 }
 
+static UINT
+shadow_client_rdpgfx_cache_import_offer(RdpgfxServerContext* context,
+                                        const RDPGFX_CACHE_IMPORT_OFFER_PDU* cacheImportOffer)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(cacheImportOffer);
+
+	return shadow_gfxcache_import_offer((rdpShadowClient*)context->custom, cacheImportOffer);
+}
+
 static BOOL shadow_are_caps_filtered(const rdpSettings* settings, UINT32 caps)
 {
 	UINT32 filter;
@@ -790,6 +986,7 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 		{
 			UINT32 flags;
 			BOOL planar = FALSE;
+			BOOL clear = FALSE;
 			BOOL rfx = FALSE;
 			BOOL avc444v2 = FALSE;
 			BOOL avc444 = FALSE;
@@ -825,6 +1022,9 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 			planar = freerdp_settings_get_bool(srvSettings, FreeRDP_GfxPlanar);
 			freerdp_settings_set_bool(clientSettings, FreeRDP_GfxPlanar, planar);
 
+			clear = freerdp_settings_get_bool(srvSettings, FreeRDP_GfxClearCodec);
+			freerdp_settings_set_bool(clientSettings, FreeRDP_GfxClearCodec, clear);
+
 			if (!avc444v2 && !avc444 && !avc420)
 				pdu.capsSet->flags |= RDPGFX_CAPS_FLAG_AVC_DISABLED;
 
@@ -989,14 +1189,64 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+/* codecs without region support encode the bounding box of the region */
+static void shadow_client_gfx_command_bounds(RDPGFX_SURFACE_COMMAND* cmd, const REGION16* region)
+{
+	const RECTANGLE_16* extents;
+
+	if (!region)
+		return;
+
+	extents = region16_extents(region);
+	cmd->left = extents->left;
+	cmd->top = extents->top;
+	cmd->right = extents->right;
+	cmd->bottom = extents->bottom;
+	cmd->width = cmd->right - cmd->left;
+	cmd->height = cmd->bottom - cmd->top;
+}
+
+/* the channel state of the client is not thread safe, commands of the outputs are serialized */
+static UINT shadow_client_gfx_frame_command(rdpShadowClient* client,
+                                            const RDPGFX_SURFACE_COMMAND* cmd,
+                                            const RDPGFX_START_FRAME_PDU* cmdstart,
+                                            const RDPGFX_END_FRAME_PDU* cmdend)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	EnterCriticalSection(&(client->lock));
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart, cmdend);
+	LeaveCriticalSection(&(client->lock));
+	return error;
+}
+
+/* frame ids are unique per client, the outputs of a client may be encoded in parallel */
+static void shadow_client_gfx_frame_init(rdpShadowClient* client, RDPGFX_START_FRAME_PDU* cmdstart,
+                                         RDPGFX_END_FRAME_PDU* cmdend)
+{
+	SYSTEMTIME sTime = { 0 };
+
+	EnterCriticalSection(&(client->lock));
+	cmdstart->frameId = shadow_encoder_create_frame_id(client->encoder);
+	LeaveCriticalSection(&(client->lock));
+	GetSystemTime(&sTime);
+	cmdstart->timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U |
+	                               sTime.wSecond << 10U | sTime.wMilliseconds);
+	cmdend->frameId = cmdstart->frameId;
+}
+
 /**
  * Function description
  *
+ * The frame of nWidth x nHeight pixels is encoded where region is set, completely if region is
+ * NULL. The H.264 codecs always encode the complete frame.
+ *
  * @return TRUE on success
  */
-static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE* pSrcData,
-                                           UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nXSrc,
-                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
+static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, SHADOW_GFX_OUTPUT* output,
+                                           const BYTE* pSrcData, UINT32 nSrcStep,
+                                           UINT32 SrcFormat, UINT16 nXSrc, UINT16 nYSrc,
+                                           UINT16 nWidth, UINT16 nHeight, const REGION16* region)
 {
 	UINT32 id;
 	UINT error = CHANNEL_RC_OK;
@@ -1006,13 +1256,12 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	RDPGFX_SURFACE_COMMAND cmd = { 0 };
 	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
 	RDPGFX_END_FRAME_PDU cmdend = { 0 };
-	SYSTEMTIME sTime = { 0 };
 
 	if (!context || !pSrcData)
 		return FALSE;
 
 	settings = context->settings;
-	encoder = client->encoder;
+	encoder = output->encoder;
 
 	if (!settings || !encoder)
 		return FALSE;
@@ -1023,12 +1272,8 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		client->first_frame = FALSE;
 	}
 
-	cmdstart.frameId = shadow_encoder_create_frame_id(encoder);
-	GetSystemTime(&sTime);
-	cmdstart.timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U | sTime.wSecond << 10U |
-	                              sTime.wMilliseconds);
-	cmdend.frameId = cmdstart.frameId;
-	cmd.surfaceId = client->surfaceId;
+	shadow_client_gfx_frame_init(client, &cmdstart, &cmdend);
+	cmd.surfaceId = output->surfaceId;
 	cmd.format = PIXEL_FORMAT_BGRX32;
 	cmd.left = nXSrc;
 	cmd.top = nYSrc;
@@ -1076,8 +1321,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
 			cmd.codecId = settings->GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
 			cmd.extra = (void*)&avc444;
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 
 		free_h264_metablock(&avc444.bitstream[0].meta);
@@ -1122,8 +1366,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			cmd.codecId = RDPGFX_CODECID_AVC420;
 			cmd.extra = (void*)&avc420;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 		free_h264_metablock(&avc420.meta);
 
@@ -1137,7 +1380,14 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	{
 		BOOL rc;
 		wStream* s;
+		wStream* shared;
+		BOOL publish;
+		SHADOW_FANOUT_KEY key = { 0 };
+		rdpShadowFanout* fanout = client->shareFrames ? client->server->fanout : NULL;
+		UINT32 x;
+		UINT32 numRects = 1;
 		RFX_RECT rect;
+		RFX_RECT* rects = &rect;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
 		{
@@ -1145,9 +1395,6 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			return FALSE;
 		}
 
-		s = Stream_New(NULL, 1024);
-		WINPR_ASSERT(s);
-
 		WINPR_ASSERT(cmd.left <= UINT16_MAX);
 		WINPR_ASSERT(cmd.top <= UINT16_MAX);
 		WINPR_ASSERT(cmd.right <= UINT16_MAX);
@@ -1157,7 +1404,53 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		rect.width = (UINT16)cmd.right - cmd.left;
 		rect.height = (UINT16)cmd.bottom - cmd.top;
 
-		rc = rfx_compose_message(encoder->rfx, s, &rect, 1, pSrcData, nWidth, nHeight, nSrcStep);
+		if (region)
+		{
+			const RECTANGLE_16* regionRects = region16_rects(region, &numRects);
+
+			if (!(rects = (RFX_RECT*)calloc(numRects, sizeof(RFX_RECT))))
+				return FALSE;
+
+			for (x = 0; x < numRects; x++)
+			{
+				rects[x].x = regionRects[x].left;
+				rects[x].y = regionRects[x].top;
+				rects[x].width = regionRects[x].right - regionRects[x].left;
+				rects[x].height = regionRects[x].bottom - regionRects[x].top;
+			}
+		}
+
+		key.src = pSrcData;
+		key.codecId = RDPGFX_CODECID_CAVIDEO;
+		key.width = nWidth;
+		key.height = nHeight;
+		key.param = encoder->rfxQuantOffset;
+		key.headers = (encoder->rfx->state == RFX_STATE_SEND_HEADERS);
+		key.region = region;
+		shared = shadow_fanout_acquire(fanout, &key, &publish);
+
+		if (shared)
+		{
+			/* the shared message carries the headers if this encoder still had to send them */
+			s = shared;
+			rc = TRUE;
+			encoder->rfx->state = RFX_STATE_SEND_FRAME_DATA;
+		}
+		else
+		{
+			s = Stream_New(NULL, 1024);
+			WINPR_ASSERT(s);
+
+			rc = rfx_compose_message(encoder->rfx, s, rects, numRects, pSrcData, nWidth, nHeight,
+			                         nSrcStep);
+
+			if (publish)
+				shadow_fanout_publish(fanout, &key, rc ? Stream_Buffer(s) : NULL,
+				                      Stream_GetPosition(s));
+		}
+
+		if (rects != &rect)
+			free(rects);
 
 		if (!rc)
 		{
@@ -1176,11 +1469,14 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			cmd.data = Stream_Buffer(s);
 			cmd.length = (UINT32)pos;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
 		}
 
-		Stream_Free(s, TRUE);
+		if (shared)
+			Stream_Release(shared);
+		else
+			Stream_Free(s, TRUE);
+
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
@@ -1190,7 +1486,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
 	{
 		INT32 rc;
-		REGION16 region;
+		REGION16 progressiveRegion;
 		RECTANGLE_16 regionRect;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PROGRESSIVE) < 0)
@@ -1207,11 +1503,17 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		regionRect.top = (UINT16)cmd.top;
 		regionRect.right = (UINT16)cmd.right;
 		regionRect.bottom = (UINT16)cmd.bottom;
-		region16_init(&region);
-		region16_union_rect(&region, &region, &regionRect);
+		region16_init(&progressiveRegion);
+
+		if (region)
+			region16_copy(&progressiveRegion, region);
+		else
+			region16_union_rect(&progressiveRegion, &progressiveRegion, &regionRect);
+
 		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, cmd.format,
-		                          nWidth, nHeight, nSrcStep, &region, &cmd.data, &cmd.length);
-		region16_uninit(&region);
+		                          nWidth, nHeight, nSrcStep, &progressiveRegion, &cmd.data,
+		                          &cmd.length);
+		region16_uninit(&progressiveRegion);
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "progressive_compress failed");
@@ -1223,10 +1525,42 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		{
 			cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
+			error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
+		}
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
+	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec))
+	{
+		int rc;
+		UINT32 w, h;
+		const BYTE* src;
+
+		shadow_client_gfx_command_bounds(&cmd, region);
+		w = cmd.right - cmd.left;
+		h = cmd.bottom - cmd.top;
+		src = &pSrcData[cmd.top * nSrcStep + cmd.left * GetBytesPerPixel(SrcFormat)];
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+			return FALSE;
+		}
+
+		rc = clear_compress(encoder->clear, src, SrcFormat, nSrcStep, w, h, &cmd.data,
+		                    &cmd.length);
+		if (rc < 0)
+		{
+			WLog_ERR(TAG, "clear_compress failed");
+			return FALSE;
 		}
 
+		cmd.codecId = RDPGFX_CODECID_CLEARCODEC;
+
+		error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
@@ -1236,28 +1570,57 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
 	{
 		BOOL rc;
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const BYTE* src = &pSrcData[cmd.top * nSrcStep + cmd.left * GetBytesPerPixel(SrcFormat)];
+		UINT32 w, h;
+		const BYTE* src;
+		wStream* shared;
+		BOOL publish;
+		SHADOW_FANOUT_KEY key = { 0 };
+		rdpShadowFanout* fanout = client->shareFrames ? client->server->fanout : NULL;
+
+		shadow_client_gfx_command_bounds(&cmd, region);
+		w = cmd.right - cmd.left;
+		h = cmd.bottom - cmd.top;
+		src = &pSrcData[cmd.top * nSrcStep + cmd.left * GetBytesPerPixel(SrcFormat)];
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
 			return FALSE;
 		}
 
-		rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
-		WINPR_ASSERT(rc);
-		freerdp_planar_topdown_image(encoder->planar, TRUE);
+		key.src = pSrcData;
+		key.codecId = RDPGFX_CODECID_PLANAR;
+		key.width = w;
+		key.height = h;
+		key.region = region;
+		shared = shadow_fanout_acquire(fanout, &key, &publish);
 
-		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
-		                                          NULL, &cmd.length);
-		WINPR_ASSERT(cmd.data || (cmd.length == 0));
+		if (shared)
+		{
+			cmd.data = Stream_Buffer(shared);
+			cmd.length = (UINT32)Stream_GetPosition(shared);
+		}
+		else
+		{
+			rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
+			WINPR_ASSERT(rc);
+			freerdp_planar_topdown_image(encoder->planar, TRUE);
+
+			cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h,
+			                                          nSrcStep, NULL, &cmd.length);
+			WINPR_ASSERT(cmd.data || (cmd.length == 0));
+
+			if (publish)
+				shadow_fanout_publish(fanout, &key, cmd.data, cmd.length);
+		}
 
 		cmd.codecId = RDPGFX_CODECID_PLANAR;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
-		free(cmd.data);
+		error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
+
+		if (shared)
+			Stream_Release(shared);
+		else
+			free(cmd.data);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
@@ -1267,10 +1630,15 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	else
 	{
 		BOOL rc;
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const UINT32 length = w * 4 * h;
-		BYTE* data = malloc(length);
+		UINT32 w, h;
+		UINT32 length;
+		BYTE* data;
+
+		shadow_client_gfx_command_bounds(&cmd, region);
+		w = cmd.right - cmd.left;
+		h = cmd.bottom - cmd.top;
+		length = w * 4 * h;
+		data = malloc(length);
 
 		WINPR_ASSERT(data);
 
@@ -1282,8 +1650,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		cmd.length = length;
 		cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
+		error = shadow_client_gfx_frame_command(client, &cmd, &cmdstart, &cmdend);
 		free(data);
 		if (error)
 		{
@@ -1291,43 +1658,338 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			return FALSE;
 		}
 	}
+
+	metrics_frame_sent(client->context.metrics, cmdstart.frameId);
 	return TRUE;
 }
 
+static BOOL shadow_client_gfx_mixed_supported(rdpShadowClient* client)
+{
+	const rdpSettings* settings = client->context.settings;
+
+	if (!client->server->gfxMixed || client->server->shareSubRect)
+		return FALSE;
+
+	if (!settings->GfxAVC444 && !settings->GfxAVC444v2 && !settings->GfxH264)
+		return FALSE;
+
+	return freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec) ||
+	       freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar);
+}
+
 /**
  * Function description
  *
+ * Encodes the complete frame with H.264, the client shows the output where videoRegion is set.
+ *
  * @return TRUE on success
  */
-static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcData,
-                                            UINT32 nSrcStep, UINT16 nXSrc, UINT16 nYSrc,
-                                            UINT16 nWidth, UINT16 nHeight)
+static BOOL shadow_client_send_surface_h264(rdpShadowClient* client, const BYTE* pSrcData,
+                                            UINT32 nSrcStep, UINT16 nWidth, UINT16 nHeight,
+                                            const REGION16* videoRegion)
 {
-	BOOL ret = TRUE;
-	size_t i;
-	BOOL first;
-	BOOL last;
-	wStream* s;
-	size_t numMessages;
-	UINT32 frameId = 0;
-	rdpUpdate* update;
-	rdpContext* context = (rdpContext*)client;
-	rdpSettings* settings;
-	rdpShadowEncoder* encoder;
-	SURFACE_BITS_COMMAND cmd = { 0 };
-	UINT32 nsID, rfxID;
-
-	if (!context || !pSrcData)
-		return FALSE;
+	INT32 rc;
+	UINT error = CHANNEL_RC_OK;
+	const rdpSettings* settings = client->context.settings;
+	rdpShadowEncoder* encoder = client->encoder;
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+	const RECTANGLE_16 regionRect = *region16_extents(videoRegion);
 
-	update = context->update;
-	settings = context->settings;
-	encoder = client->encoder;
+	cmd.surfaceId = client->surfaceId;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.right = nWidth;
+	cmd.bottom = nHeight;
+	cmd.width = nWidth;
+	cmd.height = nHeight;
 
-	if (!update || !settings || !encoder)
-		return FALSE;
+	if (settings->GfxAVC444 || settings->GfxAVC444v2)
+	{
+		RDPGFX_AVC444_BITMAP_STREAM avc444 = { 0 };
+		const BYTE version = settings->GfxAVC444v2 ? 2 : 1;
 
-	if (encoder->frameAck)
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC444) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC444");
+			return FALSE;
+		}
+
+		rc = avc444_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
+		                     version, &regionRect, &avc444.LC, &avc444.bitstream[0].data,
+		                     &avc444.bitstream[0].length, &avc444.bitstream[1].data,
+		                     &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
+		                     &avc444.bitstream[1].meta);
+
+		/* rc > 0 means new data */
+		if (rc > 0)
+		{
+			shadow_classify_filter_meta(encoder, videoRegion, &avc444.bitstream[0].meta);
+			shadow_classify_filter_meta(encoder, videoRegion, &avc444.bitstream[1].meta);
+			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
+			cmd.codecId = settings->GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
+			cmd.extra = (void*)&avc444;
+			IFCALLRET(client->rdpgfx->SurfaceCommand, error, client->rdpgfx, &cmd);
+		}
+
+		free_h264_metablock(&avc444.bitstream[0].meta);
+		free_h264_metablock(&avc444.bitstream[1].meta);
+	}
+	else
+	{
+		RDPGFX_AVC420_BITMAP_STREAM avc420 = { 0 };
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC420) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC420");
+			return FALSE;
+		}
+
+		rc = avc420_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
+		                     &regionRect, &avc420.data, &avc420.length, &avc420.meta);
+
+		/* rc > 0 means new data */
+		if (rc > 0)
+		{
+			shadow_classify_filter_meta(encoder, videoRegion, &avc420.meta);
+			cmd.codecId = RDPGFX_CODECID_AVC420;
+			cmd.extra = (void*)&avc420;
+			IFCALLRET(client->rdpgfx->SurfaceCommand, error, client->rdpgfx, &cmd);
+		}
+
+		free_h264_metablock(&avc420.meta);
+	}
+
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "H.264 compression of the video region failed");
+		return FALSE;
+	}
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ *
+ * Sends rect with ClearCodec, designed for text, or Planar.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_lossless(rdpShadowClient* client, const BYTE* pSrcData,
+                                                UINT32 nSrcStep, UINT32 SrcFormat,
+                                                const RECTANGLE_16* rect)
+{
+	UINT error = CHANNEL_RC_OK;
+	const rdpSettings* settings = client->context.settings;
+	rdpShadowEncoder* encoder = client->encoder;
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+	const UINT32 w = rect->right - rect->left;
+	const UINT32 h = rect->bottom - rect->top;
+	const BYTE* src = &pSrcData[rect->top * nSrcStep + rect->left * GetBytesPerPixel(SrcFormat)];
+
+	cmd.surfaceId = client->surfaceId;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.left = rect->left;
+	cmd.top = rect->top;
+	cmd.right = rect->right;
+	cmd.bottom = rect->bottom;
+	cmd.width = w;
+	cmd.height = h;
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec))
+	{
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+			return FALSE;
+		}
+
+		if (clear_compress(encoder->clear, src, SrcFormat, nSrcStep, w, h, &cmd.data,
+		                   &cmd.length) < 0)
+		{
+			WLog_ERR(TAG, "clear_compress failed");
+			return FALSE;
+		}
+
+		cmd.codecId = RDPGFX_CODECID_CLEARCODEC;
+		IFCALLRET(client->rdpgfx->SurfaceCommand, error, client->rdpgfx, &cmd);
+	}
+	else
+	{
+		BOOL rc;
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
+			return FALSE;
+		}
+
+		rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
+		WINPR_ASSERT(rc);
+		freerdp_planar_topdown_image(encoder->planar, TRUE);
+
+		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
+		                                          NULL, &cmd.length);
+		WINPR_ASSERT(cmd.data || (cmd.length == 0));
+
+		cmd.codecId = RDPGFX_CODECID_PLANAR;
+		IFCALLRET(client->rdpgfx->SurfaceCommand, error, client->rdpgfx, &cmd);
+		free(cmd.data);
+	}
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ *
+ * Sends the frame with H.264 for the tiles showing video and a lossless codec for text and
+ * user interface content. The lossless commands follow the H.264 one, they are drawn on top.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_mixed(rdpShadowClient* client, const BYTE* pSrcData,
+                                             UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
+                                             UINT16 nHeight, const REGION16* invalidRegion)
+{
+	BOOL rc = FALSE;
+	BOOL batch = FALSE;
+	BOOL framed = FALSE;
+	UINT error = CHANNEL_RC_OK;
+	UINT32 index;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects;
+	REGION16 videoRegion;
+	REGION16 textRegion;
+	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
+	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+
+	region16_init(&videoRegion);
+	region16_init(&textRegion);
+
+	if (!shadow_classify_region(client->encoder, pSrcData, nSrcStep, nWidth, nHeight,
+	                            invalidRegion, &videoRegion, &textRegion))
+		goto out;
+
+	if (region16_is_empty(&videoRegion) && region16_is_empty(&textRegion))
+	{
+		rc = TRUE;
+		goto out;
+	}
+
+	shadow_client_gfx_frame_init(client, &cmdstart, &cmdend);
+
+	/* the whole frame is compressed and written at once */
+	if (client->rdpgfx->BeginBatch)
+	{
+		error = client->rdpgfx->BeginBatch(client->rdpgfx);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "BeginBatch failed with error %" PRIu32 "", error);
+			goto out;
+		}
+
+		batch = TRUE;
+	}
+
+	IFCALLRET(client->rdpgfx->StartFrame, error, client->rdpgfx, &cmdstart);
+
+	if (error)
+	{
+		WLog_ERR(TAG, "StartFrame failed with error %" PRIu32 "", error);
+		goto out;
+	}
+
+	if (!region16_is_empty(&videoRegion) &&
+	    !shadow_client_send_surface_h264(client, pSrcData, nSrcStep, nWidth, nHeight,
+	                                     &videoRegion))
+		goto out;
+
+	rects = region16_rects(&textRegion, &numRects);
+
+	for (index = 0; index < numRects; index++)
+	{
+		if (!shadow_client_send_surface_lossless(client, pSrcData, nSrcStep, SrcFormat,
+		                                         &rects[index]))
+			goto out;
+	}
+
+	IFCALLRET(client->rdpgfx->EndFrame, error, client->rdpgfx, &cmdend);
+
+	if (error)
+	{
+		WLog_ERR(TAG, "EndFrame failed with error %" PRIu32 "", error);
+		goto out;
+	}
+
+	framed = TRUE;
+	rc = TRUE;
+out:
+	if (batch)
+	{
+		error = client->rdpgfx->EndBatch(client->rdpgfx, rc);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "EndBatch failed with error %" PRIu32 "", error);
+			rc = FALSE;
+		}
+	}
+
+	if (rc && framed)
+		metrics_frame_sent(client->context.metrics, cmdstart.frameId);
+
+	region16_uninit(&videoRegion);
+	region16_uninit(&textRegion);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcData,
+                                            UINT32 nSrcStep, UINT16 nXSrc, UINT16 nYSrc,
+                                            UINT16 nWidth, UINT16 nHeight)
+{
+	BOOL ret = TRUE;
+	size_t i;
+	BOOL first;
+	BOOL last;
+	wStream* s;
+	size_t numMessages;
+	UINT32 frameId = 0;
+	rdpUpdate* update;
+	rdpContext* context = (rdpContext*)client;
+	rdpSettings* settings;
+	rdpShadowEncoder* encoder;
+	SURFACE_BITS_COMMAND cmd = { 0 };
+	UINT32 nsID, rfxID;
+
+	if (!context || !pSrcData)
+		return FALSE;
+
+	update = context->update;
+	settings = context->settings;
+	encoder = client->encoder;
+
+	if (!update || !settings || !encoder)
+		return FALSE;
+
+	if (encoder->frameAck)
 		frameId = shadow_encoder_create_frame_id(encoder);
 
 	nsID = freerdp_settings_get_uint32(settings, FreeRDP_NSCodecId);
@@ -1484,6 +2146,10 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 	BITMAP_DATA* bitmapData;
 	BITMAP_UPDATE bitmapUpdate;
 	rdpShadowEncoder* encoder;
+	RECTANGLE_16 rect;
+	BOOL useOrders = FALSE;
+	BOOL handled;
+	SHADOW_ORDERS_TILE tile;
 
 	if (!context || !pSrcData)
 		return FALSE;
@@ -1549,6 +2215,18 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 		nHeight += (4 - (nHeight % 4));
 	}
 
+	rect.left = nXSrc;
+	rect.top = nYSrc;
+	rect.right = nXSrc + nWidth;
+	rect.bottom = nYSrc + nHeight;
+	useOrders = shadow_orders_begin(client);
+
+	if (useOrders && !shadow_orders_send_scroll(client, pSrcData, nSrcStep, &rect))
+	{
+		ret = FALSE;
+		goto out;
+	}
+
 	for (yIdx = 0; yIdx < rows; yIdx++)
 	{
 		for (xIdx = 0; xIdx < cols; xIdx++)
@@ -1572,6 +2250,19 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 			if ((bitmap->width < 4) || (bitmap->height < 4))
 				continue;
 
+			if (useOrders)
+			{
+				if (!shadow_orders_send_tile(client, pSrcData, nSrcStep, bitmap, &tile,
+				                             &handled))
+				{
+					ret = FALSE;
+					goto out;
+				}
+
+				if (handled)
+					continue;
+			}
+
 			if (settings->ColorDepth < 32)
 			{
 				UINT32 bitsPerPixel = settings->ColorDepth;
@@ -1605,11 +2296,39 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 
 			bitmap->cbCompFirstRowSize = 0;
 			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
+
+			if (useOrders)
+			{
+				if (!shadow_orders_cache_tile(client, bitmap, &tile, &handled))
+				{
+					ret = FALSE;
+					goto out;
+				}
+
+				if (handled)
+					continue;
+			}
+
 			totalBitmapSize += bitmap->bitmapLength;
 			k++;
 		}
 	}
 
+	if (useOrders)
+	{
+		/* the orders have to reach the client before the bitmaps drawn over them */
+		useOrders = FALSE;
+
+		if (!shadow_orders_end(client, pSrcData, nSrcStep, &rect))
+		{
+			ret = FALSE;
+			goto out;
+		}
+	}
+
+	if (k == 0)
+		goto out;
+
 	bitmapUpdate.number = k;
 	updateSizeEstimate = totalBitmapSize + (k * bitmapUpdate.number) + 16;
 
@@ -1630,61 +2349,275 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 			goto out;
 		}
 
-		bitmapUpdate.rectangles = fragBitmapData;
-		i = j = 0;
-		updateSize = 1024;
+		bitmapUpdate.rectangles = fragBitmapData;
+		i = j = 0;
+		updateSize = 1024;
+
+		while (i < k)
+		{
+			newUpdateSize = updateSize + (bitmapData[i].bitmapLength + 16);
+
+			if (newUpdateSize < maxUpdateSize)
+			{
+				CopyMemory(&fragBitmapData[j++], &bitmapData[i++], sizeof(BITMAP_DATA));
+				updateSize = newUpdateSize;
+			}
+
+			if ((newUpdateSize >= maxUpdateSize) || (i + 1) >= k)
+			{
+				bitmapUpdate.number = j;
+				IFCALLRET(update->BitmapUpdate, ret, context, &bitmapUpdate);
+
+				if (!ret)
+				{
+					WLog_ERR(TAG, "BitmapUpdate failed");
+					break;
+				}
+
+				updateSize = 1024;
+				j = 0;
+			}
+		}
+
+		free(fragBitmapData);
+	}
+	else
+	{
+		IFCALLRET(update->BitmapUpdate, ret, context, &bitmapUpdate);
+
+		if (!ret)
+		{
+			WLog_ERR(TAG, "BitmapUpdate failed");
+		}
+	}
+
+out:
+	if (useOrders)
+		shadow_orders_end(client, pSrcData, nSrcStep, NULL);
+
+	free(bitmapData);
+	return ret;
+}
+
+/**
+ * Scrolled content is kept on the client with SurfaceToSurface, only what still differs from
+ * the last sent frame has to be encoded. The H.264 codecs encode complete frames and handle
+ * motion on their own.
+ */
+static BOOL shadow_client_gfx_region_supported(rdpShadowClient* client)
+{
+	const rdpSettings* settings = client->context.settings;
+
+	if (settings->GfxAVC444 || settings->GfxAVC444v2 || settings->GfxH264)
+		return FALSE;
+
+	/* the invalid region is in surface coordinates, the gfx surface shows the sub rect */
+	if (client->server->shareSubRect)
+		return FALSE;
+
+	return shadow_encoder_prepare_last_frame(client->encoder);
+}
+
+/**
+ * Function description
+ *
+ * Sends a SurfaceToSurface for scrolled content in invalidRegion and collects the 64x64 tiles
+ * that still differ from what the client shows in encodeRegion.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_to_surface(rdpShadowClient* client, const BYTE* pSrcData,
+                                                  UINT32 nSrcStep, const REGION16* invalidRegion,
+                                                  REGION16* encodeRegion)
+{
+	UINT error = CHANNEL_RC_OK;
+	UINT32 index, numRects = 0;
+	UINT32 x, y;
+	INT32 dx, dy;
+	RECTANGLE_16 src;
+	const RECTANGLE_16* rects;
+	rdpShadowEncoder* encoder = client->encoder;
+
+	if (shadow_encoder_find_move(encoder, pSrcData, nSrcStep, region16_extents(invalidRegion), &src,
+	                             &dx, &dy))
+	{
+		RDPGFX_POINT16 destPt = { 0 };
+		RDPGFX_SURFACE_TO_SURFACE_PDU pdu = { 0 };
+
+		destPt.x = (UINT16)(src.left + dx);
+		destPt.y = (UINT16)(src.top + dy);
+		pdu.surfaceIdSrc = client->surfaceId;
+		pdu.surfaceIdDest = client->surfaceId;
+		pdu.rectSrc = src;
+		pdu.destPtsCount = 1;
+		pdu.destPts = &destPt;
+		IFCALLRET(client->rdpgfx->SurfaceToSurface, error, client->rdpgfx, &pdu);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceToSurface failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+
+		shadow_encoder_move_last_frame(encoder, &src, dx, dy);
+	}
+
+	rects = region16_rects(invalidRegion, &numRects);
+
+	for (index = 0; index < numRects; index++)
+	{
+		const RECTANGLE_16* rect = &rects[index];
+
+		for (y = rect->top & ~63U; y < rect->bottom; y += 64)
+		{
+			for (x = rect->left & ~63U; x < rect->right; x += 64)
+			{
+				RECTANGLE_16 tile;
+				tile.left = (UINT16)MAX(x, rect->left);
+				tile.top = (UINT16)MAX(y, rect->top);
+				tile.right = (UINT16)MIN(x + 64, rect->right);
+				tile.bottom = (UINT16)MIN(y + 64, rect->bottom);
+
+				if (shadow_encoder_last_frame_equal(encoder, pSrcData, nSrcStep, &tile))
+					continue;
+
+				if (!region16_union_rect(encodeRegion, encodeRegion, &tile))
+					return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE on success (or nothing need to be updated)
+ */
+typedef struct
+{
+	rdpShadowClient* client;
+	SHADOW_GFX_OUTPUT* output;
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	UINT32 SrcFormat;
+	REGION16 region; /* damage relative to the output */
+	BOOL rc;
+} SHADOW_OUTPUT_WORK;
+
+static void shadow_client_send_output(SHADOW_OUTPUT_WORK* param)
+{
+	const RECTANGLE_16* rect = &param->output->rect;
+
+	param->rc = shadow_client_send_surface_gfx(
+	    param->client, param->output, param->pSrcData, param->nSrcStep, param->SrcFormat, 0, 0,
+	    rect->right - rect->left, rect->bottom - rect->top, &param->region);
+}
+
+static void CALLBACK shadow_client_send_output_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                             void* context, PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	shadow_client_send_output((SHADOW_OUTPUT_WORK*)context);
+}
+
+/**
+ * Encodes the damaged outputs in parallel, an output without damage costs nothing.
+ */
+static BOOL shadow_client_send_surface_outputs(rdpShadowClient* client, const BYTE* pSrcData,
+                                               UINT32 nSrcStep, UINT32 SrcFormat,
+                                               const REGION16* invalidRegion)
+{
+	BOOL rc = TRUE;
+	UINT32 index;
+	UINT32 count = 0;
+	SHADOW_OUTPUT_WORK params[SHADOW_MAX_GFX_OUTPUTS];
+	PTP_WORK work[SHADOW_MAX_GFX_OUTPUTS] = { 0 };
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(invalidRegion);
+
+	/* the output encoders were reset when their surfaces were created */
+	client->first_frame = FALSE;
 
-		while (i < k)
-		{
-			newUpdateSize = updateSize + (bitmapData[i].bitmapLength + 16);
+	for (index = 0; index < client->numOutputs; index++)
+	{
+		UINT32 x;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects;
+		REGION16 damage;
+		SHADOW_OUTPUT_WORK* param = &params[count];
+		SHADOW_GFX_OUTPUT* output = &client->outputs[index];
 
-			if (newUpdateSize < maxUpdateSize)
-			{
-				CopyMemory(&fragBitmapData[j++], &bitmapData[i++], sizeof(BITMAP_DATA));
-				updateSize = newUpdateSize;
-			}
+		region16_init(&damage);
+		region16_init(&param->region);
+		region16_intersect_rect(&damage, invalidRegion, &output->rect);
+		rects = region16_rects(&damage, &numRects);
 
-			if ((newUpdateSize >= maxUpdateSize) || (i + 1) >= k)
-			{
-				bitmapUpdate.number = j;
-				IFCALLRET(update->BitmapUpdate, ret, context, &bitmapUpdate);
+		for (x = 0; x < numRects; x++)
+		{
+			RECTANGLE_16 rect = rects[x];
 
-				if (!ret)
-				{
-					WLog_ERR(TAG, "BitmapUpdate failed");
-					break;
-				}
+			rect.left -= output->rect.left;
+			rect.right -= output->rect.left;
+			rect.top -= output->rect.top;
+			rect.bottom -= output->rect.top;
+			region16_union_rect(&param->region, &param->region, &rect);
+		}
 
-				updateSize = 1024;
-				j = 0;
-			}
+		region16_uninit(&damage);
+
+		if (region16_is_empty(&param->region))
+		{
+			region16_uninit(&param->region);
+			continue;
 		}
 
-		free(fragBitmapData);
+		param->client = client;
+		param->output = output;
+		param->pSrcData = &pSrcData[1ULL * output->rect.top * nSrcStep + output->rect.left * 4ULL];
+		param->nSrcStep = nSrcStep;
+		param->SrcFormat = SrcFormat;
+		param->rc = FALSE;
+		count++;
 	}
-	else
+
+	for (index = 0; index < count; index++)
 	{
-		IFCALLRET(update->BitmapUpdate, ret, context, &bitmapUpdate);
+		/* the last output is encoded by this thread */
+		if (index + 1 < count)
+			work[index] =
+			    CreateThreadpoolWork(shadow_client_send_output_work_callback, &params[index], NULL);
 
-		if (!ret)
+		if (work[index])
+			SubmitThreadpoolWork(work[index]);
+		else
+			shadow_client_send_output(&params[index]);
+	}
+
+	for (index = 0; index < count; index++)
+	{
+		if (work[index])
 		{
-			WLog_ERR(TAG, "BitmapUpdate failed");
+			WaitForThreadpoolWorkCallbacks(work[index], FALSE);
+			CloseThreadpoolWork(work[index]);
 		}
+
+		if (!params[index].rc)
+			rc = FALSE;
+
+		region16_uninit(&params[index].region);
 	}
 
-out:
-	free(bitmapData);
-	return ret;
+	return rc;
 }
 
-/**
- * Function description
- *
- * @return TRUE on success (or nothing need to be updated)
- */
 static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus)
 {
 	BOOL ret = TRUE;
+	BOOL newSurface = FALSE;
 	INT64 nXSrc, nYSrc;
 	INT64 nWidth, nHeight;
 	rdpContext* context = (rdpContext*)client;
@@ -1726,6 +2659,11 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	for (index = 0; index < numRects; index++)
 		region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
 
+	client->encoder->moveValid = surface->moveValid;
+	client->encoder->moveSrc = surface->moveSrc;
+	client->encoder->moveDx = surface->moveDx;
+	client->encoder->moveDy = surface->moveDy;
+
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
 	WINPR_ASSERT(surface->width <= UINT16_MAX);
@@ -1789,14 +2727,79 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 				goto out;
 
 			pStatus->gfxSurfaceCreated = TRUE;
+			newSurface = TRUE;
 		}
 
 		WINPR_ASSERT(nWidth >= 0);
 		WINPR_ASSERT(nWidth <= UINT16_MAX);
 		WINPR_ASSERT(nHeight >= 0);
 		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
-		                                     (UINT16)nWidth, (UINT16)nHeight);
+
+		if (client->numOutputs > 1)
+		{
+			/* new surfaces are empty, they need the complete frame */
+			if (newSurface)
+				region16_union_rect(&invalidRegion, &invalidRegion, &surfaceRect);
+
+			ret = shadow_client_send_surface_outputs(client, pSrcData, nSrcStep, SrcFormat,
+			                                         &invalidRegion);
+		}
+		else if (shadow_client_gfx_region_supported(client))
+		{
+			REGION16 encodeRegion;
+			region16_init(&encodeRegion);
+
+			/* a new surface is empty, it needs the complete frame */
+			if (newSurface)
+			{
+				client->encoder->lastFrameValid = FALSE;
+				region16_union_rect(&encodeRegion, &encodeRegion, &surfaceRect);
+				region16_union_rect(&invalidRegion, &invalidRegion, &surfaceRect);
+			}
+			else
+				ret = shadow_client_send_surface_to_surface(client, pSrcData, nSrcStep,
+				                                            &invalidRegion, &encodeRegion);
+
+			if (ret)
+				ret = shadow_gfxcache_send_hits(client, pSrcData, nSrcStep, &encodeRegion);
+
+			if (ret && !region16_is_empty(&encodeRegion))
+			{
+				ret = shadow_client_send_surface_gfx(client, &client->outputs[0], pSrcData,
+				                                     nSrcStep, SrcFormat, 0, 0, (UINT16)nWidth,
+				                                     (UINT16)nHeight, &encodeRegion);
+
+				if (ret)
+					ret = shadow_gfxcache_store(client);
+			}
+
+			if (ret)
+			{
+				rects = region16_rects(&invalidRegion, &numRects);
+
+				for (index = 0; index < numRects; index++)
+					shadow_encoder_update_last_frame(client->encoder, pSrcData, nSrcStep,
+					                                 &rects[index]);
+			}
+
+			region16_uninit(&encodeRegion);
+		}
+		else if (shadow_client_gfx_mixed_supported(client))
+		{
+			/* a new surface is empty, it needs the complete frame */
+			if (newSurface)
+			{
+				shadow_classify_reset(client->encoder);
+				region16_union_rect(&invalidRegion, &invalidRegion, &surfaceRect);
+			}
+
+			ret = shadow_client_send_surface_mixed(client, pSrcData, nSrcStep, SrcFormat,
+			                                       (UINT16)nWidth, (UINT16)nHeight, &invalidRegion);
+		}
+		else
+			ret = shadow_client_send_surface_gfx(client, &client->outputs[0], pSrcData,
+			                                     nSrcStep, SrcFormat, 0, 0, (UINT16)nWidth,
+			                                     (UINT16)nHeight, NULL);
 	}
 	else if (settings->RemoteFxCodec || freerdp_settings_get_bool(settings, FreeRDP_NSCodec))
 	{
@@ -1933,6 +2936,7 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 	WINPR_ASSERT(update);
 
 	/* FIXME: the pointer updates appear to be broken when used with bulk compression and mstsc */
+	/* pointer updates are sent under the update lock, the encode thread may send a frame */
 
 	switch (message->id)
 	{
@@ -1956,7 +2960,9 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 				if ((msg->xPos != client->pointerX) || (msg->yPos != client->pointerY))
 				{
 					WINPR_ASSERT(update->pointer);
+					rdp_update_lock(update);
 					IFCALL(update->pointer->PointerPosition, context, &pointerPosition);
+					rdp_update_unlock(update);
 					client->pointerX = msg->xPos;
 					client->pointerY = msg->yPos;
 				}
@@ -1989,8 +2995,10 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 
 			if (client->activated)
 			{
+				rdp_update_lock(update);
 				IFCALL(update->pointer->PointerNew, context, &pointerNew);
 				IFCALL(update->pointer->PointerCached, context, &pointerCached);
+				rdp_update_unlock(update);
 			}
 
 			break;
@@ -2035,6 +3043,322 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 	return 1;
 }
 
+static BOOL shadow_client_rtt_measure_response(rdpContext* context, UINT16 sequenceNumber)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context;
+
+	WINPR_UNUSED(sequenceNumber);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(client->encoder);
+	WINPR_ASSERT(context->autodetect);
+
+	client->encoder->rttRequested = 0;
+	shadow_encoder_set_rtt(client->encoder, context->autodetect->netCharAverageRTT);
+	return TRUE;
+}
+
+static BOOL shadow_client_bandwidth_measure_results(rdpContext* context, UINT16 sequenceNumber)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context;
+
+	WINPR_UNUSED(sequenceNumber);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(client->encoder);
+	WINPR_ASSERT(context->autodetect);
+
+	shadow_encoder_set_bandwidth(client->encoder, context->autodetect->netCharBandwidth);
+	return TRUE;
+}
+
+/**
+ * Function description
+ * Sends the continuous RTT and bandwidth probes when they are due.
+ *
+ * @return the time in ms until the next probe is due, INFINITE if none
+ */
+static DWORD shadow_client_network_detect(rdpShadowClient* client,
+                                          SHADOW_NETDETECT_STATUS* pStatus)
+{
+	UINT64 now;
+	rdpContext* context = (rdpContext*)client;
+	rdpSettings* settings;
+	rdpAutoDetect* autodetect;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pStatus);
+
+	settings = context->settings;
+	WINPR_ASSERT(settings);
+
+	autodetect = context->autodetect;
+	encoder = client->encoder;
+
+	if (!client->activated || !settings->NetworkAutoDetect || !autodetect || !encoder)
+		return INFINITE;
+
+	now = GetTickCount64();
+
+	if (now >= pStatus->nextRtt)
+	{
+		BOOL rc = FALSE;
+
+		/* An unanswered request is at least as slow as its age */
+		if (encoder->rttRequested)
+			shadow_encoder_set_rtt(encoder, (UINT32)MIN(now - encoder->rttRequested, UINT32_MAX));
+
+		IFCALLRET(autodetect->RTTMeasureRequest, rc, context, pStatus->sequenceNumber++);
+		if (rc)
+			encoder->rttRequested = now;
+
+		pStatus->nextRtt = now + SHADOW_RTT_INTERVAL_MS;
+	}
+
+	if (pStatus->bandwidthStop)
+	{
+		if (now >= pStatus->bandwidthStop)
+		{
+			BOOL rc = FALSE;
+
+			IFCALLRET(autodetect->BandwidthMeasureStop, rc, context, pStatus->sequenceNumber++);
+			if (!rc)
+				WLog_DBG(TAG, "Failed to stop the bandwidth measurement");
+
+			pStatus->bandwidthStop = 0;
+		}
+	}
+	else if (now >= pStatus->nextBandwidth)
+	{
+		BOOL rc = FALSE;
+
+		IFCALLRET(autodetect->BandwidthMeasureStart, rc, context, pStatus->sequenceNumber++);
+		if (rc)
+			pStatus->bandwidthStop = now + SHADOW_BANDWIDTH_WINDOW_MS;
+
+		pStatus->nextBandwidth = now + SHADOW_BANDWIDTH_INTERVAL_MS;
+	}
+
+	return SHADOW_NETDETECT_TICK_MS;
+}
+
+static BOOL shadow_client_log_metric(void* custom, const char* line)
+{
+	WINPR_UNUSED(custom);
+	WLog_DBG(TAG, "%s", line);
+	return TRUE;
+}
+
+/**
+ * Frames are encoded on a thread of their own, the client thread keeps handling input,
+ * acknowledges and channel traffic meanwhile. Graphics pipeline output is queued to the
+ * virtual channel manager and sent by the client thread, the encode thread starts on the next
+ * frame while the previous one is still being sent. At most SHADOW_CLIENT_MAX_QUEUED_FRAMES
+ * encoded frames wait to be sent, beyond that the encode thread waits for the client thread.
+ * Updates sent without the graphics pipeline are written by the encode thread under the update
+ * lock.
+ */
+#define SHADOW_CLIENT_MAX_QUEUED_FRAMES 2
+
+typedef struct
+{
+	rdpShadowClient* client;
+	void* subscriber;
+	HANDLE channelEvent;
+	SHADOW_GFX_STATUS* gfxstatus;
+
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE sentEvent; /* set by the client thread once the queued channel data was sent */
+	LONG queued;      /* encoded frames waiting in the virtual channel manager */
+	BOOL deferred;    /* damage was coalesced by the frame pacing and waits to be sent */
+} SHADOW_ENCODE_STAGE;
+
+static BOOL shadow_client_encode_frame(SHADOW_ENCODE_STAGE* stage, BOOL frameUpdate)
+{
+	BOOL rc = TRUE;
+	rdpShadowClient* client = stage->client;
+	rdpUpdate* update = client->context.update;
+	BOOL gfx;
+
+	WINPR_ASSERT(update);
+
+	EnterCriticalSection(&(client->encodeLock));
+	gfx = stage->gfxstatus->gfxOpened;
+	stage->deferred = FALSE;
+
+	/* the fan out is keyed by the surface, not its contents: outside of a frame update the
+	 * entries may still hold the previous frame */
+	client->shareFrames = frameUpdate;
+
+	if (!gfx)
+		rdp_update_lock(update);
+
+	if (client->activated && !client->suppressOutput)
+	{
+		/* Send screen update or resize to this client */
+
+		/* Check resize */
+		if (shadow_client_recalc_desktop_size(client))
+		{
+			/* Screen size changed, do resize */
+			if (gfx)
+				rdp_update_lock(update);
+
+			rc = shadow_client_send_resize(client, stage->gfxstatus);
+
+			if (gfx)
+				rdp_update_unlock(update);
+
+			if (!rc)
+				WLog_ERR(TAG, "Failed to send resize message");
+		}
+		else if (shadow_encoder_frame_delay(client->encoder) > 0)
+		{
+			/* The next frame is not due yet, keep the damage for it */
+			rc = shadow_client_no_surface_update(client, stage->gfxstatus);
+			stage->deferred = TRUE;
+
+			if (!rc)
+				WLog_ERR(TAG, "Failed to handle surface update");
+		}
+		else
+		{
+			/* Send frame */
+			const UINT64 start = GetTickCount64();
+			FREERDP_TRACE_SPAN_BEGIN(span);
+
+			rc = shadow_client_send_surface_update(client, stage->gfxstatus);
+			FREERDP_TRACE_SPAN_END(span, "shadow_send_surface_update");
+
+			if (rc)
+				shadow_encoder_frame_encoded(client->encoder, start);
+			else
+				WLog_ERR(TAG, "Failed to send surface update");
+		}
+	}
+	else
+	{
+		/* Our client don't receive graphic updates. Just save the invalid region */
+		rc = shadow_client_no_surface_update(client, stage->gfxstatus);
+
+		if (!rc)
+			WLog_ERR(TAG, "Failed to handle surface update");
+	}
+
+	if (!gfx)
+		rdp_update_unlock(update);
+
+	LeaveCriticalSection(&(client->encodeLock));
+
+	/* count the frame only if its data is still waiting to be sent */
+	if (gfx && (WaitForSingleObject(stage->channelEvent, 0) == WAIT_OBJECT_0))
+		InterlockedIncrement(&stage->queued);
+
+	return rc;
+}
+
+static DWORD WINAPI shadow_client_encode_thread(LPVOID arg)
+{
+	SHADOW_ENCODE_STAGE* stage = (SHADOW_ENCODE_STAGE*)arg;
+	HANDLE updateEvents[2];
+	HANDLE sentEvents[2];
+
+	WINPR_ASSERT(stage);
+
+	updateEvents[0] = stage->stopEvent;
+	updateEvents[1] = shadow_multiclient_getevent(stage->subscriber);
+	sentEvents[0] = stage->stopEvent;
+	sentEvents[1] = stage->sentEvent;
+
+	while (1)
+	{
+		BOOL rc;
+		DWORD status;
+		DWORD timeout = INFINITE;
+
+		/* coalesced damage is sent once the frame is due, even if the screen stays unchanged */
+		if (stage->deferred)
+			timeout = MAX(shadow_encoder_frame_delay(stage->client->encoder), 1);
+
+		status = WaitForMultipleObjects(ARRAYSIZE(updateEvents), updateEvents, FALSE, timeout);
+
+		if ((status != WAIT_TIMEOUT) && (status != WAIT_OBJECT_0 + 1))
+			break;
+
+		for (;;)
+		{
+			/* reset before checking, the client thread clears queued before setting it */
+			ResetEvent(stage->sentEvent);
+
+			if (InterlockedCompareExchange(&stage->queued, 0, 0) < SHADOW_CLIENT_MAX_QUEUED_FRAMES)
+				break;
+
+			if (WaitForMultipleObjects(ARRAYSIZE(sentEvents), sentEvents, FALSE, INFINITE) !=
+			    WAIT_OBJECT_0 + 1)
+				goto out;
+		}
+
+		/* The UpdateEvent means to start sending current frame. It is
+		 * triggered from subsystem implementation and it should ensure
+		 * that the screen and primary surface meta data (width, height,
+		 * scanline, invalid region, etc) is not changed until it is reset
+		 * (at shadow_multiclient_consume). As best practice, subsystem
+		 * implementation should invoke shadow_subsystem_frame_update which
+		 * triggers the event and then wait for completion */
+		rc = shadow_client_encode_frame(stage, status != WAIT_TIMEOUT);
+
+		/*
+		 * The return value of shadow_multiclient_consume is whether or not
+		 * the subscriber really consumes the event. It's not cared currently.
+		 */
+		if (status != WAIT_TIMEOUT)
+			(void)shadow_multiclient_consume(stage->subscriber);
+
+		if (!rc)
+			break;
+	}
+
+out:
+	ExitThread(0);
+	return 0;
+}
+
+static BOOL shadow_client_encode_stage_start(SHADOW_ENCODE_STAGE* stage)
+{
+	WINPR_ASSERT(stage);
+
+	stage->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	stage->sentEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!stage->stopEvent || !stage->sentEvent)
+		return FALSE;
+
+	stage->thread = CreateThread(NULL, 0, shadow_client_encode_thread, stage, 0, NULL);
+	return stage->thread != NULL;
+}
+
+static void shadow_client_encode_stage_stop(SHADOW_ENCODE_STAGE* stage)
+{
+	WINPR_ASSERT(stage);
+
+	if (stage->thread)
+	{
+		SetEvent(stage->stopEvent);
+		WaitForSingleObject(stage->thread, INFINITE);
+		CloseHandle(stage->thread);
+		stage->thread = NULL;
+	}
+
+	if (stage->stopEvent)
+		CloseHandle(stage->stopEvent);
+
+	if (stage->sentEvent)
+		CloseHandle(stage->sentEvent);
+
+	stage->stopEvent = NULL;
+	stage->sentEvent = NULL;
+}
+
 static DWORD WINAPI shadow_client_thread(LPVOID arg)
 {
 	rdpShadowClient* client = (rdpShadowClient*)arg;
@@ -2046,9 +3370,9 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	wMessage pointerAlphaMsg;
 	wMessage audioVolumeMsg;
 	HANDLE events[32] = { 0 };
+	WINPR_WAIT_SET* waitSet = NULL;
 	HANDLE ChannelEvent;
 	void* UpdateSubscriber;
-	HANDLE UpdateEvent;
 	freerdp_peer* peer;
 	rdpContext* context;
 	rdpSettings* settings;
@@ -2057,6 +3381,9 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	wMessageQueue* MsgQueue;
 	/* This should only be visited in client thread */
 	SHADOW_GFX_STATUS gfxstatus = { 0 };
+	SHADOW_NETDETECT_STATUS netstatus = { 0 };
+	SHADOW_ENCODE_STAGE stage = { 0 };
+	DWORD timeout = INFINITE;
 
 	WINPR_ASSERT(client);
 
@@ -2088,6 +3415,10 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	peer->update->SuppressOutput = shadow_client_suppress_output;
 	peer->update->SurfaceFrameAcknowledge = shadow_client_surface_frame_acknowledge;
 
+	WINPR_ASSERT(context->autodetect);
+	context->autodetect->RTTMeasureResponse = shadow_client_rtt_measure_response;
+	context->autodetect->BandwidthMeasureResults = shadow_client_bandwidth_measure_results;
+
 	if ((!client->vcm) || (!subsystem->updateEvent))
 		goto out;
 
@@ -2096,9 +3427,6 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	if (!UpdateSubscriber)
 		goto out;
 
-	UpdateEvent = shadow_multiclient_getevent(UpdateSubscriber);
-	WINPR_ASSERT(UpdateEvent);
-
 	ChannelEvent = WTSVirtualChannelManagerGetEventHandle(client->vcm);
 	WINPR_ASSERT(ChannelEvent);
 
@@ -2109,10 +3437,26 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	rc = freerdp_settings_set_bool(settings, FreeRDP_HasExtendedMouseEvent, TRUE);
 	WINPR_ASSERT(rc);
 
+	/* the handles rarely change, keep them registered between iterations */
+	waitSet = winpr_WaitSetNew();
+	if (!waitSet)
+		goto fail;
+
+	stage.client = client;
+	stage.subscriber = UpdateSubscriber;
+	stage.channelEvent = ChannelEvent;
+	stage.gfxstatus = &gfxstatus;
+
+	if (!shadow_client_encode_stage_start(&stage))
+	{
+		WLog_ERR(TAG, "Failed to start the encode thread");
+		goto fail;
+	}
+
 	while (1)
 	{
 		nCount = 0;
-		events[nCount++] = UpdateEvent;
+		events[nCount++] = stage.thread;
 		{
 			DWORD tmp = peer->GetEventHandles(peer, &events[nCount], 64 - nCount);
 
@@ -2126,60 +3470,22 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 		}
 		events[nCount++] = ChannelEvent;
 		events[nCount++] = MessageQueue_Event(MsgQueue);
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
 
-		if (status == WAIT_FAILED)
+		if (!winpr_WaitSetUpdate(waitSet, nCount, events))
 			goto fail;
 
-		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
-		{
-			/* The UpdateEvent means to start sending current frame. It is
-			 * triggered from subsystem implementation and it should ensure
-			 * that the screen and primary surface meta data (width, height,
-			 * scanline, invalid region, etc) is not changed until it is reset
-			 * (at shadow_multiclient_consume). As best practice, subsystem
-			 * implementation should invoke shadow_subsystem_frame_update which
-			 * triggers the event and then wait for completion */
-			if (client->activated && !client->suppressOutput)
-			{
-				/* Send screen update or resize to this client */
+		status = winpr_WaitSetWait(waitSet, timeout);
 
-				/* Check resize */
-				if (shadow_client_recalc_desktop_size(client))
-				{
-					/* Screen size changed, do resize */
-					if (!shadow_client_send_resize(client, &gfxstatus))
-					{
-						WLog_ERR(TAG, "Failed to send resize message");
-						break;
-					}
-				}
-				else
-				{
-					/* Send frame */
-					if (!shadow_client_send_surface_update(client, &gfxstatus))
-					{
-						WLog_ERR(TAG, "Failed to send surface update");
-						break;
-					}
-				}
-			}
-			else
-			{
-				/* Our client don't receive graphic updates. Just save the invalid region */
-				if (!shadow_client_no_surface_update(client, &gfxstatus))
-				{
-					WLog_ERR(TAG, "Failed to handle surface update");
-					break;
-				}
-			}
+		if (status == WAIT_FAILED)
+			goto fail;
 
-			/*
-			 * The return value of shadow_multiclient_consume is whether or not
-			 * the subscriber really consumes the event. It's not cared currently.
-			 */
-			(void)shadow_multiclient_consume(UpdateSubscriber);
-		}
+		/* the encode thread only stops on failure */
+		if (WaitForSingleObject(stage.thread, 0) == WAIT_OBJECT_0)
+			goto fail;
+
+		rdp_update_lock(peer->context->update);
+		timeout = shadow_client_network_detect(client, &netstatus);
+		rdp_update_unlock(peer->context->update);
 
 		WINPR_ASSERT(peer->CheckFileDescriptor);
 		if (!peer->CheckFileDescriptor(peer))
@@ -2217,12 +3523,17 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 						}
 
 						/* Init RDPGFX dynamic channel */
+						EnterCriticalSection(&(client->encodeLock));
+
 						if (settings->SupportGraphicsPipeline && client->rdpgfx &&
 						    !gfxstatus.gfxOpened)
 						{
 							client->rdpgfx->FrameAcknowledge =
 							    shadow_client_rdpgfx_frame_acknowledge;
 							client->rdpgfx->CapsAdvertise = shadow_client_rdpgfx_caps_advertise;
+							client->rdpgfx->CacheImportOffer =
+							    shadow_client_rdpgfx_cache_import_offer;
+							shadow_gfxcache_reset(client);
 
 							if (!client->rdpgfx->Open(client->rdpgfx))
 							{
@@ -2236,6 +3547,8 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 							}
 						}
 
+						LeaveCriticalSection(&(client->encodeLock));
+
 						break;
 
 					default:
@@ -2251,6 +3564,10 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 				WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
 				goto fail;
 			}
+
+			/* the queued frames are sent, let the encode thread continue */
+			InterlockedExchange(&stage.queued, 0);
+			SetEvent(stage.sentEvent);
 		}
 
 		if (WaitForSingleObject(MessageQueue_Event(MsgQueue), 0) == WAIT_OBJECT_0)
@@ -2326,6 +3643,7 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	}
 
 fail:
+	shadow_client_encode_stage_stop(&stage);
 
 	/* Free channels early because we establish channels in post connect */
 	if (client->audin && !IFCALLRESULT(TRUE, client->audin->IsOpen, client->audin))
@@ -2363,7 +3681,15 @@ fail:
 		subsystem->ClientDisconnect(subsystem, client);
 	}
 
+	if (WLog_IsLevelActive(WLog_Get(TAG), WLOG_DEBUG))
+	{
+		char labels[128] = { 0 };
+		_snprintf(labels, sizeof(labels), "client=\"%s\"", peer->hostname);
+		metrics_export(peer->context->metrics, labels, shadow_client_log_metric, NULL);
+	}
+
 out:
+	winpr_WaitSetFree(waitSet);
 	WINPR_ASSERT(peer->Disconnect);
 	peer->Disconnect(peer);
 	freerdp_peer_context_free(peer);
@@ -19,6 +19,7 @@
 #include <freerdp/config.h>
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "shadow.h"
 
@@ -26,10 +27,24 @@
 
 #define TAG CLIENT_TAG("shadow")
 
+#define SHADOW_ENCODER_HASH_BASIS 0xCBF29CE484222325ULL
+#define SHADOW_ENCODER_HASH_PRIME 0x100000001B3ULL
+
+/* share of the measured bandwidth frames may use, in percent */
+#define SHADOW_BANDWIDTH_SHARE 80
+#define SHADOW_MAX_ACK_WINDOW 8
+#define SHADOW_MAX_RFX_QUANT_OFFSET 6
+#define SHADOW_MIN_H264_BITRATE 100000
+
+/* frame pacing limits */
+#define SHADOW_MAX_FRAME_INTERVAL 1000
+#define SHADOW_MAX_QUEUE_DEPTH 2
+#define SHADOW_ACK_RTT_SLACK 20
+
 UINT32 shadow_encoder_preferred_fps(rdpShadowEncoder* encoder)
 {
-	/* Return preferred fps calculated according to the last
-	 * sent frame id and last client-acknowledged frame id.
+	/* Return preferred fps derived from the frame interval of
+	 * the pacing, see shadow_encoder_pace.
 	 */
 	return encoder->fps;
 }
@@ -51,30 +66,415 @@ UINT32 shadow_encoder_inflight_frames(rdpShadowEncoder* encoder)
 UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 {
 	UINT32 frameId;
-	UINT32 inFlightFrames = shadow_encoder_inflight_frames(encoder);
+	const UINT64 bytesOut =
+	    metrics_counter_get(encoder->client->context.metrics, FREERDP_METRIC_BYTES_OUT);
+
+	/* Everything sent since the last frame is accounted to it */
+	if (encoder->lastBytesOut > 0)
+	{
+		const UINT64 delta = bytesOut - encoder->lastBytesOut;
+		encoder->frameBytes =
+		    (encoder->frameBytes > 0) ? (encoder->frameBytes * 7 + delta) / 8 : delta;
+	}
+	encoder->lastBytesOut = bytesOut;
+
+	frameId = ++encoder->frameId;
+	return frameId;
+}
+
+static void shadow_encoder_set_quant_offset(rdpShadowEncoder* encoder, UINT32 quantOffset)
+{
+	if (quantOffset == encoder->rfxQuantOffset)
+		return;
+
+	encoder->rfxQuantOffset = quantOffset;
+
+	if (encoder->rfx)
+		rfx_context_set_quantization_offset(encoder->rfx, encoder->rfxQuantOffset);
+}
+
+/**
+ * Frames are congested if more are in flight than a round trip carries, if the client reports
+ * a decoder queue or if acknowledges take longer than on an idle link.
+ */
+static BOOL shadow_encoder_congested(rdpShadowEncoder* encoder)
+{
+	const UINT32 queueDepth = encoder->queueDepth;
+
+	if (shadow_encoder_inflight_frames(encoder) > MAX(encoder->ackWindow, 1))
+		return TRUE;
+
+	if ((queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT) && (queueDepth > SHADOW_MAX_QUEUE_DEPTH))
+		return TRUE;
+
+	return (encoder->ackRttMin > 0) &&
+	       (encoder->ackRtt > 2 * encoder->ackRttMin + SHADOW_ACK_RTT_SLACK);
+}
+
+/**
+ * Picks the interval to the next frame after a frame was sent. Congestion doubles the interval
+ * and lowers the RemoteFX quality, without it the interval shrinks back towards the lowest one
+ * the frame rate limit, the bandwidth and the encode time allow. Damage reported before the
+ * next frame is due is coalesced, the client gets the newest content instead of a backlog.
+ */
+static void shadow_encoder_pace(rdpShadowEncoder* encoder)
+{
+	UINT32 interval = 1000 / MAX(encoder->maxFps, 1);
+
+	if (encoder->fpsLimit > 0)
+		interval = MAX(interval, 1000 / encoder->fpsLimit);
+
+	interval = MAX(interval, encoder->encodeTime);
+
+	if (shadow_encoder_congested(encoder))
+	{
+		encoder->frameInterval = MAX(encoder->frameInterval * 2, interval);
+
+		if ((encoder->frameInterval >= 2 * interval) &&
+		    (encoder->rfxQuantOffset < SHADOW_MAX_RFX_QUANT_OFFSET))
+			shadow_encoder_set_quant_offset(encoder, encoder->rfxQuantOffset + 1);
+	}
+	else
+	{
+		encoder->frameInterval -= MAX(encoder->frameInterval / 4, 1);
+
+		if (encoder->frameInterval <= interval)
+		{
+			encoder->frameInterval = interval;
+
+			/* the bandwidth may still ask for the lower quality, see shadow_encoder_adapt */
+			if ((encoder->rfxQuantOffset > 0) &&
+			    ((encoder->fpsLimit == 0) || (encoder->fpsLimit >= encoder->maxFps)))
+				shadow_encoder_set_quant_offset(encoder, encoder->rfxQuantOffset - 1);
+		}
+	}
+
+	encoder->frameInterval = MIN(encoder->frameInterval, SHADOW_MAX_FRAME_INTERVAL);
+	encoder->fps = MAX(1000 / MAX(encoder->frameInterval, 1), 1);
+
+	if (encoder->fps > encoder->maxFps)
+		encoder->fps = encoder->maxFps;
+}
+
+void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId,
+                                       UINT32 queueDepth)
+{
+	const UINT32 slot = frameId % SHADOW_ENCODER_FRAME_SLOTS;
+
+	WINPR_ASSERT(encoder);
 
 	/*
-	 * Calculate preferred fps according to how much frames are
-	 * in-progress. Note that it only works when subsytem implementation
-	 * calls shadow_encoder_preferred_fps and takes the suggestion.
+	 * Record the last client acknowledged frame id to
+	 * calculate how much frames are in progress.
+	 * Some rdp clients (win7 mstsc) skips frame ACK if it is
+	 * inactive, we should not expect ACK for each frame.
+	 * So it is OK to calculate inflight frame count according to
+	 * a latest acknowledged frame id.
 	 */
-	if (inFlightFrames > 1)
+	encoder->lastAckframeId = frameId;
+	encoder->queueDepth = queueDepth;
+
+	/* frames overwritten by newer ones in the meantime are not timed */
+	if ((frameId != 0) && (encoder->frameSentId[slot] == frameId))
 	{
-		encoder->fps = (100 / (inFlightFrames + 1) * encoder->maxFps) / 100;
+		const UINT64 now = GetTickCount64();
+		const UINT32 rtt = (UINT32)MIN(now - encoder->frameSent[slot], UINT32_MAX);
+
+		encoder->frameSentId[slot] = 0;
+		encoder->ackRtt = (encoder->ackRtt > 0) ? (encoder->ackRtt * 7 + rtt) / 8 : rtt;
+
+		if ((encoder->ackRttMin == 0) || (rtt < encoder->ackRttMin))
+			encoder->ackRttMin = MAX(rtt, 1);
 	}
-	else
+}
+
+/**
+ * Called once a frame was handed to the transport, start is the time encoding began.
+ */
+void shadow_encoder_frame_encoded(rdpShadowEncoder* encoder, UINT64 start)
+{
+	UINT64 now;
+	UINT32 elapsed;
+	UINT32 frameId;
+
+	WINPR_ASSERT(encoder);
+	frameId = encoder->frameId;
+
+	/* no frame was created, nothing was encoded */
+	if (frameId == encoder->lastSentFrameId)
+		return;
+
+	now = GetTickCount64();
+	elapsed = (UINT32)MIN(now - start, SHADOW_MAX_FRAME_INTERVAL);
+	encoder->lastSentFrameId = frameId;
+	encoder->frameSent[frameId % SHADOW_ENCODER_FRAME_SLOTS] = now;
+	encoder->frameSentId[frameId % SHADOW_ENCODER_FRAME_SLOTS] = frameId;
+	encoder->encodeTime =
+	    (encoder->encodeTime > 0) ? (encoder->encodeTime * 7 + elapsed) / 8 : elapsed;
+
+	shadow_encoder_pace(encoder);
+	encoder->nextFrame = start + encoder->frameInterval;
+}
+
+/**
+ * @return the time in ms until the next frame is due, 0 if it may be sent now
+ */
+UINT32 shadow_encoder_frame_delay(rdpShadowEncoder* encoder)
+{
+	const UINT64 now = GetTickCount64();
+
+	WINPR_ASSERT(encoder);
+
+	if (now >= encoder->nextFrame)
+		return 0;
+
+	return (UINT32)(encoder->nextFrame - now);
+}
+
+static void shadow_encoder_apply_h264_bitrate(rdpShadowEncoder* encoder)
+{
+	UINT64 bitRate;
+
+	if (!encoder->h264 || (encoder->bandwidth == 0))
+		return;
+
+	bitRate = encoder->bandwidth * 1000ull * SHADOW_BANDWIDTH_SHARE / 100;
+	bitRate = MIN(bitRate, encoder->server->h264BitRate);
+	encoder->h264->BitRate = (UINT32)MAX(bitRate, SHADOW_MIN_H264_BITRATE);
+}
+
+/* Derives the frame acknowledge window, the fps limit and the codec quality from the
+ * network state */
+static void shadow_encoder_adapt(rdpShadowEncoder* encoder)
+{
+	UINT64 budget;
+	UINT64 fpsLimit;
+	const UINT32 quantOffset = encoder->rfxQuantOffset;
+
+	/* the frames a round trip keeps in flight at the maximum frame rate */
+	encoder->ackWindow = 1 + (encoder->rtt * encoder->maxFps + 999) / 1000;
+	if (encoder->ackWindow > SHADOW_MAX_ACK_WINDOW)
+		encoder->ackWindow = SHADOW_MAX_ACK_WINDOW;
+
+	if ((encoder->bandwidth == 0) || (encoder->frameBytes == 0))
+		return;
+
+	budget = encoder->bandwidth * 1000ull / 8 * SHADOW_BANDWIDTH_SHARE / 100;
+	fpsLimit = budget / encoder->frameBytes;
+	encoder->fpsLimit = (UINT32)MAX(MIN(fpsLimit, encoder->maxFps), 1);
+
+	/* Trade RemoteFX quality for frame rate when the link can not carry half the maximum
+	 * rate, go back once it carries the full rate */
+	if ((fpsLimit < encoder->maxFps / 2) &&
+	    (encoder->rfxQuantOffset < SHADOW_MAX_RFX_QUANT_OFFSET))
+		shadow_encoder_set_quant_offset(encoder, quantOffset + 1);
+	else if ((fpsLimit >= encoder->maxFps) && (encoder->rfxQuantOffset > 0))
+		shadow_encoder_set_quant_offset(encoder, quantOffset - 1);
+
+	shadow_encoder_apply_h264_bitrate(encoder);
+
+	WLog_DBG(TAG,
+	         "rtt=%" PRIu32 "ms bandwidth=%" PRIu32 "kbit/s frame=%" PRIu64
+	         " bytes -> window=%" PRIu32 " fps<=%" PRIu32 " rfx quant +%" PRIu32,
+	         encoder->rtt, encoder->bandwidth, encoder->frameBytes, encoder->ackWindow,
+	         encoder->fpsLimit, encoder->rfxQuantOffset);
+}
+
+void shadow_encoder_set_rtt(rdpShadowEncoder* encoder, UINT32 rtt)
+{
+	WINPR_ASSERT(encoder);
+
+	encoder->rtt = (encoder->rtt > 0) ? (encoder->rtt * 7 + rtt) / 8 : rtt;
+	shadow_encoder_adapt(encoder);
+}
+
+void shadow_encoder_set_bandwidth(rdpShadowEncoder* encoder, UINT32 bandwidth)
+{
+	WINPR_ASSERT(encoder);
+
+	/*
+	 * Continuous detection measures the traffic the server sent, an idle session
+	 * measures low. Only trust a lower value if frames queued up meanwhile.
+	 */
+	if ((bandwidth >= encoder->bandwidth) ||
+	    (shadow_encoder_inflight_frames(encoder) > MAX(encoder->ackWindow, 1)))
+		encoder->bandwidth = bandwidth;
+
+	shadow_encoder_adapt(encoder);
+}
+
+/**
+ * The copy of the last sent frame is allocated on first use, only the update paths that skip
+ * or move content need it.
+ */
+BOOL shadow_encoder_prepare_last_frame(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	if (encoder->lastFrame)
+		return TRUE;
+
+	encoder->lastFrame = (BYTE*)calloc(encoder->width * 4ULL, encoder->height);
+	encoder->lastFrameValid = FALSE;
+	return encoder->lastFrame != NULL;
+}
+
+BOOL shadow_encoder_last_frame_equal(rdpShadowEncoder* encoder, const BYTE* pSrcData,
+                                     UINT32 nSrcStep, const RECTANGLE_16* rect)
+{
+	UINT32 y;
+	const size_t step = encoder->width * 4ULL;
+	const size_t length = (rect->right - rect->left) * 4ULL;
+
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+
+	if (!encoder->lastFrameValid || (rect->right > encoder->width) ||
+	    (rect->bottom > encoder->height))
+		return FALSE;
+
+	for (y = rect->top; y < rect->bottom; y++)
+	{
+		if (memcmp(&pSrcData[y * nSrcStep + rect->left * 4ULL],
+		           &encoder->lastFrame[y * step + rect->left * 4ULL], length) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+UINT64 shadow_encoder_tile_key(const BYTE* pSrcData, UINT32 nSrcStep, const RECTANGLE_16* rect)
+{
+	UINT32 x, y;
+	const UINT32 width = rect->right - rect->left;
+	const UINT32 height = rect->bottom - rect->top;
+	UINT64 key = SHADOW_ENCODER_HASH_BASIS ^ (((UINT64)width << 16) | height);
+
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+
+	for (y = rect->top; y < rect->bottom; y++)
 	{
-		encoder->fps += 2;
+		const UINT32* pixel = (const UINT32*)&pSrcData[y * nSrcStep + rect->left * 4ULL];
 
-		if (encoder->fps > encoder->maxFps)
-			encoder->fps = encoder->maxFps;
+		for (x = 0; x < width; x++)
+			key = (key ^ pixel[x]) * SHADOW_ENCODER_HASH_PRIME;
 	}
 
-	if (encoder->fps < 1)
-		encoder->fps = 1;
+	/* 0 marks unused cache entries */
+	return key ? key : 1;
+}
+
+void shadow_encoder_move_last_frame(rdpShadowEncoder* encoder, const RECTANGLE_16* src, INT32 dx,
+                                    INT32 dy)
+{
+	INT32 y;
+	const size_t step = encoder->width * 4ULL;
+	const size_t length = (src->right - src->left) * 4ULL;
+	const INT32 height = src->bottom - src->top;
+	BYTE* data;
 
-	frameId = ++encoder->frameId;
-	return frameId;
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(encoder->lastFrame);
+
+	data = &encoder->lastFrame[src->top * step + src->left * 4ULL];
+
+	/* copy in the direction that does not overwrite rows still to be moved */
+	for (y = 0; y < height; y++)
+	{
+		const INT32 row = (dy > 0) ? height - 1 - y : y;
+		BYTE* from = &data[row * step];
+		MoveMemory(&from[dy * (INT64)step + dx * 4LL], from, length);
+	}
+}
+
+/**
+ * Finds the part of rect that moved since the last frame sent to the client. A move reported by
+ * the capture is taken if the client shows its source content, otherwise the frames are searched
+ * for scrolled content.
+ *
+ * @return TRUE if src moved by dx, dy is found
+ */
+BOOL shadow_encoder_find_move(rdpShadowEncoder* encoder, const BYTE* pSrcData, UINT32 nSrcStep,
+                              const RECTANGLE_16* rect, RECTANGLE_16* src, INT32* dx, INT32* dy)
+{
+	const size_t step = encoder->width * 4ULL;
+
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+
+	if (!encoder->lastFrameValid)
+		return FALSE;
+
+	if (encoder->moveValid)
+	{
+		const RECTANGLE_16* move = &encoder->moveSrc;
+		const INT64 left = 1LL * move->left + encoder->moveDx;
+		const INT64 top = 1LL * move->top + encoder->moveDy;
+		const INT64 right = 1LL * move->right + encoder->moveDx;
+		const INT64 bottom = 1LL * move->bottom + encoder->moveDy;
+
+		if ((move->right > move->left) && (move->bottom > move->top) &&
+		    (move->right <= encoder->width) && (move->bottom <= encoder->height) &&
+		    (left >= rect->left) && (top >= rect->top) && (right <= rect->right) &&
+		    (bottom <= rect->bottom) && (right <= encoder->width) && (bottom <= encoder->height))
+		{
+			UINT32 y;
+			const size_t length = (move->right - move->left) * 4ULL;
+
+			for (y = 0; y < (UINT32)(move->bottom - move->top); y++)
+			{
+				if (memcmp(&pSrcData[(top + y) * nSrcStep + left * 4],
+				           &encoder->lastFrame[(move->top + y) * step + move->left * 4ULL],
+				           length) != 0)
+					break;
+			}
+
+			if (y == (UINT32)(move->bottom - move->top))
+			{
+				*src = *move;
+				*dx = encoder->moveDx;
+				*dy = encoder->moveDy;
+				return TRUE;
+			}
+		}
+	}
+
+	return shadow_capture_find_scroll(pSrcData, nSrcStep, encoder->lastFrame, (UINT32)step, rect,
+	                                  src, dx, dy);
+}
+
+void shadow_encoder_update_last_frame(rdpShadowEncoder* encoder, const BYTE* pSrcData,
+                                      UINT32 nSrcStep, const RECTANGLE_16* rect)
+{
+	UINT32 y;
+	UINT32 right, bottom;
+	const size_t step = encoder->width * 4ULL;
+
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+
+	if (!encoder->lastFrame)
+		return;
+
+	right = MIN(rect->right, encoder->width);
+	bottom = MIN(rect->bottom, encoder->height);
+
+	if (right <= rect->left)
+		return;
+
+	for (y = rect->top; y < bottom; y++)
+		CopyMemory(&encoder->lastFrame[y * step + rect->left * 4ULL],
+		           &pSrcData[y * nSrcStep + rect->left * 4ULL], (right - rect->left) * 4ULL);
+
+	/* until then parts of the copy might not match what the client shows */
+	if ((rect->left == 0) && (rect->top == 0) && (right == encoder->width) &&
+	    (bottom == encoder->height))
+		encoder->lastFrameValid = TRUE;
 }
 
 static int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
@@ -128,6 +528,12 @@ static int shadow_encoder_uninit_grid(rdpShadowEncoder* encoder)
 	return 0;
 }
 
+static void shadow_encoder_count(rdpShadowEncoder* encoder, INT64 contexts)
+{
+	rdpContext* context = (rdpContext*)encoder->client;
+	metrics_gauge_add(context->metrics, FREERDP_METRIC_CODEC_CONTEXTS, contexts);
+}
+
 static int shadow_encoder_init_rfx(rdpShadowEncoder* encoder)
 {
 	if (!encoder->rfx)
@@ -141,10 +547,21 @@ static int shadow_encoder_init_rfx(rdpShadowEncoder* encoder)
 
 	encoder->rfx->mode = encoder->server->rfxMode;
 	rfx_context_set_pixel_format(encoder->rfx, PIXEL_FORMAT_BGRX32);
+
+	/* all clients show the same screen, tiles encoded for one are reused by the others */
+	if (!rfx_context_set_shared_tile_cache(encoder->rfx, TRUE))
+		goto fail;
+
+	if ((encoder->rfxQuantOffset > 0) &&
+	    !rfx_context_set_quantization_offset(encoder->rfx, encoder->rfxQuantOffset))
+		goto fail;
+
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_REMOTEFX;
 	return 1;
 fail:
 	rfx_context_free(encoder->rfx);
+	encoder->rfx = NULL;
 	return -1;
 }
 
@@ -173,10 +590,12 @@ static int shadow_encoder_init_nsc(rdpShadowEncoder* encoder)
 		goto fail;
 	if (!nsc_context_set_parameters(encoder->nsc, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32))
 		goto fail;
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_NSCODEC;
 	return 1;
 fail:
 	nsc_context_free(encoder->nsc);
+	encoder->nsc = NULL;
 	return -1;
 }
 
@@ -204,10 +623,12 @@ static int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 	                                         encoder->maxTileHeight))
 		goto fail;
 
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_PLANAR;
 	return 1;
 fail:
 	freerdp_bitmap_planar_context_free(encoder->planar);
+	encoder->planar = NULL;
 	return -1;
 }
 
@@ -222,10 +643,12 @@ static int shadow_encoder_init_interleaved(rdpShadowEncoder* encoder)
 	if (!bitmap_interleaved_context_reset(encoder->interleaved))
 		goto fail;
 
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_INTERLEAVED;
 	return 1;
 fail:
 	bitmap_interleaved_context_free(encoder->interleaved);
+	encoder->interleaved = NULL;
 	return -1;
 }
 
@@ -244,11 +667,14 @@ static int shadow_encoder_init_h264(rdpShadowEncoder* encoder)
 	encoder->h264->BitRate = encoder->server->h264BitRate;
 	encoder->h264->FrameRate = encoder->server->h264FrameRate;
 	encoder->h264->QP = encoder->server->h264QP;
+	shadow_encoder_apply_h264_bitrate(encoder);
 
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444;
 	return 1;
 fail:
 	h264_context_free(encoder->h264);
+	encoder->h264 = NULL;
 	return -1;
 }
 
@@ -256,7 +682,8 @@ static int shadow_encoder_init_progressive(rdpShadowEncoder* encoder)
 {
 	WINPR_ASSERT(encoder);
 	if (!encoder->progressive)
-		encoder->progressive = progressive_context_new(TRUE);
+		encoder->progressive =
+		    progressive_context_new_ex(TRUE, encoder->server->settings->ThreadingFlags);
 
 	if (!encoder->progressive)
 		goto fail;
@@ -264,17 +691,41 @@ static int shadow_encoder_init_progressive(rdpShadowEncoder* encoder)
 	if (!progressive_context_reset(encoder->progressive))
 		goto fail;
 
+	shadow_encoder_count(encoder, 1);
 	encoder->codecs |= FREERDP_CODEC_PROGRESSIVE;
 	return 1;
 fail:
 	progressive_context_free(encoder->progressive);
+	encoder->progressive = NULL;
+	return -1;
+}
+
+static int shadow_encoder_init_clear(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	if (!encoder->clear)
+		encoder->clear = clear_context_new(TRUE);
+
+	if (!encoder->clear)
+		goto fail;
+
+	if (!clear_context_reset(encoder->clear))
+		goto fail;
+
+	shadow_encoder_count(encoder, 1);
+	encoder->codecs |= FREERDP_CODEC_CLEARCODEC;
+	return 1;
+fail:
+	clear_context_free(encoder->clear);
+	encoder->clear = NULL;
 	return -1;
 }
 
 static int shadow_encoder_init(rdpShadowEncoder* encoder)
 {
-	encoder->width = encoder->server->screen->width;
-	encoder->height = encoder->server->screen->height;
+	encoder->width = encoder->outputWidth ? encoder->outputWidth : encoder->server->screen->width;
+	encoder->height =
+	    encoder->outputHeight ? encoder->outputHeight : encoder->server->screen->height;
 	encoder->maxTileWidth = 64;
 	encoder->maxTileHeight = 64;
 	shadow_encoder_init_grid(encoder);
@@ -294,6 +745,7 @@ static int shadow_encoder_uninit_rfx(rdpShadowEncoder* encoder)
 	{
 		rfx_context_free(encoder->rfx);
 		encoder->rfx = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_REMOTEFX;
@@ -306,6 +758,7 @@ static int shadow_encoder_uninit_nsc(rdpShadowEncoder* encoder)
 	{
 		nsc_context_free(encoder->nsc);
 		encoder->nsc = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_NSCODEC;
@@ -318,6 +771,7 @@ static int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 	{
 		freerdp_bitmap_planar_context_free(encoder->planar);
 		encoder->planar = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_PLANAR;
@@ -330,6 +784,7 @@ static int shadow_encoder_uninit_interleaved(rdpShadowEncoder* encoder)
 	{
 		bitmap_interleaved_context_free(encoder->interleaved);
 		encoder->interleaved = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_INTERLEAVED;
@@ -342,6 +797,7 @@ static int shadow_encoder_uninit_h264(rdpShadowEncoder* encoder)
 	{
 		h264_context_free(encoder->h264);
 		encoder->h264 = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32) ~(FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444);
@@ -355,15 +811,34 @@ static int shadow_encoder_uninit_progressive(rdpShadowEncoder* encoder)
 	{
 		progressive_context_free(encoder->progressive);
 		encoder->progressive = NULL;
+		shadow_encoder_count(encoder, -1);
 	}
 
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_PROGRESSIVE;
 	return 1;
 }
 
+static int shadow_encoder_uninit_clear(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	if (encoder->clear)
+	{
+		clear_context_free(encoder->clear);
+		encoder->clear = NULL;
+		shadow_encoder_count(encoder, -1);
+	}
+
+	encoder->codecs &= (UINT32)~FREERDP_CODEC_CLEARCODEC;
+	return 1;
+}
+
 static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 {
 	shadow_encoder_uninit_grid(encoder);
+	shadow_orders_uninit(encoder);
+	free(encoder->lastFrame);
+	encoder->lastFrame = NULL;
+	encoder->lastFrameValid = FALSE;
 
 	if (encoder->bs)
 	{
@@ -382,9 +857,33 @@ static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 
 	    shadow_encoder_uninit_progressive(encoder);
 
+	    shadow_encoder_uninit_clear(encoder);
+
 	    return 1;
 }
 
+/**
+ * Frees what the encoder rebuilds on its next frame, the codec contexts and the copy of the last
+ * frame. The first frame after that is encoded from scratch, which is what the client needs
+ * anyway after its output was suppressed.
+ */
+void shadow_encoder_release(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	free(encoder->lastFrame);
+	encoder->lastFrame = NULL;
+	encoder->lastFrameValid = FALSE;
+
+	shadow_encoder_uninit_rfx(encoder);
+	shadow_encoder_uninit_nsc(encoder);
+	shadow_encoder_uninit_planar(encoder);
+	shadow_encoder_uninit_interleaved(encoder);
+	shadow_encoder_uninit_h264(encoder);
+	shadow_encoder_uninit_progressive(encoder);
+	shadow_encoder_uninit_clear(encoder);
+}
+
 int shadow_encoder_reset(rdpShadowEncoder* encoder)
 {
 	int status;
@@ -410,6 +909,10 @@ int shadow_encoder_reset(rdpShadowEncoder* encoder)
 	encoder->maxFps = 32;
 	encoder->frameId = 0;
 	encoder->lastAckframeId = 0;
+	encoder->lastSentFrameId = 0;
+	encoder->frameInterval = 1000 / encoder->maxFps;
+	encoder->nextFrame = 0;
+	ZeroMemory(encoder->frameSentId, sizeof(encoder->frameSentId));
 	encoder->frameAck = settings->SurfaceFrameMarkerEnabled;
 	return 1;
 }
@@ -473,10 +976,20 @@ int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs)
 			return -1;
 	}
 
+	if ((codecs & FREERDP_CODEC_CLEARCODEC) && !(encoder->codecs & FREERDP_CODEC_CLEARCODEC))
+	{
+		WLog_DBG(TAG, "initializing ClearCodec encoder");
+		status = shadow_encoder_init_clear(encoder);
+
+		if (status < 0)
+			return -1;
+	}
+
 	return 1;
 }
 
-rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
+static rdpShadowEncoder* shadow_encoder_new_size(rdpShadowClient* client, UINT32 width,
+                                                 UINT32 height)
 {
 	rdpShadowEncoder* encoder;
 	rdpShadowServer* server = client->server;
@@ -487,6 +1000,8 @@ rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
 
 	encoder->client = client;
 	encoder->server = server;
+	encoder->outputWidth = width;
+	encoder->outputHeight = height;
 	encoder->fps = 16;
 	encoder->maxFps = 32;
 
@@ -499,11 +1014,35 @@ rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
 	return encoder;
 }
 
+rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
+{
+	return shadow_encoder_new_size(client, 0, 0);
+}
+
+/**
+ * Creates the encoder of a graphics pipeline output of width x height pixels, prepared for the
+ * codecs of the client.
+ */
+rdpShadowEncoder* shadow_encoder_new_output(rdpShadowClient* client, UINT32 width, UINT32 height)
+{
+	rdpShadowEncoder* encoder = shadow_encoder_new_size(client, width, height);
+
+	if (encoder && (shadow_encoder_reset(encoder) < 0))
+	{
+		shadow_encoder_free(encoder);
+		return NULL;
+	}
+
+	return encoder;
+}
+
 void shadow_encoder_free(rdpShadowEncoder* encoder)
 {
 	if (!encoder)
 		return;
 
 	shadow_encoder_uninit(encoder);
+	shadow_gfxcache_free(encoder->gfxCache);
+	shadow_classifier_free(encoder->classifier);
 	free(encoder);
 }
@@ -27,6 +27,11 @@
 
 #include <freerdp/server/shadow.h>
 
+#include "shadow_gfxcache.h"
+#include "shadow_classify.h"
+
+#define SHADOW_ENCODER_FRAME_SLOTS 16
+
 struct rdp_shadow_encoder
 {
 	rdpShadowClient* client;
@@ -34,6 +39,8 @@ struct rdp_shadow_encoder
 
 	UINT32 width;
 	UINT32 height;
+	UINT32 outputWidth; /* size of the graphics pipeline output, 0 for the whole screen */
+	UINT32 outputHeight;
 	UINT32 codecs;
 
 	BYTE** grid;
@@ -51,6 +58,7 @@ struct rdp_shadow_encoder
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
 	H264_CONTEXT* h264;
 	PROGRESSIVE_CONTEXT* progressive;
+	CLEAR_CONTEXT* clear;
 
 	UINT32 fps;
 	UINT32 maxFps;
@@ -58,6 +66,44 @@ struct rdp_shadow_encoder
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+
+	/* network state fed by the continuous autodetect of the client thread */
+	UINT32 rtt;            /* smoothed round trip time in ms, 0 until measured */
+	UINT32 bandwidth;      /* bandwidth estimate in kbit/s, 0 until measured */
+	UINT64 rttRequested;   /* send time of the unanswered RTT request, 0 if none */
+	UINT32 ackWindow;      /* frames that may be in flight before the fps is reduced */
+	UINT32 fpsLimit;       /* highest fps the bandwidth allows, 0 if unknown */
+	UINT32 rfxQuantOffset; /* added to the RemoteFX quantization values */
+	UINT64 frameBytes;     /* average number of bytes sent per frame */
+	UINT64 lastBytesOut;
+
+	/* frame pacing driven by the frame acknowledges, see shadow_encoder_pace */
+	UINT64 frameSent[SHADOW_ENCODER_FRAME_SLOTS]; /* time the recent frames were sent in ms */
+	UINT32 frameSentId[SHADOW_ENCODER_FRAME_SLOTS];
+	UINT32 lastSentFrameId;
+	UINT32 ackRtt;        /* smoothed time from sending a frame to its acknowledge in ms */
+	UINT32 ackRttMin;     /* lowest acknowledge time seen, the delay without queueing */
+	UINT32 encodeTime;    /* smoothed time to encode and send a frame in ms */
+	UINT32 frameInterval; /* minimum time between two frames in ms */
+	UINT64 nextFrame;     /* earliest time the next frame is sent, damage is coalesced before */
+
+	BYTE* lastFrame;     /* surface content as last sent to the client */
+	BOOL lastFrameValid; /* FALSE until the whole surface has been sent */
+
+	/* move reported by the capture for the frame being sent, see shadow_encoder_find_move */
+	BOOL moveValid;
+	RECTANGLE_16 moveSrc;
+	INT32 moveDx;
+	INT32 moveDy;
+
+	/* drawing order state of the bitmap update path, see shadow_orders.c */
+	UINT64* cacheKeys; /* tile hash per bitmap cache entry, 0 if unused */
+	UINT32 cacheId;
+	UINT32 cacheEntries;
+	UINT32 cacheNext;
+
+	SHADOW_GFXCACHE* gfxCache;     /* RDPGFX cache slots of the client, see shadow_gfxcache.c */
+	SHADOW_CLASSIFIER* classifier; /* tile content types, see shadow_classify.c */
 };
 
 #ifdef __cplusplus
@@ -67,9 +113,31 @@ extern "C"
 
 	int shadow_encoder_reset(rdpShadowEncoder* encoder);
 	int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs);
+	void shadow_encoder_release(rdpShadowEncoder* encoder);
 	UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder);
+	void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId,
+	                                       UINT32 queueDepth);
+	void shadow_encoder_frame_encoded(rdpShadowEncoder* encoder, UINT64 start);
+	UINT32 shadow_encoder_frame_delay(rdpShadowEncoder* encoder);
+
+	void shadow_encoder_set_rtt(rdpShadowEncoder* encoder, UINT32 rtt);
+	void shadow_encoder_set_bandwidth(rdpShadowEncoder* encoder, UINT32 bandwidth);
+
+	BOOL shadow_encoder_prepare_last_frame(rdpShadowEncoder* encoder);
+	BOOL shadow_encoder_last_frame_equal(rdpShadowEncoder* encoder, const BYTE* pSrcData,
+	                                     UINT32 nSrcStep, const RECTANGLE_16* rect);
+	UINT64 shadow_encoder_tile_key(const BYTE* pSrcData, UINT32 nSrcStep, const RECTANGLE_16* rect);
+	void shadow_encoder_move_last_frame(rdpShadowEncoder* encoder, const RECTANGLE_16* src,
+	                                    INT32 dx, INT32 dy);
+	BOOL shadow_encoder_find_move(rdpShadowEncoder* encoder, const BYTE* pSrcData,
+	                              UINT32 nSrcStep, const RECTANGLE_16* rect, RECTANGLE_16* src,
+	                              INT32* dx, INT32* dy);
+	void shadow_encoder_update_last_frame(rdpShadowEncoder* encoder, const BYTE* pSrcData,
+	                                      UINT32 nSrcStep, const RECTANGLE_16* rect);
 
 	rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client);
+	rdpShadowEncoder* shadow_encoder_new_output(rdpShadowClient* client, UINT32 width,
+	                                            UINT32 height);
 	void shadow_encoder_free(rdpShadowEncoder* encoder);
 
 #ifdef __cplusplus
@@ -0,0 +1,291 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+
+#include "shadow.h"
+
+#include "shadow_fanout.h"
+
+#define TAG SERVER_TAG("shadow")
+
+/**
+ * Encoded frames shared between the clients of a server.
+ *
+ * All clients encode the same surface content between two calls of
+ * shadow_subsystem_frame_update. The first client encoding a frame with a given key publishes
+ * the result, clients with the same codec settings and region send these bytes instead of
+ * running the encoder themselves. A client arriving while the frame is being encoded waits for
+ * it. Frame ids, frame acknowledges and pacing stay per client.
+ */
+
+#define SHADOW_FANOUT_MAX_ENTRIES 16
+
+typedef struct
+{
+	const BYTE* src;
+	UINT32 codecId;
+	UINT32 width;
+	UINT32 height;
+	UINT32 param;
+	BOOL headers;
+	REGION16 region;
+
+	BOOL pending;
+	HANDLE event; /* set once the encoder published the frame */
+	wStream* s;   /* NULL if encoding failed */
+} SHADOW_FANOUT_ENTRY;
+
+struct rdp_shadow_fanout
+{
+	CRITICAL_SECTION lock;
+	wStreamPool* pool;
+	SHADOW_FANOUT_ENTRY entries[SHADOW_FANOUT_MAX_ENTRIES];
+	UINT32 count;
+	UINT64 shared; /* frames sent without encoding */
+	UINT64 encoded;
+};
+
+/* a NULL region, the complete frame, is stored as an empty one */
+static BOOL shadow_fanout_region_equal(const REGION16* a, const REGION16* b)
+{
+	UINT32 numA = 0;
+	UINT32 numB = 0;
+	const RECTANGLE_16* rectsA = region16_rects(a, &numA);
+	const RECTANGLE_16* rectsB = b ? region16_rects(b, &numB) : NULL;
+
+	if (numA != numB)
+		return FALSE;
+
+	return (numA == 0) || (memcmp(rectsA, rectsB, numA * sizeof(RECTANGLE_16)) == 0);
+}
+
+static BOOL shadow_fanout_key_equal(const SHADOW_FANOUT_ENTRY* entry, const SHADOW_FANOUT_KEY* key)
+{
+	if ((entry->src != key->src) || (entry->codecId != key->codecId) ||
+	    (entry->width != key->width) || (entry->height != key->height) ||
+	    (entry->param != key->param) || (entry->headers != key->headers))
+		return FALSE;
+
+	return shadow_fanout_region_equal(&entry->region, key->region);
+}
+
+static SHADOW_FANOUT_ENTRY* shadow_fanout_find(rdpShadowFanout* fanout,
+                                               const SHADOW_FANOUT_KEY* key)
+{
+	UINT32 index;
+
+	for (index = 0; index < fanout->count; index++)
+	{
+		SHADOW_FANOUT_ENTRY* entry = &fanout->entries[index];
+
+		if (shadow_fanout_key_equal(entry, key))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void shadow_fanout_clear(rdpShadowFanout* fanout)
+{
+	UINT32 index;
+
+	for (index = 0; index < fanout->count; index++)
+	{
+		SHADOW_FANOUT_ENTRY* entry = &fanout->entries[index];
+
+		if (entry->s)
+			Stream_Release(entry->s);
+
+		CloseHandle(entry->event);
+		region16_uninit(&entry->region);
+		ZeroMemory(entry, sizeof(SHADOW_FANOUT_ENTRY));
+	}
+
+	fanout->count = 0;
+}
+
+/**
+ * Drops the frames of the previous update, called before the clients are notified of a new one.
+ */
+void shadow_fanout_next_frame(rdpShadowFanout* fanout)
+{
+	if (!fanout)
+		return;
+
+	EnterCriticalSection(&fanout->lock);
+	shadow_fanout_clear(fanout);
+	LeaveCriticalSection(&fanout->lock);
+}
+
+/**
+ * Function description
+ *
+ * @param publish set to TRUE if the caller has to encode the frame and hand the result to
+ *                shadow_fanout_publish
+ *
+ * @return the shared encoded frame, released with Stream_Release, or NULL if the caller has to
+ *         encode it
+ */
+wStream* shadow_fanout_acquire(rdpShadowFanout* fanout, const SHADOW_FANOUT_KEY* key,
+                               BOOL* publish)
+{
+	wStream* s = NULL;
+	SHADOW_FANOUT_ENTRY* entry;
+
+	WINPR_ASSERT(key);
+	WINPR_ASSERT(publish);
+
+	*publish = FALSE;
+
+	if (!fanout)
+		return NULL;
+
+	EnterCriticalSection(&fanout->lock);
+	entry = shadow_fanout_find(fanout, key);
+
+	if (!entry)
+	{
+		if (fanout->count >= SHADOW_FANOUT_MAX_ENTRIES)
+			goto out;
+
+		entry = &fanout->entries[fanout->count];
+		region16_init(&entry->region);
+		entry->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (!entry->event || (key->region && !region16_copy(&entry->region, key->region)))
+		{
+			CloseHandle(entry->event);
+			region16_uninit(&entry->region);
+			ZeroMemory(entry, sizeof(SHADOW_FANOUT_ENTRY));
+			goto out;
+		}
+
+		entry->src = key->src;
+		entry->codecId = key->codecId;
+		entry->width = key->width;
+		entry->height = key->height;
+		entry->param = key->param;
+		entry->headers = key->headers;
+		entry->pending = TRUE;
+		fanout->count++;
+		fanout->encoded++;
+		*publish = TRUE;
+		goto out;
+	}
+
+	if (entry->pending)
+	{
+		/* entries are only dropped by shadow_fanout_next_frame once all clients are done */
+		HANDLE event = entry->event;
+		LeaveCriticalSection(&fanout->lock);
+		WaitForSingleObject(event, INFINITE);
+		EnterCriticalSection(&fanout->lock);
+	}
+
+	s = entry->s;
+
+	if (s)
+	{
+		Stream_AddRef(s);
+		fanout->shared++;
+	}
+
+out:
+	LeaveCriticalSection(&fanout->lock);
+	return s;
+}
+
+/**
+ * Hands the encoded frame to the clients waiting for it, data is NULL if encoding failed.
+ * Must be called whenever shadow_fanout_acquire asked for it.
+ */
+void shadow_fanout_publish(rdpShadowFanout* fanout, const SHADOW_FANOUT_KEY* key,
+                           const BYTE* data, size_t length)
+{
+	SHADOW_FANOUT_ENTRY* entry;
+
+	WINPR_ASSERT(key);
+
+	if (!fanout)
+		return;
+
+	EnterCriticalSection(&fanout->lock);
+	entry = shadow_fanout_find(fanout, key);
+
+	if (!entry || !entry->pending)
+		goto out;
+
+	if (data)
+	{
+		entry->s = StreamPool_Take(fanout->pool, length);
+
+		if (entry->s)
+			Stream_Write(entry->s, data, length);
+		else
+			WLog_WARN(TAG, "failed to share an encoded frame of %" PRIuz " bytes", length);
+	}
+
+	entry->pending = FALSE;
+	SetEvent(entry->event);
+
+	if ((fanout->encoded % 1000) == 0)
+		WLog_DBG(TAG, "fanout: %" PRIu64 " frames encoded, %" PRIu64 " shared", fanout->encoded,
+		         fanout->shared);
+out:
+	LeaveCriticalSection(&fanout->lock);
+}
+
+rdpShadowFanout* shadow_fanout_new(void)
+{
+	rdpShadowFanout* fanout = (rdpShadowFanout*)calloc(1, sizeof(rdpShadowFanout));
+
+	if (!fanout)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&fanout->lock, 4000))
+	{
+		free(fanout);
+		return NULL;
+	}
+
+	fanout->pool = StreamPool_New(TRUE, 64 * 1024);
+
+	if (!fanout->pool)
+	{
+		shadow_fanout_free(fanout);
+		return NULL;
+	}
+
+	return fanout;
+}
+
+void shadow_fanout_free(rdpShadowFanout* fanout)
+{
+	if (!fanout)
+		return;
+
+	shadow_fanout_clear(fanout);
+	StreamPool_Free(fanout->pool);
+	DeleteCriticalSection(&fanout->lock);
+	free(fanout);
+}
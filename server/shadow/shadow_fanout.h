@@ -0,0 +1,58 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_FANOUT_H
+#define FREERDP_SERVER_SHADOW_FANOUT_H
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <freerdp/codec/region.h>
+
+#include <freerdp/server/shadow.h>
+
+/* everything the encoded data of a frame depends on */
+typedef struct
+{
+	const BYTE* src; /* the surface data the frame is encoded from */
+	UINT32 codecId;  /* RDPGFX_CODECID_* */
+	UINT32 width;
+	UINT32 height;
+	UINT32 param;           /* codec specific, the quantization offset for RemoteFX */
+	BOOL headers;           /* the encoder has to send its stream headers */
+	const REGION16* region; /* the encoded region, NULL for the complete frame */
+} SHADOW_FANOUT_KEY;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	void shadow_fanout_next_frame(rdpShadowFanout* fanout);
+
+	wStream* shadow_fanout_acquire(rdpShadowFanout* fanout, const SHADOW_FANOUT_KEY* key,
+	                               BOOL* publish);
+	void shadow_fanout_publish(rdpShadowFanout* fanout, const SHADOW_FANOUT_KEY* key,
+	                           const BYTE* data, size_t length);
+
+	rdpShadowFanout* shadow_fanout_new(void);
+	void shadow_fanout_free(rdpShadowFanout* fanout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_FANOUT_H */
@@ -0,0 +1,518 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+
+#include <freerdp/log.h>
+
+#include "shadow.h"
+
+#include "shadow_gfxcache.h"
+
+#define TAG SERVER_TAG("shadow")
+
+/**
+ * Server side view of the RDPGFX cache of a client.
+ *
+ * Full 64x64 tiles are keyed by a hash of their content. A tile seen before is drawn with
+ * CacheToSurface instead of being encoded, new tiles are copied into a cache slot with
+ * SurfaceToCache once the frame carrying them has been sent. Slots are found through a hash
+ * index and reused least recently used first.
+ */
+
+/* the size of the small cache, which every client supports */
+#define SHADOW_GFXCACHE_MAX_SLOTS 4096
+#define SHADOW_GFXCACHE_BUCKETS 8192
+#define SHADOW_GFXCACHE_TILE_SIZE 64
+#define SHADOW_GFXCACHE_NONE UINT32_MAX
+
+typedef struct
+{
+	UINT64 key; /* 0 if the slot is unused */
+	UINT32 hashNext;
+	UINT32 lruPrev;
+	UINT32 lruNext;
+} SHADOW_GFXCACHE_SLOT;
+
+typedef struct
+{
+	UINT64 key;
+	RECTANGLE_16 rect;
+} SHADOW_GFXCACHE_TILE;
+
+struct s_shadow_gfxcache
+{
+	SHADOW_GFXCACHE_SLOT slots[SHADOW_GFXCACHE_MAX_SLOTS];
+	UINT32 buckets[SHADOW_GFXCACHE_BUCKETS];
+	UINT32 numUsed;
+	UINT32 lruHead; /* most recently used slot */
+	UINT32 lruTail; /* least recently used slot */
+
+	/* tiles of the current frame that are not cached yet */
+	SHADOW_GFXCACHE_TILE* pending;
+	UINT32 numPending;
+	UINT32 maxPending;
+};
+
+static void shadow_gfxcache_clear(SHADOW_GFXCACHE* cache)
+{
+	UINT32 index;
+
+	for (index = 0; index < SHADOW_GFXCACHE_BUCKETS; index++)
+		cache->buckets[index] = SHADOW_GFXCACHE_NONE;
+
+	ZeroMemory(cache->slots, sizeof(cache->slots));
+	cache->numUsed = 0;
+	cache->lruHead = SHADOW_GFXCACHE_NONE;
+	cache->lruTail = SHADOW_GFXCACHE_NONE;
+	cache->numPending = 0;
+}
+
+static SHADOW_GFXCACHE* shadow_gfxcache_get(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	if (!encoder->gfxCache)
+	{
+		encoder->gfxCache = (SHADOW_GFXCACHE*)calloc(1, sizeof(SHADOW_GFXCACHE));
+
+		if (!encoder->gfxCache)
+			return NULL;
+
+		shadow_gfxcache_clear(encoder->gfxCache);
+	}
+
+	return encoder->gfxCache;
+}
+
+static UINT32 shadow_gfxcache_bucket(UINT64 key)
+{
+	return (UINT32)((key ^ (key >> 32)) & (SHADOW_GFXCACHE_BUCKETS - 1));
+}
+
+static UINT32 shadow_gfxcache_find(const SHADOW_GFXCACHE* cache, UINT64 key)
+{
+	UINT32 slot = cache->buckets[shadow_gfxcache_bucket(key)];
+
+	while ((slot != SHADOW_GFXCACHE_NONE) && (cache->slots[slot].key != key))
+		slot = cache->slots[slot].hashNext;
+
+	return slot;
+}
+
+static void shadow_gfxcache_lru_unlink(SHADOW_GFXCACHE* cache, UINT32 slot)
+{
+	SHADOW_GFXCACHE_SLOT* entry = &cache->slots[slot];
+
+	if (entry->lruPrev != SHADOW_GFXCACHE_NONE)
+		cache->slots[entry->lruPrev].lruNext = entry->lruNext;
+	else
+		cache->lruHead = entry->lruNext;
+
+	if (entry->lruNext != SHADOW_GFXCACHE_NONE)
+		cache->slots[entry->lruNext].lruPrev = entry->lruPrev;
+	else
+		cache->lruTail = entry->lruPrev;
+}
+
+static void shadow_gfxcache_lru_push(SHADOW_GFXCACHE* cache, UINT32 slot)
+{
+	SHADOW_GFXCACHE_SLOT* entry = &cache->slots[slot];
+
+	entry->lruPrev = SHADOW_GFXCACHE_NONE;
+	entry->lruNext = cache->lruHead;
+
+	if (cache->lruHead != SHADOW_GFXCACHE_NONE)
+		cache->slots[cache->lruHead].lruPrev = slot;
+	else
+		cache->lruTail = slot;
+
+	cache->lruHead = slot;
+}
+
+static void shadow_gfxcache_touch(SHADOW_GFXCACHE* cache, UINT32 slot)
+{
+	if (cache->lruHead == slot)
+		return;
+
+	shadow_gfxcache_lru_unlink(cache, slot);
+	shadow_gfxcache_lru_push(cache, slot);
+}
+
+static void shadow_gfxcache_hash_unlink(SHADOW_GFXCACHE* cache, UINT32 slot)
+{
+	UINT32* next = &cache->buckets[shadow_gfxcache_bucket(cache->slots[slot].key)];
+
+	while (*next != slot)
+	{
+		WINPR_ASSERT(*next != SHADOW_GFXCACHE_NONE);
+		next = &cache->slots[*next].hashNext;
+	}
+
+	*next = cache->slots[slot].hashNext;
+}
+
+/**
+ * Assigns a slot to key, reusing the least recently used one when all slots are taken.
+ *
+ * @param evicted set to TRUE if the slot held another entry before
+ *
+ * @return the slot index
+ */
+static UINT32 shadow_gfxcache_insert(SHADOW_GFXCACHE* cache, UINT64 key, BOOL* evicted)
+{
+	UINT32 slot;
+	UINT32 bucket;
+
+	*evicted = FALSE;
+
+	if (cache->numUsed < SHADOW_GFXCACHE_MAX_SLOTS)
+		slot = cache->numUsed++;
+	else
+	{
+		slot = cache->lruTail;
+		shadow_gfxcache_lru_unlink(cache, slot);
+		shadow_gfxcache_hash_unlink(cache, slot);
+		*evicted = TRUE;
+	}
+
+	bucket = shadow_gfxcache_bucket(key);
+	cache->slots[slot].key = key;
+	cache->slots[slot].hashNext = cache->buckets[bucket];
+	cache->buckets[bucket] = slot;
+	shadow_gfxcache_lru_push(cache, slot);
+	return slot;
+}
+
+static BOOL shadow_gfxcache_is_pending(const SHADOW_GFXCACHE* cache, UINT64 key)
+{
+	UINT32 index;
+
+	for (index = 0; index < cache->numPending; index++)
+	{
+		if (cache->pending[index].key == key)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static BOOL shadow_gfxcache_add_pending(SHADOW_GFXCACHE* cache, UINT64 key,
+                                        const RECTANGLE_16* rect)
+{
+	if (cache->numPending >= cache->maxPending)
+	{
+		const UINT32 maxPending = cache->maxPending ? cache->maxPending * 2 : 256;
+		SHADOW_GFXCACHE_TILE* pending = (SHADOW_GFXCACHE_TILE*)realloc(
+		    cache->pending, maxPending * sizeof(SHADOW_GFXCACHE_TILE));
+
+		if (!pending)
+			return FALSE;
+
+		cache->pending = pending;
+		cache->maxPending = maxPending;
+	}
+
+	cache->pending[cache->numPending].key = key;
+	cache->pending[cache->numPending].rect = *rect;
+	cache->numPending++;
+	return TRUE;
+}
+
+static BOOL shadow_gfxcache_send_cache_to_surface(rdpShadowClient* client, UINT32 slot,
+                                                  const RECTANGLE_16* rect)
+{
+	UINT error = CHANNEL_RC_OK;
+	RDPGFX_POINT16 destPt = { 0 };
+	RDPGFX_CACHE_TO_SURFACE_PDU pdu = { 0 };
+
+	destPt.x = rect->left;
+	destPt.y = rect->top;
+	pdu.cacheSlot = (UINT16)(slot + 1);
+	pdu.surfaceId = client->surfaceId;
+	pdu.destPtsCount = 1;
+	pdu.destPts = &destPt;
+	IFCALLRET(client->rdpgfx->CacheToSurface, error, client->rdpgfx, &pdu);
+
+	if (error)
+	{
+		WLog_ERR(TAG, "CacheToSurface failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ *
+ * Draws the full tiles of encodeRegion the client has cached with CacheToSurface and removes
+ * them from the region. Tiles that are not cached are remembered for shadow_gfxcache_store.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_gfxcache_send_hits(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+                               REGION16* encodeRegion)
+{
+	BOOL rc = FALSE;
+	UINT32 x, y, index;
+	UINT32 numRects = 0;
+	REGION16 tileRegion;
+	REGION16 missRegion;
+	const RECTANGLE_16* extents;
+	SHADOW_GFXCACHE* cache;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(encodeRegion);
+
+	encoder = client->encoder;
+	region16_init(&tileRegion);
+	region16_init(&missRegion);
+	EnterCriticalSection(&client->lock);
+
+	if (!(cache = shadow_gfxcache_get(encoder)))
+		goto fail;
+
+	cache->numPending = 0;
+	extents = region16_extents(encodeRegion);
+
+	for (y = extents->top & ~63U; y < extents->bottom; y += SHADOW_GFXCACHE_TILE_SIZE)
+	{
+		for (x = extents->left & ~63U; x < extents->right; x += SHADOW_GFXCACHE_TILE_SIZE)
+		{
+			const RECTANGLE_16* rects;
+			RECTANGLE_16 tile;
+			tile.left = (UINT16)x;
+			tile.top = (UINT16)y;
+			tile.right = (UINT16)MIN(x + SHADOW_GFXCACHE_TILE_SIZE, encoder->width);
+			tile.bottom = (UINT16)MIN(y + SHADOW_GFXCACHE_TILE_SIZE, encoder->height);
+
+			if (!region16_intersect_rect(&tileRegion, encodeRegion, &tile))
+				goto fail;
+
+			rects = region16_rects(&tileRegion, &numRects);
+
+			if (numRects == 0)
+				continue;
+
+			/* only complete tiles are cached, edges and partial tiles are encoded */
+			if ((numRects == 1) && (tile.right - tile.left == SHADOW_GFXCACHE_TILE_SIZE) &&
+			    (tile.bottom - tile.top == SHADOW_GFXCACHE_TILE_SIZE) &&
+			    rectangles_equal(&rects[0], &tile))
+			{
+				const UINT64 key = shadow_encoder_tile_key(pSrcData, nSrcStep, &tile);
+				const UINT32 slot = shadow_gfxcache_find(cache, key);
+
+				if (slot != SHADOW_GFXCACHE_NONE)
+				{
+					if (!shadow_gfxcache_send_cache_to_surface(client, slot, &tile))
+						goto fail;
+
+					shadow_gfxcache_touch(cache, slot);
+					continue;
+				}
+
+				if (!shadow_gfxcache_is_pending(cache, key) &&
+				    !shadow_gfxcache_add_pending(cache, key, &tile))
+					goto fail;
+			}
+
+			for (index = 0; index < numRects; index++)
+			{
+				if (!region16_union_rect(&missRegion, &missRegion, &rects[index]))
+					goto fail;
+			}
+		}
+	}
+
+	rc = region16_copy(encodeRegion, &missRegion);
+fail:
+	if (!rc && cache)
+		cache->numPending = 0;
+
+	LeaveCriticalSection(&client->lock);
+	region16_uninit(&tileRegion);
+	region16_uninit(&missRegion);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * Copies the tiles remembered by shadow_gfxcache_send_hits into the client cache, called once
+ * the frame that encoded them was sent.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_gfxcache_store(rdpShadowClient* client)
+{
+	BOOL rc = TRUE;
+	UINT32 index;
+	SHADOW_GFXCACHE* cache;
+
+	WINPR_ASSERT(client);
+
+	EnterCriticalSection(&client->lock);
+	cache = client->encoder->gfxCache;
+
+	for (index = 0; cache && (index < cache->numPending); index++)
+	{
+		BOOL evicted;
+		UINT error = CHANNEL_RC_OK;
+		RDPGFX_SURFACE_TO_CACHE_PDU pdu = { 0 };
+		const SHADOW_GFXCACHE_TILE* tile = &cache->pending[index];
+		const UINT32 slot = shadow_gfxcache_insert(cache, tile->key, &evicted);
+
+		/* the client does not release slot data that is overwritten */
+		if (evicted)
+		{
+			RDPGFX_EVICT_CACHE_ENTRY_PDU evict = { 0 };
+			evict.cacheSlot = (UINT16)(slot + 1);
+			IFCALLRET(client->rdpgfx->EvictCacheEntry, error, client->rdpgfx, &evict);
+
+			if (error)
+			{
+				WLog_ERR(TAG, "EvictCacheEntry failed with error %" PRIu32 "", error);
+				rc = FALSE;
+				break;
+			}
+		}
+
+		pdu.surfaceId = client->surfaceId;
+		pdu.cacheKey = tile->key;
+		pdu.cacheSlot = (UINT16)(slot + 1);
+		pdu.rectSrc = tile->rect;
+		IFCALLRET(client->rdpgfx->SurfaceToCache, error, client->rdpgfx, &pdu);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceToCache failed with error %" PRIu32 "", error);
+			rc = FALSE;
+			break;
+		}
+	}
+
+	if (!rc)
+	{
+		/* the client state is unknown, start over */
+		shadow_gfxcache_clear(cache);
+	}
+	else if (cache)
+		cache->numPending = 0;
+
+	LeaveCriticalSection(&client->lock);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * Takes over the entries a client offers from its persistent cache and replies with the slots
+ * they were imported to. Only keys computed the way shadow_encoder_tile_key does will ever hit.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT shadow_gfxcache_import_offer(rdpShadowClient* client,
+                                  const RDPGFX_CACHE_IMPORT_OFFER_PDU* offer)
+{
+	UINT error = CHANNEL_RC_OK;
+	UINT16 index;
+	UINT16 imported = 0;
+	UINT16* cacheSlots = NULL;
+	SHADOW_GFXCACHE* cache;
+	RDPGFX_CACHE_IMPORT_REPLY_PDU reply = { 0 };
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(offer);
+
+	reply.importedEntriesCount =
+	    (UINT16)MIN(offer->cacheEntriesCount, SHADOW_GFXCACHE_MAX_SLOTS);
+
+	if (reply.importedEntriesCount > 0)
+	{
+		cacheSlots = (UINT16*)calloc(reply.importedEntriesCount, sizeof(UINT16));
+
+		if (!cacheSlots)
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	EnterCriticalSection(&client->lock);
+
+	if (!(cache = shadow_gfxcache_get(client->encoder)))
+	{
+		LeaveCriticalSection(&client->lock);
+		free(cacheSlots);
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	/* an offer is only sent right after the channel was opened, the cache is empty */
+	shadow_gfxcache_clear(cache);
+
+	for (index = 0; index < reply.importedEntriesCount; index++)
+	{
+		BOOL evicted;
+		const UINT64 key = offer->cacheEntries[index].cacheKey;
+
+		/* slot 0 tells the client that the entry was not imported */
+		if ((key == 0) || (shadow_gfxcache_find(cache, key) != SHADOW_GFXCACHE_NONE))
+			continue;
+
+		cacheSlots[index] = (UINT16)(shadow_gfxcache_insert(cache, key, &evicted) + 1);
+		imported++;
+	}
+
+	LeaveCriticalSection(&client->lock);
+
+	reply.cacheSlots = cacheSlots;
+	IFCALLRET(client->rdpgfx->CacheImportReply, error, client->rdpgfx, &reply);
+
+	if (error)
+		WLog_ERR(TAG, "CacheImportReply failed with error %" PRIu32 "", error);
+
+	WLog_DBG(TAG, "imported %" PRIu16 " of %" PRIu16 " offered cache entries", imported,
+	         offer->cacheEntriesCount);
+	free(cacheSlots);
+	return error;
+}
+
+/**
+ * Forgets all cache entries, the client starts with an empty cache when the channel is opened.
+ */
+void shadow_gfxcache_reset(rdpShadowClient* client)
+{
+	WINPR_ASSERT(client);
+
+	EnterCriticalSection(&client->lock);
+
+	if (client->encoder->gfxCache)
+		shadow_gfxcache_clear(client->encoder->gfxCache);
+
+	LeaveCriticalSection(&client->lock);
+}
+
+void shadow_gfxcache_free(SHADOW_GFXCACHE* cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->pending);
+	free(cache);
+}
@@ -0,0 +1,48 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_GFXCACHE_H
+#define FREERDP_SERVER_SHADOW_GFXCACHE_H
+
+#include <winpr/crt.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/channels/rdpgfx.h>
+
+#include <freerdp/server/shadow.h>
+
+typedef struct s_shadow_gfxcache SHADOW_GFXCACHE;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	BOOL shadow_gfxcache_send_hits(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+	                               REGION16* encodeRegion);
+	BOOL shadow_gfxcache_store(rdpShadowClient* client);
+	UINT shadow_gfxcache_import_offer(rdpShadowClient* client,
+	                                  const RDPGFX_CACHE_IMPORT_OFFER_PDU* offer);
+	void shadow_gfxcache_reset(rdpShadowClient* client);
+
+	void shadow_gfxcache_free(SHADOW_GFXCACHE* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_GFXCACHE_H */
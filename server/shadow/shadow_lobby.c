@@ -75,6 +75,19 @@ BOOL shadow_client_init_lobby(rdpShadowServer* server)
 	// rdtk_button_draw(surface, 16, 64, 128, 32, NULL, "button");
 	// rdtk_text_field_draw(surface, 16, 128, 128, 32, NULL, "text field");
 
+	/* only announce what rdtk actually drew */
+	{
+		UINT16 x, y, w, h;
+
+		if (rdtk_surface_get_dirty_rect(surface, &x, &y, &w, &h))
+		{
+			invalidRect.left = x;
+			invalidRect.top = y;
+			invalidRect.right = x + w;
+			invalidRect.bottom = y + h;
+		}
+	}
+
 	rdtk_surface_free(surface);
 
 	rdtk_engine_free(engine);
@@ -0,0 +1,418 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+
+#include "shadow.h"
+
+#include "shadow_orders.h"
+
+#define TAG SERVER_TAG("shadow")
+
+/**
+ * Drawing orders for clients that only take bitmap updates.
+ *
+ * The encoder keeps a copy of the surface as it was last sent. Scrolled content is moved on the
+ * client with ScrBlt, tiles that did not change are skipped, single colored tiles are sent as
+ * OpaqueRect and tiles seen before are drawn from the client bitmap cache with MemBlt.
+ */
+
+/* the third cell holds bitmaps of up to 64x64 pixels, the tile size of bitmap updates */
+#define SHADOW_ORDERS_CACHE_CELL 2
+#define SHADOW_ORDERS_CACHE_MAX_ENTRIES 4096
+/* the orders of an update are flushed at 16k, larger tiles go out as bitmap updates */
+#define SHADOW_ORDERS_CACHE_MAX_LENGTH 8192
+
+#define SHADOW_ORDERS_ROP_SRCCOPY 0xCC
+
+static BOOL shadow_orders_cache_supported(const rdpSettings* settings)
+{
+	const BITMAP_CACHE_V2_CELL_INFO* cellInfo;
+
+	if (!settings->OrderSupport[NEG_MEMBLT_INDEX] && !settings->OrderSupport[NEG_MEMBLT_V2_INDEX])
+		return FALSE;
+
+	/* the cell sizes are only known if the client sent a revision 2 cache capability set */
+	if ((settings->BitmapCacheVersion < 2) ||
+	    (settings->BitmapCacheV2NumCells <= SHADOW_ORDERS_CACHE_CELL))
+		return FALSE;
+
+	/* cache bitmaps can not be sent with 15 bpp */
+	if (settings->ColorDepth == 15)
+		return FALSE;
+
+	cellInfo = &settings->BitmapCacheV2CellInfo[SHADOW_ORDERS_CACHE_CELL];
+	return cellInfo->numEntries > 0;
+}
+
+static void shadow_orders_init_cache(rdpShadowEncoder* encoder, const rdpSettings* settings)
+{
+	const BITMAP_CACHE_V2_CELL_INFO* cellInfo =
+	    &settings->BitmapCacheV2CellInfo[SHADOW_ORDERS_CACHE_CELL];
+	const UINT32 entries = MIN(cellInfo->numEntries, SHADOW_ORDERS_CACHE_MAX_ENTRIES);
+
+	encoder->cacheId = SHADOW_ORDERS_CACHE_CELL;
+	encoder->cacheNext = 0;
+	encoder->cacheKeys = (UINT64*)calloc(entries, sizeof(UINT64));
+
+	if (encoder->cacheKeys)
+		encoder->cacheEntries = entries;
+	else
+		WLog_WARN(TAG, "Failed to allocate the bitmap cache keys, not using the cache");
+}
+
+void shadow_orders_uninit(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	free(encoder->cacheKeys);
+	encoder->cacheKeys = NULL;
+	encoder->cacheEntries = 0;
+	encoder->cacheNext = 0;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE if drawing orders are used for this update, FALSE to send plain bitmaps
+ */
+BOOL shadow_orders_begin(rdpShadowClient* client)
+{
+	BOOL rc = FALSE;
+	rdpContext* context = (rdpContext*)client;
+	rdpSettings* settings;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+
+	settings = context->settings;
+	encoder = client->encoder;
+	WINPR_ASSERT(settings);
+	WINPR_ASSERT(encoder);
+
+	/* order colors of palette sessions would need the color table */
+	if (settings->ColorDepth < 15)
+		return FALSE;
+
+	if (!settings->OrderSupport[NEG_SCRBLT_INDEX] &&
+	    !settings->OrderSupport[NEG_OPAQUE_RECT_INDEX] && !shadow_orders_cache_supported(settings))
+		return FALSE;
+
+	if (!shadow_encoder_prepare_last_frame(encoder))
+		return FALSE;
+
+	if (!encoder->cacheKeys && shadow_orders_cache_supported(settings))
+		shadow_orders_init_cache(encoder, settings);
+
+	IFCALLRET(context->update->BeginPaint, rc, context);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE on success (or if no scroll was found)
+ */
+BOOL shadow_orders_send_scroll(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+                               const RECTANGLE_16* rect)
+{
+	BOOL rc = TRUE;
+	INT32 dx, dy;
+	RECTANGLE_16 clipped;
+	RECTANGLE_16 src;
+	rdpContext* context = (rdpContext*)client;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+
+	encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	if (!encoder->lastFrameValid || !context->settings->OrderSupport[NEG_SCRBLT_INDEX])
+		return TRUE;
+
+	clipped = *rect;
+	clipped.right = (UINT16)MIN(clipped.right, encoder->width);
+	clipped.bottom = (UINT16)MIN(clipped.bottom, encoder->height);
+
+	if ((clipped.right <= clipped.left) || (clipped.bottom <= clipped.top))
+		return TRUE;
+
+	if (shadow_encoder_find_move(encoder, pSrcData, nSrcStep, &clipped, &src, &dx, &dy))
+	{
+		SCRBLT_ORDER scrblt = { 0 };
+		scrblt.nLeftRect = src.left + dx;
+		scrblt.nTopRect = src.top + dy;
+		scrblt.nWidth = src.right - src.left;
+		scrblt.nHeight = src.bottom - src.top;
+		scrblt.bRop = SHADOW_ORDERS_ROP_SRCCOPY;
+		scrblt.nXSrc = src.left;
+		scrblt.nYSrc = src.top;
+		IFCALLRET(context->update->primary->ScrBlt, rc, context, &scrblt);
+
+		if (rc)
+			shadow_encoder_move_last_frame(encoder, &src, dx, dy);
+		else
+			WLog_ERR(TAG, "ScrBlt failed");
+	}
+
+	return rc;
+}
+
+static BOOL shadow_orders_is_solid(const BYTE* data, UINT32 step, UINT32 width, UINT32 height,
+                                   UINT32* color)
+{
+	UINT32 x, y;
+	const UINT32 first = *(const UINT32*)data;
+
+	for (y = 0; y < height; y++)
+	{
+		const UINT32* pixel = (const UINT32*)&data[y * step];
+
+		for (x = 0; x < width; x++)
+		{
+			if (pixel[x] != first)
+				return FALSE;
+		}
+	}
+
+	*color = first;
+	return TRUE;
+}
+
+static UINT32 shadow_orders_color(const rdpSettings* settings, UINT32 color)
+{
+	UINT32 format;
+
+	/* the inverse of gdi_decode_color */
+	switch (settings->ColorDepth)
+	{
+		case 15:
+			format = PIXEL_FORMAT_RGB15;
+			break;
+
+		case 16:
+			format = PIXEL_FORMAT_RGB16;
+			break;
+
+		default:
+			format = PIXEL_FORMAT_BGR24;
+			break;
+	}
+
+	return FreeRDPConvertColor(color, PIXEL_FORMAT_BGRX32, format, NULL);
+}
+
+static BOOL shadow_orders_send_memblt(rdpShadowClient* client, const BITMAP_DATA* bitmap,
+                                      UINT32 index, BOOL* handled)
+{
+	BOOL rc = FALSE;
+	MEMBLT_ORDER memblt = { 0 };
+	rdpContext* context = (rdpContext*)client;
+
+	memblt.cacheId = client->encoder->cacheId;
+	memblt.nLeftRect = bitmap->destLeft;
+	memblt.nTopRect = bitmap->destTop;
+	memblt.nWidth = bitmap->width;
+	memblt.nHeight = bitmap->height;
+	memblt.bRop = SHADOW_ORDERS_ROP_SRCCOPY;
+	memblt.cacheIndex = index;
+	IFCALLRET(context->update->primary->MemBlt, rc, context, &memblt);
+
+	if (!rc)
+		WLog_ERR(TAG, "MemBlt failed");
+
+	*handled = rc;
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * Called before the tile is compressed. Tiles that are handled here are left out of the bitmap
+ * update.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_orders_send_tile(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+                             const BITMAP_DATA* bitmap, SHADOW_ORDERS_TILE* tile, BOOL* handled)
+{
+	UINT32 color;
+	const BYTE* src;
+	RECTANGLE_16 rect;
+	rdpContext* context = (rdpContext*)client;
+	rdpSettings* settings;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(bitmap);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(handled);
+
+	settings = context->settings;
+	encoder = client->encoder;
+	*handled = FALSE;
+	tile->key = 0;
+
+	if ((bitmap->destLeft + bitmap->width > encoder->width) ||
+	    (bitmap->destTop + bitmap->height > encoder->height))
+		return TRUE;
+
+	src = &pSrcData[bitmap->destTop * nSrcStep + bitmap->destLeft * 4ULL];
+
+	rect.left = bitmap->destLeft;
+	rect.top = bitmap->destTop;
+	rect.right = bitmap->destLeft + bitmap->width;
+	rect.bottom = bitmap->destTop + bitmap->height;
+
+	if (shadow_encoder_last_frame_equal(encoder, pSrcData, nSrcStep, &rect))
+	{
+		*handled = TRUE;
+		return TRUE;
+	}
+
+	if (settings->OrderSupport[NEG_OPAQUE_RECT_INDEX] &&
+	    shadow_orders_is_solid(src, nSrcStep, bitmap->width, bitmap->height, &color))
+	{
+		BOOL rc = FALSE;
+		OPAQUE_RECT_ORDER opaqueRect = { 0 };
+		opaqueRect.nLeftRect = bitmap->destLeft;
+		opaqueRect.nTopRect = bitmap->destTop;
+		opaqueRect.nWidth = bitmap->width;
+		opaqueRect.nHeight = bitmap->height;
+		opaqueRect.color = shadow_orders_color(settings, color);
+		IFCALLRET(context->update->primary->OpaqueRect, rc, context, &opaqueRect);
+
+		if (!rc)
+			WLog_ERR(TAG, "OpaqueRect failed");
+
+		*handled = rc;
+		return rc;
+	}
+
+	if (encoder->cacheEntries > 0)
+	{
+		UINT32 index;
+
+		tile->key = shadow_encoder_tile_key(pSrcData, nSrcStep, &rect);
+
+		for (index = 0; index < encoder->cacheEntries; index++)
+		{
+			if (encoder->cacheKeys[index] == tile->key)
+				return shadow_orders_send_memblt(client, bitmap, index, handled);
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ *
+ * Called with the compressed tile, stores it in the client bitmap cache if it is small enough.
+ * Cache entries are replaced round robin.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_orders_cache_tile(rdpShadowClient* client, const BITMAP_DATA* bitmap,
+                              const SHADOW_ORDERS_TILE* tile, BOOL* handled)
+{
+	BOOL rc = FALSE;
+	UINT32 index;
+	CACHE_BITMAP_V2_ORDER cacheBitmap = { 0 };
+	rdpContext* context = (rdpContext*)client;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(bitmap);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(handled);
+
+	encoder = client->encoder;
+	*handled = FALSE;
+
+	if ((tile->key == 0) || (encoder->cacheEntries == 0) ||
+	    (bitmap->bitmapLength > SHADOW_ORDERS_CACHE_MAX_LENGTH))
+		return TRUE;
+
+	index = encoder->cacheNext;
+	cacheBitmap.cacheId = encoder->cacheId;
+	cacheBitmap.flags = CBR2_NO_BITMAP_COMPRESSION_HDR;
+	cacheBitmap.bitmapBpp = bitmap->bitsPerPixel;
+	cacheBitmap.bitmapWidth = bitmap->width;
+	cacheBitmap.bitmapHeight = bitmap->height;
+	cacheBitmap.bitmapLength = bitmap->bitmapLength;
+	cacheBitmap.cacheIndex = index;
+	cacheBitmap.compressed = TRUE;
+	cacheBitmap.bitmapDataStream = bitmap->bitmapDataStream;
+	IFCALLRET(context->update->secondary->CacheBitmapV2, rc, context, &cacheBitmap);
+
+	if (!rc)
+	{
+		WLog_ERR(TAG, "CacheBitmapV2 failed");
+		return FALSE;
+	}
+
+	encoder->cacheKeys[index] = tile->key;
+	encoder->cacheNext = (index + 1) % encoder->cacheEntries;
+	return shadow_orders_send_memblt(client, bitmap, index, handled);
+}
+
+/**
+ * Function description
+ *
+ * Sends the collected orders and records the sent area in the copy of the surface. Without
+ * a rectangle the orders are flushed and the copy is marked invalid.
+ *
+ * @return TRUE on success
+ */
+BOOL shadow_orders_end(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+                       const RECTANGLE_16* rect)
+{
+	BOOL rc = FALSE;
+	rdpContext* context = (rdpContext*)client;
+	rdpShadowEncoder* encoder;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+
+	encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	IFCALLRET(context->update->EndPaint, rc, context);
+
+	/* without a rectangle the update was aborted, the client may show anything now */
+	if (!rc || !rect)
+	{
+		if (!rc)
+			WLog_ERR(TAG, "EndPaint failed");
+
+		encoder->lastFrameValid = FALSE;
+		return rc;
+	}
+
+	shadow_encoder_update_last_frame(encoder, pSrcData, nSrcStep, rect);
+	return TRUE;
+}
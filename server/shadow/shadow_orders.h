@@ -0,0 +1,54 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_ORDERS_H
+#define FREERDP_SERVER_SHADOW_ORDERS_H
+
+#include <winpr/crt.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/region.h>
+
+#include <freerdp/server/shadow.h>
+
+typedef struct
+{
+	UINT64 key; /* content hash of the tile, 0 if the bitmap cache is not used */
+} SHADOW_ORDERS_TILE;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	BOOL shadow_orders_begin(rdpShadowClient* client);
+	BOOL shadow_orders_send_scroll(rdpShadowClient* client, const BYTE* pSrcData,
+	                               UINT32 nSrcStep, const RECTANGLE_16* rect);
+	BOOL shadow_orders_send_tile(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+	                             const BITMAP_DATA* bitmap, SHADOW_ORDERS_TILE* tile,
+	                             BOOL* handled);
+	BOOL shadow_orders_cache_tile(rdpShadowClient* client, const BITMAP_DATA* bitmap,
+	                              const SHADOW_ORDERS_TILE* tile, BOOL* handled);
+	BOOL shadow_orders_end(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+	                       const RECTANGLE_16* rect);
+
+	void shadow_orders_uninit(rdpShadowEncoder* encoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_ORDERS_H */
@@ -34,6 +34,22 @@ static void rdpsnd_activated(RdpsndServerContext* context)
 	const AUDIO_FORMAT* agreed_format = NULL;
 	UINT16 i = 0, j = 0;
 
+	/* Opus needs far less bandwidth than everything else, prefer it */
+	for (i = 0; i < context->num_client_formats; i++)
+	{
+		if (context->client_formats[i].wFormatTag != WAVE_FORMAT_OPUS)
+			continue;
+
+		for (j = 0; j < context->num_server_formats; j++)
+		{
+			if (audio_format_compatible(&context->server_formats[j], &context->client_formats[i]))
+			{
+				context->SelectFormat(context, i);
+				return;
+			}
+		}
+	}
+
 	for (i = 0; i < context->num_client_formats; i++)
 	{
 		for (j = 0; j < context->num_server_formats; j++)
@@ -25,13 +25,47 @@
 #include "shadow_screen.h"
 #include "shadow_lobby.h"
 
+/* the selected monitor, the bounding box of all monitors if the server spans them */
+static void shadow_screen_get_area(rdpShadowServer* server, INT64* x, INT64* y, INT64* width,
+                                   INT64* height)
+{
+	UINT32 index;
+	rdpShadowSubsystem* subsystem = server->subsystem;
+	const MONITOR_DEF* primary;
+	INT64 left, top, right, bottom;
+
+	WINPR_ASSERT(subsystem->selectedMonitor < ARRAYSIZE(subsystem->monitors));
+	primary = &(subsystem->monitors[subsystem->selectedMonitor]);
+	left = primary->left;
+	top = primary->top;
+	right = primary->right;
+	bottom = primary->bottom;
+
+	if (server->spanMonitors)
+	{
+		for (index = 0; index < MIN(subsystem->numMonitors, ARRAYSIZE(subsystem->monitors));
+		     index++)
+		{
+			const MONITOR_DEF* monitor = &(subsystem->monitors[index]);
+
+			left = MIN(left, monitor->left);
+			top = MIN(top, monitor->top);
+			right = MAX(right, monitor->right);
+			bottom = MAX(bottom, monitor->bottom);
+		}
+	}
+
+	*x = left;
+	*y = top;
+	*width = right - left + 1;
+	*height = bottom - top + 1;
+}
+
 rdpShadowScreen* shadow_screen_new(rdpShadowServer* server)
 {
 	INT64 x, y;
 	INT64 width, height;
 	rdpShadowScreen* screen;
-	rdpShadowSubsystem* subsystem;
-	MONITOR_DEF* primary;
 
 	WINPR_ASSERT(server);
 	WINPR_ASSERT(server->subsystem);
@@ -42,20 +76,12 @@ rdpShadowScreen* shadow_screen_new(rdpShadowServer* server)
 		goto out_error;
 
 	screen->server = server;
-	subsystem = server->subsystem;
 
 	if (!InitializeCriticalSectionAndSpinCount(&(screen->lock), 4000))
 		goto out_free;
 
 	region16_init(&(screen->invalidRegion));
-
-	WINPR_ASSERT(subsystem->selectedMonitor < ARRAYSIZE(subsystem->monitors));
-	primary = &(subsystem->monitors[subsystem->selectedMonitor]);
-
-	x = primary->left;
-	y = primary->top;
-	width = primary->right - primary->left + 1;
-	height = primary->bottom - primary->top + 1;
+	shadow_screen_get_area(server, &x, &y, &width, &height);
 
 	WINPR_ASSERT(x >= 0);
 	WINPR_ASSERT(x <= UINT16_MAX);
@@ -126,21 +152,13 @@ void shadow_screen_free(rdpShadowScreen* screen)
 
 BOOL shadow_screen_resize(rdpShadowScreen* screen)
 {
-	int x, y;
-	int width, height;
-	MONITOR_DEF* primary;
-	rdpShadowSubsystem* subsystem;
+	INT64 x, y;
+	INT64 width, height;
 
 	if (!screen)
 		return FALSE;
 
-	subsystem = screen->server->subsystem;
-	primary = &(subsystem->monitors[subsystem->selectedMonitor]);
-
-	x = primary->left;
-	y = primary->top;
-	width = primary->right - primary->left + 1;
-	height = primary->bottom - primary->top + 1;
+	shadow_screen_get_area(screen->server, &x, &y, &width, &height);
 
 	WINPR_ASSERT(x >= 0);
 	WINPR_ASSERT(x <= UINT16_MAX);
@@ -350,6 +350,36 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 		{
 			freerdp_settings_set_string(settings, FreeRDP_NtlmSamFile, arg->Value);
 		}
+		CommandLineSwitchCase(arg, "max-handshakes")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return -1;
+
+			freerdp_settings_set_uint32(settings, FreeRDP_MaxConcurrentHandshakes, (UINT32)val);
+		}
+		CommandLineSwitchCase(arg, "handshake-timeout")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT32_MAX))
+				return -1;
+
+			freerdp_settings_set_uint32(settings, FreeRDP_HandshakeQueueTimeout, (UINT32)val);
+		}
+		CommandLineSwitchCase(arg, "affinity")
+		{
+			ULONGLONG mask;
+
+			if (!winpr_ParseProcessorMask(arg->Value, &mask))
+			{
+				WLog_ERR(TAG, "invalid processor affinity: %s", arg->Value);
+				return COMMAND_LINE_ERROR;
+			}
+
+			server->threadAffinity = mask;
+		}
 		CommandLineSwitchCase(arg, "log-level")
 		{
 			wLog* root = WLog_GetRoot();
@@ -379,6 +409,12 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, arg->Value ? TRUE : FALSE))
 				return COMMAND_LINE_ERROR;
 		}
+		CommandLineSwitchCase(arg, "gfx-clear")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxClearCodec,
+			                               arg->Value ? TRUE : FALSE))
+				return COMMAND_LINE_ERROR;
+		}
 		CommandLineSwitchCase(arg, "gfx-avc420")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxH264, arg->Value ? TRUE : FALSE))
@@ -392,6 +428,10 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxAVC444, arg->Value ? TRUE : FALSE))
 				return COMMAND_LINE_ERROR;
 		}
+		CommandLineSwitchCase(arg, "gfx-mixed")
+		{
+			server->gfxMixed = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchDefault(arg)
 		{
 		}
@@ -410,12 +450,17 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 		if (arg->Flags & COMMAND_LINE_VALUE_PRESENT)
 		{
 			/* Select monitors */
-			long val = strtol(arg->Value, NULL, 0);
+			if (_stricmp(arg->Value, "all") == 0)
+				server->spanMonitors = TRUE;
+			else
+			{
+				long val = strtol(arg->Value, NULL, 0);
 
-			if ((val < 0) || (errno != 0) || ((UINT32)val >= numMonitors))
-				status = COMMAND_LINE_STATUS_PRINT;
+				if ((val < 0) || (errno != 0) || ((UINT32)val >= numMonitors))
+					status = COMMAND_LINE_STATUS_PRINT;
 
-			server->selectedMonitor = (UINT32)val;
+				server->selectedMonitor = (UINT32)val;
+			}
 		}
 		else
 		{
@@ -553,6 +598,21 @@ int shadow_server_start(rdpShadowServer* server)
 #ifndef _WIN32
 	signal(SIGPIPE, SIG_IGN);
 #endif
+
+	/* This thread and all threads created from here on (capture, clients, encoders) share the
+	 * mask. Surfaces and encoder buffers are first touched by them, which places that memory
+	 * on the node of the selected processors. */
+	if (server->threadAffinity != 0)
+	{
+		if (SetThreadAffinityMask(_GetCurrentThread(), (DWORD_PTR)server->threadAffinity) == 0)
+		{
+			WLog_ERR(TAG, "failed to set thread affinity 0x%016" PRIx64, server->threadAffinity);
+			return -1;
+		}
+
+		WLog_INFO(TAG, "server threads use processor mask 0x%016" PRIx64, server->threadAffinity);
+	}
+
 	server->screen = shadow_screen_new(server);
 
 	if (!server->screen)
@@ -814,6 +874,9 @@ int shadow_server_init(rdpShadowServer* server)
 	if (!InitializeCriticalSectionAndSpinCount(&(server->lock), 4000))
 		goto fail_server_lock;
 
+	if (!(server->fanout = shadow_fanout_new()))
+		goto fail_fanout;
+
 	status = shadow_server_init_config_path(server);
 
 	if (status < 0)
@@ -838,6 +901,19 @@ int shadow_server_init(rdpShadowServer* server)
 
 	status = shadow_subsystem_init(server->subsystem, server);
 
+	while ((status < 0) && shadow_subsystem_load_fallback())
+	{
+		WLog_WARN(TAG, "Failed to initialize the shadow subsystem, trying the fallback");
+		shadow_subsystem_uninit(server->subsystem);
+		shadow_subsystem_free(server->subsystem);
+		server->subsystem = shadow_subsystem_new();
+
+		if (!server->subsystem)
+			goto fail_subsystem_new;
+
+		status = shadow_subsystem_init(server->subsystem, server);
+	}
+
 	if (status >= 0)
 		return status;
 
@@ -854,6 +930,9 @@ fail_certificate:
 	free(server->ConfigPath);
 	server->ConfigPath = NULL;
 fail_config_path:
+	shadow_fanout_free(server->fanout);
+	server->fanout = NULL;
+fail_fanout:
 	DeleteCriticalSection(&(server->lock));
 fail_server_lock:
 	CloseHandle(server->StopEvent);
@@ -874,6 +953,8 @@ int shadow_server_uninit(rdpShadowServer* server)
 	shadow_server_stop(server);
 	shadow_subsystem_uninit(server->subsystem);
 	shadow_subsystem_free(server->subsystem);
+	shadow_fanout_free(server->fanout);
+	server->fanout = NULL;
 	freerdp_listener_free(server->listener);
 	server->listener = NULL;
 	free(server->CertificateFile);
@@ -906,6 +987,7 @@ rdpShadowServer* shadow_server_new(void)
 	server->h264BitRate = 10000000;
 	server->h264FrameRate = 30;
 	server->h264QP = 0;
+	server->gfxMixed = TRUE;
 	server->authentication = FALSE;
 	server->settings = freerdp_settings_new(FREERDP_SETTINGS_SERVER_MODE);
 	return server;
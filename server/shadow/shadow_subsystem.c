@@ -23,12 +23,28 @@
 #include "shadow_subsystem.h"
 
 static pfnShadowSubsystemEntry pSubsystemEntry = NULL;
+static pfnShadowSubsystemEntry pFallbackEntry = NULL;
 
 void shadow_subsystem_set_entry(pfnShadowSubsystemEntry pEntry)
 {
 	pSubsystemEntry = pEntry;
 }
 
+void shadow_subsystem_set_fallback_entry(pfnShadowSubsystemEntry pEntry)
+{
+	pFallbackEntry = pEntry;
+}
+
+BOOL shadow_subsystem_load_fallback(void)
+{
+	if (!pFallbackEntry || (pFallbackEntry == pSubsystemEntry))
+		return FALSE;
+
+	pSubsystemEntry = pFallbackEntry;
+	pFallbackEntry = NULL;
+	return TRUE;
+}
+
 static int shadow_subsystem_load_entry_points(RDP_SHADOW_ENTRY_POINTS* pEntryPoints)
 {
 	ZeroMemory(pEntryPoints, sizeof(RDP_SHADOW_ENTRY_POINTS));
@@ -279,5 +295,8 @@ int shadow_subsystem_pointer_convert_alpha_pointer_data(
 
 void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
+	if (subsystem->server)
+		shadow_fanout_next_frame(subsystem->server->fanout);
+
 	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
 }
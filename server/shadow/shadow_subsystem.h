@@ -29,6 +29,7 @@ extern "C"
 {
 #endif
 
+	BOOL shadow_subsystem_load_fallback(void);
 	rdpShadowSubsystem* shadow_subsystem_new(void);
 	void shadow_subsystem_free(rdpShadowSubsystem* subsystem);
 
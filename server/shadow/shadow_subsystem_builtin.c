@@ -38,6 +38,14 @@ extern int Mac_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
 extern int Win_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
 #endif
 
+#ifdef WITH_SHADOW_PIPEWIRE
+extern int PipeWire_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
+#endif
+
+#ifdef WITH_SHADOW_SYNTHETIC
+extern int Synthetic_ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
+#endif
+
 static RDP_SHADOW_SUBSYSTEM g_Subsystems[] = {
 
 #ifdef WITH_SHADOW_X11
@@ -52,6 +60,14 @@ static RDP_SHADOW_SUBSYSTEM g_Subsystems[] = {
 	{ "Win", Win_ShadowSubsystemEntry },
 #endif
 
+#ifdef WITH_SHADOW_PIPEWIRE
+	{ "PipeWire", PipeWire_ShadowSubsystemEntry },
+#endif
+
+#ifdef WITH_SHADOW_SYNTHETIC
+	{ "Synthetic", Synthetic_ShadowSubsystemEntry },
+#endif
+
 	{ "", NULL }
 };
 
@@ -61,11 +77,23 @@ static pfnShadowSubsystemEntry shadow_subsystem_load_static_entry(const char* na
 {
 	int index;
 
+	if (!name)
+		name = getenv("FREERDP_SHADOW_SUBSYSTEM");
+
+#ifdef WITH_SHADOW_PIPEWIRE
+	/* only a screen cast granted to us is captured, never whatever node PipeWire offers */
+	if (!name &&
+	    (getenv("FREERDP_SHADOW_PIPEWIRE_NODE") || getenv("FREERDP_SHADOW_PIPEWIRE_FD")))
+		name = "PipeWire";
+#endif
+
 	if (!name)
 	{
 		for (index = 0; index < g_SubsystemCount; index++)
 		{
-			if (g_Subsystems[index].name)
+			/* a generated desktop or a screen cast is never shared unless asked for */
+			if (g_Subsystems[index].name && (strcmp(g_Subsystems[index].name, "Synthetic") != 0) &&
+			    (strcmp(g_Subsystems[index].name, "PipeWire") != 0))
 				return g_Subsystems[index].entry;
 		}
 
@@ -90,5 +118,11 @@ void shadow_subsystem_set_entry_builtin(const char* name)
 	if (entry)
 		shadow_subsystem_set_entry(entry);
 
+#if defined(WITH_SHADOW_PIPEWIRE) && defined(WITH_SHADOW_X11)
+	/* without the screen cast the X clients of the desktop can still be shared */
+	if (entry == PipeWire_ShadowSubsystemEntry)
+		shadow_subsystem_set_fallback_entry(X11_ShadowSubsystemEntry);
+#endif
+
 	return;
 }
@@ -41,6 +41,8 @@ rdpShadowSurface* shadow_surface_new(rdpShadowServer* server, UINT16 x, UINT16 y
 	surface->scanline = ALIGN_SCREEN_SIZE(surface->width, 32) * 4;
 	surface->format = PIXEL_FORMAT_BGRX32;
 	surface->data = (BYTE*)calloc(ALIGN_SCREEN_SIZE(surface->height, 32), surface->scanline);
+	surface->buffer = surface->data;
+	surface->bufferScanline = surface->scanline;
 
 	if (!surface->data)
 	{
@@ -64,7 +66,7 @@ void shadow_surface_free(rdpShadowSurface* surface)
 	if (!surface)
 		return;
 
-	free(surface->data);
+	free(surface->buffer);
 	DeleteCriticalSection(&(surface->lock));
 	region16_uninit(&(surface->invalidRegion));
 	free(surface);
@@ -87,7 +89,9 @@ BOOL shadow_surface_resize(rdpShadowSurface* surface, UINT16 x, UINT16 y, UINT32
 		return TRUE;
 	}
 
-	buffer = (BYTE*)realloc(surface->data, scanline * ALIGN_SCREEN_SIZE(height, 4));
+	/* an attached capture buffer has the old size */
+	shadow_surface_attach_buffer(surface, NULL, 0);
+	buffer = (BYTE*)realloc(surface->buffer, scanline * ALIGN_SCREEN_SIZE(height, 4));
 
 	if (buffer)
 	{
@@ -97,8 +101,33 @@ BOOL shadow_surface_resize(rdpShadowSurface* surface, UINT16 x, UINT16 y, UINT32
 		surface->height = height;
 		surface->scanline = scanline;
 		surface->data = buffer;
+		surface->buffer = buffer;
+		surface->bufferScanline = scanline;
 		return TRUE;
 	}
 
 	return FALSE;
 }
+
+/**
+ * Lets the surface use a frame buffer of the subsystem, so captured frames are encoded without
+ * being copied into the surface. data NULL switches back to the buffer of the surface, its
+ * content is stale then. The caller holds surface->lock and keeps the buffer valid while it is
+ * attached.
+ */
+void shadow_surface_attach_buffer(rdpShadowSurface* surface, BYTE* data, UINT32 scanline)
+{
+	if (!surface)
+		return;
+
+	if (data)
+	{
+		surface->data = data;
+		surface->scanline = scanline;
+	}
+	else
+	{
+		surface->data = surface->buffer;
+		surface->scanline = surface->bufferScanline;
+	}
+}
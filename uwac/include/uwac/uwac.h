@@ -533,8 +533,8 @@ extern "C"
 	 *	Sends a frame to the compositor with the content of the drawing buffer
 	 *
 	 * @param window the UwacWindow to refresh
-	 * @param copyContentForNextFrame if true the content to display is copied in the next drawing
-	 *buffer
+	 * @param copyContentForNextFrame if true the parts of the next drawing buffer that are older
+	 *than the content to display are copied to it, so only changes have to be drawn
 	 * @return UWAC_SUCCESS if the operation was successful
 	 */
 	UWAC_API UwacReturnCode UwacWindowSubmitBuffer(UwacWindow* window,
@@ -35,7 +35,7 @@
 #include "uwac-os.h"
 #include "wayland-cursor.h"
 
-#define TARGET_COMPOSITOR_INTERFACE 3U
+#define TARGET_COMPOSITOR_INTERFACE 4U
 #define TARGET_SHM_INTERFACE 1U
 #define TARGET_SHELL_INTERFACE 1U
 #define TARGET_DDM_INTERFACE 1U
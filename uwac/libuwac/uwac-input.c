@@ -105,7 +105,10 @@ static UwacReturnCode set_cursor_image(UwacSeat* seat, uint32_t serial)
 	{
 		case 2: /* Custom poiner */
 			image = seat->pointer_image;
-			buffer = create_pointer_buffer(seat, seat->pointer_data, seat->pointer_size);
+			if (!seat->pointer_buffer)
+				seat->pointer_buffer =
+				    create_pointer_buffer(seat, seat->pointer_data, seat->pointer_size);
+			buffer = seat->pointer_buffer;
 			if (!buffer)
 				return UWAC_ERROR_INTERNAL;
 			surface = seat->pointer_surface;
@@ -130,7 +133,10 @@ static UwacReturnCode set_cursor_image(UwacSeat* seat, uint32_t serial)
 			break;
 	}
 
-	if (buffer)
+	/* the custom pointer buffer is owned by the seat and attached again on every enter */
+	if (buffer && (buffer == seat->pointer_buffer))
+		buffer_add_listener_success = 0;
+	else if (buffer)
 	{
 		buffer_add_listener_success =
 		    wl_buffer_add_listener(buffer, &buffer_release_listener, seat);
@@ -1116,6 +1122,9 @@ void UwacSeatDestroy(UwacSeat* s)
 	if (s->pointer_surface)
 		wl_surface_destroy(s->pointer_surface);
 
+	if (s->pointer_buffer)
+		wl_buffer_destroy(s->pointer_buffer);
+
 	free(s->pointer_image);
 	free(s->pointer_data);
 
@@ -1152,12 +1161,42 @@ UwacReturnCode UwacSeatInhibitShortcuts(UwacSeat* s, bool inhibit)
 	return UWAC_SUCCESS;
 }
 
+static bool pointer_image_equal(const UwacSeat* seat, const void* data, size_t length,
+                                size_t width, size_t height, size_t hot_x, size_t hot_y)
+{
+	const struct wl_cursor_image* image = seat->pointer_image;
+
+	if ((seat->pointer_type != 2) || !image || !seat->pointer_buffer)
+		return false;
+
+	if ((image->width != width) || (image->height != height) || (image->hotspot_x != hot_x) ||
+	    (image->hotspot_y != hot_y) || (seat->pointer_size != length))
+		return false;
+
+	return memcmp(seat->pointer_data, data, length) == 0;
+}
+
 UwacReturnCode UwacSeatSetMouseCursor(UwacSeat* seat, const void* data, size_t length, size_t width,
                                       size_t height, size_t hot_x, size_t hot_y)
 {
+	UwacReturnCode rc;
+	struct wl_buffer* old_buffer;
+
 	if (!seat)
 		return UWAC_ERROR_CLOSED;
 
+	/* same cursor again, keep the shm buffer that is already on the pointer surface */
+	if ((data != NULL) && (length != 0) &&
+	    pointer_image_equal(seat, data, length, width, height, hot_x, hot_y))
+	{
+		if (!seat->default_cursor)
+			return UWAC_SUCCESS;
+		return set_cursor_image(seat, seat->display->serial);
+	}
+
+	old_buffer = seat->pointer_buffer;
+	seat->pointer_buffer = NULL;
+
 	free(seat->pointer_image);
 	seat->pointer_image = NULL;
 
@@ -1170,7 +1209,11 @@ UwacReturnCode UwacSeatSetMouseCursor(UwacSeat* seat, const void* data, size_t l
 	{
 		seat->pointer_image = xzalloc(sizeof(struct wl_cursor_image));
 		if (!seat->pointer_image)
+		{
+			if (old_buffer)
+				wl_buffer_destroy(old_buffer);
 			return UWAC_ERROR_NOMEMORY;
+		}
 		seat->pointer_image->width = width;
 		seat->pointer_image->height = height;
 		seat->pointer_image->hotspot_x = hot_x;
@@ -1193,7 +1236,13 @@ UwacReturnCode UwacSeatSetMouseCursor(UwacSeat* seat, const void* data, size_t l
 	{
 		seat->pointer_type = 1;
 	}
-	if (seat && !seat->default_cursor)
-		return UWAC_SUCCESS;
-	return set_cursor_image(seat, seat->display->serial);
+
+	rc = UWAC_SUCCESS;
+	if (seat->default_cursor)
+		rc = set_cursor_image(seat, seat->display->serial);
+
+	/* destroyed after the replacement was attached, shm contents stay valid until then */
+	if (old_buffer)
+		wl_buffer_destroy(old_buffer);
+	return rc;
 }
@@ -166,6 +166,7 @@ struct uwac_seat
 	struct wl_cursor* default_cursor;
 	void* pointer_data;
 	size_t pointer_size;
+	struct wl_buffer* pointer_buffer; /* shm copy of pointer_data, reused on every enter */
 	int pointer_type;
 	struct wl_keyboard* keyboard;
 	struct wl_touch* touch;
@@ -215,8 +216,10 @@ struct uwac_buffer
 	bool dirty;
 #ifdef HAVE_PIXMAN_REGION
 	pixman_region32_t damage;
+	pixman_region32_t stale;
 #else
 	REGION16 damage;
+	REGION16 stale;
 #endif
 	struct wl_buffer* wayland_buffer;
 	void* data;
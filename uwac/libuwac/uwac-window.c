@@ -65,8 +65,10 @@ static void UwacWindowDestroyBuffers(UwacWindow* w)
 		UwacBuffer* buffer = &w->buffers[i];
 #ifdef HAVE_PIXMAN_REGION
 		pixman_region32_fini(&buffer->damage);
+		pixman_region32_fini(&buffer->stale);
 #else
 		region16_uninit(&buffer->damage);
+		region16_uninit(&buffer->stale);
 #endif
 		UwacBufferReleaseData* releaseData =
 		    (UwacBufferReleaseData*)wl_buffer_get_user_data(buffer->wayland_buffer);
@@ -354,8 +356,13 @@ int UwacWindowShmAllocBuffers(UwacWindow* w, int nbuffers, int allocSize, uint32
 		UwacBuffer* buffer = &w->buffers[bufferIdx];
 #ifdef HAVE_PIXMAN_REGION
 		pixman_region32_init(&buffer->damage);
+		/* a new buffer has none of the content drawn so far */
+		pixman_region32_init_rect(&buffer->stale, 0, 0, width, height);
 #else
+		const RECTANGLE_16 box = { 0, 0, (UINT16)width, (UINT16)height };
 		region16_init(&buffer->damage);
+		region16_init(&buffer->stale);
+		region16_union_rect(&buffer->stale, &buffer->stale, &box);
 #endif
 		buffer->data = data + (allocSize * i);
 		buffer->size = allocSize;
@@ -652,6 +659,29 @@ static void frame_done_cb(void* data, struct wl_callback* callback, uint32_t tim
 
 static const struct wl_callback_listener frame_listener = { frame_done_cb };
 
+/* the damage is in buffer coordinates, surface damage only matches without a buffer scale */
+static void damage_rect(UwacWindow* window, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	if (wl_surface_get_version(window->surface) >= WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION)
+		wl_surface_damage_buffer(window->surface, x, y, width, height);
+	else
+		wl_surface_damage(window->surface, x, y, width, height);
+}
+
+static void copy_rect(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src, int32_t x,
+                      int32_t y, int32_t width, int32_t height)
+{
+	int32_t i;
+	const size_t offset = y * window->stride * 1ULL + x * bppFromShmFormat(window->format);
+	const size_t length = width * bppFromShmFormat(window->format) * 1ULL;
+
+	for (i = 0; i < height; i++)
+	{
+		const size_t line = offset + i * window->stride * 1ULL;
+		memcpy((char*)dst->data + line, (const char*)src->data + line, length);
+	}
+}
+
 #ifdef HAVE_PIXMAN_REGION
 static void damage_surface(UwacWindow* window, UwacBuffer* buffer)
 {
@@ -659,11 +689,26 @@ static void damage_surface(UwacWindow* window, UwacBuffer* buffer)
 	const pixman_box32_t* box = pixman_region32_rectangles(&buffer->damage, &nrects);
 
 	for (i = 0; i < nrects; i++, box++)
-		wl_surface_damage(window->surface, box->x1, box->y1, (box->x2 - box->x1),
-		                  (box->y2 - box->y1));
+		damage_rect(window, box->x1, box->y1, (box->x2 - box->x1), (box->y2 - box->y1));
 
 	pixman_region32_clear(&buffer->damage);
 }
+
+static void add_stale(UwacBuffer* buffer, const UwacBuffer* submitted)
+{
+	pixman_region32_union(&buffer->stale, &buffer->stale, &submitted->damage);
+}
+
+static void copy_stale(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src)
+{
+	int nrects, i;
+	const pixman_box32_t* box = pixman_region32_rectangles(&dst->stale, &nrects);
+
+	for (i = 0; i < nrects; i++, box++)
+		copy_rect(window, dst, src, box->x1, box->y1, (box->x2 - box->x1), (box->y2 - box->y1));
+
+	pixman_region32_clear(&dst->stale);
+}
 #else
 static void damage_surface(UwacWindow* window, UwacBuffer* buffer)
 {
@@ -671,11 +716,32 @@ static void damage_surface(UwacWindow* window, UwacBuffer* buffer)
 	const RECTANGLE_16* box = region16_rects(&buffer->damage, &nrects);
 
 	for (i = 0; i < nrects; i++, box++)
-		wl_surface_damage(window->surface, box->left, box->top, (box->right - box->left),
-		                  (box->bottom - box->top));
+		damage_rect(window, box->left, box->top, (box->right - box->left),
+		            (box->bottom - box->top));
 
 	region16_clear(&buffer->damage);
 }
+
+static void add_stale(UwacBuffer* buffer, const UwacBuffer* submitted)
+{
+	uint32_t nrects, i;
+	const RECTANGLE_16* box = region16_rects(&submitted->damage, &nrects);
+
+	for (i = 0; i < nrects; i++, box++)
+		region16_union_rect(&buffer->stale, &buffer->stale, box);
+}
+
+static void copy_stale(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src)
+{
+	uint32_t nrects, i;
+	const RECTANGLE_16* box = region16_rects(&dst->stale, &nrects);
+
+	for (i = 0; i < nrects; i++, box++)
+		copy_rect(window, dst, src, box->left, box->top, (box->right - box->left),
+		          (box->bottom - box->top));
+
+	region16_clear(&dst->stale);
+}
 #endif
 
 static void UwacSubmitBufferPtr(UwacWindow* window, UwacBuffer* buffer)
@@ -766,6 +832,7 @@ UwacReturnCode UwacWindowGetDrawingBufferGeometry(UwacWindow* window, UwacSize*
 
 UwacReturnCode UwacWindowSubmitBuffer(UwacWindow* window, bool copyContentForNextFrame)
 {
+	ssize_t i;
 	UwacBuffer* currentDrawingBuffer;
 	UwacBuffer* nextDrawingBuffer;
 	UwacBuffer* pendingBuffer;
@@ -785,9 +852,18 @@ UwacReturnCode UwacWindowSubmitBuffer(UwacWindow* window, bool copyContentForNex
 	if ((!nextDrawingBuffer) || (window->drawingBufferIdx < 0))
 		return UWAC_ERROR_NOMEMORY;
 
+	/*
+	 * Every other buffer misses what was drawn to the submitted one. The next drawing buffer
+	 * only gets those parts copied, so the caller can redraw just what changed.
+	 */
+	for (i = 0; i < window->nbuffers; i++)
+	{
+		if (i != window->pendingBufferIdx)
+			add_stale(&window->buffers[i], pendingBuffer);
+	}
+
 	if (copyContentForNextFrame)
-		memcpy(nextDrawingBuffer->data, pendingBuffer->data,
-		       window->stride * window->height * 1ULL);
+		copy_stale(window, nextDrawingBuffer, pendingBuffer);
 
 	UwacSubmitBufferPtr(window, pendingBuffer);
 	return UWAC_SUCCESS;
@@ -425,6 +425,19 @@ extern "C"
 	WINPR_API int MessageQueue_Get(wMessageQueue* queue, wMessage* message);
 	WINPR_API int MessageQueue_Peek(wMessageQueue* queue, wMessage* message, BOOL remove);
 
+	/*! \brief Removes up to count messages from the queue in one go.
+	 *
+	 *  Does not wait, use \b MessageQueue_Wait or the queue event first.
+	 *  Stops after a \b WMQ_QUIT message, which is returned as the last one.
+	 *
+	 *  \param queue The queue to read from.
+	 *  \param messages Array receiving the messages.
+	 *  \param count Number of elements of \b messages.
+	 *
+	 *  \return The number of messages removed.
+	 */
+	WINPR_API size_t MessageQueue_GetBatch(wMessageQueue* queue, wMessage* messages, size_t count);
+
 	/*! \brief Clears all elements in a message queue.
 	 *
 	 *  \note If dynamically allocated data is part of the messages,
@@ -555,6 +568,12 @@ extern "C"
 	WINPR_API void PubSub_AddEventTypes(wPubSub* pubSub, wEventType* events, size_t count);
 	WINPR_API wEventType* PubSub_FindEventType(wPubSub* pubSub, const char* EventName);
 
+	/**
+	 * Resolves an event name to an ID that stays valid for the lifetime of pubSub, raising
+	 * by ID skips the name lookup. Returns -1 for unknown events.
+	 */
+	WINPR_API int PubSub_GetEventId(wPubSub* pubSub, const char* EventName);
+
 	WINPR_API int PubSub_Subscribe(wPubSub* pubSub, const char* EventName,
 	                               pEventHandler EventHandler);
 	WINPR_API int PubSub_Unsubscribe(wPubSub* pubSub, const char* EventName,
@@ -562,6 +581,8 @@ extern "C"
 
 	WINPR_API int PubSub_OnEvent(wPubSub* pubSub, const char* EventName, void* context,
 	                             const wEventArgs* e);
+	WINPR_API int PubSub_OnEventId(wPubSub* pubSub, int EventId, void* context,
+	                               const wEventArgs* e);
 
 	WINPR_API wPubSub* PubSub_New(BOOL synchronized);
 	WINPR_API void PubSub_Free(wPubSub* pubSub);
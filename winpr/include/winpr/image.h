@@ -86,6 +86,13 @@ extern "C"
 	WINPR_API BYTE* winpr_bitmap_construct_header(size_t width, size_t height, size_t bpp);
 
 	WINPR_API int winpr_image_write(wImage* image, const char* filename);
+
+	/**
+	 * Encodes the image in memory.
+	 * @param format WINPR_IMAGE_BITMAP or WINPR_IMAGE_PNG
+	 * @return the encoded image, to be freed with free(), or NULL on failure
+	 */
+	WINPR_API void* winpr_image_write_buffer(wImage* image, UINT32 format, size_t* size);
 	WINPR_API int winpr_image_read(wImage* image, const char* filename);
 
 	WINPR_API int winpr_image_read_buffer(wImage* image, const BYTE* buffer, size_t size);
@@ -61,10 +61,35 @@ extern "C"
 	WINPR_API wStream* Stream_StaticInit(wStream* s, BYTE* buffer, size_t size);
 	WINPR_API void Stream_Free(wStream* s, BOOL bFreeBuffer);
 
+	/**
+	 * Checks once that _n bytes are left to read. When it succeeds the Stream_Read_* calls
+	 * consuming those bytes need no further checks. Unlike Stream_GetRemainingLength this is
+	 * inlined and does not log, the caller reports the error.
+	 */
+	static INLINE BOOL Stream_CheckRequiredLength(const wStream* _s, size_t _n)
+	{
+		size_t cur;
+		WINPR_ASSERT(_s);
+		cur = (size_t)(_s->pointer - _s->buffer);
+		if (cur > _s->length)
+			return FALSE;
+		return (_s->length - cur) >= _n;
+	}
+
+	/* Same as Stream_CheckRequiredLength for _count elements of _size bytes each */
+	static INLINE BOOL Stream_CheckRequiredLengthOfSize(const wStream* _s, size_t _count,
+	                                                    size_t _size)
+	{
+		if ((_size != 0) && (_count > SIZE_MAX / _size))
+			return FALSE;
+		return Stream_CheckRequiredLength(_s, _count * _size);
+	}
+
 	static INLINE void Stream_Seek(wStream* s, size_t _offset)
 	{
 		WINPR_ASSERT(s);
-		WINPR_ASSERT(Stream_GetRemainingCapacity(s) >= _offset);
+		WINPR_ASSERT((size_t)(s->pointer - s->buffer) <= s->capacity);
+		WINPR_ASSERT(s->capacity - (size_t)(s->pointer - s->buffer) >= _offset);
 		s->pointer += (_offset);
 	}
 
@@ -85,7 +110,7 @@ extern "C"
 	do                                                    \
 	{                                                     \
 		WINPR_ASSERT(_s);                                 \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 1); \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 1));  \
 		(_v) = (_t)(*(_s)->pointer);                      \
 		if (_p)                                           \
 			Stream_Seek(_s, sizeof(_t));                  \
@@ -95,7 +120,7 @@ extern "C"
 	do                                                                           \
 	{                                                                            \
 		WINPR_ASSERT(_s);                                                        \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 2);                        \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 2));                         \
 		(_v) = (_t)((*(_s)->pointer) + (((UINT16)(*((_s)->pointer + 1))) << 8)); \
 		if (_p)                                                                  \
 			Stream_Seek(_s, sizeof(_t));                                         \
@@ -105,7 +130,7 @@ extern "C"
 	do                                                                                   \
 	{                                                                                    \
 		WINPR_ASSERT(_s);                                                                \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 2);                                \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 2));                                 \
 		(_v) = (_t)((((UINT16)(*(_s)->pointer)) << 8) + (UINT16)(*((_s)->pointer + 1))); \
 		if (_p)                                                                          \
 			Stream_Seek(_s, sizeof(_t));                                                 \
@@ -115,7 +140,7 @@ extern "C"
 	do                                                                                   \
 	{                                                                                    \
 		WINPR_ASSERT(_s);                                                                \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 4);                                \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 4));                                 \
 		(_v) = (_t)((UINT32)(*(_s)->pointer) + (((UINT32)(*((_s)->pointer + 1))) << 8) + \
 		            (((UINT32)(*((_s)->pointer + 2))) << 16) +                           \
 		            ((((UINT32) * ((_s)->pointer + 3))) << 24));                         \
@@ -127,7 +152,7 @@ extern "C"
 	do                                                                                             \
 	{                                                                                              \
 		WINPR_ASSERT(_s);                                                                          \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 4);                                          \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 4));                                           \
 		(_v) = (_t)(((((UINT32) * ((_s)->pointer))) << 24) +                                       \
 		            (((UINT32)(*((_s)->pointer + 1))) << 16) +                                     \
 		            (((UINT32)(*((_s)->pointer + 2))) << 8) + (((UINT32)(*((_s)->pointer + 3))))); \
@@ -139,7 +164,7 @@ extern "C"
 	do                                                                                   \
 	{                                                                                    \
 		WINPR_ASSERT(_s);                                                                \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 8);                                \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 8));                                 \
 		(_v) = (_t)((UINT64)(*(_s)->pointer) + (((UINT64)(*((_s)->pointer + 1))) << 8) + \
 		            (((UINT64)(*((_s)->pointer + 2))) << 16) +                           \
 		            (((UINT64)(*((_s)->pointer + 3))) << 24) +                           \
@@ -155,7 +180,7 @@ extern "C"
 	do                                                                                             \
 	{                                                                                              \
 		WINPR_ASSERT(_s);                                                                          \
-		WINPR_ASSERT(Stream_GetRemainingLength(_s) >= 8);                                          \
+		WINPR_ASSERT(Stream_CheckRequiredLength(_s, 8));                                           \
 		(_v) =                                                                                     \
 		    (_t)((((UINT64)(*((_s)->pointer))) << 56) + (((UINT64)(*((_s)->pointer + 1))) << 48) + \
 		         (((UINT64)(*((_s)->pointer + 2))) << 40) +                                        \
@@ -197,6 +222,44 @@ extern "C"
 		Stream_Seek(_s, _n);
 	}
 
+	/**
+	 * Bulk readers for arrays of little endian values, the caller validates the length once
+	 * with Stream_CheckRequiredLengthOfSize. On little endian hosts this is a plain copy.
+	 */
+	static INLINE void Stream_Read_UINT16_Array(wStream* _s, UINT16* _v, size_t _count)
+	{
+		WINPR_ASSERT(_s);
+		WINPR_ASSERT(_v || (_count == 0));
+		WINPR_ASSERT(Stream_CheckRequiredLengthOfSize(_s, _count, sizeof(UINT16)));
+#if defined(__BIG_ENDIAN__)
+		{
+			size_t x;
+			for (x = 0; x < _count; x++)
+				_stream_read_n16_le(UINT16, _s, _v[x], TRUE);
+		}
+#else
+		memcpy(_v, _s->pointer, _count * sizeof(UINT16));
+		Stream_Seek(_s, _count * sizeof(UINT16));
+#endif
+	}
+
+	static INLINE void Stream_Read_UINT32_Array(wStream* _s, UINT32* _v, size_t _count)
+	{
+		WINPR_ASSERT(_s);
+		WINPR_ASSERT(_v || (_count == 0));
+		WINPR_ASSERT(Stream_CheckRequiredLengthOfSize(_s, _count, sizeof(UINT32)));
+#if defined(__BIG_ENDIAN__)
+		{
+			size_t x;
+			for (x = 0; x < _count; x++)
+				_stream_read_n32_le(UINT32, _s, _v[x], TRUE);
+		}
+#else
+		memcpy(_v, _s->pointer, _count * sizeof(UINT32));
+		Stream_Seek(_s, _count * sizeof(UINT32));
+#endif
+	}
+
 #define Stream_Peek_UINT8(_s, _v) _stream_read_n8(UINT8, _s, _v, FALSE)
 #define Stream_Peek_INT8(_s, _v) _stream_read_n8(INT8, _s, _v, FALSE)
 
@@ -417,6 +417,29 @@ extern "C"
 
 	WINPR_API void* GetEventWaitObject(HANDLE hEvent);
 
+	/* Persistent wait sets, for loops waiting on the same handles over and over.
+	 * Handles are registered once (epoll or kqueue where available) instead of being
+	 * passed to the kernel on every wait. With a kernel queue a set can hold more than
+	 * MAXIMUM_WAIT_OBJECTS handles. A set must only be used by one thread. */
+	typedef struct winpr_wait_set WINPR_WAIT_SET;
+
+	WINPR_API WINPR_WAIT_SET* winpr_WaitSetNew(void);
+	WINPR_API void winpr_WaitSetFree(WINPR_WAIT_SET* set);
+
+	WINPR_API BOOL winpr_WaitSetAdd(WINPR_WAIT_SET* set, HANDLE hHandle);
+	WINPR_API BOOL winpr_WaitSetRemove(WINPR_WAIT_SET* set, HANDLE hHandle);
+	/* Registers exactly lpHandles, a no-op if the set already holds them in this order */
+	WINPR_API BOOL winpr_WaitSetUpdate(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles);
+	WINPR_API DWORD winpr_WaitSetCount(WINPR_WAIT_SET* set);
+
+	/* Waits for any of the handles, returns WAIT_OBJECT_0 + the lowest signaled index in
+	 * registration order just like WaitForMultipleObjects with bWaitAll = FALSE */
+	WINPR_API DWORD winpr_WaitSetWait(WINPR_WAIT_SET* set, DWORD dwMilliseconds);
+	/* Reports up to nCount signaled indices in ascending order, returns WAIT_OBJECT_0 once at
+	 * least one is reported. Only the kernel queue backends report more than one. */
+	WINPR_API DWORD winpr_WaitSetWaitEx(WINPR_WAIT_SET* set, DWORD dwMilliseconds,
+	                                    DWORD* lpIndices, DWORD nCount, DWORD* lpSignaled);
+
 #ifdef __cplusplus
 }
 #endif
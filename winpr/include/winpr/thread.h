@@ -226,6 +226,11 @@ extern "C"
 
 	WINPR_API DWORD GetCurrentProcessorNumber(void);
 
+	WINPR_API DWORD_PTR SetThreadAffinityMask(HANDLE hThread, DWORD_PTR dwThreadAffinityMask);
+
+	WINPR_API BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber);
+	WINPR_API BOOL GetNumaNodeProcessorMask(UCHAR Node, PULONGLONG ProcessorMask);
+
 	/* Thread-Local Storage */
 
 #define TLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
@@ -249,6 +254,12 @@ extern "C"
 
 	WINPR_API LPSTR* CommandLineToArgvA(LPCSTR lpCmdLine, int* pNumArgs);
 
+	/**
+	 * Parses a processor affinity string, either a cpu list like "0-3,8" or
+	 * "node:<n>" for all processors of a NUMA node.
+	 */
+	WINPR_API BOOL winpr_ParseProcessorMask(const char* str, ULONGLONG* mask);
+
 #if defined(WITH_DEBUG_THREADS)
 	WINPR_API VOID DumpThreadHandles(void);
 #endif
@@ -114,29 +114,40 @@ extern "C"
 	WINPR_API DWORD WLog_GetLogLevel(wLog* log);
 	WINPR_API BOOL WLog_IsLevelActive(wLog* _log, DWORD _log_level);
 
-#define WLog_Print(_log, _log_level, ...)                                              \
-	do                                                                                 \
-	{                                                                                  \
-		if (WLog_IsLevelActive(_log, _log_level))                                      \
-		{                                                                              \
-			WLog_PrintMessage(_log, WLOG_MESSAGE_TEXT, _log_level, __LINE__, __FILE__, \
-			                  __FUNCTION__, __VA_ARGS__);                              \
-		}                                                                              \
+/* Messages below this level are compiled out, with a constant level the
+ * compiler drops the whole call including the format arguments. */
+#if defined(WITH_WLOG_STRIP_DEBUG)
+#define WLog_IsLevelCompiled(_log_level) ((DWORD)(_log_level) >= WLOG_INFO)
+#else
+#define WLog_IsLevelCompiled(_log_level) TRUE
+#endif
+
+#define WLog_Print(_log, _log_level, ...)                                                  \
+	do                                                                                     \
+	{                                                                                      \
+		if (WLog_IsLevelCompiled(_log_level) && WLog_IsLevelActive(_log, _log_level))      \
+		{                                                                                  \
+			WLog_PrintMessage(_log, WLOG_MESSAGE_TEXT, _log_level, __LINE__, __FILE__,     \
+			                  __FUNCTION__, __VA_ARGS__);                                  \
+		}                                                                                  \
 	} while (0)
 
-#define WLog_Print_tag(_tag, _log_level, ...)                 \
-	do                                                        \
-	{                                                         \
-		static wLog* _log_cached_ptr = NULL;                  \
-		if (!_log_cached_ptr)                                 \
-			_log_cached_ptr = WLog_Get(_tag);                 \
-		WLog_Print(_log_cached_ptr, _log_level, __VA_ARGS__); \
+#define WLog_Print_tag(_tag, _log_level, ...)                     \
+	do                                                            \
+	{                                                             \
+		static wLog* _log_cached_ptr = NULL;                      \
+		if (WLog_IsLevelCompiled(_log_level))                     \
+		{                                                         \
+			if (!_log_cached_ptr)                                 \
+				_log_cached_ptr = WLog_Get(_tag);                 \
+			WLog_Print(_log_cached_ptr, _log_level, __VA_ARGS__); \
+		}                                                         \
 	} while (0)
 
 #define WLog_PrintVA(_log, _log_level, _args)                                            \
 	do                                                                                   \
 	{                                                                                    \
-		if (WLog_IsLevelActive(_log, _log_level))                                        \
+		if (WLog_IsLevelCompiled(_log_level) && WLog_IsLevelActive(_log, _log_level))    \
 		{                                                                                \
 			WLog_PrintMessageVA(_log, WLOG_MESSAGE_TEXT, _log_level, __LINE__, __FILE__, \
 			                    __FUNCTION__, _args);                                    \
@@ -146,7 +157,7 @@ extern "C"
 #define WLog_Data(_log, _log_level, ...)                                               \
 	do                                                                                 \
 	{                                                                                  \
-		if (WLog_IsLevelActive(_log, _log_level))                                      \
+		if (WLog_IsLevelCompiled(_log_level) && WLog_IsLevelActive(_log, _log_level))  \
 		{                                                                              \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_DATA, _log_level, __LINE__, __FILE__, \
 			                  __FUNCTION__, __VA_ARGS__);                              \
@@ -156,7 +167,7 @@ extern "C"
 #define WLog_Image(_log, _log_level, ...)                                              \
 	do                                                                                 \
 	{                                                                                  \
-		if (WLog_IsLevelActive(_log, _log_level))                                      \
+		if (WLog_IsLevelCompiled(_log_level) && WLog_IsLevelActive(_log, _log_level))  \
 		{                                                                              \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_DATA, _log_level, __LINE__, __FILE__, \
 			                  __FUNCTION__, __VA_ARGS__);                              \
@@ -166,7 +177,7 @@ extern "C"
 #define WLog_Packet(_log, _log_level, ...)                                               \
 	do                                                                                   \
 	{                                                                                    \
-		if (WLog_IsLevelActive(_log, _log_level))                                        \
+		if (WLog_IsLevelCompiled(_log_level) && WLog_IsLevelActive(_log, _log_level))    \
 		{                                                                                \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_PACKET, _log_level, __LINE__, __FILE__, \
 			                  __FUNCTION__, __VA_ARGS__);                                \
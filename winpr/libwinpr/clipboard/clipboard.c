@@ -153,11 +153,66 @@ void ClipboardUnlock(wClipboard* clipboard)
 	LeaveCriticalSection(&(clipboard->lock));
 }
 
+/* conversions larger than this in total are synthesized again on every request */
+#define CLIPBOARD_CONVERSIONS_MAX_SIZE (64 * 1024 * 1024)
+
+static void ClipboardClearConversions(wClipboard* clipboard)
+{
+	UINT32 index;
+
+	for (index = 0; index < clipboard->numConversions; index++)
+		free(clipboard->conversions[index].data);
+
+	clipboard->numConversions = 0;
+	clipboard->conversionsSize = 0;
+}
+
+static const wClipboardConversion* ClipboardFindConversion(wClipboard* clipboard,
+                                                           UINT32 formatId)
+{
+	UINT32 index;
+
+	for (index = 0; index < clipboard->numConversions; index++)
+	{
+		const wClipboardConversion* conversion = &clipboard->conversions[index];
+
+		if (conversion->formatId == formatId)
+			return conversion;
+	}
+
+	return NULL;
+}
+
+static void ClipboardAddConversion(wClipboard* clipboard, UINT32 formatId, const void* data,
+                                   UINT32 size)
+{
+	wClipboardConversion* conversion;
+	const UINT32 maxConversions = ARRAYSIZE(clipboard->conversions);
+
+	if ((clipboard->numConversions >= maxConversions) ||
+	    (size > CLIPBOARD_CONVERSIONS_MAX_SIZE - clipboard->conversionsSize))
+		return;
+
+	conversion = &clipboard->conversions[clipboard->numConversions];
+	conversion->data = malloc(size);
+
+	if (!conversion->data)
+		return;
+
+	CopyMemory(conversion->data, data, size);
+	conversion->formatId = formatId;
+	conversion->size = size;
+	clipboard->numConversions++;
+	clipboard->conversionsSize += size;
+}
+
 BOOL ClipboardEmpty(wClipboard* clipboard)
 {
 	if (!clipboard)
 		return FALSE;
 
+	ClipboardClearConversions(clipboard);
+
 	if (clipboard->data)
 	{
 		free((void*)clipboard->data);
@@ -457,6 +512,20 @@ void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
 	}
 	else
 	{
+		const wClipboardConversion* conversion = ClipboardFindConversion(clipboard, formatId);
+
+		if (conversion)
+		{
+			pDstData = malloc(conversion->size);
+
+			if (!pDstData)
+				return NULL;
+
+			CopyMemory(pDstData, conversion->data, conversion->size);
+			*pSize = conversion->size;
+			return pDstData;
+		}
+
 		synthesizer = ClipboardFindSynthesizer(format, formatId);
 
 		if (!synthesizer || !synthesizer->pfnSynthesize)
@@ -465,7 +534,10 @@ void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
 		DstSize = SrcSize;
 		pDstData = synthesizer->pfnSynthesize(clipboard, format->formatId, pSrcData, &DstSize);
 		if (pDstData)
+		{
+			ClipboardAddConversion(clipboard, formatId, pDstData, DstSize);
 			*pSize = DstSize;
+		}
 	}
 
 	return pDstData;
@@ -483,6 +555,19 @@ BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data,
 	if (!format)
 		return FALSE;
 
+	/* The same data is set again for every format requested from it, keep what was
+	 * synthesized from it and the file list, they were derived from identical data */
+	if (clipboard->data && (clipboard->formatId == formatId) && (clipboard->size == size) &&
+	    (memcmp(clipboard->data, data, size) == 0))
+	{
+		if (clipboard->fileListSequenceNumber == clipboard->sequenceNumber)
+			clipboard->fileListSequenceNumber++;
+
+		clipboard->sequenceNumber++;
+		return TRUE;
+	}
+
+	ClipboardClearConversions(clipboard);
 	free((void*)clipboard->data);
 	clipboard->data = malloc(size);
 
@@ -601,6 +686,7 @@ void ClipboardDestroy(wClipboard* clipboard)
 		}
 	}
 
+	ClipboardClearConversions(clipboard);
 	free((void*)clipboard->data);
 	clipboard->data = NULL;
 	clipboard->size = 0;
@@ -39,6 +39,13 @@ typedef struct
 	wClipboardSynthesizer* synthesizers;
 } wClipboardFormat;
 
+typedef struct
+{
+	UINT32 formatId;
+	UINT32 size;
+	void* data;
+} wClipboardConversion;
+
 struct s_wClipboard
 {
 	UINT64 ownerId;
@@ -57,6 +64,12 @@ struct s_wClipboard
 	UINT32 formatId;
 	UINT32 sequenceNumber;
 
+	/* synthesized data of the current sequence number */
+
+	UINT32 numConversions;
+	size_t conversionsSize;
+	wClipboardConversion conversions[8];
+
 	/* clipboard file handling */
 
 	wArrayList* localFiles;
@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <winpr/crt.h>
 #include <winpr/user.h>
+#include <winpr/image.h>
 
 #include "clipboard.h"
 
@@ -323,6 +324,118 @@ static void* clipboard_synthesize_image_bmp(wClipboard* clipboard, UINT32 format
 	return NULL;
 }
 
+/**
+ * "image/png":
+ *
+ * PNG file format, only encoded when an application asks for it.
+ */
+
+static void* clipboard_synthesize_image_png(wClipboard* clipboard, UINT32 formatId,
+                                            const void* data, UINT32* pSize)
+{
+	size_t x, y;
+	size_t size = 0;
+	size_t offset, stride, srcBpp, dstBpp;
+	BOOL alpha;
+	void* pDstData;
+	wImage image = { 0 };
+	const BITMAPINFOHEADER* pInfoHeader;
+	const BYTE* pSrcData = (const BYTE*)data;
+	size_t SrcSize = *pSize;
+
+	if (formatId == ClipboardGetFormatId(clipboard, "image/bmp"))
+	{
+		if ((SrcSize < sizeof(BITMAPFILEHEADER)) ||
+		    (((const BITMAPFILEHEADER*)pSrcData)->bfType != 0x4D42))
+			return NULL;
+
+		pSrcData += sizeof(BITMAPFILEHEADER);
+		SrcSize -= sizeof(BITMAPFILEHEADER);
+	}
+	else if ((formatId != CF_DIB) && (formatId != CF_DIBV5))
+		return NULL;
+
+	if (SrcSize < sizeof(BITMAPINFOHEADER))
+		return NULL;
+
+	pInfoHeader = (const BITMAPINFOHEADER*)pSrcData;
+
+	if ((pInfoHeader->biSize < sizeof(BITMAPINFOHEADER)) || (pInfoHeader->biWidth <= 0) ||
+	    (pInfoHeader->biHeight == 0) || (pInfoHeader->biHeight == INT32_MIN))
+		return NULL;
+
+	if ((pInfoHeader->biBitCount != 24) && (pInfoHeader->biBitCount != 32))
+		return NULL;
+
+	if ((pInfoHeader->biCompression != BI_RGB) &&
+	    ((pInfoHeader->biCompression != BI_BITFIELDS) || (pInfoHeader->biBitCount != 32)))
+		return NULL;
+
+	/* the color masks of a plain BITMAPINFOHEADER follow it, like a color table */
+	offset = pInfoHeader->biSize + pInfoHeader->biClrUsed * sizeof(RGBQUAD);
+	if ((pInfoHeader->biCompression == BI_BITFIELDS) &&
+	    (pInfoHeader->biSize == sizeof(BITMAPINFOHEADER)))
+		offset += 3 * sizeof(DWORD);
+
+	/* the fourth byte is only alpha if a V5 header says so */
+	alpha = (pInfoHeader->biBitCount == 32) && (pInfoHeader->biSize >= sizeof(BITMAPV5HEADER)) &&
+	        (((const BITMAPV5HEADER*)pSrcData)->bV5AlphaMask != 0);
+
+	image.width = (UINT32)pInfoHeader->biWidth;
+	image.height = (UINT32)abs(pInfoHeader->biHeight);
+	srcBpp = pInfoHeader->biBitCount / 8;
+	dstBpp = alpha ? 4 : 3;
+
+	if (image.width > SrcSize / srcBpp)
+		return NULL;
+	stride = ((image.width * srcBpp + 3) / 4) * 4;
+
+	if ((offset > SrcSize) || (image.height > (SrcSize - offset) / stride))
+		return NULL;
+
+	image.type = WINPR_IMAGE_PNG;
+	image.bitsPerPixel = (UINT32)dstBpp * 8;
+	image.bytesPerPixel = (UINT32)dstBpp;
+	image.scanline = image.width * image.bytesPerPixel;
+	image.data = malloc((size_t)image.scanline * image.height);
+
+	if (!image.data)
+		return NULL;
+
+	/* bottom-up BGR(A) to top-down RGB(A) */
+	for (y = 0; y < image.height; y++)
+	{
+		const size_t row = (pInfoHeader->biHeight > 0) ? image.height - 1 - y : y;
+		const BYTE* pSrc = &pSrcData[offset + row * stride];
+		BYTE* pDst = &image.data[y * image.scanline];
+
+		for (x = 0; x < image.width; x++)
+		{
+			pDst[0] = pSrc[2];
+			pDst[1] = pSrc[1];
+			pDst[2] = pSrc[0];
+
+			if (alpha)
+				pDst[3] = pSrc[3];
+
+			pSrc += srcBpp;
+			pDst += dstBpp;
+		}
+	}
+
+	pDstData = winpr_image_write_buffer(&image, WINPR_IMAGE_PNG, &size);
+	free(image.data);
+
+	if (!pDstData || (size > UINT32_MAX))
+	{
+		free(pDstData);
+		return NULL;
+	}
+
+	*pSize = (UINT32)size;
+	return pDstData;
+}
+
 /**
  * "HTML Format":
  *
@@ -608,6 +721,21 @@ BOOL ClipboardInitSynthesizers(wClipboard* clipboard)
 		ClipboardRegisterSynthesizer(clipboard, formatId, CF_DIBV5, clipboard_synthesize_cf_dibv5);
 	}
 
+	/**
+	 * image/png
+	 */
+	altFormatId = ClipboardRegisterFormat(clipboard, "image/png");
+
+	if (altFormatId)
+	{
+		ClipboardRegisterSynthesizer(clipboard, CF_DIB, altFormatId,
+		                             clipboard_synthesize_image_png);
+		ClipboardRegisterSynthesizer(clipboard, CF_DIBV5, altFormatId,
+		                             clipboard_synthesize_image_png);
+		ClipboardRegisterSynthesizer(clipboard, ClipboardGetFormatId(clipboard, "image/bmp"),
+		                             altFormatId, clipboard_synthesize_image_png);
+	}
+
 	/**
 	 * HTML Format
 	 */
@@ -1,8 +1,51 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/image.h>
 #include <winpr/clipboard.h>
 
+/* a bottom-up 3x2 CF_DIB is encoded to a top-down PNG */
+static BOOL test_dib_to_png(wClipboard* clipboard)
+{
+	BOOL rc = FALSE;
+	UINT32 size = 0;
+	BYTE* png = NULL;
+	wImage* image = NULL;
+	BYTE dib[sizeof(BITMAPINFOHEADER) + 2 * 12] = { 0 };
+	BITMAPINFOHEADER* header = (BITMAPINFOHEADER*)dib;
+	const BYTE rows[2][12] = { { 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 0, 0 },
+		                       { 10, 20, 30, 40, 50, 60, 70, 80, 90, 0, 0, 0 } };
+	const BYTE expected[] = { 30, 20, 10, 0xFF, 60, 50, 40, 0xFF, 90, 80, 70, 0xFF,
+		                      3,  2,  1,  0xFF, 6,  5,  4,  0xFF, 9,  8,  7,  0xFF };
+
+	header->biSize = sizeof(BITMAPINFOHEADER);
+	header->biWidth = 3;
+	header->biHeight = 2;
+	header->biPlanes = 1;
+	header->biBitCount = 24;
+	header->biCompression = BI_RGB;
+	memcpy(&dib[sizeof(BITMAPINFOHEADER)], rows, sizeof(rows));
+
+	if (!ClipboardSetData(clipboard, CF_DIB, dib, sizeof(dib)))
+		return FALSE;
+
+	png = ClipboardGetData(clipboard, ClipboardGetFormatId(clipboard, "image/png"), &size);
+	image = winpr_image_new();
+
+	if (!png || !image || (winpr_image_read_buffer(image, png, size) < 0))
+		goto fail;
+
+	rc = (image->width == 3) && (image->height == 2) &&
+	     (memcmp(image->data, expected, sizeof(expected)) == 0);
+fail:
+	if (!rc)
+		fprintf(stderr, "CF_DIB to image/png conversion failed\n");
+
+	winpr_image_free(image, TRUE);
+	free(png);
+	return rc;
+}
+
 int TestClipboardFormats(int argc, char* argv[])
 {
 	UINT32 index;
@@ -73,6 +116,46 @@ int TestClipboardFormats(int argc, char* argv[])
 		free(pSrcData);
 	}
 
+	if (1)
+	{
+		BOOL rc = FALSE;
+		UINT32 DstSize = 0;
+		char* pSrcData = NULL;
+		WCHAR* pDstData;
+		const char* pNewData = "this is another test string";
+
+		/* synthesized again from the new data, not taken from the previous conversion */
+		ClipboardSetData(clipboard, utf8StringFormatId, pNewData, (UINT32)strlen(pNewData) + 1);
+		pDstData = (WCHAR*)ClipboardGetData(clipboard, CF_UNICODETEXT, &DstSize);
+		ConvertFromUnicode(CP_UTF8, 0, pDstData, -1, &pSrcData, 0, NULL, NULL);
+		free(pDstData);
+
+		if (pSrcData && (strcmp(pSrcData, pNewData) == 0))
+		{
+			free(pSrcData);
+			pSrcData = NULL;
+			pDstData = (WCHAR*)ClipboardGetData(clipboard, CF_UNICODETEXT, &DstSize);
+			ConvertFromUnicode(CP_UTF8, 0, pDstData, -1, &pSrcData, 0, NULL, NULL);
+			free(pDstData);
+			rc = pSrcData && (strcmp(pSrcData, pNewData) == 0);
+		}
+
+		free(pSrcData);
+
+		if (!rc)
+		{
+			fprintf(stderr, "ClipboardGetData (synthetic) returned stale data\n");
+			ClipboardDestroy(clipboard);
+			return -1;
+		}
+	}
+
+	if (!test_dib_to_png(clipboard))
+	{
+		ClipboardDestroy(clipboard);
+		return -1;
+	}
+
 	pFormatIds = NULL;
 	count = ClipboardGetFormatIds(clipboard, &pFormatIds);
 
@@ -53,8 +53,9 @@ static TP_POOL DEFAULT_POOL = {
 	500,  /* DWORD Maximum */
 	NULL, /* wArrayList* Threads */
 	NULL, /* wQueue* PendingQueue */
+	NULL, /* wObjectPool* CallbackInstances */
 	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
+	NULL, /* TP_TIMER_WHEEL* TimerWheel */
 };
 
 static DWORD WINAPI thread_pool_work_func(LPVOID arg)
@@ -80,14 +81,13 @@ static DWORD WINAPI thread_pool_work_func(LPVOID arg)
 		if (status != (WAIT_OBJECT_0 + 1))
 			break;
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
-
-		if (callbackInstance)
+		/* Codecs submit bursts of small jobs, run everything queued before waiting again */
+		while ((callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue)))
 		{
 			work = callbackInstance->Work;
 			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			CountdownEvent_Signal(work->WorkComplete, 1);
+			ObjectPool_Return(pool->CallbackInstances, callbackInstance);
 		}
 	}
 
@@ -101,6 +101,12 @@ static void threads_close(void* thread)
 	CloseHandle(thread);
 }
 
+static void* callback_instance_new(const void* val)
+{
+	WINPR_UNUSED(val);
+	return calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+}
+
 static BOOL InitializeThreadpool(PTP_POOL pool)
 {
 	BOOL rc = FALSE;
@@ -117,9 +123,13 @@ static BOOL InitializeThreadpool(PTP_POOL pool)
 	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
 		goto fail;
 
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
+	if (!(pool->CallbackInstances = ObjectPool_New(TRUE)))
 		goto fail;
 
+	obj = ObjectPool_Object(pool->CallbackInstances);
+	obj->fnObjectNew = callback_instance_new;
+	obj->fnObjectFree = free;
+
 	if (!(pool->TerminateEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
 		goto fail;
 
@@ -193,11 +203,12 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 		return;
 	}
 #endif
+	FreeThreadpoolTimerWheel(ptpp->TimerWheel);
 	SetEvent(ptpp->TerminateEvent);
 
 	ArrayList_Free(ptpp->Threads);
 	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
+	ObjectPool_Free(ptpp->CallbackInstances);
 	CloseHandle(ptpp->TerminateEvent);
 
 	{
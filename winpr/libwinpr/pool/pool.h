@@ -26,6 +26,8 @@
 #include <winpr/thread.h>
 #include <winpr/collections.h>
 
+typedef struct S_TP_TIMER_WHEEL TP_TIMER_WHEEL;
+
 #if defined(_WIN32)
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN6) || defined(__MINGW32__)
 struct _TP_CALLBACK_INSTANCE
@@ -39,8 +41,9 @@ struct _TP_POOL
 	DWORD Maximum;
 	wArrayList* Threads;
 	wQueue* PendingQueue;
+	wObjectPool* CallbackInstances; /* recycled TP_CALLBACK_INSTANCE objects */
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	TP_TIMER_WHEEL* TimerWheel; /* created with the first timer of the pool */
 };
 
 struct _TP_WORK
@@ -48,11 +51,21 @@ struct _TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	wCountdownEvent* WorkComplete; /* callbacks of this work still pending */
 };
 
 struct _TP_TIMER
 {
-	void* dummy;
+	PVOID CallbackParameter;
+	PTP_TIMER_CALLBACK TimerCallback;
+	TP_CALLBACK_ENVIRON CallbackEnvironment;
+	TP_WORK Work; /* dispatches the callback to the pool workers */
+	TP_TIMER_WHEEL* Wheel;
+	UINT64 Expires; /* wheel tick of the next expiration */
+	DWORD Period;
+	PTP_TIMER* Slot; /* wheel slot the timer is linked into, NULL if not set */
+	PTP_TIMER Prev;
+	PTP_TIMER Next;
 };
 
 struct _TP_WAIT
@@ -83,8 +96,9 @@ struct S_TP_POOL
 	DWORD Maximum;
 	wArrayList* Threads;
 	wQueue* PendingQueue;
+	wObjectPool* CallbackInstances; /* recycled TP_CALLBACK_INSTANCE objects */
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	TP_TIMER_WHEEL* TimerWheel; /* created with the first timer of the pool */
 };
 
 struct S_TP_WORK
@@ -92,11 +106,21 @@ struct S_TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	wCountdownEvent* WorkComplete; /* callbacks of this work still pending */
 };
 
 struct S_TP_TIMER
 {
-	void* dummy;
+	PVOID CallbackParameter;
+	PTP_TIMER_CALLBACK TimerCallback;
+	TP_CALLBACK_ENVIRON CallbackEnvironment;
+	TP_WORK Work; /* dispatches the callback to the pool workers */
+	TP_TIMER_WHEEL* Wheel;
+	UINT64 Expires; /* wheel tick of the next expiration */
+	DWORD Period;
+	PTP_TIMER* Slot; /* wheel slot the timer is linked into, NULL if not set */
+	PTP_TIMER Prev;
+	PTP_TIMER Next;
 };
 
 struct S_TP_WAIT
@@ -118,5 +142,6 @@ struct S_TP_CLEANUP_GROUP
 #endif
 
 PTP_POOL GetDefaultThreadpool(void);
+void FreeThreadpoolTimerWheel(TP_TIMER_WHEEL* wheel);
 
 #endif /* WINPR_POOL_PRIVATE_H */
@@ -1,8 +1,190 @@
 
 #include <winpr/crt.h>
 #include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#define TEST_TIMER_COUNT 1000
+
+typedef struct
+{
+	LONG fired;
+	LONG expected;
+	HANDLE done;
+} TEST_TIMER_CONTEXT;
+
+static void CALLBACK test_TimerCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                        PTP_TIMER timer)
+{
+	TEST_TIMER_CONTEXT* ctx = (TEST_TIMER_CONTEXT*)context;
+
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(timer);
+
+	if (InterlockedIncrement(&ctx->fired) == ctx->expected)
+		SetEvent(ctx->done);
+}
+
+static void test_due_time(FILETIME* ft, LONGLONG ms)
+{
+	const ULONGLONG due = (ULONGLONG)(-ms * 10000);
+
+	ft->dwLowDateTime = (DWORD)(due & 0xFFFFFFFF);
+	ft->dwHighDateTime = (DWORD)(due >> 32);
+}
+
+static BOOL test_periodic(PTP_CALLBACK_ENVIRON env)
+{
+	BOOL rc = FALSE;
+	FILETIME due;
+	PTP_TIMER timer = NULL;
+	TEST_TIMER_CONTEXT ctx = { 0, 5, NULL };
+
+	if (!(ctx.done = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		return FALSE;
+
+	if (!(timer = CreateThreadpoolTimer(test_TimerCallback, &ctx, env)))
+		goto fail;
+
+	if (IsThreadpoolTimerSet(timer))
+		goto fail;
+
+	test_due_time(&due, 10);
+	SetThreadpoolTimer(timer, &due, 10, 0);
+
+	if (!IsThreadpoolTimerSet(timer))
+		goto fail;
+
+	if (WaitForSingleObject(ctx.done, 5000) != WAIT_OBJECT_0)
+	{
+		printf("periodic timer fired %" PRId32 " times\n", ctx.fired);
+		goto fail;
+	}
+
+	/* a NULL due time stops the timer */
+	SetThreadpoolTimer(timer, NULL, 0, 0);
+	if (IsThreadpoolTimerSet(timer))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (timer)
+		CloseThreadpoolTimer(timer);
+	CloseHandle(ctx.done);
+	return rc;
+}
+
+static BOOL test_many(PTP_CALLBACK_ENVIRON env)
+{
+	BOOL rc = FALSE;
+	size_t index;
+	FILETIME due;
+	PTP_TIMER* timers;
+	TEST_TIMER_CONTEXT ctx = { 0, TEST_TIMER_COUNT, NULL };
+
+	if (!(timers = (PTP_TIMER*)calloc(TEST_TIMER_COUNT, sizeof(PTP_TIMER))))
+		return FALSE;
+
+	if (!(ctx.done = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	/* one shot timers spread over several wheel levels, including due right away */
+	for (index = 0; index < TEST_TIMER_COUNT; index++)
+	{
+		if (!(timers[index] = CreateThreadpoolTimer(test_TimerCallback, &ctx, env)))
+			goto fail;
+
+		test_due_time(&due, (LONGLONG)((index * 7) % 300));
+		SetThreadpoolTimer(timers[index], &due, 0, 0);
+	}
+
+	if (WaitForSingleObject(ctx.done, 5000) != WAIT_OBJECT_0)
+	{
+		printf("%" PRId32 " of %d one shot timers fired\n", ctx.fired, TEST_TIMER_COUNT);
+		goto fail;
+	}
+
+	for (index = 0; index < TEST_TIMER_COUNT; index++)
+	{
+		WaitForThreadpoolTimerCallbacks(timers[index], FALSE);
+
+		if (IsThreadpoolTimerSet(timers[index]))
+			goto fail;
+	}
+
+	/* every timer fires exactly once */
+	Sleep(50);
+	if (ctx.fired != TEST_TIMER_COUNT)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	for (index = 0; index < TEST_TIMER_COUNT; index++)
+	{
+		if (timers[index])
+			CloseThreadpoolTimer(timers[index]);
+	}
+	free(timers);
+	if (ctx.done)
+		CloseHandle(ctx.done);
+	return rc;
+}
+
+static BOOL test_cancel(PTP_CALLBACK_ENVIRON env)
+{
+	BOOL rc = FALSE;
+	FILETIME due;
+	PTP_TIMER timer;
+	TEST_TIMER_CONTEXT ctx = { 0, 1, NULL };
+
+	if (!(ctx.done = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		return FALSE;
+
+	if (!(timer = CreateThreadpoolTimer(test_TimerCallback, &ctx, env)))
+		goto fail;
+
+	/* a timer far beyond the wheel range is held until it is cancelled */
+	test_due_time(&due, 7LL * 24LL * 3600LL * 1000LL);
+	SetThreadpoolTimer(timer, &due, 0, 0);
+	WaitForThreadpoolTimerCallbacks(timer, TRUE);
+
+	if (IsThreadpoolTimerSet(timer) || (ctx.fired != 0))
+		goto fail;
+
+	CloseThreadpoolTimer(timer);
+	rc = TRUE;
+fail:
+	CloseHandle(ctx.done);
+	return rc;
+}
 
 int TestPoolTimer(int argc, char* argv[])
 {
-	return 0;
+	int rc = -1;
+	PTP_POOL pool;
+	TP_CALLBACK_ENVIRON environment;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_periodic(NULL) || !test_cancel(NULL))
+		return -1;
+
+	if (!(pool = CreateThreadpool(NULL)))
+		return -1;
+
+	InitializeThreadpoolEnvironment(&environment);
+	SetThreadpoolCallbackPool(&environment, pool);
+
+	if (!test_periodic(&environment))
+		goto fail;
+
+	if (!test_many(&environment))
+		goto fail;
+
+	rc = 0;
+fail:
+	DestroyThreadpoolEnvironment(&environment);
+	CloseThreadpool(pool);
+	return rc;
 }
@@ -123,6 +123,56 @@ fail:
 	return rc;
 }
 
+static void CALLBACK test_BlockingCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                           PTP_WORK work)
+{
+	WaitForSingleObject((HANDLE)context, INFINITE);
+}
+
+static BOOL test3(void)
+{
+	BOOL rc = FALSE;
+	int index;
+	HANDLE event;
+	PTP_WORK blocked = NULL;
+	PTP_WORK work = NULL;
+	printf("Independent work completion\n");
+
+	if (!(event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		return FALSE;
+
+	blocked = CreateThreadpoolWork(test_BlockingCallback, event, NULL);
+	work = CreateThreadpoolWork(test_WorkCallback, "world", NULL);
+
+	if (!blocked || !work)
+	{
+		printf("CreateThreadpoolWork failure\n");
+		goto fail;
+	}
+
+	/* Waiting for one work must not wait for the callbacks of another one, this would
+	 * dead lock as the blocked callback is only released afterwards */
+	SubmitThreadpoolWork(blocked);
+
+	for (index = 0; index < 10; index++)
+		SubmitThreadpoolWork(work);
+
+	WaitForThreadpoolWorkCallbacks(work, FALSE);
+	SetEvent(event);
+	WaitForThreadpoolWorkCallbacks(blocked, FALSE);
+	rc = TRUE;
+fail:
+
+	if (work)
+		CloseThreadpoolWork(work);
+
+	if (blocked)
+		CloseThreadpoolWork(blocked);
+
+	CloseHandle(event);
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 
@@ -135,5 +185,8 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test3())
+		return -1;
+
 	return 0;
 }
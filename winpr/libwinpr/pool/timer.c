@@ -21,30 +21,546 @@
 
 #include <winpr/crt.h>
 #include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/library.h>
+#include <winpr/interlocked.h>
+
+#include "pool.h"
+#include "../log.h"
+#define TAG WINPR_TAG("pool")
 
 #ifdef WINPR_THREAD_POOL
 
+/**
+ * All timers of a pool live in a hierarchical timing wheel with a resolution of one
+ * millisecond. Level n holds the timers expiring within 64^(n+1) ticks, a slot of level
+ * n covers 64^n ticks and is moved to the lower levels once the wheel reaches it.
+ *
+ * A single thread per pool sleeps on a waitable timer (timerfd where available) armed
+ * for the next slot that needs attention and hands expired timers to the pool workers,
+ * so any number of timers costs one thread and one timer handle.
+ */
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_RANGE (1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))
+
+struct S_TP_TIMER_WHEEL
+{
+	CRITICAL_SECTION lock;
+	HANDLE thread;
+	HANDLE timer;
+	HANDLE stopEvent;
+	UINT64 start; /* GetTickCount64() of tick 0 */
+	UINT64 now;   /* tick the wheel was advanced to */
+	UINT64 armed; /* tick the waitable timer is armed for */
+	size_t count;
+	PTP_TIMER slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+#ifdef _WIN32
+static INIT_ONCE init_once_module = INIT_ONCE_STATIC_INIT;
+static PTP_TIMER(WINAPI* pCreateThreadpoolTimer)(PTP_TIMER_CALLBACK pfnti, PVOID pv,
+                                                 PTP_CALLBACK_ENVIRON pcbe);
+static VOID(WINAPI* pCloseThreadpoolTimer)(PTP_TIMER pti);
+static BOOL(WINAPI* pIsThreadpoolTimerSet)(PTP_TIMER pti);
+static VOID(WINAPI* pSetThreadpoolTimer)(PTP_TIMER pti, PFILETIME pftDueTime, DWORD msPeriod,
+                                         DWORD msWindowLength);
+static VOID(WINAPI* pWaitForThreadpoolTimerCallbacks)(PTP_TIMER pti,
+                                                      BOOL fCancelPendingCallbacks);
+
+static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	HMODULE kernel32 = LoadLibraryA("kernel32.dll");
+
+	if (kernel32)
+	{
+		pCreateThreadpoolTimer = (void*)GetProcAddress(kernel32, "CreateThreadpoolTimer");
+		pCloseThreadpoolTimer = (void*)GetProcAddress(kernel32, "CloseThreadpoolTimer");
+		pIsThreadpoolTimerSet = (void*)GetProcAddress(kernel32, "IsThreadpoolTimerSet");
+		pSetThreadpoolTimer = (void*)GetProcAddress(kernel32, "SetThreadpoolTimer");
+		pWaitForThreadpoolTimerCallbacks =
+		    (void*)GetProcAddress(kernel32, "WaitForThreadpoolTimerCallbacks");
+	}
+
+	return TRUE;
+}
+#endif
+
+static UINT64 timer_wheel_ticks(const TP_TIMER_WHEEL* wheel)
+{
+	return GetTickCount64() - wheel->start;
+}
+
+static void timer_wheel_insert(TP_TIMER_WHEEL* wheel, PTP_TIMER timer)
+{
+	size_t level;
+	UINT64 tick = (timer->Expires > wheel->now) ? timer->Expires : wheel->now + 1;
+	const UINT64 delta = tick - wheel->now;
+
+	if (delta >= TIMER_WHEEL_RANGE)
+		tick = wheel->now + TIMER_WHEEL_RANGE - 1;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++)
+	{
+		if (delta < (1ull << ((level + 1) * TIMER_WHEEL_BITS)))
+			break;
+	}
+
+	timer->Slot = &wheel->slots[level][(tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK];
+	timer->Prev = NULL;
+	timer->Next = *timer->Slot;
+
+	if (timer->Next)
+		timer->Next->Prev = timer;
+
+	*timer->Slot = timer;
+	wheel->count++;
+}
+
+static void timer_wheel_remove(TP_TIMER_WHEEL* wheel, PTP_TIMER timer)
+{
+	if (!timer->Slot)
+		return;
+
+	if (timer->Prev)
+		timer->Prev->Next = timer->Next;
+	else
+		*timer->Slot = timer->Next;
+
+	if (timer->Next)
+		timer->Next->Prev = timer->Prev;
+
+	timer->Slot = NULL;
+	timer->Prev = NULL;
+	timer->Next = NULL;
+	wheel->count--;
+}
+
+/* called with the lock held */
+static void timer_wheel_advance(TP_TIMER_WHEEL* wheel, UINT64 target)
+{
+	size_t level;
+	PTP_TIMER pending = NULL;
+
+	if (target <= wheel->now)
+		return;
+
+	if (wheel->count == 0)
+	{
+		wheel->now = target;
+		return;
+	}
+
+	/* detach every slot the wheel passes, a lap or more visits each slot once */
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		UINT64 block;
+		const size_t shift = level * TIMER_WHEEL_BITS;
+		UINT64 first = (wheel->now >> shift) + 1;
+		UINT64 last = target >> shift;
+
+		if (last < first)
+			break;
+
+		if (last - first >= TIMER_WHEEL_MASK)
+		{
+			first = 0;
+			last = TIMER_WHEEL_MASK;
+		}
+
+		for (block = first; block <= last; block++)
+		{
+			PTP_TIMER* slot = &wheel->slots[level][block & TIMER_WHEEL_MASK];
+
+			while (*slot)
+			{
+				PTP_TIMER timer = *slot;
+				timer_wheel_remove(wheel, timer);
+				timer->Next = pending;
+				pending = timer;
+			}
+		}
+	}
+
+	wheel->now = target;
+
+	while (pending)
+	{
+		PTP_TIMER timer = pending;
+		pending = timer->Next;
+		timer->Next = NULL;
+
+		if (timer->Expires > target)
+		{
+			timer_wheel_insert(wheel, timer);
+			continue;
+		}
+
+		if (timer->Period > 0)
+		{
+			/* missed periods are dropped instead of queuing a burst of callbacks */
+			timer->Expires += timer->Period;
+
+			if (timer->Expires <= target)
+				timer->Expires = target + timer->Period;
+
+			timer_wheel_insert(wheel, timer);
+		}
+
+		winpr_SubmitThreadpoolWork(&timer->Work);
+	}
+}
+
+/* called with the lock held, returns the first tick a slot needs to be visited */
+static UINT64 timer_wheel_deadline(const TP_TIMER_WHEEL* wheel)
+{
+	size_t level;
+	UINT64 deadline = UINT64_MAX;
+
+	if (wheel->count == 0)
+		return deadline;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		UINT64 block;
+		const size_t shift = level * TIMER_WHEEL_BITS;
+		const UINT64 base = wheel->now >> shift;
+
+		for (block = base + 1; block <= base + TIMER_WHEEL_SLOTS; block++)
+		{
+			if (wheel->slots[level][block & TIMER_WHEEL_MASK])
+			{
+				if ((block << shift) < deadline)
+					deadline = block << shift;
+				break;
+			}
+		}
+	}
+
+	return deadline;
+}
+
+/* called with the lock held */
+static void timer_wheel_arm(TP_TIMER_WHEEL* wheel)
+{
+	LARGE_INTEGER due;
+	UINT64 now;
+	const UINT64 deadline = timer_wheel_deadline(wheel);
+
+	/* an idle wheel keeps the old deadline, the spurious wakeup is harmless */
+	if ((deadline == UINT64_MAX) || (deadline == wheel->armed))
+		return;
+
+	now = timer_wheel_ticks(wheel);
+	due.QuadPart = -1;
+
+	if (deadline > now)
+		due.QuadPart = -(LONGLONG)((deadline - now) * 10000ull);
+
+	if (!SetWaitableTimer(wheel->timer, &due, 0, NULL, NULL, FALSE))
+	{
+		WLog_ERR(TAG, "failed to arm the timer wheel");
+		return;
+	}
+
+	wheel->armed = deadline;
+}
+
+static DWORD WINAPI timer_wheel_thread(LPVOID arg)
+{
+	TP_TIMER_WHEEL* wheel = (TP_TIMER_WHEEL*)arg;
+	HANDLE events[2];
+
+	events[0] = wheel->stopEvent;
+	events[1] = wheel->timer;
+
+	while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == (WAIT_OBJECT_0 + 1))
+	{
+		EnterCriticalSection(&wheel->lock);
+		wheel->armed = UINT64_MAX;
+		timer_wheel_advance(wheel, timer_wheel_ticks(wheel));
+		timer_wheel_arm(wheel);
+		LeaveCriticalSection(&wheel->lock);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+void FreeThreadpoolTimerWheel(TP_TIMER_WHEEL* wheel)
+{
+	if (!wheel)
+		return;
+
+	if (wheel->thread)
+	{
+		SetEvent(wheel->stopEvent);
+		WaitForSingleObject(wheel->thread, INFINITE);
+		CloseHandle(wheel->thread);
+	}
+
+	if (wheel->stopEvent)
+		CloseHandle(wheel->stopEvent);
+
+	if (wheel->timer)
+		CloseHandle(wheel->timer);
+
+	DeleteCriticalSection(&wheel->lock);
+	free(wheel);
+}
+
+static TP_TIMER_WHEEL* timer_wheel_new(void)
+{
+	TP_TIMER_WHEEL* wheel = (TP_TIMER_WHEEL*)calloc(1, sizeof(TP_TIMER_WHEEL));
+
+	if (!wheel)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&wheel->lock, 4000))
+	{
+		free(wheel);
+		return NULL;
+	}
+
+	wheel->start = GetTickCount64();
+	wheel->armed = UINT64_MAX;
+
+	if (!(wheel->timer = CreateWaitableTimerA(NULL, FALSE, NULL)))
+		goto fail;
+
+	if (!(wheel->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(wheel->thread = CreateThread(NULL, 0, timer_wheel_thread, (void*)wheel, 0, NULL)))
+		goto fail;
+
+	return wheel;
+fail:
+	FreeThreadpoolTimerWheel(wheel);
+	return NULL;
+}
+
+/* The wheel is created with the first timer, pools that never use timers get no thread */
+static TP_TIMER_WHEEL* timer_wheel_get(PTP_POOL pool)
+{
+	TP_TIMER_WHEEL* wheel;
+	TP_TIMER_WHEEL* current;
+
+	current = InterlockedCompareExchangePointer((PVOID volatile*)&pool->TimerWheel, NULL, NULL);
+	if (current)
+		return current;
+
+	if (!(wheel = timer_wheel_new()))
+		return NULL;
+
+	current = InterlockedCompareExchangePointer((PVOID volatile*)&pool->TimerWheel, wheel, NULL);
+	if (current)
+	{
+		FreeThreadpoolTimerWheel(wheel);
+		return current;
+	}
+
+	return wheel;
+}
+
+static VOID CALLBACK timer_work_callback(PTP_CALLBACK_INSTANCE instance, PVOID context,
+                                         PTP_WORK work)
+{
+	PTP_TIMER timer = (PTP_TIMER)context;
+
+	WINPR_UNUSED(work);
+	timer->TimerCallback(instance, timer->CallbackParameter, timer);
+}
+
 PTP_TIMER winpr_CreateThreadpoolTimer(PTP_TIMER_CALLBACK pfnti, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
 {
+	PTP_TIMER timer;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+
+	if (pCreateThreadpoolTimer)
+		return pCreateThreadpoolTimer(pfnti, pv, pcbe);
+
+#endif
+
+	if (!pfnti)
+		return NULL;
+
+	timer = (PTP_TIMER)calloc(1, sizeof(TP_TIMER));
+
+	if (!timer)
+		return NULL;
+
+	/* timers are not members of a cleanup group, they are closed explicitly */
+	timer->CallbackEnvironment.Version = 1;
+
+	if (pcbe)
+		timer->CallbackEnvironment.Pool = pcbe->Pool;
+
+	if (!timer->CallbackEnvironment.Pool)
+		timer->CallbackEnvironment.Pool = GetDefaultThreadpool();
+
+	if (!timer->CallbackEnvironment.Pool)
+		goto fail;
+
+	timer->TimerCallback = pfnti;
+	timer->CallbackParameter = pv;
+	timer->Work.WorkCallback = timer_work_callback;
+	timer->Work.CallbackParameter = timer;
+	timer->Work.CallbackEnvironment = &timer->CallbackEnvironment;
+
+	if (!(timer->Work.WorkComplete = CountdownEvent_New(0)))
+		goto fail;
+
+	if (!(timer->Wheel = timer_wheel_get(timer->CallbackEnvironment.Pool)))
+		goto fail;
+
+	return timer;
+fail:
+	CountdownEvent_Free(timer->Work.WorkComplete);
+	free(timer);
 	return NULL;
 }
 
 VOID winpr_CloseThreadpoolTimer(PTP_TIMER pti)
 {
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+
+	if (pCloseThreadpoolTimer)
+	{
+		pCloseThreadpoolTimer(pti);
+		return;
+	}
+
+#endif
+
+	if (!pti)
+		return;
+
+	/* Unlike the native API this waits for outstanding callbacks, do not call it from one */
+	winpr_WaitForThreadpoolTimerCallbacks(pti, TRUE);
+	CountdownEvent_Signal(pti->Work.WorkComplete, 0);
+	CountdownEvent_Free(pti->Work.WorkComplete);
+	free(pti);
 }
 
 BOOL winpr_IsThreadpoolTimerSet(PTP_TIMER pti)
 {
-	return FALSE;
+	BOOL set;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+
+	if (pIsThreadpoolTimerSet)
+		return pIsThreadpoolTimerSet(pti);
+
+#endif
+
+	if (!pti)
+		return FALSE;
+
+	EnterCriticalSection(&pti->Wheel->lock);
+	set = (pti->Slot != NULL);
+	LeaveCriticalSection(&pti->Wheel->lock);
+	return set;
 }
 
 VOID winpr_SetThreadpoolTimer(PTP_TIMER pti, PFILETIME pftDueTime, DWORD msPeriod,
                               DWORD msWindowLength)
 {
+	UINT64 delay = 0;
+	TP_TIMER_WHEEL* wheel;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+
+	if (pSetThreadpoolTimer)
+	{
+		pSetThreadpoolTimer(pti, pftDueTime, msPeriod, msWindowLength);
+		return;
+	}
+
+#endif
+	/* the wheel resolution is finer than any window callers ask for */
+	WINPR_UNUSED(msWindowLength);
+
+	if (!pti)
+		return;
+
+	if (pftDueTime)
+	{
+		const LONGLONG due =
+		    (LONGLONG)(((UINT64)pftDueTime->dwHighDateTime << 32) | pftDueTime->dwLowDateTime);
+
+		if (due < 0)
+		{
+			/* relative, in 100 nanosecond intervals */
+			delay = ((UINT64)(-due) + 9999ull) / 10000ull;
+		}
+		else if (due > 0)
+		{
+			/* absolute system time */
+			FILETIME ft = { 0 };
+			LONGLONG now;
+
+			GetSystemTimeAsFileTime(&ft);
+			now = (LONGLONG)(((UINT64)ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+
+			if (due > now)
+				delay = ((UINT64)(due - now) + 9999ull) / 10000ull;
+		}
+	}
+
+	wheel = pti->Wheel;
+	EnterCriticalSection(&wheel->lock);
+	timer_wheel_remove(wheel, pti);
+
+	if (pftDueTime)
+	{
+		const UINT64 now = timer_wheel_ticks(wheel);
+
+		/* keep the wheel current so the new timer is placed relative to the real time */
+		timer_wheel_advance(wheel, now);
+		pti->Period = msPeriod;
+		pti->Expires = now + delay;
+		timer_wheel_insert(wheel, pti);
+		timer_wheel_arm(wheel);
+	}
+
+	LeaveCriticalSection(&wheel->lock);
 }
 
 VOID winpr_WaitForThreadpoolTimerCallbacks(PTP_TIMER pti, BOOL fCancelPendingCallbacks)
 {
-}
+	HANDLE event;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+
+	if (pWaitForThreadpoolTimerCallbacks)
+	{
+		pWaitForThreadpoolTimerCallbacks(pti, fCancelPendingCallbacks);
+		return;
+	}
 
 #endif
+
+	if (!pti)
+		return;
+
+	/* callbacks already handed to the workers still run */
+	if (fCancelPendingCallbacks)
+	{
+		EnterCriticalSection(&pti->Wheel->lock);
+		timer_wheel_remove(pti->Wheel, pti);
+		LeaveCriticalSection(&pti->Wheel->lock);
+	}
+
+	event = CountdownEvent_WaitHandle(pti->Work.WorkComplete);
+
+	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
+		WLog_ERR(TAG, "error waiting on timer callbacks");
+}
+
+#endif /* WINPR_THREAD_POOL defined */
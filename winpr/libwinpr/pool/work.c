@@ -91,6 +91,13 @@ PTP_WORK winpr_CreateThreadpoolWork(PTP_WORK_CALLBACK pfnwk, PVOID pv, PTP_CALLB
 		work->CallbackEnvironment = pcbe;
 		work->WorkCallback = pfnwk;
 		work->CallbackParameter = pv;
+
+		if (!(work->WorkComplete = CountdownEvent_New(0)))
+		{
+			free(work);
+			return NULL;
+		}
+
 #ifndef _WIN32
 
 		if (pcbe->CleanupGroup)
@@ -119,6 +126,10 @@ VOID winpr_CloseThreadpoolWork(PTP_WORK pwk)
 		ArrayList_Remove(pwk->CallbackEnvironment->CleanupGroup->groups, pwk);
 
 #endif
+	/* A worker may still be inside CountdownEvent_Signal after the waiter woke up,
+	 * signalling nothing takes the countdown lock once and waits for it to leave. */
+	CountdownEvent_Signal(pwk->WorkComplete, 0);
+	CountdownEvent_Free(pwk->WorkComplete);
 	free(pwk);
 }
 
@@ -137,12 +148,12 @@ VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 
 #endif
 	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+	callbackInstance = (PTP_CALLBACK_INSTANCE)ObjectPool_Take(pool->CallbackInstances);
 
 	if (callbackInstance)
 	{
 		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
+		CountdownEvent_AddCount(pwk->WorkComplete, 1);
 		Queue_Enqueue(pool->PendingQueue, callbackInstance);
 	}
 }
@@ -164,7 +175,6 @@ BOOL winpr_TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfns, PVOID pv,
 VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallbacks)
 {
 	HANDLE event;
-	PTP_POOL pool;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -175,8 +185,8 @@ VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallb
 	}
 
 #endif
-	pool = pwk->CallbackEnvironment->Pool;
-	event = CountdownEvent_WaitHandle(pool->WorkComplete);
+	/* Only wait for the callbacks of this work, not for everything else in the pool */
+	event = CountdownEvent_WaitHandle(pwk->WorkComplete);
 
 	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
 		WLog_ERR(TAG, "error waiting on work completion");
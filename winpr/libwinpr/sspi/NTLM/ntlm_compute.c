@@ -284,6 +284,17 @@ static int ntlm_convert_password_hash(NTLM_CONTEXT* context, BYTE* hash)
 	return 1;
 }
 
+/**
+ * NTOWFv2 only depends on the user, domain and password of the credentials, keep it
+ * for the next context using the same credentials handle (reconnects, NLA retries).
+ */
+
+static void ntlm_cache_ntlm_v2_hash(SSPI_CREDENTIALS* credentials, const BYTE* hash)
+{
+	CopyMemory(credentials->NtlmV2Hash, hash, 16);
+	credentials->NtlmV2HashCached = TRUE;
+}
+
 static int ntlm_compute_ntlm_v2_hash(NTLM_CONTEXT* context, BYTE* hash)
 {
 	SSPI_CREDENTIALS* credentials = context->credentials;
@@ -321,22 +332,30 @@ static int ntlm_compute_ntlm_v2_hash(NTLM_CONTEXT* context, BYTE* hash)
 		                 credentials->identity.UserLength * 2, (LPWSTR)credentials->identity.Domain,
 		                 credentials->identity.DomainLength * 2, (BYTE*)hash);
 	}
+	else if (credentials->NtlmV2HashCached)
+	{
+		/* Derived from the password of the credentials by an earlier context */
+		CopyMemory(hash, credentials->NtlmV2Hash, 16);
+	}
 	else if (credentials->identity.PasswordLength > SSPI_CREDENTIALS_HASH_LENGTH_OFFSET)
 	{
 		/* Special case for WinPR: password hash */
 		if (ntlm_convert_password_hash(context, context->NtlmHash) < 0)
 			return -1;
 
-		NTOWFv2FromHashW(context->NtlmHash, (LPWSTR)credentials->identity.User,
-		                 credentials->identity.UserLength * 2, (LPWSTR)credentials->identity.Domain,
-		                 credentials->identity.DomainLength * 2, (BYTE*)hash);
+		if (NTOWFv2FromHashW(context->NtlmHash, (LPWSTR)credentials->identity.User,
+		                     credentials->identity.UserLength * 2,
+		                     (LPWSTR)credentials->identity.Domain,
+		                     credentials->identity.DomainLength * 2, (BYTE*)hash))
+			ntlm_cache_ntlm_v2_hash(credentials, hash);
 	}
 	else if (credentials->identity.Password)
 	{
-		NTOWFv2W((LPWSTR)credentials->identity.Password, credentials->identity.PasswordLength * 2,
-		         (LPWSTR)credentials->identity.User, credentials->identity.UserLength * 2,
-		         (LPWSTR)credentials->identity.Domain, credentials->identity.DomainLength * 2,
-		         (BYTE*)hash);
+		if (NTOWFv2W((LPWSTR)credentials->identity.Password,
+		             credentials->identity.PasswordLength * 2, (LPWSTR)credentials->identity.User,
+		             credentials->identity.UserLength * 2, (LPWSTR)credentials->identity.Domain,
+		             credentials->identity.DomainLength * 2, (BYTE*)hash))
+			ntlm_cache_ntlm_v2_hash(credentials, hash);
 	}
 	else if (context->HashCallback)
 	{
@@ -822,6 +822,13 @@ SECURITY_STATUS ntlm_read_AuthenticateMessage(NTLM_CONTEXT* context, PSecBuffer
 
 #endif
 
+	/* The identity is replaced by the one of the client, drop what was derived from it */
+	if ((message->UserName.Len > 0) || (message->DomainName.Len > 0))
+	{
+		memset(credentials->NtlmV2Hash, 0, sizeof(credentials->NtlmV2Hash));
+		credentials->NtlmV2HashCached = FALSE;
+	}
+
 	if (message->UserName.Len > 0)
 	{
 		credentials->identity.User = (UINT16*)malloc(message->UserName.Len);
@@ -36,6 +36,8 @@ typedef struct
 	void* pvGetKeyArgument;
 	SEC_WINNT_AUTH_IDENTITY identity;
 	SEC_WINPR_KERBEROS_SETTINGS* kerbSettings;
+	BYTE NtlmV2Hash[16]; /* NTOWFv2 of identity, valid if NtlmV2HashCached is set */
+	BOOL NtlmV2HashCached;
 } SSPI_CREDENTIALS;
 
 SSPI_CREDENTIALS* sspi_CredentialsNew(void);
@@ -222,6 +222,7 @@ void sspi_CredentialsFree(SSPI_CREDENTIALS* credentials)
 		memset(credentials->identity.Domain, 0, domainLength);
 	if (credentials->identity.Password)
 		memset(credentials->identity.Password, 0, passwordLength);
+	memset(credentials->NtlmV2Hash, 0, sizeof(credentials->NtlmV2Hash));
 	free(credentials->identity.User);
 	free(credentials->identity.Domain);
 	free(credentials->identity.Password);
@@ -3,6 +3,7 @@
 #include <winpr/sspi.h>
 #include <winpr/print.h>
 #include <winpr/wlog.h>
+#include <winpr/sysinfo.h>
 
 static BYTE TEST_NTLM_TIMESTAMP[8] = { 0x33, 0x57, 0xbd, 0xb1, 0x07, 0x8b, 0xcf, 0x01 };
 
@@ -465,6 +466,87 @@ static void test_ntlm_server_free(TEST_NTLM_SERVER* ntlm)
 	free(ntlm);
 }
 
+/* Full handshakes the server side completes in one thread, printed as handshakes per second */
+#define TEST_NTLM_BENCH_HANDSHAKES 200
+
+static BOOL test_ntlm_handshake(void)
+{
+	BOOL rc = FALSE;
+	PSecBuffer pSecBuffer;
+	TEST_NTLM_CLIENT* client = test_ntlm_client_new();
+	TEST_NTLM_SERVER* server = test_ntlm_server_new();
+
+	if (!client || !server)
+		goto fail;
+
+	if (test_ntlm_client_init(client, TEST_NTLM_USER, TEST_NTLM_DOMAIN, TEST_NTLM_PASSWORD) < 0)
+		goto fail;
+
+	if (test_ntlm_server_init(server) < 0)
+		goto fail;
+
+	/* Negotiate */
+	if (test_ntlm_client_authenticate(client) < 0)
+		goto fail;
+
+	pSecBuffer = &(client->outputBuffer[0]);
+	server->haveInputBuffer = TRUE;
+	server->inputBuffer[0].pvBuffer = pSecBuffer->pvBuffer;
+	server->inputBuffer[0].cbBuffer = pSecBuffer->cbBuffer;
+
+	/* Challenge */
+	if (test_ntlm_server_authenticate(server) < 0)
+		goto fail;
+
+	pSecBuffer = &(server->outputBuffer[0]);
+	client->haveInputBuffer = TRUE;
+	client->inputBuffer[0].pvBuffer = pSecBuffer->pvBuffer;
+	client->inputBuffer[0].cbBuffer = pSecBuffer->cbBuffer;
+
+	/* Authenticate, the client releases the challenge buffer of the server */
+	if (test_ntlm_client_authenticate(client) < 0)
+		goto fail;
+
+	server->outputBuffer[0].pvBuffer = NULL;
+	pSecBuffer = &(client->outputBuffer[0]);
+	server->inputBuffer[0].pvBuffer = pSecBuffer->pvBuffer;
+	server->inputBuffer[0].cbBuffer = pSecBuffer->cbBuffer;
+
+	if (test_ntlm_server_authenticate(server) < 0)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	test_ntlm_client_free(client);
+	test_ntlm_server_free(server);
+	return rc;
+}
+
+static BOOL test_ntlm_benchmark(void)
+{
+	size_t i;
+	UINT64 start, duration;
+
+	start = GetTickCount64();
+
+	for (i = 0; i < TEST_NTLM_BENCH_HANDSHAKES; i++)
+	{
+		if (!test_ntlm_handshake())
+		{
+			printf("handshake %" PRIuz " failed\n", i);
+			return FALSE;
+		}
+	}
+
+	duration = GetTickCount64() - start;
+
+	if (duration == 0)
+		duration = 1;
+
+	printf("NTLM: %.1f handshakes/s\n", TEST_NTLM_BENCH_HANDSHAKES * 1000.0 / (double)duration);
+	return TRUE;
+}
+
 int TestNTLM(int argc, char* argv[])
 {
 	int status;
@@ -682,6 +764,9 @@ int TestNTLM(int argc, char* argv[])
 		goto fail;
 	}
 
+	if (!test_ntlm_benchmark())
+		goto fail;
+
 	rc = 0;
 
 fail:
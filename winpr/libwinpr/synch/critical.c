@@ -122,6 +122,29 @@ DWORD SetCriticalSectionSpinCount(LPCRITICAL_SECTION lpCriticalSection, DWORD dw
 #endif
 }
 
+/* Spinning only pauses the pipeline, the CPU is given up once in a while */
+static INLINE VOID _RelaxCriticalSection(ULONG SpinCount)
+{
+	if ((SpinCount % 64) == 63)
+	{
+		if (sched_yield() != 0)
+		{
+			/**
+			 * On some operating systems sched_yield is a stub.
+			 * usleep should at least trigger a context switch if any thread is waiting.
+			 */
+			usleep(1);
+		}
+		return;
+	}
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__asm__ __volatile__("pause" ::: "memory");
+#elif defined(__GNUC__) && defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
 static VOID _WaitForCriticalSection(LPCRITICAL_SECTION lpCriticalSection)
 {
 #if defined(__APPLE__)
@@ -152,24 +175,17 @@ VOID EnterCriticalSection(LPCRITICAL_SECTION lpCriticalSection)
 	/* Spin requested times but don't compete with another waiting thread */
 	while (SpinCount-- && lpCriticalSection->LockCount < 1)
 	{
-		/* Atomically try to acquire and check the if the section is free. */
-		if (InterlockedCompareExchange(&lpCriticalSection->LockCount, 0, -1) == -1)
+		/* Only try to acquire with an atomic once the section looks free. */
+		if ((lpCriticalSection->LockCount == -1) &&
+		    (InterlockedCompareExchange(&lpCriticalSection->LockCount, 0, -1) == -1))
 		{
 			lpCriticalSection->RecursionCount = 1;
 			lpCriticalSection->OwningThread = (HANDLE)(ULONG_PTR)GetCurrentThreadId();
 			return;
 		}
 
-		/* Failed to get the lock. Let the scheduler know that we're spinning. */
-		if (sched_yield() != 0)
-		{
-			/**
-			 * On some operating systems sched_yield is a stub.
-			 * usleep should at least trigger a context switch if any thread is waiting.
-			 * A ThreadYield() would be nice in winpr ...
-			 */
-			usleep(1);
-		}
+		/* Failed to get the lock, the owner usually leaves within a few hundred cycles */
+		_RelaxCriticalSection(SpinCount);
 	}
 
 #endif
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 
 #include <winpr/synch.h>
+#include <winpr/interlocked.h>
 
 #ifndef _WIN32
 
@@ -216,6 +217,7 @@ static BOOL EventCloseHandle_(WINPR_EVENT* event)
 	}
 
 	winpr_event_uninit(&event->impl);
+	pthread_mutex_destroy(&event->lock);
 
 #if defined(WITH_DEBUG_EVENTS)
 	if (global_event_list)
@@ -286,6 +288,12 @@ HANDLE CreateEventA(LPSECURITY_ATTRIBUTES lpEventAttributes, BOOL bManualReset,
 	if (!event)
 		return NULL;
 
+	if (pthread_mutex_init(&event->lock, NULL) != 0)
+	{
+		free(event);
+		return NULL;
+	}
+
 	if (lpName)
 		event->name = strdup(lpName);
 
@@ -392,7 +400,25 @@ BOOL SetEvent(HANDLE hEvent)
 	{
 		event = (WINPR_EVENT*)Object;
 
-		status = winpr_event_set(&event->impl);
+		if (!winpr_event_state_known(event))
+			return winpr_event_set(&event->impl);
+
+		/* Setting a signaled event again needs no write */
+		if (event->signaled)
+			return TRUE;
+
+		pthread_mutex_lock(&event->lock);
+		status = TRUE;
+
+		if (!event->signaled)
+		{
+			status = winpr_event_set(&event->impl);
+
+			if (status)
+				InterlockedExchange(&event->signaled, TRUE);
+		}
+
+		pthread_mutex_unlock(&event->lock);
 	}
 
 	return status;
@@ -403,13 +429,32 @@ BOOL ResetEvent(HANDLE hEvent)
 	ULONG Type;
 	WINPR_HANDLE* Object;
 	WINPR_EVENT* event;
+	BOOL status = TRUE;
 
 	if (!winpr_Handle_GetInfo(hEvent, &Type, &Object))
 		return FALSE;
 
 	event = (WINPR_EVENT*)Object;
 
-	return winpr_event_reset(&event->impl);
+	if (!winpr_event_state_known(event))
+		return winpr_event_reset(&event->impl);
+
+	/* Nothing to drain when the event is not signaled */
+	if (!event->signaled)
+		return TRUE;
+
+	pthread_mutex_lock(&event->lock);
+
+	if (event->signaled)
+	{
+		status = winpr_event_reset(&event->impl);
+
+		if (status)
+			InterlockedExchange(&event->signaled, FALSE);
+	}
+
+	pthread_mutex_unlock(&event->lock);
+	return status;
 }
 
 #endif
@@ -422,6 +467,12 @@ HANDLE CreateFileDescriptorEventW(LPSECURITY_ATTRIBUTES lpEventAttributes, BOOL
 	HANDLE handle = NULL;
 	event = (WINPR_EVENT*)calloc(1, sizeof(WINPR_EVENT));
 
+	if (event && (pthread_mutex_init(&event->lock, NULL) != 0))
+	{
+		free(event);
+		event = NULL;
+	}
+
 	if (event)
 	{
 		event->impl.fds[0] = -1;
@@ -23,6 +23,10 @@
 
 #include <winpr/config.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 #ifdef HAVE_SYS_EVENTFD_H
 #include <sys/eventfd.h>
 #endif
@@ -41,6 +45,11 @@ struct winpr_event
 	WINPR_EVENT_IMPL impl;
 	BOOL bAttached;
 	BOOL bManualReset;
+#ifndef _WIN32
+	/* Mirrors the descriptor state of events we own, changed under lock */
+	volatile LONG signaled;
+	pthread_mutex_t lock;
+#endif
 	char* name;
 #if defined(WITH_DEBUG_EVENTS)
 	void* create_stack;
@@ -54,4 +63,7 @@ BOOL winpr_event_set(WINPR_EVENT_IMPL* event);
 BOOL winpr_event_reset(WINPR_EVENT_IMPL* event);
 void winpr_event_uninit(WINPR_EVENT_IMPL* event);
 
+/* The state of an event that owns its descriptor is known without a syscall */
+#define winpr_event_state_known(event) (!(event)->bAttached)
+
 #endif /* WINPR_LIBWINPR_SYNCH_EVENT_H_ */
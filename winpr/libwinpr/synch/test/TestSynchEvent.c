@@ -1,6 +1,72 @@
 
 #include <winpr/crt.h>
 #include <winpr/synch.h>
+#include <winpr/thread.h>
+
+static DWORD WINAPI test_event_waiter(LPVOID arg)
+{
+	HANDLE event = (HANDLE)arg;
+	return WaitForSingleObject(event, INFINITE);
+}
+
+/* Signaled events are found without poll, blocked waiters still need the descriptor */
+static BOOL test_event_fast_paths(void)
+{
+	BOOL rc = FALSE;
+	DWORD status = 0;
+	HANDLE thread = NULL;
+	HANDLE events[2] = { 0 };
+
+	events[0] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	events[1] = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!events[0] || !events[1])
+		goto fail;
+
+	if (WaitForMultipleObjects(2, events, FALSE, 0) != WAIT_TIMEOUT)
+		goto fail;
+
+	if (!SetEvent(events[1]) || !SetEvent(events[1]))
+		goto fail;
+
+	if (WaitForMultipleObjects(2, events, FALSE, 0) != WAIT_OBJECT_0 + 1)
+		goto fail;
+
+	if (WaitForMultipleObjects(2, events, FALSE, 10) != WAIT_OBJECT_0 + 1)
+		goto fail;
+
+	if (!ResetEvent(events[1]) || !ResetEvent(events[1]))
+		goto fail;
+
+	if (WaitForMultipleObjects(2, events, FALSE, 10) != WAIT_TIMEOUT)
+		goto fail;
+
+	thread = CreateThread(NULL, 0, test_event_waiter, events[0], 0, NULL);
+
+	if (!thread)
+		goto fail;
+
+	Sleep(50);
+
+	if (!SetEvent(events[0]))
+		goto fail;
+
+	if (WaitForSingleObject(thread, 5000) != WAIT_OBJECT_0)
+		goto fail;
+
+	if (!GetExitCodeThread(thread, &status) || (status != WAIT_OBJECT_0))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (thread)
+		CloseHandle(thread);
+	if (events[0])
+		CloseHandle(events[0]);
+	if (events[1])
+		CloseHandle(events[1]);
+	return rc;
+}
 
 int TestSynchEvent(int argc, char* argv[])
 {
@@ -91,5 +157,11 @@ int TestSynchEvent(int argc, char* argv[])
 
 	CloseHandle(event);
 
+	if (!test_event_fast_paths())
+	{
+		printf("event fast path failure\n");
+		return -1;
+	}
+
 	return 0;
 }
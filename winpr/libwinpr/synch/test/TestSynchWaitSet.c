@@ -0,0 +1,155 @@
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+int TestSynchWaitSet(int argc, char* argv[])
+{
+	int rc = -1;
+	size_t x;
+	DWORD status;
+	HANDLE events[3] = { 0 };
+	HANDLE events_dup[2];
+	WINPR_WAIT_SET* set;
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	set = winpr_WaitSetNew();
+	if (!set)
+	{
+		printf("winpr_WaitSetNew failure\n");
+		return -1;
+	}
+
+	if (winpr_WaitSetWait(set, 0) != WAIT_FAILED)
+	{
+		printf("winpr_WaitSetWait on an empty set unexpectedly succeeded\n");
+		goto fail;
+	}
+
+	events[0] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	events[1] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	events[2] = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!events[0] || !events[1] || !events[2])
+	{
+		printf("CreateEvent failure\n");
+		goto fail;
+	}
+
+	if (!winpr_WaitSetUpdate(set, ARRAYSIZE(events), events))
+	{
+		printf("winpr_WaitSetUpdate failure\n");
+		goto fail;
+	}
+
+	if (winpr_WaitSetWait(set, 10) != WAIT_TIMEOUT)
+	{
+		printf("winpr_WaitSetWait failure 1\n");
+		goto fail;
+	}
+
+	/* the lowest signaled index wins, like WaitForMultipleObjects */
+	SetEvent(events[2]);
+	SetEvent(events[1]);
+
+	status = winpr_WaitSetWait(set, INFINITE);
+	if (status != WAIT_OBJECT_0 + 1)
+	{
+		printf("winpr_WaitSetWait failure 2 (0x%08" PRIx32 ")\n", status);
+		goto fail;
+	}
+
+	{
+		DWORD indices[3] = { 0 };
+		DWORD signaled = 0;
+
+		/* all signaled handles in ascending order, or just the first one without a kernel
+		 * queue backend */
+		status = winpr_WaitSetWaitEx(set, INFINITE, indices, ARRAYSIZE(indices), &signaled);
+		if ((status != WAIT_OBJECT_0) || (signaled < 1) || (signaled > 2) ||
+		    (indices[0] != 1) || ((signaled == 2) && (indices[1] != 2)))
+		{
+			printf("winpr_WaitSetWaitEx failure (0x%08" PRIx32 ", %" PRIu32 ")\n", status,
+			       signaled);
+			goto fail;
+		}
+	}
+
+	ResetEvent(events[1]);
+
+	status = winpr_WaitSetWait(set, INFINITE);
+	if (status != WAIT_OBJECT_0 + 2)
+	{
+		printf("winpr_WaitSetWait failure 3 (0x%08" PRIx32 ")\n", status);
+		goto fail;
+	}
+
+	ResetEvent(events[2]);
+
+	if (winpr_WaitSetWait(set, 0) != WAIT_TIMEOUT)
+	{
+		printf("winpr_WaitSetWait failure 4\n");
+		goto fail;
+	}
+
+	/* removing shifts the indices of the handles behind it */
+	if (!winpr_WaitSetRemove(set, events[0]) || winpr_WaitSetRemove(set, events[0]))
+	{
+		printf("winpr_WaitSetRemove failure\n");
+		goto fail;
+	}
+
+	SetEvent(events[0]);
+	SetEvent(events[1]);
+
+	status = winpr_WaitSetWait(set, INFINITE);
+	if (status != WAIT_OBJECT_0)
+	{
+		printf("winpr_WaitSetWait failure 5 (0x%08" PRIx32 ")\n", status);
+		goto fail;
+	}
+
+	if (!winpr_WaitSetUpdate(set, 1, &events[0]))
+	{
+		printf("winpr_WaitSetUpdate failure 2\n");
+		goto fail;
+	}
+
+	status = winpr_WaitSetWait(set, 0);
+	if (status != WAIT_OBJECT_0)
+	{
+		printf("winpr_WaitSetWait failure 6 (0x%08" PRIx32 ")\n", status);
+		goto fail;
+	}
+
+	/* handles sharing a file descriptor */
+	events_dup[0] = events[2];
+	events_dup[1] = events[2];
+	if (!winpr_WaitSetUpdate(set, ARRAYSIZE(events_dup), events_dup) ||
+	    !winpr_WaitSetRemove(set, events[2]))
+	{
+		printf("winpr_WaitSetUpdate failure 3\n");
+		goto fail;
+	}
+
+	SetEvent(events[2]);
+
+	status = winpr_WaitSetWait(set, 100);
+	if (status != WAIT_OBJECT_0)
+	{
+		printf("winpr_WaitSetWait failure 7 (0x%08" PRIx32 ")\n", status);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	winpr_WaitSetFree(set);
+
+	for (x = 0; x < ARRAYSIZE(events); x++)
+	{
+		if (events[x])
+			CloseHandle(events[x]);
+	}
+
+	return rc;
+}
@@ -190,6 +190,21 @@ DWORD WaitForSingleObjectEx(HANDLE hHandle, DWORD dwMilliseconds, BOOL bAlertabl
 		return WAIT_FAILED;
 	}
 
+	if ((Type == HANDLE_TYPE_EVENT) && !bAlertable)
+	{
+		const WINPR_EVENT* event = (const WINPR_EVENT*)Object;
+
+		/* Only go through poll when we really have to block */
+		if (winpr_event_state_known(event))
+		{
+			if (event->signaled)
+				return WAIT_OBJECT_0;
+
+			if (dwMilliseconds == 0)
+				return WAIT_TIMEOUT;
+		}
+	}
+
 	if (Type == HANDLE_TYPE_PROCESS)
 	{
 		WINPR_PROCESS* process = (WINPR_PROCESS*)Object;
@@ -339,6 +354,30 @@ DWORD WaitForMultipleObjectsEx(DWORD nCount, const HANDLE* lpHandles, BOOL bWait
 		return WAIT_FAILED;
 	}
 
+	/* Owned events in front of all other handles are checked without building a pollset */
+	if (!bWaitAll && !bAlertable)
+	{
+		for (index = 0; index < nCount; index++)
+		{
+			const WINPR_EVENT* event;
+
+			if (!winpr_Handle_GetInfo(lpHandles[index], &Type, &Object) ||
+			    (Type != HANDLE_TYPE_EVENT))
+				break;
+
+			event = (const WINPR_EVENT*)Object;
+
+			if (!winpr_event_state_known(event))
+				break;
+
+			if (event->signaled)
+				return WAIT_OBJECT_0 + index;
+		}
+
+		if ((index == nCount) && (dwMilliseconds == 0))
+			return WAIT_TIMEOUT;
+	}
+
 	if (bAlertable)
 	{
 		thread = winpr_GetCurrentThread();
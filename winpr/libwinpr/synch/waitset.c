@@ -0,0 +1,551 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Persistent wait sets
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("sync.waitset")
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+
+#include "../handle/handle.h"
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(__linux__)
+#define WAIT_SET_EPOLL
+#include <sys/epoll.h>
+#elif defined(HAVE_SYS_EVENT_H)
+#define WAIT_SET_KQUEUE
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+#endif
+
+#if defined(WAIT_SET_EPOLL) || defined(WAIT_SET_KQUEUE)
+#define WAIT_SET_KERNEL_QUEUE
+#endif
+
+typedef struct
+{
+	int fd;
+	ULONG mode;
+	BOOL signaled;
+} WAIT_SET_ENTRY;
+
+struct winpr_wait_set
+{
+	HANDLE* handles;
+	DWORD count;
+	DWORD capacity;
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	WAIT_SET_ENTRY* entries;
+	int queue;
+#endif
+#if defined(WAIT_SET_EPOLL)
+	struct epoll_event events[MAXIMUM_WAIT_OBJECTS];
+#elif defined(WAIT_SET_KQUEUE)
+	struct kevent events[2 * MAXIMUM_WAIT_OBJECTS];
+#endif
+};
+
+/* Only the kernel queues lift the WaitForMultipleObjects limit */
+#if defined(WAIT_SET_KERNEL_QUEUE)
+#define WAIT_SET_MAX_HANDLES (64 * MAXIMUM_WAIT_OBJECTS)
+#else
+#define WAIT_SET_MAX_HANDLES MAXIMUM_WAIT_OBJECTS
+#endif
+
+static BOOL wait_set_ensure_capacity(WINPR_WAIT_SET* set, DWORD count)
+{
+	DWORD capacity = set->capacity;
+	HANDLE* handles;
+
+	if (count <= set->capacity)
+		return TRUE;
+
+	if (count > WAIT_SET_MAX_HANDLES)
+	{
+		WLog_ERR(TAG, "wait set is full (%" PRIu32 " handles)", (UINT32)WAIT_SET_MAX_HANDLES);
+		return FALSE;
+	}
+
+	if (capacity < 16)
+		capacity = 16;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	if (capacity > WAIT_SET_MAX_HANDLES)
+		capacity = WAIT_SET_MAX_HANDLES;
+
+	handles = realloc(set->handles, capacity * sizeof(HANDLE));
+	if (!handles)
+		return FALSE;
+	set->handles = handles;
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	{
+		WAIT_SET_ENTRY* entries = realloc(set->entries, capacity * sizeof(WAIT_SET_ENTRY));
+		if (!entries)
+			return FALSE;
+		set->entries = entries;
+	}
+#endif
+
+	set->capacity = capacity;
+	return TRUE;
+}
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+/* Several handles may share a file descriptor, the kernel sees the union of their modes */
+static ULONG wait_set_fd_mode(const WINPR_WAIT_SET* set, int fd)
+{
+	DWORD index;
+	ULONG mode = 0;
+
+	if (fd < 0)
+		return 0;
+
+	for (index = 0; index < set->count; index++)
+	{
+		if (set->entries[index].fd == fd)
+			mode |= set->entries[index].mode;
+	}
+
+	return mode;
+}
+
+static BOOL wait_set_register_fd(WINPR_WAIT_SET* set, int fd, ULONG oldMode, ULONG newMode)
+{
+#if defined(WAIT_SET_EPOLL)
+	int op;
+	struct epoll_event event = { 0 };
+
+	oldMode &= WINPR_FD_READ | WINPR_FD_WRITE;
+	newMode &= WINPR_FD_READ | WINPR_FD_WRITE;
+
+	if ((fd < 0) || (oldMode == newMode))
+		return TRUE;
+
+	if (newMode & WINPR_FD_READ)
+		event.events |= EPOLLIN;
+
+	if (newMode & WINPR_FD_WRITE)
+		event.events |= EPOLLOUT;
+
+	event.data.fd = fd;
+
+	if (!newMode)
+	{
+		/* the descriptor might already be closed, which removed it from the set */
+		epoll_ctl(set->queue, EPOLL_CTL_DEL, fd, &event);
+		return TRUE;
+	}
+
+	op = oldMode ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+	if (epoll_ctl(set->queue, op, fd, &event) == 0)
+		return TRUE;
+
+	/* a closed and reused descriptor number leaves the bookkeeping out of date */
+	if ((op == EPOLL_CTL_ADD) && (errno == EEXIST))
+		op = EPOLL_CTL_MOD;
+	else if ((op == EPOLL_CTL_MOD) && (errno == ENOENT))
+		op = EPOLL_CTL_ADD;
+	else
+		op = -1;
+
+	if ((op != -1) && (epoll_ctl(set->queue, op, fd, &event) == 0))
+		return TRUE;
+#elif defined(WAIT_SET_KQUEUE)
+	int nchanges = 0;
+	struct kevent changes[2];
+
+	if ((oldMode & WINPR_FD_READ) != (newMode & WINPR_FD_READ))
+	{
+		EV_SET(&changes[nchanges++], fd, EVFILT_READ,
+		       (newMode & WINPR_FD_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+
+	if ((oldMode & WINPR_FD_WRITE) != (newMode & WINPR_FD_WRITE))
+	{
+		EV_SET(&changes[nchanges++], fd, EVFILT_WRITE,
+		       (newMode & WINPR_FD_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+
+	if ((fd < 0) || (nchanges == 0))
+		return TRUE;
+
+	if (kevent(set->queue, changes, nchanges, NULL, 0, NULL) == 0)
+		return TRUE;
+
+	/* the descriptor might already be closed, which removed it from the set */
+	if (!(newMode & (WINPR_FD_READ | WINPR_FD_WRITE)))
+		return TRUE;
+#endif
+	WLog_ERR(TAG, "unable to register fd %d [%d] %s", fd, errno, strerror(errno));
+	return FALSE;
+}
+
+static BOOL wait_set_entry_set(WINPR_WAIT_SET* set, DWORD index, int fd, ULONG mode)
+{
+	BOOL rc = TRUE;
+	WAIT_SET_ENTRY* entry = &set->entries[index];
+	const int oldFd = entry->fd;
+	const ULONG oldFdMode = wait_set_fd_mode(set, oldFd);
+	const ULONG fdMode = (fd == oldFd) ? oldFdMode : wait_set_fd_mode(set, fd);
+
+	entry->fd = fd;
+	entry->mode = mode;
+
+	if (oldFd != fd)
+		rc = wait_set_register_fd(set, oldFd, oldFdMode, wait_set_fd_mode(set, oldFd));
+
+	if (!wait_set_register_fd(set, fd, fdMode, wait_set_fd_mode(set, fd)))
+	{
+		entry->fd = -1;
+		entry->mode = 0;
+		return FALSE;
+	}
+
+	return rc;
+}
+
+/* Handles may change their descriptor, e.g. with SetEventFileDescriptor, so check them */
+static BOOL wait_set_refresh(WINPR_WAIT_SET* set)
+{
+	DWORD index;
+
+	for (index = 0; index < set->count; index++)
+	{
+		ULONG Type;
+		WINPR_HANDLE* Object;
+		int fd;
+
+		if (!winpr_Handle_GetInfo(set->handles[index], &Type, &Object))
+		{
+			WLog_ERR(TAG, "invalid handle at %" PRIu32, index);
+			SetLastError(ERROR_INVALID_HANDLE);
+			return FALSE;
+		}
+
+		fd = winpr_Handle_getFd(Object);
+		if (fd == -1)
+		{
+			WLog_ERR(TAG, "invalid file descriptor at %" PRIu32, index);
+			SetLastError(ERROR_INVALID_HANDLE);
+			return FALSE;
+		}
+
+		if ((set->entries[index].fd != fd) || (set->entries[index].mode != Object->Mode))
+		{
+			if (!wait_set_entry_set(set, index, fd, Object->Mode))
+			{
+				SetLastError(ERROR_INTERNAL_ERROR);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static int wait_set_poll(WINPR_WAIT_SET* set, DWORD dwMilliseconds)
+{
+#if defined(WAIT_SET_EPOLL)
+	const int timeout = (dwMilliseconds == INFINITE) ? -1 : (int)dwMilliseconds;
+
+	return epoll_wait(set->queue, set->events, ARRAYSIZE(set->events), timeout);
+#else
+	struct timespec ts;
+	struct timespec* timeout = NULL;
+
+	if (dwMilliseconds != INFINITE)
+	{
+		ts.tv_sec = dwMilliseconds / 1000;
+		ts.tv_nsec = (dwMilliseconds % 1000) * 1000000L;
+		timeout = &ts;
+	}
+
+	return kevent(set->queue, NULL, 0, set->events, ARRAYSIZE(set->events), timeout);
+#endif
+}
+
+/* Flags all handles that are ready in the polled events */
+static void wait_set_mark_signaled(WINPR_WAIT_SET* set, int nevents)
+{
+	int x;
+	DWORD index;
+
+	for (x = 0; x < nevents; x++)
+	{
+		int fd;
+		ULONG mode = 0;
+#if defined(WAIT_SET_EPOLL)
+		const struct epoll_event* event = &set->events[x];
+
+		fd = event->data.fd;
+
+		/* errors and hangups are reported to readers, which will then see them */
+		if (event->events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			mode |= WINPR_FD_READ;
+
+		if (event->events & EPOLLOUT)
+			mode |= WINPR_FD_WRITE;
+#else
+		const struct kevent* event = &set->events[x];
+
+		fd = (int)event->ident;
+
+		if (event->filter == EVFILT_READ)
+			mode |= WINPR_FD_READ;
+		else if (event->filter == EVFILT_WRITE)
+			mode |= WINPR_FD_WRITE;
+#endif
+
+		for (index = 0; index < set->count; index++)
+		{
+			WAIT_SET_ENTRY* entry = &set->entries[index];
+
+			if ((entry->fd == fd) && (entry->mode & mode))
+				entry->signaled = TRUE;
+		}
+	}
+}
+#endif
+
+WINPR_WAIT_SET* winpr_WaitSetNew(void)
+{
+	WINPR_WAIT_SET* set = calloc(1, sizeof(WINPR_WAIT_SET));
+
+	if (!set)
+		return NULL;
+
+#if defined(WAIT_SET_EPOLL)
+	set->queue = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(WAIT_SET_KQUEUE)
+	set->queue = kqueue();
+#endif
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	if (set->queue < 0)
+	{
+		WLog_ERR(TAG, "unable to create kernel event queue [%d] %s", errno, strerror(errno));
+		free(set);
+		return NULL;
+	}
+#endif
+
+	return set;
+}
+
+void winpr_WaitSetFree(WINPR_WAIT_SET* set)
+{
+	if (!set)
+		return;
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	close(set->queue);
+	free(set->entries);
+#endif
+	free(set->handles);
+	free(set);
+}
+
+BOOL winpr_WaitSetAdd(WINPR_WAIT_SET* set, HANDLE hHandle)
+{
+	if (!set || !hHandle || (hHandle == INVALID_HANDLE_VALUE))
+		return FALSE;
+
+	if (!wait_set_ensure_capacity(set, set->count + 1))
+		return FALSE;
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	/* registered with the kernel on the next wait */
+	set->entries[set->count].fd = -1;
+	set->entries[set->count].mode = 0;
+	set->entries[set->count].signaled = FALSE;
+#endif
+	set->handles[set->count++] = hHandle;
+	return TRUE;
+}
+
+BOOL winpr_WaitSetRemove(WINPR_WAIT_SET* set, HANDLE hHandle)
+{
+	DWORD index;
+
+	if (!set)
+		return FALSE;
+
+	for (index = 0; index < set->count; index++)
+	{
+		if (set->handles[index] == hHandle)
+			break;
+	}
+
+	if (index == set->count)
+		return FALSE;
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	wait_set_entry_set(set, index, -1, 0);
+	MoveMemory(&set->entries[index], &set->entries[index + 1],
+	           (set->count - index - 1) * sizeof(WAIT_SET_ENTRY));
+#endif
+	MoveMemory(&set->handles[index], &set->handles[index + 1],
+	           (set->count - index - 1) * sizeof(HANDLE));
+	set->count--;
+	return TRUE;
+}
+
+BOOL winpr_WaitSetUpdate(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles)
+{
+	DWORD index;
+
+	if (!set || (nCount && !lpHandles))
+		return FALSE;
+
+	if ((nCount == set->count) &&
+	    (memcmp(set->handles, lpHandles, nCount * sizeof(HANDLE)) == 0))
+		return TRUE;
+
+	while (set->count > 0)
+	{
+		if (!winpr_WaitSetRemove(set, set->handles[set->count - 1]))
+			return FALSE;
+	}
+
+	for (index = 0; index < nCount; index++)
+	{
+		if (!winpr_WaitSetAdd(set, lpHandles[index]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+DWORD winpr_WaitSetCount(WINPR_WAIT_SET* set)
+{
+	if (!set)
+		return 0;
+
+	return set->count;
+}
+
+DWORD winpr_WaitSetWaitEx(WINPR_WAIT_SET* set, DWORD dwMilliseconds, DWORD* lpIndices,
+                          DWORD nCount, DWORD* lpSignaled)
+{
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	UINT64 now, dueTime;
+#endif
+
+	if (!set || !set->count || !lpIndices || !nCount || !lpSignaled)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return WAIT_FAILED;
+	}
+
+	*lpSignaled = 0;
+
+#if defined(WAIT_SET_KERNEL_QUEUE)
+	if (!wait_set_refresh(set))
+		return WAIT_FAILED;
+
+	now = GetTickCount64();
+	if (dwMilliseconds == INFINITE)
+		dueTime = 0xFFFFFFFFFFFFFFFF;
+	else
+		dueTime = now + dwMilliseconds;
+
+	do
+	{
+		const DWORD waitTime = (dwMilliseconds == INFINITE) ? INFINITE : (DWORD)(dueTime - now);
+		const int status = wait_set_poll(set, waitTime);
+
+		if (status < 0)
+		{
+			if (errno != EINTR)
+			{
+				WLog_ERR(TAG, "wait failure [%d] %s", errno, strerror(errno));
+				SetLastError(ERROR_INTERNAL_ERROR);
+				return WAIT_FAILED;
+			}
+		}
+		else if (status == 0)
+			return WAIT_TIMEOUT;
+		else
+		{
+			DWORD index;
+			DWORD rc = WAIT_OBJECT_0;
+
+			wait_set_mark_signaled(set, status);
+
+			for (index = 0; index < set->count; index++)
+			{
+				if (!set->entries[index].signaled)
+					continue;
+
+				set->entries[index].signaled = FALSE;
+
+				if ((rc != WAIT_OBJECT_0) || (*lpSignaled >= nCount))
+					continue;
+
+				rc = winpr_Handle_cleanup(set->handles[index]);
+				if (rc == WAIT_OBJECT_0)
+					lpIndices[(*lpSignaled)++] = index;
+			}
+
+			if (rc != WAIT_OBJECT_0)
+				return rc;
+
+			if (*lpSignaled > 0)
+				return WAIT_OBJECT_0;
+		}
+
+		now = GetTickCount64();
+	} while (now < dueTime);
+
+	return WAIT_TIMEOUT;
+#else
+	{
+		const DWORD status =
+		    WaitForMultipleObjects(set->count, set->handles, FALSE, dwMilliseconds);
+
+		if (status >= WAIT_OBJECT_0 + set->count)
+			return status;
+
+		lpIndices[(*lpSignaled)++] = status - WAIT_OBJECT_0;
+		return WAIT_OBJECT_0;
+	}
+#endif
+}
+
+DWORD winpr_WaitSetWait(WINPR_WAIT_SET* set, DWORD dwMilliseconds)
+{
+	DWORD index = 0;
+	DWORD signaled = 0;
+	const DWORD status = winpr_WaitSetWaitEx(set, dwMilliseconds, &index, 1, &signaled);
+
+	if (status != WAIT_OBJECT_0)
+		return status;
+
+	return WAIT_OBJECT_0 + index;
+}
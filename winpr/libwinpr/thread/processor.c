@@ -16,21 +16,98 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-
 #include <winpr/config.h>
 
 #include <winpr/handle.h>
 
+#include <winpr/crt.h>
+#include <winpr/error.h>
 #include <winpr/thread.h>
 
+#include <stdio.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 /**
  * GetCurrentProcessorNumber
  * GetCurrentProcessorNumberEx
  * GetThreadIdealProcessorEx
  * SetThreadIdealProcessorEx
  * IsProcessorFeaturePresent
+ * GetNumaHighestNodeNumber
+ * GetNumaNodeProcessorMask
  */
 
+/* Parses a cpu list as used by sysfs and taskset, e.g. "0-3,8,10-11" */
+static BOOL parse_cpu_list(const char* str, ULONGLONG* mask)
+{
+	ULONGLONG result = 0;
+	const char* cur = str;
+
+	if (!str || !mask)
+		return FALSE;
+
+	while (*cur && (*cur != '\n'))
+	{
+		char* end = NULL;
+		unsigned long first, last, x;
+
+		first = strtoul(cur, &end, 10);
+		if (end == cur)
+			return FALSE;
+
+		last = first;
+		cur = end;
+
+		if (*cur == '-')
+		{
+			cur++;
+			last = strtoul(cur, &end, 10);
+			if ((end == cur) || (last < first))
+				return FALSE;
+			cur = end;
+		}
+
+		if (last >= 64)
+			return FALSE;
+
+		for (x = first; x <= last; x++)
+			result |= (1ULL << x);
+
+		if (*cur == ',')
+			cur++;
+		else if (*cur && (*cur != '\n'))
+			return FALSE;
+	}
+
+	if (result == 0)
+		return FALSE;
+
+	*mask = result;
+	return TRUE;
+}
+
+BOOL winpr_ParseProcessorMask(const char* str, ULONGLONG* mask)
+{
+	if (!str || !mask)
+		return FALSE;
+
+	if (strncmp(str, "node:", 5) == 0)
+	{
+		char* end = NULL;
+		const unsigned long node = strtoul(&str[5], &end, 10);
+
+		if ((end == &str[5]) || (*end != '\0') || (node > UINT8_MAX))
+			return FALSE;
+
+		return GetNumaNodeProcessorMask((UCHAR)node, mask) && (*mask != 0);
+	}
+
+	return parse_cpu_list(str, mask);
+}
+
 #ifndef _WIN32
 
 DWORD GetCurrentProcessorNumber(VOID)
@@ -38,4 +115,84 @@ DWORD GetCurrentProcessorNumber(VOID)
 	return 0;
 }
 
+static BOOL read_sysfs_line(const char* path, char* buffer, size_t size)
+{
+	BOOL rc;
+	FILE* fp = fopen(path, "r");
+
+	if (!fp)
+		return FALSE;
+
+	rc = fgets(buffer, (int)size, fp) != NULL;
+	fclose(fp);
+	return rc;
+}
+
+BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber)
+{
+	char buffer[256];
+	const char* last;
+
+	if (!HighestNodeNumber)
+		return FALSE;
+
+	*HighestNodeNumber = 0;
+
+	/* "0" or "0-1", the highest possible node is the last number in the list */
+	if (!read_sysfs_line("/sys/devices/system/node/possible", buffer, sizeof(buffer)))
+		return TRUE;
+
+	last = strrchr(buffer, '-');
+	if (!last)
+		last = strrchr(buffer, ',');
+
+	if (last)
+		*HighestNodeNumber = strtoul(&last[1], NULL, 10);
+
+	return TRUE;
+}
+
+BOOL GetNumaNodeProcessorMask(UCHAR Node, PULONGLONG ProcessorMask)
+{
+	char path[64];
+	char buffer[256];
+
+	if (!ProcessorMask)
+		return FALSE;
+
+	*ProcessorMask = 0;
+	sprintf_s(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+	          (unsigned)Node);
+
+	if (read_sysfs_line(path, buffer, sizeof(buffer)))
+		return parse_cpu_list(buffer, ProcessorMask) || (buffer[0] == '\n');
+
+	/* no NUMA information, all processors are on node 0 */
+	if (Node != 0)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	if (read_sysfs_line("/sys/devices/system/cpu/online", buffer, sizeof(buffer)) &&
+	    parse_cpu_list(buffer, ProcessorMask))
+		return TRUE;
+
+#if defined(_SC_NPROCESSORS_ONLN)
+	{
+		const long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (count >= 64)
+			*ProcessorMask = ~0ULL;
+		else if (count > 0)
+			*ProcessorMask = (1ULL << count) - 1ULL;
+		else
+			*ProcessorMask = 1;
+	}
+#else
+	*ProcessorMask = 1;
+#endif
+	return TRUE;
+}
+
 #endif
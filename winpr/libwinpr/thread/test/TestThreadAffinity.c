@@ -0,0 +1,83 @@
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+
+static BOOL test_parse(const char* str, BOOL expected, ULONGLONG expectedMask)
+{
+	ULONGLONG mask = 0;
+	const BOOL rc = winpr_ParseProcessorMask(str, &mask);
+
+	if (rc != expected)
+	{
+		printf("winpr_ParseProcessorMask(\"%s\") returned %d\n", str, rc);
+		return FALSE;
+	}
+
+	if (rc && (mask != expectedMask))
+	{
+		printf("winpr_ParseProcessorMask(\"%s\") mask 0x%016" PRIx64 " != 0x%016" PRIx64 "\n",
+		       str, mask, expectedMask);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static DWORD WINAPI affinity_thread(LPVOID arg)
+{
+	DWORD_PTR* mask = (DWORD_PTR*)arg;
+	const DWORD_PTR allowed = SetThreadAffinityMask(_GetCurrentThread(), ~(DWORD_PTR)0);
+	const DWORD_PTR lowest = allowed & (~allowed + 1);
+
+	/* pin to the lowest allowed processor, a second call returns that mask */
+	*mask = 0;
+	if ((allowed != 0) && (SetThreadAffinityMask(_GetCurrentThread(), lowest) != 0) &&
+	    (SetThreadAffinityMask(_GetCurrentThread(), lowest) == lowest))
+		*mask = lowest;
+
+	return 0;
+}
+
+int TestThreadAffinity(int argc, char* argv[])
+{
+	ULONG highest = 0;
+	ULONGLONG node0 = 0;
+	DWORD_PTR mask = 0;
+	HANDLE thread;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_parse("0", TRUE, 0x1) || !test_parse("0-3,8", TRUE, 0x10F) ||
+	    !test_parse("1,3,5-6\n", TRUE, 0x6A) || !test_parse("63", TRUE, 1ULL << 63) ||
+	    !test_parse("", FALSE, 0) || !test_parse("3-1", FALSE, 0) ||
+	    !test_parse("64", FALSE, 0) || !test_parse("1;2", FALSE, 0) ||
+	    !test_parse("node:", FALSE, 0) || !test_parse("node:x", FALSE, 0))
+		return -1;
+
+	if (!GetNumaHighestNodeNumber(&highest))
+		return -1;
+
+	if (!GetNumaNodeProcessorMask(0, &node0) || (node0 == 0) ||
+	    !test_parse("node:0", TRUE, node0) || !test_parse("node:256", FALSE, 0))
+		return -1;
+
+#if defined(__linux__) && !defined(ANDROID)
+	if (!(thread = CreateThread(NULL, 0, affinity_thread, &mask, 0, NULL)))
+		return -1;
+
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+
+	if (mask == 0)
+	{
+		printf("SetThreadAffinityMask failed\n");
+		return -1;
+	}
+#else
+	WINPR_UNUSED(mask);
+	WINPR_UNUSED(thread);
+#endif
+
+	return 0;
+}
@@ -20,6 +20,11 @@
  * limitations under the License.
  */
 
+/* pthread_setaffinity_np */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <winpr/config.h>
 
 #include <winpr/assert.h>
@@ -57,6 +62,7 @@
  * QueueUserAPC
  * ResumeThread
  * SetPriorityClass
+ * SetThreadAffinityMask
  * SetThreadContext
  * SetThreadPriority
  * SetThreadPriorityBoost
@@ -785,6 +791,70 @@ BOOL SwitchToThread(VOID)
 	return TRUE;
 }
 
+DWORD_PTR SetThreadAffinityMask(HANDLE hThread, DWORD_PTR dwThreadAffinityMask)
+{
+#if defined(__linux__) && !defined(ANDROID)
+	ULONG Type;
+	WINPR_HANDLE* Object;
+	pthread_t tid;
+	cpu_set_t set;
+	DWORD_PTR previous = 0;
+	size_t x;
+	int rc;
+
+	if (!winpr_Handle_GetInfo(hThread, &Type, &Object) || (Type != HANDLE_TYPE_THREAD))
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return 0;
+	}
+
+	if (dwThreadAffinityMask == 0)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+
+	if (Object == (WINPR_HANDLE*)&mainThread)
+		tid = mainThreadId;
+	else
+		tid = ((WINPR_THREAD*)Object)->thread;
+
+	CPU_ZERO(&set);
+	rc = pthread_getaffinity_np(tid, sizeof(set), &set);
+	if (rc != 0)
+		goto fail;
+
+	for (x = 0; x < sizeof(DWORD_PTR) * 8; x++)
+	{
+		if (CPU_ISSET(x, &set))
+			previous |= ((DWORD_PTR)1) << x;
+	}
+
+	CPU_ZERO(&set);
+	for (x = 0; x < sizeof(DWORD_PTR) * 8; x++)
+	{
+		if (dwThreadAffinityMask & (((DWORD_PTR)1) << x))
+			CPU_SET(x, &set);
+	}
+
+	rc = pthread_setaffinity_np(tid, sizeof(set), &set);
+	if (rc != 0)
+		goto fail;
+
+	/* 0 reports failure, a thread only allowed on processors beyond the mask width gets all */
+	return previous ? previous : (DWORD_PTR)-1;
+fail:
+	WLog_WARN(TAG, "failed to change thread affinity: %s [%d]", strerror(rc), rc);
+	SetLastError(ERROR_INVALID_PARAMETER);
+	return 0;
+#else
+	WINPR_UNUSED(hThread);
+	WINPR_UNUSED(dwThreadAffinityMask);
+	SetLastError(ERROR_NOT_SUPPORTED);
+	return 0;
+#endif
+}
+
 BOOL TerminateThread(HANDLE hThread, DWORD dwExitCode)
 {
 	ULONG Type;
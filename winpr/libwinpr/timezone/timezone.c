@@ -24,6 +24,8 @@
 #include <winpr/timezone.h>
 #include <winpr/crt.h>
 #include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
 #include "../log.h"
 
 #define TAG WINPR_TAG("timezone")
@@ -267,7 +269,31 @@ static char* winpr_get_unix_timezone_identifier_from_file(void)
 #endif
 }
 
-static BOOL winpr_match_unix_timezone_identifier_with_list(const char* tzid, const char* list)
+/* IANA identifier -> TimeZoneTable entry, built once from WindowsTimeZoneIdTable */
+static INIT_ONCE time_zone_index_once = INIT_ONCE_STATIC_INIT;
+static wHashTable* time_zone_index = NULL;
+
+/* The detected time zone does not change for the lifetime of the process */
+static INIT_ONCE time_zone_detect_once = INIT_ONCE_STATIC_INIT;
+static const TIME_ZONE_ENTRY* time_zone_detected = NULL;
+
+static const TIME_ZONE_ENTRY* winpr_find_time_zone_entry(const char* id)
+{
+	size_t i;
+
+	for (i = 0; i < TimeZoneTableNrElements; i++)
+	{
+		const TIME_ZONE_ENTRY* tze = &TimeZoneTable[i];
+
+		if (strcmp(tze->Id, id) == 0)
+			return tze;
+	}
+
+	return NULL;
+}
+
+static BOOL winpr_index_unix_timezone_identifiers(wHashTable* index, const TIME_ZONE_ENTRY* tze,
+                                                  const char* list)
 {
 	char* p;
 	char* list_copy;
@@ -282,30 +308,81 @@ static BOOL winpr_match_unix_timezone_identifier_with_list(const char* tzid, con
 
 	while (p != NULL)
 	{
-		if (strcmp(p, tzid) == 0)
+		const TIME_ZONE_ENTRY* cur = HashTable_GetItemValue(index, p);
+
+		/* An identifier listed for several zones resolves to the first one of TimeZoneTable */
+		if (!cur || (cur > tze))
 		{
-			free(list_copy);
-			return TRUE;
+			if (!HashTable_Insert(index, p, tze))
+			{
+				free(list_copy);
+				return FALSE;
+			}
 		}
 
 		p = strtok_s(NULL, " ", &context);
 	}
 
 	free(list_copy);
+	return TRUE;
+}
+
+static BOOL CALLBACK winpr_time_zone_index_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	size_t j;
+	wHashTable* index;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	index = HashTable_New(FALSE);
+
+	if (!index || !HashTable_SetupForStringData(index, FALSE))
+		goto fail;
+
+	for (j = 0; j < WindowsTimeZoneIdTableNrElements; j++)
+	{
+		const WINDOWS_TZID_ENTRY* wzid = &WindowsTimeZoneIdTable[j];
+		const TIME_ZONE_ENTRY* tze = winpr_find_time_zone_entry(wzid->windows);
+
+		if (!tze)
+			continue;
+
+		if (!winpr_index_unix_timezone_identifiers(index, tze, wzid->tzid))
+			goto fail;
+	}
+
+	time_zone_index = index;
+	return TRUE;
+fail:
+	HashTable_Free(index);
 	return FALSE;
 }
 
-static TIME_ZONE_ENTRY* winpr_detect_windows_time_zone(void)
+static const TIME_ZONE_ENTRY* winpr_lookup_windows_time_zone(const char* tzid)
 {
-	size_t i, j;
+	if (!InitOnceExecuteOnce(&time_zone_index_once, winpr_time_zone_index_init, NULL, NULL))
+		return NULL;
+
+	return HashTable_GetItemValue(time_zone_index, tzid);
+}
+
+static BOOL CALLBACK winpr_detect_windows_time_zone(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	DWORD nSize;
 	char *tzid = NULL, *ntzid = NULL;
 	LPCSTR tz = "TZ";
 
-	DWORD nSize = GetEnvironmentVariableA(tz, NULL, 0);
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	nSize = GetEnvironmentVariableA(tz, NULL, 0);
 	if (nSize)
 	{
 		tzid = (char*)malloc(nSize);
-		if (!GetEnvironmentVariableA(tz, tzid, nSize))
+		if (tzid && !GetEnvironmentVariableA(tz, tzid, nSize))
 		{
 			free(tzid);
 			tzid = NULL;
@@ -335,38 +412,16 @@ static TIME_ZONE_ENTRY* winpr_detect_windows_time_zone(void)
 	}
 
 	if (tzid == NULL)
-		return NULL;
+		return TRUE;
 
 	WLog_INFO(TAG, "tzid: %s", tzid);
+	time_zone_detected = winpr_lookup_windows_time_zone(tzid);
 
-	for (i = 0; i < TimeZoneTableNrElements; i++)
-	{
-		const TIME_ZONE_ENTRY* tze = &TimeZoneTable[i];
-
-		for (j = 0; j < WindowsTimeZoneIdTableNrElements; j++)
-		{
-			const WINDOWS_TZID_ENTRY* wzid = &WindowsTimeZoneIdTable[j];
-
-			if (strcmp(tze->Id, wzid->windows) != 0)
-				continue;
-
-			if (winpr_match_unix_timezone_identifier_with_list(tzid, wzid->tzid))
-			{
-				TIME_ZONE_ENTRY* ctimezone = (TIME_ZONE_ENTRY*)malloc(sizeof(TIME_ZONE_ENTRY));
-				free(tzid);
+	if (!time_zone_detected)
+		WLog_ERR(TAG, "Unable to find a match for unix timezone: %s", tzid);
 
-				if (!ctimezone)
-					return NULL;
-
-				*ctimezone = TimeZoneTable[i];
-				return ctimezone;
-			}
-		}
-	}
-
-	WLog_ERR(TAG, "Unable to find a match for unix timezone: %s", tzid);
 	free(tzid);
-	return NULL;
+	return TRUE;
 }
 
 static const TIME_ZONE_RULE_ENTRY*
@@ -395,7 +450,7 @@ DWORD GetTimeZoneInformation(LPTIME_ZONE_INFORMATION lpTimeZoneInformation)
 	time_t t;
 	struct tm tres;
 	struct tm* local_time;
-	TIME_ZONE_ENTRY* dtz = NULL;
+	const TIME_ZONE_ENTRY* dtz = NULL;
 	LPTIME_ZONE_INFORMATION tz = lpTimeZoneInformation;
 	lpTimeZoneInformation->StandardBias = 0;
 	time(&t);
@@ -416,7 +471,8 @@ DWORD GetTimeZoneInformation(LPTIME_ZONE_INFORMATION lpTimeZoneInformation)
 #else
 	tz->Bias = 0;
 #endif
-	dtz = winpr_detect_windows_time_zone();
+	InitOnceExecuteOnce(&time_zone_detect_once, winpr_detect_windows_time_zone, NULL, NULL);
+	dtz = time_zone_detected;
 
 	if (dtz != NULL)
 	{
@@ -459,7 +515,6 @@ DWORD GetTimeZoneInformation(LPTIME_ZONE_INFORMATION lpTimeZoneInformation)
 			}
 		}
 
-		free(dtz);
 		/* 1 ... TIME_ZONE_ID_STANDARD
 		 * 2 ... TIME_ZONE_ID_DAYLIGHT */
 		return local_time->tm_isdst ? 2 : 1;
@@ -468,7 +523,6 @@ DWORD GetTimeZoneInformation(LPTIME_ZONE_INFORMATION lpTimeZoneInformation)
 	/* could not detect timezone, use computed bias from tm_gmtoff */
 	WLog_DBG(TAG, "tz not found, using computed bias %" PRId32 ".", tz->Bias);
 out_error:
-	free(dtz);
 	memcpy(tz->StandardName, L"Client Local Time", sizeof(tz->StandardName));
 	memcpy(tz->DaylightName, L"Client Local Time", sizeof(tz->DaylightName));
 	return 0; /* TIME_ZONE_ID_UNKNOWN */
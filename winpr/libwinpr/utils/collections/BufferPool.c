@@ -82,71 +82,48 @@ static BOOL BufferPool_Unlock(wBufferPool* pool)
  * Methods
  */
 
-static BOOL BufferPool_ShiftAvailable(wBufferPool* pool, size_t index, int count)
+/* The item arrays only hold bookkeeping, pool->alignment applies to the buffers */
+static BOOL BufferPool_EnsureItemCapacity(wBufferPoolItem** array, SSIZE_T* capacity,
+                                          SSIZE_T size)
 {
-	if (count > 0)
-	{
-		if (pool->aSize + count > pool->aCapacity)
-		{
-			wBufferPoolItem* newArray;
-			SSIZE_T newCapacity = pool->aCapacity * 2;
+	SSIZE_T newCapacity;
+	wBufferPoolItem* newArray;
 
-			if (pool->alignment > 0)
-				newArray = (wBufferPoolItem*)_aligned_realloc(
-				    pool->aArray, sizeof(wBufferPoolItem) * newCapacity, pool->alignment);
-			else
-				newArray =
-				    (wBufferPoolItem*)realloc(pool->aArray, sizeof(wBufferPoolItem) * newCapacity);
-			if (!newArray)
-				return FALSE;
-			pool->aArray = newArray;
-			pool->aCapacity = newCapacity;
-		}
+	if (size < *capacity)
+		return TRUE;
 
-		MoveMemory(&pool->aArray[index + count], &pool->aArray[index],
-		           (pool->aSize - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
-	}
-	else if (count < 0)
-	{
-		MoveMemory(&pool->aArray[index], &pool->aArray[index - count],
-		           (pool->aSize - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
-	}
+	newCapacity = *capacity * 2;
+	newArray = (wBufferPoolItem*)realloc(*array, sizeof(wBufferPoolItem) * newCapacity);
+
+	if (!newArray)
+		return FALSE;
+
+	*array = newArray;
+	*capacity = newCapacity;
 	return TRUE;
 }
 
-static BOOL BufferPool_ShiftUsed(wBufferPool* pool, SSIZE_T index, SSIZE_T count)
+/* Order does not matter, move the last item into the hole instead of shifting */
+static void BufferPool_RemoveItem(wBufferPoolItem* array, SSIZE_T* size, SSIZE_T index)
 {
-	if (count > 0)
-	{
-		if (pool->uSize + count > pool->uCapacity)
-		{
-			SSIZE_T newUCapacity = pool->uCapacity * 2;
-			wBufferPoolItem* newUArray;
-			if (pool->alignment > 0)
-				newUArray = (wBufferPoolItem*)_aligned_realloc(
-				    pool->uArray, sizeof(wBufferPoolItem) * newUCapacity, pool->alignment);
-			else
-				newUArray =
-				    (wBufferPoolItem*)realloc(pool->uArray, sizeof(wBufferPoolItem) * newUCapacity);
-			if (!newUArray)
-				return FALSE;
-			pool->uCapacity = newUCapacity;
-			pool->uArray = newUArray;
-		}
+	(*size)--;
 
-		MoveMemory(&pool->uArray[index + count], &pool->uArray[index],
-		           (pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
-	}
-	else if (count < 0)
+	if (index != *size)
+		array[index] = array[*size];
+}
+
+/* Buffers are usually returned shortly after being taken, search from the end */
+static SSIZE_T BufferPool_FindUsed(wBufferPool* pool, const void* buffer)
+{
+	SSIZE_T index;
+
+	for (index = pool->uSize - 1; index >= 0; index--)
 	{
-		MoveMemory(&pool->uArray[index], &pool->uArray[index - count],
-		           (pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
+		if (pool->uArray[index].buffer == buffer)
+			return index;
 	}
-	return TRUE;
+
+	return -1;
 }
 
 /**
@@ -196,15 +173,12 @@ SSIZE_T BufferPool_GetBufferSize(wBufferPool* pool, const void* buffer)
 	else
 	{
 		/* variable size buffers */
+		index = BufferPool_FindUsed(pool, buffer);
 
-		for (index = 0; index < pool->uSize; index++)
+		if (index >= 0)
 		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				size = pool->uArray[index].size;
-				found = TRUE;
-				break;
-			}
+			size = pool->uArray[index].size;
+			found = TRUE;
 		}
 	}
 
@@ -310,25 +284,20 @@ void* BufferPool_Take(wBufferPool* pool, SSIZE_T size)
 
 				buffer = newBuffer;
 			}
+			else
+			{
+				/* remember the real size, the buffer may be handed out for more later */
+				size = pool->aArray[foundIndex].size;
+			}
 
-			if (!BufferPool_ShiftAvailable(pool, foundIndex, -1))
-				goto out_error;
+			BufferPool_RemoveItem(pool->aArray, &pool->aSize, foundIndex);
 		}
 
 		if (!buffer)
 			goto out_error;
 
-		if (pool->uSize + 1 > pool->uCapacity)
-		{
-			size_t newUCapacity = pool->uCapacity * 2;
-			wBufferPoolItem* newUArray =
-			    (wBufferPoolItem*)realloc(pool->uArray, sizeof(wBufferPoolItem) * newUCapacity);
-			if (!newUArray)
-				goto out_error;
-
-			pool->uCapacity = newUCapacity;
-			pool->uArray = newUArray;
-		}
+		if (!BufferPool_EnsureItemCapacity(&pool->uArray, &pool->uCapacity, pool->uSize + 1))
+			goto out_error;
 
 		pool->uArray[pool->uSize].buffer = buffer;
 		pool->uArray[pool->uSize].size = size;
@@ -358,7 +327,6 @@ BOOL BufferPool_Return(wBufferPool* pool, void* buffer)
 	BOOL rc = FALSE;
 	SSIZE_T size = 0;
 	SSIZE_T index = 0;
-	BOOL found = FALSE;
 
 	BufferPool_Lock(pool);
 
@@ -382,36 +350,18 @@ BOOL BufferPool_Return(wBufferPool* pool, void* buffer)
 	else
 	{
 		/* variable size buffers */
+		index = BufferPool_FindUsed(pool, buffer);
 
-		for (index = 0; index < pool->uSize; index++)
-		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				found = TRUE;
-				break;
-			}
-		}
-
-		if (found)
+		if (index >= 0)
 		{
 			size = pool->uArray[index].size;
-			if (!BufferPool_ShiftUsed(pool, index, -1))
-				goto out_error;
+			BufferPool_RemoveItem(pool->uArray, &pool->uSize, index);
 		}
 
 		if (size)
 		{
-			if ((pool->aSize + 1) >= pool->aCapacity)
-			{
-				SSIZE_T newCapacity = pool->aCapacity * 2;
-				wBufferPoolItem* newArray =
-				    (wBufferPoolItem*)realloc(pool->aArray, sizeof(wBufferPoolItem) * newCapacity);
-				if (!newArray)
-					goto out_error;
-
-				pool->aCapacity = newCapacity;
-				pool->aArray = newArray;
-			}
+			if (!BufferPool_EnsureItemCapacity(&pool->aArray, &pool->aCapacity, pool->aSize + 1))
+				goto out_error;
 
 			pool->aArray[pool->aSize].buffer = buffer;
 			pool->aArray[pool->aSize].size = size;
@@ -104,35 +104,34 @@ void HashTable_StringFree(void* str)
 	free(str);
 }
 
-static INLINE BOOL HashTable_IsProbablePrime(size_t oddNumber)
+/* Bucket counts are powers of two, so the hash is mixed before masking.
+ * This is the murmur3 finalizer, it spreads weak hashes like small ids
+ * or aligned pointers over all buckets. */
+static INLINE size_t HashTable_BucketIndex(wHashTable* table, const void* key, size_t numOfBuckets)
 {
-	size_t i;
+	UINT32 hash;
 
-	for (i = 3; i < 51; i += 2)
-	{
-		if (oddNumber == i)
-			return TRUE;
-		else if (oddNumber % i == 0)
-			return FALSE;
-	}
-
-	return TRUE; /* maybe */
+	WINPR_ASSERT(table);
+	WINPR_ASSERT(table->hash);
+	hash = table->hash(key);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash & (numOfBuckets - 1);
 }
 
 static INLINE size_t HashTable_CalculateIdealNumOfBuckets(wHashTable* table)
 {
-	size_t idealNumOfBuckets;
+	size_t idealNumOfBuckets = 8;
+	size_t minNumOfBuckets;
 
 	WINPR_ASSERT(table);
-	idealNumOfBuckets = table->numOfElements / (table->idealRatio);
+	minNumOfBuckets = table->numOfElements / (table->idealRatio);
 
-	if (idealNumOfBuckets < 5)
-		idealNumOfBuckets = 5;
-	else
-		idealNumOfBuckets |= 0x01;
-
-	while (!HashTable_IsProbablePrime(idealNumOfBuckets))
-		idealNumOfBuckets += 2;
+	while (idealNumOfBuckets < minNumOfBuckets)
+		idealNumOfBuckets <<= 1;
 
 	return idealNumOfBuckets;
 }
@@ -140,7 +139,7 @@ static INLINE size_t HashTable_CalculateIdealNumOfBuckets(wHashTable* table)
 static INLINE void HashTable_Rehash(wHashTable* table, size_t numOfBuckets)
 {
 	size_t index;
-	UINT32 hashValue;
+	size_t hashValue;
 	wKeyValuePair* pair;
 	wKeyValuePair* nextPair;
 	wKeyValuePair** newBucketArray;
@@ -170,7 +169,7 @@ static INLINE void HashTable_Rehash(wHashTable* table, size_t numOfBuckets)
 		while (pair)
 		{
 			nextPair = pair->next;
-			hashValue = table->hash(pair->key) % numOfBuckets;
+			hashValue = HashTable_BucketIndex(table, pair->key, numOfBuckets);
 			pair->next = newBucketArray[hashValue];
 			newBucketArray[hashValue] = pair;
 			pair = nextPair;
@@ -192,14 +191,14 @@ static INLINE BOOL HashTable_Equals(wHashTable* table, const wKeyValuePair* pair
 
 static INLINE wKeyValuePair* HashTable_Get(wHashTable* table, const void* key)
 {
-	UINT32 hashValue;
+	size_t hashValue;
 	wKeyValuePair* pair;
 
 	WINPR_ASSERT(table);
 	if (!key)
 		return NULL;
 
-	hashValue = table->hash(key) % table->numOfBuckets;
+	hashValue = HashTable_BucketIndex(table, key, table->numOfBuckets);
 	pair = table->bucketArray[hashValue];
 
 	while (pair && !HashTable_Equals(table, pair, key))
@@ -294,7 +293,7 @@ int HashTable_Add(wHashTable* table, const void* key, const void* value)
 BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 {
 	BOOL rc = FALSE;
-	UINT32 hashValue;
+	size_t hashValue;
 	wKeyValuePair* pair;
 	wKeyValuePair* newPair;
 
@@ -305,7 +304,7 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
+	hashValue = HashTable_BucketIndex(table, key, table->numOfBuckets);
 	pair = table->bucketArray[hashValue];
 
 	while (pair && !HashTable_Equals(table, pair, key))
@@ -369,7 +368,7 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 
 BOOL HashTable_Remove(wHashTable* table, const void* key)
 {
-	UINT32 hashValue;
+	size_t hashValue;
 	BOOL status = TRUE;
 	wKeyValuePair* pair = NULL;
 	wKeyValuePair* previousPair = NULL;
@@ -381,7 +380,7 @@ BOOL HashTable_Remove(wHashTable* table, const void* key)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
+	hashValue = HashTable_BucketIndex(table, key, table->numOfBuckets);
 	pair = table->bucketArray[hashValue];
 
 	while (pair && !HashTable_Equals(table, pair, key))
@@ -390,7 +389,7 @@ BOOL HashTable_Remove(wHashTable* table, const void* key)
 		pair = pair->next;
 	}
 
-	if (!pair)
+	if (!pair || pair->markedForRemove)
 	{
 		status = FALSE;
 		goto out;
@@ -505,21 +504,26 @@ void HashTable_Clear(wHashTable* table)
 	{
 		pair = table->bucketArray[index];
 
-		while (pair)
+		if (table->foreachRecursionLevel)
 		{
-			nextPair = pair->next;
-
-			if (table->foreachRecursionLevel)
+			/* if we're in a foreach we just mark the entries for removal */
+			for (; pair; pair = pair->next)
 			{
-				/* if we're in a foreach we just mark the entry for removal */
-				pair->markedForRemove = TRUE;
-				table->pendingRemoves++;
-			}
-			else
-			{
-				disposePair(table, pair);
-				pair = nextPair;
+				if (!pair->markedForRemove)
+				{
+					pair->markedForRemove = TRUE;
+					table->pendingRemoves++;
+				}
 			}
+
+			continue;
+		}
+
+		while (pair)
+		{
+			nextPair = pair->next;
+			disposePair(table, pair);
+			pair = nextPair;
 		}
 
 		table->bucketArray[index] = NULL;
@@ -527,7 +531,7 @@ void HashTable_Clear(wHashTable* table)
 
 	table->numOfElements = 0;
 	if (table->foreachRecursionLevel == 0)
-		HashTable_Rehash(table, 5);
+		HashTable_Rehash(table, 0);
 
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -616,9 +620,12 @@ BOOL HashTable_Foreach(wHashTable* table, HASH_TABLE_FOREACH_FN fn, VOID* arg)
 			if (!pair->markedForRemove && !fn(pair->key, pair->value, arg))
 			{
 				ret = FALSE;
-				goto out;
+				break;
 			}
 		}
+
+		if (!ret)
+			break;
 	}
 	table->foreachRecursionLevel--;
 
@@ -649,7 +656,6 @@ BOOL HashTable_Foreach(wHashTable* table, HASH_TABLE_FOREACH_FN fn, VOID* arg)
 		table->pendingRemoves = 0;
 	}
 
-out:
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 	return ret;
@@ -728,7 +734,7 @@ BOOL HashTable_ContainsValue(wHashTable* table, const void* value)
 
 		while (pair)
 		{
-			if (!pair->markedForRemove && HashTable_Equals(table, pair, value))
+			if (!pair->markedForRemove && table->value.fnObjectEquals(value, pair->value))
 			{
 				status = TRUE;
 				break;
@@ -767,9 +773,9 @@ wHashTable* HashTable_New(BOOL synchronized)
 	if (!table->bucketArray)
 		goto fail;
 
-	table->idealRatio = 3.0;
+	table->idealRatio = 1.0;
 	table->lowerRehashThreshold = 0.0;
-	table->upperRehashThreshold = 15.0;
+	table->upperRehashThreshold = 2.0;
 	table->hash = HashTable_PointerHash;
 	table->key.fnObjectEquals = HashTable_PointerCompare;
 	table->value.fnObjectEquals = HashTable_PointerCompare;
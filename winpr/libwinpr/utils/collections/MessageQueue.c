@@ -145,7 +145,8 @@ BOOL MessageQueue_Dispatch(wMessageQueue* queue, const wMessage* message)
 	queue->tail = (queue->tail + 1) % queue->capacity;
 	queue->size++;
 
-	if (queue->size > 0)
+	/* The event stays set until the queue is drained, only signal the first message */
+	if (queue->size == 1)
 		SetEvent(queue->event);
 
 	if (message->id == WMQ_QUIT)
@@ -230,6 +231,35 @@ int MessageQueue_Peek(wMessageQueue* queue, wMessage* message, BOOL remove)
 	return status;
 }
 
+size_t MessageQueue_GetBatch(wMessageQueue* queue, wMessage* messages, size_t count)
+{
+	size_t index = 0;
+
+	WINPR_ASSERT(queue);
+	WINPR_ASSERT(messages || (count == 0));
+	EnterCriticalSection(&queue->lock);
+
+	while ((index < count) && (queue->size > 0))
+	{
+		wMessage* message = &messages[index++];
+
+		CopyMemory(message, &(queue->array[queue->head]), sizeof(wMessage));
+		ZeroMemory(&(queue->array[queue->head]), sizeof(wMessage));
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->size--;
+
+		if (message->id == WMQ_QUIT)
+			break;
+	}
+
+	if ((index > 0) && (queue->size < 1))
+		ResetEvent(queue->event);
+
+	LeaveCriticalSection(&queue->lock);
+
+	return index;
+}
+
 /**
  * Construction, Destruction
  */
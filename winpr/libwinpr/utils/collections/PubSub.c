@@ -20,6 +20,7 @@
 #include <winpr/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
@@ -28,6 +29,18 @@
  * http://msdn.microsoft.com/en-us/library/awbftdfh.aspx
  */
 
+/**
+ * Handlers are dispatched from an immutable snapshot. Subscribe and Unsubscribe publish a
+ * new snapshot under the lock, a raise only holds the lock to take a reference and runs
+ * the handlers unlocked, so handlers may (un)subscribe or raise other events.
+ */
+typedef struct
+{
+	LONG refCount;
+	size_t count;
+	pEventHandler handlers[MAX_EVENT_HANDLERS];
+} wPubSubHandlers;
+
 struct s_wPubSub
 {
 	CRITICAL_SECTION lock;
@@ -36,8 +49,61 @@ struct s_wPubSub
 	size_t size;
 	size_t count;
 	wEventType* events;
+	wPubSubHandlers** handlers; /* current snapshot of each event type */
+	wHashTable* ids;            /* event name to index + 1 */
 };
 
+static void pubsub_handlers_release(wPubSubHandlers* handlers)
+{
+	if (handlers && (InterlockedDecrement(&handlers->refCount) == 0))
+		free(handlers);
+}
+
+/* called with the lock held */
+static wPubSubHandlers* pubsub_handlers_acquire(wPubSub* pubSub, size_t index)
+{
+	wPubSubHandlers* handlers = pubSub->handlers[index];
+
+	if (handlers)
+		InterlockedIncrement(&handlers->refCount);
+
+	return handlers;
+}
+
+/* called with the lock held, mirrors the new handler list into the public event type */
+static BOOL pubsub_handlers_publish(wPubSub* pubSub, size_t index, const pEventHandler* list,
+                                    size_t count)
+{
+	wEventType* event = &pubSub->events[index];
+	wPubSubHandlers* handlers = (wPubSubHandlers*)calloc(1, sizeof(wPubSubHandlers));
+
+	if (!handlers)
+		return FALSE;
+
+	handlers->refCount = 1;
+	handlers->count = count;
+	CopyMemory(handlers->handlers, list, count * sizeof(pEventHandler));
+
+	ZeroMemory(event->EventHandlers, sizeof(event->EventHandlers));
+	CopyMemory(event->EventHandlers, list, count * sizeof(pEventHandler));
+	event->EventHandlerCount = count;
+
+	pubsub_handlers_release(pubSub->handlers[index]);
+	pubSub->handlers[index] = handlers;
+	return TRUE;
+}
+
+/* called with the lock held */
+static int pubsub_find_event_id(wPubSub* pubSub, const char* EventName)
+{
+	const size_t id = (size_t)HashTable_GetItemValue(pubSub->ids, EventName);
+
+	if ((id == 0) || (id > pubSub->count))
+		return -1;
+
+	return (int)(id - 1);
+}
+
 /**
  * Properties
  */
@@ -71,148 +137,206 @@ void PubSub_Unlock(wPubSub* pubSub)
 
 wEventType* PubSub_FindEventType(wPubSub* pubSub, const char* EventName)
 {
-	size_t index;
-	wEventType* event = NULL;
+	int id;
+
+	WINPR_ASSERT(pubSub);
+	WINPR_ASSERT(EventName);
+
+	id = pubsub_find_event_id(pubSub, EventName);
+	if (id < 0)
+		return NULL;
+
+	return &pubSub->events[id];
+}
+
+int PubSub_GetEventId(wPubSub* pubSub, const char* EventName)
+{
+	int id;
 
 	WINPR_ASSERT(pubSub);
 	WINPR_ASSERT(EventName);
-	for (index = 0; index < pubSub->count; index++)
-	{
-		if (strcmp(pubSub->events[index].EventName, EventName) == 0)
-		{
-			event = &(pubSub->events[index]);
-			break;
-		}
-	}
 
-	return event;
+	PubSub_Lock(pubSub);
+	id = pubsub_find_event_id(pubSub, EventName);
+	PubSub_Unlock(pubSub);
+	return id;
 }
 
 void PubSub_AddEventTypes(wPubSub* pubSub, wEventType* events, size_t count)
 {
+	size_t index;
+
 	WINPR_ASSERT(pubSub);
 	WINPR_ASSERT(events || (count == 0));
-	if (pubSub->synchronized)
-		PubSub_Lock(pubSub);
+	PubSub_Lock(pubSub);
 
 	while (pubSub->count + count >= pubSub->size)
 	{
 		size_t new_size;
 		wEventType* new_event;
+		wPubSubHandlers** new_handlers;
 
 		new_size = pubSub->size * 2;
 		new_event = (wEventType*)realloc(pubSub->events, new_size * sizeof(wEventType));
 		if (!new_event)
-			return;
-		pubSub->size = new_size;
+			goto out;
 		pubSub->events = new_event;
+
+		new_handlers = (wPubSubHandlers**)realloc(pubSub->handlers,
+		                                          new_size * sizeof(wPubSubHandlers*));
+		if (!new_handlers)
+			goto out;
+		pubSub->handlers = new_handlers;
+		pubSub->size = new_size;
 	}
 
-	CopyMemory(&pubSub->events[pubSub->count], events, count * sizeof(wEventType));
-	pubSub->count += count;
+	for (index = 0; index < count; index++)
+	{
+		const size_t id = pubSub->count;
+		wEventType* event = &pubSub->events[id];
+
+		*event = events[index];
+		pubSub->handlers[id] = NULL;
 
-	if (pubSub->synchronized)
-		PubSub_Unlock(pubSub);
+		/* the first registration of a name wins, as with the former linear search */
+		if (!HashTable_Contains(pubSub->ids, event->EventName) &&
+		    !HashTable_Insert(pubSub->ids, event->EventName, (void*)(id + 1)))
+			goto out;
+
+		pubSub->count++;
+
+		if (event->EventHandlerCount > MAX_EVENT_HANDLERS)
+			event->EventHandlerCount = MAX_EVENT_HANDLERS;
+
+		if (!pubsub_handlers_publish(pubSub, id, event->EventHandlers, event->EventHandlerCount))
+			goto out;
+	}
+
+out:
+	PubSub_Unlock(pubSub);
 }
 
 int PubSub_Subscribe(wPubSub* pubSub, const char* EventName, pEventHandler EventHandler)
 {
-	wEventType* event;
+	int id;
 	int status = -1;
 	WINPR_ASSERT(pubSub);
+	WINPR_ASSERT(EventName);
 	WINPR_ASSERT(EventHandler);
 
-	if (pubSub->synchronized)
-		PubSub_Lock(pubSub);
-
-	event = PubSub_FindEventType(pubSub, EventName);
+	PubSub_Lock(pubSub);
+	id = pubsub_find_event_id(pubSub, EventName);
 
-	if (event)
+	if (id >= 0)
 	{
-		status = 0;
+		pEventHandler list[MAX_EVENT_HANDLERS] = { 0 };
+		const wPubSubHandlers* handlers = pubSub->handlers[id];
+		const size_t count = handlers ? handlers->count : 0;
 
-		if (event->EventHandlerCount < MAX_EVENT_HANDLERS)
-			event->EventHandlers[event->EventHandlerCount++] = EventHandler;
-		else
-			status = -1;
-	}
+		if (count < MAX_EVENT_HANDLERS)
+		{
+			if (handlers)
+				CopyMemory(list, handlers->handlers, count * sizeof(pEventHandler));
 
-	if (pubSub->synchronized)
-		PubSub_Unlock(pubSub);
+			list[count] = EventHandler;
+
+			if (pubsub_handlers_publish(pubSub, (size_t)id, list, count + 1))
+				status = 0;
+		}
+	}
 
+	PubSub_Unlock(pubSub);
 	return status;
 }
 
 int PubSub_Unsubscribe(wPubSub* pubSub, const char* EventName, pEventHandler EventHandler)
 {
-	size_t index;
-	wEventType* event;
+	int id;
 	int status = -1;
 	WINPR_ASSERT(pubSub);
 	WINPR_ASSERT(EventName);
 	WINPR_ASSERT(EventHandler);
 
-	if (pubSub->synchronized)
-		PubSub_Lock(pubSub);
-
-	event = PubSub_FindEventType(pubSub, EventName);
+	PubSub_Lock(pubSub);
+	id = pubsub_find_event_id(pubSub, EventName);
 
-	if (event)
+	if (id >= 0)
 	{
+		size_t index;
+		size_t count = 0;
+		pEventHandler list[MAX_EVENT_HANDLERS] = { 0 };
+		const wPubSubHandlers* handlers = pubSub->handlers[id];
+
 		status = 0;
 
-		for (index = 0; index < event->EventHandlerCount; index++)
+		for (index = 0; handlers && (index < handlers->count); index++)
 		{
-			if (event->EventHandlers[index] == EventHandler)
-			{
-				event->EventHandlers[index] = NULL;
-				event->EventHandlerCount--;
-				MoveMemory(&event->EventHandlers[index], &event->EventHandlers[index + 1],
-				           (MAX_EVENT_HANDLERS - index - 1) * sizeof(pEventHandler));
+			if (handlers->handlers[index] != EventHandler)
+				list[count++] = handlers->handlers[index];
+		}
+
+		if (handlers && (count != handlers->count))
+		{
+			if (pubsub_handlers_publish(pubSub, (size_t)id, list, count))
 				status = 1;
-			}
+			else
+				status = -1;
 		}
 	}
 
-	if (pubSub->synchronized)
-		PubSub_Unlock(pubSub);
-
+	PubSub_Unlock(pubSub);
 	return status;
 }
 
-int PubSub_OnEvent(wPubSub* pubSub, const char* EventName, void* context, const wEventArgs* e)
+int PubSub_OnEventId(wPubSub* pubSub, int EventId, void* context, const wEventArgs* e)
 {
 	size_t index;
-	wEventType* event;
+	wPubSubHandlers* handlers = NULL;
 	int status = -1;
 	WINPR_ASSERT(pubSub);
 	WINPR_ASSERT(e);
 
-	if (pubSub->synchronized)
-		PubSub_Lock(pubSub);
-
-	event = PubSub_FindEventType(pubSub, EventName);
-
-	if (pubSub->synchronized)
-		PubSub_Unlock(pubSub);
+	PubSub_Lock(pubSub);
 
-	if (event)
+	if ((EventId >= 0) && ((size_t)EventId < pubSub->count))
 	{
+		handlers = pubsub_handlers_acquire(pubSub, (size_t)EventId);
 		status = 0;
+	}
+
+	PubSub_Unlock(pubSub);
 
-		for (index = 0; index < event->EventHandlerCount; index++)
+	if (handlers)
+	{
+		for (index = 0; index < handlers->count; index++)
 		{
-			if (event->EventHandlers[index])
-			{
-				event->EventHandlers[index](context, e);
-				status++;
-			}
+			handlers->handlers[index](context, e);
+			status++;
 		}
+
+		pubsub_handlers_release(handlers);
 	}
 
 	return status;
 }
 
+int PubSub_OnEvent(wPubSub* pubSub, const char* EventName, void* context, const wEventArgs* e)
+{
+	int id;
+	WINPR_ASSERT(pubSub);
+	WINPR_ASSERT(EventName);
+	WINPR_ASSERT(e);
+
+	PubSub_Lock(pubSub);
+	id = pubsub_find_event_id(pubSub, EventName);
+	PubSub_Unlock(pubSub);
+
+	if (id < 0)
+		return -1;
+
+	return PubSub_OnEventId(pubSub, id, context, e);
+}
+
 /**
  * Construction, Destruction
  */
@@ -236,6 +360,14 @@ wPubSub* PubSub_New(BOOL synchronized)
 	if (!pubSub->events)
 		goto fail;
 
+	pubSub->handlers = (wPubSubHandlers**)calloc(pubSub->size, sizeof(wPubSubHandlers*));
+	if (!pubSub->handlers)
+		goto fail;
+
+	pubSub->ids = HashTable_New(FALSE);
+	if (!pubSub->ids || !HashTable_SetupForStringData(pubSub->ids, FALSE))
+		goto fail;
+
 	return pubSub;
 fail:
 	PubSub_Free(pubSub);
@@ -246,9 +378,16 @@ void PubSub_Free(wPubSub* pubSub)
 {
 	if (pubSub)
 	{
+		size_t index;
+
 		if (pubSub->synchronized)
 			DeleteCriticalSection(&pubSub->lock);
 
+		for (index = 0; pubSub->handlers && (index < pubSub->count); index++)
+			pubsub_handlers_release(pubSub->handlers[index]);
+
+		HashTable_Free(pubSub->ids);
+		free(pubSub->handlers);
 		free(pubSub->events);
 		free(pubSub);
 	}
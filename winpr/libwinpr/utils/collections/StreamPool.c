@@ -21,21 +21,35 @@
 
 #include <winpr/crt.h>
 #include <winpr/wlog.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
 #include "../stream.h"
 
+/* Available streams are kept in power of two size classes, bucket n holds streams with a
+ * capacity in [2^n, 2^(n+1)). The last bucket collects everything larger. */
+#define STREAM_POOL_BUCKETS 32
+
+typedef struct
+{
+	size_t size;
+	size_t capacity;
+	wStream** array;
+} wStreamPoolBucket;
+
 struct s_wStreamPool
 {
 	size_t aSize;
-	size_t aCapacity;
-	wStream** aArray;
+	wStreamPoolBucket buckets[STREAM_POOL_BUCKETS];
 
 	size_t uSize;
 	size_t uCapacity;
 	wStream** uArray;
 
+	size_t hits;
+	size_t misses;
+
 	CRITICAL_SECTION lock;
 	BOOL synchronized;
 	size_t defaultSize;
@@ -63,38 +77,24 @@ static INLINE void StreamPool_Unlock(wStreamPool* pool)
 		LeaveCriticalSection(&pool->lock);
 }
 
-static BOOL StreamPool_EnsureCapacity(wStreamPool* pool, size_t count, BOOL usedOrAvailable)
+static BOOL StreamPool_EnsureCapacity(wStream*** array, size_t* capacity, size_t size)
 {
-	size_t new_cap = 0;
-	size_t* cap;
-	size_t* size;
-	wStream*** array;
+	size_t new_cap;
+	wStream** new_arr;
 
-	WINPR_ASSERT(pool);
+	WINPR_ASSERT(array);
+	WINPR_ASSERT(capacity);
 
-	cap = (usedOrAvailable) ? &pool->uCapacity : &pool->aCapacity;
-	size = (usedOrAvailable) ? &pool->uSize : &pool->aSize;
-	array = (usedOrAvailable) ? &pool->uArray : &pool->aArray;
-	if (*cap == 0)
-		new_cap = *size + count;
-	else if (*size + count > *cap)
-		new_cap = *cap * 2;
-	else if ((*size + count) < *cap / 3)
-		new_cap = *cap / 2;
-
-	if (new_cap > 0)
-	{
-		wStream** new_arr;
+	if (size < *capacity)
+		return TRUE;
 
-		if (*cap < *size + count)
-			*cap += count;
+	new_cap = (*capacity > 0) ? *capacity * 2 : 32;
+	new_arr = (wStream**)realloc(*array, sizeof(wStream*) * new_cap);
+	if (!new_arr)
+		return FALSE;
 
-		new_arr = (wStream**)realloc(*array, sizeof(wStream*) * new_cap);
-		if (!new_arr)
-			return FALSE;
-		*cap = new_cap;
-		*array = new_arr;
-	}
+	*capacity = new_cap;
+	*array = new_arr;
 	return TRUE;
 }
 
@@ -102,39 +102,27 @@ static BOOL StreamPool_EnsureCapacity(wStreamPool* pool, size_t count, BOOL used
  * Methods
  */
 
-static void StreamPool_ShiftUsed(wStreamPool* pool, size_t index, INT64 count)
+static INLINE size_t StreamPool_BucketIndex(size_t capacity)
 {
-	WINPR_ASSERT(pool);
-	if (count > 0)
-	{
-		const size_t pcount = (size_t)count;
-		StreamPool_EnsureCapacity(pool, pcount, TRUE);
+	size_t index = 0;
 
-		MoveMemory(&pool->uArray[index + pcount], &pool->uArray[index],
-		           (pool->uSize - index) * sizeof(wStream*));
-		pool->uSize += pcount;
-	}
-	else if (count < 0)
-	{
-		const size_t pcount = (size_t)-count;
-		if ((pool->uSize - index - pcount) > 0)
-		{
-			MoveMemory(&pool->uArray[index], &pool->uArray[index + pcount],
-			           (pool->uSize - index - pcount) * sizeof(wStream*));
-		}
+	while ((capacity >>= 1) && (index < STREAM_POOL_BUCKETS - 1))
+		index++;
 
-		pool->uSize -= pcount;
-	}
+	return index;
 }
 
 /**
  * Adds a used stream to the pool.
  */
 
-static void StreamPool_AddUsed(wStreamPool* pool, wStream* s)
+static BOOL StreamPool_AddUsed(wStreamPool* pool, wStream* s)
 {
-	StreamPool_EnsureCapacity(pool, 1, TRUE);
+	WINPR_ASSERT(pool);
+	if (!StreamPool_EnsureCapacity(&pool->uArray, &pool->uCapacity, pool->uSize))
+		return FALSE;
 	pool->uArray[(pool->uSize)++] = s;
+	return TRUE;
 }
 
 /**
@@ -144,45 +132,18 @@ static void StreamPool_AddUsed(wStreamPool* pool, wStream* s)
 static void StreamPool_RemoveUsed(wStreamPool* pool, wStream* s)
 {
 	size_t index;
-	BOOL found = FALSE;
 
 	WINPR_ASSERT(pool);
-	for (index = 0; index < pool->uSize; index++)
-	{
-		if (pool->uArray[index] == s)
-		{
-			found = TRUE;
-			break;
-		}
-	}
-
-	if (found)
-		StreamPool_ShiftUsed(pool, index, -1);
-}
-
-static void StreamPool_ShiftAvailable(wStreamPool* pool, size_t index, INT64 count)
-{
-	WINPR_ASSERT(pool);
-	if (count > 0)
-	{
-		const size_t pcount = (size_t)count;
 
-		StreamPool_EnsureCapacity(pool, pcount, FALSE);
-		MoveMemory(&pool->aArray[index + pcount], &pool->aArray[index],
-		           (pool->aSize - index) * sizeof(wStream*));
-		pool->aSize += pcount;
-	}
-	else if (count < 0)
+	/* Streams are mostly released in the reverse order they were taken in, so search from the
+	 * end. The order of the used streams does not matter, fill the gap with the last one. */
+	for (index = pool->uSize; index > 0; index--)
 	{
-		const size_t pcount = (size_t)-count;
-
-		if ((pool->aSize - index - pcount) > 0)
+		if (pool->uArray[index - 1] == s)
 		{
-			MoveMemory(&pool->aArray[index], &pool->aArray[index + pcount],
-			           (pool->aSize - index - pcount) * sizeof(wStream*));
+			pool->uArray[index - 1] = pool->uArray[--(pool->uSize)];
+			break;
 		}
-
-		pool->aSize -= pcount;
 	}
 }
 
@@ -193,7 +154,7 @@ static void StreamPool_ShiftAvailable(wStreamPool* pool, size_t index, INT64 cou
 wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 {
 	size_t index;
-	SSIZE_T foundIndex;
+	size_t x;
 	wStream* s = NULL;
 
 	StreamPool_Lock(pool);
@@ -201,37 +162,46 @@ wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 	if (size == 0)
 		size = pool->defaultSize;
 
-	foundIndex = -1;
+	/* The smallest size class guaranteed to fit, or the one just above it */
+	index = StreamPool_BucketIndex(size);
+	if ((index < STREAM_POOL_BUCKETS - 1) && (((size_t)1 << index) < size))
+		index++;
 
-	for (index = 0; index < pool->aSize; index++)
+	for (x = index; (x < STREAM_POOL_BUCKETS) && (x <= index + 1); x++)
 	{
-		s = pool->aArray[index];
+		wStreamPoolBucket* bucket = &pool->buckets[x];
 
-		if (Stream_Capacity(s) >= size)
+		if ((bucket->size > 0) && (Stream_Capacity(bucket->array[bucket->size - 1]) >= size))
 		{
-			foundIndex = index;
+			s = bucket->array[--(bucket->size)];
+			pool->aSize--;
 			break;
 		}
 	}
 
-	if (foundIndex < 0)
+	if (s)
 	{
-		s = Stream_New(NULL, size);
-		if (!s)
-			goto out_fail;
+		pool->hits++;
+		Stream_SetPosition(s, 0);
+		Stream_SetLength(s, Stream_Capacity(s));
 	}
 	else
 	{
-		Stream_SetPosition(s, 0);
-		Stream_SetLength(s, Stream_Capacity(s));
-		StreamPool_ShiftAvailable(pool, foundIndex, -1);
+		/* Round up to the size class so the stream can be reused for any size within it */
+		const size_t capacity = (index < STREAM_POOL_BUCKETS - 1) ? ((size_t)1 << index) : size;
+
+		pool->misses++;
+		s = Stream_New(NULL, capacity);
+		if (!s)
+			goto out_fail;
 	}
 
-	if (s)
+	s->pool = pool;
+	s->count = 1;
+	if (!StreamPool_AddUsed(pool, s))
 	{
-		s->pool = pool;
-		s->count = 1;
-		StreamPool_AddUsed(pool, s);
+		Stream_Free(s, TRUE);
+		s = NULL;
 	}
 
 out_fail:
@@ -246,18 +216,26 @@ out_fail:
 
 void StreamPool_Return(wStreamPool* pool, wStream* s)
 {
+	wStreamPoolBucket* bucket;
+
 	WINPR_ASSERT(pool);
 	if (!s)
 		return;
 
 	StreamPool_Lock(pool);
 
-	StreamPool_EnsureCapacity(pool, 1, FALSE);
+	Stream_EnsureValidity(s);
+	StreamPool_RemoveUsed(pool, s);
+
+	/* The user might have grown the stream, file it by its current capacity */
+	bucket = &pool->buckets[StreamPool_BucketIndex(Stream_Capacity(s))];
+	if (StreamPool_EnsureCapacity(&bucket->array, &bucket->capacity, bucket->size))
 	{
-		Stream_EnsureValidity(s);
-		pool->aArray[(pool->aSize)++] = s;
-		StreamPool_RemoveUsed(pool, s);
+		bucket->array[(bucket->size)++] = s;
+		pool->aSize++;
 	}
+	else
+		Stream_Free(s, TRUE);
 
 	StreamPool_Unlock(pool);
 }
@@ -270,11 +248,7 @@ void Stream_AddRef(wStream* s)
 {
 	WINPR_ASSERT(s);
 	if (s->pool)
-	{
-		StreamPool_Lock(s->pool);
-		s->count++;
-		StreamPool_Unlock(s->pool);
-	}
+		InterlockedIncrement((volatile LONG*)&s->count);
 }
 
 /**
@@ -283,16 +257,10 @@ void Stream_AddRef(wStream* s)
 
 void Stream_Release(wStream* s)
 {
-	DWORD count;
-
 	WINPR_ASSERT(s);
 	if (s->pool)
 	{
-		StreamPool_Lock(s->pool);
-		count = --(s->count);
-		StreamPool_Unlock(s->pool);
-
-		if (count == 0)
+		if (InterlockedDecrement((volatile LONG*)&s->count) == 0)
 			StreamPool_Return(s->pool, s);
 	}
 }
@@ -331,13 +299,21 @@ wStream* StreamPool_Find(wStreamPool* pool, BYTE* ptr)
 
 void StreamPool_Clear(wStreamPool* pool)
 {
+	size_t x;
+
 	StreamPool_Lock(pool);
 
-	while (pool->aSize > 0)
+	for (x = 0; x < STREAM_POOL_BUCKETS; x++)
 	{
-		(pool->aSize)--;
-		Stream_Free(pool->aArray[pool->aSize], TRUE);
+		wStreamPoolBucket* bucket = &pool->buckets[x];
+
+		while (bucket->size > 0)
+		{
+			(bucket->size)--;
+			Stream_Free(bucket->array[bucket->size], TRUE);
+		}
 	}
+	pool->aSize = 0;
 
 	while (pool->uSize > 0)
 	{
@@ -363,12 +339,10 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 		pool->synchronized = synchronized;
 		pool->defaultSize = defaultSize;
 
-		if (!StreamPool_EnsureCapacity(pool, 32, FALSE))
-			goto fail;
-		if (!StreamPool_EnsureCapacity(pool, 32, TRUE))
-			goto fail;
-
 		InitializeCriticalSectionAndSpinCount(&pool->lock, 4000);
+
+		if (!StreamPool_EnsureCapacity(&pool->uArray, &pool->uCapacity, 0))
+			goto fail;
 	}
 
 	return pool;
@@ -381,11 +355,14 @@ void StreamPool_Free(wStreamPool* pool)
 {
 	if (pool)
 	{
+		size_t x;
+
 		StreamPool_Clear(pool);
 
 		DeleteCriticalSection(&pool->lock);
 
-		free(pool->aArray);
+		for (x = 0; x < STREAM_POOL_BUCKETS; x++)
+			free(pool->buckets[x].array);
 		free(pool->uArray);
 
 		free(pool);
@@ -394,13 +371,22 @@ void StreamPool_Free(wStreamPool* pool)
 
 char* StreamPool_GetStatistics(wStreamPool* pool, char* buffer, size_t size)
 {
+	size_t x;
+	size_t aCapacity = 0;
+
 	WINPR_ASSERT(pool);
 
 	if (!buffer || (size < 1))
 		return NULL;
+
+	StreamPool_Lock(pool);
+	for (x = 0; x < STREAM_POOL_BUCKETS; x++)
+		aCapacity += pool->buckets[x].capacity;
 	_snprintf(buffer, size - 1,
-	          "aSize    =%" PRIuz ", uSize    =%" PRIuz "aCapacity=%" PRIuz ", uCapacity=%" PRIuz,
-	          pool->aSize, pool->uSize, pool->aCapacity, pool->uCapacity);
+	          "aSize    =%" PRIuz ", uSize    =%" PRIuz ", aCapacity=%" PRIuz
+	          ", uCapacity=%" PRIuz ", hits     =%" PRIuz ", misses   =%" PRIuz,
+	          pool->aSize, pool->uSize, aCapacity, pool->uCapacity, pool->hits, pool->misses);
+	StreamPool_Unlock(pool);
 	buffer[size - 1] = '\0';
 	return buffer;
 }
@@ -30,9 +30,16 @@
 #include "lodepng/lodepng.h"
 #include <winpr/stream.h>
 
+#if defined(WITH_ZLIB)
+#include <zlib.h>
+#endif
+
 #include "../log.h"
 #define TAG WINPR_TAG("utils.image")
 
+/* larger images are encoded for speed, e.g. screenshots on the clipboard */
+#define WINPR_IMAGE_PNG_FAST_PIXELS (512 * 512)
+
 static BOOL writeBitmapFileHeader(wStream* s, const WINPR_BITMAP_FILE_HEADER* bf)
 {
 	if (!Stream_EnsureRemainingCapacity(s, sizeof(WINPR_BITMAP_FILE_HEADER)))
@@ -180,6 +187,216 @@ fail:
 	return ret;
 }
 
+static void* winpr_bitmap_write_buffer(const wImage* image, size_t* size)
+{
+	BYTE* data;
+	BYTE* header;
+	const size_t imgSize = (size_t)image->width * image->height * (image->bitsPerPixel / 8);
+
+	header = winpr_bitmap_construct_header(image->width, image->height, image->bitsPerPixel);
+	if (!header)
+		return NULL;
+
+	data = realloc(header, WINPR_IMAGE_BMP_HEADER_LEN + imgSize);
+	if (!data)
+	{
+		free(header);
+		return NULL;
+	}
+
+	CopyMemory(&data[WINPR_IMAGE_BMP_HEADER_LEN], image->data, imgSize);
+	*size = WINPR_IMAGE_BMP_HEADER_LEN + imgSize;
+	return data;
+}
+
+#if defined(WITH_ZLIB)
+static unsigned winpr_image_png_zlib(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                     size_t insize, const LodePNGCompressSettings* settings)
+{
+	BYTE* data;
+	uLongf size;
+	const int* level = (const int*)settings->custom_context;
+
+	if ((uLong)insize != insize)
+		return 1;
+
+	size = compressBound((uLong)insize);
+	data = malloc(size);
+
+	if (!data)
+		return 83; /* lodepng: memory allocation failed */
+
+	if (compress2(data, &size, in, (uLong)insize, *level) != Z_OK)
+	{
+		free(data);
+		return 1;
+	}
+
+	*out = data;
+	*outsize = size;
+	return 0;
+}
+#endif
+
+/**
+ * Picks None, Sub or Up for each row from every fourth pixel, a cheap stand-in for the MINSUM
+ * heuristic of lodepng, which runs all five filters over every byte.
+ */
+static void winpr_image_png_choose_filters(const BYTE* data, UINT32 width, UINT32 height,
+                                           size_t bpp, BYTE* filters)
+{
+	UINT32 y;
+	const size_t linebytes = width * bpp;
+
+	for (y = 0; y < height; y++)
+	{
+		size_t x, c;
+		size_t sum[3] = { 0 };
+		const BYTE* line = &data[y * linebytes];
+		const BYTE* prev = (y > 0) ? &data[(y - 1) * linebytes] : NULL;
+
+		for (x = bpp; x < linebytes; x += 4 * bpp)
+		{
+			for (c = 0; (c < bpp) && (x + c < linebytes); c++)
+			{
+				const BYTE v = line[x + c];
+				const BYTE up = prev ? prev[x + c] : 0;
+
+				sum[0] += (size_t)abs((INT8)v);
+				sum[1] += (size_t)abs((INT8)(v - line[x + c - bpp]));
+				sum[2] += (size_t)abs((INT8)(v - up));
+			}
+		}
+
+		filters[y] = 0;
+		if (sum[1] < sum[filters[y]])
+			filters[y] = 1;
+		if (sum[2] < sum[filters[y]])
+			filters[y] = 2;
+	}
+}
+
+static BOOL winpr_image_is_opaque(const BYTE* data, UINT32 width, UINT32 height)
+{
+	size_t x;
+	const size_t count = (size_t)width * height;
+
+	for (x = 0; x < count; x++)
+	{
+		if (data[x * 4 + 3] != 0xFF)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void* winpr_image_png_write_buffer(const wImage* image, size_t* size)
+{
+	unsigned error;
+	LodePNGState state;
+	BYTE* out = NULL;
+	BYTE* packed = NULL;
+	BYTE* filters = NULL;
+	size_t outsize = 0;
+	const BYTE* data = image->data;
+	const size_t bpp = (image->bitsPerPixel == 24) ? 3 : 4;
+	const size_t linebytes = image->width * bpp;
+	const BOOL fast = ((size_t)image->width * image->height) > WINPR_IMAGE_PNG_FAST_PIXELS;
+#if defined(WITH_ZLIB)
+	int level = fast ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION;
+#endif
+
+	if (!data || (image->width == 0) || (image->height == 0))
+		return NULL;
+
+	/* lodepng takes the rows without padding */
+	if (image->scanline > linebytes)
+	{
+		UINT32 y;
+
+		packed = malloc(linebytes * image->height);
+		if (!packed)
+			return NULL;
+
+		for (y = 0; y < image->height; y++)
+			CopyMemory(&packed[y * linebytes], &image->data[y * image->scanline], linebytes);
+
+		data = packed;
+	}
+
+	lodepng_state_init(&state);
+	state.info_raw.colortype = (bpp == 3) ? LCT_RGB : LCT_RGBA;
+	state.info_raw.bitdepth = 8;
+#if defined(WITH_ZLIB)
+	state.encoder.zlibsettings.custom_zlib = winpr_image_png_zlib;
+	state.encoder.zlibsettings.custom_context = &level;
+#endif
+
+	/* auto_convert counts the colors of every pixel and MINSUM filters every row five times,
+	 * both are left to small images where they pay off */
+	if (fast)
+	{
+		filters = malloc(image->height);
+		if (!filters)
+			goto fail;
+
+		winpr_image_png_choose_filters(data, image->width, image->height, bpp, filters);
+
+		state.encoder.auto_convert = 0;
+		state.encoder.filter_palette_zero = 0;
+		state.encoder.filter_strategy = LFS_PREDEFINED;
+		state.encoder.predefined_filters = filters;
+		state.info_png.color.colortype = state.info_raw.colortype;
+		state.info_png.color.bitdepth = 8;
+
+		if ((bpp == 4) && winpr_image_is_opaque(data, image->width, image->height))
+			state.info_png.color.colortype = LCT_RGB;
+
+#if !defined(WITH_ZLIB)
+		state.encoder.zlibsettings.windowsize = 512;
+		state.encoder.zlibsettings.nicematch = 32;
+		state.encoder.zlibsettings.lazymatching = 0;
+#endif
+	}
+
+	error = lodepng_encode(&out, &outsize, data, image->width, image->height, &state);
+
+	if (error)
+	{
+		WLog_ERR(TAG, "PNG encoding failed: %s", lodepng_error_text(error));
+		free(out);
+		out = NULL;
+	}
+	else
+		*size = outsize;
+
+fail:
+	lodepng_state_cleanup(&state);
+	free(filters);
+	free(packed);
+	return out;
+}
+
+void* winpr_image_write_buffer(wImage* image, UINT32 format, size_t* size)
+{
+	if (!image || !size)
+		return NULL;
+
+	*size = 0;
+
+	switch (format)
+	{
+		case WINPR_IMAGE_BITMAP:
+			return winpr_bitmap_write_buffer(image, size);
+
+		case WINPR_IMAGE_PNG:
+			return winpr_image_png_write_buffer(image, size);
+
+		default:
+			return NULL;
+	}
+}
+
 int winpr_image_write(wImage* image, const char* filename)
 {
 	int status = -1;
@@ -191,9 +408,13 @@ int winpr_image_write(wImage* image, const char* filename)
 	}
 	else
 	{
-		unsigned lodepng_status;
-		lodepng_status = lodepng_encode32_file(filename, image->data, image->width, image->height);
-		status = (lodepng_status) ? -1 : 1;
+		size_t size = 0;
+		BYTE* data = winpr_image_png_write_buffer(image, &size);
+
+		if (data && (lodepng_save_file(data, size, filename) == 0))
+			status = 1;
+
+		free(data);
 	}
 
 	return status;
@@ -22,12 +22,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <winpr/wtypes.h>
 #include <winpr/crt.h>
 #include <winpr/sam.h>
 #include <winpr/print.h>
 #include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
 
 #include "../log.h"
 
@@ -42,6 +48,24 @@
 #endif
 #define TAG WINPR_TAG("utils")
 
+#ifdef _WIN32
+#define winpr_sam_fstat(fp, st) _fstat64(_fileno(fp), st)
+typedef struct _stat64 winpr_sam_stat_t;
+#else
+#define winpr_sam_fstat(fp, st) fstat(fileno(fp), st)
+typedef struct stat winpr_sam_stat_t;
+#endif
+
+#if defined(_WIN32)
+#define winpr_sam_mtime_nsec(st) 0
+#elif defined(__APPLE__)
+#define winpr_sam_mtime_nsec(st) ((st)->st_mtimespec.tv_nsec)
+#elif defined(ANDROID)
+#define winpr_sam_mtime_nsec(st) ((st)->st_mtimensec)
+#else
+#define winpr_sam_mtime_nsec(st) ((st)->st_mtim.tv_nsec)
+#endif
+
 struct winpr_sam
 {
 	FILE* fp;
@@ -49,36 +73,61 @@ struct winpr_sam
 	char* buffer;
 	char* context;
 	BOOL readOnly;
+	char* filename;
 };
 
-static WINPR_SAM_ENTRY* SamEntryFromDataA(LPCSTR User, DWORD UserLength, LPCSTR Domain,
-                                          DWORD DomainLength)
+/* Parsed SAM file, rebuilt when the file was modified or replaced */
+typedef struct
 {
-	WINPR_SAM_ENTRY* entry = calloc(1, sizeof(WINPR_SAM_ENTRY));
-	if (!entry)
-		return NULL;
-	entry->User = _strdup(User);
-	entry->UserLength = UserLength;
-	entry->Domain = _strdup(Domain);
-	entry->DomainLength = DomainLength;
-	return entry;
-}
-
-static BOOL SamAreEntriesEqual(const WINPR_SAM_ENTRY* a, const WINPR_SAM_ENTRY* b)
+	INT64 mtime;
+	INT64 mtimeNsec;
+	INT64 ctime;
+	UINT64 inode;
+	INT64 size;
+	INT64 built; /* when the file was parsed */
+	wHashTable* entries; /* "User:Domain" -> WINPR_SAM_ENTRY*, first entry in the file wins */
+} WINPR_SAM_INDEX;
+
+static INIT_ONCE sam_index_once = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION sam_index_lock;
+static wHashTable* sam_indexes = NULL; /* filename -> WINPR_SAM_INDEX* */
+
+static BOOL SamEntryMatches(const WINPR_SAM_ENTRY* entry, LPCSTR User, UINT32 UserLength,
+                            LPCSTR Domain, UINT32 DomainLength)
 {
-	if (!a || !b)
+	if (!entry)
 		return FALSE;
-	if (a->UserLength != b->UserLength)
+	if (entry->UserLength != UserLength)
 		return FALSE;
-	if (a->DomainLength != b->DomainLength)
+	if (entry->DomainLength != DomainLength)
 		return FALSE;
-	if (strncmp(a->User, b->User, a->UserLength) != 0)
+	if ((UserLength > 0) && (strncmp(entry->User, User, UserLength) != 0))
 		return FALSE;
-	if (strncmp(a->Domain, b->Domain, a->DomainLength) != 0)
+	if ((DomainLength > 0) && (strncmp(entry->Domain, Domain, DomainLength) != 0))
 		return FALSE;
 	return TRUE;
 }
 
+/* User and domain can not contain ':', the key is unique for every line of the file */
+static char* SamIndexKey(LPCSTR User, UINT32 UserLength, LPCSTR Domain, UINT32 DomainLength)
+{
+	char* key = (char*)malloc((size_t)UserLength + DomainLength + 2);
+
+	if (!key)
+		return NULL;
+
+	if (UserLength > 0)
+		memcpy(key, User, UserLength);
+
+	key[UserLength] = ':';
+
+	if (DomainLength > 0)
+		memcpy(&key[UserLength + 1], Domain, DomainLength);
+
+	key[(size_t)UserLength + DomainLength + 1] = '\0';
+	return key;
+}
+
 WINPR_SAM* SamOpen(const char* filename, BOOL readOnly)
 {
 	FILE* fp = NULL;
@@ -109,6 +158,13 @@ WINPR_SAM* SamOpen(const char* filename, BOOL readOnly)
 
 		sam->readOnly = readOnly;
 		sam->fp = fp;
+		sam->filename = _strdup(filename);
+
+		if (!sam->filename)
+		{
+			SamClose(sam);
+			return NULL;
+		}
 	}
 	else
 	{
@@ -275,56 +331,236 @@ void SamResetEntry(WINPR_SAM_ENTRY* entry)
 	ZeroMemory(entry->NtHash, sizeof(entry->NtHash));
 }
 
-WINPR_SAM_ENTRY* SamLookupUserA(WINPR_SAM* sam, LPCSTR User, UINT32 UserLength, LPCSTR Domain,
-                                UINT32 DomainLength)
+static void SamIndexFreeEntry(void* entry)
 {
-	size_t length;
-	BOOL found = FALSE;
-	WINPR_SAM_ENTRY* search = SamEntryFromDataA(User, UserLength, Domain, DomainLength);
-	WINPR_SAM_ENTRY* entry = (WINPR_SAM_ENTRY*)calloc(1, sizeof(WINPR_SAM_ENTRY));
+	WINPR_SAM_ENTRY* sam_entry = (WINPR_SAM_ENTRY*)entry;
+
+	if (sam_entry)
+	{
+		SecureZeroMemory(sam_entry->LmHash, sizeof(sam_entry->LmHash));
+		SecureZeroMemory(sam_entry->NtHash, sizeof(sam_entry->NtHash));
+	}
+
+	SamFreeEntry(NULL, sam_entry);
+}
+
+static void SamIndexFree(void* index)
+{
+	WINPR_SAM_INDEX* sam_index = (WINPR_SAM_INDEX*)index;
+
+	if (sam_index)
+	{
+		HashTable_Free(sam_index->entries);
+		free(sam_index);
+	}
+}
+
+static BOOL CALLBACK SamIndexInit(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	wObject* obj;
+
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
 
-	if (!entry || !search)
+	if (!(sam_indexes = HashTable_New(FALSE)))
+		return FALSE;
+
+	if (!HashTable_SetupForStringData(sam_indexes, FALSE))
 		goto fail;
 
-	if (!SamLookupStart(sam))
+	obj = HashTable_ValueObject(sam_indexes);
+	obj->fnObjectFree = SamIndexFree;
+
+	if (!InitializeCriticalSectionAndSpinCount(&sam_index_lock, 4000))
 		goto fail;
 
+	return TRUE;
+fail:
+	HashTable_Free(sam_indexes);
+	sam_indexes = NULL;
+	return FALSE;
+}
+
+static WINPR_SAM_INDEX* SamIndexNew(WINPR_SAM* sam, const winpr_sam_stat_t* st)
+{
+	wObject* obj;
+	WINPR_SAM_INDEX* index = (WINPR_SAM_INDEX*)calloc(1, sizeof(WINPR_SAM_INDEX));
+
+	if (!index)
+		return NULL;
+
+	index->mtime = (INT64)st->st_mtime;
+	index->mtimeNsec = (INT64)winpr_sam_mtime_nsec(st);
+	index->ctime = (INT64)st->st_ctime;
+	index->inode = (UINT64)st->st_ino;
+	index->size = (INT64)st->st_size;
+	index->built = (INT64)time(NULL);
+
+	if (!(index->entries = HashTable_New(FALSE)))
+		goto fail;
+
+	if (!HashTable_SetupForStringData(index->entries, FALSE))
+		goto fail;
+
+	obj = HashTable_ValueObject(index->entries);
+	obj->fnObjectFree = SamIndexFreeEntry;
+
+	/* An empty file is a valid, empty database */
+	if (!SamLookupStart(sam))
+		return index;
+
 	while (sam->line != NULL)
 	{
-		length = strlen(sam->line);
+		WINPR_SAM_ENTRY* entry;
+		char* key;
 
-		if (length > 1)
+		if ((strlen(sam->line) <= 1) || (sam->line[0] == '#'))
 		{
-			if (sam->line[0] != '#')
-			{
-				if (!SamReadEntry(sam, entry))
-				{
-					goto out_fail;
-				}
-
-				if (SamAreEntriesEqual(entry, search))
-				{
-					found = 1;
-					break;
-				}
-			}
+			sam->line = strtok_s(NULL, "\n", &sam->context);
+			continue;
 		}
 
-		SamResetEntry(entry);
+		if (!(entry = (WINPR_SAM_ENTRY*)calloc(1, sizeof(WINPR_SAM_ENTRY))))
+			goto fail_lookup;
+
+		/* Lookups never went past a malformed line, keep it that way */
+		if (!SamReadEntry(sam, entry))
+		{
+			WLog_WARN(TAG, "Ignoring SAM entries after malformed line");
+			SamIndexFreeEntry(entry);
+			break;
+		}
+
+		key = SamIndexKey(entry->User, entry->UserLength, entry->Domain, entry->DomainLength);
+
+		if (!key || HashTable_Contains(index->entries, key))
+			SamIndexFreeEntry(entry);
+		else if (!HashTable_Insert(index->entries, key, entry))
+		{
+			SamIndexFreeEntry(entry);
+			free(key);
+			goto fail_lookup;
+		}
+
+		free(key);
 		sam->line = strtok_s(NULL, "\n", &sam->context);
 	}
 
-out_fail:
+	SamLookupFinish(sam);
+	return index;
+
+fail_lookup:
 	SamLookupFinish(sam);
 fail:
-	SamFreeEntry(sam, search);
+	SamIndexFree(index);
+	return NULL;
+}
+
+/**
+ * A rewrite of a line with the same length keeps the size, and file systems with coarse
+ * timestamps may keep the modification time. An index built within a second of the last
+ * modification is therefore not trusted.
+ */
+static BOOL SamIndexIsCurrent(const WINPR_SAM_INDEX* index, const winpr_sam_stat_t* st)
+{
+	return (index->mtime == (INT64)st->st_mtime) &&
+	       (index->mtimeNsec == (INT64)winpr_sam_mtime_nsec(st)) &&
+	       (index->ctime == (INT64)st->st_ctime) && (index->inode == (UINT64)st->st_ino) &&
+	       (index->size == (INT64)st->st_size) && (index->built > index->mtime + 1) &&
+	       (index->built > index->ctime + 1);
+}
 
-	if (!found)
+/* Returns the index of the file sam was opened from, sam_index_lock must be held */
+static WINPR_SAM_INDEX* SamIndexGet(WINPR_SAM* sam)
+{
+	winpr_sam_stat_t st = { 0 };
+	WINPR_SAM_INDEX* index;
+
+	if (!sam || !sam->fp || (winpr_sam_fstat(sam->fp, &st) != 0))
+		return NULL;
+
+	index = (WINPR_SAM_INDEX*)HashTable_GetItemValue(sam_indexes, sam->filename);
+
+	if (index && SamIndexIsCurrent(index, &st))
+		return index;
+
+	if (!(index = SamIndexNew(sam, &st)))
+		return NULL;
+
+	/* Replaces and frees an outdated index */
+	if (!HashTable_Insert(sam_indexes, sam->filename, index))
 	{
-		SamFreeEntry(sam, entry);
+		SamIndexFree(index);
 		return NULL;
 	}
 
+	return index;
+}
+
+static WINPR_SAM_ENTRY* SamCopyEntry(const WINPR_SAM_ENTRY* src)
+{
+	WINPR_SAM_ENTRY* entry = (WINPR_SAM_ENTRY*)calloc(1, sizeof(WINPR_SAM_ENTRY));
+
+	if (!entry)
+		return NULL;
+
+	*entry = *src;
+	entry->User = (LPSTR)malloc(src->UserLength + 1);
+	entry->Domain = NULL;
+
+	if (!entry->User)
+		goto fail;
+
+	memcpy(entry->User, src->User, src->UserLength + 1);
+
+	if (src->DomainLength > 0)
+	{
+		entry->Domain = (LPSTR)malloc(src->DomainLength + 1);
+
+		if (!entry->Domain)
+			goto fail;
+
+		memcpy(entry->Domain, src->Domain, src->DomainLength + 1);
+	}
+
+	return entry;
+fail:
+	free(entry->User);
+	free(entry);
+	return NULL;
+}
+
+WINPR_SAM_ENTRY* SamLookupUserA(WINPR_SAM* sam, LPCSTR User, UINT32 UserLength, LPCSTR Domain,
+                                UINT32 DomainLength)
+{
+	char* key;
+	WINPR_SAM_INDEX* index;
+	const WINPR_SAM_ENTRY* found;
+	WINPR_SAM_ENTRY* entry = NULL;
+
+	if (!sam || (!User && (UserLength > 0)) || (!Domain && (DomainLength > 0)))
+		return NULL;
+
+	if (!InitOnceExecuteOnce(&sam_index_once, SamIndexInit, NULL, NULL))
+		return NULL;
+
+	if (!(key = SamIndexKey(User, UserLength, Domain, DomainLength)))
+		return NULL;
+
+	EnterCriticalSection(&sam_index_lock);
+	index = SamIndexGet(sam);
+
+	if (index)
+	{
+		found = (const WINPR_SAM_ENTRY*)HashTable_GetItemValue(index->entries, key);
+
+		if (SamEntryMatches(found, User, UserLength, Domain, DomainLength))
+			entry = SamCopyEntry(found);
+	}
+
+	LeaveCriticalSection(&sam_index_lock);
+	free(key);
 	return entry;
 }
 
@@ -357,6 +593,7 @@ void SamClose(WINPR_SAM* sam)
 	if (sam != NULL)
 	{
 		fclose(sam->fp);
+		free(sam->filename);
 		free(sam);
 	}
 }
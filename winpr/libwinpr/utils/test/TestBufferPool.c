@@ -9,6 +9,8 @@ int TestBufferPool(int argc, char* argv[])
 	int BufferSize;
 	wBufferPool* pool;
 	BYTE* Buffers[10];
+	BYTE* Many[100];
+	size_t index;
 	int DefaultSize = 1234;
 
 	WINPR_UNUSED(argc);
@@ -62,6 +64,25 @@ int TestBufferPool(int argc, char* argv[])
 
 	BufferPool_Clear(pool);
 
+	/* grow the bookkeeping beyond its initial capacity of an aligned pool */
+	for (index = 0; index < ARRAYSIZE(Many); index++)
+	{
+		if (!(Many[index] = BufferPool_Take(pool, DefaultSize + index)))
+			return -1;
+	}
+
+	for (index = 0; index < ARRAYSIZE(Many); index++)
+	{
+		if (!BufferPool_Return(pool, Many[index]))
+			return -1;
+	}
+
+	if (BufferPool_GetPoolSize(pool) != 0)
+	{
+		printf("BufferPool_GetPoolSize failure: buffers still in use after return\n");
+		return -1;
+	}
+
 	BufferPool_Free(pool);
 
 	return 0;
@@ -429,6 +429,63 @@ out:
 	return retCode;
 }
 
+static BOOL foreachStop(const void* key, void* value, void* arg)
+{
+	WINPR_UNUSED(key);
+	WINPR_UNUSED(value);
+	WINPR_UNUSED(arg);
+	return FALSE;
+}
+
+static int test_hash_growth(void)
+{
+	int rc = -1;
+	size_t index;
+	wHashTable* table = HashTable_New(TRUE);
+
+	if (!table)
+		return -1;
+
+	/* small integer keys, all values differ only in the low bits */
+	for (index = 1; index <= 1000; index++)
+	{
+		if (!HashTable_Insert(table, (void*)index, (void*)(index * 2)))
+			goto fail;
+	}
+
+	if (HashTable_Count(table) != 1000)
+		goto fail;
+
+	for (index = 1; index <= 1000; index++)
+	{
+		if (HashTable_GetItemValue(table, (void*)index) != (void*)(index * 2))
+			goto fail;
+	}
+
+	/* an aborted foreach must not leave later removes deferred */
+	if (HashTable_Foreach(table, foreachStop, NULL))
+		goto fail;
+
+	if (!HashTable_Remove(table, (void*)1) || HashTable_Remove(table, (void*)1))
+		goto fail;
+
+	if ((HashTable_Count(table) != 999) || HashTable_Contains(table, (void*)1))
+		goto fail;
+
+	if (!HashTable_ContainsValue(table, (void*)4) || HashTable_ContainsValue(table, (void*)3))
+		goto fail;
+
+	HashTable_Clear(table);
+
+	if ((HashTable_Count(table) != 0) || HashTable_Contains(table, (void*)2))
+		goto fail;
+
+	rc = 0;
+fail:
+	HashTable_Free(table);
+	return rc;
+}
+
 int TestHashTable(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -442,5 +499,8 @@ int TestHashTable(int argc, char* argv[])
 
 	if (test_hash_foreach() < 0)
 		return 3;
+
+	if (test_hash_growth() < 0)
+		return 4;
 	return 0;
 }
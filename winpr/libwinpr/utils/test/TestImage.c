@@ -293,6 +293,54 @@ static int test_image_png_to_bmp(void)
 	return 0;
 }
 
+/* large enough for the fast encoder settings */
+static int test_image_png_buffer(BOOL opaque)
+{
+	int rc = -1;
+	size_t x, size = 0;
+	void* buffer = NULL;
+	wImage* image = winpr_image_new();
+	wImage* image2 = winpr_image_new();
+
+	if (!image || !image2)
+		goto cleanup;
+
+	image->type = WINPR_IMAGE_PNG;
+	image->width = 1024;
+	image->height = 600;
+	image->bitsPerPixel = 32;
+	image->bytesPerPixel = 4;
+	image->scanline = image->width * image->bytesPerPixel;
+	image->data = malloc((size_t)image->scanline * image->height);
+
+	if (!image->data)
+		goto cleanup;
+
+	for (x = 0; x < (size_t)image->width * image->height; x++)
+	{
+		BYTE* pixel = &image->data[x * 4];
+		pixel[0] = (BYTE)(x % image->width);
+		pixel[1] = (BYTE)(x / image->width);
+		pixel[2] = (BYTE)((x / 64) * 37);
+		pixel[3] = opaque ? 0xFF : (BYTE)(x * 3);
+	}
+
+	buffer = winpr_image_write_buffer(image, WINPR_IMAGE_PNG, &size);
+
+	if (!buffer || (winpr_image_read_buffer(image2, buffer, size) < 0))
+	{
+		fprintf(stderr, "Failed to encode and decode a PNG in memory!\n");
+		goto cleanup;
+	}
+
+	rc = img_compare(image, image2, TRUE);
+cleanup:
+	free(buffer);
+	winpr_image_free(image, TRUE);
+	winpr_image_free(image2, TRUE);
+	return rc;
+}
+
 int TestImage(int argc, char* argv[])
 {
 	int rc = test_image_png_to_bmp();
@@ -300,5 +348,11 @@ int TestImage(int argc, char* argv[])
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
+	if (rc == 0)
+		rc = test_image_png_buffer(TRUE);
+
+	if (rc == 0)
+		rc = test_image_png_buffer(FALSE);
+
 	return rc;
 }
@@ -24,6 +24,36 @@ static DWORD WINAPI message_queue_consumer_thread(LPVOID arg)
 	return 0;
 }
 
+static BOOL test_message_queue_batch(void)
+{
+	BOOL rc = FALSE;
+	size_t count;
+	wMessage messages[4];
+	wMessageQueue* queue;
+
+	if (!(queue = MessageQueue_New(NULL)))
+		return FALSE;
+
+	if (!MessageQueue_Post(queue, NULL, 1, NULL, NULL) ||
+	    !MessageQueue_Post(queue, NULL, 2, NULL, NULL) || !MessageQueue_PostQuit(queue, 0))
+		goto fail;
+
+	/* a batch ends with the quit message, anything after it stays queued */
+	count = MessageQueue_GetBatch(queue, messages, ARRAYSIZE(messages));
+
+	if ((count != 3) || (messages[0].id != 1) || (messages[1].id != 2) ||
+	    (messages[2].id != WMQ_QUIT))
+		goto fail;
+
+	if (WaitForSingleObject(MessageQueue_Event(queue), 0) != WAIT_TIMEOUT)
+		goto fail;
+
+	rc = MessageQueue_GetBatch(queue, messages, ARRAYSIZE(messages)) == 0;
+fail:
+	MessageQueue_Free(queue);
+	return rc;
+}
+
 int TestMessageQueue(int argc, char* argv[])
 {
 	HANDLE thread;
@@ -32,6 +62,12 @@ int TestMessageQueue(int argc, char* argv[])
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
+	if (!test_message_queue_batch())
+	{
+		printf("MessageQueue_GetBatch failed\n");
+		return 1;
+	}
+
 	if (!(queue = MessageQueue_New(NULL)))
 	{
 		printf("failed to create message queue\n");
@@ -25,6 +25,17 @@ static void MouseButtonEventHandler(void* context, const MouseButtonEventArgs* e
 	printf("MouseButtonEvent: x: %d y: %d flags: %d button: %d\n", e->x, e->y, e->flags, e->button);
 }
 
+static wPubSub* test_node = NULL;
+
+static void MouseMotionOnceEventHandler(void* context, const MouseMotionEventArgs* e)
+{
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(e);
+
+	/* handlers run on a snapshot and may unsubscribe while the event is raised */
+	PubSub_UnsubscribeMouseMotion(test_node, MouseMotionOnceEventHandler);
+}
+
 static wEventType Node_Events[] = { DEFINE_EVENT_ENTRY(MouseMotion),
 	                                DEFINE_EVENT_ENTRY(MouseButton) };
 
@@ -32,6 +43,7 @@ static wEventType Node_Events[] = { DEFINE_EVENT_ENTRY(MouseMotion),
 
 int TestPubSub(int argc, char* argv[])
 {
+	int id;
 	wPubSub* node;
 
 	WINPR_UNUSED(argc);
@@ -67,7 +79,31 @@ int TestPubSub(int argc, char* argv[])
 		PubSub_OnMouseButton(node, NULL, &e);
 	}
 
+	{
+		MouseMotionEventArgs e = { 0 };
+
+		id = PubSub_GetEventId(node, "MouseMotion");
+		if ((id < 0) || (PubSub_GetEventId(node, "Unknown") != -1))
+			goto fail;
+
+		test_node = node;
+		if (PubSub_SubscribeMouseMotion(node, MouseMotionOnceEventHandler) != 0)
+			goto fail;
+
+		if (PubSub_OnEventId(node, id, NULL, &e.e) != 2)
+			goto fail;
+
+		if (PubSub_OnEventId(node, id, NULL, &e.e) != 1)
+			goto fail;
+
+		if (PubSub_OnEvent(node, "Unknown", NULL, &e.e) != -1)
+			goto fail;
+	}
+
 	PubSub_Free(node);
 
 	return 0;
+fail:
+	PubSub_Free(node);
+	return -1;
 }
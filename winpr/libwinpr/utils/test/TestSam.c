@@ -0,0 +1,139 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/sam.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+
+static const char TEST_SAM_01[] = "# comment\n"
+                                  "alice::00000000000000000000000000000000:"
+                                  "11111111111111111111111111111111:::\n"
+                                  "bob:DOMAIN::22222222222222222222222222222222:::\n"
+                                  "alice::33333333333333333333333333333333:"
+                                  "33333333333333333333333333333333:::\n";
+
+/* Different size than the first file, the index must be rebuilt */
+static const char TEST_SAM_02[] = "carol::44444444444444444444444444444444:"
+                                  "55555555555555555555555555555555:::\n"
+                                  "bob:DOMAIN::66666666666666666666666666666666:::\n"
+                                  "\n";
+
+/* Same size as the second file, as when a password changes, usually within the same second */
+static const char TEST_SAM_03[] = "carol::44444444444444444444444444444444:"
+                                  "77777777777777777777777777777777:::\n"
+                                  "bob:DOMAIN::66666666666666666666666666666666:::\n"
+                                  "\n";
+
+static BOOL write_sam(const char* path, const char* data)
+{
+	size_t length = strlen(data);
+	FILE* fp = winpr_fopen(path, "w");
+
+	if (!fp)
+		return FALSE;
+
+	if (fwrite(data, 1, length, fp) != length)
+	{
+		fclose(fp);
+		return FALSE;
+	}
+
+	return fclose(fp) == 0;
+}
+
+static BOOL test_lookup(const char* path, const char* user, const char* domain, BYTE nthash)
+{
+	BOOL rc = FALSE;
+	size_t index;
+	WINPR_SAM_ENTRY* entry = NULL;
+	WINPR_SAM* sam = SamOpen(path, TRUE);
+
+	if (!sam)
+		return FALSE;
+
+	entry = SamLookupUserA(sam, user, (UINT32)strlen(user), domain,
+	                       domain ? (UINT32)strlen(domain) : 0);
+
+	if (nthash == 0)
+	{
+		rc = (entry == NULL);
+		goto fail;
+	}
+
+	if (!entry || (strcmp(entry->User, user) != 0))
+		goto fail;
+
+	for (index = 0; index < sizeof(entry->NtHash); index++)
+	{
+		if (entry->NtHash[index] != nthash)
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		fprintf(stderr, "lookup of %s\\%s failed\n", domain ? domain : "", user);
+
+	SamFreeEntry(sam, entry);
+	SamClose(sam);
+	return rc;
+}
+
+int TestSam(int argc, char* argv[])
+{
+	int rc = -1;
+	char* tmp_path = NULL;
+	char* sam_file = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+		goto fail;
+
+	if (!(sam_file = GetCombinedPath(tmp_path, "TestSam.sam")))
+		goto fail;
+
+	if (!write_sam(sam_file, TEST_SAM_01))
+		goto fail;
+
+	/* The first entry of a user wins */
+	if (!test_lookup(sam_file, "alice", NULL, 0x11))
+		goto fail;
+
+	if (!test_lookup(sam_file, "bob", "DOMAIN", 0x22))
+		goto fail;
+
+	if (!test_lookup(sam_file, "bob", NULL, 0))
+		goto fail;
+
+	if (!test_lookup(sam_file, "carol", NULL, 0))
+		goto fail;
+
+	if (!write_sam(sam_file, TEST_SAM_02))
+		goto fail;
+
+	if (!test_lookup(sam_file, "alice", NULL, 0))
+		goto fail;
+
+	if (!test_lookup(sam_file, "bob", "DOMAIN", 0x66))
+		goto fail;
+
+	if (!test_lookup(sam_file, "carol", NULL, 0x55))
+		goto fail;
+
+	if (!write_sam(sam_file, TEST_SAM_03))
+		goto fail;
+
+	if (!test_lookup(sam_file, "carol", NULL, 0x77))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (sam_file)
+		winpr_DeleteFile(sam_file);
+
+	free(sam_file);
+	free(tmp_path);
+	return rc;
+}
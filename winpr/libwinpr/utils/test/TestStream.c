@@ -315,6 +315,44 @@ static BOOL TestStream_Reading(void)
 	return result;
 }
 
+static BOOL TestStream_ReadArrays(void)
+{
+	BYTE src[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A };
+	UINT16 v16[3] = { 0 };
+	UINT32 v32[2] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, src, sizeof(src));
+
+	if (!s)
+		return FALSE;
+
+	if (!Stream_CheckRequiredLength(s, sizeof(src)) ||
+	    Stream_CheckRequiredLength(s, sizeof(src) + 1))
+		return FALSE;
+
+	if (Stream_CheckRequiredLengthOfSize(s, SIZE_MAX / 2 + 1, 2))
+		return FALSE;
+
+	if (!Stream_CheckRequiredLengthOfSize(s, ARRAYSIZE(v16), sizeof(UINT16)))
+		return FALSE;
+
+	Stream_Read_UINT16_Array(s, v16, ARRAYSIZE(v16));
+
+	if ((v16[0] != 0x0201) || (v16[1] != 0x0403) || (v16[2] != 0x0605))
+		return FALSE;
+
+	if (Stream_CheckRequiredLengthOfSize(s, ARRAYSIZE(v32), sizeof(UINT32)))
+		return FALSE;
+
+	Stream_SetPosition(s, 2);
+	Stream_Read_UINT32_Array(s, v32, ARRAYSIZE(v32));
+
+	if ((v32[0] != 0x06050403) || (v32[1] != 0x0A090807))
+		return FALSE;
+
+	return Stream_GetRemainingLength(s) == 0;
+}
+
 static BOOL TestStream_Write(void)
 {
 	BOOL rc = FALSE;
@@ -679,5 +717,8 @@ int TestStream(int argc, char* argv[])
 	if (!TestStream_Static())
 		return 12;
 
+	if (!TestStream_ReadArrays())
+		return 13;
+
 	return 0;
 }
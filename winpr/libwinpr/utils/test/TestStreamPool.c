@@ -7,6 +7,7 @@
 
 int TestStreamPool(int argc, char* argv[])
 {
+	int rc = -1;
 	wStream* s[5];
 	wStreamPool* pool;
 	char buffer[8192];
@@ -73,7 +74,34 @@ int TestStreamPool(int argc, char* argv[])
 
 	printf("%s\n", StreamPool_GetStatistics(pool, buffer, sizeof(buffer)));
 
+	Stream_Release(s[2]);
+	Stream_Release(s[3]);
+	Stream_Release(s[4]);
+
+	/* a cached stream is only handed out if it is large enough */
+	s[0] = StreamPool_Take(pool, BUFFER_SIZE * 2 + 1);
+	if (!s[0] || (Stream_Capacity(s[0]) < BUFFER_SIZE * 2 + 1))
+		goto fail;
+
+	Stream_Release(s[0]);
+
+	/* the size class is rounded up, so a similar request reuses the stream */
+	s[1] = StreamPool_Take(pool, BUFFER_SIZE * 3);
+	if (s[1] != s[0])
+		goto fail;
+
+	s[2] = StreamPool_Take(pool, BUFFER_SIZE);
+	if (!s[2] || (s[2] == s[1]) || (Stream_Capacity(s[2]) < BUFFER_SIZE))
+		goto fail;
+
+	Stream_Release(s[1]);
+	Stream_Release(s[2]);
+
+	printf("%s\n", StreamPool_GetStatistics(pool, buffer, sizeof(buffer)));
+
+	rc = 0;
+fail:
 	StreamPool_Free(pool);
 
-	return 0;
+	return rc;
 }
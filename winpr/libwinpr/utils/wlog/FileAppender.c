@@ -26,6 +26,12 @@
 #include <winpr/environment.h>
 #include <winpr/file.h>
 #include <winpr/path.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+/* lines queued for the writer thread before new ones are dropped */
+#define WLOG_FILE_APPENDER_MAX_PENDING 4096
 
 typedef struct
 {
@@ -35,8 +41,123 @@ typedef struct
 	char* FilePath;
 	char* FullFileName;
 	FILE* FileDescriptor;
+
+	/* asynchronous mode, lines are formatted by the caller and written by Writer */
+	BOOL Async;
+	HANDLE Writer;
+	wMessageQueue* Pending;
+	volatile LONG Dropped;
 } wLogFileAppender;
 
+static void WLog_FileAppender_FreeLine(void* obj)
+{
+	wMessage* msg = (wMessage*)obj;
+
+	if (msg)
+		free(msg->wParam);
+}
+
+static DWORD WINAPI WLog_FileAppender_WriterThread(LPVOID arg)
+{
+	BOOL quit = FALSE;
+	wLogFileAppender* appender = (wLogFileAppender*)arg;
+	FILE* fp = appender->FileDescriptor;
+
+	while (!quit && MessageQueue_Wait(appender->Pending))
+	{
+		size_t index;
+		wMessage lines[64];
+		const size_t count = MessageQueue_GetBatch(appender->Pending, lines, ARRAYSIZE(lines));
+		const LONG dropped = InterlockedExchange(&appender->Dropped, 0);
+
+		for (index = 0; index < count; index++)
+		{
+			if (lines[index].id == WMQ_QUIT)
+			{
+				quit = TRUE;
+				break;
+			}
+
+			fputs((const char*)lines[index].wParam, fp);
+			free(lines[index].wParam);
+		}
+
+		if (dropped > 0)
+			fprintf(fp, "[wlog] %" PRId32 " messages dropped, writer could not keep up\n", dropped);
+
+		/* one flush per batch instead of one per message */
+		fflush(fp);
+	}
+
+	return 0;
+}
+
+static BOOL WLog_FileAppender_StartWriter(wLogFileAppender* appender)
+{
+	wObject obj = { 0 };
+
+	obj.fnObjectFree = WLog_FileAppender_FreeLine;
+	appender->Dropped = 0;
+	appender->Pending = MessageQueue_New(&obj);
+
+	if (!appender->Pending)
+		return FALSE;
+
+	appender->Writer = CreateThread(NULL, 0, WLog_FileAppender_WriterThread, appender, 0, NULL);
+
+	if (!appender->Writer)
+	{
+		MessageQueue_Free(appender->Pending);
+		appender->Pending = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void WLog_FileAppender_StopWriter(wLogFileAppender* appender)
+{
+	if (appender->Writer)
+	{
+		/* everything queued before the quit message is still written */
+		MessageQueue_PostQuit(appender->Pending, 0);
+		WaitForSingleObject(appender->Writer, INFINITE);
+		CloseHandle(appender->Writer);
+		appender->Writer = NULL;
+	}
+
+	MessageQueue_Free(appender->Pending);
+	appender->Pending = NULL;
+}
+
+static BOOL WLog_FileAppender_QueueMessage(wLogFileAppender* appender, const wLogMessage* message)
+{
+	char* line;
+	size_t length;
+
+	if (MessageQueue_Size(appender->Pending) >= WLOG_FILE_APPENDER_MAX_PENDING)
+	{
+		InterlockedIncrement(&appender->Dropped);
+		return TRUE;
+	}
+
+	length = strlen(message->PrefixString) + strlen(message->TextString) + 2;
+	line = (char*)malloc(length);
+
+	if (!line)
+		return FALSE;
+
+	sprintf_s(line, length, "%s%s\n", message->PrefixString, message->TextString);
+
+	if (!MessageQueue_Post(appender->Pending, NULL, 0, line, NULL))
+	{
+		free(line);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static BOOL WLog_FileAppender_SetOutputFileName(wLogFileAppender* appender, const char* filename)
 {
 	appender->FileName = _strdup(filename);
@@ -106,6 +227,13 @@ static BOOL WLog_FileAppender_Open(wLog* log, wLogAppender* appender)
 	if (!fileAppender->FileDescriptor)
 		return FALSE;
 
+	if (fileAppender->Async && !WLog_FileAppender_StartWriter(fileAppender))
+	{
+		fclose(fileAppender->FileDescriptor);
+		fileAppender->FileDescriptor = NULL;
+		return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -121,6 +249,7 @@ static BOOL WLog_FileAppender_Close(wLog* log, wLogAppender* appender)
 	if (!fileAppender->FileDescriptor)
 		return TRUE;
 
+	WLog_FileAppender_StopWriter(fileAppender);
 	fclose(fileAppender->FileDescriptor);
 	fileAppender->FileDescriptor = NULL;
 	return TRUE;
@@ -141,8 +270,13 @@ static BOOL WLog_FileAppender_WriteMessage(wLog* log, wLogAppender* appender, wL
 	if (!fp)
 		return FALSE;
 
+	/* The prefix is always built here, it may contain the calling thread id and time */
 	message->PrefixString = prefix;
 	WLog_Layout_GetMessagePrefix(log, appender->Layout, message);
+
+	if (fileAppender->Pending)
+		return WLog_FileAppender_QueueMessage(fileAppender, message);
+
 	fprintf(fp, "%s%s\n", message->PrefixString, message->TextString);
 	fflush(fp); /* slow! */
 	return TRUE;
@@ -197,6 +331,12 @@ static BOOL WLog_FileAppender_Set(wLogAppender* appender, const char* setting, v
 		return WLog_FileAppender_SetOutputFileName(fileAppender, (const char*)value);
 	else if (!strcmp("outputfilepath", setting))
 		return WLog_FileAppender_SetOutputFilePath(fileAppender, (const char*)value);
+	else if (!strcmp("async", setting))
+	{
+		/* only takes effect when the appender is (re)opened */
+		fileAppender->Async = strcmp((const char*)value, "0") != 0;
+		return TRUE;
+	}
 	else
 		return FALSE;
 
@@ -210,6 +350,8 @@ static void WLog_FileAppender_Free(wLogAppender* appender)
 	if (appender)
 	{
 		fileAppender = (wLogFileAppender*)appender;
+		/* appenders are freed without being closed, write out what is still queued */
+		WLog_FileAppender_StopWriter(fileAppender);
 		free(fileAppender->FileName);
 		free(fileAppender->FilePath);
 		free(fileAppender->FullFileName);
@@ -279,6 +421,7 @@ wLogAppender* WLog_FileAppender_New(wLog* log)
 			goto error_output_file_name;
 	}
 
+	FileAppender->Async = GetEnvironmentVariableA("WLOG_FILEAPPENDER_ASYNC", NULL, 0) > 0;
 	return (wLogAppender*)FileAppender;
 error_output_file_name:
 	free(FileAppender->FilePath);
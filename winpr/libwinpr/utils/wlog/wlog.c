@@ -27,6 +27,7 @@
 #include <winpr/print.h>
 #include <winpr/debug.h>
 #include <winpr/environment.h>
+#include <winpr/interlocked.h>
 #include <winpr/wlog.h>
 
 #if defined(ANDROID)
@@ -58,6 +59,8 @@ typedef struct
 LPCSTR WLOG_LEVELS[7] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OFF" };
 
 static INIT_ONCE _WLogInitialized = INIT_ONCE_STATIC_INIT;
+/* bumped whenever levels or filters change, invalidates the cached levels */
+static volatile LONG g_LevelGeneration = 1;
 static DWORD g_FilterCount = 0;
 static wLogFilter* g_Filters = NULL;
 static wLog* g_RootLog = NULL;
@@ -442,11 +445,28 @@ DWORD WLog_GetLogLevel(wLog* log)
 BOOL WLog_IsLevelActive(wLog* _log, DWORD _log_level)
 {
 	DWORD level;
+	LONG state;
+	LONG generation;
 
 	if (!_log)
 		return FALSE;
 
-	level = WLog_GetLogLevel(_log);
+	/* Level and generation share one LONG so that a reader never pairs a
+	 * generation with a level computed for an older one. */
+	generation = (LONG)((DWORD)g_LevelGeneration << WLOG_EFFECTIVE_LEVEL_BITS);
+	state = _log->EffectiveState;
+
+	if ((state & ~WLOG_EFFECTIVE_LEVEL_MASK) == generation)
+		level = (DWORD)(state & WLOG_EFFECTIVE_LEVEL_MASK);
+	else
+	{
+		level = WLog_GetLogLevel(_log);
+
+		if (level > WLOG_OFF)
+			level = WLOG_OFF;
+
+		InterlockedExchange(&_log->EffectiveState, generation | (LONG)level);
+	}
 
 	if (level == WLOG_OFF)
 		return FALSE;
@@ -499,6 +519,7 @@ static BOOL WLog_AddStringLogFilters_int(wLog* root, LPCSTR filter)
 	LPCSTR filterStr;
 	LPSTR cp;
 	wLogFilter* tmp;
+	BOOL rc;
 
 	if (!filter)
 		return FALSE;
@@ -555,7 +576,9 @@ static BOOL WLog_AddStringLogFilters_int(wLog* root, LPCSTR filter)
 
 	g_FilterCount = size;
 	free(cp);
-	return WLog_reset_log_filters(root);
+	rc = WLog_reset_log_filters(root);
+	InterlockedIncrement(&g_LevelGeneration);
+	return rc;
 }
 
 BOOL WLog_AddStringLogFilters(LPCSTR filter)
@@ -590,6 +613,7 @@ static BOOL WLog_UpdateInheritLevel(wLog* log, DWORD logLevel)
 BOOL WLog_SetLogLevel(wLog* log, DWORD logLevel)
 {
 	DWORD x;
+	BOOL rc = TRUE;
 
 	if (!log)
 		return FALSE;
@@ -605,10 +629,18 @@ BOOL WLog_SetLogLevel(wLog* log, DWORD logLevel)
 		wLog* child = log->Children[x];
 
 		if (!WLog_UpdateInheritLevel(child, logLevel))
-			return FALSE;
+		{
+			rc = FALSE;
+			break;
+		}
 	}
 
-	return WLog_reset_log_filters(log);
+	if (rc)
+		rc = WLog_reset_log_filters(log);
+
+	/* Only after every level changed, so no cache is validated early */
+	InterlockedIncrement(&g_LevelGeneration);
+	return rc;
 }
 
 int WLog_ParseLogLevel(LPCSTR level)
@@ -728,6 +760,7 @@ BOOL WLog_ParseFilters(wLog* root)
 	free(g_Filters);
 	g_Filters = NULL;
 	g_FilterCount = 0;
+	InterlockedIncrement(&g_LevelGeneration);
 	nSize = GetEnvironmentVariableA(filter, NULL, 0);
 
 	if (nSize < 1)
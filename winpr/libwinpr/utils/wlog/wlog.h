@@ -79,8 +79,15 @@ struct s_wLog
 	DWORD ChildrenCount;
 	DWORD ChildrenSize;
 	CRITICAL_SECTION lock;
+
+	/* WLog_GetLogLevel result in the low bits, the level generation it was
+	 * computed for in the high bits */
+	volatile LONG EffectiveState;
 };
 
+#define WLOG_EFFECTIVE_LEVEL_BITS 3
+#define WLOG_EFFECTIVE_LEVEL_MASK ((1 << WLOG_EFFECTIVE_LEVEL_BITS) - 1)
+
 extern const char* WLOG_LEVELS[7];
 BOOL WLog_Layout_GetMessagePrefix(wLog* log, wLogLayout* layout, wLogMessage* message);
 